@@ -13,6 +13,9 @@ if [[ $# -ne 1 ]] ; then
     echo "  USE_WASM=0 ../build-emscripten.sh .."
     echo
     echo "This should generate a libheif.js and (optionally, without the USE_WASM=0) a libheif.wasm"
+    echo
+    echo "Set USE_SIMD=1 to build with WebAssembly SIMD and USE_PTHREADS=1 to build with threads."
+    echo "A threaded build needs SharedArrayBuffer, i.e. the page has to be cross-origin isolated."
     exit 5
 fi
 
@@ -29,9 +32,22 @@ USE_ES6="${USE_ES6:-0}"
 USE_WASM="${USE_WASM:-1}"
 USE_TYPESCRIPT="${USE_TYPESCRIPT:-1}"
 USE_UNSAFE_EVAL="${USE_UNSAFE_EVAL:-1}"
+USE_SIMD="${USE_SIMD:-0}"
+USE_PTHREADS="${USE_PTHREADS:-0}"
 
 echo "Build using ${CORES} CPU cores"
 
+# Flags that have to be used for libheif and all codec libraries.
+# With SIMD, the NEON kernels are compiled to WebAssembly SIMD by the emscripten NEON headers.
+# With threads, all object files have to be compiled with -pthread to link against shared memory.
+DEPS_COMPILER_FLAGS=""
+if [ "$USE_SIMD" = "1" ]; then
+    DEPS_COMPILER_FLAGS="$DEPS_COMPILER_FLAGS -msimd128 -mfpu=neon"
+fi
+if [ "$USE_PTHREADS" = "1" ]; then
+    DEPS_COMPILER_FLAGS="$DEPS_COMPILER_FLAGS -pthread"
+fi
+
 LIBRARY_LINKER_FLAGS=""
 LIBRARY_INCLUDE_FLAGS=""
 
@@ -45,7 +61,7 @@ if [ "$ENABLE_LIBDE265" = "1" ]; then
         tar xf libde265-${LIBDE265_VERSION}.tar.gz
         cd libde265-${LIBDE265_VERSION}
         [ -x configure ] || ./autogen.sh
-        CXXFLAGS=-O3 emconfigure ./configure --enable-static --disable-shared --disable-sse --disable-dec265 --disable-sherlock265
+        CFLAGS="-O3 ${DEPS_COMPILER_FLAGS}" CXXFLAGS="-O3 ${DEPS_COMPILER_FLAGS}" emconfigure ./configure --enable-static --disable-shared --disable-sse --disable-dec265 --disable-sherlock265
         emmake make -j${CORES}
         cd ..
     fi
@@ -76,6 +92,8 @@ if [ "$ENABLE_AOM" = "1" ]; then
             -DCONFIG_MULTITHREAD=0 \
             -DCONFIG_RUNTIME_CPU_DETECT=0 \
             -DBUILD_SHARED_LIBS=0 \
+            -DCMAKE_C_FLAGS="${DEPS_COMPILER_FLAGS}" \
+            -DCMAKE_CXX_FLAGS="${DEPS_COMPILER_FLAGS}" \
             -DCMAKE_BUILD_TYPE=Release
 
         emmake make -j${CORES}
@@ -89,18 +107,23 @@ if [ "$ENABLE_AOM" = "1" ]; then
 fi
 
 EXTRA_EXE_LINKER_FLAGS="-lembind"
-EXTRA_COMPILER_FLAGS=""
+EXTRA_COMPILER_FLAGS="${DEPS_COMPILER_FLAGS}"
 if [ "$STANDALONE" = "1" ]; then
     EXTRA_EXE_LINKER_FLAGS=""
-    EXTRA_COMPILER_FLAGS="-D__EMSCRIPTEN_STANDALONE_WASM__=1"
+    EXTRA_COMPILER_FLAGS="${EXTRA_COMPILER_FLAGS} -D__EMSCRIPTEN_STANDALONE_WASM__=1"
+fi
+
+ENABLE_MULTITHREADING_SUPPORT="OFF"
+if [ "$USE_PTHREADS" = "1" ]; then
+    ENABLE_MULTITHREADING_SUPPORT="ON"
 fi
 
-CONFIGURE_ARGS="-DENABLE_MULTITHREADING_SUPPORT=OFF -DWITH_GDK_PIXBUF=OFF -DWITH_EXAMPLES=OFF -DBUILD_SHARED_LIBS=OFF -DENABLE_PLUGIN_LOADING=OFF"
+CONFIGURE_ARGS="-DENABLE_MULTITHREADING_SUPPORT=${ENABLE_MULTITHREADING_SUPPORT} -DWITH_GDK_PIXBUF=OFF -DWITH_EXAMPLES=OFF -DBUILD_SHARED_LIBS=OFF -DENABLE_PLUGIN_LOADING=OFF"
 emcmake cmake ${SRCDIR} $CONFIGURE_ARGS \
     -DCMAKE_BUILD_TYPE=Release \
     -DCMAKE_C_FLAGS="${EXTRA_COMPILER_FLAGS}" \
     -DCMAKE_CXX_FLAGS="${EXTRA_COMPILER_FLAGS}" \
-    -DCMAKE_EXE_LINKER_FLAGS="${LIBRARY_LINKER_FLAGS} ${EXTRA_EXE_LINKER_FLAGS}" \
+    -DCMAKE_EXE_LINKER_FLAGS="${LIBRARY_LINKER_FLAGS} ${EXTRA_EXE_LINKER_FLAGS} ${DEPS_COMPILER_FLAGS}" \
     $CONFIGURE_ARGS_LIBDE265 \
     $CONFIGURE_ARGS_AOM
 
@@ -134,6 +157,17 @@ if [ "$USE_ES6" = "1" ]; then
     BUILD_FLAGS="$BUILD_FLAGS -sEXPORT_ES6"
 fi
 
+if [ "$USE_SIMD" = "1" ]; then
+    echo "Building with WebAssembly SIMD"
+    BUILD_FLAGS="$BUILD_FLAGS -msimd128"
+fi
+
+if [ "$USE_PTHREADS" = "1" ]; then
+    echo "Building with threads"
+    # Start the workers together with the module. Threads cannot be started while the main thread is blocked in a decode call.
+    BUILD_FLAGS="$BUILD_FLAGS -pthread -sPTHREAD_POOL_SIZE=navigator.hardwareConcurrency"
+fi
+
 emcc -Wl,--whole-archive "$LIBHEIFA" -Wl,--no-whole-archive \
     -sEXPORTED_FUNCTIONS="$EXPORTED_FUNCTIONS,_free,_malloc,_memcpy" \
     -sMODULARIZE \
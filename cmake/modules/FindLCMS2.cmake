@@ -0,0 +1,24 @@
+include(LibFindMacros)
+
+libfind_pkg_check_modules(LCMS2_PKGCONF lcms2)
+
+find_path(LCMS2_INCLUDE_DIR
+    NAMES lcms2.h
+    HINTS ${LCMS2_PKGCONF_INCLUDE_DIRS} ${LCMS2_PKGCONF_INCLUDEDIR}
+)
+
+find_library(LCMS2_LIBRARY
+    NAMES lcms2 liblcms2
+    HINTS ${LCMS2_PKGCONF_LIBRARY_DIRS} ${LCMS2_PKGCONF_LIBDIR}
+)
+
+set(LCMS2_PROCESS_LIBS LCMS2_LIBRARY)
+set(LCMS2_PROCESS_INCLUDES LCMS2_INCLUDE_DIR)
+libfind_process(LCMS2)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LCMS2
+    REQUIRED_VARS
+        LCMS2_INCLUDE_DIR
+        LCMS2_LIBRARIES
+)
@@ -20,39 +20,62 @@
 
 #include "benchmark.h"
 #include "libheif/heif.h"
-#include <math.h>
+#include "libheif/heif_tracing.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
 
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <thread>
+#endif
 
-double compute_psnr(heif_image* original_image, const std::string& encoded_file)
-{
-  double psnr = 0.0;
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BENCHMARK_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BENCHMARK_NEON 1
+#endif
 
-  // read encoded image
 
-  struct heif_context* ctx = nullptr;
-  struct heif_image_handle* handle = nullptr;
-  struct heif_image* image = nullptr;
-  heif_error err{};
+// --- decoding from memory
 
-  int orig_stride = 0;
-  const uint8_t* orig_p = nullptr;
-  int compressed_stride = 0;
-  const uint8_t* compressed_p = nullptr;
+static heif_error memory_writer_write(heif_context*, const void* data, size_t size, void* userdata)
+{
+  auto* buffer = static_cast<std::vector<uint8_t>*>(userdata);
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  buffer->insert(buffer->end(), bytes, bytes + size);
+  return heif_error_success;
+}
 
-  int w = 0, h = 0;
-  double mse = 0.0;
 
+heif_image* decode_encoded_image(heif_context* encoded_ctx, const heif_image* original_image,
+                                 size_t* out_file_size, heif_decoding_statistics* statistics)
+{
+  std::vector<uint8_t> file_data;
 
-  if (heif_image_get_colorspace(original_image) != heif_colorspace_YCbCr &&
-      heif_image_get_colorspace(original_image) != heif_colorspace_monochrome) {
-    fprintf(stderr, "Benchmark can only be computed on YCbCr or monochrome images\n");
-    goto cleanup;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = memory_writer_write;
+
+  heif_error err = heif_context_write(encoded_ctx, &writer, &file_data);
+  if (err.code) {
+    fprintf(stderr, "Error writing encoded file: %s\n", err.message);
+    return nullptr;
   }
 
+  if (out_file_size) {
+    *out_file_size = file_data.size();
+  }
 
-  ctx = heif_context_alloc();
+  heif_context* ctx = heif_context_alloc();
+  heif_image_handle* handle = nullptr;
+  heif_image* image = nullptr;
+  heif_decoding_options* options = nullptr;
 
-  err = heif_context_read_from_file(ctx, encoded_file.c_str(), nullptr);
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
   if (err.code) {
     fprintf(stderr, "Error reading encoded file: %s\n", err.message);
     goto cleanup;
@@ -64,36 +87,397 @@ double compute_psnr(heif_image* original_image, const std::string& encoded_file)
     goto cleanup;
   }
 
+  options = heif_decoding_options_alloc();
+  options->statistics = statistics;
+
   err = heif_decode_image(handle, &image,
                           heif_image_get_colorspace(original_image),
                           heif_image_get_chroma_format(original_image),
-                          nullptr);
+                          options);
   if (err.code) {
     fprintf(stderr, "Error decoding image: %s\n", err.message);
-    goto cleanup;
+    image = nullptr;
+  }
+
+  cleanup:
+  heif_decoding_options_free(options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  return image;
+}
+
+
+// --- quality metrics
+
+// Calls 'func(begin, end)' for consecutive ranges of [0;n), one range per thread.
+static void parallel_for(int n, int num_threads, const std::function<void(int, int)>& func)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  num_threads = std::max(1, std::min(num_threads, n));
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; t++) {
+    threads.emplace_back(func, n * t / num_threads, n * (t + 1) / num_threads);
   }
 
-  w = heif_image_get_width(original_image, heif_channel_Y);
-  h = heif_image_get_height(original_image, heif_channel_Y);
+  func(0, n / num_threads);
 
-  orig_p = heif_image_get_plane_readonly(original_image, heif_channel_Y, &orig_stride);
-  compressed_p = heif_image_get_plane_readonly(image, heif_channel_Y, &compressed_stride);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+#else
+  (void) num_threads;
+  func(0, n);
+#endif
+}
 
-  for (int y = 0; y < h; y++) {
-    for (int x = 0; x < w; x++) {
-      int d = orig_p[y * orig_stride + x] - compressed_p[y * compressed_stride + x];
-      mse += d * d;
+
+static uint64_t squared_error_row_8bit(const uint8_t* a, const uint8_t* b, int width)
+{
+  uint64_t sum = 0;
+  int x = 0;
+
+#if BENCHMARK_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+
+  for (; x + 16 <= width; x += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*) (a + x));
+    __m128i vb = _mm_loadu_si128((const __m128i*) (b + x));
+    __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    __m128i lo = _mm_unpacklo_epi8(d, zero);
+    __m128i hi = _mm_unpackhi_epi8(d, zero);
+
+    // Each 32 bit lane grows by at most 4*255^2 per iteration. Flushing them every 1024 iterations prevents overflows.
+    acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+
+    if ((x & 0x3FFF) == 0x3FF0) {
+      alignas(16) uint32_t lanes[4];
+      _mm_store_si128((__m128i*) lanes, acc);
+      sum += (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+      acc = _mm_setzero_si128();
     }
   }
 
-  mse /= w * h;
+  alignas(16) uint32_t lanes[4];
+  _mm_store_si128((__m128i*) lanes, acc);
+  sum += (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif BENCHMARK_NEON
+  uint64x2_t acc = vdupq_n_u64(0);
 
-  psnr = 10 * log10(255.0 * 255.0 / mse);
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t d = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+    uint16x8_t lo = vmull_u8(vget_low_u8(d), vget_low_u8(d));
+    uint16x8_t hi = vmull_u8(vget_high_u8(d), vget_high_u8(d));
+    acc = vpadalq_u32(acc, vaddq_u32(vpaddlq_u16(lo), vpaddlq_u16(hi)));
+  }
 
-  cleanup:
-  heif_image_release(image);
-  heif_image_handle_release(handle);
-  heif_context_free(ctx);
+  sum += vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+  for (; x < width; x++) {
+    int d = a[x] - b[x];
+    sum += d * d;
+  }
+
+  return sum;
+}
+
+
+namespace {
+  // Luma plane with the samples widened to 16 bit, as used for SSIM.
+  struct LumaPlane
+  {
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> samples;
+
+    uint16_t at(int x, int y) const { return samples[y * width + x]; }
+  };
+
+
+  struct SsimSums
+  {
+    double ssim = 0.0;
+    double cs = 0.0;   // contrast-structure term, used for MS-SSIM
+    uint64_t num_windows = 0;
+  };
+}
+
+
+static LumaPlane get_luma_plane(const heif_image* image, int num_threads)
+{
+  LumaPlane plane;
+  plane.width = heif_image_get_width(image, heif_channel_Y);
+  plane.height = heif_image_get_height(image, heif_channel_Y);
+  plane.samples.resize((size_t) plane.width * plane.height);
+
+  size_t stride;
+  const uint8_t* p = heif_image_get_plane_readonly2(image, heif_channel_Y, &stride);
+  bool high_bit_depth = heif_image_get_bits_per_pixel_range(image, heif_channel_Y) > 8;
+
+  parallel_for(plane.height, num_threads, [&](int begin, int end) {
+    for (int y = begin; y < end; y++) {
+      uint16_t* out = &plane.samples[(size_t) y * plane.width];
+      if (high_bit_depth) {
+        std::copy_n(reinterpret_cast<const uint16_t*>(p + y * stride), plane.width, out);
+      }
+      else {
+        std::copy_n(p + y * stride, plane.width, out);
+      }
+    }
+  });
+
+  return plane;
+}
+
+
+static LumaPlane downscale_2x2(const LumaPlane& in)
+{
+  LumaPlane out;
+  out.width = in.width / 2;
+  out.height = in.height / 2;
+  out.samples.resize((size_t) out.width * out.height);
+
+  for (int y = 0; y < out.height; y++) {
+    for (int x = 0; x < out.width; x++) {
+      int sum = in.at(2 * x, 2 * y) + in.at(2 * x + 1, 2 * y) + in.at(2 * x, 2 * y + 1) + in.at(2 * x + 1, 2 * y + 1);
+      out.samples[(size_t) y * out.width + x] = (uint16_t) ((sum + 2) / 4);
+    }
+  }
+
+  return out;
+}
+
+
+// SSIM over 8x8 windows that are placed every 4 pixels, as in the libvpx/libaom implementations.
+static SsimSums compute_ssim(const LumaPlane& a, const LumaPlane& b, int max_value, int num_threads)
+{
+  const int kWindow = 8;
+  const int kStep = 4;
+
+  const double c1 = (0.01 * max_value) * (0.01 * max_value);
+  const double c2 = (0.03 * max_value) * (0.03 * max_value);
+
+  SsimSums total;
+  if (a.width < kWindow || a.height < kWindow) {
+    return total;
+  }
+
+  int num_window_rows = (a.height - kWindow) / kStep + 1;
+  int num_window_columns = (a.width - kWindow) / kStep + 1;
+
+  std::vector<SsimSums> band_sums(std::max(1, num_threads));
+  std::mutex band_mutex;
+  int next_band = 0;
+
+  parallel_for(num_window_rows, num_threads, [&](int begin, int end) {
+    SsimSums sums;
+
+    for (int wy = begin; wy < end; wy++) {
+      for (int wx = 0; wx < num_window_columns; wx++) {
+        uint64_t sum_a = 0, sum_b = 0, sum_aa = 0, sum_bb = 0, sum_ab = 0;
+
+        for (int y = wy * kStep; y < wy * kStep + kWindow; y++) {
+          const uint16_t* pa = &a.samples[(size_t) y * a.width + wx * kStep];
+          const uint16_t* pb = &b.samples[(size_t) y * b.width + wx * kStep];
+          for (int x = 0; x < kWindow; x++) {
+            sum_a += pa[x];
+            sum_b += pb[x];
+            sum_aa += (uint64_t) pa[x] * pa[x];
+            sum_bb += (uint64_t) pb[x] * pb[x];
+            sum_ab += (uint64_t) pa[x] * pb[x];
+          }
+        }
+
+        const double n = kWindow * kWindow;
+        double mean_a = (double) sum_a / n;
+        double mean_b = (double) sum_b / n;
+        double var_a = (double) sum_aa / n - mean_a * mean_a;
+        double var_b = (double) sum_bb / n - mean_b * mean_b;
+        double cov = (double) sum_ab / n - mean_a * mean_b;
 
-  return psnr;
+        double cs = (2 * cov + c2) / (var_a + var_b + c2);
+        double luminance = (2 * mean_a * mean_b + c1) / (mean_a * mean_a + mean_b * mean_b + c1);
+
+        sums.ssim += luminance * cs;
+        sums.cs += cs;
+        sums.num_windows++;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(band_mutex);
+    band_sums[next_band++] = sums;
+  });
+
+  for (const SsimSums& sums : band_sums) {
+    total.ssim += sums.ssim;
+    total.cs += sums.cs;
+    total.num_windows += sums.num_windows;
+  }
+
+  total.ssim /= (double) total.num_windows;
+  total.cs /= (double) total.num_windows;
+
+  return total;
+}
+
+
+bool compute_quality_metrics(const heif_image* original_image, const heif_image* decoded_image,
+                             int num_threads, QualityMetrics& out_metrics)
+{
+  if (heif_image_get_colorspace(original_image) != heif_colorspace_YCbCr &&
+      heif_image_get_colorspace(original_image) != heif_colorspace_monochrome) {
+    fprintf(stderr, "Benchmark can only be computed on YCbCr or monochrome images\n");
+    return false;
+  }
+
+  int w = heif_image_get_width(original_image, heif_channel_Y);
+  int h = heif_image_get_height(original_image, heif_channel_Y);
+  int bit_depth = heif_image_get_bits_per_pixel_range(original_image, heif_channel_Y);
+
+  if (heif_image_get_width(decoded_image, heif_channel_Y) != w ||
+      heif_image_get_height(decoded_image, heif_channel_Y) != h ||
+      heif_image_get_bits_per_pixel_range(decoded_image, heif_channel_Y) != bit_depth) {
+    fprintf(stderr, "Decoded image does not match the input image size and bit depth\n");
+    return false;
+  }
+
+  const int max_value = (1 << bit_depth) - 1;
+
+  LumaPlane original = get_luma_plane(original_image, num_threads);
+  LumaPlane decoded = get_luma_plane(decoded_image, num_threads);
+
+
+  // --- PSNR (8 bit images are compared directly on the image planes)
+
+  std::vector<uint64_t> row_errors(h);
+
+  size_t orig_stride, decoded_stride;
+  const uint8_t* orig_p = heif_image_get_plane_readonly2(original_image, heif_channel_Y, &orig_stride);
+  const uint8_t* decoded_p = heif_image_get_plane_readonly2(decoded_image, heif_channel_Y, &decoded_stride);
+
+  parallel_for(h, num_threads, [&](int begin, int end) {
+    for (int y = begin; y < end; y++) {
+      if (bit_depth <= 8) {
+        row_errors[y] = squared_error_row_8bit(orig_p + y * orig_stride, decoded_p + y * decoded_stride, w);
+      }
+      else {
+        uint64_t sum = 0;
+        for (int x = 0; x < w; x++) {
+          int64_t d = (int64_t) original.at(x, y) - decoded.at(x, y);
+          sum += d * d;
+        }
+        row_errors[y] = sum;
+      }
+    }
+  });
+
+  uint64_t squared_error = 0;
+  for (uint64_t e : row_errors) {
+    squared_error += e;
+  }
+
+  double mse = (double) squared_error / ((double) w * h);
+  out_metrics.psnr = (mse == 0.0 ? INFINITY : 10 * log10((double) max_value * max_value / mse));
+
+
+  // --- SSIM and MS-SSIM
+  //     MS-SSIM uses the five scales and weights of Wang et al. Scales that would be smaller than the SSIM
+  //     window are left out and the weights of the remaining scales are renormalized.
+
+  const double kScaleWeights[5] = {0.0448, 0.2856, 0.3001, 0.2363, 0.1333};
+
+  std::vector<SsimSums> scale_sums;
+  for (int scale = 0; scale < 5; scale++) {
+    if (scale > 0) {
+      if (original.width / 2 < 8 || original.height / 2 < 8) {
+        break;
+      }
+
+      original = downscale_2x2(original);
+      decoded = downscale_2x2(decoded);
+    }
+
+    scale_sums.push_back(compute_ssim(original, decoded, max_value, num_threads));
+    if (scale_sums.back().num_windows == 0) {
+      return false;
+    }
+  }
+
+  out_metrics.ssim = scale_sums[0].ssim;
+
+  double weight_sum = 0.0;
+  for (size_t i = 0; i < scale_sums.size(); i++) {
+    weight_sum += kScaleWeights[i];
+  }
+
+  double ms_ssim = 1.0;
+  for (size_t i = 0; i < scale_sums.size(); i++) {
+    double value = (i + 1 == scale_sums.size()) ? scale_sums[i].ssim : scale_sums[i].cs;
+    ms_ssim *= pow(std::max(value, 0.0), kScaleWeights[i] / weight_sum);
+  }
+
+  out_metrics.ms_ssim = ms_ssim;
+
+  return true;
+}
+
+
+// --- stage timing
+
+StageTimes::~StageTimes()
+{
+  uninstall();
+}
+
+
+bool StageTimes::install()
+{
+  if (!heif_have_tracing_support()) {
+    return false;
+  }
+
+  heif_trace_sink sink;
+  sink.version = 1;
+  sink.trace_event = [](const heif_trace_event* event, void* user_data) {
+    static_cast<StageTimes*>(user_data)->add(*event);
+  };
+
+  m_installed = (heif_set_trace_sink(&sink, this).code == heif_error_Ok);
+  return m_installed;
+}
+
+
+void StageTimes::uninstall()
+{
+  if (m_installed) {
+    heif_set_trace_sink(nullptr, nullptr);
+    m_installed = false;
+  }
+}
+
+
+void StageTimes::add(const heif_trace_event& event)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Stage& stage = m_stages[std::string(event.category) + "/" + event.name];
+  stage.duration_us += event.duration_us;
+  stage.count++;
+}
+
+
+void StageTimes::write(std::ostream& ostr) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // Nested operations are included in the time of their enclosing operation and the times of parallel
+  // operations are summed up. Hence, the stage times do not add up to the total time.
+
+  for (const auto& [name, stage] : m_stages) {
+    ostr << "  " << name << ": " << std::setprecision(1) << std::fixed << (double) stage.duration_us / 1000.0
+         << " ms (" << stage.count << "x)\n";
+  }
 }
@@ -22,11 +22,64 @@
 #ifndef LIBHEIF_BENCHMARK_H
 #define LIBHEIF_BENCHMARK_H
 
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <vector>
 
+struct heif_context;
 struct heif_image;
+struct heif_decoding_statistics;
+struct heif_trace_event;
 
-double compute_psnr(heif_image* original_image, const std::string& encoded_file);
+
+struct QualityMetrics
+{
+  double psnr = 0.0;
+  double ssim = 0.0;
+  double ms_ssim = 0.0;
+};
+
+// Writes the context into memory and decodes its primary image in the colorspace and chroma of 'original_image'.
+// 'out_file_size' is the size of the written file. The decoding times are added to 'statistics' unless it is NULL.
+// Returns NULL on error.
+heif_image* decode_encoded_image(heif_context* ctx, const heif_image* original_image,
+                                 size_t* out_file_size, heif_decoding_statistics* statistics);
+
+// Compares the luma planes of the two images. The image rows are distributed over 'num_threads' threads.
+// Returns false if the images cannot be compared.
+bool compute_quality_metrics(const heif_image* original_image, const heif_image* decoded_image,
+                             int num_threads, QualityMetrics& out_metrics);
+
+
+// Sums up the durations of the libheif trace events, separately for each operation.
+// This requires that libheif was built with tracing support.
+class StageTimes
+{
+public:
+  ~StageTimes();
+
+  bool install();
+
+  void uninstall();
+
+  void write(std::ostream& ostr) const;
+
+private:
+  void add(const heif_trace_event& event);
+
+  struct Stage
+  {
+    uint64_t duration_us = 0;
+    uint64_t count = 0;
+  };
+
+  mutable std::mutex m_mutex;
+  std::map<std::string, Stage> m_stages;
+  bool m_installed = false;
+};
 
 #endif //LIBHEIF_BENCHMARK_H
@@ -31,6 +31,9 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
 
 
 void show_version()
@@ -145,4 +148,212 @@ int check_for_valid_input_HEIF_file(const std::string& input_filename)
   }
 
   return 0;
-}
\ No newline at end of file
+}
+
+bool read_batch_entry(std::istream& manifest, BatchEntry& entry)
+{
+  // 'entry' is passed in again for the next line, continue counting from its line
+  int line_number = entry.line_number;
+
+  std::string line;
+
+  while (std::getline(manifest, line)) {
+    line_number++;
+
+    entry = BatchEntry{};
+    entry.line_number = line_number;
+
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    std::vector<std::string> fields;
+
+    if (line.find('\t') != std::string::npos) {
+      std::istringstream fields_stream(line);
+      std::string field;
+      while (std::getline(fields_stream, field, '\t')) {
+        if (!field.empty()) {
+          fields.push_back(field);
+        }
+      }
+    }
+    else {
+      std::istringstream fields_stream(line);
+      std::string field;
+      while (fields_stream >> field) {
+        fields.push_back(field);
+      }
+    }
+
+    if (fields.empty() || fields[0][0] == '#') {
+      continue;
+    }
+
+    if (fields.size() < 2) {
+      entry.input_filename = fields[0];
+      entry.error = "missing output filename";
+      return true;
+    }
+
+    entry.input_filename = fields[0];
+    entry.output_filename = fields[1];
+    entry.options.assign(fields.begin() + 2, fields.end());
+    return true;
+  }
+
+  return false;
+}
+
+
+void report_batch_result(std::ostream& out, const BatchEntry& entry, int exit_code)
+{
+  if (exit_code == 0) {
+    out << "ok\t" << entry.output_filename << std::endl;
+  }
+  else {
+    out << "error\t" << entry.output_filename << '\t' << exit_code << std::endl;
+  }
+}
+
+
+// Returns the length of the valid UTF-8 sequence starting at s[i], or 0 if it is invalid.
+static size_t utf8_sequence_length(const std::string& s, size_t i)
+{
+  auto byte = [&s](size_t k) { return static_cast<unsigned char>(s[k]); };
+
+  unsigned char c = byte(i);
+  size_t len;
+  unsigned char min2 = 0x80, max2 = 0xBF; // range of the second byte (excludes overlong forms and surrogates)
+
+  if (c >= 0xC2 && c <= 0xDF) {
+    len = 2;
+  }
+  else if (c >= 0xE0 && c <= 0xEF) {
+    len = 3;
+    if (c == 0xE0) min2 = 0xA0;
+    if (c == 0xED) max2 = 0x9F;
+  }
+  else if (c >= 0xF0 && c <= 0xF4) {
+    len = 4;
+    if (c == 0xF0) min2 = 0x90;
+    if (c == 0xF4) max2 = 0x8F;
+  }
+  else {
+    return 0;
+  }
+
+  if (i + len > s.size() || byte(i + 1) < min2 || byte(i + 1) > max2) {
+    return 0;
+  }
+
+  for (size_t k = 2; k < len; k++) {
+    if (byte(i + k) < 0x80 || byte(i + k) > 0xBF) {
+      return 0;
+    }
+  }
+
+  return len;
+}
+
+
+std::string json_escape(const std::string& s)
+{
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    char c = s[i];
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        }
+        else if (static_cast<unsigned char>(c) < 0x80) {
+          out += c;
+        }
+        else if (size_t len = utf8_sequence_length(s, i)) {
+          out.append(s, i, len);
+          i += len - 1;
+        }
+        else {
+          // Not UTF-8 (e.g. a fourcc with arbitrary bytes). Output the byte as the code point of the same value.
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+          out += buf;
+        }
+    }
+  }
+  return out;
+}
+
+
+heif_image* create_synthetic_image(uint32_t width, uint32_t height, heif_colorspace colorspace, heif_chroma chroma,
+                                   int bpp, uint32_t seed)
+{
+  heif_image* img;
+  heif_error err = heif_image_create((int) width, (int) height, colorspace, chroma, &img);
+  if (err.code) {
+    return nullptr;
+  }
+
+  std::vector<heif_channel> channels;
+  uint32_t samples_per_pixel = 1;
+  if (colorspace == heif_colorspace_YCbCr) {
+    channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+  }
+  else if (chroma == heif_chroma_444) {
+    channels = {heif_channel_R, heif_channel_G, heif_channel_B};
+  }
+  else {
+    channels = {heif_channel_interleaved};
+    samples_per_pixel = 3;
+  }
+
+  uint32_t state = seed * 2654435761U + 1;
+  uint32_t max_value = (1U << bpp) - 1;
+
+  for (uint32_t c = 0; c < channels.size(); c++) {
+    bool subsampled = (c > 0 && chroma == heif_chroma_420);
+    uint32_t w = subsampled ? (width + 1) / 2 : width;
+    uint32_t h = subsampled ? (height + 1) / 2 : height;
+
+    err = heif_image_add_plane(img, channels[c], (int) w, (int) h, bpp);
+    if (err.code) {
+      heif_image_release(img);
+      return nullptr;
+    }
+
+    size_t stride;
+    uint8_t* p = heif_image_get_plane2(img, channels[c], &stride);
+
+    for (uint32_t y = 0; y < h; y++) {
+      for (uint32_t i = 0; i < w * samples_per_pixel; i++) {
+        uint32_t x = i / samples_per_pixel;
+        uint32_t component = c + i % samples_per_pixel;
+
+        state = state * 1664525U + 1013904223U;
+        uint32_t v = ((x + seed) * (component + 1) * max_value / w + y * max_value / h) / 2 + ((state >> 24) & 0x0F);
+        v = std::min(v, max_value);
+
+        if (bpp > 8) {
+          reinterpret_cast<uint16_t*>(p + y * stride)[i] = static_cast<uint16_t>(v);
+        }
+        else {
+          p[y * stride + i] = static_cast<uint8_t>(v);
+        }
+      }
+    }
+  }
+
+  return img;
+}
@@ -28,11 +28,18 @@
 #define LIBHEIF_COMMON_H
 
 #include <libheif/heif.h>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <vector>
 
 // Note: the same function is also exists in common_utils.h, but is not in the public API.
 std::string fourcc_to_string(uint32_t fourcc);
 
+// Escapes the string for use in a JSON string literal (without the surrounding quotes).
+// Bytes that are not part of valid UTF-8 sequences are escaped as \u00XX.
+std::string json_escape(const std::string& s);
+
 void show_version();
 
 void list_all_decoders();
@@ -42,4 +49,33 @@ void list_decoders(heif_compression_format format);
 // returns 0 on success, or program exit code in case of warning/error
 int check_for_valid_input_HEIF_file(const std::string& input_filename);
 
+
+// One line of a batch manifest: "input output [option...]".
+// The fields are separated by tabs if the line contains a tab (to allow spaces in filenames), otherwise by whitespace.
+// Empty lines and lines starting with '#' are skipped.
+struct BatchEntry
+{
+  std::string input_filename;
+  std::string output_filename;
+  std::vector<std::string> options;
+
+  int line_number = 0;
+
+  // set if the line could not be parsed
+  std::string error;
+};
+
+// Reads the next entry. Returns false at the end of the manifest.
+bool read_batch_entry(std::istream& manifest, BatchEntry& entry);
+
+// Writes "ok\t<output>" or "error\t<output>\t<exit code>" and flushes it, such that a process driving
+// a batch through stdin/stdout gets the result as soon as the entry is processed.
+void report_batch_result(std::ostream& out, const BatchEntry& entry, int exit_code);
+
+
+// Synthetic test content: a gradient with some noise, such that lossy encoders do not degenerate to trivial bitstreams.
+// Different seeds give different images. Returns NULL if the image cannot be created.
+heif_image* create_synthetic_image(uint32_t width, uint32_t height, heif_colorspace colorspace, heif_chroma chroma,
+                                   int bpp, uint32_t seed);
+
 #endif //LIBHEIF_COMMON_H
@@ -0,0 +1,900 @@
+/*
+  libheif example application "heif-bench".
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libheif/heif.h>
+#include <libheif/heif_sequences.h>
+#include <libheif/heif_tracing.h>
+#include "common.h"
+
+
+// --- command line options
+
+static int option_iterations = 5;
+static std::vector<int> option_threads{1};
+static uint32_t option_width = 2048;
+static uint32_t option_height = 2048;
+static uint32_t option_tile_size = 512;
+static uint32_t option_viewport_size = 1024;
+static int option_sequence_frames = 30;
+static bool option_synthetic = true;
+static std::string option_filter;
+static std::string option_output;
+static std::string option_trace;
+static heif_compression_format option_format = heif_compression_undefined;
+
+
+static struct option long_options[] = {
+    {(char* const) "iterations",    required_argument, 0, 'n'},
+    {(char* const) "threads",       required_argument, 0, 't'},
+    {(char* const) "size",          required_argument, 0, 's'},
+    {(char* const) "tile-size",     required_argument, 0, 'T'},
+    {(char* const) "viewport",      required_argument, 0, 'V'},
+    {(char* const) "frames",        required_argument, 0, 'F'},
+    {(char* const) "encoder",       required_argument, 0, 'e'},
+    {(char* const) "filter",        required_argument, 0, 'f'},
+    {(char* const) "output",        required_argument, 0, 'o'},
+    {(char* const) "trace",         required_argument, 0, 'J'},
+    {(char* const) "no-synthetic",  no_argument,       0, 'N'},
+    {(char* const) "help",          no_argument,       0, 'h'},
+    {(char* const) "version",       no_argument,       0, 'v'},
+    {0, 0,                                             0, 0}
+};
+
+
+static void show_help(const char* argv0)
+{
+  std::cerr << " heif-bench  libheif version: " << heif_get_version() << "\n"
+            << "-------------------------------------\n"
+            << "Usage: heif-bench [options] [corpus files...]\n"
+            << "\n"
+            << "Runs decoding, grid/tile and color conversion benchmarks on synthetic images and on the given files.\n"
+            << "The 'encode/speed-class-N' scenarios measure the encoding time of each speed class of the encoder.\n"
+            << "The results are written as JSON.\n"
+            << "\n"
+            << "Options:\n"
+            << "  -n, --iterations N     number of timed runs per scenario (default: 5)\n"
+            << "  -t, --threads LIST     comma separated list of decoding thread counts (default: 1)\n"
+            << "  -s, --size WxH         size of the synthetic images (default: 2048x2048)\n"
+            << "  -T, --tile-size N      tile size of the synthetic grid image (default: 512)\n"
+            << "  -V, --viewport N       size of the decoded viewport in the tile scenarios (default: 1024)\n"
+            << "  -F, --frames N         number of frames of the synthetic sequence (default: 30)\n"
+            << "  -e, --encoder FORMAT   compression of the synthetic images: unci, hevc, av1, jpeg, j2k\n"
+            << "                         (default: unci when available, otherwise the first available encoder)\n"
+            << "  -f, --filter TEXT      only run scenarios whose name contains TEXT\n"
+            << "  -o, --output FILE      write the JSON results to FILE instead of stdout\n"
+            << "  -J, --trace FILE       write a Chrome JSON trace (chrome://tracing, Perfetto) of all runs to FILE\n"
+            << "                         (requires libheif built with ENABLE_TRACING)\n"
+            << "  -N, --no-synthetic     only benchmark the corpus files\n"
+            << "  -h, --help             show help\n"
+            << "  -v, --version          show version\n";
+}
+
+
+// --- small helpers
+
+static std::vector<int> parse_int_list(const char* s)
+{
+  std::vector<int> values;
+  std::stringstream sstr(s);
+  std::string item;
+  while (std::getline(sstr, item, ',')) {
+    int v = atoi(item.c_str());
+    if (v <= 0) {
+      std::cerr << "Invalid value in list: " << item << "\n";
+      exit(5);
+    }
+    values.push_back(v);
+  }
+  return values;
+}
+
+
+static heif_error write_to_vector(struct heif_context*, const void* data, size_t size, void* userdata)
+{
+  auto* v = static_cast<std::vector<uint8_t>*>(userdata);
+  auto* p = static_cast<const uint8_t*>(data);
+  v->insert(v->end(), p, p + size);
+  return heif_error_success;
+}
+
+
+// --- benchmark results
+
+struct BenchmarkResult
+{
+  std::string scenario;
+  std::string input;
+  int threads = 1;
+  double megapixels = 0; // pixels processed in each run
+  std::vector<double> times_ms;
+  std::string error;
+};
+
+static std::vector<BenchmarkResult> results;
+
+
+static bool scenario_enabled(const std::string& name)
+{
+  return option_filter.empty() || name.find(option_filter) != std::string::npos;
+}
+
+
+// Runs 'body' once untimed to warm up the caches, then 'option_iterations' times with timing.
+// 'body' may return an error, which ends the scenario and is reported in the results.
+static void run_scenario(const std::string& scenario, const std::string& input, int threads, double megapixels,
+                         const std::function<heif_error()>& body)
+{
+  if (!scenario_enabled(scenario)) {
+    return;
+  }
+
+  BenchmarkResult result;
+  result.scenario = scenario;
+  result.input = input;
+  result.threads = threads;
+  result.megapixels = megapixels;
+
+  std::cerr << scenario << " (" << input << ", " << threads << " threads) ... ";
+
+  heif_error err = body();
+  for (int i = 0; i < option_iterations && err.code == heif_error_Ok; i++) {
+    auto start = std::chrono::steady_clock::now();
+    err = body();
+    auto end = std::chrono::steady_clock::now();
+
+    result.times_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  if (err.code != heif_error_Ok) {
+    result.error = err.message ? err.message : "unknown error";
+    result.times_ms.clear();
+    std::cerr << "error: " << result.error << "\n";
+  }
+  else {
+    std::cerr << "done\n";
+  }
+
+  results.push_back(std::move(result));
+}
+
+
+static void write_results(std::ostream& ostr)
+{
+  ostr << "{\n"
+       << "  \"libheif_version\": \"" << json_escape(heif_get_version()) << "\",\n"
+       << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+       << "  \"iterations\": " << option_iterations << ",\n"
+       << "  \"results\": [";
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& r = results[i];
+
+    ostr << (i == 0 ? "\n" : ",\n")
+         << "    {\"scenario\": \"" << json_escape(r.scenario) << "\""
+         << ", \"input\": \"" << json_escape(r.input) << "\""
+         << ", \"threads\": " << r.threads;
+
+    if (!r.error.empty()) {
+      ostr << ", \"error\": \"" << json_escape(r.error) << "\"}";
+      continue;
+    }
+
+    std::vector<double> sorted = r.times_ms;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for (double t : sorted) {
+      sum += t;
+    }
+
+    double median = sorted[sorted.size() / 2];
+    if (sorted.size() % 2 == 0) {
+      median = (median + sorted[sorted.size() / 2 - 1]) / 2;
+    }
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             ", \"min_ms\": %.3f, \"median_ms\": %.3f, \"mean_ms\": %.3f, \"max_ms\": %.3f",
+             sorted.front(), median, sum / (double) sorted.size(), sorted.back());
+    ostr << buf;
+
+    if (r.megapixels > 0) {
+      snprintf(buf, sizeof(buf), ", \"megapixels\": %.3f, \"megapixels_per_second\": %.2f",
+               r.megapixels, r.megapixels / (median / 1000.0));
+      ostr << buf;
+    }
+
+    ostr << "}";
+  }
+
+  ostr << "\n  ]\n}\n";
+}
+
+
+// --- scenarios on an encoded file
+
+struct ConversionTarget
+{
+  const char* name;
+  heif_colorspace colorspace;
+  heif_chroma chroma;
+};
+
+static const ConversionTarget conversion_targets[] = {
+    {"rgb24",      heif_colorspace_RGB,   heif_chroma_interleaved_RGB},
+    {"rgba32",     heif_colorspace_RGB,   heif_chroma_interleaved_RGBA},
+    {"rgb-planar", heif_colorspace_RGB,   heif_chroma_444},
+    {"rrggbb-le",  heif_colorspace_RGB,   heif_chroma_interleaved_RRGGBB_LE},
+    {"ycbcr420",   heif_colorspace_YCbCr, heif_chroma_420},
+    {"ycbcr444",   heif_colorspace_YCbCr, heif_chroma_444},
+};
+
+
+class FileBenchmark
+{
+public:
+  FileBenchmark(std::string name, const std::vector<uint8_t>& data)
+      : m_name(std::move(name)), m_data(data)
+  {
+  }
+
+  ~FileBenchmark()
+  {
+    heif_image_handle_release(m_handle);
+    heif_context_free(m_ctx);
+  }
+
+  heif_error open()
+  {
+    m_ctx = heif_context_alloc();
+    heif_error err = heif_context_read_from_memory_without_copy(m_ctx, m_data.data(), m_data.size(), nullptr);
+    if (err.code) {
+      return err;
+    }
+
+    // pure sequence files may have no primary image
+    if (heif_context_get_number_of_top_level_images(m_ctx) == 0 && has_sequence()) {
+      return heif_error_success;
+    }
+
+    return heif_context_get_primary_image_handle(m_ctx, &m_handle);
+  }
+
+  double megapixels() const
+  {
+    return heif_image_handle_get_width(m_handle) * (double) heif_image_handle_get_height(m_handle) / 1.0e6;
+  }
+
+  void run_open()
+  {
+    run_scenario("open", m_name, 1, 0, [this]() {
+      heif_context* ctx = heif_context_alloc();
+      heif_error err = heif_context_read_from_memory_without_copy(ctx, m_data.data(), m_data.size(), nullptr);
+      if (err.code == heif_error_Ok && m_handle) {
+        heif_image_handle* handle;
+        err = heif_context_get_primary_image_handle(ctx, &handle);
+        if (err.code == heif_error_Ok) {
+          heif_image_handle_release(handle);
+        }
+      }
+      heif_context_free(ctx);
+      return err;
+    });
+  }
+
+  heif_error decode(heif_colorspace colorspace, heif_chroma chroma, int threads)
+  {
+    heif_context_set_max_decoding_threads(m_ctx, threads);
+
+    heif_image* img;
+    heif_error err = heif_decode_image(m_handle, &img, colorspace, chroma, nullptr);
+    if (err.code == heif_error_Ok) {
+      heif_image_release(img);
+    }
+
+    return err;
+  }
+
+  // Decoding into the native format of the image. The conversion scenarios should be compared to this.
+  void run_decode(const std::string& scenario, int threads)
+  {
+    run_scenario(scenario, m_name, threads, megapixels(), [this, threads]() {
+      return decode(heif_colorspace_undefined, heif_chroma_undefined, threads);
+    });
+  }
+
+  void run_conversions(int threads)
+  {
+    for (const auto& target : conversion_targets) {
+      run_scenario(std::string("convert/") + target.name, m_name, threads, megapixels(), [this, threads, target]() {
+        return decode(target.colorspace, target.chroma, threads);
+      });
+    }
+  }
+
+  bool is_tiled() const
+  {
+    heif_image_tiling tiling;
+    heif_error err = heif_image_handle_get_image_tiling(m_handle, 1, &tiling);
+    return err.code == heif_error_Ok && tiling.num_columns * tiling.num_rows > 1;
+  }
+
+  // Decodes a centered square viewport, which covers only some of the tiles.
+  void run_viewport(int threads)
+  {
+    uint32_t w = heif_image_handle_get_width(m_handle);
+    uint32_t h = heif_image_handle_get_height(m_handle);
+    uint32_t vw = std::min(option_viewport_size, w);
+    uint32_t vh = std::min(option_viewport_size, h);
+
+    run_scenario("tiled/viewport", m_name, threads, vw * (double) vh / 1.0e6, [this, threads, w, h, vw, vh]() {
+      heif_context_set_max_decoding_threads(m_ctx, threads);
+
+      heif_image* img;
+      heif_error err = heif_decode_image_region(m_handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                                (w - vw) / 2, (h - vh) / 2, vw, vh);
+      if (err.code == heif_error_Ok) {
+        heif_image_release(img);
+      }
+      return err;
+    });
+  }
+
+  bool has_sequence() const
+  {
+    return heif_context_has_sequence(m_ctx);
+  }
+
+  void run_sequence(int threads)
+  {
+    run_scenario("sequence/decode", m_name, threads, 0, [this, threads]() {
+      heif_context_set_max_decoding_threads(m_ctx, threads);
+
+      heif_track* track = heif_context_get_track(m_ctx, 0);
+      if (!track) {
+        return heif_error{heif_error_Usage_error, heif_suberror_Unspecified, "no visual track"};
+      }
+
+      // the track position is kept in the context, start again from the first sample
+      heif_error err = heif_track_seek_to_sample(track, 0);
+
+      int frames = 0;
+      while (err.code == heif_error_Ok) {
+        heif_image* img;
+        err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+        if (err.code == heif_error_Ok) {
+          heif_image_release(img);
+          frames++;
+        }
+      }
+
+      heif_track_release(track);
+
+      if (err.code == heif_error_End_of_sequence && frames > 0) {
+        return heif_error_success;
+      }
+      else if (err.code == heif_error_End_of_sequence) {
+        return heif_error{heif_error_Usage_error, heif_suberror_Unspecified, "empty sequence"};
+      }
+      return err;
+    });
+  }
+
+  // All scenarios that apply to the file.
+  void run_all()
+  {
+    run_open();
+
+    if (m_handle) {
+      for (int threads : option_threads) {
+        run_decode(is_tiled() ? "grid/decode" : "decode", threads);
+      }
+
+      run_conversions(option_threads.front());
+
+      if (is_tiled()) {
+        for (int threads : option_threads) {
+          run_viewport(threads);
+        }
+      }
+    }
+
+    if (has_sequence()) {
+      run_sequence(option_threads.front());
+    }
+  }
+
+private:
+  std::string m_name;
+  const std::vector<uint8_t>& m_data;
+
+  heif_context* m_ctx = nullptr;
+  heif_image_handle* m_handle = nullptr;
+};
+
+
+static void run_file_benchmark(const std::string& name, const std::vector<uint8_t>& data,
+                               const std::function<void(FileBenchmark&)>& scenarios)
+{
+  FileBenchmark bench(name, data);
+  heif_error err = bench.open();
+  if (err.code) {
+    BenchmarkResult result;
+    result.scenario = "open";
+    result.input = name;
+    result.error = err.message;
+    results.push_back(result);
+
+    std::cerr << "cannot open " << name << ": " << err.message << "\n";
+    return;
+  }
+
+  scenarios(bench);
+}
+
+
+// --- synthetic input
+
+static heif_compression_format select_synthetic_format()
+{
+  if (option_format != heif_compression_undefined) {
+    return option_format;
+  }
+
+  for (heif_compression_format format : {heif_compression_uncompressed, heif_compression_HEVC, heif_compression_AV1,
+                                         heif_compression_JPEG2000, heif_compression_JPEG}) {
+    if (heif_have_encoder_for_format(format)) {
+      return format;
+    }
+  }
+
+  return heif_compression_undefined;
+}
+
+
+enum class SyntheticLayout
+{
+  single_image,
+  grid,
+  sequence
+};
+
+// Encodes a synthetic file. Returns an empty vector (and prints the error) if this is not possible.
+static std::vector<uint8_t> encode_synthetic_file(heif_compression_format format, SyntheticLayout layout,
+                                                  heif_colorspace colorspace, heif_chroma chroma, int bpp)
+{
+  std::vector<uint8_t> data;
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder = nullptr;
+  heif_track_info* info = nullptr;
+  heif_track* track = nullptr;
+  std::vector<heif_image*> images;
+
+  heif_error err = heif_context_get_encoder_for_format(ctx, format, &encoder);
+
+  if (err.code == heif_error_Ok) {
+    heif_encoder_set_lossy_quality(encoder, 90);
+
+    if (layout == SyntheticLayout::single_image) {
+      images.push_back(create_synthetic_image(option_width, option_height, colorspace, chroma, bpp, 0));
+      err = heif_context_encode_image(ctx, images[0], encoder, nullptr, nullptr);
+    }
+    else if (layout == SyntheticLayout::grid) {
+      uint32_t columns = std::max(1U, option_width / option_tile_size);
+      uint32_t rows = std::max(1U, option_height / option_tile_size);
+
+      for (uint32_t i = 0; i < columns * rows; i++) {
+        images.push_back(create_synthetic_image(option_tile_size, option_tile_size, colorspace, chroma, bpp, i));
+      }
+
+      err = heif_context_encode_grid(ctx, images.data(), static_cast<uint16_t>(rows), static_cast<uint16_t>(columns),
+                                     encoder, nullptr, nullptr);
+    }
+    else {
+      uint32_t w = std::min(option_width, 1280U);
+      uint32_t h = std::min(option_height, 720U);
+
+      info = heif_track_info_alloc();
+      info->track_timescale = 30;
+      err = heif_context_add_visual_sequence_track(ctx, static_cast<uint16_t>(w), static_cast<uint16_t>(h), info,
+                                                   heif_track_type_video, &track);
+
+      for (int i = 0; i < option_sequence_frames && err.code == heif_error_Ok; i++) {
+        images.push_back(create_synthetic_image(w, h, colorspace, chroma, bpp, i * 7));
+        heif_image_set_duration(images.back(), 1);
+        err = heif_track_encode_sequence_image(track, images.back(), encoder, nullptr);
+      }
+    }
+  }
+
+  if (err.code == heif_error_Ok) {
+    heif_writer writer{};
+    writer.writer_api_version = 1;
+    writer.write = write_to_vector;
+    err = heif_context_write(ctx, &writer, &data);
+  }
+
+  if (err.code != heif_error_Ok) {
+    std::cerr << "cannot encode synthetic input: " << err.message << "\n";
+    data.clear();
+  }
+
+  for (heif_image* img : images) {
+    heif_image_release(img);
+  }
+
+  heif_track_release(track);
+  heif_track_info_release(info);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  return data;
+}
+
+
+// Encodes a synthetic image with each speed class of the encoder (see heif_encoder_set_speed_class()),
+// such that the fastest speed class that meets an encoding time budget can be chosen.
+static void run_speed_class_calibration(heif_compression_format format)
+{
+  bool any_enabled = false;
+  for (int speed_class = 0; speed_class <= 9; speed_class++) {
+    any_enabled |= scenario_enabled("encode/speed-class-" + std::to_string(speed_class));
+  }
+
+  if (!any_enabled) {
+    return;
+  }
+
+  // check that the encoder maps the speed classes
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder = nullptr;
+  heif_error err = heif_context_get_encoder_for_format(ctx, format, &encoder);
+  if (err.code == heif_error_Ok) {
+    err = heif_encoder_set_speed_class(encoder, 0);
+  }
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  if (err.code != heif_error_Ok) {
+    std::cerr << "encoder has no speed classes: " << err.message << "\n";
+    return;
+  }
+
+  heif_image* img = create_synthetic_image(option_width, option_height, heif_colorspace_YCbCr, heif_chroma_420, 8, 0);
+  if (!img) {
+    return;
+  }
+
+  std::string input = "synthetic:ycbcr420-8bit-" + std::to_string(option_width) + "x" + std::to_string(option_height);
+  double megapixels = option_width * (double) option_height / 1.0e6;
+
+  for (int speed_class = 0; speed_class <= 9; speed_class++) {
+    run_scenario("encode/speed-class-" + std::to_string(speed_class), input, 1, megapixels, [format, img, speed_class]() {
+      heif_context* ctx = heif_context_alloc();
+      heif_encoder* encoder = nullptr;
+      heif_error err = heif_context_get_encoder_for_format(ctx, format, &encoder);
+      if (err.code == heif_error_Ok) {
+        heif_encoder_set_lossy_quality(encoder, 90);
+        err = heif_encoder_set_speed_class(encoder, speed_class);
+      }
+      if (err.code == heif_error_Ok) {
+        err = heif_context_encode_image(ctx, img, encoder, nullptr, nullptr);
+      }
+      heif_encoder_release(encoder);
+      heif_context_free(ctx);
+      return err;
+    });
+  }
+
+  heif_image_release(img);
+}
+
+
+struct SyntheticSource
+{
+  const char* name;
+  heif_colorspace colorspace;
+  heif_chroma chroma;
+  int bpp;
+};
+
+static const SyntheticSource synthetic_sources[] = {
+    {"ycbcr420",  heif_colorspace_YCbCr, heif_chroma_420,                   8},
+    {"ycbcr420",  heif_colorspace_YCbCr, heif_chroma_420,                   10},
+    {"rgb444",    heif_colorspace_RGB,   heif_chroma_444,                   8},
+    {"rrggbb-be", heif_colorspace_RGB,   heif_chroma_interleaved_RRGGBB_BE, 10},
+};
+
+
+static void run_synthetic_benchmarks()
+{
+  heif_compression_format format = select_synthetic_format();
+  if (format == heif_compression_undefined || !heif_have_encoder_for_format(format)) {
+    std::cerr << "no encoder available for the synthetic images\n";
+    return;
+  }
+
+  std::string size = std::to_string(option_width) + "x" + std::to_string(option_height);
+
+  for (const auto& source : synthetic_sources) {
+    std::vector<uint8_t> data = encode_synthetic_file(format, SyntheticLayout::single_image,
+                                                      source.colorspace, source.chroma, source.bpp);
+    if (data.empty()) {
+      continue;
+    }
+
+    std::string name = std::string("synthetic:") + source.name + "-" + std::to_string(source.bpp) + "bit-" + size;
+
+    run_file_benchmark(name, data, [](FileBenchmark& bench) {
+      bench.run_open();
+      for (int threads : option_threads) {
+        bench.run_decode("decode", threads);
+        bench.run_conversions(threads);
+      }
+    });
+  }
+
+  std::vector<uint8_t> grid = encode_synthetic_file(format, SyntheticLayout::grid,
+                                                    heif_colorspace_YCbCr, heif_chroma_420, 8);
+  if (!grid.empty()) {
+    std::string name = "synthetic:grid-ycbcr420-8bit-" + size + "-tile" + std::to_string(option_tile_size);
+
+    run_file_benchmark(name, grid, [](FileBenchmark& bench) {
+      bench.run_open();
+      for (int threads : option_threads) {
+        bench.run_decode("grid/decode", threads);
+        bench.run_viewport(threads);
+      }
+    });
+  }
+
+  std::vector<uint8_t> sequence = encode_synthetic_file(format, SyntheticLayout::sequence,
+                                                        heif_colorspace_YCbCr, heif_chroma_420, 8);
+  if (!sequence.empty()) {
+    std::string name = "synthetic:sequence-ycbcr420-8bit-" + std::to_string(option_sequence_frames) + "frames";
+
+    run_file_benchmark(name, sequence, [](FileBenchmark& bench) {
+      bench.run_open();
+      for (int threads : option_threads) {
+        bench.run_sequence(threads);
+      }
+    });
+  }
+
+  run_speed_class_calibration(format);
+}
+
+
+static heif_compression_format parse_format(const std::string& name)
+{
+  if (name == "unci") return heif_compression_uncompressed;
+  if (name == "hevc") return heif_compression_HEVC;
+  if (name == "av1") return heif_compression_AV1;
+  if (name == "jpeg") return heif_compression_JPEG;
+  if (name == "j2k") return heif_compression_JPEG2000;
+
+  std::cerr << "Unknown encoder format: " << name << "\n";
+  exit(5);
+}
+
+
+// --- trace output
+
+// Collects the libheif trace events and writes them as Chrome JSON trace ("complete" events).
+class ChromeTraceSink
+{
+public:
+  heif_error install()
+  {
+    heif_trace_sink sink;
+    sink.version = 1;
+    sink.trace_event = [](const heif_trace_event* event, void* user_data) {
+      static_cast<ChromeTraceSink*>(user_data)->add(*event);
+    };
+
+    return heif_set_trace_sink(&sink, this);
+  }
+
+  void write(std::ostream& ostr) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ostr << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < m_events.size(); i++) {
+      const Event& e = m_events[i];
+      ostr << "{\"name\":\"" << json_escape(e.name) << "\",\"cat\":\"" << json_escape(e.category) << "\","
+           << "\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread_id << ","
+           << "\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us;
+      if (e.item_id) {
+        ostr << ",\"args\":{\"item\":" << e.item_id << "}";
+      }
+      ostr << "}" << (i + 1 < m_events.size() ? ",\n" : "\n");
+    }
+    ostr << "],\"displayTimeUnit\":\"ms\"}\n";
+  }
+
+private:
+  struct Event
+  {
+    const char* category;
+    const char* name;
+    uint32_t item_id;
+    uint32_t thread_id;
+    uint64_t start_us;
+    uint64_t duration_us;
+  };
+
+  void add(const heif_trace_event& event)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_events.push_back({event.category, event.name, event.item_id, event.thread_id, event.start_us, event.duration_us});
+  }
+
+  mutable std::mutex m_mutex;
+  std::vector<Event> m_events;
+};
+
+
+int main(int argc, char** argv)
+{
+  heif_init(nullptr);
+
+  while (true) {
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "n:t:s:T:V:F:e:f:o:J:Nhv", long_options, &option_index);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'n':
+        option_iterations = std::max(1, atoi(optarg));
+        break;
+      case 't':
+        option_threads = parse_int_list(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%ux%u", &option_width, &option_height) != 2 || option_width == 0 || option_height == 0) {
+          std::cerr << "Invalid size, use the format WxH\n";
+          return 5;
+        }
+        break;
+      case 'T':
+        option_tile_size = std::max(16, atoi(optarg));
+        break;
+      case 'V':
+        option_viewport_size = std::max(1, atoi(optarg));
+        break;
+      case 'F':
+        option_sequence_frames = std::max(1, atoi(optarg));
+        break;
+      case 'e':
+        option_format = parse_format(optarg);
+        break;
+      case 'f':
+        option_filter = optarg;
+        break;
+      case 'o':
+        option_output = optarg;
+        break;
+      case 'J':
+        option_trace = optarg;
+        break;
+      case 'N':
+        option_synthetic = false;
+        break;
+      case 'h':
+        show_help(argv[0]);
+        heif_deinit();
+        return 0;
+      case 'v':
+        show_version();
+        heif_deinit();
+        return 0;
+      default:
+        show_help(argv[0]);
+        heif_deinit();
+        return 5;
+    }
+  }
+
+  ChromeTraceSink trace_sink;
+  if (!option_trace.empty()) {
+    heif_error err = trace_sink.install();
+    if (err.code) {
+      std::cerr << "cannot enable tracing: " << err.message << "\n";
+      heif_deinit();
+      return 1;
+    }
+  }
+
+  if (option_synthetic) {
+    run_synthetic_benchmarks();
+  }
+
+  for (int i = optind; i < argc; i++) {
+    std::ifstream istr(argv[i], std::ios::binary);
+    if (!istr) {
+      std::cerr << "cannot read " << argv[i] << "\n";
+      heif_deinit();
+      return 1;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+
+    run_file_benchmark(argv[i], data, [](FileBenchmark& bench) {
+      bench.run_all();
+    });
+  }
+
+  if (!option_output.empty()) {
+    std::ofstream ostr(option_output);
+    if (!ostr) {
+      std::cerr << "cannot write " << option_output << "\n";
+      heif_deinit();
+      return 1;
+    }
+    write_results(ostr);
+  }
+  else {
+    write_results(std::cout);
+  }
+
+  if (!option_trace.empty()) {
+    heif_set_trace_sink(nullptr, nullptr);
+
+    std::ofstream ostr(option_trace);
+    if (!ostr) {
+      std::cerr << "cannot write " << option_trace << "\n";
+      heif_deinit();
+      return 1;
+    }
+    trace_sink.write(ostr);
+  }
+
+  heif_deinit();
+
+  return 0;
+}
@@ -47,6 +47,14 @@
 #include <vector>
 #include <array>
 #include <cctype>
+#include <functional>
+#include <memory>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <atomic>
+#include <mutex>
+#include <thread>
+#endif
 
 #include <libheif/heif.h>
 #include <libheif/heif_tai_timestamps.h>
@@ -105,6 +113,10 @@ static void show_help(const char* argv0)
                "      --no-colons                replace ':' characters in auxiliary image filenames with '_'\n"
                "      --list-decoders            list all available decoders (built-in and plugins)\n"
                "      --tiles                    output all image tiles as separate images\n"
+               "  -j, --jobs N                   decode and write N images or tiles in parallel (0 = number of CPU cores)\n"
+               "      --batch FILE               decode all 'input output [quality=N]' lines of FILE ('-' reads them from stdin).\n"
+               "                                 All other options apply to all files. For each line, 'ok<TAB>output' or\n"
+               "                                 'error<TAB>output<TAB>code' is written to stdout.\n"
                "      --quiet                    do not output status messages to console\n"
                "  -S, --sequence                 decode image sequence instead of still image\n"
                "  -C, --chroma-upsampling ALGO   Force chroma upsampling algorithm (nn = nearest-neighbor / bilinear)\n"
@@ -140,11 +152,14 @@ int option_png_compression_level = -1; // use zlib default
 int option_output_tiles = 0;
 int option_disable_limits = 0;
 int option_sequence = 0;
+int option_jobs = 1;
 std::string output_filename;
+std::string batch_manifest;
 
 std::string chroma_upsampling;
 
 #define OPTION_PNG_COMPRESSION_LEVEL 1000
+#define OPTION_BATCH 1001
 
 
 static struct option long_options[] = {
@@ -166,6 +181,8 @@ static struct option long_options[] = {
     {(char* const) "png-compression-level", required_argument, 0,  OPTION_PNG_COMPRESSION_LEVEL},
     {(char* const) "version",          no_argument,       0,                        'v'},
     {(char* const) "disable-limits", no_argument, &option_disable_limits, 1},
+    {(char* const) "jobs",             required_argument, 0,                        'j'},
+    {(char* const) "batch",            required_argument, 0,                        OPTION_BATCH},
     {nullptr, no_argument, nullptr, 0}
 };
 
@@ -192,6 +209,21 @@ bool is_integer_string(const char* s)
 }
 
 
+#if ENABLE_MULTITHREADING_SUPPORT
+static std::mutex console_mutex;
+#endif
+
+// Writes one line of console output. With --jobs, lines of parallel jobs are not mixed.
+static void print_line(std::ostream& ostr, const std::string& text)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(console_mutex);
+#endif
+
+  ostr << text << "\n";
+}
+
+
 void show_png_compression_level_usage_warning()
 {
   fprintf(stderr, "Invalid PNG compression level. Has to be between 0 (fastest) and 9 (best).\n"
@@ -199,11 +231,49 @@ void show_png_compression_level_usage_warning()
 }
 
 
+// Whether the JPEG output file would only contain data that is already in the JPEG bitstream of the image,
+// such that the bitstream can be written without decoding and re-encoding the image.
+static bool can_copy_jpeg_bitstream(const heif_image_handle* handle, const heif_decoding_options* decode_options)
+{
+  heif_color_profile_type profile_type = heif_image_handle_get_color_profile_type(handle);
+
+  return !decode_options->ignore_transformations &&
+         !heif_image_handle_has_alpha_channel(handle) &&
+         heif_image_handle_get_luma_bits_per_pixel(handle) == 8 &&
+         profile_type != heif_color_profile_type_prof &&
+         profile_type != heif_color_profile_type_rICC &&
+         heif_image_handle_get_number_of_metadata_blocks(handle, nullptr) == 0 &&
+         !option_aux && !option_with_xmp && !option_with_exif;
+}
+
+
+// Returns whether the JPEG bitstream was written. When the image cannot be written this way, nothing is written.
+static bool write_jpeg_bitstream(const heif_image_handle* handle, const std::string& filename, bool& out_write_failed)
+{
+  out_write_failed = false;
+
+  uint8_t* data = nullptr;
+  size_t size = 0;
+  heif_error err = heif_image_handle_get_jpeg_bitstream(handle, &data, &size);
+  if (err.code) {
+    return false;
+  }
+
+  std::ofstream ostr(filename.c_str(), std::ios::binary);
+  ostr.write((const char*) data, (std::streamsize) size);
+  heif_release_bitstream_data(&data);
+
+  out_write_failed = !ostr;
+  return true;
+}
+
+
 int decode_single_image(heif_image_handle* handle,
                         std::string filename_stem,
                         std::string filename_suffix,
                         heif_decoding_options* decode_options,
-                        std::unique_ptr<Encoder>& encoder)
+                        std::unique_ptr<Encoder>& encoder,
+                        bool copy_jpeg_bitstream)
 {
   int bit_depth = heif_image_handle_get_luma_bits_per_pixel(handle);
   if (bit_depth < 0) {
@@ -211,18 +281,69 @@ int decode_single_image(heif_image_handle* handle,
     return 1;
   }
 
+  // --- JPEG images are written without transcoding when possible
+
+  if (copy_jpeg_bitstream && can_copy_jpeg_bitstream(handle, decode_options)) {
+    std::string filename = filename_stem + '.' + filename_suffix;
+
+    bool write_failed;
+    if (write_jpeg_bitstream(handle, filename, write_failed)) {
+      if (write_failed) {
+        fprintf(stderr, "could not write image\n");
+      }
+      else if (!option_quiet) {
+        print_line(std::cout, "Written to " + filename);
+      }
+
+      return 0;
+    }
+  }
+
   int has_alpha = heif_image_handle_has_alpha_channel(handle);
 
-  struct heif_image* image;
   struct heif_error err;
-  err = heif_decode_image(handle,
-                          &image,
-                          encoder->colorspace(has_alpha),
-                          encoder->chroma(has_alpha, bit_depth),
-                          decode_options);
-  if (err.code) {
-    std::cerr << "Could not decode image: "
-              << err.message << "\n";
+
+  // --- get the depth image, which is decoded in parallel to the main image
+
+  struct heif_image_handle* depth_handle = nullptr;
+
+  if (option_aux && heif_image_handle_has_depth_image(handle)) {
+    heif_item_id depth_id;
+    int nDepthImages = heif_image_handle_get_list_of_depth_image_IDs(handle, &depth_id, 1);
+    assert(nDepthImages == 1);
+    (void) nDepthImages;
+
+    err = heif_image_handle_get_depth_image_handle(handle, depth_id, &depth_handle);
+    if (err.code) {
+      std::cerr << "Could not read depth channel\n";
+      return 1;
+    }
+  }
+
+  std::vector<const heif_image_handle*> handles{handle};
+  std::vector<heif_colorspace> colorspaces{encoder->colorspace(has_alpha)};
+  std::vector<heif_chroma> chromas{encoder->chroma(has_alpha, bit_depth)};
+
+  if (depth_handle) {
+    int depth_bit_depth = heif_image_handle_get_luma_bits_per_pixel(depth_handle);
+
+    handles.push_back(depth_handle);
+    colorspaces.push_back(encoder->colorspace(false));
+    chromas.push_back(encoder->chroma(false, depth_bit_depth));
+  }
+
+  std::vector<heif_image*> images(handles.size());
+  std::vector<heif_error> errors(handles.size());
+  heif_decode_images(handles.data(), (int) handles.size(), colorspaces.data(), chromas.data(),
+                     decode_options, images.data(), errors.data());
+
+  struct heif_image* image = images[0];
+  struct heif_image* depth_image = depth_handle ? images[1] : nullptr;
+
+  if (errors[0].code) {
+    heif_image_release(depth_image);
+    heif_image_handle_release(depth_handle);
+    print_line(std::cerr, std::string("Could not decode image: ") + errors[0].message);
     return 1;
   }
 
@@ -234,7 +355,7 @@ int decode_single_image(heif_image_handle* handle,
       break;
     }
 
-    std::cerr << "Warning: " << err.message << "\n";
+    print_line(std::cerr, std::string("Warning: ") + err.message);
   }
 
   if (image) {
@@ -246,59 +367,36 @@ int decode_single_image(heif_image_handle* handle,
     }
     else {
       if (!option_quiet) {
-        std::cout << "Written to " << filename << "\n";
+        print_line(std::cout, "Written to " + filename);
       }
     }
     heif_image_release(image);
 
 
-    if (option_aux) {
-      int has_depth = heif_image_handle_has_depth_image(handle);
-      if (has_depth) {
-        heif_item_id depth_id;
-        int nDepthImages = heif_image_handle_get_list_of_depth_image_IDs(handle, &depth_id, 1);
-        assert(nDepthImages == 1);
-        (void) nDepthImages;
-
-        struct heif_image_handle* depth_handle = nullptr;
-        err = heif_image_handle_get_depth_image_handle(handle, depth_id, &depth_handle);
-        if (err.code) {
-          std::cerr << "Could not read depth channel\n";
-          return 1;
-        }
-
-        int depth_bit_depth = heif_image_handle_get_luma_bits_per_pixel(depth_handle);
-
-        struct heif_image* depth_image;
-        err = heif_decode_image(depth_handle,
-                                &depth_image,
-                                encoder->colorspace(false),
-                                encoder->chroma(false, depth_bit_depth),
-                                nullptr);
-        if (err.code) {
-          heif_image_handle_release(depth_handle);
-          std::cerr << "Could not decode depth image: " << err.message << "\n";
-          return 1;
-        }
+    if (depth_handle) {
+      if (errors[1].code) {
+        heif_image_handle_release(depth_handle);
+        std::cerr << "Could not decode depth image: " << errors[1].message << "\n";
+        return 1;
+      }
 
-        std::ostringstream s;
-        s << filename_stem;
-        s << "-depth.";
-        s << filename_suffix;
+      std::ostringstream s;
+      s << filename_stem;
+      s << "-depth.";
+      s << filename_suffix;
 
-        written = encoder->Encode(depth_handle, depth_image, s.str());
-        if (!written) {
-          fprintf(stderr, "could not write depth image\n");
-        }
-        else {
-          if (!option_quiet) {
-            std::cout << "Depth image written to " << s.str() << "\n";
-          }
+      written = encoder->Encode(depth_handle, depth_image, s.str());
+      if (!written) {
+        fprintf(stderr, "could not write depth image\n");
+      }
+      else {
+        if (!option_quiet) {
+          print_line(std::cout, "Depth image written to " + s.str());
         }
-
-        heif_image_release(depth_image);
-        heif_image_handle_release(depth_handle);
       }
+
+      heif_image_release(depth_image);
+      heif_image_handle_release(depth_handle);
     }
 
 
@@ -366,7 +464,7 @@ int decode_single_image(heif_image_handle* handle,
           }
           else {
             if (!option_quiet) {
-              std::cout << "Auxiliary image written to " << auxFilename << "\n";
+              print_line(std::cout, "Auxiliary image written to " + auxFilename);
             }
           }
 
@@ -464,20 +562,14 @@ int digits_for_integer(uint32_t v)
 }
 
 
-int decode_image_tiles(heif_image_handle* handle,
-                       std::string filename_stem,
-                       std::string filename_suffix,
-                       heif_decoding_options* decode_options,
-                       std::unique_ptr<Encoder>& encoder)
+int decode_image_tile(heif_image_handle* handle,
+                      const heif_image_tiling& tiling,
+                      uint32_t tx, uint32_t ty,
+                      const std::string& filename_stem,
+                      const std::string& filename_suffix,
+                      heif_decoding_options* decode_options,
+                      std::unique_ptr<Encoder>& encoder)
 {
-  heif_image_tiling tiling;
-
-  heif_image_handle_get_image_tiling(handle, !decode_options->ignore_transformations, &tiling);
-  if (tiling.num_columns == 1 && tiling.num_rows == 1) {
-    return decode_single_image(handle, filename_stem, filename_suffix, decode_options, encoder);
-  }
-
-
   int bit_depth = heif_image_handle_get_luma_bits_per_pixel(handle);
   if (bit_depth < 0) {
     std::cerr << "Input image has undefined bit-depth\n";
@@ -489,56 +581,121 @@ int decode_image_tiles(heif_image_handle* handle,
   int digits_tx = digits_for_integer(tiling.num_columns-1);
   int digits_ty = digits_for_integer(tiling.num_rows-1);
 
-  for (uint32_t ty = 0; ty < tiling.num_rows; ty++)
-    for (uint32_t tx = 0; tx < tiling.num_columns; tx++) {
-      struct heif_image* image;
-      struct heif_error err;
-      err = heif_image_handle_decode_image_tile(handle,
-                                                &image,
-                                                encoder->colorspace(has_alpha),
-                                                encoder->chroma(has_alpha, bit_depth),
-                                                decode_options, tx, ty);
-      if (err.code) {
-        std::cerr << "Could not decode image tile: "
-                  << err.message << "\n";
-        return 1;
+  struct heif_image* image;
+  struct heif_error err;
+  err = heif_image_handle_decode_image_tile(handle,
+                                            &image,
+                                            encoder->colorspace(has_alpha),
+                                            encoder->chroma(has_alpha, bit_depth),
+                                            decode_options, tx, ty);
+  if (err.code) {
+    print_line(std::cerr, std::string("Could not decode image tile: ") + err.message);
+    return 1;
+  }
+
+  // show decoding warnings
+
+  for (int i = 0;; i++) {
+    int n = heif_image_get_decoding_warnings(image, i, &err, 1);
+    if (n == 0) {
+      break;
+    }
+
+    print_line(std::cerr, std::string("Warning: ") + err.message);
+  }
+
+  if (image) {
+    std::stringstream filename_str;
+    filename_str << filename_stem << "-"
+                 << std::setfill('0') << std::setw(digits_ty) << ty << '-'
+                 << std::setfill('0') << std::setw(digits_tx) << tx << "." << filename_suffix;
+
+    std::string filename = filename_str.str();
+
+    bool written = encoder->Encode(handle, image, filename);
+    if (!written) {
+      fprintf(stderr, "could not write image\n");
+    }
+    else {
+      if (!option_quiet) {
+        print_line(std::cout, "Written to " + filename);
       }
+    }
+    heif_image_release(image);
+  }
+
+  return 0;
+}
 
-      // show decoding warnings
 
-      for (int i = 0;; i++) {
-        int n = heif_image_get_decoding_warnings(image, i, &err, 1);
-        if (n == 0) {
+// Runs the jobs in order and stops at the first failing job.
+// With more than one thread, the jobs are distributed over the threads. Each thread decodes and writes
+// its own image, such that decoding one image overlaps with writing another one. Jobs that have not
+// been started when a job fails are skipped.
+// Returns the result of the first failed job (in job order), or 0.
+static int run_jobs(const std::vector<std::function<int()>>& jobs, int num_threads)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (num_threads > 1 && jobs.size() > 1) {
+    std::vector<int> results(jobs.size(), 0);
+    std::atomic<size_t> next_job{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+      while (!failed) {
+        size_t i = next_job++;
+        if (i >= jobs.size()) {
           break;
         }
 
-        std::cerr << "Warning: " << err.message << "\n";
+        results[i] = jobs[i]();
+        if (results[i]) {
+          failed = true;
+        }
       }
+    };
 
-      if (image) {
-        std::stringstream filename_str;
-        filename_str << filename_stem << "-"
-                     << std::setfill('0') << std::setw(digits_ty) << ty << '-'
-                     << std::setfill('0') << std::setw(digits_tx) << tx << "." << filename_suffix;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads && (size_t) t < jobs.size(); t++) {
+      threads.emplace_back(worker);
+    }
 
-        std::string filename = filename_str.str();
+    for (auto& thread : threads) {
+      thread.join();
+    }
 
-        bool written = encoder->Encode(handle, image, filename);
-        if (!written) {
-          fprintf(stderr, "could not write image\n");
-        }
-        else {
-          if (!option_quiet) {
-            std::cout << "Written to " << filename << "\n";
-          }
-        }
-        heif_image_release(image);
+    for (int result : results) {
+      if (result) {
+        return result;
       }
     }
 
+    return 0;
+  }
+#endif
+
+  for (const auto& job : jobs) {
+    if (int ret = job()) {
+      return ret;
+    }
+  }
+
   return 0;
 }
 
+
+// Number of codec threads for each of 'num_jobs' parallel decoding jobs.
+static int codec_threads_per_job(int num_jobs)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  int num_cores = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+  return std::max(1, num_cores / num_jobs);
+#else
+  return 1;
+#endif
+}
+
+
 static int max_value_progress = 0;
 
 void start_progress(enum heif_progress_step step, int max_progress, void* progress_user_data)
@@ -565,117 +722,23 @@ public:
 };
 
 
-int main(int argc, char** argv)
+// Decodes all images of 'input_filename' into 'output_file' (numbered when there are several images).
+// Returns 0 or the program exit code.
+static int decode_file(const std::string& input_filename, const std::string& output_file,
+                       int quality, bool strict_decoding, const char* decoder_id)
 {
-  // This takes care of initializing libheif and also deinitializing it at the end to free all resources.
-  LibHeifInitializer initializer;
-
-  int quality = -1;  // Use default quality.
-  bool strict_decoding = false;
-  const char* decoder_id = nullptr;
-
-  UNUSED(quality);  // The quality will only be used by encoders that support it.
-  //while ((opt = getopt(argc, argv, "q:s")) != -1) {
-  while (true) {
-    int option_index = 0;
-    int c = getopt_long(argc, argv, "hq:sd:C:vo:S", long_options, &option_index);
-    if (c == -1) {
-      break;
-    }
-
-    switch (c) {
-      case 'q':
-        quality = atoi(optarg);
-        break;
-      case 'd':
-        decoder_id = optarg;
-        break;
-      case 's':
-        strict_decoding = true;
-        break;
-      case '?':
-        std::cerr << "\n";
-        [[fallthrough]];
-      case 'h':
-        show_help(argv[0]);
-        return 0;
-      case 'C':
-        chroma_upsampling = optarg;
-        if (chroma_upsampling != "nn" &&
-            chroma_upsampling != "nearest-neighbor" &&
-            chroma_upsampling != "bilinear") {
-          fprintf(stderr, "Undefined chroma upsampling algorithm.\n");
-          exit(5);
-        }
-        if (chroma_upsampling == "nn") { // abbreviation
-          chroma_upsampling = "nearest-neighbor";
-        }
-        break;
-      case OPTION_PNG_COMPRESSION_LEVEL:
-        if (!is_integer_string(optarg)) {
-          show_png_compression_level_usage_warning();
-          exit(5);
-        }
-        option_png_compression_level = std::stoi(optarg);
-        if (option_png_compression_level < -1 || option_png_compression_level > 9) {
-          show_png_compression_level_usage_warning();
-          exit(5);
-        }
-        break;
-      case 'v':
-        show_version();
-        return 0;
-      case 'o':
-        output_filename = optarg;
-        break;
-      case 'S':
-        option_sequence = 1;
-        break;
-    }
-  }
-
-  if (option_list_decoders) {
-    list_all_decoders();
-    return 0;
-  }
-
-  if (optind >= argc || optind + 2 < argc) {
-    // Need at least input filename as additional argument, but not more as two filenames.
-    show_help(argv[0]);
-    return 5;
-  }
-
-  std::string input_filename(argv[optind++]);
   std::string output_filename_stem;
   std::string output_filename_suffix;
 
-  if (output_filename.empty()) {
-    if (optind == argc) {
-      std::string input_stem;
-      size_t dot_pos = input_filename.rfind('.');
-      if (dot_pos != std::string::npos) {
-        input_stem = input_filename.substr(0, dot_pos);
-      }
-      else {
-        input_stem = input_filename;
-      }
-
-      output_filename = input_stem + ".jpg";
-    }
-    else if (optind == argc-1) {
-      output_filename = argv[optind];
-    }
-    else {
-      assert(false);
-    }
-  }
-
   std::unique_ptr<Encoder> encoder;
 
-  size_t dot_pos = output_filename.rfind('.');
+  // JPEG images are only re-encoded for JPEG output when a quality was set.
+  bool copy_jpeg_bitstream = false;
+
+  size_t dot_pos = output_file.rfind('.');
   if (dot_pos != std::string::npos) {
-    output_filename_stem = output_filename.substr(0,dot_pos);
-    std::string suffix_lowercase = output_filename.substr(dot_pos + 1);
+    output_filename_stem = output_file.substr(0,dot_pos);
+    std::string suffix_lowercase = output_file.substr(dot_pos + 1);
 
     std::transform(suffix_lowercase.begin(), suffix_lowercase.end(),
                    suffix_lowercase.begin(), ::tolower);
@@ -687,6 +750,7 @@ int main(int argc, char** argv)
       static const int kDefaultJpegQuality = 90;
       if (quality == -1) {
         quality = kDefaultJpegQuality;
+        copy_jpeg_bitstream = true;
       }
       encoder.reset(new JpegEncoder(quality));
 #else
@@ -720,12 +784,12 @@ int main(int argc, char** argv)
     }
   }
   else {
-    output_filename_stem = output_filename;
+    output_filename_stem = output_file;
     output_filename_suffix = "jpg";
   }
 
   if (!encoder) {
-    fprintf(stderr, "Unknown file type in %s\n", output_filename.c_str());
+    fprintf(stderr, "Unknown file type in %s\n", output_file.c_str());
     return 1;
   }
 
@@ -905,42 +969,56 @@ int main(int argc, char** argv)
   num_images = heif_context_get_list_of_top_level_image_IDs(ctx, image_IDs.data(), num_images);
 
 
-  std::string filename;
-  size_t image_index = 1;  // Image filenames are "1" based.
+  // --- set up the decoding of all images
 
-  for (int idx = 0; idx < num_images; ++idx) {
+  // Everything needed to decode one top-level image. It is kept until all jobs are finished.
+  struct ImageToDecode
+  {
+    heif_image_handle* handle = nullptr;
+    std::unique_ptr<heif_decoding_options, void(*)(heif_decoding_options*)> decode_options{heif_decoding_options_alloc(), heif_decoding_options_free};
+    heif_color_conversion_options_ext* color_conversion_options_ext = nullptr;
+    std::string filename_stem;
+
+    ~ImageToDecode()
+    {
+      heif_color_conversion_options_ext_free(color_conversion_options_ext);
+      heif_image_handle_release(handle);
+    }
+  };
 
-    std::string numbered_output_filename_stem;
+  std::vector<std::unique_ptr<ImageToDecode>> images;
+  std::vector<std::function<int()>> jobs;
+  size_t max_image_bytes = 0;
+
+  for (int idx = 0; idx < num_images; ++idx) {
+    auto img = std::make_unique<ImageToDecode>();
 
     if (num_images > 1) {
       std::ostringstream s;
       s << output_filename_stem;
-      s << "-" << image_index;
-      numbered_output_filename_stem = s.str();
-
-      s << "." << output_filename_suffix;
-      filename = s.str();
+      s << "-" << idx + 1;  // Image filenames are "1" based.
+      img->filename_stem = s.str();
     }
     else {
-      filename = output_filename;
-      numbered_output_filename_stem = output_filename_stem;
+      img->filename_stem = output_filename_stem;
     }
 
-    struct heif_image_handle* handle;
-    err = heif_context_get_image_handle(ctx, image_IDs[idx], &handle);
+    err = heif_context_get_image_handle(ctx, image_IDs[idx], &img->handle);
     if (err.code) {
       std::cerr << "Could not read HEIF/AVIF image " << idx << ": "
                 << err.message << "\n";
       return 1;
     }
 
-    std::unique_ptr<heif_decoding_options, void(*)(heif_decoding_options*)> decode_options(heif_decoding_options_alloc(), heif_decoding_options_free);
-    encoder->UpdateDecodingOptions(handle, decode_options.get());
+    heif_image_handle* handle = img->handle;
+    heif_decoding_options* decode_options = img->decode_options.get();
+    encoder->UpdateDecodingOptions(handle, decode_options);
 
     decode_options->strict_decoding = strict_decoding;
     decode_options->decoder_id = decoder_id;
 
-    if (!option_quiet) {
+    // The progress output cannot show more than one image at a time.
+    if (!option_quiet && option_jobs == 1) {
       decode_options->start_progress = start_progress;
       decode_options->on_progress = on_progress;
       decode_options->end_progress = end_progress;
@@ -955,33 +1033,251 @@ int main(int argc, char** argv)
       decode_options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
     }
 
-    int ret;
-
-    auto* color_conversion_options_ext = heif_color_conversion_options_ext_alloc();
-    decode_options->color_conversion_options_ext = color_conversion_options_ext;
+    img->color_conversion_options_ext = heif_color_conversion_options_ext_alloc();
+    decode_options->color_conversion_options_ext = img->color_conversion_options_ext;
 
     if (!encoder->supports_alpha()) {
-      color_conversion_options_ext->alpha_composition_mode = heif_alpha_composition_mode_solid_color;
+      img->color_conversion_options_ext->alpha_composition_mode = heif_alpha_composition_mode_solid_color;
     }
 
+    const std::string& filename_stem = img->filename_stem;
+
+    heif_image_tiling tiling{};
     if (option_output_tiles) {
-      ret = decode_image_tiles(handle, numbered_output_filename_stem, output_filename_suffix, decode_options.get(), encoder);
+      heif_image_handle_get_image_tiling(handle, !decode_options->ignore_transformations, &tiling);
+    }
+
+    if (option_output_tiles && (tiling.num_columns > 1 || tiling.num_rows > 1)) {
+      // The workers decode different tiles at the same time. Each tile decoder only gets its share of the CPU cores,
+      // such that the codecs do not start more threads than there are cores. Since all tiles are decoded with
+      // the same configuration, the decoder instances are reused for the next tiles.
+      if (option_jobs > 1) {
+        decode_options->max_codec_threads = codec_threads_per_job(option_jobs);
+      }
+
+      for (uint32_t ty = 0; ty < tiling.num_rows; ty++)
+        for (uint32_t tx = 0; tx < tiling.num_columns; tx++) {
+          jobs.emplace_back([=, &encoder]() {
+            return decode_image_tile(handle, tiling, tx, ty, filename_stem, output_filename_suffix, decode_options, encoder);
+          });
+        }
+
+      max_image_bytes = std::max(max_image_bytes, (size_t) tiling.tile_width * tiling.tile_height * 8);
     }
     else {
-      ret = decode_single_image(handle, numbered_output_filename_stem, output_filename_suffix, decode_options.get(), encoder);
+      jobs.emplace_back([=, &encoder]() {
+        return decode_single_image(handle, filename_stem, output_filename_suffix, decode_options, encoder, copy_jpeg_bitstream);
+      });
+
+      max_image_bytes = std::max(max_image_bytes, (size_t) heif_image_handle_get_width(handle) * heif_image_handle_get_height(handle) * 8);
     }
 
-    heif_color_conversion_options_ext_free(color_conversion_options_ext);
+    images.emplace_back(std::move(img));
+  }
 
-    if (ret) {
-      heif_image_handle_release(handle);
-      return ret;
+  // When writing several images, keep the memory of decoded images for the next image decoded by the same job.
+  // The estimate of 8 bytes per pixel covers the decoded image and its color conversion.
+  if (jobs.size() > 1) {
+    heif_set_image_buffer_pool_size(std::min(jobs.size(), (size_t) option_jobs) * max_image_bytes);
+  }
+
+  if (int ret = run_jobs(jobs, option_jobs)) {
+    return ret;
+  }
+
+  return 0;
+}
+
+
+// Decodes all entries of a batch manifest (see read_batch_entry()) with the options of the command line.
+// The only per-entry option is 'quality=N'.
+// Returns 0 when all entries were decoded, or the exit code of the first failed entry.
+static int decode_batch(std::istream& manifest, int quality, bool strict_decoding, const char* decoder_id)
+{
+  // Only the results are written to stdout, all other output goes to stderr.
+  std::ostream results(std::cout.rdbuf());
+  std::streambuf* cout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  int batch_ret = 0;
+
+  BatchEntry entry;
+  while (read_batch_entry(manifest, entry)) {
+    int ret = 0;
+    int entry_quality = quality;
+
+    if (!entry.error.empty()) {
+      std::cerr << "Batch line " << entry.line_number << ": " << entry.error << "\n";
+      ret = 5;
+    }
+
+    for (const std::string& option : entry.options) {
+      if (ret) {
+        break;
+      }
+
+      if (option.rfind("quality=", 0) == 0 && is_integer_string(option.c_str() + 8)) {
+        entry_quality = std::stoi(option.substr(8));
+      }
+      else {
+        std::cerr << "Batch line " << entry.line_number << ": unknown option '" << option << "'\n";
+        ret = 5;
+      }
+    }
+
+    if (ret == 0) {
+      ret = decode_file(entry.input_filename, entry.output_filename, entry_quality, strict_decoding, decoder_id);
     }
 
-    heif_image_handle_release(handle);
+    report_batch_result(results, entry, ret);
 
-    image_index++;
+    if (ret && batch_ret == 0) {
+      batch_ret = ret;
+    }
   }
 
-  return 0;
+  std::cout.rdbuf(cout_buffer);
+
+  return batch_ret;
+}
+
+
+int main(int argc, char** argv)
+{
+  // This takes care of initializing libheif and also deinitializing it at the end to free all resources.
+  LibHeifInitializer initializer;
+
+  int quality = -1;  // Use default quality.
+  bool strict_decoding = false;
+  const char* decoder_id = nullptr;
+
+  UNUSED(quality);  // The quality will only be used by encoders that support it.
+  //while ((opt = getopt(argc, argv, "q:s")) != -1) {
+  while (true) {
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "hq:sd:C:vo:Sj:", long_options, &option_index);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'q':
+        quality = atoi(optarg);
+        break;
+      case 'd':
+        decoder_id = optarg;
+        break;
+      case 's':
+        strict_decoding = true;
+        break;
+      case '?':
+        std::cerr << "\n";
+        [[fallthrough]];
+      case 'h':
+        show_help(argv[0]);
+        return 0;
+      case 'C':
+        chroma_upsampling = optarg;
+        if (chroma_upsampling != "nn" &&
+            chroma_upsampling != "nearest-neighbor" &&
+            chroma_upsampling != "bilinear") {
+          fprintf(stderr, "Undefined chroma upsampling algorithm.\n");
+          exit(5);
+        }
+        if (chroma_upsampling == "nn") { // abbreviation
+          chroma_upsampling = "nearest-neighbor";
+        }
+        break;
+      case OPTION_PNG_COMPRESSION_LEVEL:
+        if (!is_integer_string(optarg)) {
+          show_png_compression_level_usage_warning();
+          exit(5);
+        }
+        option_png_compression_level = std::stoi(optarg);
+        if (option_png_compression_level < -1 || option_png_compression_level > 9) {
+          show_png_compression_level_usage_warning();
+          exit(5);
+        }
+        break;
+      case 'v':
+        show_version();
+        return 0;
+      case 'o':
+        output_filename = optarg;
+        break;
+      case 'S':
+        option_sequence = 1;
+        break;
+      case 'j':
+        if (!is_integer_string(optarg) || std::stoi(optarg) < 0) {
+          std::cerr << "The number of jobs has to be a non-negative integer.\n";
+          exit(5);
+        }
+        option_jobs = std::stoi(optarg);
+        break;
+      case OPTION_BATCH:
+        batch_manifest = optarg;
+        break;
+    }
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (option_jobs == 0) {
+    option_jobs = std::max(1U, std::thread::hardware_concurrency());
+  }
+#else
+  if (option_jobs != 1) {
+    std::cerr << "Warning: parallel decoding has not been compiled in, --jobs is ignored.\n";
+  }
+  option_jobs = 1;
+#endif
+
+  if (option_list_decoders) {
+    list_all_decoders();
+    return 0;
+  }
+
+  if (!batch_manifest.empty()) {
+    if (batch_manifest == "-") {
+      return decode_batch(std::cin, quality, strict_decoding, decoder_id);
+    }
+
+    std::ifstream manifest(batch_manifest);
+    if (!manifest) {
+      std::cerr << "Cannot open batch manifest '" << batch_manifest << "'\n";
+      return 5;
+    }
+
+    return decode_batch(manifest, quality, strict_decoding, decoder_id);
+  }
+
+  if (optind >= argc || optind + 2 < argc) {
+    // Need at least input filename as additional argument, but not more as two filenames.
+    show_help(argv[0]);
+    return 5;
+  }
+
+  std::string input_filename(argv[optind++]);
+
+  if (output_filename.empty()) {
+    if (optind == argc) {
+      std::string input_stem;
+      size_t dot_pos = input_filename.rfind('.');
+      if (dot_pos != std::string::npos) {
+        input_stem = input_filename.substr(0, dot_pos);
+      }
+      else {
+        input_stem = input_filename;
+      }
+
+      output_filename = input_stem + ".jpg";
+    }
+    else if (optind == argc-1) {
+      output_filename = argv[optind];
+    }
+    else {
+      assert(false);
+    }
+  }
+
+  return decode_file(input_filename, output_filename, quality, strict_decoding, decoder_id);
 }
@@ -40,6 +40,14 @@
 #include <filesystem>
 #include <regex>
 #include <optional>
+#include <map>
+#include <deque>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 #include <libheif/heif.h>
 #include <libheif/heif_properties.h>
@@ -74,6 +82,8 @@ int tiled_image_height = 0;
 std::string tiling_method = "grid";
 heif_unci_compression unci_compression = heif_unci_compression_brotli;
 int add_pyramid_group = 0;
+int pyramid_tile_size = 0;
+long long target_size = 0;
 
 uint16_t nclx_colour_primaries = 1;
 uint16_t nclx_transfer_characteristic = 13;
@@ -83,6 +93,11 @@ int nclx_full_range = true;
 // default to 30 fps
 uint32_t sequence_timebase = 30;
 uint32_t sequence_durations = 1;
+bool sequence_timing_specified = false;
+heif_sequence_gop_structure sequence_gop_structure = heif_sequence_gop_structure_intra_only;
+int sequence_keyframe_distance_min = 0;
+int sequence_keyframe_distance_max = 0;
+int sequence_parallel_frames = 0;
 std::string vmt_metadata_file;
 
 int quality = 50;
@@ -103,6 +118,8 @@ bool encode_sequence = false;
 
 std::string property_pitm_description;
 
+std::string batch_manifest;
+
 // for benchmarking
 
 #if !defined(_MSC_VER)
@@ -135,12 +152,20 @@ const int OPTION_SEQUENCES_TIMEBASE = 1016;
 const int OPTION_SEQUENCES_DURATIONS = 1017;
 const int OPTION_SEQUENCES_FPS = 1018;
 const int OPTION_VMT_METADATA_FILE = 1019;
+const int OPTION_BATCH = 1020;
+const int OPTION_SEQUENCES_GOP_STRUCTURE = 1021;
+const int OPTION_SEQUENCES_MIN_KEYFRAME_DISTANCE = 1022;
+const int OPTION_SEQUENCES_MAX_KEYFRAME_DISTANCE = 1023;
+const int OPTION_SEQUENCES_PARALLEL_FRAMES = 1024;
+const int OPTION_PYRAMID = 1025;
+const int OPTION_TARGET_SIZE = 1026;
 
 
 static struct option long_options[] = {
     {(char* const) "help",                    no_argument,       0,              'h'},
     {(char* const) "version",                 no_argument,       0,              'v'},
     {(char* const) "quality",                 required_argument, 0,              'q'},
+    {(char* const) "target-size",             required_argument, nullptr,        OPTION_TARGET_SIZE},
     {(char* const) "output",                  required_argument, 0,              'o'},
     {(char* const) "lossless",                no_argument,       0,              'L'},
     {(char* const) "thumb",                   required_argument, 0,              't'},
@@ -183,9 +208,15 @@ static struct option long_options[] = {
     {(char* const) "timebase",                    required_argument,       nullptr, OPTION_SEQUENCES_TIMEBASE},
     {(char* const) "duration",                    required_argument,       nullptr, OPTION_SEQUENCES_DURATIONS},
     {(char* const) "fps",                         required_argument,       nullptr, OPTION_SEQUENCES_FPS},
+    {(char* const) "gop-structure",               required_argument,       nullptr, OPTION_SEQUENCES_GOP_STRUCTURE},
+    {(char* const) "min-keyframe-distance",       required_argument,       nullptr, OPTION_SEQUENCES_MIN_KEYFRAME_DISTANCE},
+    {(char* const) "max-keyframe-distance",       required_argument,       nullptr, OPTION_SEQUENCES_MAX_KEYFRAME_DISTANCE},
+    {(char* const) "parallel-frames",             required_argument,       nullptr, OPTION_SEQUENCES_PARALLEL_FRAMES},
 #if HEIF_ENABLE_EXPERIMENTAL_FEATURES
     {(char* const) "vmt-metadata",                required_argument,       nullptr, OPTION_VMT_METADATA_FILE},
+    {(char* const) "pyramid",                     required_argument,       nullptr, OPTION_PYRAMID},
 #endif
+    {(char* const) "batch",                       required_argument,       nullptr, OPTION_BATCH},
     {0, 0,                                                           0,  0}
 };
 
@@ -215,6 +246,7 @@ void show_help(const char* argv0)
             << "  -h, --help        show help\n"
             << "  -v, --version     show version\n"
             << "  -q, --quality     set output quality (0-100) for lossy compression\n"
+            << "  --target-size BYTES   choose the highest quality at which the coded image is not larger than BYTES\n"
             << "  -L, --lossless    generate lossless output (-q has no effect). Image will be encoded as RGB (matrix_coefficients=0).\n"
             << "  -t, --thumb #     generate thumbnail with maximum size # (default: off)\n"
             << "      --no-alpha    do not save alpha channel\n"
@@ -231,7 +263,8 @@ void show_help(const char* argv0)
             << "      --htj2k           encode as High Throughput JPEG 2000 (experimental)\n"
 #if WITH_UNCOMPRESSED_CODEC
             << "  -U, --uncompressed             encode as uncompressed image (according to ISO 23001-17) (EXPERIMENTAL)\n"
-            << "      --unci-compression METHOD  choose one of these methods: none, deflate, zlib, brotli.\n"
+            << "      --unci-compression METHOD  choose one of these methods: none, deflate, zlib, brotli, zstd,\n"
+            << "                                 auto (try all methods, select the smallest).\n"
 #endif
             << "      --list-encoders         list all available encoders for all compression formats\n"
             << "  -e, --encoder ID            select encoder to use (the IDs can be listed with --list-encoders)\n"
@@ -247,8 +280,13 @@ void show_help(const char* argv0)
 #endif
             << "  -C,--chroma-downsampling ALGO   force chroma downsampling algorithm (nn = nearest-neighbor / average / sharp-yuv)\n"
             << "                                  (sharp-yuv makes edges look sharper when using YUV420 with bilinear chroma upsampling)\n"
-            << "  --benchmark               measure encoding time, PSNR, and output file size\n"
+            << "  --benchmark               measure encoding time, PSNR, SSIM, MS-SSIM, and output file size\n"
+            << "                            (and the time of the encoding and decoding stages)\n"
             << "  --pitm-description TEXT   (experimental) set user description for primary image\n"
+            << "  --batch FILE              encode all 'input output [NAME=VALUE...]' lines of FILE ('-' reads them from stdin).\n"
+            << "                            The NAME=VALUE options set additional encoder parameters for this file.\n"
+            << "                            All other options apply to all files. Encoders are reused between the files.\n"
+            << "                            For each line, 'ok<TAB>output' or 'error<TAB>output<TAB>code' is written to stdout.\n"
             << "\n"
             << "tiling:\n"
             << "  --cut-tiles #             cuts the input image into square tiles of the given width\n"
@@ -256,6 +294,8 @@ void show_help(const char* argv0)
             << "                            For example, 'tile-01-05.jpg' would be a valid input filename.\n"
             << "                            You only have to provide the filename of one tile as input, heif-enc will scan the directory\n"
             << "                            for the other tiles and determine the range of tiles automatically.\n"
+            << "                            The tiles are loaded one after another and the encoded data is written directly to the\n"
+            << "                            output file. Thus, only a few tiles are held in memory.\n"
             << "  --tiled-image-width #     override image width of tiled image\n"
             << "  --tiled-image-height #    override image height of tiled image\n"
             << "  --tiled-input-x-y         usually, the first number in the input tile filename should be the y position.\n"
@@ -263,12 +303,19 @@ void show_help(const char* argv0)
 #if HEIF_ENABLE_EXPERIMENTAL_FEATURES
             << "  --tiling-method METHOD    choose one of these methods: grid, tili, unci. The default is 'grid'.\n"
             << "  --add-pyramid-group       when several images are given, put them into a multi-resolution pyramid group.\n"
+            << "  --pyramid #               encode each image as a multi-resolution pyramid with downscaled layers that are\n"
+            << "                            generated automatically. The layers are cut into square tiles of the given width.\n"
             << "\n"
             << "sequences:\n"
-            << "  -S, --sequence            encode input images as sequence (input filenames with a number will pull in all files with this pattern).\n"
-            << "      --timebase #          set clock ticks/second for sequence\n"
+            << "  -S, --sequence            encode input images as sequence (input filenames with a number will pull in all files with this pattern,\n"
+            << "                            a single Y4M file is encoded frame by frame).\n"
+            << "      --timebase #          set clock ticks/second for sequence (default: 30, or the frame rate of a Y4M input)\n"
             << "      --duration #          set frame duration (default: 1)\n"
             << "      --fps #               set timebase and duration based on fps\n"
+            << "      --gop-structure GOP   choose one of: intra, lowdelay, unrestricted (default: intra)\n"
+            << "      --min-keyframe-distance #  minimum number of frames between keyframes\n"
+            << "      --max-keyframe-distance #  maximum number of frames between keyframes\n"
+            << "      --parallel-frames #   number of frames encoded in parallel (only for frames coded independently, default: 1)\n"
 #endif
 #if HEIF_ENABLE_EXPERIMENTAL_FEATURES
             << "      --vmt-metadata FILE   encode metadata track from VMT file\n"
@@ -378,13 +425,14 @@ void list_encoder_parameters(heif_encoder* encoder)
 }
 
 
-void set_params(struct heif_encoder* encoder, const std::vector<std::string>& params)
+// Returns 0 or the program exit code.
+int set_params(struct heif_encoder* encoder, const std::vector<std::string>& params)
 {
   for (const std::string& p : params) {
     auto pos = p.find_first_of('=');
     if (pos == std::string::npos || pos == 0 || pos == p.size() - 1) {
       std::cerr << "Encoder parameter must be in the format 'name=value'\n";
-      exit(5);
+      return 5;
     }
 
     std::string name = p.substr(0, pos);
@@ -393,9 +441,11 @@ void set_params(struct heif_encoder* encoder, const std::vector<std::string>& pa
     struct heif_error error = heif_encoder_set_parameter(encoder, name.c_str(), value.c_str());
     if (error.code) {
       std::cerr << "Error: " << error.message << "\n";
-      exit(5);
+      return 5;
     }
   }
+
+  return 0;
 }
 
 
@@ -545,18 +595,26 @@ std::string suffix_for_compression_format(heif_compression_format format)
 }
 
 
+std::string suffix_lowercase(const std::string& filename)
+{
+  std::string suffix;
+  auto suffix_pos = filename.find_last_of('.');
+  if (suffix_pos != std::string::npos) {
+    suffix = filename.substr(suffix_pos + 1);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
+  }
+
+  return suffix;
+}
+
+
 InputImage load_image(const std::string& input_filename, int output_bit_depth)
 {
   InputImage input_image;
 
   // get file type from file name
 
-  std::string suffix;
-  auto suffix_pos = input_filename.find_last_of('.');
-  if (suffix_pos != std::string::npos) {
-    suffix = input_filename.substr(suffix_pos + 1);
-    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::tolower);
-  }
+  std::string suffix = suffix_lowercase(input_filename);
 
   enum
   {
@@ -576,28 +634,28 @@ InputImage load_image(const std::string& input_filename, int output_bit_depth)
     heif_error err = loadPNG(input_filename.c_str(), output_bit_depth, &input_image);
     if (err.code != heif_error_Ok) {
       std::cerr << "Can not load TIFF input_image: " << err.message << '\n';
-      exit(1);
+      return {};
     }
   }
   else if (filetype == Y4M) {
     heif_error err = loadY4M(input_filename.c_str(), &input_image);
     if (err.code != heif_error_Ok) {
       std::cerr << "Can not load TIFF input_image: " << err.message << '\n';
-      exit(1);
+      return {};
     }
   }
   else if (filetype == TIFF) {
     heif_error err = loadTIFF(input_filename.c_str(), &input_image);
     if (err.code != heif_error_Ok) {
       std::cerr << "Can not load TIFF input_image: " << err.message << '\n';
-      exit(1);
+      return {};
     }
   }
   else {
     heif_error err = loadJPEG(input_filename.c_str(), &input_image);
     if (err.code != heif_error_Ok) {
       std::cerr << "Can not load JPEG input_image: " << err.message << '\n';
-      exit(1);
+      return {};
     }
   }
 
@@ -812,12 +870,15 @@ std::shared_ptr<input_tiles_generator> determine_input_images_tiling(const std::
 class input_tiles_generator_cut_image : public input_tiles_generator
 {
 public:
-  input_tiles_generator_cut_image(const char* filename, int tile_size, int output_bit_depth)
+  // The tiles are cut from the already loaded input image. Loading it again would double the memory usage.
+  input_tiles_generator_cut_image(InputImage image, int tile_size)
   {
-    mImage = load_image(filename, output_bit_depth);
+    mImage = std::move(image);
 
-    mWidth = heif_image_get_width(mImage.image.get(), heif_channel_Y);
-    mHeight = heif_image_get_height(mImage.image.get(), heif_channel_Y);
+    if (mImage.image) {
+      mWidth = heif_image_get_primary_width(mImage.image.get());
+      mHeight = heif_image_get_primary_height(mImage.image.get());
+    }
 
     mTileSize = tile_size;
   }
@@ -827,13 +888,22 @@ public:
 
   InputImage get_image(uint32_t tx, uint32_t ty, int output_bit_depth) override
   {
+    uint32_t x0 = tx * mTileSize;
+    uint32_t y0 = ty * mTileSize;
+
+    // Tiles inside the image reference the input image without copying. Only the tiles at the right
+    // and bottom border have to be copied, since they are padded to the full tile size.
     heif_image* tileImage;
-    heif_error err = heif_image_extract_area(mImage.image.get(), tx * mTileSize, ty * mTileSize, mTileSize, mTileSize,
-                                             heif_get_global_security_limits(),
-                                             &tileImage);
+    heif_error err = heif_image_create_view(mImage.image.get(), x0, y0, mTileSize, mTileSize, &tileImage);
+    if (err.code) {
+      err = heif_image_extract_area(mImage.image.get(), x0, y0, mTileSize, mTileSize,
+                                    heif_get_global_security_limits(),
+                                    &tileImage);
+    }
+
     if (err.code) {
       std::cerr << "error extracting tile " << tx << ";" << ty << std::endl;
-      exit(1);
+      return {};
     }
 
     InputImage tile;
@@ -842,12 +912,12 @@ public:
     return tile;
   }
 
-  uint32_t get_image_width() const { return heif_image_get_width(mImage.image.get(), heif_channel_Y); }
-  uint32_t get_image_height() const { return heif_image_get_height(mImage.image.get(), heif_channel_Y); }
+  uint32_t get_image_width() const { return mWidth; }
+  uint32_t get_image_height() const { return mHeight; }
 
 private:
   InputImage mImage;
-  uint32_t mWidth, mHeight;
+  uint32_t mWidth = 0, mHeight = 0;
   int mTileSize;
 };
 
@@ -901,6 +971,9 @@ heif_image_handle* encode_tiled(heif_context* ctx, heif_encoder* encoder, heif_e
     params.compression = unci_compression;
 
     InputImage prototype_image = tile_generator->get_image(0,0, output_bit_depth);
+    if (!prototype_image.image) {
+      return nullptr;
+    }
 
     heif_error error = heif_context_add_unci_image(ctx, &params, options, prototype_image.image.get(), &tiled_image);
     if (error.code != 0) {
@@ -925,6 +998,9 @@ heif_image_handle* encode_tiled(heif_context* ctx, heif_encoder* encoder, heif_e
   for (uint32_t ty = 0; ty < tile_generator->nRows(); ty++)
     for (uint32_t tx = 0; tx < tile_generator->nColumns(); tx++) {
       InputImage input_image = tile_generator->get_image(tx,ty, output_bit_depth);
+      if (!input_image.image) {
+        return nullptr;
+      }
 
       if (tile_width == 0) {
         tile_width = heif_image_get_primary_width(input_image.image.get());
@@ -970,10 +1046,303 @@ public:
 };
 
 
+static heif_error ofstream_writer_write(heif_context*, const void* data, size_t size, void* userdata)
+{
+  auto* ostr = static_cast<std::ofstream*>(userdata);
+  ostr->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  if (!*ostr) {
+    return {heif_error_Encoding_error, heif_suberror_Cannot_write_output_data, "Could not write to output file"};
+  }
+
+  return heif_error_success;
+}
+
+
+static heif_error ofstream_writer_seek(heif_context*, uint64_t position, void* userdata)
+{
+  auto* ostr = static_cast<std::ofstream*>(userdata);
+  ostr->seekp(static_cast<std::streamoff>(position));
+  if (!*ostr) {
+    return {heif_error_Encoding_error, heif_suberror_Cannot_write_output_data, "Could not seek in output file"};
+  }
+
+  return heif_error_success;
+}
+
+
 int do_encode_images(heif_context*, heif_encoder*, heif_encoding_options* options, const std::vector<std::string>& args);
 int do_encode_sequence(heif_context*, heif_encoder*, heif_encoding_options* options, std::vector<std::string> args);
 
 
+heif_compression_format determine_compression_format(const std::string& filename)
+{
+  heif_compression_format compressionFormat;
+
+  if (force_enc_av1f) {
+    compressionFormat = heif_compression_AV1;
+  }
+  else if (force_enc_vvc) {
+    compressionFormat = heif_compression_VVC;
+  }
+  else if (force_enc_uncompressed) {
+    compressionFormat = heif_compression_uncompressed;
+  }
+  else if (force_enc_jpeg) {
+    compressionFormat = heif_compression_JPEG;
+  }
+  else if (force_enc_jpeg2000) {
+    compressionFormat = heif_compression_JPEG2000;
+  }
+  else if (force_enc_htj2k) {
+    compressionFormat = heif_compression_HTJ2K;
+  }
+  else {
+    compressionFormat = guess_compression_format_from_filename(filename);
+  }
+
+  if (compressionFormat == heif_compression_undefined) {
+    compressionFormat = heif_compression_HEVC;
+  }
+
+  return compressionFormat;
+}
+
+
+// Allocates the encoder for the compression format (the one selected with --encoder, or the default one).
+// Returns 0 or the program exit code.
+int get_encoder(heif_compression_format compressionFormat,
+                heif_encoder** out_encoder,
+                const heif_encoder_descriptor** out_descriptor)
+{
+#define MAX_ENCODERS 10
+  const heif_encoder_descriptor* encoder_descriptors[MAX_ENCODERS];
+  int count = heif_get_encoder_descriptors(compressionFormat,
+                                           nullptr,
+                                           encoder_descriptors, MAX_ENCODERS);
+#undef MAX_ENCODERS
+
+  if (count == 0) {
+    std::cerr << "No " << get_compression_format_name(compressionFormat) << " encoder available.\n";
+    return 5;
+  }
+
+  int idx = 0;
+  if (encoderId != nullptr) {
+    for (int i = 0; i <= count; i++) {
+      if (i == count) {
+        std::cerr << "Unknown encoder ID. Choose one from the list below.\n";
+        show_list_of_encoders(encoder_descriptors, count);
+        return 5;
+      }
+
+      if (strcmp(encoderId, heif_encoder_descriptor_get_id_name(encoder_descriptors[i])) == 0) {
+        idx = i;
+        break;
+      }
+    }
+  }
+
+  heif_error error = heif_context_get_encoder(nullptr, encoder_descriptors[idx], out_encoder);
+  if (error.code) {
+    std::cerr << error.message << "\n";
+    return 5;
+  }
+
+  *out_descriptor = encoder_descriptors[idx];
+  return 0;
+}
+
+
+// Sets the quality, logging level and encoder parameters given on the command line and the additional 'params'.
+// Returns 0 or the program exit code.
+int configure_encoder(heif_encoder* encoder, const std::vector<std::string>& raw_params, const std::vector<std::string>& params)
+{
+  if (!lossless) {
+    heif_encoder_set_lossy_quality(encoder, quality);
+  }
+
+  heif_encoder_set_logging_level(encoder, logging_level);
+
+  if (int ret = set_params(encoder, raw_params)) {
+    return ret;
+  }
+
+  return set_params(encoder, params);
+}
+
+
+heif_encoding_options* alloc_encoding_options()
+{
+  struct heif_encoding_options* options = heif_encoding_options_alloc();
+  options->save_two_colr_boxes_when_ICC_and_nclx_available = (uint8_t) two_colr_boxes;
+
+  if (chroma_downsampling == "average") {
+    options->color_conversion_options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_average;
+    options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
+  }
+  else if (chroma_downsampling == "sharp-yuv") {
+    options->color_conversion_options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_sharp_yuv;
+    options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
+  }
+  else if (chroma_downsampling == "nearest-neighbor") {
+    options->color_conversion_options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_nearest_neighbor;
+    options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
+  }
+
+  return options;
+}
+
+
+// Encodes the input images into a new HEIF file 'output_filename'.
+// Returns 0 or the program exit code.
+int encode_to_output_file(heif_encoder* encoder, heif_encoding_options* options, const std::vector<std::string>& args)
+{
+  std::shared_ptr<heif_context> context(heif_context_alloc(),
+                                        [](heif_context* c) { heif_context_free(c); });
+  if (!context) {
+    std::cerr << "Could not create context object\n";
+    return 1;
+  }
+
+
+  // --- Tiled input may be larger than the available memory. Write the image data to the output file
+  //     while the tiles are encoded.
+
+  std::ofstream output_stream;
+  heif_writer output_writer{};
+  output_writer.writer_api_version = 2;
+  output_writer.write = ofstream_writer_write;
+  output_writer.seek = ofstream_writer_seek;
+
+  bool stream_output = use_tiling;
+
+  if (stream_output) {
+    output_stream.open(output_filename, std::ios_base::binary);
+    if (!output_stream) {
+      std::cerr << "Could not open output file '" << output_filename << "'\n";
+      return 5;
+    }
+
+    heif_error error = heif_context_start_streaming(context.get(), &output_writer, &output_stream);
+    if (error.code) {
+      std::cerr << error.message << "\n";
+      return 5;
+    }
+  }
+
+
+  int ret;
+
+  if (!encode_sequence) {
+    ret = do_encode_images(context.get(), encoder, options, args);
+  }
+  else {
+    ret = do_encode_sequence(context.get(), encoder, options, args);
+  }
+
+  if (ret != 0) {
+    return ret;
+  }
+
+
+  // --- write HEIF file
+
+  heif_error error;
+  if (stream_output) {
+    error = heif_context_write(context.get(), &output_writer, &output_stream);
+  }
+  else {
+    error = heif_context_write_to_file(context.get(), output_filename.c_str());
+  }
+
+  if (error.code) {
+    std::cerr << error.message << "\n";
+    return 5;
+  }
+
+  return 0;
+}
+
+
+// Encodes all entries of a batch manifest (see read_batch_entry()) with the options of the command line.
+// The encoders are kept and reused for all entries with the same output format and encoder parameters.
+// Returns 0 when all entries were encoded, or the exit code of the first failed entry.
+int encode_batch(std::istream& manifest, const std::vector<std::string>& raw_params)
+{
+  struct PooledEncoder
+  {
+    heif_encoder* encoder;
+    const heif_encoder_descriptor* descriptor;
+  };
+
+  std::map<std::pair<heif_compression_format, std::vector<std::string>>, PooledEncoder> encoder_pool;
+
+  struct heif_encoding_options* options = alloc_encoding_options();
+
+  // Only the results are written to stdout, all other output goes to stderr.
+  std::ostream results(std::cout.rdbuf());
+  std::streambuf* cout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  const bool lossless_requested = lossless;
+  int batch_ret = 0;
+
+  BatchEntry entry;
+  while (read_batch_entry(manifest, entry)) {
+    int ret = 0;
+
+    if (!entry.error.empty()) {
+      std::cerr << "Batch line " << entry.line_number << ": " << entry.error << "\n";
+      ret = 5;
+    }
+    else {
+      heif_compression_format compressionFormat = determine_compression_format(entry.output_filename);
+
+      auto pool_key = std::make_pair(compressionFormat, entry.options);
+      auto pool_iter = encoder_pool.find(pool_key);
+
+      if (pool_iter == encoder_pool.end()) {
+        PooledEncoder pooled{};
+        ret = get_encoder(compressionFormat, &pooled.encoder, &pooled.descriptor);
+        if (ret == 0) {
+          lossless = lossless_requested && heif_encoder_descriptor_supports_lossless_compression(pooled.descriptor);
+
+          ret = configure_encoder(pooled.encoder, raw_params, entry.options);
+          if (ret) {
+            heif_encoder_release(pooled.encoder);
+          }
+          else {
+            pool_iter = encoder_pool.emplace(pool_key, pooled).first;
+          }
+        }
+      }
+
+      if (ret == 0) {
+        lossless = lossless_requested && heif_encoder_descriptor_supports_lossless_compression(pool_iter->second.descriptor);
+
+        output_filename = entry.output_filename;
+        ret = encode_to_output_file(pool_iter->second.encoder, options, {entry.input_filename});
+      }
+    }
+
+    report_batch_result(results, entry, ret);
+
+    if (ret && batch_ret == 0) {
+      batch_ret = ret;
+    }
+  }
+
+  std::cout.rdbuf(cout_buffer);
+
+  for (auto& pooled : encoder_pool) {
+    heif_encoder_release(pooled.second.encoder);
+  }
+
+  heif_encoding_options_free(options);
+
+  return batch_ret;
+}
+
+
 int main(int argc, char** argv)
 {
   // This takes care of initializing libheif and also deinitializing it at the end to free all resources.
@@ -1095,6 +1464,22 @@ int main(int argc, char** argv)
       case OPTION_CUT_TILES:
         cut_tiles = atoi(optarg);
         break;
+      case OPTION_TARGET_SIZE:
+        target_size = atoll(optarg);
+        if (target_size <= 0) {
+          std::cerr << "Invalid target size\n";
+          exit(5);
+        }
+        break;
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+      case OPTION_PYRAMID:
+        pyramid_tile_size = atoi(optarg);
+        if (pyramid_tile_size <= 0) {
+          std::cerr << "Invalid pyramid tile size\n";
+          exit(5);
+        }
+        break;
+#endif
       case OPTION_UNCI_COMPRESSION: {
         std::string option(optarg);
         if (option == "none") {
@@ -1109,6 +1494,12 @@ int main(int argc, char** argv)
         else if (option == "zlib") {
           unci_compression = heif_unci_compression_zlib;
         }
+        else if (option == "zstd") {
+          unci_compression = heif_unci_compression_zstd;
+        }
+        else if (option == "auto") {
+          unci_compression = heif_unci_compression_auto;
+        }
         else {
           std::cerr << "Invalid unci compression method '" << option << "'\n";
           exit(5);
@@ -1141,12 +1532,15 @@ int main(int argc, char** argv)
         encode_sequence = true;
         break;
       case OPTION_SEQUENCES_TIMEBASE:
+        sequence_timing_specified = true;
         sequence_timebase = atoi(optarg);
         break;
       case OPTION_SEQUENCES_DURATIONS:
+        sequence_timing_specified = true;
         sequence_durations = atoi(optarg);
         break;
       case OPTION_SEQUENCES_FPS:
+        sequence_timing_specified = true;
         if (strcmp(optarg,"29.97")==0) {
           sequence_durations = 1001;
           sequence_timebase = 30000;
@@ -1157,9 +1551,36 @@ int main(int argc, char** argv)
           sequence_durations = (uint32_t)(90000 / fps + 0.5);
         }
         break;
+      case OPTION_SEQUENCES_GOP_STRUCTURE:
+        if (strcmp(optarg, "intra") == 0) {
+          sequence_gop_structure = heif_sequence_gop_structure_intra_only;
+        }
+        else if (strcmp(optarg, "lowdelay") == 0) {
+          sequence_gop_structure = heif_sequence_gop_structure_lowdelay;
+        }
+        else if (strcmp(optarg, "unrestricted") == 0) {
+          sequence_gop_structure = heif_sequence_gop_structure_unrestricted;
+        }
+        else {
+          std::cerr << "GOP structure must be one of: intra, lowdelay, unrestricted\n";
+          return 5;
+        }
+        break;
+      case OPTION_SEQUENCES_MIN_KEYFRAME_DISTANCE:
+        sequence_keyframe_distance_min = atoi(optarg);
+        break;
+      case OPTION_SEQUENCES_MAX_KEYFRAME_DISTANCE:
+        sequence_keyframe_distance_max = atoi(optarg);
+        break;
+      case OPTION_SEQUENCES_PARALLEL_FRAMES:
+        sequence_parallel_frames = atoi(optarg);
+        break;
       case OPTION_VMT_METADATA_FILE:
         vmt_metadata_file = optarg;
         break;
+      case OPTION_BATCH:
+        batch_manifest = optarg;
+        break;
     }
   }
 
@@ -1179,6 +1600,16 @@ int main(int argc, char** argv)
     return 5;
   }
 
+  if (target_size && (encode_sequence || use_tiling || cut_tiles || pyramid_tile_size || lossless)) {
+    std::cerr << "A target size can only be used for lossy coding of single images.\n";
+    return 5;
+  }
+
+  if (pyramid_tile_size && (encode_sequence || use_tiling || cut_tiles)) {
+    std::cerr << "Multi-resolution pyramids cannot be used together with sequences or tiled input.\n";
+    return 5;
+  }
+
   if (sequence_timebase <= 0) {
     std::cerr << "Sequence clock tick rate cannot be zero.\n";
     return 5;
@@ -1189,6 +1620,17 @@ int main(int argc, char** argv)
     return 5;
   }
 
+  if (sequence_keyframe_distance_min < 0 || sequence_keyframe_distance_max < 0 ||
+      (sequence_keyframe_distance_max > 0 && sequence_keyframe_distance_min > sequence_keyframe_distance_max)) {
+    std::cerr << "Invalid keyframe distance range.\n";
+    return 5;
+  }
+
+  if (sequence_parallel_frames < 0) {
+    std::cerr << "Number of parallel frames cannot be negative.\n";
+    return 5;
+  }
+
   if (logging_level > 0) {
     logging_level += 2;
 
@@ -1200,90 +1642,37 @@ int main(int argc, char** argv)
 
   // ==============================================================================
 
-  struct heif_encoder* encoder = nullptr;
-
   if (list_encoders) {
     show_list_of_all_encoders();
     return 0;
   }
 
-  // --- determine output compression format (from output filename or command line parameter)
-
-  heif_compression_format compressionFormat;
+  if (!batch_manifest.empty()) {
+    if (batch_manifest == "-") {
+      return encode_batch(std::cin, raw_params);
+    }
 
-  if (force_enc_av1f) {
-    compressionFormat = heif_compression_AV1;
-  }
-  else if (force_enc_vvc) {
-    compressionFormat = heif_compression_VVC;
-  }
-  else if (force_enc_uncompressed) {
-    compressionFormat = heif_compression_uncompressed;
-  }
-  else if (force_enc_jpeg) {
-    compressionFormat = heif_compression_JPEG;
-  }
-  else if (force_enc_jpeg2000) {
-    compressionFormat = heif_compression_JPEG2000;
-  }
-  else if (force_enc_htj2k) {
-    compressionFormat = heif_compression_HTJ2K;
-  }
-  else {
-    compressionFormat = guess_compression_format_from_filename(output_filename);
-  }
+    std::ifstream manifest(batch_manifest);
+    if (!manifest) {
+      std::cerr << "Cannot open batch manifest '" << batch_manifest << "'\n";
+      return 5;
+    }
 
-  if (compressionFormat == heif_compression_undefined) {
-    compressionFormat = heif_compression_HEVC;
+    return encode_batch(manifest, raw_params);
   }
 
+  // --- determine output compression format (from output filename or command line parameter)
 
-  // --- select encoder
+  heif_compression_format compressionFormat = determine_compression_format(output_filename);
 
-  std::shared_ptr<heif_context> context(heif_context_alloc(),
-                                        [](heif_context* c) { heif_context_free(c); });
-  if (!context) {
-    std::cerr << "Could not create context object\n";
-    return 1;
-  }
 
+  // --- select encoder
 
-#define MAX_ENCODERS 10
-  const heif_encoder_descriptor* encoder_descriptors[MAX_ENCODERS];
-  int count = heif_get_encoder_descriptors(compressionFormat,
-                                           nullptr,
-                                           encoder_descriptors, MAX_ENCODERS);
-#undef MAX_ENCODERS
-
+  struct heif_encoder* encoder = nullptr;
   const heif_encoder_descriptor* active_encoder_descriptor = nullptr;
-  if (count > 0) {
-    int idx = 0;
-    if (encoderId != nullptr) {
-      for (int i = 0; i <= count; i++) {
-        if (i == count) {
-          std::cerr << "Unknown encoder ID. Choose one from the list below.\n";
-          show_list_of_encoders(encoder_descriptors, count);
-          return 5;
-        }
-
-        if (strcmp(encoderId, heif_encoder_descriptor_get_id_name(encoder_descriptors[i])) == 0) {
-          idx = i;
-          break;
-        }
-      }
-    }
 
-    heif_error error = heif_context_get_encoder(context.get(), encoder_descriptors[idx], &encoder);
-    if (error.code) {
-      std::cerr << error.message << "\n";
-      return 5;
-    }
-
-    active_encoder_descriptor = encoder_descriptors[idx];
-  }
-  else {
-    std::cerr << "No " << get_compression_format_name(compressionFormat) << " encoder available.\n";
-    return 5;
+  if (int ret = get_encoder(compressionFormat, &encoder, &active_encoder_descriptor)) {
+    return ret;
   }
 
   if (option_show_parameters) {
@@ -1318,28 +1707,12 @@ int main(int argc, char** argv)
   }
 
 
-  if (!lossless) {
-    heif_encoder_set_lossy_quality(encoder, quality);
+  if (int ret = configure_encoder(encoder, raw_params, {})) {
+    heif_encoder_release(encoder);
+    return ret;
   }
 
-  heif_encoder_set_logging_level(encoder, logging_level);
-
-  set_params(encoder, raw_params);
-  struct heif_encoding_options* options = heif_encoding_options_alloc();
-  options->save_two_colr_boxes_when_ICC_and_nclx_available = (uint8_t) two_colr_boxes;
-
-  if (chroma_downsampling == "average") {
-    options->color_conversion_options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_average;
-    options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
-  }
-  else if (chroma_downsampling == "sharp-yuv") {
-    options->color_conversion_options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_sharp_yuv;
-    options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
-  }
-  else if (chroma_downsampling == "nearest-neighbor") {
-    options->color_conversion_options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_nearest_neighbor;
-    options->color_conversion_options.only_use_preferred_chroma_algorithm = true;
-  }
+  struct heif_encoding_options* options = alloc_encoding_options();
 
 
   // --- if no output filename was given, synthesize one from the first input image filename
@@ -1361,34 +1734,12 @@ int main(int argc, char** argv)
   }
 
 
-  int ret;
-
-  if (!encode_sequence) {
-    ret = do_encode_images(context.get(), encoder, options, args);
-  }
-  else {
-    ret = do_encode_sequence(context.get(), encoder, options, args);
-  }
-
-  if (ret != 0) {
-    heif_encoding_options_free(options);
-    heif_encoder_release(encoder);
-    return ret;
-  }
-
-
-  // --- write HEIF file
-
-  heif_error error = heif_context_write_to_file(context.get(), output_filename.c_str());
-  if (error.code) {
-    std::cerr << error.message << "\n";
-    return 5;
-  }
+  int ret = encode_to_output_file(encoder, options, args);
 
   heif_encoding_options_free(options);
   heif_encoder_release(encoder);
 
-  return 0;
+  return ret;
 }
 
 
@@ -1400,9 +1751,18 @@ int do_encode_images(heif_context* context, heif_encoder* encoder, heif_encoding
 
   std::vector<heif_item_id> encoded_image_ids;
 
+  StageTimes encoding_stage_times;
+  bool have_stage_times = false;
+  if (run_benchmark) {
+    have_stage_times = encoding_stage_times.install();
+  }
+
   for (std::string input_filename : args) {
 
     InputImage input_image = load_image(input_filename, output_bit_depth);
+    if (!input_image.image) {
+      return 1;
+    }
 
     std::shared_ptr<heif_image> image = input_image.image;
 
@@ -1431,8 +1791,7 @@ int do_encode_images(heif_context* context, heif_encoder* encoder, heif_encoding
       }
     }
     else if (cut_tiles != 0) {
-      auto cutting_tile_generator = std::make_shared<input_tiles_generator_cut_image>(input_filename.c_str(),
-                                                                         cut_tiles, output_bit_depth);
+      auto cutting_tile_generator = std::make_shared<input_tiles_generator_cut_image>(input_image, cut_tiles);
       tile_generator = cutting_tile_generator;
 
       tiling.num_columns = tile_generator->nColumns();
@@ -1474,6 +1833,41 @@ int do_encode_images(heif_context* context, heif_encoder* encoder, heif_encoding
     if (use_tiling || cut_tiles > 0) {
       handle = encode_tiled(context, encoder, options, output_bit_depth, tile_generator, tiling);
     }
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+    else if (pyramid_tile_size > 0) {
+      error = heif_context_encode_pyramid(context,
+                                          image.get(),
+                                          pyramid_tile_size, pyramid_tile_size,
+                                          encoder,
+                                          options,
+                                          &handle,
+                                          nullptr);
+      if (error.code != 0) {
+        heif_nclx_color_profile_free(nclx);
+        std::cerr << "Could not encode multi-resolution pyramid: " << error.message << "\n";
+        return 1;
+      }
+    }
+#endif
+    else if (target_size > 0) {
+      int chosen_quality;
+      error = heif_context_encode_image_with_target_size(context,
+                                                         image.get(),
+                                                         encoder,
+                                                         options,
+                                                         (size_t) target_size,
+                                                         &chosen_quality,
+                                                         &handle);
+      if (error.code != 0) {
+        heif_nclx_color_profile_free(nclx);
+        std::cerr << "Could not encode HEIF/AVIF file: " << error.message << "\n";
+        return 1;
+      }
+
+      if (logging_level > 0) {
+        std::cerr << "quality for target size: " << chosen_quality << "\n";
+      }
+    }
     else {
       error = heif_context_encode_image(context,
                                         image.get(),
@@ -1596,18 +1990,47 @@ int do_encode_images(heif_context* context, heif_encoder* encoder, heif_encoding
 #endif
 
   if (run_benchmark) {
-    double psnr = compute_psnr(primary_image.get(), output_filename);
-    std::cout << "PSNR: " << std::setprecision(2) << std::fixed << psnr << " ";
+    encoding_stage_times.uninstall();
+
+    // The metrics are computed on the file data in memory, before the file is written.
+
+    int num_threads = 1;
+#if ENABLE_MULTITHREADING_SUPPORT
+    num_threads = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+#endif
+
+    size_t size = 0;
+    heif_decoding_statistics* decoding_statistics = heif_decoding_statistics_alloc();
+    std::shared_ptr<heif_image> decoded_image(decode_encoded_image(context, primary_image.get(), &size, decoding_statistics),
+                                              heif_image_release);
+
+    QualityMetrics metrics;
+    if (decoded_image) {
+      compute_quality_metrics(primary_image.get(), decoded_image.get(), num_threads, metrics);
+    }
+
+    std::cout << "PSNR: " << std::setprecision(2) << std::fixed << metrics.psnr << " "
+              << "SSIM: " << std::setprecision(4) << metrics.ssim << " "
+              << "MS-SSIM: " << metrics.ms_ssim << " ";
 
 #if HAVE_GETTIMEOFDAY
     double t = (double) (time_encoding_end.tv_sec - time_encoding_start.tv_sec) + (double) (time_encoding_end.tv_usec - time_encoding_start.tv_usec) / 1000000.0;
     std::cout << "time: " << std::setprecision(1) << std::fixed << t << " ";
 #endif
 
-    std::ifstream istr(output_filename.c_str());
-    istr.seekg(0, std::ios_base::end);
-    std::streamoff size = istr.tellg();
     std::cout << "size: " << size << "\n";
+
+    if (have_stage_times) {
+      std::cout << "encoding stages:\n";
+      encoding_stage_times.write(std::cout);
+    }
+
+    std::cout << "decoding: " << std::setprecision(1) << std::fixed
+              << "total " << (double) decoding_statistics->total_time_us / 1000.0 << " ms, "
+              << "codec " << (double) decoding_statistics->codec_time_us / 1000.0 << " ms, "
+              << "color conversion " << (double) decoding_statistics->color_conversion_time_us / 1000.0 << " ms\n";
+
+    heif_decoding_statistics_free(decoding_statistics);
   }
 
   return 0;
@@ -1752,13 +2175,192 @@ int encode_vmt_metadata_track(heif_context* context, heif_track* visual_track)
 }
 
 
+struct SequenceFrame
+{
+  InputImage image;
+  std::string name;
+
+  // Program exit code when the frame could not be read.
+  int error = 0;
+
+  // Set after the last frame. 'image' is empty.
+  bool end_of_sequence = false;
+};
+
+
+// Reads the input frames of a sequence, either from a list of image files or from a single Y4M file.
+// Y4M frames are read one after the other, such that the input does not have to fit into memory.
+class SequenceFrameReader
+{
+public:
+  // Returns 0 or the program exit code.
+  int open(const std::vector<std::string>& args)
+  {
+    if (args.size() == 1 && suffix_lowercase(args[0]) == "y4m") {
+      m_y4m = std::make_unique<Y4MReader>();
+      heif_error err = m_y4m->open(args[0].c_str());
+      if (err.code) {
+        std::cerr << "Cannot open Y4M file '" << args[0] << "': " << err.message << "\n";
+        return 1;
+      }
+
+      m_y4m_filename = args[0];
+    }
+    else if (args.size() == 1) {
+      m_filenames = deflate_input_filenames(args[0]);
+    }
+    else {
+      m_filenames = args;
+    }
+
+    return 0;
+  }
+
+  // 0 if not known in advance.
+  size_t get_number_of_frames() const { return m_filenames.size(); }
+
+  const Y4MReader* get_y4m_reader() const { return m_y4m.get(); }
+
+  SequenceFrame read_frame()
+  {
+    SequenceFrame frame;
+
+    if (m_y4m) {
+      frame.name = m_y4m_filename + " frame " + std::to_string(m_next_frame + 1);
+
+      heif_error err = m_y4m->read_next_frame(&frame.image);
+      if (err.code) {
+        std::cerr << "Cannot read " << frame.name << ": " << err.message << "\n";
+        frame.error = 1;
+      }
+      else if (!frame.image.image) {
+        frame.end_of_sequence = true;
+      }
+    }
+    else if (m_next_frame == m_filenames.size()) {
+      frame.end_of_sequence = true;
+    }
+    else {
+      frame.name = m_filenames[m_next_frame];
+      frame.image = load_image(frame.name, output_bit_depth);
+      if (!frame.image.image) {
+        frame.error = 1;
+      }
+    }
+
+    m_next_frame++;
+
+    return frame;
+  }
+
+private:
+  std::vector<std::string> m_filenames;
+
+  std::unique_ptr<Y4MReader> m_y4m;
+  std::string m_y4m_filename;
+
+  size_t m_next_frame = 0;
+};
+
+
+// Reads the next frames in a separate thread while the current frame is encoded.
+// At most 'max_queued_frames' frames are held in memory.
+class PrefetchingFrameReader
+{
+public:
+  PrefetchingFrameReader(SequenceFrameReader& reader, size_t max_queued_frames)
+      : m_reader(reader), m_max_queued_frames(max_queued_frames)
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    m_thread = std::thread(&PrefetchingFrameReader::read_frames, this);
+#endif
+  }
+
+  ~PrefetchingFrameReader()
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+#endif
+  }
+
+  SequenceFrame get_next_frame()
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this] { return !m_frames.empty(); });
+
+    SequenceFrame frame = std::move(m_frames.front());
+    m_frames.pop_front();
+
+    lock.unlock();
+    m_cond.notify_all();
+
+    return frame;
+#else
+    return m_reader.read_frame();
+#endif
+  }
+
+private:
+  SequenceFrameReader& m_reader;
+  size_t m_max_queued_frames;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::deque<SequenceFrame> m_frames;
+  bool m_stop = false;
+
+  void read_frames()
+  {
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_stop || m_frames.size() < m_max_queued_frames; });
+        if (m_stop) {
+          return;
+        }
+      }
+
+      SequenceFrame frame = m_reader.read_frame();
+      bool last_frame = (frame.end_of_sequence || frame.error);
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frames.push_back(std::move(frame));
+      }
+      m_cond.notify_all();
+
+      if (last_frame) {
+        return;
+      }
+    }
+  }
+#endif
+};
+
+
 int do_encode_sequence(heif_context* context, heif_encoder* encoder, heif_encoding_options* options, std::vector<std::string> args)
 {
-  if (args.size() == 1) {
-    args = deflate_input_filenames(args[0]);
+  SequenceFrameReader reader;
+  if (int ret = reader.open(args)) {
+    return ret;
+  }
+
+  // Take the frame rate from the Y4M header when no timing was given on the command line.
+  const Y4MReader* y4m = reader.get_y4m_reader();
+  if (y4m && !sequence_timing_specified && y4m->get_framerate_numerator() != 0) {
+    sequence_timebase = y4m->get_framerate_numerator();
+    sequence_durations = y4m->get_framerate_denominator();
   }
 
-  size_t nImages = args.size();
+  size_t nImages = reader.get_number_of_frames();
   size_t currImage = 0;
 
   uint16_t image_width=0, image_height=0;
@@ -1767,14 +2369,29 @@ int do_encode_sequence(heif_context* context, heif_encoder* encoder, heif_encodi
 
   heif_track* track = nullptr;
 
-  for (std::string input_filename : args) {
+  // Keep enough frames queued to feed the frames that are encoded in parallel.
+  PrefetchingFrameReader prefetcher(reader, std::max(2, sequence_parallel_frames));
+
+  for (;;) {
+    SequenceFrame frame = prefetcher.get_next_frame();
+    if (frame.error) {
+      return frame.error;
+    }
+
+    if (frame.end_of_sequence) {
+      break;
+    }
+
+    const std::string& input_filename = frame.name;
+
     currImage++;
-    std::cout << "\rencoding sequence image " << currImage << "/" << nImages;
+    std::cout << "\rencoding sequence image " << currImage;
+    if (nImages) {
+      std::cout << "/" << nImages;
+    }
     std::cout.flush();
 
-    InputImage input_image = load_image(input_filename, output_bit_depth);
-
-    std::shared_ptr<heif_image> image = input_image.image;
+    std::shared_ptr<heif_image> image = frame.image.image;
 
     int w = heif_image_get_primary_width(image.get());
     int h = heif_image_get_primary_height(image.get());
@@ -1788,9 +2405,16 @@ int do_encode_sequence(heif_context* context, heif_encoder* encoder, heif_encodi
       heif_track_info* track_info = heif_track_info_alloc();
 
       track_info->track_timescale = sequence_timebase;
+      track_info->gop_structure = sequence_gop_structure;
+      track_info->keyframe_distance_min = sequence_keyframe_distance_min;
+      track_info->keyframe_distance_max = sequence_keyframe_distance_max;
 
       heif_context_set_sequence_timescale(context, sequence_timebase);
 
+      if (sequence_parallel_frames > 1) {
+        heif_context_set_max_encoding_threads(context, sequence_parallel_frames);
+      }
+
       image_width = static_cast<uint16_t>(w);
       image_height = static_cast<uint16_t>(h);
 
@@ -1835,6 +2459,14 @@ int do_encode_sequence(heif_context* context, heif_encoder* encoder, heif_encodi
 
   std::cout << "\n";
 
+  if (track) {
+    heif_error error = heif_track_encode_end_of_sequence(track, encoder);
+    if (error.code) {
+      std::cerr << "Cannot finish encoding the sequence: " << error.message << "\n";
+      return 5;
+    }
+  }
+
   if (!vmt_metadata_file.empty()) {
     int ret = encode_vmt_metadata_track(context, track);
     if (ret) {
@@ -41,6 +41,7 @@
 #include <libheif/heif_regions.h>
 #include <libheif/heif_properties.h>
 #include <libheif/heif_experimental.h>
+#include <libheif/heif_items.h>
 #include "libheif/heif_sequences.h"
 
 #include <fstream>
@@ -70,12 +71,19 @@ info -d // dump
  */
 
 int option_disable_limits = 0;
+int option_json = 0;
+int option_no_decode = 0;
+
+#define OPTION_FILE_LIST 1000
 
 static struct option long_options[] = {
     //{"write-raw", required_argument, 0, 'w' },
     //{"output",    required_argument, 0, 'o' },
     {(char* const) "dump-boxes", no_argument, 0, 'd'},
     {(char* const) "disable-limits", no_argument, &option_disable_limits, 1},
+    {(char* const) "json",       no_argument, &option_json, 1},
+    {(char* const) "no-decode",  no_argument, &option_no_decode, 1},
+    {(char* const) "file-list",  required_argument, 0, OPTION_FILE_LIST},
     {(char* const) "help",       no_argument, 0, 'h'},
     {(char* const) "version",    no_argument, 0, 'v'},
     {0, 0,                                    0, 0}
@@ -95,17 +103,329 @@ void show_help(const char* argv0)
   std::cerr << title << "\n"
             << std::string(title.length() + 1, '-') << "\n"
             << "Usage: " << filename << " [options] <HEIF-image>\n"
+            << "       " << filename << " --json [options] <HEIF-image>...\n"
             << "\n"
                "options:\n"
                //fprintf(stderr,"  -w, --write-raw ID   write raw compressed data of image 'ID'\n");
                //fprintf(stderr,"  -o, --output NAME    output file name for image selected by -w\n");
                "  -d, --dump-boxes     show a low-level dump of all MP4 file boxes\n"
+               "      --json           write one line with a JSON record for each input file\n"
+               "      --no-decode      (with --json) only read the file structure: box parsing is lazy\n"
+               "                       and no item data is read except for the metadata sizes\n"
+               "      --file-list FILE (with --json) also process the files listed in FILE, one per line ('-' reads stdin)\n"
                "      --disable-limits disable all security limits (do not use in production environment)\n"
                "  -h, --help           show help\n"
                "  -v, --version        show version\n";
 }
 
 
+// Short name of the metadata block, e.g. "Exif", "XMP" or "mime/application/json".
+static std::string get_metadata_name(const heif_image_handle* handle, heif_item_id id)
+{
+  std::string itemtype = heif_image_handle_get_metadata_type(handle, id);
+  std::string contenttype = heif_image_handle_get_metadata_content_type(handle, id);
+  std::string item_uri_type = heif_image_handle_get_metadata_item_uri_type(handle, id);
+
+  if (itemtype == "Exif") {
+    return itemtype;
+  }
+  else if (itemtype == "uri ") {
+    return itemtype + "/" + item_uri_type;
+  }
+  else if (contenttype == "application/rdf+xml") {
+    return "XMP";
+  }
+  else {
+    return itemtype + "/" + contenttype;
+  }
+}
+
+
+static const char* colorspace_name(heif_colorspace colorspace)
+{
+  switch (colorspace) {
+    case heif_colorspace_YCbCr:
+      return "YCbCr";
+    case heif_colorspace_RGB:
+      return "RGB";
+    case heif_colorspace_monochrome:
+      return "monochrome";
+    case heif_colorspace_nonvisual:
+      return "non-visual";
+    default:
+      return "unknown";
+  }
+}
+
+
+static const char* chroma_name(heif_chroma chroma)
+{
+  switch (chroma) {
+    case heif_chroma_monochrome:
+      return "monochrome";
+    case heif_chroma_420:
+      return "4:2:0";
+    case heif_chroma_422:
+      return "4:2:2";
+    case heif_chroma_444:
+      return "4:4:4";
+    default:
+      return "unknown";
+  }
+}
+
+
+// Writes the properties of the image handle that are needed by most indexers as a JSON object.
+static void write_json_image(std::ostream& out, heif_context* ctx, heif_image_handle* handle, heif_item_id id)
+{
+  out << "{\"id\":" << id
+      << ",\"item_type\":\"" << json_escape(fourcc_to_string(heif_item_get_item_type(ctx, id))) << "\""
+      << ",\"width\":" << heif_image_handle_get_width(handle)
+      << ",\"height\":" << heif_image_handle_get_height(handle)
+      << ",\"primary\":" << (heif_image_handle_is_primary_image(handle) ? "true" : "false");
+
+  heif_image_tiling tiling;
+  heif_error err = heif_image_handle_get_image_tiling(handle, true, &tiling);
+  if (err.code == heif_error_Ok && (tiling.num_columns != 1 || tiling.num_rows != 1)) {
+    out << ",\"tiling\":{\"columns\":" << tiling.num_columns << ",\"rows\":" << tiling.num_rows
+        << ",\"tile_width\":" << tiling.tile_width << ",\"tile_height\":" << tiling.tile_height << "}";
+  }
+
+  heif_colorspace colorspace;
+  heif_chroma chroma;
+  err = heif_image_handle_get_preferred_decoding_colorspace(handle, &colorspace, &chroma);
+  if (err.code == heif_error_Ok) {
+    out << ",\"colorspace\":\"" << colorspace_name(colorspace) << "\"";
+    if (colorspace == heif_colorspace_YCbCr) {
+      out << ",\"chroma\":\"" << chroma_name(chroma) << "\"";
+    }
+  }
+
+  out << ",\"luma_bit_depth\":" << heif_image_handle_get_luma_bits_per_pixel(handle)
+      << ",\"chroma_bit_depth\":" << heif_image_handle_get_chroma_bits_per_pixel(handle);
+
+  uint32_t profileType = heif_image_handle_get_color_profile_type(handle);
+  if (profileType) {
+    out << ",\"color_profile\":\"" << json_escape(fourcc_to_string(profileType)) << "\"";
+  }
+
+  bool has_alpha = heif_image_handle_has_alpha_channel(handle);
+  out << ",\"alpha\":" << (has_alpha ? "true" : "false");
+  if (has_alpha) {
+    out << ",\"premultiplied_alpha\":" << (heif_image_handle_is_premultiplied_alpha(handle) ? "true" : "false");
+  }
+
+  // --- thumbnails
+
+  int nThumbnails = heif_image_handle_get_number_of_thumbnails(handle);
+  std::vector<heif_item_id> thumbnailIDs(nThumbnails);
+  nThumbnails = heif_image_handle_get_list_of_thumbnail_IDs(handle, thumbnailIDs.data(), nThumbnails);
+
+  out << ",\"thumbnails\":[";
+  for (int t = 0; t < nThumbnails; t++) {
+    heif_image_handle* thumbnail_handle;
+    err = heif_image_handle_get_thumbnail(handle, thumbnailIDs[t], &thumbnail_handle);
+    if (err.code) {
+      continue;
+    }
+
+    out << (t ? "," : "") << "{\"id\":" << thumbnailIDs[t]
+        << ",\"width\":" << heif_image_handle_get_width(thumbnail_handle)
+        << ",\"height\":" << heif_image_handle_get_height(thumbnail_handle) << "}";
+    heif_image_handle_release(thumbnail_handle);
+  }
+  out << "]";
+
+  // --- auxiliary images (the alpha channel is reported above)
+
+  int aux_filter = LIBHEIF_AUX_IMAGE_FILTER_OMIT_ALPHA;
+  int nAux = heif_image_handle_get_number_of_auxiliary_images(handle, aux_filter);
+  std::vector<heif_item_id> auxIDs(nAux);
+  nAux = heif_image_handle_get_list_of_auxiliary_image_IDs(handle, aux_filter, auxIDs.data(), nAux);
+
+  out << ",\"auxiliary\":[";
+  for (int a = 0; a < nAux; a++) {
+    heif_image_handle* aux_handle;
+    err = heif_image_handle_get_auxiliary_image_handle(handle, auxIDs[a], &aux_handle);
+    if (err.code) {
+      continue;
+    }
+
+    out << (a ? "," : "") << "{\"id\":" << auxIDs[a];
+
+    const char* aux_type = nullptr;
+    err = heif_image_handle_get_auxiliary_type(aux_handle, &aux_type);
+    if (err.code == heif_error_Ok && aux_type) {
+      out << ",\"type\":\"" << json_escape(aux_type) << "\"";
+      heif_image_handle_release_auxiliary_type(aux_handle, &aux_type);
+    }
+
+    out << ",\"width\":" << heif_image_handle_get_width(aux_handle)
+        << ",\"height\":" << heif_image_handle_get_height(aux_handle) << "}";
+    heif_image_handle_release(aux_handle);
+  }
+  out << "]";
+
+  // --- metadata
+
+  int numMetadata = heif_image_handle_get_number_of_metadata_blocks(handle, nullptr);
+  std::vector<heif_item_id> metadataIDs(numMetadata);
+  heif_image_handle_get_list_of_metadata_block_IDs(handle, nullptr, metadataIDs.data(), numMetadata);
+
+  out << ",\"metadata\":[";
+  for (int n = 0; n < numMetadata; n++) {
+    out << (n ? "," : "") << "{\"id\":" << metadataIDs[n]
+        << ",\"type\":\"" << json_escape(get_metadata_name(handle, metadataIDs[n])) << "\""
+        << ",\"size\":" << heif_image_handle_get_metadata_size(handle, metadataIDs[n]) << "}";
+  }
+  out << "]";
+
+  // --- region annotations. The number of regions is only known after reading the region item data.
+
+  int numRegionItems = heif_image_handle_get_number_of_region_items(handle);
+  std::vector<heif_item_id> regionItemIDs(numRegionItems);
+  heif_image_handle_get_list_of_region_item_ids(handle, regionItemIDs.data(), numRegionItems);
+
+  out << ",\"region_items\":[";
+  for (int r = 0; r < numRegionItems; r++) {
+    out << (r ? "," : "") << "{\"id\":" << regionItemIDs[r];
+
+    if (!option_no_decode) {
+      heif_region_item* region_item;
+      err = heif_context_get_region_item(ctx, regionItemIDs[r], &region_item);
+      if (err.code == heif_error_Ok) {
+        out << ",\"regions\":" << heif_region_item_get_number_of_regions(region_item);
+        heif_region_item_release(region_item);
+      }
+    }
+
+    out << "}";
+  }
+  out << "]}";
+}
+
+
+// Writes one line with a JSON record for the file. Returns the exit code, like main().
+static int write_json_record(std::ostream& out, const std::string& input_filename)
+{
+  out << "{\"file\":\"" << json_escape(input_filename) << "\"";
+
+  // --- file type
+
+  {
+    const static int bufSize = 50;
+
+    uint8_t buf[bufSize];
+    FILE* fh = fopen(input_filename.c_str(), "rb");
+    if (!fh) {
+      out << ",\"error\":\"" << json_escape(strerror(errno)) << "\"}\n";
+      return 10;
+    }
+
+    int n = (int) fread(buf, 1, bufSize, fh);
+    fclose(fh);
+
+    out << ",\"mime_type\":\"" << json_escape(heif_get_file_mime_type(buf, n)) << "\"";
+
+    heif_brand2* brands = nullptr;
+    int nBrands = 0;
+    heif_error err = heif_list_compatible_brands(buf, n, &brands, &nBrands);
+    if (err.code == heif_error_Ok) {
+      out << ",\"main_brand\":\"" << json_escape(fourcc_to_string(heif_read_main_brand(buf, n))) << "\""
+          << ",\"compatible_brands\":[";
+      for (int i = 0; i < nBrands; i++) {
+        out << (i ? "," : "") << "\"" << json_escape(fourcc_to_string(brands[i])) << "\"";
+      }
+      out << "]";
+
+      heif_free_list_of_compatible_brands(brands);
+    }
+  }
+
+  // --- read file structure
+
+  std::shared_ptr<heif_context> ctx(heif_context_alloc(),
+                                    [](heif_context* c) { heif_context_free(c); });
+
+  if (option_disable_limits) {
+    heif_context_set_security_limits(ctx.get(), heif_get_disabled_security_limits());
+  }
+
+  if (option_no_decode) {
+    heif_context_set_lazy_box_parsing(ctx.get(), 1);
+  }
+
+  heif_error err = heif_context_read_from_file(ctx.get(), input_filename.c_str(), nullptr);
+  if (err.code != heif_error_Ok) {
+    out << ",\"error\":\"" << json_escape(err.message) << "\"}\n";
+    return 1;
+  }
+
+  // --- images
+
+  int numImages = heif_context_get_number_of_top_level_images(ctx.get());
+  std::vector<heif_item_id> IDs(numImages);
+  heif_context_get_list_of_top_level_image_IDs(ctx.get(), IDs.data(), numImages);
+
+  out << ",\"images\":[";
+  bool first = true;
+  for (heif_item_id id : IDs) {
+    heif_image_handle* handle;
+    err = heif_context_get_image_handle(ctx.get(), id, &handle);
+    if (err.code) {
+      continue;
+    }
+
+    out << (first ? "" : ",");
+    first = false;
+
+    write_json_image(out, ctx.get(), handle, id);
+    heif_image_handle_release(handle);
+  }
+  out << "]";
+
+  // --- sequence tracks
+
+  uint32_t nTracks = heif_context_number_of_sequence_tracks(ctx.get());
+  if (nTracks > 0) {
+    out << ",\"sequence\":{\"timescale\":" << heif_context_get_sequence_timescale(ctx.get())
+        << ",\"duration\":" << heif_context_get_sequence_duration(ctx.get()) << "}";
+  }
+
+  std::vector<uint32_t> track_ids(nTracks);
+  if (nTracks > 0) {
+    heif_context_get_track_ids(ctx.get(), track_ids.data());
+  }
+
+  out << ",\"tracks\":[";
+  for (uint32_t t = 0; t < nTracks; t++) {
+    heif_track* track = heif_context_get_track(ctx.get(), track_ids[t]);
+    if (!track) {
+      continue;
+    }
+
+    heif_track_type handler = heif_track_get_track_handler_type(track);
+
+    out << (t ? "," : "") << "{\"id\":" << track_ids[t]
+        << ",\"handler\":\"" << json_escape(fourcc_to_string(handler)) << "\""
+        << ",\"sample_entry_type\":\"" << json_escape(fourcc_to_string(heif_track_get_sample_entry_type_of_first_cluster(track))) << "\"";
+
+    if (handler == heif_track_type_video ||
+        handler == heif_track_type_image_sequence) {
+      uint16_t w, h;
+      heif_track_get_image_resolution(track, &w, &h);
+      out << ",\"width\":" << w << ",\"height\":" << h;
+    }
+
+    out << "}";
+    heif_track_release(track);
+  }
+  out << "]}\n";
+
+  return 0;
+}
+
+
 class LibHeifInitializer
 {
 public:
@@ -125,6 +445,7 @@ int main(int argc, char** argv)
   bool write_raw_image = false;
   heif_item_id raw_image_id;
   std::string output_filename = "output.265";
+  std::string file_list;
 
   while (true) {
     int option_index = 0;
@@ -149,9 +470,56 @@ int main(int argc, char** argv)
       case 'v':
         show_version();
         return 0;
+      case OPTION_FILE_LIST:
+        file_list = optarg;
+        break;
     }
   }
 
+  if (option_json) {
+    // Many files are processed in one process, so that indexers do not have to start one process per file.
+
+    std::vector<std::string> input_filenames(argv + optind, argv + argc);
+
+    if (!file_list.empty()) {
+      std::ifstream list_file;
+      if (file_list != "-") {
+        list_file.open(file_list);
+        if (!list_file) {
+          std::cerr << "Cannot open file list '" << file_list << "'\n";
+          return 1;
+        }
+      }
+
+      std::istream& list = (file_list == "-") ? std::cin : list_file;
+      std::string line;
+      while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') {
+          line.pop_back();
+        }
+
+        if (!line.empty()) {
+          input_filenames.push_back(line);
+        }
+      }
+    }
+
+    if (input_filenames.empty()) {
+      show_help(argv[0]);
+      return 0;
+    }
+
+    int ret = 0;
+    for (const std::string& filename : input_filenames) {
+      int file_ret = write_json_record(std::cout, filename);
+      if (file_ret && ret == 0) {
+        ret = file_ret;
+      }
+    }
+
+    return ret;
+  }
+
   if (optind != argc - 1) {
     show_help(argv[0]);
     return 0;
@@ -454,22 +822,7 @@ int main(int argc, char** argv)
       heif_image_handle_get_list_of_metadata_block_IDs(handle, nullptr, ids.data(), numMetadata);
 
       for (int n = 0; n < numMetadata; n++) {
-        std::string itemtype = heif_image_handle_get_metadata_type(handle, ids[n]);
-        std::string contenttype = heif_image_handle_get_metadata_content_type(handle, ids[n]);
-        std::string item_uri_type = heif_image_handle_get_metadata_item_uri_type(handle, ids[n]);
-        std::string ID{"unknown"};
-        if (itemtype == "Exif") {
-          ID = itemtype;
-        }
-        else if (itemtype == "uri ") {
-          ID = itemtype + "/" + item_uri_type;
-        }
-        else if (contenttype == "application/rdf+xml") {
-          ID = "XMP";
-        }
-        else {
-          ID = itemtype + "/" + contenttype;
-        }
+        std::string ID = get_metadata_name(handle, ids[n]);
 
         printf("  %s: %zu bytes\n", ID.c_str(), heif_image_handle_get_metadata_size(handle, ids[n]));
       }
@@ -0,0 +1,623 @@
+/*
+  libheif example application "heif-synth".
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <libheif/heif.h>
+#include <libheif/heif_experimental.h>
+#include <libheif/heif_regions.h>
+#include <libheif/heif_sequences.h>
+#include "common.h"
+
+
+// --- command line options
+
+static std::string option_output;
+static heif_compression_format option_format = heif_compression_undefined;
+static int option_threads = 0;
+static uint32_t option_width = 256;
+static uint32_t option_height = 256;
+static uint32_t option_tile_size = 256;
+static uint32_t option_grid_columns = 0;
+static uint32_t option_grid_rows = 0;
+static uint32_t option_tili_columns = 0;
+static uint32_t option_tili_rows = 0;
+static uint32_t option_unci_columns = 0;
+static uint32_t option_unci_rows = 0;
+static int option_pyramid_layers = 0;
+static int option_items = 0;
+static uint32_t option_item_size = 64;
+static int option_regions = 0;
+static int option_frames = 0;
+static uint32_t option_frame_width = 64;
+static uint32_t option_frame_height = 64;
+
+
+#define OPTION_GRID 1000
+#define OPTION_TILI 1001
+#define OPTION_UNCI 1002
+#define OPTION_PYRAMID_LAYERS 1003
+#define OPTION_ITEMS 1004
+#define OPTION_ITEM_SIZE 1005
+#define OPTION_REGIONS 1006
+#define OPTION_FRAME_SIZE 1007
+
+static struct option long_options[] = {
+    {(char* const) "output",         required_argument, 0, 'o'},
+    {(char* const) "encoder",        required_argument, 0, 'e'},
+    {(char* const) "threads",        required_argument, 0, 't'},
+    {(char* const) "size",           required_argument, 0, 's'},
+    {(char* const) "tile-size",      required_argument, 0, 'T'},
+    {(char* const) "grid",           required_argument, 0, OPTION_GRID},
+    {(char* const) "tili",           required_argument, 0, OPTION_TILI},
+    {(char* const) "unci-tiles",     required_argument, 0, OPTION_UNCI},
+    {(char* const) "pyramid-layers", required_argument, 0, OPTION_PYRAMID_LAYERS},
+    {(char* const) "items",          required_argument, 0, OPTION_ITEMS},
+    {(char* const) "item-size",      required_argument, 0, OPTION_ITEM_SIZE},
+    {(char* const) "regions",        required_argument, 0, OPTION_REGIONS},
+    {(char* const) "frames",         required_argument, 0, 'F'},
+    {(char* const) "frame-size",     required_argument, 0, OPTION_FRAME_SIZE},
+    {(char* const) "help",           no_argument,       0, 'h'},
+    {(char* const) "version",        no_argument,       0, 'v'},
+    {0, 0,                                              0, 0}
+};
+
+
+static void show_help(const char* argv0)
+{
+  std::cerr << " heif-synth  libheif version: " << heif_get_version() << "\n"
+            << "-------------------------------------\n"
+            << "Usage: heif-synth [options] -o output.heif\n"
+            << "\n"
+            << "Generates files with synthetic content for scalability tests, e.g. with many items, large grids,\n"
+            << "pyramids, many regions or long sequences. The first image that is added becomes the primary image.\n"
+            << "To keep the generation fast, only a few different images are created and used repeatedly.\n"
+            << "\n"
+            << "Options:\n"
+            << "  -o, --output FILE         output file (required)\n"
+            << "  -e, --encoder FORMAT      compression: unci, hevc, av1, jpeg, j2k\n"
+            << "                            (default: unci when available, otherwise the first available encoder)\n"
+            << "  -t, --threads N           number of encoding threads (default: 0, encode in the calling thread)\n"
+            << "  -s, --size WxH            size of the primary image if no grid, tili or pyramid image is added\n"
+            << "                            (default: 256x256)\n"
+            << "  -T, --tile-size N         tile size of the grid, tili, unci and pyramid images (default: 256)\n"
+            << "      --grid CxR            add a grid image with C columns and R rows of tiles\n"
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+            << "      --tili CxR            add a 'tili' tiled image with C columns and R rows of tiles\n"
+            << "      --unci-tiles CxR      add a tiled 'unci' image with C columns and R rows of tiles\n"
+            << "      --pyramid-layers N    add a multi-resolution pyramid with N layers\n"
+#endif
+            << "      --items N             add N small images (default: 0)\n"
+            << "      --item-size N         size of the small images (default: 64)\n"
+            << "      --regions N           add N rectangle regions to the primary image (default: 0)\n"
+            << "  -F, --frames N            add a sequence track with N samples (default: 0)\n"
+            << "      --frame-size WxH      size of the sequence frames (default: 64x64)\n"
+            << "  -h, --help                show help\n"
+            << "  -v, --version             show version\n";
+}
+
+
+static void parse_size(const char* arg, const char* what, uint32_t* w, uint32_t* h)
+{
+  if (sscanf(arg, "%ux%u", w, h) != 2 || *w == 0 || *h == 0) {
+    std::cerr << "Invalid " << what << ", use the format " << (strcmp(what, "size") == 0 ? "WxH" : "CxR") << "\n";
+    exit(5);
+  }
+}
+
+
+static int parse_count(const char* arg)
+{
+  int n = atoi(arg);
+  if (n < 0) {
+    std::cerr << "Invalid count: " << arg << "\n";
+    exit(5);
+  }
+  return n;
+}
+
+
+static heif_compression_format parse_format(const std::string& name)
+{
+  if (name == "unci") return heif_compression_uncompressed;
+  if (name == "hevc") return heif_compression_HEVC;
+  if (name == "av1") return heif_compression_AV1;
+  if (name == "jpeg") return heif_compression_JPEG;
+  if (name == "j2k") return heif_compression_JPEG2000;
+
+  std::cerr << "Unknown encoder format: " << name << "\n";
+  exit(5);
+}
+
+
+static heif_compression_format select_format()
+{
+  if (option_format != heif_compression_undefined) {
+    return option_format;
+  }
+
+  for (heif_compression_format format : {heif_compression_uncompressed, heif_compression_HEVC, heif_compression_AV1,
+                                         heif_compression_JPEG2000, heif_compression_JPEG}) {
+    if (heif_have_encoder_for_format(format)) {
+      return format;
+    }
+  }
+
+  return heif_compression_undefined;
+}
+
+
+// --- synthetic content
+
+// Only a few different images of each size are generated. They are used cyclically for the tiles, items and frames.
+class SyntheticImages
+{
+public:
+  static const uint32_t kVariants = 4;
+
+  ~SyntheticImages()
+  {
+    for (auto& entry : m_images) {
+      heif_image_release(entry.second);
+    }
+  }
+
+  // Returns NULL if the image cannot be created.
+  const heif_image* get(uint32_t width, uint32_t height, uint32_t index)
+  {
+    auto key = std::make_tuple(width, height, index % kVariants);
+
+    auto iter = m_images.find(key);
+    if (iter != m_images.end()) {
+      return iter->second;
+    }
+
+    heif_image* img = create_synthetic_image(width, height, heif_colorspace_YCbCr, heif_chroma_420, 8, index % kVariants);
+    if (img) {
+      // display duration when used as a sequence frame
+      heif_image_set_duration(img, 1);
+
+      m_images[key] = img;
+    }
+
+    return img;
+  }
+
+private:
+  std::map<std::tuple<uint32_t, uint32_t, uint32_t>, heif_image*> m_images;
+};
+
+
+static heif_error error_cannot_create_image()
+{
+  return {heif_error_Memory_allocation_error, heif_suberror_Unspecified, "cannot create synthetic image"};
+}
+
+
+// --- file structures
+
+static heif_error add_grid(heif_context* ctx, heif_encoder* encoder, SyntheticImages& images,
+                           heif_image_handle** out_handle)
+{
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  heif_error err = heif_context_add_grid_image(ctx, option_grid_columns * option_tile_size, option_grid_rows * option_tile_size,
+                                               option_grid_columns, option_grid_rows, options, out_handle);
+  heif_encoding_options_free(options);
+
+  for (uint32_t ty = 0; ty < option_grid_rows && err.code == heif_error_Ok; ty++) {
+    for (uint32_t tx = 0; tx < option_grid_columns && err.code == heif_error_Ok; tx++) {
+      const heif_image* tile = images.get(option_tile_size, option_tile_size, ty * option_grid_columns + tx);
+      if (!tile) {
+        return error_cannot_create_image();
+      }
+
+      err = heif_context_add_image_tile(ctx, *out_handle, tx, ty, tile, encoder);
+    }
+  }
+
+  return err;
+}
+
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+static heif_error add_tili(heif_context* ctx, heif_encoder* encoder, SyntheticImages& images,
+                           heif_image_handle** out_handle)
+{
+  heif_tiled_image_parameters params{};
+  params.version = 1;
+  params.image_width = option_tili_columns * option_tile_size;
+  params.image_height = option_tili_rows * option_tile_size;
+  params.tile_width = option_tile_size;
+  params.tile_height = option_tile_size;
+  params.offset_field_length = 64;
+  params.size_field_length = 32;
+  params.tiles_are_sequential = 1;
+
+  heif_error err = heif_context_add_tiled_image(ctx, &params, nullptr, encoder, out_handle);
+
+  for (uint32_t ty = 0; ty < option_tili_rows && err.code == heif_error_Ok; ty++) {
+    for (uint32_t tx = 0; tx < option_tili_columns && err.code == heif_error_Ok; tx++) {
+      const heif_image* tile = images.get(option_tile_size, option_tile_size, ty * option_tili_columns + tx);
+      if (!tile) {
+        return error_cannot_create_image();
+      }
+
+      err = heif_context_add_image_tile(ctx, *out_handle, tx, ty, tile, encoder);
+    }
+  }
+
+  return err;
+}
+
+
+static heif_error add_unci_tiles(heif_context* ctx, SyntheticImages& images, heif_image_handle** out_handle)
+{
+  const heif_image* prototype = images.get(option_tile_size, option_tile_size, 0);
+  if (!prototype) {
+    return error_cannot_create_image();
+  }
+
+  heif_unci_image_parameters params{};
+  params.version = 1;
+  params.image_width = option_unci_columns * option_tile_size;
+  params.image_height = option_unci_rows * option_tile_size;
+  params.tile_width = option_tile_size;
+  params.tile_height = option_tile_size;
+  params.compression = heif_unci_compression_off;
+
+  heif_error err = heif_context_add_unci_image(ctx, &params, nullptr, prototype, out_handle);
+
+  for (uint32_t ty = 0; ty < option_unci_rows && err.code == heif_error_Ok; ty++) {
+    for (uint32_t tx = 0; tx < option_unci_columns && err.code == heif_error_Ok; tx++) {
+      const heif_image* tile = images.get(option_tile_size, option_tile_size, ty * option_unci_columns + tx);
+      if (!tile) {
+        return error_cannot_create_image();
+      }
+
+      err = heif_context_add_image_tile(ctx, *out_handle, tx, ty, tile, nullptr);
+    }
+  }
+
+  return err;
+}
+
+
+// The full resolution layer is chosen such that halving it 'option_pyramid_layers - 1' times gives a single tile.
+static heif_error add_pyramid(heif_context* ctx, heif_encoder* encoder, heif_image_handle** out_handle)
+{
+  uint32_t size = option_tile_size << (option_pyramid_layers - 1);
+
+  heif_image* img = create_synthetic_image(size, size, heif_colorspace_YCbCr, heif_chroma_420, 8, 0);
+  if (!img) {
+    return error_cannot_create_image();
+  }
+
+  heif_entity_group_id group_id;
+  heif_error err = heif_context_encode_pyramid(ctx, img, option_tile_size, option_tile_size, encoder, nullptr,
+                                               out_handle, &group_id);
+  heif_image_release(img);
+
+  return err;
+}
+#endif
+
+
+// A region item can hold at most 255 regions. Larger numbers are spread over several region items.
+static const int kMaxRegionsPerItem = 255;
+
+static heif_error add_regions(heif_image_handle* handle)
+{
+  uint32_t w = heif_image_handle_get_width(handle);
+  uint32_t h = heif_image_handle_get_height(handle);
+
+  // The rectangles are laid out on a regular raster over the image.
+
+  auto raster = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(option_regions))));
+  uint32_t cell_w = std::max(1U, w / raster);
+  uint32_t cell_h = std::max(1U, h / raster);
+
+  std::vector<int32_t> rects;
+  for (int i = 0; i < option_regions; i++) {
+    uint32_t cx = static_cast<uint32_t>(i) % raster;
+    uint32_t cy = static_cast<uint32_t>(i) / raster;
+    rects.push_back(static_cast<int32_t>(cx * cell_w));
+    rects.push_back(static_cast<int32_t>(cy * cell_h));
+    rects.push_back(static_cast<int32_t>(std::max(1U, cell_w / 2)));
+    rects.push_back(static_cast<int32_t>(std::max(1U, cell_h / 2)));
+  }
+
+  for (int first = 0; first < option_regions; first += kMaxRegionsPerItem) {
+    heif_region_item* region_item;
+    heif_error err = heif_image_handle_add_region_item(handle, w, h, &region_item);
+    if (err.code) {
+      return err;
+    }
+
+    int n = std::min(kMaxRegionsPerItem, option_regions - first);
+    err = heif_region_item_add_region_rectangles(region_item, rects.data() + 4 * first, n);
+    heif_region_item_release(region_item);
+
+    if (err.code) {
+      return err;
+    }
+  }
+
+  return heif_error_success;
+}
+
+
+static heif_error add_sequence(heif_context* ctx, heif_encoder* encoder, SyntheticImages& images)
+{
+  heif_track_info* info = heif_track_info_alloc();
+  info->track_timescale = 30;
+
+  heif_track* track = nullptr;
+  heif_error err = heif_context_add_visual_sequence_track(ctx, static_cast<uint16_t>(option_frame_width),
+                                                          static_cast<uint16_t>(option_frame_height), info,
+                                                          heif_track_type_video, &track);
+  heif_track_info_release(info);
+
+  for (int i = 0; i < option_frames && err.code == heif_error_Ok; i++) {
+    const heif_image* frame = images.get(option_frame_width, option_frame_height, static_cast<uint32_t>(i));
+    if (!frame) {
+      err = error_cannot_create_image();
+      break;
+    }
+
+    err = heif_track_encode_sequence_image(track, frame, encoder, nullptr);
+  }
+
+  if (err.code == heif_error_Ok) {
+    err = heif_track_encode_end_of_sequence(track, encoder);
+  }
+
+  heif_track_release(track);
+
+  return err;
+}
+
+
+// Generates the file. The primary image is the first image that is added.
+static heif_error generate(heif_context* ctx, heif_encoder* encoder)
+{
+  SyntheticImages images;
+  heif_image_handle* primary = nullptr;
+  heif_error err = heif_error_success;
+
+  auto set_primary = [&](heif_image_handle* handle) {
+    if (!primary) {
+      primary = handle;
+      return heif_context_set_primary_image(ctx, primary);
+    }
+
+    heif_image_handle_release(handle);
+    return heif_error_success;
+  };
+
+  if (option_grid_columns > 0) {
+    heif_image_handle* handle = nullptr;
+    err = add_grid(ctx, encoder, images, &handle);
+    if (err.code == heif_error_Ok) {
+      err = set_primary(handle);
+    }
+    else {
+      heif_image_handle_release(handle);
+    }
+  }
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+  if (err.code == heif_error_Ok && option_tili_columns > 0) {
+    heif_image_handle* handle = nullptr;
+    err = add_tili(ctx, encoder, images, &handle);
+    if (err.code == heif_error_Ok) {
+      err = set_primary(handle);
+    }
+    else {
+      heif_image_handle_release(handle);
+    }
+  }
+
+  if (err.code == heif_error_Ok && option_unci_columns > 0) {
+    heif_image_handle* handle = nullptr;
+    err = add_unci_tiles(ctx, images, &handle);
+    if (err.code == heif_error_Ok) {
+      err = set_primary(handle);
+    }
+    else {
+      heif_image_handle_release(handle);
+    }
+  }
+
+  if (err.code == heif_error_Ok && option_pyramid_layers > 0) {
+    heif_image_handle* handle = nullptr;
+    err = add_pyramid(ctx, encoder, &handle);
+    if (err.code == heif_error_Ok) {
+      err = set_primary(handle);
+    }
+    else {
+      heif_image_handle_release(handle);
+    }
+  }
+#endif
+
+  if (err.code == heif_error_Ok && !primary) {
+    const heif_image* img = images.get(option_width, option_height, 0);
+    heif_image_handle* handle = nullptr;
+    err = img ? heif_context_encode_image(ctx, img, encoder, nullptr, &handle) : error_cannot_create_image();
+    if (err.code == heif_error_Ok) {
+      err = set_primary(handle);
+    }
+  }
+
+  for (int i = 0; i < option_items && err.code == heif_error_Ok; i++) {
+    const heif_image* img = images.get(option_item_size, option_item_size, static_cast<uint32_t>(i));
+    err = img ? heif_context_encode_image(ctx, img, encoder, nullptr, nullptr) : error_cannot_create_image();
+  }
+
+  if (err.code == heif_error_Ok && option_regions > 0 && primary) {
+    err = add_regions(primary);
+  }
+
+  if (err.code == heif_error_Ok && option_frames > 0) {
+    err = add_sequence(ctx, encoder, images);
+  }
+
+  heif_image_handle_release(primary);
+
+  return err;
+}
+
+
+int main(int argc, char** argv)
+{
+  heif_init(nullptr);
+
+  while (true) {
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "o:e:t:s:T:F:hv", long_options, &option_index);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'o':
+        option_output = optarg;
+        break;
+      case 'e':
+        option_format = parse_format(optarg);
+        break;
+      case 't':
+        option_threads = parse_count(optarg);
+        break;
+      case 's':
+        parse_size(optarg, "size", &option_width, &option_height);
+        break;
+      case 'T':
+        option_tile_size = std::max(16, atoi(optarg));
+        break;
+      case OPTION_GRID:
+        parse_size(optarg, "grid", &option_grid_columns, &option_grid_rows);
+        if (option_grid_columns > 0xFFFF || option_grid_rows > 0xFFFF) {
+          std::cerr << "A grid can have at most 65535 columns and rows\n";
+          return 5;
+        }
+        break;
+      case OPTION_TILI:
+        parse_size(optarg, "tili", &option_tili_columns, &option_tili_rows);
+        break;
+      case OPTION_UNCI:
+        parse_size(optarg, "unci-tiles", &option_unci_columns, &option_unci_rows);
+        break;
+      case OPTION_PYRAMID_LAYERS:
+        option_pyramid_layers = std::min(parse_count(optarg), 16);
+        break;
+      case OPTION_ITEMS:
+        option_items = parse_count(optarg);
+        break;
+      case OPTION_ITEM_SIZE:
+        option_item_size = std::max(1, atoi(optarg));
+        break;
+      case OPTION_REGIONS:
+        option_regions = parse_count(optarg);
+        break;
+      case 'F':
+        option_frames = parse_count(optarg);
+        break;
+      case OPTION_FRAME_SIZE:
+        parse_size(optarg, "size", &option_frame_width, &option_frame_height);
+        if (option_frame_width > 0xFFFF || option_frame_height > 0xFFFF) {
+          std::cerr << "The frame size is limited to 65535x65535\n";
+          return 5;
+        }
+        break;
+      case 'h':
+        show_help(argv[0]);
+        heif_deinit();
+        return 0;
+      case 'v':
+        show_version();
+        heif_deinit();
+        return 0;
+      default:
+        show_help(argv[0]);
+        heif_deinit();
+        return 5;
+    }
+  }
+
+  if (option_output.empty()) {
+    show_help(argv[0]);
+    heif_deinit();
+    return 5;
+  }
+
+  heif_compression_format format = select_format();
+  if (format == heif_compression_undefined || !heif_have_encoder_for_format(format)) {
+    std::cerr << "no encoder available for the synthetic images\n";
+    heif_deinit();
+    return 1;
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, option_threads);
+
+  heif_encoder* encoder = nullptr;
+  heif_error err = heif_context_get_encoder_for_format(ctx, format, &encoder);
+  if (err.code == heif_error_Ok) {
+    heif_encoder_set_lossy_quality(encoder, 90);
+
+    err = generate(ctx, encoder);
+  }
+
+  if (err.code == heif_error_Ok) {
+    err = heif_context_write_to_file(ctx, option_output.c_str());
+  }
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  if (err.code != heif_error_Ok) {
+    std::cerr << "cannot generate " << option_output << ": " << err.message << "\n";
+    heif_deinit();
+    return 1;
+  }
+
+  heif_deinit();
+
+  return 0;
+}
@@ -100,6 +100,9 @@ int main(int argc, char** argv)
   std::shared_ptr<heif_context> context(heif_context_alloc(),
                                         [](heif_context* c) { heif_context_free(c); });
 
+  // Only the still images are needed. The sample tables of image sequences are not parsed.
+  heif_context_set_lazy_box_parsing(context.get(), 1);
+
   struct heif_error err;
   err = heif_context_read_from_file(context.get(), input_filename.c_str(), nullptr);
   if (err.code != 0) {
@@ -119,29 +122,7 @@ int main(int argc, char** argv)
   }
 
 
-  // --- if image has a thumbnail, use that instead
-
-  if (!thumbnail_from_primary_image_only) {
-    heif_item_id thumbnail_ID;
-    int nThumbnails = heif_image_handle_get_list_of_thumbnail_IDs(image_handle, &thumbnail_ID, 1);
-    if (nThumbnails > 0) {
-      struct heif_image_handle* thumbnail_handle;
-      err = heif_image_handle_get_thumbnail(image_handle, thumbnail_ID, &thumbnail_handle);
-      if (err.code) {
-        std::cerr << "Could not read HEIF image : " << err.message << "\n";
-        return 1;
-      }
-
-      // replace image handle with thumbnail handle
-
-      heif_image_handle_release(image_handle);
-      image_handle = thumbnail_handle;
-    }
-  }
-
-
-
-  // --- decode the image (or its thumbnail)
+  // --- decode the image
 
   std::unique_ptr<Encoder> encoder(new PngEncoder());
 
@@ -152,58 +133,89 @@ int main(int argc, char** argv)
   int bit_depth = 8;
 
   struct heif_image* image = NULL;
-  err = heif_decode_image(image_handle,
-                          &image,
-                          encoder->colorspace(false),
-                          encoder->chroma(false, bit_depth),
-                          decode_options);
-  if (err.code) {
-    std::cerr << "Could not decode HEIF image : " << err.message << "\n";
-    return 1;
+
+  if (!thumbnail_from_primary_image_only) {
+    // Decodes the smallest sufficiently large thumbnail or pyramid layer, if there is one.
+
+    err = heif_decode_image_at_size(image_handle,
+                                    &image,
+                                    encoder->colorspace(false),
+                                    encoder->chroma(false, bit_depth),
+                                    decode_options,
+                                    size, size);
+    if (err.code) {
+      std::cerr << "Could not decode HEIF image : " << err.message << "\n";
+      return 1;
+    }
+
+    assert(image);
   }
+  else {
+    // --- compute output thumbnail size
+
+    int input_width = heif_image_handle_get_width(image_handle);
+    int input_height = heif_image_handle_get_height(image_handle);
 
-  assert(image);
+    bool scale_down = (input_width > size || input_height > size);
+    int thumbnail_width = input_width;
+    int thumbnail_height = input_height;
 
-  // --- compute output thumbnail size
+    if (scale_down) {
+      if (input_width > input_height) {
+        thumbnail_height = input_height * size / input_width;
+        thumbnail_width = size;
+      }
+      else if (input_height > 0) {
+        thumbnail_width = input_width * size / input_height;
+        thumbnail_height = size;
+      }
+      else {
+        thumbnail_width = thumbnail_height = 0;
+      }
 
-  int input_width = heif_image_handle_get_width(image_handle);
-  int input_height = heif_image_handle_get_height(image_handle);
+      if (thumbnail_width == 0 || thumbnail_height == 0) {
+        std::cerr << "Zero thumbnail output size\n";
+        return 1;
+      }
 
-  if (input_width > size || input_height > size) {
-    int thumbnail_width;
-    int thumbnail_height;
+      // Let codecs that support it (JPEG, JPEG 2000) skip the resolution that is discarded by the scaling anyway.
 
-    if (input_width > input_height) {
-      thumbnail_height = input_height * size / input_width;
-      thumbnail_width = size;
-    }
-    else if (input_height > 0) {
-      thumbnail_width = input_width * size / input_height;
-      thumbnail_height = size;
-    }
-    else {
-      thumbnail_width = thumbnail_height = 0;
+      for (int d = 2; d <= 8; d *= 2) {
+        if ((input_width + d - 1) / d < thumbnail_width || (input_height + d - 1) / d < thumbnail_height) {
+          break;
+        }
+        decode_options->target_scale_denominator = static_cast<uint8_t>(d);
+      }
     }
 
-    if (thumbnail_width == 0 || thumbnail_height == 0) {
-      std::cerr << "Zero thumbnail output size\n";
+    err = heif_decode_image(image_handle,
+                            &image,
+                            encoder->colorspace(false),
+                            encoder->chroma(false, bit_depth),
+                            decode_options);
+    if (err.code) {
+      std::cerr << "Could not decode HEIF image : " << err.message << "\n";
       return 1;
     }
 
+    assert(image);
 
-    // --- output thumbnail smaller than HEIF thumbnail -> scale down
+    if (scale_down && (heif_image_get_primary_width(image) != thumbnail_width ||
+                       heif_image_get_primary_height(image) != thumbnail_height)) {
+      // --- scale down
 
-    struct heif_image* scaled_image = NULL;
-    err = heif_image_scale_image(image, &scaled_image,
-                                 thumbnail_width, thumbnail_height,
-                                 NULL);
-    if (err.code) {
-      std::cerr << "Could not scale image : " << err.message << "\n";
-      return 1;
-    }
+      struct heif_image* scaled_image = NULL;
+      err = heif_image_scale_image(image, &scaled_image,
+                                   thumbnail_width, thumbnail_height,
+                                   NULL);
+      if (err.code) {
+        std::cerr << "Could not scale image : " << err.message << "\n";
+        return 1;
+      }
 
-    heif_image_release(image);
-    image = scaled_image;
+      heif_image_release(image);
+      image = scaled_image;
+    }
   }
 
 
@@ -71,6 +71,8 @@ static void show_help(const char* argv0)
                "      --list-decoders            list all available decoders (built-in and plugins)\n"
                "  -d, --decoder ID               use a specific decoder (see --list-decoders)\n"
                "      --speedup FACTOR           increase playback speed by FACTOR\n"
+               "      --lookahead N              decode up to N frames ahead in the background (default: 4, 0 = off)\n"
+               "      --no-frame-drop            show all frames, even when decoding is slower than real-time\n"
                "      --show-sai                 show sample auxiliary information\n"
                "      --show-frame-duration      show each frame duration in milliseconds\n"
                "      --show-track-metadata      show metadata attached to the track (e.g. TAI config)\n"
@@ -96,6 +98,8 @@ private:
 
 int option_list_decoders = 0;
 double option_speedup = 1.0;
+int option_lookahead = 4;
+int option_no_frame_drop = 0;
 bool option_show_sai = false;
 bool option_show_frame_duration = false;
 bool option_show_track_metadata = false;
@@ -112,6 +116,7 @@ const int OPTION_SHOW_TRACK_METADATA = 1003;
 const int OPTION_SHOW_ALL = 1004;
 const int OPTION_SHOW_METADATA_TEXT = 1005;
 const int OPTION_SHOW_METADATA_HEX = 1006;
+const int OPTION_LOOKAHEAD = 1007;
 
 static struct option long_options[] = {
     {(char* const) "decoder",             required_argument, 0,                     'd'},
@@ -119,6 +124,8 @@ static struct option long_options[] = {
     {(char* const) "help",                no_argument,       0,                     'h'},
     {(char* const) "version",             no_argument,       0,                     'v'},
     {(char* const) "speedup",             required_argument, 0,                     OPTION_SPEEDUP},
+    {(char* const) "lookahead",           required_argument, 0,                     OPTION_LOOKAHEAD},
+    {(char* const) "no-frame-drop",       no_argument,       &option_no_frame_drop, 1},
     {(char* const) "show-sai",            no_argument,       0,                     OPTION_SHOW_SAI},
     {(char* const) "show-frame-duration", no_argument,       0,                     OPTION_SHOW_FRAME_DURATION},
     {(char* const) "show-track-metadata", no_argument,       0,                     OPTION_SHOW_TRACK_METADATA},
@@ -195,6 +202,13 @@ int main(int argc, char** argv)
           return 5;
         }
         break;
+      case OPTION_LOOKAHEAD:
+        option_lookahead = atoi(optarg);
+        if (option_lookahead < 0) {
+          std::cerr << "Lookahead must not be negative.\n";
+          return 5;
+        }
+        break;
       case OPTION_SHOW_SAI:
         option_show_sai = true;
         show_frame_number = true;
@@ -318,6 +332,11 @@ int main(int argc, char** argv)
   decode_options->convert_hdr_to_8bit = true;
   decode_options->decoder_id = decoder_id;
 
+  // While a frame is waiting for its presentation time, the next frames are decoded in the background.
+  heif_track_set_decoding_lookahead(track, option_lookahead);
+
+  uint64_t num_dropped_frames = 0;
+
 
   // --- decoding loop
 
@@ -351,26 +370,36 @@ int main(int argc, char** argv)
     static const uint64_t start_time = SDL_GetTicks64();
     static uint64_t next_frame_pts = 0;
 
+    uint64_t frame_pts = next_frame_pts;
+    next_frame_pts += static_cast<uint64_t>(static_cast<double>(duration_ms) / option_speedup);
+
     uint64_t now_time = SDL_GetTicks64();
     uint64_t elapsed_time = (now_time - start_time);
-    if (elapsed_time < next_frame_pts) {
-      SDL_Delay(next_frame_pts - elapsed_time);
+    if (elapsed_time < frame_pts) {
+      SDL_Delay(static_cast<Uint32>(frame_pts - elapsed_time));
     }
 
-    next_frame_pts += static_cast<uint64_t>(static_cast<double>(duration_ms) / option_speedup);
+    // When decoding fell behind, frames whose display time has already passed are not shown,
+    // such that the playback catches up with the clock.
+    bool drop_frame = !option_no_frame_drop && elapsed_time >= next_frame_pts;
 
 
     // --- display image
 
-    size_t stride_Y, stride_Cb, stride_Cr;
-    const uint8_t* p_Y = heif_image_get_plane_readonly2(out_image, heif_channel_Y, &stride_Y);
-    const uint8_t* p_Cb = heif_image_get_plane_readonly2(out_image, heif_channel_Cb, &stride_Cb);
-    const uint8_t* p_Cr = heif_image_get_plane_readonly2(out_image, heif_channel_Cr, &stride_Cr);
+    if (drop_frame) {
+      num_dropped_frames++;
+    }
+    else {
+      size_t stride_Y, stride_Cb, stride_Cr;
+      const uint8_t* p_Y = heif_image_get_plane_readonly2(out_image, heif_channel_Y, &stride_Y);
+      const uint8_t* p_Cb = heif_image_get_plane_readonly2(out_image, heif_channel_Cb, &stride_Cb);
+      const uint8_t* p_Cr = heif_image_get_plane_readonly2(out_image, heif_channel_Cr, &stride_Cr);
 
-    sdlWindow.display(p_Y, p_Cb, p_Cr, stride_Y, stride_Cb);
+      sdlWindow.display(p_Y, p_Cb, p_Cr, static_cast<int>(stride_Y), static_cast<int>(stride_Cb));
+    }
 
     if (show_frame_number) {
-      std::cout << "--- frame " << frameNr << "\n";
+      std::cout << "--- frame " << frameNr << (drop_frame ? " (dropped)" : "") << "\n";
     }
 
     if (option_show_sai) {
@@ -446,6 +475,10 @@ int main(int argc, char** argv)
 
   sdlWindow.close();
 
+  if (num_dropped_frames > 0) {
+    std::cerr << num_dropped_frames << " frames were dropped because decoding was slower than real-time\n";
+  }
+
   heif_track_release(track);
   heif_track_release(metadata_track);
 
@@ -66,7 +66,7 @@ bool SDL_YUV_Display::init(int frame_width, int frame_height, enum SDL_Chroma ch
   Uint32 pixelFormat = 0;
   switch (mChroma) {
   case SDL_CHROMA_MONO: pixelFormat = SDL_PIXELFORMAT_YV12; break;
-  case SDL_CHROMA_420:  pixelFormat = SDL_PIXELFORMAT_YV12; break;
+  case SDL_CHROMA_420:  pixelFormat = SDL_PIXELFORMAT_IYUV; break; // planes are uploaded directly, see display()
   case SDL_CHROMA_422:  pixelFormat = SDL_PIXELFORMAT_YV12; break;
   case SDL_CHROMA_444:  pixelFormat = SDL_PIXELFORMAT_YV12; break;
   //case SDL_CHROMA_444:  pixelFormat = SDL_PIXELFORMAT_YV12; break;
@@ -100,13 +100,21 @@ void SDL_YUV_Display::display(const unsigned char *Y,
                               int stride, int chroma_stride)
 {
   if (!mWindowOpen) return;
-  if (SDL_LockTexture(mTexture, nullptr,
-    reinterpret_cast<void**>(&mPixels), &mStride) < 0) return;
 
   if (mChroma == SDL_CHROMA_420) {
-    display420(Y,U,V,stride,chroma_stride);
+    // The decoded planes are uploaded without copying them into a locked texture first.
+    // SDL handles the different strides and may convert on the GPU.
+    if (SDL_UpdateYUVTexture(mTexture, &rect, Y, stride, U, chroma_stride, V, chroma_stride) < 0) return;
+
+    SDL_RenderCopy(mRenderer, mTexture, nullptr, nullptr);
+    SDL_RenderPresent(mRenderer);
+    return;
   }
-  else if (mChroma == SDL_CHROMA_422) {
+
+  if (SDL_LockTexture(mTexture, nullptr,
+    reinterpret_cast<void**>(&mPixels), &mStride) < 0) return;
+
+  if (mChroma == SDL_CHROMA_422) {
     display422(Y,U,V,stride,chroma_stride);
   }
   else if (mChroma == SDL_CHROMA_444) {
@@ -124,41 +132,6 @@ void SDL_YUV_Display::display(const unsigned char *Y,
 }
 
 
-void SDL_YUV_Display::display420(const unsigned char *Y,
-                                 const unsigned char *U,
-                                 const unsigned char *V,
-                                 int stride, int chroma_stride)
-{
-  if (stride == mStride && chroma_stride == mStride/2) {
-
-    // fast copy
-
-    memcpy(mPixels, Y, rect.w * rect.h);
-    memcpy(&mPixels[rect.w * rect.h], V, rect.w * rect.h / 4);
-    memcpy(&mPixels[(rect.w * rect.h) + (rect.w * rect.h / 4)], U, rect.w * rect.h / 4);
-  }
-  else {
-    // copy line by line, because sizes are different
-    uint8_t *dest = mPixels;
-
-    for (int y=0;y<rect.h;y++,dest+=mStride)
-      {
-        memcpy(dest, Y+stride*y, rect.w);
-      }
-
-    for (int y=0;y<rect.h/2;y++,dest+=mStride/2)
-      {
-        memcpy(dest, V+chroma_stride*y, rect.w/2);
-      }
-
-    for (int y=0;y<rect.h/2;y++,dest+=mStride/2)
-      {
-        memcpy(dest, U+chroma_stride*y, rect.w/2);
-      }
-  }
-}
-
-
 void SDL_YUV_Display::display400(const unsigned char *Y, int stride)
 {
   uint8_t *dest = mPixels;
@@ -60,10 +60,6 @@ private:
 
   void display400(const unsigned char *Y,
                   int stride);
-  void display420(const unsigned char *Y,
-                  const unsigned char *U,
-                  const unsigned char *V,
-                  int stride, int chroma_stride);
   void display422(const unsigned char *Y,
                   const unsigned char *U,
                   const unsigned char *V,
@@ -22,6 +22,7 @@
 
 #include <gdk-pixbuf/gdk-pixbuf-io.h>
 #include <libheif/heif.h>
+#include <string.h>
 
 
 G_MODULE_EXPORT void fill_vtable(GdkPixbufModule* module);
@@ -36,9 +37,82 @@ typedef struct
   GdkPixbufModuleSizeFunc size_func;
   gpointer user_data;
   GByteArray* data;
+
+  // Read position of the heif_reader in 'data'.
+  gint64 read_pos;
+
+  // The file is parsed as soon as its header has been received. NULL until then.
+  struct heif_context* hc;
+
+  // Output size returned by the size function. Only valid if 'size_known' is set.
+  gboolean size_known;
+  int requested_width, requested_height;
+
+  // Next data size at which we try to parse the header and decode the image. This is doubled after each
+  // try, such that the number of tries only grows logarithmically with the file size.
+  guint next_load_size;
+
+  // The image has been delivered. Further data is not needed.
+  gboolean loaded;
 } HeifPixbufCtx;
 
 
+static int64_t reader_get_position(void* userdata)
+{
+  return ((HeifPixbufCtx*) userdata)->read_pos;
+}
+
+
+static int reader_read(void* data, size_t size, void* userdata)
+{
+  HeifPixbufCtx* hpc = (HeifPixbufCtx*) userdata;
+
+  if (hpc->read_pos < 0 || (guint64) hpc->read_pos + size > hpc->data->len) {
+    return 1;
+  }
+
+  memcpy(data, hpc->data->data + hpc->read_pos, size);
+  hpc->read_pos += size;
+  return 0;
+}
+
+
+static int reader_seek(int64_t position, void* userdata)
+{
+  HeifPixbufCtx* hpc = (HeifPixbufCtx*) userdata;
+
+  if (position < 0 || (guint64) position > hpc->data->len) {
+    return 1;
+  }
+
+  hpc->read_pos = position;
+  return 0;
+}
+
+
+// We cannot wait for data. If it has not been received yet, the read fails and is tried again later.
+static enum heif_reader_grow_status reader_wait_for_file_size(int64_t target_size, void* userdata)
+{
+  HeifPixbufCtx* hpc = (HeifPixbufCtx*) userdata;
+
+  if (target_size <= (int64_t) hpc->data->len) {
+    return heif_reader_grow_status_size_reached;
+  }
+  else {
+    return heif_reader_grow_status_size_beyond_eof;
+  }
+}
+
+
+static struct heif_reader reader = {
+    1,
+    reader_get_position,
+    reader_read,
+    reader_seek,
+    reader_wait_for_file_size
+};
+
+
 static gpointer begin_load(GdkPixbufModuleSizeFunc size_func,
                            GdkPixbufModulePreparedFunc prepare_func,
                            GdkPixbufModuleUpdatedFunc update_func,
@@ -46,6 +120,13 @@ static gpointer begin_load(GdkPixbufModuleSizeFunc size_func,
                            GError** error)
 {
   HeifPixbufCtx* hpc;
+  struct heif_error err;
+
+  err = heif_init(NULL);
+  if (err.code != heif_error_Ok) {
+    g_set_error(error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_FAILED, "%s", err.message);
+    return NULL;
+  }
 
   hpc = g_new0(HeifPixbufCtx, 1);
   hpc->data = g_byte_array_new();
@@ -53,6 +134,7 @@ static gpointer begin_load(GdkPixbufModuleSizeFunc size_func,
   hpc->prepare_func = prepare_func;
   hpc->update_func = update_func;
   hpc->user_data = user_data;
+  hpc->next_load_size = 64 * 1024;
   return hpc;
 }
 
@@ -63,11 +145,11 @@ static void release_heif_image(guchar* pixels, gpointer data)
 }
 
 
-static gboolean stop_load(gpointer context, GError** error)
+// Tries to decode the image from the data received so far. When 'complete' is FALSE, failures are expected
+// while data is missing and no warnings are shown.
+static gboolean load_image(HeifPixbufCtx* hpc, gboolean complete)
 {
-  HeifPixbufCtx* hpc;
   struct heif_error err;
-  struct heif_context* hc = NULL;
   struct heif_image_handle* hdl = NULL;
   struct heif_image* img = NULL;
   int width, height, stride;
@@ -77,27 +159,28 @@ static gboolean stop_load(gpointer context, GError** error)
   gboolean result;
 
   result = FALSE;
-  hpc = (HeifPixbufCtx*) context;
 
-  err = heif_init(NULL);
-  if (err.code != heif_error_Ok) {
-    g_warning("%s", err.message);
-    goto cleanup;
-  }
+  if (!hpc->hc) {
+    hpc->hc = heif_context_alloc();
+    if (!hpc->hc) {
+      g_warning("cannot allocate heif_context");
+      goto cleanup;
+    }
 
-  hc = heif_context_alloc();
-  if (!hc) {
-    g_warning("cannot allocate heif_context");
-    goto cleanup;
-  }
+    hpc->read_pos = 0;
+    err = heif_context_read_from_reader(hpc->hc, &reader, hpc, NULL);
+    if (err.code != heif_error_Ok) {
+      if (complete) {
+        g_warning("%s", err.message);
+      }
 
-  err = heif_context_read_from_memory_without_copy(hc, hpc->data->data, hpc->data->len, NULL);
-  if (err.code != heif_error_Ok) {
-    g_warning("%s", err.message);
-    goto cleanup;
+      heif_context_free(hpc->hc);
+      hpc->hc = NULL;
+      goto cleanup;
+    }
   }
 
-  err = heif_context_get_primary_image_handle(hc, &hdl);
+  err = heif_context_get_primary_image_handle(hpc->hc, &hdl);
   if (err.code != heif_error_Ok) {
     g_warning("%s", err.message);
     goto cleanup;
@@ -105,26 +188,58 @@ static gboolean stop_load(gpointer context, GError** error)
 
   int has_alpha = heif_image_handle_has_alpha_channel(hdl);
 
-  err = heif_decode_image(hdl, &img, heif_colorspace_RGB,
-                          has_alpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
-                          NULL);
+  width = heif_image_handle_get_width(hdl);
+  height = heif_image_handle_get_height(hdl);
+
+  if (!hpc->size_known) {
+    hpc->requested_width = width;
+    hpc->requested_height = height;
+
+    if (hpc->size_func) {
+      (*hpc->size_func)(&hpc->requested_width, &hpc->requested_height, hpc->user_data);
+    }
+
+    hpc->size_known = TRUE;
+  }
+
+  requested_width = hpc->requested_width;
+  requested_height = hpc->requested_height;
+
+  // The application only wants to know the image size.
+  if (requested_width == 0 || requested_height == 0) {
+    result = TRUE;
+    goto cleanup;
+  }
+
+  // For a smaller size, decode the smallest sufficiently large thumbnail or pyramid layer. Only its data is needed.
+  if (requested_width > 0 && requested_height > 0 && (requested_width < width || requested_height < height)) {
+    err = heif_decode_image_at_size(hdl, &img, heif_colorspace_RGB,
+                                    has_alpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
+                                    NULL, requested_width, requested_height);
+  }
+  else {
+    err = heif_decode_image(hdl, &img, heif_colorspace_RGB,
+                            has_alpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
+                            NULL);
+  }
   if (err.code != heif_error_Ok) {
-    g_warning("%s", err.message);
+    if (complete) {
+      g_warning("%s", err.message);
+    }
     goto cleanup;
   }
 
   width = heif_image_get_width(img, heif_channel_interleaved);
   height = heif_image_get_height(img, heif_channel_interleaved);
-  requested_width = width;
-  requested_height = height;
-
-  if (hpc->size_func) {
-    (*hpc->size_func)(&requested_width, &requested_height, hpc->user_data);
-  }
 
+  // heif_decode_image_at_size() keeps the aspect ratio, the size function might not.
   if (requested_width > 0 && requested_height > 0 && (width != requested_width || height != requested_height)) {
     struct heif_image* resized;
-    heif_image_scale_image(img, &resized, requested_width, requested_height, NULL);
+    err = heif_image_scale_image(img, &resized, requested_width, requested_height, NULL);
+    if (err.code != heif_error_Ok) {
+      g_warning("%s", err.message);
+      goto cleanup;
+    }
     heif_image_release(img);
     width = requested_width;
     height = requested_height;
@@ -178,8 +293,25 @@ static gboolean stop_load(gpointer context, GError** error)
     heif_image_handle_release(hdl);
   }
 
-  if (hc) {
-    heif_context_free(hc);
+  if (result) {
+    hpc->loaded = TRUE;
+  }
+
+  return result;
+}
+
+
+static gboolean stop_load(gpointer context, GError** error)
+{
+  HeifPixbufCtx* hpc;
+  gboolean result;
+
+  hpc = (HeifPixbufCtx*) context;
+
+  result = hpc->loaded || load_image(hpc, TRUE);
+
+  if (hpc->hc) {
+    heif_context_free(hpc->hc);
   }
 
   g_byte_array_free(hpc->data, TRUE);
@@ -193,8 +325,20 @@ static gboolean stop_load(gpointer context, GError** error)
 
 static gboolean load_increment(gpointer context, const guchar* buf, guint size, GError** error)
 {
-  HeifPixbufCtx* ctx = (HeifPixbufCtx*) context;
-  g_byte_array_append(ctx->data, buf, size);
+  HeifPixbufCtx* hpc = (HeifPixbufCtx*) context;
+
+  // The rest of the file is not needed, e.g. when we decoded a thumbnail that is stored before the main image.
+  if (hpc->loaded) {
+    return TRUE;
+  }
+
+  g_byte_array_append(hpc->data, buf, size);
+
+  if (hpc->data->len >= hpc->next_load_size) {
+    hpc->next_load_size = hpc->data->len > G_MAXUINT / 2 ? G_MAXUINT : hpc->data->len * 2;
+    load_image(hpc, FALSE);
+  }
+
   return TRUE;
 }
 
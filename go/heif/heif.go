@@ -32,6 +32,15 @@ package heif
 #include <stdlib.h>
 #include <string.h> // We use 'memcpy'
 #include <libheif/heif.h>
+
+// Go code may not pass an array of Go pointers to C, so the plane array is set up here.
+static struct heif_error decode_image_into_rgba(const struct heif_image_handle* handle, uint8_t* data, size_t stride,
+                                                const struct heif_decoding_options* options)
+{
+  uint8_t* planes[1] = {data};
+  size_t strides[1] = {stride};
+  return heif_decode_image_into(handle, heif_colorspace_RGB, heif_chroma_interleaved_RGBA, planes, strides, options);
+}
 */
 import "C"
 
@@ -42,6 +51,7 @@ import (
 	"io"
 	"io/ioutil"
 	"runtime"
+	"sync"
 	"unsafe"
 )
 
@@ -743,6 +753,84 @@ func (h *ImageHandle) DecodeImage(colorspace Colorspace, chroma Chroma, options
 	return &image, nil
 }
 
+// DecodeImageToRGBA decodes the image directly into the pixel buffer of "dst",
+// which must have the size of the image. The decoded pixels are copied once from
+// the libheif image into "dst" without intermediate Go buffers.
+func (h *ImageHandle) DecodeImageToRGBA(dst *image.RGBA, options *DecodingOptions) error {
+	img, err := h.DecodeImage(ColorspaceRGB, ChromaInterleavedRGBA, options)
+	if err != nil {
+		return err
+	}
+
+	width := img.GetWidth(ChannelInterleaved)
+	height := img.GetHeight(ChannelInterleaved)
+	if dst.Rect.Dx() != width || dst.Rect.Dy() != height {
+		return fmt.Errorf("Destination size %dx%d does not match image size %dx%d",
+			dst.Rect.Dx(), dst.Rect.Dy(), width, height)
+	}
+
+	rgba, err := img.GetPlaneView(ChannelInterleaved)
+	if err != nil {
+		return err
+	}
+	return rgba.copyPlaneTo(dst.Pix, dst.PixOffset(dst.Rect.Min.X, dst.Rect.Min.Y), dst.Stride, width*4)
+}
+
+// DecodeImageToYCbCr decodes the image directly into the planes of "dst", which
+// must have the size of the image. The chroma format is taken from the subsample
+// ratio of "dst". Only images with 8 bits per pixel are supported.
+func (h *ImageHandle) DecodeImageToYCbCr(dst *image.YCbCr, options *DecodingOptions) error {
+	var chroma Chroma
+	switch dst.SubsampleRatio {
+	case image.YCbCrSubsampleRatio420:
+		chroma = Chroma420
+	case image.YCbCrSubsampleRatio422:
+		chroma = Chroma422
+	case image.YCbCrSubsampleRatio444:
+		chroma = Chroma444
+	default:
+		return fmt.Errorf("Unsupported YCbCr subsample ratio: %v", dst.SubsampleRatio)
+	}
+
+	img, err := h.DecodeImage(ColorspaceYCbCr, chroma, options)
+	if err != nil {
+		return err
+	}
+
+	width := img.GetWidth(ChannelY)
+	height := img.GetHeight(ChannelY)
+	if dst.Rect.Dx() != width || dst.Rect.Dy() != height {
+		return fmt.Errorf("Destination size %dx%d does not match image size %dx%d",
+			dst.Rect.Dx(), dst.Rect.Dy(), width, height)
+	}
+	if bpp := img.GetBitsPerPixel(ChannelY); bpp != 8 {
+		return fmt.Errorf("Unsupported bits per pixel: %d", bpp)
+	}
+
+	y, err := img.GetPlaneView(ChannelY)
+	if err != nil {
+		return err
+	}
+	cb, err := img.GetPlaneView(ChannelCb)
+	if err != nil {
+		return err
+	}
+	cr, err := img.GetPlaneView(ChannelCr)
+	if err != nil {
+		return err
+	}
+
+	if err := y.copyPlaneTo(dst.Y, dst.YOffset(dst.Rect.Min.X, dst.Rect.Min.Y), dst.YStride, width); err != nil {
+		return err
+	}
+	chromaWidth := img.GetWidth(ChannelCb)
+	chromaOffset := dst.COffset(dst.Rect.Min.X, dst.Rect.Min.Y)
+	if err := cb.copyPlaneTo(dst.Cb, chromaOffset, dst.CStride, chromaWidth); err != nil {
+		return err
+	}
+	return cr.copyPlaneTo(dst.Cr, chromaOffset, dst.CStride, chromaWidth)
+}
+
 func (img *Image) GetColorspace() Colorspace {
 	cs := Colorspace(C.heif_image_get_colorspace(img.image))
 	runtime.KeepAlive(img)
@@ -828,15 +916,15 @@ func (img *Image) GetImage() (image.Image, error) {
 	case ColorspaceRGB:
 		switch cf {
 		case Chroma444:
-			r, err := img.GetPlane(ChannelR)
+			r, err := img.GetPlaneView(ChannelR)
 			if err != nil {
 				return nil, err
 			}
-			g, err := img.GetPlane(ChannelG)
+			g, err := img.GetPlaneView(ChannelG)
 			if err != nil {
 				return nil, err
 			}
-			b, err := img.GetPlane(ChannelB)
+			b, err := img.GetPlaneView(ChannelB)
 			if err != nil {
 				return nil, err
 			}
@@ -955,7 +1043,7 @@ func (img *Image) GetImage() (image.Image, error) {
 				}
 			}
 		case ChromaInterleavedRGB:
-			rgb, err := img.GetPlane(ChannelInterleaved)
+			rgb, err := img.GetPlaneView(ChannelInterleaved)
 			if err != nil {
 				return nil, err
 			}
@@ -1010,7 +1098,7 @@ func (img *Image) GetImage() (image.Image, error) {
 				},
 			}
 		case ChromaInterleavedRRGGBB_BE:
-			rgb, err := img.GetPlane(ChannelInterleaved)
+			rgb, err := img.GetPlaneView(ChannelInterleaved)
 			if err != nil {
 				return nil, err
 			}
@@ -1074,7 +1162,7 @@ func (img *Image) GetImage() (image.Image, error) {
 				},
 			}
 		case ChromaInterleavedRRGGBBAA_BE:
-			rgba, err := img.GetPlane(ChannelInterleaved)
+			rgba, err := img.GetPlaneView(ChannelInterleaved)
 			if err != nil {
 				return nil, err
 			}
@@ -1110,7 +1198,8 @@ func (img *Image) GetImage() (image.Image, error) {
 					read_pos += stride_add
 				}
 			} else {
-				plane = rgba.Plane
+				// The view references the memory of "img", copy it into Go memory.
+				plane = append([]byte(nil), rgba.Plane...)
 			}
 			i = &image.RGBA64{
 				Pix:    plane,
@@ -1133,6 +1222,7 @@ func (img *Image) GetImage() (image.Image, error) {
 		return nil, fmt.Errorf("Unsupported colorspace: %v", cs)
 	}
 
+	runtime.KeepAlive(img)
 	return i, nil
 }
 
@@ -1187,6 +1277,50 @@ func (img *Image) GetPlane(channel Channel) (*ImageAccess, error) {
 	return access, nil
 }
 
+// GetPlaneView returns the pixel data of a plane without copying it. The returned
+// "Plane" slice references the memory of the image and is only valid as long as
+// the image is alive. Keep a reference to the "ImageAccess" (or the "Image") while
+// accessing the slice, e.g. with "runtime.KeepAlive".
+func (img *Image) GetPlaneView(channel Channel) (*ImageAccess, error) {
+	height := C.heif_image_get_height(img.image, uint32(channel))
+	if height == -1 {
+		return nil, fmt.Errorf("No such channel %v", channel)
+	}
+
+	var stride C.int
+	plane := C.heif_image_get_plane(img.image, uint32(channel), &stride)
+	runtime.KeepAlive(img)
+	if plane == nil {
+		return nil, fmt.Errorf("No such channel %v", channel)
+	}
+
+	ptr := unsafe.Pointer(plane)
+	access := &ImageAccess{
+		Plane:    unsafe.Slice((*byte)(ptr), int(stride)*int(height)),
+		planePtr: ptr,
+		Stride:   int(stride),
+		height:   int(height),
+		image:    img,
+	}
+	return access, nil
+}
+
+// copyPlaneTo copies "rowBytes" bytes of each row of the plane into "dst", which
+// starts at "offset" and has rows "dstStride" bytes apart.
+func (i *ImageAccess) copyPlaneTo(dst []byte, offset, dstStride, rowBytes int) error {
+	if rowBytes > i.Stride || rowBytes > dstStride ||
+		(i.height > 0 && offset+(i.height-1)*dstStride+rowBytes > len(dst)) {
+		return fmt.Errorf("Destination buffer is too small")
+	}
+
+	for y := 0; y < i.height; y++ {
+		srcP := unsafe.Add(i.planePtr, y*i.Stride)
+		C.memcpy(unsafe.Pointer(&dst[offset+y*dstStride]), srcP, C.size_t(rowBytes))
+	}
+	runtime.KeepAlive(i.image)
+	return nil
+}
+
 func (img *Image) NewPlane(channel Channel, width, height, depth int) (*ImageAccess, error) {
 	err := C.heif_image_add_plane(img.image, uint32(channel), C.int(width), C.int(height), C.int(depth))
 	runtime.KeepAlive(img)
@@ -1450,6 +1584,160 @@ func EncodeFromImage(img image.Image, compression Compression, quality int, loss
 	return ctx, nil
 }
 
+// --- Thread pool
+
+// SetThreadPoolSize sets the number of worker threads of the libheif thread
+// pool that is shared by all contexts. Do not call this while images are decoded.
+func SetThreadPoolSize(numThreads int) {
+	C.heif_set_thread_pool_size(C.int(numThreads))
+}
+
+func GetThreadPoolSize() int {
+	return int(C.heif_get_thread_pool_size())
+}
+
+// SetImageBufferPoolSize lets libheif reuse the memory of released images up to
+// "maxBytes" for new images with the same plane sizes (0 disables the pool).
+func SetImageBufferPoolSize(maxBytes int) {
+	C.heif_set_image_buffer_pool_size(C.size_t(maxBytes))
+}
+
+// --- Batch decoding
+
+// BatchResult is the decoded primary image of one input of BatchDecoder.DecodeToRGBA.
+type BatchResult struct {
+	Image *image.RGBA
+	Err   error
+}
+
+// BatchDecoder decodes the primary images of many files concurrently into RGBA
+// images. The number of concurrent decodes is bounded, such that the goroutines
+// do not block more threads in cgo calls than libheif can keep busy. The pixel
+// buffers of released images are reused for the following decodes, which avoids
+// allocating (and garbage collecting) a new buffer for each image.
+//
+// A BatchDecoder can be used from several goroutines.
+type BatchDecoder struct {
+	slots   chan struct{}
+	buffers sync.Pool // *[]byte
+}
+
+// NewBatchDecoder creates a decoder that runs at most "maxConcurrency" decodes
+// at the same time. With 0, this is the size of the libheif thread pool.
+func NewBatchDecoder(maxConcurrency int) *BatchDecoder {
+	if maxConcurrency <= 0 {
+		maxConcurrency = GetThreadPoolSize()
+	}
+	if maxConcurrency <= 0 {
+		maxConcurrency = 1
+	}
+
+	return &BatchDecoder{
+		slots: make(chan struct{}, maxConcurrency),
+	}
+}
+
+// DecodeToRGBA decodes the primary image of each input in its own goroutine and
+// returns the results in the order of the inputs. The options may be nil.
+// Pass the images to Release when they are no longer used.
+func (b *BatchDecoder) DecodeToRGBA(inputs [][]byte, options *DecodingOptions) []BatchResult {
+	results := make([]BatchResult, len(inputs))
+
+	var wg sync.WaitGroup
+	for i, data := range inputs {
+		wg.Add(1)
+		go func(i int, data []byte) {
+			defer wg.Done()
+
+			b.slots <- struct{}{}
+			defer func() { <-b.slots }()
+
+			results[i].Image, results[i].Err = b.decodeOne(data, options)
+		}(i, data)
+	}
+	wg.Wait()
+
+	runtime.KeepAlive(options)
+	return results
+}
+
+func (b *BatchDecoder) decodeOne(data []byte, options *DecodingOptions) (*image.RGBA, error) {
+	if len(data) == 0 {
+		return nil, fmt.Errorf("Empty input")
+	}
+
+	ctx := C.heif_context_alloc()
+	if ctx == nil {
+		return nil, fmt.Errorf("Could not allocate context")
+	}
+	defer C.heif_context_free(ctx)
+
+	// The data is only needed while the context exists.
+	err := C.heif_context_read_from_memory_without_copy(ctx, unsafe.Pointer(&data[0]), C.size_t(len(data)), nil)
+	if err := convertHeifError(err); err != nil {
+		return nil, err
+	}
+
+	var handle *C.struct_heif_image_handle
+	err = C.heif_context_get_primary_image_handle(ctx, &handle)
+	if err := convertHeifError(err); err != nil {
+		return nil, err
+	}
+	defer C.heif_image_handle_release(handle)
+
+	width := int(C.heif_image_handle_get_width(handle))
+	height := int(C.heif_image_handle_get_height(handle))
+	if width <= 0 || height <= 0 {
+		return nil, fmt.Errorf("Invalid image size %dx%d", width, height)
+	}
+
+	img := b.getImage(width, height)
+
+	var opt *C.struct_heif_decoding_options
+	if options != nil {
+		opt = options.options
+	}
+
+	err = C.decode_image_into_rgba(handle, (*C.uint8_t)(unsafe.Pointer(&img.Pix[0])), C.size_t(img.Stride), opt)
+	runtime.KeepAlive(data)
+	if err := convertHeifError(err); err != nil {
+		b.Release(img)
+		return nil, err
+	}
+
+	return img, nil
+}
+
+func (b *BatchDecoder) getImage(width, height int) *image.RGBA {
+	size := width * height * 4
+
+	var pix []byte
+	if buf, ok := b.buffers.Get().(*[]byte); ok && cap(*buf) >= size {
+		pix = (*buf)[:size]
+	} else {
+		// Buffers that are too small are dropped. They are replaced by the larger ones over time.
+		pix = make([]byte, size)
+	}
+
+	return &image.RGBA{
+		Pix:    pix,
+		Stride: width * 4,
+		Rect:   image.Rect(0, 0, width, height),
+	}
+}
+
+// Release returns the pixel buffer of an image from DecodeToRGBA for reuse.
+// The image must not be used afterwards.
+func (b *BatchDecoder) Release(img *image.RGBA) {
+	if img == nil || img.Pix == nil {
+		return
+	}
+
+	pix := img.Pix[:0]
+	b.buffers.Put(&pix)
+	img.Pix = nil
+}
+
 // --- High-level decoding API, always decodes primary image (if present).
 
 func decodePrimaryImageFromReader(r io.Reader) (*ImageHandle, error) {
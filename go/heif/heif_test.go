@@ -27,6 +27,7 @@
 package heif
 
 import (
+	"bytes"
 	"fmt"
 	"image"
 	"io/ioutil"
@@ -97,6 +98,40 @@ func CheckHeifImage(t *testing.T, handle *ImageHandle, thumbnail bool) {
 	}
 }
 
+func CheckDecodeImageTo(t *testing.T, handle *ImageHandle) {
+	rect := image.Rect(0, 0, handle.GetWidth(), handle.GetHeight())
+
+	rgba := image.NewRGBA(rect)
+	if err := handle.DecodeImageToRGBA(rgba, nil); err != nil {
+		t.Errorf("Could not decode image to RGBA: %s", err)
+	}
+
+	ycbcr := image.NewYCbCr(rect, image.YCbCrSubsampleRatio420)
+	if err := handle.DecodeImageToYCbCr(ycbcr, nil); err != nil {
+		t.Errorf("Could not decode image to YCbCr: %s", err)
+	}
+
+	small := image.NewRGBA(image.Rect(0, 0, 1, 1))
+	if err := handle.DecodeImageToRGBA(small, nil); err == nil {
+		t.Error("Expected error when decoding into a buffer of the wrong size")
+	}
+
+	img, err := handle.DecodeImage(ColorspaceRGB, ChromaInterleavedRGBA, nil)
+	if err != nil {
+		t.Fatalf("Could not decode image: %s", err)
+	}
+	view, err := img.GetPlaneView(ChannelInterleaved)
+	if err != nil {
+		t.Fatalf("Could not get plane view: %s", err)
+	}
+	for y := 0; y < rect.Dy(); y++ {
+		row := view.Plane[y*view.Stride : y*view.Stride+rect.Dx()*4]
+		if string(row) != string(rgba.Pix[y*rgba.Stride:y*rgba.Stride+rect.Dx()*4]) {
+			t.Fatalf("Plane view and decoded RGBA image differ in row %d", y)
+		}
+	}
+}
+
 func CheckHeifFile(t *testing.T, ctx *Context) {
 	if count := ctx.GetNumberOfTopLevelImages(); count != 2 {
 		t.Errorf("Expected %d top level images, got %d", 2, count)
@@ -114,6 +149,7 @@ func CheckHeifFile(t *testing.T, ctx *Context) {
 			t.Error("Expected primary image")
 		}
 		CheckHeifImage(t, handle, false)
+		CheckDecodeImageTo(t, handle)
 	}
 }
 
@@ -182,3 +218,55 @@ func TestReadImage(t *testing.T) {
 		fmt.Printf("Image size %+v does not match config %+v\n", r, config)
 	}
 }
+
+func TestBatchDecode(t *testing.T) {
+	filename := path.Join("..", "..", "examples", "example.heic")
+	data, err := ioutil.ReadFile(filename)
+	if err != nil {
+		t.Fatalf("Can't read file %s: %s", filename, err)
+	}
+
+	ctx, err := NewContext()
+	if err != nil {
+		t.Fatalf("Can't create context: %s", err)
+	}
+	if err := ctx.ReadFromMemory(data); err != nil {
+		t.Fatalf("Can't read from memory: %s", err)
+	}
+	handle, err := ctx.GetPrimaryImageHandle()
+	if err != nil {
+		t.Fatalf("Could not get primary image handle: %s", err)
+	}
+	expected := image.NewRGBA(image.Rect(0, 0, handle.GetWidth(), handle.GetHeight()))
+	if err := handle.DecodeImageToRGBA(expected, nil); err != nil {
+		t.Fatalf("Could not decode image: %s", err)
+	}
+
+	decoder := NewBatchDecoder(2)
+	inputs := [][]byte{data, data, nil, data}
+
+	// The second round reuses the buffers of the first one.
+	for round := 0; round < 2; round++ {
+		results := decoder.DecodeToRGBA(inputs, nil)
+		if len(results) != len(inputs) {
+			t.Fatalf("Expected %d results, got %d", len(inputs), len(results))
+		}
+
+		for i, result := range results {
+			if inputs[i] == nil {
+				if result.Err == nil {
+					t.Errorf("Expected an error for empty input %d", i)
+				}
+				continue
+			}
+
+			if result.Err != nil {
+				t.Fatalf("Could not decode input %d: %s", i, result.Err)
+			}
+			if !bytes.Equal(result.Image.Pix, expected.Pix) || result.Image.Rect != expected.Rect {
+				t.Errorf("Batch decoded image %d differs from the image decoded with DecodeImageToRGBA", i)
+			}
+			decoder.Release(result.Image)
+		}
+	}
+}
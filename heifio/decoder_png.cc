@@ -27,8 +27,10 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <vector>
 #include "decoder_png.h"
 #include "exif.h"
 
@@ -47,6 +49,12 @@ user_read_fn(png_structp png_ptr, png_bytep data, png_size_t length)
 } // user_read_data
 
 
+static void release_png_image_data(uint8_t* data, void*)
+{
+  free(data);
+}
+
+
 heif_error loadPNG(const char* filename, int output_bit_depth, InputImage *input_image)
 {
   FILE* fh = fopen(filename, "rb");
@@ -143,6 +151,9 @@ heif_error loadPNG(const char* filename, int output_bit_depth, InputImage *input
    */
   png_set_packing(png_ptr);
 
+  /* Let libpng reconstruct interlaced images in png_read_image(). */
+  png_set_interlace_handling(png_ptr);
+
 
   /* Expand paletted colors into true RGB triplets */
   if (color_type == PNG_COLOR_TYPE_PALETTE) {
@@ -181,256 +192,260 @@ heif_error loadPNG(const char* filename, int output_bit_depth, InputImage *input
    */
   png_read_update_info(png_ptr, info_ptr);
 
-  /* Allocate the memory to hold the image using the fields of info_ptr. */
+  int band = png_get_channels(png_ptr, info_ptr);
+  bool has_alpha = (band == 2 || band == 4);
 
-  /* The easiest way to read the image: */
-  uint8_t** row_pointers = new png_bytep[height];
-  assert(row_pointers != NULL);
+  size_t row_bytes = png_get_rowbytes(png_ptr, info_ptr);
 
-  for (uint32_t y = 0; y < height; y++) {
-    row_pointers[y] = (png_bytep) malloc(png_get_rowbytes(png_ptr, info_ptr));
-    assert(row_pointers[y] != NULL);
-  } // for
+  // 8-bit gray and RGB(A) images are decoded into one memory block that is passed to libheif without copying.
+  // All other formats are converted into the image planes while they are decoded.
+  bool pass_through = (bit_depth == 8 && band != 2);
 
-  /* Now it's time to read the image.  One of these methods is REQUIRED */
-  png_read_image(png_ptr, row_pointers);
+  struct heif_error err;
+  uint8_t* image_data = nullptr;
 
-  /* read rest of file, and get additional chunks in info_ptr - REQUIRED */
-  png_read_end(png_ptr, info_ptr);
+  if (pass_through) {
+    image_data = (uint8_t*) malloc(row_bytes * height);
+    assert(image_data != NULL);
 
+    std::vector<png_bytep> row_pointers(height);
+    for (uint32_t y = 0; y < height; y++) {
+      row_pointers[y] = image_data + y * row_bytes;
+    }
 
-  // --- read EXIF data
+    png_read_image(png_ptr, row_pointers.data());
+  }
+  else {
+    std::function<void(uint32_t y, const uint8_t* p)> convert_row;
 
-#ifdef PNG_eXIf_SUPPORTED
-  png_bytep exifPtr = nullptr;
-  png_uint_32 exifSize = 0;
-  if (png_get_eXIf_1(png_ptr, info_ptr, &exifSize, &exifPtr) == PNG_INFO_eXIf) {
-    input_image->exif.resize(exifSize);
-    memcpy(input_image->exif.data(), exifPtr, exifSize);
+    int bdShift = 16 - output_bit_depth;
 
-    // remove the EXIF orientation since it is informal only in PNG and we do not want to confuse with an orientation not matching irot/imir
-    modify_exif_orientation_tag_if_it_exists(input_image->exif.data(), (int) input_image->exif.size(), 1);
-  }
-#endif
+    if (band == 1) {
+      assert(bit_depth > 8);
 
-  // --- read XMP data
+      err = heif_image_create((int) width, (int) height,
+                              heif_colorspace_monochrome,
+                              heif_chroma_monochrome,
+                              &image);
+      (void) err;
 
-#ifdef PNG_iTXt_SUPPORTED
-  png_textp textPtr = nullptr;
-  const png_uint_32 nTextChunks = png_get_text(png_ptr, info_ptr, &textPtr, nullptr);
-  for (png_uint_32 i = 0; i < nTextChunks; i++, textPtr++) {
-    png_size_t textLength = textPtr->text_length;
-    if ((textPtr->compression == PNG_ITXT_COMPRESSION_NONE) || (textPtr->compression == PNG_ITXT_COMPRESSION_zTXt)) {
-      textLength = textPtr->itxt_length;
-    }
+      heif_image_add_plane(image, heif_channel_Y, (int) width, (int) height, output_bit_depth);
 
-    if (!strcmp(textPtr->key, "XML:com.adobe.xmp")) {
-      if (textLength == 0) {
-        // TODO: error
+      size_t y_stride;
+      uint8_t* py = heif_image_get_plane2(image, heif_channel_Y, &y_stride);
+
+      if (output_bit_depth == 8) {
+        convert_row = [=](uint32_t y, const uint8_t* p) {
+          for (uint32_t x = 0; x < width; x++) {
+            py[x + y * y_stride] = p[2 * x];
+          }
+        };
       }
       else {
-        input_image->xmp.resize(textLength);
-        memcpy(input_image->xmp.data(), textPtr->text, textLength);
+        convert_row = [=](uint32_t y, const uint8_t* p) {
+          uint16_t* out = (uint16_t*) (py + y * y_stride);
+          for (uint32_t x = 0; x < width; x++) {
+            out[x] = (uint16_t) (((p[0] << 8) | p[1]) >> bdShift);
+            p += 2;
+          }
+        };
       }
     }
-  }
-#endif
-
-  int band = png_get_channels(png_ptr, info_ptr);
-
-  /* clean up after the read, and free any memory allocated - REQUIRED */
-  png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
-
-
-  struct heif_error err;
-
-  bool has_alpha = (band == 2 || band == 4);
-
-  if (band == 1 && bit_depth == 8) {
-    err = heif_image_create((int) width, (int) height,
-                            heif_colorspace_monochrome,
-                            heif_chroma_monochrome,
-                            &image);
-    (void) err;
-
-    heif_image_add_plane(image, heif_channel_Y, (int) width, (int) height, 8);
-
-    size_t y_stride;
-    size_t a_stride;
-    uint8_t* py = heif_image_get_plane2(image, heif_channel_Y, &y_stride);
-    uint8_t* pa = nullptr;
+    else if (band == 2 && bit_depth == 8) {
+      err = heif_image_create((int) width, (int) height,
+                              heif_colorspace_monochrome,
+                              heif_chroma_monochrome,
+                              &image);
+      (void) err;
 
-    if (has_alpha) {
+      heif_image_add_plane(image, heif_channel_Y, (int) width, (int) height, 8);
       heif_image_add_plane(image, heif_channel_Alpha, (int) width, (int) height, 8);
 
-      pa = heif_image_get_plane2(image, heif_channel_Alpha, &a_stride);
-    }
+      size_t stride;
+      uint8_t* py = heif_image_get_plane2(image, heif_channel_Y, &stride);
 
+      size_t strideA;
+      uint8_t* pA = heif_image_get_plane2(image, heif_channel_Alpha, &strideA);
 
-    for (uint32_t y = 0; y < height; y++) {
-      uint8_t* p = row_pointers[y];
-
-      if (has_alpha) {
+      convert_row = [=](uint32_t y, const uint8_t* p) {
         for (uint32_t x = 0; x < width; x++) {
-          py[y * y_stride + x] = *p++;
-          pa[y * a_stride + x] = *p++;
+          py[y * stride + x] = p[2 * x];
+          pA[y * strideA + x] = p[2 * x + 1];
         }
-      }
-      else {
-        memcpy(&py[y * y_stride], p, width);
-      }
+      };
     }
-  }
-  else if (band == 1) {
-    assert(bit_depth > 8);
-
-    err = heif_image_create((int) width, (int) height,
-                            heif_colorspace_monochrome,
-                            heif_chroma_monochrome,
-                            &image);
-    (void) err;
-
-    int bdShift = 16 - output_bit_depth;
-
-    heif_image_add_plane(image, heif_channel_Y, (int) width, (int) height, output_bit_depth);
-
-    size_t y_stride;
-    size_t a_stride = 0;
-    uint16_t* py = (uint16_t*) heif_image_get_plane2(image, heif_channel_Y, &y_stride);
-    uint16_t* pa = nullptr;
+    else if (band == 2) {
+      err = heif_image_create((int) width, (int) height,
+                              heif_colorspace_monochrome,
+                              heif_chroma_monochrome,
+                              &image);
+      (void) err;
 
-    if (has_alpha) {
+      heif_image_add_plane(image, heif_channel_Y, (int) width, (int) height, output_bit_depth);
       heif_image_add_plane(image, heif_channel_Alpha, (int) width, (int) height, output_bit_depth);
 
-      pa = (uint16_t*) heif_image_get_plane2(image, heif_channel_Alpha, &a_stride);
+      size_t y_stride;
+      uint8_t* py = heif_image_get_plane2(image, heif_channel_Y, &y_stride);
+      size_t a_stride;
+      uint8_t* pa = heif_image_get_plane2(image, heif_channel_Alpha, &a_stride);
+
+      if (output_bit_depth == 8) {
+        convert_row = [=](uint32_t y, const uint8_t* p) {
+          for (uint32_t x = 0; x < width; x++) {
+            py[x + y * y_stride] = p[4 * x];
+            pa[x + y * a_stride] = p[4 * x + 2];
+          }
+        };
+      }
+      else {
+        convert_row = [=](uint32_t y, const uint8_t* p) {
+          uint16_t* out_y = (uint16_t*) (py + y * y_stride);
+          uint16_t* out_a = (uint16_t*) (pa + y * a_stride);
+          for (uint32_t x = 0; x < width; x++) {
+            out_y[x] = (uint16_t) (((p[0] << 8) | p[1]) >> bdShift);
+            out_a[x] = (uint16_t) (((p[2] << 8) | p[3]) >> bdShift);
+            p += 4;
+          }
+        };
+      }
     }
+    else {
+      if (output_bit_depth == 8) {
+        err = heif_image_create((int) width, (int) height,
+                                heif_colorspace_RGB,
+                                has_alpha ?
+                                heif_chroma_interleaved_RGBA :
+                                heif_chroma_interleaved_RGB,
+                                &image);
+      }
+      else {
+        err = heif_image_create((int) width, (int) height,
+                                heif_colorspace_RGB,
+                                has_alpha ?
+                                heif_chroma_interleaved_RRGGBBAA_LE :
+                                heif_chroma_interleaved_RRGGBB_LE,
+                                &image);
+      }
+      (void) err;
 
-    y_stride /= 2;
-    a_stride /= 2;
+      heif_image_add_plane(image, heif_channel_interleaved, (int) width, (int) height, output_bit_depth);
 
-    for (uint32_t y = 0; y < height; y++) {
-      uint8_t* p = row_pointers[y];
+      size_t stride;
+      uint8_t* p_out = (uint8_t*) heif_image_get_plane2(image, heif_channel_interleaved, &stride);
 
-      if (has_alpha) {
-        for (uint32_t x = 0; x < width; x++) {
-          uint16_t vp = (uint16_t) (((p[0] << 8) | p[1]) >> bdShift);
-          uint16_t va = (uint16_t) (((p[2] << 8) | p[3]) >> bdShift);
+      uint32_t nVal = (has_alpha ? 4 : 3) * width;
 
-          py[x + y * y_stride] = vp;
-          pa[x + y * y_stride] = va;
+      if (output_bit_depth == 8) {
+        // convert HDR to SDR
 
-          p += 4;
-        }
+        convert_row = [=](uint32_t y, const uint8_t* p) {
+          for (uint32_t x = 0; x < nVal; x++) {
+            p_out[x + y * stride] = p[0];
+            p += 2;
+          }
+        };
       }
       else {
-        for (uint32_t x = 0; x < width; x++) {
-          uint16_t vp = (uint16_t) (((p[0] << 8) | p[1]) >> bdShift);
+        convert_row = [=](uint32_t y, const uint8_t* p) {
+          for (uint32_t x = 0; x < nVal; x++) {
+            uint16_t v = (uint16_t) (((p[0] << 8) | p[1]) >> bdShift);
+            p_out[2 * x + y * stride + 1] = (uint8_t) (v >> 8);
+            p_out[2 * x + y * stride + 0] = (uint8_t) (v & 0xFF);
+            p += 2;
+          }
+        };
+      }
+    }
+
+    if (interlace_type == PNG_INTERLACE_NONE) {
+      // Decode one row at a time. No intermediate buffer for the whole image is needed.
+      std::vector<uint8_t> row(row_bytes);
+      for (uint32_t y = 0; y < height; y++) {
+        png_read_row(png_ptr, row.data(), nullptr);
+        convert_row(y, row.data());
+      }
+    }
+    else {
+      // Interlaced images can only be reconstructed after all passes were decoded.
+      std::vector<uint8_t> data(row_bytes * height);
+      std::vector<png_bytep> row_pointers(height);
+      for (uint32_t y = 0; y < height; y++) {
+        row_pointers[y] = data.data() + y * row_bytes;
+      }
 
-          py[x + y * y_stride] = vp;
+      png_read_image(png_ptr, row_pointers.data());
 
-          p += 2;
-        }
+      for (uint32_t y = 0; y < height; y++) {
+        convert_row(y, row_pointers[y]);
       }
     }
   }
-  else if (band == 2 && bit_depth==8) {
-    err = heif_image_create((int) width, (int) height,
-                            heif_colorspace_monochrome,
-                            heif_chroma_monochrome,
-                            &image);
-    (void) err;
 
-    heif_image_add_plane(image, heif_channel_Y, (int) width, (int) height, 8);
-    heif_image_add_plane(image, heif_channel_Alpha, (int) width, (int) height, 8);
+  /* read rest of file, and get additional chunks in info_ptr - REQUIRED */
+  png_read_end(png_ptr, info_ptr);
 
-    size_t stride;
-    uint8_t* p = heif_image_get_plane2(image, heif_channel_Y, &stride);
 
-    size_t strideA;
-    uint8_t* pA = heif_image_get_plane2(image, heif_channel_Alpha, &strideA);
+  // --- read EXIF data
 
-    for (uint32_t y = 0; y < height; y++) {
-      for (uint32_t x = 0; x < width; x++) {
-        p[y * stride + x] = row_pointers[y][2 * x];
-        pA[y * strideA + x] = row_pointers[y][2 * x + 1];
-      }
-    }
+#ifdef PNG_eXIf_SUPPORTED
+  png_bytep exifPtr = nullptr;
+  png_uint_32 exifSize = 0;
+  if (png_get_eXIf_1(png_ptr, info_ptr, &exifSize, &exifPtr) == PNG_INFO_eXIf) {
+    input_image->exif.resize(exifSize);
+    memcpy(input_image->exif.data(), exifPtr, exifSize);
+
+    // remove the EXIF orientation since it is informal only in PNG and we do not want to confuse with an orientation not matching irot/imir
+    modify_exif_orientation_tag_if_it_exists(input_image->exif.data(), (int) input_image->exif.size(), 1);
   }
-  else if (bit_depth == 8) {
-    err = heif_image_create((int) width, (int) height,
-                            heif_colorspace_RGB,
-                            has_alpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
-                            &image);
-    (void) err;
+#endif
 
-    heif_image_add_plane(image, heif_channel_interleaved, (int) width, (int) height,
-                         has_alpha ? 32 : 24);
+  // --- read XMP data
 
-    size_t stride;
-    uint8_t* p = heif_image_get_plane2(image, heif_channel_interleaved, &stride);
+#ifdef PNG_iTXt_SUPPORTED
+  png_textp textPtr = nullptr;
+  const png_uint_32 nTextChunks = png_get_text(png_ptr, info_ptr, &textPtr, nullptr);
+  for (png_uint_32 i = 0; i < nTextChunks; i++, textPtr++) {
+    png_size_t textLength = textPtr->text_length;
+    if ((textPtr->compression == PNG_ITXT_COMPRESSION_NONE) || (textPtr->compression == PNG_ITXT_COMPRESSION_zTXt)) {
+      textLength = textPtr->itxt_length;
+    }
 
-    for (uint32_t y = 0; y < height; y++) {
-      if (has_alpha) {
-        memcpy(p + y * stride, row_pointers[y], width * 4);
+    if (!strcmp(textPtr->key, "XML:com.adobe.xmp")) {
+      if (textLength == 0) {
+        // TODO: error
       }
       else {
-        memcpy(p + y * stride, row_pointers[y], width * 3);
+        input_image->xmp.resize(textLength);
+        memcpy(input_image->xmp.data(), textPtr->text, textLength);
       }
     }
   }
-  else {
-    if (output_bit_depth == 8) {
+#endif
+
+  /* clean up after the read, and free any memory allocated - REQUIRED */
+  png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+
+
+  if (pass_through) {
+    if (band == 1) {
       err = heif_image_create((int) width, (int) height,
-                              heif_colorspace_RGB,
-                              has_alpha ?
-                              heif_chroma_interleaved_RGBA :
-                              heif_chroma_interleaved_RGB,
+                              heif_colorspace_monochrome,
+                              heif_chroma_monochrome,
                               &image);
+      (void) err;
+
+      heif_image_add_plane_external(image, heif_channel_Y, (int) width, (int) height, 8,
+                                    image_data, row_bytes, release_png_image_data, nullptr);
     }
     else {
       err = heif_image_create((int) width, (int) height,
                               heif_colorspace_RGB,
-                              has_alpha ?
-                              heif_chroma_interleaved_RRGGBBAA_LE :
-                              heif_chroma_interleaved_RRGGBB_LE,
+                              has_alpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
                               &image);
-    }
-    (void) err;
-
-    int bdShift = 16 - output_bit_depth;
-
-    heif_image_add_plane(image, heif_channel_interleaved, (int) width, (int) height, output_bit_depth);
-
-    size_t stride;
-    uint8_t* p_out = (uint8_t*) heif_image_get_plane2(image, heif_channel_interleaved, &stride);
+      (void) err;
 
-    if (output_bit_depth==8) {
-      // convert HDR to SDR
-
-      for (uint32_t y = 0; y < height; y++) {
-        uint8_t* p = row_pointers[y];
-
-        uint32_t nVal = (has_alpha ? 4 : 3) * width;
-
-        for (uint32_t x = 0; x < nVal; x++) {
-          p_out[x + y * stride] = p[0];
-          p+=2;
-        }
-      }
-    }
-    else {
-      for (uint32_t y = 0; y < height; y++) {
-        uint8_t* p = row_pointers[y];
-
-        uint32_t nVal = (has_alpha ? 4 : 3) * width;
-
-        for (uint32_t x = 0; x < nVal; x++) {
-          uint16_t v = (uint16_t) (((p[0] << 8) | p[1]) >> bdShift);
-          p_out[2 * x + y * stride + 1] = (uint8_t) (v >> 8);
-          p_out[2 * x + y * stride + 0] = (uint8_t) (v & 0xFF);
-          p += 2;
-        }
-      }
+      heif_image_add_plane_external(image, heif_channel_interleaved, (int) width, (int) height, 8,
+                                    image_data, row_bytes, release_png_image_data, nullptr);
     }
   }
 
@@ -439,11 +454,6 @@ heif_error loadPNG(const char* filename, int output_bit_depth, InputImage *input
   }
 
   free(profile_data);
-  for (uint32_t y = 0; y < height; y++) {
-    free(row_pointers[y]);
-  } // for
-
-  delete[] row_pointers;
   fclose(fh);
 
   input_image->image = std::shared_ptr<heif_image>(image,
@@ -24,12 +24,18 @@
   SOFTWARE.
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iostream>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <thread>
+#endif
+
 extern "C" {
 #include <tiff.h>
 #include <tiffio.h>
@@ -270,127 +276,188 @@ heif_error getImageWidthAndHeight(TIFF *tif, uint32_t &width, uint32_t &height)
   return heif_error_ok;
 }
 
-heif_error readMono(TIFF *tif, heif_image **image)
+// Layout of the strips or tiles in which the image data is stored.
+struct BlockLayout
 {
-  uint32_t width, height;
-  heif_error err = getImageWidthAndHeight(tif, width, height);
-  if (err.code != heif_error_Ok) {
-    return err;
-  }
-  err = heif_image_create((int) width, (int) height, heif_colorspace_monochrome, heif_chroma_monochrome, image);
-  if (err.code != heif_error_Ok) {
-    return err;
-  }
-  heif_image_add_plane(*image, heif_channel_Y, (int)width, (int)height, 8);
+  uint32_t blockWidth;
+  uint32_t blockHeight;
+  uint32_t blocksAcross;
+  uint32_t blocksPerPlane;
+  uint32_t numPlanes;
+  bool tiled;
+  tmsize_t blockSize;
+};
 
-  size_t y_stride;
-  uint8_t *py = heif_image_get_plane2(*image, heif_channel_Y, &y_stride);
-  for (uint32_t row = 0; row < height; row++)
-  {
-    TIFFReadScanline(tif, py, row, 0);
-    py += y_stride;
-  }
-  return heif_error_ok;
-}
 
-heif_error readPixelInterleaveRGB(TIFF *tif, uint16_t samplesPerPixel, heif_image **image)
+static BlockLayout getBlockLayout(TIFF* tif, uint32_t width, uint32_t height, uint16_t samplesPerPixel, uint16_t config)
 {
-  uint32_t width, height;
-  heif_error err = getImageWidthAndHeight(tif, width, height);
-  if (err.code != heif_error_Ok) {
-    return err;
+  BlockLayout layout{};
+  layout.tiled = TIFFIsTiled(tif);
+  layout.numPlanes = (config == PLANARCONFIG_SEPARATE) ? samplesPerPixel : 1;
+
+  if (layout.tiled) {
+    TIFFGetField(tif, TIFFTAG_TILEWIDTH, &layout.blockWidth);
+    TIFFGetField(tif, TIFFTAG_TILELENGTH, &layout.blockHeight);
+    layout.blockSize = TIFFTileSize(tif);
   }
-  heif_chroma chroma = heif_chroma_interleaved_RGB;
-  if (samplesPerPixel == 4) {
-    chroma = heif_chroma_interleaved_RGBA;
+  else {
+    uint32_t rowsPerStrip = height;
+    TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+
+    layout.blockWidth = width;
+    layout.blockHeight = std::min(rowsPerStrip, height);
+    layout.blockSize = TIFFStripSize(tif);
   }
 
-  err = heif_image_create((int)width, (int)height, heif_colorspace_RGB, chroma, image);
-  if (err.code != heif_error_Ok)
-  {
-    return err;
+  if (layout.blockWidth == 0 || layout.blockHeight == 0) {
+    return layout;
   }
-  heif_channel channel = heif_channel_interleaved;
-  heif_image_add_plane(*image, channel, (int)width, (int)height, samplesPerPixel * 8);
 
-  size_t y_stride;
-  uint8_t *py = heif_image_get_plane2(*image, channel, &y_stride);
+  layout.blocksAcross = (width + layout.blockWidth - 1) / layout.blockWidth;
+  layout.blocksPerPlane = layout.blocksAcross * ((height + layout.blockHeight - 1) / layout.blockHeight);
 
-  tdata_t buf = _TIFFmalloc(TIFFScanlineSize(tif));
-  for (uint32_t row = 0; row < height; row++)
-  {
-    TIFFReadScanline(tif, buf, row, 0);
-    memcpy(py, buf, width * samplesPerPixel);
-    py += y_stride;
-  }
-  _TIFFfree(buf);
-  return heif_error_ok;
+  return layout;
 }
 
-heif_error readPixelInterleave(TIFF *tif,  uint16_t samplesPerPixel, heif_image **image)
+
+// Decodes the strips or tiles starting with 'nextBlock' until all are done, copying them into the image plane.
+// Several threads can run this concurrently, each one with its own TIFF handle.
+static void decodeBlocks(TIFF* tif, const BlockLayout& layout, uint32_t width, uint32_t height, uint16_t samplesPerPixel,
+                         uint8_t* plane, size_t stride,
+                         std::atomic<uint32_t>& nextBlock, std::atomic<bool>& failed)
 {
-  if (samplesPerPixel == 1) {
-    return readMono(tif, image);
-  } else {
-    return readPixelInterleaveRGB(tif, samplesPerPixel, image);
+  std::vector<uint8_t> buf(static_cast<size_t>(layout.blockSize));
+
+  const uint32_t numBlocks = layout.blocksPerPlane * layout.numPlanes;
+  const bool separate = (layout.numPlanes > 1);
+  const uint32_t srcPixelSize = separate ? 1 : samplesPerPixel;
+
+  for (;;) {
+    uint32_t block = nextBlock++;
+    if (block >= numBlocks || failed) {
+      return;
+    }
+
+    tmsize_t size;
+    if (layout.tiled) {
+      size = TIFFReadEncodedTile(tif, block, buf.data(), layout.blockSize);
+    }
+    else {
+      size = TIFFReadEncodedStrip(tif, block, buf.data(), layout.blockSize);
+    }
+
+    if (size < 0) {
+      failed = true;
+      return;
+    }
+
+    uint32_t sample = block / layout.blocksPerPlane;
+    uint32_t idx = block % layout.blocksPerPlane;
+    uint32_t x0 = (idx % layout.blocksAcross) * layout.blockWidth;
+    uint32_t y0 = (idx / layout.blocksAcross) * layout.blockHeight;
+
+    uint32_t w = std::min(layout.blockWidth, width - x0);
+    uint32_t h = std::min(layout.blockHeight, height - y0);
+
+    size_t srcStride = static_cast<size_t>(layout.blockWidth) * srcPixelSize;
+
+    // The last strip may be shorter.
+    h = std::min(h, static_cast<uint32_t>(static_cast<size_t>(size) / srcStride));
+
+    for (uint32_t y = 0; y < h; y++) {
+      const uint8_t* src = buf.data() + y * srcStride;
+      uint8_t* dst = plane + (y0 + y) * stride + static_cast<size_t>(x0) * samplesPerPixel;
+
+      if (separate) {
+        dst += sample;
+        for (uint32_t x = 0; x < w; x++, dst += samplesPerPixel) {
+          *dst = src[x];
+        }
+      }
+      else {
+        memcpy(dst, src, static_cast<size_t>(w) * samplesPerPixel);
+      }
+    }
   }
 }
 
-heif_error readBandInterleaveRGB(TIFF *tif, uint16_t samplesPerPixel, heif_image **image)
+
+static heif_error readImageData(TIFF* tif, const char* filename, uint16_t samplesPerPixel, uint16_t config, heif_image** image)
 {
   uint32_t width, height;
   heif_error err = getImageWidthAndHeight(tif, width, height);
   if (err.code != heif_error_Ok) {
     return err;
   }
-  if (samplesPerPixel == 3) {
-    err = heif_image_create((int)width, (int)height, heif_colorspace_RGB, heif_chroma_interleaved_RGB, image);
-  } else {
-    err = heif_image_create((int)width, (int)height, heif_colorspace_RGB, heif_chroma_interleaved_RGBA, image);
+
+  BlockLayout layout = getBlockLayout(tif, width, height, samplesPerPixel, config);
+  if (layout.blocksPerPlane == 0 || layout.blockSize <= 0) {
+    struct heif_error err = {
+      .code = heif_error_Invalid_input,
+      .subcode = heif_suberror_Unspecified,
+      .message = "Invalid strip or tile size in TIFF image."};
+    return err;
+  }
+
+  heif_channel channel;
+  if (samplesPerPixel == 1) {
+    err = heif_image_create((int) width, (int) height, heif_colorspace_monochrome, heif_chroma_monochrome, image);
+    channel = heif_channel_Y;
+  }
+  else {
+    err = heif_image_create((int) width, (int) height, heif_colorspace_RGB,
+                            samplesPerPixel == 4 ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
+                            image);
+    channel = heif_channel_interleaved;
   }
   if (err.code != heif_error_Ok) {
     return err;
   }
-  heif_channel channel = heif_channel_interleaved;
-  heif_image_add_plane(*image, channel, (int)width, (int)height, samplesPerPixel * 8);
 
-  size_t y_stride;
-  uint8_t *py = heif_image_get_plane2(*image, channel, &y_stride);
+  heif_image_add_plane(*image, channel, (int) width, (int) height, samplesPerPixel * 8);
 
-  uint8_t *buf = static_cast<uint8_t *>(_TIFFmalloc(TIFFScanlineSize(tif)));
-  for (uint16_t i = 0; i < samplesPerPixel; i++)
-  {
-    uint8_t *dest = py + i;
-    for (uint32_t row = 0; row < height; row++)
-    {
-      TIFFReadScanline(tif, buf, row, i);
-      for (uint32_t x = 0; x < width; x++, dest += samplesPerPixel)
-      {
-        *dest = buf[x];
+  size_t stride;
+  uint8_t* plane = heif_image_get_plane2(*image, channel, &stride);
+
+  std::atomic<uint32_t> nextBlock{0};
+  std::atomic<bool> failed{false};
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  // libtiff handles cannot be shared between threads. Each additional thread opens the file again.
+  uint32_t numBlocks = layout.blocksPerPlane * layout.numPlanes;
+  uint32_t numThreads = std::min(std::max(std::thread::hardware_concurrency(), 1U), numBlocks);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 1; i < numThreads; i++) {
+    threads.emplace_back([&]() {
+      std::unique_ptr<TIFF, void (*)(TIFF*)> threadTif(TIFFOpen(filename, "r"), [](TIFF* t) { TIFFClose(t); });
+      if (threadTif) {
+        decodeBlocks(threadTif.get(), layout, width, height, samplesPerPixel, plane, stride, nextBlock, failed);
       }
-      dest += (y_stride - width * samplesPerPixel);
-    }
+    });
   }
-  _TIFFfree(buf);
-  return heif_error_ok;
-}
+#endif
 
+  decodeBlocks(tif, layout, width, height, samplesPerPixel, plane, stride, nextBlock, failed);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  for (auto& thread : threads) {
+    thread.join();
+  }
+#endif
+
+  if (failed) {
+    heif_image_release(*image);
+    *image = nullptr;
 
-heif_error readBandInterleave(TIFF *tif, uint16_t samplesPerPixel, heif_image **image)
-{
-  if (samplesPerPixel == 1) {
-    return readMono(tif, image);
-  } else if (samplesPerPixel == 3) {
-    return readBandInterleaveRGB(tif, samplesPerPixel, image);
-  } else if (samplesPerPixel == 4) {
-    return readBandInterleaveRGB(tif,  samplesPerPixel, image);
-  } else {
     struct heif_error err = {
-      .code = heif_error_Unsupported_feature,
+      .code = heif_error_Invalid_input,
       .subcode = heif_suberror_Unspecified,
-      .message = "Only 1, 3 and 4 bands are supported"};
+      .message = "Error decoding TIFF image data."};
     return err;
   }
+
+  return heif_error_ok;
 }
 
 
@@ -412,13 +479,6 @@ heif_error loadTIFF(const char* filename, InputImage *input_image) {
   }
 
   TIFF* tif = tifPtr.get();
-  if (TIFFIsTiled(tif)) {
-    struct heif_error err = {
-      .code = heif_error_Unsupported_feature,
-      .subcode = heif_suberror_Unspecified,
-      .message = "Tiled TIFF images are not supported yet"};
-    return err;
-  }
 
   uint16_t shortv, samplesPerPixel, bps, config, format;
   if (TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &shortv) && shortv == PHOTOMETRIC_PALETTE) {
@@ -429,8 +489,8 @@ heif_error loadTIFF(const char* filename, InputImage *input_image) {
     return err;
   }
 
-  TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &config);
-  TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+  TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &config);
+  TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
   if (samplesPerPixel != 1 && samplesPerPixel != 3 && samplesPerPixel != 4) {
     struct heif_error err = {
       .code = heif_error_Invalid_input,
@@ -456,23 +516,16 @@ heif_error loadTIFF(const char* filename, InputImage *input_image) {
     return err;
   }
 
-  struct heif_error err;
-  struct heif_image* image = nullptr;
-
-  switch (config) {
-    case PLANARCONFIG_CONTIG:
-      err = readPixelInterleave(tif, samplesPerPixel, &image);
-      break;
-    case PLANARCONFIG_SEPARATE:
-      err = readBandInterleave(tif, samplesPerPixel, &image);
-      break;
-    default:
-      struct heif_error err = {
-        .code = heif_error_Invalid_input,
-        .subcode = heif_suberror_Unspecified,
-        .message = "Unsupported planar configuration"};
-      return err;
+  if (config != PLANARCONFIG_CONTIG && config != PLANARCONFIG_SEPARATE) {
+    struct heif_error err = {
+      .code = heif_error_Invalid_input,
+      .subcode = heif_suberror_Unspecified,
+      .message = "Unsupported planar configuration"};
+    return err;
   }
+
+  struct heif_image* image = nullptr;
+  struct heif_error err = readImageData(tif, filename, samplesPerPixel, config, &image);
   if (err.code != heif_error_Ok) {
     return err;
   }
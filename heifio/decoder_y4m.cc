@@ -29,90 +29,105 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
 
 static struct heif_error heif_error_ok = {heif_error_Ok, heif_suberror_Unspecified, "Success"};
 
-heif_error loadY4M(const char *filename, InputImage *input_image)
-{
-
-  struct heif_image* image = nullptr;
 
+static heif_error y4m_error(heif_error_code code, const char* message)
+{
+  struct heif_error err = {
+    .code = code,
+    .subcode = heif_suberror_Unspecified,
+    .message = message};
+  return err;
+}
 
-  // open input file
 
-  std::ifstream istr(filename, std::ios_base::binary);
-  if (istr.fail()) {
-    struct heif_error err = {
-      .code = heif_error_Invalid_input,
-      .subcode = heif_suberror_Unspecified,
-      .message = "Cannot open Y4M file"};
-    return err;
+heif_error Y4MReader::open(const char* filename)
+{
+  m_istr.open(filename, std::ios_base::binary);
+  if (m_istr.fail()) {
+    return y4m_error(heif_error_Invalid_input, "Cannot open Y4M file");
   }
 
-
   std::string header;
-  getline(istr, header);
+  getline(m_istr, header);
 
   if (header.find("YUV4MPEG2 ") != 0) {
-    struct heif_error err = {
-      .code = heif_error_Unsupported_feature,
-      .subcode = heif_suberror_Unspecified,
-      .message = "Input is not a Y4M file."};
-    return err;
+    return y4m_error(heif_error_Unsupported_feature, "Input is not a Y4M file.");
   }
 
-  int w = -1;
-  int h = -1;
+  // --- parse the space separated header tags
 
-  size_t pos = 0;
-  for (;;) {
-    pos = header.find(' ', pos + 1) + 1;
-    if (pos == std::string::npos) {
-      break;
-    }
+  size_t pos = header.find(' ');
+  while (pos != std::string::npos) {
+    size_t start = pos + 1;
+    pos = header.find(' ', start);
 
-    size_t end = header.find_first_of(" \n", pos + 1);
-    if (end == std::string::npos) {
-      break;
+    std::string token = header.substr(start, pos == std::string::npos ? std::string::npos : pos - start);
+    if (token.empty()) {
+      continue;
     }
 
-    if (end - pos <= 1) {
-      struct heif_error err = {
-        .code = heif_error_Unsupported_feature,
-        .subcode = heif_suberror_Unspecified,
-        .message = "Header format error in Y4M file."};
-      return err;
+    if (token.size() == 1) {
+      return y4m_error(heif_error_Unsupported_feature, "Header format error in Y4M file.");
     }
 
-    char tag = header[pos];
-    std::string value = header.substr(pos + 1, end - pos - 1);
+    char tag = token[0];
+    std::string value = token.substr(1);
     if (tag == 'W') {
-      w = atoi(value.c_str());
+      m_width = atoi(value.c_str());
     }
     else if (tag == 'H') {
-      h = atoi(value.c_str());
+      m_height = atoi(value.c_str());
+    }
+    else if (tag == 'F') {
+      unsigned int num = 0, den = 0;
+      if (sscanf(value.c_str(), "%u:%u", &num, &den) == 2 && num > 0 && den > 0) {
+        m_framerate_numerator = num;
+        m_framerate_denominator = den;
+      }
+    }
+    else if (tag == 'C') {
+      // Only 8-bit 4:2:0 is supported. The chroma siting variants (420jpeg, 420paldv, ...) are all read the same way,
+      // higher bit depths are signalled as '420p10' etc.
+      bool high_bit_depth = (value.size() > 4 && value[3] == 'p' && isdigit(value[4]));
+      if (value.compare(0, 3, "420") != 0 || high_bit_depth) {
+        return y4m_error(heif_error_Unsupported_feature, "Only 8-bit 4:2:0 Y4M files are supported.");
+      }
     }
   }
 
-  std::string frameheader;
-  getline(istr, frameheader);
+  if (m_width <= 0 || m_height <= 0) {
+    return y4m_error(heif_error_Unsupported_feature, "Y4M has invalid frame size.");
+  }
 
-  if (frameheader != "FRAME") {
-    struct heif_error err = {
-        .code = heif_error_Unsupported_feature,
-        .subcode = heif_suberror_Unspecified,
-        .message = "Y4M misses the frame header."};
-    return err;
+  return heif_error_ok;
+}
+
+
+heif_error Y4MReader::read_next_frame(InputImage* input_image)
+{
+  input_image->image.reset();
+
+  std::string frameheader;
+  if (!getline(m_istr, frameheader)) {
+    // end of file
+    return heif_error_ok;
   }
 
-  if (w < 0 || h < 0) {
-    struct heif_error err = {
-        .code = heif_error_Unsupported_feature,
-        .subcode = heif_suberror_Unspecified,
-        .message = "Y4M has invalid frame size."};
-    return err;
+  // The frame header may carry parameters after "FRAME", which we ignore.
+  if (frameheader.compare(0, 5, "FRAME") != 0) {
+    return y4m_error(heif_error_Unsupported_feature, "Y4M misses the frame header.");
   }
 
+  const int w = m_width;
+  const int h = m_height;
+
+  struct heif_image* image = nullptr;
   struct heif_error err = heif_image_create(w, h,
                                             heif_colorspace_YCbCr,
                                             heif_chroma_420,
@@ -121,6 +136,8 @@ heif_error loadY4M(const char *filename, InputImage *input_image)
     return err;
   }
 
+  std::shared_ptr<heif_image> img(image, [](heif_image* img) { heif_image_release(img); });
+
   heif_image_add_plane(image, heif_channel_Y, w, h, 8);
   heif_image_add_plane(image, heif_channel_Cb, (w + 1) / 2, (h + 1) / 2, 8);
   heif_image_add_plane(image, heif_channel_Cr, (w + 1) / 2, (h + 1) / 2, 8);
@@ -131,19 +148,43 @@ heif_error loadY4M(const char *filename, InputImage *input_image)
   uint8_t* pcr = heif_image_get_plane2(image, heif_channel_Cr, &cr_stride);
 
   for (int y = 0; y < h; y++) {
-    istr.read((char*) (py + y * y_stride), w);
+    m_istr.read((char*) (py + y * y_stride), w);
   }
 
   for (int y = 0; y < (h + 1) / 2; y++) {
-    istr.read((char*) (pcb + y * cb_stride), (w + 1) / 2);
+    m_istr.read((char*) (pcb + y * cb_stride), (w + 1) / 2);
   }
 
   for (int y = 0; y < (h + 1) / 2; y++) {
-    istr.read((char*) (pcr + y * cr_stride), (w + 1) / 2);
+    m_istr.read((char*) (pcr + y * cr_stride), (w + 1) / 2);
+  }
+
+  if (m_istr.fail()) {
+    return y4m_error(heif_error_Invalid_input, "Y4M frame data is truncated.");
+  }
+
+  input_image->image = std::move(img);
+
+  return heif_error_ok;
+}
+
+
+heif_error loadY4M(const char *filename, InputImage *input_image)
+{
+  Y4MReader reader;
+  heif_error err = reader.open(filename);
+  if (err.code != heif_error_Ok) {
+    return err;
   }
 
-  input_image->image = std::shared_ptr<heif_image>(image,
-                                                   [](heif_image* img) { heif_image_release(img); });
+  err = reader.read_next_frame(input_image);
+  if (err.code != heif_error_Ok) {
+    return err;
+  }
+
+  if (!input_image->image) {
+    return y4m_error(heif_error_Invalid_input, "Y4M file contains no frame.");
+  }
 
   return heif_error_ok;
 }
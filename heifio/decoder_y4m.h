@@ -30,14 +30,46 @@
 #include "decoder.h"
 
 #ifdef __cplusplus
+#include <cstdint>
+#include <fstream>
+
 extern "C" {
 #endif
 
+// Loads the first frame of the Y4M file.
 LIBHEIF_API
 heif_error loadY4M(const char *filename, InputImage *input_image);
 
 #ifdef __cplusplus
 }
+
+
+// Reads the frames of a Y4M file one after the other. Only one frame is held in memory at a time.
+class Y4MReader
+{
+public:
+  heif_error open(const char* filename);
+
+  // At the end of the file, no image is returned.
+  heif_error read_next_frame(InputImage* input_image);
+
+  int get_width() const { return m_width; }
+
+  int get_height() const { return m_height; }
+
+  // Both are 0 when the file does not specify the frame rate.
+  uint32_t get_framerate_numerator() const { return m_framerate_numerator; }
+
+  uint32_t get_framerate_denominator() const { return m_framerate_denominator; }
+
+private:
+  std::ifstream m_istr;
+
+  int m_width = -1;
+  int m_height = -1;
+  uint32_t m_framerate_numerator = 0;
+  uint32_t m_framerate_denominator = 0;
+};
 #endif
 
 #endif //LIBHEIF_DECODER_Y4M_H
@@ -28,6 +28,9 @@
 #include <vector>
 #include <string>
 #include "image-items/image_item.h"
+#include "codecs/decoder.h"
+
+class SampleMultiplexer;
 
 struct heif_image_handle
 {
@@ -38,6 +41,12 @@ struct heif_image_handle
 };
 
 
+struct heif_gpu_surfaces
+{
+  GpuSurfaceList surfaces;
+};
+
+
 struct heif_track
 {
   std::shared_ptr<Track> track;
@@ -46,6 +55,14 @@ struct heif_track
   std::shared_ptr<HeifContext> context;
 };
 
+struct heif_sample_multiplexer
+{
+  std::unique_ptr<SampleMultiplexer> multiplexer;
+
+  std::shared_ptr<HeifContext> context;
+};
+
+
 struct heif_raw_sequence_sample
 {
   ~heif_raw_sequence_sample()
@@ -70,6 +87,10 @@ struct heif_image
 struct heif_context
 {
   std::shared_ptr<HeifContext> context;
+
+  // set by heif_context_start_streaming() and heif_context_start_fragmented_writing()
+  struct heif_writer* streaming_writer = nullptr;
+  void* streaming_userdata = nullptr;
 };
 
 
@@ -83,6 +104,17 @@ struct heif_encoder
 
   void release();
 
+  // Allocate a new instance of the same plugin and copy all parameter values into it.
+  // Since an encoder instance cannot be used from several threads at once, this is used for parallel encoding.
+  Result<std::shared_ptr<heif_encoder>> clone();
+
+  // Access to the standard "threads" parameter (heif_encoder_parameter_name_threads).
+  // The value is clamped to the range supported by the plugin.
+  // These return false if the plugin has no such parameter.
+  bool get_threads_parameter(int* threads) const;
+
+  bool set_threads_parameter(int threads);
+
 
   const struct heif_encoder_plugin* plugin;
   void* encoder = nullptr;
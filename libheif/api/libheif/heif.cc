@@ -32,9 +32,15 @@
 #include "error.h"
 #include "bitstream.h"
 #include "init.h"
+#include "thread_pool.h"
+#include "plane_buffer_pool.h"
+#include "memory_budget.h"
 #include "image-items/grid.h"
 #include "image-items/overlay.h"
 #include "image-items/tiled.h"
+#include "image-items/jpeg.h"
+#include "color-conversion/tensor.h"
+#include "decoding_statistics.h"
 #include <set>
 #include <limits>
 
@@ -569,6 +575,76 @@ heif_error heif_context_read_from_reader(struct heif_context* ctx,
   return err.error_struct(ctx->context.get());
 }
 
+heif_error heif_context_write_header_index(struct heif_context* ctx,
+                                           struct heif_writer* writer,
+                                           void* userdata)
+{
+  if (!writer) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+  else if (writer->writer_api_version < 1 || writer->writer_api_version > 2) {
+    Error err(heif_error_Usage_error, heif_suberror_Unsupported_writer_version);
+    return err.error_struct(ctx->context.get());
+  }
+
+  StreamWriter swriter;
+  Error err = ctx->context->get_heif_file()->write_header_index(swriter);
+  if (err) {
+    return err.error_struct(ctx->context.get());
+  }
+
+  const auto& data = swriter.get_data();
+  heif_error writer_error = writer->write(ctx, data.data(), data.size(), userdata);
+  if (!writer_error.message) {
+    if (writer_error.code == heif_error_Ok) {
+      writer_error.message = Error::kSuccess;
+      return writer_error;
+    }
+    else {
+      return heif_error{heif_error_Usage_error, heif_suberror_Null_pointer_argument, "heif_writer callback returned a null error text"};
+    }
+  }
+
+  return writer_error;
+}
+
+heif_error heif_context_read_from_index(struct heif_context* ctx,
+                                        const void* index, size_t index_size,
+                                        const struct heif_reader* reader_func_table,
+                                        void* userdata,
+                                        const struct heif_reading_options*)
+{
+  if (!index || !reader_func_table) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+
+  auto reader = std::make_shared<StreamReader_CApi>(reader_func_table, userdata);
+
+  Error err = ctx->context->read_with_header_index(reader, static_cast<const uint8_t*>(index), index_size);
+  return err.error_struct(ctx->context.get());
+}
+
+heif_error heif_context_read_from_file_with_index(struct heif_context* ctx,
+                                                  const char* filename,
+                                                  const void* index, size_t index_size,
+                                                  const struct heif_reading_options*)
+{
+  if (!filename || !index) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+
+  auto streamResult = HeifFile::open_file_stream(filename);
+  if (streamResult.error) {
+    return streamResult.error.error_struct(ctx->context.get());
+  }
+
+  Error err = ctx->context->read_with_header_index(*streamResult, static_cast<const uint8_t*>(index), index_size);
+  return err.error_struct(ctx->context.get());
+}
+
 // TODO: heif_error heif_context_read_from_file_descriptor(heif_context*, int fd);
 
 void heif_context_debug_dump_boxes_to_file(struct heif_context* ctx, int fd)
@@ -1295,7 +1371,7 @@ struct heif_error heif_image_handle_get_depth_image_handle(const struct heif_ima
 
 void fill_default_decoding_options(heif_decoding_options& options)
 {
-  options.version = 7;
+  options.version = 14;
 
   options.ignore_transformations = false;
 
@@ -1330,6 +1406,38 @@ void fill_default_decoding_options(heif_decoding_options& options)
   // version 7
 
   options.color_conversion_options_ext = nullptr;
+
+  // version 8
+
+  options.target_scale_denominator = 1;
+
+  // version 9
+
+  options.max_codec_threads = 0;
+
+  // version 10
+
+  options.statistics = nullptr;
+
+  // version 11
+
+  options.max_coded_data_size = 0;
+  options.max_quality_layers = 0;
+
+  // version 12
+
+  options.prioritize_tiles_near_point = false;
+  options.tile_priority_x = 0;
+  options.tile_priority_y = 0;
+  options.on_tile_decoded = nullptr;
+
+  // version 13
+
+  options.low_latency_decoding = false;
+
+  // version 14
+
+  options.deadline_us = 0;
 }
 
 
@@ -1341,6 +1449,31 @@ static heif_decoding_options normalize_options(const heif_decoding_options* inpu
 
   if (input_options) {
     switch (input_options->version) {
+      case 14:
+        options.deadline_us = input_options->deadline_us;
+        // fallthrough
+      case 13:
+        options.low_latency_decoding = input_options->low_latency_decoding;
+        // fallthrough
+      case 12:
+        options.prioritize_tiles_near_point = input_options->prioritize_tiles_near_point;
+        options.tile_priority_x = input_options->tile_priority_x;
+        options.tile_priority_y = input_options->tile_priority_y;
+        options.on_tile_decoded = input_options->on_tile_decoded;
+        // fallthrough
+      case 11:
+        options.max_coded_data_size = input_options->max_coded_data_size;
+        options.max_quality_layers = input_options->max_quality_layers;
+        // fallthrough
+      case 10:
+        options.statistics = input_options->statistics;
+        // fallthrough
+      case 9:
+        options.max_codec_threads = input_options->max_codec_threads;
+        // fallthrough
+      case 8:
+        options.target_scale_denominator = input_options->target_scale_denominator;
+        // fallthrough
       case 7:
         options.color_conversion_options_ext = input_options->color_conversion_options_ext;
         // fallthrough
@@ -1387,6 +1520,12 @@ void heif_color_conversion_options_set_defaults(struct heif_color_conversion_opt
 }
 
 
+uint64_t heif_get_monotonic_time_us()
+{
+  return get_monotonic_time_us();
+}
+
+
 heif_decoding_options* heif_decoding_options_alloc()
 {
   auto options = new heif_decoding_options;
@@ -1403,13 +1542,35 @@ void heif_decoding_options_free(heif_decoding_options* options)
 }
 
 
+heif_decoding_statistics* heif_decoding_statistics_alloc()
+{
+  auto statistics = new heif_decoding_statistics{};
+  statistics->version = 2;
+
+  return statistics;
+}
+
+
+void heif_decoding_statistics_free(heif_decoding_statistics* statistics)
+{
+  delete statistics;
+}
+
+
 void fill_default_color_conversion_options_ext(heif_color_conversion_options_ext& options)
 {
-  options.version = 1;
+  options.version = 6;
   options.alpha_composition_mode = heif_alpha_composition_mode_none;
   options.background_red = options.background_green = options.background_blue = 0xFFFF;
   options.secondary_background_red = options.secondary_background_green = options.secondary_background_blue = 0xCCCC;
   options.checkerboard_square_size = 16;
+  options.max_threads = 1;
+  options.alpha_premultiplication_mode = heif_alpha_premultiplication_mode_keep;
+  options.bit_depth_reduction_method = heif_bit_depth_reduction_method_truncate;
+  options.output_icc_profile = nullptr;
+  options.output_icc_profile_size = 0;
+  options.rendering_intent = heif_rendering_intent_perceptual;
+  options.demosaic_method = heif_demosaic_method_bilinear;
 }
 
 
@@ -1421,6 +1582,23 @@ heif_color_conversion_options_ext normalize_options(const heif_color_conversion_
 
   if (input_options) {
     switch (input_options->version) {
+      case 6:
+        options.demosaic_method = input_options->demosaic_method;
+        // fallthrough
+      case 5:
+        options.output_icc_profile = input_options->output_icc_profile;
+        options.output_icc_profile_size = input_options->output_icc_profile_size;
+        options.rendering_intent = input_options->rendering_intent;
+        // fallthrough
+      case 4:
+        options.bit_depth_reduction_method = input_options->bit_depth_reduction_method;
+        // fallthrough
+      case 3:
+        options.alpha_premultiplication_mode = input_options->alpha_premultiplication_mode;
+        // fallthrough
+      case 2:
+        options.max_threads = input_options->max_threads;
+        // fallthrough
       case 1:
         options.alpha_composition_mode = input_options->alpha_composition_mode;
         options.background_red = input_options->background_red;
@@ -1496,174 +1674,1117 @@ struct heif_error heif_decode_image(const struct heif_image_handle* in_handle,
 }
 
 
-struct heif_error heif_image_handle_decode_image_tile(const struct heif_image_handle* in_handle,
-                                                      struct heif_image** out_img,
-                                                      enum heif_colorspace colorspace,
-                                                      enum heif_chroma chroma,
-                                                      const struct heif_decoding_options* input_options,
-                                                      uint32_t x0, uint32_t y0)
+struct heif_error heif_decode_image_into(const struct heif_image_handle* in_handle,
+                                         heif_colorspace colorspace,
+                                         heif_chroma chroma,
+                                         uint8_t* const planes[],
+                                         const size_t strides[],
+                                         const struct heif_decoding_options* input_options)
 {
-  if (!in_handle) {
-    return error_null_parameter;
+  if (in_handle == nullptr || planes == nullptr || strides == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "NULL argument passed to heif_decode_image_into()"};
   }
 
-  heif_item_id id = in_handle->image->get_id();
+  // --- the planes of the output format, in the order in which they are passed
+
+  std::vector<heif_channel> channels;
+
+  if (chroma == heif_chroma_interleaved_RGB ||
+      chroma == heif_chroma_interleaved_RGBA ||
+      chroma == heif_chroma_interleaved_RRGGBB_BE ||
+      chroma == heif_chroma_interleaved_RRGGBB_LE ||
+      chroma == heif_chroma_interleaved_RRGGBBAA_BE ||
+      chroma == heif_chroma_interleaved_RRGGBBAA_LE) {
+    if (colorspace == heif_colorspace_RGB) {
+      channels = {heif_channel_interleaved};
+    }
+  }
+  else if (colorspace == heif_colorspace_monochrome && chroma == heif_chroma_monochrome) {
+    channels = {heif_channel_Y};
+  }
+  else if (colorspace == heif_colorspace_YCbCr &&
+           (chroma == heif_chroma_420 || chroma == heif_chroma_422 || chroma == heif_chroma_444)) {
+    channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+  }
+  else if (colorspace == heif_colorspace_RGB && chroma == heif_chroma_444) {
+    channels = {heif_channel_R, heif_channel_G, heif_channel_B};
+  }
+
+  if (channels.empty()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unsupported_parameter,
+            "Unsupported colorspace/chroma combination passed to heif_decode_image_into()"};
+  }
+
+  if (channels[0] != heif_channel_interleaved && heif_image_handle_has_alpha_channel(in_handle)) {
+    channels.push_back(heif_channel_Alpha);
+  }
 
   heif_decoding_options dec_options = normalize_options(input_options);
 
-  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image(id,
-                                                                                            colorspace,
-                                                                                            chroma,
-                                                                                            dec_options,
-                                                                                            true, x0,y0);
-  if (decodingResult.error.error_code != heif_error_Ok) {
-    return decodingResult.error.error_struct(in_handle->image.get());
+  int bit_depth = in_handle->image->get_luma_bits_per_pixel();
+  if (dec_options.convert_hdr_to_8bit ||
+      chroma == heif_chroma_interleaved_RGB ||
+      chroma == heif_chroma_interleaved_RGBA) {
+    bit_depth = 8;
   }
 
-  std::shared_ptr<HeifPixelImage> img = decodingResult.value;
 
-  *out_img = new heif_image();
-  (*out_img)->image = std::move(img);
+  // --- wrap the planes of the caller into the target image
 
-  return Error::Ok.error_struct(in_handle->image.get());
-}
+  uint32_t width = in_handle->image->get_width();
+  uint32_t height = in_handle->image->get_height();
 
+  auto target = std::make_shared<HeifPixelImage>();
+  target->create(width, height, colorspace, chroma);
 
+  for (size_t i = 0; i < channels.size(); i++) {
+    heif_channel channel = channels[i];
 
-int heif_image_handle_get_pixel_aspect_ratio(const struct heif_image_handle* handle, uint32_t* aspect_h, uint32_t* aspect_v)
-{
-  auto pasp = handle->image->get_property<Box_pasp>();
-  if (pasp) {
-    *aspect_h = pasp->hSpacing;
-    *aspect_v = pasp->vSpacing;
-    return 1;
-  }
-  else {
-    *aspect_h = 1;
-    *aspect_v = 1;
-    return 0;
+    Error err = target->add_external_plane(channel,
+                                           channel_width(width, chroma, channel),
+                                           channel_height(height, chroma, channel),
+                                           bit_depth, planes[i], strides[i], nullptr);
+    if (err) {
+      return err.error_struct(in_handle->image.get());
+    }
   }
+
+  Error err = in_handle->context->decode_image_into(in_handle->image->get_id(), dec_options, target);
+  return err.error_struct(in_handle->image.get());
 }
 
-void heif_image_handle_release(const struct heif_image_handle* handle)
+
+static void fill_default_tensor_options(heif_tensor_options& options)
 {
-  delete handle;
+  options.version = 1;
+
+  options.layout = heif_tensor_layout_planar;
+  options.datatype = heif_tensor_datatype_float32;
+  options.width = 0;
+  options.height = 0;
+
+  for (int c = 0; c < 3; c++) {
+    options.mean[c] = 0.0f;
+    options.std[c] = 1.0f;
+  }
 }
 
 
-int heif_image_handle_get_number_of_metadata_blocks(const struct heif_image_handle* handle,
-                                                    const char* type_filter)
+struct heif_tensor_options* heif_tensor_options_alloc()
 {
-  int cnt = 0;
-  for (const auto& metadata : handle->image->get_metadata()) {
-    if (type_filter == nullptr ||
-        metadata->item_type == type_filter) {
-      cnt++;
-    }
-  }
+  auto options = new heif_tensor_options;
 
-  return cnt;
+  fill_default_tensor_options(*options);
+
+  return options;
 }
 
 
-int heif_image_handle_get_list_of_metadata_block_IDs(const struct heif_image_handle* handle,
-                                                     const char* type_filter,
-                                                     heif_item_id* ids, int count)
+void heif_tensor_options_free(struct heif_tensor_options* options)
 {
-  int cnt = 0;
-  for (const auto& metadata : handle->image->get_metadata()) {
-    if (type_filter == nullptr ||
-        metadata->item_type == type_filter) {
-      if (cnt < count) {
-        ids[cnt] = metadata->item_id;
-        cnt++;
-      }
-      else {
-        break;
-      }
-    }
-  }
-
-  return cnt;
+  delete options;
 }
 
 
-const char* heif_image_handle_get_metadata_type(const struct heif_image_handle* handle,
-                                                heif_item_id metadata_id)
+struct heif_error heif_decode_image_to_tensor(const struct heif_image_handle* in_handle,
+                                              const struct heif_tensor_options* input_tensor_options,
+                                              void* out_data, size_t out_data_size,
+                                              const struct heif_decoding_options* input_options)
 {
-  for (auto& metadata : handle->image->get_metadata()) {
-    if (metadata->item_id == metadata_id) {
-      return metadata->item_type.c_str();
+  if (in_handle == nullptr || out_data == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "NULL argument passed to heif_decode_image_to_tensor()"};
+  }
+
+  heif_tensor_options tensor_options{};
+  fill_default_tensor_options(tensor_options);
+
+  if (input_tensor_options) {
+    switch (input_tensor_options->version) {
+      case 1:
+        tensor_options.layout = input_tensor_options->layout;
+        tensor_options.datatype = input_tensor_options->datatype;
+        tensor_options.width = input_tensor_options->width;
+        tensor_options.height = input_tensor_options->height;
+        for (int c = 0; c < 3; c++) {
+          tensor_options.mean[c] = input_tensor_options->mean[c];
+          tensor_options.std[c] = input_tensor_options->std[c];
+        }
     }
   }
 
-  return nullptr;
-}
+  heif_decoding_options dec_options = normalize_options(input_options);
 
+  // --- decode in the coded colorspace, the conversion to RGB is part of the tensor computation
 
-const char* heif_image_handle_get_metadata_content_type(const struct heif_image_handle* handle,
-                                                        heif_item_id metadata_id)
-{
-  for (auto& metadata : handle->image->get_metadata()) {
-    if (metadata->item_id == metadata_id) {
-      return metadata->content_type.c_str();
-    }
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image(in_handle->image->get_id(),
+                                                                                            heif_colorspace_undefined,
+                                                                                            heif_chroma_undefined,
+                                                                                            dec_options,
+                                                                                            false, 0, 0);
+  if (decodingResult.error) {
+    return decodingResult.error.error_struct(in_handle->image.get());
   }
 
-  return nullptr;
+  heif_color_conversion_options_ext options_ext = normalize_options(dec_options.color_conversion_options_ext);
+
+  // Without an explicit number of conversion threads, use the decoding threads of the context.
+  if (dec_options.color_conversion_options_ext == nullptr || dec_options.color_conversion_options_ext->version < 2) {
+    options_ext.max_threads = in_handle->context->get_max_decoding_threads();
+  }
+
+  Error err = convert_to_tensor(*decodingResult, tensor_options, out_data, out_data_size,
+                                dec_options.color_conversion_options, options_ext,
+                                in_handle->context->get_security_limits());
+  return err.error_struct(in_handle->image.get());
 }
 
 
-const char* heif_image_handle_get_metadata_item_uri_type(const struct heif_image_handle* handle,
-                                                         heif_item_id metadata_id)
+struct heif_error heif_decode_images(const struct heif_image_handle* const* handles,
+                                     int num_handles,
+                                     const enum heif_colorspace* colorspaces,
+                                     const enum heif_chroma* chromas,
+                                     const struct heif_decoding_options* input_options,
+                                     struct heif_image** out_images,
+                                     struct heif_error* out_errors)
 {
-  for (auto& metadata : handle->image->get_metadata()) {
-    if (metadata->item_id == metadata_id) {
-      return metadata->item_uri_type.c_str();
+  if (num_handles < 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Negative number of handles passed to heif_decode_images()"};
+  }
+
+  if (num_handles > 0 && (!handles || !colorspaces || !chromas || !out_images)) {
+    return error_null_parameter;
+  }
+
+  for (int i = 0; i < num_handles; i++) {
+    if (!handles[i]) {
+      return error_null_parameter;
     }
   }
 
-  return nullptr;
-}
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  auto decode_handle = [&](int i) {
+    const heif_image_handle* handle = handles[i];
+    out_images[i] = nullptr;
+
+    Result<std::shared_ptr<HeifPixelImage>> decodingResult = handle->context->decode_image(handle->image->get_id(),
+                                                                                           colorspaces[i],
+                                                                                           chromas[i],
+                                                                                           dec_options,
+                                                                                           false, 0, 0);
+    if (decodingResult.error) {
+      if (out_errors) {
+        out_errors[i] = decodingResult.error.error_struct(handle->image.get());
+      }
+      return;
+    }
 
+    out_images[i] = new heif_image();
+    out_images[i]->image = std::move(decodingResult.value);
 
-size_t heif_image_handle_get_metadata_size(const struct heif_image_handle* handle,
-                                           heif_item_id metadata_id)
-{
-  for (auto& metadata : handle->image->get_metadata()) {
-    if (metadata->item_id == metadata_id) {
-      return metadata->m_data.size();
+    if (out_errors) {
+      out_errors[i] = heif_error_success;
     }
+  };
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  TaskGroup tasks;
+  for (int i = 0; i < num_handles; i++) {
+    tasks.run([&decode_handle, i]() { decode_handle(i); });
+  }
+  tasks.wait();
+#else
+  for (int i = 0; i < num_handles; i++) {
+    decode_handle(i);
   }
+#endif
 
-  return 0;
+  return heif_error_success;
 }
 
 
-struct heif_error heif_image_handle_get_metadata(const struct heif_image_handle* handle,
-                                                 heif_item_id metadata_id,
-                                                 void* out_data)
+struct heif_error heif_decode_image_async(const struct heif_image_handle* in_handle,
+                                          heif_colorspace colorspace,
+                                          heif_chroma chroma,
+                                          const struct heif_decoding_options* input_options,
+                                          void (*on_completion)(struct heif_image* image, struct heif_error error, void* userdata),
+                                          void* userdata)
 {
-  for (auto& metadata : handle->image->get_metadata()) {
-    if (metadata->item_id == metadata_id) {
+  if (in_handle == nullptr || on_completion == nullptr) {
+    return error_null_parameter;
+  }
 
-      if (!metadata->m_data.empty()) {
-        if (out_data == nullptr) {
-          Error err(heif_error_Usage_error,
-                    heif_suberror_Null_pointer_argument);
-          return err.error_struct(handle->image.get());
-        }
+  // The handle may be released before the decoding starts. Keep the image and the context alive until then.
 
-        memcpy(out_data,
-               metadata->m_data.data(),
-               metadata->m_data.size());
-      }
+  std::shared_ptr<HeifContext> context = in_handle->context;
+  std::shared_ptr<ImageItem> image = in_handle->image;
+  heif_decoding_options dec_options = normalize_options(input_options);
 
-      return Error::Ok.error_struct(handle->image.get());
+  auto decode = [context, image, colorspace, chroma, dec_options, on_completion, userdata]() {
+    Result<std::shared_ptr<HeifPixelImage>> decodingResult = context->decode_image(image->get_id(),
+                                                                                   colorspace,
+                                                                                   chroma,
+                                                                                   dec_options,
+                                                                                   false, 0, 0);
+    if (decodingResult.error) {
+      on_completion(nullptr, decodingResult.error.error_struct(image.get()), userdata);
+      return;
     }
-  }
 
-  Error err(heif_error_Usage_error,
+    auto* out_img = new heif_image();
+    out_img->image = std::move(decodingResult.value);
+
+    on_completion(out_img, heif_error_success, userdata);
+  };
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  auto submit = [decode]() { ThreadPool::global().submit(decode); };
+
+  if (!context->request_image_data_async(image->get_id(), submit)) {
+    submit();
+  }
+#else
+  decode();
+#endif
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_decode_images_from_memory(const void* const* data,
+                                                 const size_t* sizes,
+                                                 int num_inputs,
+                                                 enum heif_colorspace colorspace,
+                                                 enum heif_chroma chroma,
+                                                 const struct heif_decoding_options* input_options,
+                                                 struct heif_image** out_images,
+                                                 struct heif_error* out_errors)
+{
+  if (num_inputs < 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Negative number of inputs passed to heif_decode_images_from_memory()"};
+  }
+
+  if (num_inputs > 0 && (!data || !sizes || !out_images)) {
+    return error_null_parameter;
+  }
+
+  load_plugins_if_not_initialized_yet();
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  auto decode_input = [&](int i) {
+    out_images[i] = nullptr;
+
+    Result<std::shared_ptr<HeifPixelImage>> decodingResult;
+    decodingResult = HeifContext::decode_primary_image_from_memory(data[i], sizes[i], colorspace, chroma, dec_options);
+
+    if (decodingResult.error) {
+      if (out_errors) {
+        // The context that could hold a detailed error message does not exist anymore.
+        out_errors[i] = {decodingResult.error.error_code,
+                         decodingResult.error.sub_error_code,
+                         decodingResult.error.sub_error_code == heif_suberror_Unspecified ?
+                         Error::get_error_string(decodingResult.error.error_code) :
+                         Error::get_error_string(decodingResult.error.sub_error_code)};
+      }
+      return;
+    }
+
+    out_images[i] = new heif_image();
+    out_images[i]->image = std::move(decodingResult.value);
+
+    if (out_errors) {
+      out_errors[i] = heif_error_success;
+    }
+  };
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  TaskGroup tasks;
+  for (int i = 0; i < num_inputs; i++) {
+    tasks.run([&decode_input, i]() { decode_input(i); });
+  }
+  tasks.wait();
+#else
+  for (int i = 0; i < num_inputs; i++) {
+    decode_input(i);
+  }
+#endif
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_context_decode_entity_group(const struct heif_context* ctx,
+                                                  heif_entity_group_id group_id,
+                                                  enum heif_colorspace colorspace,
+                                                  enum heif_chroma chroma,
+                                                  const struct heif_decoding_options* input_options,
+                                                  uint32_t max_width, uint32_t max_height,
+                                                  struct heif_image** out_images,
+                                                  heif_item_id* out_item_ids,
+                                                  struct heif_error* out_errors,
+                                                  int max_images,
+                                                  int* out_num_images)
+{
+  if (!ctx || !out_num_images) {
+    return error_null_parameter;
+  }
+
+  *out_num_images = 0;
+
+  if (max_images < 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Negative number of images passed to heif_context_decode_entity_group()"};
+  }
+
+  if (max_images > 0 && !out_images) {
+    return error_null_parameter;
+  }
+
+  if ((max_width == 0) != (max_height == 0)) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Either both or none of the maximum width and height have to be 0"};
+  }
+
+  std::shared_ptr<Box_EntityToGroup> groupBox = ctx->context->get_heif_file()->get_entity_group(group_id);
+  if (!groupBox) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Nonexisting_item_referenced,
+                 "Entity group does not exist").error_struct(ctx->context.get());
+  }
+
+  std::vector<std::shared_ptr<ImageItem>> images;
+  for (heif_item_id id : groupBox->get_item_ids()) {
+    if (images.size() == static_cast<size_t>(max_images)) {
+      break;
+    }
+
+    std::shared_ptr<ImageItem> image = ctx->context->get_image(id, true);
+    if (image) {
+      images.push_back(std::move(image));
+    }
+  }
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  // All images are decoded with the decoder instance pool of the context, which is shared between the threads.
+
+  auto decode_member = [&](size_t i) {
+    const std::shared_ptr<ImageItem>& image = images[i];
+    out_images[i] = nullptr;
+
+    Result<std::shared_ptr<HeifPixelImage>> decodingResult;
+    if (max_width == 0) {
+      decodingResult = ctx->context->decode_image(image->get_id(), colorspace, chroma, dec_options, false, 0, 0);
+    }
+    else {
+      decodingResult = ctx->context->decode_image_at_size(image->get_id(), colorspace, chroma, dec_options,
+                                                          max_width, max_height);
+    }
+
+    if (decodingResult.error) {
+      if (out_errors) {
+        out_errors[i] = decodingResult.error.error_struct(image.get());
+      }
+      return;
+    }
+
+    out_images[i] = new heif_image();
+    out_images[i]->image = std::move(decodingResult.value);
+
+    if (out_errors) {
+      out_errors[i] = heif_error_success;
+    }
+  };
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  TaskGroup tasks;
+  for (size_t i = 0; i < images.size(); i++) {
+    tasks.run([&decode_member, i]() { decode_member(i); });
+  }
+  tasks.wait();
+#else
+  for (size_t i = 0; i < images.size(); i++) {
+    decode_member(i);
+  }
+#endif
+
+  if (out_item_ids) {
+    for (size_t i = 0; i < images.size(); i++) {
+      out_item_ids[i] = images[i]->get_id();
+    }
+  }
+
+  *out_num_images = static_cast<int>(images.size());
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_image_handle_decode_image_tile(const struct heif_image_handle* in_handle,
+                                                      struct heif_image** out_img,
+                                                      enum heif_colorspace colorspace,
+                                                      enum heif_chroma chroma,
+                                                      const struct heif_decoding_options* input_options,
+                                                      uint32_t x0, uint32_t y0)
+{
+  if (!in_handle) {
+    return error_null_parameter;
+  }
+
+  heif_item_id id = in_handle->image->get_id();
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image(id,
+                                                                                            colorspace,
+                                                                                            chroma,
+                                                                                            dec_options,
+                                                                                            true, x0,y0);
+  if (decodingResult.error.error_code != heif_error_Ok) {
+    return decodingResult.error.error_struct(in_handle->image.get());
+  }
+
+  std::shared_ptr<HeifPixelImage> img = decodingResult.value;
+
+  *out_img = new heif_image();
+  (*out_img)->image = std::move(img);
+
+  return Error::Ok.error_struct(in_handle->image.get());
+}
+
+
+
+struct heif_error heif_image_handle_decode_to_gpu_surfaces(const struct heif_image_handle* in_handle,
+                                                          enum heif_gpu_surface_type type,
+                                                          const struct heif_decoding_options* input_options,
+                                                          struct heif_gpu_surfaces** out_surfaces)
+{
+  if (!in_handle || !out_surfaces) {
+    return error_null_parameter;
+  }
+
+  *out_surfaces = nullptr;
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  auto surfaces = std::make_unique<heif_gpu_surfaces>();
+
+  Error err = in_handle->context->decode_image_to_gpu_surfaces(in_handle->image->get_id(), type, dec_options,
+                                                               surfaces->surfaces);
+  if (err) {
+    return err.error_struct(in_handle->image.get());
+  }
+
+  *out_surfaces = surfaces.release();
+
+  return heif_error_success;
+}
+
+
+int heif_gpu_surfaces_get_number_of_tiles(const struct heif_gpu_surfaces* surfaces)
+{
+  if (!surfaces) {
+    return 0;
+  }
+
+  return static_cast<int>(surfaces->surfaces.get_tiles().size());
+}
+
+
+const struct heif_gpu_surface_tile* heif_gpu_surfaces_get_tile(const struct heif_gpu_surfaces* surfaces, int index)
+{
+  if (!surfaces || index < 0 || static_cast<size_t>(index) >= surfaces->surfaces.get_tiles().size()) {
+    return nullptr;
+  }
+
+  return &surfaces->surfaces.get_tiles()[index];
+}
+
+
+void heif_gpu_surfaces_release(struct heif_gpu_surfaces* surfaces)
+{
+  delete surfaces;
+}
+
+struct heif_error heif_decode_image_region(const struct heif_image_handle* in_handle,
+                                           struct heif_image** out_img,
+                                           enum heif_colorspace colorspace,
+                                           enum heif_chroma chroma,
+                                           const struct heif_decoding_options* input_options,
+                                           uint32_t x0, uint32_t y0, uint32_t width, uint32_t height)
+{
+  if (out_img == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "NULL out_img passed to heif_decode_image_region()"};
+  }
+
+  if (!in_handle) {
+    return error_null_parameter;
+  }
+
+  *out_img = nullptr;
+  heif_item_id id = in_handle->image->get_id();
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image_region(id,
+                                                                                                   colorspace,
+                                                                                                   chroma,
+                                                                                                   dec_options,
+                                                                                                   x0, y0, width, height);
+  if (decodingResult.error.error_code != heif_error_Ok) {
+    return decodingResult.error.error_struct(in_handle->image.get());
+  }
+
+  *out_img = new heif_image();
+  (*out_img)->image = std::move(decodingResult.value);
+
+  return Error::Ok.error_struct(in_handle->image.get());
+}
+
+
+struct heif_error heif_image_handle_get_next_progressive_data_range(const struct heif_image_handle* handle,
+                                                                    uint64_t coded_data_size,
+                                                                    uint64_t* out_next_coded_data_size,
+                                                                    uint64_t* out_file_range_start,
+                                                                    uint64_t* out_file_range_end)
+{
+  if (!handle) {
+    return error_null_parameter;
+  }
+
+  Result<uint64_t> nextSizeResult = handle->image->get_next_progressive_data_size(coded_data_size);
+  if (nextSizeResult.error) {
+    return nextSizeResult.error.error_struct(handle->image.get());
+  }
+
+  uint64_t next_size = *nextSizeResult;
+
+  std::vector<std::pair<uint64_t, uint64_t>> file_ranges;
+  if (next_size > coded_data_size) {
+    handle->context->get_heif_file()->get_item_file_ranges(handle->image->get_id(), coded_data_size,
+                                                           next_size - coded_data_size, file_ranges);
+  }
+
+  uint64_t range_start = 0, range_end = 0;
+  if (!file_ranges.empty()) {
+    range_start = file_ranges[0].first;
+    range_end = file_ranges[0].second;
+
+    for (const auto& range : file_ranges) {
+      range_start = std::min(range_start, range.first);
+      range_end = std::max(range_end, range.second);
+    }
+  }
+
+  if (out_next_coded_data_size) {
+    *out_next_coded_data_size = next_size;
+  }
+
+  if (out_file_range_start) {
+    *out_file_range_start = range_start;
+  }
+
+  if (out_file_range_end) {
+    *out_file_range_end = range_end;
+  }
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_decode_image_incremental(const struct heif_image_handle* in_handle,
+                                               struct heif_image** out_img,
+                                               enum heif_colorspace colorspace,
+                                               enum heif_chroma chroma,
+                                               const struct heif_decoding_options* input_options,
+                                               uint64_t available_file_size,
+                                               int* out_is_complete)
+{
+  if (out_img == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "NULL out_img passed to heif_decode_image_incremental()"};
+  }
+
+  if (!in_handle) {
+    return error_null_parameter;
+  }
+
+  *out_img = nullptr;
+  if (out_is_complete) {
+    *out_is_complete = 0;
+  }
+
+  const std::shared_ptr<ImageItem>& image = in_handle->image;
+  std::shared_ptr<HeifFile> file = in_handle->context->get_heif_file();
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  Error error_not_loaded{heif_error_Invalid_input,
+                         heif_suberror_End_of_data,
+                         "Not enough image data loaded for incremental decoding"};
+
+  if (image->get_compression_format() == heif_compression_undefined) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_image_type,
+                 "Incremental decoding is only supported for coded images"}.error_struct(image.get());
+  }
+
+  if (const auto& alpha = image->get_alpha_channel()) {
+    auto alphaSizeResult = file->get_item_data_size(alpha->get_id());
+    auto alphaAvailableResult = file->get_available_item_data_size(alpha->get_id(), available_file_size);
+    if (alphaSizeResult.error || alphaAvailableResult.error || *alphaAvailableResult < *alphaSizeResult) {
+      return error_not_loaded.error_struct(image.get());
+    }
+  }
+
+  auto sizeResult = file->get_item_data_size(image->get_id());
+  if (sizeResult.error) {
+    return sizeResult.error.error_struct(image.get());
+  }
+
+  auto availableResult = file->get_available_item_data_size(image->get_id(), available_file_size);
+  if (availableResult.error) {
+    return availableResult.error.error_struct(image.get());
+  }
+
+  bool is_complete = (*availableResult >= *sizeResult);
+
+  if (!is_complete) {
+    uint64_t data_size = image->get_incremental_decoding_data_size(*availableResult);
+    if (data_size == 0) {
+      return error_not_loaded.error_struct(image.get());
+    }
+
+    const heif_decoder_plugin* plugin = get_decoder(image->get_compression_format(), dec_options.decoder_id);
+    if (!plugin || plugin->plugin_api_version < 4 || plugin->set_progressive_decoding == nullptr) {
+      return Error{heif_error_Unsupported_feature,
+                   heif_suberror_Unsupported_codec,
+                   "The decoder plugin cannot decode truncated data"}.error_struct(image.get());
+    }
+
+    dec_options.max_coded_data_size = data_size;
+  }
+
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image(image->get_id(),
+                                                                                            colorspace,
+                                                                                            chroma,
+                                                                                            dec_options,
+                                                                                            false, 0, 0);
+  if (decodingResult.error) {
+    return decodingResult.error.error_struct(image.get());
+  }
+
+  *out_img = new heif_image();
+  (*out_img)->image = std::move(decodingResult.value);
+
+  if (out_is_complete) {
+    *out_is_complete = is_complete;
+  }
+
+  return Error::Ok.error_struct(image.get());
+}
+
+
+struct heif_error heif_image_handle_get_jpeg_bitstream(const struct heif_image_handle* handle,
+                                                       uint8_t** out_data, size_t* out_data_size)
+{
+  if (!handle || !out_data || !out_data_size) {
+    return error_null_parameter;
+  }
+
+  *out_data = nullptr;
+  *out_data_size = 0;
+
+  auto jpeg = std::dynamic_pointer_cast<ImageItem_JPEG>(handle->image);
+  if (!jpeg) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_image_type,
+                 "The image is not coded as JPEG"}.error_struct(handle->image.get());
+  }
+
+  Result<std::vector<uint8_t>> dataResult = jpeg->get_jpeg_bitstream();
+  if (dataResult.error) {
+    return dataResult.error.error_struct(handle->image.get());
+  }
+
+  *out_data = new uint8_t[dataResult.value.size()];
+  memcpy(*out_data, dataResult.value.data(), dataResult.value.size());
+  *out_data_size = dataResult.value.size();
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_image_handle_get_annexb_bitstream(const struct heif_image_handle* handle,
+                                                         uint8_t** out_data, size_t* out_data_size)
+{
+  if (!handle || !out_data || !out_data_size) {
+    return error_null_parameter;
+  }
+
+  *out_data = nullptr;
+  *out_data_size = 0;
+
+  Result<std::vector<uint8_t>> dataResult = handle->image->get_annexb_bitstream();
+  if (dataResult.error) {
+    return dataResult.error.error_struct(handle->image.get());
+  }
+
+  *out_data = new uint8_t[dataResult.value.size()];
+  memcpy(*out_data, dataResult.value.data(), dataResult.value.size());
+  *out_data_size = dataResult.value.size();
+
+  return heif_error_success;
+}
+
+
+void heif_release_bitstream_data(uint8_t** data)
+{
+  if (data) {
+    delete[] *data;
+    *data = nullptr;
+  }
+}
+
+
+struct heif_error heif_decode_image_at_size(const struct heif_image_handle* in_handle,
+                                            struct heif_image** out_img,
+                                            enum heif_colorspace colorspace,
+                                            enum heif_chroma chroma,
+                                            const struct heif_decoding_options* input_options,
+                                            uint32_t max_width, uint32_t max_height)
+{
+  if (out_img == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "NULL out_img passed to heif_decode_image_at_size()"};
+  }
+
+  if (!in_handle) {
+    return error_null_parameter;
+  }
+
+  *out_img = nullptr;
+  heif_item_id id = in_handle->image->get_id();
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image_at_size(id,
+                                                                                                    colorspace,
+                                                                                                    chroma,
+                                                                                                    dec_options,
+                                                                                                    max_width, max_height);
+  if (decodingResult.error.error_code != heif_error_Ok) {
+    return decodingResult.error.error_struct(in_handle->image.get());
+  }
+
+  *out_img = new heif_image();
+  (*out_img)->image = std::move(decodingResult.value);
+
+  return Error::Ok.error_struct(in_handle->image.get());
+}
+
+
+int heif_image_handle_get_number_of_pyramid_layers(const struct heif_image_handle* handle)
+{
+  if (!handle) {
+    return 0;
+  }
+
+  return static_cast<int>(handle->context->get_pyramid_layers(handle->image->get_id()).size());
+}
+
+
+struct heif_error heif_image_handle_get_pyramid_layer(const struct heif_image_handle* handle,
+                                                      int layer_index,
+                                                      int process_image_transformations,
+                                                      heif_item_id* out_layer_image_id,
+                                                      struct heif_image_tiling* out_tiling)
+{
+  if (!handle) {
+    return error_null_parameter;
+  }
+
+  auto layers = handle->context->get_pyramid_layers(handle->image->get_id());
+  if (layer_index < 0 || static_cast<size_t>(layer_index) >= layers.size()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Pyramid layer index out of range"};
+  }
+
+  const std::shared_ptr<ImageItem>& layer = layers[layer_index];
+
+  if (out_layer_image_id) {
+    *out_layer_image_id = layer->get_id();
+  }
+
+  if (out_tiling) {
+    *out_tiling = layer->get_heif_image_tiling();
+
+    if (process_image_transformations) {
+      Error error = layer->process_image_transformations_on_tiling(*out_tiling);
+      if (error) {
+        return error.error_struct(handle->context.get());
+      }
+    }
+  }
+
+  return heif_error_ok;
+}
+
+
+struct heif_error heif_decode_image_region_at_scale(const struct heif_image_handle* in_handle,
+                                                    struct heif_image** out_img,
+                                                    enum heif_colorspace colorspace,
+                                                    enum heif_chroma chroma,
+                                                    const struct heif_decoding_options* input_options,
+                                                    uint32_t x0, uint32_t y0, uint32_t width, uint32_t height,
+                                                    uint32_t out_width, uint32_t out_height)
+{
+  if (out_img == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "NULL out_img passed to heif_decode_image_region_at_scale()"};
+  }
+
+  if (!in_handle) {
+    return error_null_parameter;
+  }
+
+  *out_img = nullptr;
+  heif_item_id id = in_handle->image->get_id();
+
+  heif_decoding_options dec_options = normalize_options(input_options);
+
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = in_handle->context->decode_image_region_at_scale(id,
+                                                                                                            colorspace,
+                                                                                                            chroma,
+                                                                                                            dec_options,
+                                                                                                            x0, y0, width, height,
+                                                                                                            out_width, out_height);
+  if (decodingResult.error.error_code != heif_error_Ok) {
+    return decodingResult.error.error_struct(in_handle->image.get());
+  }
+
+  *out_img = new heif_image();
+  (*out_img)->image = std::move(decodingResult.value);
+
+  return Error::Ok.error_struct(in_handle->image.get());
+}
+
+
+int heif_image_handle_get_pixel_aspect_ratio(const struct heif_image_handle* handle, uint32_t* aspect_h, uint32_t* aspect_v)
+{
+  auto pasp = handle->image->get_property<Box_pasp>();
+  if (pasp) {
+    *aspect_h = pasp->hSpacing;
+    *aspect_v = pasp->vSpacing;
+    return 1;
+  }
+  else {
+    *aspect_h = 1;
+    *aspect_v = 1;
+    return 0;
+  }
+}
+
+void heif_image_handle_release(const struct heif_image_handle* handle)
+{
+  delete handle;
+}
+
+
+int heif_image_handle_get_number_of_metadata_blocks(const struct heif_image_handle* handle,
+                                                    const char* type_filter)
+{
+  int cnt = 0;
+  for (const auto& metadata : handle->image->get_metadata()) {
+    if (type_filter == nullptr ||
+        metadata->item_type == type_filter) {
+      cnt++;
+    }
+  }
+
+  return cnt;
+}
+
+
+int heif_image_handle_get_list_of_metadata_block_IDs(const struct heif_image_handle* handle,
+                                                     const char* type_filter,
+                                                     heif_item_id* ids, int count)
+{
+  int cnt = 0;
+  for (const auto& metadata : handle->image->get_metadata()) {
+    if (type_filter == nullptr ||
+        metadata->item_type == type_filter) {
+      if (cnt < count) {
+        ids[cnt] = metadata->item_id;
+        cnt++;
+      }
+      else {
+        break;
+      }
+    }
+  }
+
+  return cnt;
+}
+
+
+const char* heif_image_handle_get_metadata_type(const struct heif_image_handle* handle,
+                                                heif_item_id metadata_id)
+{
+  for (auto& metadata : handle->image->get_metadata()) {
+    if (metadata->item_id == metadata_id) {
+      return metadata->item_type.c_str();
+    }
+  }
+
+  return nullptr;
+}
+
+
+const char* heif_image_handle_get_metadata_content_type(const struct heif_image_handle* handle,
+                                                        heif_item_id metadata_id)
+{
+  for (auto& metadata : handle->image->get_metadata()) {
+    if (metadata->item_id == metadata_id) {
+      return metadata->content_type.c_str();
+    }
+  }
+
+  return nullptr;
+}
+
+
+const char* heif_image_handle_get_metadata_item_uri_type(const struct heif_image_handle* handle,
+                                                         heif_item_id metadata_id)
+{
+  for (auto& metadata : handle->image->get_metadata()) {
+    if (metadata->item_id == metadata_id) {
+      return metadata->item_uri_type.c_str();
+    }
+  }
+
+  return nullptr;
+}
+
+
+size_t heif_image_handle_get_metadata_size(const struct heif_image_handle* handle,
+                                           heif_item_id metadata_id)
+{
+  for (auto& metadata : handle->image->get_metadata()) {
+    if (metadata->item_id == metadata_id) {
+      if (metadata->m_compressed) {
+        auto sizeResult = handle->context->get_decompressed_metadata_size(metadata_id);
+        return sizeResult.error ? 0 : sizeResult.value;
+      }
+
+      return metadata->get_data().size();
+    }
+  }
+
+  return 0;
+}
+
+
+struct heif_error heif_image_handle_get_metadata(const struct heif_image_handle* handle,
+                                                 heif_item_id metadata_id,
+                                                 void* out_data)
+{
+  for (auto& metadata : handle->image->get_metadata()) {
+    if (metadata->item_id == metadata_id) {
+
+      std::shared_ptr<const std::vector<uint8_t>> decompressed_data;
+      std::span<const uint8_t> data;
+      if (metadata->m_compressed) {
+        auto dataResult = handle->context->get_decompressed_metadata(metadata_id);
+        if (dataResult.error) {
+          return dataResult.error.error_struct(handle->image.get());
+        }
+
+        decompressed_data = dataResult.value;
+        data = *decompressed_data;
+      }
+      else {
+        data = metadata->get_data();
+      }
+
+      if (!data.empty()) {
+        if (out_data == nullptr) {
+          Error err(heif_error_Usage_error,
+                    heif_suberror_Null_pointer_argument);
+          return err.error_struct(handle->image.get());
+        }
+
+        memcpy(out_data,
+               data.data(),
+               data.size());
+      }
+
+      return Error::Ok.error_struct(handle->image.get());
+    }
+  }
+
+  Error err(heif_error_Usage_error,
+            heif_suberror_Nonexisting_item_referenced);
+  return err.error_struct(handle->image.get());
+}
+
+
+struct heif_error heif_image_handle_get_metadata_borrowed(const struct heif_image_handle* handle,
+                                                          heif_item_id metadata_id,
+                                                          const uint8_t** out_data,
+                                                          size_t* out_data_size)
+{
+  if (!out_data || !out_data_size) {
+    Error err(heif_error_Usage_error,
+              heif_suberror_Null_pointer_argument);
+    return err.error_struct(handle->image.get());
+  }
+
+  for (auto& metadata : handle->image->get_metadata()) {
+    if (metadata->item_id == metadata_id) {
+      std::span<const uint8_t> data = metadata->get_data();
+
+      // The decompressed data may be evicted from the cache. The context keeps a reference that stays valid.
+      if (metadata->m_compressed) {
+        auto dataResult = handle->context->get_borrowed_item_data(metadata_id, nullptr);
+        if (dataResult.error) {
+          *out_data = nullptr;
+          *out_data_size = 0;
+          return dataResult.error.error_struct(handle->image.get());
+        }
+
+        data = dataResult.value;
+      }
+
+      *out_data = data.data();
+      *out_data_size = data.size();
+
+      return Error::Ok.error_struct(handle->image.get());
+    }
+  }
+
+  *out_data = nullptr;
+  *out_data_size = 0;
+
+  Error err(heif_error_Usage_error,
             heif_suberror_Nonexisting_item_referenced);
   return err.error_struct(handle->image.get());
 }
@@ -1780,26 +2901,89 @@ void heif_context_reset(struct heif_context* ctx)
 static struct heif_error heif_file_writer_write(struct heif_context* ctx,
                                                 const void* data, size_t size, void* userdata)
 {
-  const char* filename = static_cast<const char*>(userdata);
+  auto* ostr = static_cast<std::ofstream*>(userdata);
+
+  ostr->write(static_cast<const char*>(data), size);
+  if (!*ostr) {
+    return Error(heif_error_Encoding_error,
+                 heif_suberror_Cannot_write_output_data,
+                 "Could not write to output file").error_struct(ctx->context.get());
+  }
+
+  return Error::Ok.error_struct(ctx->context.get());
+}
+
+
+static struct heif_error heif_file_writer_seek(struct heif_context* ctx,
+                                               uint64_t position, void* userdata)
+{
+  auto* ostr = static_cast<std::ofstream*>(userdata);
+
+  ostr->seekp(static_cast<std::streamoff>(position));
+  if (!*ostr) {
+    return Error(heif_error_Encoding_error,
+                 heif_suberror_Cannot_write_output_data,
+                 "Could not seek in output file").error_struct(ctx->context.get());
+  }
+
+  return Error::Ok.error_struct(ctx->context.get());
+}
 
+
+struct heif_error heif_context_write_to_file(struct heif_context* ctx,
+                                             const char* filename)
+{
 #if defined(__MINGW32__) || defined(__MINGW64__) || defined(_MSC_VER)
   std::ofstream ostr(HeifFile::convert_utf8_path_to_utf16(filename).c_str(), std::ios_base::binary);
 #else
   std::ofstream ostr(filename, std::ios_base::binary);
 #endif
-  ostr.write(static_cast<const char*>(data), size);
-  // TODO: handle write errors
-  return Error::Ok.error_struct(ctx->context.get());
+
+  if (!ostr) {
+    return Error(heif_error_Encoding_error,
+                 heif_suberror_Cannot_write_output_data,
+                 "Could not open output file").error_struct(ctx->context.get());
+  }
+
+  heif_writer writer{};
+  writer.writer_api_version = 2;
+  writer.write = heif_file_writer_write;
+  writer.seek = heif_file_writer_seek;
+  return heif_context_write(ctx, &writer, &ostr);
 }
 
 
-struct heif_error heif_context_write_to_file(struct heif_context* ctx,
-                                             const char* filename)
+static Error writer_error_to_Error(const heif_error& writer_error)
 {
-  heif_writer writer;
-  writer.writer_api_version = 1;
-  writer.write = heif_file_writer_write;
-  return heif_context_write(ctx, &writer, (void*) filename);
+  if (writer_error.code == heif_error_Ok) {
+    return Error::Ok;
+  }
+  else if (!writer_error.message) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "heif_writer callback returned a null error text"};
+  }
+  else {
+    return {writer_error.code, writer_error.subcode, writer_error.message};
+  }
+}
+
+
+static OutputWriteFunction get_output_write_function(struct heif_context* ctx, struct heif_writer* writer, void* userdata)
+{
+  return [ctx, writer, userdata](const uint8_t* data, size_t size) {
+    return writer_error_to_Error(writer->write(ctx, data, size, userdata));
+  };
+}
+
+
+static OutputSeekFunction get_output_seek_function(struct heif_context* ctx, struct heif_writer* writer, void* userdata)
+{
+  if (writer->writer_api_version < 2 || !writer->seek) {
+    return nullptr;
+  }
+
+  return [ctx, writer, userdata](uint64_t position) {
+    return writer_error_to_Error(writer->seek(ctx, position, userdata));
+  };
 }
 
 
@@ -1811,13 +2995,28 @@ struct heif_error heif_context_write(struct heif_context* ctx,
     return Error(heif_error_Usage_error,
                  heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
   }
-  else if (writer->writer_api_version != 1) {
+  else if (writer->writer_api_version < 1 || writer->writer_api_version > 2) {
     Error err(heif_error_Usage_error, heif_suberror_Unsupported_writer_version);
     return err.error_struct(ctx->context.get());
   }
+  else if (ctx->streaming_writer &&
+           (writer != ctx->streaming_writer || userdata != ctx->streaming_userdata)) {
+    Error err(heif_error_Usage_error, heif_suberror_Unspecified,
+              "A streamed file has to be written with the writer that was passed when streaming was started");
+    return err.error_struct(ctx->context.get());
+  }
+
+  if (writer->writer_api_version >= 2 || ctx->streaming_writer) {
+    Error err = ctx->context->write(get_output_write_function(ctx, writer, userdata),
+                                    get_output_seek_function(ctx, writer, userdata));
+    return err.error_struct(ctx->context.get());
+  }
 
   StreamWriter swriter;
-  ctx->context->write(swriter);
+  Error err = ctx->context->write(swriter);
+  if (err) {
+    return err.error_struct(ctx->context.get());
+  }
 
   const auto& data = swriter.get_data();
   heif_error writer_error = writer->write(ctx, data.data(), data.size(), userdata);
@@ -1837,6 +3036,84 @@ struct heif_error heif_context_write(struct heif_context* ctx,
 }
 
 
+struct heif_error heif_context_store_image_data_in_temporary_file(struct heif_context* ctx)
+{
+  Error err = ctx->context->get_heif_file()->set_write_mode(FileLayout::WriteMode::TmpFile);
+  return err.error_struct(ctx->context.get());
+}
+
+
+void heif_context_set_write_mini_format(struct heif_context* ctx, int enable)
+{
+  ctx->context->get_heif_file()->set_write_mini_format(enable != 0);
+}
+
+
+void heif_context_set_image_data_order(struct heif_context* ctx, enum heif_image_data_order order)
+{
+  ctx->context->set_image_data_order(order);
+}
+
+
+struct heif_error heif_context_start_streaming(struct heif_context* ctx,
+                                               struct heif_writer* writer,
+                                               void* userdata)
+{
+  if (!writer) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+  else if (writer->writer_api_version < 2 || writer->writer_api_version > 2 || !writer->seek) {
+    Error err(heif_error_Usage_error, heif_suberror_Unsupported_writer_version,
+              "Streaming requires a version 2 heif_writer with a seek() function");
+    return err.error_struct(ctx->context.get());
+  }
+
+  Error err = ctx->context->get_heif_file()->start_streaming(get_output_write_function(ctx, writer, userdata),
+                                                             get_output_seek_function(ctx, writer, userdata));
+  if (err) {
+    return err.error_struct(ctx->context.get());
+  }
+
+  ctx->streaming_writer = writer;
+  ctx->streaming_userdata = userdata;
+
+  return Error::Ok.error_struct(ctx->context.get());
+}
+
+
+struct heif_error heif_context_start_fragmented_writing(struct heif_context* ctx,
+                                                        struct heif_writer* writer,
+                                                        void* userdata,
+                                                        uint32_t samples_per_fragment)
+{
+  if (!writer) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+  else if (writer->writer_api_version < 1 || writer->writer_api_version > 2) {
+    Error err(heif_error_Usage_error, heif_suberror_Unsupported_writer_version);
+    return err.error_struct(ctx->context.get());
+  }
+  else if (samples_per_fragment == 0) {
+    Error err(heif_error_Usage_error, heif_suberror_Invalid_parameter_value,
+              "A fragment has to contain at least one sample");
+    return err.error_struct(ctx->context.get());
+  }
+
+  Error err = ctx->context->start_fragmented_writing(get_output_write_function(ctx, writer, userdata),
+                                                     samples_per_fragment);
+  if (err) {
+    return err.error_struct(ctx->context.get());
+  }
+
+  ctx->streaming_writer = writer;
+  ctx->streaming_userdata = userdata;
+
+  return Error::Ok.error_struct(ctx->context.get());
+}
+
+
 void heif_context_add_compatible_brand(struct heif_context* ctx,
                                        heif_brand2 compatible_brand)
 {
@@ -2039,11 +3316,11 @@ struct heif_error heif_context_get_encoder_for_format(struct heif_context* conte
     return err.error_struct(context ? context->context.get() : nullptr);
   }
 
-  std::vector<const struct heif_encoder_descriptor*> descriptors;
-  descriptors = get_filtered_encoder_descriptors(format, nullptr);
+  // Note: only loads the plugins that may have a higher priority than the already loaded ones.
+  const struct heif_encoder_plugin* plugin = get_encoder(format);
 
-  if (descriptors.size() > 0) {
-    *encoder = new struct heif_encoder(descriptors[0]->plugin);
+  if (plugin) {
+    *encoder = new struct heif_encoder(plugin);
     return (*encoder)->alloc();
   }
   else {
@@ -2088,14 +3365,31 @@ struct heif_error heif_encoder_set_lossy_quality(struct heif_encoder* encoder,
 }
 
 
-struct heif_error heif_encoder_set_lossless(struct heif_encoder* encoder, int enable)
+struct heif_error heif_encoder_set_lossless(struct heif_encoder* encoder, int enable)
+{
+  if (!encoder) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(nullptr);
+  }
+
+  return encoder->plugin->set_parameter_lossless(encoder->encoder, enable);
+}
+
+
+struct heif_error heif_encoder_set_speed_class(struct heif_encoder* encoder, int speed_class)
 {
   if (!encoder) {
     return Error(heif_error_Usage_error,
                  heif_suberror_Null_pointer_argument).error_struct(nullptr);
   }
 
-  return encoder->plugin->set_parameter_lossless(encoder->encoder, enable);
+  if (speed_class < 0 || speed_class > 9) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Speed class must be in the range 0-9"};
+  }
+
+  return encoder->plugin->set_parameter_integer(encoder->encoder, heif_encoder_parameter_name_speed_class, speed_class);
 }
 
 
@@ -2481,7 +3775,7 @@ int heif_encoder_has_default(struct heif_encoder* encoder,
 
 void set_default_encoding_options(heif_encoding_options& options)
 {
-  options.version = 7;
+  options.version = 8;
 
   options.save_alpha_channel = true;
   options.macOS_compatibility_workaround = false;
@@ -2496,11 +3790,16 @@ void set_default_encoding_options(heif_encoding_options& options)
   options.color_conversion_options.only_use_preferred_chroma_algorithm = false;
 
   options.prefer_uncC_short_form = true;
+
+  options.grid_tile_size = 0;
 }
 
 void copy_options(heif_encoding_options& options, const heif_encoding_options& input_options)
 {
   switch (input_options.version) {
+    case 8:
+      options.grid_tile_size = input_options.grid_tile_size;
+      // fallthrough
     case 7:
       options.prefer_uncC_short_form = input_options.prefer_uncC_short_form;
       // fallthrough
@@ -2541,23 +3840,12 @@ void heif_encoding_options_free(heif_encoding_options* options)
   delete options;
 }
 
-struct heif_error heif_context_encode_image(struct heif_context* ctx,
-                                            const struct heif_image* input_image,
-                                            struct heif_encoder* encoder,
-                                            const struct heif_encoding_options* input_options,
-                                            struct heif_image_handle** out_image_handle)
+// When no output nclx profile is set, the one of the input image is used. It is stored in 'nclx'.
+static void get_image_encoding_options(heif_encoding_options& options,
+                                       heif_color_profile_nclx& nclx,
+                                       const struct heif_encoding_options* input_options,
+                                       const struct heif_image* input_image)
 {
-  if (!encoder) {
-    return Error(heif_error_Usage_error,
-                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
-  }
-
-  if (out_image_handle) {
-    *out_image_handle = nullptr;
-  }
-
-  heif_encoding_options options;
-  heif_color_profile_nclx nclx;
   set_default_encoding_options(options);
   if (input_options) {
     copy_options(options, *input_options);
@@ -2574,17 +3862,13 @@ struct heif_error heif_context_encode_image(struct heif_context* ctx,
       }
     }
   }
+}
 
-  auto encodingResult = ctx->context->encode_image(input_image->image,
-                                     encoder,
-                                     options,
-                                     heif_image_input_class_normal);
-  if (encodingResult.error != Error::Ok) {
-    return encodingResult.error.error_struct(ctx->context.get());
-  }
-
-  std::shared_ptr<ImageItem> image = *encodingResult;
 
+static void return_encoded_image(struct heif_context* ctx,
+                                 std::shared_ptr<ImageItem> image,
+                                 struct heif_image_handle** out_image_handle)
+{
   // mark the new image as primary image
 
   if (ctx->context->is_primary_image_set() == false) {
@@ -2596,6 +3880,83 @@ struct heif_error heif_context_encode_image(struct heif_context* ctx,
     (*out_image_handle)->image = std::move(image);
     (*out_image_handle)->context = ctx->context;
   }
+}
+
+
+struct heif_error heif_context_encode_image(struct heif_context* ctx,
+                                            const struct heif_image* input_image,
+                                            struct heif_encoder* encoder,
+                                            const struct heif_encoding_options* input_options,
+                                            struct heif_image_handle** out_image_handle)
+{
+  if (!encoder) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+
+  if (out_image_handle) {
+    *out_image_handle = nullptr;
+  }
+
+  heif_encoding_options options;
+  heif_color_profile_nclx nclx;
+  get_image_encoding_options(options, nclx, input_options, input_image);
+
+  Result<std::shared_ptr<ImageItem>> encodingResult;
+  if (options.grid_tile_size != 0) {
+    encodingResult = ctx->context->encode_image_as_grid(input_image->image,
+                                                        options.grid_tile_size, options.grid_tile_size,
+                                                        encoder,
+                                                        options);
+  }
+  else {
+    encodingResult = ctx->context->encode_image(input_image->image,
+                                                encoder,
+                                                options,
+                                                heif_image_input_class_normal);
+  }
+
+  if (encodingResult.error != Error::Ok) {
+    return encodingResult.error.error_struct(ctx->context.get());
+  }
+
+  return_encoded_image(ctx, *encodingResult, out_image_handle);
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_context_encode_image_with_target_size(struct heif_context* ctx,
+                                                             const struct heif_image* input_image,
+                                                             struct heif_encoder* encoder,
+                                                             const struct heif_encoding_options* input_options,
+                                                             size_t target_size,
+                                                             int* out_quality,
+                                                             struct heif_image_handle** out_image_handle)
+{
+  if (!encoder || !input_image) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+
+  if (out_image_handle) {
+    *out_image_handle = nullptr;
+  }
+
+  heif_encoding_options options;
+  heif_color_profile_nclx nclx;
+  get_image_encoding_options(options, nclx, input_options, input_image);
+
+  auto encodingResult = ctx->context->encode_image_with_target_size(input_image->image,
+                                                                    encoder,
+                                                                    options,
+                                                                    target_size,
+                                                                    out_quality);
+  if (encodingResult.error != Error::Ok) {
+    return encodingResult.error.error_struct(ctx->context.get());
+  }
+
+  return_encoded_image(ctx, *encodingResult, out_image_handle);
 
   return heif_error_success;
 }
@@ -2672,6 +4033,67 @@ struct heif_error heif_context_encode_grid(struct heif_context* ctx,
 }
 
 
+struct heif_error heif_context_encode_pyramid(struct heif_context* ctx,
+                                              const struct heif_image* image,
+                                              uint32_t tile_width, uint32_t tile_height,
+                                              struct heif_encoder* encoder,
+                                              const struct heif_encoding_options* input_options,
+                                              struct heif_image_handle** out_image_handle,
+                                              heif_entity_group_id* out_group_id)
+{
+  if (out_image_handle) {
+    *out_image_handle = nullptr;
+  }
+
+  if (!image || !encoder) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Null_pointer_argument).error_struct(ctx->context.get());
+  }
+
+  heif_encoding_options options;
+  heif_color_profile_nclx nclx;
+  set_default_encoding_options(options);
+  if (input_options) {
+    copy_options(options, *input_options);
+
+    if (options.output_nclx_profile == nullptr) {
+      auto input_nclx = image->image->get_color_profile_nclx();
+      if (input_nclx) {
+        options.output_nclx_profile = &nclx;
+        nclx.version = 1;
+        nclx.color_primaries = (enum heif_color_primaries) input_nclx->get_colour_primaries();
+        nclx.transfer_characteristics = (enum heif_transfer_characteristics) input_nclx->get_transfer_characteristics();
+        nclx.matrix_coefficients = (enum heif_matrix_coefficients) input_nclx->get_matrix_coefficients();
+        nclx.full_range_flag = input_nclx->get_full_range_flag();
+      }
+    }
+  }
+
+  std::shared_ptr<ImageItem> base_image;
+  Result<heif_item_id> pyramidResult = ctx->context->encode_pyramid(image->image, tile_width, tile_height,
+                                                                    encoder, options, base_image);
+  if (pyramidResult.error) {
+    return pyramidResult.error.error_struct(ctx->context.get());
+  }
+
+  if (ctx->context->is_primary_image_set() == false) {
+    ctx->context->set_primary_image(base_image);
+  }
+
+  if (out_image_handle) {
+    *out_image_handle = new heif_image_handle;
+    (*out_image_handle)->image = std::move(base_image);
+    (*out_image_handle)->context = ctx->context;
+  }
+
+  if (out_group_id) {
+    *out_group_id = *pyramidResult;
+  }
+
+  return heif_error_success;
+}
+
+
 struct heif_error heif_context_add_grid_image(struct heif_context* ctx,
                                               uint32_t image_width,
                                               uint32_t image_height,
@@ -2821,6 +4243,30 @@ struct heif_error heif_context_add_image_tile(struct heif_context* ctx,
 }
 
 
+struct heif_error heif_context_add_precoded_image_tile(struct heif_context* ctx,
+                                                       struct heif_image_handle* grid_image,
+                                                       uint32_t tile_x, uint32_t tile_y,
+                                                       enum heif_compression_format format,
+                                                       const uint8_t* data, size_t size)
+{
+  if (!ctx || !grid_image || !data) {
+    return error_null_parameter;
+  }
+
+  auto grid_item = std::dynamic_pointer_cast<ImageItem_Grid>(grid_image->image);
+  if (!grid_item) {
+    return {
+      heif_error_Usage_error,
+      heif_suberror_Unspecified,
+      "Precoded tiles can only be added to grid images"
+    };
+  }
+
+  Error err = grid_item->add_precoded_image_tile(tile_x, tile_y, format, {data, size});
+  return err.error_struct(ctx->context.get());
+}
+
+
 struct heif_error heif_context_add_unci_image(struct heif_context* ctx,
                                               const struct heif_unci_image_parameters* parameters,
                                               const struct heif_encoding_options* encoding_options,
@@ -2994,6 +4440,20 @@ struct heif_error heif_context_add_generic_uri_metadata(struct heif_context* ctx
 }
 
 
+struct heif_error heif_context_remove_metadata(struct heif_context* ctx,
+                                               const struct heif_image_handle* image_handle,
+                                               heif_item_id metadata_id)
+{
+  Error error = ctx->context->remove_metadata(image_handle->image, metadata_id);
+  if (error != Error::Ok) {
+    return error.error_struct(ctx->context.get());
+  }
+  else {
+    return heif_error_success;
+  }
+}
+
+
 void heif_context_set_maximum_image_size_limit(struct heif_context* ctx, int maximum_width)
 {
   ctx->context->get_security_limits()->max_image_size_pixels = static_cast<uint64_t>(maximum_width) * maximum_width;
@@ -3005,3 +4465,171 @@ void heif_context_set_max_decoding_threads(struct heif_context* ctx, int max_thr
   ctx->context->set_max_decoding_threads(max_threads);
 }
 
+
+void heif_context_set_decoded_tile_cache_size(struct heif_context* ctx, size_t max_bytes)
+{
+  ctx->context->get_decoded_tile_cache().set_max_bytes(max_bytes);
+}
+
+
+void heif_context_set_derived_image_source_cache_size(struct heif_context* ctx, size_t max_bytes)
+{
+  ctx->context->get_derived_image_source_cache().set_max_bytes(max_bytes);
+}
+
+
+void heif_context_set_max_encoding_threads(struct heif_context* ctx, int max_threads)
+{
+  ctx->context->set_max_encoding_threads(max_threads);
+}
+
+
+void heif_context_set_encoding_thread_budget(struct heif_context* ctx, int num_threads)
+{
+  ctx->context->set_encoding_thread_budget(num_threads);
+}
+
+
+void heif_context_set_lazy_box_parsing(struct heif_context* ctx, int enable)
+{
+  ctx->context->set_lazy_box_parsing(enable != 0);
+}
+
+
+void heif_context_set_initial_read_size(struct heif_context* ctx, uint32_t size)
+{
+  ctx->context->set_initial_read_size(size);
+}
+
+
+void heif_context_set_item_data_cache_size(struct heif_context* ctx, size_t max_bytes)
+{
+  ctx->context->set_item_data_cache_size(max_bytes);
+}
+
+
+void heif_context_set_max_read_gap(struct heif_context* ctx, size_t max_gap)
+{
+  ctx->context->set_max_read_gap(max_gap);
+}
+
+
+void heif_context_set_prefetch_primary_image(struct heif_context* ctx, int enable)
+{
+  ctx->context->set_prefetch_primary_image(enable != 0);
+}
+
+
+void heif_set_thread_pool_size(int num_threads)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  ThreadPool::global().set_num_threads(num_threads);
+#else
+  (void) num_threads;
+#endif
+}
+
+
+int heif_get_thread_pool_size()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  return ThreadPool::global().get_num_threads();
+#else
+  return 0;
+#endif
+}
+
+
+struct heif_thread_pool_options* heif_thread_pool_options_alloc()
+{
+  auto* options = new heif_thread_pool_options();
+  options->version = 1;
+  options->cpus = nullptr;
+  options->num_cpus = 0;
+  options->priority_reduction = 0;
+  options->numa_aware = false;
+
+  return options;
+}
+
+
+void heif_thread_pool_options_free(struct heif_thread_pool_options* options)
+{
+  delete options;
+}
+
+
+struct heif_error heif_set_thread_pool_options(const struct heif_thread_pool_options* options)
+{
+  if (options) {
+    if (options->num_cpus < 0 || (options->num_cpus > 0 && options->cpus == nullptr)) {
+      return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Invalid CPU list"};
+    }
+
+    for (int i = 0; i < options->num_cpus; i++) {
+      if (options->cpus[i] < 0) {
+        return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Invalid CPU number"};
+      }
+    }
+
+    if (options->priority_reduction < 0) {
+      return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Priority reduction must not be negative"};
+    }
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  ThreadPool::Options pool_options;
+  if (options) {
+    pool_options.cpus.assign(options->cpus, options->cpus + options->num_cpus);
+    pool_options.priority_reduction = options->priority_reduction;
+    pool_options.numa_aware = (options->numa_aware != 0);
+  }
+
+  ThreadPool::global().set_options(pool_options);
+#endif
+
+  return heif_error_success;
+}
+
+
+void heif_context_set_numa_node(struct heif_context* ctx, int numa_node)
+{
+  ctx->context->set_numa_node(numa_node);
+}
+
+
+void heif_set_image_buffer_pool_size(size_t max_bytes)
+{
+  PlaneBufferPool::global().set_max_cached_bytes(max_bytes);
+}
+
+
+void heif_set_image_memory_budget(uint64_t max_bytes)
+{
+  MemoryBudget::global().set_max_bytes(max_bytes);
+}
+
+
+uint64_t heif_get_image_memory_budget()
+{
+  return MemoryBudget::global().get_max_bytes();
+}
+
+
+uint64_t heif_get_image_memory_in_use()
+{
+  return MemoryBudget::global().get_used_bytes();
+}
+
+
+struct heif_error heif_set_image_plane_alignment(int alignment)
+{
+  if (HeifPixelImage::set_plane_alignment(alignment)) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Plane alignment must be a power of two between 16 and 4096"};
+  }
+
+  return heif_error_success;
+}
+
@@ -137,7 +137,8 @@ enum heif_metadata_compression
   heif_metadata_compression_unknown = 2, // only used when reading unknown method from input file
   heif_metadata_compression_deflate = 3,
   heif_metadata_compression_zlib = 4,    // do not use for header data
-  heif_metadata_compression_brotli = 5
+  heif_metadata_compression_brotli = 5,
+  heif_metadata_compression_zstd = 6     // only available when libheif was compiled with zstd support
 };
 
 // ========================= file type check ======================
@@ -475,6 +476,11 @@ const char* heif_get_file_mime_type(const uint8_t* data, int len);
 
 // Allocate a new context for reading HEIF files.
 // Has to be freed again with heif_context_free().
+//
+// Several threads can decode images from the same context at the same time, also different tiles of the same image.
+// Each image item has its own locks, so that decoding different images does not block each other, except when reading
+// from a heif_reader without read_at(). Functions that change the context (adding images or metadata, writing the file)
+// must not be called in parallel to any other function on the same context.
 LIBHEIF_API
 struct heif_context* heif_context_alloc(void);
 
@@ -485,6 +491,7 @@ void heif_context_free(struct heif_context*);
 
 
 struct heif_reading_options;
+struct heif_writer;
 
 enum heif_reader_grow_status
 {
@@ -577,6 +584,35 @@ struct heif_reader
   // If this function is NULL, the error message string will not be released.
   // This is a viable option if you are only returning static strings.
   void (*release_error_msg)(const char* msg);
+
+  // --- version 3 functions ---
+
+  // Asynchronous variant of request_range(). It should start fetching the range and return immediately.
+  // When the range is available (or an error occurred), the reader has to call 'on_completion' with the
+  // result and the given 'completion_userdata'. The callback may be called from any thread, even before
+  // request_range_async() returns. A 'reader_error_msg' in the result will be released with release_error_msg().
+  //
+  // libheif starts several requests at once when it knows in advance which ranges it will need (e.g. the
+  // tiles of a decoded region). Each range is only waited for when it is actually read, so that the network
+  // latency of the remaining requests overlaps with decoding.
+  // Every started request has to be completed. libheif waits for outstanding requests before the file is closed.
+  //
+  // You still have to provide request_range(). If request_range_async is NULL, libheif sends preload_range_hint() instead.
+  void (*request_range_async)(uint64_t start_pos, uint64_t end_pos,
+                              void (*on_completion)(struct heif_reader_range_request_result result, void* completion_userdata),
+                              void* completion_userdata,
+                              void* userdata);
+
+  // --- version 4 functions ---
+
+  // Reads 'size' bytes at file position 'position' into 'data'. Returns 0 on success.
+  // Unlike seek() and read(), this does not use or change the current read position.
+  //
+  // libheif calls read_at() for the image data from several threads concurrently, without holding a lock.
+  // Hence, read_at() has to be thread-safe, also with respect to concurrent calls of the other functions.
+  // All other functions are still called from one thread at a time.
+  // If read_at is NULL, libheif reads the image data with seek() and read() and serializes all reads of the file.
+  int (*read_at)(uint64_t position, void* data, size_t size, void* userdata);
 };
 
 
@@ -607,6 +643,36 @@ struct heif_error heif_context_read_from_reader(struct heif_context*,
                                                 void* userdata,
                                                 const struct heif_reading_options*);
 
+// Writes a header index of the file that has been read into the context. It contains the data of the
+// 'ftyp', 'meta' and 'moov' boxes and of all other box headers that were read while opening the file.
+// When the same file is opened again with heif_context_read_from_index(), the file structure is taken
+// from the index and only the image data is read from the file. This saves the I/O for the header boxes,
+// which is useful when the file is read over a network. The boxes themselves are still parsed.
+// The index is written in one call to writer->write().
+LIBHEIF_API
+struct heif_error heif_context_write_header_index(struct heif_context*,
+                                                  struct heif_writer* writer,
+                                                  void* userdata);
+
+// Reads a file with the help of a header index written by heif_context_write_header_index().
+// The index is protected by a checksum. To keep the I/O low, libheif only compares the first 64 bytes of the
+// file with the index. It cannot detect all changes of the file. If the file can be modified, you should
+// store its size and modification time with the index and check them before using it.
+// If the index does not match the file, an error is returned. The caller may then read the file without the index.
+LIBHEIF_API
+struct heif_error heif_context_read_from_index(struct heif_context*,
+                                               const void* index, size_t index_size,
+                                               const struct heif_reader* reader,
+                                               void* userdata,
+                                               const struct heif_reading_options*);
+
+// Same as heif_context_read_from_index(), but reads the image data from a named disk file.
+LIBHEIF_API
+struct heif_error heif_context_read_from_file_with_index(struct heif_context*,
+                                                         const char* filename,
+                                                         const void* index, size_t index_size,
+                                                         const struct heif_reading_options*);
+
 // Number of top-level images in the HEIF file. This does not include the thumbnails or the
 // tile images that are composed to an image grid. You can get access to the thumbnails via
 // the main image handle.
@@ -652,16 +718,182 @@ LIBHEIF_API
 void heif_context_set_maximum_image_size_limit(struct heif_context* ctx, int maximum_width);
 
 // If the maximum threads number is set to 0, the image tiles are decoded in the main thread.
-// This is different from setting it to 1, which will generate a single background thread to decode the tiles.
+// Otherwise, this is the maximum number of tiles (of a grid image) or layers (of an overlay image) that are
+// decoded in parallel. The work is done by the library-wide thread pool (see heif_set_thread_pool_size()).
+// With at least two threads, the alpha channel is decoded in parallel to the image it belongs to.
 // Note that this setting only affects libheif itself. The codecs itself may still use multi-threaded decoding.
 // You can use it, for example, in cases where you are decoding several images in parallel anyway you thus want
 // to minimize parallelism in each decoder.
 LIBHEIF_API
 void heif_context_set_max_decoding_threads(struct heif_context* ctx, int max_threads);
 
+// Keeps the tiles decoded by heif_image_handle_decode_image_tile() in a least-recently-used cache of the heif_context.
+// A tile that is decoded again with the same colorspace, chroma and decoding options is copied from the cache instead.
+// 'max_bytes' limits the memory of the cached tiles. The default is 0, which disables the cache and frees the cached tiles.
+LIBHEIF_API
+void heif_context_set_decoded_tile_cache_size(struct heif_context* ctx, size_t max_bytes);
+
+// When several derived images ('iden' images, 'iovl' overlays) reference the same image, that image is decoded once and
+// kept in a least-recently-used cache of the heif_context for decoding the other derived images.
+// 'max_bytes' limits the memory of the cached images. The default is 64 MiB. 0 disables the cache.
+LIBHEIF_API
+void heif_context_set_derived_image_source_cache_size(struct heif_context* ctx, size_t max_bytes);
+
+// Maximum number of threads used to encode the tiles of a grid image in heif_context_encode_grid().
+// Each thread uses its own copy of the encoder with the same parameters. The tiles are always stored in the
+// file in tile order, independent of the number of threads.
+// This also limits the number of 'unci' tiles that are compressed in parallel when they are added with
+// heif_context_add_image_tile(). These are stored in the order in which they were added.
+// The same applies to the images of sequence tracks that are coded independently (see heif_track_encode_sequence_image()).
+// With a single thread, the color conversion of the next grid tile runs in a second thread while the current tile is encoded.
+// If set to 0 (default), the tiles are encoded sequentially in the calling thread.
+LIBHEIF_API
+void heif_context_set_max_encoding_threads(struct heif_context* ctx, int max_threads);
+
+// Total number of threads for the encoders when tiles are encoded in parallel (see heif_context_set_max_encoding_threads()).
+// The budget is divided between the parallel encoder instances and each of them gets its share through the
+// standard "threads" encoder parameter. Encoders without this parameter are not affected.
+// If set to 0 (default), the budget is the number of hardware threads.
+// If set to a negative value, the encoders keep their own thread settings.
+LIBHEIF_API
+void heif_context_set_encoding_thread_budget(struct heif_context* ctx, int num_threads);
+
+// When enabled, heif_context_read_*() only records the position of the parts of the file that are not
+// needed to access the images. They are parsed when they are accessed for the first time.
+// Currently, this is the 'moov' box of image sequences with all its sample tables. It is parsed by the
+// first call to a track function. Errors in these parts are then not reported by heif_context_read_*(),
+// but by the function that accesses them. Track functions without an error return value then behave as if
+// there were no tracks, e.g. heif_context_number_of_sequence_tracks() returns 0, while heif_context_has_sequence()
+// still returns true and heif_context_create_sample_multiplexer() returns the error.
+// Use this when you only need the still images of a file, e.g. to read the image sizes.
+// This setting has to be made before reading the file. Default: disabled.
+LIBHEIF_API
+void heif_context_set_lazy_box_parsing(struct heif_context* ctx, int enable);
+
+// Number of bytes that are requested from the reader at the start of the file (default: 1024).
+// The same amount is read ahead whenever the next top-level box header is not available yet.
+// For network readers, a larger size (e.g. 65536) usually gets the 'ftyp' and 'meta' boxes with
+// a single request instead of one request per box. 0 selects the default.
+// This setting has to be made before reading the file.
+LIBHEIF_API
+void heif_context_set_initial_read_size(struct heif_context* ctx, uint32_t size);
+
+// When enabled, heif_context_read_*() announces the file ranges of the primary image data to the reader
+// right after the file structure has been parsed. Readers that support asynchronous range requests
+// start to fetch them immediately, other readers get preload hints.
+// For 'grid' and 'iovl' images, this includes the data of all referenced images.
+// This setting has to be made before reading the file. Default: disabled.
+LIBHEIF_API
+void heif_context_set_prefetch_primary_image(struct heif_context* ctx, int enable);
+
+// Keeps the item data (compressed images, codec configurations, metadata) read from the reader in a
+// least-recently-used cache of 'max_bytes' bytes. Decoding the same item again (e.g. an alpha or depth image,
+// or a grid tile) then does not access the reader. This is useful for heif_readers that fetch the data over the network.
+// When libheif releases a file range (heif_reader::release_file_range()), its data is also dropped from the cache.
+// Files read from memory are not cached. This setting has to be made before reading the file. Default: 0 (disabled).
+LIBHEIF_API
+void heif_context_set_item_data_cache_size(struct heif_context* ctx, size_t max_bytes);
+
+// Item data that is stored in several file ranges (extents of one item, or the tiles of a grid image that is
+// decoded completely) is read with a single request when the ranges are separated by at most 'max_gap' bytes.
+// The data in the gaps is read and discarded. This reduces the number of requests to heif_readers that fetch
+// the data over the network. This setting has to be made before reading the file. Default: 64 KiB.
+LIBHEIF_API
+void heif_context_set_max_read_gap(struct heif_context* ctx, size_t max_gap);
+
+// Number of worker threads in the thread pool that is shared by all heif_contexts in the process.
+// The default is the number of CPU cores. When set to 0, all work is done in the calling thread.
+// The worker threads are started on first use and stopped in heif_deinit().
+// Do not call this function while images are decoded or encoded.
+LIBHEIF_API
+void heif_set_thread_pool_size(int num_threads);
+
+LIBHEIF_API
+int heif_get_thread_pool_size(void);
+
+struct heif_thread_pool_options
+{
+  uint8_t version;
+
+  // version 1 options
+
+  // The worker threads only run on these CPUs. When NULL, they may run on all CPUs.
+  const int* cpus;
+  int num_cpus;
+
+  // The worker threads run with a lower priority than the thread that starts them, such that threads that
+  // handle requests stay responsive. On Linux, this is added to the nice value (0: no change).
+  // On Windows, any value > 0 selects THREAD_PRIORITY_BELOW_NORMAL, values >= 10 THREAD_PRIORITY_LOWEST.
+  int priority_reduction;
+
+  // The workers are spread over the NUMA nodes of their CPUs. Tasks are preferably executed on the node of the
+  // thread that submits them, or on the node set with heif_context_set_numa_node(). Only supported on Linux.
+  uint8_t numa_aware;
+};
+
+LIBHEIF_API
+struct heif_thread_pool_options* heif_thread_pool_options_alloc(void);
+
+LIBHEIF_API
+void heif_thread_pool_options_free(struct heif_thread_pool_options*);
+
+// Sets the placement of the worker threads of the library-wide thread pool. Passing NULL resets the defaults.
+// CPU pinning and the priority are supported on Linux and Windows, and are ignored on other systems.
+// Do not call this function while images are decoded or encoded.
+LIBHEIF_API
+struct heif_error heif_set_thread_pool_options(const struct heif_thread_pool_options*);
+
+// The decoding work of this context is preferably executed on the workers of the given NUMA node, e.g. the node
+// on which the application allocates its image buffers. -1 (default): the node of the thread that decodes the image.
+// Only has an effect when the thread pool is NUMA-aware (see heif_thread_pool_options).
+LIBHEIF_API
+void heif_context_set_numa_node(struct heif_context* ctx, int numa_node);
+
+// The memory of released images can be kept in a pool and reused for new images with the same plane sizes.
+// This avoids repeated allocations when decoding many tiles or sequence frames of the same size.
+// 'max_bytes' limits the amount of memory held by unused planes. The default is 0, which disables the pool.
+// The pool is shared by all heif_contexts in the process and freed in heif_deinit().
+LIBHEIF_API
+void heif_set_image_buffer_pool_size(size_t max_bytes);
+
+// Image planes allocated by libheif are counted against a memory budget that is shared by all heif_contexts in the process.
+// An allocation fails if the memory of all live image planes plus the memory margin of the heif_security_limits would
+// exceed 'max_bytes'. Setting 'max_bytes' to 0 disables the check.
+// On Linux, the default is the memory limit of the cgroup of the process, or the physical memory size if there is no limit.
+// On other systems, the budget is disabled by default.
+LIBHEIF_API
+void heif_set_image_memory_budget(uint64_t max_bytes);
+
+LIBHEIF_API
+uint64_t heif_get_image_memory_budget(void);
+
+// Returns the number of bytes of all image planes that are currently allocated.
+LIBHEIF_API
+uint64_t heif_get_image_memory_in_use(void);
+
+// Alignment in bytes of the plane start and the row stride of image planes that are allocated from now on.
+// Must be a power of two between 16 and 4096. The default is 16. Use 64 to align the rows to cache lines.
+LIBHEIF_API
+struct heif_error heif_set_image_plane_alignment(int alignment);
+
 
 // --- security limits
 
+// How the memory of image planes is allocated (heif_security_limits::plane_allocation).
+// The flags are only supported on Linux. They are ignored on other systems.
+enum heif_plane_allocation_flags
+{
+  // Lock the memory of each plane with mlock(). Allocations fail immediately if there is not enough physical memory,
+  // but all pages are faulted in when the plane is allocated and the amount is limited by RLIMIT_MEMLOCK.
+  heif_plane_allocation_lock_memory = 1,
+
+  // Back planes larger than 2 MB with transparent huge pages (madvise(MADV_HUGEPAGE)).
+  heif_plane_allocation_huge_pages = 2,
+
+  // Place the memory on the NUMA node of the thread that allocates the plane, i.e. the decoding worker.
+  heif_plane_allocation_numa_local = 4
+};
+
 // If you set a limit to 0, the limit is disabled.
 struct heif_security_limits {
   uint8_t version;
@@ -688,14 +920,27 @@ struct heif_security_limits {
 
   // --- version 2
 
-  // When memory is allocated, libheif takes care that some system memory stays free.
+  // When memory is allocated, libheif takes care that some memory of the image memory budget stays free (see heif_set_image_memory_budget()).
   // The margin amount is computed dynamically based on the amount of requested memory, but it will be adjusted to fit into the bounds configured here.
-  // Setting max_memory_margin to zero switches off checking the available RAM. Libheif will try to get all memory it needs.
+  // Setting max_memory_margin to zero switches off checking the memory budget. Libheif will try to get all memory it needs.
   size_t  min_memory_margin;
   size_t  max_memory_margin; // must be >= min_memory_margin
 
   uint32_t max_sample_description_box_entries;
   uint32_t max_sample_group_description_box_entries;
+
+  // --- version 3
+
+  // Memory that the parallel decoding of grid and tiled images of a heif_context may use for the tiles it decodes
+  // at the same time (estimated from the tile sizes). When the budget is used up, fewer tiles are decoded in parallel,
+  // but at least one. Setting this to 0 only limits the parallelism by the number of decoding threads.
+  uint64_t max_total_memory;
+
+  // --- version 4
+
+  // Combination of heif_plane_allocation_flags for the image planes allocated for this heif_context.
+  // 0 (the default) allocates plain memory.
+  uint32_t plane_allocation;
 };
 
 // The global security limits are the default for new heif_contexts.
@@ -849,6 +1094,132 @@ struct heif_error heif_image_handle_decode_image_tile(const struct heif_image_ha
                                                       uint32_t tile_x, uint32_t tile_y);
 
 
+// Decode a rectangular region of the image.
+// If the image transformations are processed (option->ignore_image_transformations==false), the region is given
+// in the transformed image coordinates.
+// For grid and tiled images, only the tiles that overlap with the region are decoded and the output image
+// has the size of the region. The region has to lie completely inside the image.
+LIBHEIF_API
+struct heif_error heif_decode_image_region(const struct heif_image_handle* in_handle,
+                                           struct heif_image** out_img,
+                                           enum heif_colorspace colorspace,
+                                           enum heif_chroma chroma,
+                                           const struct heif_decoding_options* options,
+                                           uint32_t x0, uint32_t y0, uint32_t width, uint32_t height);
+
+
+// Decode the image scaled down to fit into max_width x max_height. The aspect ratio is kept and the image
+// is never scaled up. Scaling uses nearest-neighbor sampling.
+// Instead of the image itself, the smallest of its thumbnails or of the layers of a 'pymd' multi-resolution
+// pyramid group that contains the image is decoded, as long as it is at least as large as the output image.
+// Only the data of that image is read. Grid images are scaled tile by tile without assembling the
+// full-resolution image first.
+LIBHEIF_API
+struct heif_error heif_decode_image_at_size(const struct heif_image_handle* in_handle,
+                                            struct heif_image** out_img,
+                                            enum heif_colorspace colorspace,
+                                            enum heif_chroma chroma,
+                                            const struct heif_decoding_options* options,
+                                            uint32_t max_width, uint32_t max_height);
+
+
+// Returns the number of layers of the 'pymd' multi-resolution pyramid group that contains the image,
+// or 0 if the image is not part of a pyramid.
+LIBHEIF_API
+int heif_image_handle_get_number_of_pyramid_layers(const struct heif_image_handle* handle);
+
+// Returns the image item ID and the size and tiling of a pyramid layer (see heif_image_handle_get_image_tiling()).
+// The layers are sorted from the smallest (index 0) to the full resolution layer. Either output may be NULL.
+LIBHEIF_API
+struct heif_error heif_image_handle_get_pyramid_layer(const struct heif_image_handle* handle,
+                                                      int layer_index,
+                                                      int process_image_transformations,
+                                                      heif_item_id* out_layer_image_id,
+                                                      struct heif_image_tiling* out_tiling);
+
+// Decode the region (x0,y0,width,height) of the image, scaled to out_width x out_height, as needed for
+// deep-zoom tile serving. The region is given in the coordinates of the image, as in heif_decode_image_region().
+// It is decoded from the smallest layer of the 'pymd' pyramid group that contains the image in which the region has
+// at least the output size. Only the tiles of this layer that overlap with the region are decoded.
+// When the region in the layer does not have exactly the output size, it is scaled with nearest-neighbor sampling.
+LIBHEIF_API
+struct heif_error heif_decode_image_region_at_scale(const struct heif_image_handle* in_handle,
+                                                    struct heif_image** out_img,
+                                                    enum heif_colorspace colorspace,
+                                                    enum heif_chroma chroma,
+                                                    const struct heif_decoding_options* options,
+                                                    uint32_t x0, uint32_t y0, uint32_t width, uint32_t height,
+                                                    uint32_t out_width, uint32_t out_height);
+
+
+// Progressive decoding of JPEG 2000 images (see heif_decoding_options.max_coded_data_size).
+// Returns in 'out_next_coded_data_size' the smallest size of the coded data larger than 'coded_data_size' at which
+// more of the image can be decoded. These steps are the ends of the codestream tile-parts. Codestreams that are split
+// into tile-parts by quality layer or resolution level are refined with each step, otherwise each step adds a tile.
+// 'out_file_range_start' and 'out_file_range_end' are set to the file range that stores the additional data, such that
+// it can be fetched in advance. When the data is split into several 'iloc' extents, the range covers all of them.
+// When 'coded_data_size' already covers all data, the total size is returned and the file range is empty.
+// Only the codestream markers are read, with heif_reader range requests.
+// Any of the output pointers may be NULL.
+LIBHEIF_API
+struct heif_error heif_image_handle_get_next_progressive_data_range(const struct heif_image_handle* handle,
+                                                                    uint64_t coded_data_size,
+                                                                    uint64_t* out_next_coded_data_size,
+                                                                    uint64_t* out_file_range_start,
+                                                                    uint64_t* out_file_range_end);
+
+
+// Incremental decoding of an image while the file is still being loaded, e.g. with a heif_reader whose
+// wait_for_file_size() reports the growing file. 'available_file_size' is the number of bytes at the beginning
+// of the file that have been loaded. Only the image data stored below this position is read, such that
+// wait_for_file_size() will not have to wait for more data.
+// Progressive JPEGs are decoded with the complete scans, JPEG 2000 images with the loaded tile-parts, and layered
+// AVIF images ('a1lx') up to the last complete layer. Other images can only be decoded when all their data is loaded.
+// '*out_is_complete' is set to 1 when all image data was available and the image has its final quality.
+// When too little data is available for a first image, heif_error_Invalid_input / heif_suberror_End_of_data is returned.
+// This is also the case for images with an alpha channel until the alpha data is loaded completely.
+// The decoder plugin has to support decoding from truncated data (plugin API version 4).
+// 'out_is_complete' may be NULL.
+LIBHEIF_API
+struct heif_error heif_decode_image_incremental(const struct heif_image_handle* in_handle,
+                                               struct heif_image** out_img,
+                                               enum heif_colorspace colorspace,
+                                               enum heif_chroma chroma,
+                                               const struct heif_decoding_options* options,
+                                               uint64_t available_file_size,
+                                               int* out_is_complete);
+
+
+// Returns the JPEG bitstream of a JPEG image as a complete JPEG file, without decoding the image.
+// The bitstream is composed of the 'jpgC' header data and the image data. The image rotation and mirroring are
+// written as Exif orientation: the orientation tag of an Exif segment in the bitstream is overwritten, or an Exif
+// segment with only the orientation is added. Alpha channels, color profiles and metadata of the HEIF image are not
+// included.
+// heif_error_Unsupported_feature is returned for images that are not coded as JPEG and for images with a clean
+// aperture ('clap'), because the cropping can only be applied by decoding.
+// The returned data has to be freed with heif_release_bitstream_data().
+LIBHEIF_API
+struct heif_error heif_image_handle_get_jpeg_bitstream(const struct heif_image_handle* handle,
+                                                       uint8_t** out_data, size_t* out_data_size);
+
+
+// Returns the coded data of an AVC, HEVC or VVC image as an Annex-B byte stream, without decoding the image.
+// The NAL units are preceded by start codes and the parameter sets of the configuration box are put in front.
+// For grid images, the byte streams of all tiles are concatenated in tile order (row by row) for decoders that decode
+// the tiles as one mosaic. The parameter sets are only repeated where they differ from those of the previous tile.
+// The byte stream of a single tile is returned for the handle of the tile item (see heif_image_handle_get_grid_image_tile_id()).
+// The image transformations are not applied.
+// The returned data has to be freed with heif_release_bitstream_data().
+LIBHEIF_API
+struct heif_error heif_image_handle_get_annexb_bitstream(const struct heif_image_handle* handle,
+                                                         uint8_t** out_data, size_t* out_data_size);
+
+// Frees the data returned by heif_image_handle_get_jpeg_bitstream() and heif_image_handle_get_annexb_bitstream()
+// and sets the pointer to NULL.
+LIBHEIF_API
+void heif_release_bitstream_data(uint8_t** data);
+
+
 // ------------------------- entity groups ------------------------
 
 typedef uint32_t heif_entity_group_id;
@@ -1037,6 +1408,15 @@ struct heif_error heif_image_handle_get_metadata(const struct heif_image_handle*
                                                  heif_item_id metadata_id,
                                                  void* out_data);
 
+// Like heif_image_handle_get_metadata(), but returns a pointer to the metadata instead of copying it.
+// When the file is held in memory (or memory-mapped), this points directly into the file data.
+// The data remains valid until the heif_context is freed. It must not be modified or released.
+LIBHEIF_API
+struct heif_error heif_image_handle_get_metadata_borrowed(const struct heif_image_handle* handle,
+                                                          heif_item_id metadata_id,
+                                                          const uint8_t** out_data,
+                                                          size_t* out_data_size);
+
 // Only valid for item type == "uri ", an absolute URI
 LIBHEIF_API
 const char* heif_image_handle_get_metadata_item_uri_type(const struct heif_image_handle* handle,
@@ -1083,7 +1463,11 @@ struct heif_error heif_camera_extrinsic_matrix_get_rotation_matrix(const struct
 enum heif_progress_step
 {
   heif_progress_step_total = 0,
-  heif_progress_step_load_tile = 1
+  heif_progress_step_load_tile = 1,
+
+  // Progress of the codec while it decodes a single coded image, from 0 to 1000. Only reported by decoder plugins
+  // that support it. For grid images, it is reported for each tile and may be called from several threads.
+  heif_progress_step_codec = 2
 };
 
 
@@ -1135,6 +1519,55 @@ enum heif_alpha_composition_mode
 };
 
 
+// How sample values are reduced to a lower bit depth (e.g. with heif_decoding_options::convert_hdr_to_8bit).
+enum heif_bit_depth_reduction_method
+{
+  // Drop the low bits.
+  heif_bit_depth_reduction_method_truncate = 0,
+
+  heif_bit_depth_reduction_method_round = 1,
+
+  // Round with a 2x2 ordered dither pattern. Reduces banding in smooth gradients.
+  heif_bit_depth_reduction_method_dither = 2
+};
+
+
+// ICC rendering intent used when converting to heif_color_conversion_options_ext::output_icc_profile.
+// The values are the same as in the ICC specification.
+enum heif_rendering_intent
+{
+  heif_rendering_intent_perceptual = 0,
+  heif_rendering_intent_relative_colorimetric = 1,
+  heif_rendering_intent_saturation = 2,
+  heif_rendering_intent_absolute_colorimetric = 3
+};
+
+
+// Whether the color values of images with alpha are multiplied with the alpha value.
+enum heif_alpha_premultiplication_mode
+{
+  // Keep the premultiplication of the decoded image (see heif_image_is_premultiplied_alpha()).
+  heif_alpha_premultiplication_mode_keep = 0,
+
+  heif_alpha_premultiplication_mode_straight = 1,
+  heif_alpha_premultiplication_mode_premultiplied = 2
+};
+
+
+// Interpolation of the missing colors of images that are recorded through a color filter array
+// (e.g. a Bayer pattern, described by a 'cpat' property of an uncompressed image).
+enum heif_demosaic_method
+{
+  // Average of the nearest samples of each color.
+  heif_demosaic_method_bilinear = 0,
+
+  // Bilinear interpolation corrected with the gradient of the sample at the pixel (Malvar-He-Cutler).
+  // Gives sharper edges with less color fringing. Only available for 2x2 Bayer patterns.
+  // Other patterns are interpolated bilinearly.
+  heif_demosaic_method_gradient_corrected = 1
+};
+
+
 struct heif_color_conversion_options_ext
 {
   uint8_t version;
@@ -1147,6 +1580,49 @@ struct heif_color_conversion_options_ext
   uint16_t background_red, background_green, background_blue;
   uint16_t secondary_background_red, secondary_background_green, secondary_background_blue;
   uint16_t checkerboard_square_size;
+
+  // --- version 2 options
+
+  // Maximum number of threads that may be used to convert a single large image.
+  // Values <= 1 convert the image in the calling thread.
+  // When the options are passed through heif_decoding_options without this field (NULL or version 1),
+  // the number of threads set with heif_context_set_max_decoding_threads() is used.
+  // Default for heif_color_conversion_options_ext_alloc(): 1
+  int max_threads;
+
+  // --- version 3 options
+
+  // Converts the color values of images with alpha to straight or premultiplied alpha.
+  // The output image is flagged accordingly (heif_image_is_premultiplied_alpha()).
+  // Default: heif_alpha_premultiplication_mode_keep
+  enum heif_alpha_premultiplication_mode alpha_premultiplication_mode;
+
+  // --- version 4 options
+
+  // Currently used when converting images with more than 8 bits to 8 bits.
+  // Default: heif_bit_depth_reduction_method_truncate
+  enum heif_bit_depth_reduction_method bit_depth_reduction_method;
+
+  // --- version 5 options
+
+  // When set, RGB output images are converted from the color profile of the image (its ICC profile or,
+  // without one, its nclx primaries and transfer characteristics) into this ICC profile.
+  // The output image carries this ICC profile.
+  // This requires that libheif is compiled with LittleCMS (WITH_LCMS2). Otherwise, the option is ignored.
+  // The profile data is not copied and has to stay valid until the conversion is finished.
+  // Default: NULL (no color management)
+  const uint8_t* output_icc_profile;
+  size_t output_icc_profile_size;
+
+  // Default: heif_rendering_intent_perceptual
+  enum heif_rendering_intent rendering_intent;
+
+  // --- version 6 options
+
+  // Images with a color filter array are demosaiced while they are decoded to heif_colorspace_RGB.
+  // Decoding them to heif_colorspace_monochrome (or heif_colorspace_undefined) returns the raw filter array samples.
+  // Default: heif_demosaic_method_bilinear
+  enum heif_demosaic_method demosaic_method;
 };
 
 
@@ -1155,6 +1631,63 @@ LIBHEIF_API
 void heif_color_conversion_options_set_defaults(struct heif_color_conversion_options*);
 
 
+// Time spent in the stages of decoding an image and some counters. Pass it in heif_decoding_options::statistics.
+//
+// The values are added to the structure, so that the statistics of several decoding calls can be summed up.
+// Times are wall-clock times in microseconds. Each stage only counts its own time, not the time of nested stages
+// (e.g. reading the data of a tile while it is decoded is counted as reading).
+// When tiles are decoded in parallel, the times of all threads are added up and may be larger than total_time_us.
+// Images decoded ahead in the background (heif_track_set_decoding_lookahead()) are not counted.
+struct heif_decoding_statistics
+{
+  uint8_t version;
+
+  // --- version 1
+
+  // Time of the heif_decode_image() call
+  uint64_t total_time_us;
+
+  // Reading the compressed data from the input.
+  uint64_t read_time_us;
+
+  // Decoding the compressed data in the codec.
+  uint64_t codec_time_us;
+
+  // Converting the decoded image to the requested colorspace and chroma.
+  uint64_t color_conversion_time_us;
+
+  // Copying the decoded tiles into the output image.
+  uint64_t tile_paste_time_us;
+
+  // Number of compressed bytes read from the input.
+  uint64_t bytes_read;
+
+  // Number of images (e.g. grid tiles) decoded by the codecs.
+  uint64_t num_codec_decodes;
+
+  // Number of image planes allocated (including planes reused from the plane buffer pool) and their size.
+  uint64_t num_planes_allocated;
+  uint64_t bytes_allocated;
+
+  // Number of image planes copied when pasting tiles.
+  uint64_t num_planes_copied;
+
+  // --- version 2
+
+  // Tiles of heif_image_handle_decode_image_tile() found in / missing from the decoded tile cache
+  // (see heif_context_set_decoded_tile_cache_size()). Only counted when the cache is enabled.
+  uint64_t num_tile_cache_hits;
+  uint64_t num_tile_cache_misses;
+};
+
+// Allocate a zeroed statistics structure. Note: use this function since the structure may grow in future versions.
+LIBHEIF_API
+struct heif_decoding_statistics* heif_decoding_statistics_alloc(void);
+
+LIBHEIF_API
+void heif_decoding_statistics_free(struct heif_decoding_statistics*);
+
+
 struct heif_decoding_options
 {
   uint8_t version;
@@ -1197,15 +1730,98 @@ struct heif_decoding_options
 
   // version 6 options
 
+  // Return non-zero to cancel decoding. It is checked between grid tiles and, for decoder plugins that
+  // support it, also while the codec decodes an image (it may then be called from the codec's threads).
   int (* cancel_decoding)(void* progress_user_data);
 
   // version 7 options
 
   // When set to NULL, default options will be used
   struct heif_color_conversion_options_ext* color_conversion_options_ext;
+
+  // version 8 options
+
+  // Decode the image at reduced resolution, with width and height divided by this value (1, 2, 4 or 8)
+  // and rounded up. This is only a hint for codecs that can skip work at lower resolutions (JPEG DCT scaling,
+  // JPEG 2000 resolution levels). Other codecs and images with a 'clap' crop window are decoded at full
+  // resolution. Check heif_image_get_decoding_scale_denominator() for the scale achieved.
+  // Default: 1 (full resolution)
+  uint8_t target_scale_denominator;
+
+  // version 9 options
+
+  // Maximum number of threads that the decoder plugin may use internally for decoding one image.
+  // When set to 0 (default), libheif splits the threads set with heif_context_set_max_decoding_threads()
+  // between decoding several tiles in parallel and the codec threads of each tile decoder.
+  // A single non-tiled image gets all threads. Only some decoder plugins support codec threads.
+  int max_codec_threads;
+
+  // version 10 options
+
+  // When set, the decoding statistics are added to this structure. Collecting the statistics has a small overhead.
+  // Default: NULL (no statistics are collected)
+  struct heif_decoding_statistics* statistics;
+
+  // version 11 options
+
+  // Progressive decoding: read and decode only the first 'max_coded_data_size' bytes of the coded data of the
+  // image item. The data is read with heif_reader range requests, the rest of the item is not accessed.
+  // The alpha channel is decoded from its complete data.
+  // Only decoders that can reconstruct an image from a truncated codestream (JPEG 2000) use this.
+  // Other images are decoded from their complete data.
+  // Use heif_image_handle_get_next_progressive_data_range() to find the data size of the next refinement step.
+  // Default: 0 (read all data)
+  uint64_t max_coded_data_size;
+
+  // Decode at most this number of JPEG 2000 quality layers. Together with target_scale_denominator, which
+  // discards resolution levels, this selects a coarser version of the image.
+  // Default: 0 (all layers)
+  int max_quality_layers;
+
+  // version 12 options
+
+  // When set, the tiles of a 'grid' image that are decoded in parallel (see heif_context_set_max_decoding_threads())
+  // are started in the order of their distance to the point (tile_priority_x, tile_priority_y), e.g. the center of
+  // the viewport. The point is given in coordinates of the grid image before transformations.
+  // Default: 0 (tiles are started in raster order)
+  uint8_t prioritize_tiles_near_point;
+  uint32_t tile_priority_x;
+  uint32_t tile_priority_y;
+
+  // Called for each tile of a 'grid' image when it has been decoded and pasted into the image, such that viewers can
+  // show large images progressively. 'region' is the area of the grid image at position (x0,y0) that has been
+  // filled by the tile. It is in the colorspace of the coded image, before color conversion and transformations,
+  // and is only valid during the callback. The callback may be called from several threads concurrently.
+  // Default: NULL
+  void (* on_tile_decoded)(const struct heif_image* region, uint32_t x0, uint32_t y0, void* progress_user_data);
+
+  // version 13 options
+
+  // For image sequences with inter-frame prediction: the decoder outputs each image as soon as it is decoded.
+  // Without this, decoders may decode several frames in parallel (e.g. dav1d frame threading), which is faster on
+  // multi-core CPUs, but delays the first image by a few frames and needs more memory.
+  // Default: 0
+  uint8_t low_latency_decoding;
+
+  // version 14 options
+
+  // Point in time (in microseconds of heif_get_monotonic_time_us()) by which the image should be decoded.
+  // When the decoding time of the image, estimated from the images previously decoded with the same context,
+  // exceeds the remaining time, a cheaper representation is decoded instead: a smaller pyramid layer, a thumbnail,
+  // or a reduced resolution (see target_scale_denominator). The largest representation that fits into the
+  // remaining time is taken, or the fastest one if none fits.
+  // When the deadline passes while the tiles of a 'grid' image are decoded, the remaining tiles are skipped
+  // and their area is left black (and transparent if the image has an alpha channel).
+  // Use heif_image_get_decoding_fallback() to find out what has been decoded.
+  // Default: 0 (no deadline)
+  uint64_t deadline_us;
 };
 
 
+// Current time of the monotonic clock used for heif_decoding_options.deadline_us, in microseconds.
+LIBHEIF_API
+uint64_t heif_get_monotonic_time_us(void);
+
 // Allocate decoding options and fill with default values.
 // Note: you should always get the decoding options through this function since the
 // option structure may grow in size in future versions.
@@ -1235,6 +1851,176 @@ struct heif_error heif_decode_image(const struct heif_image_handle* in_handle,
                                     enum heif_chroma chroma,
                                     const struct heif_decoding_options* options);
 
+// Decodes an image like heif_decode_image(), but writes the result directly into memory of the caller.
+// 'colorspace' and 'chroma' have to be set. The planes are passed in this order:
+//   - interleaved formats: one plane with all components,
+//   - heif_colorspace_monochrome: Y,
+//   - heif_colorspace_YCbCr: Y, Cb, Cr (the chroma planes have the subsampled size),
+//   - heif_colorspace_RGB with heif_chroma_444: R, G, B,
+// followed by an Alpha plane for the non-interleaved formats if the image has an alpha channel
+// (see heif_image_handle_has_alpha_channel()).
+// Each plane covers the size of the image as returned by heif_image_handle_get_width() / heif_image_handle_get_height()
+// with 'strides[i]' bytes per row. The samples have 8 bits for heif_chroma_interleaved_RGB/RGBA and when
+// 'convert_hdr_to_8bit' is set. Otherwise, they have the bit depth returned by heif_image_handle_get_luma_bits_per_pixel()
+// and are stored in 16 bits (in the byte order of the chroma format for the interleaved formats) if it is larger than 8.
+//
+// If possible, the image is decoded into the planes without an intermediate image. Grid tiles are then pasted into
+// the planes directly and, if the tiles are coded in a different format, converted into the output format while
+// decoding. Otherwise (e.g. with alpha channels or transformations), the decoded image is copied into the planes.
+// Decoding options may be NULL.
+LIBHEIF_API
+struct heif_error heif_decode_image_into(const struct heif_image_handle* in_handle,
+                                         enum heif_colorspace colorspace,
+                                         enum heif_chroma chroma,
+                                         uint8_t* const planes[],
+                                         const size_t strides[],
+                                         const struct heif_decoding_options* options);
+
+
+// --- decoding into floating point tensors (e.g. as input of neural networks)
+
+enum heif_tensor_layout
+{
+  // channel x height x width, i.e. NCHW without the batch dimension
+  heif_tensor_layout_planar = 0,
+
+  // height x width x channel, i.e. NHWC without the batch dimension
+  heif_tensor_layout_interleaved = 1
+};
+
+enum heif_tensor_datatype
+{
+  heif_tensor_datatype_float32 = 0,
+  heif_tensor_datatype_float16 = 1 // IEEE 754 half precision
+};
+
+struct heif_tensor_options
+{
+  uint8_t version;
+
+  // --- version 1 options
+
+  // Default: heif_tensor_layout_planar
+  enum heif_tensor_layout layout;
+
+  // Default: heif_tensor_datatype_float32
+  enum heif_tensor_datatype datatype;
+
+  // Size of the tensor. The image is scaled to this size with bilinear interpolation (without antialiasing,
+  // i.e. strong downscaling aliases). The aspect ratio is not preserved. When 0, the image size is used.
+  // Default: 0
+  uint32_t width;
+  uint32_t height;
+
+  // The R,G,B values in the range [0,1] are normalized to (value - mean[c]) / std[c].
+  // Default: mean 0, std 1
+  float mean[3];
+  float std[3];
+};
+
+// Allocate tensor options and fill with default values.
+// Note: you should always get the tensor options through this function since the
+// option structure may grow in size in future versions.
+LIBHEIF_API
+struct heif_tensor_options* heif_tensor_options_alloc(void);
+
+LIBHEIF_API
+void heif_tensor_options_free(struct heif_tensor_options*);
+
+// Decodes an image into an RGB tensor with floating point values in 'out_data'.
+// The tensor has 3 channels (R,G,B) and the size of 'tensor_options', without padding between the rows.
+// 'out_data_size' has to be at least 3 * width * height * (4 for float32, 2 for float16) bytes.
+// Monochrome images give three equal channels. The alpha channel is not included.
+//
+// The image is decoded in its coded colorspace. The YCbCr to RGB conversion, the upsampling of the chroma,
+// the scaling and the normalization are then done in a single pass over the image. Large tensors are computed
+// in parallel with the threads set with heif_context_set_max_decoding_threads().
+// Both option parameters may be NULL to use the defaults.
+LIBHEIF_API
+struct heif_error heif_decode_image_to_tensor(const struct heif_image_handle* in_handle,
+                                              const struct heif_tensor_options* tensor_options,
+                                              void* out_data, size_t out_data_size,
+                                              const struct heif_decoding_options* options);
+
+// Decodes the images of 'num_handles' handles in parallel on the libheif thread pool (see heif_set_thread_pool_size()),
+// for example a primary image together with its depth image or other auxiliary images.
+// The handles may belong to the same heif_context. 'colorspaces[i]' and 'chromas[i]' select the output format of
+// image 'i' as in heif_decode_image(). The same decoding options are used for all images.
+// The alpha channel of an image is decoded in parallel to the image itself anyway (see heif_context_set_max_decoding_threads()).
+// 'out_images[i]' receives the decoded image or NULL if decoding failed. The images have to be released with
+// heif_image_release(). If 'out_errors' is not NULL, 'out_errors[i]' receives the error of image 'i'.
+// The returned error only reports usage errors.
+LIBHEIF_API
+struct heif_error heif_decode_images(const struct heif_image_handle* const* handles,
+                                     int num_handles,
+                                     const enum heif_colorspace* colorspaces,
+                                     const enum heif_chroma* chromas,
+                                     const struct heif_decoding_options* options,
+                                     struct heif_image** out_images,
+                                     struct heif_error* out_errors);
+
+// Decodes an image like heif_decode_image(), but in the background on the libheif thread pool (see heif_set_thread_pool_size()).
+// The function returns immediately. When decoding has finished, 'on_completion' is called from a pool thread with the
+// decoded image, which has to be released with heif_image_release(), or with NULL and the error. The error message
+// is only valid during the callback. Decoding can be canceled with the 'cancel_decoding' callback of the options.
+//
+// If the heif_reader supports asynchronous range requests (version 3), the image data is requested first and the
+// decoding only starts when the data is available. No pool thread is blocked while waiting for the data.
+//
+// The handle may be released immediately after this call. The options are copied, but data referenced by the options
+// (e.g. callbacks and their user data) has to stay valid until 'on_completion' has been called.
+// All decodings have to be completed before heif_deinit() is called.
+// When the thread pool has no threads, the image is decoded in the calling thread before the function returns.
+// The returned error only reports usage errors. 'on_completion' is not called in that case.
+LIBHEIF_API
+struct heif_error heif_decode_image_async(const struct heif_image_handle* in_handle,
+                                          enum heif_colorspace colorspace,
+                                          enum heif_chroma chroma,
+                                          const struct heif_decoding_options* options,
+                                          void (*on_completion)(struct heif_image* image, struct heif_error error, void* userdata),
+                                          void* userdata);
+
+// Decodes the primary images of 'num_inputs' files in memory ('data[i]' with 'sizes[i]' bytes) in parallel
+// on the libheif thread pool (see heif_set_thread_pool_size()). This avoids the overhead of creating a
+// heif_context and heif_image_handle for each of many small images.
+// 'out_images[i]' receives the decoded image or NULL if decoding failed. The images have to be released with
+// heif_image_release(). If 'out_errors' is not NULL, 'out_errors[i]' receives the error of input 'i'.
+// Its message is a generic description of the error code.
+// The memory buffers have to stay valid until the function returns. The returned error only reports usage errors.
+LIBHEIF_API
+struct heif_error heif_decode_images_from_memory(const void* const* data,
+                                                 const size_t* sizes,
+                                                 int num_inputs,
+                                                 enum heif_colorspace colorspace,
+                                                 enum heif_chroma chroma,
+                                                 const struct heif_decoding_options* options,
+                                                 struct heif_image** out_images,
+                                                 struct heif_error* out_errors);
+
+// Decodes the images of the entity group 'group_id' (e.g. a burst or the layers of a 'pymd' pyramid, see
+// heif_context_get_entity_groups()) in parallel on the libheif thread pool (see heif_set_thread_pool_size()).
+// The decoder instances are shared between the images.
+// Entities that are not images (e.g. tracks) are skipped. The images are returned in the order of the group.
+// 'out_images' and 'out_item_ids' (which may be NULL) must have space for 'max_images' entries. If the group
+// has more images, only the first 'max_images' are decoded. '*out_num_images' receives the number of entries.
+// If 'max_width' and 'max_height' are not 0, the images are decoded scaled down as with heif_decode_image_at_size().
+// This is faster for previews (e.g. for selecting an image of a burst) because smaller thumbnails are used when available.
+// 'out_images[i]' receives the decoded image or NULL if decoding failed. The images have to be released with
+// heif_image_release(). If 'out_errors' is not NULL, 'out_errors[i]' receives the error of image 'i'.
+// The returned error only reports usage errors and a non-existing group.
+LIBHEIF_API
+struct heif_error heif_context_decode_entity_group(const struct heif_context* ctx,
+                                                  heif_entity_group_id group_id,
+                                                  enum heif_colorspace colorspace,
+                                                  enum heif_chroma chroma,
+                                                  const struct heif_decoding_options* options,
+                                                  uint32_t max_width, uint32_t max_height,
+                                                  struct heif_image** out_images,
+                                                  heif_item_id* out_item_ids,
+                                                  struct heif_error* out_errors,
+                                                  int max_images,
+                                                  int* out_num_images);
+
 // ====================================================================================================
 //  Encoding API
 
@@ -1250,17 +2036,97 @@ struct heif_writer
   // --- version 1 functions ---
 
   // On success, the returned heif_error may have a NULL message. It will automatically be replaced with a "Success" string.
+  // A version 1 writer receives the whole file in one call. For version 2 writers, write() is called several times
+  // with consecutive parts of the file.
   struct heif_error (* write)(struct heif_context* ctx, // TODO: why do we need this parameter?
                               const void* data,
                               size_t size,
                               void* userdata);
+
+  // --- version 2 functions ---
+
+  // Moves the output position to 'position' (counted from the start of the file). The next write() overwrites the
+  // data at this position. Only used for streaming output (see heif_context_start_streaming()). May be NULL otherwise.
+  struct heif_error (* seek)(struct heif_context* ctx,
+                             uint64_t position,
+                             void* userdata);
 };
 
+// Writes the file. With a version 1 writer, the whole file is assembled in memory first.
+// A version 2 writer receives the header boxes and then the image data in blocks, so that the image data
+// is not copied again when it is kept in a temporary file.
+// If heif_context_start_streaming() or heif_context_start_fragmented_writing() has been called, the same writer
+// and userdata have to be passed.
+// A context that has been read from a file can be written again, e.g. after changing its metadata or primary image.
+// The coded image data is then copied from the input file without decoding it. Files in the 'mini' format are
+// written with a full 'meta' box unless heif_context_set_write_mini_format() is enabled.
+// Files with sequence tracks cannot be written again.
 LIBHEIF_API
 struct heif_error heif_context_write(struct heif_context*,
                                      struct heif_writer* writer,
                                      void* userdata);
 
+// Keeps the compressed image data in a temporary file instead of in memory until the file is written.
+// This has to be called before any image or metadata is added to the context.
+LIBHEIF_API
+struct heif_error heif_context_store_image_data_in_temporary_file(struct heif_context*);
+
+// Writes the compressed image data directly to the output when it is added to the context.
+// This keeps the memory usage low when creating large files. The writer has to be a version 2 writer with a
+// seek() function, because the start of the file is filled in when heif_context_write() is called at the end.
+// The 'ftyp' box has to fit into 248 bytes. The file cannot be written in the 'mini' format.
+// 'writer' has to stay valid until heif_context_write() has been called.
+// This has to be called before any image or metadata is added to the context.
+LIBHEIF_API
+struct heif_error heif_context_start_streaming(struct heif_context*,
+                                               struct heif_writer* writer,
+                                               void* userdata);
+
+// Writes the samples of sequence tracks in movie fragments ('moof'+'mdat') while they are added.
+// The memory usage does not grow with the length of the sequence and the part of the file that has been written
+// can already be read. The 'ftyp', 'meta' and 'moov' boxes are written before the first fragment. Hence, all tracks
+// have to be added and have received their first sample before the first fragment is written. Image items cannot
+// be stored in fragmented files.
+// A fragment is written when it has at least 'samples_per_fragment' samples and the next sample is a sync sample,
+// such that each fragment starts with a sync sample. heif_context_write() writes the last fragment.
+// 'writer' does not need a seek() function. It has to stay valid until heif_context_write() has been called.
+// This has to be called before any track is added to the context.
+LIBHEIF_API
+struct heif_error heif_context_start_fragmented_writing(struct heif_context*,
+                                                        struct heif_writer* writer,
+                                                        void* userdata,
+                                                        uint32_t samples_per_fragment);
+
+// Writes the file in the compact 'mini' format (ftyp+mini) when its content can be represented with it.
+// This is the case for a single HEVC or AV1 image with an nclx color profile and optionally an alpha image,
+// ICC profile, Exif and XMP metadata. The image may only have 'ispe', 'pixi', 'colr', 'irot' and 'imir' properties.
+// Other files are written with a full 'meta' box as usual.
+// This has no effect in streaming mode or when libheif was built without ENABLE_EXPERIMENTAL_MINI_FORMAT.
+LIBHEIF_API
+void heif_context_set_write_mini_format(struct heif_context*, int enable);
+
+enum heif_image_data_order
+{
+  // The image data is stored in the order in which it has been added (default).
+  heif_image_data_order_as_added = 0,
+
+  // The image data is stored in the order in which a viewer that loads the file progressively with range requests
+  // needs it: the thumbnails of the primary image, its pyramid layers from the smallest to the largest,
+  // its alpha image, the primary image itself and its other auxiliary images, followed by the other top-level images
+  // in the same way. The tiles of 'grid' images are stored in raster order.
+  heif_image_data_order_progressive = 1,
+
+  // Like heif_image_data_order_progressive, but the tiles of 'grid' images are stored in Z-order,
+  // such that the tiles of each square region of the image lie close together.
+  heif_image_data_order_progressive_z_order = 2
+};
+
+// Selects the order of the image data in the 'mdat' box. The 'ftyp' and 'meta' boxes are always written first,
+// so that a client can render a preview with few range requests at the start of the file.
+// The order has no effect in streaming mode and for files with sequence tracks.
+LIBHEIF_API
+void heif_context_set_image_data_order(struct heif_context*, enum heif_image_data_order order);
+
 // Add a compatible brand that is now added automatically by libheif when encoding images (e.g. some application brands like 'geo1').
 LIBHEIF_API
 void heif_context_add_compatible_brand(struct heif_context* ctx,
@@ -1399,6 +2265,15 @@ struct heif_error heif_encoder_set_lossy_quality(struct heif_encoder*, int quali
 LIBHEIF_API
 struct heif_error heif_encoder_set_lossless(struct heif_encoder*, int enable);
 
+// Set the encoding speed with a codec-independent 'speed class' from 0 (slowest, best compression)
+// to 9 (fastest). Each encoder maps it onto its own speed or preset parameter (e.g. the x265 'preset'
+// or the aom 'speed'), which is overwritten. Encoders with fewer steps map neighboring classes
+// onto the same setting. The encoding time of each class can be measured for a given encoder with
+// 'heif-bench --filter encode/speed-class'.
+// Returns heif_suberror_Unsupported_parameter if the encoder has no speed setting.
+LIBHEIF_API
+struct heif_error heif_encoder_set_speed_class(struct heif_encoder*, int speed_class);
+
 // level should be between 0 (= none) to 4 (= full)
 LIBHEIF_API
 struct heif_error heif_encoder_set_logging_level(struct heif_encoder*, int level);
@@ -1576,6 +2451,13 @@ struct heif_encoding_options
   // Set this to true to use compressed form of uncC where possible.
   uint8_t prefer_uncC_short_form;
 
+  // version 8 options
+
+  // When this is not 0, heif_context_encode_image() stores images that are wider or higher than this size as a 'grid'
+  // image with square tiles of this size. The tiles are encoded in parallel (see heif_context_set_max_encoding_threads()).
+  // Use this for images that exceed the maximum image size of the codec.
+  uint32_t grid_tile_size; // default: 0
+
   // TODO: we should add a flag to force MIAF compatible outputs. E.g. this will put restrictions on grid tile sizes and
   //       might add a clap box when the grid output size does not match the color subsampling factors.
   //       Since some of these constraints have to be known before actually encoding the image, "forcing MIAF compatibility"
@@ -1601,6 +2483,21 @@ struct heif_error heif_context_encode_image(struct heif_context*,
                                             const struct heif_encoding_options* options,
                                             struct heif_image_handle** out_image_handle);
 
+// Like heif_context_encode_image(), but the quality is chosen automatically as the highest quality at which
+// the coded image (including its alpha channel) is not larger than 'target_size' bytes.
+// The color conversion is only done once for all search steps, the search is started at half resolution and
+// several qualities are probed in parallel (see heif_context_set_max_encoding_threads()).
+// The quality and lossless settings of 'encoder' are not used and not changed. The chosen quality is
+// returned in 'out_quality' unless it is NULL. If the image does not fit even at quality 0, it is coded with quality 0.
+LIBHEIF_API
+struct heif_error heif_context_encode_image_with_target_size(struct heif_context*,
+                                                             const struct heif_image* image,
+                                                             struct heif_encoder* encoder,
+                                                             const struct heif_encoding_options* options,
+                                                             size_t target_size,
+                                                             int* out_quality,
+                                                             struct heif_image_handle** out_image_handle);
+
 /**
  * @brief Encodes an array of images into a grid.
  * 
@@ -1638,6 +2535,16 @@ struct heif_error heif_context_add_image_tile(struct heif_context* ctx,
                                               const struct heif_image* image,
                                               struct heif_encoder* encoder);
 
+// Adds a tile to a grid image from data that has already been coded, without re-encoding it.
+// Currently, only HEVC Annex-B byte streams are supported. The byte stream has to contain a single intra coded image
+// with its VPS, SPS and PPS, which are stored in the 'hvcC' property of the tile.
+LIBHEIF_API
+struct heif_error heif_context_add_precoded_image_tile(struct heif_context* ctx,
+                                                       struct heif_image_handle* grid_image,
+                                                       uint32_t tile_x, uint32_t tile_y,
+                                                       enum heif_compression_format format,
+                                                       const uint8_t* data, size_t size);
+
 // offsets[] should either be NULL (all offsets==0) or an array of size 2*nImages with x;y offset pairs.
 // If background_rgba is NULL, the background is transparent.
 LIBHEIF_API
@@ -1714,6 +2621,13 @@ struct heif_error heif_context_add_generic_uri_metadata(struct heif_context* ctx
                                                     const char* item_uri_type,
                                                     heif_item_id* out_item_id);
 
+// Removes a metadata block (e.g. Exif or XMP) from an image. 'metadata_id' is one of the IDs returned by
+// heif_image_handle_get_list_of_metadata_block_IDs().
+LIBHEIF_API
+struct heif_error heif_context_remove_metadata(struct heif_context* ctx,
+                                               const struct heif_image_handle* image_handle,
+                                               heif_item_id metadata_id);
+
 
 
 // DEPRECATED, typo in function name
@@ -26,6 +26,7 @@
 #include "pixelimage.h"
 #include "api_structs.h"
 #include "error.h"
+#include "color-conversion/gain_map.h"
 #include <set>
 #include <limits>
 
@@ -358,3 +359,58 @@ struct heif_error heif_mastering_display_colour_volume_decode(const struct heif_
 }
 
 
+
+
+struct heif_gain_map_parameters* heif_gain_map_parameters_alloc()
+{
+  auto* params = new heif_gain_map_parameters;
+  params->version = 1;
+
+  for (int c = 0; c < 3; c++) {
+    params->gain_map_min[c] = 0.0f;
+    params->gain_map_max[c] = 0.0f;
+    params->gamma[c] = 1.0f;
+    params->base_offset[c] = 1.0f / 64;
+    params->alternate_offset[c] = 1.0f / 64;
+  }
+
+  params->base_hdr_headroom = 0.0f;
+  params->alternate_hdr_headroom = 0.0f;
+
+  return params;
+}
+
+
+void heif_gain_map_parameters_free(struct heif_gain_map_parameters* params)
+{
+  delete params;
+}
+
+
+struct heif_error heif_image_apply_gain_map(const struct heif_image* base_image,
+                                            const struct heif_image* gain_map,
+                                            const struct heif_gain_map_parameters* params,
+                                            float target_hdr_headroom,
+                                            struct heif_image** out_image)
+{
+  if (base_image == nullptr || gain_map == nullptr || params == nullptr || out_image == nullptr) {
+    return error_null_parameter;
+  }
+
+  if (params->version < 1) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unsupported_parameter,
+            "Unsupported version of heif_gain_map_parameters"};
+  }
+
+  auto result = apply_gain_map(base_image->image, gain_map->image, *params, target_hdr_headroom,
+                               heif_get_global_security_limits());
+  if (!result) {
+    return result.error.error_struct(base_image->image.get());
+  }
+
+  *out_image = new heif_image;
+  (*out_image)->image = *result;
+
+  return heif_error_success;
+}
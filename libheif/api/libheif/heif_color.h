@@ -264,6 +264,52 @@ LIBHEIF_API
 struct heif_error heif_mastering_display_colour_volume_decode(const struct heif_mastering_display_colour_volume* in,
                                                               struct heif_decoded_mastering_display_colour_volume* out);
 
+
+// ------------------------- gain maps -------------------------
+
+// Gain map metadata as specified in ISO 21496-1. All gains and headrooms are log2 values.
+// Single-channel gain maps use the values at index 0.
+struct heif_gain_map_parameters
+{
+  uint8_t version;
+
+  // --- version 1 parameters
+
+  float gain_map_min[3];     // default: 0
+  float gain_map_max[3];     // default: 0
+  float gamma[3];            // default: 1, has to be > 0
+  float base_offset[3];      // default: 1/64
+  float alternate_offset[3]; // default: 1/64
+
+  float base_hdr_headroom;      // default: 0
+  float alternate_hdr_headroom; // default: 0
+};
+
+LIBHEIF_API
+struct heif_gain_map_parameters* heif_gain_map_parameters_alloc(void);
+
+LIBHEIF_API
+void heif_gain_map_parameters_free(struct heif_gain_map_parameters*);
+
+// Combines the base image and its gain map into an image for a display with the given HDR headroom (log2 of the
+// display peak relative to the SDR reference white of 203 cd/m^2). This is done in a single pass without creating
+// intermediate full-size images. The gain map may have a lower resolution, it is bilinearly scaled on the fly.
+//
+// The base image is linearized according to its NCLX transfer characteristics (sRGB if unspecified;
+// BT.709/601/2020, gamma 2.2/2.8, linear and PQ are supported).
+// When 'target_hdr_headroom' is negative, the headroom is taken from the mdcv or clli metadata of the base image,
+// or the larger one of the base and alternate headroom if there is neither.
+//
+// The output is a planar RGB image with 16 bit linear samples (transfer characteristics 'linear') in the
+// primaries of the base image. 65535 corresponds to the target headroom, which is also stored as the
+// maximum content light level. An alpha plane of the base image is copied, scaled to 16 bit.
+LIBHEIF_API
+struct heif_error heif_image_apply_gain_map(const struct heif_image* base_image,
+                                            const struct heif_image* gain_map,
+                                            const struct heif_gain_map_parameters* params,
+                                            float target_hdr_headroom,
+                                            struct heif_image** out_image);
+
 #ifdef __cplusplus
 }
 #endif
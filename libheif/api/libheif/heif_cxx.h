@@ -27,6 +27,8 @@
 #ifndef LIBHEIF_HEIF_CXX_H
 #define LIBHEIF_HEIF_CXX_H
 
+#include <exception>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -34,6 +36,7 @@
 
 extern "C" {
 #include <libheif/heif.h>
+#include <libheif/heif_sequences.h>
 }
 
 
@@ -88,6 +91,8 @@ namespace heif {
 
   class Image;
 
+  class Track;
+
   class Encoder;
 
   class EncoderParameter;
@@ -95,6 +100,99 @@ namespace heif {
   class EncoderDescriptor;
 
 
+  // ------------------------- move-only handles -------------------------
+
+  // The classes below share their C objects with std::shared_ptr, which allocates a reference count for each object.
+  // These move-only owners have no overhead over the raw C pointers. They can be used with the free functions below.
+
+  struct ContextDeleter
+  {
+    void operator()(heif_context* ctx) const noexcept
+    { heif_context_free(ctx); }
+  };
+
+  struct ImageHandleDeleter
+  {
+    void operator()(heif_image_handle* handle) const noexcept
+    { heif_image_handle_release(handle); }
+  };
+
+  struct ImageDeleter
+  {
+    void operator()(heif_image* image) const noexcept
+    { heif_image_release(image); }
+  };
+
+  struct TrackDeleter
+  {
+    void operator()(heif_track* track) const noexcept
+    { heif_track_release(track); }
+  };
+
+  using UniqueContext = std::unique_ptr<heif_context, ContextDeleter>;
+
+  using UniqueImageHandle = std::unique_ptr<heif_image_handle, ImageHandleDeleter>;
+
+  using UniqueImage = std::unique_ptr<heif_image, ImageDeleter>;
+
+  using UniqueTrack = std::unique_ptr<heif_track, TrackDeleter>;
+
+
+  // View of the pixel data of an image plane. It does not own the data and is only valid as long as the image exists.
+  // T is 'uint8_t' or 'const uint8_t'.
+  template <typename T>
+  struct PlaneView
+  {
+    T* data = nullptr;
+    size_t stride = 0; // in bytes
+    int width = 0;
+    int height = 0;
+    int bits_per_pixel = 0;
+
+    bool empty() const noexcept
+    { return data == nullptr; }
+
+    T* row(int y) const noexcept
+    { return data + y * stride; }
+  };
+
+  // Returns an empty view if the image has no such channel.
+  inline PlaneView<const uint8_t> get_plane_view(const heif_image* image, heif_channel channel) noexcept;
+
+  inline PlaneView<uint8_t> get_plane_view(heif_image* image, heif_channel channel) noexcept;
+
+  // The decoding options may be NULL.
+
+  // throws Error
+  inline UniqueImage decode_image(const heif_image_handle* handle, heif_colorspace colorspace, heif_chroma chroma,
+                                  const heif_decoding_options* options = nullptr);
+
+  // The tile position is given in tile indices (see heif_image_handle_decode_image_tile()).
+  // throws Error
+  inline UniqueImage decode_image_tile(const heif_image_handle* handle, uint32_t tile_x, uint32_t tile_y,
+                                       heif_colorspace colorspace, heif_chroma chroma,
+                                       const heif_decoding_options* options = nullptr);
+
+  // throws Error
+  inline UniqueImage decode_image_region(const heif_image_handle* handle,
+                                         uint32_t x0, uint32_t y0, uint32_t width, uint32_t height,
+                                         heif_colorspace colorspace, heif_chroma chroma,
+                                         const heif_decoding_options* options = nullptr);
+
+  // Decodes into memory of the caller (see heif_decode_image_into() for the plane layout).
+  // throws Error
+  inline void decode_image_into(const heif_image_handle* handle, heif_colorspace colorspace, heif_chroma chroma,
+                                uint8_t* const planes[], const size_t strides[],
+                                const heif_decoding_options* options = nullptr);
+
+  // Decodes the image on the libheif thread pool. The future throws an Error if decoding fails.
+  // Data referenced by the options (e.g. callbacks) has to stay valid until the image has been decoded.
+  // throws Error (for usage errors)
+  inline std::future<UniqueImage> decode_image_async(const heif_image_handle* handle,
+                                                     heif_colorspace colorspace, heif_chroma chroma,
+                                                     const heif_decoding_options* options = nullptr);
+
+
   class Context
   {
   public:
@@ -145,6 +243,15 @@ namespace heif {
 
     ImageHandle get_image_handle(heif_item_id id) const;
 
+    // ------------------------- sequences -------------------------
+
+    bool has_sequence() const noexcept;
+
+    std::vector<uint32_t> get_track_ids() const;
+
+    // throws Error
+    Track get_track(uint32_t track_id) const;
+
 
     class EncodingOptions : public heif_encoding_options
     {
@@ -192,6 +299,12 @@ namespace heif {
     // throws Error
     void write_to_file(const std::string& filename) const;
 
+    heif_context* get_raw_context() noexcept
+    { return m_context.get(); }
+
+    const heif_context* get_raw_context() const noexcept
+    { return m_context.get(); }
+
   private:
     std::shared_ptr<heif_context> m_context;
 
@@ -266,6 +379,31 @@ namespace heif {
     Image decode_image(heif_colorspace colorspace, heif_chroma chroma,
                        const DecodingOptions& options = DecodingOptions());
 
+    // ------------------------- tiles, regions and decoding into buffers -------------------------
+    // The decoding options may be NULL.
+
+    // throws Error
+    heif_image_tiling get_image_tiling(bool process_image_transformations = true) const;
+
+    // throws Error
+    Image decode_image_tile(uint32_t tile_x, uint32_t tile_y, heif_colorspace colorspace, heif_chroma chroma,
+                            const heif_decoding_options* options = nullptr) const;
+
+    // throws Error
+    Image decode_image_region(uint32_t x0, uint32_t y0, uint32_t width, uint32_t height,
+                              heif_colorspace colorspace, heif_chroma chroma,
+                              const heif_decoding_options* options = nullptr) const;
+
+    // throws Error
+    void decode_image_into(heif_colorspace colorspace, heif_chroma chroma,
+                           uint8_t* const planes[], const size_t strides[],
+                           const heif_decoding_options* options = nullptr) const;
+
+    // See heif::decode_image_async().
+    // throws Error
+    std::future<Image> decode_image_async(heif_colorspace colorspace, heif_chroma chroma,
+                                          const heif_decoding_options* options = nullptr) const;
+
 
     heif_image_handle* get_raw_image_handle() noexcept
     { return m_image_handle.get(); }
@@ -321,6 +459,8 @@ namespace heif {
 
     Image(heif_image* image);
 
+    bool empty() const noexcept
+    { return !m_image; }
 
     // throws Error
     void create(int width, int height,
@@ -349,6 +489,16 @@ namespace heif {
 
     uint8_t* get_plane(enum heif_channel channel, size_t* out_stride) noexcept;
 
+    PlaneView<const uint8_t> get_plane_view(enum heif_channel channel) const noexcept;
+
+    PlaneView<uint8_t> get_plane_view(enum heif_channel channel) noexcept;
+
+    heif_image* get_raw_image() noexcept
+    { return m_image.get(); }
+
+    const heif_image* get_raw_image() const noexcept
+    { return m_image.get(); }
+
     // throws Error
     void set_nclx_color_profile(const ColorProfile_nclx&);
 
@@ -382,6 +532,45 @@ namespace heif {
   };
 
 
+  // A track of an image sequence. Tracks cannot be copied, only moved.
+  class Track
+  {
+  public:
+    Track() = default;
+
+    explicit Track(heif_track* track) : m_track(track)
+    {}
+
+    bool empty() const noexcept
+    { return !m_track; }
+
+    uint32_t get_id() const noexcept;
+
+    heif_track_type get_track_handler_type() const noexcept;
+
+    uint32_t get_timescale() const noexcept;
+
+    uint32_t get_number_of_samples() const noexcept;
+
+    // Returns an empty Image after the last image of the sequence.
+    // throws Error
+    Image decode_next_image(heif_colorspace colorspace, heif_chroma chroma,
+                            const heif_decoding_options* options = nullptr);
+
+    // Decodes up to 'num_frames' images ahead in the background (see heif_track_set_decoding_lookahead()).
+    void set_decoding_lookahead(int num_frames) noexcept;
+
+    // throws Error
+    void seek_to_sample(uint32_t sample_index);
+
+    heif_track* get_raw_track() const noexcept
+    { return m_track.get(); }
+
+  private:
+    UniqueTrack m_track;
+  };
+
+
   class EncoderDescriptor
   {
   public:
@@ -1362,6 +1551,246 @@ namespace heif {
       throw err;
     }
   }
+
+
+  // ------------------------- move-only handles -------------------------
+
+  inline PlaneView<const uint8_t> get_plane_view(const heif_image* image, heif_channel channel) noexcept
+  {
+    PlaneView<const uint8_t> view;
+    view.data = heif_image_get_plane_readonly2(image, channel, &view.stride);
+    if (view.data) {
+      view.width = heif_image_get_width(image, channel);
+      view.height = heif_image_get_height(image, channel);
+      view.bits_per_pixel = heif_image_get_bits_per_pixel(image, channel);
+    }
+    return view;
+  }
+
+  inline PlaneView<uint8_t> get_plane_view(heif_image* image, heif_channel channel) noexcept
+  {
+    PlaneView<uint8_t> view;
+    view.data = heif_image_get_plane2(image, channel, &view.stride);
+    if (view.data) {
+      view.width = heif_image_get_width(image, channel);
+      view.height = heif_image_get_height(image, channel);
+      view.bits_per_pixel = heif_image_get_bits_per_pixel(image, channel);
+    }
+    return view;
+  }
+
+  inline UniqueImage decode_image(const heif_image_handle* handle, heif_colorspace colorspace, heif_chroma chroma,
+                                  const heif_decoding_options* options)
+  {
+    heif_image* out_img;
+    Error err = Error(heif_decode_image(handle, &out_img, colorspace, chroma, options));
+    if (err) {
+      throw err;
+    }
+
+    return UniqueImage(out_img);
+  }
+
+  inline UniqueImage decode_image_tile(const heif_image_handle* handle, uint32_t tile_x, uint32_t tile_y,
+                                       heif_colorspace colorspace, heif_chroma chroma,
+                                       const heif_decoding_options* options)
+  {
+    heif_image* out_img;
+    Error err = Error(heif_image_handle_decode_image_tile(handle, &out_img, colorspace, chroma, options, tile_x, tile_y));
+    if (err) {
+      throw err;
+    }
+
+    return UniqueImage(out_img);
+  }
+
+  inline UniqueImage decode_image_region(const heif_image_handle* handle,
+                                         uint32_t x0, uint32_t y0, uint32_t width, uint32_t height,
+                                         heif_colorspace colorspace, heif_chroma chroma,
+                                         const heif_decoding_options* options)
+  {
+    heif_image* out_img;
+    Error err = Error(heif_decode_image_region(handle, &out_img, colorspace, chroma, options, x0, y0, width, height));
+    if (err) {
+      throw err;
+    }
+
+    return UniqueImage(out_img);
+  }
+
+  inline void decode_image_into(const heif_image_handle* handle, heif_colorspace colorspace, heif_chroma chroma,
+                                uint8_t* const planes[], const size_t strides[],
+                                const heif_decoding_options* options)
+  {
+    Error err = Error(heif_decode_image_into(handle, colorspace, chroma, planes, strides, options));
+    if (err) {
+      throw err;
+    }
+  }
+
+  namespace detail {
+    // T is constructed from the decoded heif_image*, which it takes ownership of.
+    template <typename T>
+    std::future<T> decode_image_async(const heif_image_handle* handle, heif_colorspace colorspace, heif_chroma chroma,
+                                      const heif_decoding_options* options)
+    {
+      auto* promise = new std::promise<T>();
+      std::future<T> future = promise->get_future();
+
+      heif_error err = heif_decode_image_async(handle, colorspace, chroma, options,
+                                               [](heif_image* image, heif_error error, void* userdata) {
+                                                 auto* p = static_cast<std::promise<T>*>(userdata);
+                                                 if (image) {
+                                                   p->set_value(T(image));
+                                                 }
+                                                 else {
+                                                   p->set_exception(std::make_exception_ptr(Error(error)));
+                                                 }
+                                                 delete p;
+                                               },
+                                               promise);
+      if (err.code != heif_error_Ok) {
+        delete promise;
+        throw Error(err);
+      }
+
+      return future;
+    }
+  }
+
+  inline std::future<UniqueImage> decode_image_async(const heif_image_handle* handle,
+                                                     heif_colorspace colorspace, heif_chroma chroma,
+                                                     const heif_decoding_options* options)
+  {
+    return detail::decode_image_async<UniqueImage>(handle, colorspace, chroma, options);
+  }
+
+
+  inline heif_image_tiling ImageHandle::get_image_tiling(bool process_image_transformations) const
+  {
+    heif_image_tiling tiling;
+    Error err = Error(heif_image_handle_get_image_tiling(m_image_handle.get(), process_image_transformations, &tiling));
+    if (err) {
+      throw err;
+    }
+
+    return tiling;
+  }
+
+  inline Image ImageHandle::decode_image_tile(uint32_t tile_x, uint32_t tile_y, heif_colorspace colorspace,
+                                              heif_chroma chroma, const heif_decoding_options* options) const
+  {
+    return Image(heif::decode_image_tile(m_image_handle.get(), tile_x, tile_y, colorspace, chroma, options).release());
+  }
+
+  inline Image ImageHandle::decode_image_region(uint32_t x0, uint32_t y0, uint32_t width, uint32_t height,
+                                                heif_colorspace colorspace, heif_chroma chroma,
+                                                const heif_decoding_options* options) const
+  {
+    return Image(heif::decode_image_region(m_image_handle.get(), x0, y0, width, height,
+                                           colorspace, chroma, options).release());
+  }
+
+  inline void ImageHandle::decode_image_into(heif_colorspace colorspace, heif_chroma chroma,
+                                             uint8_t* const planes[], const size_t strides[],
+                                             const heif_decoding_options* options) const
+  {
+    heif::decode_image_into(m_image_handle.get(), colorspace, chroma, planes, strides, options);
+  }
+
+  inline std::future<Image> ImageHandle::decode_image_async(heif_colorspace colorspace, heif_chroma chroma,
+                                                            const heif_decoding_options* options) const
+  {
+    return detail::decode_image_async<Image>(m_image_handle.get(), colorspace, chroma, options);
+  }
+
+  inline PlaneView<const uint8_t> Image::get_plane_view(enum heif_channel channel) const noexcept
+  {
+    return heif::get_plane_view(static_cast<const heif_image*>(m_image.get()), channel);
+  }
+
+  inline PlaneView<uint8_t> Image::get_plane_view(enum heif_channel channel) noexcept
+  {
+    return heif::get_plane_view(m_image.get(), channel);
+  }
+
+
+  // ------------------------- sequences -------------------------
+
+  inline bool Context::has_sequence() const noexcept
+  {
+    return heif_context_has_sequence(m_context.get()) != 0;
+  }
+
+  inline std::vector<uint32_t> Context::get_track_ids() const
+  {
+    int n = heif_context_number_of_sequence_tracks(m_context.get());
+    if (n <= 0) {
+      return {};
+    }
+
+    std::vector<uint32_t> ids(n);
+    heif_context_get_track_ids(m_context.get(), ids.data());
+    return ids;
+  }
+
+  inline Track Context::get_track(uint32_t track_id) const
+  {
+    heif_track* track = heif_context_get_track(m_context.get(), track_id);
+    if (!track) {
+      throw Error(heif_error_Usage_error, heif_suberror_Unspecified, "No track with this ID");
+    }
+
+    return Track(track);
+  }
+
+  inline uint32_t Track::get_id() const noexcept
+  {
+    return heif_track_get_id(m_track.get());
+  }
+
+  inline heif_track_type Track::get_track_handler_type() const noexcept
+  {
+    return heif_track_get_track_handler_type(m_track.get());
+  }
+
+  inline uint32_t Track::get_timescale() const noexcept
+  {
+    return heif_track_get_timescale(m_track.get());
+  }
+
+  inline uint32_t Track::get_number_of_samples() const noexcept
+  {
+    return heif_track_get_number_of_samples(m_track.get());
+  }
+
+  inline Image Track::decode_next_image(heif_colorspace colorspace, heif_chroma chroma,
+                                        const heif_decoding_options* options)
+  {
+    heif_image* out_img;
+    heif_error err = heif_track_decode_next_image(m_track.get(), &out_img, colorspace, chroma, options);
+    if (err.code == heif_error_End_of_sequence) {
+      return Image();
+    }
+    else if (err.code != heif_error_Ok) {
+      throw Error(err);
+    }
+
+    return Image(out_img);
+  }
+
+  inline void Track::set_decoding_lookahead(int num_frames) noexcept
+  {
+    heif_track_set_decoding_lookahead(m_track.get(), num_frames);
+  }
+
+  inline void Track::seek_to_sample(uint32_t sample_index)
+  {
+    Error err = Error(heif_track_seek_to_sample(m_track.get(), sample_index));
+    if (err) {
+      throw err;
+    }
+  }
 }
 
 
@@ -1,8 +1,11 @@
 #ifndef LIBHEIF_BOX_EMSCRIPTEN_H
 #define LIBHEIF_BOX_EMSCRIPTEN_H
 
+#include <emscripten.h>
 #include <emscripten/bind.h>
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <string>
 #include <sstream>
@@ -219,6 +222,9 @@ static emscripten::val heif_js_decode_image(struct heif_image_handle* handle,
 /*
  * The returned object includes a pointer to an heif_image in the property "image".
  * This image has to be released after the image data has been read (copied) with heif_image_release().
+ *
+ * The "data" of each channel is a typed array view onto the WASM heap, not a copy.
+ * It becomes invalid when the image is released or when the WASM memory grows.
  */
 static emscripten::val heif_js_decode_image2(struct heif_image_handle* handle,
                                              enum heif_colorspace colorspace, enum heif_chroma chroma)
@@ -285,6 +291,268 @@ static emscripten::val heif_js_decode_image2(struct heif_image_handle* handle,
 }
 
 
+// Copies the interleaved RGBA plane of 'image' into the typed array 'target'.
+static void heif_js_copy_rgba_image(const struct heif_image* image, emscripten::val& target, int width, int height)
+{
+  size_t stride;
+  const uint8_t* plane = heif_image_get_plane_readonly2(image, heif_channel_interleaved, &stride);
+  size_t row_size = (size_t) width * 4;
+
+  // TypedArray.set() copies the data from the WASM heap without a JS loop.
+  if (stride == row_size) {
+    target.call<void>("set", emscripten::val(emscripten::typed_memory_view(row_size * height, plane)));
+  }
+  else {
+    for (int y = 0; y < height; y++) {
+      target.call<void>("set", emscripten::val(emscripten::typed_memory_view(row_size, plane + y * stride)),
+                        (double) (y * row_size));
+    }
+  }
+}
+
+
+/*
+ * Decodes the image to RGBA with 8 bits per component and writes it into 'target', which
+ * is typically the Uint8ClampedArray of an ImageData. When 'width' and 'height' are > 0, the
+ * image is scaled to this size (e.g. for thumbnails), otherwise the image size is used.
+ * 'target' has to hold at least width*height*4 bytes. The rows are written without padding.
+ * Returns a heif_error.
+ */
+static emscripten::val heif_js_decode_image_rgba(struct heif_image_handle* handle, emscripten::val target,
+                                                 int width, int height)
+{
+  struct heif_error err{heif_error_Ok, heif_suberror_Unspecified, "Success"};
+
+  if (!handle) {
+    err = {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "No image handle"};
+    return emscripten::val(err);
+  }
+
+  int image_width = heif_image_handle_get_width(handle);
+  int image_height = heif_image_handle_get_height(handle);
+
+  if (width <= 0 || height <= 0) {
+    width = image_width;
+    height = image_height;
+  }
+
+  if (target["length"].as<double>() < double(width) * height * 4) {
+    err = {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Target array is too small"};
+    return emscripten::val(err);
+  }
+
+  // Let codecs that support it decode at a lower resolution that is still at least the target size.
+  struct heif_decoding_options* options = heif_decoding_options_alloc();
+  int denominator = 1;
+  while (denominator < 8 &&
+         (image_width + 2 * denominator - 1) / (2 * denominator) >= width &&
+         (image_height + 2 * denominator - 1) / (2 * denominator) >= height) {
+    denominator *= 2;
+  }
+  options->target_scale_denominator = (uint8_t) denominator;
+
+  struct heif_image* image;
+  err = heif_decode_image(handle, &image, heif_colorspace_RGB, heif_chroma_interleaved_RGBA, options);
+  heif_decoding_options_free(options);
+  if (err.code != heif_error_Ok) {
+    return emscripten::val(err);
+  }
+
+  if (heif_image_get_primary_width(image) != width || heif_image_get_primary_height(image) != height) {
+    struct heif_scaling_options* scaling_options = heif_scaling_options_alloc();
+
+    struct heif_image* scaled_image;
+    err = heif_image_scale_image(image, &scaled_image, width, height, scaling_options);
+    heif_scaling_options_free(scaling_options);
+    heif_image_release(image);
+    if (err.code != heif_error_Ok) {
+      return emscripten::val(err);
+    }
+
+    image = scaled_image;
+  }
+
+  heif_js_copy_rgba_image(image, target, width, height);
+  heif_image_release(image);
+
+  return emscripten::val(err);
+}
+
+
+/*
+ * Decodes the region (x,y,width,height) of the image as RGBA into the typed array 'target' (e.g. the data of an ImageData).
+ * For grid and tiled images, only the tiles that overlap with the region are read and decoded.
+ * Returns a heif_error.
+ */
+static emscripten::val heif_js_decode_image_region_rgba(struct heif_image_handle* handle, emscripten::val target,
+                                                        int x, int y, int width, int height)
+{
+  struct heif_error err{heif_error_Ok, heif_suberror_Unspecified, "Success"};
+
+  if (!handle) {
+    err = {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "No image handle"};
+    return emscripten::val(err);
+  }
+
+  if (x < 0 || y < 0 || width <= 0 || height <= 0) {
+    err = {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Invalid region"};
+    return emscripten::val(err);
+  }
+
+  if (target["length"].as<double>() < double(width) * height * 4) {
+    err = {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Target array is too small"};
+    return emscripten::val(err);
+  }
+
+  struct heif_image* image;
+  err = heif_decode_image_region(handle, &image, heif_colorspace_RGB, heif_chroma_interleaved_RGBA, nullptr,
+                                 (uint32_t) x, (uint32_t) y, (uint32_t) width, (uint32_t) height);
+  if (err.code != heif_error_Ok) {
+    return emscripten::val(err);
+  }
+
+  heif_js_copy_rgba_image(image, target, width, height);
+  heif_image_release(image);
+
+  return emscripten::val(err);
+}
+
+
+// --- Reading from a HeifRangeReader (see post.js), which only downloads the file ranges that libheif reads.
+// The JS reader lives on the main runtime thread. In a build with threads, the calls are proxied to it.
+
+struct heif_js_range_reader
+{
+  int id;
+  uint64_t size;
+  uint64_t position;
+};
+
+static std::map<int, std::unique_ptr<heif_js_range_reader>>& heif_js_range_readers()
+{
+  static std::map<int, std::unique_ptr<heif_js_range_reader>> readers;
+  return readers;
+}
+
+static int64_t heif_js_range_reader_get_position(void* userdata)
+{
+  return (int64_t) static_cast<heif_js_range_reader*>(userdata)->position;
+}
+
+static int heif_js_range_reader_read(void* data, size_t size, void* userdata)
+{
+  auto* reader = static_cast<heif_js_range_reader*>(userdata);
+
+  int ok = MAIN_THREAD_EM_ASM_INT({
+    return Module.HeifRangeReader._get($0)._read($1, $2, $3) ? 1 : 0;
+  }, reader->id, (double) reader->position, (double) size, data);
+
+  if (!ok) {
+    return 1;
+  }
+
+  reader->position += size;
+  return 0;
+}
+
+static int heif_js_range_reader_seek(int64_t position, void* userdata)
+{
+  auto* reader = static_cast<heif_js_range_reader*>(userdata);
+  if (position < 0 || (uint64_t) position > reader->size) {
+    return 1;
+  }
+
+  reader->position = (uint64_t) position;
+  return 0;
+}
+
+static enum heif_reader_grow_status heif_js_range_reader_wait_for_file_size(int64_t target_size, void* userdata)
+{
+  auto* reader = static_cast<heif_js_range_reader*>(userdata);
+  return (target_size < 0 || (uint64_t) target_size > reader->size) ? heif_reader_grow_status_size_beyond_eof
+                                                                      : heif_reader_grow_status_size_reached;
+}
+
+static struct heif_reader_range_request_result heif_js_range_reader_request_range(uint64_t start_pos, uint64_t end_pos,
+                                                                                  void* userdata)
+{
+  auto* reader = static_cast<heif_js_range_reader*>(userdata);
+
+  struct heif_reader_range_request_result result{};
+  result.range_end = std::min(end_pos, reader->size);
+
+  int ok = MAIN_THREAD_EM_ASM_INT({
+    return Module.HeifRangeReader._get($0)._request($1, $2) ? 1 : 0;
+  }, reader->id, (double) start_pos, (double) result.range_end);
+
+  if (!ok) {
+    result.status = heif_reader_grow_status_error;
+    result.reader_error_msg = "HTTP range request failed";
+  }
+  else if (end_pos > reader->size) {
+    result.status = heif_reader_grow_status_size_beyond_eof;
+  }
+  else {
+    result.status = heif_reader_grow_status_size_reached;
+  }
+
+  return result;
+}
+
+static void heif_js_range_reader_preload_range_hint(uint64_t start_pos, uint64_t end_pos, void* userdata)
+{
+  auto* reader = static_cast<heif_js_range_reader*>(userdata);
+
+  MAIN_THREAD_EM_ASM({
+    Module.HeifRangeReader._get($0)._hint($1, $2);
+  }, reader->id, (double) start_pos, (double) end_pos);
+}
+
+static void heif_js_range_reader_release_file_range(uint64_t start_pos, uint64_t end_pos, void* userdata)
+{
+  auto* reader = static_cast<heif_js_range_reader*>(userdata);
+
+  MAIN_THREAD_EM_ASM({
+    Module.HeifRangeReader._get($0)._release($1, $2);
+  }, reader->id, (double) start_pos, (double) end_pos);
+}
+
+/*
+ * Reads the file through the HeifRangeReader with the given id.
+ * The reader has to be kept until the context has been freed. Then, call heif_js_range_reader_free().
+ */
+static struct heif_error heif_js_context_read_from_range_reader(struct heif_context* context, int reader_id)
+{
+  static const heif_reader reader_functions = [] {
+    heif_reader functions{};
+    functions.reader_api_version = 2;
+    functions.get_position = heif_js_range_reader_get_position;
+    functions.read = heif_js_range_reader_read;
+    functions.seek = heif_js_range_reader_seek;
+    functions.wait_for_file_size = heif_js_range_reader_wait_for_file_size;
+    functions.request_range = heif_js_range_reader_request_range;
+    functions.preload_range_hint = heif_js_range_reader_preload_range_hint;
+    functions.release_file_range = heif_js_range_reader_release_file_range;
+    functions.release_error_msg = nullptr; // only static strings
+    return functions;
+  }();
+
+  double size = MAIN_THREAD_EM_ASM_DOUBLE({
+    return Module.HeifRangeReader._get($0).size;
+  }, reader_id);
+
+  auto& reader = heif_js_range_readers()[reader_id];
+  reader.reset(new heif_js_range_reader{reader_id, (uint64_t) size, 0});
+
+  return heif_context_read_from_reader(context, &reader_functions, reader.get(), nullptr);
+}
+
+static void heif_js_range_reader_free(int reader_id)
+{
+  heif_js_range_readers().erase(reader_id);
+}
+
+
 #define EXPORT_HEIF_FUNCTION(name) \
   emscripten::function(#name, &name, emscripten::allow_raw_pointers())
 
@@ -310,6 +578,14 @@ EMSCRIPTEN_BINDINGS(libheif) {
     //&heif_js_decode_image, emscripten::allow_raw_pointers());
     emscripten::function("heif_js_decode_image2",
     &heif_js_decode_image2, emscripten::allow_raw_pointers());
+    emscripten::function("heif_js_decode_image_rgba",
+    &heif_js_decode_image_rgba, emscripten::allow_raw_pointers());
+    emscripten::function("heif_js_decode_image_region_rgba",
+    &heif_js_decode_image_region_rgba, emscripten::allow_raw_pointers());
+    emscripten::function("heif_js_context_read_from_range_reader",
+    &heif_js_context_read_from_range_reader, emscripten::allow_raw_pointers());
+    emscripten::function("heif_js_range_reader_free",
+    &heif_js_range_reader_free, emscripten::allow_raw_pointers());
     EXPORT_HEIF_FUNCTION(heif_image_handle_release);
     EXPORT_HEIF_FUNCTION(heif_image_handle_get_width);
     EXPORT_HEIF_FUNCTION(heif_image_handle_get_height);
@@ -156,11 +156,26 @@ struct heif_error heif_context_add_tiled_image(struct heif_context* ctx,
 enum heif_unci_compression
 {
   heif_unci_compression_off = 0,
-  //heif_unci_compression_auto = 1,
+  heif_unci_compression_auto = 1, // select the method that fits the image content best (see heif_unci_compression_selection)
   //heif_unci_compression_unknown = 2, // only used when reading unknown method from input file
   heif_unci_compression_deflate = 3,
   heif_unci_compression_zlib = 4,
-  heif_unci_compression_brotli = 5
+  heif_unci_compression_brotli = 5,
+  heif_unci_compression_zstd = 6
+};
+
+
+// Criterion for choosing the method with heif_unci_compression_auto.
+// Each tile is compressed with all available methods. Since the method is signalled once for the whole image,
+// the method with the lowest cost summed over all tiles is used. With deflate, tiles that do not compress well
+// are stored in uncompressed deflate blocks, which are decoded with a plain copy.
+// The compressed tiles are kept in memory until the file is written.
+enum heif_unci_compression_selection
+{
+  heif_unci_compression_selection_smallest_size = 0,
+
+  // Trade file size for decoding speed, based on a rough estimate of the decompression speed of each method.
+  heif_unci_compression_selection_decoding_speed = 1
 };
 
 
@@ -177,6 +192,10 @@ struct heif_unci_image_parameters {
 
   enum heif_unci_compression compression; // TODO
 
+  // --- version 2
+
+  enum heif_unci_compression_selection compression_selection;
+
   // TODO: interleave type, padding
 };
 
@@ -206,6 +225,20 @@ struct heif_error heif_context_add_pyramid_entity_group(struct heif_context* ctx
                                                         size_t num_layers,
                                                         heif_item_id* out_group_id);
 
+// Encodes the image as a multi-resolution pyramid. The downscaled layers are generated with the area filter.
+// Each layer has half the size of the previous one, down to the first layer that fits into a single tile.
+// Layers larger than one tile are encoded as grid images with the given tile size, the smaller layers are hidden.
+// All layers are put into a 'pymd' entity group, whose ID is returned in 'out_group_id'.
+// 'out_image_handle' returns the full resolution layer. It becomes the primary image if none has been set yet.
+LIBHEIF_API
+struct heif_error heif_context_encode_pyramid(struct heif_context* ctx,
+                                              const struct heif_image* image,
+                                              uint32_t tile_width, uint32_t tile_height,
+                                              struct heif_encoder* encoder,
+                                              const struct heif_encoding_options* options,
+                                              struct heif_image_handle** out_image_handle,
+                                              heif_entity_group_id* out_group_id);
+
 LIBHEIF_API
 struct heif_pyramid_layer_info* heif_context_get_pyramid_entity_group_info(struct heif_context*, heif_entity_group_id id, int* out_num_layers);
 
@@ -356,6 +389,98 @@ struct heif_complex64* heif_image_get_channel_complex64(struct heif_image*,
 #endif
 
 
+// --- GPU surface output
+
+// Decoders that decode in hardware can output their images as GPU surfaces instead of copying them into
+// the heif_image planes. This saves the download into system memory and the upload for rendering.
+
+enum heif_gpu_surface_type
+{
+  heif_gpu_surface_type_DMA_BUF = 1,        // Linux (VAAPI)
+  heif_gpu_surface_type_CVPixelBuffer = 2,  // macOS, iOS (VideoToolbox)
+  heif_gpu_surface_type_D3D11_texture = 3   // Windows (D3D11VA)
+};
+
+struct heif_gpu_surface_dma_buf_plane
+{
+  int fd;
+  uint64_t offset;
+  uint32_t pitch;
+  uint64_t format_modifier;  // DRM format modifier of the buffer object
+};
+
+// One layer with a DRM fourcc format, e.g. NV12 as one layer or as an R8 + GR88 layer pair.
+struct heif_gpu_surface_dma_buf_layer
+{
+  uint32_t drm_format;
+  int num_planes;
+  struct heif_gpu_surface_dma_buf_plane planes[4];
+};
+
+struct heif_gpu_surface
+{
+  int version;  // currently 1
+
+  enum heif_gpu_surface_type type;
+
+  // Size of the surface in luma samples and the format of the decoded image.
+  uint32_t width;
+  uint32_t height;
+  enum heif_chroma chroma;
+  int bits_per_pixel;
+
+  // --- heif_gpu_surface_type_DMA_BUF
+
+  int num_layers;
+  struct heif_gpu_surface_dma_buf_layer layers[4];
+
+  // --- heif_gpu_surface_type_CVPixelBuffer: the CVPixelBufferRef
+  // --- heif_gpu_surface_type_D3D11_texture: the ID3D11Texture2D* and the index into the texture array
+
+  void* native_handle;
+  uint32_t texture_array_index;
+
+  // Set by the decoder plugin. Frees the surface and its handles.
+  void (*release)(void* release_data);
+  void* release_data;
+};
+
+struct heif_gpu_surface_tile
+{
+  // Position of the surface in the coded image, in luma samples.
+  uint32_t x;
+  uint32_t y;
+
+  struct heif_gpu_surface surface;
+};
+
+struct heif_gpu_surfaces;
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+// Decodes the image into GPU surfaces of the given type. Coded images give one surface, grid images one
+// surface per tile, placed at its position in the grid. Tiles at the right and bottom border may extend
+// beyond the image. The surfaces show the coded image: crop them to heif_image_handle_get_ispe_width/height()
+// and apply the transformations (irot, imir, clap) when rendering. The alpha channel is not decoded.
+// Returns heif_error_Unsupported_feature if the decoder plugin cannot output this surface type, e.g. because
+// the image was decoded in software. Decode with heif_decode_image() in this case.
+LIBHEIF_API
+struct heif_error heif_image_handle_decode_to_gpu_surfaces(const struct heif_image_handle* handle,
+                                                          enum heif_gpu_surface_type type,
+                                                          const struct heif_decoding_options* options,
+                                                          struct heif_gpu_surfaces** out_surfaces);
+
+LIBHEIF_API
+int heif_gpu_surfaces_get_number_of_tiles(const struct heif_gpu_surfaces*);
+
+// The returned tile is valid until the surfaces are released.
+LIBHEIF_API
+const struct heif_gpu_surface_tile* heif_gpu_surfaces_get_tile(const struct heif_gpu_surfaces*, int index);
+
+// Releases all surfaces.
+LIBHEIF_API
+void heif_gpu_surfaces_release(struct heif_gpu_surfaces*);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
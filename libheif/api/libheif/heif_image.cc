@@ -23,6 +23,7 @@
 #include <cstdint>
 #include "heif.h"
 #include "pixelimage.h"
+#include "image_scaling.h"
 #include "api_structs.h"
 #include "error.h"
 #include "init.h"
@@ -103,6 +104,17 @@ int heif_image_get_decoding_warnings(struct heif_image* image,
   }
 }
 
+int heif_image_get_decoding_scale_denominator(const struct heif_image* image)
+{
+  return image->image->get_decoding_scale_denominator();
+}
+
+
+heif_decoding_fallback heif_image_get_decoding_fallback(const struct heif_image* image)
+{
+  return image->image->get_decoding_fallback();
+}
+
 void heif_image_add_decoding_warning(struct heif_image* image,
                                      struct heif_error err)
 {
@@ -247,6 +259,52 @@ struct heif_error heif_image_add_plane(struct heif_image* image,
 }
 
 
+// Calls the release callback of an external plane when the last image using it is released.
+struct ExternalPlaneRelease
+{
+  void (*release_callback)(uint8_t* data, void* userdata);
+  void* userdata;
+  bool active = true;
+
+  void operator()(void* data) const
+  {
+    if (active) {
+      release_callback(static_cast<uint8_t*>(data), userdata);
+    }
+  }
+};
+
+
+struct heif_error heif_image_add_plane_external(struct heif_image* image,
+                                                heif_channel channel,
+                                                int width, int height, int bit_depth,
+                                                uint8_t* data, size_t stride,
+                                                void (*release_callback)(uint8_t* data, void* userdata),
+                                                void* userdata)
+{
+  if (width <= 0 || height <= 0) {
+    return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "heif_image_add_plane_external: invalid plane size."};
+  }
+
+  std::shared_ptr<void> memory_owner;
+  if (release_callback) {
+    memory_owner = std::shared_ptr<void>(data, ExternalPlaneRelease{release_callback, userdata});
+  }
+
+  if (auto err = image->image->add_external_plane(channel, width, height, bit_depth, data, stride, memory_owner)) {
+    // The caller keeps the ownership of the memory when the plane could not be added.
+    if (memory_owner) {
+      std::get_deleter<ExternalPlaneRelease>(memory_owner)->active = false;
+    }
+
+    return err.error_struct(image->image.get());
+  }
+  else {
+    return heif_error_success;
+  }
+}
+
+
 struct heif_error heif_image_add_channel(struct heif_image* image,
                                          enum heif_channel channel,
                                          int width, int height,
@@ -467,14 +525,44 @@ struct heif_error heif_image_extend_padding_to_size(struct heif_image* image, in
 }
 
 
+struct heif_scaling_options* heif_scaling_options_alloc()
+{
+  auto* options = new heif_scaling_options;
+  options->version = 1;
+  options->filter = heif_scaling_filter_area;
+  options->max_threads = 1;
+
+  return options;
+}
+
+
+void heif_scaling_options_free(struct heif_scaling_options* options)
+{
+  delete options;
+}
+
+
 struct heif_error heif_image_scale_image(const struct heif_image* input,
                                          struct heif_image** output,
                                          int width, int height,
                                          const struct heif_scaling_options* options)
 {
+  if (width <= 0 || height <= 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Scaled image size must be positive"};
+  }
+
+  heif_scaling_filter filter = heif_scaling_filter_nearest_neighbor;
+  int max_threads = 1;
+  if (options && options->version >= 1) {
+    filter = options->filter;
+    max_threads = options->max_threads;
+  }
+
   std::shared_ptr<HeifPixelImage> out_img;
 
-  Error err = input->image->scale_nearest_neighbor(out_img, width, height, nullptr);
+  Error err = scale_image(*input->image, out_img, width, height, filter, max_threads, nullptr);
   if (err) {
     return err.error_struct(input->image.get());
   }
@@ -644,3 +732,25 @@ struct heif_error heif_image_extract_area(const heif_image* srcimg,
 
   return heif_error_success;
 }
+
+
+struct heif_error heif_image_create_view(const heif_image* src_image,
+                                         uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                                         struct heif_image** out_image)
+{
+  if (out_image == nullptr) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "heif_image_create_view: NULL passed as image pointer."};
+  }
+
+  auto viewResult = src_image->image->create_view(x0, y0, w, h);
+  if (viewResult.error) {
+    return viewResult.error.error_struct(src_image->image.get());
+  }
+
+  heif_image* view = new heif_image;
+  view->image = viewResult.value;
+
+  *out_image = view;
+
+  return heif_error_success;
+}
@@ -168,6 +168,28 @@ struct heif_error heif_image_extract_area(const struct heif_image*,
                                           const struct heif_security_limits* limits,
                                           struct heif_image** out_image);
 
+/**
+ * Create an image that references an area of another image without copying the pixel data.
+ *
+ * The view shares the plane memory with `src_image`. Writing into the planes of the view changes
+ * `src_image` and vice versa. The memory stays valid until both images have been released.
+ * The area must lie completely inside the image and its top-left corner must be at a position where
+ * all planes can start without copying (a multiple of the chroma subsampling, and with the plane start
+ * keeping the memory alignment). Otherwise, `heif_error_Usage_error` is returned and
+ * heif_image_extract_area() can be used instead.
+ *
+ * @param src_image the image that owns the pixel data
+ * @param x0 left border of the area
+ * @param y0 top border of the area
+ * @param w width of the area
+ * @param h height of the area
+ * @param out_image the view. Release it with heif_image_release().
+ */
+LIBHEIF_API
+struct heif_error heif_image_create_view(const struct heif_image* src_image,
+                                         uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                                         struct heif_image** out_image);
+
 // Get the number of bits per pixel in the given image channel. Returns -1 if
 // a non-existing channel was given.
 // Note that the number of bits per pixel may be different for each color channel.
@@ -221,9 +243,40 @@ uint8_t* heif_image_get_plane2(struct heif_image*,
 
 
 
-struct heif_scaling_options;
+enum heif_scaling_filter
+{
+  heif_scaling_filter_nearest_neighbor = 0,
+
+  // Average of all input pixels that are covered by an output pixel. Good for downscaling by large factors.
+  heif_scaling_filter_area = 1,
+
+  // Sharper than the area filter, but may show slight ringing at strong edges.
+  heif_scaling_filter_lanczos3 = 2
+};
+
+struct heif_scaling_options
+{
+  uint8_t version;
+
+  // --- version 1 options
+
+  // Default for heif_scaling_options_alloc(): heif_scaling_filter_area
+  enum heif_scaling_filter filter;
+
+  // Maximum number of threads that may be used to scale the image (in bands of rows).
+  // Values <= 1 scale the image in the calling thread. The nearest-neighbor filter is always single-threaded.
+  // Default for heif_scaling_options_alloc(): 1
+  int max_threads;
+};
 
-// Currently, heif_scaling_options is not defined yet. Pass a NULL pointer.
+LIBHEIF_API
+struct heif_scaling_options* heif_scaling_options_alloc(void);
+
+LIBHEIF_API
+void heif_scaling_options_free(struct heif_scaling_options*);
+
+// Scales all planes of the image. Subsampled chroma planes are scaled at their own resolution.
+// When 'options' is NULL, the nearest-neighbor filter is used.
 LIBHEIF_API
 struct heif_error heif_image_scale_image(const struct heif_image* input,
                                          struct heif_image** output,
@@ -247,6 +300,33 @@ int heif_image_get_decoding_warnings(struct heif_image* image,
                                      struct heif_error* out_warnings,
                                      int max_output_buffer_entries);
 
+// Returns the factor by which the image was reduced in size by the decoder, as requested
+// with heif_decoding_options.target_scale_denominator. Returns 1 for images decoded at full resolution.
+LIBHEIF_API
+int heif_image_get_decoding_scale_denominator(const struct heif_image* image);
+
+enum heif_decoding_fallback
+{
+  heif_decoding_fallback_none = 0,
+
+  // A smaller layer of the 'pymd' pyramid group that contains the image was decoded.
+  heif_decoding_fallback_pyramid_layer = 1,
+
+  // A thumbnail of the image was decoded.
+  heif_decoding_fallback_thumbnail = 2,
+
+  // The image was decoded at a reduced resolution (see heif_image_get_decoding_scale_denominator()).
+  heif_decoding_fallback_reduced_resolution = 3,
+
+  // The deadline passed while the grid tiles were decoded. The area of the missing tiles is black.
+  heif_decoding_fallback_partial_image = 4
+};
+
+// Returns which cheaper representation was decoded to meet heif_decoding_options.deadline_us.
+// Returns heif_decoding_fallback_none if the full image was decoded.
+LIBHEIF_API
+enum heif_decoding_fallback heif_image_get_decoding_fallback(const struct heif_image* image);
+
 // This function is only for decoder plugin implementors.
 LIBHEIF_API
 void heif_image_add_decoding_warning(struct heif_image* image,
@@ -321,6 +401,37 @@ struct heif_error heif_image_add_plane(struct heif_image* image,
                                        enum heif_channel channel,
                                        int width, int height, int bit_depth);
 
+/**
+ * Add an image plane that uses memory of the caller instead of allocating new memory.
+ *
+ * <p>The pixel data is not copied. It is encoded directly when the encoder accepts the image format.
+ * The memory has to stay valid until {@code release_callback} is called, which happens when the last
+ * image referencing the plane is released. Pass NULL as {@code release_callback} if you keep the memory
+ * alive yourself for the lifetime of the image.
+ *
+ * <p>libheif may read and write the pixel data, but never accesses memory outside of
+ * {@code height} rows of {@code width} pixels. Operations that need more memory (like padding the
+ * image for an encoder) work on a copy of the plane.
+ *
+ * @param image the parent image to add the channel plane to
+ * @param channel the channel of the plane to add
+ * @param width the width of the plane
+ * @param height the height of the plane
+ * @param bit_depth the bit depth per color channel (see {@link heif_image_add_plane})
+ * @param data the first pixel of the plane
+ * @param stride the number of bytes between the starts of two rows
+ * @param release_callback called with {@code data} and {@code userdata} when the plane is no longer used. May be NULL.
+ * @param userdata passed to {@code release_callback}
+ * @return whether the addition succeeded or there was an error. In case of an error, {@code release_callback} is not called.
+ */
+LIBHEIF_API
+struct heif_error heif_image_add_plane_external(struct heif_image* image,
+                                                enum heif_channel channel,
+                                                int width, int height, int bit_depth,
+                                                uint8_t* data, size_t stride,
+                                                void (*release_callback)(uint8_t* data, void* userdata),
+                                                void* userdata);
+
 // Signal that the image is premultiplied by the alpha pixel values.
 LIBHEIF_API
 void heif_image_set_premultiplied_alpha(struct heif_image* image,
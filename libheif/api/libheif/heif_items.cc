@@ -167,6 +167,30 @@ void heif_release_item_data(const struct heif_context* ctx, uint8_t** item_data)
 }
 
 
+struct heif_error heif_item_get_item_data_borrowed(const struct heif_context* ctx,
+                                                   heif_item_id item_id,
+                                                   heif_metadata_compression* out_compression_format,
+                                                   const uint8_t** out_data, size_t* out_data_size)
+{
+  if (!out_data || !out_data_size) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "out_data and out_data_size may not be NULL"};
+  }
+
+  auto dataResult = ctx->context->get_borrowed_item_data(item_id, out_compression_format);
+  if (dataResult.error) {
+    *out_data = nullptr;
+    *out_data_size = 0;
+
+    return dataResult.error.error_struct(ctx->context.get());
+  }
+
+  *out_data = dataResult.value.data();
+  *out_data_size = dataResult.value.size();
+
+  return heif_error_success;
+}
+
+
 
 size_t heif_context_get_item_references(const struct heif_context* ctx,
                                         heif_item_id from_item_id,
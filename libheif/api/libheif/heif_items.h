@@ -166,6 +166,28 @@ struct heif_error heif_item_get_item_data(const struct heif_context* ctx,
 LIBHEIF_API
 void heif_release_item_data(const struct heif_context* ctx, uint8_t** item_data);
 
+/**
+ * Gets the item data without copying it.
+ *
+ * This works like {@link heif_item_get_item_data}, but returns a pointer to the data instead of a copy.
+ * When the file is held in memory (or memory-mapped) and the data is stored in one range, the pointer references
+ * the file data directly. Otherwise (e.g. if the data has to be decompressed), the data is copied once and the
+ * copy is kept by the context.
+ * The data remains valid until the context is freed. It must not be modified or released.
+ *
+ * @param ctx the file context
+ * @param item_id the item identifier for the item
+ * @param out_compression_format how the data is compressed. If the pointer is NULL, the decompressed data will be returned.
+ * @param out_data the corresponding raw metadata
+ * @param out_data_size the size of the metadata in bytes
+ * @return whether the call succeeded, or there was an error
+ */
+LIBHEIF_API
+struct heif_error heif_item_get_item_data_borrowed(const struct heif_context* ctx,
+                                                   heif_item_id item_id,
+                                                   enum heif_metadata_compression* out_compression_format,
+                                                   const uint8_t** out_data, size_t* out_data_size);
+
 
 // ------------------------- item references -------------------------
 
@@ -82,7 +82,7 @@ struct heif_error heif_register_decoder_plugin(const heif_decoder_plugin* decode
   if (!decoder_plugin) {
     return error_null_parameter;
   }
-  else if (decoder_plugin->plugin_api_version > 3) {
+  else if (decoder_plugin->plugin_api_version > 4) {
     return error_unsupported_plugin_version;
   }
 
@@ -95,7 +95,7 @@ struct heif_error heif_register_encoder_plugin(const heif_encoder_plugin* encode
   if (!encoder_plugin) {
     return error_null_parameter;
   }
-  else if (encoder_plugin->plugin_api_version > 3) {
+  else if (encoder_plugin->plugin_api_version > 4) {
     return error_unsupported_plugin_version;
   }
 
@@ -26,7 +26,9 @@ extern "C" {
 #endif
 
 #include <libheif/heif.h>
+#include <libheif/heif_sequences.h>
 
+struct heif_gpu_surface;
 
 // ====================================================================================================
 //  This file is for codec plugin developers only.
@@ -42,6 +44,7 @@ extern "C" {
 //  1.8          1         2          2
 //  1.13         2         3          2
 //  1.15         3         3          2
+//  1.20         4         4          2
 
 
 // ====================================================================================================
@@ -101,14 +104,116 @@ struct heif_decoder_plugin
 
   */
 
-  // Reset decoder, such that we can feed in new data for another image.
-  // void (*reset_image)(void* decoder);
-
   // --- version 3 functions will follow below ... ---
 
   const char* id_name;
 
   // --- version 4 functions will follow below ... ---
+
+  // Asks the decoder to output the image at reduced resolution, with the width and height divided by
+  // 'denominator' (1, 2, 4 or 8) and rounded up. This is a hint: the decoder may use a smaller denominator,
+  // down to full resolution, if the bitstream does not allow it.
+  // It is called before the data is pushed into the decoder. May be NULL.
+  void (*set_target_scale_denominator)(void* decoder, int denominator);
+
+  // Decode the image directly into the planes of 'target' instead of allocating a new image.
+  // This saves copying the image when it is only a part of a larger image, e.g. a grid tile.
+  // The decoded image is placed with its top-left corner at (x0,y0), given in luma samples.
+  // The offset is always a multiple of the chroma subsampling factors. Parts of the image that extend
+  // beyond the target image are discarded. The nclx profile of the decoded image is not used.
+  // If the colorspace, chroma format or bit depth of the decoded image does not match the target,
+  // return heif_error_Unsupported_feature / heif_suberror_Unsupported_color_conversion without
+  // writing into the target. libheif will then decode the image again with decode_image().
+  // May be NULL.
+  struct heif_error (*decode_image_into)(void* decoder, struct heif_image* target, uint32_t x0, uint32_t y0);
+
+  // Reset the decoder, such that new data for another image can be pushed into it.
+  // Afterwards, the decoder has to be in the same state as after new_decoder(). This includes the settings
+  // made with set_strict_decoding(), set_target_scale_denominator(), set_decode_area(), set_progressive_decoding()
+  // and set_low_latency_decoding().
+  // libheif will set them again.
+  // libheif keeps decoders for reuse, when decoding many images with the same decoder configuration (e.g. grid tiles).
+  // This saves the decoder setup time. It may be called after a decode function returned an error.
+  // If the decoder cannot be reset, return an error and libheif will free it.
+  // May be NULL, then decoders are not reused.
+  struct heif_error (*reset_decoder)(void* decoder);
+
+  // Set the maximum number of threads that the decoder may use internally. libheif calls this before the
+  // data is pushed into the decoder, also after reset_decoder(). The number of threads is not reset by
+  // reset_decoder(), because restarting the decoder threads for each image would defeat decoder reuse.
+  // May be NULL.
+  struct heif_error (*set_num_threads)(void* decoder, int num_threads);
+
+  // Decode the image into a GPU surface of the given type (enum heif_gpu_surface_type, see heif_experimental.h)
+  // instead of downloading it into a heif_image. The surface has to stay valid after the decoder was freed,
+  // until libheif calls out_surface->release.
+  // Return heif_error_Unsupported_feature when the image cannot be output as this surface type.
+  // May be NULL.
+  struct heif_error (*decode_image_to_gpu_surface)(void* decoder, int surface_type, struct heif_gpu_surface* out_surface);
+
+  // Asks the decoder to decode only the area of width x height samples with its top-left corner at (x0,y0).
+  // The area is given in luma samples of the full-resolution image. The decoded image has the size of the area.
+  // Decoders can use this to skip the parts of the bitstream that do not intersect with the area (e.g. codec-internal tiles).
+  // It is called before the data is pushed into the decoder.
+  // Return heif_error_Unsupported_feature if the area cannot be decoded. libheif will then decode the whole image.
+  // May be NULL.
+  struct heif_error (*set_decode_area)(void* decoder, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height);
+
+  // Progressive decoding: decode at most 'max_quality_layers' quality layers (0 = all layers).
+  // If 'data_is_truncated' is set, only the beginning of the coded data is pushed into the decoder. The decoder
+  // should then output the image that can be reconstructed from this data instead of returning an error.
+  // It is called before the data is pushed into the decoder.
+  // May be NULL, then libheif always pushes the complete data.
+  struct heif_error (*set_progressive_decoding)(void* decoder, int max_quality_layers, int data_is_truncated);
+
+  // Decoding of image sequences with inter-frame prediction, where the samples depend on each other.
+  // The same decoder instance is used for all samples of a sequence. The configuration data (e.g. parameter
+  // sets) is passed with push_data() before the first sample. push_sequence_sample() and get_next_sequence_image()
+  // may be called alternately.
+  // If any of these functions is NULL, libheif decodes each sample independently with push_data() and decode_image().
+
+  // Pushes the coded data of one sample. The samples are pushed in decoding order.
+  // 'user_data' is returned with the image that is decoded from this sample.
+  struct heif_error (*push_sequence_sample)(void* decoder, const void* data, size_t size, uintptr_t user_data);
+
+  // Signals that no more samples follow. The decoder then outputs all images that it still holds back.
+  struct heif_error (*flush_sequence)(void* decoder);
+
+  // Returns the next image in output (presentation) order and the 'user_data' of its sample.
+  // Returns NULL in *out_img if the decoder needs more data, or when all images have been output after flush_sequence().
+  struct heif_error (*get_next_sequence_image)(void* decoder, struct heif_image** out_img, uintptr_t* out_user_data);
+
+  // Asks the decoder to output each image of a sequence as soon as it is decoded, instead of decoding several
+  // frames in parallel (see heif_decoding_options.low_latency_decoding). It is called before the data is pushed
+  // into the decoder and is reset by reset_decoder().
+  // May be NULL.
+  void (*set_low_latency_decoding)(void* decoder, int flag);
+
+  // Sets a function that the decoder calls regularly while it decodes an image, e.g. after each decoded slice,
+  // codestream tile or chunk of input data. 'progress' is the decoded fraction of the image (0 to 1),
+  // or negative if it is not known.
+  // When the function returns non-zero, the decoder should stop as soon as possible and return heif_error_Canceled
+  // from the decode function (or from push_data(), if the decoder already decodes there).
+  // The function may be called from the decoder's worker threads.
+  // It is called before the data is pushed into the decoder and is reset by reset_decoder(). libheif removes it
+  // with callback=NULL after decoding.
+  // May be NULL, then decoding can only be canceled between images.
+  void (*set_decoding_callback)(void* decoder, int (*callback)(float progress, void* callback_data), void* callback_data);
+
+  // Batch decoding of independent images (e.g. the tiles of a grid image) with one decoder instance.
+  // If any of these functions is NULL, libheif decodes each image with its own decoder instance.
+
+  // Pushes the complete coded data of one image, including its configuration data (e.g. parameter sets) that is
+  // otherwise passed with push_data(). The images do not reference each other.
+  // 'image_id' is returned with the image that is decoded from this data.
+  struct heif_error (*push_batch_image)(void* decoder, const void* data, size_t size, uintptr_t image_id);
+
+  // Called after all images of a batch have been pushed. Returns the decoded images in any order, with the
+  // 'image_id' of their data. Returns NULL in *out_img when all images of the batch have been output.
+  // Afterwards, the images of the next batch can be pushed into the same decoder instance.
+  struct heif_error (*get_next_batch_image)(void* decoder, struct heif_image** out_img, uintptr_t* out_image_id);
+
+  // --- version 5 functions will follow below ... ---
 };
 
 
@@ -230,7 +335,56 @@ struct heif_encoder_plugin
   void (* query_encoded_size)(void* encoder, uint32_t input_width, uint32_t input_height,
                               uint32_t* encoded_width, uint32_t* encoded_height);
 
-  // --- version 4 functions will follow below ... ---
+  // --- version 4 ---
+
+  // Encoding of image sequences with inter-frame prediction.
+  // Set all four functions to NULL if the plugin can only code each image independently.
+  //
+  // libheif calls start_sequence_encoding() before the first frame, then encode_sequence_frame() for each frame
+  // in presentation order, and finally end_sequence_encoding() to flush the frames still buffered in the encoder.
+  // After each of these calls, libheif fetches all frames that are ready with get_compressed_data2().
+  // The same encoder object is not used for encoding still images while a sequence is encoded.
+
+  struct heif_error (* start_sequence_encoding)(void* encoder, const struct heif_sequence_encoding_options* options);
+
+  // 'frame_number' is counted from 0 and returned with the coded frame in get_compressed_data2().
+  struct heif_error (* encode_sequence_frame)(void* encoder, const struct heif_image* image,
+                                              enum heif_image_input_class image_class,
+                                              uintptr_t frame_number);
+
+  struct heif_error (* end_sequence_encoding)(void* encoder);
+
+  // Get the coded frames in decoding order, one packet per call. The packet format is the same as in
+  // get_compressed_data(). All packets of a frame are returned consecutively, followed by a NULL data pointer.
+  // Calling the function again continues with the next frame. If no (further) frame is ready, the first call
+  // returns NULL.
+  // 'frame_number' and 'is_keyframe' have to be set for each packet. A keyframe can be decoded independently
+  // and no following frame (in decoding order) references a frame before it.
+  struct heif_error (* get_compressed_data2)(void* encoder, uint8_t** data, int* size,
+                                             uintptr_t* frame_number, int* is_keyframe,
+                                             enum heif_encoded_data_type* type);
+
+  // --- version 5 functions will follow below ... ---
+};
+
+
+// Parameters passed to start_sequence_encoding().
+struct heif_sequence_encoding_options
+{
+  int version; // current version: 1
+
+  // --- version 1 fields ---
+
+  // never heif_sequence_gop_structure_intra_only, as this does not use the sequence encoding functions
+  enum heif_sequence_gop_structure gop_structure;
+
+  // Distances between keyframes. 0 lets the encoder choose.
+  int keyframe_distance_min;
+  int keyframe_distance_max;
+
+  // Nominal frame rate (from the track timescale and the duration of the first frame).
+  uint32_t framerate_numerator;
+  uint32_t framerate_denominator;
 };
 
 
@@ -238,6 +392,17 @@ struct heif_encoder_plugin
 #define heif_encoder_parameter_name_quality  "quality"
 #define heif_encoder_parameter_name_lossless "lossless"
 
+// Number of threads that one encoder instance may use. When libheif encodes several images in parallel,
+// it sets this parameter to divide its thread budget between the encoder instances
+// (see heif_context_set_encoding_thread_budget()).
+#define heif_encoder_parameter_name_threads  "threads"
+
+// Codec-independent speed setting from 0 (slowest, best compression) to 9 (fastest), see heif_encoder_set_speed_class().
+// Encoders map it onto their own speed or preset parameter, which they overwrite. Encoders with fewer steps map
+// neighboring classes onto the same setting. Reading it returns the class of the current native setting.
+// It should be listed before the native parameter, such that copying all parameters in list order keeps the native value.
+#define heif_encoder_parameter_name_speed_class "speed-class"
+
 // For use only by the encoder plugins.
 // Application programs should use the access functions.
 // NOLINTNEXTLINE(clang-analyzer-optin.performance.Padding)
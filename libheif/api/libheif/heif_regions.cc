@@ -25,6 +25,7 @@
 #include "file.h"
 #include "api_structs.h"
 #include "context.h"
+#include "image-items/mask_image.h"
 #include <cstring>
 #include <memory>
 #include <vector>
@@ -107,7 +108,7 @@ int heif_region_item_get_list_of_regions(const struct heif_region_item* region_i
                                          struct heif_region** out_regions,
                                          int max_count)
 {
-  auto regions = region_item->region_item->get_regions();
+  const auto& regions = region_item->region_item->get_regions();
   int num = std::min(max_count, (int) regions.size());
 
   for (int i = 0; i < num; i++) {
@@ -124,6 +125,158 @@ int heif_region_item_get_list_of_regions(const struct heif_region_item* region_i
 }
 
 
+static int return_regions(const struct heif_region_item* region_item,
+                          const std::vector<int>& indices,
+                          struct heif_region** out_regions,
+                          int max_count)
+{
+  const auto& regions = region_item->region_item->get_regions();
+  int num = std::min(max_count, (int) indices.size());
+
+  for (int i = 0; i < num; i++) {
+    auto region = new heif_region();
+    region->context = region_item->context;
+    region->region_item = region_item->region_item;
+    region->region = regions[indices[i]];
+
+    out_regions[i] = region;
+  }
+
+  return num;
+}
+
+
+int heif_region_item_get_regions_in_rectangle(const struct heif_region_item* region_item,
+                                              int32_t x, int32_t y, uint32_t width, uint32_t height,
+                                              struct heif_region** out_regions,
+                                              int max_count)
+{
+  auto indices = region_item->region_item->find_regions_in_rectangle(x, y, width, height);
+  return return_regions(region_item, indices, out_regions, max_count);
+}
+
+
+static heif_error get_referenced_mask(const struct heif_region* region,
+                                      const RegionGeometry_ReferencedMask& mask,
+                                      std::shared_ptr<const HeifPixelImage>* out_mask);
+
+
+int heif_region_item_get_regions_at_point(const struct heif_region_item* region_item,
+                                          int32_t x, int32_t y,
+                                          struct heif_region** out_regions,
+                                          int max_count)
+{
+  const auto& regions = region_item->region_item->get_regions();
+
+  std::vector<int> indices;
+  for (int idx : region_item->region_item->find_regions_at_point(x, y)) {
+    auto mask = std::dynamic_pointer_cast<RegionGeometry_ReferencedMask>(regions[idx]);
+    if (mask) {
+      // Only the bounding box has been checked so far.
+      heif_region region{region_item->context, region_item->region_item, regions[idx]};
+
+      std::shared_ptr<const HeifPixelImage> mask_image;
+      if (get_referenced_mask(&region, *mask, &mask_image).code != heif_error_Ok ||
+          !RegionGeometry_ReferencedMask::mask_contains_point(mask_image, mask->get_bounding_box(), x, y)) {
+        continue;
+      }
+    }
+
+    indices.push_back(idx);
+  }
+
+  return return_regions(region_item, indices, out_regions, max_count);
+}
+
+
+int heif_region_item_get_number_of_regions_of_type(const struct heif_region_item* region_item,
+                                                   enum heif_region_type type)
+{
+  int num = 0;
+  for (const auto& region : region_item->region_item->get_regions()) {
+    if (region->getRegionType() == type) {
+      num++;
+    }
+  }
+
+  return num;
+}
+
+
+int heif_region_item_get_region_points(const struct heif_region_item* region_item,
+                                       int32_t* out_pts, int max_count)
+{
+  int num = 0;
+  for (const auto& region : region_item->region_item->get_regions()) {
+    if (num == max_count) {
+      break;
+    }
+
+    if (auto point = std::dynamic_pointer_cast<RegionGeometry_Point>(region)) {
+      out_pts[2 * num + 0] = point->x;
+      out_pts[2 * num + 1] = point->y;
+      num++;
+    }
+  }
+
+  return num;
+}
+
+
+int heif_region_item_get_region_rectangles(const struct heif_region_item* region_item,
+                                           int32_t* out_rects, int max_count)
+{
+  int num = 0;
+  for (const auto& region : region_item->region_item->get_regions()) {
+    if (num == max_count) {
+      break;
+    }
+
+    if (auto rect = std::dynamic_pointer_cast<RegionGeometry_Rectangle>(region)) {
+      out_rects[4 * num + 0] = rect->x;
+      out_rects[4 * num + 1] = rect->y;
+      out_rects[4 * num + 2] = (int32_t) std::min(rect->width, (uint32_t) INT32_MAX);
+      out_rects[4 * num + 3] = (int32_t) std::min(rect->height, (uint32_t) INT32_MAX);
+      num++;
+    }
+  }
+
+  return num;
+}
+
+
+int heif_region_item_get_region_polygons(const struct heif_region_item* region_item,
+                                         int* out_num_points_per_polygon,
+                                         int32_t* out_pts_array,
+                                         int max_count)
+{
+  int num = 0;
+  for (const auto& region : region_item->region_item->get_regions()) {
+    if (num == max_count) {
+      break;
+    }
+
+    if (region->getRegionType() != heif_region_type_polygon) {
+      continue;
+    }
+
+    const auto& points = std::static_pointer_cast<RegionGeometry_Polygon>(region)->points;
+    out_num_points_per_polygon[num] = (int) points.size();
+
+    if (out_pts_array) {
+      for (const auto& p : points) {
+        *out_pts_array++ = p.x;
+        *out_pts_array++ = p.y;
+      }
+    }
+
+    num++;
+  }
+
+  return num;
+}
+
+
 struct heif_error heif_image_handle_add_region_item(struct heif_image_handle* image_handle,
                                                     uint32_t reference_width, uint32_t reference_height,
                                                     struct heif_region_item** out_region_item)
@@ -262,6 +415,109 @@ struct heif_error heif_region_item_add_region_polyline(struct heif_region_item*
 }
 
 
+static const struct heif_error heif_error_too_many_regions = {heif_error_Usage_error,
+                                                              heif_suberror_Too_many_regions,
+                                                              "A region item cannot hold more than 255 regions"};
+
+
+static bool can_add_regions(const struct heif_region_item* item, int num)
+{
+  return num >= 0 && item->region_item->get_number_of_regions() + num <= 255;
+}
+
+
+struct heif_error heif_region_item_add_region_points(struct heif_region_item* item,
+                                                     const int32_t* pts, int num_points)
+{
+  if (!can_add_regions(item, num_points)) {
+    return heif_error_too_many_regions;
+  }
+
+  std::vector<std::shared_ptr<RegionGeometry>> regions;
+  regions.reserve(num_points);
+
+  for (int i = 0; i < num_points; i++) {
+    auto region = std::make_shared<RegionGeometry_Point>();
+    region->x = pts[2 * i + 0];
+    region->y = pts[2 * i + 1];
+    regions.emplace_back(std::move(region));
+  }
+
+  item->region_item->add_regions(regions);
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_region_item_add_region_rectangles(struct heif_region_item* item,
+                                                         const int32_t* rects, int num_rectangles)
+{
+  if (!can_add_regions(item, num_rectangles)) {
+    return heif_error_too_many_regions;
+  }
+
+  for (int i = 0; i < num_rectangles; i++) {
+    if (rects[4 * i + 2] < 0 || rects[4 * i + 3] < 0) {
+      return heif_error_invalid_parameter_value;
+    }
+  }
+
+  std::vector<std::shared_ptr<RegionGeometry>> regions;
+  regions.reserve(num_rectangles);
+
+  for (int i = 0; i < num_rectangles; i++) {
+    auto region = std::make_shared<RegionGeometry_Rectangle>();
+    region->x = rects[4 * i + 0];
+    region->y = rects[4 * i + 1];
+    region->width = (uint32_t) rects[4 * i + 2];
+    region->height = (uint32_t) rects[4 * i + 3];
+    regions.emplace_back(std::move(region));
+  }
+
+  item->region_item->add_regions(regions);
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_region_item_add_region_polygons(struct heif_region_item* item,
+                                                       const int32_t* pts_array,
+                                                       const int* num_points_per_polygon,
+                                                       int num_polygons)
+{
+  if (!can_add_regions(item, num_polygons)) {
+    return heif_error_too_many_regions;
+  }
+
+  for (int i = 0; i < num_polygons; i++) {
+    if (num_points_per_polygon[i] < 0) {
+      return heif_error_invalid_parameter_value;
+    }
+  }
+
+  std::vector<std::shared_ptr<RegionGeometry>> regions;
+  regions.reserve(num_polygons);
+
+  const int32_t* pts = pts_array;
+  for (int i = 0; i < num_polygons; i++) {
+    auto region = std::make_shared<RegionGeometry_Polygon>();
+    region->points.resize(num_points_per_polygon[i]);
+
+    for (auto& p : region->points) {
+      p.x = *pts++;
+      p.y = *pts++;
+    }
+
+    region->closed = true;
+    regions.emplace_back(std::move(region));
+  }
+
+  item->region_item->add_regions(regions);
+
+  return heif_error_success;
+}
+
+
 struct heif_error heif_region_item_add_region_referenced_mask(struct heif_region_item* item,
                                                               int32_t x, int32_t y,
                                                               uint32_t width, uint32_t height,
@@ -338,15 +594,11 @@ struct heif_error heif_region_item_add_region_inline_mask(struct heif_region_ite
   uint32_t mask_width = mask_image->image->get_width();
   size_t stride;
   uint8_t* p = heif_image_get_plane2(mask_image, heif_channel_Y, &stride);
-  uint64_t pixel_index = 0;
 
-  for (uint32_t y = 0; y < mask_height; y++) {
-    for (uint32_t x = 0; x < mask_width; x++) {
-      uint8_t mask_bit = p[y * stride + x] & 0x80; // use high-order bit of the 8-bit mask value as binary mask value
-      region->mask_data.data()[pixel_index/8] |= uint8_t(mask_bit >> (pixel_index % 8));
-
-      pixel_index++;
-    }
+  // use high-order bit of the 8-bit mask value as binary mask value
+  for (uint32_t y = 0; y < std::min(mask_height, height); y++) {
+    pack_mask_bits(p + y * stride, std::min(mask_width, width), 0x80,
+                   region->mask_data.data(), (uint64_t) y * width);
   }
 
   item->region_item->add_region(region);
@@ -675,19 +927,10 @@ static struct heif_error heif_region_get_inline_mask_image(const struct heif_reg
     }
     size_t stride;
     uint8_t* p = heif_image_get_plane2(*out_mask_image, heif_channel_Y, &stride);
-    uint64_t pixel_index = 0;
 
     for (uint32_t y = 0; y < height; y++)
     {
-      for (uint32_t x = 0; x < width; x++)
-      {
-        uint64_t mask_byte = pixel_index / 8;
-        uint8_t pixel_bit = uint8_t(0x80U >> (pixel_index % 8));
-
-        p[y * stride + x] = (mask_data[mask_byte] & pixel_bit) ? 255 : 0;
-
-        pixel_index++;
-      }
+      unpack_mask_bits(mask_data, (uint64_t) y * width, p + y * stride, width);
     }
     return heif_error_success;
   }
@@ -710,22 +953,81 @@ struct heif_error heif_region_get_mask_image(const struct heif_region* region,
       return err;
     }
 
-    heif_context ctx;
-    ctx.context = region->context;
+    auto mask = std::dynamic_pointer_cast<RegionGeometry_ReferencedMask>(region->region);
 
-    heif_image_handle* mski_handle_in;
-    err = heif_context_get_image_handle(&ctx, referenced_item_id, &mski_handle_in);
+    std::shared_ptr<const HeifPixelImage> cached_mask;
+    err = get_referenced_mask(region, *mask, &cached_mask);
     if (err.code != heif_error_Ok) {
-      assert(mski_handle_in == nullptr);
       return err;
     }
 
-    err = heif_decode_image(mski_handle_in, mask_image, heif_colorspace_monochrome, heif_chroma_monochrome, NULL);
+    // Return a copy, because the caller may modify the image.
+    auto image = std::make_shared<HeifPixelImage>();
+    image->create(cached_mask->get_width(), cached_mask->get_height(), heif_colorspace_monochrome, heif_chroma_monochrome);
+    Error copy_err = image->copy_new_plane_from(cached_mask, heif_channel_Y, heif_channel_Y,
+                                                region->context->get_security_limits());
+    if (copy_err) {
+      return copy_err.error_struct(region->context.get());
+    }
 
-    heif_image_handle_release(mski_handle_in);
+    *mask_image = new heif_image;
+    (*mask_image)->image = std::move(image);
 
-    return err;
+    return heif_error_success;
   }
 
   return heif_error_invalid_parameter_value;
 }
+
+
+struct heif_error heif_image_handle_decode_mask_bitset(const struct heif_image_handle* mask_handle,
+                                                       uint8_t* out_bits, size_t out_stride)
+{
+  auto mask = std::dynamic_pointer_cast<ImageItem_mask>(mask_handle->image);
+  if (!mask || !out_bits || out_stride < (mask->get_width() + 7) / 8) {
+    return heif_error_invalid_parameter_value;
+  }
+
+  Error err = mask->decode_bitset(out_bits, out_stride);
+  if (err) {
+    return err.error_struct(mask_handle->image.get());
+  }
+
+  return heif_error_success;
+}
+
+
+static heif_error get_referenced_mask(const struct heif_region* region,
+                                      const RegionGeometry_ReferencedMask& mask,
+                                      std::shared_ptr<const HeifPixelImage>* out_mask)
+{
+  if (auto cached = mask.get_cached_mask()) {
+    *out_mask = std::move(cached);
+    return heif_error_success;
+  }
+
+  heif_context ctx;
+  ctx.context = region->context;
+
+  heif_image_handle* mski_handle_in;
+  heif_error err = heif_context_get_image_handle(&ctx, mask.referenced_item, &mski_handle_in);
+  if (err.code != heif_error_Ok) {
+    assert(mski_handle_in == nullptr);
+    return err;
+  }
+
+  heif_image* decoded_mask;
+  err = heif_decode_image(mski_handle_in, &decoded_mask, heif_colorspace_monochrome, heif_chroma_monochrome, NULL);
+
+  heif_image_handle_release(mski_handle_in);
+
+  if (err.code != heif_error_Ok) {
+    return err;
+  }
+
+  mask.set_cached_mask(decoded_mask->image);
+  *out_mask = decoded_mask->image;
+  heif_image_release(decoded_mask);
+
+  return heif_error_success;
+}
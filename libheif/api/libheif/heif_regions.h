@@ -238,6 +238,117 @@ int heif_region_item_get_list_of_regions(const struct heif_region_item* region_i
                                          struct heif_region** out_regions_array,
                                          int max_count);
 
+/**
+ * Get the regions of a region item whose bounding box intersects a rectangle.
+ *
+ * The rectangle is given in the reference coordinate system of the region item (see heif_region_item_get_reference_size()).
+ * The regions are returned in the same order as by heif_region_item_get_list_of_regions().
+ * A spatial index is built on the first query, so that repeated queries (e.g. for a viewport) do not check all regions.
+ *
+ * Caller is responsible for releasing the returned `heif_region` objects, see heif_region_item_get_list_of_regions().
+ *
+ * @param region_item the region_item to query
+ * @param x the X coordinate of the top left corner of the rectangle
+ * @param y the Y coordinate of the top left corner of the rectangle
+ * @param width the width of the rectangle
+ * @param height the height of the rectangle
+ * @param out_regions_array array to put the region pointers into
+ * @param max_count the maximum number of regions, which needs to correspond to the size of the out_regions_array.
+ * Use heif_region_item_get_number_of_regions() to get an upper bound.
+ * @return the number of regions that were returned.
+ */
+LIBHEIF_API
+int heif_region_item_get_regions_in_rectangle(const struct heif_region_item* region_item,
+                                              int32_t x, int32_t y, uint32_t width, uint32_t height,
+                                              struct heif_region** out_regions_array,
+                                              int max_count);
+
+/**
+ * Get the regions of a region item that contain a point.
+ *
+ * The point is given in the reference coordinate system of the region item.
+ * Ellipses, polygons and masks are tested exactly. A polyline contains the points on its segments.
+ * Referenced mask images are decoded on the first query and then kept in memory.
+ *
+ * Caller is responsible for releasing the returned `heif_region` objects, see heif_region_item_get_list_of_regions().
+ *
+ * @param region_item the region_item to query
+ * @param x the X coordinate of the point
+ * @param y the Y coordinate of the point
+ * @param out_regions_array array to put the region pointers into
+ * @param max_count the maximum number of regions, which needs to correspond to the size of the out_regions_array.
+ * @return the number of regions that were returned.
+ */
+LIBHEIF_API
+int heif_region_item_get_regions_at_point(const struct heif_region_item* region_item,
+                                          int32_t x, int32_t y,
+                                          struct heif_region** out_regions_array,
+                                          int max_count);
+
+/**
+ * Get the number of regions of a given type within a region item.
+ *
+ * This can be used to size the arrays for heif_region_item_get_region_points(),
+ * heif_region_item_get_region_rectangles() and heif_region_item_get_region_polygons().
+ *
+ * @param region_item the region item to query.
+ * @param type the region type to count
+ * @return the number of regions of this type
+ */
+LIBHEIF_API
+int heif_region_item_get_number_of_regions_of_type(const struct heif_region_item* region_item,
+                                                   enum heif_region_type type);
+
+/**
+ * Get all point regions of a region item as one flat array.
+ *
+ * The points are written in X,Y order, in the same order as the regions are returned by heif_region_item_get_list_of_regions().
+ * Unlike heif_region_item_get_list_of_regions(), no `heif_region` objects are created, so there is nothing to release.
+ *
+ * @param region_item the region item to query
+ * @param out_pts_array array with space for 2*max_count values
+ * @param max_count the maximum number of points to return
+ * @return the number of points that were returned.
+ */
+LIBHEIF_API
+int heif_region_item_get_region_points(const struct heif_region_item* region_item,
+                                       int32_t* out_pts_array, int max_count);
+
+/**
+ * Get all rectangle regions of a region item as one flat array.
+ *
+ * Each rectangle is written as four values: X, Y, width, height.
+ * Widths and heights that do not fit into an int32_t are clamped.
+ *
+ * @param region_item the region item to query
+ * @param out_rects_array array with space for 4*max_count values
+ * @param max_count the maximum number of rectangles to return
+ * @return the number of rectangles that were returned.
+ */
+LIBHEIF_API
+int heif_region_item_get_region_rectangles(const struct heif_region_item* region_item,
+                                           int32_t* out_rects_array, int max_count);
+
+/**
+ * Get all polygon regions of a region item.
+ *
+ * The number of points of each polygon is written into `out_num_points_per_polygon`.
+ * The points of all polygons are written one after the other into `out_pts_array`, in X,Y order.
+ * Call this function first with `out_pts_array` set to NULL to get the number of points,
+ * then allocate an array of twice their sum and call it again.
+ *
+ * @param region_item the region item to query
+ * @param out_num_points_per_polygon array with space for max_count values
+ * @param out_pts_array array for the points (may be NULL, see above)
+ * @param max_count the maximum number of polygons to return
+ * @return the number of polygons that were returned.
+ */
+LIBHEIF_API
+int heif_region_item_get_region_polygons(const struct heif_region_item* region_item,
+                                         int* out_num_points_per_polygon,
+                                         int32_t* out_pts_array,
+                                         int max_count);
+
 /**
  * Release a region.
  *
@@ -637,6 +748,25 @@ struct heif_error heif_region_get_mask_image(const struct heif_region* region,
                                              uint32_t* out_width, uint32_t* out_height,
                                              struct heif_image** out_mask_image);
 
+/**
+ * Decode a mask image item to a packed bitset.
+ *
+ * This is faster and uses less memory than decoding the mask to an image when only a binary mask is needed,
+ * especially for mask items with 1 bit per pixel, which are copied without unpacking.
+ * The mask item ID of a referenced mask region can be obtained with heif_region_get_referenced_mask_ID().
+ *
+ * Each row of the output starts at a byte boundary and holds one bit per pixel, most significant bit first.
+ * Masks with more than 1 bit per pixel are thresholded at half of the maximum value.
+ *
+ * @param mask_handle the handle of the mask image item (`mski`)
+ * @param out_bits the output buffer with space for `height` rows of `out_stride` bytes
+ * @param out_stride the number of bytes per output row, at least (width + 7) / 8
+ * @return heif_error_ok on success, or an error value indicating the problem on failure
+ */
+LIBHEIF_API
+struct heif_error heif_image_handle_decode_mask_bitset(const struct heif_image_handle* mask_handle,
+                                                       uint8_t* out_bits, size_t out_stride);
+
 // --- adding region items
 
 /**
@@ -757,6 +887,57 @@ struct heif_error heif_region_item_add_region_polyline(struct heif_region_item*
                                                        const int32_t* pts_array, int nPoints,
                                                        struct heif_region** out_region);
 
+/**
+ * Add several point regions to the region item at once.
+ *
+ * This is faster than calling heif_region_item_add_region_point() for each point.
+ * The points are provided as pairs of X,Y coordinates.
+ *
+ * A region item can hold at most 255 regions. If there are more, spread them over several region items.
+ *
+ * @param region_item the region item that holds the point regions
+ * @param pts_array the array of points in X,Y order
+ * @param num_points the number of points
+ * @return heif_error_ok on success, or an error indicating the problem on failure
+ */
+LIBHEIF_API
+struct heif_error heif_region_item_add_region_points(struct heif_region_item* region_item,
+                                                     const int32_t* pts_array, int num_points);
+
+/**
+ * Add several rectangle regions to the region item at once.
+ *
+ * Each rectangle is given as four values: X, Y, width, height. Width and height must not be negative.
+ * See heif_region_item_add_region_points() for the maximum number of regions.
+ *
+ * @param region_item the region item that holds the rectangle regions
+ * @param rects_array the array of rectangles
+ * @param num_rectangles the number of rectangles, not the number of elements in the array
+ * @return heif_error_ok on success, or an error indicating the problem on failure
+ */
+LIBHEIF_API
+struct heif_error heif_region_item_add_region_rectangles(struct heif_region_item* region_item,
+                                                         const int32_t* rects_array, int num_rectangles);
+
+/**
+ * Add several polygon regions to the region item at once.
+ *
+ * The points of all polygons are given one after the other in `pts_array`, in X,Y order.
+ * `num_points_per_polygon` specifies how many of these points belong to each polygon.
+ * See heif_region_item_add_region_points() for the maximum number of regions.
+ *
+ * @param region_item the region item that holds the polygon regions
+ * @param pts_array the array of points of all polygons
+ * @param num_points_per_polygon the number of points of each polygon
+ * @param num_polygons the number of polygons
+ * @return heif_error_ok on success, or an error indicating the problem on failure
+ */
+LIBHEIF_API
+struct heif_error heif_region_item_add_region_polygons(struct heif_region_item* region_item,
+                                                       const int32_t* pts_array,
+                                                       const int* num_points_per_polygon,
+                                                       int num_polygons);
+
 
 /**
  * Add a referenced mask region to the region item.
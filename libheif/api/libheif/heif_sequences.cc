@@ -25,7 +25,9 @@
 #include "sequences/track.h"
 #include "sequences/track_visual.h"
 #include "sequences/track_metadata.h"
+#include "sequences/sample_multiplexer.h"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <memory>
@@ -81,28 +83,102 @@ struct heif_error heif_track_decode_next_image(struct heif_track* track_ptr,
             "Cannot get image from non-visual track."};
   }
 
-  auto decodingResult = visual_track->decode_next_image_sample(*opts);
+  auto decodingResult = visual_track->decode_next_image(colorspace, chroma, *opts);
   if (!decodingResult) {
     return decodingResult.error.error_struct(track_ptr->context.get());
   }
 
-  std::shared_ptr<HeifPixelImage> img = *decodingResult;
+  *out_img = new heif_image();
+  (*out_img)->image = std::move(*decodingResult);
 
+  return {};
+}
 
-  // --- convert to output colorspace
 
-  auto conversion_result = track_ptr->context->convert_to_output_colorspace(img, colorspace, chroma, *opts);
-  if (conversion_result.error) {
-    return conversion_result.error.error_struct(track_ptr->context.get());
+struct heif_error heif_track_decode_sync_images(struct heif_track* track_ptr,
+                                                uint32_t sample_distance,
+                                                uint32_t max_width, uint32_t max_height,
+                                                enum heif_colorspace colorspace,
+                                                enum heif_chroma chroma,
+                                                const struct heif_decoding_options* options,
+                                                struct heif_image* out_images[],
+                                                uint32_t out_sample_indices[],
+                                                int max_images,
+                                                int* out_num_images)
+{
+  if (out_images == nullptr || out_num_images == nullptr) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "NULL argument"};
   }
-  else {
-    img = *conversion_result;
+
+  *out_num_images = 0;
+
+  if (max_images <= 0) {
+    return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "max_images must be positive"};
   }
 
-  *out_img = new heif_image();
-  (*out_img)->image = std::move(img);
+  auto visual_track = std::dynamic_pointer_cast<Track_Visual>(track_ptr->track);
+  if (!visual_track) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Cannot get image from non-visual track."};
+  }
 
-  return {};
+  heif_decoding_options default_options;
+  if (!options) {
+    fill_default_decoding_options(default_options);
+    options = &default_options;
+  }
+
+  auto decodingResult = visual_track->decode_sync_samples(sample_distance, static_cast<uint32_t>(max_images),
+                                                          max_width, max_height, colorspace, chroma, *options);
+  if (!decodingResult) {
+    return decodingResult.error.error_struct(track_ptr->context.get());
+  }
+
+  const auto& samples = *decodingResult;
+  for (size_t i = 0; i < samples.size(); i++) {
+    out_images[i] = new heif_image();
+    out_images[i]->image = samples[i].image;
+
+    if (out_sample_indices) {
+      out_sample_indices[i] = samples[i].sample_idx;
+    }
+  }
+
+  *out_num_images = static_cast<int>(samples.size());
+
+  return heif_error_success;
+}
+
+
+void heif_track_set_decoding_lookahead(struct heif_track* track_ptr, int num_frames)
+{
+  auto visual_track = std::dynamic_pointer_cast<Track_Visual>(track_ptr->track);
+  if (visual_track) {
+    visual_track->set_decoding_lookahead(static_cast<uint32_t>(std::max(num_frames, 0)));
+  }
+}
+
+
+struct heif_error heif_track_seek_to_sample(struct heif_track* track_ptr, uint32_t sample_index)
+{
+  Error err = track_ptr->track->seek_to_sample(sample_index);
+  if (err) {
+    return err.error_struct(track_ptr->context.get());
+  }
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_track_seek_to_time(struct heif_track* track_ptr, uint64_t time)
+{
+  Result<uint32_t> sampleResult = track_ptr->track->get_sample_at_time(time);
+  if (sampleResult.error) {
+    return sampleResult.error.error_struct(track_ptr->context.get());
+  }
+
+  return heif_track_seek_to_sample(track_ptr, *sampleResult);
 }
 
 
@@ -130,6 +206,39 @@ struct heif_error heif_track_get_next_raw_sequence_sample(struct heif_track* tra
 }
 
 
+struct heif_error heif_track_get_next_raw_sequence_samples(struct heif_track* track_ptr,
+                                                           uint8_t* buffer, size_t buffer_size,
+                                                           struct heif_raw_sequence_sample_info* out_infos,
+                                                           int max_samples,
+                                                           int* out_num_samples)
+{
+  if (!buffer || !out_infos || !out_num_samples) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "NULL argument"};
+  }
+
+  *out_num_samples = 0;
+
+  if (max_samples <= 0) {
+    return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "max_samples has to be positive"};
+  }
+
+  auto track = track_ptr->track;
+
+  if (track->end_of_sequence_reached()) {
+    return {heif_error_End_of_sequence, heif_suberror_Unspecified, "End of sequence"};
+  }
+
+  auto readResult = track->read_next_raw_samples(buffer, buffer_size, out_infos, static_cast<uint32_t>(max_samples));
+  if (readResult.error) {
+    return readResult.error.error_struct(track_ptr->context.get());
+  }
+
+  *out_num_samples = static_cast<int>(*readResult);
+
+  return heif_error_success;
+}
+
+
 heif_raw_sequence_sample* heif_raw_sequence_sample_alloc()
 {
   return new heif_raw_sequence_sample();
@@ -176,6 +285,80 @@ uint32_t heif_raw_sequence_sample_get_duration(const heif_raw_sequence_sample* s
   return sample->duration;
 }
 
+
+struct heif_error heif_context_create_sample_multiplexer(struct heif_context* ctx,
+                                                         const uint32_t* track_ids, int num_track_ids,
+                                                         struct heif_sample_multiplexer** out_multiplexer)
+{
+  if (!out_multiplexer || (num_track_ids > 0 && !track_ids)) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "NULL passed"};
+  }
+
+  if (num_track_ids < 0) {
+    return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Negative number of tracks"};
+  }
+
+  std::vector<uint32_t> ids;
+  if (track_ids) {
+    ids.assign(track_ids, track_ids + num_track_ids);
+  }
+  else {
+    auto idsResult = ctx->context->get_track_IDs();
+    if (idsResult.error) {
+      return idsResult.error.error_struct(ctx->context.get());
+    }
+
+    ids = *idsResult;
+  }
+
+  std::vector<std::shared_ptr<Track>> tracks;
+  for (uint32_t id : ids) {
+    auto trackResult = ctx->context->get_track(id);
+    if (trackResult.error) {
+      return trackResult.error.error_struct(ctx->context.get());
+    }
+
+    tracks.push_back(*trackResult);
+  }
+
+  auto* multiplexer = new heif_sample_multiplexer;
+  multiplexer->multiplexer = std::make_unique<SampleMultiplexer>(ctx->context->get_heif_file(), std::move(tracks));
+  multiplexer->context = ctx->context;
+
+  *out_multiplexer = multiplexer;
+
+  return heif_error_success;
+}
+
+
+struct heif_error heif_sample_multiplexer_get_next_sample(struct heif_sample_multiplexer* multiplexer,
+                                                          uint32_t* out_track_id,
+                                                          heif_raw_sequence_sample** out_sample)
+{
+  if (!out_sample) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "Output sample pointer is NULL."};
+  }
+
+  auto sampleResult = multiplexer->multiplexer->get_next_sample();
+  if (sampleResult.error) {
+    return sampleResult.error.error_struct(multiplexer->context.get());
+  }
+
+  if (out_track_id) {
+    *out_track_id = sampleResult.value.track_id;
+  }
+
+  *out_sample = sampleResult.value.sample;
+
+  return heif_error_success;
+}
+
+
+void heif_sample_multiplexer_release(struct heif_sample_multiplexer* multiplexer)
+{
+  delete multiplexer;
+}
+
 const char* heif_raw_sequence_sample_get_gimi_sample_content_id(const heif_raw_sequence_sample* sample)
 {
   char* s = new char[sample->gimi_sample_content_id.size() + 1];
@@ -211,7 +394,12 @@ void heif_raw_sequence_sample_set_tai_timestamp(struct heif_raw_sequence_sample*
 
 uint32_t heif_context_get_sequence_timescale(heif_context* ctx)
 {
-  return ctx->context->get_sequence_timescale();
+  auto timescaleResult = ctx->context->get_sequence_timescale();
+  if (timescaleResult.error) {
+    return 0;
+  }
+
+  return *timescaleResult;
 }
 
 void heif_context_set_sequence_timescale(heif_context* ctx, uint32_t timescale)
@@ -222,7 +410,12 @@ void heif_context_set_sequence_timescale(heif_context* ctx, uint32_t timescale)
 
 uint64_t heif_context_get_sequence_duration(heif_context* ctx)
 {
-  return ctx->context->get_sequence_duration();
+  auto durationResult = ctx->context->get_sequence_duration();
+  if (durationResult.error) {
+    return 0;
+  }
+
+  return *durationResult;
 }
 
 struct heif_error heif_track_get_image_resolution(heif_track* track_ptr, uint16_t* out_width, uint16_t* out_height)
@@ -357,8 +550,12 @@ size_t heif_track_find_referring_tracks(heif_track* track, uint32_t reference_ty
 
   // iterate through all tracks
 
-  auto trackIDs = track->context->get_track_IDs();
-  for (auto id : trackIDs) {
+  auto trackIDsResult = track->context->get_track_IDs();
+  if (trackIDsResult.error) {
+    return 0;
+  }
+
+  for (auto id : *trackIDsResult) {
     // a track should never reference itself
     if (id == track->track->get_id()) {
       continue;
@@ -528,6 +725,25 @@ struct heif_error heif_track_encode_sequence_image(struct heif_track* track,
 }
 
 
+struct heif_error heif_track_encode_end_of_sequence(struct heif_track* track,
+                                                    struct heif_encoder* encoder)
+{
+  auto visual_track = std::dynamic_pointer_cast<Track_Visual>(track->track);
+  if (!visual_track) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Cannot encode image for non-visual track."};
+  }
+
+  auto error = visual_track->encode_end_of_sequence(encoder);
+  if (error.error_code) {
+    return error.error_struct(track->context.get());
+  }
+
+  return heif_error_ok;
+}
+
+
 struct heif_error heif_track_add_raw_sequence_sample(struct heif_track* track,
                                                      const struct heif_raw_sequence_sample* sample)
 {
@@ -541,7 +757,12 @@ struct heif_error heif_track_add_raw_sequence_sample(struct heif_track* track,
   Track_Metadata::Metadata metadata;
   metadata.raw_metadata = sample->data;
   metadata.duration = sample->duration;
-  metadata.timestamp = sample->timestamp;
+  if (sample->timestamp) {
+    // 'metadata' takes ownership of the timestamp
+    heif_tai_timestamp_packet* timestamp = heif_tai_timestamp_packet_alloc();
+    heif_tai_timestamp_packet_copy(timestamp, sample->timestamp);
+    metadata.timestamp = timestamp;
+  }
   metadata.gimi_contentID = sample->gimi_sample_content_id;
 
   auto error = metadata_track->write_raw_metadata(metadata);
@@ -555,15 +776,22 @@ struct heif_error heif_track_add_raw_sequence_sample(struct heif_track* track,
 
 int heif_context_number_of_sequence_tracks(const struct heif_context* ctx)
 {
-  return ctx->context->get_number_of_tracks();
+  auto numTracksResult = ctx->context->get_number_of_tracks();
+  if (numTracksResult.error) {
+    return 0;
+  }
+
+  return *numTracksResult;
 }
 
 void heif_context_get_track_ids(const struct heif_context* ctx, uint32_t out_track_id_array[])
 {
-  std::vector<uint32_t> IDs;
-  IDs = ctx->context->get_track_IDs();
+  auto IDsResult = ctx->context->get_track_IDs();
+  if (IDsResult.error) {
+    return;
+  }
 
-  for (uint32_t id : IDs) {
+  for (uint32_t id : *IDsResult) {
     *out_track_id_array++ = id;
   }
 }
@@ -601,6 +829,12 @@ uint32_t heif_track_get_timescale(struct heif_track* track)
 }
 
 
+uint32_t heif_track_get_number_of_samples(struct heif_track* track)
+{
+  return track->track->get_number_of_samples();
+}
+
+
 uint32_t heif_track_get_sample_entry_type_of_first_cluster(struct heif_track* track)
 {
   return track->track->get_first_cluster_sample_entry_type();
@@ -635,6 +869,21 @@ void heif_string_release(const char* str)
 }
 
 
+struct heif_error heif_track_get_tai_timestamps(struct heif_track* track, uint32_t first_sample, uint32_t count,
+                                               uint64_t out_tai_timestamps[], uint8_t out_flags[])
+{
+  if (!out_tai_timestamps) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "NULL argument"};
+  }
+
+  if (Error err = track->track->read_tai_timestamps(first_sample, count, out_tai_timestamps, out_flags)) {
+    return err.error_struct(track->context.get());
+  }
+
+  return heif_error_success;
+}
+
+
 const struct heif_tai_clock_info* heif_track_get_tai_clock_info_of_first_cluster(struct heif_track* track)
 {
   auto first_taic = track->track->get_first_cluster_taic();
@@ -661,3 +910,65 @@ void heif_track_get_sample_aux_info_types(struct heif_track* track, struct heif_
   }
 }
 
+
+int heif_track_get_number_of_sample_grouping_types(struct heif_track* track)
+{
+  return (int)track->track->get_sample_grouping_types().size();
+}
+
+
+void heif_track_get_sample_grouping_types(struct heif_track* track, uint32_t out_grouping_types[])
+{
+  std::vector<uint32_t> types = track->track->get_sample_grouping_types();
+  std::copy(types.begin(), types.end(), out_grouping_types);
+}
+
+
+struct heif_error heif_track_get_sample_group_description_indices(struct heif_track* track, uint32_t grouping_type,
+                                                                 uint32_t first_sample, uint32_t count,
+                                                                 uint32_t out_indices[])
+{
+  if (!out_indices) {
+    return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "NULL argument"};
+  }
+
+  if (Error err = track->track->get_sample_group_description_indices(grouping_type, first_sample, count, out_indices)) {
+    return err.error_struct(track->context.get());
+  }
+
+  return heif_error_success;
+}
+
+
+size_t heif_track_get_sample_group_description_size(struct heif_track* track, uint32_t grouping_type,
+                                                    uint32_t description_index)
+{
+  auto dataResult = track->track->get_sample_group_description(grouping_type, description_index);
+  if (!dataResult) {
+    return 0;
+  }
+
+  return (*dataResult)->size();
+}
+
+
+struct heif_error heif_track_get_sample_group_description(struct heif_track* track, uint32_t grouping_type,
+                                                          uint32_t description_index, uint8_t* out_data)
+{
+  auto dataResult = track->track->get_sample_group_description(grouping_type, description_index);
+  if (!dataResult) {
+    return dataResult.error.error_struct(track->context.get());
+  }
+
+  const std::vector<uint8_t>& data = **dataResult;
+  if (!data.empty()) {
+    if (!out_data) {
+      return {heif_error_Usage_error, heif_suberror_Null_pointer_argument, "NULL argument"};
+    }
+
+    memcpy(out_data, data.data(), data.size());
+  }
+
+  return heif_error_success;
+}
+
@@ -22,6 +22,7 @@
 #define LIBHEIF_HEIF_SEQUENCES_H
 
 #include "libheif/heif.h"
+#include "libheif/heif_tai_timestamps.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -132,6 +133,12 @@ heif_track_type heif_track_get_track_handler_type(struct heif_track*);
 LIBHEIF_API
 uint32_t heif_track_get_timescale(struct heif_track*);
 
+/**
+ * Get the number of samples (frames) in the track.
+ */
+LIBHEIF_API
+uint32_t heif_track_get_number_of_samples(struct heif_track*);
+
 
 // --- reading visual tracks
 
@@ -145,6 +152,9 @@ struct heif_error heif_track_get_image_resolution(heif_track*, uint16_t* out_wid
 /**
  * Decode the next image in the passed sequence track.
  * If there is no more image in the sequence, `heif_error_End_of_sequence` is returned.
+ * The images are returned in presentation order, also when the samples are stored in a different
+ * decoding order (B-frames). Decoding such a sequence needs a decoder plugin that keeps its state
+ * between the samples.
  * The parameters `colorspace`, `chroma` and `options` are similar to heif_decode_image().
  * If you want to let libheif decide the output colorspace and chroma, set these parameters
  * to heif_colorspace_undefined / heif_chroma_undefined. Usually, libheif will return the
@@ -159,6 +169,65 @@ struct heif_error heif_track_decode_next_image(struct heif_track* track,
                                                enum heif_chroma chroma,
                                                const struct heif_decoding_options* options);
 
+/**
+ * Let heif_track_decode_next_image() decode up to `num_frames` images ahead in the background.
+ * While the application processes an image, the next images are decoded and converted to the colorspace
+ * and chroma requested in the last heif_track_decode_next_image() call. Calling it with different
+ * parameters is still possible, but the images decoded ahead will then have to be converted again.
+ * The progress and cancel callbacks of the decoding options are not used for the images decoded ahead.
+ * Set `num_frames` to 0 (default) to decode each image in heif_track_decode_next_image().
+ * This has no effect if libheif is compiled without multithreading support or the thread pool has no threads.
+ */
+LIBHEIF_API
+void heif_track_set_decoding_lookahead(struct heif_track* track, int num_frames);
+
+/**
+ * Decode only the sync samples (keyframes) of a visual track, e.g. to generate the thumbnails of a scrub bar.
+ * Starting at the track position, up to `max_images` sync samples are selected. Each selected sample is at least
+ * `sample_distance` samples after the previously selected one. The data of the other samples is not read.
+ * The data of the selected samples is requested with as few reads as possible and, since each sync sample can be
+ * decoded on its own, the images are decoded in parallel.
+ *
+ * If `max_width` and `max_height` are non-zero, the images are scaled down to fit into this size (nearest-neighbor,
+ * keeping the aspect ratio). Decoders that support it decode at a reduced resolution then.
+ *
+ * Afterwards, the track is positioned at the sample at which the selection of the next call starts.
+ * heif_error_End_of_sequence is returned when there is no further sync sample.
+ *
+ * @param out_images Array with `max_images` entries. Release the returned images with heif_image_release().
+ * @param out_sample_indices Optional array with `max_images` entries that receives the sample indices. May be NULL.
+ * @param out_num_images Receives the number of returned images.
+ */
+LIBHEIF_API
+struct heif_error heif_track_decode_sync_images(struct heif_track* track,
+                                                uint32_t sample_distance,
+                                                uint32_t max_width, uint32_t max_height,
+                                                enum heif_colorspace colorspace,
+                                                enum heif_chroma chroma,
+                                                const struct heif_decoding_options* options,
+                                                struct heif_image* out_images[],
+                                                uint32_t out_sample_indices[],
+                                                int max_images,
+                                                int* out_num_images);
+
+/**
+ * Position the track such that the next heif_track_decode_next_image() returns the sample with the
+ * given index (the first sample has index 0). Decoding restarts at the preceding sync sample and the
+ * samples up to the requested one are decoded, but not returned.
+ * For visual tracks, heif_track_get_next_raw_sequence_sample() continues at the preceding sync sample.
+ * Passing the number of samples positions the track at the end of the sequence.
+ */
+LIBHEIF_API
+struct heif_error heif_track_seek_to_sample(struct heif_track* track, uint32_t sample_index);
+
+/**
+ * Like heif_track_seek_to_sample(), but selects the sample that is displayed at `time`.
+ * The time is specified in clock ticks of the track timescale (see heif_track_get_timescale()).
+ * If `time` is after the end of the sequence, the track is positioned at the end.
+ */
+LIBHEIF_API
+struct heif_error heif_track_seek_to_time(struct heif_track* track, uint64_t time);
+
 /**
  * Get the image display duration in clock ticks of this track.
  * Make sure to use the timescale of the track and not the timescale of the total sequence.
@@ -237,6 +306,91 @@ size_t heif_raw_sequence_sample_get_data_size(const heif_raw_sequence_sample*);
 LIBHEIF_API
 uint32_t heif_raw_sequence_sample_get_duration(const heif_raw_sequence_sample*);
 
+/**
+ * Position and timing of a sample read with heif_track_get_next_raw_sequence_samples().
+ */
+struct heif_raw_sequence_sample_info
+{
+  // position of the sample data in the buffer passed to heif_track_get_next_raw_sequence_samples()
+  size_t data_offset;
+  uint32_t data_size;
+
+  // sample duration in clock ticks of the track timescale
+  uint32_t duration;
+
+  // 'tai_timestamp' is only valid if 'has_tai_timestamp' is set
+  uint8_t has_tai_timestamp; // bool
+  struct heif_tai_timestamp_packet tai_timestamp;
+};
+
+/**
+ * Read the next samples of the track into a buffer provided by the caller.
+ * Compared to calling heif_track_get_next_raw_sequence_sample() for each sample, no sample objects are allocated
+ * and the data of samples that follow each other in the file is read with a single I/O call. This is intended
+ * for tracks with many small samples, like GPS or IMU metadata.
+ *
+ * As many samples are read as fit into the buffer, but at most `max_samples`. The sample data is stored one after
+ * the other and `out_infos` (an array of `max_samples` entries) describes where each sample is.
+ * The track position advances by the number of samples read.
+ * GIMI content IDs are not returned. Use heif_track_get_next_raw_sequence_sample() to read them.
+ *
+ * Returns heif_error_End_of_sequence if there is no further sample.
+ * If the next sample does not fit into the buffer, heif_error_Usage_error is returned and no sample is read.
+ *
+ * @param out_num_samples Number of samples read.
+ */
+LIBHEIF_API
+struct heif_error heif_track_get_next_raw_sequence_samples(struct heif_track*,
+                                                           uint8_t* buffer, size_t buffer_size,
+                                                           struct heif_raw_sequence_sample_info* out_infos,
+                                                           int max_samples,
+                                                           int* out_num_samples);
+
+
+// --- reading the samples of several tracks
+
+/**
+ * Reads the raw samples of several tracks in the order in which they are stored in the file.
+ * The samples of each track are returned in decoding order.
+ * Neighbouring sample data and sample auxiliary information of all tracks is read in larger blocks.
+ * Reading all samples of a file with interleaved tracks thus only needs forward reads, which is much
+ * faster than reading each track separately when the file is on network storage.
+ */
+struct heif_sample_multiplexer;
+
+/**
+ * Create a multiplexer that reads the samples of the given tracks, starting at their first samples.
+ * It keeps its own read positions. The position of the tracks for heif_track_get_next_raw_sequence_sample()
+ * and heif_track_decode_next_image() is not changed.
+ *
+ * @param track_ids The IDs of the tracks to read. Pass NULL to read all tracks.
+ * @param num_track_ids Number of entries in 'track_ids'.
+ * @param out_multiplexer Free with heif_sample_multiplexer_release().
+ */
+LIBHEIF_API
+struct heif_error heif_context_create_sample_multiplexer(struct heif_context*,
+                                                         const uint32_t* track_ids, int num_track_ids,
+                                                         struct heif_sample_multiplexer** out_multiplexer);
+
+/**
+ * Get the next sample in file order.
+ * Returns heif_error_End_of_sequence after the last sample of all tracks.
+ *
+ * @param out_track_id ID of the track that the sample belongs to (may be NULL).
+ * @param out_sample Free with heif_raw_sequence_sample_release().
+ */
+LIBHEIF_API
+struct heif_error heif_sample_multiplexer_get_next_sample(struct heif_sample_multiplexer*,
+                                                          uint32_t* out_track_id,
+                                                          heif_raw_sequence_sample** out_sample);
+
+/**
+ * Release a heif_sample_multiplexer object.
+ * You may pass NULL.
+ */
+LIBHEIF_API
+void heif_sample_multiplexer_release(struct heif_sample_multiplexer*);
+
 
 // --- writing sequences
 
@@ -260,6 +414,23 @@ enum heif_sample_aux_info_presence {
 };
 
 
+/**
+ * Prediction structure used for encoding the images of a visual track.
+ */
+enum heif_sequence_gop_structure
+{
+  // Each image is coded independently (all samples are sync samples).
+  heif_sequence_gop_structure_intra_only = 0,
+
+  // Images may be predicted from preceding images. The decoding order is the presentation order.
+  heif_sequence_gop_structure_lowdelay = 1,
+
+  // Images may also be predicted from following images (B-frames). The coded samples are stored in
+  // decoding order and the presentation order is signaled in the 'ctts' box.
+  heif_sequence_gop_structure_unrestricted = 2
+};
+
+
 /**
  * This structure specifies what will be written in a track and how it will be laid out in the file.
  */
@@ -294,6 +465,27 @@ struct heif_track_info
   // TODO: should this be in an extension API as it is not in the HEIF standard?
   uint8_t with_gimi_track_content_id;
   const char* gimi_track_content_id;
+
+  // --- version 2
+
+  // Inter-frame prediction needs an encoder plugin that supports it (for example x265, aom, svt).
+  // With other encoders, the images are coded independently.
+  // When not intra-only, heif_track_encode_end_of_sequence() has to be called after the last image.
+  enum heif_sequence_gop_structure gop_structure; // default: intra_only
+
+  // Distances between sync samples. 0 lets the encoder choose.
+  int keyframe_distance_min; // default: 0
+  int keyframe_distance_max; // default: 0
+
+  // --- version 3
+
+  // Samples of metadata tracks are collected and written as one chunk when the chunk reaches
+  // one of these limits. Larger chunks give smaller sample tables and fewer writes.
+  // 0 writes each sample into the file immediately.
+  uint32_t max_chunk_size; // in bytes, default: 65536
+
+  // Maximum duration of the samples in a chunk (in track timescale units). 0 means no limit.
+  uint32_t max_chunk_duration; // default: 0
 };
 
 /**
@@ -338,6 +530,13 @@ void heif_image_set_duration(heif_image*, uint32_t duration);
 /**
  * Encode the image into a visual track.
  * If the passed track is no visual track, an error will be returned.
+ *
+ * When the images are coded independently (intra-only, or with an encoder that does not support inter-frame
+ * prediction) and heif_context_set_max_encoding_threads() is set to more than one thread, this function returns
+ * before the image is encoded. The images are encoded in parallel with copies of the encoder and are written to
+ * the track in the order in which they were passed in. The image must not be modified afterwards and changes to the
+ * encoder parameters have no effect until the encoder is changed. Encoding errors are returned by one of the
+ * following calls or by heif_track_encode_end_of_sequence().
  */
 LIBHEIF_API
 struct heif_error heif_track_encode_sequence_image(struct heif_track*,
@@ -345,6 +544,16 @@ struct heif_error heif_track_encode_sequence_image(struct heif_track*,
                                                    struct heif_encoder* encoder,
                                                    const struct heif_encoding_options* options);
 
+/**
+ * Signal that all images of the track have been passed to heif_track_encode_sequence_image().
+ * When the track uses inter-frame prediction, this writes the images still buffered in the encoder.
+ * Images that are encoded in parallel are written once they are finished.
+ * Pass the same encoder that was used for the images.
+ */
+LIBHEIF_API
+struct heif_error heif_track_encode_end_of_sequence(struct heif_track*,
+                                                    struct heif_encoder* encoder);
+
 // --- metadata tracks
 
 /**
@@ -410,6 +619,52 @@ LIBHEIF_API
 void heif_track_get_sample_aux_info_types(struct heif_track*, struct heif_sample_aux_info_type out_types[]);
 
 
+// --- sample groups
+
+/**
+ * Returns how many different types of sample groupings (e.g. 'refs') are assigned to this track's samples.
+ * Only the sample groups in the sample table of the track are listed, not those in movie fragments.
+ */
+LIBHEIF_API
+int heif_track_get_number_of_sample_grouping_types(struct heif_track*);
+
+/**
+ * Get the list of sample grouping types of the track.
+ * The passed array has to have heif_track_get_number_of_sample_grouping_types() entries.
+ */
+LIBHEIF_API
+void heif_track_get_sample_grouping_types(struct heif_track*, uint32_t out_grouping_types[]);
+
+/**
+ * Get the group description index of `count` samples, starting at sample `first_sample` (in decoding order).
+ * The indices start at 1. Samples that are in no group of this type get the value 0.
+ * Finding the first sample takes logarithmic time in the size of the sample-to-group table, such that
+ * querying many small ranges of a long track is cheap.
+ *
+ * @param out_indices Array with `count` entries.
+ */
+LIBHEIF_API
+struct heif_error heif_track_get_sample_group_description_indices(struct heif_track*, uint32_t grouping_type,
+                                                                 uint32_t first_sample, uint32_t count,
+                                                                 uint32_t out_indices[]);
+
+/**
+ * Returns the size of the group description `description_index` of the grouping type.
+ * Returns 0 if there is no such description or if its size is not stored in the file.
+ */
+LIBHEIF_API
+size_t heif_track_get_sample_group_description_size(struct heif_track*, uint32_t grouping_type,
+                                                    uint32_t description_index);
+
+/**
+ * Copies the payload of the group description `description_index` into `out_data`.
+ * The array has to be heif_track_get_sample_group_description_size() bytes large.
+ */
+LIBHEIF_API
+struct heif_error heif_track_get_sample_group_description(struct heif_track*, uint32_t grouping_type,
+                                                          uint32_t description_index, uint8_t* out_data);
+
+
 // --- GIMI content IDs
 
 /**
@@ -480,6 +735,28 @@ LIBHEIF_API
 void heif_raw_sequence_sample_set_tai_timestamp(struct heif_raw_sequence_sample* sample,
                                                 const struct heif_tai_timestamp_packet* timestamp);
 
+enum heif_tai_timestamp_flags
+{
+  heif_tai_timestamp_flag_present = 1,
+  heif_tai_timestamp_flag_synchronized = 2,
+  heif_tai_timestamp_flag_generation_failure = 4,
+  heif_tai_timestamp_flag_modified = 8
+};
+
+/**
+ * Get the TAI timestamps of `count` samples of the track, starting at sample `first_sample` (in decoding order).
+ * This reads the timestamps without reading or decoding the samples. Timestamps that are stored next to each other
+ * in the file are read with a single I/O call.
+ * The track position for reading or decoding samples is not changed.
+ *
+ * @param out_tai_timestamps Array with `count` entries. Samples without timestamp get the value 0.
+ * @param out_flags Optional array with `count` entries that receives combinations of `heif_tai_timestamp_flags`.
+ *                  Samples without timestamp get the value 0. May be NULL.
+ */
+LIBHEIF_API
+struct heif_error heif_track_get_tai_timestamps(struct heif_track*, uint32_t first_sample, uint32_t count,
+                                               uint64_t out_tai_timestamps[], uint8_t out_flags[]);
+
 /**
  * Returns the TAI clock info of the track.
  * If there is no TAI clock info, NULL is returned.
@@ -0,0 +1,51 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libheif/heif_tracing.h>
+#include "tracing.h"
+
+
+int heif_have_tracing_support(void)
+{
+#if ENABLE_TRACING
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+
+heif_error heif_set_trace_sink(const heif_trace_sink* sink, void* sink_user_data)
+{
+#if ENABLE_TRACING
+  if (sink && (sink->version < 1 || !sink->trace_event)) {
+    return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Invalid trace sink"};
+  }
+
+  set_trace_sink(sink, sink_user_data);
+
+  return heif_error_success;
+#else
+  (void) sink;
+  (void) sink_user_data;
+
+  return {heif_error_Unsupported_feature, heif_suberror_Unspecified, "libheif was built without tracing support"};
+#endif
+}
@@ -0,0 +1,90 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_HEIF_TRACING_H
+#define LIBHEIF_HEIF_TRACING_H
+
+#include <libheif/heif_library.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Trace events are only emitted when libheif was built with ENABLE_TRACING.
+// Use heif_have_tracing_support() to check this at runtime.
+
+struct heif_trace_event
+{
+  uint8_t version;
+
+  // --- version 1
+
+  // Category of the event ("file", "decode", "convert", "encode"). Static string, valid forever.
+  const char* category;
+
+  // Name of the traced operation. Static string, valid forever.
+  const char* name;
+
+  // Item the operation works on, or 0.
+  uint32_t item_id;
+
+  // Small number identifying the thread that executed the operation. Starts at 1.
+  uint32_t thread_id;
+
+  // Start time of the operation in microseconds on a monotonic clock with arbitrary origin.
+  uint64_t start_us;
+
+  uint64_t duration_us;
+};
+
+
+struct heif_trace_sink
+{
+  uint8_t version;
+
+  // --- version 1
+
+  // Called at the end of each traced operation. The event is only valid during the call.
+  // This is called from all threads that libheif uses, i.e. the callback has to be thread-safe.
+  // Since events are emitted when they end, nested operations are reported before their enclosing operation.
+  void (*trace_event)(const struct heif_trace_event* event, void* sink_user_data);
+};
+
+
+LIBHEIF_API
+int heif_have_tracing_support(void);
+
+/**
+ * Sets the process-wide trace sink. Pass NULL to stop tracing.
+ *
+ * The sink struct is copied. After the sink was replaced, operations that are still running may
+ * still report to the previous sink. Hence, keep the previous sink's user_data alive until all
+ * libheif calls that were running while the sink was changed have returned.
+ *
+ * Returns heif_error_Unsupported_feature when libheif was built without ENABLE_TRACING.
+ */
+LIBHEIF_API
+struct heif_error heif_set_trace_sink(const struct heif_trace_sink* sink, void* sink_user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBHEIF_HEIF_TRACING_H
@@ -22,116 +22,879 @@
 
 #include <utility>
 #include <cstring>
+#include <cerrno>
 #include <cassert>
 
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+#define HEIF_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define HEIF_HAVE_MMAP 0
+#endif
+
 #if ((defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && !defined(__PGI)) && __GNUC__ < 9) || (defined(__clang__) && __clang_major__ < 10)
 #include <type_traits>
 #else
 #include <bit>
 #endif
 
-#define MAX_UVLC_LEADING_ZEROS 20
+#define MAX_UVLC_LEADING_ZEROS 20
+
+
+bool StreamReader::read_at(uint64_t position, void* data, size_t size)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(get_read_mutex());
+#endif
+
+  return seek(position) && read(data, size);
+}
+
+
+StreamReader_istream::StreamReader_istream(std::unique_ptr<std::istream>&& istr)
+    : m_istr(std::move(istr))
+{
+  m_istr->seekg(0, std::ios_base::end);
+  m_length = m_istr->tellg();
+  m_istr->seekg(0, std::ios_base::beg);
+}
+
+uint64_t StreamReader_istream::get_position() const
+{
+  return m_istr->tellg();
+}
+
+StreamReader::grow_status StreamReader_istream::wait_for_file_size(uint64_t target_size)
+{
+  return (target_size > m_length) ? grow_status::size_beyond_eof : grow_status::size_reached;
+}
+
+bool StreamReader_istream::read(void* data, size_t size)
+{
+  uint64_t end_pos = get_position() + size;
+  if (end_pos > m_length) {
+    return false;
+  }
+
+  m_istr->read((char*) data, size);
+  return true;
+}
+
+bool StreamReader_istream::seek(uint64_t position)
+{
+  if (position > m_length)
+    return false;
+
+  m_istr->seekg(position, std::ios_base::beg);
+  return true;
+}
+
+
+StreamReader_memory::StreamReader_memory(const uint8_t* data, size_t size, bool copy)
+    : m_length(size),
+      m_position(0)
+{
+  if (copy) {
+    m_owned_data = new uint8_t[m_length];
+    memcpy(m_owned_data, data, size);
+
+    m_data = m_owned_data;
+  }
+  else {
+    m_data = data;
+  }
+}
+
+StreamReader_memory::~StreamReader_memory()
+{
+  if (m_owned_data) {
+    delete[] m_owned_data;
+  }
+}
+
+uint64_t StreamReader_memory::get_position() const
+{
+  return m_position;
+}
+
+StreamReader::grow_status StreamReader_memory::wait_for_file_size(uint64_t target_size)
+{
+  return (target_size > m_length) ? grow_status::size_beyond_eof : grow_status::size_reached;
+}
+
+bool StreamReader_memory::read(void* data, size_t size)
+{
+  uint64_t end_pos = m_position + size;
+  if (end_pos > m_length) {
+    return false;
+  }
+
+  memcpy(data, &m_data[m_position], size);
+  m_position += size;
+
+  return true;
+}
+
+bool StreamReader_memory::seek(uint64_t position)
+{
+  if (position > m_length)
+    return false;
+
+  m_position = position;
+  return true;
+}
+
+bool StreamReader_memory::read_at(uint64_t position, void* data, size_t size)
+{
+  if (position > m_length || size > m_length - position) {
+    return false;
+  }
+
+  memcpy(data, &m_data[position], size);
+  return true;
+}
+
+const uint8_t* StreamReader_memory::get_direct_data_pointer(uint64_t start, uint64_t end_pos) const
+{
+  if (start > end_pos || end_pos > m_length) {
+    return nullptr;
+  }
+
+  return m_data + start;
+}
+
+
+std::shared_ptr<StreamReader_mmap> StreamReader_mmap::open(const char* filename)
+{
+#if HEIF_HAVE_MMAP
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  auto length = static_cast<uint64_t>(st.st_size);
+  if (length > std::numeric_limits<size_t>::max()) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  void* data = mmap(nullptr, static_cast<size_t>(length), PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping stays valid after closing the file descriptor.
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+
+  return std::shared_ptr<StreamReader_mmap>(new StreamReader_mmap(static_cast<const uint8_t*>(data), length));
+#else
+  (void) filename;
+  return nullptr;
+#endif
+}
+
+StreamReader_mmap::~StreamReader_mmap()
+{
+#if HEIF_HAVE_MMAP
+  munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_length));
+#endif
+}
+
+StreamReader::grow_status StreamReader_mmap::wait_for_file_size(uint64_t target_size)
+{
+  return (target_size > m_length) ? grow_status::size_beyond_eof : grow_status::size_reached;
+}
+
+bool StreamReader_mmap::read(void* data, size_t size)
+{
+  uint64_t end_pos = m_position + size;
+  if (end_pos > m_length) {
+    return false;
+  }
+
+  memcpy(data, &m_data[m_position], size);
+  m_position += size;
+
+  return true;
+}
+
+bool StreamReader_mmap::seek(uint64_t position)
+{
+  if (position > m_length)
+    return false;
+
+  m_position = position;
+  return true;
+}
+
+bool StreamReader_mmap::read_at(uint64_t position, void* data, size_t size)
+{
+  if (position > m_length || size > m_length - position) {
+    return false;
+  }
+
+  memcpy(data, &m_data[position], size);
+  return true;
+}
+
+void StreamReader_mmap::preload_range_hint(uint64_t start, uint64_t end_pos)
+{
+#if HEIF_HAVE_MMAP && defined(MADV_WILLNEED)
+  end_pos = std::min(end_pos, m_length);
+  if (start >= end_pos) {
+    return;
+  }
+
+  // madvise() requires a page-aligned start address.
+  auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  uint64_t aligned_start = start - start % page_size;
+
+  madvise(const_cast<uint8_t*>(m_data + aligned_start), static_cast<size_t>(end_pos - aligned_start), MADV_WILLNEED);
+#else
+  (void) start;
+  (void) end_pos;
+#endif
+}
+
+const uint8_t* StreamReader_mmap::get_direct_data_pointer(uint64_t start, uint64_t end_pos) const
+{
+  if (start > end_pos || end_pos > m_length) {
+    return nullptr;
+  }
+
+  return m_data + start;
+}
+
+
+std::shared_ptr<StreamReader_fd> StreamReader_fd::open(const char* filename)
+{
+#if HEIF_HAVE_MMAP
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  return std::shared_ptr<StreamReader_fd>(new StreamReader_fd(fd, static_cast<uint64_t>(st.st_size)));
+#else
+  (void) filename;
+  return nullptr;
+#endif
+}
+
+StreamReader_fd::~StreamReader_fd()
+{
+#if HEIF_HAVE_MMAP
+  ::close(m_fd);
+#endif
+}
+
+StreamReader::grow_status StreamReader_fd::wait_for_file_size(uint64_t target_size)
+{
+  return (target_size > m_length) ? grow_status::size_beyond_eof : grow_status::size_reached;
+}
+
+bool StreamReader_fd::read(void* data, size_t size)
+{
+  if (!read_at(m_position, data, size)) {
+    return false;
+  }
+
+  m_position += size;
+  return true;
+}
+
+bool StreamReader_fd::seek(uint64_t position)
+{
+  if (position > m_length)
+    return false;
+
+  m_position = position;
+  return true;
+}
+
+bool StreamReader_fd::read_at(uint64_t position, void* data, size_t size)
+{
+  if (position > m_length || size > m_length - position) {
+    return false;
+  }
+
+#if HEIF_HAVE_MMAP
+  auto* dst = static_cast<uint8_t*>(data);
+
+  while (size > 0) {
+    ssize_t n = pread(m_fd, dst, size, static_cast<off_t>(position));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return false;
+    }
+
+    dst += n;
+    position += static_cast<uint64_t>(n);
+    size -= static_cast<size_t>(n);
+  }
+
+  return true;
+#else
+  (void) data;
+  return false;
+#endif
+}
+
+void StreamReader_fd::preload_range_hint(uint64_t start, uint64_t end_pos)
+{
+#if HEIF_HAVE_MMAP && defined(POSIX_FADV_WILLNEED)
+  end_pos = std::min(end_pos, m_length);
+  if (start < end_pos) {
+    posix_fadvise(m_fd, static_cast<off_t>(start), static_cast<off_t>(end_pos - start), POSIX_FADV_WILLNEED);
+  }
+#else
+  (void) start;
+  (void) end_pos;
+#endif
+}
+
+bool StreamReader_fd::request_range_async(uint64_t start, uint64_t end_pos)
+{
+#if HEIF_HAVE_MMAP && defined(POSIX_FADV_WILLNEED)
+  preload_range_hint(start, end_pos);
+  return true;
+#else
+  (void) start;
+  (void) end_pos;
+  return false;
+#endif
+}
+
+
+StreamReader_cached::StreamReader_cached(std::shared_ptr<StreamReader> base, std::vector<CachedRange> ranges, uint64_t file_size)
+    : m_base(std::move(base)), m_ranges(std::move(ranges)), m_file_size(file_size)
+{
+}
+
+
+const StreamReader_cached::CachedRange* StreamReader_cached::find_range(uint64_t start, uint64_t end_pos) const
+{
+  for (const auto& range : m_ranges) {
+    if (range.start <= start && end_pos <= range.start + range.data.size()) {
+      return &range;
+    }
+  }
+
+  return nullptr;
+}
+
+
+bool StreamReader_cached::read(void* data, size_t size)
+{
+  if (const CachedRange* range = find_range(m_position, m_position + size)) {
+    memcpy(data, range->data.data() + (m_position - range->start), size);
+    m_position += size;
+    return true;
+  }
+
+  // The base reader's position is only set when we actually need it.
+
+  if (m_base->get_position() != m_position && !m_base->seek(m_position)) {
+    return false;
+  }
+
+  if (!m_base->read(data, size)) {
+    return false;
+  }
+
+  m_position += size;
+  return true;
+}
+
+
+bool StreamReader_cached::seek(uint64_t position)
+{
+  m_position = position;
+  return true;
+}
+
+
+bool StreamReader_cached::read_at(uint64_t position, void* data, size_t size)
+{
+  if (const CachedRange* range = find_range(position, position + size)) {
+    memcpy(data, range->data.data() + (position - range->start), size);
+    return true;
+  }
+
+  if (m_base->has_concurrent_read_at()) {
+    return m_base->read_at(position, data, size);
+  }
+
+  // The base reader is also used by our read(), which is protected by our mutex, not by that of the base reader.
+  return StreamReader::read_at(position, data, size);
+}
+
+
+uint64_t StreamReader_cached::request_range(uint64_t start, uint64_t end_pos)
+{
+  if (find_range(start, end_pos)) {
+    return end_pos;
+  }
+
+  // Reading the file structure also checks where the file ends.
+  if (m_file_size != 0 && start >= m_file_size) {
+    return m_file_size;
+  }
+
+  uint64_t result = m_base->request_range(start, end_pos);
+  if (result == 0) {
+    m_last_error = m_base->get_error();
+  }
+
+  return result;
+}
+
+
+const uint8_t* StreamReader_cached::get_direct_data_pointer(uint64_t start, uint64_t end_pos) const
+{
+  if (const CachedRange* range = find_range(start, end_pos)) {
+    return range->data.data() + (start - range->start);
+  }
+
+  return m_base->get_direct_data_pointer(start, end_pos);
+}
+
+
+StreamReader_range_cache::StreamReader_range_cache(std::shared_ptr<StreamReader> base, size_t max_bytes)
+    : m_base(std::move(base)), m_max_bytes(max_bytes)
+{
+  m_position = m_base->get_position();
+}
+
+
+void StreamReader_range_cache::set_max_bytes(size_t max_bytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_max_bytes = max_bytes;
+  evict(max_bytes);
+}
+
+
+size_t StreamReader_range_cache::get_cached_bytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_cached_bytes;
+}
+
+
+const StreamReader_range_cache::CachedRange* StreamReader_range_cache::find_range(uint64_t start, uint64_t end_pos)
+{
+  for (auto iter = m_ranges.begin(); iter != m_ranges.end(); ++iter) {
+    if (iter->start <= start && end_pos <= iter->start + iter->data.size()) {
+      m_ranges.splice(m_ranges.begin(), m_ranges, iter);
+      return &m_ranges.front();
+    }
+  }
+
+  return nullptr;
+}
+
+
+void StreamReader_range_cache::evict(size_t max_bytes)
+{
+  while (m_cached_bytes > max_bytes) {
+    m_cached_bytes -= m_ranges.back().data.size();
+    m_ranges.pop_back();
+  }
+}
+
+
+bool StreamReader_range_cache::read(void* data, size_t size)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (const CachedRange* range = find_range(m_position, m_position + size)) {
+      memcpy(data, range->data.data() + (m_position - range->start), size);
+      m_position += size;
+      return true;
+    }
+  }
+
+  // The base reader may also be used by others. Set its position before each read.
+
+  if (m_base->get_position() != m_position && !m_base->seek(m_position)) {
+    return false;
+  }
+
+  if (!m_base->read(data, size)) {
+    return false;
+  }
+
+  uint64_t start = m_position;
+  m_position += size;
+
+  // --- remember item data that is not directly accessible anyway
+
+  if (start >= m_requested_start && m_position <= m_requested_end &&
+      !m_base->get_direct_data_pointer(start, m_position)) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (size <= m_max_bytes) {
+      evict(m_max_bytes - size);
+
+      const auto* bytes = static_cast<const uint8_t*>(data);
+      m_ranges.push_front({start, std::vector<uint8_t>(bytes, bytes + size)});
+      m_cached_bytes += size;
+    }
+  }
+
+  return true;
+}
+
+
+bool StreamReader_range_cache::seek(uint64_t position)
+{
+  m_position = position;
+  return true;
+}
+
+
+uint64_t StreamReader_range_cache::request_range(uint64_t start, uint64_t end_pos)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (find_range(start, end_pos)) {
+      return end_pos;
+    }
+  }
+
+  uint64_t result = m_base->request_range(start, end_pos);
+  if (result == 0) {
+    m_last_error = m_base->get_error();
+    return 0;
+  }
+
+  m_requested_start = start;
+  m_requested_end = std::min(result, end_pos);
+
+  return result;
+}
+
+
+void StreamReader_range_cache::release_range(uint64_t start, uint64_t end_pos)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto iter = m_ranges.begin(); iter != m_ranges.end();) {
+      if (iter->start < end_pos && start < iter->start + iter->data.size()) {
+        m_cached_bytes -= iter->data.size();
+        iter = m_ranges.erase(iter);
+      }
+      else {
+        ++iter;
+      }
+    }
+  }
+
+  m_base->release_range(start, end_pos);
+}
+
+
+StreamReader_CApi::StreamReader_CApi(const heif_reader* func_table, void* userdata)
+    : m_func_table(func_table), m_userdata(userdata)
+{
+}
+
+StreamReader_CApi::~StreamReader_CApi()
+{
+  // The completion callbacks of outstanding requests still refer to us.
+
+  std::unique_lock<std::mutex> lock(m_async_mutex);
+  m_async_completed.wait(lock, [this]() {
+    return std::all_of(m_async_requests.begin(), m_async_requests.end(),
+                       [](const std::shared_ptr<AsyncRangeRequest>& request) { return request->completed; });
+  });
+}
+
+
+bool StreamReader_CApi::read_at(uint64_t position, void* data, size_t size)
+{
+  if (has_concurrent_read_at()) {
+    return !m_func_table->read_at(position, data, size, m_userdata);
+  }
+
+  return StreamReader::read_at(position, data, size);
+}
+
+
+uint64_t StreamReader_CApi::request_range(uint64_t start, uint64_t end_pos)
+{
+  if (m_func_table->reader_api_version >= 2) {
+
+    // If the range has been requested asynchronously, wait for that request instead of starting a new one.
+
+    if (has_async_requests()) {
+      std::unique_lock<std::mutex> lock(m_async_mutex);
+
+      for (const auto& pending : m_async_requests) {
+        if (pending->start <= start && end_pos <= pending->end_pos) {
+          // Keep our own reference. m_async_requests may be modified by other threads while we are waiting.
+          std::shared_ptr<AsyncRangeRequest> request = pending;
+
+          request->num_waiting++;
+          m_async_completed.wait(lock, [&request]() { return request->completed; });
+          request->num_waiting--;
+
+          return convert_range_request_result(request->status, request->range_end, end_pos,
+                                              request->reader_error_code,
+                                              request->has_error_msg ? &request->reader_error_msg : nullptr);
+        }
+      }
+    }
+
+    heif_reader_range_request_result result = m_func_table->request_range(start, end_pos, m_userdata);
+
+    // convert error message string and release input string memory
+
+    std::string error_msg;
+    if (result.reader_error_msg) {
+      error_msg = std::string{result.reader_error_msg};
+
+      if (m_func_table->release_error_msg) {
+        m_func_table->release_error_msg(result.reader_error_msg);
+      }
+    }
+
+    return convert_range_request_result(result.status, result.range_end, end_pos,
+                                        result.reader_error_code, result.reader_error_msg ? &error_msg : nullptr);
+  }
+  else {
+    auto result = m_func_table->wait_for_file_size(end_pos, m_userdata);
+    if (result == heif_reader_grow_status_size_reached) {
+      return end_pos;
+    }
+    else {
+      uint64_t pos = m_func_table->get_position(m_userdata);
+      return bisect_filesize(pos, end_pos);
+    }
+  }
+}
+
+
+uint64_t StreamReader_CApi::convert_range_request_result(heif_reader_grow_status status, uint64_t range_end, uint64_t end_pos,
+                                                         int reader_error_code, const std::string* reader_error_msg)
+{
+  switch (status) {
+    case heif_reader_grow_status_size_reached:
+      return end_pos;
+    case heif_reader_grow_status_timeout:
+      return 0; // invalid return value from callback
+    case heif_reader_grow_status_size_beyond_eof:
+      m_last_error = {heif_error_Invalid_input, heif_suberror_End_of_data, "Read beyond file size"};
+      return range_end;
+    case heif_reader_grow_status_error: {
+      std::stringstream sstr;
+      sstr << "Input error (" << reader_error_code << ")";
+      if (reader_error_msg) {
+        sstr << " : " << *reader_error_msg;
+      }
+      m_last_error = {heif_error_Invalid_input, heif_suberror_Unspecified, sstr.str()};
+
+      return 0; // error occurred
+    }
+    default:
+      m_last_error = {heif_error_Invalid_input, heif_suberror_Unspecified, "Invalid input reader return value"};
+      return 0;
+  }
+}
+
+
+std::shared_ptr<StreamReader_CApi::AsyncRangeRequest>
+StreamReader_CApi::find_or_add_async_request(uint64_t start, uint64_t end_pos, AsyncRangeRequest** out_new_request)
+{
+  *out_new_request = nullptr;
+
+  for (const auto& pending : m_async_requests) {
+    if (pending->start <= start && end_pos <= pending->end_pos) {
+      return pending;
+    }
+  }
 
+  auto new_request = std::make_shared<AsyncRangeRequest>();
+  new_request->reader = this;
+  new_request->start = start;
+  new_request->end_pos = end_pos;
 
-StreamReader_istream::StreamReader_istream(std::unique_ptr<std::istream>&& istr)
-    : m_istr(std::move(istr))
-{
-  m_istr->seekg(0, std::ios_base::end);
-  m_length = m_istr->tellg();
-  m_istr->seekg(0, std::ios_base::beg);
-}
+  *out_new_request = new_request.get();
+  m_async_requests.push_back(new_request);
 
-uint64_t StreamReader_istream::get_position() const
-{
-  return m_istr->tellg();
+  return new_request;
 }
 
-StreamReader::grow_status StreamReader_istream::wait_for_file_size(uint64_t target_size)
-{
-  return (target_size > m_length) ? grow_status::size_beyond_eof : grow_status::size_reached;
-}
 
-bool StreamReader_istream::read(void* data, size_t size)
+bool StreamReader_CApi::request_range_async(uint64_t start, uint64_t end_pos)
 {
-  uint64_t end_pos = get_position() + size;
-  if (end_pos > m_length) {
+  if (!has_async_requests()) {
     return false;
   }
 
-  m_istr->read((char*) data, size);
+  AsyncRangeRequest* new_request;
+
+  {
+    std::lock_guard<std::mutex> lock(m_async_mutex);
+    find_or_add_async_request(start, end_pos, &new_request);
+  }
+
+  // The lock must not be held here, because the reader may call the completion callback immediately.
+
+  if (new_request) {
+    m_func_table->request_range_async(start, end_pos, on_async_range_request_completed, new_request, m_userdata);
+  }
+
   return true;
 }
 
-bool StreamReader_istream::seek(uint64_t position)
+
+bool StreamReader_CApi::request_ranges_async(const std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+                                             std::function<void()> on_completed)
 {
-  if (position > m_length)
+  if (!has_async_requests()) {
     return false;
+  }
 
-  m_istr->seekg(position, std::ios_base::beg);
-  return true;
-}
+  std::vector<AsyncRangeRequest*> new_requests;
+  bool all_completed = true;
 
+  {
+    std::lock_guard<std::mutex> lock(m_async_mutex);
 
-StreamReader_memory::StreamReader_memory(const uint8_t* data, size_t size, bool copy)
-    : m_length(size),
-      m_position(0)
-{
-  if (copy) {
-    m_owned_data = new uint8_t[m_length];
-    memcpy(m_owned_data, data, size);
+    AsyncRangeWaiter waiter;
 
-    m_data = m_owned_data;
+    for (const auto& range : ranges) {
+      AsyncRangeRequest* new_request;
+      std::shared_ptr<AsyncRangeRequest> request = find_or_add_async_request(range.first, range.second, &new_request);
+      if (new_request) {
+        new_requests.push_back(new_request);
+      }
+
+      if (!request->completed) {
+        waiter.requests.push_back(request);
+        all_completed = false;
+      }
+    }
+
+    // The waiter is registered before the requests are sent, because they may complete immediately.
+
+    if (!all_completed) {
+      waiter.on_completed = std::move(on_completed);
+      m_async_waiters.push_back(std::move(waiter));
+    }
   }
-  else {
-    m_data = data;
+
+  if (all_completed) {
+    on_completed();
   }
-}
 
-StreamReader_memory::~StreamReader_memory()
-{
-  if (m_owned_data) {
-    delete[] m_owned_data;
+  for (AsyncRangeRequest* request : new_requests) {
+    m_func_table->request_range_async(request->start, request->end_pos, on_async_range_request_completed, request, m_userdata);
   }
-}
 
-uint64_t StreamReader_memory::get_position() const
-{
-  return m_position;
+  return true;
 }
 
-StreamReader::grow_status StreamReader_memory::wait_for_file_size(uint64_t target_size)
-{
-  return (target_size > m_length) ? grow_status::size_beyond_eof : grow_status::size_reached;
-}
 
-bool StreamReader_memory::read(void* data, size_t size)
+void StreamReader_CApi::on_async_range_request_completed(heif_reader_range_request_result result, void* completion_userdata)
 {
-  uint64_t end_pos = m_position + size;
-  if (end_pos > m_length) {
-    return false;
+  auto* request = static_cast<AsyncRangeRequest*>(completion_userdata);
+  StreamReader_CApi* reader = request->reader;
+
+  std::string error_msg;
+  if (result.reader_error_msg) {
+    error_msg = std::string{result.reader_error_msg};
+
+    if (reader->m_func_table->release_error_msg) {
+      reader->m_func_table->release_error_msg(result.reader_error_msg);
+    }
   }
 
-  memcpy(data, &m_data[m_position], size);
-  m_position += size;
+  std::vector<std::function<void()>> completed_callbacks;
 
-  return true;
-}
+  {
+    // Notify while holding the lock. Otherwise, the waiting thread could destroy the reader before we call notify.
+
+    std::lock_guard<std::mutex> lock(reader->m_async_mutex);
+
+    request->status = result.status;
+    request->range_end = result.range_end;
+    request->reader_error_code = result.reader_error_code;
+    request->has_error_msg = (result.reader_error_msg != nullptr);
+    request->reader_error_msg = std::move(error_msg);
+    request->completed = true;
+
+    auto& waiters = reader->m_async_waiters;
+    for (auto iter = waiters.begin(); iter != waiters.end();) {
+      if (std::all_of(iter->requests.begin(), iter->requests.end(),
+                      [](const std::shared_ptr<const AsyncRangeRequest>& r) { return r->completed; })) {
+        completed_callbacks.push_back(std::move(iter->on_completed));
+        iter = waiters.erase(iter);
+      }
+      else {
+        ++iter;
+      }
+    }
 
-bool StreamReader_memory::seek(uint64_t position)
-{
-  if (position > m_length)
-    return false;
+    reader->m_async_completed.notify_all();
+  }
 
-  m_position = position;
-  return true;
+  // The callbacks do not refer to the reader, which may already be destroyed here.
+
+  for (const auto& callback : completed_callbacks) {
+    callback();
+  }
 }
 
 
-StreamReader_CApi::StreamReader_CApi(const heif_reader* func_table, void* userdata)
-    : m_func_table(func_table), m_userdata(userdata)
+void StreamReader_CApi::release_range(uint64_t start, uint64_t end_pos)
 {
+  if (m_func_table->reader_api_version >= 2) {
+    m_func_table->release_file_range(start, end_pos, m_userdata);
+  }
+
+  // Forget completed asynchronous requests that overlap the released range. Their data may not be available anymore.
+  // Requests that a request_range() call is still waiting for are kept until it has read the result.
+
+  if (has_async_requests()) {
+    std::lock_guard<std::mutex> lock(m_async_mutex);
+
+    m_async_requests.erase(std::remove_if(m_async_requests.begin(), m_async_requests.end(),
+                                          [start, end_pos](const std::shared_ptr<AsyncRangeRequest>& request) {
+                                            return request->completed && request->num_waiting == 0 &&
+                                                   request->start < end_pos && start < request->end_pos;
+                                          }),
+                           m_async_requests.end());
+  }
 }
 
+
 StreamReader::grow_status StreamReader_CApi::wait_for_file_size(uint64_t target_size)
 {
   heif_reader_grow_status status = m_func_table->wait_for_file_size(target_size, m_userdata);
@@ -177,39 +940,87 @@ StreamReader::grow_status BitstreamRange::wait_until_range_is_available()
 }
 
 
-uint8_t BitstreamRange::read8()
+bool BitstreamRange::read_bytes(void* data, size_t n)
 {
-  if (!prepare_read(1)) {
-    return 0;
+  if (m_buffer_data) {
+    if (m_remaining < n) {
+      m_remaining = 0;
+      m_error = true;
+      return false;
+    }
+
+    memcpy(data, m_buffer_data, n);
+    m_buffer_data += n;
+    m_remaining -= n;
+    return true;
   }
 
-  uint8_t buf;
+  if (!prepare_read(n)) {
+    return false;
+  }
 
-  auto istr = get_istream();
-  bool success = istr->read((char*) &buf, 1);
+  bool success = m_istr->read(data, n);
 
   if (!success) {
     set_eof_while_reading();
-    return 0;
   }
 
-  return buf;
+  return success;
 }
 
 
-uint16_t BitstreamRange::read16()
+void BitstreamRange::buffer_remaining_data(size_t max_size)
+{
+  if (m_buffer_data || m_remaining == 0 || m_remaining > max_size) {
+    return;
+  }
+
+  uint64_t start = m_istr->get_position();
+
+  const uint8_t* data = m_istr->get_direct_data_pointer(start, start + m_remaining);
+  if (data) {
+    if (!m_istr->seek(start + m_remaining)) {
+      return;
+    }
+  }
+  else {
+    m_buffer.resize(m_remaining);
+    if (!m_istr->read(m_buffer.data(), m_remaining)) {
+      m_buffer.clear();
+      m_istr->seek(start);
+      return;
+    }
+
+    data = m_buffer.data();
+  }
+
+  // The data has been consumed from the StreamReader.
+
+  if (m_parent_range) {
+    m_parent_range->skip_without_advancing_file_pos(m_remaining);
+  }
+
+  m_buffer_data = data;
+}
+
+
+uint8_t BitstreamRange::read8()
 {
-  if (!prepare_read(2)) {
+  uint8_t buf;
+
+  if (!read_bytes(&buf, 1)) {
     return 0;
   }
 
-  uint8_t buf[2];
+  return buf;
+}
 
-  auto istr = get_istream();
-  bool success = istr->read((char*) buf, 2);
 
-  if (!success) {
-    set_eof_while_reading();
+uint16_t BitstreamRange::read16()
+{
+  uint8_t buf[2];
+
+  if (!read_bytes(buf, 2)) {
     return 0;
   }
 
@@ -233,17 +1044,9 @@ int16_t BitstreamRange::read16s()
 
 uint32_t BitstreamRange::read24()
 {
-  if (!prepare_read(3)) {
-    return 0;
-  }
-
   uint8_t buf[3];
 
-  auto istr = get_istream();
-  bool success = istr->read((char*) buf, 3);
-
-  if (!success) {
-    set_eof_while_reading();
+  if (!read_bytes(buf, 3)) {
     return 0;
   }
 
@@ -254,17 +1057,9 @@ uint32_t BitstreamRange::read24()
 
 uint32_t BitstreamRange::read32()
 {
-  if (!prepare_read(4)) {
-    return 0;
-  }
-
   uint8_t buf[4];
 
-  auto istr = get_istream();
-  bool success = istr->read((char*) buf, 4);
-
-  if (!success) {
-    set_eof_while_reading();
+  if (!read_bytes(buf, 4)) {
     return 0;
   }
 
@@ -311,17 +1106,9 @@ int32_t BitstreamRange::read32s()
 
 uint64_t BitstreamRange::read64()
 {
-  if (!prepare_read(8)) {
-    return 0;
-  }
-
   uint8_t buf[8];
 
-  auto istr = get_istream();
-  bool success = istr->read((char*) buf, 8);
-
-  if (!success) {
-    set_eof_while_reading();
+  if (!read_bytes(buf, 8)) {
     return 0;
   }
 
@@ -395,18 +1182,9 @@ std::string BitstreamRange::read_string()
     return std::string();
   }
 
-  auto istr = get_istream();
-
   for (;;) {
-    if (!prepare_read(1)) {
-      return std::string();
-    }
-
     char c;
-    bool success = istr->read(&c, 1);
-
-    if (!success) {
-      set_eof_while_reading();
+    if (!read_bytes(&c, 1)) {
       return std::string();
     }
 
@@ -424,52 +1202,27 @@ std::string BitstreamRange::read_string()
 
 std::string BitstreamRange::read_fixed_string(int len)
 {
-  std::string str;
-
-  if (!prepare_read(len)) {
-    return std::string();
+  if (len <= 0) {
+    return {};
   }
 
-  auto istr = get_istream();
-
-  uint8_t n;
-  bool success = istr->read(&n, 1);
-  if (!success || n > len - 1) {
+  std::vector<char> buf(static_cast<size_t>(len));
+  if (!read_bytes(buf.data(), buf.size())) {
     return {};
   }
 
-  for (int i = 0; i < n; i++) {
-    char c;
-    success = istr->read(&c, 1);
-
-    if (!success) {
-      set_eof_while_reading();
-      return std::string();
-    }
-
-    str += (char) c;
+  auto n = static_cast<uint8_t>(buf[0]);
+  if (n > len - 1) {
+    return {};
   }
 
-  istr->seek_cur(len-n-1);
-
-  return str;
+  return std::string(buf.data() + 1, n);
 }
 
 
 bool BitstreamRange::read(uint8_t* data, size_t n)
 {
-  if (!prepare_read(n)) {
-    return false;
-  }
-
-  auto istr = get_istream();
-  bool success = istr->read(data, n);
-
-  if (!success) {
-    set_eof_while_reading();
-  }
-
-  return success;
+  return read_bytes(data, n);
 }
 
 
@@ -503,6 +1256,10 @@ bool BitstreamRange::prepare_read(size_t nBytes)
 
 StreamReader::grow_status BitstreamRange::wait_for_available_bytes(size_t nBytes)
 {
+  if (m_buffer_data) {
+    return nBytes <= m_remaining ? StreamReader::grow_status::size_reached : StreamReader::grow_status::size_beyond_eof;
+  }
+
   int64_t target_size = m_istr->get_position() + nBytes;
 
   return m_istr->wait_for_file_size(target_size);
@@ -587,13 +1344,17 @@ bool BitReader::get_flag()
   return (get_bits(1) == 0x01);
 }
 
-std::vector<uint8_t> BitReader::read_bytes(uint32_t n)
+std::span<const uint8_t> BitReader::read_bytes(uint32_t n)
 {
-  // TODO: this implementation isn't very efficient
-  std::vector<uint8_t> bytes;
-  for (uint32_t i = 0; i < n; i++) {
-    bytes.push_back(get_bits8(8));
+  assert(is_at_byte_boundary());
+
+  int available = get_bytes_remaining();
+  if (n > (uint32_t) available) {
+    n = (uint32_t) available;
   }
+
+  std::span<const uint8_t> bytes(get_current_byte_pointer(), n);
+  skip_bytes((int) n);
   return bytes;
 }
 
@@ -624,7 +1385,18 @@ int BitReader::peek_bits(int n)
 
 void BitReader::skip_bytes(int nBytes)
 {
-  // TODO: this is slow
+  // At a byte boundary, we can jump directly to the new position.
+  if (is_at_byte_boundary() && nBytes >= 0 && nBytes <= get_bytes_remaining()) {
+    const uint8_t* new_position = get_current_byte_pointer() + nBytes;
+    bytes_remaining = get_bytes_remaining() - nBytes;
+    data = new_position;
+
+    nextbits = 0;
+    nextbits_cnt = 0;
+    refill();
+    return;
+  }
+
   while (nBytes--) {
     skip_bits(8);
   }
@@ -668,17 +1440,33 @@ void BitReader::skip_to_byte_boundary()
 
 bool BitReader::get_uvlc(int* value)
 {
-  int num_zeros = 0;
+  if (nextbits_cnt <= MAX_UVLC_LEADING_ZEROS) {
+    refill();
+  }
+
+  // Count the leading zeros in one step. This needs the terminating one-bit to be buffered.
+  int num_zeros = (nextbits == 0) ? 64 : std::countl_zero(nextbits);
+
+  if (num_zeros >= nextbits_cnt) {
+    // Only zeros left until the end of the data.
+    num_zeros = nextbits_cnt;
+    if (num_zeros > MAX_UVLC_LEADING_ZEROS) { return false; }
 
-  while (get_bits(1) == 0) {
-    num_zeros++;
+    skip_bits_fast(num_zeros);
+    while (get_bits(1) == 0) {
+      num_zeros++;
 
+      if (num_zeros > MAX_UVLC_LEADING_ZEROS) { return false; }
+    }
+  }
+  else {
     if (num_zeros > MAX_UVLC_LEADING_ZEROS) { return false; }
+
+    skip_bits_fast(num_zeros + 1);
   }
 
-  int offset = 0;
   if (num_zeros != 0) {
-    offset = (int) get_bits(num_zeros);
+    int offset = (int) get_bits(num_zeros);
     *value = offset + (1 << num_zeros) - 1;
     assert(*value > 0);
     return true;
@@ -707,17 +1495,37 @@ bool BitReader::get_svlc(int* value)
 
 void BitReader::refill()
 {
-#if 0
-  // TODO: activate me once I'm sure this works
-  while (nextbits_cnt <= 64-8 && bytes_remaining) {
-    uint64_t newval = *data++;
-    bytes_remaining--;
+  if (bytes_remaining < 8) {
+    refill_bytewise();
+    return;
+  }
 
-    nextbits_cnt += 8;
-    newval <<= 64-nextbits_cnt;
-    nextbits |= newval;
+  // Load 8 bytes at once and take as many complete bytes as fit into 'nextbits'.
+
+  int num_bytes = (64 - nextbits_cnt) >> 3;
+  if (num_bytes == 0) {
+    return;
   }
-#else
+
+  uint64_t newval;
+  memcpy(&newval, data, 8);
+  if constexpr (std::endian::native == std::endian::little) {
+    newval = ((newval & 0x00000000FFFFFFFFULL) << 32) | ((newval & 0xFFFFFFFF00000000ULL) >> 32);
+    newval = ((newval & 0x0000FFFF0000FFFFULL) << 16) | ((newval & 0xFFFF0000FFFF0000ULL) >> 16);
+    newval = ((newval & 0x00FF00FF00FF00FFULL) << 8) | ((newval & 0xFF00FF00FF00FF00ULL) >> 8);
+  }
+
+  newval &= ~0ULL << (64 - num_bytes * 8);
+  nextbits |= newval >> nextbits_cnt;
+  nextbits_cnt += num_bytes * 8;
+
+  data += num_bytes;
+  bytes_remaining -= num_bytes;
+}
+
+
+void BitReader::refill_bytewise()
+{
   int shift = 64 - nextbits_cnt;
 
   while (shift >= 8 && bytes_remaining) {
@@ -730,7 +1538,39 @@ void BitReader::refill()
   }
 
   nextbits_cnt = 64 - shift;
-#endif
+}
+
+
+void BitWriter::write_bits(uint32_t value, int n)
+{
+  assert(n >= 0 && n <= 32);
+
+  for (int i = n - 1; i >= 0; i--) {
+    m_current_byte = static_cast<uint8_t>((m_current_byte << 1) | ((value >> i) & 1));
+    m_current_bits++;
+
+    if (m_current_bits == 8) {
+      m_data.push_back(m_current_byte);
+      m_current_byte = 0;
+      m_current_bits = 0;
+    }
+  }
+}
+
+
+void BitWriter::skip_to_byte_boundary()
+{
+  if (m_current_bits > 0) {
+    write_bits(0, 8 - m_current_bits);
+  }
+}
+
+
+void BitWriter::write_bytes(const std::vector<uint8_t>& data)
+{
+  assert(m_current_bits == 0);
+
+  m_data.insert(m_data.end(), data.begin(), data.end());
 }
 
 
@@ -905,30 +1745,30 @@ void StreamWriter::write_fixed_string(std::string s, size_t len)
 
 void StreamWriter::write(const std::vector<uint8_t>& vec)
 {
-  size_t required_size = m_position + vec.size();
-
-  if (required_size > m_data.size()) {
-    m_data.resize(required_size);
-  }
-
-  memcpy(m_data.data() + m_position, vec.data(), vec.size());
-  m_position += vec.size();
+  write(vec.data(), vec.size());
 }
 
 
-void StreamWriter::write(const StreamWriter& writer)
+void StreamWriter::write(const uint8_t* data, size_t size)
 {
-  size_t required_size = m_position + writer.get_data().size();
+  if (size == 0) {
+    return;
+  }
+
+  size_t required_size = m_position + size;
 
   if (required_size > m_data.size()) {
     m_data.resize(required_size);
   }
 
-  const auto& data = writer.get_data();
+  memcpy(m_data.data() + m_position, data, size);
+  m_position += size;
+}
 
-  memcpy(m_data.data() + m_position, data.data(), data.size());
 
-  m_position += data.size();
+void StreamWriter::write(const StreamWriter& writer)
+{
+  write(writer.m_data.data(), writer.m_data.size());
 }
 
 
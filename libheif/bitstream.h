@@ -25,6 +25,8 @@
 #include <cstddef>
 
 #include <vector>
+#include <list>
+#include <span>
 #include <string>
 #include <memory>
 #include <limits>
@@ -34,6 +36,9 @@
 
 #include "error.h"
 #include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 
 
 class StreamReader
@@ -58,6 +63,18 @@ public:
 
   virtual bool seek(uint64_t position) = 0;
 
+  // Reads 'size' bytes at file position 'position' without using the read position of seek() and read().
+  // This can be called from several threads concurrently, but not while holding get_read_mutex().
+  // The default implementation does a seek() and read() under get_read_mutex().
+  virtual bool read_at(uint64_t position, void* data, size_t size);
+
+  // Returns true if read_at() does not lock get_read_mutex(), i.e. if concurrent reads do not block each other.
+  virtual bool has_concurrent_read_at() const { return false; }
+
+  // Serializes all accesses that use the read position or change the state of the reader.
+  // Each reader has its own mutex. Only read_at() can be called without it.
+  virtual std::mutex& get_read_mutex() { return m_read_mutex; }
+
   bool seek_cur(uint64_t position_offset)
   {
     return seek(get_position() + position_offset);
@@ -76,6 +93,22 @@ public:
 
   virtual void preload_range_hint(uint64_t start, uint64_t end_pos) { }
 
+  // Starts fetching the range in the background. A later request_range() within this range waits for the
+  // outstanding request instead of issuing a new one.
+  // Returns false if the reader does not support asynchronous requests. Use preload_range_hint() in that case.
+  virtual bool request_range_async(uint64_t start, uint64_t end_pos) { return false; }
+
+  // Starts fetching all ranges in the background like request_range_async() and calls 'on_completed' when all of them
+  // are available. The callback may be called from any thread, or from the calling thread before this returns.
+  // Returns false if the reader does not support asynchronous requests. The callback is not called in that case.
+  virtual bool request_ranges_async(const std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+                                    std::function<void()> on_completed) { return false; }
+
+  // Returns a pointer to the file data in the range [start, end_pos) when the reader has the whole file
+  // in memory (memory buffer or memory-mapped file). The pointer stays valid as long as the StreamReader exists.
+  // Returns NULL when the data can only be accessed through read().
+  virtual const uint8_t* get_direct_data_pointer(uint64_t start, uint64_t end_pos) const { return nullptr; }
+
   Error get_error() const {
     return m_last_error;
   }
@@ -84,6 +117,9 @@ public:
 
 protected:
   Error m_last_error;
+
+private:
+  std::mutex m_read_mutex;
 };
 
 #include <iostream>
@@ -135,11 +171,17 @@ public:
 
   bool seek(uint64_t position) override;
 
+  bool read_at(uint64_t position, void* data, size_t size) override;
+
+  bool has_concurrent_read_at() const override { return true; }
+
   // end_pos is last byte to read + 1. I.e. like a file size.
   uint64_t request_range(uint64_t start, uint64_t end_pos) override {
     return m_length;
   }
 
+  const uint8_t* get_direct_data_pointer(uint64_t start, uint64_t end_pos) const override;
+
 private:
   const uint8_t* m_data;
   uint64_t m_length;
@@ -150,11 +192,95 @@ private:
 };
 
 
+// Reads a file through a read-only memory mapping.
+// This gives decoders direct access to the compressed data without copying it.
+class StreamReader_mmap : public StreamReader
+{
+public:
+  // Returns NULL if the file cannot be mapped (e.g. it is empty, not a regular file, or
+  // memory-mapping is not supported on this platform). The caller should then fall back to StreamReader_istream.
+  static std::shared_ptr<StreamReader_mmap> open(const char* filename);
+
+  ~StreamReader_mmap() override;
+
+  uint64_t get_position() const override { return m_position; }
+
+  grow_status wait_for_file_size(uint64_t target_size) override;
+
+  bool read(void* data, size_t size) override;
+
+  bool seek(uint64_t position) override;
+
+  bool read_at(uint64_t position, void* data, size_t size) override;
+
+  bool has_concurrent_read_at() const override { return true; }
+
+  uint64_t request_range(uint64_t start, uint64_t end_pos) override {
+    return std::min(end_pos, m_length);
+  }
+
+  // Lets the kernel read the pages of the range ahead (madvise(MADV_WILLNEED)).
+  void preload_range_hint(uint64_t start, uint64_t end_pos) override;
+
+  const uint8_t* get_direct_data_pointer(uint64_t start, uint64_t end_pos) const override;
+
+private:
+  StreamReader_mmap(const uint8_t* data, uint64_t length) : m_data(data), m_length(length) {}
+
+  const uint8_t* m_data;
+  uint64_t m_length;
+  uint64_t m_position = 0;
+};
+
+
+// Reads a file with pread(). Unlike StreamReader_istream, reads at different positions do not have to be
+// serialized, such that the tiles of an image can be read concurrently by the decoding threads.
+// Requested ranges are read ahead by the kernel (posix_fadvise(POSIX_FADV_WILLNEED)).
+class StreamReader_fd : public StreamReader
+{
+public:
+  // Returns NULL if the file cannot be opened or pread() is not supported on this platform.
+  static std::shared_ptr<StreamReader_fd> open(const char* filename);
+
+  ~StreamReader_fd() override;
+
+  uint64_t get_position() const override { return m_position; }
+
+  grow_status wait_for_file_size(uint64_t target_size) override;
+
+  bool read(void* data, size_t size) override;
+
+  bool seek(uint64_t position) override;
+
+  bool read_at(uint64_t position, void* data, size_t size) override;
+
+  bool has_concurrent_read_at() const override { return true; }
+
+  uint64_t request_range(uint64_t start, uint64_t end_pos) override {
+    return std::min(end_pos, m_length);
+  }
+
+  void preload_range_hint(uint64_t start, uint64_t end_pos) override;
+
+  // The kernel reads the range in the background. A later read() of the range waits for that read.
+  bool request_range_async(uint64_t start, uint64_t end_pos) override;
+
+private:
+  StreamReader_fd(int fd, uint64_t length) : m_fd(fd), m_length(length) {}
+
+  int m_fd;
+  uint64_t m_length;
+  uint64_t m_position = 0;
+};
+
+
 class StreamReader_CApi : public StreamReader
 {
 public:
   StreamReader_CApi(const heif_reader* func_table, void* userdata);
 
+  ~StreamReader_CApi() override;
+
   uint64_t get_position() const override { return m_func_table->get_position(m_userdata); }
 
   StreamReader::grow_status wait_for_file_size(uint64_t target_size) override;
@@ -163,59 +289,11 @@ public:
 
   bool seek(uint64_t position) override { return !m_func_table->seek(position, m_userdata); }
 
-  uint64_t request_range(uint64_t start, uint64_t end_pos) override {
-    if (m_func_table->reader_api_version >= 2) {
-      heif_reader_range_request_result result = m_func_table->request_range(start, end_pos, m_userdata);
-
-      // convert error message string and release input string memory
-
-      std::string error_msg;
-      if (result.reader_error_msg) {
-        error_msg = std::string{result.reader_error_msg};
+  bool read_at(uint64_t position, void* data, size_t size) override;
 
-        if (m_func_table->release_error_msg) {
-          m_func_table->release_error_msg(result.reader_error_msg);
-        }
-      }
+  bool has_concurrent_read_at() const override { return m_func_table->reader_api_version >= 4 && m_func_table->read_at; }
 
-      switch (result.status) {
-        case heif_reader_grow_status_size_reached:
-          return end_pos;
-        case heif_reader_grow_status_timeout:
-          return 0; // invalid return value from callback
-        case heif_reader_grow_status_size_beyond_eof:
-          m_last_error = {heif_error_Invalid_input, heif_suberror_End_of_data, "Read beyond file size"};
-          return result.range_end;
-        case heif_reader_grow_status_error: {
-          if (result.reader_error_msg) {
-            std::stringstream sstr;
-            sstr << "Input error (" << result.reader_error_code << ") : " << error_msg;
-            m_last_error = {heif_error_Invalid_input, heif_suberror_Unspecified, sstr.str()};
-          }
-          else {
-            std::stringstream sstr;
-            sstr << "Input error (" << result.reader_error_code << ")";
-            m_last_error = {heif_error_Invalid_input, heif_suberror_Unspecified, sstr.str()};
-          }
-
-          return 0; // error occurred
-        }
-        default:
-          m_last_error = {heif_error_Invalid_input, heif_suberror_Unspecified, "Invalid input reader return value"};
-          return 0;
-      }
-    }
-    else {
-      auto result = m_func_table->wait_for_file_size(end_pos, m_userdata);
-      if (result == heif_reader_grow_status_size_reached) {
-        return end_pos;
-      }
-      else {
-        uint64_t pos = m_func_table->get_position(m_userdata);
-        return bisect_filesize(pos,end_pos);
-      }
-    }
-  }
+  uint64_t request_range(uint64_t start, uint64_t end_pos) override;
 
   uint64_t bisect_filesize(uint64_t mini, uint64_t maxi) {
     // mini - <= filesize
@@ -235,11 +313,7 @@ public:
     }
   }
 
-  void release_range(uint64_t start, uint64_t end_pos) override {
-    if (m_func_table->reader_api_version >= 2) {
-      m_func_table->release_file_range(start, end_pos, m_userdata);
-    }
-  }
+  void release_range(uint64_t start, uint64_t end_pos) override;
 
   void preload_range_hint(uint64_t start, uint64_t end_pos) override {
     if (m_func_table->reader_api_version >= 2) {
@@ -247,9 +321,172 @@ public:
     }
   }
 
+  bool request_range_async(uint64_t start, uint64_t end_pos) override;
+
+  bool request_ranges_async(const std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+                            std::function<void()> on_completed) override;
+
 private:
   const heif_reader* m_func_table;
   void* m_userdata;
+
+  struct AsyncRangeRequest
+  {
+    StreamReader_CApi* reader;
+    uint64_t start;
+    uint64_t end_pos;
+
+    bool completed = false;
+    // Number of request_range() calls waiting for this request. It is not released while there are any.
+    int num_waiting = 0;
+    heif_reader_grow_status status = heif_reader_grow_status_error;
+    uint64_t range_end = 0;
+    int reader_error_code = 0;
+    bool has_error_msg = false;
+    std::string reader_error_msg;
+  };
+
+  static void on_async_range_request_completed(heif_reader_range_request_result result, void* completion_userdata);
+
+  bool has_async_requests() const { return m_func_table->reader_api_version >= 3 && m_func_table->request_range_async; }
+
+  uint64_t convert_range_request_result(heif_reader_grow_status status, uint64_t range_end, uint64_t end_pos,
+                                        int reader_error_code, const std::string* reader_error_msg);
+
+  // Callback of request_ranges_async() that waits for the completion of several requests.
+  struct AsyncRangeWaiter
+  {
+    std::vector<std::shared_ptr<const AsyncRangeRequest>> requests;
+    std::function<void()> on_completed;
+  };
+
+  // Returns the pending or completed request that covers the range. Creates a new request if there is none.
+  // The new request is returned in 'out_new_request' and has to be sent to the reader after releasing m_async_mutex.
+  // m_async_mutex must be locked.
+  std::shared_ptr<AsyncRangeRequest> find_or_add_async_request(uint64_t start, uint64_t end_pos, AsyncRangeRequest** out_new_request);
+
+  // Protects the AsyncRangeRequests, which are completed from the reader's threads.
+  // The requests are shared so that waiting threads keep them alive when the list is modified.
+  std::mutex m_async_mutex;
+  std::condition_variable m_async_completed;
+  std::vector<std::shared_ptr<AsyncRangeRequest>> m_async_requests;
+  std::vector<AsyncRangeWaiter> m_async_waiters;
+};
+
+
+// Serves some file ranges from memory and forwards all other accesses to another StreamReader.
+// This is used to open a file with the header boxes taken from a previously written header index.
+class StreamReader_cached : public StreamReader
+{
+public:
+  struct CachedRange
+  {
+    uint64_t start;
+    std::vector<uint8_t> data;
+  };
+
+  // 'file_size' may be 0 if it is unknown.
+  StreamReader_cached(std::shared_ptr<StreamReader> base, std::vector<CachedRange> ranges, uint64_t file_size);
+
+  uint64_t get_position() const override { return m_position; }
+
+  grow_status wait_for_file_size(uint64_t target_size) override { return m_base->wait_for_file_size(target_size); }
+
+  bool read(void* data, size_t size) override;
+
+  bool seek(uint64_t position) override;
+
+  bool read_at(uint64_t position, void* data, size_t size) override;
+
+  bool has_concurrent_read_at() const override { return m_base->has_concurrent_read_at(); }
+
+  uint64_t request_range(uint64_t start, uint64_t end_pos) override;
+
+  void release_range(uint64_t start, uint64_t end_pos) override { m_base->release_range(start, end_pos); }
+
+  void preload_range_hint(uint64_t start, uint64_t end_pos) override { m_base->preload_range_hint(start, end_pos); }
+
+  bool request_range_async(uint64_t start, uint64_t end_pos) override { return m_base->request_range_async(start, end_pos); }
+
+  bool request_ranges_async(const std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+                            std::function<void()> on_completed) override { return m_base->request_ranges_async(ranges, std::move(on_completed)); }
+
+  const uint8_t* get_direct_data_pointer(uint64_t start, uint64_t end_pos) const override;
+
+private:
+  std::shared_ptr<StreamReader> m_base;
+  std::vector<CachedRange> m_ranges;
+  uint64_t m_file_size;
+  uint64_t m_position = 0;
+
+  // Returns the cached range that contains [start, end_pos) completely, or NULL.
+  const CachedRange* find_range(uint64_t start, uint64_t end_pos) const;
+};
+
+
+// Keeps the data of recently read item data ranges in memory and serves repeated reads of the same
+// data without accessing the underlying StreamReader. Only reads inside the range of the last
+// request_range() call are cached. These are the reads of item data (see Box_iloc::read_data()).
+// A release_range() drops the cached data in the released range.
+class StreamReader_range_cache : public StreamReader
+{
+public:
+  StreamReader_range_cache(std::shared_ptr<StreamReader> base, size_t max_bytes);
+
+  // Setting this to 0 frees all cached data.
+  void set_max_bytes(size_t max_bytes);
+
+  size_t get_cached_bytes() const;
+
+  uint64_t get_position() const override { return m_position; }
+
+  grow_status wait_for_file_size(uint64_t target_size) override { return m_base->wait_for_file_size(target_size); }
+
+  bool read(void* data, size_t size) override;
+
+  bool seek(uint64_t position) override;
+
+  uint64_t request_range(uint64_t start, uint64_t end_pos) override;
+
+  void release_range(uint64_t start, uint64_t end_pos) override;
+
+  void preload_range_hint(uint64_t start, uint64_t end_pos) override { m_base->preload_range_hint(start, end_pos); }
+
+  bool request_range_async(uint64_t start, uint64_t end_pos) override { return m_base->request_range_async(start, end_pos); }
+
+  bool request_ranges_async(const std::vector<std::pair<uint64_t, uint64_t>>& ranges,
+                            std::function<void()> on_completed) override { return m_base->request_ranges_async(ranges, std::move(on_completed)); }
+
+  const uint8_t* get_direct_data_pointer(uint64_t start, uint64_t end_pos) const override { return m_base->get_direct_data_pointer(start, end_pos); }
+
+  // The file structure is read from the base reader directly. Both have to use the same mutex.
+  std::mutex& get_read_mutex() override { return m_base->get_read_mutex(); }
+
+private:
+  struct CachedRange
+  {
+    uint64_t start;
+    std::vector<uint8_t> data;
+  };
+
+  std::shared_ptr<StreamReader> m_base;
+  uint64_t m_position = 0;
+
+  // the range of the last request_range() call
+  uint64_t m_requested_start = 0;
+  uint64_t m_requested_end = 0;
+
+  mutable std::mutex m_mutex;
+  std::list<CachedRange> m_ranges; // most recently used first
+  size_t m_cached_bytes = 0;
+  size_t m_max_bytes;
+
+  // Returns the cached range that contains [start, end_pos) completely and marks it as most recently used.
+  // m_mutex must be locked.
+  const CachedRange* find_range(uint64_t start, uint64_t end_pos);
+
+  // m_mutex must be locked
+  void evict(size_t max_bytes);
 };
 
 
@@ -311,6 +548,19 @@ public:
 
   bool prepare_read(size_t nBytes);
 
+  // Ranges up to this size are buffered by buffer_remaining_data().
+  static const size_t max_buffered_range_size = 64 * 1024 * 1024;
+
+  // Reads the remaining data of the range with a single read from the StreamReader. All following reads
+  // decode the values from this buffer. When the StreamReader holds the file in memory, the data is not copied.
+  // Only use this for boxes without child boxes, since child ranges and get_istream() still access the StreamReader,
+  // which is already positioned at the end of the range.
+  // Does nothing if the range is larger than 'max_size' or the data cannot be read. Reading then continues as usual.
+  void buffer_remaining_data(size_t max_size = max_buffered_range_size);
+
+  // The remaining buffered data (get_remaining_bytes() bytes) or nullptr if the range is not buffered.
+  const uint8_t* get_buffered_data() const { return m_buffer_data; }
+
   StreamReader::grow_status wait_for_available_bytes(size_t nBytes);
 
   void skip_to_end_of_file()
@@ -328,6 +578,12 @@ public:
   {
     size_t actual_skip = std::min(static_cast<size_t>(n), m_remaining);
 
+    if (m_buffer_data) {
+      m_buffer_data += actual_skip;
+      m_remaining -= actual_skip;
+      return;
+    }
+
     if (m_parent_range) {
       // also advance position in parent range
       m_parent_range->skip_without_advancing_file_pos(actual_skip);
@@ -341,7 +597,10 @@ public:
 
   void skip_to_end_of_box()
   {
-    if (m_remaining > 0) {
+    if (m_buffer_data) {
+      m_remaining = 0;
+    }
+    else if (m_remaining > 0) {
       if (m_parent_range) {
         // also advance position in parent range
         m_parent_range->skip_without_advancing_file_pos(m_remaining);
@@ -398,8 +657,16 @@ private:
   size_t m_remaining;
   bool m_error = false;
 
+  // --- buffered data (see buffer_remaining_data())
+
+  const uint8_t* m_buffer_data = nullptr; // next byte to read. m_remaining bytes are left.
+  std::vector<uint8_t> m_buffer; // only used when the StreamReader does not provide direct access to the data
+
   // Note: 'nBytes' may not be larger than the number of remaining bytes
   void skip_without_advancing_file_pos(size_t nBytes);
+
+  // Reads from the buffer or from the StreamReader and sets the error flag when there is not enough data.
+  bool read_bytes(void* data, size_t n);
 };
 
 
@@ -425,7 +692,12 @@ public:
    */
   bool get_flag();
 
-  std::vector<uint8_t> read_bytes(uint32_t n);
+  /**
+   * Read n bytes without copying them.
+   * Only valid at a byte boundary. The returned span points into the input buffer
+   * and is shorter than n if not enough data is left.
+   */
+  std::span<const uint8_t> read_bytes(uint32_t n);
 
   int get_bits_fast(int n);
 
@@ -453,6 +725,14 @@ public:
     return ((int64_t) bytes_remaining) * 8 + nextbits_cnt;
   }
 
+  bool is_at_byte_boundary() const { return (nextbits_cnt & 7) == 0; }
+
+  // Only valid at a byte boundary.
+  const uint8_t* get_current_byte_pointer() const { return data - nextbits_cnt / 8; }
+
+  // Only valid at a byte boundary.
+  int get_bytes_remaining() const { return bytes_remaining + nextbits_cnt / 8; }
+
 private:
   const uint8_t* data;
   int data_length;
@@ -462,6 +742,8 @@ private:
   int nextbits_cnt;
 
   void refill(); // refill to at least 56+1 bits
+
+  void refill_bytewise();
 };
 
 
@@ -494,10 +776,17 @@ public:
 
   void write(const std::vector<uint8_t>&);
 
+  void write(const uint8_t* data, size_t size);
+
   void write(const StreamWriter&);
 
   void skip(int n);
 
+  // Preallocates memory for a stream of 'size' bytes. This does not change the data size.
+  void reserve(size_t size) { m_data.reserve(size); }
+
+  // Moves the data behind the current position. This is only used for the rare case that a box header
+  // has to be enlarged to a 64-bit size.
   void insert(int nBytes);
 
   size_t data_size() const { return m_data.size(); }
@@ -508,11 +797,36 @@ public:
 
   void set_position_to_end() { m_position = m_data.size(); }
 
-  const std::vector<uint8_t> get_data() const { return m_data; }
+  const std::vector<uint8_t>& get_data() const { return m_data; }
 
 private:
   std::vector<uint8_t> m_data;
   size_t m_position = 0;
 };
 
+
+class BitWriter
+{
+public:
+  // Writes the 'n' lowest bits of 'value', MSB first.
+  void write_bits(uint32_t value, int n);
+
+  void write_flag(bool flag) { write_bits(flag ? 1 : 0, 1); }
+
+  // Fills the current byte with zero bits.
+  void skip_to_byte_boundary();
+
+  // Only valid at a byte boundary.
+  void write_bytes(const std::vector<uint8_t>& data);
+
+  // The incomplete last byte is included only after skip_to_byte_boundary().
+  const std::vector<uint8_t>& get_data() const { return m_data; }
+
+private:
+  std::vector<uint8_t> m_data;
+
+  uint8_t m_current_byte = 0;
+  int m_current_bits = 0; // number of bits already written into m_current_byte
+};
+
 #endif
@@ -32,6 +32,7 @@
 #include "codecs/avif_boxes.h"
 #include "image-items/tiled.h"
 #include "sequences/seq_boxes.h"
+#include "box_arena.h"
 
 #include <iomanip>
 #include <utility>
@@ -52,13 +53,6 @@
 #define M_PI 3.14159265358979323846
 #endif
 
-#if !defined(_WIN32)
-#include <unistd.h>
-#else
-#include <fcntl.h>
-#include <io.h>
-#endif
-
 
 Fraction::Fraction(int32_t num, int32_t den)
 {
@@ -273,11 +267,9 @@ Error BoxHeader::parse_header(BitstreamRange& range)
                    heif_suberror_End_of_data);
     }
 
-    if (range.prepare_read(16)) {
-      m_uuid_type.resize(16);
-      bool success = range.get_istream()->read((char*) m_uuid_type.data(), 16);
-      assert(success);
-      (void) success;
+    m_uuid_type.resize(16);
+    if (!range.read(m_uuid_type.data(), 16)) {
+      m_uuid_type.clear();
     }
 
     m_header_size += 16;
@@ -466,274 +458,274 @@ Error Box::read(BitstreamRange& range, std::shared_ptr<Box>* result, const heif_
 
   switch (hdr.get_short_type()) {
     case fourcc("ftyp"):
-      box = std::make_shared<Box_ftyp>();
+      box = make_box<Box_ftyp>();
       break;
 
     case fourcc("free"):
     case fourcc("skip"):
-      box = std::make_shared<Box_free>();
+      box = make_box<Box_free>();
       break;
 
     case fourcc("meta"):
-      box = std::make_shared<Box_meta>();
+      box = make_box<Box_meta>();
       break;
 
     case fourcc("hdlr"):
-      box = std::make_shared<Box_hdlr>();
+      box = make_box<Box_hdlr>();
       break;
 
     case fourcc("pitm"):
-      box = std::make_shared<Box_pitm>();
+      box = make_box<Box_pitm>();
       break;
 
     case fourcc("iloc"):
-      box = std::make_shared<Box_iloc>();
+      box = make_box<Box_iloc>();
       break;
 
     case fourcc("iinf"):
-      box = std::make_shared<Box_iinf>();
+      box = make_box<Box_iinf>();
       break;
 
     case fourcc("infe"):
-      box = std::make_shared<Box_infe>();
+      box = make_box<Box_infe>();
       break;
 
     case fourcc("iprp"):
-      box = std::make_shared<Box_iprp>();
+      box = make_box<Box_iprp>();
       break;
 
     case fourcc("ipco"):
-      box = std::make_shared<Box_ipco>();
+      box = make_box<Box_ipco>();
       break;
 
     case fourcc("ipma"):
-      box = std::make_shared<Box_ipma>();
+      box = make_box<Box_ipma>();
       break;
 
     case fourcc("ispe"):
-      box = std::make_shared<Box_ispe>();
+      box = make_box<Box_ispe>();
       break;
 
     case fourcc("auxC"):
-      box = std::make_shared<Box_auxC>();
+      box = make_box<Box_auxC>();
       break;
 
     case fourcc("irot"):
-      box = std::make_shared<Box_irot>();
+      box = make_box<Box_irot>();
       break;
 
     case fourcc("imir"):
-      box = std::make_shared<Box_imir>();
+      box = make_box<Box_imir>();
       break;
 
     case fourcc("clap"):
-      box = std::make_shared<Box_clap>();
+      box = make_box<Box_clap>();
       break;
 
     case fourcc("iref"):
-      box = std::make_shared<Box_iref>();
+      box = make_box<Box_iref>();
       break;
 
     case fourcc("hvcC"):
-      box = std::make_shared<Box_hvcC>();
+      box = make_box<Box_hvcC>();
       break;
 
     case fourcc("hvc1"):
-      box = std::make_shared<Box_hvc1>();
+      box = make_box<Box_hvc1>();
       break;
 
     case fourcc("av1C"):
-      box = std::make_shared<Box_av1C>();
+      box = make_box<Box_av1C>();
       break;
 
     case fourcc("av01"):
-      box = std::make_shared<Box_av01>();
+      box = make_box<Box_av01>();
       break;
 
     case fourcc("vvcC"):
-      box = std::make_shared<Box_vvcC>();
+      box = make_box<Box_vvcC>();
       break;
 
     case fourcc("vvc1"):
-      box = std::make_shared<Box_vvc1>();
+      box = make_box<Box_vvc1>();
       break;
 
     case fourcc("idat"):
-      box = std::make_shared<Box_idat>();
+      box = make_box<Box_idat>();
       break;
 
     case fourcc("grpl"):
-      box = std::make_shared<Box_grpl>();
+      box = make_box<Box_grpl>();
       break;
 
     case fourcc("pymd"):
-      box = std::make_shared<Box_pymd>();
+      box = make_box<Box_pymd>();
       break;
 
     case fourcc("altr"):
-      box = std::make_shared<Box_EntityToGroup>();
+      box = make_box<Box_EntityToGroup>();
       break;
 
     case fourcc("ster"):
-      box = std::make_shared<Box_ster>();
+      box = make_box<Box_ster>();
       break;
 
     case fourcc("dinf"):
-      box = std::make_shared<Box_dinf>();
+      box = make_box<Box_dinf>();
       break;
 
     case fourcc("dref"):
-      box = std::make_shared<Box_dref>();
+      box = make_box<Box_dref>();
       break;
 
     case fourcc("url "):
-      box = std::make_shared<Box_url>();
+      box = make_box<Box_url>();
       break;
 
     case fourcc("colr"):
-      box = std::make_shared<Box_colr>();
+      box = make_box<Box_colr>();
       break;
 
     case fourcc("pixi"):
-      box = std::make_shared<Box_pixi>();
+      box = make_box<Box_pixi>();
       break;
 
     case fourcc("pasp"):
-      box = std::make_shared<Box_pasp>();
+      box = make_box<Box_pasp>();
       break;
 
     case fourcc("lsel"):
-      box = std::make_shared<Box_lsel>();
+      box = make_box<Box_lsel>();
       break;
 
     case fourcc("a1op"):
-      box = std::make_shared<Box_a1op>();
+      box = make_box<Box_a1op>();
       break;
 
     case fourcc("a1lx"):
-      box = std::make_shared<Box_a1lx>();
+      box = make_box<Box_a1lx>();
       break;
 
     case fourcc("clli"):
-      box = std::make_shared<Box_clli>();
+      box = make_box<Box_clli>();
       break;
 
     case fourcc("mdcv"):
-      box = std::make_shared<Box_mdcv>();
+      box = make_box<Box_mdcv>();
       break;
 
     case fourcc("amve"):
-      box = std::make_shared<Box_amve>();
+      box = make_box<Box_amve>();
       break;
 
     case fourcc("cmin"):
-      box = std::make_shared<Box_cmin>();
+      box = make_box<Box_cmin>();
       break;
 
     case fourcc("cmex"):
-      box = std::make_shared<Box_cmex>();
+      box = make_box<Box_cmex>();
       break;
 
     case fourcc("udes"):
-      box = std::make_shared<Box_udes>();
+      box = make_box<Box_udes>();
       break;
 
     case fourcc("jpgC"):
-      box = std::make_shared<Box_jpgC>();
+      box = make_box<Box_jpgC>();
       break;
 
     case fourcc("mjpg"):
-      box = std::make_shared<Box_mjpg>();
+      box = make_box<Box_mjpg>();
       break;
 
 #if WITH_UNCOMPRESSED_CODEC
     case fourcc("cmpd"):
-      box = std::make_shared<Box_cmpd>();
+      box = make_box<Box_cmpd>();
       break;
 
     case fourcc("uncC"):
-      box = std::make_shared<Box_uncC>();
+      box = make_box<Box_uncC>();
       break;
 
     case fourcc("cmpC"):
-      box = std::make_shared<Box_cmpC>();
+      box = make_box<Box_cmpC>();
       break;
 
     case fourcc("icef"):
-      box = std::make_shared<Box_icef>();
+      box = make_box<Box_icef>();
       break;
 
     case fourcc("cpat"):
-      box = std::make_shared<Box_cpat>();
+      box = make_box<Box_cpat>();
       break;
 
     case fourcc("uncv"):
-      box = std::make_shared<Box_uncv>();
+      box = make_box<Box_uncv>();
       break;
 #endif
 
     // --- JPEG 2000
 
     case fourcc("j2kH"):
-      box = std::make_shared<Box_j2kH>();
+      box = make_box<Box_j2kH>();
       break;
 
     case fourcc("cdef"):
-      box = std::make_shared<Box_cdef>();
+      box = make_box<Box_cdef>();
       break;
 
     case fourcc("cmap"):
-      box = std::make_shared<Box_cmap>();
+      box = make_box<Box_cmap>();
       break;
 
     case fourcc("pclr"):
-      box = std::make_shared<Box_pclr>();
+      box = make_box<Box_pclr>();
       break;
 
     case fourcc("j2kL"):
-      box = std::make_shared<Box_j2kL>();
+      box = make_box<Box_j2kL>();
       break;
 
     case fourcc("j2ki"):
-      box = std::make_shared<Box_j2ki>();
+      box = make_box<Box_j2ki>();
       break;
 
 
     // --- mski
 
     case fourcc("mskC"):
-      box = std::make_shared<Box_mskC>();
+      box = make_box<Box_mskC>();
       break;
 
     // --- TAI timestamps
 
     case fourcc("itai"):
-      box = std::make_shared<Box_itai>();
+      box = make_box<Box_itai>();
       break;
 
     case fourcc("taic"):
-      box = std::make_shared<Box_taic>();
+      box = make_box<Box_taic>();
       break;
 
     // --- AVC (H.264)
 
     case fourcc("avcC"):
-      box = std::make_shared<Box_avcC>();
+      box = make_box<Box_avcC>();
       break;
 
     case fourcc("avc1"):
-      box = std::make_shared<Box_avc1>();
+      box = make_box<Box_avc1>();
       break;
 
 #if HEIF_ENABLE_EXPERIMENTAL_FEATURES
     case fourcc("tilC"):
-      box = std::make_shared<Box_tilC>();
+      box = make_box<Box_tilC>();
       break;
 #endif
 
 #if ENABLE_EXPERIMENTAL_MINI_FORMAT
     case fourcc("mini"):
-      box = std::make_shared<Box_mini>();
+      box = make_box<Box_mini>();
       break;
 #endif
 
@@ -744,120 +736,158 @@ Error Box::read(BitstreamRange& range, std::shared_ptr<Box>* result, const heif_
 
     case fourcc("uuid"):
       if (hdr.get_uuid_type() == std::vector<uint8_t>{0x22, 0xcc, 0x04, 0xc7, 0xd6, 0xd9, 0x4e, 0x07, 0x9d, 0x90, 0x4e, 0xb6, 0xec, 0xba, 0xf3, 0xa3}) {
-        box = std::make_shared<Box_cmin>();
+        box = make_box<Box_cmin>();
       }
       else if (hdr.get_uuid_type() == std::vector<uint8_t>{0x43, 0x63, 0xe9, 0x14, 0x5b, 0x7d, 0x4a, 0xab, 0x97, 0xae, 0xbe, 0xa6, 0x98, 0x03, 0xb4, 0x34}) {
-        box = std::make_shared<Box_cmex>();
+        box = make_box<Box_cmex>();
       }
       else {
-        box = std::make_shared<Box_other>(hdr.get_short_type());
+        box = make_box<Box_other>(hdr.get_short_type());
       }
       break;
 
     // --- sequences
 
     case fourcc("moov"):
-      box = std::make_shared<Box_moov>();
+      box = make_box<Box_moov>();
       break;
 
     case fourcc("mvhd"):
-      box = std::make_shared<Box_mvhd>();
+      box = make_box<Box_mvhd>();
       break;
 
     case fourcc("trak"):
-      box = std::make_shared<Box_trak>();
+      box = make_box<Box_trak>();
       break;
 
     case fourcc("tkhd"):
-      box = std::make_shared<Box_tkhd>();
+      box = make_box<Box_tkhd>();
       break;
 
     case fourcc("mdia"):
-      box = std::make_shared<Box_mdia>();
+      box = make_box<Box_mdia>();
       break;
 
     case fourcc("mdhd"):
-      box = std::make_shared<Box_mdhd>();
+      box = make_box<Box_mdhd>();
       break;
 
     case fourcc("minf"):
-      box = std::make_shared<Box_minf>();
+      box = make_box<Box_minf>();
       break;
 
     case fourcc("vmhd"):
-      box = std::make_shared<Box_vmhd>();
+      box = make_box<Box_vmhd>();
       break;
 
     case fourcc("stbl"):
-      box = std::make_shared<Box_stbl>();
+      box = make_box<Box_stbl>();
       break;
 
     case fourcc("stsd"):
-      box = std::make_shared<Box_stsd>();
+      box = make_box<Box_stsd>();
       break;
 
     case fourcc("stts"):
-      box = std::make_shared<Box_stts>();
+      box = make_box<Box_stts>();
+      break;
+
+    case fourcc("ctts"):
+      box = make_box<Box_ctts>();
       break;
 
     case fourcc("stsc"):
-      box = std::make_shared<Box_stsc>();
+      box = make_box<Box_stsc>();
       break;
 
     case fourcc("stco"):
-      box = std::make_shared<Box_stco>();
+    case fourcc("co64"):
+      box = make_box<Box_stco>();
       break;
 
     case fourcc("stsz"):
-      box = std::make_shared<Box_stsz>();
+    case fourcc("stz2"):
+      box = make_box<Box_stsz>();
       break;
 
     case fourcc("stss"):
-      box = std::make_shared<Box_stss>();
+      box = make_box<Box_stss>();
       break;
 
     case fourcc("ccst"):
-      box = std::make_shared<Box_ccst>();
+      box = make_box<Box_ccst>();
       break;
 
     case fourcc("sbgp"):
-      box = std::make_shared<Box_sbgp>();
+      box = make_box<Box_sbgp>();
       break;
 
     case fourcc("sgpd"):
-      box = std::make_shared<Box_sgpd>();
+      box = make_box<Box_sgpd>();
       break;
 
     case fourcc("btrt"):
-      box = std::make_shared<Box_btrt>();
+      box = make_box<Box_btrt>();
       break;
 
     case fourcc("saiz"):
-      box = std::make_shared<Box_saiz>();
+      box = make_box<Box_saiz>();
       break;
 
     case fourcc("saio"):
-      box = std::make_shared<Box_saio>();
+      box = make_box<Box_saio>();
       break;
 
     case fourcc("urim"):
-      box = std::make_shared<Box_URIMetaSampleEntry>();
+      box = make_box<Box_URIMetaSampleEntry>();
       break;
 
     case fourcc("uri "):
-      box = std::make_shared<Box_uri>();
+      box = make_box<Box_uri>();
       break;
 
     case fourcc("nmhd"):
-      box = std::make_shared<Box_nmhd>();
+      box = make_box<Box_nmhd>();
       break;
 
     case fourcc("tref"):
-      box = std::make_shared<Box_tref>();
+      box = make_box<Box_tref>();
+      break;
+
+    case fourcc("mvex"):
+      box = make_box<Box_mvex>();
+      break;
+
+    case fourcc("trex"):
+      box = make_box<Box_trex>();
+      break;
+
+    case fourcc("moof"):
+      box = make_box<Box_moof>();
+      break;
+
+    case fourcc("mfhd"):
+      box = make_box<Box_mfhd>();
+      break;
+
+    case fourcc("traf"):
+      box = make_box<Box_traf>();
+      break;
+
+    case fourcc("tfhd"):
+      box = make_box<Box_tfhd>();
+      break;
+
+    case fourcc("tfdt"):
+      box = make_box<Box_tfdt>();
+      break;
+
+    case fourcc("trun"):
+      box = make_box<Box_trun>();
       break;
 
     default:
-      box = std::make_shared<Box_other>(hdr.get_short_type());
+      box = make_box<Box_other>(hdr.get_short_type());
       break;
   }
 
@@ -935,7 +965,7 @@ Error Box::read(BitstreamRange& range, std::shared_ptr<Box>* result, const heif_
   else {
     parse_error_fatality fatality = box->get_parse_error_fatality();
 
-    box = std::make_shared<Box_Error>(box->get_short_type(), err, fatality);
+    box = make_box<Box_Error>(box->get_short_type(), err, fatality);
 
     // We return a Box_Error that represents the parse error.
     *result = std::move(box);
@@ -1493,6 +1523,8 @@ Error Box_pitm::write(StreamWriter& writer) const
 
 Error Box_iloc::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_version() > 2) {
@@ -1625,7 +1657,7 @@ Error Box_iloc::parse(BitstreamRange& range, const heif_security_limits* limits)
     }
 
     if (!range.error()) {
-      m_items.push_back(item);
+      append_item(item);
     }
   }
 
@@ -1636,37 +1668,6 @@ Error Box_iloc::parse(BitstreamRange& range, const heif_security_limits* limits)
 Box_iloc::Box_iloc()
 {
   set_short_type(fourcc("iloc"));
-
-  set_use_tmp_file(false);
-}
-
-
-Box_iloc::~Box_iloc()
-{
-  if (m_use_tmpfile) {
-    unlink(m_tmp_filename);
-  }
-}
-
-
-void Box_iloc::set_use_tmp_file(bool flag)
-{
-  m_use_tmpfile = flag;
-  if (flag) {
-#if !defined(_WIN32)
-    strcpy(m_tmp_filename, "/tmp/libheif-XXXXXX");
-    m_tmpfile_fd = mkstemp(m_tmp_filename);
-#else
-    // TODO Currently unused code. Implement when needed.
-    assert(false);
-#  if 0
-    char tmpname[L_tmpnam_s];
-    // TODO: check return value (errno_t)
-    tmpnam_s(tmpname, L_tmpnam_s);
-    _sopen_s(&m_tmpfile_fd, tmpname, _O_CREAT | _O_TEMPORARY | _O_TRUNC | _O_RDWR, _SH_DENYRW, _S_IREAD | _S_IWRITE);
-#  endif
-#endif
-  }
 }
 
 
@@ -1697,6 +1698,48 @@ std::string Box_iloc::dump(Indent& indent) const
 }
 
 
+void Box_iloc::append_item(Item& item)
+{
+  m_item_index.emplace(item.item_ID, m_items.size());
+  m_items.push_back(item);
+}
+
+
+void Box_iloc::set_items(std::vector<Item> items)
+{
+  m_items = std::move(items);
+
+  m_item_index.clear();
+  for (size_t i = 0; i < m_items.size(); i++) {
+    m_item_index.emplace(m_items[i].item_ID, i);
+  }
+}
+
+
+void Box_iloc::remove_item(heif_item_id item_id)
+{
+  std::vector<Item> items;
+  for (auto& item : m_items) {
+    if (item.item_ID != item_id) {
+      items.push_back(std::move(item));
+    }
+  }
+
+  set_items(std::move(items));
+}
+
+
+const Box_iloc::Item* Box_iloc::find_item(heif_item_id item_id) const
+{
+  auto iter = m_item_index.find(item_id);
+  if (iter == m_item_index.end()) {
+    return nullptr;
+  }
+
+  return &m_items[iter->second];
+}
+
+
 Error Box_iloc::read_data(heif_item_id item,
                           const std::shared_ptr<StreamReader>& istr,
                           const std::shared_ptr<Box_idat>& idat,
@@ -1714,13 +1757,7 @@ Error Box_iloc::read_data(heif_item_id item_id,
                           uint64_t offset, uint64_t size,
                           const heif_security_limits* limits) const
 {
-  const Item* item = nullptr;
-  for (auto& i : m_items) {
-    if (i.item_ID == item_id) {
-      item = &i;
-      break;
-    }
-  }
+  const Item* item = find_item(item_id);
 
   if (!item) {
     std::stringstream sstr;
@@ -1731,12 +1768,6 @@ Error Box_iloc::read_data(heif_item_id item_id,
                  sstr.str());
   }
 
-#if ENABLE_MULTITHREADING_SUPPORT
-  static std::mutex read_mutex;
-
-  std::lock_guard<std::mutex> lock(read_mutex);
-#endif
-
   bool limited_size = (size != std::numeric_limits<uint64_t>::max());
 
 
@@ -1744,20 +1775,152 @@ Error Box_iloc::read_data(heif_item_id item_id,
   //       the image data is concatenated with data in a configuration box. However, it seems that
   //       this function clears the array in some cases. This should be corrected.
 
-  for (const auto& extent : item->extents) {
-    if (item->construction_method == 0) {
+  if (item->construction_method == 0) {
+    Error err = read_file_data(*item, istr, dest, offset, size, limits);
+    if (err) {
+      return err;
+    }
+  }
+  else {
+    for (const auto& extent : item->extents) {
+      if (item->construction_method == 1) {
+        if (!idat) {
+          return {heif_error_Invalid_input,
+                  heif_suberror_No_idat_box,
+                  "idat box referenced in iref box is not present in file"};
+        }
 
-      // --- make sure that all data is available
+        {
+#if ENABLE_MULTITHREADING_SUPPORT
+          std::lock_guard<std::mutex> lock(istr->get_read_mutex());
+#endif
 
-      if (extent.offset > MAX_FILE_POS ||
-          item->base_offset > MAX_FILE_POS ||
-          extent.length > MAX_FILE_POS) {
-        return {heif_error_Invalid_input,
-                heif_suberror_Security_limit_exceeded,
-                "iloc data pointers out of allowed range"};
+          idat->read_data(istr,
+                          extent.offset + item->base_offset,
+                          extent.length,
+                          *dest, limits);
+        }
+
+        size -= extent.length;
+      }
+      else {
+        std::stringstream sstr;
+        sstr << "Item construction method " << (int) item->construction_method << " not implemented";
+        return {heif_error_Unsupported_feature,
+                heif_suberror_Unsupported_item_construction_method,
+                sstr.str()};
       }
+    }
+  }
+
+  // --- we could not read all data
+
+  if (limited_size && size > 0) {
+    return {heif_error_Invalid_input,
+            heif_suberror_End_of_data,
+            "Not enough data present in 'iloc' to satisfy request."};
+  }
+
+  return Error::Ok;
+}
+
+
+Error Box_iloc::read_file_data(const Item& item,
+                               const std::shared_ptr<StreamReader>& istr,
+                               std::vector<uint8_t>* dest,
+                               uint64_t offset, uint64_t& size,
+                               const heif_security_limits* limits) const
+{
+  // --- determine which parts of the extents have to be read
 
-      StreamReader::grow_status status = istr->wait_for_file_size(extent.offset + item->base_offset + extent.length);
+  struct ExtentRead
+  {
+    uint64_t file_pos;
+    uint64_t length;
+  };
+
+  std::vector<ExtentRead> extent_reads;
+  uint64_t total_read_len = 0;
+
+  for (const auto& extent : item.extents) {
+    if (extent.offset > MAX_FILE_POS ||
+        item.base_offset > MAX_FILE_POS ||
+        extent.length > MAX_FILE_POS) {
+      return {heif_error_Invalid_input,
+              heif_suberror_Security_limit_exceeded,
+              "iloc data pointers out of allowed range"};
+    }
+
+    // skip to reading offset
+
+    uint64_t skip_len = std::min(offset, extent.length);
+    offset -= skip_len;
+
+    uint64_t read_len = std::min(extent.length - skip_len, size);
+
+    if (offset > 0) {
+      continue;
+    }
+
+    if (read_len == 0) {
+      continue;
+    }
+
+    // --- security check that we do not allocate too much memory
+
+    auto max_memory_block_size = limits->max_memory_block_size;
+    if (max_memory_block_size && max_memory_block_size - dest->size() - total_read_len < read_len) {
+      std::stringstream sstr;
+      sstr << "iloc box contained " << extent.length << " bytes, total memory size would be "
+           << (dest->size() + total_read_len + extent.length) << " bytes, exceeding the security limit of "
+           << max_memory_block_size << " bytes";
+
+      return {heif_error_Memory_allocation_error,
+              heif_suberror_Security_limit_exceeded,
+              sstr.str()};
+    }
+
+    extent_reads.push_back({extent.offset + item.base_offset + skip_len, read_len});
+    total_read_len += read_len;
+    size -= read_len;
+  }
+
+  // --- read the extents. Extents that follow each other closely are read as one block.
+
+  for (size_t first = 0; first < extent_reads.size();) {
+    uint64_t block_start = extent_reads[first].file_pos;
+    uint64_t block_end = block_start + extent_reads[first].length;
+    uint64_t block_data_len = extent_reads[first].length;
+
+    size_t last = first + 1;
+    for (; last < extent_reads.size(); last++) {
+      const ExtentRead& next = extent_reads[last];
+      if (next.file_pos < block_end || next.file_pos - block_end > m_max_read_gap) {
+        break;
+      }
+
+      // the gaps are also held in memory
+      uint64_t new_block_end = next.file_pos + next.length;
+      if (limits->max_memory_block_size && new_block_end - block_start > limits->max_memory_block_size) {
+        break;
+      }
+
+      block_end = new_block_end;
+      block_data_len += next.length;
+    }
+
+    {
+      // Only the file size and range requests are serialized. The data itself is read with read_at(),
+      // which does not block other threads if the reader supports concurrent reads.
+
+#if ENABLE_MULTITHREADING_SUPPORT
+      std::lock_guard<std::mutex> lock(istr->get_read_mutex());
+#endif
+
+      // Only wait for the part of the extent that is read. This allows reading the beginning of
+      // an item while the rest of the file is still being loaded.
+
+      StreamReader::grow_status status = istr->wait_for_file_size(block_end);
       if (status == StreamReader::grow_status::size_beyond_eof) {
         // Out-of-bounds
         // TODO: I think we should not clear this. Maybe we want to try reading again later and
@@ -1766,7 +1929,7 @@ Error Box_iloc::read_data(heif_item_id item_id,
 
         std::stringstream sstr;
         sstr << "Extent in iloc box references data outside of file bounds "
-             << "(points to file position " << extent.offset + item->base_offset << ")\n";
+             << "(points to file position " << block_start << ")\n";
 
         return {heif_error_Invalid_input,
                 heif_suberror_End_of_data,
@@ -1778,101 +1941,121 @@ Error Box_iloc::read_data(heif_item_id item_id,
                 heif_suberror_End_of_data};
       }
 
+      // --- request file range
 
-      // skip to reading offset
+      uint64_t rangeRequestEndPos = istr->request_range(block_start, block_end);
+      if (rangeRequestEndPos == 0) {
+        return istr->get_error();
+      }
+    }
 
-      uint64_t skip_len = std::min(offset, extent.length);
-      offset -= skip_len;
+    // --- read data
 
-      uint64_t read_len = std::min(extent.length - skip_len, size);
+    size_t old_size = dest->size();
+    bool success;
 
-      if (offset > 0) {
-        continue;
+    if (block_end - block_start == block_data_len) {
+      // no gaps, read directly into the output
+      dest->resize(static_cast<size_t>(old_size + block_data_len));
+      success = istr->read_at(block_start, dest->data() + old_size, static_cast<size_t>(block_data_len));
+    }
+    else {
+      std::vector<uint8_t> block(static_cast<size_t>(block_end - block_start));
+      success = istr->read_at(block_start, block.data(), block.size());
+      if (success) {
+        dest->reserve(static_cast<size_t>(old_size + block_data_len));
+        for (size_t i = first; i < last; i++) {
+          auto src = block.begin() + static_cast<ptrdiff_t>(extent_reads[i].file_pos - block_start);
+          dest->insert(dest->end(), src, src + static_cast<ptrdiff_t>(extent_reads[i].length));
+        }
       }
+    }
 
-      if (read_len == 0) {
-        continue;
-      }
+    if (!success) {
+      return {heif_error_Invalid_input,
+              heif_suberror_Unspecified,
+              "Error reading input file"};
+    }
 
-      size_t old_size = dest->size();
+    first = last;
+  }
 
-      // --- security check that we do not allocate too much memory
+  return Error::Ok;
+}
 
-      auto max_memory_block_size = limits->max_memory_block_size;
-      if (max_memory_block_size && max_memory_block_size - old_size < read_len) {
-        std::stringstream sstr;
-        sstr << "iloc box contained " << extent.length << " bytes, total memory size would be "
-             << (old_size + extent.length) << " bytes, exceeding the security limit of "
-             << max_memory_block_size << " bytes";
 
-        return {heif_error_Memory_allocation_error,
-                heif_suberror_Security_limit_exceeded,
-                sstr.str()};
-      }
+const uint8_t* Box_iloc::get_direct_data_pointer(heif_item_id item_id,
+                                                 const std::shared_ptr<StreamReader>& istr,
+                                                 uint64_t* out_size) const
+{
+  const Item* item = find_item(item_id);
 
+  if (!item || item->construction_method != 0 || item->extents.empty()) {
+    return nullptr;
+  }
 
-      // --- request file range
+  if (item->base_offset > MAX_FILE_POS) {
+    return nullptr;
+  }
 
-      uint64_t data_start_pos = extent.offset + item->base_offset + skip_len;
-      uint64_t rangeRequestEndPos = istr->request_range(data_start_pos, data_start_pos + read_len);
-      if (rangeRequestEndPos == 0) {
-        return istr->get_error();
-      }
+  // --- all extents have to follow each other without gaps
 
-      // --- move file pointer to start of data
+  uint64_t start = item->extents[0].offset;
+  uint64_t end = start;
 
-      bool success = istr->seek(data_start_pos);
-      if (!success) {
-        return {heif_error_Invalid_input,
-                heif_suberror_Unspecified,
-                "Error setting input file position"};
-      }
+  for (const auto& extent : item->extents) {
+    if (extent.offset > MAX_FILE_POS ||
+        extent.length > MAX_FILE_POS ||
+        extent.offset != end) {
+      return nullptr;
+    }
 
+    end += extent.length;
+  }
 
-      // --- read data
+  if (end == start || end > MAX_FILE_POS) {
+    return nullptr;
+  }
 
-      dest->resize(static_cast<size_t>(old_size + read_len));
-      success = istr->read((char*) dest->data() + old_size, static_cast<size_t>(read_len));
-      if (!success) {
-        return {heif_error_Invalid_input,
-                heif_suberror_Unspecified,
-                "Error reading input file"};
-      }
+  const uint8_t* data = istr->get_direct_data_pointer(start + item->base_offset, end + item->base_offset);
+  if (data) {
+    *out_size = end - start;
+  }
 
-      size -= read_len;
-    }
-    else if (item->construction_method == 1) {
-      if (!idat) {
-        return {heif_error_Invalid_input,
-                heif_suberror_No_idat_box,
-                "idat box referenced in iref box is not present in file"};
-      }
+  return data;
+}
+
+
+void Box_iloc::get_file_ranges(heif_item_id item_id, uint64_t offset, uint64_t size,
+                               std::vector<std::pair<uint64_t, uint64_t>>& out_ranges) const
+{
+  const Item* item = find_item(item_id);
 
-      idat->read_data(istr,
-                      extent.offset + item->base_offset,
-                      extent.length,
-                      *dest, limits);
+  if (!item || item->construction_method != 0 || item->base_offset > MAX_FILE_POS) {
+    return;
+  }
 
-      size -= extent.length;
+  for (const auto& extent : item->extents) {
+    if (size == 0) {
+      break;
     }
-    else {
-      std::stringstream sstr;
-      sstr << "Item construction method " << (int) item->construction_method << " not implemented";
-      return {heif_error_Unsupported_feature,
-              heif_suberror_Unsupported_item_construction_method,
-              sstr.str()};
+
+    if (extent.offset > MAX_FILE_POS || extent.length > MAX_FILE_POS) {
+      return;
     }
-  }
 
-  // --- we could not read all data
+    if (offset >= extent.length) {
+      offset -= extent.length;
+      continue;
+    }
 
-  if (limited_size && size > 0) {
-    return {heif_error_Invalid_input,
-            heif_suberror_End_of_data,
-            "Not enough data present in 'iloc' to satisfy request."};
-  }
+    uint64_t len = std::min(extent.length - offset, size);
+    uint64_t start = item->base_offset + extent.offset + offset;
+    out_ranges.emplace_back(start, start + len);
 
-  return Error::Ok;
+    offset = 0;
+    size -= len;
+  }
 }
 
 
@@ -1880,121 +2063,125 @@ Error Box_iloc::append_data(heif_item_id item_ID,
                             const std::vector<uint8_t>& data,
                             uint8_t construction_method)
 {
+  if (construction_method != 1) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Only 'idat' data can be stored in the iloc box"};
+  }
+
   // check whether this item ID already exists
 
   size_t idx;
-  for (idx = 0; idx < m_items.size(); idx++) {
-    if (m_items[idx].item_ID == item_ID) {
-      break;
-    }
+  auto iter = m_item_index.find(item_ID);
+  if (iter != m_item_index.end()) {
+    idx = iter->second;
   }
+  else {
+    // item does not exist -> add a new one to the end
 
-  // item does not exist -> add a new one to the end
+    idx = m_items.size();
 
-  if (idx == m_items.size()) {
     Item item;
     item.item_ID = item_ID;
     item.construction_method = construction_method;
 
-    m_items.push_back(item);
+    append_item(item);
   }
 
   if (m_items[idx].construction_method != construction_method) {
-    // TODO: return error: construction methods do not match
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Item data is stored with different construction methods"};
   }
 
-  Extent extent;
-  extent.length = data.size();
+  auto& extents = m_items[idx].extents;
 
-  if (m_use_tmpfile && construction_method==0) {
-#if !defined(_WIN32)
-    ssize_t cnt = ::write(m_tmpfile_fd, data.data(), data.size());
-#else
-    // TODO Currently unused code. Implement when needed.
-    assert(false);
-#  if 0
-    int cnt = _write(m_tmpfile_fd, data.data(), data.size());
-#  else
-    int cnt = -1;
-#  endif
-#endif
-    if (cnt < 0) {
-      std::stringstream sstr;
-      sstr << "Could not write to tmp file: error " << errno;
-      return {heif_error_Encoding_error,
-              heif_suberror_Unspecified,
-              sstr.str()};
-    }
-    else if ((size_t)cnt != data.size()) {
-      return {heif_error_Encoding_error,
-              heif_suberror_Unspecified,
-              "Could not write to tmp file (storage full?)"};
-    }
-  }
-  else {
-    if (!m_items[idx].extents.empty()) {
-      Extent& e = m_items[idx].extents.back();
-      e.data.insert(e.data.end(), data.begin(), data.end());
-      e.length = e.data.size();
-      return Error::Ok;
-    }
+  // The 'idat' data of all items is stored consecutively. We can only extend the last extent of the item
+  // if no other 'idat' data has been appended in between.
 
-    extent.data = data;
+  if (!extents.empty() &&
+      extents.back().offset + extents.back().length == m_idat_offset) {
+    Extent& e = extents.back();
+    e.data.insert(e.data.end(), data.begin(), data.end());
+    e.length = e.data.size();
   }
-
-  if (construction_method == 1) {
+  else {
+    Extent extent;
     extent.offset = m_idat_offset;
     extent.length = data.size();
+    extent.data = data;
 
-    m_idat_offset += (int) data.size();
+    extents.push_back(std::move(extent));
   }
 
-  m_items[idx].extents.push_back(std::move(extent));
+  m_idat_offset += data.size();
 
   return Error::Ok;
 }
 
 
-Error Box_iloc::replace_data(heif_item_id item_ID,
-                             uint64_t output_offset,
-                             const std::vector<uint8_t>& data,
-                             uint8_t construction_method)
+Error Box_iloc::append_mdat_extent(heif_item_id item_ID, uint64_t mdat_position, uint64_t length)
 {
-  assert(construction_method == 0); // TODO
+  size_t idx;
+  auto iter = m_item_index.find(item_ID);
+  if (iter != m_item_index.end()) {
+    idx = iter->second;
+  }
+  else {
+    idx = m_items.size();
 
-  // check whether this item ID already exists
+    Item item;
+    item.item_ID = item_ID;
+    item.construction_method = 0;
 
-  size_t idx;
-  for (idx = 0; idx < m_items.size(); idx++) {
-    if (m_items[idx].item_ID == item_ID) {
-      break;
-    }
+    append_item(item);
+  }
+
+  if (m_items[idx].construction_method != 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Item data is stored with different construction methods"};
   }
 
-  assert(idx != m_items.size());
+  auto& extents = m_items[idx].extents;
 
-  uint64_t data_start = 0;
-  for (auto& extent : m_items[idx].extents) {
-    if (output_offset >= extent.data.size()) {
-      output_offset -= extent.data.size();
-    }
-    else {
-      uint64_t write_n = std::min(extent.data.size() - output_offset,
-                                  data.size() - data_start);
-      assert(write_n > 0);
+  if (!extents.empty() &&
+      extents.back().mdat_position + extents.back().length == mdat_position) {
+    extents.back().length += length;
+  }
+  else {
+    Extent extent;
+    extent.mdat_position = mdat_position;
+    extent.length = length;
+
+    extents.push_back(extent);
+  }
 
-      memcpy(extent.data.data() + output_offset, data.data() + data_start, write_n);
+  return Error::Ok;
+}
 
-      data_start += write_n;
-      output_offset = 0;
-    }
 
-    if (data_start == data.size()) {
-      break;
+void Box_iloc::set_mdat_positions_from_file_offsets(const std::function<uint64_t(uint64_t file_offset)>& mdat_position)
+{
+  for (auto& item : m_items) {
+    if (item.construction_method == 0) {
+      for (auto& extent : item.extents) {
+        extent.mdat_position = mdat_position(item.base_offset + extent.offset);
+      }
     }
   }
+}
 
-  return Error::Ok;
+
+// The extents of an item are written relative to the extent that is stored first in the 'mdat' data.
+static uint64_t get_first_mdat_position(const Box_iloc::Item& item)
+{
+  uint64_t first = item.extents[0].mdat_position;
+  for (const auto& extent : item.extents) {
+    first = std::min(first, extent.mdat_position);
+  }
+
+  return first;
 }
 
 
@@ -2011,7 +2198,9 @@ void Box_iloc::derive_box_version()
   m_base_offset_size = 0;
   m_index_size = 0;
 
-  uint64_t total_data_size = 0;
+  uint64_t max_mdat_end = 0;
+  uint64_t max_offset = 0;
+  uint64_t max_length = 0;
 
   for (const auto& item : m_items) {
     // check item_ID size
@@ -2024,61 +2213,36 @@ void Box_iloc::derive_box_version()
       min_version = std::max(min_version, 1);
     }
 
-    total_data_size += item.extents[0].length;
+    // The final offsets are not known yet. 'mdat' extents will be stored relative to the first extent of the item.
 
-    /* cannot compute this here because values are not set yet
-    // base offset size
-    if (item.base_offset > 0xFFFFFFFF) {
-      m_base_offset_size = std::max(m_base_offset_size, (uint8_t)8);
+    uint64_t first_mdat_position = 0;
+    if (item.construction_method == 0 && !item.extents.empty()) {
+      first_mdat_position = get_first_mdat_position(item);
     }
-    else if (item.base_offset > 0) {
-      m_base_offset_size = std::max(m_base_offset_size, (uint8_t)4);
-    }
-*/
 
-    /*
     for (const auto& extent : item.extents) {
-      // extent index size
-
-      if (extent.index != 0) {
-        min_version = std::max(min_version, 1);
-        m_index_size = 4;
-      }
-
-      if (extent.index > 0xFFFFFFFF) {
-        m_index_size = 8;
-      }
-
-      // extent offset size
-      if (extent.offset > 0xFFFFFFFF) {
-        m_offset_size = 8;
+      if (item.construction_method == 0) {
+        max_mdat_end = std::max(max_mdat_end, extent.mdat_position + extent.length);
+        max_offset = std::max(max_offset, extent.mdat_position - first_mdat_position);
       }
       else {
-        m_offset_size = 4;
+        max_offset = std::max(max_offset, extent.offset);
       }
 
-      // extent length size
-      if (extent.length > 0xFFFFFFFF) {
-        m_length_size = 8;
-      }
-      else {
-        m_length_size = 4;
-      }
+      max_length = std::max(max_length, extent.length);
     }
-      */
   }
 
   uint64_t maximum_meta_box_size_guess = 0x10000000; // 256 MB
-  if (total_data_size + maximum_meta_box_size_guess > 0xFFFFFFFF) {
+  if (max_mdat_end + maximum_meta_box_size_guess > 0xFFFFFFFF) {
     m_base_offset_size = 8;
   }
   else {
     m_base_offset_size = 4;
   }
 
-  m_offset_size = 4;
-  m_length_size = 4;
-  //m_base_offset_size = 4; // set above
+  m_offset_size = (max_offset > 0xFFFFFFFF) ? 8 : 4;
+  m_length_size = (max_length > 0xFFFFFFFF) ? 8 : 4;
   m_index_size = 0;
 
   set_version((uint8_t) min_version);
@@ -2149,86 +2313,20 @@ Error Box_iloc::write(StreamWriter& writer) const
 }
 
 
-Error Box_iloc::write_mdat_after_iloc(StreamWriter& writer)
+void Box_iloc::set_mdat_data_start(StreamWriter& writer, uint64_t data_start)
 {
-  // --- compute sum of all mdat data
-
-  size_t sum_mdat_size = 0;
-
-  for (const auto& item : m_items) {
-    if (item.construction_method == 0) {
-      for (const auto& extent : item.extents) {
-        sum_mdat_size += extent.length;
-      }
-    }
-  }
-
-  // --- write mdat box
-
-  if (sum_mdat_size <= 0xFFFFFFFF) {
-    writer.write32((uint32_t) (sum_mdat_size + 8));
-    writer.write32(fourcc("mdat"));
-  }
-  else {
-    // box size > 4 GB
-
-    writer.write32(1);
-    writer.write32(fourcc("mdat"));
-    writer.write64(sum_mdat_size+8+8);
-  }
-
-  if (m_use_tmpfile) {
-    ::lseek(m_tmpfile_fd, 0, SEEK_SET);
-  }
-
   for (auto& item : m_items) {
-    if (item.construction_method == 0) {
-      item.base_offset = writer.get_position();
+    if (item.construction_method == 0 && !item.extents.empty()) {
+      uint64_t first_mdat_position = get_first_mdat_position(item);
+      item.base_offset = data_start + first_mdat_position;
 
       for (auto& extent : item.extents) {
-        extent.offset = writer.get_position() - item.base_offset;
-        //extent.length = extent.data.size();
-
-        if (m_use_tmpfile) {
-          std::vector<uint8_t> data(extent.length);
-#if !defined(_WIN32)
-          ssize_t cnt = ::read(m_tmpfile_fd, data.data(), extent.length);
-#else
-          // TODO Currently unused code. Implement when needed.
-          assert(false);
-# if 0
-          int cnt = _read(m_tmpfile_fd, data.data(), extent.length);
-# else
-          int cnt = -1;
-# endif
-#endif
-          if (cnt<0) {
-            std::stringstream sstr;
-            sstr << "Cannot read tmp data file, error " << errno;
-            return {heif_error_Encoding_error,
-                    heif_suberror_Unspecified,
-                    sstr.str()};
-          }
-          else if ((uint64_t)cnt != extent.length) {
-            return {heif_error_Encoding_error,
-                    heif_suberror_Unspecified,
-                    "Tmp data could not be read completely"};
-          }
-          writer.write(data);
-        }
-        else {
-          writer.write(extent.data);
-        }
+        extent.offset = extent.mdat_position - first_mdat_position;
       }
     }
   }
 
-
-  // --- patch iloc box
-
   patch_iloc_header(writer);
-
-  return Error::Ok;
 }
 
 
@@ -2530,12 +2628,60 @@ std::string Box_iprp::dump(Indent& indent) const
 
 uint32_t Box_ipco::find_or_append_child_box(const std::shared_ptr<Box>& box)
 {
-  for (uint32_t i = 0; i < (uint32_t) m_children.size(); i++) {
-    if (Box::equal(m_children[i], box)) {
-      return i;
+  // Boxes with children are never deduplicated (see Box::equal()).
+  if (!box || box->has_child_boxes()) {
+    return append_child_box(box);
+  }
+
+  update_property_hashes();
+
+  size_t hash = get_property_hash(*box);
+
+  auto candidates = m_property_hashes.equal_range(hash);
+  for (auto it = candidates.first; it != candidates.second; ++it) {
+    if (Box::equal(m_children[it->second], box)) {
+      return it->second;
     }
   }
-  return append_child_box(box);
+
+  uint32_t index = append_child_box(box);
+  m_property_hashes.emplace(hash, index);
+  m_hashed_properties.push_back(box.get());
+
+  return index;
+}
+
+
+size_t Box_ipco::get_property_hash(const Box& box)
+{
+  StreamWriter writer;
+  box.write(writer);
+
+  const std::vector<uint8_t>& data = writer.get_data();
+  return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+}
+
+
+void Box_ipco::update_property_hashes()
+{
+  // When a box has been removed, the last hashed box is not at its index anymore. Start again in this case.
+
+  if (m_hashed_properties.size() > m_children.size() ||
+      (!m_hashed_properties.empty() && m_children[m_hashed_properties.size() - 1].get() != m_hashed_properties.back())) {
+    m_property_hashes.clear();
+    m_hashed_properties.clear();
+  }
+
+  // Add the boxes that have been read from a file or appended with append_child_box().
+
+  for (size_t i = m_hashed_properties.size(); i < m_children.size(); i++) {
+    const std::shared_ptr<Box>& child = m_children[i];
+    if (child && !child->has_child_boxes()) {
+      m_property_hashes.emplace(get_property_hash(*child), static_cast<uint32_t>(i));
+    }
+
+    m_hashed_properties.push_back(child.get());
+  }
 }
 
 
@@ -3091,6 +3237,8 @@ bool Box_ispe::operator==(const Box& other) const
 
 Error Box_ipma::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   // TODO: is there any specification of allowed values for the ipma version in the HEIF standards?
@@ -3138,27 +3286,62 @@ Error Box_ipma::parse(BitstreamRange& range, const heif_security_limits* limits)
       entry.associations.push_back(association);
     }
 
-    m_entries.push_back(entry);
+    append_entry(std::move(entry));
   }
 
   return range.get_error();
 }
 
 
-const std::vector<Box_ipma::PropertyAssociation>* Box_ipma::get_properties_for_item_ID(uint32_t itemID) const
+void Box_ipma::append_entry(Entry entry)
 {
-  for (const auto& entry : m_entries) {
-    if (entry.item_ID == itemID) {
-      return &entry.associations;
+  m_entry_index.emplace(entry.item_ID, m_entries.size());
+  m_entries.push_back(std::move(entry));
+}
+
+
+void Box_ipma::remove_entries_for_item_ID(heif_item_id itemID)
+{
+  std::vector<Entry> entries;
+  for (auto& entry : m_entries) {
+    if (entry.item_ID != itemID) {
+      entries.push_back(std::move(entry));
     }
   }
 
-  return nullptr;
+  m_entries.clear();
+  m_entry_index.clear();
+
+  for (auto& entry : entries) {
+    append_entry(std::move(entry));
+  }
+}
+
+
+const std::vector<Box_ipma::PropertyAssociation>* Box_ipma::get_properties_for_item_ID(uint32_t itemID) const
+{
+  auto iter = m_entry_index.find(itemID);
+  if (iter == m_entry_index.end()) {
+    return nullptr;
+  }
+
+  return &m_entries[iter->second].associations;
 }
 
 
 bool Box_ipma::is_property_essential_for_item(heif_item_id itemId, int propertyIndex) const
 {
+  auto iter = m_entry_index.find(itemId);
+  if (iter != m_entry_index.end()) {
+    for (const auto& assoc : m_entries[iter->second].associations) {
+      if (assoc.property_index == propertyIndex) {
+        return assoc.essential;
+      }
+    }
+  }
+
+  // The property may be in a later entry if the item has several entries (e.g. from several 'ipma' boxes).
+
   for (const auto& entry : m_entries) {
     if (entry.item_ID == itemId) {
       for (const auto& assoc : entry.associations) {
@@ -3178,17 +3361,17 @@ void Box_ipma::add_property_for_item_ID(heif_item_id itemID,
                                         PropertyAssociation assoc)
 {
   size_t idx;
-  for (idx = 0; idx < m_entries.size(); idx++) {
-    if (m_entries[idx].item_ID == itemID) {
-      break;
-    }
+  auto iter = m_entry_index.find(itemID);
+  if (iter != m_entry_index.end()) {
+    idx = iter->second;
   }
+  else {
+    // if itemID does not exist, add a new entry
+    idx = m_entries.size();
 
-  // if itemID does not exist, add a new entry
-  if (idx == m_entries.size()) {
     Entry entry;
     entry.item_ID = itemID;
-    m_entries.push_back(entry);
+    append_entry(std::move(entry));
   }
 
   // If the property is already associated with the item, skip.
@@ -3290,9 +3473,9 @@ Error Box_ipma::write(StreamWriter& writer) const
 
 void Box_ipma::insert_entries_from_other_ipma_box(const Box_ipma& b)
 {
-  m_entries.insert(m_entries.end(),
-                   b.m_entries.begin(),
-                   b.m_entries.end());
+  for (const Entry& entry : b.m_entries) {
+    append_entry(entry);
+  }
 }
 
 
@@ -3610,6 +3793,8 @@ void Box_clap::set(uint32_t clap_width, uint32_t clap_height,
 
 Error Box_iref::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_version() > 1) {
@@ -3657,7 +3842,7 @@ Error Box_iref::parse(BitstreamRange& range, const heif_security_limits* limits)
       ref.to_item_ID.push_back(static_cast<uint32_t>(range.read_uint(read_len)));
     }
 
-    m_references.push_back(ref);
+    append_reference(std::move(ref));
   }
 
 
@@ -3815,15 +4000,16 @@ std::string Box_iref::dump(Indent& indent) const
 }
 
 
-bool Box_iref::has_references(uint32_t itemID) const
+void Box_iref::append_reference(Reference ref)
 {
-  for (const Reference& ref : m_references) {
-    if (ref.from_item_ID == itemID) {
-      return true;
-    }
-  }
+  m_references_by_from_ID[ref.from_item_ID].push_back(m_references.size());
+  m_references.push_back(std::move(ref));
+}
 
-  return false;
+
+bool Box_iref::has_references(uint32_t itemID) const
+{
+  return m_references_by_from_ID.find(itemID) != m_references_by_from_ID.end();
 }
 
 
@@ -3831,9 +4017,10 @@ std::vector<Box_iref::Reference> Box_iref::get_references_from(heif_item_id item
 {
   std::vector<Reference> references;
 
-  for (const Reference& ref : m_references) {
-    if (ref.from_item_ID == itemID) {
-      references.push_back(ref);
+  auto iter = m_references_by_from_ID.find(itemID);
+  if (iter != m_references_by_from_ID.end()) {
+    for (size_t idx : iter->second) {
+      references.push_back(m_references[idx]);
     }
   }
 
@@ -3843,10 +4030,12 @@ std::vector<Box_iref::Reference> Box_iref::get_references_from(heif_item_id item
 
 std::vector<uint32_t> Box_iref::get_references(uint32_t itemID, uint32_t ref_type) const
 {
-  for (const Reference& ref : m_references) {
-    if (ref.from_item_ID == itemID &&
-        ref.header.get_short_type() == ref_type) {
-      return ref.to_item_ID;
+  auto iter = m_references_by_from_ID.find(itemID);
+  if (iter != m_references_by_from_ID.end()) {
+    for (size_t idx : iter->second) {
+      if (m_references[idx].header.get_short_type() == ref_type) {
+        return m_references[idx].to_item_ID;
+      }
     }
   }
 
@@ -3863,18 +4052,47 @@ void Box_iref::add_references(heif_item_id from_id, uint32_t type, const std::ve
 
   assert(to_ids.size() <= 0xFFFF);
 
-  m_references.push_back(ref);
+  append_reference(std::move(ref));
 }
 
 
-void Box_iref::overwrite_reference(heif_item_id from_id, uint32_t type, uint32_t reference_idx, heif_item_id to_item)
+void Box_iref::remove_references_of_item(heif_item_id itemID)
 {
+  std::vector<Reference> references;
   for (auto& ref : m_references) {
-    if (ref.from_item_ID == from_id && ref.header.get_short_type() == type) {
-      assert(reference_idx < ref.to_item_ID.size());
+    if (ref.from_item_ID == itemID) {
+      continue;
+    }
 
-      ref.to_item_ID[reference_idx] = to_item;
-      return;
+    ref.to_item_ID.erase(std::remove(ref.to_item_ID.begin(), ref.to_item_ID.end(), itemID),
+                         ref.to_item_ID.end());
+
+    if (!ref.to_item_ID.empty()) {
+      references.push_back(std::move(ref));
+    }
+  }
+
+  m_references.clear();
+  m_references_by_from_ID.clear();
+
+  for (auto& ref : references) {
+    append_reference(std::move(ref));
+  }
+}
+
+
+void Box_iref::overwrite_reference(heif_item_id from_id, uint32_t type, uint32_t reference_idx, heif_item_id to_item)
+{
+  auto iter = m_references_by_from_ID.find(from_id);
+  if (iter != m_references_by_from_ID.end()) {
+    for (size_t idx : iter->second) {
+      auto& ref = m_references[idx];
+      if (ref.header.get_short_type() == type) {
+        assert(reference_idx < ref.to_item_ID.size());
+
+        ref.to_item_ID[reference_idx] = to_item;
+        return;
+      }
     }
   }
 
@@ -3904,6 +4122,26 @@ Error Box_idat::write(StreamWriter& writer) const
 }
 
 
+Error Box_idat::load_data_for_writing(const std::shared_ptr<StreamReader>& istr,
+                                     const heif_security_limits* limits)
+{
+  if (get_box_size() < get_header_size()) {
+    return {heif_error_Invalid_input,
+            heif_suberror_End_of_data,
+            "Invalid 'idat' box size"};
+  }
+
+  std::vector<uint8_t> data;
+  if (Error err = read_data(istr, 0, get_box_size() - get_header_size(), data, limits)) {
+    return err;
+  }
+
+  m_data_for_writing = std::move(data);
+
+  return Error::Ok;
+}
+
+
 std::string Box_idat::dump(Indent& indent) const
 {
   std::ostringstream sstr;
@@ -4933,7 +5171,13 @@ uint64_t uint8_vector_to_uint64_BE(const uint8_t* data)
 
 Result<heif_tai_timestamp_packet> Box_itai::decode_tai_from_vector(const std::vector<uint8_t>& data)
 {
-  if (data.size() != 9) {
+  return decode_tai_from_bitstream(data.data(), data.size());
+}
+
+
+Result<heif_tai_timestamp_packet> Box_itai::decode_tai_from_bitstream(const uint8_t* data, size_t size)
+{
+  if (size != 9) {
     return Error{heif_error_Invalid_input,
                  heif_suberror_Unspecified,
                  "Wrong size of TAI timestamp data"};
@@ -4943,7 +5187,7 @@ Result<heif_tai_timestamp_packet> Box_itai::decode_tai_from_vector(const std::ve
 
   heif_tai_timestamp_packet tai;
   tai.version = 1;
-  tai.tai_timestamp = uint8_vector_to_uint64_BE(data.data());
+  tai.tai_timestamp = uint8_vector_to_uint64_BE(data);
   tai.synchronization_state = !!(status_bits & 0x80);
   tai.timestamp_generation_failure = !!(status_bits & 0x40);
   tai.timestamp_is_modified = !!(status_bits & 0x20);
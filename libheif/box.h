@@ -39,6 +39,12 @@
 #include <bitset>
 #include <utility>
 #include <optional>
+#include <unordered_map>
+#include <functional>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
 
 #include "error.h"
 #include "logging.h"
@@ -536,10 +542,6 @@ class Box_iloc : public FullBox
 public:
   Box_iloc();
 
-  ~Box_iloc() override;
-
-  void set_use_tmp_file(bool flag);
-
   std::string dump(Indent&) const override;
 
   const char* debug_box_name() const override { return "Item Location"; }
@@ -550,7 +552,9 @@ public:
     uint64_t offset = 0;
     uint64_t length = 0;
 
-    std::vector<uint8_t> data; // only used when writing data
+    std::vector<uint8_t> data; // only used when writing 'idat' data (construction method 1)
+
+    uint64_t mdat_position = 0; // only used when writing 'mdat' data: position relative to the start of the 'mdat' payload
   };
 
   struct Item
@@ -565,6 +569,13 @@ public:
 
   const std::vector<Item>& get_items() const { return m_items; }
 
+  void set_items(std::vector<Item> items);
+
+  void remove_item(heif_item_id item_id);
+
+  // Returns NULL if there is no item with this ID.
+  const Item* find_item(heif_item_id item_id) const;
+
   Error read_data(heif_item_id item,
                   const std::shared_ptr<StreamReader>& istr,
                   const std::shared_ptr<class Box_idat>&,
@@ -579,36 +590,46 @@ public:
                   uint64_t offset, uint64_t size,
                   const heif_security_limits* limits) const;
 
+  // Returns a pointer to the item data if it is stored in one contiguous range of the file (construction method 0)
+  // and the StreamReader has the file in memory. Returns NULL if the data has to be copied with read_data().
+  const uint8_t* get_direct_data_pointer(heif_item_id item,
+                                         const std::shared_ptr<StreamReader>& istr,
+                                         uint64_t* out_size) const;
+
+  // Appends the file ranges [start, end) in which the item data range [offset, offset+size) is stored.
+  // Only data stored in the file itself (construction method 0) is considered.
+  void get_file_ranges(heif_item_id item, uint64_t offset, uint64_t size,
+                       std::vector<std::pair<uint64_t, uint64_t>>& out_ranges) const;
+
   void set_min_version(uint8_t min_version) { m_user_defined_min_version = min_version; }
 
-  // append bitstream data that will be written later (after iloc box)
+  // Extents of an item that follow each other in the file with a gap of at most 'max_gap' bytes
+  // are read with a single request. The data in the gaps is read and discarded.
+  void set_max_read_gap(uint64_t max_gap) { m_max_read_gap = max_gap; }
+
+  // Append data that is stored in the 'idat' box (construction method 1).
   // TODO: use an enum for the construction method
   Error append_data(heif_item_id item_ID,
                     const std::vector<uint8_t>& data,
-                    uint8_t construction_method = 0);
-
-  Error replace_data(heif_item_id item_ID,
-                     uint64_t output_offset,
-                     const std::vector<uint8_t>& data,
-                     uint8_t construction_method);
+                    uint8_t construction_method);
 
-  // append bitstream data that already has been written (before iloc box)
-  // Error write_mdat_before_iloc(heif_image_id item_ID,
-  //                              std::vector<uint8_t>& data)
+  // Append a range of the 'mdat' payload to the item data (construction method 0).
+  // When the range directly follows the last extent of the item, the extent is extended.
+  Error append_mdat_extent(heif_item_id item_ID, uint64_t mdat_position, uint64_t length);
 
-  // reserve data entry that will be written later
-  // Error reserve_mdat_item(heif_image_id item_ID,
-  //                         uint8_t construction_method,
-  //                         uint32_t* slot_ID);
-  // void patch_mdat_slot(uint32_t slot_ID, size_t start, size_t length);
+  // Sets the 'mdat' positions of all data stored in the file (construction method 0) from the file offsets
+  // of the extents. This is used when the data of a file that has been read is copied into the file that is written.
+  void set_mdat_positions_from_file_offsets(const std::function<uint64_t(uint64_t file_offset)>& mdat_position);
 
   void derive_box_version() override;
 
   Error write(StreamWriter& writer) const override;
 
-  Error write_mdat_after_iloc(StreamWriter& writer);
+  // Sets the file offsets of the 'mdat' extents from the file position of the 'mdat' payload and
+  // overwrites the iloc box that has been written with write() before.
+  void set_mdat_data_start(StreamWriter& writer, uint64_t data_start);
 
-  void append_item(Item &item) { m_items.push_back(item); }
+  void append_item(Item &item);
 
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
@@ -616,6 +637,9 @@ protected:
 private:
   std::vector<Item> m_items;
 
+  // Index of each item in m_items. If an item ID occurs several times, the first one is used.
+  std::unordered_map<heif_item_id, size_t> m_item_index;
+
   mutable size_t m_iloc_box_start = 0;
   uint8_t m_user_defined_min_version = 0;
   uint8_t m_offset_size = 0;
@@ -623,13 +647,15 @@ private:
   uint8_t m_base_offset_size = 0;
   uint8_t m_index_size = 0;
 
-  void patch_iloc_header(StreamWriter& writer) const;
+  uint64_t m_max_read_gap = 0;
 
-  int m_idat_offset = 0; // only for writing: offset of next data array
+  Error read_file_data(const Item& item, const std::shared_ptr<StreamReader>& istr,
+                       std::vector<uint8_t>* dest, uint64_t offset, uint64_t& size,
+                       const heif_security_limits* limits) const;
 
-  bool m_use_tmpfile = false;
-  int m_tmpfile_fd = 0;
-  char m_tmp_filename[20];
+  void patch_iloc_header(StreamWriter& writer) const;
+
+  uint64_t m_idat_offset = 0; // only for writing: offset of next data array
 };
 
 
@@ -764,6 +790,17 @@ public:
 
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  // Hashes of the serialized properties. Only properties with the same hash are compared in find_or_append_child_box().
+  std::unordered_multimap<size_t, uint32_t> m_property_hashes;
+
+  // The children that are included in m_property_hashes, to detect when the children have been changed otherwise.
+  std::vector<const Box*> m_hashed_properties;
+
+  void update_property_hashes();
+
+  static size_t get_property_hash(const Box& box);
 };
 
 
@@ -835,6 +872,8 @@ public:
 
   void insert_entries_from_other_ipma_box(const Box_ipma& b);
 
+  void remove_entries_for_item_ID(heif_item_id itemID);
+
   // sorts properties such that descriptive properties precede the transformative properties
   void sort_properties(const std::shared_ptr<Box_ipco>&);
 
@@ -848,6 +887,11 @@ protected:
   };
 
   std::vector<Entry> m_entries;
+
+  // Index of the first entry of each item in m_entries.
+  std::unordered_map<heif_item_id, size_t> m_entry_index;
+
+  void append_entry(Entry entry);
 };
 
 
@@ -1024,6 +1068,9 @@ public:
 
   void overwrite_reference(heif_item_id from_id, uint32_t type, uint32_t reference_idx, heif_item_id to_item);
 
+  // Removes all references from and to the item. References that do not point to any item anymore are removed.
+  void remove_references_of_item(heif_item_id itemID);
+
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
 
@@ -1035,6 +1082,11 @@ protected:
 
 private:
   std::vector<Reference> m_references;
+
+  // Indices of the references in m_references, listed by their from_item_ID.
+  std::unordered_map<heif_item_id, std::vector<size_t>> m_references_by_from_ID;
+
+  void append_reference(Reference ref);
 };
 
 
@@ -1061,6 +1113,10 @@ public:
     return (int) pos;
   }
 
+  // Keeps the data of a box that has been read, so that it is written again.
+  Error load_data_for_writing(const std::shared_ptr<StreamReader>& istr,
+                              const heif_security_limits* limits);
+
   Error write(StreamWriter& writer) const override;
 
 protected:
@@ -1769,6 +1825,8 @@ public:
 
   static Result<heif_tai_timestamp_packet> decode_tai_from_vector(const std::vector<uint8_t>&);
 
+  static Result<heif_tai_timestamp_packet> decode_tai_from_bitstream(const uint8_t* data, size_t size);
+
   /**
    * The number of nanoseconds since the TAI epoch of 1958-01-01T00:00:00.0Z.
    */
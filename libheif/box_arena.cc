@@ -0,0 +1,90 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "box_arena.h"
+
+#include <cassert>
+
+
+static thread_local const std::shared_ptr<BoxArena>* current_arena = nullptr;
+
+
+void* BoxArena::allocate(size_t size, size_t alignment)
+{
+  assert(alignment <= alignof(std::max_align_t));
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  size_t padding = (alignment - reinterpret_cast<uintptr_t>(m_free_start) % alignment) % alignment;
+
+  if (m_free_start == nullptr || padding + size > m_free_size) {
+    // Large allocations get their own block, such that the free space of the current block is not lost.
+    if (size > kBlockSize / 4) {
+      m_blocks.emplace_back(new uint8_t[size]);
+      m_allocated_bytes += size;
+      return m_blocks.back().get();
+    }
+
+    m_blocks.emplace_back(new uint8_t[kBlockSize]);
+    m_allocated_bytes += kBlockSize;
+
+    m_free_start = m_blocks.back().get();
+    m_free_size = kBlockSize;
+    padding = 0;
+  }
+
+  uint8_t* mem = m_free_start + padding;
+  m_free_start += padding + size;
+  m_free_size -= padding + size;
+
+  return mem;
+}
+
+
+size_t BoxArena::get_allocated_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_allocated_bytes;
+}
+
+
+BoxArena::Scope::Scope(std::shared_ptr<BoxArena> arena)
+    : m_arena(std::move(arena)),
+      m_previous(current_arena)
+{
+  current_arena = &m_arena;
+}
+
+
+BoxArena::Scope::~Scope()
+{
+  current_arena = m_previous;
+}
+
+
+const std::shared_ptr<BoxArena>* BoxArena::current()
+{
+  return current_arena;
+}
@@ -0,0 +1,129 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_BOX_ARENA_H
+#define LIBHEIF_BOX_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+
+// Monotonic memory arena for the boxes that are parsed from a file.
+// A file contains many small boxes (e.g. one 'ispe' or 'pixi' per image). Allocating them from larger blocks
+// saves the heap allocation for each box, and releasing a box does not free its memory.
+// The memory is freed when the arena is destroyed, i.e. when the last box allocated from it has been released.
+class BoxArena
+{
+public:
+  BoxArena() = default;
+
+  BoxArena(const BoxArena&) = delete;
+
+  BoxArena& operator=(const BoxArena&) = delete;
+
+  void* allocate(size_t size, size_t alignment);
+
+  // Total size of the memory blocks held by the arena.
+  size_t get_allocated_bytes() const;
+
+  // While a Scope is active, make_box() allocates the boxes that are created on this thread from 'arena'.
+  class Scope
+  {
+  public:
+    explicit Scope(std::shared_ptr<BoxArena> arena);
+
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    std::shared_ptr<BoxArena> m_arena;
+    const std::shared_ptr<BoxArena>* m_previous;
+  };
+
+  // The arena of the innermost active Scope on this thread, or NULL.
+  static const std::shared_ptr<BoxArena>* current();
+
+private:
+  static const size_t kBlockSize = 64 * 1024;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  mutable std::mutex m_mutex;
+#endif
+
+  std::vector<std::unique_ptr<uint8_t[]>> m_blocks;
+  size_t m_allocated_bytes = 0;
+
+  uint8_t* m_free_start = nullptr; // free space at the end of the current block
+  size_t m_free_size = 0;
+};
+
+
+// Allocator that takes the memory from a BoxArena. Each allocator keeps its arena alive.
+template <typename T>
+class BoxArenaAllocator
+{
+public:
+  using value_type = T;
+
+  explicit BoxArenaAllocator(std::shared_ptr<BoxArena> arena) : m_arena(std::move(arena)) {}
+
+  template <typename U>
+  BoxArenaAllocator(const BoxArenaAllocator<U>& other) : m_arena(other.get_arena()) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+
+  // The memory is released together with the arena.
+  void deallocate(T*, size_t) {}
+
+  const std::shared_ptr<BoxArena>& get_arena() const { return m_arena; }
+
+  template <typename U>
+  bool operator==(const BoxArenaAllocator<U>& other) const { return m_arena == other.get_arena(); }
+
+  template <typename U>
+  bool operator!=(const BoxArenaAllocator<U>& other) const { return m_arena != other.get_arena(); }
+
+private:
+  std::shared_ptr<BoxArena> m_arena;
+};
+
+
+// Creates a box in the arena of the active BoxArena::Scope, or on the heap if there is none.
+template <typename T, typename... Args>
+std::shared_ptr<T> make_box(Args&&... args)
+{
+  if (const std::shared_ptr<BoxArena>* arena = BoxArena::current()) {
+    return std::allocate_shared<T>(BoxArenaAllocator<T>(*arena), std::forward<Args>(args)...);
+  }
+
+  return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+#endif //LIBHEIF_BOX_ARENA_H
@@ -35,6 +35,12 @@ Result<std::vector<uint8_t>> Decoder_AVC::read_bitstream_configuration_data() co
 }
 
 
+uint8_t Decoder_AVC::get_nal_unit_length_size() const
+{
+  return m_avcC->get_configuration().lengthSize;
+}
+
+
 int Decoder_AVC::get_luma_bits_per_pixel() const
 {
   return m_avcC->get_configuration().bit_depth_luma;
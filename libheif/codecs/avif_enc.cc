@@ -77,6 +77,41 @@ Result<Encoder::CodedImageData> Encoder_AVIF::encode(const std::shared_ptr<HeifP
 }
 
 
+Error Encoder_AVIF::prepare_sequence_frame(const std::shared_ptr<HeifPixelImage>& image)
+{
+  // Preliminary av1C in case we cannot parse the sequence_header() of the first frame.
+  if (!m_sequence_have_preliminary_config) {
+    fill_av1C_configuration(&m_sequence_config, image);
+    m_sequence_have_preliminary_config = true;
+  }
+
+  return Error::Ok;
+}
+
+
+void Encoder_AVIF::add_sequence_packet(CodedImageData& codedImage, const uint8_t* data, int size)
+{
+  if (!m_sequence_av1C) {
+    fill_av1C_configuration_from_stream(&m_sequence_config, data, size);
+  }
+
+  codedImage.append(data, size);
+}
+
+
+Error Encoder_AVIF::finish_sequence_frame(CodedImageData& codedImage)
+{
+  if (!m_sequence_av1C) {
+    m_sequence_av1C = std::make_shared<Box_av1C>();
+    m_sequence_av1C->set_configuration(m_sequence_config);
+  }
+
+  codedImage.properties.push_back(m_sequence_av1C);
+
+  return Error::Ok;
+}
+
+
 std::shared_ptr<class Box_VisualSampleEntry> Encoder_AVIF::get_sample_description_box(const CodedImageData& data) const
 {
   auto av01 = std::make_shared<Box_av01>();
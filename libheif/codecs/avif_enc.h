@@ -31,6 +31,7 @@
 #include <utility>
 #include <vector>
 #include "codecs/encoder.h"
+#include "codecs/avif_boxes.h"
 
 
 class Encoder_AVIF : public Encoder {
@@ -41,6 +42,21 @@ public:
                                 enum heif_image_input_class input_class) override;
 
   std::shared_ptr<class Box_VisualSampleEntry> get_sample_description_box(const CodedImageData&) const override;
+
+protected:
+  bool can_encode_sequences_with_inter_prediction() const override { return true; }
+
+  Error prepare_sequence_frame(const std::shared_ptr<HeifPixelImage>&) override;
+
+  void add_sequence_packet(CodedImageData&, const uint8_t* data, int size) override;
+
+  Error finish_sequence_frame(CodedImageData&) override;
+
+private:
+  // The av1C of a sequence is taken from the first coded frame.
+  std::shared_ptr<class Box_av1C> m_sequence_av1C;
+  Box_av1C::configuration m_sequence_config{};
+  bool m_sequence_have_preliminary_config = false;
 };
 
 
@@ -20,11 +20,20 @@
 
 #include "codecs/decoder.h"
 
+#include <algorithm>
 #include <utility>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
 #include "error.h"
 #include "context.h"
 #include "plugin_registry.h"
 #include "libheif/api_structs.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
+#include "codecs/nalu_utils.h"
 
 #include "codecs/hevc_dec.h"
 #include "codecs/avif_dec.h"
@@ -117,6 +126,43 @@ Result<std::vector<uint8_t>> DataExtent::read_data(uint64_t offset, uint64_t siz
 }
 
 
+Result<uint64_t> DataExtent::get_data_size() const
+{
+  if (!m_raw.empty()) {
+    return m_raw.size();
+  }
+  else if (m_source == Source::Image) {
+    assert(m_file);
+    return m_file->get_item_data_size(m_item_id);
+  }
+  else if (m_source == Source::FileRange) {
+    return m_size;
+  }
+  else {
+    return 0;
+  }
+}
+
+
+std::span<const uint8_t> DataExtent::get_data_without_copy() const
+{
+  if (!m_raw.empty()) {
+    return m_raw;
+  }
+  else if (m_source == Source::Image) {
+    assert(m_file);
+    return m_file->get_item_data_without_copy(m_item_id);
+  }
+  else if (m_source == Source::FileRange) {
+    assert(m_file);
+    return m_file->get_file_range_without_copy(m_offset, m_size);
+  }
+  else {
+    return {};
+  }
+}
+
+
 std::shared_ptr<Decoder> Decoder::alloc_for_infe_type(const ImageItem* item)
 {
   uint32_t format_4cc = item->get_infe_type();
@@ -227,7 +273,7 @@ Result<std::vector<uint8_t>> Decoder::get_compressed_data() const
     return confData.error;
   }
 
-  std::vector<uint8_t> data = confData.value;
+  std::vector<uint8_t> data = std::move(confData.value);
 
   // append image data
 
@@ -242,6 +288,282 @@ Result<std::vector<uint8_t>> Decoder::get_compressed_data() const
 }
 
 
+Result<std::vector<uint8_t>> Decoder::get_annexb_data(bool include_parameter_sets) const
+{
+  uint8_t length_size = get_nal_unit_length_size();
+  if (length_size == 0) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_codec,
+                 "Annex-B byte streams are only available for AVC, HEVC and VVC images"};
+  }
+
+  std::vector<uint8_t> annexb;
+
+  // The NAL units of the configuration boxes are always stored with 4-byte sizes.
+
+  if (include_parameter_sets) {
+    Result<std::vector<uint8_t>> confData = read_bitstream_configuration_data();
+    if (confData.error) {
+      return confData.error;
+    }
+
+    if (Error err = append_nal_units_as_annexb(annexb, confData.value, 4)) {
+      return err;
+    }
+  }
+
+  Result dataResult = m_data_extent.read_data();
+  if (dataResult.error) {
+    return dataResult.error;
+  }
+
+  if (Error err = append_nal_units_as_annexb(annexb, *dataResult.value, length_size)) {
+    return err;
+  }
+
+  return annexb;
+}
+
+
+Result<std::shared_ptr<void>>
+Decoder::create_plugin_decoder(const struct heif_decoder_plugin* decoder_plugin, const struct heif_decoding_options& options,
+                               const std::vector<uint8_t>& configuration, const DecodeArea* area)
+{
+  if (decoder_plugin->new_decoder == nullptr) {
+    return Error(heif_error_Plugin_loading_error, heif_suberror_No_matching_decoder_installed,
+                 "Cannot decode with a dummy decoder plugin.");
+  }
+
+  void* decoder = nullptr;
+  if (m_instance_pool) {
+    decoder = m_instance_pool->acquire(decoder_plugin, configuration);
+  }
+
+  if (!decoder) {
+    struct heif_error err = decoder_plugin->new_decoder(&decoder);
+    if (err.code != heif_error_Ok) {
+      return Error(err.code, err.subcode, err.message);
+    }
+  }
+
+  // automatically delete decoder plugin (or return it to the pool) when we leave the scope
+  std::shared_ptr<void> decoderSmartPtr;
+  if (m_instance_pool && DecoderInstancePool::supports_reuse(decoder_plugin)) {
+    decoderSmartPtr = std::shared_ptr<void>(decoder,
+                                            [pool = m_instance_pool, decoder_plugin, configuration](void* d) {
+                                              pool->release(decoder_plugin, configuration, d);
+                                            });
+  }
+  else {
+    decoderSmartPtr = std::shared_ptr<void>(decoder, decoder_plugin->free_decoder);
+  }
+
+  if (decoder_plugin->plugin_api_version >= 2) {
+    if (decoder_plugin->set_strict_decoding) {
+      decoder_plugin->set_strict_decoding(decoder, options.strict_decoding);
+    }
+  }
+
+  if (decoder_plugin->plugin_api_version >= 4 && options.target_scale_denominator > 1) {
+    if (decoder_plugin->set_target_scale_denominator) {
+      decoder_plugin->set_target_scale_denominator(decoder, options.target_scale_denominator);
+    }
+  }
+
+  if (decoder_plugin->plugin_api_version >= 4 && options.max_codec_threads > 0) {
+    if (decoder_plugin->set_num_threads) {
+      heif_error err = decoder_plugin->set_num_threads(decoder, options.max_codec_threads);
+      if (err.code != heif_error_Ok) {
+        return Error(err.code, err.subcode, err.message);
+      }
+    }
+  }
+
+  if (decoder_plugin->plugin_api_version >= 4 && options.low_latency_decoding) {
+    if (decoder_plugin->set_low_latency_decoding) {
+      decoder_plugin->set_low_latency_decoding(decoder, options.low_latency_decoding);
+    }
+  }
+
+  if (area) {
+    heif_error err = decoder_plugin->set_decode_area(decoder, area->x0, area->y0, area->w, area->h);
+    if (err.code != heif_error_Ok) {
+      return Error(err.code, err.subcode, err.message);
+    }
+  }
+
+  return decoderSmartPtr;
+}
+
+
+// Passes the cancellation and progress callbacks of the decoding options into a decoder plugin while it decodes
+// one image. It holds the decoder, such that the callback is removed before the decoder is released.
+struct PluginDecoderCallback
+{
+  std::shared_ptr<void> decoder;
+  const heif_decoder_plugin* plugin = nullptr;
+
+  int (* cancel_decoding)(void* progress_user_data) = nullptr;
+  void (* start_progress)(heif_progress_step step, int max_progress, void* progress_user_data) = nullptr;
+  void (* on_progress)(heif_progress_step step, int progress, void* progress_user_data) = nullptr;
+  void (* end_progress)(heif_progress_step step, void* progress_user_data) = nullptr;
+  void* progress_user_data = nullptr;
+
+  bool progress_started = false;
+  bool canceled = false;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::mutex mutex;
+#endif
+
+  ~PluginDecoderCallback()
+  {
+    plugin->set_decoding_callback(decoder.get(), nullptr, nullptr);
+
+    if (progress_started && end_progress) {
+      end_progress(heif_progress_step_codec, progress_user_data);
+    }
+  }
+
+  static int callback(float progress, void* callback_data)
+  {
+    auto* self = static_cast<PluginDecoderCallback*>(callback_data);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(self->mutex);
+#endif
+
+    if (self->canceled) {
+      return 1;
+    }
+
+    if (self->cancel_decoding && self->cancel_decoding(self->progress_user_data)) {
+      self->canceled = true;
+      return 1;
+    }
+
+    if (progress >= 0 && self->on_progress) {
+      if (!self->progress_started) {
+        if (self->start_progress) {
+          self->start_progress(heif_progress_step_codec, 1000, self->progress_user_data);
+        }
+        self->progress_started = true;
+      }
+
+      self->on_progress(heif_progress_step_codec, static_cast<int>(std::min(progress, 1.0f) * 1000), self->progress_user_data);
+    }
+
+    return 0;
+  }
+};
+
+
+Result<std::shared_ptr<void>>
+Decoder::start_plugin_decoder(const struct heif_decoder_plugin* decoder_plugin, const struct heif_decoding_options& options,
+                              const DecodeArea* area)
+{
+  Result<std::vector<uint8_t>> confData = read_bitstream_configuration_data();
+  if (confData.error) {
+    return confData.error;
+  }
+
+  auto decoderResult = create_plugin_decoder(decoder_plugin, options, confData.value, area);
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  std::shared_ptr<void> decoderSmartPtr = *decoderResult;
+  void* decoder = decoderSmartPtr.get();
+
+  // --- let the plugin check for cancellation and report its progress while decoding
+
+  if (decoder_plugin->plugin_api_version >= 4 &&
+      decoder_plugin->set_decoding_callback &&
+      (options.cancel_decoding || options.on_progress)) {
+    auto callback = std::make_shared<PluginDecoderCallback>();
+    callback->decoder = decoderSmartPtr;
+    callback->plugin = decoder_plugin;
+    callback->cancel_decoding = options.cancel_decoding;
+    callback->start_progress = options.start_progress;
+    callback->on_progress = options.on_progress;
+    callback->end_progress = options.end_progress;
+    callback->progress_user_data = options.progress_user_data;
+
+    decoder_plugin->set_decoding_callback(decoder, PluginDecoderCallback::callback, callback.get());
+
+    // The returned pointer keeps the callback alive until the decoder is released.
+    decoderSmartPtr = std::shared_ptr<void>(callback, decoder);
+  }
+
+  // --- progressive decoding: only push the beginning of the data into the plugin
+
+  uint64_t data_size_limit = 0;
+
+  if (decoder_plugin->plugin_api_version >= 4 &&
+      decoder_plugin->set_progressive_decoding &&
+      (options.max_coded_data_size > 0 || options.max_quality_layers > 0)) {
+    if (options.max_coded_data_size > 0) {
+      auto sizeResult = m_data_extent.get_data_size();
+      if (sizeResult.error) {
+        return sizeResult.error;
+      }
+
+      if (*sizeResult > options.max_coded_data_size) {
+        data_size_limit = options.max_coded_data_size;
+      }
+    }
+
+    heif_error err = decoder_plugin->set_progressive_decoding(decoder, options.max_quality_layers, data_size_limit > 0);
+    if (err.code != heif_error_Ok) {
+      return Error(err.code, err.subcode, err.message);
+    }
+  }
+
+  // When there is no configuration data to prepend, we can pass the data directly from the
+  // memory-mapped file to the plugin instead of copying it into a temporary buffer.
+
+  std::span<const uint8_t> compressed_data;
+  if (confData.value.empty()) {
+    compressed_data = m_data_extent.get_data_without_copy();
+
+    if (data_size_limit > 0 && !compressed_data.empty()) {
+      compressed_data = compressed_data.first(static_cast<size_t>(data_size_limit));
+    }
+  }
+
+  std::vector<uint8_t> compressed_data_copy;
+  if (compressed_data.empty()) {
+    if (data_size_limit > 0) {
+      // Read only the beginning of the data. This uses range requests for files that are loaded over the network.
+      auto dataResult = m_data_extent.read_data(0, data_size_limit);
+      if (dataResult.error) {
+        return dataResult.error;
+      }
+
+      compressed_data_copy = std::move(confData.value);
+      compressed_data_copy.insert(compressed_data_copy.end(), dataResult.value.begin(), dataResult.value.end());
+    }
+    else {
+      auto dataResult = get_compressed_data();
+      if (dataResult.error) {
+        return dataResult.error;
+      }
+
+      compressed_data_copy = std::move(dataResult.value);
+    }
+
+    compressed_data = compressed_data_copy;
+  }
+
+  heif_error err = decoder_plugin->push_data(decoder, compressed_data.data(), compressed_data.size());
+  if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
+  }
+
+  return decoderSmartPtr;
+}
+
+
 Result<std::shared_ptr<HeifPixelImage>>
 Decoder::decode_single_frame_from_compressed_data(const struct heif_decoding_options& options)
 {
@@ -253,39 +575,281 @@ Decoder::decode_single_frame_from_compressed_data(const struct heif_decoding_opt
 
   // --- decode image with the plugin
 
-  if (decoder_plugin->new_decoder == nullptr) {
-    return Error(heif_error_Plugin_loading_error, heif_suberror_No_matching_decoder_installed,
-                 "Cannot decode with a dummy decoder plugin.");
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
+  auto decoderResult = start_plugin_decoder(decoder_plugin, options);
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  return run_plugin_decoder(decoder_plugin, *decoderResult);
+}
+
+
+bool Decoder::supports_sequence_decoding(const struct heif_decoding_options& options) const
+{
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(get_compression_format(), options.decoder_id);
+
+  return (decoder_plugin &&
+          decoder_plugin->plugin_api_version >= 4 &&
+          decoder_plugin->push_sequence_sample &&
+          decoder_plugin->flush_sequence &&
+          decoder_plugin->get_next_sequence_image);
+}
+
+
+Error Decoder::start_sequence_decoding(const struct heif_decoding_options& options)
+{
+  if (!supports_sequence_decoding(options)) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unspecified,
+            "Decoder plugin cannot decode sequences with inter-frame prediction"};
+  }
+
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(get_compression_format(), options.decoder_id);
+
+  Result<std::vector<uint8_t>> confData = read_bitstream_configuration_data();
+  if (confData.error) {
+    return confData.error;
+  }
+
+  auto decoderResult = create_plugin_decoder(decoder_plugin, options, confData.value);
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  if (!confData.value.empty()) {
+    heif_error err = decoder_plugin->push_data(decoderResult.value.get(), confData.value.data(), confData.value.size());
+    if (err.code != heif_error_Ok) {
+      return Error(err.code, err.subcode, err.message);
+    }
+  }
+
+  m_sequence_plugin = decoder_plugin;
+  m_sequence_decoder = *decoderResult;
+
+  return Error::Ok;
+}
+
+
+Error Decoder::push_sequence_sample(uintptr_t user_data)
+{
+  assert(m_sequence_decoder);
+
+  std::span<const uint8_t> data = m_data_extent.get_data_without_copy();
+
+  std::vector<uint8_t>* data_copy = nullptr;
+  if (data.empty()) {
+    auto dataResult = m_data_extent.read_data();
+    if (dataResult.error) {
+      return dataResult.error;
+    }
+
+    data_copy = *dataResult;
+    data = *data_copy;
+  }
+
+  heif_error err = m_sequence_plugin->push_sequence_sample(m_sequence_decoder.get(), data.data(), data.size(), user_data);
+  if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
+  }
+
+  return Error::Ok;
+}
+
+
+Error Decoder::flush_sequence()
+{
+  assert(m_sequence_decoder);
+
+  heif_error err = m_sequence_plugin->flush_sequence(m_sequence_decoder.get());
+  if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
   }
 
-  void* decoder;
+  return Error::Ok;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> Decoder::get_next_sequence_image(uintptr_t* out_user_data)
+{
+  assert(m_sequence_decoder);
+
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
+  heif_image* decoded_img = nullptr;
+  uintptr_t user_data = 0;
+
+  heif_error err = m_sequence_plugin->get_next_sequence_image(m_sequence_decoder.get(), &decoded_img, &user_data);
+  if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
+  }
+
+  if (!decoded_img) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+
+  std::shared_ptr<HeifPixelImage> img = std::move(decoded_img->image);
+  heif_image_release(decoded_img);
+
+  *out_user_data = user_data;
+
+  return img;
+}
+
+
+void Decoder::end_sequence_decoding()
+{
+  m_sequence_decoder.reset();
+  m_sequence_plugin = nullptr;
+}
+
+
+bool BatchDecoder::supports_batch_decoding(heif_compression_format format, const struct heif_decoding_options& options)
+{
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(format, options.decoder_id);
+
+  return (decoder_plugin &&
+          decoder_plugin->plugin_api_version >= 4 &&
+          decoder_plugin->push_batch_image &&
+          decoder_plugin->get_next_batch_image);
+}
+
+
+Error BatchDecoder::start(heif_compression_format format, const struct heif_decoding_options& options)
+{
+  if (!supports_batch_decoding(format, options)) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unspecified,
+            "Decoder plugin cannot decode images in batches"};
+  }
+
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(format, options.decoder_id);
+
+  void* decoder = nullptr;
   struct heif_error err = decoder_plugin->new_decoder(&decoder);
   if (err.code != heif_error_Ok) {
     return Error(err.code, err.subcode, err.message);
   }
 
-  // automatically delete decoder plugin when we leave the scope
-  std::unique_ptr<void, void (*)(void*)> decoderSmartPtr(decoder, decoder_plugin->free_decoder);
+  m_decoder = std::shared_ptr<void>(decoder, decoder_plugin->free_decoder);
+  m_plugin = decoder_plugin;
 
-  if (decoder_plugin->plugin_api_version >= 2) {
-    if (decoder_plugin->set_strict_decoding) {
-      decoder_plugin->set_strict_decoding(decoder, options.strict_decoding);
+  if (decoder_plugin->set_strict_decoding) {
+    decoder_plugin->set_strict_decoding(decoder, options.strict_decoding);
+  }
+
+  if (options.max_codec_threads > 0 && decoder_plugin->set_num_threads) {
+    err = decoder_plugin->set_num_threads(decoder, options.max_codec_threads);
+    if (err.code != heif_error_Ok) {
+      return Error(err.code, err.subcode, err.message);
     }
   }
 
-  auto dataResult = get_compressed_data();
+  return Error::Ok;
+}
+
+
+Error BatchDecoder::push_image(const Decoder& decoder, uintptr_t image_id)
+{
+  assert(m_decoder);
+
+  auto dataResult = decoder.get_compressed_data();
   if (dataResult.error) {
     return dataResult.error;
   }
 
-  err = decoder_plugin->push_data(decoder, dataResult.value.data(), dataResult.value.size());
+  heif_error err = m_plugin->push_batch_image(m_decoder.get(), dataResult.value.data(), dataResult.value.size(), image_id);
   if (err.code != heif_error_Ok) {
     return Error(err.code, err.subcode, err.message);
   }
 
+  return Error::Ok;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> BatchDecoder::get_next_image(uintptr_t* out_image_id)
+{
+  assert(m_decoder);
+
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
   heif_image* decoded_img = nullptr;
+  uintptr_t image_id = 0;
 
-  err = decoder_plugin->decode_image(decoder, &decoded_img);
+  heif_error err = m_plugin->get_next_batch_image(m_decoder.get(), &decoded_img, &image_id);
+  if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
+  }
+
+  if (!decoded_img) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+
+  std::shared_ptr<HeifPixelImage> img = std::move(decoded_img->image);
+  heif_image_release(decoded_img);
+
+  *out_image_id = image_id;
+
+  return img;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Decoder::decode_single_frame_area(const struct heif_decoding_options& options,
+                                  uint32_t x0, uint32_t y0, uint32_t w, uint32_t h)
+{
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(get_compression_format(), options.decoder_id);
+  if (!decoder_plugin ||
+      decoder_plugin->plugin_api_version < 4 ||
+      decoder_plugin->set_decode_area == nullptr) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  HEIF_TRACE_SCOPE("decode", "codec area");
+
+  DecodeArea area{x0, y0, w, h};
+
+  auto decoderResult = start_plugin_decoder(decoder_plugin, options, &area);
+  if (decoderResult.error) {
+    if (decoderResult.error.error_code == heif_error_Unsupported_feature) {
+      return std::shared_ptr<HeifPixelImage>();
+    }
+
+    return decoderResult.error;
+  }
+
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+
+  auto imgResult = run_plugin_decoder(decoder_plugin, *decoderResult);
+  if (imgResult.error) {
+    return imgResult.error;
+  }
+
+  if ((*imgResult)->get_width() != w || (*imgResult)->get_height() != h) {
+    return Error(heif_error_Decoder_plugin_error, heif_suberror_Unspecified,
+                 "Decoded area has a different size than requested");
+  }
+
+  return imgResult;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Decoder::run_plugin_decoder(const struct heif_decoder_plugin* decoder_plugin, const std::shared_ptr<void>& decoder)
+{
+  heif_image* decoded_img = nullptr;
+
+  heif_error err = decoder_plugin->decode_image(decoder.get(), &decoded_img);
   if (err.code != heif_error_Ok) {
     return Error(err.code, err.subcode, err.message);
   }
@@ -302,3 +866,134 @@ Decoder::decode_single_frame_from_compressed_data(const struct heif_decoding_opt
 
   return img;
 }
+
+
+Result<bool>
+Decoder::decode_single_frame_into_image(const struct heif_decoding_options& options,
+                                        const std::shared_ptr<HeifPixelImage>& target, uint32_t x0, uint32_t y0)
+{
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(get_compression_format(), options.decoder_id);
+  if (!decoder_plugin ||
+      decoder_plugin->plugin_api_version < 4 ||
+      decoder_plugin->decode_image_into == nullptr) {
+    return false;
+  }
+
+  // The plugin can only check the target format after decoding. Check what we know before.
+
+  heif_colorspace colorspace;
+  heif_chroma chroma;
+  if (get_coded_image_colorspace(&colorspace, &chroma) ||
+      colorspace != target->get_colorspace() ||
+      chroma != target->get_chroma_format() ||
+      get_luma_bits_per_pixel() != target->get_bits_per_pixel(heif_channel_Y)) {
+    return false;
+  }
+
+  if (chroma == heif_chroma_420 || chroma == heif_chroma_422) {
+    if (x0 % 2 != 0 || (chroma == heif_chroma_420 && y0 % 2 != 0)) {
+      return false;
+    }
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
+  auto decoderResult = start_plugin_decoder(decoder_plugin, options);
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  heif_image target_img;
+  target_img.image = target;
+
+  heif_error err = decoder_plugin->decode_image_into(decoderResult.value.get(), &target_img, x0, y0);
+  if (err.code == heif_error_Unsupported_feature && err.subcode == heif_suberror_Unsupported_color_conversion) {
+    return false;
+  }
+  else if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
+  }
+
+  return true;
+}
+
+
+Result<heif_gpu_surface>
+Decoder::decode_single_frame_to_gpu_surface(const struct heif_decoding_options& options, heif_gpu_surface_type type)
+{
+  const struct heif_decoder_plugin* decoder_plugin = get_decoder(get_compression_format(), options.decoder_id);
+  if (!decoder_plugin) {
+    return Error(heif_error_Plugin_loading_error, heif_suberror_No_matching_decoder_installed);
+  }
+
+  if (decoder_plugin->plugin_api_version < 4 ||
+      decoder_plugin->decode_image_to_gpu_surface == nullptr) {
+    return Error(heif_error_Unsupported_feature, heif_suberror_Unspecified,
+                 "Decoder plugin cannot output GPU surfaces");
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
+  auto decoderResult = start_plugin_decoder(decoder_plugin, get_full_resolution_decoding_options(options));
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  heif_gpu_surface surface{};
+  surface.version = 1;
+  surface.type = type;
+
+  heif_error err = decoder_plugin->decode_image_to_gpu_surface(decoderResult.value.get(), type, &surface);
+  if (err.code != heif_error_Ok) {
+    return Error(err.code, err.subcode, err.message);
+  }
+
+  return surface;
+}
+
+
+GpuSurfaceList::~GpuSurfaceList()
+{
+  for (auto& tile : m_tiles) {
+    if (tile.surface.release) {
+      tile.surface.release(tile.surface.release_data);
+    }
+  }
+}
+
+
+void GpuSurfaceList::add(const heif_gpu_surface& surface, uint32_t x, uint32_t y)
+{
+  heif_gpu_surface_tile tile{};
+  tile.x = x;
+  tile.y = y;
+  tile.surface = surface;
+
+  m_tiles.push_back(tile);
+}
+
+
+heif_decoding_options get_full_resolution_decoding_options(const heif_decoding_options& options)
+{
+  heif_decoding_options full_resolution_options = options;
+  full_resolution_options.target_scale_denominator = 1;
+  return full_resolution_options;
+}
+
+
+heif_decoding_options get_decoding_options_with_codec_threads(const heif_decoding_options& options,
+                                                              int max_threads, size_t num_parallel_decodes)
+{
+  heif_decoding_options threaded_options = options;
+
+  if (threaded_options.max_codec_threads == 0) {
+    size_t share = static_cast<size_t>(std::max(max_threads, 1)) / std::max(num_parallel_decodes, size_t{1});
+    threaded_options.max_codec_threads = static_cast<int>(std::max(share, size_t{1}));
+  }
+
+  return threaded_options;
+}
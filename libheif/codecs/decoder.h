@@ -22,11 +22,14 @@
 #define HEIF_DECODER_H
 
 #include "libheif/heif.h"
+#include "libheif/heif_experimental.h"
 #include "box.h"
 #include "error.h"
 #include "file.h"
+#include "codecs/decoder_instance_pool.h"
 
 #include <memory>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -58,6 +61,13 @@ struct DataExtent
   Result<std::vector<uint8_t>*> read_data() const;
 
   Result<std::vector<uint8_t>> read_data(uint64_t offset, uint64_t size) const;
+
+  // Size of the data, without reading it.
+  Result<uint64_t> get_data_size() const;
+
+  // Returns the data without copying it, if it is available in memory in one piece.
+  // Returns an empty span if read_data() has to be used.
+  std::span<const uint8_t> get_data_without_copy() const;
 };
 
 
@@ -77,6 +87,9 @@ public:
 
   const DataExtent& get_data_extent() const { return m_data_extent; }
 
+  // Decoder plugin instances are taken from this pool and returned to it after decoding.
+  void set_instance_pool(std::shared_ptr<DecoderInstancePool> pool) { m_instance_pool = std::move(pool); }
+
   // --- information about the image format
 
   [[nodiscard]] virtual int get_luma_bits_per_pixel() const = 0;
@@ -91,13 +104,149 @@ public:
 
   Result<std::vector<uint8_t>> get_compressed_data() const;
 
+  // Number of bytes of the NAL unit sizes in the coded data. 0 if the codec does not use NAL units.
+  [[nodiscard]] virtual uint8_t get_nal_unit_length_size() const { return 0; }
+
+  // The coded data of AVC, HEVC and VVC images as an Annex-B byte stream with start codes instead of NAL unit sizes,
+  // optionally preceded by the parameter sets of the configuration box.
+  Result<std::vector<uint8_t>> get_annexb_data(bool include_parameter_sets) const;
+
   // --- decoding
 
+  // If options.target_scale_denominator > 1 and the decoder plugin supports it, the image may be decoded
+  // at reduced resolution. The caller has to check the size of the returned image.
   virtual Result<std::shared_ptr<HeifPixelImage>>
   decode_single_frame_from_compressed_data(const struct heif_decoding_options& options);
 
+  // Decodes the frame directly into the planes of 'target', with its top-left corner at (x0,y0).
+  // Returns false if the decoder plugin cannot do this for the given target. The image is then not decoded and
+  // decode_single_frame_from_compressed_data() has to be used instead.
+  virtual Result<bool>
+  decode_single_frame_into_image(const struct heif_decoding_options& options,
+                                 const std::shared_ptr<HeifPixelImage>& target, uint32_t x0, uint32_t y0);
+
+  // Decodes only the area of w x h samples with its top-left corner at (x0,y0) of the full-resolution frame.
+  // Returns a null image if the decoder plugin cannot restrict decoding to an area. The frame is then not decoded
+  // and decode_single_frame_from_compressed_data() has to be used instead.
+  Result<std::shared_ptr<HeifPixelImage>>
+  decode_single_frame_area(const struct heif_decoding_options& options,
+                           uint32_t x0, uint32_t y0, uint32_t w, uint32_t h);
+
+  // Decodes the frame into a GPU surface. The caller has to release the surface.
+  // Returns heif_error_Unsupported_feature if the decoder plugin cannot output this surface type.
+  Result<heif_gpu_surface> decode_single_frame_to_gpu_surface(const struct heif_decoding_options& options,
+                                                              heif_gpu_surface_type type);
+
+  // --- decoding of sequences with inter-frame prediction
+  //
+  // One decoder plugin instance is kept for all samples. The samples are pushed in decoding order (with the
+  // data extent set to the sample) and the decoder outputs the images in its output order.
+
+  // Whether the decoder plugin can decode samples that depend on each other with one decoder instance.
+  bool supports_sequence_decoding(const struct heif_decoding_options& options) const;
+
+  // Starts the decoder plugin instance and passes the configuration data to it.
+  Error start_sequence_decoding(const struct heif_decoding_options& options);
+
+  bool is_sequence_decoding_started() const { return m_sequence_decoder != nullptr; }
+
+  // Pushes the current data extent as one sample. 'user_data' is returned with the image decoded from it.
+  Error push_sequence_sample(uintptr_t user_data);
+
+  // After the last sample, the decoder outputs all images that it still holds back.
+  Error flush_sequence();
+
+  // Returns a null image if the decoder needs more data, or after the last image when the sequence was flushed.
+  Result<std::shared_ptr<HeifPixelImage>> get_next_sequence_image(uintptr_t* out_user_data);
+
+  // Releases the decoder plugin instance.
+  void end_sequence_decoding();
+
 private:
   DataExtent m_data_extent;
+
+  std::shared_ptr<DecoderInstancePool> m_instance_pool;
+
+  const struct heif_decoder_plugin* m_sequence_plugin = nullptr;
+  std::shared_ptr<void> m_sequence_decoder;
+
+  struct DecodeArea
+  {
+    uint32_t x0, y0, w, h;
+  };
+
+  // Creates a plugin decoder instance (or takes one from the pool) and sets the decoding options.
+  // If 'area' is given, the plugin is asked to decode only this area.
+  Result<std::shared_ptr<void>> create_plugin_decoder(const struct heif_decoder_plugin* decoder_plugin,
+                                                      const struct heif_decoding_options& options,
+                                                      const std::vector<uint8_t>& configuration,
+                                                      const DecodeArea* area = nullptr);
+
+  // Creates a plugin decoder instance, sets the decoding options and pushes the compressed data into it.
+  // If 'area' is given, the plugin is asked to decode only this area.
+  Result<std::shared_ptr<void>> start_plugin_decoder(const struct heif_decoder_plugin* decoder_plugin,
+                                                     const struct heif_decoding_options& options,
+                                                     const DecodeArea* area = nullptr);
+
+  Result<std::shared_ptr<HeifPixelImage>> run_plugin_decoder(const struct heif_decoder_plugin* decoder_plugin,
+                                                             const std::shared_ptr<void>& decoder);
 };
 
+
+// Decodes several independent images of one compression format (e.g. grid tiles) with one decoder plugin instance.
+// The images are pushed with push_image(). Then get_next_image() returns the decoded images in any order.
+// Afterwards, the next batch of images can be pushed.
+class BatchDecoder
+{
+public:
+  // Whether the decoder plugin for 'format' supports batch decoding.
+  static bool supports_batch_decoding(heif_compression_format format, const struct heif_decoding_options& options);
+
+  // Starts the decoder plugin instance and sets the decoding options, including max_codec_threads.
+  Error start(heif_compression_format format, const struct heif_decoding_options& options);
+
+  // Pushes the coded data of the image at the data extent of 'decoder', including its configuration data.
+  // 'image_id' is returned with the decoded image.
+  Error push_image(const Decoder& decoder, uintptr_t image_id);
+
+  // Returns a null image when all pushed images have been output.
+  Result<std::shared_ptr<HeifPixelImage>> get_next_image(uintptr_t* out_image_id);
+
+private:
+  const struct heif_decoder_plugin* m_plugin = nullptr;
+  std::shared_ptr<void> m_decoder;
+};
+
+
+// GPU surfaces with their positions in the image. The surfaces are released with the list.
+class GpuSurfaceList
+{
+public:
+  GpuSurfaceList() = default;
+
+  ~GpuSurfaceList();
+
+  GpuSurfaceList(const GpuSurfaceList&) = delete;
+
+  GpuSurfaceList& operator=(const GpuSurfaceList&) = delete;
+
+  void add(const heif_gpu_surface& surface, uint32_t x, uint32_t y);
+
+  const std::vector<heif_gpu_surface_tile>& get_tiles() const { return m_tiles; }
+
+private:
+  std::vector<heif_gpu_surface_tile> m_tiles;
+};
+
+
+// Returns a copy of the options with reduced-resolution decoding disabled.
+// This is used when decoding images that are assembled at full resolution, like grid tiles or overlay layers.
+heif_decoding_options get_full_resolution_decoding_options(const heif_decoding_options& options);
+
+// Returns a copy of the options in which an automatic max_codec_threads (0) is replaced by the share of
+// 'max_threads' that each of 'num_parallel_decodes' images decoded in parallel gets (at least one thread).
+// Options with an explicit number of codec threads are returned unchanged.
+heif_decoding_options get_decoding_options_with_codec_threads(const heif_decoding_options& options,
+                                                              int max_threads, size_t num_parallel_decodes);
+
 #endif
@@ -0,0 +1,113 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "codecs/decoder_instance_pool.h"
+#include <libheif/heif_plugin.h>
+
+#include <iterator>
+#include <utility>
+
+
+DecoderInstancePool::~DecoderInstancePool()
+{
+  clear();
+}
+
+
+bool DecoderInstancePool::supports_reuse(const heif_decoder_plugin* plugin)
+{
+  return plugin->plugin_api_version >= 4 && plugin->reset_decoder != nullptr;
+}
+
+
+void* DecoderInstancePool::acquire(const heif_decoder_plugin* plugin, const std::vector<uint8_t>& configuration)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  for (auto iter = m_instances.rbegin(); iter != m_instances.rend(); ++iter) {
+    if (iter->plugin == plugin && iter->configuration == configuration) {
+      void* decoder = iter->decoder;
+      m_instances.erase(std::next(iter).base());
+      return decoder;
+    }
+  }
+
+  return nullptr;
+}
+
+
+void DecoderInstancePool::release(const heif_decoder_plugin* plugin, const std::vector<uint8_t>& configuration, void* decoder)
+{
+  if (decoder == nullptr) {
+    return;
+  }
+
+  if (!supports_reuse(plugin)) {
+    plugin->free_decoder(decoder);
+    return;
+  }
+
+  // Reset outside of the lock. This may have to wait for the decoder's worker threads.
+
+  heif_error err = plugin->reset_decoder(decoder);
+  if (err.code != heif_error_Ok) {
+    plugin->free_decoder(decoder);
+    return;
+  }
+
+  Instance evicted{};
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+    if (m_instances.size() >= max_unused_instances) {
+      evicted = std::move(m_instances.front());
+      m_instances.pop_front();
+    }
+
+    m_instances.push_back({plugin, configuration, decoder});
+  }
+
+  if (evicted.decoder) {
+    evicted.plugin->free_decoder(evicted.decoder);
+  }
+}
+
+
+void DecoderInstancePool::clear()
+{
+  std::deque<Instance> instances;
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+    instances.swap(m_instances);
+  }
+
+  for (const auto& instance : instances) {
+    instance.plugin->free_decoder(instance.decoder);
+  }
+}
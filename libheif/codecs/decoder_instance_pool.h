@@ -0,0 +1,83 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_DECODER_INSTANCE_POOL_H
+#define LIBHEIF_DECODER_INSTANCE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+struct heif_decoder_plugin;
+
+
+// Keeps decoder plugin instances for reuse, when many images with the same decoder configuration are decoded.
+// Creating a decoder can be more expensive than decoding a small grid tile, because the decoder may set up
+// tables and start worker threads.
+//
+// Each HeifContext has its own pool. Only plugins that implement reset_decoder() are pooled.
+class DecoderInstancePool
+{
+public:
+  DecoderInstancePool() = default;
+
+  ~DecoderInstancePool();
+
+  DecoderInstancePool(const DecoderInstancePool&) = delete;
+
+  DecoderInstancePool& operator=(const DecoderInstancePool&) = delete;
+
+  // Returns an unused decoder instance of the plugin that was used with the same configuration data,
+  // or NULL if there is none.
+  void* acquire(const heif_decoder_plugin* plugin, const std::vector<uint8_t>& configuration);
+
+  // Resets the decoder instance and keeps it for reuse. If the decoder cannot be reset, it is freed.
+  // When the pool is full, the oldest instance is freed.
+  void release(const heif_decoder_plugin* plugin, const std::vector<uint8_t>& configuration, void* decoder);
+
+  // Frees all unused decoder instances.
+  void clear();
+
+  static bool supports_reuse(const heif_decoder_plugin* plugin);
+
+  // More instances than decoding threads are only kept when images with different configurations are decoded.
+  static constexpr size_t max_unused_instances = 16;
+
+private:
+  struct Instance
+  {
+    const heif_decoder_plugin* plugin;
+    std::vector<uint8_t> configuration;
+    void* decoder;
+  };
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::mutex m_mutex;
+#endif
+
+  std::deque<Instance> m_instances; // oldest first
+};
+
+#endif //LIBHEIF_DECODER_INSTANCE_POOL_H
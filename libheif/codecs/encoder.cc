@@ -74,9 +74,11 @@ static std::shared_ptr<color_profile_nclx> compute_target_nclx_profile(const std
 
 
 // TODO: remove me, moved to encoder.cc
+// With 'compare_primaries' = false, differing colour primaries are ignored unless the matrix is derived from them.
 static bool nclx_profile_matches_spec(heif_colorspace colorspace,
                                       std::shared_ptr<const color_profile_nclx> image_nclx,
-                                      const struct heif_color_profile_nclx* spec_nclx)
+                                      const struct heif_color_profile_nclx* spec_nclx,
+                                      bool compare_primaries = true)
 {
   if (colorspace != heif_colorspace_YCbCr) {
     return true;
@@ -100,9 +102,12 @@ static bool nclx_profile_matches_spec(heif_colorspace colorspace,
     return false;
   }
 
-  // TODO: are the colour primaries relevant for matrix-coefficients != 12,13 ?
-  //       If not, we should skip this test for anything else than matrix-coefficients != 12,13.
-  if (image_nclx->get_colour_primaries() != spec_nclx->color_primaries) {
+  uint16_t matrix = image_nclx->get_matrix_coefficients();
+  bool chromaticity_derived_matrix = (matrix == heif_matrix_coefficients_chromaticity_derived_non_constant_luminance ||
+                                      matrix == heif_matrix_coefficients_chromaticity_derived_constant_luminance);
+
+  if ((compare_primaries || chromaticity_derived_matrix) &&
+      image_nclx->get_colour_primaries() != spec_nclx->color_primaries) {
     return false;
   }
 
@@ -146,9 +151,23 @@ Result<std::shared_ptr<HeifPixelImage>> Encoder::convert_colorspace_for_encoding
   std::shared_ptr<HeifPixelImage> output_image;
 
   if (colorspace == image->get_colorspace() &&
-      chroma == image->get_chroma_format() &&
-      nclx_profile_matches_spec(colorspace, image->get_color_profile_nclx(), output_nclx_profile)) {
-    return image;
+      chroma == image->get_chroma_format()) {
+    if (nclx_profile_matches_spec(colorspace, image->get_color_profile_nclx(), output_nclx_profile)) {
+      return image;
+    }
+
+    // Only the colour primaries differ, which do not change the YCbCr values. Pass the planes to the encoder
+    // without copying them, but with the target nclx profile, which the encoder may write into the bitstream.
+    if (nclx_profile_matches_spec(colorspace, image->get_color_profile_nclx(), output_nclx_profile, false)) {
+      auto viewResult = image->create_view(0, 0, image->get_width(), image->get_height());
+      if (viewResult.error) {
+        return viewResult.error;
+      }
+
+      std::shared_ptr<HeifPixelImage> view = *viewResult;
+      view->set_color_profile_nclx(target_nclx_profile);
+      return view;
+    }
   }
 
 
@@ -162,3 +181,117 @@ Result<std::shared_ptr<HeifPixelImage>> Encoder::convert_colorspace_for_encoding
                             output_bpp, options.color_conversion_options, nullptr,
                             security_limits);
 }
+
+
+bool Encoder::supports_sequence_encoding(const struct heif_encoder* encoder) const
+{
+  const heif_encoder_plugin* plugin = encoder->plugin;
+
+  return (can_encode_sequences_with_inter_prediction() &&
+          plugin->plugin_api_version >= 4 &&
+          plugin->start_sequence_encoding != nullptr &&
+          plugin->encode_sequence_frame != nullptr &&
+          plugin->end_sequence_encoding != nullptr &&
+          plugin->get_compressed_data2 != nullptr);
+}
+
+
+Error Encoder::start_sequence_encoding(struct heif_encoder* encoder,
+                                       const heif_sequence_encoding_options& options)
+{
+  struct heif_error err = encoder->plugin->start_sequence_encoding(encoder->encoder, &options);
+  if (err.code) {
+    return Error(err.code,
+                 err.subcode,
+                 err.message);
+  }
+
+  return Error::Ok;
+}
+
+
+Error Encoder::encode_sequence_frame(const std::shared_ptr<HeifPixelImage>& image,
+                                     struct heif_encoder* encoder,
+                                     enum heif_image_input_class input_class,
+                                     uintptr_t frame_number)
+{
+  if (Error err = prepare_sequence_frame(image)) {
+    return err;
+  }
+
+  heif_image c_api_image;
+  c_api_image.image = image;
+
+  struct heif_error err = encoder->plugin->encode_sequence_frame(encoder->encoder, &c_api_image, input_class, frame_number);
+  if (err.code) {
+    return Error(err.code,
+                 err.subcode,
+                 err.message);
+  }
+
+  return Error::Ok;
+}
+
+
+Error Encoder::end_sequence_encoding(struct heif_encoder* encoder)
+{
+  struct heif_error err = encoder->plugin->end_sequence_encoding(encoder->encoder);
+  if (err.code) {
+    return Error(err.code,
+                 err.subcode,
+                 err.message);
+  }
+
+  return Error::Ok;
+}
+
+
+Result<std::optional<Encoder::CodedSequenceFrame>> Encoder::get_coded_sequence_frame(struct heif_encoder* encoder)
+{
+  CodedSequenceFrame frame;
+  bool have_data = false;
+
+  for (;;) {
+    uint8_t* data = nullptr;
+    int size = 0;
+    uintptr_t frame_number = 0;
+    int is_keyframe = 0;
+
+    struct heif_error err = encoder->plugin->get_compressed_data2(encoder->encoder, &data, &size,
+                                                                  &frame_number, &is_keyframe, nullptr);
+    if (err.code) {
+      return Error(err.code,
+                   err.subcode,
+                   err.message);
+    }
+
+    if (data == nullptr) {
+      break;
+    }
+
+    if (have_data && frame_number != frame.frame_number) {
+      return Error(heif_error_Encoder_plugin_error,
+                   heif_suberror_Unspecified,
+                   "Encoder plugin returned packets of different frames without separating them.");
+    }
+
+    frame.frame_number = frame_number;
+    frame.data.is_sync_frame = (is_keyframe != 0);
+    have_data = true;
+
+    add_sequence_packet(frame.data, data, size);
+  }
+
+  if (!have_data) {
+    return {std::nullopt};
+  }
+
+  frame.data.codingConstraints.intra_pred_used = true;
+  frame.data.codingConstraints.all_ref_pics_intra = false;
+
+  if (Error err = finish_sequence_frame(frame.data)) {
+    return err;
+  }
+
+  return {std::move(frame)};
+}
@@ -26,6 +26,7 @@
 #include "libheif/heif_plugin.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -70,6 +71,44 @@ public:
                                         enum heif_image_input_class input_class) { return {}; }
 
   virtual std::shared_ptr<class Box_VisualSampleEntry> get_sample_description_box(const CodedImageData&) const { return {}; }
+
+
+  // --- Encoding of sequences with inter-frame prediction.
+  // Frames are pushed in presentation order and the coded frames are returned in decoding order.
+
+  // Whether the codec and the encoder plugin support encoding with inter-frame prediction.
+  bool supports_sequence_encoding(const struct heif_encoder* encoder) const;
+
+  Error start_sequence_encoding(struct heif_encoder* encoder,
+                                const heif_sequence_encoding_options& options);
+
+  Error encode_sequence_frame(const std::shared_ptr<HeifPixelImage>& image,
+                              struct heif_encoder* encoder,
+                              enum heif_image_input_class input_class,
+                              uintptr_t frame_number);
+
+  Error end_sequence_encoding(struct heif_encoder* encoder);
+
+  struct CodedSequenceFrame
+  {
+    CodedImageData data;
+    uintptr_t frame_number = 0;
+  };
+
+  // Returns the next coded frame or nothing if the encoder needs more input.
+  Result<std::optional<CodedSequenceFrame>> get_coded_sequence_frame(struct heif_encoder* encoder);
+
+protected:
+  virtual bool can_encode_sequences_with_inter_prediction() const { return false; }
+
+  // Called before a frame is sent to the encoder plugin.
+  virtual Error prepare_sequence_frame(const std::shared_ptr<HeifPixelImage>&) { return Error::Ok; }
+
+  // Add a packet from get_compressed_data2() to the coded frame.
+  virtual void add_sequence_packet(CodedImageData&, const uint8_t* data, int size) {}
+
+  // Called when all packets of a frame have been added.
+  virtual Error finish_sequence_frame(CodedImageData&) { return Error::Ok; }
 };
 
 
@@ -38,6 +38,12 @@ Result<std::vector<uint8_t>> Decoder_HEVC::read_bitstream_configuration_data() c
 }
 
 
+uint8_t Decoder_HEVC::get_nal_unit_length_size() const
+{
+  return m_hvcC->get_configuration().m_length_size;
+}
+
+
 int Decoder_HEVC::get_luma_bits_per_pixel() const
 {
   return m_hvcC->get_configuration().bit_depth_luma;
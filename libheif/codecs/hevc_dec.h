@@ -47,6 +47,8 @@ public:
 
   Result<std::vector<uint8_t>> read_bitstream_configuration_data() const override;
 
+  uint8_t get_nal_unit_length_size() const override;
+
 private:
   const std::shared_ptr<const Box_hvcC> m_hvcC;
 };
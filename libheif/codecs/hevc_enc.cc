@@ -23,6 +23,7 @@
 #include "error.h"
 #include "context.h"
 #include "libheif/api_structs.h"
+#include "codecs/nalu_utils.h"
 
 #include <string>
 
@@ -116,6 +117,127 @@ Result<Encoder::CodedImageData> Encoder_HEVC::encode(const std::shared_ptr<HeifP
 }
 
 
+Result<Encoder::CodedImageData> Encoder_HEVC::encapsulate_annexb_bitstream(std::span<const uint8_t> annexb)
+{
+  CodedImageData codedImage;
+
+  auto hvcC = std::make_shared<Box_hvcC>();
+  HEVCDecoderConfigurationRecord config{};
+  bool have_sps = false;
+
+  int encoded_width = 0;
+  int encoded_height = 0;
+
+  const uint8_t NAL_SPS = 33;
+
+  for (std::span<const uint8_t> nal : split_annexb_nal_units(annexb)) {
+    if (nal.size() < 2) {
+      return Error(heif_error_Invalid_input,
+                   heif_suberror_Unspecified,
+                   "Invalid HEVC NAL unit");
+    }
+
+    if ((nal[0] >> 1) == NAL_SPS && !have_sps) {
+      Error err = parse_sps_for_hvcC_configuration(nal.data(), nal.size(), &config, &encoded_width, &encoded_height);
+      if (err) {
+        return err;
+      }
+
+      hvcC->set_configuration(config);
+      have_sps = true;
+    }
+
+    switch (nal[0] >> 1) {
+      case 0x20:
+      case 0x21:
+      case 0x22:
+        hvcC->append_nal_data(nal.data(), nal.size());
+        break;
+
+      default:
+        codedImage.append_with_4bytes_size(nal.data(), nal.size());
+    }
+  }
+
+  if (!have_sps || codedImage.bitstream.empty() || !encoded_width || !encoded_height) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_Unspecified,
+                 "HEVC bitstream has no SPS or no coded image");
+  }
+
+  codedImage.encoded_image_width = encoded_width;
+  codedImage.encoded_image_height = encoded_height;
+
+  codedImage.properties.push_back(hvcC);
+
+  auto ispe = std::make_shared<Box_ispe>();
+  ispe->set_size(encoded_width, encoded_height);
+  codedImage.properties.push_back(ispe);
+
+  auto pixi = std::make_shared<Box_pixi>();
+  pixi->add_channel_bits(config.bit_depth_luma);
+  if (config.chroma_format != heif_chroma_monochrome) {
+    pixi->add_channel_bits(config.bit_depth_chroma);
+    pixi->add_channel_bits(config.bit_depth_chroma);
+  }
+  codedImage.properties.push_back(pixi);
+
+  codedImage.codingConstraints.intra_pred_used = true;
+  codedImage.codingConstraints.all_ref_pics_intra = true;
+
+  return codedImage;
+}
+
+
+void Encoder_HEVC::add_sequence_packet(CodedImageData& codedImage, const uint8_t* data, int size)
+{
+  const uint8_t NAL_SPS = 33;
+
+  switch (data[0] >> 1) {
+    case 0x20:
+    case 0x21:
+    case 0x22:
+      // The parameter sets are stored in the sample description. Repetitions at later keyframes are dropped.
+      if (!m_sequence_hvcC_complete) {
+        if (!m_sequence_hvcC) {
+          m_sequence_hvcC = std::make_shared<Box_hvcC>();
+        }
+
+        if ((data[0] >> 1) == NAL_SPS) {
+          HEVCDecoderConfigurationRecord config;
+
+          parse_sps_for_hvcC_configuration(data, size, &config, &m_sequence_encoded_width, &m_sequence_encoded_height);
+
+          m_sequence_hvcC->set_configuration(config);
+        }
+
+        m_sequence_hvcC->append_nal_data(data, size);
+      }
+      break;
+
+    default:
+      codedImage.append_with_4bytes_size(data, size);
+  }
+}
+
+
+Error Encoder_HEVC::finish_sequence_frame(CodedImageData& codedImage)
+{
+  if (!m_sequence_encoded_width || !m_sequence_encoded_height) {
+    return Error(heif_error_Encoder_plugin_error,
+                 heif_suberror_Invalid_image_size);
+  }
+
+  m_sequence_hvcC_complete = true;
+
+  codedImage.properties.push_back(m_sequence_hvcC);
+  codedImage.encoded_image_width = m_sequence_encoded_width;
+  codedImage.encoded_image_height = m_sequence_encoded_height;
+
+  return Error::Ok;
+}
+
+
 std::shared_ptr<class Box_VisualSampleEntry> Encoder_HEVC::get_sample_description_box(const CodedImageData& data) const
 {
   auto hvc1 = std::make_shared<Box_hvc1>();
@@ -27,6 +27,7 @@
 #include "file.h"
 
 #include <memory>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -41,6 +42,24 @@ public:
                                 enum heif_image_input_class input_class) override;
 
   std::shared_ptr<class Box_VisualSampleEntry> get_sample_description_box(const CodedImageData&) const override;
+
+  // Stores an HEVC image that has already been coded (an Annex-B byte stream) in the coded data of an item,
+  // with the 'hvcC', 'ispe' and 'pixi' properties derived from its parameter sets.
+  static Result<CodedImageData> encapsulate_annexb_bitstream(std::span<const uint8_t> annexb);
+
+protected:
+  bool can_encode_sequences_with_inter_prediction() const override { return true; }
+
+  void add_sequence_packet(CodedImageData&, const uint8_t* data, int size) override;
+
+  Error finish_sequence_frame(CodedImageData&) override;
+
+private:
+  // The parameter sets of a sequence are collected from the first coded frame.
+  std::shared_ptr<class Box_hvcC> m_sequence_hvcC;
+  bool m_sequence_hvcC_complete = false;
+  int m_sequence_encoded_width = 0;
+  int m_sequence_encoded_height = 0;
 };
 
 
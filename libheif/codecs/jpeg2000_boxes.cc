@@ -23,10 +23,14 @@
 #include <cstdint>
 #include <iostream>
 #include <cstdio>
+#include <algorithm>
 
 static const uint16_t JPEG2000_CAP_MARKER = 0xFF50;
 static const uint16_t JPEG2000_SIZ_MARKER = 0xFF51;
 static const uint16_t JPEG2000_SOC_MARKER = 0xFF4F;
+static const uint16_t JPEG2000_TLM_MARKER = 0xFF55;
+static const uint16_t JPEG2000_SOT_MARKER = 0xFF90;
+static const uint16_t JPEG2000_EOC_MARKER = 0xFFD9;
 
 
 Error Box_cdef::parse(BitstreamRange& range, const heif_security_limits* limits)
@@ -516,3 +520,171 @@ heif_chroma JPEG2000MainHeader::get_chroma_format() const
 
   return heif_chroma_undefined;
 }
+
+
+Result<uint64_t> get_next_jpeg2000_tile_part_end(uint64_t codestream_size, uint64_t size,
+                                                 const std::function<Result<std::vector<uint8_t>>(uint64_t offset, uint64_t size)>& read)
+{
+  if (size >= codestream_size) {
+    return codestream_size;
+  }
+
+  // --- read the main header in blocks, up to the first SOT marker
+
+  const uint64_t header_block_size = 4096;
+
+  std::vector<uint8_t> header;
+
+  auto read_header_up_to = [&](uint64_t end) -> Error {
+    if (end > codestream_size) {
+      return {heif_error_Invalid_input,
+              heif_suberror_End_of_data,
+              "JPEG 2000 codestream main header is truncated"};
+    }
+
+    if (end <= header.size()) {
+      return Error::Ok;
+    }
+
+    const uint64_t header_size = header.size();
+    uint64_t block_end = std::min(codestream_size, std::max(end, header_size + header_block_size));
+    auto dataResult = read(header_size, block_end - header_size);
+    if (dataResult.error) {
+      return dataResult.error;
+    }
+
+    header.insert(header.end(), dataResult.value.begin(), dataResult.value.end());
+    return Error::Ok;
+  };
+
+  auto header16 = [&](uint64_t pos) {
+    return static_cast<uint16_t>((header[pos] << 8) | header[pos + 1]);
+  };
+
+  auto header32 = [&](uint64_t pos) {
+    return static_cast<uint32_t>((header16(pos) << 16) | header16(pos + 2));
+  };
+
+  Error err = read_header_up_to(2);
+  if (err) {
+    return err;
+  }
+
+  if (header16(0) != JPEG2000_SOC_MARKER) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Invalid_J2K_codestream,
+                 "JPEG 2000 codestream does not start with an SOC marker"};
+  }
+
+  uint64_t pos = 2;
+  std::vector<uint32_t> tile_part_lengths;
+  bool has_TLM = false;
+
+  for (;;) {
+    err = read_header_up_to(pos + 4);
+    if (err) {
+      return err;
+    }
+
+    uint16_t marker = header16(pos);
+    if (marker == JPEG2000_SOT_MARKER) {
+      break;
+    }
+
+    uint16_t segment_length = header16(pos + 2);
+    if ((marker & 0xFF00) != 0xFF00 || segment_length < 2) {
+      return Error{heif_error_Invalid_input,
+                   heif_suberror_Invalid_J2K_codestream,
+                   "Invalid marker segment in JPEG 2000 main header"};
+    }
+
+    if (marker == JPEG2000_TLM_MARKER) {
+      err = read_header_up_to(pos + 2 + segment_length);
+      if (err) {
+        return err;
+      }
+
+      // TLM: Ztlm (8 bit), Stlm (8 bit), then pairs of tile index (ST bytes) and tile-part length (2 or 4 bytes)
+
+      if (segment_length < 4) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Invalid_J2K_codestream,
+                     "Invalid TLM marker segment"};
+      }
+
+      uint8_t Stlm = header[pos + 5];
+      uint32_t ST = (Stlm >> 4) & 3;
+      uint32_t SP = (Stlm >> 6) & 1;
+      if (ST == 3) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Invalid_J2K_codestream,
+                     "Invalid TLM marker segment"};
+      }
+
+      uint32_t entry_size = ST + (SP ? 4 : 2);
+      uint32_t num_entries = (segment_length - 4) / entry_size;
+
+      for (uint32_t i = 0; i < num_entries; i++) {
+        uint64_t entry_pos = pos + 6 + i * entry_size + ST;
+        tile_part_lengths.push_back(SP ? header32(entry_pos) : header16(entry_pos));
+      }
+
+      has_TLM = true;
+    }
+
+    pos += 2 + segment_length;
+  }
+
+
+  // --- tile-parts
+
+  if (has_TLM) {
+    for (uint32_t length : tile_part_lengths) {
+      if (length == 0) {
+        break;
+      }
+
+      pos += length;
+      if (pos > size) {
+        return std::min(pos, codestream_size);
+      }
+    }
+
+    return codestream_size;
+  }
+
+  // SOT: marker, Lsot (16 bit), Isot (16 bit), Psot (32 bit), TPsot (8 bit), TNsot (8 bit)
+  const uint64_t SOT_segment_size = 12;
+
+  while (pos + SOT_segment_size <= codestream_size) {
+    auto dataResult = read(pos, SOT_segment_size);
+    if (dataResult.error) {
+      return dataResult.error;
+    }
+
+    const std::vector<uint8_t>& sot = *dataResult;
+
+    uint16_t marker = static_cast<uint16_t>((sot[0] << 8) | sot[1]);
+    if (marker == JPEG2000_EOC_MARKER) {
+      break;
+    }
+    else if (marker != JPEG2000_SOT_MARKER) {
+      return Error{heif_error_Invalid_input,
+                   heif_suberror_Invalid_J2K_codestream,
+                   "Missing SOT marker in JPEG 2000 codestream"};
+    }
+
+    uint32_t Psot = (static_cast<uint32_t>(sot[6]) << 24) | (sot[7] << 16) | (sot[8] << 8) | sot[9];
+    if (Psot == 0) {
+      // the last tile-part extends up to the EOC marker
+      break;
+    }
+
+    pos += Psot;
+    if (pos > size) {
+      return std::min(pos, codestream_size);
+    }
+  }
+
+  return codestream_size;
+}
@@ -29,6 +29,7 @@
 #include <vector>
 #include <memory>
 #include <utility>
+#include <functional>
 
 /**
  * JPEG 2000 Channel Definition box.
@@ -517,6 +518,20 @@ private:
 };
 
 
+/**
+ * Find the next progressive refinement step in a JPEG 2000 codestream.
+ *
+ * Returns the smallest codestream size larger than 'size' at which a tile-part ends. Decoding the codestream
+ * truncated at this size adds the data of this tile-part to the image. The tile-part lengths are taken from
+ * the TLM marker segments if the main header has them. Otherwise, the SOT marker segments are read.
+ *
+ * @param codestream_size the total size of the codestream
+ * @param read reads the given range of the codestream. Only the marker segments are read.
+ */
+Result<uint64_t> get_next_jpeg2000_tile_part_end(uint64_t codestream_size, uint64_t size,
+                                                 const std::function<Result<std::vector<uint8_t>>(uint64_t offset, uint64_t size)>& read);
+
+
 class Box_j2ki : public Box_VisualSampleEntry
 {
 public:
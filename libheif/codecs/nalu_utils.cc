@@ -0,0 +1,91 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nalu_utils.h"
+
+
+Error append_nal_units_as_annexb(std::vector<uint8_t>& dest, std::span<const uint8_t> data, uint8_t length_size)
+{
+  static const uint8_t start_code[] = {0, 0, 0, 1};
+
+  size_t pos = 0;
+  while (pos < data.size()) {
+    if (data.size() - pos < length_size) {
+      return {heif_error_Invalid_input,
+              heif_suberror_End_of_data,
+              "Incomplete NAL unit size"};
+    }
+
+    size_t nal_size = 0;
+    for (uint8_t i = 0; i < length_size; i++) {
+      nal_size = (nal_size << 8) | data[pos + i];
+    }
+    pos += length_size;
+
+    if (nal_size > data.size() - pos) {
+      return {heif_error_Invalid_input,
+              heif_suberror_End_of_data,
+              "NAL unit exceeds the coded data"};
+    }
+
+    dest.insert(dest.end(), std::begin(start_code), std::end(start_code));
+    dest.insert(dest.end(), data.begin() + pos, data.begin() + pos + nal_size);
+    pos += nal_size;
+  }
+
+  return Error::Ok;
+}
+
+
+std::vector<std::span<const uint8_t>> split_annexb_nal_units(std::span<const uint8_t> data)
+{
+  std::vector<std::span<const uint8_t>> nal_units;
+
+  // position after the last start code, or data.size() if there is none yet
+  size_t nal_start = data.size();
+
+  auto add_nal_unit = [&](size_t nal_end) {
+    // Zero bytes at the end belong to the next start code (trailing_zero_8bits).
+    while (nal_end > nal_start && data[nal_end - 1] == 0) {
+      nal_end--;
+    }
+
+    if (nal_end > nal_start) {
+      nal_units.push_back(data.subspan(nal_start, nal_end - nal_start));
+    }
+  };
+
+  for (size_t i = 0; i + 2 < data.size(); i++) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      if (nal_start < data.size()) {
+        add_nal_unit(i);
+      }
+
+      nal_start = i + 3;
+      i += 2;
+    }
+  }
+
+  if (nal_start < data.size()) {
+    add_nal_unit(data.size());
+  }
+
+  return nal_units;
+}
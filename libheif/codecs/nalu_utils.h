@@ -0,0 +1,38 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_NALU_UTILS_H
+#define LIBHEIF_NALU_UTILS_H
+
+#include "error.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+// Appends NAL units that are each preceded by their size in 'length_size' bytes (as stored in HEIF files)
+// to 'dest' as an Annex-B byte stream, in which each NAL unit is preceded by a start code.
+Error append_nal_units_as_annexb(std::vector<uint8_t>& dest, std::span<const uint8_t> data, uint8_t length_size);
+
+// Splits an Annex-B byte stream into its NAL units. The returned NAL units do not include the start codes.
+std::vector<std::span<const uint8_t>> split_annexb_nal_units(std::span<const uint8_t> data);
+
+#endif
@@ -38,6 +38,15 @@
 #include "unc_types.h"
 #include "unc_boxes.h"
 #include "unc_codec.h"
+#include "cpu_features.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
 #include "decoder_abstract.h"
 #include "codecs/decoder.h"
 #include "codecs/uncompressed/unc_codec.h"
@@ -98,6 +107,11 @@ void AbstractDecoder::processComponentSample(UncompressedBitReader& srcBits, con
 // Not valid for multi-Y pixel interleave
 void AbstractDecoder::processComponentRow(ChannelListEntry& entry, UncompressedBitReader& srcBits, uint64_t dst_row_offset, uint32_t tile_column)
 {
+  uint64_t dst_column_offset = uint64_t{tile_column} * entry.tile_width * entry.bytes_per_component_sample;
+  if (processComponentRowFast(entry, srcBits, entry.dst_plane + dst_row_offset + dst_column_offset)) {
+    return;
+  }
+
   for (uint32_t tile_x = 0; tile_x < entry.tile_width; tile_x++) {
     if (entry.component_alignment != 0) {
       srcBits.skip_to_byte_boundary();
@@ -109,6 +123,224 @@ void AbstractDecoder::processComponentRow(ChannelListEntry& entry, UncompressedB
   srcBits.skip_to_byte_boundary();
 }
 
+// --- specialized row decoders
+
+static inline void store_native(uint8_t* dst, uint32_t value, uint32_t bytes_per_sample)
+{
+  if (bytes_per_sample == 1) {
+    *dst = static_cast<uint8_t>(value);
+  }
+  else {
+    uint16_t v = static_cast<uint16_t>(value);
+    memcpy(dst, &v, 2);
+  }
+}
+
+
+// Converts big-endian 16-bit samples to native byte order and masks off padding bits.
+// The SIMD kernels return the number of converted samples. The rest is converted by the scalar code.
+typedef uint32_t (*be16_row_kernel)(const uint8_t* src, uint8_t* dst, uint32_t num_samples, uint16_t mask);
+
+#if HEIF_HAVE_X86_SIMD
+HEIF_TARGET_SSE41
+static uint32_t be16_row_to_native_sse41(const uint8_t* src, uint8_t* dst, uint32_t num_samples, uint16_t mask)
+{
+  const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  const __m128i vmask = _mm_set1_epi16(static_cast<short>(mask));
+
+  uint32_t i = 0;
+  for (; i + 8 <= num_samples; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+    v = _mm_and_si128(_mm_shuffle_epi8(v, swap), vmask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), v);
+  }
+
+  return i;
+}
+#endif
+
+#if HEIF_HAVE_NEON
+static uint32_t be16_row_to_native_neon(const uint8_t* src, uint8_t* dst, uint32_t num_samples, uint16_t mask)
+{
+  const uint16x8_t vmask = vdupq_n_u16(mask);
+
+  uint32_t i = 0;
+  for (; i + 8 <= num_samples; i += 8) {
+    uint16x8_t v = vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(src + 2 * i)));
+    vst1q_u8(dst + 2 * i, vreinterpretq_u8_u16(vandq_u16(v, vmask)));
+  }
+
+  return i;
+}
+#endif
+
+// The kernels swap the bytes of each sample, independent of the host byte order.
+static be16_row_kernel get_swap16_row_kernel()
+{
+  static const be16_row_kernel kernel = []() -> be16_row_kernel {
+#if HEIF_HAVE_X86_SIMD
+    if (cpu_supports_sse41()) {
+      return be16_row_to_native_sse41;
+    }
+#endif
+#if HEIF_HAVE_NEON
+    if (cpu_supports_neon()) {
+      return be16_row_to_native_neon;
+    }
+#endif
+    return nullptr;
+  }();
+
+  return kernel;
+}
+
+
+void unc_be16_row_to_native(const uint8_t* src, uint8_t* dst, uint32_t num_samples, uint16_t mask)
+{
+  uint32_t i = 0;
+  if (std::endian::native == std::endian::little) {
+    if (auto kernel = get_swap16_row_kernel()) {
+      i = kernel(src, dst, num_samples, mask);
+    }
+  }
+
+  for (; i < num_samples; i++) {
+    store_native(dst + 2 * i, ((src[2 * i] << 8) | src[2 * i + 1]) & mask, 2);
+  }
+}
+
+
+void unc_swap16_row(const uint8_t* src, uint8_t* dst, uint32_t num_samples)
+{
+  uint32_t i = 0;
+  if (auto kernel = get_swap16_row_kernel()) {
+    i = kernel(src, dst, num_samples, 0xFFFF);
+  }
+
+  for (; i < num_samples; i++) {
+    dst[2 * i] = src[2 * i + 1];
+    dst[2 * i + 1] = src[2 * i];
+  }
+}
+
+
+void unc_packed_row_to_native(const uint8_t* src, uint8_t* dst, uint32_t num_samples,
+                              uint32_t bits_per_sample, uint32_t bytes_per_sample)
+{
+  uint32_t i = 0;
+
+  // unrolled versions for the common bit depths that repeat after a few bytes
+
+  if (bits_per_sample == 12) {
+    for (; i + 2 <= num_samples; i += 2, src += 3) {
+      store_native(dst + 2 * i, (src[0] << 4) | (src[1] >> 4), 2);
+      store_native(dst + 2 * (i + 1), ((src[1] & 0x0F) << 8) | src[2], 2);
+    }
+  }
+  else if (bits_per_sample == 10) {
+    for (; i + 4 <= num_samples; i += 4, src += 5) {
+      store_native(dst + 2 * i, (src[0] << 2) | (src[1] >> 6), 2);
+      store_native(dst + 2 * (i + 1), ((src[1] & 0x3F) << 4) | (src[2] >> 4), 2);
+      store_native(dst + 2 * (i + 2), ((src[2] & 0x0F) << 6) | (src[3] >> 2), 2);
+      store_native(dst + 2 * (i + 3), ((src[3] & 0x03) << 8) | src[4], 2);
+    }
+  }
+
+  // remaining samples
+
+  uint32_t acc = 0;
+  uint32_t acc_bits = 0;
+
+  for (; i < num_samples; i++) {
+    while (acc_bits < bits_per_sample) {
+      acc = (acc << 8) | *src++;
+      acc_bits += 8;
+    }
+
+    acc_bits -= bits_per_sample;
+    store_native(dst + i * bytes_per_sample, acc >> acc_bits, bytes_per_sample);
+    acc &= (1U << acc_bits) - 1;
+  }
+}
+
+
+static AbstractDecoder::RowLayout select_row_layout(uint32_t bits_per_sample, uint32_t component_alignment)
+{
+  using RowLayout = AbstractDecoder::RowLayout;
+
+  if (bits_per_sample == 0 || bits_per_sample > 16) {
+    return RowLayout::generic;
+  }
+
+  uint32_t bytes_per_sample = (bits_per_sample + 7) / 8;
+
+  if ((bits_per_sample % 8 == 0 && component_alignment == 0) || component_alignment == bytes_per_sample) {
+    return bytes_per_sample == 1 ? RowLayout::bytes8 : RowLayout::bytes16;
+  }
+
+  if (component_alignment == 0) {
+    return RowLayout::packed;
+  }
+
+  return RowLayout::generic;
+}
+
+
+bool AbstractDecoder::processComponentRowFast(const ChannelListEntry& entry, UncompressedBitReader& srcBits, uint8_t* dst)
+{
+  if (entry.row_layout == RowLayout::generic || !srcBits.is_at_byte_boundary()) {
+    return false;
+  }
+
+  const uint32_t num_samples = entry.tile_width;
+  const uint32_t bits = entry.bits_per_component_sample;
+  const uint16_t mask = static_cast<uint16_t>((1U << bits) - 1);
+
+  uint64_t row_bytes;
+  switch (entry.row_layout) {
+    case RowLayout::bytes8:
+      row_bytes = num_samples;
+      break;
+    case RowLayout::bytes16:
+      row_bytes = uint64_t{num_samples} * 2;
+      break;
+    default:
+      row_bytes = (uint64_t{num_samples} * bits + 7) / 8;
+      break;
+  }
+
+  // Leave truncated data to the generic code.
+  if (row_bytes > static_cast<uint64_t>(srcBits.get_bytes_remaining())) {
+    return false;
+  }
+
+  const uint8_t* src = srcBits.get_current_byte_pointer();
+
+  switch (entry.row_layout) {
+    case RowLayout::bytes8:
+      if (bits == 8) {
+        memcpy(dst, src, num_samples);
+      }
+      else {
+        for (uint32_t x = 0; x < num_samples; x++) {
+          dst[x] = static_cast<uint8_t>(src[x] & mask);
+        }
+      }
+      break;
+    case RowLayout::bytes16:
+      unc_be16_row_to_native(src, dst, num_samples, mask);
+      break;
+    default:
+      unc_packed_row_to_native(src, dst, num_samples, bits, entry.bytes_per_component_sample);
+      break;
+  }
+
+  srcBits.skip_bytes(static_cast<int>(row_bytes));
+
+  return true;
+}
+
+
 void AbstractDecoder::processComponentTileSample(UncompressedBitReader& srcBits, const ChannelListEntry& entry, uint64_t dst_offset, uint32_t tile_x)
 {
   uint64_t dst_sample_offset = uint64_t{tile_x} * entry.bytes_per_component_sample;
@@ -122,6 +354,10 @@ void AbstractDecoder::processComponentTileSample(UncompressedBitReader& srcBits,
 // Not valid for multi-Y pixel interleave
 void AbstractDecoder::processComponentTileRow(ChannelListEntry& entry, UncompressedBitReader& srcBits, uint64_t dst_offset)
 {
+  if (processComponentRowFast(entry, srcBits, entry.dst_plane + dst_offset)) {
+    return;
+  }
+
   for (uint32_t tile_x = 0; tile_x < entry.tile_width; tile_x++) {
     if (entry.component_alignment != 0) {
       srcBits.skip_to_byte_boundary();
@@ -162,6 +398,7 @@ AbstractDecoder::ChannelListEntry AbstractDecoder::buildChannelListEntry(Box_unc
   entry.component_alignment = component.component_align_size;
   entry.bytes_per_component_sample = (component.component_bit_depth + 7) / 8;
   entry.bytes_per_tile_row_src = entry.tile_width * entry.bytes_per_component_sample;
+  entry.row_layout = select_row_layout(entry.bits_per_component_sample, entry.component_alignment);
   return entry;
 }
 
@@ -180,6 +417,13 @@ const Error AbstractDecoder::get_compressed_image_data_uncompressed(const DataEx
 
   if (!cmpC_box) {
     // assume no generic compression
+
+    std::span<const uint8_t> mapped_data = dataExtent.get_data_without_copy();
+    if (!mapped_data.empty() && range_start_offset <= mapped_data.size() && range_size <= mapped_data.size() - range_start_offset) {
+      data->insert(data->end(), mapped_data.begin() + range_start_offset, mapped_data.begin() + range_start_offset + range_size);
+      return Error::Ok;
+    }
+
     auto readResult = dataExtent.read_data(range_start_offset, range_size);
     if (readResult.error) {
       return readResult.error;
@@ -190,6 +434,10 @@ const Error AbstractDecoder::get_compressed_image_data_uncompressed(const DataEx
     return Error::Ok;
   }
 
+  // --- get the compressed data, without copying it if it is available in memory
+
+  std::span<const uint8_t> mapped_data = dataExtent.get_data_without_copy();
+
   if (icef_box && cmpC_box->get_compressed_unit_type() == heif_cmpC_compressed_unit_type_image_tile) {
     const auto& units = icef_box->get_units();
     if (tile_idx >= units.size()) {
@@ -201,110 +449,267 @@ const Error AbstractDecoder::get_compressed_image_data_uncompressed(const DataEx
     const auto unit = units[tile_idx];
 
     // get data needed for one tile
-    Result<std::vector<uint8_t>> readingResult = dataExtent.read_data(unit.unit_offset, unit.unit_size);
-    if (readingResult.error) {
-      return readingResult.error;
+    std::span<const uint8_t> compressed_bytes;
+    std::vector<uint8_t> read_bytes;
+
+    if (!mapped_data.empty() && unit.unit_offset <= mapped_data.size() && unit.unit_size <= mapped_data.size() - unit.unit_offset) {
+      compressed_bytes = mapped_data.subspan(unit.unit_offset, unit.unit_size);
     }
+    else {
+      Result<std::vector<uint8_t>> readingResult = dataExtent.read_data(unit.unit_offset, unit.unit_size);
+      if (readingResult.error) {
+        return readingResult.error;
+      }
 
-    const std::vector<uint8_t>& compressed_bytes = readingResult.value;
+      read_bytes = std::move(readingResult.value);
+      compressed_bytes = read_bytes;
+    }
 
-    // decompress only the unit
-    Error err = do_decompress_data(cmpC_box, compressed_bytes, data);
-    if (err) {
-      return err;
+    // Decompress only the unit, directly into the output. We need the first range_size bytes of the tile.
+    size_t start = data->size();
+    data->resize(start + range_size);
+
+    Result<size_t> decompressResult = do_decompress_data(cmpC_box, compressed_bytes, std::span<uint8_t>(data->data() + start, range_size));
+    if (decompressResult.error) {
+      return decompressResult.error;
+    }
+
+    if (decompressResult.value != range_size) {
+      return {heif_error_Invalid_input,
+              heif_suberror_Decompression_invalid_data,
+              "compressed unci tile is smaller than expected"};
     }
   }
-  else if (icef_box) {
+  else {
     // get all data and decode all
-    Result<std::vector<uint8_t>*> readResult = dataExtent.read_data();
-    if (readResult.error) {
-      return readResult.error;
-    }
 
-    const std::vector<uint8_t>& compressed_bytes = *readResult.value;
+    std::span<const uint8_t> compressed_bytes = mapped_data;
+    if (compressed_bytes.empty()) {
+      Result<std::vector<uint8_t>*> readResult = dataExtent.read_data();
+      if (readResult.error) {
+        return readResult.error;
+      }
 
-    for (Box_icef::CompressedUnitInfo unit_info : icef_box->get_units()) {
-      auto unit_start = compressed_bytes.begin() + unit_info.unit_offset;
-      auto unit_end = unit_start + unit_info.unit_size;
-      std::vector<uint8_t> compressed_unit_data = std::vector<uint8_t>(unit_start, unit_end);
-      std::vector<uint8_t> uncompressed_unit_data;
-      Error err = do_decompress_data(cmpC_box, std::move(compressed_unit_data), &uncompressed_unit_data);
+      compressed_bytes = *readResult.value;
+    }
+
+    if (icef_box) {
+      for (Box_icef::CompressedUnitInfo unit_info : icef_box->get_units()) {
+        if (unit_info.unit_offset > compressed_bytes.size() || unit_info.unit_size > compressed_bytes.size() - unit_info.unit_offset) {
+          return {heif_error_Invalid_input,
+                  heif_suberror_Unspecified,
+                  "icef-box unit exceeds the item data"};
+        }
+
+        Error err = do_decompress_data(cmpC_box, compressed_bytes.subspan(unit_info.unit_offset, unit_info.unit_size), data);
+        if (err) {
+          return err;
+        }
+      }
+    }
+    else {
+      // Decode as a single blob
+      Error err = do_decompress_data(cmpC_box, compressed_bytes, data);
       if (err) {
         return err;
       }
-      data->insert(data->end(), uncompressed_unit_data.data(), uncompressed_unit_data.data() + uncompressed_unit_data.size());
     }
 
     // cut out the range that we actually need
-    memcpy(data->data(), data->data() + range_start_offset, range_size);
+    if (range_start_offset > data->size() || range_size > data->size() - range_start_offset) {
+      return {heif_error_Invalid_input,
+              heif_suberror_Decompression_invalid_data,
+              "decompressed unci data is smaller than expected"};
+    }
+
+    memmove(data->data(), data->data() + range_start_offset, range_size);
     data->resize(range_size);
   }
-  else {
-    // get all data and decode all
-    Result<std::vector<uint8_t>*> readResult = dataExtent.read_data();
+
+  return Error::Ok;
+}
+
+
+Result<bool> AbstractDecoder::get_uncompressed_row_data(const DataExtent& dataExtent,
+                                                        const UncompressedImageCodec::unci_properties& properties,
+                                                        std::vector<uint8_t>* data,
+                                                        uint64_t range_start_offset, uint64_t range_size,
+                                                        uint64_t first_unit, uint32_t num_units, uint64_t total_units) const
+{
+  std::shared_ptr<const Box_cmpC> cmpC_box = properties.cmpC;
+  std::shared_ptr<const Box_icef> icef_box = properties.icef;
+
+  if (!cmpC_box) {
+    Error err = get_compressed_image_data_uncompressed(dataExtent, properties, data, range_start_offset, range_size, 0, nullptr);
+    if (err) {
+      return err;
+    }
+
+    return true;
+  }
+
+  if (!icef_box ||
+      cmpC_box->get_compressed_unit_type() != heif_cmpC_compressed_unit_type_image_row ||
+      icef_box->get_units().size() != total_units ||
+      first_unit + num_units > total_units ||
+      num_units == 0) {
+    return false;
+  }
+
+  const auto& units = icef_box->get_units();
+
+  // --- get the compressed data of the units. Units of successive rows are usually stored one after the other
+  //     and are read with a single request.
+
+  std::span<const uint8_t> mapped_data = dataExtent.get_data_without_copy();
+
+  bool contiguous = true;
+  for (uint64_t i = first_unit + 1; i < first_unit + num_units; i++) {
+    if (units[i].unit_offset != units[i - 1].unit_offset + units[i - 1].unit_size) {
+      contiguous = false;
+      break;
+    }
+  }
+
+  uint64_t span_start = units[first_unit].unit_offset;
+  uint64_t span_end = units[first_unit + num_units - 1].unit_offset + units[first_unit + num_units - 1].unit_size;
+
+  std::vector<uint8_t> read_bytes;
+  if (mapped_data.empty() && contiguous) {
+    Result<std::vector<uint8_t>> readResult = dataExtent.read_data(span_start, span_end - span_start);
     if (readResult.error) {
       return readResult.error;
     }
 
-    std::vector<uint8_t> compressed_bytes = *readResult.value;
+    read_bytes = std::move(readResult.value);
+  }
+
+  // --- decompress the units
+
+  size_t start = data->size();
+
+  for (uint64_t i = first_unit; i < first_unit + num_units; i++) {
+    const auto& unit = units[i];
+
+    std::span<const uint8_t> compressed_bytes;
+    std::vector<uint8_t> unit_bytes;
+
+    if (!mapped_data.empty()) {
+      if (unit.unit_offset > mapped_data.size() || unit.unit_size > mapped_data.size() - unit.unit_offset) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Unspecified,
+                     "icef-box unit exceeds the item data"};
+      }
+
+      compressed_bytes = mapped_data.subspan(unit.unit_offset, unit.unit_size);
+    }
+    else if (contiguous) {
+      compressed_bytes = std::span<const uint8_t>(read_bytes).subspan(unit.unit_offset - span_start, unit.unit_size);
+    }
+    else {
+      Result<std::vector<uint8_t>> readResult = dataExtent.read_data(unit.unit_offset, unit.unit_size);
+      if (readResult.error) {
+        return readResult.error;
+      }
+
+      unit_bytes = std::move(readResult.value);
+      compressed_bytes = unit_bytes;
+    }
 
-    // Decode as a single blob
     Error err = do_decompress_data(cmpC_box, compressed_bytes, data);
     if (err) {
       return err;
     }
+  }
 
-    // cut out the range that we actually need
-    memcpy(data->data(), data->data() + range_start_offset, range_size);
-    data->resize(range_size);
+  if (data->size() - start != range_size) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Decompression_invalid_data,
+                 "decompressed unci rows do not have the expected size"};
   }
 
-  return Error::Ok;
+  return true;
 }
 
 
-const Error AbstractDecoder::do_decompress_data(std::shared_ptr<const Box_cmpC>& cmpC_box,
-                                                std::vector<uint8_t> compressed_data,
-                                                std::vector<uint8_t>* data) const
+static Error unsupported_compression_error(uint32_t compression_type)
 {
-  if (cmpC_box->get_compression_type() == fourcc("brot")) {
-#if HAVE_BROTLI
-    return decompress_brotli(compressed_data, data);
-#else
-    std::stringstream sstr;
-  sstr << "cannot decode unci item with brotli compression - not enabled" << std::endl;
+  std::stringstream sstr;
+  if (compression_type == fourcc("brot")) {
+    sstr << "cannot decode unci item with brotli compression - not enabled" << std::endl;
+  }
+  else if (compression_type == fourcc("zlib")) {
+    sstr << "cannot decode unci item with zlib compression - not enabled" << std::endl;
+  }
+  else if (compression_type == fourcc("defl")) {
+    sstr << "cannot decode unci item with deflate compression - not enabled" << std::endl;
+  }
+  else if (compression_type == fourcc("zstd")) {
+    sstr << "cannot decode unci item with zstd compression - not enabled" << std::endl;
+  }
+  else {
+    sstr << "cannot decode unci item with unsupported compression type: " << compression_type << std::endl;
+  }
+
   return Error(heif_error_Unsupported_feature,
                heif_suberror_Unsupported_generic_compression_method,
                sstr.str());
-#endif
+}
+
+
+const Error AbstractDecoder::do_decompress_data(const std::shared_ptr<const Box_cmpC>& cmpC_box,
+                                                std::span<const uint8_t> compressed_data,
+                                                std::vector<uint8_t>* data) const
+{
+  uint32_t compression_type = cmpC_box->get_compression_type();
+
+#if HAVE_BROTLI
+  if (compression_type == fourcc("brot")) {
+    return decompress_brotli(compressed_data, data);
   }
-  else if (cmpC_box->get_compression_type() == fourcc("zlib")) {
+#endif
 #if HAVE_ZLIB
+  if (compression_type == fourcc("zlib")) {
     return decompress_zlib(compressed_data, data);
-#else
-    std::stringstream sstr;
-    sstr << "cannot decode unci item with zlib compression - not enabled" << std::endl;
-    return Error(heif_error_Unsupported_feature,
-                 heif_suberror_Unsupported_generic_compression_method,
-                 sstr.str());
+  }
+  else if (compression_type == fourcc("defl")) {
+    return decompress_deflate(compressed_data, data);
+  }
 #endif
+#if HAVE_ZSTD
+  if (compression_type == fourcc("zstd")) {
+    return decompress_zstd(compressed_data, data);
   }
-  else if (cmpC_box->get_compression_type() == fourcc("defl")) {
+#endif
+
+  return unsupported_compression_error(compression_type);
+}
+
+
+Result<size_t> AbstractDecoder::do_decompress_data(const std::shared_ptr<const Box_cmpC>& cmpC_box,
+                                                   std::span<const uint8_t> compressed_data,
+                                                   std::span<uint8_t> data) const
+{
+  uint32_t compression_type = cmpC_box->get_compression_type();
+
+#if HAVE_BROTLI
+  if (compression_type == fourcc("brot")) {
+    return decompress_brotli(compressed_data, data);
+  }
+#endif
 #if HAVE_ZLIB
+  if (compression_type == fourcc("zlib")) {
+    return decompress_zlib(compressed_data, data);
+  }
+  else if (compression_type == fourcc("defl")) {
     return decompress_deflate(compressed_data, data);
-#else
-    std::stringstream sstr;
-    sstr << "cannot decode unci item with deflate compression - not enabled" << std::endl;
-    return Error(heif_error_Unsupported_feature,
-                 heif_suberror_Unsupported_generic_compression_method,
-                 sstr.str());
-#endif
   }
-  else {
-    std::stringstream sstr;
-    sstr << "cannot decode unci item with unsupported compression type: " << cmpC_box->get_compression_type() << std::endl;
-    return Error(heif_error_Unsupported_feature,
-                 heif_suberror_Unsupported_generic_compression_method,
-                 sstr.str());
+#endif
+#if HAVE_ZSTD
+  if (compression_type == fourcc("zstd")) {
+    return decompress_zstd(compressed_data, data);
   }
+#endif
+
+  return unsupported_compression_error(compression_type);
 }
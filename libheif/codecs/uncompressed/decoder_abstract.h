@@ -30,6 +30,7 @@
 #include <utility>
 #include <vector>
 #include <memory>
+#include <span>
 
 #include "common_utils.h"
 #include "context.h"
@@ -102,6 +103,20 @@ private:
 };
 
 
+// Row decoders for the common sample layouts. They give the same result as reading each sample with
+// BitReader::get_bits() and storing it in native byte order.
+
+// Big-endian 16-bit samples. 'mask' removes padding bits.
+void unc_be16_row_to_native(const uint8_t* src, uint8_t* dst, uint32_t num_samples, uint16_t mask);
+
+// Swaps the byte order of 16-bit samples. Also used by the encoder to write big-endian samples.
+void unc_swap16_row(const uint8_t* src, uint8_t* dst, uint32_t num_samples);
+
+// Densely packed samples of up to 16 bits. Reads (num_samples * bits_per_sample + 7) / 8 bytes.
+void unc_packed_row_to_native(const uint8_t* src, uint8_t* dst, uint32_t num_samples,
+                              uint32_t bits_per_sample, uint32_t bytes_per_sample);
+
+
 template<typename T> void skip_to_alignment(T& position, uint32_t alignment)
 {
   if (alignment == 0) {
@@ -129,8 +144,27 @@ public:
                             uint32_t image_width, uint32_t image_height,
                             uint32_t tile_x, uint32_t tile_y) = 0;
 
+  // Decodes the rows y0 ... y0+num_rows-1 of an image that is not split into tiles. The channel list has to be built
+  // for an image of the full image width and num_rows rows. Only the data of these rows is read.
+  // Returns false if the interleave mode or the compression of the data does not support this.
+  virtual Result<bool> decode_rows(const DataExtent& dataExtent,
+                                   const UncompressedImageCodec::unci_properties& properties,
+                                   uint32_t y0, uint32_t num_rows)
+  {
+    return false;
+  }
+
   void buildChannelList(std::shared_ptr<HeifPixelImage>& img);
 
+  // Sample layouts for which rows can be decoded without going through the BitReader sample by sample.
+  enum class RowLayout
+  {
+    generic,
+    bytes8,   // one byte per sample (possibly with padding bits)
+    bytes16,  // two big-endian bytes per sample (possibly with padding bits)
+    packed    // densely packed samples of up to 16 bits, e.g. 10 or 12 bits
+  };
+
 protected:
   AbstractDecoder(uint32_t width, uint32_t height,
                   const std::shared_ptr<const Box_cmpd> cmpd,
@@ -170,6 +204,7 @@ protected:
     uint8_t component_alignment;
     uint32_t bytes_per_tile_row_src;
     bool use_channel;
+    RowLayout row_layout = RowLayout::generic;
   };
 
   std::vector<ChannelListEntry> channelList;
@@ -190,6 +225,10 @@ protected:
   // Not valid for multi-Y pixel interleave
   void processComponentTileRow(ChannelListEntry& entry, UncompressedBitReader& srcBits, uint64_t dst_offset);
 
+  // Decodes a complete row of 'entry.tile_width' samples to 'dst' if the row can use a specialized decoder.
+  // Returns false if the row has to be decoded sample by sample.
+  bool processComponentRowFast(const ChannelListEntry& entry, UncompressedBitReader& srcBits, uint8_t* dst);
+
   // generic compression and uncompressed, per 23001-17
   const Error get_compressed_image_data_uncompressed(const DataExtent& dataExtent,
                                                      const UncompressedImageCodec::unci_properties& properties,
@@ -198,10 +237,25 @@ protected:
                                                      uint32_t tile_idx,
                                                      const Box_iloc::Item* item) const;
 
-  const Error do_decompress_data(std::shared_ptr<const Box_cmpC>& cmpC_box,
-                                 std::vector<uint8_t> compressed_data,
+  // Like get_compressed_image_data_uncompressed(), but with generic compression, only the units
+  // first_unit ... first_unit+num_units-1 are read and decompressed. This requires 'icef' entries for image rows,
+  // 'total_units' of them. The range is the data of these units. Returns false if the data is not stored this way.
+  Result<bool> get_uncompressed_row_data(const DataExtent& dataExtent,
+                                         const UncompressedImageCodec::unci_properties& properties,
+                                         std::vector<uint8_t>* data,
+                                         uint64_t range_start_offset, uint64_t range_size,
+                                         uint64_t first_unit, uint32_t num_units, uint64_t total_units) const;
+
+  // Appends the decompressed data to 'data'.
+  const Error do_decompress_data(const std::shared_ptr<const Box_cmpC>& cmpC_box,
+                                 std::span<const uint8_t> compressed_data,
                                  std::vector<uint8_t>* data) const;
 
+  // Decompresses until 'data' is full or the compressed stream ends. Returns the number of bytes written.
+  Result<size_t> do_decompress_data(const std::shared_ptr<const Box_cmpC>& cmpC_box,
+                                    std::span<const uint8_t> compressed_data,
+                                    std::span<uint8_t> data) const;
+
 protected:
   void memcpy_to_native_endian(uint8_t* dst, uint32_t value, uint32_t bytes_per_sample);
 
@@ -42,16 +42,7 @@ Error ComponentInterleaveDecoder::decode_tile(const DataExtent& dataExtent,
   uint64_t total_tile_size = 0;
 
   for (ChannelListEntry& entry : channelList) {
-    uint32_t bits_per_component = entry.bits_per_component_sample;
-    if (entry.component_alignment > 0) {
-      uint32_t bytes_per_component = (bits_per_component + 7) / 8;
-      skip_to_alignment(bytes_per_component, entry.component_alignment);
-      bits_per_component = bytes_per_component * 8;
-    }
-
-    uint32_t bytes_per_tile_row = (bits_per_component * entry.tile_width + 7) / 8;
-    skip_to_alignment(bytes_per_tile_row, m_uncC->get_row_align_size());
-    uint64_t bytes_per_tile = uint64_t{bytes_per_tile_row} * entry.tile_height;
+    uint64_t bytes_per_tile = uint64_t{get_bytes_per_tile_row(entry)} * entry.tile_height;
     total_tile_size += bytes_per_tile;
   }
 
@@ -94,3 +85,69 @@ Error ComponentInterleaveDecoder::decode_tile(const DataExtent& dataExtent,
 
   return Error::Ok;
 }
+
+
+uint32_t ComponentInterleaveDecoder::get_bytes_per_tile_row(const ChannelListEntry& entry) const
+{
+  uint32_t bits_per_component = entry.bits_per_component_sample;
+  if (entry.component_alignment > 0) {
+    uint32_t bytes_per_component = (bits_per_component + 7) / 8;
+    skip_to_alignment(bytes_per_component, entry.component_alignment);
+    bits_per_component = bytes_per_component * 8;
+  }
+
+  uint32_t bytes_per_tile_row = (bits_per_component * entry.tile_width + 7) / 8;
+  skip_to_alignment(bytes_per_tile_row, m_uncC->get_row_align_size());
+
+  return bytes_per_tile_row;
+}
+
+
+Result<bool> ComponentInterleaveDecoder::decode_rows(const DataExtent& dataExtent,
+                                                     const UncompressedImageCodec::unci_properties& properties,
+                                                     uint32_t y0, uint32_t num_rows)
+{
+  if (m_tile_width != m_width || m_tile_height != m_height) {
+    return false;
+  }
+
+  for (const ChannelListEntry& entry : channelList) {
+    if (entry.tile_height != m_tile_height) {
+      return false;
+    }
+  }
+
+  // --- each component is stored as a separate plane. Read only the rows y0 ... y0+num_rows-1 of each plane.
+  //     With generic compression, each plane row is a separate 'icef' unit.
+
+  uint64_t component_start_offset = 0;
+  uint32_t component_idx = 0;
+  const uint64_t total_units = uint64_t{m_height} * channelList.size();
+
+  for (ChannelListEntry& entry : channelList) {
+    uint64_t bytes_per_row = get_bytes_per_tile_row(entry);
+
+    if (entry.use_channel) {
+      std::vector<uint8_t> src_data;
+      auto readResult = get_uncompressed_row_data(dataExtent, properties, &src_data,
+                                                  component_start_offset + y0 * bytes_per_row, num_rows * bytes_per_row,
+                                                  uint64_t{component_idx} * m_height + y0, num_rows, total_units);
+      if (readResult.error || !*readResult) {
+        return readResult;
+      }
+
+      UncompressedBitReader srcBits(src_data);
+
+      for (uint32_t y = 0; y < num_rows; y++) {
+        srcBits.markRowStart();
+        processComponentTileRow(entry, srcBits, uint64_t{y} * entry.dst_plane_stride);
+        srcBits.handleRowAlignment(m_uncC->get_row_align_size());
+      }
+    }
+
+    component_start_offset += bytes_per_row * m_height;
+    component_idx++;
+  }
+
+  return true;
+}
@@ -40,6 +40,14 @@ public:
                     uint32_t out_x0, uint32_t out_y0,
                     uint32_t image_width, uint32_t image_height,
                     uint32_t tile_x, uint32_t tile_y) override;
+
+  Result<bool> decode_rows(const DataExtent& dataExtent,
+                           const UncompressedImageCodec::unci_properties& properties,
+                           uint32_t y0, uint32_t num_rows) override;
+
+private:
+  // Size of one row of the component in the tile, including the row alignment.
+  uint32_t get_bytes_per_tile_row(const ChannelListEntry& entry) const;
 };
 
 #endif // UNCI_DECODER_COMPONENT_INTERLEAVE_H
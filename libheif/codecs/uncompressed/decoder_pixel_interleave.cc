@@ -98,8 +98,65 @@ Error PixelInterleaveDecoder::decode_tile(const DataExtent& dataExtent,
 
 void PixelInterleaveDecoder::processTile(UncompressedBitReader& srcBits, uint32_t tile_row, uint32_t tile_column, uint32_t out_x0, uint32_t out_y0)
 {
+  // --- When all components are stored in whole bytes, the rows can be de-interleaved directly.
+
+  bool byte_aligned_pixels = true;
+  uint32_t bytes_per_pixel = 0;
+
+  for (const ChannelListEntry& entry : channelList) {
+    if (entry.row_layout != RowLayout::bytes8 && entry.row_layout != RowLayout::bytes16) {
+      byte_aligned_pixels = false;
+    }
+
+    bytes_per_pixel += entry.bytes_per_component_sample;
+  }
+
+  if (m_uncC->get_pixel_size() != 0) {
+    if (m_uncC->get_pixel_size() < bytes_per_pixel) {
+      byte_aligned_pixels = false;
+    }
+
+    bytes_per_pixel = m_uncC->get_pixel_size();
+  }
+
+  const uint64_t bytes_per_row = uint64_t{bytes_per_pixel} * m_tile_width;
+
   for (uint32_t tile_y = 0; tile_y < m_tile_height; tile_y++) {
     srcBits.markRowStart();
+
+    if (byte_aligned_pixels && srcBits.is_at_byte_boundary() &&
+        bytes_per_row <= static_cast<uint64_t>(srcBits.get_bytes_remaining())) {
+      const uint8_t* src = srcBits.get_current_byte_pointer();
+      uint32_t component_offset = 0;
+
+      for (const ChannelListEntry& entry : channelList) {
+        if (entry.use_channel) {
+          uint8_t* dst = entry.dst_plane + entry.getDestinationRowOffset(0, tile_y + out_y0) + uint64_t{out_x0} * entry.bytes_per_component_sample;
+          const uint8_t* p = src + component_offset;
+          const uint16_t mask = static_cast<uint16_t>((1U << entry.bits_per_component_sample) - 1);
+
+          if (entry.row_layout == RowLayout::bytes8) {
+            for (uint32_t x = 0; x < m_tile_width; x++) {
+              dst[x] = static_cast<uint8_t>(p[x * bytes_per_pixel] & mask);
+            }
+          }
+          else {
+            for (uint32_t x = 0; x < m_tile_width; x++) {
+              const uint8_t* sample = p + x * bytes_per_pixel;
+              uint16_t v = static_cast<uint16_t>(((sample[0] << 8) | sample[1]) & mask);
+              memcpy(dst + 2 * x, &v, 2);
+            }
+          }
+        }
+
+        component_offset += entry.bytes_per_component_sample;
+      }
+
+      srcBits.skip_bytes(static_cast<int>(bytes_per_row));
+      srcBits.handleRowAlignment(m_uncC->get_row_align_size());
+      continue;
+    }
+
     for (uint32_t tile_x = 0; tile_x < m_tile_width; tile_x++) {
       srcBits.markPixelStart();
       for (ChannelListEntry& entry : channelList) {
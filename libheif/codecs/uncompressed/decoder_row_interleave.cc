@@ -39,8 +39,41 @@ Error RowInterleaveDecoder::decode_tile(const DataExtent& dataExtent,
 
   // --- compute which file range we need to read for the tile
 
+  uint32_t bytes_per_row = get_bytes_per_row();
+
+  uint64_t total_tile_size = 0;
+  total_tile_size += bytes_per_row * static_cast<uint64_t>(m_tile_height);
+
+  if (m_uncC->get_tile_align_size() != 0) {
+    skip_to_alignment(total_tile_size, m_uncC->get_tile_align_size());
+  }
+
+  assert(m_tile_width > 0);
+  uint32_t tileIdx = tile_x + tile_y * (image_width / m_tile_width);
+  uint64_t tile_start_offset = total_tile_size * tileIdx;
+
+
+  // --- read required file range
+
+  std::vector<uint8_t> src_data;
+  Error err = get_compressed_image_data_uncompressed(dataExtent, properties, &src_data, tile_start_offset, total_tile_size, tileIdx, nullptr);
+  //Error err = context->get_heif_file()->append_data_from_iloc(image_id, src_data, tile_start_offset, total_tile_size);
+  if (err) {
+    return err;
+  }
+
+  UncompressedBitReader srcBits(src_data);
+
+  processTile(srcBits, m_tile_height, out_x0, out_y0);
+
+  return Error::Ok;
+}
+
+
+uint32_t RowInterleaveDecoder::get_bytes_per_row() const
+{
   uint32_t bits_per_row = 0;
-  for (ChannelListEntry& entry : channelList) {
+  for (const ChannelListEntry& entry : channelList) {
     uint32_t bits_per_component = entry.bits_per_component_sample;
     if (entry.component_alignment > 0) {
       // start at byte boundary
@@ -68,38 +101,47 @@ Error RowInterleaveDecoder::decode_tile(const DataExtent& dataExtent,
     skip_to_alignment(bytes_per_row, m_uncC->get_row_align_size());
   }
 
-  uint64_t total_tile_size = 0;
-  total_tile_size += bytes_per_row * static_cast<uint64_t>(m_tile_height);
+  return bytes_per_row;
+}
 
-  if (m_uncC->get_tile_align_size() != 0) {
-    skip_to_alignment(total_tile_size, m_uncC->get_tile_align_size());
+
+Result<bool> RowInterleaveDecoder::decode_rows(const DataExtent& dataExtent,
+                                               const UncompressedImageCodec::unci_properties& properties,
+                                               uint32_t y0, uint32_t num_rows)
+{
+  if (m_tile_width != m_width || m_tile_height != m_height) {
+    return false;
   }
 
-  assert(m_tile_width > 0);
-  uint32_t tileIdx = tile_x + tile_y * (image_width / m_tile_width);
-  uint64_t tile_start_offset = total_tile_size * tileIdx;
+  for (const ChannelListEntry& entry : channelList) {
+    if (entry.tile_height != m_tile_height) {
+      return false;
+    }
+  }
 
+  // --- the rows of all components are stored one after the other, so the image rows form one file range
 
-  // --- read required file range
+  uint64_t bytes_per_row = get_bytes_per_row();
 
   std::vector<uint8_t> src_data;
-  Error err = get_compressed_image_data_uncompressed(dataExtent, properties, &src_data, tile_start_offset, total_tile_size, tileIdx, nullptr);
-  //Error err = context->get_heif_file()->append_data_from_iloc(image_id, src_data, tile_start_offset, total_tile_size);
-  if (err) {
-    return err;
+  auto readResult = get_uncompressed_row_data(dataExtent, properties, &src_data,
+                                              y0 * bytes_per_row, num_rows * bytes_per_row,
+                                              y0, num_rows, m_height);
+  if (readResult.error || !*readResult) {
+    return readResult;
   }
 
   UncompressedBitReader srcBits(src_data);
 
-  processTile(srcBits, tile_y, tile_x, out_x0, out_y0);
+  processTile(srcBits, num_rows, 0, 0);
 
-  return Error::Ok;
+  return true;
 }
 
 
-void RowInterleaveDecoder::processTile(UncompressedBitReader& srcBits, uint32_t tile_row, uint32_t tile_column, uint32_t out_x0, uint32_t out_y0)
+void RowInterleaveDecoder::processTile(UncompressedBitReader& srcBits, uint32_t num_rows, uint32_t out_x0, uint32_t out_y0)
 {
-  for (uint32_t tile_y = 0; tile_y < m_tile_height; tile_y++) {
+  for (uint32_t tile_y = 0; tile_y < num_rows; tile_y++) {
     for (ChannelListEntry& entry : channelList) {
       srcBits.markRowStart();
       if (entry.use_channel) {
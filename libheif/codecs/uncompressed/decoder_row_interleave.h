@@ -41,8 +41,15 @@ public:
                     uint32_t image_width, uint32_t image_height,
                     uint32_t tile_x, uint32_t tile_y) override;
 
+  Result<bool> decode_rows(const DataExtent& dataExtent,
+                           const UncompressedImageCodec::unci_properties& properties,
+                           uint32_t y0, uint32_t num_rows) override;
+
 private:
-  void processTile(UncompressedBitReader& srcBits, uint32_t tile_row, uint32_t tile_column,
+  // Size of one row of the tile, containing all components.
+  uint32_t get_bytes_per_row() const;
+
+  void processTile(UncompressedBitReader& srcBits, uint32_t num_rows,
                    uint32_t out_x0, uint32_t out_y0);
 };
 
@@ -429,8 +429,13 @@ uint64_t Box_uncC::compute_tile_data_size_bytes(uint32_t tile_width, uint32_t ti
       uint32_t bytes_per_pixel = 0;
 
       for (const auto& comp : m_components) {
-        assert(comp.component_bit_depth % 8 == 0); // TODO: component sizes that are no multiples of bytes
-        bytes_per_pixel += comp.component_bit_depth / 8;
+        if (comp.component_align_size != 0) {
+          bytes_per_pixel += comp.component_align_size;
+        }
+        else {
+          assert(comp.component_bit_depth % 8 == 0); // TODO: component sizes that are no multiples of bytes
+          bytes_per_pixel += comp.component_bit_depth / 8;
+        }
       }
 
       return bytes_per_pixel * uint64_t{tile_width} * tile_height;
@@ -720,7 +725,7 @@ Error Box_cpat::parse(BitstreamRange& range, const heif_security_limits* limits)
       PatternComponent component{};
       component.component_index = range.read32();
       component.component_gain = range.read_float32();
-      m_components[i] = component;
+      m_components[size_t{i} * m_pattern_width + j] = component;
     }
   }
 
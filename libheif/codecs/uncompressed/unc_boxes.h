@@ -353,6 +353,12 @@ public:
     return m_pattern_height;
   }
 
+  // The components of the pattern in raster-scan order.
+  const std::vector<PatternComponent>& get_components() const
+  {
+    return m_components;
+  }
+
   std::string dump(Indent&) const override;
 
   Error write(StreamWriter& writer) const override;
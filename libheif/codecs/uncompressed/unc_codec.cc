@@ -35,10 +35,13 @@
 #include "decoder_tile_component_interleave.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <iostream>
 #include <cassert>
 #include "security_limits.h"
+#include "thread_pool.h"
+#include "decoding_statistics.h"
 
 
 bool isKnownUncompressedFrameConfigurationBoxProfile(const std::shared_ptr<const Box_uncC>& uncC)
@@ -444,6 +447,50 @@ bool map_uncompressed_component_to_channel(const std::shared_ptr<const Box_cmpd>
 }
 
 
+Result<FilterArrayPattern> get_filter_array_pattern(const std::shared_ptr<const Box_cpat>& cpat,
+                                                    const std::shared_ptr<const Box_cmpd>& cmpd)
+{
+  FilterArrayPattern pattern;
+  pattern.width = cpat->get_pattern_width();
+  pattern.height = cpat->get_pattern_height();
+
+  const auto& components = cmpd->get_components();
+
+  for (const auto& pattern_component : cpat->get_components()) {
+    if (pattern_component.component_index >= components.size()) {
+      return Error{heif_error_Invalid_input,
+                   heif_suberror_Invalid_parameter_value,
+                   "Filter array pattern references a non-existing component."};
+    }
+
+    switch (components[pattern_component.component_index].component_type) {
+      case component_type_red:
+        pattern.channels.push_back(heif_channel_R);
+        break;
+      case component_type_green:
+        pattern.channels.push_back(heif_channel_G);
+        break;
+      case component_type_blue:
+        pattern.channels.push_back(heif_channel_B);
+        break;
+      default:
+        // other filter colors are not used for the RGB output
+        pattern.channels.push_back(heif_channel_Y);
+        break;
+    }
+  }
+
+  if (pattern.width == 0 || pattern.height == 0 ||
+      pattern.channels.size() != size_t{pattern.width} * pattern.height) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Invalid_parameter_value,
+                 "Invalid filter array pattern size."};
+  }
+
+  return pattern;
+}
+
+
 
 static AbstractDecoder* makeDecoder(uint32_t width, uint32_t height, const std::shared_ptr<const Box_cmpd>& cmpd, const std::shared_ptr<const Box_uncC>& uncC)
 {
@@ -566,6 +613,91 @@ Error UncompressedImageCodec::decode_uncompressed_image_tile(const HeifContext*
 }
 
 
+Result<std::shared_ptr<HeifPixelImage>> UncompressedImageCodec::decode_uncompressed_image_area(const HeifContext* context,
+                                                                                              heif_item_id ID,
+                                                                                              uint32_t x0, uint32_t y0,
+                                                                                              uint32_t w, uint32_t h)
+{
+  auto image = context->get_image(ID, false);
+  if (!image) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Nonexisting_item_referenced};
+  }
+
+  UncompressedImageCodec::unci_properties properties;
+  properties.fill_from_image_item(image);
+
+  auto ispe = properties.ispe;
+  auto uncC = properties.uncC;
+  auto cmpd = properties.cmpd;
+
+  Error error = check_header_validity(ispe, cmpd, uncC);
+  if (error) {
+    return error;
+  }
+
+  error = uncompressed_image_type_is_supported(uncC, cmpd);
+  if (error) {
+    return error;
+  }
+
+  // Tiled images are decoded tile by tile. With subsampled chroma, the area would have to be aligned.
+
+  if (uncC->get_number_of_tile_columns() != 1 || uncC->get_number_of_tile_rows() != 1 ||
+      uncC->get_sampling_type() != sampling_mode_no_subsampling ||
+      (uncC->get_interleave_type() != interleave_mode_component &&
+       uncC->get_interleave_type() != interleave_mode_row)) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  uint32_t width = ispe->get_width();
+  uint32_t height = ispe->get_height();
+
+  if (w == 0 || h == 0 || x0 >= width || y0 >= height || w > width - x0 || h > height - y0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Decoding area is outside of the image"};
+  }
+
+  // --- decode the full rows of the area and crop them afterwards
+
+  error = check_for_valid_image_size(context->get_security_limits(), width, h);
+  if (error) {
+    return error;
+  }
+
+  Result<std::shared_ptr<HeifPixelImage>> createImgResult = create_image(cmpd, uncC, width, h, context->get_security_limits());
+  if (createImgResult.error) {
+    return createImgResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = *createImgResult;
+
+  std::unique_ptr<AbstractDecoder> decoder(makeDecoder(width, height, cmpd, uncC));
+  assert(decoder);
+
+  decoder->buildChannelList(img);
+
+  DataExtent dataExtent;
+  dataExtent.set_from_image_item(context->get_heif_file(), ID);
+
+  Result<bool> decodeResult = decoder->decode_rows(dataExtent, properties, y0, h);
+  if (decodeResult.error) {
+    return decodeResult.error;
+  }
+
+  if (!*decodeResult) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  if (w == width) {
+    return img;
+  }
+
+  return img->crop_inplace(x0, x0 + w - 1, 0, h - 1, context->get_security_limits());
+}
+
+
 Error UncompressedImageCodec::check_header_validity(std::optional<const std::shared_ptr<const Box_ispe>> ispe,
                                                     const std::shared_ptr<const Box_cmpd>& cmpd,
                                                     const std::shared_ptr<const Box_uncC>& uncC)
@@ -621,6 +753,96 @@ Error UncompressedImageCodec::check_header_validity(std::optional<const std::sha
 }
 
 
+// Decodes all tiles of the image into 'img'.
+// The tiles are independent and write to disjoint areas of the image planes. With 'max_threads' > 0,
+// they are decoded in parallel.
+static Error decode_all_tiles(AbstractDecoder* decoder,
+                              const DataExtent& dataExtent,
+                              const UncompressedImageCodec::unci_properties& properties,
+                              std::shared_ptr<HeifPixelImage>& img,
+                              uint32_t width, uint32_t height,
+                              int max_threads)
+{
+  const std::shared_ptr<const Box_uncC>& uncC = properties.uncC;
+
+  uint32_t tile_width = width / uncC->get_number_of_tile_columns();
+  uint32_t tile_height = height / uncC->get_number_of_tile_rows();
+
+  std::vector<std::pair<uint32_t, uint32_t>> tiles;
+  for (uint32_t tile_y0 = 0; tile_y0 < height; tile_y0 += tile_height)
+    for (uint32_t tile_x0 = 0; tile_x0 < width; tile_x0 += tile_width) {
+      tiles.emplace_back(tile_x0, tile_y0);
+    }
+
+  auto decode_tile = [&](size_t i) {
+    uint32_t tile_x0 = tiles[i].first;
+    uint32_t tile_y0 = tiles[i].second;
+    return decoder->decode_tile(dataExtent, properties, img, tile_x0, tile_y0,
+                                width, height,
+                                tile_x0 / tile_width, tile_y0 / tile_height);
+  };
+
+#if ENABLE_PARALLEL_TILE_DECODING
+  if (max_threads > 0 && tiles.size() > 1) {
+    // Without independently compressed tiles, each tile decompresses the whole item data.
+    // Unless it can be accessed in place, read it once now, because DataExtent caches it and the cache
+    // must not be filled concurrently.
+    if (properties.cmpC &&
+        !(properties.icef && properties.cmpC->get_compressed_unit_type() == heif_cmpC_compressed_unit_type_image_tile) &&
+        dataExtent.get_data_without_copy().empty()) {
+      auto readResult = dataExtent.read_data();
+      if (readResult.error) {
+        return readResult.error;
+      }
+    }
+
+    const size_t num_tasks = std::min(tiles.size(), static_cast<size_t>(max_threads));
+
+    std::vector<Error> tile_errors(tiles.size());
+    std::atomic<size_t> next_tile{0};
+    std::atomic<bool> failed{false};
+
+    DecodingStatistics* statistics = DecodingStatistics::current();
+
+    auto decode_tiles = [&]() {
+      DecodingStatisticsScope statistics_scope(statistics);
+
+      for (size_t i = next_tile++; i < tiles.size() && !failed; i = next_tile++) {
+        tile_errors[i] = decode_tile(i);
+        if (tile_errors[i]) {
+          failed = true;
+        }
+      }
+    };
+
+    TaskGroup tasks;
+    for (size_t t = 0; t < num_tasks; t++) {
+      tasks.run(decode_tiles);
+    }
+
+    tasks.wait();
+
+    for (const Error& e : tile_errors) {
+      if (e) {
+        return e;
+      }
+    }
+
+    return Error::Ok;
+  }
+#endif
+
+  for (size_t i = 0; i < tiles.size(); i++) {
+    Error error = decode_tile(i);
+    if (error) {
+      return error;
+    }
+  }
+
+  return Error::Ok;
+}
+
+
 // TODO: this should be deprecated and replaced with the function taking unci_properties/DataExtent
 Error UncompressedImageCodec::decode_uncompressed_image(const HeifContext* context,
                                                         heif_item_id ID,
@@ -686,26 +908,15 @@ Error UncompressedImageCodec::decode_uncompressed_image(const HeifContext* conte
 
   decoder->buildChannelList(img);
 
-  uint32_t tile_width = width / uncC->get_number_of_tile_columns();
-  uint32_t tile_height = height / uncC->get_number_of_tile_rows();
-
   DataExtent dataExtent;
   dataExtent.set_from_image_item(context->get_heif_file(), ID);
 
-  for (uint32_t tile_y0 = 0; tile_y0 < height; tile_y0 += tile_height)
-    for (uint32_t tile_x0 = 0; tile_x0 < width; tile_x0 += tile_width) {
-      error = decoder->decode_tile(dataExtent, properties, img, tile_x0, tile_y0,
-                                   width, height,
-                                   tile_x0 / tile_width, tile_y0 / tile_height);
-      if (error) {
-        delete decoder;
-        return error;
-      }
-    }
+  error = decode_all_tiles(decoder, dataExtent, properties, img, width, height,
+                           context->get_max_decoding_threads());
 
   //Error result = decoder->decode(source_data, img);
   delete decoder;
-  return Error::Ok;
+  return error;
 }
 
 
@@ -769,26 +980,35 @@ UncompressedImageCodec::decode_uncompressed_image(const UncompressedImageCodec::
 
   decoder->buildChannelList(img);
 
-  uint32_t tile_width = width / uncC->get_number_of_tile_columns();
-  uint32_t tile_height = height / uncC->get_number_of_tile_rows();
-
-  for (uint32_t tile_y0 = 0; tile_y0 < height; tile_y0 += tile_height)
-    for (uint32_t tile_x0 = 0; tile_x0 < width; tile_x0 += tile_width) {
-      error = decoder->decode_tile(extent, properties, img, tile_x0, tile_y0,
-                                   width, height,
-                                   tile_x0 / tile_width, tile_y0 / tile_height);
-      if (error) {
-        delete decoder;
-        return error;
-      }
-    }
+  // Sequence samples are decoded without a HeifContext, hence sequentially.
+  error = decode_all_tiles(decoder, extent, properties, img, width, height, 0);
 
   //Error result = decoder->decode(source_data, img);
   delete decoder;
+  if (error) {
+    return error;
+  }
+
   return img;
 }
 
 
+// Samples are written in whole bytes, as they are stored in HeifPixelImage. Samples with more than 8 bits
+// are written as big-endian 16-bit values.
+static uint8_t get_component_align_size(int bpp)
+{
+  if (bpp == 8) {
+    return 0;
+  }
+  else if (bpp > 8) {
+    return 2;
+  }
+  else {
+    return 1;
+  }
+}
+
+
 Error fill_cmpd_and_uncC(std::shared_ptr<Box_cmpd>& cmpd,
                          std::shared_ptr<Box_uncC>& uncC,
                          const std::shared_ptr<const HeifPixelImage>& image,
@@ -811,13 +1031,13 @@ Error fill_cmpd_and_uncC(std::shared_ptr<Box_cmpd>& cmpd,
     Box_cmpd::Component crComponent = {component_type_Cr};
     cmpd->add_component(crComponent);
     uint8_t bpp_y = image->get_bits_per_pixel(heif_channel_Y);
-    Box_uncC::Component component0 = {0, bpp_y, component_format_unsigned, 0};
+    Box_uncC::Component component0 = {0, bpp_y, component_format_unsigned, get_component_align_size(bpp_y)};
     uncC->add_component(component0);
     uint8_t bpp_cb = image->get_bits_per_pixel(heif_channel_Cb);
-    Box_uncC::Component component1 = {1, bpp_cb, component_format_unsigned, 0};
+    Box_uncC::Component component1 = {1, bpp_cb, component_format_unsigned, get_component_align_size(bpp_cb)};
     uncC->add_component(component1);
     uint8_t bpp_cr = image->get_bits_per_pixel(heif_channel_Cr);
-    Box_uncC::Component component2 = {2, bpp_cr, component_format_unsigned, 0};
+    Box_uncC::Component component2 = {2, bpp_cr, component_format_unsigned, get_component_align_size(bpp_cr)};
     uncC->add_component(component2);
     if (image->get_chroma_format() == heif_chroma_444) {
       uncC->set_sampling_type(sampling_mode_no_subsampling);
@@ -879,13 +1099,7 @@ Error fill_cmpd_and_uncC(std::shared_ptr<Box_cmpd>& cmpd,
         (image->get_chroma_format() == heif_chroma_interleaved_RRGGBBAA_LE)) {
       uncC->set_interleave_type(interleave_mode_pixel);
       int bpp = image->get_bits_per_pixel(heif_channel_interleaved);
-      uint8_t component_align = 1;
-      if (bpp == 8) {
-        component_align = 0;
-      }
-      else if (bpp > 8) {
-        component_align = 2;
-      }
+      uint8_t component_align = get_component_align_size(bpp);
       Box_uncC::Component component0 = {0, (uint8_t) (bpp), component_format_unsigned, component_align};
       uncC->add_component(component0);
       Box_uncC::Component component1 = {1, (uint8_t) (bpp), component_format_unsigned, component_align};
@@ -903,29 +1117,24 @@ Error fill_cmpd_and_uncC(std::shared_ptr<Box_cmpd>& cmpd,
     else {
       uncC->set_interleave_type(interleave_mode_component);
       int bpp_red = image->get_bits_per_pixel(heif_channel_R);
-      Box_uncC::Component component0 = {0, (uint8_t) (bpp_red), component_format_unsigned, 0};
+      Box_uncC::Component component0 = {0, (uint8_t) (bpp_red), component_format_unsigned, get_component_align_size(bpp_red)};
       uncC->add_component(component0);
       int bpp_green = image->get_bits_per_pixel(heif_channel_G);
-      Box_uncC::Component component1 = {1, (uint8_t) (bpp_green), component_format_unsigned, 0};
+      Box_uncC::Component component1 = {1, (uint8_t) (bpp_green), component_format_unsigned, get_component_align_size(bpp_green)};
       uncC->add_component(component1);
       int bpp_blue = image->get_bits_per_pixel(heif_channel_B);
-      Box_uncC::Component component2 = {2, (uint8_t) (bpp_blue), component_format_unsigned, 0};
+      Box_uncC::Component component2 = {2, (uint8_t) (bpp_blue), component_format_unsigned, get_component_align_size(bpp_blue)};
       uncC->add_component(component2);
       if (image->has_channel(heif_channel_Alpha)) {
         int bpp_alpha = image->get_bits_per_pixel(heif_channel_Alpha);
-        Box_uncC::Component component3 = {3, (uint8_t) (bpp_alpha), component_format_unsigned, 0};
+        Box_uncC::Component component3 = {3, (uint8_t) (bpp_alpha), component_format_unsigned, get_component_align_size(bpp_alpha)};
         uncC->add_component(component3);
       }
     }
     uncC->set_sampling_type(sampling_mode_no_subsampling);
     uncC->set_block_size(0);
-    if ((image->get_chroma_format() == heif_chroma_interleaved_RRGGBB_LE) ||
-        (image->get_chroma_format() == heif_chroma_interleaved_RRGGBBAA_LE)) {
-      uncC->set_components_little_endian(true);
-    }
-    else {
-      uncC->set_components_little_endian(false);
-    }
+    // little-endian input is byte-swapped by the encoder
+    uncC->set_components_little_endian(false);
     uncC->set_block_pad_lsb(false);
     uncC->set_block_little_endian(false);
     uncC->set_block_reversed(false);
@@ -944,11 +1153,11 @@ Error fill_cmpd_and_uncC(std::shared_ptr<Box_cmpd>& cmpd,
       cmpd->add_component(alphaComponent);
     }
     int bpp = image->get_bits_per_pixel(heif_channel_Y);
-    Box_uncC::Component component0 = {0, (uint8_t) (bpp), component_format_unsigned, 0};
+    Box_uncC::Component component0 = {0, (uint8_t) (bpp), component_format_unsigned, get_component_align_size(bpp)};
     uncC->add_component(component0);
     if (image->has_channel(heif_channel_Alpha)) {
       bpp = image->get_bits_per_pixel(heif_channel_Alpha);
-      Box_uncC::Component component1 = {1, (uint8_t) (bpp), component_format_unsigned, 0};
+      Box_uncC::Component component1 = {1, (uint8_t) (bpp), component_format_unsigned, get_component_align_size(bpp)};
       uncC->add_component(component1);
     }
     uncC->set_sampling_type(sampling_mode_no_subsampling);
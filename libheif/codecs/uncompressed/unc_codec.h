@@ -25,6 +25,7 @@
 #include "pixelimage.h"
 #include "file.h"
 #include "context.h"
+#include "color-conversion/demosaic.h"
 #if WITH_UNCOMPRESSED_CODEC
 #include "unc_boxes.h"
 #endif
@@ -50,6 +51,10 @@ bool map_uncompressed_component_to_channel(const std::shared_ptr<const Box_cmpd>
                                            Box_uncC::Component component,
                                            heif_channel *channel);
 
+// Colors of the filter array pattern 'cpat'. The pattern entries reference the components in 'cmpd'.
+Result<FilterArrayPattern> get_filter_array_pattern(const std::shared_ptr<const Box_cpat>& cpat,
+                                                    const std::shared_ptr<const Box_cmpd>& cmpd);
+
 
 class UncompressedImageCodec
 {
@@ -63,6 +68,13 @@ public:
                                               std::shared_ptr<HeifPixelImage>& img,
                                               uint32_t tile_x0, uint32_t tile_y0);
 
+  // Decodes the area (x0,y0,w,h) of an image that is not split into tiles, reading only the rows of the area.
+  // Returns a null image if the interleave mode, the chroma subsampling or the compression do not allow this.
+  static Result<std::shared_ptr<HeifPixelImage>> decode_uncompressed_image_area(const HeifContext* context,
+                                                                                heif_item_id ID,
+                                                                                uint32_t x0, uint32_t y0,
+                                                                                uint32_t w, uint32_t h);
+
   struct unci_properties {
     std::shared_ptr<const Box_ispe> ispe;
     std::shared_ptr<const Box_cmpd> cmpd;
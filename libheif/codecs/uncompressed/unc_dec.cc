@@ -22,6 +22,8 @@
 #include "codecs/uncompressed/unc_codec.h"
 #include "error.h"
 #include "context.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
 
 #include <string>
 #include <algorithm>
@@ -171,6 +173,10 @@ Decoder_uncompressed::decode_single_frame_from_compressed_data(const struct heif
   properties.cmpd = m_cmpd;
   properties.ispe = m_ispe;
 
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
   auto decodeResult = UncompressedImageCodec::decode_uncompressed_image(properties,
                                                           get_data_extent(),
                                                           heif_get_global_security_limits()); // TODO: use correct security limits
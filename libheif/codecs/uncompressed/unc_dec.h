@@ -55,6 +55,11 @@ public:
   Result<std::shared_ptr<HeifPixelImage>>
   decode_single_frame_from_compressed_data(const struct heif_decoding_options& options) override;
 
+  // The uncompressed codec does not use decoder plugins.
+  Result<bool>
+  decode_single_frame_into_image(const struct heif_decoding_options& options,
+                                 const std::shared_ptr<HeifPixelImage>& target, uint32_t x0, uint32_t y0) override { return false; }
+
 private:
   const std::shared_ptr<const Box_uncC> m_uncC;
   const std::shared_ptr<const Box_cmpd> m_cmpd;
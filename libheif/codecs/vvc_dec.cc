@@ -38,6 +38,12 @@ Result<std::vector<uint8_t>> Decoder_VVC::read_bitstream_configuration_data() co
 }
 
 
+uint8_t Decoder_VVC::get_nal_unit_length_size() const
+{
+  return static_cast<uint8_t>(m_vvcC->get_configuration().LengthSizeMinusOne + 1);
+}
+
+
 int Decoder_VVC::get_luma_bits_per_pixel() const
 {
   const Box_vvcC::configuration& config = m_vvcC->get_configuration();
@@ -20,6 +20,7 @@
 
 #include <cstdint>
 #include "alpha.h"
+#include "alpha_simd.h"
 
 
 std::vector<ColorStateWithCost>
@@ -82,7 +83,9 @@ Op_drop_alpha_plane::convert_colorspace(const std::shared_ptr<const HeifPixelIma
                                heif_channel_G,
                                heif_channel_B}) {
     if (input->has_channel(channel)) {
-      outimg->copy_new_plane_from(input, channel, channel, limits);
+      if (auto err = outimg->share_plane_from(input, channel, channel)) {
+        return err;
+      }
     }
   }
 
@@ -90,6 +93,132 @@ Op_drop_alpha_plane::convert_colorspace(const std::shared_ptr<const HeifPixelIma
 }
 
 
+// --- row functions that use the SIMD kernels where possible and process the rest of the row with the scalar code
+
+static void premultiply_row(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width, int alpha_bpp)
+{
+  const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+
+  uint32_t x = 0;
+  if (alpha_bpp == 8 && kernels.premultiply8) {
+    x = kernels.premultiply8(in, alpha, out, width);
+  }
+
+  for (; x < width; x++) {
+    out[x] = static_cast<uint8_t>(premultiply_sample(in[x], alpha[x], alpha_bpp));
+  }
+}
+
+
+static void premultiply_row(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int alpha_bpp)
+{
+  const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+
+  uint32_t x = 0;
+  if (kernels.premultiply16) {
+    x = kernels.premultiply16(in, alpha, out, width, alpha_bpp);
+  }
+
+  for (; x < width; x++) {
+    out[x] = static_cast<uint16_t>(premultiply_sample(in[x], alpha[x], alpha_bpp));
+  }
+}
+
+
+// For color and alpha with different bit depths.
+static uint32_t unpremultiply_sample(uint32_t color, uint32_t alpha, int alpha_bpp, int bpp)
+{
+  if (alpha == 0) {
+    return 0;
+  }
+
+  auto alpha_max = static_cast<float>((1U << alpha_bpp) - 1);
+  auto max_value = static_cast<float>((1U << bpp) - 1);
+  float v = static_cast<float>(color) * (alpha_max / static_cast<float>(alpha)) + 0.5f;
+  return static_cast<uint32_t>(std::min(v, max_value));
+}
+
+
+static void unpremultiply_row(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width, int alpha_bpp, int bpp)
+{
+  uint32_t x = 0;
+
+  if (bpp == 8 && alpha_bpp == 8) {
+    const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+    if (kernels.unpremultiply8) {
+      x = kernels.unpremultiply8(in, alpha, out, width);
+    }
+
+    const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+    for (; x < width; x++) {
+      out[x] = unpremultiply_sample8(in[x], alpha[x], reciprocals);
+    }
+  }
+  else {
+    for (; x < width; x++) {
+      out[x] = static_cast<uint8_t>(unpremultiply_sample(in[x], alpha[x], alpha_bpp, bpp));
+    }
+  }
+}
+
+
+static void unpremultiply_row(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int alpha_bpp, int bpp)
+{
+  uint32_t x = 0;
+
+  if (bpp == alpha_bpp) {
+    const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+    if (kernels.unpremultiply16) {
+      x = kernels.unpremultiply16(in, alpha, out, width, bpp);
+    }
+
+    for (; x < width; x++) {
+      out[x] = unpremultiply_sample16(in[x], alpha[x], bpp);
+    }
+  }
+  else {
+    for (; x < width; x++) {
+      out[x] = static_cast<uint16_t>(unpremultiply_sample(in[x], alpha[x], alpha_bpp, bpp));
+    }
+  }
+}
+
+
+static void flatten_row(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                        uint8_t bkg, int alpha_bpp, int bpp, bool premultiplied)
+{
+  const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+  auto max_value = static_cast<uint32_t>((1U << bpp) - 1);
+
+  uint32_t x = 0;
+  if (alpha_bpp == 8 && bpp == 8 && kernels.flatten8) {
+    x = kernels.flatten8(in, alpha, out, width, bkg, premultiplied);
+  }
+
+  for (; x < width; x++) {
+    out[x] = static_cast<uint8_t>(flatten_sample(in[x], alpha[x], bkg, alpha_bpp, max_value, premultiplied));
+  }
+}
+
+
+static void flatten_row(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                        uint16_t bkg, int alpha_bpp, int bpp, bool premultiplied)
+{
+  const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+  auto max_value = static_cast<uint16_t>((1U << bpp) - 1);
+
+  uint32_t x = 0;
+  if (kernels.flatten16) {
+    x = kernels.flatten16(in, alpha, out, width, bkg, alpha_bpp, max_value, premultiplied);
+  }
+
+  for (; x < width; x++) {
+    out[x] = static_cast<uint16_t>(flatten_sample(in[x], alpha[x], bkg, alpha_bpp, max_value, premultiplied));
+  }
+}
+
+
+
 template<class Pixel>
 std::vector<ColorStateWithCost>
 Op_flatten_alpha_plane<Pixel>::state_after_conversion(const ColorState& input_state,
@@ -151,6 +280,7 @@ Op_flatten_alpha_plane<Pixel>::convert_colorspace(const std::shared_ptr<const He
   *nclx = input_state.nclx_profile;
   heif_color_conversion_options_ext options_ext_skip_alpha = options_ext;
   options_ext_skip_alpha.alpha_composition_mode = heif_alpha_composition_mode_none;
+  options_ext_skip_alpha.alpha_premultiplication_mode = heif_alpha_premultiplication_mode_keep;
 
   if (options_ext.alpha_composition_mode != heif_alpha_composition_mode_none) {
     Result<std::shared_ptr<const HeifPixelImage>> convInput = ::convert_colorspace(input,
@@ -177,30 +307,26 @@ Op_flatten_alpha_plane<Pixel>::convert_colorspace(const std::shared_ptr<const He
                  input->get_colorspace(),
                  input->get_chroma_format());
 
+  const bool premultiplied = input_state.premultiplied_alpha;
+
+  size_t stride_alpha;
+  const Pixel* p_alpha = input->get_channel<Pixel>(heif_channel_Alpha, &stride_alpha);
+  int bpp_alpha = input->get_bits_per_pixel(heif_channel_Alpha);
+
   for (heif_channel channel : {heif_channel_R,
                                heif_channel_G,
                                heif_channel_B}) {
-    outimg->add_plane(channel, width, height, target_state.bits_per_pixel, limits);
+    if (auto err = outimg->add_plane(channel, width, height, target_state.bits_per_pixel, limits)) {
+      return err;
+    }
 
-    const Pixel* p_alpha;
-    size_t stride_alpha;
-    p_alpha = (const Pixel*)input->get_plane(heif_channel_Alpha, &stride_alpha);
-    int bpp_alpha = input->get_bits_per_pixel(heif_channel_Alpha);
-    Pixel alpha_max = (Pixel)((1 << bpp_alpha) - 1);
+    int bpp = input->get_bits_per_pixel(channel);
 
-    const Pixel* p_in;
     size_t stride_in;
-    p_in = (const Pixel*)input->get_plane(channel, &stride_in);
+    const Pixel* p_in = input->get_channel<Pixel>(channel, &stride_in);
 
-    Pixel* p_out;
     size_t stride_out;
-    p_out = (Pixel*)outimg->get_plane(channel, &stride_out);
-
-    if (sizeof(Pixel) == 2) {
-      stride_alpha /= 2;
-      stride_in /= 2;
-      stride_out /= 2;
-    }
+    Pixel* p_out = outimg->get_channel<Pixel>(channel, &stride_out);
 
     if (options_ext.alpha_composition_mode == heif_alpha_composition_mode_solid_color ||
         (options_ext.alpha_composition_mode == heif_alpha_composition_mode_checkerboard && options_ext.checkerboard_square_size == 0)) {
@@ -221,13 +347,12 @@ Op_flatten_alpha_plane<Pixel>::convert_colorspace(const std::shared_ptr<const He
           bkg16 = 0;
       }
 
-      Pixel bkg = static_cast<Pixel>(bkg16 >> (16 - input->get_bits_per_pixel(channel)));
+      Pixel bkg = static_cast<Pixel>(bkg16 >> (16 - bpp));
 
-      for (uint32_t y = 0; y < height; y++)
-        for (uint32_t x = 0; x < width; x++) {
-          int a = p_alpha[y * stride_alpha + x];
-          p_out[y * stride_out + x] = static_cast<Pixel>((p_in[y * stride_in + x] * a + bkg * (alpha_max - a)) >> bpp_alpha);
-        }
+      for (uint32_t y = 0; y < height; y++) {
+        flatten_row(p_in + y * stride_in, p_alpha + y * stride_alpha, p_out + y * stride_out, width,
+                    bkg, bpp_alpha, bpp, premultiplied);
+      }
     }
     else {
       uint16_t bkg16_1, bkg16_2;
@@ -250,19 +375,25 @@ Op_flatten_alpha_plane<Pixel>::convert_colorspace(const std::shared_ptr<const He
           bkg16_1 = bkg16_2 = 0;
       }
 
-      Pixel bkg1 = static_cast<Pixel>(bkg16_1 >> (16 - input->get_bits_per_pixel(channel)));
-      Pixel bkg2 = static_cast<Pixel>(bkg16_2 >> (16 - input->get_bits_per_pixel(channel)));
+      Pixel bkg1 = static_cast<Pixel>(bkg16_1 >> (16 - bpp));
+      Pixel bkg2 = static_cast<Pixel>(bkg16_2 >> (16 - bpp));
+
+      const uint32_t square_size = options_ext.checkerboard_square_size;
+
+      // Each row is flattened in segments of one checkerboard square with constant background.
 
-      for (uint32_t y = 0; y < height; y++)
-        for (uint32_t x = 0; x < width; x++) {
-          uint8_t parity = (x / options_ext.checkerboard_square_size + y / options_ext.checkerboard_square_size) % 2;
+      for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x += square_size) {
+          uint8_t parity = (x / square_size + y / square_size) % 2;
           Pixel bkg = parity ? bkg1 : bkg2;
 
-          int a = p_alpha[y * stride_alpha + x];
-          p_out[y * stride_out + x] = static_cast<Pixel>((p_in[y * stride_in + x] * a + bkg * (alpha_max - a)) >> bpp_alpha);
+          uint32_t segment_width = std::min(square_size, width - x);
+
+          flatten_row(p_in + y * stride_in + x, p_alpha + y * stride_alpha + x, p_out + y * stride_out + x,
+                      segment_width, bkg, bpp_alpha, bpp, premultiplied);
         }
+      }
     }
-
   }
 
   if (options_ext.alpha_composition_mode != heif_alpha_composition_mode_none) {
@@ -287,3 +418,141 @@ Op_flatten_alpha_plane<Pixel>::convert_colorspace(const std::shared_ptr<const He
 
 template class Op_flatten_alpha_plane<uint8_t>;
 template class Op_flatten_alpha_plane<uint16_t>;
+
+
+template<class Pixel, bool Premultiply>
+std::vector<ColorStateWithCost>
+Op_alpha_premultiplication<Pixel, Premultiply>::state_after_conversion(const ColorState& input_state,
+                                                                       const ColorState& target_state,
+                                                                       const heif_color_conversion_options& options,
+                                                                       const heif_color_conversion_options_ext& options_ext) const
+{
+  if (!input_state.has_alpha ||
+      input_state.premultiplied_alpha == Premultiply ||
+      !target_state.has_alpha ||
+      target_state.premultiplied_alpha != Premultiply) {
+    return {};
+  }
+
+  bool hdr = !std::is_same<Pixel, uint8_t>::value;
+
+  if (input_state.chroma == heif_chroma_interleaved_RGBA) {
+    if (hdr) {
+      return {};
+    }
+  }
+  else if ((input_state.colorspace != heif_colorspace_RGB || input_state.chroma != heif_chroma_444) &&
+           (input_state.colorspace != heif_colorspace_monochrome || input_state.chroma != heif_chroma_monochrome)) {
+    return {};
+  }
+  else if ((input_state.bits_per_pixel > 8) != hdr) {
+    return {};
+  }
+
+  std::vector<ColorStateWithCost> states;
+
+  ColorState output_state = input_state;
+  output_state.premultiplied_alpha = Premultiply;
+
+  states.emplace_back(output_state, SpeedCosts_OptimizedSoftware);
+
+  return states;
+}
+
+
+template<class Pixel, bool Premultiply>
+Result<std::shared_ptr<HeifPixelImage>>
+Op_alpha_premultiplication<Pixel, Premultiply>::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                                                   const ColorState& input_state,
+                                                                   const ColorState& target_state,
+                                                                   const heif_color_conversion_options& options,
+                                                                   const heif_color_conversion_options_ext& options_ext,
+                                                                   const heif_security_limits* limits) const
+{
+  uint32_t width = input->get_width();
+  uint32_t height = input->get_height();
+
+  auto outimg = std::make_shared<HeifPixelImage>();
+
+  outimg->create(width, height,
+                 input->get_colorspace(),
+                 input->get_chroma_format());
+
+  if (input->get_chroma_format() == heif_chroma_interleaved_RGBA) {
+    if (auto err = outimg->add_plane(heif_channel_interleaved, width, height, 8, limits)) {
+      return err;
+    }
+
+    const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+    Alpha_RGBA32_row_kernel kernel = Premultiply ? kernels.premultiply_rgba32 : kernels.unpremultiply_rgba32;
+    const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+    size_t stride_in, stride_out;
+    const uint8_t* p_in = input->get_plane(heif_channel_interleaved, &stride_in);
+    uint8_t* p_out = outimg->get_plane(heif_channel_interleaved, &stride_out);
+
+    for (uint32_t y = 0; y < height; y++) {
+      const uint8_t* in = p_in + y * stride_in;
+      uint8_t* out = p_out + y * stride_out;
+
+      uint32_t x = kernel ? kernel(in, out, width) : 0;
+
+      for (; x < width; x++) {
+        uint8_t a = in[4 * x + 3];
+
+        for (int c = 0; c < 3; c++) {
+          out[4 * x + c] = Premultiply ?
+                           static_cast<uint8_t>(premultiply_sample(in[4 * x + c], a, 8)) :
+                           unpremultiply_sample8(in[4 * x + c], a, reciprocals);
+        }
+
+        out[4 * x + 3] = a;
+      }
+    }
+
+    return outimg;
+  }
+
+  if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
+    return err;
+  }
+
+  size_t stride_alpha;
+  const Pixel* p_alpha = input->get_channel<Pixel>(heif_channel_Alpha, &stride_alpha);
+  int bpp_alpha = input->get_bits_per_pixel(heif_channel_Alpha);
+
+  for (heif_channel channel : {heif_channel_Y,
+                               heif_channel_R,
+                               heif_channel_G,
+                               heif_channel_B}) {
+    if (!input->has_channel(channel)) {
+      continue;
+    }
+
+    int bpp = input->get_bits_per_pixel(channel);
+
+    if (auto err = outimg->add_plane(channel, width, height, bpp, limits)) {
+      return err;
+    }
+
+    size_t stride_in, stride_out;
+    const Pixel* p_in = input->get_channel<Pixel>(channel, &stride_in);
+    Pixel* p_out = outimg->get_channel<Pixel>(channel, &stride_out);
+
+    for (uint32_t y = 0; y < height; y++) {
+      if (Premultiply) {
+        premultiply_row(p_in + y * stride_in, p_alpha + y * stride_alpha, p_out + y * stride_out, width, bpp_alpha);
+      }
+      else {
+        unpremultiply_row(p_in + y * stride_in, p_alpha + y * stride_alpha, p_out + y * stride_out, width, bpp_alpha, bpp);
+      }
+    }
+  }
+
+  return outimg;
+}
+
+template class Op_alpha_premultiplication<uint8_t, true>;
+template class Op_alpha_premultiplication<uint16_t, true>;
+template class Op_alpha_premultiplication<uint8_t, false>;
+template class Op_alpha_premultiplication<uint16_t, false>;
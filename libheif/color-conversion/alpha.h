@@ -62,6 +62,32 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const override;
+
+  // The checkerboard pattern depends on the absolute pixel position.
+  bool supports_strip_processing(const heif_color_conversion_options_ext&) const override { return false; }
+};
+
+// Multiplies the color values with alpha (Premultiply=true) or undoes the premultiplication.
+// Works on planar RGB 4:4:4 and monochrome images with alpha plane, and, with 8 bits, on interleaved RGBA.
+template<class Pixel, bool Premultiply>
+class Op_alpha_premultiplication : public ColorConversionOperation
+{
+public:
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState& input_state,
+                         const ColorState& target_state,
+                         const heif_color_conversion_options& options,
+                         const heif_color_conversion_options_ext& options_ext) const override;
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+
+  bool handles_alpha_premultiplication() const override { return true; }
 };
 
 #endif //LIBHEIF_COLORCONVERSION_ALPHA_H
@@ -0,0 +1,1072 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alpha_simd.h"
+
+#include <array>
+#include <cstring>
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+const uint32_t* get_unpremultiply_reciprocals_8bit()
+{
+  static const std::array<uint32_t, 256> reciprocals = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t a = 1; a < 256; a++) {
+      table[a] = ((255U << 16) + a / 2) / a;
+    }
+    return table;
+  }();
+
+  return reciprocals.data();
+}
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+// div_round_by_alpha_max() for 8 bits. The intermediate values fit into 16 bits for t <= 255*255.
+HEIF_TARGET_SSE41
+static inline __m128i div_round_by_255_epu16_sse41(__m128i t)
+{
+  t = _mm_add_epi16(t, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i div_round_by_alpha_max_epu32_sse41(__m128i t, __m128i rounding, __m128i shift)
+{
+  t = _mm_add_epi32(t, rounding);
+  return _mm_srl_epi32(_mm_add_epi32(t, _mm_srl_epi32(t, shift)), shift);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t premultiply_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+
+    __m128i lo = div_round_by_255_epu16_sse41(_mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(a, zero)));
+    __m128i hi = div_round_by_255_epu16_sse41(_mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(a, zero)));
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+// Multiplies the int32 colors with the reciprocals of their alpha values.
+HEIF_TARGET_SSE41
+static inline __m128i unpremultiply_with_reciprocals_sse41(__m128i c, __m128i reciprocals)
+{
+  __m128i v = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(c, reciprocals), _mm_set1_epi32(0x8000)), 16);
+  return _mm_min_epu32(v, _mm_set1_epi32(255));
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i unpremultiply_4_alpha8_sse41(const uint8_t* in, const uint8_t* alpha, const uint32_t* reciprocals)
+{
+  int32_t c32;
+  memcpy(&c32, in, 4);
+  __m128i c = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(c32));
+
+  __m128i r = _mm_setr_epi32((int32_t) reciprocals[alpha[0]], (int32_t) reciprocals[alpha[1]],
+                             (int32_t) reciprocals[alpha[2]], (int32_t) reciprocals[alpha[3]]);
+
+  return unpremultiply_with_reciprocals_sse41(c, r);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t unpremultiply_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i lo = unpremultiply_4_alpha8_sse41(in + x, alpha + x, reciprocals);
+    __m128i hi = unpremultiply_4_alpha8_sse41(in + x + 4, alpha + x + 4, reciprocals);
+
+    __m128i v16 = _mm_packus_epi32(lo, hi);
+    _mm_storel_epi64((__m128i*) (out + x), _mm_packus_epi16(v16, v16));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t premultiply_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp)
+{
+  const __m128i rounding = _mm_set1_epi32(1 << (bpp - 1));
+  const __m128i shift = _mm_cvtsi32_si128(bpp);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+
+    __m128i lo = _mm_mullo_epi32(_mm_cvtepu16_epi32(c), _mm_cvtepu16_epi32(a));
+    __m128i hi = _mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(c, 8)), _mm_cvtepu16_epi32(_mm_srli_si128(a, 8)));
+
+    lo = div_round_by_alpha_max_epu32_sse41(lo, rounding, shift);
+    hi = div_round_by_alpha_max_epu32_sse41(hi, rounding, shift);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i unpremultiply_4_alpha16_sse41(__m128i c, __m128i a, __m128 max_value)
+{
+  __m128 v = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), _mm_div_ps(max_value, _mm_cvtepi32_ps(a))), _mm_set1_ps(0.5f));
+  __m128i r = _mm_cvttps_epi32(_mm_min_ps(v, max_value));
+
+  // alpha = 0 gives 0
+  return _mm_andnot_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), r);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t unpremultiply_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp)
+{
+  const __m128 max_value = _mm_set1_ps(static_cast<float>((1U << bpp) - 1));
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+
+    __m128i lo = unpremultiply_4_alpha16_sse41(_mm_cvtepu16_epi32(c), _mm_cvtepu16_epi32(a), max_value);
+    __m128i hi = unpremultiply_4_alpha16_sse41(_mm_cvtepu16_epi32(_mm_srli_si128(c, 8)),
+                                               _mm_cvtepu16_epi32(_mm_srli_si128(a, 8)), max_value);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t premultiply_RGBA32_row_sse41(const uint8_t* in, uint8_t* out, uint32_t width)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  // Broadcast the alpha of each pixel to its components. The alpha component itself is multiplied by 255.
+  const __m128i alpha_shuffle = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+  const __m128i alpha_component = _mm_setr_epi8(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + 4 * x));
+    __m128i a = _mm_or_si128(_mm_shuffle_epi8(c, alpha_shuffle), alpha_component);
+
+    __m128i lo = div_round_by_255_epu16_sse41(_mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(a, zero)));
+    __m128i hi = div_round_by_255_epu16_sse41(_mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(a, zero)));
+
+    _mm_storeu_si128((__m128i*) (out + 4 * x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i unpremultiply_RGBA_pixel_sse41(const uint8_t* in, const uint32_t* reciprocals)
+{
+  int32_t c32;
+  memcpy(&c32, in, 4);
+  __m128i c = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(c32));
+
+  __m128i v = unpremultiply_with_reciprocals_sse41(c, _mm_set1_epi32((int32_t) reciprocals[in[3]]));
+
+  // keep the alpha component
+  return _mm_blend_epi16(v, c, 0xC0);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t unpremultiply_RGBA32_row_sse41(const uint8_t* in, uint8_t* out, uint32_t width)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const uint8_t* p = in + 4 * x;
+
+    __m128i p01 = _mm_packus_epi32(unpremultiply_RGBA_pixel_sse41(p, reciprocals),
+                                   unpremultiply_RGBA_pixel_sse41(p + 4, reciprocals));
+    __m128i p23 = _mm_packus_epi32(unpremultiply_RGBA_pixel_sse41(p + 8, reciprocals),
+                                   unpremultiply_RGBA_pixel_sse41(p + 12, reciprocals));
+
+    _mm_storeu_si128((__m128i*) (out + 4 * x), _mm_packus_epi16(p01, p23));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i flatten_8_alpha8_sse41(__m128i c, __m128i a, __m128i bkg, bool premultiplied)
+{
+  const __m128i alpha_max = _mm_set1_epi16(255);
+
+  __m128i background = _mm_mullo_epi16(bkg, _mm_sub_epi16(alpha_max, a));
+
+  if (premultiplied) {
+    return _mm_add_epi16(c, div_round_by_255_epu16_sse41(background));
+  }
+  else {
+    return div_round_by_255_epu16_sse41(_mm_add_epi16(_mm_mullo_epi16(c, a), background));
+  }
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t flatten_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                  uint8_t bkg, bool premultiplied)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i background = _mm_set1_epi16(bkg);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+
+    __m128i lo = flatten_8_alpha8_sse41(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(a, zero), background, premultiplied);
+    __m128i hi = flatten_8_alpha8_sse41(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(a, zero), background, premultiplied);
+
+    // packing saturates invalid premultiplied colors to 255
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i flatten_4_alpha16_sse41(__m128i c, __m128i a, __m128i bkg, __m128i alpha_max,
+                                              __m128i rounding, __m128i shift, __m128i max_value, bool premultiplied)
+{
+  __m128i background = _mm_mullo_epi32(bkg, _mm_sub_epi32(alpha_max, a));
+
+  if (premultiplied) {
+    return _mm_min_epu32(_mm_add_epi32(c, div_round_by_alpha_max_epu32_sse41(background, rounding, shift)), max_value);
+  }
+  else {
+    return div_round_by_alpha_max_epu32_sse41(_mm_add_epi32(_mm_mullo_epi32(c, a), background), rounding, shift);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t flatten_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                   uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied)
+{
+  const __m128i background = _mm_set1_epi32(bkg);
+  const __m128i alpha_max = _mm_set1_epi32((1 << alpha_bpp) - 1);
+  const __m128i rounding = _mm_set1_epi32(1 << (alpha_bpp - 1));
+  const __m128i shift = _mm_cvtsi32_si128(alpha_bpp);
+  const __m128i maxval = _mm_set1_epi32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+
+    __m128i lo = flatten_4_alpha16_sse41(_mm_cvtepu16_epi32(c), _mm_cvtepu16_epi32(a), background, alpha_max,
+                                         rounding, shift, maxval, premultiplied);
+    __m128i hi = flatten_4_alpha16_sse41(_mm_cvtepu16_epi32(_mm_srli_si128(c, 8)), _mm_cvtepu16_epi32(_mm_srli_si128(a, 8)),
+                                         background, alpha_max, rounding, shift, maxval, premultiplied);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t composite_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                    bool premultiplied)
+{
+  const __m128i zero = _mm_setzero_si128();
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+    __m128i b = _mm_loadu_si128((const __m128i*) (out + x));
+
+    __m128i lo = flatten_8_alpha8_sse41(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(a, zero),
+                                        _mm_unpacklo_epi8(b, zero), premultiplied);
+    __m128i hi = flatten_8_alpha8_sse41(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(a, zero),
+                                        _mm_unpackhi_epi8(b, zero), premultiplied);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t composite_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                     int alpha_bpp, uint16_t max_value, bool premultiplied)
+{
+  const __m128i alpha_max = _mm_set1_epi32((1 << alpha_bpp) - 1);
+  const __m128i rounding = _mm_set1_epi32(1 << (alpha_bpp - 1));
+  const __m128i shift = _mm_cvtsi32_si128(alpha_bpp);
+  const __m128i maxval = _mm_set1_epi32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i c = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i a = _mm_loadu_si128((const __m128i*) (alpha + x));
+    __m128i b = _mm_loadu_si128((const __m128i*) (out + x));
+
+    __m128i lo = flatten_4_alpha16_sse41(_mm_cvtepu16_epi32(c), _mm_cvtepu16_epi32(a), _mm_cvtepu16_epi32(b),
+                                         alpha_max, rounding, shift, maxval, premultiplied);
+    __m128i hi = flatten_4_alpha16_sse41(_mm_cvtepu16_epi32(_mm_srli_si128(c, 8)), _mm_cvtepu16_epi32(_mm_srli_si128(a, 8)),
+                                         _mm_cvtepu16_epi32(_mm_srli_si128(b, 8)),
+                                         alpha_max, rounding, shift, maxval, premultiplied);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+static inline __m256i div_round_by_255_epu16_avx2(__m256i t)
+{
+  t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i div_round_by_alpha_max_epu32_avx2(__m256i t, __m256i rounding, __m128i shift)
+{
+  t = _mm256_add_epi32(t, rounding);
+  return _mm256_srl_epi32(_mm256_add_epi32(t, _mm256_srl_epi32(t, shift)), shift);
+}
+
+
+// Packs two vectors with 16 uint16 each into 32 bytes in their original order.
+HEIF_TARGET_AVX2
+static inline __m256i pack_u8_avx2(__m256i lo, __m256i hi)
+{
+  return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+}
+
+
+// Packs two vectors with 8 uint32 each into 16 uint16 in their original order.
+HEIF_TARGET_AVX2
+static inline __m256i pack_u16_avx2(__m256i lo, __m256i hi)
+{
+  return _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t premultiply_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i c_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x + 16)));
+    __m256i a_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (alpha + x + 16)));
+
+    __m256i lo = div_round_by_255_epu16_avx2(_mm256_mullo_epi16(c_lo, a_lo));
+    __m256i hi = div_round_by_255_epu16_avx2(_mm256_mullo_epi16(c_hi, a_hi));
+
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u8_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i unpremultiply_with_reciprocals_avx2(__m256i c, __m256i reciprocals)
+{
+  __m256i v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(c, reciprocals), _mm256_set1_epi32(0x8000)), 16);
+  return _mm256_min_epu32(v, _mm256_set1_epi32(255));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i unpremultiply_8_alpha8_avx2(const uint8_t* in, const uint8_t* alpha, const uint32_t* reciprocals)
+{
+  __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) in));
+  __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) alpha));
+  __m256i r = _mm256_i32gather_epi32((const int*) reciprocals, a, 4);
+
+  return unpremultiply_with_reciprocals_avx2(c, r);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t unpremultiply_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i lo = unpremultiply_8_alpha8_avx2(in + x, alpha + x, reciprocals);
+    __m256i hi = unpremultiply_8_alpha8_avx2(in + x + 8, alpha + x + 8, reciprocals);
+
+    __m256i v16 = pack_u16_avx2(lo, hi);
+    __m128i v8 = _mm_packus_epi16(_mm256_castsi256_si128(v16), _mm256_extracti128_si256(v16, 1));
+    _mm_storeu_si128((__m128i*) (out + x), v8);
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t premultiply_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp)
+{
+  const __m256i rounding = _mm256_set1_epi32(1 << (bpp - 1));
+  const __m128i shift = _mm_cvtsi32_si128(bpp);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i c_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x + 8)));
+    __m256i a_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x + 8)));
+
+    __m256i lo = div_round_by_alpha_max_epu32_avx2(_mm256_mullo_epi32(c_lo, a_lo), rounding, shift);
+    __m256i hi = div_round_by_alpha_max_epu32_avx2(_mm256_mullo_epi32(c_hi, a_hi), rounding, shift);
+
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u16_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i unpremultiply_8_alpha16_avx2(__m256i c, __m256i a, __m256 max_value)
+{
+  __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c), _mm256_div_ps(max_value, _mm256_cvtepi32_ps(a))),
+                           _mm256_set1_ps(0.5f));
+  __m256i r = _mm256_cvttps_epi32(_mm256_min_ps(v, max_value));
+
+  // alpha = 0 gives 0
+  return _mm256_andnot_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()), r);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t unpremultiply_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp)
+{
+  const __m256 max_value = _mm256_set1_ps(static_cast<float>((1U << bpp) - 1));
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i c_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x + 8)));
+    __m256i a_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x + 8)));
+
+    __m256i lo = unpremultiply_8_alpha16_avx2(c_lo, a_lo, max_value);
+    __m256i hi = unpremultiply_8_alpha16_avx2(c_hi, a_hi, max_value);
+
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u16_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t premultiply_RGBA32_row_avx2(const uint8_t* in, uint8_t* out, uint32_t width)
+{
+  const __m256i zero = _mm256_setzero_si256();
+
+  // Broadcast the alpha of each pixel to its components. The alpha component itself is multiplied by 255.
+  const __m256i alpha_shuffle = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+                                                 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+  const __m256i alpha_component = _mm256_set1_epi32(static_cast<int32_t>(0xFF000000));
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i c = _mm256_loadu_si256((const __m256i*) (in + 4 * x));
+    __m256i a = _mm256_or_si256(_mm256_shuffle_epi8(c, alpha_shuffle), alpha_component);
+
+    // unpack and pack both work within the 128-bit lanes and keep the pixel order
+    __m256i lo = div_round_by_255_epu16_avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(a, zero)));
+    __m256i hi = div_round_by_255_epu16_avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(a, zero)));
+
+    _mm256_storeu_si256((__m256i*) (out + 4 * x), _mm256_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+// Unpremultiplies two RGBA pixels. The result is one int32 per component.
+HEIF_TARGET_AVX2
+static inline __m256i unpremultiply_2_RGBA_pixels_avx2(const uint8_t* in, const uint32_t* reciprocals)
+{
+  const __m128i alpha_shuffle = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+  __m128i p = _mm_loadl_epi64((const __m128i*) in);
+  __m256i c = _mm256_cvtepu8_epi32(p);
+  __m256i a = _mm256_cvtepu8_epi32(_mm_shuffle_epi8(p, alpha_shuffle));
+  __m256i r = _mm256_i32gather_epi32((const int*) reciprocals, a, 4);
+
+  // keep the alpha component
+  return _mm256_blend_epi32(unpremultiply_with_reciprocals_avx2(c, r), c, 0x88);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t unpremultiply_RGBA32_row_avx2(const uint8_t* in, uint8_t* out, uint32_t width)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const uint8_t* p = in + 4 * x;
+
+    __m256i p0123 = pack_u16_avx2(unpremultiply_2_RGBA_pixels_avx2(p, reciprocals),
+                                  unpremultiply_2_RGBA_pixels_avx2(p + 8, reciprocals));
+    __m256i p4567 = pack_u16_avx2(unpremultiply_2_RGBA_pixels_avx2(p + 16, reciprocals),
+                                  unpremultiply_2_RGBA_pixels_avx2(p + 24, reciprocals));
+
+    _mm256_storeu_si256((__m256i*) (out + 4 * x), pack_u8_avx2(p0123, p4567));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i flatten_16_alpha8_avx2(__m256i c, __m256i a, __m256i bkg, bool premultiplied)
+{
+  const __m256i alpha_max = _mm256_set1_epi16(255);
+
+  __m256i background = _mm256_mullo_epi16(bkg, _mm256_sub_epi16(alpha_max, a));
+
+  if (premultiplied) {
+    return _mm256_add_epi16(c, div_round_by_255_epu16_avx2(background));
+  }
+  else {
+    return div_round_by_255_epu16_avx2(_mm256_add_epi16(_mm256_mullo_epi16(c, a), background));
+  }
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t flatten_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                 uint8_t bkg, bool premultiplied)
+{
+  const __m256i background = _mm256_set1_epi16(bkg);
+
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i c_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x + 16)));
+    __m256i a_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (alpha + x + 16)));
+
+    __m256i lo = flatten_16_alpha8_avx2(c_lo, a_lo, background, premultiplied);
+    __m256i hi = flatten_16_alpha8_avx2(c_hi, a_hi, background, premultiplied);
+
+    // packing saturates invalid premultiplied colors to 255
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u8_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i flatten_8_alpha16_avx2(__m256i c, __m256i a, __m256i bkg, __m256i alpha_max,
+                                             __m256i rounding, __m128i shift, __m256i max_value, bool premultiplied)
+{
+  __m256i background = _mm256_mullo_epi32(bkg, _mm256_sub_epi32(alpha_max, a));
+
+  if (premultiplied) {
+    return _mm256_min_epu32(_mm256_add_epi32(c, div_round_by_alpha_max_epu32_avx2(background, rounding, shift)), max_value);
+  }
+  else {
+    return div_round_by_alpha_max_epu32_avx2(_mm256_add_epi32(_mm256_mullo_epi32(c, a), background), rounding, shift);
+  }
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t flatten_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                  uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied)
+{
+  const __m256i background = _mm256_set1_epi32(bkg);
+  const __m256i alpha_max = _mm256_set1_epi32((1 << alpha_bpp) - 1);
+  const __m256i rounding = _mm256_set1_epi32(1 << (alpha_bpp - 1));
+  const __m128i shift = _mm_cvtsi32_si128(alpha_bpp);
+  const __m256i maxval = _mm256_set1_epi32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i c_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x + 8)));
+    __m256i a_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x + 8)));
+
+    __m256i lo = flatten_8_alpha16_avx2(c_lo, a_lo, background, alpha_max, rounding, shift, maxval, premultiplied);
+    __m256i hi = flatten_8_alpha16_avx2(c_hi, a_hi, background, alpha_max, rounding, shift, maxval, premultiplied);
+
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u16_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t composite_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                   bool premultiplied)
+{
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i c_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x + 16)));
+    __m256i a_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (alpha + x + 16)));
+    __m256i b_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (out + x)));
+    __m256i b_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (out + x + 16)));
+
+    __m256i lo = flatten_16_alpha8_avx2(c_lo, a_lo, b_lo, premultiplied);
+    __m256i hi = flatten_16_alpha8_avx2(c_hi, a_hi, b_hi, premultiplied);
+
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u8_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t composite_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                    int alpha_bpp, uint16_t max_value, bool premultiplied)
+{
+  const __m256i alpha_max = _mm256_set1_epi32((1 << alpha_bpp) - 1);
+  const __m256i rounding = _mm256_set1_epi32(1 << (alpha_bpp - 1));
+  const __m128i shift = _mm_cvtsi32_si128(alpha_bpp);
+  const __m256i maxval = _mm256_set1_epi32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i c_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i c_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x + 8)));
+    __m256i a_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x)));
+    __m256i a_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (alpha + x + 8)));
+    __m256i b_lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (out + x)));
+    __m256i b_hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (out + x + 8)));
+
+    __m256i lo = flatten_8_alpha16_avx2(c_lo, a_lo, b_lo, alpha_max, rounding, shift, maxval, premultiplied);
+    __m256i hi = flatten_8_alpha16_avx2(c_hi, a_hi, b_hi, alpha_max, rounding, shift, maxval, premultiplied);
+
+    _mm256_storeu_si256((__m256i*) (out + x), pack_u16_avx2(lo, hi));
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+static inline uint16x8_t div_round_by_255_u16_neon(uint16x8_t t)
+{
+  t = vaddq_u16(t, vdupq_n_u16(128));
+  return vshrq_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+
+// 'neg_shift' is the negative number of bits, as vshlq shifts right for negative values.
+static inline uint32x4_t div_round_by_alpha_max_u32_neon(uint32x4_t t, uint32x4_t rounding, int32x4_t neg_shift)
+{
+  t = vaddq_u32(t, rounding);
+  return vshlq_u32(vaddq_u32(t, vshlq_u32(t, neg_shift)), neg_shift);
+}
+
+
+uint32_t premultiply_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t c = vld1q_u8(in + x);
+    uint8x16_t a = vld1q_u8(alpha + x);
+
+    uint16x8_t lo = div_round_by_255_u16_neon(vmull_u8(vget_low_u8(c), vget_low_u8(a)));
+    uint16x8_t hi = div_round_by_255_u16_neon(vmull_u8(vget_high_u8(c), vget_high_u8(a)));
+
+    vst1q_u8(out + x, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+  }
+
+  return x;
+}
+
+
+static inline uint32x4_t unpremultiply_with_reciprocals_neon(uint32x4_t c, uint32x4_t reciprocals)
+{
+  uint32x4_t v = vshrq_n_u32(vaddq_u32(vmulq_u32(c, reciprocals), vdupq_n_u32(0x8000)), 16);
+  return vminq_u32(v, vdupq_n_u32(255));
+}
+
+
+static inline uint32x4_t load_reciprocals_neon(const uint8_t* alpha, int step, const uint32_t* reciprocals)
+{
+  const uint32_t r[4] = {reciprocals[alpha[0]], reciprocals[alpha[step]],
+                         reciprocals[alpha[2 * step]], reciprocals[alpha[3 * step]]};
+  return vld1q_u32(r);
+}
+
+
+// Unpremultiplies 8 samples with their alpha values at 'alpha', 'alpha + step', ...
+static inline uint8x8_t unpremultiply_8_alpha8_neon(uint8x8_t c, const uint8_t* alpha, int step, const uint32_t* reciprocals)
+{
+  uint16x8_t c16 = vmovl_u8(c);
+
+  uint32x4_t lo = unpremultiply_with_reciprocals_neon(vmovl_u16(vget_low_u16(c16)),
+                                                      load_reciprocals_neon(alpha, step, reciprocals));
+  uint32x4_t hi = unpremultiply_with_reciprocals_neon(vmovl_u16(vget_high_u16(c16)),
+                                                      load_reciprocals_neon(alpha + 4 * step, step, reciprocals));
+
+  return vmovn_u16(vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+}
+
+
+uint32_t unpremultiply_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    vst1_u8(out + x, unpremultiply_8_alpha8_neon(vld1_u8(in + x), alpha + x, 1, reciprocals));
+  }
+
+  return x;
+}
+
+
+uint32_t premultiply_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp)
+{
+  const uint32x4_t rounding = vdupq_n_u32(1U << (bpp - 1));
+  const int32x4_t neg_shift = vdupq_n_s32(-bpp);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t c = vld1q_u16(in + x);
+    uint16x8_t a = vld1q_u16(alpha + x);
+
+    uint32x4_t lo = div_round_by_alpha_max_u32_neon(vmull_u16(vget_low_u16(c), vget_low_u16(a)), rounding, neg_shift);
+    uint32x4_t hi = div_round_by_alpha_max_u32_neon(vmull_u16(vget_high_u16(c), vget_high_u16(a)), rounding, neg_shift);
+
+    vst1q_u16(out + x, vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+  }
+
+  return x;
+}
+
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+static inline uint32x4_t unpremultiply_4_alpha16_neon(uint32x4_t c, uint32x4_t a, float32x4_t max_value)
+{
+  float32x4_t v = vaddq_f32(vmulq_f32(vcvtq_f32_u32(c), vdivq_f32(max_value, vcvtq_f32_u32(a))), vdupq_n_f32(0.5f));
+  uint32x4_t r = vcvtq_u32_f32(vminq_f32(v, max_value));
+
+  // alpha = 0 gives 0
+  return vandq_u32(r, vtstq_u32(a, a));
+}
+
+
+uint32_t unpremultiply_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp)
+{
+  const float32x4_t max_value = vdupq_n_f32(static_cast<float>((1U << bpp) - 1));
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t c = vld1q_u16(in + x);
+    uint16x8_t a = vld1q_u16(alpha + x);
+
+    uint32x4_t lo = unpremultiply_4_alpha16_neon(vmovl_u16(vget_low_u16(c)), vmovl_u16(vget_low_u16(a)), max_value);
+    uint32x4_t hi = unpremultiply_4_alpha16_neon(vmovl_u16(vget_high_u16(c)), vmovl_u16(vget_high_u16(a)), max_value);
+
+    vst1q_u16(out + x, vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+  }
+
+  return x;
+}
+
+#endif
+
+
+uint32_t premultiply_RGBA32_row_neon(const uint8_t* in, uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x4_t p = vld4q_u8(in + 4 * x);
+
+    for (int c = 0; c < 3; c++) {
+      uint16x8_t lo = div_round_by_255_u16_neon(vmull_u8(vget_low_u8(p.val[c]), vget_low_u8(p.val[3])));
+      uint16x8_t hi = div_round_by_255_u16_neon(vmull_u8(vget_high_u8(p.val[c]), vget_high_u8(p.val[3])));
+      p.val[c] = vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+    }
+
+    vst4q_u8(out + 4 * x, p);
+  }
+
+  return x;
+}
+
+
+uint32_t unpremultiply_RGBA32_row_neon(const uint8_t* in, uint8_t* out, uint32_t width)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint8x8x4_t p = vld4_u8(in + 4 * x);
+
+    for (int c = 0; c < 3; c++) {
+      p.val[c] = unpremultiply_8_alpha8_neon(p.val[c], in + 4 * x + 3, 4, reciprocals);
+    }
+
+    vst4_u8(out + 4 * x, p);
+  }
+
+  return x;
+}
+
+
+static inline uint16x8_t flatten_8_alpha8_neon(uint8x8_t c, uint8x8_t a, uint8x8_t bkg, bool premultiplied)
+{
+  uint16x8_t background = vmull_u8(bkg, vsub_u8(vdup_n_u8(255), a));
+
+  if (premultiplied) {
+    return vaddq_u16(vmovl_u8(c), div_round_by_255_u16_neon(background));
+  }
+  else {
+    return div_round_by_255_u16_neon(vaddq_u16(vmull_u8(c, a), background));
+  }
+}
+
+
+uint32_t flatten_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                 uint8_t bkg, bool premultiplied)
+{
+  const uint8x8_t background = vdup_n_u8(bkg);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t c = vld1q_u8(in + x);
+    uint8x16_t a = vld1q_u8(alpha + x);
+
+    uint16x8_t lo = flatten_8_alpha8_neon(vget_low_u8(c), vget_low_u8(a), background, premultiplied);
+    uint16x8_t hi = flatten_8_alpha8_neon(vget_high_u8(c), vget_high_u8(a), background, premultiplied);
+
+    // the saturating narrowing clips invalid premultiplied colors to 255
+    vst1q_u8(out + x, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+  }
+
+  return x;
+}
+
+
+static inline uint32x4_t flatten_4_alpha16_neon(uint32x4_t c, uint32x4_t a, uint32x4_t bkg, uint32x4_t alpha_max,
+                                                uint32x4_t rounding, int32x4_t neg_shift, uint32x4_t max_value,
+                                                bool premultiplied)
+{
+  uint32x4_t background = vmulq_u32(bkg, vsubq_u32(alpha_max, a));
+
+  if (premultiplied) {
+    return vminq_u32(vaddq_u32(c, div_round_by_alpha_max_u32_neon(background, rounding, neg_shift)), max_value);
+  }
+  else {
+    return div_round_by_alpha_max_u32_neon(vaddq_u32(vmulq_u32(c, a), background), rounding, neg_shift);
+  }
+}
+
+
+uint32_t flatten_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                  uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied)
+{
+  const uint32x4_t background = vdupq_n_u32(bkg);
+  const uint32x4_t alpha_max = vdupq_n_u32((1U << alpha_bpp) - 1);
+  const uint32x4_t rounding = vdupq_n_u32(1U << (alpha_bpp - 1));
+  const int32x4_t neg_shift = vdupq_n_s32(-alpha_bpp);
+  const uint32x4_t maxval = vdupq_n_u32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t c = vld1q_u16(in + x);
+    uint16x8_t a = vld1q_u16(alpha + x);
+
+    uint32x4_t lo = flatten_4_alpha16_neon(vmovl_u16(vget_low_u16(c)), vmovl_u16(vget_low_u16(a)), background,
+                                           alpha_max, rounding, neg_shift, maxval, premultiplied);
+    uint32x4_t hi = flatten_4_alpha16_neon(vmovl_u16(vget_high_u16(c)), vmovl_u16(vget_high_u16(a)), background,
+                                           alpha_max, rounding, neg_shift, maxval, premultiplied);
+
+    vst1q_u16(out + x, vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+  }
+
+  return x;
+}
+
+
+uint32_t composite_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                   bool premultiplied)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t c = vld1q_u8(in + x);
+    uint8x16_t a = vld1q_u8(alpha + x);
+    uint8x16_t b = vld1q_u8(out + x);
+
+    uint16x8_t lo = flatten_8_alpha8_neon(vget_low_u8(c), vget_low_u8(a), vget_low_u8(b), premultiplied);
+    uint16x8_t hi = flatten_8_alpha8_neon(vget_high_u8(c), vget_high_u8(a), vget_high_u8(b), premultiplied);
+
+    vst1q_u8(out + x, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+  }
+
+  return x;
+}
+
+
+uint32_t composite_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                    int alpha_bpp, uint16_t max_value, bool premultiplied)
+{
+  const uint32x4_t alpha_max = vdupq_n_u32((1U << alpha_bpp) - 1);
+  const uint32x4_t rounding = vdupq_n_u32(1U << (alpha_bpp - 1));
+  const int32x4_t neg_shift = vdupq_n_s32(-alpha_bpp);
+  const uint32x4_t maxval = vdupq_n_u32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t c = vld1q_u16(in + x);
+    uint16x8_t a = vld1q_u16(alpha + x);
+    uint16x8_t b = vld1q_u16(out + x);
+
+    uint32x4_t lo = flatten_4_alpha16_neon(vmovl_u16(vget_low_u16(c)), vmovl_u16(vget_low_u16(a)),
+                                           vmovl_u16(vget_low_u16(b)),
+                                           alpha_max, rounding, neg_shift, maxval, premultiplied);
+    uint32x4_t hi = flatten_4_alpha16_neon(vmovl_u16(vget_high_u16(c)), vmovl_u16(vget_high_u16(a)),
+                                           vmovl_u16(vget_high_u16(b)),
+                                           alpha_max, rounding, neg_shift, maxval, premultiplied);
+
+    vst1q_u16(out + x, vcombine_u16(vqmovn_u32(lo), vqmovn_u32(hi)));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Alpha_row_kernels select_alpha_row_kernels()
+{
+  Alpha_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.premultiply8 = premultiply_alpha8_row_avx2;
+    kernels.unpremultiply8 = unpremultiply_alpha8_row_avx2;
+    kernels.premultiply16 = premultiply_alpha16_row_avx2;
+    kernels.unpremultiply16 = unpremultiply_alpha16_row_avx2;
+    kernels.premultiply_rgba32 = premultiply_RGBA32_row_avx2;
+    kernels.unpremultiply_rgba32 = unpremultiply_RGBA32_row_avx2;
+    kernels.flatten8 = flatten_alpha8_row_avx2;
+    kernels.flatten16 = flatten_alpha16_row_avx2;
+    kernels.composite8 = composite_alpha8_row_avx2;
+    kernels.composite16 = composite_alpha16_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.premultiply8 = premultiply_alpha8_row_sse41;
+    kernels.unpremultiply8 = unpremultiply_alpha8_row_sse41;
+    kernels.premultiply16 = premultiply_alpha16_row_sse41;
+    kernels.unpremultiply16 = unpremultiply_alpha16_row_sse41;
+    kernels.premultiply_rgba32 = premultiply_RGBA32_row_sse41;
+    kernels.unpremultiply_rgba32 = unpremultiply_RGBA32_row_sse41;
+    kernels.flatten8 = flatten_alpha8_row_sse41;
+    kernels.flatten16 = flatten_alpha16_row_sse41;
+    kernels.composite8 = composite_alpha8_row_sse41;
+    kernels.composite16 = composite_alpha16_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.premultiply8 = premultiply_alpha8_row_neon;
+    kernels.unpremultiply8 = unpremultiply_alpha8_row_neon;
+    kernels.premultiply16 = premultiply_alpha16_row_neon;
+#if defined(__aarch64__) || defined(_M_ARM64)
+    kernels.unpremultiply16 = unpremultiply_alpha16_row_neon;
+#endif
+    kernels.premultiply_rgba32 = premultiply_RGBA32_row_neon;
+    kernels.unpremultiply_rgba32 = unpremultiply_RGBA32_row_neon;
+    kernels.flatten8 = flatten_alpha8_row_neon;
+    kernels.flatten16 = flatten_alpha16_row_neon;
+    kernels.composite8 = composite_alpha8_row_neon;
+    kernels.composite16 = composite_alpha16_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const Alpha_row_kernels& get_alpha_row_kernels()
+{
+  static const Alpha_row_kernels kernels = select_alpha_row_kernels();
+  return kernels;
+}
@@ -0,0 +1,212 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_ALPHA_SIMD_H
+#define LIBHEIF_COLORCONVERSION_ALPHA_SIMD_H
+
+#include <cstdint>
+#include <algorithm>
+#include "cpu_features.h"
+
+
+// --- Per-sample alpha operations.
+//
+// The scalar code in alpha.cc and the SIMD row kernels below compute exactly these expressions.
+
+// Rounded division of t by (2^bits - 1). Exact for t <= (2^bits - 1)^2.
+inline uint32_t div_round_by_alpha_max(uint32_t t, int bits)
+{
+  t += 1U << (bits - 1);
+  return (t + (t >> bits)) >> bits;
+}
+
+inline uint32_t premultiply_sample(uint32_t color, uint32_t alpha, int alpha_bpp)
+{
+  return div_round_by_alpha_max(color * alpha, alpha_bpp);
+}
+
+// Reciprocals for undoing 8-bit premultiplication: ((255 << 16) + a/2) / a, and 0 for a=0.
+const uint32_t* get_unpremultiply_reciprocals_8bit();
+
+// The result differs from the exactly rounded value only for ties, which may be rounded down.
+inline uint8_t unpremultiply_sample8(uint32_t color, uint32_t alpha, const uint32_t* reciprocals)
+{
+  uint32_t v = (color * reciprocals[alpha] + 0x8000) >> 16;
+  return static_cast<uint8_t>(std::min(v, 255U));
+}
+
+// Color and alpha have the same bit depth.
+inline uint16_t unpremultiply_sample16(uint32_t color, uint32_t alpha, int bpp)
+{
+  if (alpha == 0) {
+    return 0;
+  }
+
+  auto max_value = static_cast<float>((1U << bpp) - 1);
+  float v = static_cast<float>(color) * (max_value / static_cast<float>(alpha)) + 0.5f;
+  return static_cast<uint16_t>(std::min(v, max_value));
+}
+
+// Composes the color onto the background 'bkg'. The result is clipped to 'max_value' for invalid premultiplied
+// colors that are larger than their alpha.
+inline uint32_t flatten_sample(uint32_t color, uint32_t alpha, uint32_t bkg, int alpha_bpp, uint32_t max_value,
+                               bool premultiplied)
+{
+  uint32_t alpha_max = (1U << alpha_bpp) - 1;
+
+  if (premultiplied) {
+    return std::min(color + div_round_by_alpha_max(bkg * (alpha_max - alpha), alpha_bpp), max_value);
+  }
+  else {
+    return div_round_by_alpha_max(color * alpha + bkg * (alpha_max - alpha), alpha_bpp);
+  }
+}
+
+
+// --- Row kernels (see cpu_features.h). They return the number of processed samples.
+
+// One planar color row and the alpha row with 8 bits.
+typedef uint32_t (*Alpha_planar8_row_kernel)(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+// One planar color row and the alpha row with up to 16 bits. For premultiplication, 'bpp' is the bit depth of the alpha
+// channel. Unpremultiplication requires that color and alpha have the same bit depth 'bpp'.
+typedef uint32_t (*Alpha_planar16_row_kernel)(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                              int bpp);
+
+// Interleaved RGBA with 8 bits. The alpha component is copied.
+typedef uint32_t (*Alpha_RGBA32_row_kernel)(const uint8_t* in, uint8_t* out, uint32_t width);
+
+typedef uint32_t (*Flatten_alpha8_row_kernel)(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                              uint8_t bkg, bool premultiplied);
+
+typedef uint32_t (*Flatten_alpha16_row_kernel)(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                               uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+// Source-over compositing of a color row onto the row 'out' (in place). This is flatten_sample() with the
+// background taken from 'out'.
+typedef uint32_t (*Composite_alpha8_row_kernel)(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                                bool premultiplied);
+
+typedef uint32_t (*Composite_alpha16_row_kernel)(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                                 int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+
+struct Alpha_row_kernels
+{
+  Alpha_planar8_row_kernel premultiply8 = nullptr;
+  Alpha_planar8_row_kernel unpremultiply8 = nullptr;
+  Alpha_planar16_row_kernel premultiply16 = nullptr;
+  Alpha_planar16_row_kernel unpremultiply16 = nullptr;
+  Alpha_RGBA32_row_kernel premultiply_rgba32 = nullptr;
+  Alpha_RGBA32_row_kernel unpremultiply_rgba32 = nullptr;
+  Flatten_alpha8_row_kernel flatten8 = nullptr;
+  Flatten_alpha16_row_kernel flatten16 = nullptr;
+  Composite_alpha8_row_kernel composite8 = nullptr;
+  Composite_alpha16_row_kernel composite16 = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t premultiply_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+uint32_t unpremultiply_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+uint32_t premultiply_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp);
+
+uint32_t unpremultiply_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp);
+
+uint32_t premultiply_RGBA32_row_sse41(const uint8_t* in, uint8_t* out, uint32_t width);
+
+uint32_t unpremultiply_RGBA32_row_sse41(const uint8_t* in, uint8_t* out, uint32_t width);
+
+uint32_t flatten_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                  uint8_t bkg, bool premultiplied);
+
+uint32_t flatten_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                   uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+uint32_t composite_alpha8_row_sse41(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                    bool premultiplied);
+
+uint32_t composite_alpha16_row_sse41(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                     int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+uint32_t premultiply_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+uint32_t unpremultiply_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+uint32_t premultiply_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp);
+
+uint32_t unpremultiply_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp);
+
+uint32_t premultiply_RGBA32_row_avx2(const uint8_t* in, uint8_t* out, uint32_t width);
+
+uint32_t unpremultiply_RGBA32_row_avx2(const uint8_t* in, uint8_t* out, uint32_t width);
+
+uint32_t flatten_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                 uint8_t bkg, bool premultiplied);
+
+uint32_t flatten_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                  uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+uint32_t composite_alpha8_row_avx2(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                   bool premultiplied);
+
+uint32_t composite_alpha16_row_avx2(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                    int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t premultiply_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+uint32_t unpremultiply_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width);
+
+uint32_t premultiply_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp);
+
+// There is no vector division on 32-bit ARM.
+#if defined(__aarch64__) || defined(_M_ARM64)
+uint32_t unpremultiply_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width, int bpp);
+#endif
+
+uint32_t premultiply_RGBA32_row_neon(const uint8_t* in, uint8_t* out, uint32_t width);
+
+uint32_t unpremultiply_RGBA32_row_neon(const uint8_t* in, uint8_t* out, uint32_t width);
+
+uint32_t flatten_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                 uint8_t bkg, bool premultiplied);
+
+uint32_t flatten_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                  uint16_t bkg, int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+uint32_t composite_alpha8_row_neon(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                   bool premultiplied);
+
+uint32_t composite_alpha16_row_neon(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                    int alpha_bpp, uint16_t max_value, bool premultiplied);
+
+#endif
+
+
+const Alpha_row_kernels& get_alpha_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_ALPHA_SIMD_H
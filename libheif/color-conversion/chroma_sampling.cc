@@ -19,7 +19,85 @@
  */
 
 #include "chroma_sampling.h"
-#include <cstring>
+#include "chroma_sampling_simd.h"
+
+
+// --- row filters that use the SIMD kernels for the first part of the row
+
+template<class Pixel>
+static void downsample_420_chroma_row(const Pixel* row0, const Pixel* row1, Pixel* out, uint32_t num_samples)
+{
+  const Chroma_sampling_row_kernels& kernels = get_chroma_sampling_row_kernels();
+
+  uint32_t x = 0;
+  if constexpr (std::is_same<Pixel, uint8_t>::value) {
+    if (kernels.downsample420_8) {
+      x = kernels.downsample420_8(row0, row1, out, num_samples);
+    }
+  }
+  else {
+    if (kernels.downsample420_16) {
+      x = kernels.downsample420_16(row0, row1, out, num_samples);
+    }
+  }
+
+  for (; x < num_samples; x++) {
+    out[x] = (Pixel) chroma_average_2x2(row0[2 * x], row0[2 * x + 1], row1[2 * x], row1[2 * x + 1]);
+  }
+}
+
+
+template<class Pixel>
+static void downsample_422_chroma_row(const Pixel* row, Pixel* out, uint32_t num_samples)
+{
+  const Chroma_sampling_row_kernels& kernels = get_chroma_sampling_row_kernels();
+
+  uint32_t x = 0;
+  if constexpr (std::is_same<Pixel, uint8_t>::value) {
+    if (kernels.downsample422_8) {
+      x = kernels.downsample422_8(row, out, num_samples);
+    }
+  }
+  else {
+    if (kernels.downsample422_16) {
+      x = kernels.downsample422_16(row, out, num_samples);
+    }
+  }
+
+  for (; x < num_samples; x++) {
+    out[x] = (Pixel) chroma_average_2x1(row[2 * x], row[2 * x + 1]);
+  }
+}
+
+
+// Interpolates the vertically weighted chroma samples 'cx' and 'cx+1' into out[2*cx] and out[2*cx+1]
+// for all cx < num_samples.
+template<class Pixel>
+static void upsample_chroma_row_pairs(const Pixel* row0, const Pixel* row1, uint32_t w0, uint32_t w1,
+                                      Pixel* out, uint32_t num_samples)
+{
+  const Chroma_sampling_row_kernels& kernels = get_chroma_sampling_row_kernels();
+
+  uint32_t cx = 0;
+  if constexpr (std::is_same<Pixel, uint8_t>::value) {
+    if (kernels.upsample8) {
+      cx = kernels.upsample8(row0, row1, w0, w1, out, num_samples);
+    }
+  }
+  else {
+    if (kernels.upsample16) {
+      cx = kernels.upsample16(row0, row1, w0, w1, out, num_samples);
+    }
+  }
+
+  for (; cx < num_samples; cx++) {
+    uint32_t v0 = chroma_vertical_sum(row0[cx], row1[cx], w0, w1);
+    uint32_t v1 = chroma_vertical_sum(row0[cx + 1], row1[cx + 1], w0, w1);
+
+    out[2 * cx + 0] = (Pixel) chroma_upsample_sample(v0, v1);
+    out[2 * cx + 1] = (Pixel) chroma_upsample_sample(v1, v0);
+  }
+}
 
 
 template<class Pixel>
@@ -89,14 +167,8 @@ Op_YCbCr444_to_YCbCr420_average<Pixel>::convert_colorspace(const std::shared_ptr
   int bpp_y = input->get_bits_per_pixel(heif_channel_Y);
   int bpp_cb = input->get_bits_per_pixel(heif_channel_Cb);
   int bpp_cr = input->get_bits_per_pixel(heif_channel_Cr);
-  int bpp_a = 0;
-
   bool has_alpha = input->has_channel(heif_channel_Alpha);
 
-  if (has_alpha) {
-    bpp_a = input->get_bits_per_pixel(heif_channel_Alpha);
-  }
-
   if (!hdr) {
     if (bpp_y > 8 ||
         bpp_cb > 8 ||
@@ -132,54 +204,37 @@ Op_YCbCr444_to_YCbCr420_average<Pixel>::convert_colorspace(const std::shared_ptr
   uint32_t cwidth = (width + 1) / 2;
   uint32_t cheight = (height + 1) / 2;
 
-  if (auto err = outimg->add_plane(heif_channel_Y, width, height, bpp_y, limits) ||
+  if (auto err = outimg->share_plane_from(input, heif_channel_Y, heif_channel_Y) ||
                  outimg->add_plane(heif_channel_Cb, cwidth, cheight, bpp_cb, limits) ||
                  outimg->add_plane(heif_channel_Cr, cwidth, cheight, bpp_cr, limits)) {
     return err;
   }
 
   if (has_alpha) {
-    if (auto err = outimg->add_plane(heif_channel_Alpha, width, height, bpp_a, limits)) {
+    if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
       return err;
     }
   }
 
-  const Pixel* in_y, * in_cb, * in_cr;
-  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0, in_a_stride = 0;
+  const Pixel* in_cb, * in_cr;
+  size_t in_cb_stride = 0, in_cr_stride = 0;
 
-  Pixel* out_y, * out_cb, * out_cr;
-  size_t out_y_stride = 0, out_cb_stride = 0, out_cr_stride = 0, out_a_stride = 0;
+  Pixel* out_cb, * out_cr;
+  size_t out_cb_stride = 0, out_cr_stride = 0;
 
-  in_y = (const Pixel*) input->get_plane(heif_channel_Y, &in_y_stride);
   in_cb = (const Pixel*) input->get_plane(heif_channel_Cb, &in_cb_stride);
   in_cr = (const Pixel*) input->get_plane(heif_channel_Cr, &in_cr_stride);
-  out_y = (Pixel*) outimg->get_plane(heif_channel_Y, &out_y_stride);
   out_cb = (Pixel*) outimg->get_plane(heif_channel_Cb, &out_cb_stride);
   out_cr = (Pixel*) outimg->get_plane(heif_channel_Cr, &out_cr_stride);
 
   if (hdr) {
-    in_y_stride /= 2;
     in_cb_stride /= 2;
     in_cr_stride /= 2;
-    out_y_stride /= 2;
     out_cb_stride /= 2;
     out_cr_stride /= 2;
   }
 
 
-  // We only copy the alpha, do not access it as 16 bit
-  const uint8_t* in_a;
-  uint8_t* out_a;
-
-  if (has_alpha) {
-    in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
-    out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
-  }
-  else {
-    in_a = nullptr;
-    out_a = nullptr;
-  }
-
 
   // --- fill right and bottom borders if the image size is odd
 
@@ -209,34 +264,12 @@ Op_YCbCr444_to_YCbCr420_average<Pixel>::convert_colorspace(const std::shared_ptr
 
   // --- averaging filter
 
-  uint32_t x, y;
+  uint32_t y;
   for (y = 0; y < height - 1; y += 2) {
-    for (x = 0; x < width - 1; x += 2) {
-      Pixel cb00 = in_cb[y * in_cb_stride + x];
-      Pixel cr00 = in_cr[y * in_cr_stride + x];
-      Pixel cb01 = in_cb[y * in_cb_stride + x + 1];
-      Pixel cr01 = in_cr[y * in_cr_stride + x + 1];
-      Pixel cb10 = in_cb[(y + 1) * in_cb_stride + x];
-      Pixel cr10 = in_cr[(y + 1) * in_cr_stride + x];
-      Pixel cb11 = in_cb[(y + 1) * in_cb_stride + x + 1];
-      Pixel cr11 = in_cr[(y + 1) * in_cr_stride + x + 1];
-
-      out_cb[(y / 2) * out_cb_stride + x / 2] = (Pixel) ((cb00 + cb01 + cb10 + cb11 + 2) / 4);
-      out_cr[(y / 2) * out_cr_stride + x / 2] = (Pixel) ((cr00 + cr01 + cr10 + cr11 + 2) / 4);
-    }
-  }
-
-  // TODO: check whether we can use HeifPixelImage::transfer_plane_from_image_as() instead of copying Y and Alpha
-
-  for (y = 0; y < height; y++) {
-    uint32_t copyWidth = (hdr ? width * 2 : width);
-
-    memcpy(&out_y[y * out_y_stride], &in_y[y * in_y_stride], copyWidth);
-
-    if (has_alpha) {
-      uint32_t alphaCopyWidth = (bpp_a > 8 ? width * 2 : width);
-      memcpy(&out_a[y * out_a_stride], &in_a[y * in_a_stride], alphaCopyWidth);
-    }
+    downsample_420_chroma_row(&in_cb[y * in_cb_stride], &in_cb[(y + 1) * in_cb_stride],
+                              &out_cb[(y / 2) * out_cb_stride], width / 2);
+    downsample_420_chroma_row(&in_cr[y * in_cr_stride], &in_cr[(y + 1) * in_cr_stride],
+                              &out_cr[(y / 2) * out_cr_stride], width / 2);
   }
 
   return outimg;
@@ -314,14 +347,8 @@ Op_YCbCr444_to_YCbCr422_average<Pixel>::convert_colorspace(const std::shared_ptr
   int bpp_y = input->get_bits_per_pixel(heif_channel_Y);
   int bpp_cb = input->get_bits_per_pixel(heif_channel_Cb);
   int bpp_cr = input->get_bits_per_pixel(heif_channel_Cr);
-  int bpp_a = 0;
-
   bool has_alpha = input->has_channel(heif_channel_Alpha);
 
-  if (has_alpha) {
-    bpp_a = input->get_bits_per_pixel(heif_channel_Alpha);
-  }
-
   if (!hdr) {
     if (bpp_y > 8 ||
         bpp_cb > 8 ||
@@ -357,49 +384,33 @@ Op_YCbCr444_to_YCbCr422_average<Pixel>::convert_colorspace(const std::shared_ptr
   uint32_t cwidth = (width + 1) / 2;
   uint32_t cheight = height;
 
-  if (auto err = outimg->add_plane(heif_channel_Y, width, height, bpp_y, limits) ||
+  if (auto err = outimg->share_plane_from(input, heif_channel_Y, heif_channel_Y) ||
                  outimg->add_plane(heif_channel_Cb, cwidth, cheight, bpp_cb, limits) ||
                  outimg->add_plane(heif_channel_Cr, cwidth, cheight, bpp_cr, limits)) {
     return err;
   }
 
   if (has_alpha) {
-    if (auto err = outimg->add_plane(heif_channel_Alpha, width, height, bpp_a, limits)) {
+    if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
       return err;
     }
   }
 
-  const Pixel* in_y, * in_cb, * in_cr;
-  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0, in_a_stride = 0;
+  const Pixel* in_cb, * in_cr;
+  size_t in_cb_stride = 0, in_cr_stride = 0;
 
-  Pixel* out_y, * out_cb, * out_cr;
-  size_t out_y_stride = 0, out_cb_stride = 0, out_cr_stride = 0, out_a_stride = 0;
+  Pixel* out_cb, * out_cr;
+  size_t out_cb_stride = 0, out_cr_stride = 0;
 
-  in_y = (const Pixel*) input->get_plane(heif_channel_Y, &in_y_stride);
   in_cb = (const Pixel*) input->get_plane(heif_channel_Cb, &in_cb_stride);
   in_cr = (const Pixel*) input->get_plane(heif_channel_Cr, &in_cr_stride);
-  out_y = (Pixel*) outimg->get_plane(heif_channel_Y, &out_y_stride);
   out_cb = (Pixel*) outimg->get_plane(heif_channel_Cb, &out_cb_stride);
   out_cr = (Pixel*) outimg->get_plane(heif_channel_Cr, &out_cr_stride);
 
-  const uint8_t* in_a;
-  uint8_t* out_a;
-
-  if (has_alpha) {
-    in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
-    out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
-  }
-  else {
-    in_a = nullptr;
-    out_a = nullptr;
-  }
-
 
   if (hdr) {
-    in_y_stride /= 2;
     in_cb_stride /= 2;
     in_cr_stride /= 2;
-    out_y_stride /= 2;
     out_cb_stride /= 2;
     out_cr_stride /= 2;
   }
@@ -416,38 +427,101 @@ Op_YCbCr444_to_YCbCr422_average<Pixel>::convert_colorspace(const std::shared_ptr
 
   // --- averaging filter
 
-  uint32_t x, y;
+  uint32_t y;
   for (y = 0; y < height; y++) {
-    for (x = 0; x < width - 1; x += 2) {
-      Pixel cb00 = in_cb[y * in_cb_stride + x];
-      Pixel cr00 = in_cr[y * in_cr_stride + x];
-      Pixel cb01 = in_cb[y * in_cb_stride + x + 1];
-      Pixel cr01 = in_cr[y * in_cr_stride + x + 1];
-
-      out_cb[y * out_cb_stride + x / 2] = (Pixel) ((cb00 + cb01 + 1) / 2);
-      out_cr[y * out_cr_stride + x / 2] = (Pixel) ((cr00 + cr01 + 1) / 2);
-    }
+    downsample_422_chroma_row(&in_cb[y * in_cb_stride], &out_cb[y * out_cb_stride], width / 2);
+    downsample_422_chroma_row(&in_cr[y * in_cr_stride], &out_cr[y * out_cr_stride], width / 2);
   }
 
-  // TODO: check whether we can use HeifPixelImage::transfer_plane_from_image_as() instead of copying Y and Alpha
+  return outimg;
+}
 
-  for (y = 0; y < height; y++) {
-    uint32_t copyWidth = (hdr ? width * 2 : width);
+template class Op_YCbCr444_to_YCbCr422_average<uint8_t>;
+template class Op_YCbCr444_to_YCbCr422_average<uint16_t>;
 
-    memcpy(&out_y[y * out_y_stride], &in_y[y * in_y_stride], copyWidth);
 
-    if (has_alpha) {
-      uint32_t alphaCopyWidth = (bpp_a>8 ? width * 2 : width);
-      memcpy(&out_a[y * out_a_stride], &in_a[y * in_a_stride], alphaCopyWidth);
+
+template<class Pixel>
+void upsample_420_chroma_row_bilinear(const Pixel* in, size_t in_stride,
+                                      uint32_t width, uint32_t height,
+                                      uint32_t y, Pixel* out)
+{
+  /*
+   *  We assume that chroma pixels are located in the center of 2x2 luma pixels.
+   *  Upsampling weights are 3/4, 1/4. For example:
+   *    A = 3/4*3/4 * C1 + 3/4*1/4 * C2 + 1/4*3/4 * C3 + 1/4*1/4 * C4
+   *
+   *    +---+---+---+---+
+   *    | b | b | b | b |
+   *    +---C1--+---C2--+
+   *    | b | A |   | b |
+   *    +---+---+---+---+
+   *    | b |   |   | b |
+   *    +---C3--+---C4--+
+   *    | b | b | b | b |
+   *    +---+---+---+---+
+   *
+   *  The image border 'b' only interpolates along the border. The nearest chroma row/column gets the full weight.
+   *  The right and bottom border only exist when the size is even.
+   */
+
+  const uint32_t chroma_height = (height + 1) / 2;
+
+  // --- vertical weights (in 1/4) of the two chroma rows around luma row 'y'
+
+  uint32_t cy0, cy1;
+  uint32_t w0, w1;
+
+  if (y == 0) {
+    cy0 = cy1 = 0;
+    w0 = 4;
+    w1 = 0;
+  }
+  else if (y % 2 == 1) {
+    cy0 = y / 2;
+
+    if (cy0 + 1 < chroma_height) {
+      cy1 = cy0 + 1;
+      w0 = 3;
+      w1 = 1;
+    }
+    else {
+      // bottom border
+      cy1 = cy0;
+      w0 = 4;
+      w1 = 0;
     }
   }
+  else {
+    cy0 = y / 2 - 1;
+    cy1 = y / 2;
+    w0 = 1;
+    w1 = 3;
+  }
 
-  return outimg;
-}
+  const Pixel* row0 = in + cy0 * in_stride;
+  const Pixel* row1 = in + cy1 * in_stride;
 
-template class Op_YCbCr444_to_YCbCr422_average<uint8_t>;
-template class Op_YCbCr444_to_YCbCr422_average<uint16_t>;
+  auto vertical = [&](uint32_t cx) {
+    return chroma_vertical_sum(row0[cx], row1[cx], w0, w1);
+  };
+
+  // --- horizontal filtering
 
+  // left border
+  out[0] = (Pixel) ((4 * vertical(0) + 8) >> 4);
+
+  // all output pixels 2*cx+1, 2*cx+2 with 2*cx+2 < width
+  upsample_chroma_row_pairs(row0, row1, w0, w1, out + 1, (width - 1) / 2);
+
+  // right border
+  if (width % 2 == 0) {
+    out[width - 1] = (Pixel) ((4 * vertical(width / 2 - 1) + 8) >> 4);
+  }
+}
+
+template void upsample_420_chroma_row_bilinear<uint8_t>(const uint8_t*, size_t, uint32_t, uint32_t, uint32_t, uint8_t*);
+template void upsample_420_chroma_row_bilinear<uint16_t>(const uint16_t*, size_t, uint32_t, uint32_t, uint32_t, uint16_t*);
 
 
 template<class Pixel>
@@ -513,14 +587,8 @@ Op_YCbCr420_bilinear_to_YCbCr444<Pixel>::convert_colorspace(const std::shared_pt
   int bpp_y = input->get_bits_per_pixel(heif_channel_Y);
   int bpp_cb = input->get_bits_per_pixel(heif_channel_Cb);
   int bpp_cr = input->get_bits_per_pixel(heif_channel_Cr);
-  int bpp_a = 0;
-
   bool has_alpha = input->has_channel(heif_channel_Alpha);
 
-  if (has_alpha) {
-    bpp_a = input->get_bits_per_pixel(heif_channel_Alpha);
-  }
-
   if (!hdr) {
     if (bpp_y > 8 ||
         bpp_cb > 8 ||
@@ -553,174 +621,40 @@ Op_YCbCr420_bilinear_to_YCbCr444<Pixel>::convert_colorspace(const std::shared_pt
 
   outimg->create(width, height, heif_colorspace_YCbCr, heif_chroma_444);
 
-  if (auto err = outimg->add_plane(heif_channel_Y, width, height, bpp_y, limits) ||
+  if (auto err = outimg->share_plane_from(input, heif_channel_Y, heif_channel_Y) ||
                  outimg->add_plane(heif_channel_Cb, width, height, bpp_cb, limits) ||
                  outimg->add_plane(heif_channel_Cr, width, height, bpp_cr, limits)) {
     return err;
   }
 
   if (has_alpha) {
-    if (auto err = outimg->add_plane(heif_channel_Alpha, width, height, bpp_a, limits)) {
+    if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
       return err;
     }
   }
 
-  const Pixel* in_y, * in_cb, * in_cr;
-  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0, in_a_stride = 0;
+  const Pixel* in_cb, * in_cr;
+  size_t in_cb_stride = 0, in_cr_stride = 0;
 
-  Pixel* out_y, * out_cb, * out_cr;
-  size_t out_y_stride = 0, out_cb_stride = 0, out_cr_stride = 0, out_a_stride = 0;
+  Pixel* out_cb, * out_cr;
+  size_t out_cb_stride = 0, out_cr_stride = 0;
 
-  in_y = (const Pixel*) input->get_plane(heif_channel_Y, &in_y_stride);
   in_cb = (const Pixel*) input->get_plane(heif_channel_Cb, &in_cb_stride);
   in_cr = (const Pixel*) input->get_plane(heif_channel_Cr, &in_cr_stride);
-  out_y = (Pixel*) outimg->get_plane(heif_channel_Y, &out_y_stride);
   out_cb = (Pixel*) outimg->get_plane(heif_channel_Cb, &out_cb_stride);
   out_cr = (Pixel*) outimg->get_plane(heif_channel_Cr, &out_cr_stride);
 
-  const uint8_t* in_a;
-  uint8_t* out_a;
-
-  if (has_alpha) {
-    in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
-    out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
-  }
-  else {
-    in_a = nullptr;
-    out_a = nullptr;
-  }
-
 
   if (hdr) {
-    in_y_stride /= 2;
     in_cb_stride /= 2;
     in_cr_stride /= 2;
-    out_y_stride /= 2;
     out_cb_stride /= 2;
     out_cr_stride /= 2;
   }
 
-  /*
-   *  We assume that chroma pixels are located in the center of 2x2 luma pixels.
-   *  The image border 'b' is handled separately.
-   *  The right and bottom border are not processed when the size is odd.
-   *  Then, each 2x2 square between 4 chroma samples is computed in one iteration.
-   *
-   *  Upsampling weights are 3/4, 1/4. For example:
-   *    A = 3/4*3/4 * C1 + 3/4*1/4 * C2 + 1/4*3/4 * C3 + 1/4*1/4 * C4
-   *
-   *    +---+---+---+---+
-   *    | b | b | b | b |
-   *    +---C1--+---C2--+
-   *    | b | A |   | b |
-   *    +---+---+---+---+
-   *    | b |   |   | b |
-   *    +---C3--+---C4--+
-   *    | b | b | b | b |
-   *    +---+---+---+---+
-   */
-
-  // --- fill borders
-
-  // top left corner
-  out_cb[0] = in_cb[0];
-  out_cr[0] = in_cr[0];
-
-  // top border
-  for (uint32_t cx = 0; cx < (width - 1) / 2; cx++) {
-    out_cb[0 * out_cb_stride + 2 * cx + 1] = (Pixel) ((3 * in_cb[cx / 2] + 1 * in_cb[cx / 2 + 1] + 2) / 4);
-    out_cb[0 * out_cb_stride + 2 * cx + 2] = (Pixel) ((1 * in_cb[cx / 2] + 3 * in_cb[cx / 2 + 1] + 2) / 4);
-    out_cr[0 * out_cr_stride + 2 * cx + 1] = (Pixel) ((3 * in_cr[cx / 2] + 1 * in_cr[cx / 2 + 1] + 2) / 4);
-    out_cr[0 * out_cr_stride + 2 * cx + 2] = (Pixel) ((1 * in_cr[cx / 2] + 3 * in_cr[cx / 2 + 1] + 2) / 4);
-  }
-
-  // top right corner
-  if (width % 2 == 0) {
-    out_cb[width - 1] = in_cb[width / 2 - 1];
-    out_cr[width - 1] = in_cr[width / 2 - 1];
-  }
-
-  // left border
-  for (uint32_t cy = 0; cy < (height - 1) / 2; cy++) {
-    out_cb[(2 * cy + 1) * out_cb_stride + 0] = (Pixel) ((3 * in_cb[cy / 2 * in_cb_stride] + 1 * in_cb[(cy / 2 + 1) * in_cb_stride] + 2) / 4);
-    out_cb[(2 * cy + 2) * out_cb_stride + 0] = (Pixel) ((1 * in_cb[cy / 2 * in_cb_stride] + 3 * in_cb[(cy / 2 + 1) * in_cb_stride] + 2) / 4);
-    out_cr[(2 * cy + 1) * out_cr_stride + 0] = (Pixel) ((3 * in_cr[cy / 2 * in_cr_stride] + 1 * in_cr[(cy / 2 + 1) * in_cr_stride] + 2) / 4);
-    out_cr[(2 * cy + 2) * out_cr_stride + 0] = (Pixel) ((1 * in_cr[cy / 2 * in_cr_stride] + 3 * in_cr[(cy / 2 + 1) * in_cr_stride] + 2) / 4);
-  }
-
-  // bottom left corner
-  if (height % 2 == 0) {
-    out_cb[(height - 1) * out_cb_stride] = in_cb[(height / 2 - 1) * in_cb_stride];
-    out_cr[(height - 1) * out_cr_stride] = in_cr[(height / 2 - 1) * in_cr_stride];
-  }
-
-  // right border
-  if (width % 2 == 0) {
-    for (uint32_t cy = 0; cy < (height - 1) / 2; cy++) {
-      out_cb[(2 * cy + 1) * out_cb_stride + width - 1] = (Pixel) ((3 * in_cb[cy / 2 * in_cb_stride + width / 2 - 1] + 1 * in_cb[(cy / 2 + 1) * in_cb_stride + width / 2 - 1] + 2) / 4);
-      out_cb[(2 * cy + 2) * out_cb_stride + width - 1] = (Pixel) ((1 * in_cb[cy / 2 * in_cb_stride + width / 2 - 1] + 3 * in_cb[(cy / 2 + 1) * in_cb_stride + width / 2 - 1] + 2) / 4);
-      out_cr[(2 * cy + 1) * out_cr_stride + width - 1] = (Pixel) ((3 * in_cr[cy / 2 * in_cr_stride + width / 2 - 1] + 1 * in_cr[(cy / 2 + 1) * in_cr_stride + width / 2 - 1] + 2) / 4);
-      out_cr[(2 * cy + 2) * out_cr_stride + width - 1] = (Pixel) ((1 * in_cr[cy / 2 * in_cr_stride + width / 2 - 1] + 3 * in_cr[(cy / 2 + 1) * in_cr_stride + width / 2 - 1] + 2) / 4);
-    }
-  }
-
-  // bottom border
-  if (height % 2 == 0) {
-    for (uint32_t cx = 0; cx < (width - 1) / 2; cx++) {
-      out_cb[(height - 1) * out_cb_stride + 2 * cx + 1] = (Pixel) ((3 * in_cb[(height / 2 - 1) * in_cb_stride + cx / 2] + 1 * in_cb[(height / 2 - 1) * in_cb_stride + cx / 2 + 1] + 2) / 4);
-      out_cb[(height - 1) * out_cb_stride + 2 * cx + 2] = (Pixel) ((1 * in_cb[(height / 2 - 1) * in_cb_stride + cx / 2] + 3 * in_cb[(height / 2 - 1) * in_cb_stride + cx / 2 + 1] + 2) / 4);
-      out_cr[(height - 1) * out_cr_stride + 2 * cx + 1] = (Pixel) ((3 * in_cr[(height / 2 - 1) * in_cr_stride + cx / 2] + 1 * in_cr[(height / 2 - 1) * in_cr_stride + cx / 2 + 1] + 2) / 4);
-      out_cr[(height - 1) * out_cr_stride + 2 * cx + 2] = (Pixel) ((1 * in_cr[(height / 2 - 1) * in_cr_stride + cx / 2] + 3 * in_cr[(height / 2 - 1) * in_cr_stride + cx / 2 + 1] + 2) / 4);
-    }
-  }
-
-  // bottom right corner
-  if (width % 2 == 0 && height % 2 == 0) {
-    out_cb[(height - 1) * out_cb_stride + width - 1] = in_cb[(height / 2 - 1) * in_cb_stride + width / 2 - 1];
-    out_cr[(height - 1) * out_cr_stride + width - 1] = in_cr[(height / 2 - 1) * in_cr_stride + width / 2 - 1];
-  }
-
-
-  // --- bilinear filtering of inner part
-
-  uint32_t x, y;
-  for (y = 1; y < height - 1; y += 2) {
-    for (x = 1; x < width - 1; x += 2) {
-      uint32_t cx = x / 2;
-      uint32_t cy = y / 2;
-
-      Pixel cb00 = in_cb[cy * in_cb_stride + cx];
-      Pixel cr00 = in_cr[cy * in_cr_stride + cx];
-      Pixel cb01 = in_cb[cy * in_cb_stride + cx + 1];
-      Pixel cr01 = in_cr[cy * in_cr_stride + cx + 1];
-      Pixel cb10 = in_cb[(cy + 1) * in_cb_stride + cx];
-      Pixel cr10 = in_cr[(cy + 1) * in_cr_stride + cx];
-      Pixel cb11 = in_cb[(cy + 1) * in_cb_stride + cx + 1];
-      Pixel cr11 = in_cr[(cy + 1) * in_cr_stride + cx + 1];
-
-      out_cb[(y + 0) * out_cb_stride + x + 0] = (Pixel) ((cb00 * 3 * 3 + cb01 * 1 * 3 + cb10 * 3 * 1 + cb11 * 1 * 1 + 8) / 16);
-      out_cb[(y + 0) * out_cb_stride + x + 1] = (Pixel) ((cb00 * 1 * 3 + cb01 * 3 * 3 + cb10 * 1 * 1 + cb11 * 3 * 1 + 8) / 16);
-      out_cb[(y + 1) * out_cb_stride + x + 0] = (Pixel) ((cb00 * 3 * 1 + cb01 * 1 * 1 + cb10 * 3 * 3 + cb11 * 1 * 3 + 8) / 16);
-      out_cb[(y + 1) * out_cb_stride + x + 1] = (Pixel) ((cb00 * 1 * 1 + cb01 * 3 * 1 + cb10 * 1 * 3 + cb11 * 3 * 3 + 8) / 16);
-
-      out_cr[(y + 0) * out_cr_stride + x + 0] = (Pixel) ((cr00 * 3 * 3 + cr01 * 1 * 3 + cr10 * 3 * 1 + cr11 * 1 * 1 + 8) / 16);
-      out_cr[(y + 0) * out_cr_stride + x + 1] = (Pixel) ((cr00 * 1 * 3 + cr01 * 3 * 3 + cr10 * 1 * 1 + cr11 * 3 * 1 + 8) / 16);
-      out_cr[(y + 1) * out_cr_stride + x + 0] = (Pixel) ((cr00 * 3 * 1 + cr01 * 1 * 1 + cr10 * 3 * 3 + cr11 * 1 * 3 + 8) / 16);
-      out_cr[(y + 1) * out_cr_stride + x + 1] = (Pixel) ((cr00 * 1 * 1 + cr01 * 3 * 1 + cr10 * 1 * 3 + cr11 * 3 * 3 + 8) / 16);
-    }
-  }
-
-  // TODO: check whether we can use HeifPixelImage::transfer_plane_from_image_as() instead of copying Y and Alpha
-
-  for (y = 0; y < height; y++) {
-    uint32_t copyWidth = (hdr ? width * 2 : width);
-
-    memcpy(&out_y[y * out_y_stride], &in_y[y * in_y_stride], copyWidth);
-
-    if (has_alpha) {
-      uint32_t alphaCopyWidth = (bpp_a > 8 ? width * 2 : width);
-      memcpy(&out_a[y * out_a_stride], &in_a[y * in_a_stride], alphaCopyWidth);
-    }
+  for (uint32_t y = 0; y < height; y++) {
+    upsample_420_chroma_row_bilinear(in_cb, in_cb_stride, width, height, y, &out_cb[y * out_cb_stride]);
+    upsample_420_chroma_row_bilinear(in_cr, in_cr_stride, width, height, y, &out_cr[y * out_cr_stride]);
   }
 
   return outimg;
@@ -795,14 +729,8 @@ Op_YCbCr422_bilinear_to_YCbCr444<Pixel>::convert_colorspace(const std::shared_pt
   int bpp_y = input->get_bits_per_pixel(heif_channel_Y);
   int bpp_cb = input->get_bits_per_pixel(heif_channel_Cb);
   int bpp_cr = input->get_bits_per_pixel(heif_channel_Cr);
-  int bpp_a = 0;
-
   bool has_alpha = input->has_channel(heif_channel_Alpha);
 
-  if (has_alpha) {
-    bpp_a = input->get_bits_per_pixel(heif_channel_Alpha);
-  }
-
   if (!hdr) {
     if (bpp_y > 8 ||
         bpp_cb > 8 ||
@@ -835,49 +763,33 @@ Op_YCbCr422_bilinear_to_YCbCr444<Pixel>::convert_colorspace(const std::shared_pt
 
   outimg->create(width, height, heif_colorspace_YCbCr, heif_chroma_444);
 
-  if (auto err = outimg->add_plane(heif_channel_Y, width, height, bpp_y, limits) ||
+  if (auto err = outimg->share_plane_from(input, heif_channel_Y, heif_channel_Y) ||
                  outimg->add_plane(heif_channel_Cb, width, height, bpp_cb, limits) ||
                  outimg->add_plane(heif_channel_Cr, width, height, bpp_cr, limits)) {
     return err;
   }
 
   if (has_alpha) {
-    if (auto err = outimg->add_plane(heif_channel_Alpha, width, height, bpp_a, limits)) {
+    if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
       return err;
     }
   }
 
-  const Pixel* in_y, * in_cb, * in_cr;
-  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0, in_a_stride = 0;
+  const Pixel* in_cb, * in_cr;
+  size_t in_cb_stride = 0, in_cr_stride = 0;
 
-  Pixel* out_y, * out_cb, * out_cr;
-  size_t out_y_stride = 0, out_cb_stride = 0, out_cr_stride = 0, out_a_stride = 0;
+  Pixel* out_cb, * out_cr;
+  size_t out_cb_stride = 0, out_cr_stride = 0;
 
-  in_y = (const Pixel*) input->get_plane(heif_channel_Y, &in_y_stride);
   in_cb = (const Pixel*) input->get_plane(heif_channel_Cb, &in_cb_stride);
   in_cr = (const Pixel*) input->get_plane(heif_channel_Cr, &in_cr_stride);
-  out_y = (Pixel*) outimg->get_plane(heif_channel_Y, &out_y_stride);
   out_cb = (Pixel*) outimg->get_plane(heif_channel_Cb, &out_cb_stride);
   out_cr = (Pixel*) outimg->get_plane(heif_channel_Cr, &out_cr_stride);
 
-  const uint8_t* in_a;
-  uint8_t* out_a;
-
-  if (has_alpha) {
-    in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
-    out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
-  }
-  else {
-    in_a = nullptr;
-    out_a = nullptr;
-  }
-
 
   if (hdr) {
-    in_y_stride /= 2;
     in_cb_stride /= 2;
     in_cr_stride /= 2;
-    out_y_stride /= 2;
     out_cb_stride /= 2;
     out_cr_stride /= 2;
   }
@@ -920,35 +832,15 @@ Op_YCbCr422_bilinear_to_YCbCr444<Pixel>::convert_colorspace(const std::shared_pt
 
   // --- bilinear filtering of inner part
 
-  uint32_t x, y;
-  for (y = 0; y < height; y++) {
-    for (x = 1; x < width - 1; x += 2) {
-      int cx = x / 2;
-
-      Pixel cb00 = in_cb[y * in_cb_stride + cx];
-      Pixel cr00 = in_cr[y * in_cr_stride + cx];
-      Pixel cb01 = in_cb[y * in_cb_stride + cx + 1];
-      Pixel cr01 = in_cr[y * in_cr_stride + cx + 1];
-
-      out_cb[y * out_cb_stride + x + 0] = (Pixel) ((cb00 * 3 + cb01 * 1 + 2) / 4);
-      out_cb[y * out_cb_stride + x + 1] = (Pixel) ((cb00 * 1 + cb01 * 3 + 2) / 4);
-
-      out_cr[y * out_cr_stride + x + 0] = (Pixel) ((cr00 * 3 + cr01 * 1 + 2) / 4);
-      out_cr[y * out_cr_stride + x + 1] = (Pixel) ((cr00 * 1 + cr01 * 3 + 2) / 4);
-    }
-  }
-
-  // TODO: check whether we can use HeifPixelImage::transfer_plane_from_image_as() instead of copying Y and Alpha
+  // The 4:2:0 filter with the full vertical weight on a single row computes (3*X + Y + 2) / 4 for 'A'.
 
+  uint32_t y;
   for (y = 0; y < height; y++) {
-    uint32_t copyWidth = (hdr ? width * 2 : width);
-
-    memcpy(&out_y[y * out_y_stride], &in_y[y * in_y_stride], copyWidth);
+    const Pixel* row_cb = &in_cb[y * in_cb_stride];
+    const Pixel* row_cr = &in_cr[y * in_cr_stride];
 
-    if (has_alpha) {
-      uint32_t alphaCopyWidth = (bpp_a > 8 ? width * 2 : width);
-      memcpy(&out_a[y * out_a_stride], &in_a[y * in_a_stride], alphaCopyWidth);
-    }
+    upsample_chroma_row_pairs(row_cb, row_cb, 4, 0, &out_cb[y * out_cb_stride + 1], (width - 1) / 2);
+    upsample_chroma_row_pairs(row_cr, row_cr, 4, 0, &out_cr[y * out_cr_stride + 1], (width - 1) / 2);
   }
 
   return outimg;
@@ -70,6 +70,13 @@ public:
 
 // --- upsampling ---
 
+// Computes row 'y' of a 4:2:0 chroma plane that is bilinearly upsampled to the luma size 'width' x 'height'.
+// 'in_stride' is given in Pixels. The result is written to 'out', which must have space for 'width' Pixels.
+template <class Pixel>
+void upsample_420_chroma_row_bilinear(const Pixel* in, size_t in_stride,
+                                      uint32_t width, uint32_t height,
+                                      uint32_t y, Pixel* out);
+
 template <class Pixel>
 class Op_YCbCr420_bilinear_to_YCbCr444 : public ColorConversionOperation
 {
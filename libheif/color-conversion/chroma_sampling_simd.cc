@@ -0,0 +1,531 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chroma_sampling_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+// chroma_vertical_sum() for eight 8-bit samples as int16.
+HEIF_TARGET_SSE41
+static inline __m128i vertical_sum_8_samples_sse41(const uint8_t* row0, const uint8_t* row1, __m128i w0, __m128i w1)
+{
+  __m128i c0 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) row0));
+  __m128i c1 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) row1));
+  return _mm_add_epi16(_mm_mullo_epi16(c0, w0), _mm_mullo_epi16(c1, w1));
+}
+
+
+// chroma_upsample_sample() for int16. The maximum intermediate value is 16*1020+8.
+HEIF_TARGET_SSE41
+static inline __m128i upsample_epi16_sse41(__m128i v_near, __m128i v_far)
+{
+  __m128i t = _mm_add_epi16(_mm_add_epi16(v_near, _mm_slli_epi16(v_near, 1)), v_far);
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_set1_epi16(8)), 4);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t upsample_chroma8_row_sse41(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                    uint8_t* out, uint32_t num_samples)
+{
+  const __m128i weight0 = _mm_set1_epi16((short) w0);
+  const __m128i weight1 = _mm_set1_epi16((short) w1);
+
+  uint32_t cx = 0;
+  for (; cx + 8 <= num_samples; cx += 8) {
+    __m128i v0 = vertical_sum_8_samples_sse41(row0 + cx, row1 + cx, weight0, weight1);
+    __m128i v1 = vertical_sum_8_samples_sse41(row0 + cx + 1, row1 + cx + 1, weight0, weight1);
+
+    __m128i even = upsample_epi16_sse41(v0, v1);
+    __m128i odd = upsample_epi16_sse41(v1, v0);
+
+    _mm_storeu_si128((__m128i*) (out + 2 * cx),
+                     _mm_packus_epi16(_mm_unpacklo_epi16(even, odd), _mm_unpackhi_epi16(even, odd)));
+  }
+
+  return cx;
+}
+
+
+// chroma_vertical_sum() for four 16-bit samples as int32.
+HEIF_TARGET_SSE41
+static inline __m128i vertical_sum_4_samples_sse41(const uint16_t* row0, const uint16_t* row1, __m128i w0, __m128i w1)
+{
+  __m128i c0 = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*) row0));
+  __m128i c1 = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*) row1));
+  return _mm_add_epi32(_mm_mullo_epi32(c0, w0), _mm_mullo_epi32(c1, w1));
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i upsample_epi32_sse41(__m128i v_near, __m128i v_far)
+{
+  __m128i t = _mm_add_epi32(_mm_add_epi32(v_near, _mm_slli_epi32(v_near, 1)), v_far);
+  return _mm_srli_epi32(_mm_add_epi32(t, _mm_set1_epi32(8)), 4);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t upsample_chroma16_row_sse41(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                     uint16_t* out, uint32_t num_samples)
+{
+  const __m128i weight0 = _mm_set1_epi32((int) w0);
+  const __m128i weight1 = _mm_set1_epi32((int) w1);
+
+  uint32_t cx = 0;
+  for (; cx + 4 <= num_samples; cx += 4) {
+    __m128i v0 = vertical_sum_4_samples_sse41(row0 + cx, row1 + cx, weight0, weight1);
+    __m128i v1 = vertical_sum_4_samples_sse41(row0 + cx + 1, row1 + cx + 1, weight0, weight1);
+
+    __m128i even = upsample_epi32_sse41(v0, v1);
+    __m128i odd = upsample_epi32_sse41(v1, v0);
+
+    _mm_storeu_si128((__m128i*) (out + 2 * cx),
+                     _mm_packus_epi32(_mm_unpacklo_epi32(even, odd), _mm_unpackhi_epi32(even, odd)));
+  }
+
+  return cx;
+}
+
+
+// Sums of horizontal pairs of 16 8-bit samples as int16.
+HEIF_TARGET_SSE41
+static inline __m128i pair_sums_8bit_sse41(const uint8_t* in)
+{
+  return _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) in), _mm_set1_epi8(1));
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t downsample_chroma420_8_row_sse41(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t num_samples)
+{
+  const __m128i round = _mm_set1_epi16(2);
+
+  uint32_t x = 0;
+  for (; x + 16 <= num_samples; x += 16) {
+    __m128i lo = _mm_add_epi16(pair_sums_8bit_sse41(row0 + 2 * x), pair_sums_8bit_sse41(row1 + 2 * x));
+    __m128i hi = _mm_add_epi16(pair_sums_8bit_sse41(row0 + 2 * x + 16), pair_sums_8bit_sse41(row1 + 2 * x + 16));
+
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 2);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t downsample_chroma422_8_row_sse41(const uint8_t* row, uint8_t* out, uint32_t num_samples)
+{
+  const __m128i round = _mm_set1_epi16(1);
+
+  uint32_t x = 0;
+  for (; x + 16 <= num_samples; x += 16) {
+    __m128i lo = _mm_srli_epi16(_mm_add_epi16(pair_sums_8bit_sse41(row + 2 * x), round), 1);
+    __m128i hi = _mm_srli_epi16(_mm_add_epi16(pair_sums_8bit_sse41(row + 2 * x + 16), round), 1);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+// Sums of horizontal pairs of eight 16-bit samples as int32.
+HEIF_TARGET_SSE41
+static inline __m128i pair_sums_16bit_sse41(const uint16_t* in)
+{
+  __m128i v = _mm_loadu_si128((const __m128i*) in);
+  return _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(v, 16));
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t downsample_chroma420_16_row_sse41(const uint16_t* row0, const uint16_t* row1, uint16_t* out, uint32_t num_samples)
+{
+  const __m128i round = _mm_set1_epi32(2);
+
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    __m128i lo = _mm_add_epi32(pair_sums_16bit_sse41(row0 + 2 * x), pair_sums_16bit_sse41(row1 + 2 * x));
+    __m128i hi = _mm_add_epi32(pair_sums_16bit_sse41(row0 + 2 * x + 8), pair_sums_16bit_sse41(row1 + 2 * x + 8));
+
+    lo = _mm_srli_epi32(_mm_add_epi32(lo, round), 2);
+    hi = _mm_srli_epi32(_mm_add_epi32(hi, round), 2);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t downsample_chroma422_16_row_sse41(const uint16_t* row, uint16_t* out, uint32_t num_samples)
+{
+  const __m128i round = _mm_set1_epi32(1);
+
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    __m128i lo = _mm_srli_epi32(_mm_add_epi32(pair_sums_16bit_sse41(row + 2 * x), round), 1);
+    __m128i hi = _mm_srli_epi32(_mm_add_epi32(pair_sums_16bit_sse41(row + 2 * x + 8), round), 1);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+//
+// Unpack and pack work within 128-bit lanes. Interleaving with unpacklo/unpackhi followed by a pack restores
+// the element order. After packing two separate vectors, the 64-bit blocks have to be reordered.
+
+HEIF_TARGET_AVX2
+static inline __m256i vertical_sum_16_samples_avx2(const uint8_t* row0, const uint8_t* row1, __m256i w0, __m256i w1)
+{
+  __m256i c0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) row0));
+  __m256i c1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) row1));
+  return _mm256_add_epi16(_mm256_mullo_epi16(c0, w0), _mm256_mullo_epi16(c1, w1));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i upsample_epi16_avx2(__m256i v_near, __m256i v_far)
+{
+  __m256i t = _mm256_add_epi16(_mm256_add_epi16(v_near, _mm256_slli_epi16(v_near, 1)), v_far);
+  return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_set1_epi16(8)), 4);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t upsample_chroma8_row_avx2(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                   uint8_t* out, uint32_t num_samples)
+{
+  const __m256i weight0 = _mm256_set1_epi16((short) w0);
+  const __m256i weight1 = _mm256_set1_epi16((short) w1);
+
+  uint32_t cx = 0;
+  for (; cx + 16 <= num_samples; cx += 16) {
+    __m256i v0 = vertical_sum_16_samples_avx2(row0 + cx, row1 + cx, weight0, weight1);
+    __m256i v1 = vertical_sum_16_samples_avx2(row0 + cx + 1, row1 + cx + 1, weight0, weight1);
+
+    __m256i even = upsample_epi16_avx2(v0, v1);
+    __m256i odd = upsample_epi16_avx2(v1, v0);
+
+    _mm256_storeu_si256((__m256i*) (out + 2 * cx),
+                        _mm256_packus_epi16(_mm256_unpacklo_epi16(even, odd), _mm256_unpackhi_epi16(even, odd)));
+  }
+
+  cx += upsample_chroma8_row_sse41(row0 + cx, row1 + cx, w0, w1, out + 2 * cx, num_samples - cx);
+
+  return cx;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i vertical_sum_8_samples_avx2(const uint16_t* row0, const uint16_t* row1, __m256i w0, __m256i w1)
+{
+  __m256i c0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) row0));
+  __m256i c1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) row1));
+  return _mm256_add_epi32(_mm256_mullo_epi32(c0, w0), _mm256_mullo_epi32(c1, w1));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i upsample_epi32_avx2(__m256i v_near, __m256i v_far)
+{
+  __m256i t = _mm256_add_epi32(_mm256_add_epi32(v_near, _mm256_slli_epi32(v_near, 1)), v_far);
+  return _mm256_srli_epi32(_mm256_add_epi32(t, _mm256_set1_epi32(8)), 4);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t upsample_chroma16_row_avx2(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                    uint16_t* out, uint32_t num_samples)
+{
+  const __m256i weight0 = _mm256_set1_epi32((int) w0);
+  const __m256i weight1 = _mm256_set1_epi32((int) w1);
+
+  uint32_t cx = 0;
+  for (; cx + 8 <= num_samples; cx += 8) {
+    __m256i v0 = vertical_sum_8_samples_avx2(row0 + cx, row1 + cx, weight0, weight1);
+    __m256i v1 = vertical_sum_8_samples_avx2(row0 + cx + 1, row1 + cx + 1, weight0, weight1);
+
+    __m256i even = upsample_epi32_avx2(v0, v1);
+    __m256i odd = upsample_epi32_avx2(v1, v0);
+
+    _mm256_storeu_si256((__m256i*) (out + 2 * cx),
+                        _mm256_packus_epi32(_mm256_unpacklo_epi32(even, odd), _mm256_unpackhi_epi32(even, odd)));
+  }
+
+  cx += upsample_chroma16_row_sse41(row0 + cx, row1 + cx, w0, w1, out + 2 * cx, num_samples - cx);
+
+  return cx;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i pair_sums_8bit_avx2(const uint8_t* in)
+{
+  return _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) in), _mm256_set1_epi8(1));
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t downsample_chroma420_8_row_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t num_samples)
+{
+  const __m256i round = _mm256_set1_epi16(2);
+
+  uint32_t x = 0;
+  for (; x + 32 <= num_samples; x += 32) {
+    __m256i lo = _mm256_add_epi16(pair_sums_8bit_avx2(row0 + 2 * x), pair_sums_8bit_avx2(row1 + 2 * x));
+    __m256i hi = _mm256_add_epi16(pair_sums_8bit_avx2(row0 + 2 * x + 32), pair_sums_8bit_avx2(row1 + 2 * x + 32));
+
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round), 2);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round), 2);
+
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+  }
+
+  x += downsample_chroma420_8_row_sse41(row0 + 2 * x, row1 + 2 * x, out + x, num_samples - x);
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t downsample_chroma422_8_row_avx2(const uint8_t* row, uint8_t* out, uint32_t num_samples)
+{
+  const __m256i round = _mm256_set1_epi16(1);
+
+  uint32_t x = 0;
+  for (; x + 32 <= num_samples; x += 32) {
+    __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(pair_sums_8bit_avx2(row + 2 * x), round), 1);
+    __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(pair_sums_8bit_avx2(row + 2 * x + 32), round), 1);
+
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+  }
+
+  x += downsample_chroma422_8_row_sse41(row + 2 * x, out + x, num_samples - x);
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i pair_sums_16bit_avx2(const uint16_t* in)
+{
+  __m256i v = _mm256_loadu_si256((const __m256i*) in);
+  return _mm256_add_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(v, 16));
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t downsample_chroma420_16_row_avx2(const uint16_t* row0, const uint16_t* row1, uint16_t* out, uint32_t num_samples)
+{
+  const __m256i round = _mm256_set1_epi32(2);
+
+  uint32_t x = 0;
+  for (; x + 16 <= num_samples; x += 16) {
+    __m256i lo = _mm256_add_epi32(pair_sums_16bit_avx2(row0 + 2 * x), pair_sums_16bit_avx2(row1 + 2 * x));
+    __m256i hi = _mm256_add_epi32(pair_sums_16bit_avx2(row0 + 2 * x + 16), pair_sums_16bit_avx2(row1 + 2 * x + 16));
+
+    lo = _mm256_srli_epi32(_mm256_add_epi32(lo, round), 2);
+    hi = _mm256_srli_epi32(_mm256_add_epi32(hi, round), 2);
+
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8));
+  }
+
+  x += downsample_chroma420_16_row_sse41(row0 + 2 * x, row1 + 2 * x, out + x, num_samples - x);
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t downsample_chroma422_16_row_avx2(const uint16_t* row, uint16_t* out, uint32_t num_samples)
+{
+  const __m256i round = _mm256_set1_epi32(1);
+
+  uint32_t x = 0;
+  for (; x + 16 <= num_samples; x += 16) {
+    __m256i lo = _mm256_srli_epi32(_mm256_add_epi32(pair_sums_16bit_avx2(row + 2 * x), round), 1);
+    __m256i hi = _mm256_srli_epi32(_mm256_add_epi32(pair_sums_16bit_avx2(row + 2 * x + 16), round), 1);
+
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8));
+  }
+
+  x += downsample_chroma422_16_row_sse41(row + 2 * x, out + x, num_samples - x);
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+uint32_t upsample_chroma8_row_neon(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                   uint8_t* out, uint32_t num_samples)
+{
+  const uint8x8_t weight0 = vdup_n_u8((uint8_t) w0);
+  const uint8x8_t weight1 = vdup_n_u8((uint8_t) w1);
+
+  uint32_t cx = 0;
+  for (; cx + 8 <= num_samples; cx += 8) {
+    uint16x8_t v0 = vmlal_u8(vmull_u8(vld1_u8(row0 + cx), weight0), vld1_u8(row1 + cx), weight1);
+    uint16x8_t v1 = vmlal_u8(vmull_u8(vld1_u8(row0 + cx + 1), weight0), vld1_u8(row1 + cx + 1), weight1);
+
+    // the rounding shift computes (t + 8) >> 4
+    uint8x8x2_t pixels;
+    pixels.val[0] = vmovn_u16(vrshrq_n_u16(vmlaq_n_u16(v1, v0, 3), 4));
+    pixels.val[1] = vmovn_u16(vrshrq_n_u16(vmlaq_n_u16(v0, v1, 3), 4));
+    vst2_u8(out + 2 * cx, pixels);
+  }
+
+  return cx;
+}
+
+
+uint32_t upsample_chroma16_row_neon(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                    uint16_t* out, uint32_t num_samples)
+{
+  uint32_t cx = 0;
+  for (; cx + 4 <= num_samples; cx += 4) {
+    uint32x4_t v0 = vmlal_n_u16(vmull_n_u16(vld1_u16(row0 + cx), (uint16_t) w0), vld1_u16(row1 + cx), (uint16_t) w1);
+    uint32x4_t v1 = vmlal_n_u16(vmull_n_u16(vld1_u16(row0 + cx + 1), (uint16_t) w0), vld1_u16(row1 + cx + 1), (uint16_t) w1);
+
+    uint16x4x2_t pixels;
+    pixels.val[0] = vmovn_u32(vrshrq_n_u32(vmlaq_n_u32(v1, v0, 3), 4));
+    pixels.val[1] = vmovn_u32(vrshrq_n_u32(vmlaq_n_u32(v0, v1, 3), 4));
+    vst2_u16(out + 2 * cx, pixels);
+  }
+
+  return cx;
+}
+
+
+// The pairwise additions and the rounding shifts compute chroma_average_2x2() and chroma_average_2x1() exactly.
+
+uint32_t downsample_chroma420_8_row_neon(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t num_samples)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    uint16x8_t sum = vpadalq_u8(vpaddlq_u8(vld1q_u8(row0 + 2 * x)), vld1q_u8(row1 + 2 * x));
+    vst1_u8(out + x, vrshrn_n_u16(sum, 2));
+  }
+
+  return x;
+}
+
+
+uint32_t downsample_chroma422_8_row_neon(const uint8_t* row, uint8_t* out, uint32_t num_samples)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    vst1_u8(out + x, vrshrn_n_u16(vpaddlq_u8(vld1q_u8(row + 2 * x)), 1));
+  }
+
+  return x;
+}
+
+
+uint32_t downsample_chroma420_16_row_neon(const uint16_t* row0, const uint16_t* row1, uint16_t* out, uint32_t num_samples)
+{
+  uint32_t x = 0;
+  for (; x + 4 <= num_samples; x += 4) {
+    uint32x4_t sum = vpadalq_u16(vpaddlq_u16(vld1q_u16(row0 + 2 * x)), vld1q_u16(row1 + 2 * x));
+    vst1_u16(out + x, vrshrn_n_u32(sum, 2));
+  }
+
+  return x;
+}
+
+
+uint32_t downsample_chroma422_16_row_neon(const uint16_t* row, uint16_t* out, uint32_t num_samples)
+{
+  uint32_t x = 0;
+  for (; x + 4 <= num_samples; x += 4) {
+    vst1_u16(out + x, vrshrn_n_u32(vpaddlq_u16(vld1q_u16(row + 2 * x)), 1));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Chroma_sampling_row_kernels select_chroma_sampling_row_kernels()
+{
+  Chroma_sampling_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.upsample8 = upsample_chroma8_row_avx2;
+    kernels.upsample16 = upsample_chroma16_row_avx2;
+    kernels.downsample420_8 = downsample_chroma420_8_row_avx2;
+    kernels.downsample420_16 = downsample_chroma420_16_row_avx2;
+    kernels.downsample422_8 = downsample_chroma422_8_row_avx2;
+    kernels.downsample422_16 = downsample_chroma422_16_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.upsample8 = upsample_chroma8_row_sse41;
+    kernels.upsample16 = upsample_chroma16_row_sse41;
+    kernels.downsample420_8 = downsample_chroma420_8_row_sse41;
+    kernels.downsample420_16 = downsample_chroma420_16_row_sse41;
+    kernels.downsample422_8 = downsample_chroma422_8_row_sse41;
+    kernels.downsample422_16 = downsample_chroma422_16_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.upsample8 = upsample_chroma8_row_neon;
+    kernels.upsample16 = upsample_chroma16_row_neon;
+    kernels.downsample420_8 = downsample_chroma420_8_row_neon;
+    kernels.downsample420_16 = downsample_chroma420_16_row_neon;
+    kernels.downsample422_8 = downsample_chroma422_8_row_neon;
+    kernels.downsample422_16 = downsample_chroma422_16_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const Chroma_sampling_row_kernels& get_chroma_sampling_row_kernels()
+{
+  static const Chroma_sampling_row_kernels kernels = select_chroma_sampling_row_kernels();
+  return kernels;
+}
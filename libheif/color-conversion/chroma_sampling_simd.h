@@ -0,0 +1,145 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_CHROMA_SAMPLING_SIMD_H
+#define LIBHEIF_COLORCONVERSION_CHROMA_SAMPLING_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// --- Per-sample chroma filters.
+//
+// The scalar code in chroma_sampling.cc and the SIMD row kernels below compute exactly these expressions.
+
+// Weighted sum (in 1/4) of two vertically neighboring chroma samples. The weights add up to 4.
+inline uint32_t chroma_vertical_sum(uint32_t c0, uint32_t c1, uint32_t w0, uint32_t w1)
+{
+  return w0 * c0 + w1 * c1;
+}
+
+// Bilinear interpolation between two vertical sums at 1/4 of the distance from 'v_near'.
+// This is also the 4:2:2 upsampling filter (3*a + b + 2) / 4 when both sums have the weight 4.
+inline uint32_t chroma_upsample_sample(uint32_t v_near, uint32_t v_far)
+{
+  return (3 * v_near + v_far + 8) >> 4;
+}
+
+inline uint32_t chroma_average_2x2(uint32_t c00, uint32_t c01, uint32_t c10, uint32_t c11)
+{
+  return (c00 + c01 + c10 + c11 + 2) / 4;
+}
+
+inline uint32_t chroma_average_2x1(uint32_t c0, uint32_t c1)
+{
+  return (c0 + c1 + 1) / 2;
+}
+
+
+// --- Row kernels (see cpu_features.h).
+//
+// They return the number of processed chroma input (upsampling) or output (downsampling) samples.
+
+// Upsamples the chroma row pair 'row0', 'row1' with the vertical weights 'w0', 'w1' (adding up to 4) horizontally
+// by 2. For each 'cx' < 'num_samples', the samples at 'cx' and 'cx+1' are interpolated into out[2*cx] and out[2*cx+1].
+// Hence, the input rows are read up to index 'num_samples'.
+typedef uint32_t (*Upsample_chroma8_row_kernel)(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                                uint8_t* out, uint32_t num_samples);
+
+typedef uint32_t (*Upsample_chroma16_row_kernel)(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                                 uint16_t* out, uint32_t num_samples);
+
+// Averages 2x2 blocks of 'row0' and 'row1' into 'num_samples' output samples.
+typedef uint32_t (*Downsample_chroma420_8_row_kernel)(const uint8_t* row0, const uint8_t* row1, uint8_t* out,
+                                                      uint32_t num_samples);
+
+typedef uint32_t (*Downsample_chroma420_16_row_kernel)(const uint16_t* row0, const uint16_t* row1, uint16_t* out,
+                                                       uint32_t num_samples);
+
+// Averages horizontal pairs of 'row' into 'num_samples' output samples.
+typedef uint32_t (*Downsample_chroma422_8_row_kernel)(const uint8_t* row, uint8_t* out, uint32_t num_samples);
+
+typedef uint32_t (*Downsample_chroma422_16_row_kernel)(const uint16_t* row, uint16_t* out, uint32_t num_samples);
+
+
+struct Chroma_sampling_row_kernels
+{
+  Upsample_chroma8_row_kernel upsample8 = nullptr;
+  Upsample_chroma16_row_kernel upsample16 = nullptr;
+  Downsample_chroma420_8_row_kernel downsample420_8 = nullptr;
+  Downsample_chroma420_16_row_kernel downsample420_16 = nullptr;
+  Downsample_chroma422_8_row_kernel downsample422_8 = nullptr;
+  Downsample_chroma422_16_row_kernel downsample422_16 = nullptr;
+};
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t upsample_chroma8_row_sse41(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                    uint8_t* out, uint32_t num_samples);
+
+uint32_t upsample_chroma16_row_sse41(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                     uint16_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma420_8_row_sse41(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma420_16_row_sse41(const uint16_t* row0, const uint16_t* row1, uint16_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma422_8_row_sse41(const uint8_t* row, uint8_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma422_16_row_sse41(const uint16_t* row, uint16_t* out, uint32_t num_samples);
+
+uint32_t upsample_chroma8_row_avx2(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                   uint8_t* out, uint32_t num_samples);
+
+uint32_t upsample_chroma16_row_avx2(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                    uint16_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma420_8_row_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma420_16_row_avx2(const uint16_t* row0, const uint16_t* row1, uint16_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma422_8_row_avx2(const uint8_t* row, uint8_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma422_16_row_avx2(const uint16_t* row, uint16_t* out, uint32_t num_samples);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t upsample_chroma8_row_neon(const uint8_t* row0, const uint8_t* row1, uint32_t w0, uint32_t w1,
+                                   uint8_t* out, uint32_t num_samples);
+
+uint32_t upsample_chroma16_row_neon(const uint16_t* row0, const uint16_t* row1, uint32_t w0, uint32_t w1,
+                                    uint16_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma420_8_row_neon(const uint8_t* row0, const uint8_t* row1, uint8_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma420_16_row_neon(const uint16_t* row0, const uint16_t* row1, uint16_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma422_8_row_neon(const uint8_t* row, uint8_t* out, uint32_t num_samples);
+
+uint32_t downsample_chroma422_16_row_neon(const uint16_t* row, uint16_t* out, uint32_t num_samples);
+
+#endif
+
+
+const Chroma_sampling_row_kernels& get_chroma_sampling_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_CHROMA_SAMPLING_SIMD_H
@@ -39,10 +39,15 @@
 #include "alpha.h"
 #include "hdr_sdr.h"
 #include "chroma_sampling.h"
+#include "float_conversion.h"
+#include "icc_transform.h"
 
 #if ENABLE_MULTITHREADING_SUPPORT
 
+#include <atomic>
 #include <mutex>
+#include "thread_pool.h"
+#include "tracing.h"
 
 #endif
 
@@ -148,7 +153,9 @@ bool ColorState::operator==(const ColorState& b) const
   bool mainParamsMatch = (colorspace == b.colorspace &&
                           chroma == b.chroma &&
                           has_alpha == b.has_alpha &&
-                          bits_per_pixel == b.bits_per_pixel);
+                          (!has_alpha || premultiplied_alpha == b.premultiplied_alpha) &&
+                          bits_per_pixel == b.bits_per_pixel &&
+                          datatype == b.datatype);
 
   if (!mainParamsMatch) {
     return false;
@@ -194,7 +201,8 @@ std::ostream& operator<<(std::ostream& ostr, const ColorState& state)
 {
   ostr << "colorspace=" << state.colorspace << " chroma=" << state.chroma
            << " bpp(R)=" << state.bits_per_pixel
-              << " alpha=" << (state.has_alpha ? "yes" : "no");
+              << (state.datatype == heif_channel_datatype_floating_point ? " float" : "")
+              << " alpha=" << (state.has_alpha ? (state.premultiplied_alpha ? "premultiplied" : "yes") : "no");
 
   if (state.colorspace == heif_colorspace_YCbCr) {
     ostr << " matrix-coefficients=" << state.nclx_profile.get_matrix_coefficients()
@@ -208,6 +216,15 @@ std::ostream& operator<<(std::ostream& ostr, const ColorState& state)
 
 std::vector<std::shared_ptr<ColorConversionOperation>> ColorConversionPipeline::m_operation_pool;
 
+std::map<ColorConversionPipeline::PipelineCacheKey, ColorConversionPipeline::CachedPipeline> ColorConversionPipeline::m_pipeline_cache;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+static std::mutex pipeline_cache_mutex;
+#endif
+
+// The number of different conversions in a process is usually small. This limit only protects against unbounded growth.
+static const size_t MAX_PIPELINE_CACHE_SIZE = 1024;
+
 void ColorConversionPipeline::init_ops()
 {
 #if ENABLE_MULTITHREADING_SUPPORT
@@ -230,6 +247,7 @@ void ColorConversionPipeline::init_ops()
   ops.emplace_back(std::make_shared<Op_RGB_to_RRGGBBaa_BE>());
   ops.emplace_back(std::make_shared<Op_mono_to_YCbCr420>());
   ops.emplace_back(std::make_shared<Op_mono_to_RGB24_32>());
+  ops.emplace_back(std::make_shared<Op_mono_to_RGB>());
   ops.emplace_back(std::make_shared<Op_RRGGBBaa_swap_endianness>());
   ops.emplace_back(std::make_shared<Op_RRGGBBaa_BE_to_RGB_HDR>());
   ops.emplace_back(std::make_shared<Op_RGB24_32_to_YCbCr>());
@@ -240,10 +258,16 @@ void ColorConversionPipeline::init_ops()
   ops.emplace_back(std::make_shared<Op_drop_alpha_plane>());
   ops.emplace_back(std::make_shared<Op_flatten_alpha_plane<uint8_t>>());
   ops.emplace_back(std::make_shared<Op_flatten_alpha_plane<uint16_t>>());
+  ops.emplace_back(std::make_shared<Op_alpha_premultiplication<uint8_t, true>>());
+  ops.emplace_back(std::make_shared<Op_alpha_premultiplication<uint16_t, true>>());
+  ops.emplace_back(std::make_shared<Op_alpha_premultiplication<uint8_t, false>>());
+  ops.emplace_back(std::make_shared<Op_alpha_premultiplication<uint16_t, false>>());
   ops.emplace_back(std::make_shared<Op_to_hdr_planes>());
   ops.emplace_back(std::make_shared<Op_to_sdr_planes>());
   ops.emplace_back(std::make_shared<Op_YCbCr420_bilinear_to_YCbCr444<uint8_t>>());
   ops.emplace_back(std::make_shared<Op_YCbCr420_bilinear_to_YCbCr444<uint16_t>>());
+  ops.emplace_back(std::make_shared<Op_YCbCr420_bilinear_to_interleaved_RGB<uint8_t>>());
+  ops.emplace_back(std::make_shared<Op_YCbCr420_bilinear_to_interleaved_RGB<uint16_t>>());
   ops.emplace_back(std::make_shared<Op_YCbCr422_bilinear_to_YCbCr444<uint8_t>>());
   ops.emplace_back(std::make_shared<Op_YCbCr422_bilinear_to_YCbCr444<uint16_t>>());
   ops.emplace_back(std::make_shared<Op_YCbCr444_to_YCbCr420_average<uint8_t>>());
@@ -251,15 +275,46 @@ void ColorConversionPipeline::init_ops()
   ops.emplace_back(std::make_shared<Op_YCbCr444_to_YCbCr422_average<uint8_t>>());
   ops.emplace_back(std::make_shared<Op_YCbCr444_to_YCbCr422_average<uint16_t>>());
   ops.emplace_back(std::make_shared<Op_Any_RGB_to_YCbCr_420_Sharp>());
+  ops.emplace_back(std::make_shared<Op_float_to_uint>());
+  ops.emplace_back(std::make_shared<Op_uint_to_float>());
+  ops.emplace_back(std::make_shared<Op_float_precision>());
 }
 
 
 void ColorConversionPipeline::release_ops()
 {
+  // the cached pipelines reference the ops
+  clear_pipeline_cache();
+
   m_operation_pool.clear();
 }
 
 
+void ColorConversionPipeline::clear_pipeline_cache()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(pipeline_cache_mutex);
+#endif
+
+  m_pipeline_cache.clear();
+}
+
+
+ColorConversionPipeline::ColorStateKey ColorConversionPipeline::make_color_state_key(const ColorState& state)
+{
+  return {state.colorspace,
+          state.chroma,
+          state.has_alpha,
+          state.has_alpha && state.premultiplied_alpha,
+          state.bits_per_pixel,
+          state.datatype,
+          state.nclx_profile.get_colour_primaries(),
+          state.nclx_profile.get_transfer_characteristics(),
+          state.nclx_profile.get_matrix_coefficients(),
+          state.nclx_profile.get_full_range_flag()};
+}
+
+
 bool ColorConversionPipeline::construct_pipeline(const ColorState& input_state,
                                                  const ColorState& target_state,
                                                  const heif_color_conversion_options& options,
@@ -274,6 +329,50 @@ bool ColorConversionPipeline::construct_pipeline(const ColorState& input_state,
     return true;
   }
 
+  PipelineCacheKey key{make_color_state_key(input_state),
+                       make_color_state_key(target_state),
+                       options.preferred_chroma_downsampling_algorithm,
+                       options.preferred_chroma_upsampling_algorithm,
+                       options.only_use_preferred_chroma_algorithm != 0,
+                       options_ext.alpha_composition_mode};
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(pipeline_cache_mutex);
+#endif
+
+    auto iter = m_pipeline_cache.find(key);
+    if (iter != m_pipeline_cache.end()) {
+      m_conversion_steps = iter->second.steps;
+      return iter->second.success;
+    }
+  }
+
+  bool success = search_pipeline(input_state, target_state, options, options_ext);
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(pipeline_cache_mutex);
+#endif
+
+    if (m_pipeline_cache.size() >= MAX_PIPELINE_CACHE_SIZE) {
+      m_pipeline_cache.clear();
+    }
+
+    CachedPipeline& cached = m_pipeline_cache[key];
+    cached.success = success;
+    cached.steps = m_conversion_steps;
+  }
+
+  return success;
+}
+
+
+bool ColorConversionPipeline::search_pipeline(const ColorState& input_state,
+                                              const ColorState& target_state,
+                                              const heif_color_conversion_options& options,
+                                              const heif_color_conversion_options_ext& options_ext)
+{
 #if DEBUG_ME
   std::cerr << "--- construct_pipeline\n";
   std::cerr << "from: " << input_state << "\nto: " << target_state << "\n";
@@ -357,6 +456,10 @@ bool ColorConversionPipeline::construct_pipeline(const ColorState& input_state,
 
     for (const auto& op_ptr : ops) {
 
+      if (!op_ptr->supports_datatype(processed_states.back().output_state.datatype)) {
+        continue;
+      }
+
 #if DEBUG_PIPELINE_CREATION
       auto& op = *op_ptr;
       std::cerr << "-- apply op: " << typeid(op).name() << "\n";
@@ -365,6 +468,14 @@ bool ColorConversionPipeline::construct_pipeline(const ColorState& input_state,
       auto out_states = op_ptr->state_after_conversion(processed_states.back().output_state,
                                                        target_state,
                                                        options, options_ext);
+
+      if (!op_ptr->handles_alpha_premultiplication()) {
+        for (auto& out_state : out_states) {
+          out_state.color_state.premultiplied_alpha = (out_state.color_state.has_alpha &&
+                                                       processed_states.back().output_state.premultiplied_alpha);
+        }
+      }
+
       for (const auto& out_state : out_states) {
         int new_op_costs = out_state.speed_costs + processed_states.back().speed_costs;
 #if DEBUG_PIPELINE_CREATION
@@ -431,8 +542,72 @@ std::string ColorConversionPipeline::debug_dump_pipeline() const
 }
 
 
+static void pass_image_properties(const std::shared_ptr<HeifPixelImage>& out,
+                                  const std::shared_ptr<const HeifPixelImage>& in)
+{
+  out->set_color_profile_icc(in->get_color_profile_icc());
+
+  out->set_premultiplied_alpha(in->is_premultiplied_alpha());
+
+  // pass through HDR information
+  if (in->has_clli()) {
+    out->set_clli(in->get_clli());
+  }
+
+  if (in->has_mdcv()) {
+    out->set_mdcv(in->get_mdcv());
+  }
+
+  if (in->has_nonsquare_pixel_ratio()) {
+    uint32_t h, v;
+    in->get_pixel_ratio(&h, &v);
+    out->set_pixel_ratio(h, v);
+  }
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+  if (in->has_gimi_sample_content_id()) {
+    out->set_gimi_sample_content_id(in->get_gimi_sample_content_id());
+  }
+#endif
+
+  if (auto* tai = in->get_tai_timestamp()) {
+    out->set_tai_timestamp(tai);
+  }
+
+  out->set_sample_duration(in->get_sample_duration());
+  out->set_decoding_scale_denominator(in->get_decoding_scale_denominator());
+  out->set_decoding_fallback(in->get_decoding_fallback());
+
+  const auto& warnings = in->get_warnings();
+  for (const auto& warning : warnings) {
+    out->add_warning(warning);
+  }
+}
+
+
+void ColorConversionPipeline::append_step(const std::shared_ptr<ColorConversionOperation>& operation,
+                                          const ColorState& input_state,
+                                          const ColorState& output_state)
+{
+  m_conversion_steps.push_back({operation, input_state, output_state});
+}
+
+
 Result<std::shared_ptr<HeifPixelImage>> ColorConversionPipeline::convert_image(const std::shared_ptr<HeifPixelImage>& input,
                                                                                const heif_security_limits* limits)
+{
+  if (use_strip_processing(input)) {
+    return convert_image_in_strips(input, limits);
+  }
+  else {
+    return convert_image_in_one_pass(input, limits);
+  }
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ColorConversionPipeline::convert_image_in_one_pass(const std::shared_ptr<HeifPixelImage>& input,
+                                                                                           const heif_security_limits* limits,
+                                                                                           bool input_is_private)
 {
   std::shared_ptr<HeifPixelImage> in = input;
   std::shared_ptr<HeifPixelImage> out = in;
@@ -444,6 +619,24 @@ Result<std::shared_ptr<HeifPixelImage>> ColorConversionPipeline::convert_image(c
     print_spec(std::cerr, in);
 #endif
 
+    HEIF_TRACE_SCOPE("convert", trace_type_name(typeid(*step.operation)));
+
+    // The images created by the previous steps are only referenced by the pipeline.
+    bool in_is_private = (in != input || input_is_private);
+
+    if (in_is_private && in->owns_plane_memory() && step.operation->supports_in_place_conversion()) {
+      if (Error err = step.operation->convert_colorspace_in_place(in, step.input_state, step.output_state,
+                                                                  m_options, m_options_ext)) {
+        return err;
+      }
+
+      in->set_color_profile_nclx(std::make_shared<color_profile_nclx>(step.output_state.nclx_profile));
+      in->set_premultiplied_alpha(step.output_state.has_alpha && step.output_state.premultiplied_alpha);
+
+      out = in;
+      continue;
+    }
+
     auto outResult = step.operation->convert_colorspace(in, step.input_state, step.output_state, m_options, m_options_ext, limits);
     if (outResult.error) {
       return outResult.error;
@@ -456,44 +649,226 @@ Result<std::shared_ptr<HeifPixelImage>> ColorConversionPipeline::convert_image(c
 
     auto output_nclx = std::make_shared<color_profile_nclx>(step.output_state.nclx_profile);
     out->set_color_profile_nclx(output_nclx);
-    out->set_color_profile_icc(in->get_color_profile_icc());
 
-    out->set_premultiplied_alpha(in->is_premultiplied_alpha());
+    pass_image_properties(out, in);
+    out->set_premultiplied_alpha(step.output_state.has_alpha && step.output_state.premultiplied_alpha);
+
+    in = out;
+  }
+
+  return out;
+}
+
+
+// Rows above and below each strip that are converted in addition, such that the bilinear chroma
+// upsampling in the strip sees the same neighboring chroma rows as in the full image.
+// Must be even to keep the strips aligned to the 4:2:0 chroma rows.
+static const uint32_t strip_overlap_rows = 2;
+
+// Smaller images are not worth the overhead of distributing them to the thread pool.
+static const uint64_t min_pixels_for_threaded_conversion = 1024 * 1024;
+
+
+bool ColorConversionPipeline::use_threads(const std::shared_ptr<HeifPixelImage>& input) const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  return (m_options_ext.max_threads > 1 &&
+          uint64_t{input->get_width()} * input->get_height() >= min_pixels_for_threaded_conversion);
+#else
+  return false;
+#endif
+}
+
+
+bool ColorConversionPipeline::use_strip_processing(const std::shared_ptr<HeifPixelImage>& input) const
+{
+  // With a single step, there are no intermediate images that we could save, but the strips can be converted in parallel.
+  if (m_strip_height == 0 || (m_conversion_steps.size() < 2 && !use_threads(input))) {
+    return false;
+  }
+
+  if (input->get_height() <= m_strip_height + 2 * strip_overlap_rows) {
+    return false;
+  }
 
-    // pass through HDR information
-    if (in->has_clli()) {
-      out->set_clli(in->get_clli());
+  // The strips are copied into and out of integer planes. Floating point conversions are threaded by the Ops themselves.
+  for (const auto& step : m_conversion_steps) {
+    if (!step.operation->supports_strip_processing(m_options_ext) ||
+        step.output_state.datatype != heif_channel_datatype_unsigned_integer) {
+      return false;
     }
+  }
 
-    if (in->has_mdcv()) {
-      out->set_mdcv(in->get_mdcv());
+  for (heif_channel channel : input->get_channel_set()) {
+    if (input->get_datatype(channel) != heif_channel_datatype_unsigned_integer) {
+      return false;
     }
+  }
+
+  return true;
+}
+
+
+// Copies 'num_rows' image rows starting at 'src_y0' in 'src' to row 'dst_y0' in 'dst'.
+// Both row positions have to be even.
+static void copy_image_rows(const std::shared_ptr<const HeifPixelImage>& src, uint32_t src_y0,
+                            const std::shared_ptr<HeifPixelImage>& dst, uint32_t dst_y0,
+                            uint32_t num_rows)
+{
+  heif_chroma chroma = src->get_chroma_format();
+
+  for (heif_channel channel : src->get_channel_set()) {
+    size_t src_stride, dst_stride;
+    const uint8_t* src_data = src->get_plane(channel, &src_stride);
+    uint8_t* dst_data = dst->get_plane(channel, &dst_stride);
 
-    if (in->has_nonsquare_pixel_ratio()) {
-      uint32_t h, v;
-      in->get_pixel_ratio(&h, &v);
-      out->set_pixel_ratio(h, v);
+    uint32_t row_bytes = src->get_width(channel) * ((src->get_storage_bits_per_pixel(channel) + 7) / 8);
+
+    uint32_t src_row = channel_height(src_y0, chroma, channel);
+    uint32_t dst_row = channel_height(dst_y0, chroma, channel);
+    uint32_t rows = channel_height(num_rows, chroma, channel);
+
+    for (uint32_t y = 0; y < rows; y++) {
+      memcpy(dst_data + (dst_row + y) * dst_stride,
+             src_data + (src_row + y) * src_stride,
+             row_bytes);
     }
+  }
+}
 
-#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
-    if (in->has_gimi_sample_content_id()) {
-      out->set_gimi_sample_content_id(in->get_gimi_sample_content_id());
+
+Result<std::shared_ptr<HeifPixelImage>> ColorConversionPipeline::convert_image_in_strips(const std::shared_ptr<HeifPixelImage>& input,
+                                                                                         const heif_security_limits* limits)
+{
+  const uint32_t width = input->get_width();
+  const uint32_t height = input->get_height();
+  const heif_chroma input_chroma = input->get_chroma_format();
+
+  // keep the strips aligned to the 4:2:0 chroma rows
+  const uint32_t strip_height = (m_strip_height + 1) & ~1U;
+  const uint32_t num_strips = (height + strip_height - 1) / strip_height;
+
+  std::shared_ptr<HeifPixelImage> out;
+
+  auto convert_strip = [&](uint32_t strip_idx) -> Error {
+    uint32_t y0 = strip_idx * strip_height;
+    uint32_t rows = std::min(strip_height, height - y0);
+
+    uint32_t in_y0 = (y0 >= strip_overlap_rows) ? y0 - strip_overlap_rows : 0;
+    uint32_t in_y1 = std::min(height, y0 + rows + strip_overlap_rows);
+
+    // --- copy the strip (with overlap) into a small image
+
+    auto strip = std::make_shared<HeifPixelImage>();
+    strip->create(width, in_y1 - in_y0, input->get_colorspace(), input_chroma);
+
+    for (heif_channel channel : input->get_channel_set()) {
+      if (auto err = strip->add_plane(channel,
+                                      channel_width(width, input_chroma, channel),
+                                      channel_height(in_y1 - in_y0, input_chroma, channel),
+                                      input->get_bits_per_pixel(channel), limits)) {
+        return err;
+      }
     }
-#endif
 
-    if (auto* tai = in->get_tai_timestamp()) {
-      out->set_tai_timestamp(tai);
+    copy_image_rows(input, in_y0, strip, 0, in_y1 - in_y0);
+
+    strip->set_color_profile_nclx(input->get_color_profile_nclx());
+    strip->set_premultiplied_alpha(input->is_premultiplied_alpha());
+
+    // --- convert the strip through all steps
+
+    auto stripResult = convert_image_in_one_pass(strip, limits, true);
+    if (stripResult.error) {
+      return stripResult.error;
     }
 
-    out->set_sample_duration(in->get_sample_duration());
+    std::shared_ptr<HeifPixelImage> converted_strip = *stripResult;
+
+    // --- allocate the output image with the layout of the first converted strip
 
-    const auto& warnings = in->get_warnings();
-    for (const auto& warning : warnings) {
-      out->add_warning(warning);
+    if (!out) {
+      heif_chroma out_chroma = converted_strip->get_chroma_format();
+
+      out = std::make_shared<HeifPixelImage>();
+      out->create(width, height, converted_strip->get_colorspace(), out_chroma);
+
+      for (heif_channel channel : converted_strip->get_channel_set()) {
+        if (auto err = out->add_plane(channel,
+                                      channel_width(width, out_chroma, channel),
+                                      channel_height(height, out_chroma, channel),
+                                      converted_strip->get_bits_per_pixel(channel), limits)) {
+          return err;
+        }
+      }
     }
 
-    in = out;
+    copy_image_rows(converted_strip, y0 - in_y0, out, y0, rows);
+
+    return Error::Ok;
+  };
+
+  // The first strip is always converted in this thread, because it allocates the output image.
+
+  if (Error err = convert_strip(0)) {
+    return err;
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (use_threads(input) && num_strips > 2) {
+    // Each task takes the next strip that has not been started yet.
+    // The strips are written into disjoint rows of the output image.
+
+    const size_t num_tasks = std::min(static_cast<size_t>(num_strips - 1), static_cast<size_t>(m_options_ext.max_threads));
+
+    std::vector<Error> strip_errors(num_strips);
+    std::atomic<uint32_t> next_strip{1};
+    std::atomic<bool> stop{false};
+
+    auto convert_strips = [&]() {
+      for (;;) {
+        uint32_t idx = next_strip++;
+        if (idx >= num_strips || stop) {
+          return;
+        }
+
+        if (Error err = convert_strip(idx)) {
+          strip_errors[idx] = err;
+          stop = true;
+        }
+      }
+    };
+
+    TaskGroup tasks;
+    for (size_t t = 0; t < num_tasks; t++) {
+      tasks.run(convert_strips);
+    }
+
+    tasks.wait();
+
+    for (const Error& err : strip_errors) {
+      if (err) {
+        return err;
+      }
+    }
   }
+  else
+#endif
+  {
+    for (uint32_t strip_idx = 1; strip_idx < num_strips; strip_idx++) {
+      if (Error err = convert_strip(strip_idx)) {
+        return err;
+      }
+    }
+  }
+
+  auto output_nclx = std::make_shared<color_profile_nclx>(m_conversion_steps.back().output_state.nclx_profile);
+  out->set_color_profile_nclx(output_nclx);
+
+  pass_image_properties(out, input);
+
+  const ColorState& output_state = m_conversion_steps.back().output_state;
+  out->set_premultiplied_alpha(output_state.has_alpha && output_state.premultiplied_alpha);
 
   return out;
 }
@@ -543,6 +918,7 @@ Result<std::shared_ptr<HeifPixelImage>> convert_colorspace(const std::shared_ptr
   input_state.colorspace = input->get_colorspace();
   input_state.chroma = input->get_chroma_format();
   input_state.has_alpha = input->has_channel(heif_channel_Alpha) || is_interleaved_with_alpha(input->get_chroma_format());
+  input_state.premultiplied_alpha = input_state.has_alpha && input->is_premultiplied_alpha();
   if (input->get_color_profile_nclx()) {
     input_state.nclx_profile = *input->get_color_profile_nclx();
   }
@@ -552,8 +928,22 @@ Result<std::shared_ptr<HeifPixelImage>> convert_colorspace(const std::shared_ptr
   std::set<enum heif_channel> channels = input->get_channel_set();
   assert(!channels.empty());
   input_state.bits_per_pixel = input->get_bits_per_pixel(*(channels.begin()));
+  input_state.datatype = input->get_datatype(*(channels.begin()));
+
+  // there are no conversions for images with mixed datatypes
+  for (heif_channel channel : channels) {
+    if (input->get_datatype(channel) != input_state.datatype) {
+      input_state.datatype = heif_channel_datatype_undefined;
+    }
+  }
 
   ColorState output_state = input_state;
+
+  // The output always has integer samples. Floating point samples are converted to 16 bit if no output bit depth is given.
+  if (input_state.datatype != heif_channel_datatype_unsigned_integer) {
+    output_state.datatype = heif_channel_datatype_unsigned_integer;
+    output_state.bits_per_pixel = 16;
+  }
   output_state.colorspace = target_colorspace;
   output_state.chroma = target_chroma;
   if (target_profile) {
@@ -590,6 +980,21 @@ Result<std::shared_ptr<HeifPixelImage>> convert_colorspace(const std::shared_ptr
     }
   }
 
+  // Alpha that is added to the image is opaque and can be considered as straight or premultiplied.
+
+  switch (options_ext.alpha_premultiplication_mode) {
+    case heif_alpha_premultiplication_mode_straight:
+      output_state.premultiplied_alpha = false;
+      break;
+    case heif_alpha_premultiplication_mode_premultiplied:
+      output_state.premultiplied_alpha = input_state.has_alpha;
+      break;
+    default:
+      output_state.premultiplied_alpha = input_state.premultiplied_alpha;
+  }
+
+  output_state.premultiplied_alpha = output_state.premultiplied_alpha && output_state.has_alpha;
+
   if (output_bpp) {
     output_state.bits_per_pixel = output_bpp;
   }
@@ -620,12 +1025,31 @@ Result<std::shared_ptr<HeifPixelImage>> convert_colorspace(const std::shared_ptr
                  heif_suberror_Unsupported_color_conversion};
   }
 
+  // --- convert into the output ICC profile as the last step of the pipeline
+
+  auto icc_op = Op_ICC_transform::create(input, output_state, options_ext);
+  if (icc_op) {
+    ColorState icc_state = output_state;
+    icc_state.nclx_profile.set_colour_primaries(heif_color_primaries_unspecified);
+    icc_state.nclx_profile.set_transfer_characteristics(heif_transfer_characteristic_unspecified);
+
+    pipeline.append_step(icc_op, output_state, icc_state);
+  }
+
   if (pipeline.is_nop()) {
     return input;
   }
-  else {
-    return pipeline.convert_image(input, limits);
+
+  auto outResult = pipeline.convert_image(input, limits);
+  if (outResult.error) {
+    return outResult.error;
   }
+
+  if (icc_op) {
+    (*outResult)->set_color_profile_icc(icc_op->get_output_profile());
+  }
+
+  return outResult;
 }
 
 
@@ -650,3 +1074,42 @@ Result<std::shared_ptr<const HeifPixelImage>> convert_colorspace(const std::shar
     return constImage;
   }
 }
+
+
+void convert_in_row_bands(uint32_t width, uint32_t height, int max_threads,
+                          const std::function<void(uint32_t y0, uint32_t y1)>& convert_rows)
+{
+  // Smaller bands are not worth the overhead of distributing them to the thread pool.
+  const uint64_t min_band_samples = 256 * 1024;
+
+  uint32_t num_bands = 1;
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (max_threads > 1) {
+    uint64_t max_bands = std::max(uint64_t{1}, uint64_t{width} * height / min_band_samples);
+    num_bands = static_cast<uint32_t>(std::min({uint64_t(max_threads), max_bands, uint64_t{height}}));
+  }
+#else
+  (void) width;
+  (void) max_threads;
+  (void) min_band_samples;
+#endif
+
+  if (num_bands <= 1) {
+    convert_rows(0, height);
+    return;
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  TaskGroup tasks;
+  for (uint32_t b = 0; b < num_bands; b++) {
+    uint32_t y0 = static_cast<uint32_t>(static_cast<uint64_t>(height) * b / num_bands);
+    uint32_t y1 = static_cast<uint32_t>(static_cast<uint64_t>(height) * (b + 1) / num_bands);
+
+    tasks.run([&convert_rows, y0, y1]() {
+      convert_rows(y0, y1);
+    });
+  }
+
+  tasks.wait();
+#endif
+}
@@ -22,8 +22,12 @@
 #define LIBHEIF_COLORCONVERSION_H
 
 #include "pixelimage.h"
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -35,6 +39,12 @@ struct ColorState
   bool has_alpha = false;
   int bits_per_pixel = 8;
 
+  // Floating point samples have bits_per_pixel 16 (half float) or 32.
+  heif_channel_datatype datatype = heif_channel_datatype_unsigned_integer;
+
+  // Whether the color values are multiplied with the alpha value. Only meaningful if has_alpha is true.
+  bool premultiplied_alpha = false;
+
   // ColorConversionOperations can assume that the input and target nclx has no 'unspecified' values
   // if the colorspace is heif_colorspace_YCbCr. Otherwise, the values should preferably be 'unspecified'.
   color_profile_nclx nclx_profile;
@@ -93,6 +103,32 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const = 0;
+
+  // Ops that keep the memory layout of the planes (e.g. swapping the byte order) can convert an intermediate image
+  // of the pipeline in place instead of writing a new image.
+  virtual bool supports_in_place_conversion() const { return false; }
+
+  virtual Error
+  convert_colorspace_in_place(const std::shared_ptr<HeifPixelImage>& image,
+                              const ColorState& input_state,
+                              const ColorState& target_state,
+                              const heif_color_conversion_options& options,
+                              const heif_color_conversion_options_ext& options_ext) const { return Error::InternalError; }
+
+  // Whether the Op can convert an image in horizontal strips independently (see ColorConversionPipeline).
+  // Ops whose output depends on the absolute pixel position, or that look further than one
+  // chroma row up or down, have to return false.
+  virtual bool supports_strip_processing(const heif_color_conversion_options_ext& options_ext) const { return true; }
+
+  // The datatype of the input samples. Most Ops only handle unsigned integers.
+  virtual bool supports_datatype(heif_channel_datatype datatype) const
+  {
+    return datatype == heif_channel_datatype_unsigned_integer;
+  }
+
+  // Ops that return false keep the premultiplication of the input in all their output states.
+  // Only the Ops that convert between straight and premultiplied alpha set it themselves.
+  virtual bool handles_alpha_premultiplication() const { return false; }
 };
 
 
@@ -109,11 +145,28 @@ public:
                           const heif_color_conversion_options& options,
                           const heif_color_conversion_options_ext& options_ext);
 
+  // Adds an operation to the end of the pipeline that is not found by the pipeline search (see Op_ICC_transform).
+  void append_step(const std::shared_ptr<ColorConversionOperation>& operation,
+                   const ColorState& input_state,
+                   const ColorState& output_state);
+
   Result<std::shared_ptr<HeifPixelImage>> convert_image(const std::shared_ptr<HeifPixelImage>& input,
                                                         const heif_security_limits* limits);
 
+  // Pipelines with more than one step convert large images in horizontal strips of this height.
+  // Only the strip is held in the intermediate formats, so that the peak memory is about one input
+  // and one output image. Set to 0 to always convert the whole image at once.
+  // When heif_color_conversion_options_ext::max_threads > 1, the strips of large images are
+  // converted in parallel (also for single-step pipelines).
+  void set_strip_height(uint32_t rows) { m_strip_height = rows; }
+
+  uint32_t get_strip_height() const { return m_strip_height; }
+
   std::string debug_dump_pipeline() const;
 
+  // Drop all pipelines that were cached by construct_pipeline().
+  static void clear_pipeline_cache();
+
 private:
   static std::vector<std::shared_ptr<ColorConversionOperation>> m_operation_pool;
 
@@ -125,6 +178,41 @@ private:
 
   std::vector<ConversionStep> m_conversion_steps;
 
+  uint32_t m_strip_height = 256;
+
+  bool use_threads(const std::shared_ptr<HeifPixelImage>& input) const;
+
+  bool use_strip_processing(const std::shared_ptr<HeifPixelImage>& input) const;
+
+  // When 'input_is_private' is set, the input is a copy owned by the pipeline that may be converted in place.
+  Result<std::shared_ptr<HeifPixelImage>> convert_image_in_one_pass(const std::shared_ptr<HeifPixelImage>& input,
+                                                                    const heif_security_limits* limits,
+                                                                    bool input_is_private = false);
+
+  Result<std::shared_ptr<HeifPixelImage>> convert_image_in_strips(const std::shared_ptr<HeifPixelImage>& input,
+                                                                  const heif_security_limits* limits);
+
+  bool search_pipeline(const ColorState& input_state,
+                       const ColorState& target_state,
+                       const heif_color_conversion_options& options,
+                       const heif_color_conversion_options_ext& options_ext);
+
+  // --- Process-wide cache of the pipelines found by search_pipeline().
+  //     The key contains all ColorState fields (including the nclx profile, which is copied into the output images)
+  //     and the options that are evaluated while planning the pipeline.
+
+  using ColorStateKey = std::tuple<int, int, bool, bool, int, int, uint16_t, uint16_t, uint16_t, bool>;
+  using PipelineCacheKey = std::tuple<ColorStateKey, ColorStateKey, int, int, bool, int>;
+
+  struct CachedPipeline {
+    bool success = false;
+    std::vector<ConversionStep> steps;
+  };
+
+  static std::map<PipelineCacheKey, CachedPipeline> m_pipeline_cache;
+
+  static ColorStateKey make_color_state_key(const ColorState& state);
+
   heif_color_conversion_options m_options;
   heif_color_conversion_options_ext m_options_ext;
 };
@@ -150,4 +238,10 @@ Result<std::shared_ptr<const HeifPixelImage>> convert_colorspace(const std::shar
                                                                  const heif_color_conversion_options_ext* options_ext,
                                                                  const heif_security_limits* limits);
 
+
+// Calls 'convert_rows(y0, y1)' for all rows of an image plane. Large planes are split into up to 'max_threads'
+// row bands that are converted in parallel on the thread pool.
+void convert_in_row_bands(uint32_t width, uint32_t height, int max_threads,
+                          const std::function<void(uint32_t y0, uint32_t y1)>& convert_rows);
+
 #endif
@@ -0,0 +1,434 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "demosaic.h"
+#include "demosaic_simd.h"
+#include "colorconversion.h"
+
+
+namespace {
+  template <typename T>
+  struct DemosaicPlanes
+  {
+    const T* in = nullptr;
+    size_t in_stride = 0;
+
+    T* out[3]{};
+    size_t out_stride[3]{};
+
+    uint32_t width = 0, height = 0;
+    int32_t max_value = 0;
+
+    T sample(uint32_t x, uint32_t y) const { return in[y * in_stride + x]; }
+  };
+
+  const heif_channel rgb_channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+}
+
+
+// --- bilinear demosaicing of arbitrary patterns
+
+// Average of the samples of color 'c' in the smallest window around (x,y) that contains any.
+// This is used at the image borders and for patterns that have no fast path.
+template <typename T>
+static T demosaic_sample_generic(const DemosaicPlanes<T>& p, const FilterArrayPattern& pattern,
+                                 uint32_t x, uint32_t y, heif_channel c)
+{
+  if (pattern.at(x, y) == c) {
+    return p.sample(x, y);
+  }
+
+  uint32_t max_radius = std::max(pattern.width, pattern.height);
+
+  for (uint32_t r = 1; r <= max_radius; r++) {
+    uint32_t x0 = x >= r ? x - r : 0;
+    uint32_t y0 = y >= r ? y - r : 0;
+    uint32_t x1 = std::min(x + r, p.width - 1);
+    uint32_t y1 = std::min(y + r, p.height - 1);
+
+    uint32_t sum = 0, n = 0;
+    for (uint32_t yy = y0; yy <= y1; yy++) {
+      for (uint32_t xx = x0; xx <= x1; xx++) {
+        if (pattern.at(xx, yy) == c) {
+          sum += p.sample(xx, yy);
+          n++;
+        }
+      }
+    }
+
+    if (n > 0) {
+      return static_cast<T>((sum + n / 2) / n);
+    }
+  }
+
+  // the color does not occur in the pattern
+  return 0;
+}
+
+
+template <typename T>
+static void demosaic_pixels_generic(const DemosaicPlanes<T>& p, const FilterArrayPattern& pattern,
+                                    uint32_t y, uint32_t x0, uint32_t x1)
+{
+  for (uint32_t x = x0; x < x1; x++) {
+    for (int k = 0; k < 3; k++) {
+      p.out[k][y * p.out_stride[k] + x] = demosaic_sample_generic(p, pattern, x, y, rgb_channels[k]);
+    }
+  }
+}
+
+
+// --- bilinear demosaicing of 2x2 patterns
+
+// Determines from where each color is taken for the four positions of a 2x2 pattern.
+// Returns false if a color has to be averaged from neighbors in different directions
+// (e.g. horizontal and diagonal), which is done by the generic code only.
+static bool get_2x2_demosaic_sources(const FilterArrayPattern& pattern, Demosaic_source sources[2][2][3])
+{
+  if (pattern.width != 2 || pattern.height != 2) {
+    return false;
+  }
+
+  for (uint32_t py = 0; py < 2; py++) {
+    for (uint32_t px = 0; px < 2; px++) {
+      for (int k = 0; k < 3; k++) {
+        heif_channel c = rgb_channels[k];
+
+        bool h = pattern.at(px + 1, py) == c;
+        bool v = pattern.at(px, py + 1) == c;
+        bool d = pattern.at(px + 1, py + 1) == c;
+
+        Demosaic_source& source = sources[py][px][k];
+
+        if (pattern.at(px, py) == c) {
+          source = demosaic_source_self;
+        }
+        else if (d && (h || v)) {
+          return false;
+        }
+        else if (h && v) {
+          source = demosaic_source_cross;
+        }
+        else if (h) {
+          source = demosaic_source_horizontal;
+        }
+        else if (v) {
+          source = demosaic_source_vertical;
+        }
+        else if (d) {
+          source = demosaic_source_diagonal;
+        }
+        else {
+          source = demosaic_source_none;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+
+// 'up', 'cur', 'down' point to the pixel and the pixels above and below it.
+template <typename T>
+static inline T demosaic_source_value(const T* up, const T* cur, const T* down, Demosaic_source source)
+{
+  switch (source) {
+    case demosaic_source_self:
+      return cur[0];
+    case demosaic_source_horizontal:
+      return static_cast<T>(demosaic_avg(cur[-1], cur[1]));
+    case demosaic_source_vertical:
+      return static_cast<T>(demosaic_avg(up[0], down[0]));
+    case demosaic_source_diagonal:
+      return static_cast<T>(demosaic_avg(demosaic_avg(up[-1], up[1]),
+                                         demosaic_avg(down[-1], down[1])));
+    case demosaic_source_cross:
+      return static_cast<T>(demosaic_avg(demosaic_avg(cur[-1], cur[1]),
+                                         demosaic_avg(up[0], down[0])));
+    case demosaic_source_none:
+    default:
+      return 0;
+  }
+}
+
+
+static uint32_t demosaic_bilinear_row_simd(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                           uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  if (auto kernel = get_demosaic_row_kernels().bilinear8) {
+    return kernel(up, cur, down, out, width, sources);
+  }
+
+  return 0;
+}
+
+
+static uint32_t demosaic_bilinear_row_simd(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                           uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  if (auto kernel = get_demosaic_row_kernels().bilinear16) {
+    return kernel(up, cur, down, out, width, sources);
+  }
+
+  return 0;
+}
+
+
+// Demosaics the interior pixels 1 .. width-2 of row y (0 < y < height-1).
+template <typename T>
+static void demosaic_row_bilinear_2x2(const DemosaicPlanes<T>& p, const Demosaic_source sources[2][2][3], uint32_t y)
+{
+  const T* cur = p.in + y * p.in_stride + 1;
+  const T* up = cur - p.in_stride;
+  const T* down = cur + p.in_stride;
+
+  T* const out[3] = {
+      p.out[0] + y * p.out_stride[0] + 1,
+      p.out[1] + y * p.out_stride[1] + 1,
+      p.out[2] + y * p.out_stride[2] + 1
+  };
+
+  uint32_t width = p.width - 2;
+
+  // The rows start at x=1. Even offsets are at odd image columns.
+  Demosaic_row_sources row_sources{};
+  for (int k = 0; k < 3; k++) {
+    row_sources.source[k][0] = sources[y & 1][1][k];
+    row_sources.source[k][1] = sources[y & 1][0][k];
+  }
+
+  uint32_t x = demosaic_bilinear_row_simd(up, cur, down, out, width, row_sources);
+
+  for (; x < width; x++) {
+    for (int k = 0; k < 3; k++) {
+      out[k][x] = demosaic_source_value(up + x, cur + x, down + x, row_sources.source[k][x & 1]);
+    }
+  }
+}
+
+
+// --- gradient corrected demosaicing of Bayer patterns
+
+static bool is_bayer_pattern(const FilterArrayPattern& pattern)
+{
+  if (pattern.width != 2 || pattern.height != 2) {
+    return false;
+  }
+
+  bool g_on_diagonal = (pattern.at(0, 0) == heif_channel_G && pattern.at(1, 1) == heif_channel_G) ||
+                       (pattern.at(1, 0) == heif_channel_G && pattern.at(0, 1) == heif_channel_G);
+
+  if (!g_on_diagonal) {
+    return false;
+  }
+
+  int num_r = 0, num_b = 0;
+  for (heif_channel c : pattern.channels) {
+    num_r += (c == heif_channel_R);
+    num_b += (c == heif_channel_B);
+  }
+
+  return num_r == 1 && num_b == 1;
+}
+
+
+template <typename T>
+static inline T clip_demosaic_value(int32_t v, int32_t shift, int32_t max_value)
+{
+  if (v <= 0) {
+    return 0;
+  }
+
+  v = (v + (1 << (shift - 1))) >> shift;
+  return static_cast<T>(std::min(v, max_value));
+}
+
+
+// Demosaics the pixels 2 .. width-3 of row y (2 <= y < height-2) with the Malvar-He-Cutler filters.
+template <typename T>
+static void demosaic_row_gradient_corrected(const DemosaicPlanes<T>& p, const FilterArrayPattern& pattern, uint32_t y)
+{
+  const T* row = p.in + y * p.in_stride;
+  const ptrdiff_t s = static_cast<ptrdiff_t>(p.in_stride);
+
+  for (uint32_t x = 2; x < p.width - 2; x++) {
+    const T* c = row + x;
+
+    int32_t center = c[0];
+    int32_t orthogonal1_h = c[-1] + c[1];
+    int32_t orthogonal1_v = c[-s] + c[s];
+    int32_t orthogonal2_h = c[-2] + c[2];
+    int32_t orthogonal2_v = c[-2 * s] + c[2 * s];
+    int32_t diagonal = c[-s - 1] + c[-s + 1] + c[s - 1] + c[s + 1];
+
+    heif_channel self = pattern.at(x, y);
+
+    int32_t value[3]; // R,G,B
+    int32_t shift[3];
+
+    for (int k = 0; k < 3; k++) {
+      heif_channel wanted = rgb_channels[k];
+
+      if (wanted == self) {
+        value[k] = center;
+        shift[k] = 0;
+      }
+      else if (self == heif_channel_G) {
+        // R or B at a G pixel, interpolated from the horizontal or vertical neighbors
+        if (pattern.at(x + 1, y) == wanted) {
+          value[k] = 10 * center + 8 * orthogonal1_h - 2 * orthogonal2_h - 2 * diagonal + orthogonal2_v;
+        }
+        else {
+          value[k] = 10 * center + 8 * orthogonal1_v - 2 * orthogonal2_v - 2 * diagonal + orthogonal2_h;
+        }
+        shift[k] = 4;
+      }
+      else if (wanted == heif_channel_G) {
+        // G at a R or B pixel
+        value[k] = 4 * center + 2 * (orthogonal1_h + orthogonal1_v) - (orthogonal2_h + orthogonal2_v);
+        shift[k] = 3;
+      }
+      else {
+        // R at a B pixel or B at a R pixel
+        value[k] = 12 * center + 4 * diagonal - 3 * (orthogonal2_h + orthogonal2_v);
+        shift[k] = 4;
+      }
+    }
+
+    for (int k = 0; k < 3; k++) {
+      p.out[k][y * p.out_stride[k] + x] = shift[k] == 0 ? static_cast<T>(value[k])
+                                                        : clip_demosaic_value<T>(value[k], shift[k], p.max_value);
+    }
+  }
+}
+
+
+template <typename T>
+static void demosaic_planes(const DemosaicPlanes<T>& p, const FilterArrayPattern& pattern,
+                            heif_demosaic_method method, int max_threads)
+{
+  Demosaic_source sources[2][2][3];
+  bool fast_2x2 = get_2x2_demosaic_sources(pattern, sources);
+
+  // Width of the border that is demosaiced with the generic code.
+  uint32_t border = 0;
+  bool gradient_corrected = false;
+
+  if (method == heif_demosaic_method_gradient_corrected && is_bayer_pattern(pattern)) {
+    gradient_corrected = true;
+    border = 2;
+  }
+  else if (fast_2x2) {
+    border = 1;
+  }
+
+  if (p.width <= 2 * border || p.height <= 2 * border) {
+    border = 0;
+  }
+
+  convert_in_row_bands(p.width, p.height, max_threads, [&](uint32_t y0, uint32_t y1) {
+    for (uint32_t y = y0; y < y1; y++) {
+      if (border == 0 || y < border || y >= p.height - border) {
+        demosaic_pixels_generic(p, pattern, y, 0, p.width);
+        continue;
+      }
+
+      demosaic_pixels_generic(p, pattern, y, 0, border);
+
+      if (gradient_corrected) {
+        demosaic_row_gradient_corrected(p, pattern, y);
+      }
+      else {
+        demosaic_row_bilinear_2x2(p, sources, y);
+      }
+
+      demosaic_pixels_generic(p, pattern, y, p.width - border, p.width);
+    }
+  });
+}
+
+
+template <typename T>
+static void demosaic_image(const std::shared_ptr<const HeifPixelImage>& raw,
+                            const std::shared_ptr<HeifPixelImage>& rgb,
+                            const FilterArrayPattern& pattern,
+                            heif_demosaic_method method,
+                            int max_threads)
+{
+  DemosaicPlanes<T> p;
+  p.in = raw->get_channel<T>(heif_channel_Y, &p.in_stride);
+  for (int k = 0; k < 3; k++) {
+    p.out[k] = rgb->get_channel<T>(rgb_channels[k], &p.out_stride[k]);
+  }
+
+  p.width = raw->get_width(heif_channel_Y);
+  p.height = raw->get_height(heif_channel_Y);
+  p.max_value = (1 << raw->get_bits_per_pixel(heif_channel_Y)) - 1;
+
+  demosaic_planes(p, pattern, method, max_threads);
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> demosaic_filter_array(const std::shared_ptr<const HeifPixelImage>& raw,
+                                                              const FilterArrayPattern& pattern,
+                                                              heif_demosaic_method method,
+                                                              int max_threads,
+                                                              const heif_security_limits* limits)
+{
+  if (raw->get_colorspace() != heif_colorspace_monochrome ||
+      !raw->has_channel(heif_channel_Y) ||
+      raw->get_datatype(heif_channel_Y) != heif_channel_datatype_unsigned_integer ||
+      raw->get_bits_per_pixel(heif_channel_Y) > 16) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_color_conversion,
+                 "Demosaicing is only supported for filter array images with up to 16 bit integer samples."};
+  }
+
+  if (pattern.width == 0 || pattern.height == 0 ||
+      pattern.channels.size() != size_t{pattern.width} * pattern.height) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Invalid_parameter_value,
+                 "Invalid filter array pattern."};
+  }
+
+  uint32_t width = raw->get_width(heif_channel_Y);
+  uint32_t height = raw->get_height(heif_channel_Y);
+  int bpp = raw->get_bits_per_pixel(heif_channel_Y);
+
+  auto rgb = std::make_shared<HeifPixelImage>();
+  rgb->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+
+  for (heif_channel channel : rgb_channels) {
+    if (auto err = rgb->add_plane(channel, width, height, bpp, limits)) {
+      return err;
+    }
+  }
+
+  if (bpp <= 8) {
+    demosaic_image<uint8_t>(raw, rgb, pattern, method, max_threads);
+  }
+  else {
+    demosaic_image<uint16_t>(raw, rgb, pattern, method, max_threads);
+  }
+
+  return rgb;
+}
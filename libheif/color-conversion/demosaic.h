@@ -0,0 +1,58 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_DEMOSAIC_H
+#define LIBHEIF_COLORCONVERSION_DEMOSAIC_H
+
+#include "pixelimage.h"
+#include "error.h"
+#include <memory>
+#include <vector>
+
+
+// Color filter array of a raw image ('cpat'). The pattern is repeated over the image, starting at the top-left pixel.
+struct FilterArrayPattern
+{
+  uint16_t width = 0;
+  uint16_t height = 0;
+
+  // Color of each pattern position in raster-scan order: heif_channel_R, _G or _B.
+  // Filters of other colors are heif_channel_Y. They are not used for any output color.
+  std::vector<heif_channel> channels;
+
+  heif_channel at(uint32_t x, uint32_t y) const { return channels[(y % height) * width + (x % width)]; }
+};
+
+
+// Interpolates the missing colors of the raw filter array image 'raw' (monochrome, one Y plane with up to 16 bits).
+// Returns a planar RGB 4:4:4 image with the bit depth of the raw image.
+//
+// Bilinear demosaicing averages the nearest samples of each color. Gradient corrected demosaicing (Malvar-He-Cutler)
+// is used for Bayer patterns only, other patterns are demosaiced bilinearly.
+// For 2x2 patterns, the rows are processed with SIMD kernels.
+//
+// Large images are processed in row bands on the thread pool when max_threads > 1.
+Result<std::shared_ptr<HeifPixelImage>> demosaic_filter_array(const std::shared_ptr<const HeifPixelImage>& raw,
+                                                              const FilterArrayPattern& pattern,
+                                                              heif_demosaic_method method,
+                                                              int max_threads,
+                                                              const heif_security_limits* limits);
+
+#endif //LIBHEIF_COLORCONVERSION_DEMOSAIC_H
@@ -0,0 +1,268 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "demosaic_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+// All pixels of the vectors use one of two sources. 'odd' selects the lanes at odd offsets.
+HEIF_TARGET_SSE41
+static inline void store_demosaic_outputs_sse41(const __m128i values[6], __m128i odd, uint8_t* const out[3],
+                                                size_t offset, const Demosaic_row_sources& sources)
+{
+  for (int k = 0; k < 3; k++) {
+    __m128i v = _mm_blendv_epi8(values[sources.source[k][0]], values[sources.source[k][1]], odd);
+    _mm_storeu_si128((__m128i*) (out[k] + offset), v);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t demosaic_bilinear8_row_sse41(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                      uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  const __m128i odd = _mm_set1_epi16(static_cast<short>(0xFF00));
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i h = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (cur + x - 1)), _mm_loadu_si128((const __m128i*) (cur + x + 1)));
+    __m128i v = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (up + x)), _mm_loadu_si128((const __m128i*) (down + x)));
+    __m128i d_up = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (up + x - 1)), _mm_loadu_si128((const __m128i*) (up + x + 1)));
+    __m128i d_down = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (down + x - 1)), _mm_loadu_si128((const __m128i*) (down + x + 1)));
+
+    __m128i values[6];
+    values[demosaic_source_self] = _mm_loadu_si128((const __m128i*) (cur + x));
+    values[demosaic_source_horizontal] = h;
+    values[demosaic_source_vertical] = v;
+    values[demosaic_source_diagonal] = _mm_avg_epu8(d_up, d_down);
+    values[demosaic_source_cross] = _mm_avg_epu8(h, v);
+    values[demosaic_source_none] = _mm_setzero_si128();
+
+    store_demosaic_outputs_sse41(values, odd, out, x, sources);
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t demosaic_bilinear16_row_sse41(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                       uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  const __m128i odd = _mm_set1_epi32(static_cast<int>(0xFFFF0000));
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i h = _mm_avg_epu16(_mm_loadu_si128((const __m128i*) (cur + x - 1)), _mm_loadu_si128((const __m128i*) (cur + x + 1)));
+    __m128i v = _mm_avg_epu16(_mm_loadu_si128((const __m128i*) (up + x)), _mm_loadu_si128((const __m128i*) (down + x)));
+    __m128i d_up = _mm_avg_epu16(_mm_loadu_si128((const __m128i*) (up + x - 1)), _mm_loadu_si128((const __m128i*) (up + x + 1)));
+    __m128i d_down = _mm_avg_epu16(_mm_loadu_si128((const __m128i*) (down + x - 1)), _mm_loadu_si128((const __m128i*) (down + x + 1)));
+
+    __m128i values[6];
+    values[demosaic_source_self] = _mm_loadu_si128((const __m128i*) (cur + x));
+    values[demosaic_source_horizontal] = h;
+    values[demosaic_source_vertical] = v;
+    values[demosaic_source_diagonal] = _mm_avg_epu16(d_up, d_down);
+    values[demosaic_source_cross] = _mm_avg_epu16(h, v);
+    values[demosaic_source_none] = _mm_setzero_si128();
+
+    uint8_t* const out_bytes[3] = {(uint8_t*) out[0], (uint8_t*) out[1], (uint8_t*) out[2]};
+    store_demosaic_outputs_sse41(values, odd, out_bytes, 2 * size_t{x}, sources);
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+static inline void store_demosaic_outputs_avx2(const __m256i values[6], __m256i odd, uint8_t* const out[3],
+                                               size_t offset, const Demosaic_row_sources& sources)
+{
+  for (int k = 0; k < 3; k++) {
+    __m256i v = _mm256_blendv_epi8(values[sources.source[k][0]], values[sources.source[k][1]], odd);
+    _mm256_storeu_si256((__m256i*) (out[k] + offset), v);
+  }
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t demosaic_bilinear8_row_avx2(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                     uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  const __m256i odd = _mm256_set1_epi16(static_cast<short>(0xFF00));
+
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i h = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*) (cur + x - 1)), _mm256_loadu_si256((const __m256i*) (cur + x + 1)));
+    __m256i v = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*) (up + x)), _mm256_loadu_si256((const __m256i*) (down + x)));
+    __m256i d_up = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*) (up + x - 1)), _mm256_loadu_si256((const __m256i*) (up + x + 1)));
+    __m256i d_down = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*) (down + x - 1)), _mm256_loadu_si256((const __m256i*) (down + x + 1)));
+
+    __m256i values[6];
+    values[demosaic_source_self] = _mm256_loadu_si256((const __m256i*) (cur + x));
+    values[demosaic_source_horizontal] = h;
+    values[demosaic_source_vertical] = v;
+    values[demosaic_source_diagonal] = _mm256_avg_epu8(d_up, d_down);
+    values[demosaic_source_cross] = _mm256_avg_epu8(h, v);
+    values[demosaic_source_none] = _mm256_setzero_si256();
+
+    store_demosaic_outputs_avx2(values, odd, out, x, sources);
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t demosaic_bilinear16_row_avx2(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                      uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  const __m256i odd = _mm256_set1_epi32(static_cast<int>(0xFFFF0000));
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i h = _mm256_avg_epu16(_mm256_loadu_si256((const __m256i*) (cur + x - 1)), _mm256_loadu_si256((const __m256i*) (cur + x + 1)));
+    __m256i v = _mm256_avg_epu16(_mm256_loadu_si256((const __m256i*) (up + x)), _mm256_loadu_si256((const __m256i*) (down + x)));
+    __m256i d_up = _mm256_avg_epu16(_mm256_loadu_si256((const __m256i*) (up + x - 1)), _mm256_loadu_si256((const __m256i*) (up + x + 1)));
+    __m256i d_down = _mm256_avg_epu16(_mm256_loadu_si256((const __m256i*) (down + x - 1)), _mm256_loadu_si256((const __m256i*) (down + x + 1)));
+
+    __m256i values[6];
+    values[demosaic_source_self] = _mm256_loadu_si256((const __m256i*) (cur + x));
+    values[demosaic_source_horizontal] = h;
+    values[demosaic_source_vertical] = v;
+    values[demosaic_source_diagonal] = _mm256_avg_epu16(d_up, d_down);
+    values[demosaic_source_cross] = _mm256_avg_epu16(h, v);
+    values[demosaic_source_none] = _mm256_setzero_si256();
+
+    uint8_t* const out_bytes[3] = {(uint8_t*) out[0], (uint8_t*) out[1], (uint8_t*) out[2]};
+    store_demosaic_outputs_avx2(values, odd, out_bytes, 2 * size_t{x}, sources);
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+uint32_t demosaic_bilinear8_row_neon(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                     uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  const uint8x16_t odd = vreinterpretq_u8_u16(vdupq_n_u16(0xFF00));
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t h = vrhaddq_u8(vld1q_u8(cur + x - 1), vld1q_u8(cur + x + 1));
+    uint8x16_t v = vrhaddq_u8(vld1q_u8(up + x), vld1q_u8(down + x));
+    uint8x16_t d_up = vrhaddq_u8(vld1q_u8(up + x - 1), vld1q_u8(up + x + 1));
+    uint8x16_t d_down = vrhaddq_u8(vld1q_u8(down + x - 1), vld1q_u8(down + x + 1));
+
+    uint8x16_t values[6];
+    values[demosaic_source_self] = vld1q_u8(cur + x);
+    values[demosaic_source_horizontal] = h;
+    values[demosaic_source_vertical] = v;
+    values[demosaic_source_diagonal] = vrhaddq_u8(d_up, d_down);
+    values[demosaic_source_cross] = vrhaddq_u8(h, v);
+    values[demosaic_source_none] = vdupq_n_u8(0);
+
+    for (int k = 0; k < 3; k++) {
+      vst1q_u8(out[k] + x, vbslq_u8(odd, values[sources.source[k][1]], values[sources.source[k][0]]));
+    }
+  }
+
+  return x;
+}
+
+
+uint32_t demosaic_bilinear16_row_neon(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                      uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources)
+{
+  const uint16x8_t odd = vreinterpretq_u16_u32(vdupq_n_u32(0xFFFF0000));
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t h = vrhaddq_u16(vld1q_u16(cur + x - 1), vld1q_u16(cur + x + 1));
+    uint16x8_t v = vrhaddq_u16(vld1q_u16(up + x), vld1q_u16(down + x));
+    uint16x8_t d_up = vrhaddq_u16(vld1q_u16(up + x - 1), vld1q_u16(up + x + 1));
+    uint16x8_t d_down = vrhaddq_u16(vld1q_u16(down + x - 1), vld1q_u16(down + x + 1));
+
+    uint16x8_t values[6];
+    values[demosaic_source_self] = vld1q_u16(cur + x);
+    values[demosaic_source_horizontal] = h;
+    values[demosaic_source_vertical] = v;
+    values[demosaic_source_diagonal] = vrhaddq_u16(d_up, d_down);
+    values[demosaic_source_cross] = vrhaddq_u16(h, v);
+    values[demosaic_source_none] = vdupq_n_u16(0);
+
+    for (int k = 0; k < 3; k++) {
+      vst1q_u16(out[k] + x, vbslq_u16(odd, values[sources.source[k][1]], values[sources.source[k][0]]));
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Demosaic_row_kernels select_demosaic_row_kernels()
+{
+  Demosaic_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.bilinear8 = demosaic_bilinear8_row_avx2;
+    kernels.bilinear16 = demosaic_bilinear16_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.bilinear8 = demosaic_bilinear8_row_sse41;
+    kernels.bilinear16 = demosaic_bilinear16_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.bilinear8 = demosaic_bilinear8_row_neon;
+    kernels.bilinear16 = demosaic_bilinear16_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const Demosaic_row_kernels& get_demosaic_row_kernels()
+{
+  static const Demosaic_row_kernels kernels = select_demosaic_row_kernels();
+  return kernels;
+}
@@ -0,0 +1,104 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_DEMOSAIC_SIMD_H
+#define LIBHEIF_COLORCONVERSION_DEMOSAIC_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// Where the bilinear demosaicing of a 2x2 filter array takes an output color of a pixel from.
+enum Demosaic_source : uint8_t
+{
+  demosaic_source_self = 0,    // the sample of the pixel
+  demosaic_source_horizontal,  // the left and right neighbors
+  demosaic_source_vertical,    // the upper and lower neighbors
+  demosaic_source_diagonal,    // the four diagonal neighbors
+  demosaic_source_cross,       // the four horizontal and vertical neighbors
+  demosaic_source_none         // the color does not occur in the pattern, the output is 0
+};
+
+// The sources of the R, G, B outputs for the pixels at even [0] and odd [1] offsets from the start of the row.
+struct Demosaic_row_sources
+{
+  Demosaic_source source[3][2];
+};
+
+// Rounded average of two samples. Averages of four samples are the averages of the two pair averages.
+// The scalar code and the SIMD kernels compute exactly the same values.
+inline uint32_t demosaic_avg(uint32_t a, uint32_t b)
+{
+  return (a + b + 1) >> 1;
+}
+
+
+// --- Row kernels (see cpu_features.h).
+//
+// The kernels demosaic the pixels cur[0 .. width-1] of a 2x2 filter array into the R, G, B rows 'out'
+// and return the number of processed pixels.
+// They also read the samples cur[-1] and cur[width] and those of the rows above and below.
+
+typedef uint32_t (*Demosaic_bilinear8_row_kernel)(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                                  uint8_t* const out[3], uint32_t width,
+                                                  const Demosaic_row_sources& sources);
+
+typedef uint32_t (*Demosaic_bilinear16_row_kernel)(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                                   uint16_t* const out[3], uint32_t width,
+                                                   const Demosaic_row_sources& sources);
+
+
+struct Demosaic_row_kernels
+{
+  Demosaic_bilinear8_row_kernel bilinear8 = nullptr;
+  Demosaic_bilinear16_row_kernel bilinear16 = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t demosaic_bilinear8_row_sse41(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                      uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources);
+
+uint32_t demosaic_bilinear16_row_sse41(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                       uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources);
+
+uint32_t demosaic_bilinear8_row_avx2(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                     uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources);
+
+uint32_t demosaic_bilinear16_row_avx2(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                      uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t demosaic_bilinear8_row_neon(const uint8_t* up, const uint8_t* cur, const uint8_t* down,
+                                     uint8_t* const out[3], uint32_t width, const Demosaic_row_sources& sources);
+
+uint32_t demosaic_bilinear16_row_neon(const uint16_t* up, const uint16_t* cur, const uint16_t* down,
+                                      uint16_t* const out[3], uint32_t width, const Demosaic_row_sources& sources);
+
+#endif
+
+
+const Demosaic_row_kernels& get_demosaic_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_DEMOSAIC_SIMD_H
@@ -0,0 +1,357 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <vector>
+#include "float_conversion.h"
+#include "float_conversion_simd.h"
+#include "colorconversion.h"
+
+
+static bool is_planar_chroma(heif_chroma chroma)
+{
+  return (chroma == heif_chroma_monochrome ||
+          chroma == heif_chroma_420 ||
+          chroma == heif_chroma_422 ||
+          chroma == heif_chroma_444);
+}
+
+
+static void convert_half_row_to_float(const uint16_t* in, float* out, uint32_t width)
+{
+  uint32_t x = 0;
+  if (auto kernel = get_float_row_kernels().half_to_float) {
+    x = kernel(in, out, width);
+  }
+
+  for (; x < width; x++) {
+    out[x] = half_to_float(in[x]);
+  }
+}
+
+
+static void convert_float_row_to_half(const float* in, uint16_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  if (auto kernel = get_float_row_kernels().float_to_half) {
+    x = kernel(in, out, width);
+  }
+
+  for (; x < width; x++) {
+    out[x] = float_to_half(in[x]);
+  }
+}
+
+
+std::vector<ColorStateWithCost>
+Op_float_to_uint::state_after_conversion(const ColorState& input_state,
+                                         const ColorState& target_state,
+                                         const heif_color_conversion_options& options,
+                                         const heif_color_conversion_options_ext& options_ext) const
+{
+  if (input_state.datatype != heif_channel_datatype_floating_point ||
+      (input_state.bits_per_pixel != 16 && input_state.bits_per_pixel != 32) ||
+      !is_planar_chroma(input_state.chroma) ||
+      target_state.datatype != heif_channel_datatype_unsigned_integer) {
+    return {};
+  }
+
+  std::vector<ColorStateWithCost> states;
+
+  ColorState output_state = input_state;
+  output_state.datatype = heif_channel_datatype_unsigned_integer;
+  output_state.bits_per_pixel = std::clamp(target_state.bits_per_pixel, 8, 16);
+
+  const Float_row_kernels& kernels = get_float_row_kernels();
+  bool optimized = (kernels.float_to_uint16 && (input_state.bits_per_pixel == 32 || kernels.half_to_float));
+
+  states.emplace_back(output_state, optimized ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
+
+  return states;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Op_float_to_uint::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                     const ColorState& input_state,
+                                     const ColorState& target_state,
+                                     const heif_color_conversion_options& options,
+                                     const heif_color_conversion_options_ext& options_ext,
+                                     const heif_security_limits* limits) const
+{
+  auto outimg = std::make_shared<HeifPixelImage>();
+
+  outimg->create(input->get_width(),
+                 input->get_height(),
+                 input->get_colorspace(),
+                 input->get_chroma_format());
+
+  const int output_bits = target_state.bits_per_pixel;
+  const float max_value = static_cast<float>((1U << output_bits) - 1);
+  const Float_row_kernels& kernels = get_float_row_kernels();
+
+  for (heif_channel channel : input->get_channel_set()) {
+    int input_bits = input->get_bits_per_pixel(channel);
+    if (input->get_datatype(channel) != heif_channel_datatype_floating_point ||
+        (input_bits != 16 && input_bits != 32)) {
+      return Error::InternalError;
+    }
+
+    uint32_t width = input->get_width(channel);
+    uint32_t height = input->get_height(channel);
+    if (auto err = outimg->add_plane(channel, width, height, output_bits, limits)) {
+      return err;
+    }
+
+    size_t stride_in;
+    const uint8_t* p_in = input->get_plane(channel, &stride_in);
+
+    size_t stride_out;
+    uint8_t* p_out = outimg->get_plane(channel, &stride_out);
+
+    convert_in_row_bands(width, height, options_ext.max_threads, [&](uint32_t y0, uint32_t y1) {
+      std::vector<float> half_row;
+      if (input_bits == 16) {
+        half_row.resize(width);
+      }
+
+      for (uint32_t y = y0; y < y1; y++) {
+        const float* in;
+        if (input_bits == 16) {
+          convert_half_row_to_float(reinterpret_cast<const uint16_t*>(p_in + y * stride_in), half_row.data(), width);
+          in = half_row.data();
+        }
+        else {
+          in = reinterpret_cast<const float*>(p_in + y * stride_in);
+        }
+
+        uint32_t x = 0;
+        if (output_bits == 8) {
+          uint8_t* out = p_out + y * stride_out;
+          if (kernels.float_to_uint8) {
+            x = kernels.float_to_uint8(in, out, width, max_value, max_value);
+          }
+
+          for (; x < width; x++) {
+            out[x] = static_cast<uint8_t>(float_to_uint_sample(in[x], max_value, max_value));
+          }
+        }
+        else {
+          auto* out = reinterpret_cast<uint16_t*>(p_out + y * stride_out);
+          if (kernels.float_to_uint16) {
+            x = kernels.float_to_uint16(in, out, width, max_value, max_value);
+          }
+
+          for (; x < width; x++) {
+            out[x] = static_cast<uint16_t>(float_to_uint_sample(in[x], max_value, max_value));
+          }
+        }
+      }
+    });
+  }
+
+  return outimg;
+}
+
+
+std::vector<ColorStateWithCost>
+Op_uint_to_float::state_after_conversion(const ColorState& input_state,
+                                         const ColorState& target_state,
+                                         const heif_color_conversion_options& options,
+                                         const heif_color_conversion_options_ext& options_ext) const
+{
+  if (input_state.bits_per_pixel > 16 ||
+      !is_planar_chroma(input_state.chroma) ||
+      target_state.datatype != heif_channel_datatype_floating_point) {
+    return {};
+  }
+
+  std::vector<ColorStateWithCost> states;
+
+  ColorState output_state = input_state;
+  output_state.datatype = heif_channel_datatype_floating_point;
+  output_state.bits_per_pixel = 32;
+
+  states.emplace_back(output_state, get_float_row_kernels().uint16_to_float ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
+
+  return states;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Op_uint_to_float::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                     const ColorState& input_state,
+                                     const ColorState& target_state,
+                                     const heif_color_conversion_options& options,
+                                     const heif_color_conversion_options_ext& options_ext,
+                                     const heif_security_limits* limits) const
+{
+  auto outimg = std::make_shared<HeifPixelImage>();
+
+  outimg->create(input->get_width(),
+                 input->get_height(),
+                 input->get_colorspace(),
+                 input->get_chroma_format());
+
+  const Float_row_kernels& kernels = get_float_row_kernels();
+
+  for (heif_channel channel : input->get_channel_set()) {
+    int input_bits = input->get_bits_per_pixel(channel);
+    if (input_bits > 16) {
+      return Error::InternalError;
+    }
+
+    uint32_t width = input->get_width(channel);
+    uint32_t height = input->get_height(channel);
+    if (auto err = outimg->add_channel(channel, width, height, heif_channel_datatype_floating_point, 32, limits)) {
+      return err;
+    }
+
+    size_t stride_in;
+    const uint8_t* p_in = input->get_plane(channel, &stride_in);
+
+    size_t stride_out;
+    uint8_t* p_out = outimg->get_plane(channel, &stride_out);
+
+    const float scale = 1.0f / static_cast<float>((1U << input_bits) - 1);
+
+    convert_in_row_bands(width, height, options_ext.max_threads, [&](uint32_t y0, uint32_t y1) {
+      for (uint32_t y = y0; y < y1; y++) {
+        auto* out = reinterpret_cast<float*>(p_out + y * stride_out);
+
+        uint32_t x = 0;
+        if (input_bits <= 8) {
+          const uint8_t* in = p_in + y * stride_in;
+          if (kernels.uint8_to_float) {
+            x = kernels.uint8_to_float(in, out, width, scale);
+          }
+
+          for (; x < width; x++) {
+            out[x] = static_cast<float>(in[x]) * scale;
+          }
+        }
+        else {
+          auto* in = reinterpret_cast<const uint16_t*>(p_in + y * stride_in);
+          if (kernels.uint16_to_float) {
+            x = kernels.uint16_to_float(in, out, width, scale);
+          }
+
+          for (; x < width; x++) {
+            out[x] = static_cast<float>(in[x]) * scale;
+          }
+        }
+      }
+    });
+  }
+
+  return outimg;
+}
+
+
+std::vector<ColorStateWithCost>
+Op_float_precision::state_after_conversion(const ColorState& input_state,
+                                           const ColorState& target_state,
+                                           const heif_color_conversion_options& options,
+                                           const heif_color_conversion_options_ext& options_ext) const
+{
+  if (input_state.datatype != heif_channel_datatype_floating_point ||
+      (input_state.bits_per_pixel != 16 && input_state.bits_per_pixel != 32) ||
+      !is_planar_chroma(input_state.chroma) ||
+      target_state.datatype != heif_channel_datatype_floating_point ||
+      (target_state.bits_per_pixel != 16 && target_state.bits_per_pixel != 32) ||
+      input_state.bits_per_pixel == target_state.bits_per_pixel) {
+    return {};
+  }
+
+  std::vector<ColorStateWithCost> states;
+
+  ColorState output_state = input_state;
+  output_state.bits_per_pixel = target_state.bits_per_pixel;
+
+  const Float_row_kernels& kernels = get_float_row_kernels();
+  bool optimized = (output_state.bits_per_pixel == 32 ? kernels.half_to_float != nullptr : kernels.float_to_half != nullptr);
+
+  states.emplace_back(output_state, optimized ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
+
+  return states;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Op_float_precision::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                       const ColorState& input_state,
+                                       const ColorState& target_state,
+                                       const heif_color_conversion_options& options,
+                                       const heif_color_conversion_options_ext& options_ext,
+                                       const heif_security_limits* limits) const
+{
+  auto outimg = std::make_shared<HeifPixelImage>();
+
+  outimg->create(input->get_width(),
+                 input->get_height(),
+                 input->get_colorspace(),
+                 input->get_chroma_format());
+
+  const int output_bits = target_state.bits_per_pixel;
+
+  for (heif_channel channel : input->get_channel_set()) {
+    int input_bits = input->get_bits_per_pixel(channel);
+    if (input->get_datatype(channel) != heif_channel_datatype_floating_point ||
+        (input_bits != 16 && input_bits != 32)) {
+      return Error::InternalError;
+    }
+
+    // e.g. an alpha plane that already has the target precision
+    if (input_bits == output_bits) {
+      if (auto err = outimg->share_plane_from(input, channel, channel)) {
+        return err;
+      }
+
+      continue;
+    }
+
+    uint32_t width = input->get_width(channel);
+    uint32_t height = input->get_height(channel);
+    if (auto err = outimg->add_channel(channel, width, height, heif_channel_datatype_floating_point, output_bits, limits)) {
+      return err;
+    }
+
+    size_t stride_in;
+    const uint8_t* p_in = input->get_plane(channel, &stride_in);
+
+    size_t stride_out;
+    uint8_t* p_out = outimg->get_plane(channel, &stride_out);
+
+    convert_in_row_bands(width, height, options_ext.max_threads, [&](uint32_t y0, uint32_t y1) {
+      for (uint32_t y = y0; y < y1; y++) {
+        if (output_bits == 32) {
+          convert_half_row_to_float(reinterpret_cast<const uint16_t*>(p_in + y * stride_in),
+                                    reinterpret_cast<float*>(p_out + y * stride_out), width);
+        }
+        else {
+          convert_float_row_to_half(reinterpret_cast<const float*>(p_in + y * stride_in),
+                                    reinterpret_cast<uint16_t*>(p_out + y * stride_out), width);
+        }
+      }
+    });
+  }
+
+  return outimg;
+}
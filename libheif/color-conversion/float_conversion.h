@@ -0,0 +1,107 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_FLOAT_CONVERSION_H
+#define LIBHEIF_COLORCONVERSION_FLOAT_CONVERSION_H
+
+#include "colorconversion.h"
+#include <vector>
+#include <memory>
+
+
+// Conversions of planar images with floating point samples ('unci' images with component_format 'float').
+//
+// Floating point samples are normalized to [0, 1]. The range [0, 1] is mapped to the full range of the
+// integer samples, [0, 2^bpp - 1]. Values outside of the range are clamped, NaN gives 0.
+// Half floats are stored with bits_per_pixel = 16, single precision floats with bits_per_pixel = 32.
+//
+// Large images are converted in row bands on the thread pool when heif_color_conversion_options_ext::max_threads > 1.
+
+
+// float16 or float32 to unsigned integer samples with 8-16 bits.
+class Op_float_to_uint : public ColorConversionOperation
+{
+public:
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState& input_state,
+                         const ColorState& target_state,
+                         const heif_color_conversion_options& options,
+                         const heif_color_conversion_options_ext& options_ext) const override;
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+
+  bool supports_datatype(heif_channel_datatype datatype) const override
+  {
+    return datatype == heif_channel_datatype_floating_point;
+  }
+};
+
+
+// Unsigned integer samples with 1-16 bits to float32.
+class Op_uint_to_float : public ColorConversionOperation
+{
+public:
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState& input_state,
+                         const ColorState& target_state,
+                         const heif_color_conversion_options& options,
+                         const heif_color_conversion_options_ext& options_ext) const override;
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+};
+
+
+// float16 to float32 and back.
+class Op_float_precision : public ColorConversionOperation
+{
+public:
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState& input_state,
+                         const ColorState& target_state,
+                         const heif_color_conversion_options& options,
+                         const heif_color_conversion_options_ext& options_ext) const override;
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+
+  bool supports_datatype(heif_channel_datatype datatype) const override
+  {
+    return datatype == heif_channel_datatype_floating_point;
+  }
+};
+
+#endif //LIBHEIF_COLORCONVERSION_FLOAT_CONVERSION_H
@@ -0,0 +1,397 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "float_conversion_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HEIF_TARGET_F16C __attribute__((target("avx2,f16c")))
+#else
+#define HEIF_TARGET_F16C
+#endif
+
+
+// --- SSE4.1
+
+// in * scale, clamped to [0, max_value] and rounded. MAXPS returns the second operand for NaN, hence NaN gives 0.
+HEIF_TARGET_SSE41
+static inline __m128i float_to_int_4_sse41(const float* in, __m128 scale, __m128 max_value)
+{
+  __m128 v = _mm_mul_ps(_mm_loadu_ps(in), scale);
+  v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), max_value);
+  return _mm_cvtps_epi32(v);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t float_to_uint8_row_sse41(const float* in, uint8_t* out, uint32_t width, float scale, float max_value)
+{
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 m = _mm_set1_ps(max_value);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i a = float_to_int_4_sse41(in + x, s, m);
+    __m128i b = float_to_int_4_sse41(in + x + 4, s, m);
+    __m128i c = float_to_int_4_sse41(in + x + 8, s, m);
+    __m128i d = float_to_int_4_sse41(in + x + 12, s, m);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d)));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t float_to_uint16_row_sse41(const float* in, uint16_t* out, uint32_t width, float scale, float max_value)
+{
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 m = _mm_set1_ps(max_value);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i a = float_to_int_4_sse41(in + x, s, m);
+    __m128i b = float_to_int_4_sse41(in + x + 4, s, m);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(a, b));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t uint8_to_float_row_sse41(const uint8_t* in, float* out, uint32_t width, float scale)
+{
+  const __m128 s = _mm_set1_ps(scale);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (in + x));
+
+    for (int i = 0; i < 4; i++) {
+      __m128i v32 = _mm_cvtepu8_epi32(v);
+      _mm_storeu_ps(out + x + 4 * i, _mm_mul_ps(_mm_cvtepi32_ps(v32), s));
+      v = _mm_srli_si128(v, 4);
+    }
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t uint16_to_float_row_sse41(const uint16_t* in, float* out, uint32_t width, float scale)
+{
+  const __m128 s = _mm_set1_ps(scale);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i lo = _mm_cvtepu16_epi32(v);
+    __m128i hi = _mm_cvtepu16_epi32(_mm_srli_si128(v, 8));
+
+    _mm_storeu_ps(out + x, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+    _mm_storeu_ps(out + x + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+static inline __m256i float_to_int_8_avx2(const float* in, __m256 scale, __m256 max_value)
+{
+  __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in), scale);
+  v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), max_value);
+  return _mm256_cvtps_epi32(v);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t float_to_uint8_row_avx2(const float* in, uint8_t* out, uint32_t width, float scale, float max_value)
+{
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 m = _mm256_set1_ps(max_value);
+
+  // the packing works within the 128-bit lanes, this restores the sample order of the 32-bit groups
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i a = float_to_int_8_avx2(in + x, s, m);
+    __m256i b = float_to_int_8_avx2(in + x + 8, s, m);
+    __m256i c = float_to_int_8_avx2(in + x + 16, s, m);
+    __m256i d = float_to_int_8_avx2(in + x + 24, s, m);
+
+    __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permutevar8x32_epi32(packed, order));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t float_to_uint16_row_avx2(const float* in, uint16_t* out, uint32_t width, float scale, float max_value)
+{
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 m = _mm256_set1_ps(max_value);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i a = float_to_int_8_avx2(in + x, s, m);
+    __m256i b = float_to_int_8_avx2(in + x + 8, s, m);
+
+    // packus works within the 128-bit lanes, restore the sample order
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t uint8_to_float_row_avx2(const uint8_t* in, float* out, uint32_t width, float scale)
+{
+  const __m256 s = _mm256_set1_ps(scale);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (in + x));
+    __m256i lo = _mm256_cvtepu8_epi32(v);
+    __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8));
+
+    _mm256_storeu_ps(out + x, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), s));
+    _mm256_storeu_ps(out + x + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), s));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t uint16_to_float_row_avx2(const uint16_t* in, float* out, uint32_t width, float scale)
+{
+  const __m256 s = _mm256_set1_ps(scale);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in + x + 8)));
+
+    _mm256_storeu_ps(out + x, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), s));
+    _mm256_storeu_ps(out + x + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), s));
+  }
+
+  return x;
+}
+
+
+// --- F16C
+
+HEIF_TARGET_F16C
+uint32_t half_to_float_row_f16c(const uint16_t* in, float* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    _mm256_storeu_ps(out + x, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (in + x))));
+    _mm256_storeu_ps(out + x + 8, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (in + x + 8))));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_F16C
+uint32_t float_to_half_row_f16c(const float* in, uint16_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    _mm_storeu_si128((__m128i*) (out + x), _mm256_cvtps_ph(_mm256_loadu_ps(in + x), _MM_FROUND_TO_NEAREST_INT));
+    _mm_storeu_si128((__m128i*) (out + x + 8), _mm256_cvtps_ph(_mm256_loadu_ps(in + x + 8), _MM_FROUND_TO_NEAREST_INT));
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+
+// FMAXNM returns the number if the other operand is NaN, hence NaN gives 0.
+static inline uint32x4_t float_to_uint_4_neon(const float* in, float32x4_t scale, float32x4_t max_value)
+{
+  float32x4_t v = vmulq_f32(vld1q_f32(in), scale);
+  v = vminq_f32(vmaxnmq_f32(v, vdupq_n_f32(0.0f)), max_value);
+  return vcvtnq_u32_f32(v);
+}
+
+
+uint32_t float_to_uint8_row_neon(const float* in, uint8_t* out, uint32_t width, float scale, float max_value)
+{
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t m = vdupq_n_f32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint16x8_t lo = vcombine_u16(vqmovn_u32(float_to_uint_4_neon(in + x, s, m)),
+                                 vqmovn_u32(float_to_uint_4_neon(in + x + 4, s, m)));
+    uint16x8_t hi = vcombine_u16(vqmovn_u32(float_to_uint_4_neon(in + x + 8, s, m)),
+                                 vqmovn_u32(float_to_uint_4_neon(in + x + 12, s, m)));
+
+    vst1q_u8(out + x, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+  }
+
+  return x;
+}
+
+
+uint32_t float_to_uint16_row_neon(const float* in, uint16_t* out, uint32_t width, float scale, float max_value)
+{
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t m = vdupq_n_f32(max_value);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    vst1q_u16(out + x, vcombine_u16(vqmovn_u32(float_to_uint_4_neon(in + x, s, m)),
+                                    vqmovn_u32(float_to_uint_4_neon(in + x + 4, s, m))));
+  }
+
+  return x;
+}
+
+
+uint32_t uint8_to_float_row_neon(const uint8_t* in, float* out, uint32_t width, float scale)
+{
+  const float32x4_t s = vdupq_n_f32(scale);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t v = vld1q_u8(in + x);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+    vst1q_f32(out + x, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), s));
+    vst1q_f32(out + x + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), s));
+    vst1q_f32(out + x + 8, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), s));
+    vst1q_f32(out + x + 12, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), s));
+  }
+
+  return x;
+}
+
+
+uint32_t uint16_to_float_row_neon(const uint16_t* in, float* out, uint32_t width, float scale)
+{
+  const float32x4_t s = vdupq_n_f32(scale);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t v = vld1q_u16(in + x);
+
+    vst1q_f32(out + x, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), s));
+    vst1q_f32(out + x + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), s));
+  }
+
+  return x;
+}
+
+
+uint32_t half_to_float_row_neon(const uint16_t* in, float* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    vst1q_f32(out + x, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + x))));
+    vst1q_f32(out + x + 4, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + x + 4))));
+  }
+
+  return x;
+}
+
+
+uint32_t float_to_half_row_neon(const float* in, uint16_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    vst1_u16(out + x, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + x))));
+    vst1_u16(out + x + 4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + x + 4))));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Float_row_kernels select_float_row_kernels()
+{
+  Float_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.float_to_uint8 = float_to_uint8_row_avx2;
+    kernels.float_to_uint16 = float_to_uint16_row_avx2;
+    kernels.uint8_to_float = uint8_to_float_row_avx2;
+    kernels.uint16_to_float = uint16_to_float_row_avx2;
+    kernels.half_to_float = half_to_float_row_f16c;
+    kernels.float_to_half = float_to_half_row_f16c;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.float_to_uint8 = float_to_uint8_row_sse41;
+    kernels.float_to_uint16 = float_to_uint16_row_sse41;
+    kernels.uint8_to_float = uint8_to_float_row_sse41;
+    kernels.uint16_to_float = uint16_to_float_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+  if (cpu_supports_neon()) {
+    kernels.float_to_uint8 = float_to_uint8_row_neon;
+    kernels.float_to_uint16 = float_to_uint16_row_neon;
+    kernels.uint8_to_float = uint8_to_float_row_neon;
+    kernels.uint16_to_float = uint16_to_float_row_neon;
+    kernels.half_to_float = half_to_float_row_neon;
+    kernels.float_to_half = float_to_half_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const Float_row_kernels& get_float_row_kernels()
+{
+  static const Float_row_kernels kernels = select_float_row_kernels();
+  return kernels;
+}
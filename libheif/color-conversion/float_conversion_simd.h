@@ -0,0 +1,185 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_FLOAT_CONVERSION_SIMD_H
+#define LIBHEIF_COLORCONVERSION_FLOAT_CONVERSION_SIMD_H
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include "cpu_features.h"
+
+
+// --- Per-sample conversions between floating point and integer samples.
+//
+// The scalar code in float_conversion.cc and the SIMD row kernels below compute exactly these expressions.
+// Rounding is to the nearest integer, ties to even (the default floating point rounding mode).
+
+// in * scale, clamped to [0, max_value]. NaN gives 0.
+inline uint32_t float_to_uint_sample(float in, float scale, float max_value)
+{
+  float v = in * scale;
+  if (!(v > 0.0f)) {
+    return 0;
+  }
+
+  if (v > max_value) {
+    v = max_value;
+  }
+
+  return static_cast<uint32_t>(std::nearbyint(v));
+}
+
+
+inline float half_to_float(uint16_t h)
+{
+  uint32_t sign = uint32_t{h & 0x8000U} << 16;
+  uint32_t exponent = (h >> 10) & 0x1F;
+  uint32_t mantissa = h & 0x3FF;
+
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    // infinity or NaN
+    bits = sign | 0x7F800000U | (mantissa << 13);
+  }
+  else if (exponent != 0) {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+  else {
+    // zero or subnormal: mantissa * 2^-24
+    float v = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+    memcpy(&bits, &v, sizeof(bits));
+    bits |= sign;
+  }
+
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+
+inline uint16_t float_to_half(float f)
+{
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+
+  auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t abs = bits & 0x7FFFFFFF;
+
+  if (abs > 0x7F800000) {
+    // NaN, keep it a (quiet) NaN
+    return static_cast<uint16_t>(sign | 0x7E00 | ((abs >> 13) & 0x3FF));
+  }
+
+  // 65520 and larger values round to infinity
+  if (abs >= 0x477FF000) {
+    return static_cast<uint16_t>(sign | 0x7C00);
+  }
+
+  // values below 2^-14 are subnormal halfs, in units of 2^-24
+  if (abs < 0x38800000) {
+    float v;
+    memcpy(&v, &abs, sizeof(v));
+    return static_cast<uint16_t>(sign | static_cast<uint16_t>(std::nearbyint(v * 16777216.0f)));
+  }
+
+  // rebias the exponent and round the mantissa. A carry into the exponent is correct.
+  uint32_t h = (abs >> 13) - ((127 - 15) << 10);
+  uint32_t rest = abs & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+    h++;
+  }
+
+  return static_cast<uint16_t>(sign | h);
+}
+
+
+// Row kernels (see cpu_features.h). They return the number of processed samples.
+
+typedef uint32_t (*Float_to_uint8_row_kernel)(const float* in, uint8_t* out, uint32_t width, float scale, float max_value);
+
+typedef uint32_t (*Float_to_uint16_row_kernel)(const float* in, uint16_t* out, uint32_t width, float scale, float max_value);
+
+// in * scale
+typedef uint32_t (*Uint8_to_float_row_kernel)(const uint8_t* in, float* out, uint32_t width, float scale);
+
+typedef uint32_t (*Uint16_to_float_row_kernel)(const uint16_t* in, float* out, uint32_t width, float scale);
+
+typedef uint32_t (*Half_to_float_row_kernel)(const uint16_t* in, float* out, uint32_t width);
+
+typedef uint32_t (*Float_to_half_row_kernel)(const float* in, uint16_t* out, uint32_t width);
+
+
+struct Float_row_kernels
+{
+  Float_to_uint8_row_kernel float_to_uint8 = nullptr;
+  Float_to_uint16_row_kernel float_to_uint16 = nullptr;
+  Uint8_to_float_row_kernel uint8_to_float = nullptr;
+  Uint16_to_float_row_kernel uint16_to_float = nullptr;
+  Half_to_float_row_kernel half_to_float = nullptr;
+  Float_to_half_row_kernel float_to_half = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t float_to_uint8_row_sse41(const float* in, uint8_t* out, uint32_t width, float scale, float max_value);
+
+uint32_t float_to_uint16_row_sse41(const float* in, uint16_t* out, uint32_t width, float scale, float max_value);
+
+uint32_t uint8_to_float_row_sse41(const uint8_t* in, float* out, uint32_t width, float scale);
+
+uint32_t uint16_to_float_row_sse41(const uint16_t* in, float* out, uint32_t width, float scale);
+
+uint32_t float_to_uint8_row_avx2(const float* in, uint8_t* out, uint32_t width, float scale, float max_value);
+
+uint32_t float_to_uint16_row_avx2(const float* in, uint16_t* out, uint32_t width, float scale, float max_value);
+
+uint32_t uint8_to_float_row_avx2(const uint8_t* in, float* out, uint32_t width, float scale);
+
+uint32_t uint16_to_float_row_avx2(const uint16_t* in, float* out, uint32_t width, float scale);
+
+// F16C. All CPUs with AVX2 support it.
+uint32_t half_to_float_row_f16c(const uint16_t* in, float* out, uint32_t width);
+
+uint32_t float_to_half_row_f16c(const float* in, uint16_t* out, uint32_t width);
+
+#endif
+
+#if HEIF_HAVE_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+
+uint32_t float_to_uint8_row_neon(const float* in, uint8_t* out, uint32_t width, float scale, float max_value);
+
+uint32_t float_to_uint16_row_neon(const float* in, uint16_t* out, uint32_t width, float scale, float max_value);
+
+uint32_t uint8_to_float_row_neon(const uint8_t* in, float* out, uint32_t width, float scale);
+
+uint32_t uint16_to_float_row_neon(const uint16_t* in, float* out, uint32_t width, float scale);
+
+uint32_t half_to_float_row_neon(const uint16_t* in, float* out, uint32_t width);
+
+uint32_t float_to_half_row_neon(const float* in, uint16_t* out, uint32_t width);
+
+#endif
+
+
+const Float_row_kernels& get_float_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_FLOAT_CONVERSION_SIMD_H
@@ -0,0 +1,374 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gain_map.h"
+#include "gain_map_simd.h"
+#include "colorconversion.h"
+#include "nclx.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+float get_hdr_headroom_from_metadata(const HeifPixelImage& image, float fallback)
+{
+  double peak_luminance;
+
+  // mdcv luminance is stored in units of 0.0001 cd/m^2, values outside of [5;10000] cd/m^2 are undefined
+  uint32_t mdcv_max = image.has_mdcv() ? image.get_mdcv().max_display_mastering_luminance : 0;
+
+  if (mdcv_max >= 50000 && mdcv_max <= 100000000) {
+    peak_luminance = mdcv_max * 0.0001;
+  }
+  else if (image.get_clli().max_content_light_level > 0) {
+    peak_luminance = image.get_clli().max_content_light_level;
+  }
+  else {
+    return fallback;
+  }
+
+  return std::max(0.0f, (float) std::log2(peak_luminance / kSDRReferenceWhite));
+}
+
+
+static bool is_supported_transfer_characteristics(uint16_t tc)
+{
+  switch (tc) {
+    case heif_transfer_characteristic_ITU_R_BT_709_5:
+    case heif_transfer_characteristic_ITU_R_BT_470_6_System_M:
+    case heif_transfer_characteristic_ITU_R_BT_470_6_System_B_G:
+    case heif_transfer_characteristic_ITU_R_BT_601_6:
+    case heif_transfer_characteristic_linear:
+    case heif_transfer_characteristic_IEC_61966_2_1:
+    case heif_transfer_characteristic_ITU_R_BT_2020_2_10bit:
+    case heif_transfer_characteristic_ITU_R_BT_2020_2_12bit:
+    case heif_transfer_characteristic_ITU_R_BT_2100_0_PQ:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+// Converts a normalized sample value to linear light, where 1.0 is the SDR reference white.
+static float transfer_to_linear(float v, uint16_t tc)
+{
+  switch (tc) {
+    case heif_transfer_characteristic_linear:
+      return v;
+
+    case heif_transfer_characteristic_IEC_61966_2_1:
+      return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+
+    case heif_transfer_characteristic_ITU_R_BT_470_6_System_M:
+      return std::pow(v, 2.2f);
+
+    case heif_transfer_characteristic_ITU_R_BT_470_6_System_B_G:
+      return std::pow(v, 2.8f);
+
+    case heif_transfer_characteristic_ITU_R_BT_2100_0_PQ: {
+      const float m1 = 0.1593017578125f;
+      const float m2 = 78.84375f;
+      const float c1 = 0.8359375f;
+      const float c2 = 18.8515625f;
+      const float c3 = 18.6875f;
+
+      float vp = std::pow(v, 1.0f / m2);
+      float nits = 10000.0f * std::pow(std::max(vp - c1, 0.0f) / (c2 - c3 * vp), 1.0f / m1);
+      return nits / kSDRReferenceWhite;
+    }
+
+    default:
+      // BT.709, BT.601 and BT.2020 share the same transfer function
+      return v < 0.081f ? v / 4.5f : std::pow((v + 0.099f) / 1.099f, 1.0f / 0.45f);
+  }
+}
+
+
+// Weight of the gain map for the target headroom as specified in ISO 21496-1.
+// This also works for HDR base images, for which the alternate headroom is smaller than the base headroom.
+static float gain_map_weight(const heif_gain_map_parameters& params, float target_hdr_headroom)
+{
+  float range = params.alternate_hdr_headroom - params.base_hdr_headroom;
+  if (range == 0.0f) {
+    return 0.0f;
+  }
+
+  float w = (target_hdr_headroom - params.base_hdr_headroom) / range;
+  return std::min(std::max(w, 0.0f), 1.0f);
+}
+
+
+template <typename T>
+static const T* get_row(const HeifPixelImage& image, heif_channel channel, uint32_t y)
+{
+  size_t stride;
+  const uint8_t* p = image.get_plane(channel, &stride);
+  return reinterpret_cast<const T*>(p + y * stride);
+}
+
+
+template <typename T>
+static void lookup_row(const T* in, const std::vector<float>& lut, float* out, uint32_t width)
+{
+  const uint32_t max_index = static_cast<uint32_t>(lut.size() - 1);
+
+  for (uint32_t x = 0; x < width; x++) {
+    out[x] = lut[std::min(static_cast<uint32_t>(in[x]), max_index)];
+  }
+}
+
+
+// Looks up the gain factors of gain map row 'y0' and 'y1' and blends them vertically.
+template <typename T>
+static void gain_row_vertical(const HeifPixelImage& gain_map, heif_channel channel, uint32_t y0, uint32_t y1, float fy,
+                              const std::vector<float>& lut, float* tmp0, float* tmp1, float* out)
+{
+  uint32_t width = gain_map.get_width();
+
+  lookup_row(get_row<T>(gain_map, channel, y0), lut, tmp0, width);
+  lookup_row(get_row<T>(gain_map, channel, y1), lut, tmp1, width);
+
+  for (uint32_t x = 0; x < width; x++) {
+    out[x] = tmp0[x] + (tmp1[x] - tmp0[x]) * fy;
+  }
+}
+
+
+// Bilinear sample positions for scaling 'in_size' samples to 'out_size' samples with centered pixels.
+static void compute_sample_position(uint32_t pos, uint32_t in_size, uint32_t out_size,
+                                    uint32_t& p0, uint32_t& p1, float& frac)
+{
+  float p = ((float) pos + 0.5f) * (float) in_size / (float) out_size - 0.5f;
+  p = std::min(std::max(p, 0.0f), (float) (in_size - 1));
+
+  p0 = static_cast<uint32_t>(p);
+  p1 = std::min(p0 + 1, in_size - 1);
+  frac = p - (float) p0;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> apply_gain_map(const std::shared_ptr<const HeifPixelImage>& base,
+                                                       const std::shared_ptr<const HeifPixelImage>& gain_map,
+                                                       const heif_gain_map_parameters& params,
+                                                       float target_hdr_headroom,
+                                                       const heif_security_limits* limits)
+{
+  for (int c = 0; c < 3; c++) {
+    if (!(params.gamma[c] > 0.0f)) {
+      return Error{heif_error_Usage_error,
+                   heif_suberror_Invalid_parameter_value,
+                   "Gain map gamma must be positive"};
+    }
+  }
+
+  if (target_hdr_headroom < 0.0f) {
+    target_hdr_headroom = get_hdr_headroom_from_metadata(*base, std::max(params.base_hdr_headroom,
+                                                                         params.alternate_hdr_headroom));
+  }
+
+
+  // --- bring the inputs into planar formats (a no-op when they are already planar RGB or monochrome)
+
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  auto baseResult = convert_colorspace(base, heif_colorspace_RGB, heif_chroma_444, nullptr, 0, options, nullptr, limits);
+  if (!baseResult) {
+    return baseResult.error;
+  }
+  std::shared_ptr<const HeifPixelImage> rgb = *baseResult;
+
+  std::shared_ptr<const HeifPixelImage> gain = gain_map;
+  int num_gain_channels = 1;
+  if (gain_map->get_colorspace() != heif_colorspace_monochrome) {
+    auto gainResult = convert_colorspace(gain_map, heif_colorspace_RGB, heif_chroma_444, nullptr, 0, options, nullptr, limits);
+    if (!gainResult) {
+      return gainResult.error;
+    }
+    gain = *gainResult;
+    num_gain_channels = 3;
+  }
+
+  const heif_channel color_channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+  const heif_channel gain_channels[3] = {
+    num_gain_channels == 1 ? heif_channel_Y : heif_channel_R,
+    heif_channel_G,
+    heif_channel_B
+  };
+
+
+  // --- lookup tables for linearizing the base image and for the gain factors
+
+  color_profile_nclx nclx;
+  if (rgb->get_color_profile_nclx()) {
+    nclx = *rgb->get_color_profile_nclx();
+  }
+  nclx.replace_undefined_values_with_sRGB_defaults();
+
+  uint16_t tc = nclx.get_transfer_characteristics();
+  if (!is_supported_transfer_characteristics(tc)) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_color_conversion,
+                 "Transfer characteristics of the base image are not supported for applying a gain map"};
+  }
+
+  int base_bpp = rgb->get_bits_per_pixel(heif_channel_R);
+  std::vector<float> base_lut(size_t{1} << base_bpp);
+  for (size_t i = 0; i < base_lut.size(); i++) {
+    base_lut[i] = transfer_to_linear((float) i / (float) (base_lut.size() - 1), tc);
+  }
+
+  float weight = gain_map_weight(params, target_hdr_headroom);
+
+  int gain_bpp = gain->get_bits_per_pixel(gain_channels[0]);
+  std::vector<float> gain_lut[3];
+  for (int c = 0; c < num_gain_channels; c++) {
+    gain_lut[c].resize(size_t{1} << gain_bpp);
+    for (size_t i = 0; i < gain_lut[c].size(); i++) {
+      float g = (float) i / (float) (gain_lut[c].size() - 1);
+      float log2_gain = std::pow(g, 1.0f / params.gamma[c]) * (params.gain_map_max[c] - params.gain_map_min[c]) + params.gain_map_min[c];
+      gain_lut[c][i] = std::exp2(log2_gain * weight);
+    }
+  }
+
+
+  // --- output image
+
+  uint32_t width = rgb->get_width();
+  uint32_t height = rgb->get_height();
+
+  auto out = std::make_shared<HeifPixelImage>();
+  out->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+
+  for (heif_channel channel : color_channels) {
+    if (auto err = out->add_plane(channel, width, height, 16, limits)) {
+      return err;
+    }
+  }
+
+  bool has_alpha = rgb->has_channel(heif_channel_Alpha);
+  if (has_alpha) {
+    if (auto err = out->add_plane(heif_channel_Alpha, width, height, 16, limits)) {
+      return err;
+    }
+    out->set_premultiplied_alpha(rgb->is_premultiplied_alpha());
+  }
+
+  auto out_nclx = std::make_shared<color_profile_nclx>(nclx);
+  out_nclx->set_transfer_characteristics(heif_transfer_characteristic_linear);
+  out_nclx->set_matrix_coefficients(heif_matrix_coefficients_RGB_GBR);
+  out_nclx->set_full_range_flag(true);
+  out->set_color_profile_nclx(out_nclx);
+
+  heif_content_light_level clli{};
+  clli.max_content_light_level = (uint16_t) std::min(65535.0f, std::round(kSDRReferenceWhite * std::exp2(target_hdr_headroom)));
+  out->set_clli(clli);
+
+  const float scale = 65535.0f / std::exp2(target_hdr_headroom);
+
+
+  // --- the gain map is scaled on the fly with these sample positions
+
+  uint32_t gain_width = gain->get_width();
+  uint32_t gain_height = gain->get_height();
+
+  std::vector<uint32_t> gx0(width), gx1(width);
+  std::vector<float> gfx(width);
+  for (uint32_t x = 0; x < width; x++) {
+    compute_sample_position(x, gain_width, width, gx0[x], gx1[x], gfx[x]);
+  }
+
+  std::vector<float> tmp0(gain_width), tmp1(gain_width), gain_vertical(gain_width);
+  std::vector<float> gain_row[3];
+  for (int c = 0; c < num_gain_channels; c++) {
+    gain_row[c].resize(width);
+  }
+  std::vector<float> base_row(width);
+
+  Gain_map_row_kernel kernel = get_gain_map_row_kernel();
+
+  for (uint32_t y = 0; y < height; y++) {
+    uint32_t gy0, gy1;
+    float fy;
+    compute_sample_position(y, gain_height, height, gy0, gy1, fy);
+
+    for (int c = 0; c < num_gain_channels; c++) {
+      if (gain_bpp <= 8) {
+        gain_row_vertical<uint8_t>(*gain, gain_channels[c], gy0, gy1, fy, gain_lut[c], tmp0.data(), tmp1.data(), gain_vertical.data());
+      }
+      else {
+        gain_row_vertical<uint16_t>(*gain, gain_channels[c], gy0, gy1, fy, gain_lut[c], tmp0.data(), tmp1.data(), gain_vertical.data());
+      }
+
+      float* g = gain_row[c].data();
+      for (uint32_t x = 0; x < width; x++) {
+        float g0 = gain_vertical[gx0[x]];
+        g[x] = g0 + (gain_vertical[gx1[x]] - g0) * gfx[x];
+      }
+    }
+
+    for (int c = 0; c < 3; c++) {
+      if (base_bpp <= 8) {
+        lookup_row(get_row<uint8_t>(*rgb, color_channels[c], y), base_lut, base_row.data(), width);
+      }
+      else {
+        lookup_row(get_row<uint16_t>(*rgb, color_channels[c], y), base_lut, base_row.data(), width);
+      }
+
+      const float* g = gain_row[num_gain_channels == 1 ? 0 : c].data();
+      size_t out_stride;
+      uint16_t* o = out->get_channel<uint16_t>(color_channels[c], &out_stride) + y * out_stride;
+
+      uint32_t x = 0;
+      if (kernel) {
+        x = kernel(base_row.data(), g, o, width, params.base_offset[c], params.alternate_offset[c], scale);
+      }
+
+      for (; x < width; x++) {
+        float v = ((base_row[x] + params.base_offset[c]) * g[x] - params.alternate_offset[c]) * scale + 0.5f;
+        o[x] = static_cast<uint16_t>(std::min(std::max(v, 0.0f), 65535.0f));
+      }
+    }
+
+    if (has_alpha) {
+      int alpha_bpp = rgb->get_bits_per_pixel(heif_channel_Alpha);
+      uint32_t alpha_max = (1U << alpha_bpp) - 1;
+
+      size_t out_stride;
+      uint16_t* o = out->get_channel<uint16_t>(heif_channel_Alpha, &out_stride) + y * out_stride;
+
+      if (alpha_bpp <= 8) {
+        const uint8_t* a = get_row<uint8_t>(*rgb, heif_channel_Alpha, y);
+        for (uint32_t x = 0; x < width; x++) {
+          o[x] = static_cast<uint16_t>((a[x] * 65535U + alpha_max / 2) / alpha_max);
+        }
+      }
+      else {
+        const uint16_t* a = get_row<uint16_t>(*rgb, heif_channel_Alpha, y);
+        for (uint32_t x = 0; x < width; x++) {
+          o[x] = static_cast<uint16_t>((std::min<uint32_t>(a[x], alpha_max) * 65535U + alpha_max / 2) / alpha_max);
+        }
+      }
+    }
+  }
+
+  return out;
+}
@@ -0,0 +1,50 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_GAIN_MAP_H
+#define LIBHEIF_COLORCONVERSION_GAIN_MAP_H
+
+#include "pixelimage.h"
+#include "error.h"
+#include <libheif/heif_color.h>
+#include <memory>
+
+
+// Reference white of SDR content in HDR signals (ITU-R BT.2408).
+constexpr float kSDRReferenceWhite = 203.0f;
+
+// HDR headroom (log2 of the peak luminance relative to the SDR reference white) that is described by the
+// mdcv or clli metadata of the image. Returns 'fallback' if the image has neither.
+float get_hdr_headroom_from_metadata(const HeifPixelImage& image, float fallback);
+
+// Combines the base image with the gain map into an image for a display with the given HDR headroom (log2).
+//
+// All of this is done in a single pass over the rows of the base image. The gain map is bilinearly scaled
+// to the size of the base image on the fly. The samples of the base image are linearized with a table
+// that is selected by its nclx transfer characteristics.
+//
+// The output is a planar RGB image with 16 bit linear samples, where 65535 corresponds to the target headroom.
+Result<std::shared_ptr<HeifPixelImage>> apply_gain_map(const std::shared_ptr<const HeifPixelImage>& base,
+                                                       const std::shared_ptr<const HeifPixelImage>& gain_map,
+                                                       const heif_gain_map_parameters& params,
+                                                       float target_hdr_headroom,
+                                                       const heif_security_limits* limits);
+
+#endif //LIBHEIF_COLORCONVERSION_GAIN_MAP_H
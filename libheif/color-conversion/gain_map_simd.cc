@@ -0,0 +1,170 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gain_map_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+HEIF_TARGET_SSE41
+static inline __m128i apply_gain_4_sse41(const float* base, const float* gain,
+                                         __m128 bo, __m128 ao, __m128 s, __m128 half, __m128 maxval)
+{
+  __m128 v = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(base), bo), _mm_loadu_ps(gain)), ao);
+  v = _mm_add_ps(_mm_mul_ps(v, s), half);
+
+  // Clamp before the conversion, out-of-range values would be converted to 0x80000000.
+  v = _mm_max_ps(_mm_min_ps(v, maxval), _mm_setzero_ps());
+  return _mm_cvttps_epi32(v);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t apply_gain_row_sse41(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                              float base_offset, float alternate_offset, float scale)
+{
+  const __m128 bo = _mm_set1_ps(base_offset);
+  const __m128 ao = _mm_set1_ps(alternate_offset);
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 maxval = _mm_set1_ps(65535.0f);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i lo = apply_gain_4_sse41(base + x, gain + x, bo, ao, s, half, maxval);
+    __m128i hi = apply_gain_4_sse41(base + x + 4, gain + x + 4, bo, ao, s, half, maxval);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi32(lo, hi));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+static inline __m256i apply_gain_8_avx2(const float* base, const float* gain,
+                                        __m256 bo, __m256 ao, __m256 s, __m256 half, __m256 maxval)
+{
+  __m256 v = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(base), bo), _mm256_loadu_ps(gain)), ao);
+  v = _mm256_add_ps(_mm256_mul_ps(v, s), half);
+  v = _mm256_max_ps(_mm256_min_ps(v, maxval), _mm256_setzero_ps());
+  return _mm256_cvttps_epi32(v);
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t apply_gain_row_avx2(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                             float base_offset, float alternate_offset, float scale)
+{
+  const __m256 bo = _mm256_set1_ps(base_offset);
+  const __m256 ao = _mm256_set1_ps(alternate_offset);
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 maxval = _mm256_set1_ps(65535.0f);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i lo = apply_gain_8_avx2(base + x, gain + x, bo, ao, s, half, maxval);
+    __m256i hi = apply_gain_8_avx2(base + x + 8, gain + x + 8, bo, ao, s, half, maxval);
+
+    // packus works within the 128-bit lanes, restore the sample order
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8));
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+static inline uint16x4_t apply_gain_4_neon(const float* base, const float* gain,
+                                           float32x4_t bo, float32x4_t ao, float32x4_t s, float32x4_t half)
+{
+  float32x4_t v = vsubq_f32(vmulq_f32(vaddq_f32(vld1q_f32(base), bo), vld1q_f32(gain)), ao);
+  v = vaddq_f32(vmulq_f32(v, s), half);
+
+  // The conversion saturates negative values to 0 and the narrowing saturates at 65535.
+  return vqmovn_u32(vcvtq_u32_f32(v));
+}
+
+
+uint32_t apply_gain_row_neon(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                             float base_offset, float alternate_offset, float scale)
+{
+  const float32x4_t bo = vdupq_n_f32(base_offset);
+  const float32x4_t ao = vdupq_n_f32(alternate_offset);
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x4_t lo = apply_gain_4_neon(base + x, gain + x, bo, ao, s, half);
+    uint16x4_t hi = apply_gain_4_neon(base + x + 4, gain + x + 4, bo, ao, s, half);
+
+    vst1q_u16(out + x, vcombine_u16(lo, hi));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Gain_map_row_kernel select_gain_map_row_kernel()
+{
+  Gain_map_row_kernel kernel = nullptr;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernel = apply_gain_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernel = apply_gain_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernel = apply_gain_row_neon;
+  }
+#endif
+
+  return kernel;
+}
+
+
+Gain_map_row_kernel get_gain_map_row_kernel()
+{
+  static const Gain_map_row_kernel kernel = select_gain_map_row_kernel();
+  return kernel;
+}
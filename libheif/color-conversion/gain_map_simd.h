@@ -0,0 +1,58 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_GAIN_MAP_SIMD_H
+#define LIBHEIF_COLORCONVERSION_GAIN_MAP_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// Row kernel that applies the gain to a row of linear samples and quantizes the result to 16 bit:
+//
+//   out = clamp(((base + base_offset) * gain - alternate_offset) * scale + 0.5, 0, 65535)
+//
+// It returns the number of processed samples (see "Row kernels" in cpu_features.h).
+typedef uint32_t (*Gain_map_row_kernel)(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                                        float base_offset, float alternate_offset, float scale);
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t apply_gain_row_sse41(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                              float base_offset, float alternate_offset, float scale);
+
+uint32_t apply_gain_row_avx2(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                             float base_offset, float alternate_offset, float scale);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t apply_gain_row_neon(const float* base, const float* gain, uint16_t* out, uint32_t width,
+                             float base_offset, float alternate_offset, float scale);
+
+#endif
+
+
+// The fastest kernel supported by the CPU, or NULL if there is none.
+Gain_map_row_kernel get_gain_map_row_kernel();
+
+#endif //LIBHEIF_COLORCONVERSION_GAIN_MAP_SIMD_H
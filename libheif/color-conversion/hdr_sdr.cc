@@ -18,8 +18,48 @@
  * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include "hdr_sdr.h"
+#include "hdr_sdr_simd.h"
+
+
+void reduce_row_to_8bit(const uint16_t* in, uint8_t* out, uint32_t width, int input_bits,
+                        heif_bit_depth_reduction_method method, uint32_t y)
+{
+  const int shift = input_bits - 8;
+  assert(shift > 0);
+
+  uint16_t offsets[2] = {0, 0};
+
+  switch (method) {
+    case heif_bit_depth_reduction_method_round:
+      offsets[0] = offsets[1] = static_cast<uint16_t>(1 << (shift - 1));
+      break;
+    case heif_bit_depth_reduction_method_dither: {
+      // 2x2 Bayer matrix, centered in the range of the dropped bits
+      static const int bayer[2][2] = {{0, 2},
+                                      {3, 1}};
+      for (int x = 0; x < 2; x++) {
+        offsets[x] = static_cast<uint16_t>(((2 * bayer[y & 1][x] + 1) << shift) >> 3);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  uint32_t x = 0;
+  if (auto kernel = get_bit_depth_row_kernels().narrow) {
+    x = kernel(in, out, width, shift, offsets[0], offsets[1]);
+  }
+
+  for (; x < width; x++) {
+    uint32_t v = std::min(uint32_t{in[x]} + offsets[x & 1], 0xFFFFU) >> shift;
+    out[x] = static_cast<uint8_t>(std::min(v, 255U));
+  }
+}
+
 
 
 std::vector<ColorStateWithCost>
@@ -45,7 +85,7 @@ Op_to_hdr_planes::state_after_conversion(const ColorState& input_state,
   output_state = input_state;
   output_state.bits_per_pixel = target_state.bits_per_pixel;
 
-  states.emplace_back(output_state, SpeedCosts_Unoptimized);
+  states.emplace_back(output_state, get_bit_depth_row_kernels().widen ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
 
   return states;
 }
@@ -74,15 +114,24 @@ Op_to_hdr_planes::convert_colorspace(const std::shared_ptr<const HeifPixelImage>
                                heif_channel_B,
                                heif_channel_Alpha}) {
     if (input->has_channel(channel)) {
+      int input_bits = input->get_bits_per_pixel(channel);
+      int output_bits = target_state.bits_per_pixel;
+
+      // e.g. an alpha plane that already has the target bit depth
+      if (input_bits == output_bits) {
+        if (auto err = outimg->share_plane_from(input, channel, channel)) {
+          return err;
+        }
+
+        continue;
+      }
+
       uint32_t width = input->get_width(channel);
       uint32_t height = input->get_height(channel);
-      if (auto err = outimg->add_plane(channel, width, height, target_state.bits_per_pixel, limits)) {
+      if (auto err = outimg->add_plane(channel, width, height, output_bits, limits)) {
         return err;
       }
 
-      int input_bits = input->get_bits_per_pixel(channel);
-      int output_bits = target_state.bits_per_pixel;
-
       int shift1 = output_bits - input_bits;
       int shift2 = 2 * input_bits - output_bits;
 
@@ -95,12 +144,20 @@ Op_to_hdr_planes::convert_colorspace(const std::shared_ptr<const HeifPixelImage>
       p_out = (uint16_t*) outimg->get_plane(channel, &stride_out);
       stride_out /= 2;
 
-      for (uint32_t y = 0; y < height; y++)
-        for (uint32_t x = 0; x < width; x++) {
+      Widen_8_to_16_row_kernel kernel = get_bit_depth_row_kernels().widen;
+
+      for (uint32_t y = 0; y < height; y++) {
+        uint32_t x = 0;
+        if (kernel) {
+          x = kernel(p_in + y * stride_in, p_out + y * stride_out, width, output_bits);
+        }
+
+        for (; x < width; x++) {
           int in = p_in[y * stride_in + x];
           // TODO: support for <8 bpp may need more than two copies of the input bit pattern
           p_out[y * stride_out + x] = (uint16_t) ((in << shift1) | (in >> shift2));
         }
+      }
     }
   }
 
@@ -135,7 +192,7 @@ Op_to_sdr_planes::state_after_conversion(const ColorState& input_state,
   output_state = input_state;
   output_state.bits_per_pixel = 8;
 
-  states.emplace_back(output_state, SpeedCosts_Unoptimized);
+  states.emplace_back(output_state, get_bit_depth_row_kernels().narrow ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
 
   return states;
 }
@@ -174,22 +231,16 @@ Op_to_sdr_planes::convert_colorspace(const std::shared_ptr<const HeifPixelImage>
           return err;
         }
 
-        int shift = input_bits - 8;
-
-        const uint16_t* p_in;
         size_t stride_in;
-        p_in = (uint16_t*) input->get_plane(channel, &stride_in);
-        stride_in /= 2;
+        const uint16_t* p_in = input->get_channel<uint16_t>(channel, &stride_in);
 
-        uint8_t* p_out;
         size_t stride_out;
-        p_out = outimg->get_plane(channel, &stride_out);
+        uint8_t* p_out = outimg->get_plane(channel, &stride_out);
 
-        for (uint32_t y = 0; y < height; y++)
-          for (uint32_t x = 0; x < width; x++) {
-            int in = p_in[y * stride_in + x];
-            p_out[y * stride_out + x] = (uint8_t) (in >> shift); // TODO: I think no rounding here, but am not sure.
-          }
+        for (uint32_t y = 0; y < height; y++) {
+          reduce_row_to_8bit(p_in + y * stride_in, p_out + y * stride_out, width, input_bits,
+                             options_ext.bit_depth_reduction_method, y);
+        }
       } else if (input_bits < 8) {
         uint32_t width = input->get_width(channel);
         uint32_t height = input->get_height(channel);
@@ -232,8 +283,8 @@ Op_to_sdr_planes::convert_colorspace(const std::shared_ptr<const HeifPixelImage>
             int in = p_in[y * stride_in + x];
             p_out[y * stride_out + x] = (uint8_t) ((in * mulFactor) >> 8);
           }
-      } else {
-        outimg->copy_new_plane_from(input, channel, channel, limits);
+      } else if (auto err = outimg->share_plane_from(input, channel, channel)) {
+        return err;
       }
     }
   }
@@ -26,6 +26,13 @@
 #include <vector>
 #include <memory>
 
+
+// Reduces a row of 'input_bits' (9-16) samples to 8 bits with the given method.
+// 'y' is the row number in the plane. It selects the row of the dither pattern.
+void reduce_row_to_8bit(const uint16_t* in, uint8_t* out, uint32_t width, int input_bits,
+                        heif_bit_depth_reduction_method method, uint32_t y);
+
+
 class Op_to_hdr_planes : public ColorConversionOperation
 {
 public:
@@ -61,6 +68,12 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const override;
+
+  // The dither pattern depends on the absolute row position.
+  bool supports_strip_processing(const heif_color_conversion_options_ext& options_ext) const override
+  {
+    return options_ext.bit_depth_reduction_method != heif_bit_depth_reduction_method_dither;
+  }
 };
 
 #endif //LIBHEIF_COLORCONVERSION_HDR_SDR_H
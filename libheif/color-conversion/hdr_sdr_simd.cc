@@ -0,0 +1,198 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hdr_sdr_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+HEIF_TARGET_SSE41
+uint32_t widen_8_to_16_row_sse41(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i shift1 = _mm_cvtsi32_si128(output_bits - 8);
+  const __m128i shift2 = _mm_cvtsi32_si128(16 - output_bits);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+    _mm_storeu_si128((__m128i*) (out + x), _mm_or_si128(_mm_sll_epi16(lo, shift1), _mm_srl_epi16(lo, shift2)));
+    _mm_storeu_si128((__m128i*) (out + x + 8), _mm_or_si128(_mm_sll_epi16(hi, shift1), _mm_srl_epi16(hi, shift2)));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t narrow_16_to_8_row_sse41(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                  uint16_t offset_even, uint16_t offset_odd)
+{
+  const __m128i offsets = _mm_set1_epi32(static_cast<int32_t>(offset_even | (uint32_t{offset_odd} << 16)));
+  const __m128i s = _mm_cvtsi32_si128(shift);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i lo = _mm_loadu_si128((const __m128i*) (in + x));
+    __m128i hi = _mm_loadu_si128((const __m128i*) (in + x + 8));
+
+    lo = _mm_srl_epi16(_mm_adds_epu16(lo, offsets), s);
+    hi = _mm_srl_epi16(_mm_adds_epu16(hi, offsets), s);
+
+    // The shift is at least 1, hence the values are non-negative int16 and the packing saturates them to 255.
+    _mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+uint32_t widen_8_to_16_row_avx2(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits)
+{
+  const __m128i shift1 = _mm_cvtsi32_si128(output_bits - 8);
+  const __m128i shift2 = _mm_cvtsi32_si128(16 - output_bits);
+
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x)));
+    __m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in + x + 16)));
+
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_or_si256(_mm256_sll_epi16(lo, shift1), _mm256_srl_epi16(lo, shift2)));
+    _mm256_storeu_si256((__m256i*) (out + x + 16), _mm256_or_si256(_mm256_sll_epi16(hi, shift1), _mm256_srl_epi16(hi, shift2)));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t narrow_16_to_8_row_avx2(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                 uint16_t offset_even, uint16_t offset_odd)
+{
+  const __m256i offsets = _mm256_set1_epi32(static_cast<int32_t>(offset_even | (uint32_t{offset_odd} << 16)));
+  const __m128i s = _mm_cvtsi32_si128(shift);
+
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*) (in + x));
+    __m256i hi = _mm256_loadu_si256((const __m256i*) (in + x + 16));
+
+    lo = _mm256_srl_epi16(_mm256_adds_epu16(lo, offsets), s);
+    hi = _mm256_srl_epi16(_mm256_adds_epu16(hi, offsets), s);
+
+    // packus works within the 128-bit lanes, restore the sample order
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+uint32_t widen_8_to_16_row_neon(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits)
+{
+  const int16x8_t shift1 = vdupq_n_s16(static_cast<int16_t>(output_bits - 8));
+  const int16x8_t shift2 = vdupq_n_s16(static_cast<int16_t>(output_bits - 16)); // negative: right shift
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t v = vld1q_u8(in + x);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+    vst1q_u16(out + x, vorrq_u16(vshlq_u16(lo, shift1), vshlq_u16(lo, shift2)));
+    vst1q_u16(out + x + 8, vorrq_u16(vshlq_u16(hi, shift1), vshlq_u16(hi, shift2)));
+  }
+
+  return x;
+}
+
+
+uint32_t narrow_16_to_8_row_neon(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                 uint16_t offset_even, uint16_t offset_odd)
+{
+  const uint16_t offset_pattern[8] = {offset_even, offset_odd, offset_even, offset_odd,
+                                      offset_even, offset_odd, offset_even, offset_odd};
+  const uint16x8_t offsets = vld1q_u16(offset_pattern);
+  const int16x8_t s = vdupq_n_s16(static_cast<int16_t>(-shift));
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint16x8_t lo = vshlq_u16(vqaddq_u16(vld1q_u16(in + x), offsets), s);
+    uint16x8_t hi = vshlq_u16(vqaddq_u16(vld1q_u16(in + x + 8), offsets), s);
+
+    vst1q_u8(out + x, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Bit_depth_row_kernels select_bit_depth_row_kernels()
+{
+  Bit_depth_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.widen = widen_8_to_16_row_avx2;
+    kernels.narrow = narrow_16_to_8_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.widen = widen_8_to_16_row_sse41;
+    kernels.narrow = narrow_16_to_8_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.widen = widen_8_to_16_row_neon;
+    kernels.narrow = narrow_16_to_8_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const Bit_depth_row_kernels& get_bit_depth_row_kernels()
+{
+  static const Bit_depth_row_kernels kernels = select_bit_depth_row_kernels();
+  return kernels;
+}
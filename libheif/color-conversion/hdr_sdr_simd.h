@@ -0,0 +1,74 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_HDR_SDR_SIMD_H
+#define LIBHEIF_COLORCONVERSION_HDR_SDR_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// Row kernels for changing the bit depth of planes (see cpu_features.h).
+// They return the number of processed samples.
+
+// 8 bit to 'output_bits' (9-16) by replicating the input bit pattern: (in << shift1) | (in >> shift2).
+typedef uint32_t (*Widen_8_to_16_row_kernel)(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits);
+
+// 9-16 bit to 8 bit: min((in + offset) >> shift, 255), where the addition saturates at 65535.
+// 'offset_even' is added to the samples at even x positions, 'offset_odd' to the samples at odd positions.
+// This covers truncation, rounding and ordered dithering with a pattern of width two.
+typedef uint32_t (*Narrow_16_to_8_row_kernel)(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                              uint16_t offset_even, uint16_t offset_odd);
+
+
+struct Bit_depth_row_kernels
+{
+  Widen_8_to_16_row_kernel widen = nullptr;
+  Narrow_16_to_8_row_kernel narrow = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t widen_8_to_16_row_sse41(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits);
+
+uint32_t narrow_16_to_8_row_sse41(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                  uint16_t offset_even, uint16_t offset_odd);
+
+uint32_t widen_8_to_16_row_avx2(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits);
+
+uint32_t narrow_16_to_8_row_avx2(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                 uint16_t offset_even, uint16_t offset_odd);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t widen_8_to_16_row_neon(const uint8_t* in, uint16_t* out, uint32_t width, int output_bits);
+
+uint32_t narrow_16_to_8_row_neon(const uint16_t* in, uint8_t* out, uint32_t width, int shift,
+                                 uint16_t offset_even, uint16_t offset_odd);
+
+#endif
+
+
+const Bit_depth_row_kernels& get_bit_depth_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_HDR_SDR_SIMD_H
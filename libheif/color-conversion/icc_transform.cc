@@ -0,0 +1,458 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "icc_transform.h"
+#include "common_utils.h"
+#include "nclx.h"
+
+#ifdef HAVE_LCMS2
+
+#include <lcms2.h>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+
+static uint64_t fnv1a_hash(const uint8_t* data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3;
+  }
+
+  return hash;
+}
+
+
+// --- Source profile of images without ICC profile
+
+static cmsToneCurve* create_tone_curve(uint16_t transfer_characteristics)
+{
+  switch (transfer_characteristics) {
+    case heif_transfer_characteristic_IEC_61966_2_1: {
+      const cmsFloat64Number params[5] = {2.4, 1.0 / 1.055, 0.055 / 1.055, 1.0 / 12.92, 0.04045};
+      return cmsBuildParametricToneCurve(nullptr, 4, params);
+    }
+    case heif_transfer_characteristic_ITU_R_BT_709_5:
+    case heif_transfer_characteristic_ITU_R_BT_601_6:
+    case heif_transfer_characteristic_ITU_R_BT_2020_2_10bit:
+    case heif_transfer_characteristic_ITU_R_BT_2020_2_12bit: {
+      const cmsFloat64Number params[5] = {1.0 / 0.45, 1.0 / 1.099, 0.099 / 1.099, 1.0 / 4.5, 0.081};
+      return cmsBuildParametricToneCurve(nullptr, 4, params);
+    }
+    case heif_transfer_characteristic_ITU_R_BT_470_6_System_M:
+      return cmsBuildGamma(nullptr, 2.2);
+    case heif_transfer_characteristic_ITU_R_BT_470_6_System_B_G:
+      return cmsBuildGamma(nullptr, 2.8);
+    case heif_transfer_characteristic_linear:
+      return cmsBuildGamma(nullptr, 1.0);
+    default:
+      // PQ and HLG cannot be described by a display-referred ICC v2/v4 matrix profile.
+      return nullptr;
+  }
+}
+
+
+static cmsHPROFILE create_profile_from_nclx(const color_profile_nclx& nclx)
+{
+  primaries p = get_colour_primaries(nclx.get_colour_primaries());
+  if (!p.defined) {
+    return nullptr;
+  }
+
+  cmsToneCurve* curve = create_tone_curve(nclx.get_transfer_characteristics());
+  if (!curve) {
+    return nullptr;
+  }
+
+  cmsCIExyY white{p.whiteX, p.whiteY, 1.0};
+  cmsCIExyYTRIPLE rgb{{p.redX, p.redY, 1.0},
+                      {p.greenX, p.greenY, 1.0},
+                      {p.blueX, p.blueY, 1.0}};
+  cmsToneCurve* curves[3] = {curve, curve, curve};
+
+  cmsHPROFILE profile = cmsCreateRGBProfile(&white, &rgb, curves);
+  cmsFreeToneCurve(curve);
+
+  return profile;
+}
+
+
+// --- Process-wide transform cache
+
+namespace {
+
+struct ProfileSource
+{
+  std::shared_ptr<const color_profile_raw> icc;
+  color_profile_nclx nclx;
+
+  uint64_t hash() const
+  {
+    if (icc) {
+      return fnv1a_hash(icc->get_data().data(), icc->get_data().size());
+    }
+
+    // tagged with the high bit, such that it does not collide with the ICC profiles
+    return (uint64_t{1} << 63) | (static_cast<uint64_t>(nclx.get_colour_primaries()) << 16) | nclx.get_transfer_characteristics();
+  }
+
+  cmsHPROFILE open() const
+  {
+    if (icc) {
+      return cmsOpenProfileFromMem(icc->get_data().data(), static_cast<cmsUInt32Number>(icc->get_data().size()));
+    }
+    else {
+      return create_profile_from_nclx(nclx);
+    }
+  }
+};
+
+// source profile hash, target profile hash, rendering intent, lcms pixel format
+using TransformKey = std::tuple<uint64_t, uint64_t, uint32_t, cmsUInt32Number>;
+
+std::map<TransformKey, std::shared_ptr<void>> transform_cache;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+std::mutex transform_cache_mutex;
+#endif
+
+// Transforms are large (they contain precomputed lookup tables), but the number of different profiles is usually small.
+const size_t MAX_TRANSFORM_CACHE_SIZE = 16;
+
+}
+
+
+static std::shared_ptr<void> get_transform(const ProfileSource& source, const color_profile_raw& target,
+                                           uint32_t intent, cmsUInt32Number format)
+{
+  TransformKey key{source.hash(),
+                   fnv1a_hash(target.get_data().data(), target.get_data().size()),
+                   intent, format};
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(transform_cache_mutex);
+#endif
+
+  auto iter = transform_cache.find(key);
+  if (iter != transform_cache.end()) {
+    return iter->second;
+  }
+
+  cmsHPROFILE src_profile = source.open();
+  cmsHPROFILE dst_profile = cmsOpenProfileFromMem(target.get_data().data(),
+                                                  static_cast<cmsUInt32Number>(target.get_data().size()));
+
+  cmsHTRANSFORM transform = nullptr;
+  if (src_profile && dst_profile) {
+    transform = cmsCreateTransform(src_profile, format, dst_profile, format, intent,
+                                   cmsFLAGS_NOCACHE | cmsFLAGS_COPY_ALPHA);
+  }
+
+  if (src_profile) {
+    cmsCloseProfile(src_profile);
+  }
+
+  if (dst_profile) {
+    cmsCloseProfile(dst_profile);
+  }
+
+  if (!transform) {
+    return nullptr;
+  }
+
+  std::shared_ptr<void> cached(transform, [](void* t) { cmsDeleteTransform(t); });
+
+  if (transform_cache.size() >= MAX_TRANSFORM_CACHE_SIZE) {
+    transform_cache.clear();
+  }
+
+  transform_cache[key] = cached;
+
+  return cached;
+}
+
+
+// 8-bit images are transformed with 8 bits, all others with 16 bits.
+// RRGGBB and planar images are converted row by row into a temporary interleaved RGB buffer.
+static cmsUInt32Number lcms_format(heif_chroma chroma, int bpp)
+{
+  switch (chroma) {
+    case heif_chroma_interleaved_RGB:
+      return TYPE_RGB_8;
+    case heif_chroma_interleaved_RGBA:
+      return TYPE_RGBA_8;
+    default:
+      return bpp == 8 ? TYPE_RGB_8 : TYPE_RGB_16;
+  }
+}
+
+
+static inline uint16_t expand_to_16bit(uint16_t v, int bpp)
+{
+  return static_cast<uint16_t>((v << (16 - bpp)) | (v >> (2 * bpp - 16)));
+}
+
+
+static inline uint16_t reduce_from_16bit(uint16_t v, int bpp)
+{
+  uint32_t max_value = (1U << bpp) - 1;
+  return static_cast<uint16_t>((v * max_value + 32767) / 65535);
+}
+
+
+template<class T>
+static void transform_planar(cmsHTRANSFORM transform, const HeifPixelImage& in, HeifPixelImage& out)
+{
+  uint32_t width = in.get_width();
+  uint32_t height = in.get_height();
+  int bpp = in.get_bits_per_pixel(heif_channel_R);
+
+  const heif_channel channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+
+  std::vector<T> row(size_t{width} * 3);
+
+  for (uint32_t y = 0; y < height; y++) {
+    for (int c = 0; c < 3; c++) {
+      size_t stride;
+      const T* p = reinterpret_cast<const T*>(in.get_plane(channels[c], &stride)) + y * (stride / sizeof(T));
+      for (uint32_t x = 0; x < width; x++) {
+        row[x * 3 + c] = (sizeof(T) == 1) ? p[x] : static_cast<T>(expand_to_16bit(p[x], bpp));
+      }
+    }
+
+    cmsDoTransform(transform, row.data(), row.data(), width);
+
+    for (int c = 0; c < 3; c++) {
+      size_t stride;
+      T* p = reinterpret_cast<T*>(out.get_plane(channels[c], &stride)) + y * (stride / sizeof(T));
+      for (uint32_t x = 0; x < width; x++) {
+        p[x] = (sizeof(T) == 1) ? row[x * 3 + c] : static_cast<T>(reduce_from_16bit(row[x * 3 + c], bpp));
+      }
+    }
+  }
+}
+
+
+static void transform_RRGGBBaa(cmsHTRANSFORM transform, const HeifPixelImage& in, HeifPixelImage& out)
+{
+  uint32_t width = in.get_width();
+  uint32_t height = in.get_height();
+  heif_chroma chroma = in.get_chroma_format();
+  int bpp = in.get_bits_per_pixel(heif_channel_interleaved);
+
+  bool big_endian = (chroma == heif_chroma_interleaved_RRGGBB_BE || chroma == heif_chroma_interleaved_RRGGBBAA_BE);
+  int bytes_per_pixel = (chroma == heif_chroma_interleaved_RRGGBBAA_BE || chroma == heif_chroma_interleaved_RRGGBBAA_LE) ? 8 : 6;
+
+  size_t in_stride, out_stride;
+  const uint8_t* in_p = in.get_plane(heif_channel_interleaved, &in_stride);
+  uint8_t* out_p = out.get_plane(heif_channel_interleaved, &out_stride);
+
+  std::vector<uint16_t> row(size_t{width} * 3);
+
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* p = in_p + y * in_stride;
+    uint8_t* q = out_p + y * out_stride;
+
+    for (uint32_t x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        const uint8_t* s = p + x * bytes_per_pixel + 2 * c;
+        uint16_t v = big_endian ? static_cast<uint16_t>((s[0] << 8) | s[1]) : static_cast<uint16_t>((s[1] << 8) | s[0]);
+        row[x * 3 + c] = expand_to_16bit(v, bpp);
+      }
+    }
+
+    cmsDoTransform(transform, row.data(), row.data(), width);
+
+    for (uint32_t x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        uint8_t* d = q + x * bytes_per_pixel + 2 * c;
+        uint16_t v = reduce_from_16bit(row[x * 3 + c], bpp);
+        d[big_endian ? 0 : 1] = static_cast<uint8_t>(v >> 8);
+        d[big_endian ? 1 : 0] = static_cast<uint8_t>(v & 0xFF);
+      }
+
+      if (bytes_per_pixel == 8 && p != q) {
+        q[x * 8 + 6] = p[x * 8 + 6];
+        q[x * 8 + 7] = p[x * 8 + 7];
+      }
+    }
+  }
+}
+
+#endif
+
+
+static bool is_supported_output(const ColorState& state)
+{
+  if (state.colorspace != heif_colorspace_RGB) {
+    return false;
+  }
+
+  switch (state.chroma) {
+    case heif_chroma_interleaved_RGB:
+    case heif_chroma_interleaved_RGBA:
+      return state.bits_per_pixel == 8;
+    case heif_chroma_interleaved_RRGGBB_BE:
+    case heif_chroma_interleaved_RRGGBB_LE:
+    case heif_chroma_interleaved_RRGGBBAA_BE:
+    case heif_chroma_interleaved_RRGGBBAA_LE:
+      return state.bits_per_pixel > 8 && state.bits_per_pixel <= 16;
+    case heif_chroma_444:
+      return state.bits_per_pixel >= 8 && state.bits_per_pixel <= 16;
+    default:
+      return false;
+  }
+}
+
+
+std::shared_ptr<Op_ICC_transform> Op_ICC_transform::create(const std::shared_ptr<const HeifPixelImage>& input,
+                                                            const ColorState& output_state,
+                                                            const heif_color_conversion_options_ext& options_ext)
+{
+  if (options_ext.output_icc_profile == nullptr ||
+      options_ext.output_icc_profile_size == 0 ||
+      !is_supported_output(output_state)) {
+    return nullptr;
+  }
+
+#ifdef HAVE_LCMS2
+  std::vector<uint8_t> target_data(options_ext.output_icc_profile,
+                                   options_ext.output_icc_profile + options_ext.output_icc_profile_size);
+
+  ProfileSource source;
+  source.icc = input->get_color_profile_icc();
+  source.nclx = output_state.nclx_profile;
+
+  if (source.icc && source.icc->get_data() == target_data) {
+    return nullptr;
+  }
+
+  auto target = std::make_shared<color_profile_raw>(fourcc("prof"), target_data);
+
+  auto transform = get_transform(source, *target, options_ext.rendering_intent,
+                                 lcms_format(output_state.chroma, output_state.bits_per_pixel));
+  if (!transform) {
+    return nullptr;
+  }
+
+  auto op = std::make_shared<Op_ICC_transform>();
+  op->m_transform = std::move(transform);
+  op->m_output_profile = std::move(target);
+  return op;
+#else
+  (void) input;
+  return nullptr;
+#endif
+}
+
+
+void Op_ICC_transform::transform_image(const HeifPixelImage& in, HeifPixelImage& out) const
+{
+#ifdef HAVE_LCMS2
+  cmsHTRANSFORM transform = m_transform.get();
+
+  switch (in.get_chroma_format()) {
+    case heif_chroma_interleaved_RGB:
+    case heif_chroma_interleaved_RGBA: {
+      size_t in_stride, out_stride;
+      const uint8_t* in_p = in.get_plane(heif_channel_interleaved, &in_stride);
+      uint8_t* out_p = out.get_plane(heif_channel_interleaved, &out_stride);
+
+      for (uint32_t y = 0; y < in.get_height(); y++) {
+        cmsDoTransform(transform, in_p + y * in_stride, out_p + y * out_stride, in.get_width());
+      }
+      break;
+    }
+    case heif_chroma_444:
+      if (in.get_bits_per_pixel(heif_channel_R) == 8) {
+        transform_planar<uint8_t>(transform, in, out);
+      }
+      else {
+        transform_planar<uint16_t>(transform, in, out);
+      }
+      break;
+    default:
+      transform_RRGGBBaa(transform, in, out);
+      break;
+  }
+#else
+  (void) in;
+  (void) out;
+#endif
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Op_ICC_transform::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                     const ColorState& input_state,
+                                     const ColorState& target_state,
+                                     const heif_color_conversion_options& options,
+                                     const heif_color_conversion_options_ext& options_ext,
+                                     const heif_security_limits* limits) const
+{
+  uint32_t width = input->get_width();
+  uint32_t height = input->get_height();
+  heif_chroma chroma = input->get_chroma_format();
+
+  auto outimg = std::make_shared<HeifPixelImage>();
+  outimg->create(width, height, heif_colorspace_RGB, chroma);
+
+  if (chroma == heif_chroma_444) {
+    for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+      if (auto err = outimg->add_plane(channel, width, height, input->get_bits_per_pixel(channel), limits)) {
+        return err;
+      }
+    }
+
+    if (input->has_channel(heif_channel_Alpha)) {
+      if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
+        return err;
+      }
+    }
+  }
+  else {
+    if (auto err = outimg->add_plane(heif_channel_interleaved, width, height,
+                                     input->get_bits_per_pixel(heif_channel_interleaved), limits)) {
+      return err;
+    }
+  }
+
+  transform_image(*input, *outimg);
+
+  return outimg;
+}
+
+
+Error Op_ICC_transform::convert_colorspace_in_place(const std::shared_ptr<HeifPixelImage>& image,
+                                                    const ColorState& input_state,
+                                                    const ColorState& target_state,
+                                                    const heif_color_conversion_options& options,
+                                                    const heif_color_conversion_options_ext& options_ext) const
+{
+  transform_image(*image, *image);
+
+  return Error::Ok;
+}
@@ -0,0 +1,78 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_ICC_TRANSFORM_H
+#define LIBHEIF_ICC_TRANSFORM_H
+
+#include "colorconversion.h"
+#include <vector>
+#include <memory>
+
+
+// Converts the RGB colors of an image into the ICC profile set in heif_color_conversion_options_ext::output_icc_profile.
+// This Op is not part of the pipeline search. It is appended as the last step of a pipeline that ends in RGB,
+// so that it is applied to each strip of the pipeline without an additional pass over the whole image.
+// The LittleCMS transforms are cached process-wide, keyed by the source and target profile and the rendering intent.
+class Op_ICC_transform : public ColorConversionOperation
+{
+public:
+  // Returns nullptr if no transform is needed or possible: no output profile is set, libheif is compiled without
+  // LittleCMS, the output format is not supported, or the source profile cannot be determined.
+  // The source profile is the ICC profile of 'input' or, without one, derived from the nclx profile of 'output_state'.
+  static std::shared_ptr<Op_ICC_transform> create(const std::shared_ptr<const HeifPixelImage>& input,
+                                                  const ColorState& output_state,
+                                                  const heif_color_conversion_options_ext& options_ext);
+
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState&,
+                         const ColorState&,
+                         const heif_color_conversion_options&,
+                         const heif_color_conversion_options_ext&) const override { return {}; }
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+
+  bool supports_in_place_conversion() const override { return true; }
+
+  Error
+  convert_colorspace_in_place(const std::shared_ptr<HeifPixelImage>& image,
+                              const ColorState& input_state,
+                              const ColorState& target_state,
+                              const heif_color_conversion_options& options,
+                              const heif_color_conversion_options_ext& options_ext) const override;
+
+  const std::shared_ptr<const color_profile_raw>& get_output_profile() const { return m_output_profile; }
+
+private:
+  // cmsHTRANSFORM, created with cmsFLAGS_NOCACHE such that strips can be transformed in parallel.
+  std::shared_ptr<void> m_transform;
+
+  std::shared_ptr<const color_profile_raw> m_output_profile;
+
+  void transform_image(const HeifPixelImage& in, HeifPixelImage& out) const;
+};
+
+
+#endif //LIBHEIF_ICC_TRANSFORM_H
@@ -20,6 +20,7 @@
 
 #include <cstring>
 #include "monochrome.h"
+#include "rgb2rgb_simd.h"
 
 
 std::vector<ColorStateWithCost>
@@ -70,32 +71,23 @@ Op_mono_to_YCbCr420::convert_colorspace(const std::shared_ptr<const HeifPixelIma
   uint32_t chroma_width = (width + 1) / 2;
   uint32_t chroma_height = (height + 1) / 2;
 
-  if (auto err = outimg->add_plane(heif_channel_Y, width, height, input_bpp, limits) ||
+  if (auto err = outimg->share_plane_from(input, heif_channel_Y, heif_channel_Y) ||
                  outimg->add_plane(heif_channel_Cb, chroma_width, chroma_height, input_bpp, limits) ||
                  outimg->add_plane(heif_channel_Cr, chroma_width, chroma_height, input_bpp, limits)) {
     return err;
   }
 
-  int alpha_bpp = 0;
-  bool has_alpha = input->has_channel(heif_channel_Alpha);
-  if (has_alpha) {
-    alpha_bpp = input->get_bits_per_pixel(heif_channel_Alpha);
-    if (auto err = outimg->add_plane(heif_channel_Alpha, width, height, alpha_bpp, limits)) {
+  if (input->has_channel(heif_channel_Alpha)) {
+    if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
       return err;
     }
   }
 
 
   if (input_bpp <= 8) {
-    uint8_t* out_cb, * out_cr, * out_y;
-    size_t out_cb_stride = 0, out_cr_stride = 0, out_y_stride = 0;
-
-    const uint8_t* in_y;
-    size_t in_y_stride = 0;
+    uint8_t* out_cb, * out_cr;
+    size_t out_cb_stride = 0, out_cr_stride = 0;
 
-    in_y = input->get_plane(heif_channel_Y, &in_y_stride);
-
-    out_y = outimg->get_plane(heif_channel_Y, &out_y_stride);
     out_cb = outimg->get_plane(heif_channel_Cb, &out_cb_stride);
     out_cr = outimg->get_plane(heif_channel_Cr, &out_cr_stride);
 
@@ -103,28 +95,14 @@ Op_mono_to_YCbCr420::convert_colorspace(const std::shared_ptr<const HeifPixelIma
 
     memset(out_cb, chroma_value, out_cb_stride * chroma_height);
     memset(out_cr, chroma_value, out_cr_stride * chroma_height);
-
-    for (uint32_t y = 0; y < height; y++) {
-      memcpy(out_y + y * out_y_stride,
-             in_y + y * in_y_stride,
-             width);
-    }
   }
   else {
-    uint16_t* out_cb, * out_cr, * out_y;
-    size_t out_cb_stride = 0, out_cr_stride = 0, out_y_stride = 0;
-
-    const uint16_t* in_y;
-    size_t in_y_stride = 0;
+    uint16_t* out_cb, * out_cr;
+    size_t out_cb_stride = 0, out_cr_stride = 0;
 
-    in_y = (const uint16_t*) input->get_plane(heif_channel_Y, &in_y_stride);
-
-    out_y = (uint16_t*) outimg->get_plane(heif_channel_Y, &out_y_stride);
     out_cb = (uint16_t*) outimg->get_plane(heif_channel_Cb, &out_cb_stride);
     out_cr = (uint16_t*) outimg->get_plane(heif_channel_Cr, &out_cr_stride);
 
-    in_y_stride /= 2;
-    out_y_stride /= 2;
     out_cb_stride /= 2;
     out_cr_stride /= 2;
 
@@ -133,28 +111,6 @@ Op_mono_to_YCbCr420::convert_colorspace(const std::shared_ptr<const HeifPixelIma
         out_cb[x + y * out_cb_stride] = (uint16_t) (128 << (input_bpp - 8));
         out_cr[x + y * out_cr_stride] = (uint16_t) (128 << (input_bpp - 8));
       }
-
-    for (uint32_t y = 0; y < height; y++) {
-      memcpy(out_y + y * out_y_stride,
-             in_y + y * in_y_stride,
-             width * 2);
-    }
-  }
-
-  if (has_alpha) {
-    const uint8_t* in_a;
-    uint8_t* out_a;
-    size_t in_a_stride = 0;
-    size_t out_a_stride = 0;
-
-    in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
-    out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
-
-    uint32_t memory_width = (alpha_bpp > 8 ? width * 2 : width);
-
-    for (uint32_t y = 0; y < height; y++) {
-      memcpy(&out_a[y * out_a_stride], &in_a[y * in_a_stride], memory_width);
-    }
   }
 
   return outimg;
@@ -187,7 +143,7 @@ Op_mono_to_RGB24_32::state_after_conversion(const ColorState& input_state,
     output_state.has_alpha = false;
     output_state.bits_per_pixel = 8;
 
-    states.emplace_back(output_state, SpeedCosts_Unoptimized);
+    states.emplace_back(output_state, SpeedCosts_OptimizedSoftware);
   }
 
 
@@ -198,7 +154,7 @@ Op_mono_to_RGB24_32::state_after_conversion(const ColorState& input_state,
   output_state.has_alpha = true;
   output_state.bits_per_pixel = 8;
 
-  states.emplace_back(output_state, SpeedCosts_Unoptimized);
+  states.emplace_back(output_state, SpeedCosts_OptimizedSoftware);
 
   return states;
 }
@@ -247,32 +203,35 @@ Op_mono_to_RGB24_32::convert_colorspace(const std::shared_ptr<const HeifPixelIma
 
   out_p = outimg->get_plane(heif_channel_interleaved, &out_p_stride);
 
-  uint32_t x, y;
-  for (y = 0; y < height; y++) {
-    if (target_state.has_alpha == false) {
-      for (x = 0; x < width; x++) {
-        uint8_t v = in_y[x + y * in_y_stride];
-        out_p[y * out_p_stride + 3 * x + 0] = v;
-        out_p[y * out_p_stride + 3 * x + 1] = v;
-        out_p[y * out_p_stride + 3 * x + 2] = v;
-      }
+  // The RGB interleaving kernels with the gray plane as R, G, and B.
+  const RGB_interleave_row_kernels& kernels = get_RGB_interleave_row_kernels();
+  Interleave_RGB8_row_kernel kernel = target_state.has_alpha ? kernels.interleave_rgba32 : kernels.interleave_rgb24;
+
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* row_y = &in_y[y * in_y_stride];
+    const uint8_t* row_a = has_alpha ? &in_a[y * in_a_stride] : nullptr;
+    uint8_t* out = &out_p[y * out_p_stride];
+
+    uint32_t x = 0;
+    if (kernel) {
+      x = kernel(row_y, row_y, row_y, row_a, out, width);
     }
-    else if (has_alpha) {
-      for (x = 0; x < width; x++) {
-        uint8_t v = in_y[x + y * in_y_stride];
-        out_p[y * out_p_stride + 4 * x + 0] = v;
-        out_p[y * out_p_stride + 4 * x + 1] = v;
-        out_p[y * out_p_stride + 4 * x + 2] = v;
-        out_p[y * out_p_stride + 4 * x + 3] = in_a[x + y * in_a_stride];
+
+    if (target_state.has_alpha == false) {
+      for (; x < width; x++) {
+        uint8_t v = row_y[x];
+        out[3 * x + 0] = v;
+        out[3 * x + 1] = v;
+        out[3 * x + 2] = v;
       }
     }
     else {
-      for (x = 0; x < width; x++) {
-        uint8_t v = in_y[x + y * in_y_stride];
-        out_p[y * out_p_stride + 4 * x + 0] = v;
-        out_p[y * out_p_stride + 4 * x + 1] = v;
-        out_p[y * out_p_stride + 4 * x + 2] = v;
-        out_p[y * out_p_stride + 4 * x + 3] = 0xFF;
+      for (; x < width; x++) {
+        uint8_t v = row_y[x];
+        out[4 * x + 0] = v;
+        out[4 * x + 1] = v;
+        out[4 * x + 2] = v;
+        out[4 * x + 3] = row_a ? row_a[x] : 0xFF;
       }
     }
   }
@@ -281,3 +240,65 @@ Op_mono_to_RGB24_32::convert_colorspace(const std::shared_ptr<const HeifPixelIma
 }
 
 
+
+
+std::vector<ColorStateWithCost>
+Op_mono_to_RGB::state_after_conversion(const ColorState& input_state,
+                                       const ColorState& target_state,
+                                       const heif_color_conversion_options& options,
+                                       const heif_color_conversion_options_ext& options_ext) const
+{
+  if (input_state.colorspace != heif_colorspace_monochrome ||
+      input_state.chroma != heif_chroma_monochrome) {
+    return {};
+  }
+
+  std::vector<ColorStateWithCost> states;
+
+  ColorState output_state;
+
+  // --- convert to RGB 4:4:4
+
+  output_state.colorspace = heif_colorspace_RGB;
+  output_state.chroma = heif_chroma_444;
+  output_state.has_alpha = input_state.has_alpha;
+  output_state.bits_per_pixel = input_state.bits_per_pixel;
+
+  states.emplace_back(output_state, SpeedCosts_OptimizedSoftware);
+
+  return states;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>>
+Op_mono_to_RGB::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                   const ColorState& input_state,
+                                   const ColorState& target_state,
+                                   const heif_color_conversion_options& options,
+                                   const heif_color_conversion_options_ext& options_ext,
+                                   const heif_security_limits* limits) const
+{
+  auto outimg = std::make_shared<HeifPixelImage>();
+
+  uint32_t width = input->get_width();
+  uint32_t height = input->get_height();
+
+  outimg->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+
+  // Like the conversion through YCbCr with neutral chroma, all components are the gray value.
+  // G references the gray plane, R and B are copies, such that the planes of the output do not alias each other.
+
+  if (auto err = outimg->share_plane_from(input, heif_channel_Y, heif_channel_G) ||
+                 outimg->copy_new_plane_from(input, heif_channel_Y, heif_channel_R, limits) ||
+                 outimg->copy_new_plane_from(input, heif_channel_Y, heif_channel_B, limits)) {
+    return err;
+  }
+
+  if (input->has_channel(heif_channel_Alpha)) {
+    if (auto err = outimg->share_plane_from(input, heif_channel_Alpha, heif_channel_Alpha)) {
+      return err;
+    }
+  }
+
+  return outimg;
+}
@@ -63,4 +63,24 @@ public:
                      const heif_security_limits* limits) const override;
 };
 
+
+// Converts a monochrome image to planar RGB of the same bit depth, without creating chroma planes.
+class Op_mono_to_RGB : public ColorConversionOperation
+{
+public:
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState& input_state,
+                         const ColorState& target_state,
+                         const heif_color_conversion_options& options,
+                         const heif_color_conversion_options_ext& options_ext) const override;
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+};
+
 #endif //LIBHEIF_COLORCONVERSION_MONOCHROME_H
@@ -20,9 +20,11 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include "rgb2rgb.h"
+#include "rgb2rgb_simd.h"
 
 
 std::vector<ColorStateWithCost>
@@ -112,32 +114,34 @@ Op_RGB_to_RGB24_32::convert_colorspace(const std::shared_ptr<const HeifPixelImag
     in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
   }
 
-  uint32_t x, y;
-  for (y = 0; y < height; y++) {
+  const RGB_interleave_row_kernels& kernels = get_RGB_interleave_row_kernels();
+  Interleave_RGB8_row_kernel kernel = want_alpha ? kernels.interleave_rgba32 : kernels.interleave_rgb24;
 
-    if (has_alpha && want_alpha) {
-      for (x = 0; x < width; x++) {
-        out_p[y * out_p_stride + 4 * x + 0] = in_r[x + y * in_r_stride];
-        out_p[y * out_p_stride + 4 * x + 1] = in_g[x + y * in_g_stride];
-        out_p[y * out_p_stride + 4 * x + 2] = in_b[x + y * in_b_stride];
-        out_p[y * out_p_stride + 4 * x + 3] = in_a[x + y * in_a_stride];
-      }
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* row_r = &in_r[y * in_r_stride];
+    const uint8_t* row_g = &in_g[y * in_g_stride];
+    const uint8_t* row_b = &in_b[y * in_b_stride];
+    const uint8_t* row_a = has_alpha ? &in_a[y * in_a_stride] : nullptr;
+    uint8_t* out = &out_p[y * out_p_stride];
+
+    uint32_t x = 0;
+    if (kernel) {
+      x = kernel(row_r, row_g, row_b, row_a, out, width);
     }
-    else if (!want_alpha) {
-      for (x = 0; x < width; x++) {
-        out_p[y * out_p_stride + 3 * x + 0] = in_r[x + y * in_r_stride];
-        out_p[y * out_p_stride + 3 * x + 1] = in_g[x + y * in_g_stride];
-        out_p[y * out_p_stride + 3 * x + 2] = in_b[x + y * in_b_stride];
+
+    if (want_alpha) {
+      for (; x < width; x++) {
+        out[4 * x + 0] = row_r[x];
+        out[4 * x + 1] = row_g[x];
+        out[4 * x + 2] = row_b[x];
+        out[4 * x + 3] = row_a ? row_a[x] : 0xFF;
       }
     }
     else {
-      assert(want_alpha && !has_alpha);
-
-      for (x = 0; x < width; x++) {
-        out_p[y * out_p_stride + 4 * x + 0] = in_r[x + y * in_r_stride];
-        out_p[y * out_p_stride + 4 * x + 1] = in_g[x + y * in_g_stride];
-        out_p[y * out_p_stride + 4 * x + 2] = in_b[x + y * in_b_stride];
-        out_p[y * out_p_stride + 4 * x + 3] = 0xFF;
+      for (; x < width; x++) {
+        out[3 * x + 0] = row_r[x];
+        out[3 * x + 1] = row_g[x];
+        out[3 * x + 2] = row_b[x];
       }
     }
   }
@@ -377,36 +381,34 @@ Op_RGB_to_RRGGBBaa_BE::convert_colorspace(const std::shared_ptr<const HeifPixelI
     in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
   }
 
+  const RGB_interleave_row_kernels& kernels = get_RGB_interleave_row_kernels();
+  Interleave_RGB8_row_kernel kernel = output_has_alpha ? kernels.interleave_rrggbbaa_be : kernels.interleave_rrggbb_be;
+
   const int pixelsize = (output_has_alpha ? 8 : 6);
 
-  uint32_t x, y;
-  for (y = 0; y < height; y++) {
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* row_r = &in_r[y * in_r_stride];
+    const uint8_t* row_g = &in_g[y * in_g_stride];
+    const uint8_t* row_b = &in_b[y * in_b_stride];
+    const uint8_t* row_a = input_has_alpha ? &in_a[y * in_a_stride] : nullptr;
+    uint8_t* out = &out_p[y * out_p_stride];
 
-    if (input_has_alpha) {
-      for (x = 0; x < width; x++) {
-        out_p[y * out_p_stride + 8 * x + 0] = 0;
-        out_p[y * out_p_stride + 8 * x + 1] = in_r[x + y * in_r_stride];
-        out_p[y * out_p_stride + 8 * x + 2] = 0;
-        out_p[y * out_p_stride + 8 * x + 3] = in_g[x + y * in_g_stride];
-        out_p[y * out_p_stride + 8 * x + 4] = 0;
-        out_p[y * out_p_stride + 8 * x + 5] = in_b[x + y * in_b_stride];
-        out_p[y * out_p_stride + 8 * x + 6] = 0;
-        out_p[y * out_p_stride + 8 * x + 7] = in_a[x + y * in_a_stride];
-      }
+    uint32_t x = 0;
+    if (kernel) {
+      x = kernel(row_r, row_g, row_b, row_a, out, width);
     }
-    else {
-      for (x = 0; x < width; x++) {
-        out_p[y * out_p_stride + pixelsize * x + 0] = 0;
-        out_p[y * out_p_stride + pixelsize * x + 1] = in_r[x + y * in_r_stride];
-        out_p[y * out_p_stride + pixelsize * x + 2] = 0;
-        out_p[y * out_p_stride + pixelsize * x + 3] = in_g[x + y * in_g_stride];
-        out_p[y * out_p_stride + pixelsize * x + 4] = 0;
-        out_p[y * out_p_stride + pixelsize * x + 5] = in_b[x + y * in_b_stride];
-
-        if (output_has_alpha) {
-          out_p[y * out_p_stride + pixelsize * x + 6] = 0;
-          out_p[y * out_p_stride + pixelsize * x + 7] = 0xFF;
-        }
+
+    for (; x < width; x++) {
+      out[pixelsize * x + 0] = 0;
+      out[pixelsize * x + 1] = row_r[x];
+      out[pixelsize * x + 2] = 0;
+      out[pixelsize * x + 3] = row_g[x];
+      out[pixelsize * x + 4] = 0;
+      out[pixelsize * x + 5] = row_b[x];
+
+      if (output_has_alpha) {
+        out[pixelsize * x + 6] = 0;
+        out[pixelsize * x + 7] = row_a ? row_a[x] : 0xFF;
       }
     }
   }
@@ -610,19 +612,34 @@ Op_RGB24_32_to_RGB::convert_colorspace(const std::shared_ptr<const HeifPixelImag
     out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
   }
 
-  uint32_t x, y;
-  for (y = 0; y < height; y++) {
+  const RGB_interleave_row_kernels& kernels = get_RGB_interleave_row_kernels();
+  Deinterleave_RGB8_row_kernel kernel = has_alpha ? kernels.deinterleave_rgba32 : kernels.deinterleave_rgb24;
 
-    for (x = 0; x < width; x++) {
-      out_r[x + y * out_r_stride] = in_p[y * in_p_stride + in_pix_size * x + 0];
-      out_g[x + y * out_g_stride] = in_p[y * in_p_stride + in_pix_size * x + 1];
-      out_b[x + y * out_b_stride] = in_p[y * in_p_stride + in_pix_size * x + 2];
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* in = &in_p[y * in_p_stride];
+    uint8_t* row_r = &out_r[y * out_r_stride];
+    uint8_t* row_g = &out_g[y * out_g_stride];
+    uint8_t* row_b = &out_b[y * out_b_stride];
+    uint8_t* row_a = want_alpha ? &out_a[y * out_a_stride] : nullptr;
 
-      if (want_alpha) {
-        uint8_t a = has_alpha ? in_p[y * in_p_stride + in_pix_size * x + 3] : 0xff;
-        out_a[x + y * out_a_stride] = a;
+    uint32_t x = 0;
+    if (kernel) {
+      x = kernel(in, row_r, row_g, row_b, row_a, width);
+    }
+
+    for (; x < width; x++) {
+      row_r[x] = in[in_pix_size * x + 0];
+      row_g[x] = in[in_pix_size * x + 1];
+      row_b[x] = in[in_pix_size * x + 2];
+
+      if (row_a && has_alpha) {
+        row_a[x] = in[in_pix_size * x + 3];
       }
     }
+
+    if (row_a && !has_alpha) {
+      memset(row_a, 0xFF, width);
+    }
   }
 
   return outimg;
@@ -692,6 +709,48 @@ Op_RRGGBBaa_swap_endianness::state_after_conversion(const ColorState& input_stat
 }
 
 
+static heif_chroma swapped_endianness(heif_chroma chroma)
+{
+  switch (chroma) {
+    case heif_chroma_interleaved_RRGGBB_LE:
+      return heif_chroma_interleaved_RRGGBB_BE;
+    case heif_chroma_interleaved_RRGGBB_BE:
+      return heif_chroma_interleaved_RRGGBB_LE;
+    case heif_chroma_interleaved_RRGGBBAA_LE:
+      return heif_chroma_interleaved_RRGGBBAA_BE;
+    case heif_chroma_interleaved_RRGGBBAA_BE:
+      return heif_chroma_interleaved_RRGGBBAA_LE;
+    default:
+      return heif_chroma_undefined;
+  }
+}
+
+
+// 'in' and 'out' may be the same plane.
+static void swap_bytes16_rows(const uint8_t* in, size_t in_stride, uint8_t* out, size_t out_stride,
+                              uint32_t row_bytes, uint32_t height)
+{
+  Swap_bytes16_row_kernel kernel = get_RGB_interleave_row_kernels().swap_bytes16;
+
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* in_row = &in[y * in_stride];
+    uint8_t* out_row = &out[y * out_stride];
+
+    uint32_t x = 0;
+    if (kernel) {
+      x = kernel(in_row, out_row, row_bytes);
+    }
+
+    for (; x < row_bytes; x += 2) {
+      uint8_t b0 = in_row[x + 0];
+      uint8_t b1 = in_row[x + 1];
+      out_row[x + 0] = b1;
+      out_row[x + 1] = b0;
+    }
+  }
+}
+
+
 Result<std::shared_ptr<HeifPixelImage>>
 Op_RRGGBBaa_swap_endianness::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
                                                 const ColorState& input_state,
@@ -700,27 +759,17 @@ Op_RRGGBBaa_swap_endianness::convert_colorspace(const std::shared_ptr<const Heif
                                                 const heif_color_conversion_options_ext& options_ext,
                                                 const heif_security_limits* limits) const
 {
+  heif_chroma out_chroma = swapped_endianness(input->get_chroma_format());
+  if (out_chroma == heif_chroma_undefined) {
+    return Error::InternalError;
+  }
+
   auto outimg = std::make_shared<HeifPixelImage>();
 
   uint32_t width = input->get_width();
   uint32_t height = input->get_height();
 
-  switch (input->get_chroma_format()) {
-    case heif_chroma_interleaved_RRGGBB_LE:
-      outimg->create(width, height, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBB_BE);
-      break;
-    case heif_chroma_interleaved_RRGGBB_BE:
-      outimg->create(width, height, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBB_LE);
-      break;
-    case heif_chroma_interleaved_RRGGBBAA_LE:
-      outimg->create(width, height, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBBAA_BE);
-      break;
-    case heif_chroma_interleaved_RRGGBBAA_BE:
-      outimg->create(width, height, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBBAA_LE);
-      break;
-    default:
-      return Error::InternalError;
-  }
+  outimg->create(width, height, heif_colorspace_RGB, out_chroma);
 
   if (auto err = outimg->add_plane(heif_channel_interleaved, width, height,
                                    input->get_bits_per_pixel(heif_channel_interleaved), limits)) {
@@ -736,15 +785,34 @@ Op_RRGGBBaa_swap_endianness::convert_colorspace(const std::shared_ptr<const Heif
   in_p = input->get_plane(heif_channel_interleaved, &in_p_stride);
   out_p = outimg->get_plane(heif_channel_interleaved, &out_p_stride);
 
-  size_t n_bytes = std::min(in_p_stride, out_p_stride);
+  uint32_t row_bytes = width * 2 * input->get_number_of_interleaved_components(heif_channel_interleaved);
 
-  uint32_t x, y;
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < n_bytes; x += 2) {
-      out_p[y * out_p_stride + x + 0] = in_p[y * in_p_stride + x + 1];
-      out_p[y * out_p_stride + x + 1] = in_p[y * in_p_stride + x + 0];
-    }
-  }
+  swap_bytes16_rows(in_p, in_p_stride, out_p, out_p_stride, row_bytes, height);
 
   return outimg;
 }
+
+
+Error
+Op_RRGGBBaa_swap_endianness::convert_colorspace_in_place(const std::shared_ptr<HeifPixelImage>& image,
+                                                         const ColorState& input_state,
+                                                         const ColorState& target_state,
+                                                         const heif_color_conversion_options& options,
+                                                         const heif_color_conversion_options_ext& options_ext) const
+{
+  heif_chroma out_chroma = swapped_endianness(image->get_chroma_format());
+  if (out_chroma == heif_chroma_undefined) {
+    return Error::InternalError;
+  }
+
+  size_t stride = 0;
+  uint8_t* p = image->get_plane(heif_channel_interleaved, &stride);
+
+  uint32_t row_bytes = image->get_width() * 2 * image->get_number_of_interleaved_components(heif_channel_interleaved);
+
+  swap_bytes16_rows(p, stride, p, stride, row_bytes, image->get_height());
+
+  image->set_chroma_format(out_chroma);
+
+  return Error::Ok;
+}
@@ -137,6 +137,14 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const override;
+  bool supports_in_place_conversion() const override { return true; }
+
+  Error
+  convert_colorspace_in_place(const std::shared_ptr<HeifPixelImage>& image,
+                              const ColorState& input_state,
+                              const ColorState& target_state,
+                              const heif_color_conversion_options& options,
+                              const heif_color_conversion_options_ext& options_ext) const override;
 };
 
 
@@ -0,0 +1,437 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rgb2rgb_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+// Interleaves 16 pixels into RGBA. Each output vector holds four pixels.
+HEIF_TARGET_SSE41
+static inline void interleave_16_pixels_sse41(__m128i r, __m128i g, __m128i b, __m128i a, __m128i rgba[4])
+{
+  __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+  __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+  __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+  __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+  rgba[0] = _mm_unpacklo_epi16(rg_lo, ba_lo);
+  rgba[1] = _mm_unpackhi_epi16(rg_lo, ba_lo);
+  rgba[2] = _mm_unpacklo_epi16(rg_hi, ba_hi);
+  rgba[3] = _mm_unpackhi_epi16(rg_hi, ba_hi);
+}
+
+
+// Removes the alpha bytes from 16 RGBA pixels, giving 48 bytes of RGB.
+HEIF_TARGET_SSE41
+static inline void drop_alpha_16_pixels_sse41(const __m128i rgba[4], __m128i rgb[3])
+{
+  // leaves 12 bytes at the start of each vector and zeros behind
+  const __m128i drop_alpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  __m128i p0 = _mm_shuffle_epi8(rgba[0], drop_alpha);
+  __m128i p1 = _mm_shuffle_epi8(rgba[1], drop_alpha);
+  __m128i p2 = _mm_shuffle_epi8(rgba[2], drop_alpha);
+  __m128i p3 = _mm_shuffle_epi8(rgba[3], drop_alpha);
+
+  rgb[0] = _mm_or_si128(p0, _mm_slli_si128(p1, 12));
+  rgb[1] = _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8));
+  rgb[2] = _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4));
+}
+
+
+HEIF_TARGET_SSE41
+static inline void load_16_pixels_planar_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                               uint32_t x, __m128i rgba[4])
+{
+  __m128i a8 = a ? _mm_loadu_si128((const __m128i*) (a + x)) : _mm_set1_epi8((char) 0xFF);
+
+  interleave_16_pixels_sse41(_mm_loadu_si128((const __m128i*) (r + x)),
+                             _mm_loadu_si128((const __m128i*) (g + x)),
+                             _mm_loadu_si128((const __m128i*) (b + x)),
+                             a8, rgba);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t interleave_RGB24_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                    uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i rgba[4], rgb[3];
+    load_16_pixels_planar_sse41(r, g, b, nullptr, x, rgba);
+    drop_alpha_16_pixels_sse41(rgba, rgb);
+
+    for (int i = 0; i < 3; i++) {
+      _mm_storeu_si128((__m128i*) (out + 3 * x + 16 * i), rgb[i]);
+    }
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t interleave_RGBA32_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                     uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i rgba[4];
+    load_16_pixels_planar_sse41(r, g, b, a, x, rgba);
+
+    for (int i = 0; i < 4; i++) {
+      _mm_storeu_si128((__m128i*) (out + 4 * x + 16 * i), rgba[i]);
+    }
+  }
+
+  return x;
+}
+
+
+// Big-endian 16-bit samples with a zero high byte are the 8-bit samples with a zero byte in front.
+HEIF_TARGET_SSE41
+static inline void store_as_16bit_BE_sse41(uint8_t* out, __m128i v)
+{
+  const __m128i zero = _mm_setzero_si128();
+  _mm_storeu_si128((__m128i*) out, _mm_unpacklo_epi8(zero, v));
+  _mm_storeu_si128((__m128i*) (out + 16), _mm_unpackhi_epi8(zero, v));
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t interleave_RRGGBB_BE_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                        uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i rgba[4], rgb[3];
+    load_16_pixels_planar_sse41(r, g, b, nullptr, x, rgba);
+    drop_alpha_16_pixels_sse41(rgba, rgb);
+
+    for (int i = 0; i < 3; i++) {
+      store_as_16bit_BE_sse41(out + 6 * x + 32 * i, rgb[i]);
+    }
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t interleave_RRGGBBAA_BE_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                          uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i rgba[4];
+    load_16_pixels_planar_sse41(r, g, b, a, x, rgba);
+
+    for (int i = 0; i < 4; i++) {
+      store_as_16bit_BE_sse41(out + 8 * x + 32 * i, rgba[i]);
+    }
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i gather_component_sse41(const __m128i v[3], const __m128i masks[3])
+{
+  return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v[0], masks[0]), _mm_shuffle_epi8(v[1], masks[1])),
+                      _mm_shuffle_epi8(v[2], masks[2]));
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t deinterleave_RGB24_row_sse41(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width)
+{
+  // Each component of 16 pixels is gathered from the three input vectors. The masks select the
+  // bytes 3*i+c that lie in the respective vector.
+  const __m128i r_masks[3] = {
+      _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+      _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1),
+      _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)
+  };
+  const __m128i g_masks[3] = {
+      _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+      _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1),
+      _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)
+  };
+  const __m128i b_masks[3] = {
+      _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+      _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1),
+      _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)
+  };
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v[3];
+    for (int i = 0; i < 3; i++) {
+      v[i] = _mm_loadu_si128((const __m128i*) (in + 3 * x + 16 * i));
+    }
+
+    _mm_storeu_si128((__m128i*) (r + x), gather_component_sse41(v, r_masks));
+    _mm_storeu_si128((__m128i*) (g + x), gather_component_sse41(v, g_masks));
+    _mm_storeu_si128((__m128i*) (b + x), gather_component_sse41(v, b_masks));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t deinterleave_RGBA32_row_sse41(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width)
+{
+  // groups the components of four pixels into 32-bit blocks: RRRR GGGG BBBB AAAA
+  const __m128i group = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) {
+      v[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (in + 4 * x + 16 * i)), group);
+    }
+
+    // transpose the 4x4 blocks
+    __m128i rg01 = _mm_unpacklo_epi32(v[0], v[1]);
+    __m128i ba01 = _mm_unpackhi_epi32(v[0], v[1]);
+    __m128i rg23 = _mm_unpacklo_epi32(v[2], v[3]);
+    __m128i ba23 = _mm_unpackhi_epi32(v[2], v[3]);
+
+    _mm_storeu_si128((__m128i*) (r + x), _mm_unpacklo_epi64(rg01, rg23));
+    _mm_storeu_si128((__m128i*) (g + x), _mm_unpackhi_epi64(rg01, rg23));
+    _mm_storeu_si128((__m128i*) (b + x), _mm_unpacklo_epi64(ba01, ba23));
+
+    if (a) {
+      _mm_storeu_si128((__m128i*) (a + x), _mm_unpackhi_epi64(ba01, ba23));
+    }
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t swap_bytes16_row_sse41(const uint8_t* in, uint8_t* out, uint32_t num_bytes)
+{
+  const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+  uint32_t x = 0;
+  for (; x + 16 <= num_bytes; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (in + x));
+    _mm_storeu_si128((__m128i*) (out + x), _mm_shuffle_epi8(v, swap));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+uint32_t swap_bytes16_row_avx2(const uint8_t* in, uint8_t* out, uint32_t num_bytes)
+{
+  // the shuffle works within the 128-bit lanes
+  const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+  uint32_t x = 0;
+  for (; x + 32 <= num_bytes; x += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (in + x));
+    _mm256_storeu_si256((__m256i*) (out + x), _mm256_shuffle_epi8(v, swap));
+  }
+
+  x += swap_bytes16_row_sse41(in + x, out + x, num_bytes - x);
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+uint32_t interleave_RGB24_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                   uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x3_t rgb;
+    rgb.val[0] = vld1q_u8(r + x);
+    rgb.val[1] = vld1q_u8(g + x);
+    rgb.val[2] = vld1q_u8(b + x);
+    vst3q_u8(out + 3 * x, rgb);
+  }
+
+  return x;
+}
+
+
+uint32_t interleave_RGBA32_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                    uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x4_t rgba;
+    rgba.val[0] = vld1q_u8(r + x);
+    rgba.val[1] = vld1q_u8(g + x);
+    rgba.val[2] = vld1q_u8(b + x);
+    rgba.val[3] = a ? vld1q_u8(a + x) : vdupq_n_u8(0xFF);
+    vst4q_u8(out + 4 * x, rgba);
+  }
+
+  return x;
+}
+
+
+// Big-endian 16-bit samples with a zero high byte are the 8-bit samples shifted into the upper byte
+// of (little-endian) 16-bit values.
+
+uint32_t interleave_RRGGBB_BE_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                       uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8x3_t rgb;
+    rgb.val[0] = vshll_n_u8(vld1_u8(r + x), 8);
+    rgb.val[1] = vshll_n_u8(vld1_u8(g + x), 8);
+    rgb.val[2] = vshll_n_u8(vld1_u8(b + x), 8);
+    vst3q_u16((uint16_t*) (out + 6 * x), rgb);
+  }
+
+  return x;
+}
+
+
+uint32_t interleave_RRGGBBAA_BE_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                         uint8_t* out, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8x4_t rgba;
+    rgba.val[0] = vshll_n_u8(vld1_u8(r + x), 8);
+    rgba.val[1] = vshll_n_u8(vld1_u8(g + x), 8);
+    rgba.val[2] = vshll_n_u8(vld1_u8(b + x), 8);
+    rgba.val[3] = a ? vshll_n_u8(vld1_u8(a + x), 8) : vdupq_n_u16(0xFF00);
+    vst4q_u16((uint16_t*) (out + 8 * x), rgba);
+  }
+
+  return x;
+}
+
+
+uint32_t deinterleave_RGB24_row_neon(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x3_t rgb = vld3q_u8(in + 3 * x);
+    vst1q_u8(r + x, rgb.val[0]);
+    vst1q_u8(g + x, rgb.val[1]);
+    vst1q_u8(b + x, rgb.val[2]);
+  }
+
+  return x;
+}
+
+
+uint32_t deinterleave_RGBA32_row_neon(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x4_t rgba = vld4q_u8(in + 4 * x);
+    vst1q_u8(r + x, rgba.val[0]);
+    vst1q_u8(g + x, rgba.val[1]);
+    vst1q_u8(b + x, rgba.val[2]);
+
+    if (a) {
+      vst1q_u8(a + x, rgba.val[3]);
+    }
+  }
+
+  return x;
+}
+
+
+uint32_t swap_bytes16_row_neon(const uint8_t* in, uint8_t* out, uint32_t num_bytes)
+{
+  uint32_t x = 0;
+  for (; x + 16 <= num_bytes; x += 16) {
+    vst1q_u8(out + x, vrev16q_u8(vld1q_u8(in + x)));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static RGB_interleave_row_kernels select_RGB_interleave_row_kernels()
+{
+  RGB_interleave_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    kernels.interleave_rgb24 = interleave_RGB24_row_sse41;
+    kernels.interleave_rgba32 = interleave_RGBA32_row_sse41;
+    kernels.interleave_rrggbb_be = interleave_RRGGBB_BE_row_sse41;
+    kernels.interleave_rrggbbaa_be = interleave_RRGGBBAA_BE_row_sse41;
+    kernels.deinterleave_rgb24 = deinterleave_RGB24_row_sse41;
+    kernels.deinterleave_rgba32 = deinterleave_RGBA32_row_sse41;
+    kernels.swap_bytes16 = swap_bytes16_row_sse41;
+  }
+
+  // The (de)interleaving is limited by the memory bandwidth. Only the byte swap gains from the wider registers.
+  if (cpu_supports_avx2()) {
+    kernels.swap_bytes16 = swap_bytes16_row_avx2;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.interleave_rgb24 = interleave_RGB24_row_neon;
+    kernels.interleave_rgba32 = interleave_RGBA32_row_neon;
+    kernels.interleave_rrggbb_be = interleave_RRGGBB_BE_row_neon;
+    kernels.interleave_rrggbbaa_be = interleave_RRGGBBAA_BE_row_neon;
+    kernels.deinterleave_rgb24 = deinterleave_RGB24_row_neon;
+    kernels.deinterleave_rgba32 = deinterleave_RGBA32_row_neon;
+    kernels.swap_bytes16 = swap_bytes16_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const RGB_interleave_row_kernels& get_RGB_interleave_row_kernels()
+{
+  static const RGB_interleave_row_kernels kernels = select_RGB_interleave_row_kernels();
+  return kernels;
+}
@@ -0,0 +1,106 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_RGB2RGB_SIMD_H
+#define LIBHEIF_COLORCONVERSION_RGB2RGB_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// --- Row kernels for the RGB interleaving Ops in rgb2rgb.cc (see cpu_features.h).
+// They return the number of processed pixels (bytes for the byte swap).
+
+// Interleaves three 8-bit planes into RGB, or four into RGBA. For RGBA output, 'a' may be NULL,
+// in which case the alpha is set to 0xFF. For RGB output, 'a' is ignored.
+// The RRGGBB(AA)_BE kernels write each sample as a big-endian 16-bit value with a zero high byte.
+typedef uint32_t (*Interleave_RGB8_row_kernel)(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                               uint8_t* out, uint32_t width);
+
+// Splits RGB or RGBA into 8-bit planes. 'a' may be NULL if the alpha should be dropped. It is ignored for RGB input.
+typedef uint32_t (*Deinterleave_RGB8_row_kernel)(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a,
+                                                 uint32_t width);
+
+// Swaps the two bytes of each 16-bit sample. 'in' and 'out' may be the same buffer.
+typedef uint32_t (*Swap_bytes16_row_kernel)(const uint8_t* in, uint8_t* out, uint32_t num_bytes);
+
+
+struct RGB_interleave_row_kernels
+{
+  Interleave_RGB8_row_kernel interleave_rgb24 = nullptr;
+  Interleave_RGB8_row_kernel interleave_rgba32 = nullptr;
+  Interleave_RGB8_row_kernel interleave_rrggbb_be = nullptr;
+  Interleave_RGB8_row_kernel interleave_rrggbbaa_be = nullptr;
+  Deinterleave_RGB8_row_kernel deinterleave_rgb24 = nullptr;
+  Deinterleave_RGB8_row_kernel deinterleave_rgba32 = nullptr;
+  Swap_bytes16_row_kernel swap_bytes16 = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t interleave_RGB24_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                    uint8_t* out, uint32_t width);
+
+uint32_t interleave_RGBA32_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                     uint8_t* out, uint32_t width);
+
+uint32_t interleave_RRGGBB_BE_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                        uint8_t* out, uint32_t width);
+
+uint32_t interleave_RRGGBBAA_BE_row_sse41(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                          uint8_t* out, uint32_t width);
+
+uint32_t deinterleave_RGB24_row_sse41(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width);
+
+uint32_t deinterleave_RGBA32_row_sse41(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width);
+
+uint32_t swap_bytes16_row_sse41(const uint8_t* in, uint8_t* out, uint32_t num_bytes);
+
+uint32_t swap_bytes16_row_avx2(const uint8_t* in, uint8_t* out, uint32_t num_bytes);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t interleave_RGB24_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                   uint8_t* out, uint32_t width);
+
+uint32_t interleave_RGBA32_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                    uint8_t* out, uint32_t width);
+
+uint32_t interleave_RRGGBB_BE_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                       uint8_t* out, uint32_t width);
+
+uint32_t interleave_RRGGBBAA_BE_row_neon(const uint8_t* r, const uint8_t* g, const uint8_t* b, const uint8_t* a,
+                                         uint8_t* out, uint32_t width);
+
+uint32_t deinterleave_RGB24_row_neon(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width);
+
+uint32_t deinterleave_RGBA32_row_neon(const uint8_t* in, uint8_t* r, uint8_t* g, uint8_t* b, uint8_t* a, uint32_t width);
+
+uint32_t swap_bytes16_row_neon(const uint8_t* in, uint8_t* out, uint32_t num_bytes);
+
+#endif
+
+
+const RGB_interleave_row_kernels& get_RGB_interleave_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_RGB2RGB_SIMD_H
@@ -22,7 +22,9 @@
 #include <cassert>
 #include <memory>
 #include <vector>
+#include <type_traits>
 #include "rgb2yuv.h"
+#include "rgb2yuv_simd.h"
 #include "nclx.h"
 #include "common_utils.h"
 
@@ -73,7 +75,11 @@ Op_RGB_to_YCbCr<Pixel>::state_after_conversion(const ColorState& input_state,
     output_state.bits_per_pixel = input_state.bits_per_pixel;
     output_state.nclx_profile = target_state.nclx_profile;
 
-    states.emplace_back(output_state, SpeedCosts_Unoptimized);
+    const auto& kernels = get_RGB_to_YCbCr_row_kernels();
+    bool simd = (hdr && matrix != 0 && target_state.chroma == heif_chroma_420 &&
+                 kernels.rgb16_planar_to_y && kernels.rgb16_planar_to_cbcr420);
+
+    states.emplace_back(output_state, simd ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
   }
   else {
     // --- convert to YCbCr 4:4:4
@@ -184,10 +190,33 @@ Op_RGB_to_YCbCr<Pixel>::convert_colorspace(const std::shared_ptr<const HeifPixel
   coeffs = get_RGB_to_YCbCr_coefficients(target_state.nclx_profile.get_matrix_coefficients(),
                                          target_state.nclx_profile.get_colour_primaries());
 
+  // SIMD kernels for the high bit-depth input. They convert the first part of each row, the scalar code does the rest.
+  RGB16_planar_to_Y_row_kernel simd_luma_kernel = nullptr;
+  RGB16_planar_to_CbCr420_row_kernel simd_chroma_kernel = nullptr;
+
+  if constexpr (std::is_same<Pixel, uint16_t>::value) {
+    if (matrix_coeffs != 0) {
+      simd_luma_kernel = get_RGB_to_YCbCr_row_kernels().rgb16_planar_to_y;
+
+      if (subH == 2 && subV == 2) {
+        simd_chroma_kernel = get_RGB_to_YCbCr_row_kernels().rgb16_planar_to_cbcr420;
+      }
+    }
+  }
+
   uint32_t x, y;
 
   for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
+    x = 0;
+
+    if constexpr (std::is_same<Pixel, uint16_t>::value) {
+      if (simd_luma_kernel) {
+        x = simd_luma_kernel(&in_r[y * in_r_stride], &in_g[y * in_g_stride], &in_b[y * in_b_stride],
+                             &out_y[y * out_y_stride], width, coeffs, full_range_flag, bpp);
+      }
+    }
+
+    for (; x < width; x++) {
       if (matrix_coeffs == 0) {
         if (full_range_flag) {
           out_y[y * out_y_stride + x] = in_g[y * in_g_stride + x];
@@ -215,7 +244,21 @@ Op_RGB_to_YCbCr<Pixel>::convert_colorspace(const std::shared_ptr<const HeifPixel
   }
 
   for (y = 0; y < height; y += subV) {
-    for (x = 0; x < width; x += subH) {
+    x = 0;
+
+    if constexpr (std::is_same<Pixel, uint16_t>::value) {
+      if (simd_chroma_kernel) {
+        uint32_t y2 = (y + 1 < height) ? y + 1 : y;
+
+        const uint16_t* const row0[3] = {&in_r[y * in_r_stride], &in_g[y * in_g_stride], &in_b[y * in_b_stride]};
+        const uint16_t* const row1[3] = {&in_r[y2 * in_r_stride], &in_g[y2 * in_g_stride], &in_b[y2 * in_b_stride]};
+
+        x = 2 * simd_chroma_kernel(row0, row1, &out_cb[(y / 2) * out_cb_stride], &out_cr[(y / 2) * out_cr_stride],
+                                   width / 2, coeffs, full_range_flag, bpp);
+      }
+    }
+
+    for (; x < width; x += subH) {
       if (matrix_coeffs == 0) {
         if (full_range_flag) {
           out_cb[(y / subV) * out_cb_stride + (x / subH)] = in_b[y * in_b_stride + x];
@@ -526,7 +569,10 @@ Op_RGB24_32_to_YCbCr::state_after_conversion(const ColorState& input_state,
   output_state.bits_per_pixel = 8;
   output_state.nclx_profile = target_state.nclx_profile;
 
-  states.emplace_back(output_state, SpeedCosts_Unoptimized);
+  const auto& kernels = get_RGB_to_YCbCr_row_kernels();
+  bool simd = (target_state.chroma == heif_chroma_420 && kernels.rgb24_32_to_y && kernels.rgb24_32_to_cbcr420);
+
+  states.emplace_back(output_state, simd ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
 
   return states;
 }
@@ -617,10 +663,19 @@ Op_RGB24_32_to_YCbCr::convert_colorspace(const std::shared_ptr<const HeifPixelIm
 
   int bytes_per_pixel = (has_alpha ? 4 : 3);
 
+  const auto& simd_kernels = get_RGB_to_YCbCr_row_kernels();
+
   for (uint32_t y = 0; y < height; y++) {
-    const uint8_t* p = &in_p[y * in_stride];
+    uint32_t x = 0;
+    if (simd_kernels.rgb24_32_to_y) {
+      x = simd_kernels.rgb24_32_to_y(&in_p[y * in_stride], bytes_per_pixel, &out_y[y * out_y_stride], width,
+                                     coeffs, full_range_flag);
+    }
 
-    for (uint32_t x = 0; x < width; x++) {
+    // convert the remaining pixels (or all, if there is no SIMD kernel)
+    const uint8_t* p = &in_p[y * in_stride + x * bytes_per_pixel];
+
+    for (; x < width; x++) {
       uint8_t r = p[0];
       uint8_t g = p[1];
       uint8_t b = p[2];
@@ -660,9 +715,16 @@ Op_RGB24_32_to_YCbCr::convert_colorspace(const std::shared_ptr<const HeifPixelIm
     // chroma 4:2:0
 
     for (uint32_t y = 0; y < (height & ~1U); y += 2) {
-      const uint8_t* p = &in_p[y * in_stride];
+      uint32_t x = 0;
+      if (simd_kernels.rgb24_32_to_cbcr420) {
+        x = 2 * simd_kernels.rgb24_32_to_cbcr420(&in_p[y * in_stride], &in_p[(y + 1) * in_stride], bytes_per_pixel,
+                                                 out_cb + (y / 2) * out_cb_stride, out_cr + (y / 2) * out_cr_stride,
+                                                 width / 2, coeffs, full_range_flag);
+      }
+
+      const uint8_t* p = &in_p[y * in_stride + x * bytes_per_pixel];
 
-      for (uint32_t x = 0; x < (width & ~1U); x += 2) {
+      for (; x < (width & ~1U); x += 2) {
         uint8_t r = uint8_t((p[0] + p[bytes_per_pixel + 0] + p[in_stride + 0] + p[bytes_per_pixel + in_stride + 0]) / 4);
         uint8_t g = uint8_t((p[1] + p[bytes_per_pixel + 1] + p[in_stride + 1] + p[bytes_per_pixel + in_stride + 1]) / 4);
         uint8_t b = uint8_t((p[2] + p[bytes_per_pixel + 2] + p[in_stride + 2] + p[bytes_per_pixel + in_stride + 2]) / 4);
@@ -19,6 +19,7 @@
  */
 
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include "rgb2yuv_sharp.h"
@@ -30,6 +31,74 @@
 #include "nclx.h"
 #include "common_utils.h"
 
+#if ENABLE_MULTITHREADING_SUPPORT
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "thread_pool.h"
+
+// Images are split into bands of this height, which are converted in parallel.
+// Both values must be even, such that the bands start at chroma row boundaries.
+static const uint32_t sharpyuv_band_height = 256;
+static const uint32_t sharpyuv_band_overlap_rows = 16;
+
+static const uint32_t sharpyuv_min_pixels_for_bands = 1024 * 1024;
+
+static bool use_bands(uint32_t width, uint32_t height, const heif_color_conversion_options_ext& options_ext)
+{
+  return options_ext.max_threads > 1 &&
+         height > sharpyuv_band_height &&
+         uint64_t{width} * height >= sharpyuv_min_pixels_for_bands;
+}
+
+
+// The band buffers are kept for the next conversion. When converting a sequence of images with the same size
+// (e.g. tiles or image sequences), each band thread will get a buffer of the right size without allocation.
+class SharpYuvScratchPool
+{
+public:
+  std::vector<uint8_t> acquire(size_t size)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      if (size != m_buffer_size) {
+        m_free_buffers.clear();
+        m_buffer_size = size;
+      }
+      else if (!m_free_buffers.empty()) {
+        std::vector<uint8_t> buffer = std::move(m_free_buffers.back());
+        m_free_buffers.pop_back();
+        return buffer;
+      }
+    }
+
+    return std::vector<uint8_t>(size);
+  }
+
+  void release(std::vector<uint8_t>&& buffer)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // drop buffers of an outdated size
+    if (buffer.size() == m_buffer_size && m_free_buffers.size() < max_free_buffers) {
+      m_free_buffers.push_back(std::move(buffer));
+    }
+  }
+
+private:
+  static const size_t max_free_buffers = 64;
+
+  std::mutex m_mutex;
+  size_t m_buffer_size = 0;
+  std::vector<std::vector<uint8_t>> m_free_buffers;
+};
+
+static SharpYuvScratchPool s_scratch_pool;
+
+#endif
+
 static inline bool PlatformIsBigEndian()
 {
   int i = 1;
@@ -234,28 +303,18 @@ Op_Any_RGB_to_YCbCr_420_Sharp::convert_colorspace(
   int input_bytes_per_pixel = (has_alpha ? 4 : 3) * input_bytes_per_sample;
   int rgb_step = planar_input ? input_bytes_per_sample : input_bytes_per_pixel;
 
-  int sharpyuv_ok =
-      SharpYuvConvert(in_r, in_g, in_b, rgb_step, (int)in_stride,
-                      input_bits, out_y, (int)out_y_stride, out_cb, (int)out_cb_stride,
-                      out_cr, (int)out_cr_stride, output_bits,
-                      input->get_width(), input->get_height(), &yuv_matrix);
-  if (!sharpyuv_ok) {
-    return Error{heif_error_Unsupported_feature,
-                 heif_suberror_Unsupported_color_conversion,
-                 "SharpYuv color conversion failed"};
-  }
+  int le = (input_chroma == heif_chroma_interleaved_RRGGBBAA_LE ||
+            input_chroma == heif_chroma_interleaved_RRGGBB_LE ||
+            (planar_input && !PlatformIsBigEndian()))
+           ? 1
+           : 0;
 
-  if (want_alpha) {
-    int le = (input_chroma == heif_chroma_interleaved_RRGGBBAA_LE ||
-              input_chroma == heif_chroma_interleaved_RRGGBB_LE ||
-              (planar_input && !PlatformIsBigEndian()))
-             ? 1
-             : 0;
-    size_t out_a_stride;
-
-    uint8_t* out_a = outimg->get_plane(heif_channel_Alpha, &out_a_stride);
-    uint16_t alpha_max = static_cast<uint16_t>((1 << input_bits) - 1);
-    for (uint32_t y = 0; y < height; y++) {
+  size_t out_a_stride = 0;
+  uint8_t* out_a = want_alpha ? outimg->get_plane(heif_channel_Alpha, &out_a_stride) : nullptr;
+  uint16_t alpha_max = static_cast<uint16_t>((1 << input_bits) - 1);
+
+  auto copy_alpha_rows = [&](uint32_t y0, uint32_t y1) {
+    for (uint32_t y = y0; y < y1; y++) {
       for (uint32_t x = 0; x < width; x++) {
         const uint8_t* in = has_alpha ? &in_a[y * in_a_stride + x * rgb_step] : nullptr;
         uint16_t a = has_alpha
@@ -272,6 +331,105 @@ Op_Any_RGB_to_YCbCr_420_Sharp::convert_colorspace(
         }
       }
     }
+  };
+
+  const Error sharpyuv_error{heif_error_Unsupported_feature,
+                             heif_suberror_Unsupported_color_conversion,
+                             "SharpYuv color conversion failed"};
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (use_bands(width, height, options_ext)) {
+    // Each band is converted with some extra rows above and below into scratch buffers, of which only the
+    // rows of the band are copied into the output image. The extra rows give the iterative optimization
+    // of libsharpyuv the same neighborhood as in the full image, such that there are no visible seams.
+
+    const uint32_t num_bands = (height + sharpyuv_band_height - 1) / sharpyuv_band_height;
+    const size_t out_bytes_per_sample = (output_bits > 8) ? 2 : 1;
+    const uint32_t scratch_rows = sharpyuv_band_height + 2 * sharpyuv_band_overlap_rows;
+    const size_t y_scratch_stride = width * out_bytes_per_sample;
+    const size_t c_scratch_stride = chroma_width * out_bytes_per_sample;
+    const size_t scratch_size = y_scratch_stride * scratch_rows + 2 * c_scratch_stride * (scratch_rows / 2);
+
+    std::vector<Error> band_errors(num_bands);
+    std::atomic<uint32_t> next_band{0};
+
+    auto convert_bands = [&]() {
+      std::vector<uint8_t> scratch = s_scratch_pool.acquire(scratch_size);
+
+      for (;;) {
+        uint32_t band = next_band++;
+        if (band >= num_bands) {
+          break;
+        }
+
+        uint32_t y0 = band * sharpyuv_band_height;
+        uint32_t y1 = std::min(height, y0 + sharpyuv_band_height);
+        uint32_t in_y0 = (y0 >= sharpyuv_band_overlap_rows) ? y0 - sharpyuv_band_overlap_rows : 0;
+        uint32_t in_y1 = std::min(height, y1 + sharpyuv_band_overlap_rows);
+
+        uint8_t* scratch_y = scratch.data();
+        uint8_t* scratch_cb = scratch_y + y_scratch_stride * scratch_rows;
+        uint8_t* scratch_cr = scratch_cb + c_scratch_stride * (scratch_rows / 2);
+
+        int ok = SharpYuvConvert(in_r + in_y0 * in_stride, in_g + in_y0 * in_stride, in_b + in_y0 * in_stride,
+                                 rgb_step, (int) in_stride, input_bits,
+                                 scratch_y, (int) y_scratch_stride,
+                                 scratch_cb, (int) c_scratch_stride,
+                                 scratch_cr, (int) c_scratch_stride, output_bits,
+                                 (int) width, (int) (in_y1 - in_y0), &yuv_matrix);
+        if (!ok) {
+          band_errors[band] = sharpyuv_error;
+          continue;
+        }
+
+        for (uint32_t y = y0; y < y1; y++) {
+          memcpy(out_y + y * out_y_stride, scratch_y + (y - in_y0) * y_scratch_stride, y_scratch_stride);
+        }
+
+        for (uint32_t cy = y0 / 2; cy < (y1 + 1) / 2; cy++) {
+          uint32_t scratch_row = cy - in_y0 / 2;
+          memcpy(out_cb + cy * out_cb_stride, scratch_cb + scratch_row * c_scratch_stride, c_scratch_stride);
+          memcpy(out_cr + cy * out_cr_stride, scratch_cr + scratch_row * c_scratch_stride, c_scratch_stride);
+        }
+
+        if (want_alpha) {
+          copy_alpha_rows(y0, y1);
+        }
+      }
+
+      s_scratch_pool.release(std::move(scratch));
+    };
+
+    size_t num_tasks = std::min(static_cast<size_t>(num_bands), static_cast<size_t>(options_ext.max_threads));
+
+    TaskGroup tasks;
+    for (size_t t = 0; t < num_tasks; t++) {
+      tasks.run(convert_bands);
+    }
+
+    tasks.wait();
+
+    for (const Error& err : band_errors) {
+      if (err) {
+        return err;
+      }
+    }
+
+    return outimg;
+  }
+#endif
+
+  int sharpyuv_ok =
+      SharpYuvConvert(in_r, in_g, in_b, rgb_step, (int)in_stride,
+                      input_bits, out_y, (int)out_y_stride, out_cb, (int)out_cb_stride,
+                      out_cr, (int)out_cr_stride, output_bits,
+                      input->get_width(), input->get_height(), &yuv_matrix);
+  if (!sharpyuv_ok) {
+    return sharpyuv_error;
+  }
+
+  if (want_alpha) {
+    copy_alpha_rows(0, height);
   }
 
   return outimg;
@@ -42,6 +42,9 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const override;
+
+  // libsharpyuv processes the whole image (or, when multithreaded, overlapping bands of it).
+  bool supports_strip_processing(const heif_color_conversion_options_ext&) const override { return false; }
 };
 
 
@@ -0,0 +1,744 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rgb2yuv_simd.h"
+
+#include <cstring>
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+// The output conversions below mirror clip_f_u8() and clip_f_u16(): add 0.5, truncate towards zero, clip.
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+// Shuffle mask that moves one color component of four interleaved pixels into 32-bit lanes.
+HEIF_TARGET_SSE41
+static inline __m128i component_mask_sse41(int first, int step)
+{
+  return _mm_setr_epi8((char) first, -1, -1, -1,
+                       (char) (first + step), -1, -1, -1,
+                       (char) (first + 2 * step), -1, -1, -1,
+                       (char) (first + 3 * step), -1, -1, -1);
+}
+
+
+struct InterleavedLoader_sse41
+{
+  __m128i mask_lo[3];
+  __m128i mask_hi[3];
+
+  // Offset of the second 16-byte load. For RGB, it overlaps with the first load so that we never
+  // read behind the eight pixels.
+  int hi_offset;
+};
+
+
+HEIF_TARGET_SSE41
+static inline InterleavedLoader_sse41 get_interleaved_loader_sse41(int bytes_per_pixel)
+{
+  InterleavedLoader_sse41 loader;
+  loader.hi_offset = (bytes_per_pixel == 4) ? 16 : 8;
+
+  int hi_first = 4 * bytes_per_pixel - loader.hi_offset;
+
+  for (int c = 0; c < 3; c++) {
+    loader.mask_lo[c] = component_mask_sse41(c, bytes_per_pixel);
+    loader.mask_hi[c] = component_mask_sse41(hi_first + c, bytes_per_pixel);
+  }
+
+  return loader;
+}
+
+
+// Loads eight interleaved pixels. The R,G,B components of the first and second four pixels are returned as int32.
+HEIF_TARGET_SSE41
+static inline void load_8_pixels_sse41(const uint8_t* p, const InterleavedLoader_sse41& loader,
+                                       __m128i lo[3], __m128i hi[3])
+{
+  __m128i v0 = _mm_loadu_si128((const __m128i*) p);
+  __m128i v1 = _mm_loadu_si128((const __m128i*) (p + loader.hi_offset));
+
+  for (int c = 0; c < 3; c++) {
+    lo[c] = _mm_shuffle_epi8(v0, loader.mask_lo[c]);
+    hi[c] = _mm_shuffle_epi8(v1, loader.mask_hi[c]);
+  }
+}
+
+
+// Computes r * c[0] + g * c[1] + b * c[2] in the same order as the scalar code.
+HEIF_TARGET_SSE41
+static inline __m128 weighted_sum_sse41(__m128i r, __m128i g, __m128i b, const float* c)
+{
+  __m128 sum = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(r), _mm_set1_ps(c[0])),
+                          _mm_mul_ps(_mm_cvtepi32_ps(g), _mm_set1_ps(c[1])));
+  return _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(b), _mm_set1_ps(c[2])));
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128 weighted_sum_sse41(__m128 r, __m128 g, __m128 b, const float* c)
+{
+  __m128 sum = _mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(c[0])),
+                          _mm_mul_ps(g, _mm_set1_ps(c[1])));
+  return _mm_add_ps(sum, _mm_mul_ps(b, _mm_set1_ps(c[2])));
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i round_clip_sse41(__m128 v, int maxval)
+{
+  __m128i x = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+  return _mm_min_epi32(_mm_max_epi32(x, _mm_setzero_si128()), _mm_set1_epi32(maxval));
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i luma_u8_sse41(__m128 yv, bool full_range)
+{
+  if (full_range) {
+    return round_clip_sse41(yv, 255);
+  }
+  else {
+    return _mm_add_epi32(round_clip_sse41(_mm_mul_ps(yv, _mm_set1_ps(0.85547f)), 219), _mm_set1_epi32(16));
+  }
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i chroma_u8_sse41(__m128 v, bool full_range)
+{
+  if (full_range) {
+    return round_clip_sse41(_mm_add_ps(v, _mm_set1_ps(128.0f)), 255);
+  }
+  else {
+    return round_clip_sse41(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(0.875f)), _mm_set1_ps(128.0f)), 255);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i luma_u16_sse41(__m128 v, bool full_range, int bpp)
+{
+  if (!full_range) {
+    v = _mm_add_ps(_mm_div_ps(_mm_mul_ps(v, _mm_set1_ps(219.0f)), _mm_set1_ps(256.0f)),
+                   _mm_set1_ps(static_cast<float>(16 << (bpp - 8))));
+  }
+
+  return round_clip_sse41(v, (1 << bpp) - 1);
+}
+
+
+HEIF_TARGET_SSE41
+static inline __m128i chroma_u16_sse41(__m128 v, bool full_range, int bpp)
+{
+  if (!full_range) {
+    v = _mm_div_ps(_mm_mul_ps(v, _mm_set1_ps(224.0f)), _mm_set1_ps(256.0f));
+  }
+
+  return round_clip_sse41(_mm_add_ps(v, _mm_set1_ps(static_cast<float>(1 << (bpp - 1)))), (1 << bpp) - 1);
+}
+
+
+// Stores four int32 values that are already clipped to [0;255].
+HEIF_TARGET_SSE41
+static inline void store_4_u8_sse41(uint8_t* out, __m128i v)
+{
+  v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+  int32_t bytes = _mm_cvtsi128_si32(v);
+  memcpy(out, &bytes, 4);
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t RGB24_32_to_Y_row_sse41(const uint8_t* in, int bytes_per_pixel, uint8_t* out_y, uint32_t width,
+                                 const RGB_to_YCbCr_coefficients& coeffs, bool full_range)
+{
+  const InterleavedLoader_sse41 loader = get_interleaved_loader_sse41(bytes_per_pixel);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i lo[3], hi[3];
+    load_8_pixels_sse41(in + x * bytes_per_pixel, loader, lo, hi);
+
+    __m128i y_lo = luma_u8_sse41(weighted_sum_sse41(lo[0], lo[1], lo[2], coeffs.c[0]), full_range);
+    __m128i y_hi = luma_u8_sse41(weighted_sum_sse41(hi[0], hi[1], hi[2], coeffs.c[0]), full_range);
+
+    __m128i y8 = _mm_packus_epi16(_mm_packs_epi32(y_lo, y_hi), _mm_setzero_si128());
+    _mm_storel_epi64((__m128i*) (out_y + x), y8);
+  }
+
+  return x;
+}
+
+
+// Loads 2x8 pixels and returns the (truncated) averages of the four 2x2 blocks as int32.
+HEIF_TARGET_SSE41
+static inline void average_2x2_blocks_sse41(const uint8_t* p0, const uint8_t* p1, const InterleavedLoader_sse41& loader,
+                                            __m128i avg[3])
+{
+  __m128i lo0[3], hi0[3], lo1[3], hi1[3];
+  load_8_pixels_sse41(p0, loader, lo0, hi0);
+  load_8_pixels_sse41(p1, loader, lo1, hi1);
+
+  for (int c = 0; c < 3; c++) {
+    __m128i sum = _mm_hadd_epi32(_mm_add_epi32(lo0[c], lo1[c]), _mm_add_epi32(hi0[c], hi1[c]));
+    avg[c] = _mm_srli_epi32(sum, 2);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t RGB24_32_to_CbCr420_row_sse41(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                       uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                       const RGB_to_YCbCr_coefficients& coeffs, bool full_range)
+{
+  const InterleavedLoader_sse41 loader = get_interleaved_loader_sse41(bytes_per_pixel);
+
+  uint32_t x = 0;
+  for (; x + 4 <= num_samples; x += 4) {
+    __m128i avg[3];
+    average_2x2_blocks_sse41(in_row0 + 2 * x * bytes_per_pixel, in_row1 + 2 * x * bytes_per_pixel, loader, avg);
+
+    store_4_u8_sse41(out_cb + x, chroma_u8_sse41(weighted_sum_sse41(avg[0], avg[1], avg[2], coeffs.c[1]), full_range));
+    store_4_u8_sse41(out_cr + x, chroma_u8_sse41(weighted_sum_sse41(avg[0], avg[1], avg[2], coeffs.c[2]), full_range));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t RGB16_planar_to_Y_row_sse41(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                     uint16_t* out_y, uint32_t width,
+                                     const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i r = _mm_loadu_si128((const __m128i*) (in_r + x));
+    __m128i g = _mm_loadu_si128((const __m128i*) (in_g + x));
+    __m128i b = _mm_loadu_si128((const __m128i*) (in_b + x));
+
+    __m128i y_lo = luma_u16_sse41(weighted_sum_sse41(_mm_cvtepu16_epi32(r),
+                                                     _mm_cvtepu16_epi32(g),
+                                                     _mm_cvtepu16_epi32(b), coeffs.c[0]), full_range, bpp);
+    __m128i y_hi = luma_u16_sse41(weighted_sum_sse41(_mm_cvtepu16_epi32(_mm_srli_si128(r, 8)),
+                                                     _mm_cvtepu16_epi32(_mm_srli_si128(g, 8)),
+                                                     _mm_cvtepu16_epi32(_mm_srli_si128(b, 8)), coeffs.c[0]), full_range, bpp);
+
+    _mm_storeu_si128((__m128i*) (out_y + x), _mm_packus_epi32(y_lo, y_hi));
+  }
+
+  return x;
+}
+
+
+// Sums up the 2x2 blocks of four samples and returns their averages.
+HEIF_TARGET_SSE41
+static inline __m128 average_2x2_blocks_u16_sse41(const uint16_t* p0, const uint16_t* p1)
+{
+  __m128i v0 = _mm_loadu_si128((const __m128i*) p0);
+  __m128i v1 = _mm_loadu_si128((const __m128i*) p1);
+
+  __m128i lo = _mm_add_epi32(_mm_cvtepu16_epi32(v0), _mm_cvtepu16_epi32(v1));
+  __m128i hi = _mm_add_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(v0, 8)), _mm_cvtepu16_epi32(_mm_srli_si128(v1, 8)));
+
+  return _mm_mul_ps(_mm_cvtepi32_ps(_mm_hadd_epi32(lo, hi)), _mm_set1_ps(0.25f));
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t RGB16_planar_to_CbCr420_row_sse41(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                           uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                           const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp)
+{
+  uint32_t x = 0;
+  for (; x + 4 <= num_samples; x += 4) {
+    __m128 r = average_2x2_blocks_u16_sse41(in_row0[0] + 2 * x, in_row1[0] + 2 * x);
+    __m128 g = average_2x2_blocks_u16_sse41(in_row0[1] + 2 * x, in_row1[1] + 2 * x);
+    __m128 b = average_2x2_blocks_u16_sse41(in_row0[2] + 2 * x, in_row1[2] + 2 * x);
+
+    __m128i cb = chroma_u16_sse41(weighted_sum_sse41(r, g, b, coeffs.c[1]), full_range, bpp);
+    __m128i cr = chroma_u16_sse41(weighted_sum_sse41(r, g, b, coeffs.c[2]), full_range, bpp);
+
+    _mm_storel_epi64((__m128i*) (out_cb + x), _mm_packus_epi32(cb, cb));
+    _mm_storel_epi64((__m128i*) (out_cr + x), _mm_packus_epi32(cr, cr));
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+//
+// The AVX2 kernels load their input with the SSE helpers and do the arithmetic on eight values at once.
+
+HEIF_TARGET_AVX2
+static inline __m256 to_float_avx2(__m128i lo, __m128i hi)
+{
+  return _mm256_cvtepi32_ps(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256 weighted_sum_avx2(__m256 r, __m256 g, __m256 b, const float* c)
+{
+  __m256 sum = _mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(c[0])),
+                             _mm256_mul_ps(g, _mm256_set1_ps(c[1])));
+  return _mm256_add_ps(sum, _mm256_mul_ps(b, _mm256_set1_ps(c[2])));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i round_clip_avx2(__m256 v, int maxval)
+{
+  __m256i x = _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_set1_ps(0.5f)));
+  return _mm256_min_epi32(_mm256_max_epi32(x, _mm256_setzero_si256()), _mm256_set1_epi32(maxval));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i luma_u8_avx2(__m256 yv, bool full_range)
+{
+  if (full_range) {
+    return round_clip_avx2(yv, 255);
+  }
+  else {
+    return _mm256_add_epi32(round_clip_avx2(_mm256_mul_ps(yv, _mm256_set1_ps(0.85547f)), 219), _mm256_set1_epi32(16));
+  }
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i chroma_u8_avx2(__m256 v, bool full_range)
+{
+  if (full_range) {
+    return round_clip_avx2(_mm256_add_ps(v, _mm256_set1_ps(128.0f)), 255);
+  }
+  else {
+    return round_clip_avx2(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(0.875f)), _mm256_set1_ps(128.0f)), 255);
+  }
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i luma_u16_avx2(__m256 v, bool full_range, int bpp)
+{
+  if (!full_range) {
+    v = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(v, _mm256_set1_ps(219.0f)), _mm256_set1_ps(256.0f)),
+                      _mm256_set1_ps(static_cast<float>(16 << (bpp - 8))));
+  }
+
+  return round_clip_avx2(v, (1 << bpp) - 1);
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m256i chroma_u16_avx2(__m256 v, bool full_range, int bpp)
+{
+  if (!full_range) {
+    v = _mm256_div_ps(_mm256_mul_ps(v, _mm256_set1_ps(224.0f)), _mm256_set1_ps(256.0f));
+  }
+
+  return round_clip_avx2(_mm256_add_ps(v, _mm256_set1_ps(static_cast<float>(1 << (bpp - 1)))), (1 << bpp) - 1);
+}
+
+
+// Packs eight int32 values in [0;65535] to uint16.
+HEIF_TARGET_AVX2
+static inline __m128i pack_u16_avx2(__m256i v)
+{
+  return _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t RGB24_32_to_Y_row_avx2(const uint8_t* in, int bytes_per_pixel, uint8_t* out_y, uint32_t width,
+                                const RGB_to_YCbCr_coefficients& coeffs, bool full_range)
+{
+  const InterleavedLoader_sse41 loader = get_interleaved_loader_sse41(bytes_per_pixel);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i y16[2];
+
+    for (int half = 0; half < 2; half++) {
+      __m128i lo[3], hi[3];
+      load_8_pixels_sse41(in + (x + 8 * half) * bytes_per_pixel, loader, lo, hi);
+
+      __m256 yv = weighted_sum_avx2(to_float_avx2(lo[0], hi[0]),
+                                    to_float_avx2(lo[1], hi[1]),
+                                    to_float_avx2(lo[2], hi[2]), coeffs.c[0]);
+      y16[half] = pack_u16_avx2(luma_u8_avx2(yv, full_range));
+    }
+
+    _mm_storeu_si128((__m128i*) (out_y + x), _mm_packus_epi16(y16[0], y16[1]));
+  }
+
+  x += RGB24_32_to_Y_row_sse41(in + x * bytes_per_pixel, bytes_per_pixel, out_y + x, width - x, coeffs, full_range);
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t RGB24_32_to_CbCr420_row_avx2(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                      uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                      const RGB_to_YCbCr_coefficients& coeffs, bool full_range)
+{
+  const InterleavedLoader_sse41 loader = get_interleaved_loader_sse41(bytes_per_pixel);
+
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    __m128i avg_lo[3], avg_hi[3];
+    average_2x2_blocks_sse41(in_row0 + 2 * x * bytes_per_pixel, in_row1 + 2 * x * bytes_per_pixel, loader, avg_lo);
+    average_2x2_blocks_sse41(in_row0 + 2 * (x + 4) * bytes_per_pixel, in_row1 + 2 * (x + 4) * bytes_per_pixel, loader, avg_hi);
+
+    __m256 r = to_float_avx2(avg_lo[0], avg_hi[0]);
+    __m256 g = to_float_avx2(avg_lo[1], avg_hi[1]);
+    __m256 b = to_float_avx2(avg_lo[2], avg_hi[2]);
+
+    __m128i cb = pack_u16_avx2(chroma_u8_avx2(weighted_sum_avx2(r, g, b, coeffs.c[1]), full_range));
+    __m128i cr = pack_u16_avx2(chroma_u8_avx2(weighted_sum_avx2(r, g, b, coeffs.c[2]), full_range));
+
+    _mm_storel_epi64((__m128i*) (out_cb + x), _mm_packus_epi16(cb, cb));
+    _mm_storel_epi64((__m128i*) (out_cr + x), _mm_packus_epi16(cr, cr));
+  }
+
+  x += RGB24_32_to_CbCr420_row_sse41(in_row0 + 2 * x * bytes_per_pixel, in_row1 + 2 * x * bytes_per_pixel, bytes_per_pixel,
+                                     out_cb + x, out_cr + x, num_samples - x, coeffs, full_range);
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t RGB16_planar_to_Y_row_avx2(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                    uint16_t* out_y, uint32_t width,
+                                    const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256 r = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in_r + x))));
+    __m256 g = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in_g + x))));
+    __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) (in_b + x))));
+
+    __m256i yv = luma_u16_avx2(weighted_sum_avx2(r, g, b, coeffs.c[0]), full_range, bpp);
+    _mm_storeu_si128((__m128i*) (out_y + x), pack_u16_avx2(yv));
+  }
+
+  return x;
+}
+
+
+// Averages eight 2x2 blocks of a 16-bit plane.
+HEIF_TARGET_AVX2
+static inline __m256 average_2x2_blocks_u16_avx2(const uint16_t* p0, const uint16_t* p1)
+{
+  __m256i v0 = _mm256_loadu_si256((const __m256i*) p0);
+  __m256i v1 = _mm256_loadu_si256((const __m256i*) p1);
+
+  // _mm256_madd_epi16() would interpret the samples as signed. Hence, we add the even and odd samples separately.
+  const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+  __m256i sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(v0, low16), _mm256_srli_epi32(v0, 16)),
+                                 _mm256_add_epi32(_mm256_and_si256(v1, low16), _mm256_srli_epi32(v1, 16)));
+
+  return _mm256_mul_ps(_mm256_cvtepi32_ps(sum), _mm256_set1_ps(0.25f));
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t RGB16_planar_to_CbCr420_row_avx2(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                          uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                          const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    __m256 r = average_2x2_blocks_u16_avx2(in_row0[0] + 2 * x, in_row1[0] + 2 * x);
+    __m256 g = average_2x2_blocks_u16_avx2(in_row0[1] + 2 * x, in_row1[1] + 2 * x);
+    __m256 b = average_2x2_blocks_u16_avx2(in_row0[2] + 2 * x, in_row1[2] + 2 * x);
+
+    __m256i cb = chroma_u16_avx2(weighted_sum_avx2(r, g, b, coeffs.c[1]), full_range, bpp);
+    __m256i cr = chroma_u16_avx2(weighted_sum_avx2(r, g, b, coeffs.c[2]), full_range, bpp);
+
+    _mm_storeu_si128((__m128i*) (out_cb + x), pack_u16_avx2(cb));
+    _mm_storeu_si128((__m128i*) (out_cr + x), pack_u16_avx2(cr));
+  }
+
+  const uint16_t* const rest_row0[3] = {in_row0[0] + 2 * x, in_row0[1] + 2 * x, in_row0[2] + 2 * x};
+  const uint16_t* const rest_row1[3] = {in_row1[0] + 2 * x, in_row1[1] + 2 * x, in_row1[2] + 2 * x};
+
+  x += RGB16_planar_to_CbCr420_row_sse41(rest_row0, rest_row1, out_cb + x, out_cr + x, num_samples - x,
+                                         coeffs, full_range, bpp);
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+// Computes r * c[0] + g * c[1] + b * c[2] in the same order as the scalar code.
+// We use separate multiplies and adds, as the scalar code is not necessarily fused.
+static inline float32x4_t weighted_sum_neon(float32x4_t r, float32x4_t g, float32x4_t b, const float* c)
+{
+  float32x4_t sum = vaddq_f32(vmulq_n_f32(r, c[0]), vmulq_n_f32(g, c[1]));
+  return vaddq_f32(sum, vmulq_n_f32(b, c[2]));
+}
+
+
+static inline int32x4_t round_clip_neon(float32x4_t v, int maxval)
+{
+  int32x4_t x = vcvtq_s32_f32(vaddq_f32(v, vdupq_n_f32(0.5f)));
+  return vminq_s32(vmaxq_s32(x, vdupq_n_s32(0)), vdupq_n_s32(maxval));
+}
+
+
+static inline int32x4_t luma_u8_neon(float32x4_t yv, bool full_range)
+{
+  if (full_range) {
+    return round_clip_neon(yv, 255);
+  }
+  else {
+    return vaddq_s32(round_clip_neon(vmulq_n_f32(yv, 0.85547f), 219), vdupq_n_s32(16));
+  }
+}
+
+
+static inline int32x4_t chroma_u8_neon(float32x4_t v, bool full_range)
+{
+  if (full_range) {
+    return round_clip_neon(vaddq_f32(v, vdupq_n_f32(128.0f)), 255);
+  }
+  else {
+    return round_clip_neon(vaddq_f32(vmulq_n_f32(v, 0.875f), vdupq_n_f32(128.0f)), 255);
+  }
+}
+
+
+static inline int32x4_t luma_u16_neon(float32x4_t v, bool full_range, int bpp)
+{
+  if (!full_range) {
+    // Dividing by 256 and multiplying by 1/256 give the same result. ARMv7 has no vector division.
+    v = vaddq_f32(vmulq_n_f32(vmulq_n_f32(v, 219.0f), 1.0f / 256),
+                  vdupq_n_f32(static_cast<float>(16 << (bpp - 8))));
+  }
+
+  return round_clip_neon(v, (1 << bpp) - 1);
+}
+
+
+static inline int32x4_t chroma_u16_neon(float32x4_t v, bool full_range, int bpp)
+{
+  if (!full_range) {
+    v = vmulq_n_f32(vmulq_n_f32(v, 224.0f), 1.0f / 256);
+  }
+
+  return round_clip_neon(vaddq_f32(v, vdupq_n_f32(static_cast<float>(1 << (bpp - 1)))), (1 << bpp) - 1);
+}
+
+
+static inline float32x4_t u16_lo_to_float(uint16x8_t v)
+{
+  return vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+}
+
+
+static inline float32x4_t u16_hi_to_float(uint16x8_t v)
+{
+  return vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+}
+
+
+// Narrows eight int32 values in [0;255] to uint8.
+static inline uint8x8_t narrow_u8_neon(int32x4_t lo, int32x4_t hi)
+{
+  return vqmovn_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)));
+}
+
+
+// Loads 8 interleaved RGB or RGBA pixels and returns the components as uint16.
+static inline void load_8_pixels_neon(const uint8_t* p, int bytes_per_pixel, uint16x8_t rgb[3])
+{
+  if (bytes_per_pixel == 4) {
+    uint8x8x4_t v = vld4_u8(p);
+    rgb[0] = vmovl_u8(v.val[0]);
+    rgb[1] = vmovl_u8(v.val[1]);
+    rgb[2] = vmovl_u8(v.val[2]);
+  }
+  else {
+    uint8x8x3_t v = vld3_u8(p);
+    rgb[0] = vmovl_u8(v.val[0]);
+    rgb[1] = vmovl_u8(v.val[1]);
+    rgb[2] = vmovl_u8(v.val[2]);
+  }
+}
+
+
+uint32_t RGB24_32_to_Y_row_neon(const uint8_t* in, int bytes_per_pixel, uint8_t* out_y, uint32_t width,
+                                const RGB_to_YCbCr_coefficients& coeffs, bool full_range)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t rgb[3];
+    load_8_pixels_neon(in + x * bytes_per_pixel, bytes_per_pixel, rgb);
+
+    int32x4_t y_lo = luma_u8_neon(weighted_sum_neon(u16_lo_to_float(rgb[0]), u16_lo_to_float(rgb[1]),
+                                                    u16_lo_to_float(rgb[2]), coeffs.c[0]), full_range);
+    int32x4_t y_hi = luma_u8_neon(weighted_sum_neon(u16_hi_to_float(rgb[0]), u16_hi_to_float(rgb[1]),
+                                                    u16_hi_to_float(rgb[2]), coeffs.c[0]), full_range);
+
+    vst1_u8(out_y + x, narrow_u8_neon(y_lo, y_hi));
+  }
+
+  return x;
+}
+
+
+uint32_t RGB24_32_to_CbCr420_row_neon(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                      uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                      const RGB_to_YCbCr_coefficients& coeffs, bool full_range)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= num_samples; x += 8) {
+    float32x4_t lo[3], hi[3];
+
+    for (int half = 0; half < 2; half++) {
+      // 8 pixels of both rows -> 4 chroma samples
+
+      uint16x8_t row0[3], row1[3];
+      load_8_pixels_neon(in_row0 + (2 * x + 8 * half) * bytes_per_pixel, bytes_per_pixel, row0);
+      load_8_pixels_neon(in_row1 + (2 * x + 8 * half) * bytes_per_pixel, bytes_per_pixel, row1);
+
+      for (int c = 0; c < 3; c++) {
+        uint32x4_t sum = vaddq_u32(vpaddlq_u16(row0[c]), vpaddlq_u16(row1[c]));
+        float32x4_t avg = vcvtq_f32_u32(vshrq_n_u32(sum, 2));
+        (half ? hi : lo)[c] = avg;
+      }
+    }
+
+    int32x4_t cb_lo = chroma_u8_neon(weighted_sum_neon(lo[0], lo[1], lo[2], coeffs.c[1]), full_range);
+    int32x4_t cb_hi = chroma_u8_neon(weighted_sum_neon(hi[0], hi[1], hi[2], coeffs.c[1]), full_range);
+    int32x4_t cr_lo = chroma_u8_neon(weighted_sum_neon(lo[0], lo[1], lo[2], coeffs.c[2]), full_range);
+    int32x4_t cr_hi = chroma_u8_neon(weighted_sum_neon(hi[0], hi[1], hi[2], coeffs.c[2]), full_range);
+
+    vst1_u8(out_cb + x, narrow_u8_neon(cb_lo, cb_hi));
+    vst1_u8(out_cr + x, narrow_u8_neon(cr_lo, cr_hi));
+  }
+
+  return x;
+}
+
+
+uint32_t RGB16_planar_to_Y_row_neon(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                    uint16_t* out_y, uint32_t width,
+                                    const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t r = vld1q_u16(in_r + x);
+    uint16x8_t g = vld1q_u16(in_g + x);
+    uint16x8_t b = vld1q_u16(in_b + x);
+
+    int32x4_t y_lo = luma_u16_neon(weighted_sum_neon(u16_lo_to_float(r), u16_lo_to_float(g),
+                                                     u16_lo_to_float(b), coeffs.c[0]), full_range, bpp);
+    int32x4_t y_hi = luma_u16_neon(weighted_sum_neon(u16_hi_to_float(r), u16_hi_to_float(g),
+                                                     u16_hi_to_float(b), coeffs.c[0]), full_range, bpp);
+
+    vst1q_u16(out_y + x, vcombine_u16(vqmovun_s32(y_lo), vqmovun_s32(y_hi)));
+  }
+
+  return x;
+}
+
+
+uint32_t RGB16_planar_to_CbCr420_row_neon(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                          uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                          const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp)
+{
+  uint32_t x = 0;
+  for (; x + 4 <= num_samples; x += 4) {
+    float32x4_t avg[3];
+
+    for (int c = 0; c < 3; c++) {
+      uint32x4_t sum = vaddq_u32(vpaddlq_u16(vld1q_u16(in_row0[c] + 2 * x)),
+                                 vpaddlq_u16(vld1q_u16(in_row1[c] + 2 * x)));
+      avg[c] = vmulq_n_f32(vcvtq_f32_u32(sum), 0.25f);
+    }
+
+    int32x4_t cb = chroma_u16_neon(weighted_sum_neon(avg[0], avg[1], avg[2], coeffs.c[1]), full_range, bpp);
+    int32x4_t cr = chroma_u16_neon(weighted_sum_neon(avg[0], avg[1], avg[2], coeffs.c[2]), full_range, bpp);
+
+    vst1_u16(out_cb + x, vqmovun_s32(cb));
+    vst1_u16(out_cr + x, vqmovun_s32(cr));
+  }
+
+  return x;
+}
+
+#endif
+
+
+static RGB_to_YCbCr_row_kernels select_RGB_to_YCbCr_row_kernels()
+{
+  RGB_to_YCbCr_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.rgb24_32_to_y = RGB24_32_to_Y_row_avx2;
+    kernels.rgb24_32_to_cbcr420 = RGB24_32_to_CbCr420_row_avx2;
+    kernels.rgb16_planar_to_y = RGB16_planar_to_Y_row_avx2;
+    kernels.rgb16_planar_to_cbcr420 = RGB16_planar_to_CbCr420_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.rgb24_32_to_y = RGB24_32_to_Y_row_sse41;
+    kernels.rgb24_32_to_cbcr420 = RGB24_32_to_CbCr420_row_sse41;
+    kernels.rgb16_planar_to_y = RGB16_planar_to_Y_row_sse41;
+    kernels.rgb16_planar_to_cbcr420 = RGB16_planar_to_CbCr420_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.rgb24_32_to_y = RGB24_32_to_Y_row_neon;
+    kernels.rgb24_32_to_cbcr420 = RGB24_32_to_CbCr420_row_neon;
+    kernels.rgb16_planar_to_y = RGB16_planar_to_Y_row_neon;
+    kernels.rgb16_planar_to_cbcr420 = RGB16_planar_to_CbCr420_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const RGB_to_YCbCr_row_kernels& get_RGB_to_YCbCr_row_kernels()
+{
+  static const RGB_to_YCbCr_row_kernels kernels = select_RGB_to_YCbCr_row_kernels();
+  return kernels;
+}
@@ -0,0 +1,125 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_RGB2YUV_SIMD_H
+#define LIBHEIF_COLORCONVERSION_RGB2YUV_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+#include "nclx.h"
+
+
+// Row kernels for the RGB -> YCbCr conversion of the encoding path.
+//
+// Like the YCbCr -> RGB kernels, they convert the first part of a row in blocks and return the number
+// of converted output samples. The rest of the row has to be converted by the scalar code.
+// The kernels evaluate the floating point expressions of the scalar code in rgb2yuv.cc in the same order.
+// The results are bit-exact with it, as long as the compiler does not contract the scalar code into
+// fused multiply-adds (which it doesn't at the x86 baseline architecture).
+
+
+// 8-bit interleaved RGB (bytes_per_pixel = 3) or RGBA (bytes_per_pixel = 4) to luma.
+typedef uint32_t (*RGB24_32_to_Y_row_kernel)(const uint8_t* in, int bytes_per_pixel,
+                                             uint8_t* out_y, uint32_t width,
+                                             const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+// 8-bit interleaved RGB(A) to 4:2:0 chroma. Each output sample is computed from two pixels of 'in_row0'
+// and two pixels of 'in_row1'. 'num_samples' is the number of complete pixel pairs in the row.
+typedef uint32_t (*RGB24_32_to_CbCr420_row_kernel)(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                                   uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                                   const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+// Planar RGB with 9-16 bits per sample to luma.
+typedef uint32_t (*RGB16_planar_to_Y_row_kernel)(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                                 uint16_t* out_y, uint32_t width,
+                                                 const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+// Planar RGB with 9-16 bits per sample to 4:2:0 chroma. The row pointers with index 1 belong to the second row.
+typedef uint32_t (*RGB16_planar_to_CbCr420_row_kernel)(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                                       uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                                       const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+
+struct RGB_to_YCbCr_row_kernels
+{
+  RGB24_32_to_Y_row_kernel rgb24_32_to_y = nullptr;
+  RGB24_32_to_CbCr420_row_kernel rgb24_32_to_cbcr420 = nullptr;
+  RGB16_planar_to_Y_row_kernel rgb16_planar_to_y = nullptr;
+  RGB16_planar_to_CbCr420_row_kernel rgb16_planar_to_cbcr420 = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t RGB24_32_to_Y_row_sse41(const uint8_t* in, int bytes_per_pixel, uint8_t* out_y, uint32_t width,
+                                 const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+uint32_t RGB24_32_to_CbCr420_row_sse41(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                       uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                       const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+uint32_t RGB16_planar_to_Y_row_sse41(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                     uint16_t* out_y, uint32_t width,
+                                     const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+uint32_t RGB16_planar_to_CbCr420_row_sse41(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                           uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                           const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+uint32_t RGB24_32_to_Y_row_avx2(const uint8_t* in, int bytes_per_pixel, uint8_t* out_y, uint32_t width,
+                                const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+uint32_t RGB24_32_to_CbCr420_row_avx2(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                      uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                      const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+uint32_t RGB16_planar_to_Y_row_avx2(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                    uint16_t* out_y, uint32_t width,
+                                    const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+uint32_t RGB16_planar_to_CbCr420_row_avx2(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                          uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                          const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t RGB24_32_to_Y_row_neon(const uint8_t* in, int bytes_per_pixel, uint8_t* out_y, uint32_t width,
+                                const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+uint32_t RGB24_32_to_CbCr420_row_neon(const uint8_t* in_row0, const uint8_t* in_row1, int bytes_per_pixel,
+                                      uint8_t* out_cb, uint8_t* out_cr, uint32_t num_samples,
+                                      const RGB_to_YCbCr_coefficients& coeffs, bool full_range);
+
+uint32_t RGB16_planar_to_Y_row_neon(const uint16_t* in_r, const uint16_t* in_g, const uint16_t* in_b,
+                                    uint16_t* out_y, uint32_t width,
+                                    const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+uint32_t RGB16_planar_to_CbCr420_row_neon(const uint16_t* const in_row0[3], const uint16_t* const in_row1[3],
+                                          uint16_t* out_cb, uint16_t* out_cr, uint32_t num_samples,
+                                          const RGB_to_YCbCr_coefficients& coeffs, bool full_range, int bpp);
+
+#endif
+
+
+const RGB_to_YCbCr_row_kernels& get_RGB_to_YCbCr_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_RGB2YUV_SIMD_H
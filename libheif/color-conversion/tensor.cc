@@ -0,0 +1,485 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "tensor.h"
+#include "tensor_simd.h"
+#include "colorconversion.h"
+#include "float_conversion_simd.h"
+#include "common_utils.h"
+
+
+namespace {
+  // Linear interpolation between two samples: value = in[i0] + w * (in[i1] - in[i0])
+  struct LinearTap
+  {
+    uint32_t i0 = 0, i1 = 0;
+    float w = 0.0f;
+  };
+
+  struct TensorPlane
+  {
+    const uint8_t* data = nullptr;
+    size_t stride = 0;
+    uint32_t width = 0, height = 0;
+    bool hdr = false; // 16 bit samples
+
+    std::vector<LinearTap> h_taps; // for each tensor column
+    std::vector<LinearTap> v_taps; // for each tensor row
+    bool h_identity = false; // the plane columns are the tensor columns
+  };
+
+  // Row buffers of one plane for one thread.
+  struct PlaneRowBuffers
+  {
+    std::vector<float> row0, row1, out;
+  };
+}
+
+
+// Sample positions of 'out_size' tensor samples in a plane of 'plane_size' samples that covers 'image_size' pixels.
+// Sample centers are at +0.5, chroma samples are centered between the luma samples.
+static std::vector<LinearTap> compute_taps(uint32_t out_size, uint32_t image_size, uint32_t plane_size, int subsampling)
+{
+  std::vector<LinearTap> taps(out_size);
+
+  for (uint32_t i = 0; i < out_size; i++) {
+    double pos = (i + 0.5) * image_size / out_size / subsampling - 0.5;
+
+    LinearTap& tap = taps[i];
+    if (pos <= 0) {
+      tap.i0 = tap.i1 = 0;
+    }
+    else if (pos >= plane_size - 1) {
+      tap.i0 = tap.i1 = plane_size - 1;
+    }
+    else {
+      tap.i0 = static_cast<uint32_t>(pos);
+      tap.i1 = tap.i0 + 1;
+      tap.w = static_cast<float>(pos - tap.i0);
+    }
+  }
+
+  return taps;
+}
+
+
+static bool taps_are_identity(const std::vector<LinearTap>& taps, uint32_t plane_size)
+{
+  if (taps.size() != plane_size) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < plane_size; i++) {
+    if (taps[i].i0 != i || taps[i].w != 0.0f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+static void load_row(const TensorPlane& plane, uint32_t y, float* out)
+{
+  const Float_row_kernels& kernels = get_float_row_kernels();
+  const uint8_t* row = plane.data + y * plane.stride;
+
+  uint32_t x = 0;
+  if (plane.hdr) {
+    auto* in = reinterpret_cast<const uint16_t*>(row);
+    if (kernels.uint16_to_float) {
+      x = kernels.uint16_to_float(in, out, plane.width, 1.0f);
+    }
+
+    for (; x < plane.width; x++) {
+      out[x] = in[x];
+    }
+  }
+  else {
+    if (kernels.uint8_to_float) {
+      x = kernels.uint8_to_float(row, out, plane.width, 1.0f);
+    }
+
+    for (; x < plane.width; x++) {
+      out[x] = row[x];
+    }
+  }
+}
+
+
+// Returns the values of 'plane' at the sample positions of tensor row 'y'.
+static const float* interpolate_row(const TensorPlane& plane, uint32_t y, uint32_t out_width, PlaneRowBuffers& buffers)
+{
+  const LinearTap& v = plane.v_taps[y];
+
+  float* row = buffers.row0.data();
+  load_row(plane, v.i0, row);
+
+  if (v.w != 0.0f) {
+    float* next_row = buffers.row1.data();
+    load_row(plane, v.i1, next_row);
+
+    uint32_t x = 0;
+    if (auto kernel = get_tensor_row_kernels().lerp) {
+      x = kernel(row, next_row, row, plane.width, v.w);
+    }
+
+    for (; x < plane.width; x++) {
+      row[x] = row[x] + v.w * (next_row[x] - row[x]);
+    }
+  }
+
+  if (plane.h_identity) {
+    return row;
+  }
+
+  float* out = buffers.out.data();
+  for (uint32_t x = 0; x < out_width; x++) {
+    const LinearTap& t = plane.h_taps[x];
+    out[x] = row[t.i0] + t.w * (row[t.i1] - row[t.i0]);
+  }
+
+  return out;
+}
+
+
+static bool can_convert_directly(const HeifPixelImage& image, const std::vector<heif_channel>& channels)
+{
+  int bpp = image.get_bits_per_pixel(channels[0]);
+
+  for (heif_channel channel : channels) {
+    if (!image.has_channel(channel) ||
+        image.get_datatype(channel) != heif_channel_datatype_unsigned_integer ||
+        image.get_bits_per_pixel(channel) != bpp) {
+      return false;
+    }
+  }
+
+  return bpp >= 1 && bpp <= 16;
+}
+
+
+static std::vector<heif_channel> get_tensor_channels(const HeifPixelImage& image)
+{
+  switch (image.get_colorspace()) {
+    case heif_colorspace_YCbCr:
+      if (image.get_chroma_format() == heif_chroma_420 ||
+          image.get_chroma_format() == heif_chroma_422 ||
+          image.get_chroma_format() == heif_chroma_444) {
+        return {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+      }
+      break;
+    case heif_colorspace_monochrome:
+      if (image.get_chroma_format() == heif_chroma_monochrome) {
+        return {heif_channel_Y};
+      }
+      break;
+    case heif_colorspace_RGB:
+      if (image.get_chroma_format() == heif_chroma_444) {
+        return {heif_channel_R, heif_channel_G, heif_channel_B};
+      }
+      break;
+    default:
+      break;
+  }
+
+  return {};
+}
+
+
+// The conversion of the sample values to RGB in [0,1], as in Op_YCbCr_to_RGB, Op_mono_to_RGB24_32 and the planar RGB ops.
+static TensorMatrix get_tensor_matrix(const HeifPixelImage& image, int bpp)
+{
+  TensorMatrix matrix;
+
+  const float max_value = static_cast<float>((1 << bpp) - 1);
+
+  if (image.get_colorspace() == heif_colorspace_monochrome) {
+    for (int c = 0; c < 3; c++) {
+      matrix.m[c][0] = 1.0f / max_value;
+    }
+
+    return matrix;
+  }
+
+  if (image.get_colorspace() == heif_colorspace_RGB) {
+    for (int c = 0; c < 3; c++) {
+      matrix.m[c][c] = 1.0f / max_value;
+    }
+
+    return matrix;
+  }
+
+  color_profile_nclx nclx;
+  if (image.get_color_profile_nclx()) {
+    nclx = *image.get_color_profile_nclx();
+  }
+  nclx.replace_undefined_values_with_sRGB_defaults();
+
+  // y' = Y * y_scale + y_offset, c' = C * c_scale + c_offset, in the range of [0,1]
+  float y_scale = 1.0f / max_value;
+  float y_offset = 0.0f;
+  float c_scale = 1.0f / max_value;
+  float c_offset = -static_cast<float>(1 << (bpp - 1)) / max_value;
+
+  if (!nclx.get_full_range_flag()) {
+    float limited_range_offset = 16.0f * static_cast<float>(1 << bpp) / 256.0f;
+    y_scale = 1.1689f / max_value;
+    y_offset = -limited_range_offset * 1.1689f / max_value;
+    c_scale = 1.1429f / max_value;
+    c_offset *= 1.1429f;
+  }
+
+  uint16_t matrix_coefficients = nclx.get_matrix_coefficients();
+
+  if (matrix_coefficients == 0) {
+    // GBR
+    matrix.m[0][2] = y_scale;
+    matrix.m[1][0] = y_scale;
+    matrix.m[2][1] = y_scale;
+    matrix.offset[0] = matrix.offset[1] = matrix.offset[2] = y_offset;
+  }
+  else if (matrix_coefficients == 8) {
+    // YCgCo
+    matrix.m[0][0] = y_scale;
+    matrix.m[0][1] = -c_scale;
+    matrix.m[0][2] = c_scale;
+    matrix.offset[0] = y_offset;
+
+    matrix.m[1][0] = y_scale;
+    matrix.m[1][1] = c_scale;
+    matrix.offset[1] = y_offset + c_offset;
+
+    matrix.m[2][0] = y_scale;
+    matrix.m[2][1] = -c_scale;
+    matrix.m[2][2] = -c_scale;
+    matrix.offset[2] = y_offset - 2 * c_offset;
+  }
+  else {
+    YCbCr_to_RGB_coefficients coeffs = get_YCbCr_to_RGB_coefficients(matrix_coefficients, nclx.get_colour_primaries());
+
+    matrix.m[0][0] = y_scale;
+    matrix.m[0][2] = coeffs.r_cr * c_scale;
+    matrix.offset[0] = y_offset + coeffs.r_cr * c_offset;
+
+    matrix.m[1][0] = y_scale;
+    matrix.m[1][1] = coeffs.g_cb * c_scale;
+    matrix.m[1][2] = coeffs.g_cr * c_scale;
+    matrix.offset[1] = y_offset + (coeffs.g_cb + coeffs.g_cr) * c_offset;
+
+    matrix.m[2][0] = y_scale;
+    matrix.m[2][1] = coeffs.b_cb * c_scale;
+    matrix.offset[2] = y_offset + coeffs.b_cb * c_offset;
+  }
+
+  return matrix;
+}
+
+
+static void convert_float_row_to_half(const float* in, uint16_t* out, size_t width)
+{
+  size_t x = 0;
+  if (auto kernel = get_float_row_kernels().float_to_half) {
+    x = kernel(in, out, static_cast<uint32_t>(width));
+  }
+
+  for (; x < width; x++) {
+    out[x] = float_to_half(in[x]);
+  }
+}
+
+
+Error convert_to_tensor(const std::shared_ptr<const HeifPixelImage>& input,
+                        const heif_tensor_options& options,
+                        void* out_data, size_t out_data_size,
+                        const heif_color_conversion_options& conversion_options,
+                        const heif_color_conversion_options_ext& options_ext,
+                        const heif_security_limits* limits)
+{
+  const uint32_t width = (options.width ? options.width : input->get_width());
+  const uint32_t height = (options.height ? options.height : input->get_height());
+  const bool planar = (options.layout == heif_tensor_layout_planar);
+  const bool half = (options.datatype == heif_tensor_datatype_float16);
+  const size_t value_size = (half ? 2 : 4);
+
+  if (width == 0 || height == 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Tensor has zero size"};
+  }
+
+  if ((options.layout != heif_tensor_layout_planar && options.layout != heif_tensor_layout_interleaved) ||
+      (options.datatype != heif_tensor_datatype_float32 && options.datatype != heif_tensor_datatype_float16)) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Invalid tensor layout or datatype"};
+  }
+
+  uint64_t num_pixels = uint64_t{width} * height;
+  if (num_pixels > std::numeric_limits<size_t>::max() / (3 * value_size) ||
+      num_pixels * 3 * value_size > out_data_size) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Tensor buffer is too small"};
+  }
+
+  for (int c = 0; c < 3; c++) {
+    if (!(options.std[c] != 0.0f)) {
+      return {heif_error_Usage_error,
+              heif_suberror_Invalid_parameter_value,
+              "Tensor normalization with zero standard deviation"};
+    }
+  }
+
+
+  // --- images that cannot be converted in one pass are converted to planar RGB first
+
+  std::shared_ptr<const HeifPixelImage> image = input;
+  std::vector<heif_channel> channels = get_tensor_channels(*image);
+
+  if (channels.empty() || !can_convert_directly(*image, channels)) {
+    auto conversionResult = convert_colorspace(image, heif_colorspace_RGB, heif_chroma_444, nullptr, 0,
+                                               conversion_options, &options_ext, limits);
+    if (conversionResult.error) {
+      return conversionResult.error;
+    }
+
+    image = *conversionResult;
+    channels = get_tensor_channels(*image);
+
+    if (channels.empty() || !can_convert_directly(*image, channels)) {
+      return {heif_error_Unsupported_feature,
+              heif_suberror_Unsupported_color_conversion,
+              "Image cannot be converted to a tensor"};
+    }
+  }
+
+  const int bpp = image->get_bits_per_pixel(channels[0]);
+
+  TensorMatrix matrix = get_tensor_matrix(*image, bpp);
+  for (int c = 0; c < 3; c++) {
+    matrix.scale[c] = 1.0f / options.std[c];
+    matrix.bias[c] = -options.mean[c] / options.std[c];
+  }
+
+  std::vector<TensorPlane> planes(channels.size());
+  for (size_t i = 0; i < channels.size(); i++) {
+    TensorPlane& plane = planes[i];
+    plane.data = image->get_plane(channels[i], &plane.stride);
+    plane.width = image->get_width(channels[i]);
+    plane.height = image->get_height(channels[i]);
+    plane.hdr = (bpp > 8);
+
+    bool chroma = (channels[i] == heif_channel_Cb || channels[i] == heif_channel_Cr);
+    int h_subsampling = (chroma ? chroma_h_subsampling(image->get_chroma_format()) : 1);
+    int v_subsampling = (chroma ? chroma_v_subsampling(image->get_chroma_format()) : 1);
+
+    plane.h_taps = compute_taps(width, image->get_width(), plane.width, h_subsampling);
+    plane.v_taps = compute_taps(height, image->get_height(), plane.height, v_subsampling);
+    plane.h_identity = taps_are_identity(plane.h_taps, plane.width);
+  }
+
+
+  // --- compute the tensor rows
+
+  const Tensor_row_kernels& kernels = get_tensor_row_kernels();
+
+  convert_in_row_bands(width, height, options_ext.max_threads, [&](uint32_t y0, uint32_t y1) {
+    std::vector<PlaneRowBuffers> buffers(planes.size());
+    for (size_t i = 0; i < planes.size(); i++) {
+      buffers[i].row0.resize(planes[i].width);
+      buffers[i].row1.resize(planes[i].width);
+      buffers[i].out.resize(width);
+    }
+
+    // RGB rows, unless they are written directly into the tensor
+    std::vector<float> rgb_rows[3];
+    if (!planar || half) {
+      for (auto& row : rgb_rows) {
+        row.resize(width);
+      }
+    }
+
+    std::vector<float> interleaved_row;
+    if (!planar && half) {
+      interleaved_row.resize(size_t{width} * 3);
+    }
+
+    for (uint32_t y = y0; y < y1; y++) {
+      const float* in[3];
+      for (size_t i = 0; i < planes.size(); i++) {
+        in[i] = interpolate_row(planes[i], y, width, buffers[i]);
+      }
+
+      if (planes.size() == 1) {
+        in[1] = in[2] = in[0];
+      }
+
+      float* rgb[3];
+      for (int c = 0; c < 3; c++) {
+        if (planar && !half) {
+          rgb[c] = static_cast<float*>(out_data) + (static_cast<size_t>(c) * height + y) * width;
+        }
+        else {
+          rgb[c] = rgb_rows[c].data();
+        }
+      }
+
+      uint32_t x = 0;
+      if (kernels.matrix) {
+        x = kernels.matrix(in[0], in[1], in[2], rgb[0], rgb[1], rgb[2], width, matrix);
+      }
+
+      for (; x < width; x++) {
+        for (int c = 0; c < 3; c++) {
+          rgb[c][x] = tensor_matrix_sample(matrix, c, in[0][x], in[1][x], in[2][x]);
+        }
+      }
+
+      // --- store in the tensor layout
+
+      if (planar) {
+        if (half) {
+          for (int c = 0; c < 3; c++) {
+            convert_float_row_to_half(rgb[c], static_cast<uint16_t*>(out_data) + (static_cast<size_t>(c) * height + y) * width, width);
+          }
+        }
+      }
+      else {
+        float* out_row = (half ? interleaved_row.data() : static_cast<float*>(out_data) + size_t{y} * width * 3);
+        for (uint32_t i = 0; i < width; i++) {
+          out_row[3 * i + 0] = rgb[0][i];
+          out_row[3 * i + 1] = rgb[1][i];
+          out_row[3 * i + 2] = rgb[2][i];
+        }
+
+        if (half) {
+          convert_float_row_to_half(out_row, static_cast<uint16_t*>(out_data) + size_t{y} * width * 3, size_t{width} * 3);
+        }
+      }
+    }
+  });
+
+  return Error::Ok;
+}
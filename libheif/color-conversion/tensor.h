@@ -0,0 +1,44 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_TENSOR_H
+#define LIBHEIF_COLORCONVERSION_TENSOR_H
+
+#include "pixelimage.h"
+#include "error.h"
+#include <memory>
+
+
+// Computes the RGB tensor of heif_decode_image_to_tensor() from a decoded image.
+//
+// YCbCr, monochrome and planar RGB images with integer samples are converted in a single pass: for each tensor row,
+// the image rows are interpolated to float rows of the tensor size, then converted to RGB and normalized.
+// Other images (e.g. with floating point samples or interleaved pixels) are first converted to planar RGB.
+// The chroma samples are assumed to be centered between the luma samples, as in the bilinear chroma upsampling.
+//
+// Large tensors are computed in row bands on the thread pool when options_ext.max_threads > 1.
+Error convert_to_tensor(const std::shared_ptr<const HeifPixelImage>& image,
+                        const heif_tensor_options& options,
+                        void* out_data, size_t out_data_size,
+                        const heif_color_conversion_options& conversion_options,
+                        const heif_color_conversion_options_ext& options_ext,
+                        const heif_security_limits* limits);
+
+#endif //LIBHEIF_COLORCONVERSION_TENSOR_H
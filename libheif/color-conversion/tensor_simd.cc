@@ -0,0 +1,209 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tensor_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+HEIF_TARGET_SSE41
+uint32_t tensor_lerp_row_sse41(const float* a, const float* b, float* out, uint32_t width, float w)
+{
+  const __m128 wv = _mm_set1_ps(w);
+
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128 va = _mm_loadu_ps(a + x);
+    __m128 vb = _mm_loadu_ps(b + x);
+    _mm_storeu_ps(out + x, _mm_add_ps(va, _mm_mul_ps(wv, _mm_sub_ps(vb, va))));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t tensor_matrix_row_sse41(const float* in0, const float* in1, const float* in2,
+                                 float* out0, float* out1, float* out2,
+                                 uint32_t width, const TensorMatrix& matrix)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  float* out[3] = {out0, out1, out2};
+
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128 a = _mm_loadu_ps(in0 + x);
+    __m128 b = _mm_loadu_ps(in1 + x);
+    __m128 c = _mm_loadu_ps(in2 + x);
+
+    for (int ch = 0; ch < 3; ch++) {
+      __m128 v = _mm_mul_ps(_mm_set1_ps(matrix.m[ch][0]), a);
+      v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(matrix.m[ch][1]), b));
+      v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(matrix.m[ch][2]), c));
+      v = _mm_add_ps(v, _mm_set1_ps(matrix.offset[ch]));
+      v = _mm_min_ps(_mm_max_ps(v, zero), one);
+      v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(matrix.scale[ch])), _mm_set1_ps(matrix.bias[ch]));
+      _mm_storeu_ps(out[ch] + x, v);
+    }
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+HEIF_TARGET_AVX2
+uint32_t tensor_lerp_row_avx2(const float* a, const float* b, float* out, uint32_t width, float w)
+{
+  const __m256 wv = _mm256_set1_ps(w);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256 va = _mm256_loadu_ps(a + x);
+    __m256 vb = _mm256_loadu_ps(b + x);
+    _mm256_storeu_ps(out + x, _mm256_add_ps(va, _mm256_mul_ps(wv, _mm256_sub_ps(vb, va))));
+  }
+
+  return x;
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t tensor_matrix_row_avx2(const float* in0, const float* in1, const float* in2,
+                                float* out0, float* out1, float* out2,
+                                uint32_t width, const TensorMatrix& matrix)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  float* out[3] = {out0, out1, out2};
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256 a = _mm256_loadu_ps(in0 + x);
+    __m256 b = _mm256_loadu_ps(in1 + x);
+    __m256 c = _mm256_loadu_ps(in2 + x);
+
+    for (int ch = 0; ch < 3; ch++) {
+      __m256 v = _mm256_mul_ps(_mm256_set1_ps(matrix.m[ch][0]), a);
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_set1_ps(matrix.m[ch][1]), b));
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_set1_ps(matrix.m[ch][2]), c));
+      v = _mm256_add_ps(v, _mm256_set1_ps(matrix.offset[ch]));
+      v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+      v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(matrix.scale[ch])), _mm256_set1_ps(matrix.bias[ch]));
+      _mm256_storeu_ps(out[ch] + x, v);
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+uint32_t tensor_lerp_row_neon(const float* a, const float* b, float* out, uint32_t width, float w)
+{
+  const float32x4_t wv = vdupq_n_f32(w);
+
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    float32x4_t va = vld1q_f32(a + x);
+    float32x4_t vb = vld1q_f32(b + x);
+    vst1q_f32(out + x, vaddq_f32(va, vmulq_f32(wv, vsubq_f32(vb, va))));
+  }
+
+  return x;
+}
+
+
+uint32_t tensor_matrix_row_neon(const float* in0, const float* in1, const float* in2,
+                                float* out0, float* out1, float* out2,
+                                uint32_t width, const TensorMatrix& matrix)
+{
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  float* out[3] = {out0, out1, out2};
+
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    float32x4_t a = vld1q_f32(in0 + x);
+    float32x4_t b = vld1q_f32(in1 + x);
+    float32x4_t c = vld1q_f32(in2 + x);
+
+    for (int ch = 0; ch < 3; ch++) {
+      float32x4_t v = vmulq_n_f32(a, matrix.m[ch][0]);
+      v = vaddq_f32(v, vmulq_n_f32(b, matrix.m[ch][1]));
+      v = vaddq_f32(v, vmulq_n_f32(c, matrix.m[ch][2]));
+      v = vaddq_f32(v, vdupq_n_f32(matrix.offset[ch]));
+      v = vminq_f32(vmaxq_f32(v, zero), one);
+      v = vaddq_f32(vmulq_n_f32(v, matrix.scale[ch]), vdupq_n_f32(matrix.bias[ch]));
+      vst1q_f32(out[ch] + x, v);
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+
+static Tensor_row_kernels select_tensor_row_kernels()
+{
+  Tensor_row_kernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    kernels.lerp = tensor_lerp_row_avx2;
+    kernels.matrix = tensor_matrix_row_avx2;
+  }
+  else if (cpu_supports_sse41()) {
+    kernels.lerp = tensor_lerp_row_sse41;
+    kernels.matrix = tensor_matrix_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.lerp = tensor_lerp_row_neon;
+    kernels.matrix = tensor_matrix_row_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+const Tensor_row_kernels& get_tensor_row_kernels()
+{
+  static const Tensor_row_kernels kernels = select_tensor_row_kernels();
+  return kernels;
+}
@@ -0,0 +1,96 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_TENSOR_SIMD_H
+#define LIBHEIF_COLORCONVERSION_TENSOR_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// Maps three rows of sample values to the normalized tensor channels:
+//   v[c] = clamp(m[c][0] * in0 + m[c][1] * in1 + m[c][2] * in2 + offset[c], 0, 1)
+//   out[c] = v[c] * scale[c] + bias[c]
+// The matrix includes the YCbCr to RGB conversion and the sample range, scale and bias the normalization.
+struct TensorMatrix
+{
+  float m[3][3] = {};
+  float offset[3] = {};
+  float scale[3] = {1, 1, 1};
+  float bias[3] = {};
+};
+
+
+inline float tensor_matrix_sample(const TensorMatrix& matrix, int c, float in0, float in1, float in2)
+{
+  float v = matrix.m[c][0] * in0 + matrix.m[c][1] * in1 + matrix.m[c][2] * in2 + matrix.offset[c];
+  v = (v < 0.0f ? 0.0f : v);
+  v = (v > 1.0f ? 1.0f : v);
+  return v * matrix.scale[c] + matrix.bias[c];
+}
+
+
+// Row kernels (see cpu_features.h). They return the number of processed samples.
+
+// out = a + w * (b - a)
+typedef uint32_t (*Tensor_lerp_row_kernel)(const float* a, const float* b, float* out, uint32_t width, float w);
+
+typedef uint32_t (*Tensor_matrix_row_kernel)(const float* in0, const float* in1, const float* in2,
+                                             float* out0, float* out1, float* out2,
+                                             uint32_t width, const TensorMatrix& matrix);
+
+
+struct Tensor_row_kernels
+{
+  Tensor_lerp_row_kernel lerp = nullptr;
+  Tensor_matrix_row_kernel matrix = nullptr;
+};
+
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t tensor_lerp_row_sse41(const float* a, const float* b, float* out, uint32_t width, float w);
+
+uint32_t tensor_matrix_row_sse41(const float* in0, const float* in1, const float* in2,
+                                 float* out0, float* out1, float* out2,
+                                 uint32_t width, const TensorMatrix& matrix);
+
+uint32_t tensor_lerp_row_avx2(const float* a, const float* b, float* out, uint32_t width, float w);
+
+uint32_t tensor_matrix_row_avx2(const float* in0, const float* in1, const float* in2,
+                                float* out0, float* out1, float* out2,
+                                uint32_t width, const TensorMatrix& matrix);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t tensor_lerp_row_neon(const float* a, const float* b, float* out, uint32_t width, float w);
+
+uint32_t tensor_matrix_row_neon(const float* in0, const float* in1, const float* in2,
+                                float* out0, float* out1, float* out2,
+                                uint32_t width, const TensorMatrix& matrix);
+
+#endif
+
+
+const Tensor_row_kernels& get_tensor_row_kernels();
+
+#endif //LIBHEIF_COLORCONVERSION_TENSOR_SIMD_H
@@ -20,10 +20,77 @@
 
 #include <cmath>
 #include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
 #include "yuv2rgb.h"
+#include "yuv2rgb_simd.h"
+#include "hdr_sdr.h"
+#include "chroma_sampling.h"
 #include "nclx.h"
 #include "common_utils.h"
 
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+
+// The terms of the floating point YCbCr -> RGB conversion, precomputed for all 8-bit sample values
+// (including the limited range scaling). The entries are the float values of the per-pixel expressions,
+// such that e.g. y[Y] + r_cr[Cr] is bit-identical to the float code and the float SIMD kernels.
+struct YCbCr_to_RGB_8bit_LUT
+{
+  float y[256];
+  float r_cr[256];
+  float g_cb[256];
+  float g_cr[256];
+  float b_cb[256];
+};
+
+
+// The tables are cached for each set of coefficients (derived from the nclx matrix and primaries) and range.
+// There are only a few different matrices, thus the cache is not limited.
+static std::shared_ptr<const YCbCr_to_RGB_8bit_LUT> get_YCbCr_to_RGB_8bit_LUT(const YCbCr_to_RGB_coefficients& coeffs,
+                                                                             bool full_range)
+{
+  using Key = std::tuple<float, float, float, float, bool>;
+  static std::map<Key, std::shared_ptr<const YCbCr_to_RGB_8bit_LUT>> cache;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  static std::mutex cache_mutex;
+  std::lock_guard<std::mutex> lock(cache_mutex);
+#endif
+
+  Key key{coeffs.r_cr, coeffs.g_cb, coeffs.g_cr, coeffs.b_cb, full_range};
+
+  auto iter = cache.find(key);
+  if (iter != cache.end()) {
+    return iter->second;
+  }
+
+  auto lut = std::make_shared<YCbCr_to_RGB_8bit_LUT>();
+
+  for (int v = 0; v < 256; v++) {
+    float yv = static_cast<float>(v);
+    float c = static_cast<float>(v - 128);
+
+    if (!full_range) {
+      yv = (yv - 16.0f) * 1.1689f;
+      c = c * 1.1429f;
+    }
+
+    lut->y[v] = yv;
+    lut->r_cr[v] = coeffs.r_cr * c;
+    lut->g_cb[v] = coeffs.g_cb * c;
+    lut->g_cr[v] = coeffs.g_cr * c;
+    lut->b_cb[v] = coeffs.b_cb * c;
+  }
+
+  cache[key] = lut;
+
+  return lut;
+}
+
 
 template<class Pixel>
 std::vector<ColorStateWithCost>
@@ -206,52 +273,78 @@ Op_YCbCr_to_RGB<Pixel>::convert_colorspace(const std::shared_ptr<const HeifPixel
   }
 
 
+  // 8-bit input is converted with precomputed tables, which handle all matrices and ranges at the same speed
+  std::shared_ptr<const YCbCr_to_RGB_8bit_LUT> lut;
+  if (!hdr && matrix_coeffs != 0 && matrix_coeffs != 8) {
+    lut = get_YCbCr_to_RGB_8bit_LUT(coeffs, full_range_flag);
+  }
+
   uint32_t x, y;
   for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      int cx = (x >> shiftH);
-      int cy = (y >> shiftV);
-
-      if (matrix_coeffs == 0) {
-        if (full_range_flag) {
-          out_r[y * out_r_stride + x] = in_cr[cy * in_cr_stride + cx];
-          out_g[y * out_g_stride + x] = in_y[y * in_y_stride + x];
-          out_b[y * out_b_stride + x] = in_cb[cy * in_cb_stride + cx];
-        }
-        else {
-          // Convert from limited range to full range.
-          out_r[y * out_r_stride + x] = (Pixel) clip_f_u16((in_cr[cy * in_cr_stride + cx] - limited_range_offset) * 1.1429f, fullRange);
-          out_g[y * out_g_stride + x] = (Pixel) clip_f_u16((in_y[y * in_y_stride + x] - limited_range_offset) * 1.1689f, fullRange);
-          out_b[y * out_b_stride + x] = (Pixel) clip_f_u16((in_cb[cy * in_cb_stride + cx] - limited_range_offset) * 1.1429f, fullRange);
-        }
+    if (lut) {
+      const Pixel* row_y = &in_y[y * in_y_stride];
+      const Pixel* row_cb = &in_cb[(y >> shiftV) * in_cb_stride];
+      const Pixel* row_cr = &in_cr[(y >> shiftV) * in_cr_stride];
+      Pixel* row_r = &out_r[y * out_r_stride];
+      Pixel* row_g = &out_g[y * out_g_stride];
+      Pixel* row_b = &out_b[y * out_b_stride];
+
+      for (x = 0; x < width; x++) {
+        float yv = lut->y[row_y[x]];
+        Pixel cb = row_cb[x >> shiftH];
+        Pixel cr = row_cr[x >> shiftH];
+
+        row_r[x] = (Pixel) (clip_f_u16(yv + lut->r_cr[cr], fullRange));
+        row_g[x] = (Pixel) (clip_f_u16(yv + lut->g_cb[cb] + lut->g_cr[cr], fullRange));
+        row_b[x] = (Pixel) (clip_f_u16(yv + lut->b_cb[cb], fullRange));
       }
-      else if (matrix_coeffs == 8) {
-        // TODO: check this. I have no input image yet which is known to be correct.
-        // TODO: is there a coeff=8 with full_range=false ?
+    }
+    else {
+      for (x = 0; x < width; x++) {
+        int cx = (x >> shiftH);
+        int cy = (y >> shiftV);
+
+        if (matrix_coeffs == 0) {
+          if (full_range_flag) {
+            out_r[y * out_r_stride + x] = in_cr[cy * in_cr_stride + cx];
+            out_g[y * out_g_stride + x] = in_y[y * in_y_stride + x];
+            out_b[y * out_b_stride + x] = in_cb[cy * in_cb_stride + cx];
+          }
+          else {
+            // Convert from limited range to full range.
+            out_r[y * out_r_stride + x] = (Pixel) clip_f_u16((in_cr[cy * in_cr_stride + cx] - limited_range_offset) * 1.1429f, fullRange);
+            out_g[y * out_g_stride + x] = (Pixel) clip_f_u16((in_y[y * in_y_stride + x] - limited_range_offset) * 1.1689f, fullRange);
+            out_b[y * out_b_stride + x] = (Pixel) clip_f_u16((in_cb[cy * in_cb_stride + cx] - limited_range_offset) * 1.1429f, fullRange);
+          }
+        }
+        else if (matrix_coeffs == 8) {
+          // TODO: check this. I have no input image yet which is known to be correct.
+          // TODO: is there a coeff=8 with full_range=false ?
 
-        int yv = in_y[y * in_y_stride + x];
-        int cb = in_cb[cy * in_cb_stride + cx] - halfRange;
-        int cr = in_cr[cy * in_cr_stride + cx] - halfRange;
+          int yv = in_y[y * in_y_stride + x];
+          int cb = in_cb[cy * in_cb_stride + cx] - halfRange;
+          int cr = in_cr[cy * in_cr_stride + cx] - halfRange;
 
-        out_r[y * out_r_stride + x] = (Pixel) (clip_int_u8(yv - cb + cr));
-        out_g[y * out_g_stride + x] = (Pixel) (clip_int_u8(yv + cb));
-        out_b[y * out_b_stride + x] = (Pixel) (clip_int_u8(yv - cb - cr));
-      }
-      else { // TODO: matrix_coefficients = 11,14
-        float yv, cb, cr;
-        yv = static_cast<float>(in_y[y * in_y_stride + x] );
-        cb = static_cast<float>(in_cb[cy * in_cb_stride + cx] - halfRange);
-        cr = static_cast<float>(in_cr[cy * in_cr_stride + cx] - halfRange);
-
-        if (!full_range_flag) {
-          yv = (yv - limited_range_offset) * 1.1689f;
-          cb = cb * 1.1429f;
-          cr = cr * 1.1429f;
+          out_r[y * out_r_stride + x] = (Pixel) (clip_int_u8(yv - cb + cr));
+          out_g[y * out_g_stride + x] = (Pixel) (clip_int_u8(yv + cb));
+          out_b[y * out_b_stride + x] = (Pixel) (clip_int_u8(yv - cb - cr));
+        }
+        else { // TODO: matrix_coefficients = 11,14
+          float yv, cb, cr;
+          yv = static_cast<float>(in_y[y * in_y_stride + x] );
+          cb = static_cast<float>(in_cb[cy * in_cb_stride + cx] - halfRange);
+          cr = static_cast<float>(in_cr[cy * in_cr_stride + cx] - halfRange);
+
+          if (!full_range_flag) {
+            yv = (yv - limited_range_offset) * 1.1689f;
+            cb = cb * 1.1429f;
+            cr = cr * 1.1429f;
+          }
+
+          out_r[y * out_r_stride + x] = (Pixel) (clip_f_u16(yv + coeffs.r_cr * cr, fullRange));
+          out_g[y * out_g_stride + x] = (Pixel) (clip_f_u16(yv + coeffs.g_cb * cb + coeffs.g_cr * cr, fullRange));
+          out_b[y * out_b_stride + x] = (Pixel) (clip_f_u16(yv + coeffs.b_cb * cb, fullRange));
         }
-
-        out_r[y * out_r_stride + x] = (Pixel) (clip_f_u16(yv + coeffs.r_cr * cr, fullRange));
-        out_g[y * out_g_stride + x] = (Pixel) (clip_f_u16(yv + coeffs.g_cb * cb + coeffs.g_cr * cr, fullRange));
-        out_b[y * out_b_stride + x] = (Pixel) (clip_f_u16(yv + coeffs.b_cb * cb, fullRange));
       }
     }
 
@@ -268,6 +361,58 @@ template class Op_YCbCr_to_RGB<uint8_t>;
 template class Op_YCbCr_to_RGB<uint16_t>;
 
 
+// 8-bit rows of a plane. Rows of planes with more than 8 bits are reduced to 8 bits on access.
+// The last reduced row is kept, since the 4:2:0 chroma rows are accessed twice.
+class SDR_plane_rows
+{
+public:
+  SDR_plane_rows(const std::shared_ptr<const HeifPixelImage>& image, heif_channel channel,
+                 heif_bit_depth_reduction_method method)
+      : m_method(method)
+  {
+    m_bits = image->get_bits_per_pixel(channel);
+    m_width = image->get_width(channel);
+    m_data = image->get_plane(channel, &m_stride);
+
+    if (m_bits > 8) {
+      m_buffer.resize(m_width);
+    }
+  }
+
+  const uint8_t* row(uint32_t y)
+  {
+    if (m_bits == 8) {
+      return m_data + y * m_stride;
+    }
+
+    if (y != m_buffered_row) {
+      reduce_row_to_8bit(reinterpret_cast<const uint16_t*>(m_data + y * m_stride), m_buffer.data(), m_width,
+                         m_bits, m_method, y);
+      m_buffered_row = y;
+    }
+
+    return m_buffer.data();
+  }
+
+private:
+  const uint8_t* m_data;
+  size_t m_stride = 0;
+  uint32_t m_width;
+  int m_bits;
+  heif_bit_depth_reduction_method m_method;
+
+  std::vector<uint8_t> m_buffer;
+  uint32_t m_buffered_row = UINT32_MAX;
+};
+
+
+// Input bit depths of the Op_YCbCr420_to_RGB24/32 Ops. Input with more than 8 bits is reduced to 8 bits.
+static bool is_supported_YCbCr420_to_RGB_input_depth(int input_bpp, int target_bpp)
+{
+  return input_bpp == 8 || (input_bpp > 8 && input_bpp <= 16 && target_bpp == 8);
+}
+
+
 std::vector<ColorStateWithCost>
 Op_YCbCr420_to_RGB24::state_after_conversion(const ColorState& input_state,
                                              const ColorState& target_state,
@@ -285,7 +430,7 @@ Op_YCbCr420_to_RGB24::state_after_conversion(const ColorState& input_state,
 
   if (input_state.colorspace != heif_colorspace_YCbCr ||
       input_state.chroma != heif_chroma_420 ||
-      input_state.bits_per_pixel != 8 ||
+      !is_supported_YCbCr420_to_RGB_input_depth(input_state.bits_per_pixel, target_state.bits_per_pixel) ||
       input_state.has_alpha == true) {
     return {};
   }
@@ -309,7 +454,7 @@ Op_YCbCr420_to_RGB24::state_after_conversion(const ColorState& input_state,
   output_state.has_alpha = false;
   output_state.bits_per_pixel = 8;
 
-  states.emplace_back(output_state, SpeedCosts_Unoptimized);
+  states.emplace_back(output_state, get_YCbCr420_to_RGB24_row_kernel() ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
 
   return states;
 }
@@ -323,9 +468,10 @@ Op_YCbCr420_to_RGB24::convert_colorspace(const std::shared_ptr<const HeifPixelIm
                                          const heif_color_conversion_options_ext& options_ext,
                                          const heif_security_limits* limits) const
 {
-  if (input->get_bits_per_pixel(heif_channel_Y) != 8 ||
-      input->get_bits_per_pixel(heif_channel_Cb) != 8 ||
-      input->get_bits_per_pixel(heif_channel_Cr) != 8) {
+  int bpp = input->get_bits_per_pixel(heif_channel_Y);
+  if (input->get_bits_per_pixel(heif_channel_Cb) != bpp ||
+      input->get_bits_per_pixel(heif_channel_Cr) != bpp ||
+      !is_supported_YCbCr420_to_RGB_input_depth(bpp, 8)) {
     return Error::InternalError;
   }
 
@@ -352,23 +498,34 @@ Op_YCbCr420_to_RGB24::convert_colorspace(const std::shared_ptr<const HeifPixelIm
   int g_cb = static_cast<int>(std::lround(256 * coeffs.g_cb));
   int b_cb = static_cast<int>(std::lround(256 * coeffs.b_cb));
 
-  const uint8_t* in_y, * in_cb, * in_cr;
-  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0;
+  SDR_plane_rows rows_y(input, heif_channel_Y, options_ext.bit_depth_reduction_method);
+  SDR_plane_rows rows_cb(input, heif_channel_Cb, options_ext.bit_depth_reduction_method);
+  SDR_plane_rows rows_cr(input, heif_channel_Cr, options_ext.bit_depth_reduction_method);
 
   uint8_t* out_p;
   size_t out_p_stride = 0;
 
-  in_y = input->get_plane(heif_channel_Y, &in_y_stride);
-  in_cb = input->get_plane(heif_channel_Cb, &in_cb_stride);
-  in_cr = input->get_plane(heif_channel_Cr, &in_cr_stride);
   out_p = outimg->get_plane(heif_channel_interleaved, &out_p_stride);
 
+  YCbCr420_to_RGB_row_kernel simd_kernel = get_YCbCr420_to_RGB24_row_kernel();
+  YCbCr_to_RGB_int_coefficients int_coeffs{r_cr, g_cb, g_cr, b_cb};
+
   uint32_t x, y;
   for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      int yv = (in_y[y * in_y_stride + x]);
-      int cb = (in_cb[y / 2 * in_cb_stride + x / 2] - 128);
-      int cr = (in_cr[y / 2 * in_cr_stride + x / 2] - 128);
+    const uint8_t* in_y = rows_y.row(y);
+    const uint8_t* in_cb = rows_cb.row(y / 2);
+    const uint8_t* in_cr = rows_cr.row(y / 2);
+
+    x = 0;
+    if (simd_kernel) {
+      x = simd_kernel(in_y, in_cb, in_cr, nullptr, &out_p[y * out_p_stride], width, int_coeffs);
+    }
+
+    // convert the remaining pixels (or all, if there is no SIMD kernel)
+    for (; x < width; x++) {
+      int yv = (in_y[x]);
+      int cb = (in_cb[x / 2] - 128);
+      int cr = (in_cr[x / 2] - 128);
 
       out_p[y * out_p_stride + 3 * x + 0] = clip_int_u8(yv + ((r_cr * cr + 128) >> 8));
       out_p[y * out_p_stride + 3 * x + 1] = clip_int_u8(yv + ((g_cb * cb + g_cr * cr + 128) >> 8));
@@ -399,7 +556,7 @@ Op_YCbCr420_to_RGB32::state_after_conversion(const ColorState& input_state,
 
   if (input_state.colorspace != heif_colorspace_YCbCr ||
       input_state.chroma != heif_chroma_420 ||
-      input_state.bits_per_pixel != 8) {
+      !is_supported_YCbCr420_to_RGB_input_depth(input_state.bits_per_pixel, target_state.bits_per_pixel)) {
     return {};
   }
 
@@ -422,7 +579,7 @@ Op_YCbCr420_to_RGB32::state_after_conversion(const ColorState& input_state,
   output_state.has_alpha = true;
   output_state.bits_per_pixel = 8;
 
-  states.emplace_back(output_state, SpeedCosts_Unoptimized);
+  states.emplace_back(output_state, get_YCbCr420_to_RGB32_row_kernel() ? SpeedCosts_OptimizedSoftware : SpeedCosts_Unoptimized);
 
   return states;
 }
@@ -436,9 +593,10 @@ Op_YCbCr420_to_RGB32::convert_colorspace(const std::shared_ptr<const HeifPixelIm
                                          const heif_color_conversion_options_ext& options_ext,
                                          const heif_security_limits* limits) const
 {
-  if (input->get_bits_per_pixel(heif_channel_Y) != 8 ||
-      input->get_bits_per_pixel(heif_channel_Cb) != 8 ||
-      input->get_bits_per_pixel(heif_channel_Cr) != 8) {
+  int bpp = input->get_bits_per_pixel(heif_channel_Y);
+  if (input->get_bits_per_pixel(heif_channel_Cb) != bpp ||
+      input->get_bits_per_pixel(heif_channel_Cr) != bpp ||
+      !is_supported_YCbCr420_to_RGB_input_depth(bpp, 8)) {
     return Error::InternalError;
   }
 
@@ -470,29 +628,44 @@ Op_YCbCr420_to_RGB32::convert_colorspace(const std::shared_ptr<const HeifPixelIm
 
 
   const bool with_alpha = input->has_channel(heif_channel_Alpha);
+  if (with_alpha && !is_supported_YCbCr420_to_RGB_input_depth(input->get_bits_per_pixel(heif_channel_Alpha), 8)) {
+    return Error::InternalError;
+  }
 
-  const uint8_t* in_y, * in_cb, * in_cr, * in_a = nullptr;
-  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0, in_a_stride = 0;
+  SDR_plane_rows rows_y(input, heif_channel_Y, options_ext.bit_depth_reduction_method);
+  SDR_plane_rows rows_cb(input, heif_channel_Cb, options_ext.bit_depth_reduction_method);
+  SDR_plane_rows rows_cr(input, heif_channel_Cr, options_ext.bit_depth_reduction_method);
+  std::unique_ptr<SDR_plane_rows> rows_a;
+  if (with_alpha) {
+    rows_a = std::make_unique<SDR_plane_rows>(input, heif_channel_Alpha, options_ext.bit_depth_reduction_method);
+  }
 
   uint8_t* out_p;
   size_t out_p_stride = 0;
 
-  in_y = input->get_plane(heif_channel_Y, &in_y_stride);
-  in_cb = input->get_plane(heif_channel_Cb, &in_cb_stride);
-  in_cr = input->get_plane(heif_channel_Cr, &in_cr_stride);
-  if (with_alpha) {
-    in_a = input->get_plane(heif_channel_Alpha, &in_a_stride);
-  }
-
   out_p = outimg->get_plane(heif_channel_interleaved, &out_p_stride);
 
+  YCbCr420_to_RGB_row_kernel simd_kernel = get_YCbCr420_to_RGB32_row_kernel();
+  YCbCr_to_RGB_int_coefficients int_coeffs{r_cr, g_cb, g_cr, b_cb};
+
   uint32_t x, y;
   for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
+    const uint8_t* in_y = rows_y.row(y);
+    const uint8_t* in_cb = rows_cb.row(y / 2);
+    const uint8_t* in_cr = rows_cr.row(y / 2);
+    const uint8_t* in_a = with_alpha ? rows_a->row(y) : nullptr;
+
+    x = 0;
+    if (simd_kernel) {
+      x = simd_kernel(in_y, in_cb, in_cr, in_a, &out_p[y * out_p_stride], width, int_coeffs);
+    }
 
-      int yv = (in_y[y * in_y_stride + x]);
-      int cb = (in_cb[y / 2 * in_cb_stride + x / 2] - 128);
-      int cr = (in_cr[y / 2 * in_cr_stride + x / 2] - 128);
+    // convert the remaining pixels (or all, if there is no SIMD kernel)
+    for (; x < width; x++) {
+
+      int yv = (in_y[x]);
+      int cb = (in_cb[x / 2] - 128);
+      int cr = (in_cr[x / 2] - 128);
 
       out_p[y * out_p_stride + 4 * x + 0] = clip_int_u8(yv + ((r_cr * cr + 128) >> 8));
       out_p[y * out_p_stride + 4 * x + 1] = clip_int_u8(yv + ((g_cb * cb + g_cr * cr + 128) >> 8));
@@ -500,7 +673,7 @@ Op_YCbCr420_to_RGB32::convert_colorspace(const std::shared_ptr<const HeifPixelIm
 
 
       if (with_alpha) {
-        out_p[y * out_p_stride + 4 * x + 3] = in_a[y * in_a_stride + x];
+        out_p[y * out_p_stride + 4 * x + 3] = in_a[x];
       }
       else {
         out_p[y * out_p_stride + 4 * x + 3] = 0xFF;
@@ -662,3 +835,302 @@ Op_YCbCr420_to_RRGGBBaa::convert_colorspace(const std::shared_ptr<const HeifPixe
   return outimg;
 }
 
+
+template<class Pixel>
+std::vector<ColorStateWithCost>
+Op_YCbCr420_bilinear_to_interleaved_RGB<Pixel>::state_after_conversion(const ColorState& input_state,
+                                                                       const ColorState& target_state,
+                                                                       const heif_color_conversion_options& options,
+                                                                       const heif_color_conversion_options_ext& options_ext) const
+{
+  if (input_state.colorspace != heif_colorspace_YCbCr ||
+      input_state.chroma != heif_chroma_420) {
+    return {};
+  }
+
+  // this Op only implements the bilinear algorithm
+
+  if (options.preferred_chroma_upsampling_algorithm != heif_chroma_upsampling_bilinear) {
+    return {};
+  }
+
+  bool hdr = !std::is_same<Pixel, uint8_t>::value;
+
+  if (hdr) {
+    if (input_state.bits_per_pixel <= 8) {
+      return {};
+    }
+  }
+  else if (!is_supported_YCbCr420_to_RGB_input_depth(input_state.bits_per_pixel, target_state.bits_per_pixel)) {
+    return {};
+  }
+
+  int matrix = input_state.nclx_profile.get_matrix_coefficients();
+  if (matrix == 0 || matrix == 8 || matrix == 11 || matrix == 14) {
+    return {};
+  }
+
+  std::vector<ColorStateWithCost> states;
+
+  ColorState output_state;
+  output_state.colorspace = heif_colorspace_RGB;
+  output_state.bits_per_pixel = hdr ? input_state.bits_per_pixel : 8;
+
+  if (!hdr) {
+    // --- convert to RGBA (with alpha)
+
+    output_state.chroma = heif_chroma_interleaved_RGBA;
+    output_state.has_alpha = true;
+
+    states.emplace_back(output_state, SpeedCosts_Unoptimized);
+
+    // --- convert to RGB (without alpha)
+
+    // Do not drop an existing alpha channel on the way to a target that has alpha.
+    if (!input_state.has_alpha || !target_state.has_alpha) {
+      output_state.chroma = heif_chroma_interleaved_RGB;
+      output_state.has_alpha = false;
+
+      states.emplace_back(output_state, SpeedCosts_Unoptimized);
+    }
+  }
+  else {
+    // --- convert to RRGGBB(AA) in both endiannesses
+
+    for (bool le : {false, true}) {
+      if (input_state.has_alpha == false) {
+        output_state.chroma = le ? heif_chroma_interleaved_RRGGBB_LE : heif_chroma_interleaved_RRGGBB_BE;
+        output_state.has_alpha = false;
+
+        states.emplace_back(output_state, SpeedCosts_Unoptimized);
+      }
+
+      output_state.chroma = le ? heif_chroma_interleaved_RRGGBBAA_LE : heif_chroma_interleaved_RRGGBBAA_BE;
+      output_state.has_alpha = true;
+
+      states.emplace_back(output_state, SpeedCosts_Unoptimized);
+    }
+  }
+
+  return states;
+}
+
+
+template<class Pixel>
+Result<std::shared_ptr<HeifPixelImage>>
+Op_YCbCr420_bilinear_to_interleaved_RGB<Pixel>::convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                                                                   const ColorState& input_state,
+                                                                   const ColorState& target_state,
+                                                                   const heif_color_conversion_options& options,
+                                                                   const heif_color_conversion_options_ext& options_ext,
+                                                                   const heif_security_limits* limits) const
+{
+  bool hdr = !std::is_same<Pixel, uint8_t>::value;
+
+  int bpp = input->get_bits_per_pixel(heif_channel_Y);
+
+  // 8-bit output of HDR input. The planes are reduced to 8 bits before the conversion.
+  bool reduce_to_8bit = (!hdr && bpp > 8);
+
+  if ((hdr ? bpp <= 8 : !is_supported_YCbCr420_to_RGB_input_depth(bpp, 8)) ||
+      input->get_bits_per_pixel(heif_channel_Cb) != bpp ||
+      input->get_bits_per_pixel(heif_channel_Cr) != bpp) {
+    return Error::InternalError;
+  }
+
+  bool has_alpha = input->has_channel(heif_channel_Alpha);
+
+  if (has_alpha) {
+    int alpha_bpp = input->get_bits_per_pixel(heif_channel_Alpha);
+    if (hdr ? alpha_bpp <= 8 : !is_supported_YCbCr420_to_RGB_input_depth(alpha_bpp, 8)) {
+      return Error::InternalError;
+    }
+  }
+
+  // Like the separate interleaving Ops, the HDR output keeps an existing alpha channel.
+  bool want_alpha = target_state.has_alpha || (hdr && has_alpha);
+
+  int le = (target_state.chroma == heif_chroma_interleaved_RRGGBB_LE ||
+            target_state.chroma == heif_chroma_interleaved_RRGGBBAA_LE) ? 1 : 0;
+
+  uint32_t width = input->get_width();
+  uint32_t height = input->get_height();
+
+  heif_chroma out_chroma;
+  if (hdr) {
+    out_chroma = want_alpha ?
+                 (le ? heif_chroma_interleaved_RRGGBBAA_LE : heif_chroma_interleaved_RRGGBBAA_BE) :
+                 (le ? heif_chroma_interleaved_RRGGBB_LE : heif_chroma_interleaved_RRGGBB_BE);
+  }
+  else {
+    out_chroma = want_alpha ? heif_chroma_interleaved_32bit : heif_chroma_interleaved_24bit;
+  }
+
+  const Pixel* in_y, * in_cb, * in_cr, * in_a = nullptr;
+  size_t in_y_stride = 0, in_cb_stride = 0, in_cr_stride = 0, in_a_stride = 0;
+
+  in_y = (const Pixel*) input->get_plane(heif_channel_Y, &in_y_stride);
+  in_cb = (const Pixel*) input->get_plane(heif_channel_Cb, &in_cb_stride);
+  in_cr = (const Pixel*) input->get_plane(heif_channel_Cr, &in_cr_stride);
+
+  if (has_alpha) {
+    in_a = (const Pixel*) input->get_plane(heif_channel_Alpha, &in_a_stride);
+  }
+
+  in_y_stride /= sizeof(Pixel);
+  in_cb_stride /= sizeof(Pixel);
+  in_cr_stride /= sizeof(Pixel);
+  in_a_stride /= sizeof(Pixel);
+
+  // When reducing HDR input to 8 bits, the (small) chroma planes are reduced completely, because the
+  // upsampling accesses the neighboring rows. Luma and alpha are reduced row by row.
+
+  std::unique_ptr<SDR_plane_rows> sdr_rows_y, sdr_rows_a;
+  std::vector<uint8_t> sdr_cb, sdr_cr;
+
+  if constexpr (std::is_same<Pixel, uint8_t>::value) {
+    if (reduce_to_8bit) {
+      heif_bit_depth_reduction_method method = options_ext.bit_depth_reduction_method;
+
+      sdr_rows_y = std::make_unique<SDR_plane_rows>(input, heif_channel_Y, method);
+      if (has_alpha) {
+        sdr_rows_a = std::make_unique<SDR_plane_rows>(input, heif_channel_Alpha, method);
+      }
+
+      uint32_t chroma_width = input->get_width(heif_channel_Cb);
+      uint32_t chroma_height = input->get_height(heif_channel_Cb);
+
+      for (auto [channel, sdr_plane] : {std::pair{heif_channel_Cb, &sdr_cb}, {heif_channel_Cr, &sdr_cr}}) {
+        SDR_plane_rows rows(input, channel, method);
+
+        sdr_plane->resize(size_t{chroma_width} * chroma_height);
+        for (uint32_t y = 0; y < chroma_height; y++) {
+          memcpy(sdr_plane->data() + size_t{y} * chroma_width, rows.row(y), chroma_width);
+        }
+      }
+
+      in_cb = sdr_cb.data();
+      in_cr = sdr_cr.data();
+      in_cb_stride = in_cr_stride = chroma_width;
+
+      bpp = 8;
+    }
+  }
+
+  auto outimg = std::make_shared<HeifPixelImage>();
+  outimg->create(width, height, heif_colorspace_RGB, out_chroma);
+
+  if (auto err = outimg->add_plane(heif_channel_interleaved, width, height, bpp, limits)) {
+    return err;
+  }
+
+  uint8_t* out_p;
+  size_t out_p_stride = 0;
+  out_p = outimg->get_plane(heif_channel_interleaved, &out_p_stride);
+
+  uint16_t halfRange = (uint16_t) (1 << (bpp - 1));
+  int32_t fullRange = (1 << bpp) - 1;
+  float limited_range_offset = static_cast<float>(16 << (bpp - 8));
+
+  bool full_range_flag = true;
+  YCbCr_to_RGB_coefficients coeffs = YCbCr_to_RGB_coefficients::defaults();
+
+  auto colorProfile = input->get_color_profile_nclx();
+  if (colorProfile) {
+    full_range_flag = colorProfile->get_full_range_flag();
+    coeffs = get_YCbCr_to_RGB_coefficients(colorProfile->get_matrix_coefficients(),
+                                           colorProfile->get_colour_primaries());
+  }
+
+  const int bytes_per_sample = hdr ? 2 : 1;
+  const int bytes_per_pixel = (want_alpha ? 4 : 3) * bytes_per_sample;
+
+  // upsampled chroma of the current row
+  std::vector<Pixel> cb_row(width);
+  std::vector<Pixel> cr_row(width);
+
+  YCbCr444_to_RGB_float_row_kernel rgb_kernel = hdr ? nullptr : get_YCbCr444_to_RGB_float_row_kernel();
+
+  // the remaining 8-bit pixels are converted with the precomputed tables
+  std::shared_ptr<const YCbCr_to_RGB_8bit_LUT> lut;
+  if (!hdr) {
+    lut = get_YCbCr_to_RGB_8bit_LUT(coeffs, full_range_flag);
+  }
+
+  for (uint32_t y = 0; y < height; y++) {
+    upsample_420_chroma_row_bilinear(in_cb, in_cb_stride, width, height, y, cb_row.data());
+    upsample_420_chroma_row_bilinear(in_cr, in_cr_stride, width, height, y, cr_row.data());
+
+    const Pixel* row_y = &in_y[y * in_y_stride];
+    const Pixel* row_a = has_alpha ? &in_a[y * in_a_stride] : nullptr;
+    uint8_t* out = &out_p[y * out_p_stride];
+
+    if constexpr (std::is_same<Pixel, uint8_t>::value) {
+      if (reduce_to_8bit) {
+        row_y = sdr_rows_y->row(y);
+        row_a = has_alpha ? sdr_rows_a->row(y) : nullptr;
+      }
+    }
+
+    uint32_t x = 0;
+
+    if constexpr (std::is_same<Pixel, uint8_t>::value) {
+      if (rgb_kernel) {
+        x = rgb_kernel(row_y, cb_row.data(), cr_row.data(), row_a, out, bytes_per_pixel, width, coeffs, full_range_flag);
+      }
+
+      for (; x < width; x++) {
+        float yv = lut->y[row_y[x]];
+        uint8_t cb = cb_row[x];
+        uint8_t cr = cr_row[x];
+
+        uint8_t* p = out + x * bytes_per_pixel;
+        p[0] = (uint8_t) clip_f_u16(yv + lut->r_cr[cr], fullRange);
+        p[1] = (uint8_t) clip_f_u16(yv + lut->g_cb[cb] + lut->g_cr[cr], fullRange);
+        p[2] = (uint8_t) clip_f_u16(yv + lut->b_cb[cb], fullRange);
+
+        if (want_alpha) {
+          p[3] = row_a ? row_a[x] : 0xFF;
+        }
+      }
+    }
+
+    for (; x < width; x++) {
+      float yv = static_cast<float>(row_y[x]);
+      float cb = static_cast<float>(cb_row[x] - halfRange);
+      float cr = static_cast<float>(cr_row[x] - halfRange);
+
+      if (!full_range_flag) {
+        yv = (yv - limited_range_offset) * 1.1689f;
+        cb = cb * 1.1429f;
+        cr = cr * 1.1429f;
+      }
+
+      uint16_t rgba[4];
+      rgba[0] = clip_f_u16(yv + coeffs.r_cr * cr, fullRange);
+      rgba[1] = clip_f_u16(yv + coeffs.g_cb * cb + coeffs.g_cr * cr, fullRange);
+      rgba[2] = clip_f_u16(yv + coeffs.b_cb * cb, fullRange);
+      rgba[3] = row_a ? row_a[x] : (uint16_t) fullRange;
+
+      int num_components = want_alpha ? 4 : 3;
+      uint8_t* p = out + x * bytes_per_pixel;
+
+      if (!hdr) {
+        for (int c = 0; c < num_components; c++) {
+          p[c] = (uint8_t) rgba[c];
+        }
+      }
+      else {
+        for (int c = 0; c < num_components; c++) {
+          p[2 * c + le] = (uint8_t) (rgba[c] >> 8);
+          p[2 * c + 1 - le] = (uint8_t) (rgba[c] & 0xFF);
+        }
+      }
+    }
+  }
+
+  return outimg;
+}
+
+template class Op_YCbCr420_bilinear_to_interleaved_RGB<uint8_t>;
+template class Op_YCbCr420_bilinear_to_interleaved_RGB<uint16_t>;
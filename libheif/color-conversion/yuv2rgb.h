@@ -47,6 +47,8 @@ public:
 };
 
 
+// Also converts input with 9-16 bits per sample to 8-bit output. The planes are then reduced to 8 bits
+// row by row (see reduce_row_to_8bit()) within the same pass.
 class Op_YCbCr420_to_RGB24 : public ColorConversionOperation
 {
 public:
@@ -63,9 +65,17 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const override;
+
+  // The dither pattern depends on the absolute row position.
+  bool supports_strip_processing(const heif_color_conversion_options_ext& options_ext) const override
+  {
+    return options_ext.bit_depth_reduction_method != heif_bit_depth_reduction_method_dither;
+  }
 };
 
 
+// Also converts input with 9-16 bits per sample to 8-bit output. The planes are then reduced to 8 bits
+// row by row (see reduce_row_to_8bit()) within the same pass.
 class Op_YCbCr420_to_RGB32 : public ColorConversionOperation
 {
 public:
@@ -82,6 +92,12 @@ public:
                      const heif_color_conversion_options& options,
                      const heif_color_conversion_options_ext& options_ext,
                      const heif_security_limits* limits) const override;
+
+  // The dither pattern depends on the absolute row position.
+  bool supports_strip_processing(const heif_color_conversion_options_ext& options_ext) const override
+  {
+    return options_ext.bit_depth_reduction_method != heif_bit_depth_reduction_method_dither;
+  }
 };
 
 
@@ -103,4 +119,35 @@ public:
                      const heif_security_limits* limits) const override;
 };
 
+
+// Bilinear 4:2:0 upsampling, YCbCr -> RGB and interleaving in one step.
+// The output is identical to the chain of Op_YCbCr420_bilinear_to_YCbCr444, Op_YCbCr_to_RGB and the
+// interleaving Ops, but there are no intermediate full-size images.
+// 8 bit input is converted to RGB / RGBA, high bit-depth input to RRGGBB(AA) in both endiannesses.
+// For 8-bit targets, the 8-bit variant also takes high bit-depth input and reduces it to 8 bits in the same pass.
+template<class Pixel>
+class Op_YCbCr420_bilinear_to_interleaved_RGB : public ColorConversionOperation
+{
+public:
+  std::vector<ColorStateWithCost>
+  state_after_conversion(const ColorState& input_state,
+                         const ColorState& target_state,
+                         const heif_color_conversion_options& options,
+                         const heif_color_conversion_options_ext& options_ext) const override;
+
+  Result<std::shared_ptr<HeifPixelImage>>
+  convert_colorspace(const std::shared_ptr<const HeifPixelImage>& input,
+                     const ColorState& input_state,
+                     const ColorState& target_state,
+                     const heif_color_conversion_options& options,
+                     const heif_color_conversion_options_ext& options_ext,
+                     const heif_security_limits* limits) const override;
+
+  // The dither pattern of the bit depth reduction depends on the absolute row position.
+  bool supports_strip_processing(const heif_color_conversion_options_ext& options_ext) const override
+  {
+    return options_ext.bit_depth_reduction_method != heif_bit_depth_reduction_method_dither;
+  }
+};
+
 #endif //LIBHEIF_COLORCONVERSION_YUV2RGB_H
@@ -0,0 +1,642 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "yuv2rgb_simd.h"
+
+#include <cstring>
+#include <limits>
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+// All kernels use 16-bit multiplications with 32-bit accumulation. This is only exact if the
+// fixed-point coefficients fit into int16, which is always the case for the standard matrices.
+static bool coefficients_fit_int16(const YCbCr_to_RGB_int_coefficients& c)
+{
+  auto fits = [](int v) {
+    return v >= std::numeric_limits<int16_t>::min() && v <= std::numeric_limits<int16_t>::max();
+  };
+
+  return fits(c.r_cr) && fits(c.g_cb) && fits(c.g_cr) && fits(c.b_cb);
+}
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1
+
+HEIF_TARGET_SSE41
+static inline __m128i pack_coefficient_pair(int cb_coeff, int cr_coeff)
+{
+  return _mm_set1_epi32((int) (((uint32_t) cb_coeff & 0xFFFF) | ((uint32_t) cr_coeff << 16)));
+}
+
+
+// Computes (coeff_cb * cb + coeff_cr * cr + 128) >> 8 for eight int16 values.
+HEIF_TARGET_SSE41
+static inline __m128i mul_chroma_sse41(__m128i cb, __m128i cr, __m128i coeff_pair)
+{
+  const __m128i round = _mm_set1_epi32(128);
+
+  __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), coeff_pair);
+  __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), coeff_pair);
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 8);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 8);
+
+  return _mm_packs_epi32(lo, hi);
+}
+
+
+struct Coefficients_sse41
+{
+  __m128i r, g, b;
+};
+
+
+// Converts 16 pixels. 'cb_dup' and 'cr_dup' already contain the chroma values duplicated horizontally.
+HEIF_TARGET_SSE41
+static inline void convert_16_pixels_sse41(__m128i y8, __m128i cb_dup, __m128i cr_dup,
+                                           const Coefficients_sse41& c,
+                                           __m128i& r, __m128i& g, __m128i& b)
+{
+  const __m128i offset = _mm_set1_epi16(128);
+
+  __m128i y_lo = _mm_cvtepu8_epi16(y8);
+  __m128i y_hi = _mm_cvtepu8_epi16(_mm_srli_si128(y8, 8));
+  __m128i cb_lo = _mm_sub_epi16(_mm_cvtepu8_epi16(cb_dup), offset);
+  __m128i cb_hi = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(cb_dup, 8)), offset);
+  __m128i cr_lo = _mm_sub_epi16(_mm_cvtepu8_epi16(cr_dup), offset);
+  __m128i cr_hi = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(cr_dup, 8)), offset);
+
+  r = _mm_packus_epi16(_mm_add_epi16(y_lo, mul_chroma_sse41(cb_lo, cr_lo, c.r)),
+                       _mm_add_epi16(y_hi, mul_chroma_sse41(cb_hi, cr_hi, c.r)));
+  g = _mm_packus_epi16(_mm_add_epi16(y_lo, mul_chroma_sse41(cb_lo, cr_lo, c.g)),
+                       _mm_add_epi16(y_hi, mul_chroma_sse41(cb_hi, cr_hi, c.g)));
+  b = _mm_packus_epi16(_mm_add_epi16(y_lo, mul_chroma_sse41(cb_lo, cr_lo, c.b)),
+                       _mm_add_epi16(y_hi, mul_chroma_sse41(cb_hi, cr_hi, c.b)));
+}
+
+
+// Writes 16 pixels as RGBA (64 bytes) or RGB (48 bytes).
+HEIF_TARGET_SSE41
+static inline void store_16_pixels_sse41(uint8_t* out, __m128i r, __m128i g, __m128i b, __m128i a, bool rgba)
+{
+  __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+  __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+  __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+  __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+  __m128i p0 = _mm_unpacklo_epi16(rg_lo, ba_lo);
+  __m128i p1 = _mm_unpackhi_epi16(rg_lo, ba_lo);
+  __m128i p2 = _mm_unpacklo_epi16(rg_hi, ba_hi);
+  __m128i p3 = _mm_unpackhi_epi16(rg_hi, ba_hi);
+
+  if (rgba) {
+    _mm_storeu_si128((__m128i*) (out + 0), p0);
+    _mm_storeu_si128((__m128i*) (out + 16), p1);
+    _mm_storeu_si128((__m128i*) (out + 32), p2);
+    _mm_storeu_si128((__m128i*) (out + 48), p3);
+    return;
+  }
+
+  // remove the alpha bytes, leaving 12 bytes at the start of each vector and zeros behind
+  const __m128i drop_alpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  p0 = _mm_shuffle_epi8(p0, drop_alpha);
+  p1 = _mm_shuffle_epi8(p1, drop_alpha);
+  p2 = _mm_shuffle_epi8(p2, drop_alpha);
+  p3 = _mm_shuffle_epi8(p3, drop_alpha);
+
+  _mm_storeu_si128((__m128i*) (out + 0), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+  _mm_storeu_si128((__m128i*) (out + 16), _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+  _mm_storeu_si128((__m128i*) (out + 32), _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+}
+
+
+HEIF_TARGET_SSE41
+static uint32_t YCbCr420_to_RGB_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                          uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs,
+                                          bool rgba)
+{
+  if (!coefficients_fit_int16(coeffs)) {
+    return 0;
+  }
+
+  Coefficients_sse41 c;
+  c.r = pack_coefficient_pair(0, coeffs.r_cr);
+  c.g = pack_coefficient_pair(coeffs.g_cb, coeffs.g_cr);
+  c.b = pack_coefficient_pair(coeffs.b_cb, 0);
+
+  const int bytes_per_pixel = rgba ? 4 : 3;
+  const __m128i opaque = _mm_set1_epi8((char) 0xFF);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i y8 = _mm_loadu_si128((const __m128i*) (in_y + x));
+    __m128i cb8 = _mm_loadl_epi64((const __m128i*) (in_cb + x / 2));
+    __m128i cr8 = _mm_loadl_epi64((const __m128i*) (in_cr + x / 2));
+
+    __m128i r, g, b;
+    convert_16_pixels_sse41(y8, _mm_unpacklo_epi8(cb8, cb8), _mm_unpacklo_epi8(cr8, cr8), c, r, g, b);
+
+    __m128i a = (rgba && in_a) ? _mm_loadu_si128((const __m128i*) (in_a + x)) : opaque;
+
+    store_16_pixels_sse41(out + x * bytes_per_pixel, r, g, b, a, rgba);
+  }
+
+  return x;
+}
+
+
+uint32_t YCbCr420_to_RGB24_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                     uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs)
+{
+  return YCbCr420_to_RGB_row_sse41(in_y, in_cb, in_cr, nullptr, out, width, coeffs, false);
+}
+
+
+uint32_t YCbCr420_to_RGB32_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                     uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs)
+{
+  return YCbCr420_to_RGB_row_sse41(in_y, in_cb, in_cr, in_a, out, width, coeffs, true);
+}
+
+
+// --- SSE4.1, 4:4:4 with floating point coefficients
+
+struct Float_coefficients_sse41
+{
+  __m128 r_cr, g_cb, g_cr, b_cb;
+};
+
+
+// Converts four pixels given as int32. The expressions match the scalar code of the fused 4:2:0 Op.
+HEIF_TARGET_SSE41
+static inline void convert_4_pixels_float_sse41(__m128i y32, __m128i cb32, __m128i cr32,
+                                                const Float_coefficients_sse41& c, bool full_range,
+                                                __m128& r, __m128& g, __m128& b)
+{
+  const __m128i offset = _mm_set1_epi32(128);
+
+  __m128 yv = _mm_cvtepi32_ps(y32);
+  __m128 cb = _mm_cvtepi32_ps(_mm_sub_epi32(cb32, offset));
+  __m128 cr = _mm_cvtepi32_ps(_mm_sub_epi32(cr32, offset));
+
+  if (!full_range) {
+    yv = _mm_mul_ps(_mm_sub_ps(yv, _mm_set1_ps(16.0f)), _mm_set1_ps(1.1689f));
+    cb = _mm_mul_ps(cb, _mm_set1_ps(1.1429f));
+    cr = _mm_mul_ps(cr, _mm_set1_ps(1.1429f));
+  }
+
+  r = _mm_add_ps(yv, _mm_mul_ps(c.r_cr, cr));
+  g = _mm_add_ps(_mm_add_ps(yv, _mm_mul_ps(c.g_cb, cb)), _mm_mul_ps(c.g_cr, cr));
+  b = _mm_add_ps(yv, _mm_mul_ps(c.b_cb, cb));
+}
+
+
+// clip_f_u16() to 8 bits: the conversion truncates and the saturating packs clip to [0;255].
+HEIF_TARGET_SSE41
+static inline __m128i round_and_pack_u8_sse41(const __m128 v[4])
+{
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  __m128i i0 = _mm_cvttps_epi32(_mm_add_ps(v[0], half));
+  __m128i i1 = _mm_cvttps_epi32(_mm_add_ps(v[1], half));
+  __m128i i2 = _mm_cvttps_epi32(_mm_add_ps(v[2], half));
+  __m128i i3 = _mm_cvttps_epi32(_mm_add_ps(v[3], half));
+
+  return _mm_packus_epi16(_mm_packs_epi32(i0, i1), _mm_packs_epi32(i2, i3));
+}
+
+
+HEIF_TARGET_SSE41
+uint32_t YCbCr444_to_RGB_float_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                         uint8_t* out, int bytes_per_pixel, uint32_t width,
+                                         const YCbCr_to_RGB_coefficients& coeffs, bool full_range)
+{
+  Float_coefficients_sse41 c;
+  c.r_cr = _mm_set1_ps(coeffs.r_cr);
+  c.g_cb = _mm_set1_ps(coeffs.g_cb);
+  c.g_cr = _mm_set1_ps(coeffs.g_cr);
+  c.b_cb = _mm_set1_ps(coeffs.b_cb);
+
+  const bool rgba = (bytes_per_pixel == 4);
+  const __m128i opaque = _mm_set1_epi8((char) 0xFF);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i y8 = _mm_loadu_si128((const __m128i*) (in_y + x));
+    __m128i cb8 = _mm_loadu_si128((const __m128i*) (in_cb + x));
+    __m128i cr8 = _mm_loadu_si128((const __m128i*) (in_cr + x));
+
+    __m128 r[4], g[4], b[4];
+    for (int i = 0; i < 4; i++) {
+      convert_4_pixels_float_sse41(_mm_cvtepu8_epi32(y8), _mm_cvtepu8_epi32(cb8), _mm_cvtepu8_epi32(cr8),
+                                   c, full_range, r[i], g[i], b[i]);
+
+      y8 = _mm_srli_si128(y8, 4);
+      cb8 = _mm_srli_si128(cb8, 4);
+      cr8 = _mm_srli_si128(cr8, 4);
+    }
+
+    __m128i a = (rgba && in_a) ? _mm_loadu_si128((const __m128i*) (in_a + x)) : opaque;
+
+    store_16_pixels_sse41(out + x * bytes_per_pixel, round_and_pack_u8_sse41(r), round_and_pack_u8_sse41(g),
+                          round_and_pack_u8_sse41(b), a, rgba);
+  }
+
+  return x;
+}
+
+
+// --- AVX2
+
+// Computes (coeff_cb * cb + coeff_cr * cr + 128) >> 8 for sixteen int16 values.
+// Unpack, madd and pack all work within 128-bit lanes, hence the element order is preserved.
+HEIF_TARGET_AVX2
+static inline __m256i mul_chroma_avx2(__m256i cb, __m256i cr, __m256i coeff_pair)
+{
+  const __m256i round = _mm256_set1_epi32(128);
+
+  __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(cb, cr), coeff_pair);
+  __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(cb, cr), coeff_pair);
+  lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), 8);
+  hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), 8);
+
+  return _mm256_packs_epi32(lo, hi);
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m128i pack_u8_avx2(__m256i v)
+{
+  return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+
+HEIF_TARGET_AVX2
+static uint32_t YCbCr420_to_RGB_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                         uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs,
+                                         bool rgba)
+{
+  if (!coefficients_fit_int16(coeffs)) {
+    return 0;
+  }
+
+  const __m256i coeff_r = _mm256_set1_epi32((int) ((uint32_t) coeffs.r_cr << 16));
+  const __m256i coeff_g = _mm256_set1_epi32((int) (((uint32_t) coeffs.g_cb & 0xFFFF) | ((uint32_t) coeffs.g_cr << 16)));
+  const __m256i coeff_b = _mm256_set1_epi32((int) ((uint32_t) coeffs.b_cb & 0xFFFF));
+  const __m256i offset = _mm256_set1_epi16(128);
+  const __m128i opaque = _mm_set1_epi8((char) 0xFF);
+
+  const int bytes_per_pixel = rgba ? 4 : 3;
+
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m128i cb8 = _mm_loadu_si128((const __m128i*) (in_cb + x / 2));
+    __m128i cr8 = _mm_loadu_si128((const __m128i*) (in_cr + x / 2));
+
+    for (int half = 0; half < 2; half++) {
+      uint32_t px = x + 16 * half;
+
+      __m256i y16 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (in_y + px)));
+
+      __m128i cb_dup = half ? _mm_unpackhi_epi8(cb8, cb8) : _mm_unpacklo_epi8(cb8, cb8);
+      __m128i cr_dup = half ? _mm_unpackhi_epi8(cr8, cr8) : _mm_unpacklo_epi8(cr8, cr8);
+      __m256i cb16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(cb_dup), offset);
+      __m256i cr16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(cr_dup), offset);
+
+      __m128i r = pack_u8_avx2(_mm256_add_epi16(y16, mul_chroma_avx2(cb16, cr16, coeff_r)));
+      __m128i g = pack_u8_avx2(_mm256_add_epi16(y16, mul_chroma_avx2(cb16, cr16, coeff_g)));
+      __m128i b = pack_u8_avx2(_mm256_add_epi16(y16, mul_chroma_avx2(cb16, cr16, coeff_b)));
+
+      __m128i a = (rgba && in_a) ? _mm_loadu_si128((const __m128i*) (in_a + px)) : opaque;
+
+      store_16_pixels_sse41(out + px * bytes_per_pixel, r, g, b, a, rgba);
+    }
+  }
+
+  // convert remaining blocks of 16 pixels with SSE
+  x += YCbCr420_to_RGB_row_sse41(in_y + x, in_cb + x / 2, in_cr + x / 2, in_a ? in_a + x : nullptr,
+                                 out + x * bytes_per_pixel, width - x, coeffs, rgba);
+
+  return x;
+}
+
+
+uint32_t YCbCr420_to_RGB24_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs)
+{
+  return YCbCr420_to_RGB_row_avx2(in_y, in_cb, in_cr, nullptr, out, width, coeffs, false);
+}
+
+
+uint32_t YCbCr420_to_RGB32_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs)
+{
+  return YCbCr420_to_RGB_row_avx2(in_y, in_cb, in_cr, in_a, out, width, coeffs, true);
+}
+
+
+
+// --- AVX2, 4:4:4 with floating point coefficients
+
+HEIF_TARGET_AVX2
+static inline void convert_8_pixels_float_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr,
+                                               const YCbCr_to_RGB_coefficients& coeffs, bool full_range,
+                                               __m256& r, __m256& g, __m256& b)
+{
+  const __m256i offset = _mm256_set1_epi32(128);
+
+  __m256 yv = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) in_y)));
+  __m256 cb = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) in_cb)), offset));
+  __m256 cr = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) in_cr)), offset));
+
+  if (!full_range) {
+    yv = _mm256_mul_ps(_mm256_sub_ps(yv, _mm256_set1_ps(16.0f)), _mm256_set1_ps(1.1689f));
+    cb = _mm256_mul_ps(cb, _mm256_set1_ps(1.1429f));
+    cr = _mm256_mul_ps(cr, _mm256_set1_ps(1.1429f));
+  }
+
+  r = _mm256_add_ps(yv, _mm256_mul_ps(_mm256_set1_ps(coeffs.r_cr), cr));
+  g = _mm256_add_ps(_mm256_add_ps(yv, _mm256_mul_ps(_mm256_set1_ps(coeffs.g_cb), cb)),
+                    _mm256_mul_ps(_mm256_set1_ps(coeffs.g_cr), cr));
+  b = _mm256_add_ps(yv, _mm256_mul_ps(_mm256_set1_ps(coeffs.b_cb), cb));
+}
+
+
+HEIF_TARGET_AVX2
+static inline __m128i round_and_pack_u8_avx2(__m256 lo, __m256 hi)
+{
+  const __m256 half = _mm256_set1_ps(0.5f);
+
+  __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_add_ps(lo, half)),
+                                      _mm256_cvttps_epi32(_mm256_add_ps(hi, half)));
+
+  return pack_u8_avx2(_mm256_permute4x64_epi64(packed, 0xD8));
+}
+
+
+HEIF_TARGET_AVX2
+uint32_t YCbCr444_to_RGB_float_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                        uint8_t* out, int bytes_per_pixel, uint32_t width,
+                                        const YCbCr_to_RGB_coefficients& coeffs, bool full_range)
+{
+  const bool rgba = (bytes_per_pixel == 4);
+  const __m128i opaque = _mm_set1_epi8((char) 0xFF);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256 r[2], g[2], b[2];
+    for (int i = 0; i < 2; i++) {
+      convert_8_pixels_float_avx2(in_y + x + 8 * i, in_cb + x + 8 * i, in_cr + x + 8 * i, coeffs, full_range,
+                                  r[i], g[i], b[i]);
+    }
+
+    __m128i a = (rgba && in_a) ? _mm_loadu_si128((const __m128i*) (in_a + x)) : opaque;
+
+    store_16_pixels_sse41(out + x * bytes_per_pixel, round_and_pack_u8_avx2(r[0], r[1]),
+                          round_and_pack_u8_avx2(g[0], g[1]), round_and_pack_u8_avx2(b[0], b[1]), a, rgba);
+  }
+
+  return x;
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+// Computes (coeff_cb * cb + coeff_cr * cr + 128) >> 8 for eight int16 values.
+static inline int16x8_t mul_chroma_neon(int16x8_t cb, int16x8_t cr, int16_t coeff_cb, int16_t coeff_cr)
+{
+  int32x4_t lo = vmull_n_s16(vget_low_s16(cb), coeff_cb);
+  int32x4_t hi = vmull_n_s16(vget_high_s16(cb), coeff_cb);
+  lo = vmlal_n_s16(lo, vget_low_s16(cr), coeff_cr);
+  hi = vmlal_n_s16(hi, vget_high_s16(cr), coeff_cr);
+
+  lo = vshrq_n_s32(vaddq_s32(lo, vdupq_n_s32(128)), 8);
+  hi = vshrq_n_s32(vaddq_s32(hi, vdupq_n_s32(128)), 8);
+
+  return vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+}
+
+
+static uint32_t YCbCr420_to_RGB_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                         uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs,
+                                         bool rgba)
+{
+  if (!coefficients_fit_int16(coeffs)) {
+    return 0;
+  }
+
+  const auto r_cr = (int16_t) coeffs.r_cr;
+  const auto g_cb = (int16_t) coeffs.g_cb;
+  const auto g_cr = (int16_t) coeffs.g_cr;
+  const auto b_cb = (int16_t) coeffs.b_cb;
+  const int16x8_t offset = vdupq_n_s16(128);
+
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t y8 = vld1q_u8(in_y + x);
+    uint8x8x2_t cb_dup = vzip_u8(vld1_u8(in_cb + x / 2), vld1_u8(in_cb + x / 2));
+    uint8x8x2_t cr_dup = vzip_u8(vld1_u8(in_cr + x / 2), vld1_u8(in_cr + x / 2));
+
+    uint8x8_t r[2], g[2], b[2];
+
+    for (int half = 0; half < 2; half++) {
+      int16x8_t yv = vreinterpretq_s16_u16(vmovl_u8(half ? vget_high_u8(y8) : vget_low_u8(y8)));
+      int16x8_t cb = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cb_dup.val[half])), offset);
+      int16x8_t cr = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cr_dup.val[half])), offset);
+
+      r[half] = vqmovun_s16(vaddq_s16(yv, mul_chroma_neon(cb, cr, 0, r_cr)));
+      g[half] = vqmovun_s16(vaddq_s16(yv, mul_chroma_neon(cb, cr, g_cb, g_cr)));
+      b[half] = vqmovun_s16(vaddq_s16(yv, mul_chroma_neon(cb, cr, b_cb, 0)));
+    }
+
+    if (rgba) {
+      uint8x16x4_t rgba_pixels;
+      rgba_pixels.val[0] = vcombine_u8(r[0], r[1]);
+      rgba_pixels.val[1] = vcombine_u8(g[0], g[1]);
+      rgba_pixels.val[2] = vcombine_u8(b[0], b[1]);
+      rgba_pixels.val[3] = in_a ? vld1q_u8(in_a + x) : vdupq_n_u8(0xFF);
+      vst4q_u8(out + 4 * x, rgba_pixels);
+    }
+    else {
+      uint8x16x3_t rgb_pixels;
+      rgb_pixels.val[0] = vcombine_u8(r[0], r[1]);
+      rgb_pixels.val[1] = vcombine_u8(g[0], g[1]);
+      rgb_pixels.val[2] = vcombine_u8(b[0], b[1]);
+      vst3q_u8(out + 3 * x, rgb_pixels);
+    }
+  }
+
+  return x;
+}
+
+
+uint32_t YCbCr420_to_RGB24_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs)
+{
+  return YCbCr420_to_RGB_row_neon(in_y, in_cb, in_cr, nullptr, out, width, coeffs, false);
+}
+
+
+uint32_t YCbCr420_to_RGB32_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs)
+{
+  return YCbCr420_to_RGB_row_neon(in_y, in_cb, in_cr, in_a, out, width, coeffs, true);
+}
+
+
+
+// clip_f_u16() to 8 bits for eight values.
+static inline uint8x8_t round_and_pack_u8_neon(float32x4_t lo, float32x4_t hi)
+{
+  const float32x4_t half = vdupq_n_f32(0.5f);
+
+  // the conversion truncates like the cast in clip_f_u16(), the saturating narrowing clips to [0;255]
+  int16x8_t v = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(vaddq_f32(lo, half))),
+                             vqmovn_s32(vcvtq_s32_f32(vaddq_f32(hi, half))));
+  return vqmovun_s16(v);
+}
+
+
+uint32_t YCbCr444_to_RGB_float_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                        uint8_t* out, int bytes_per_pixel, uint32_t width,
+                                        const YCbCr_to_RGB_coefficients& coeffs, bool full_range)
+{
+  const int32x4_t offset = vdupq_n_s32(128);
+
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t y16 = vmovl_u8(vld1_u8(in_y + x));
+    uint16x8_t cb16 = vmovl_u8(vld1_u8(in_cb + x));
+    uint16x8_t cr16 = vmovl_u8(vld1_u8(in_cr + x));
+
+    float32x4_t r[2], g[2], b[2];
+
+    for (int half = 0; half < 2; half++) {
+      uint32x4_t y32 = vmovl_u16(half ? vget_high_u16(y16) : vget_low_u16(y16));
+      uint32x4_t cb32 = vmovl_u16(half ? vget_high_u16(cb16) : vget_low_u16(cb16));
+      uint32x4_t cr32 = vmovl_u16(half ? vget_high_u16(cr16) : vget_low_u16(cr16));
+
+      float32x4_t yv = vcvtq_f32_u32(y32);
+      float32x4_t cb = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(cb32), offset));
+      float32x4_t cr = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(cr32), offset));
+
+      if (!full_range) {
+        yv = vmulq_n_f32(vsubq_f32(yv, vdupq_n_f32(16.0f)), 1.1689f);
+        cb = vmulq_n_f32(cb, 1.1429f);
+        cr = vmulq_n_f32(cr, 1.1429f);
+      }
+
+      // Multiplications and additions are kept separate, because vmlaq_f32() may be fused.
+      r[half] = vaddq_f32(yv, vmulq_n_f32(cr, coeffs.r_cr));
+      g[half] = vaddq_f32(vaddq_f32(yv, vmulq_n_f32(cb, coeffs.g_cb)), vmulq_n_f32(cr, coeffs.g_cr));
+      b[half] = vaddq_f32(yv, vmulq_n_f32(cb, coeffs.b_cb));
+    }
+
+    if (bytes_per_pixel == 4) {
+      uint8x8x4_t rgba_pixels;
+      rgba_pixels.val[0] = round_and_pack_u8_neon(r[0], r[1]);
+      rgba_pixels.val[1] = round_and_pack_u8_neon(g[0], g[1]);
+      rgba_pixels.val[2] = round_and_pack_u8_neon(b[0], b[1]);
+      rgba_pixels.val[3] = in_a ? vld1_u8(in_a + x) : vdup_n_u8(0xFF);
+      vst4_u8(out + 4 * x, rgba_pixels);
+    }
+    else {
+      uint8x8x3_t rgb_pixels;
+      rgb_pixels.val[0] = round_and_pack_u8_neon(r[0], r[1]);
+      rgb_pixels.val[1] = round_and_pack_u8_neon(g[0], g[1]);
+      rgb_pixels.val[2] = round_and_pack_u8_neon(b[0], b[1]);
+      vst3_u8(out + 3 * x, rgb_pixels);
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+
+YCbCr420_to_RGB_row_kernel get_YCbCr420_to_RGB24_row_kernel()
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    return YCbCr420_to_RGB24_row_avx2;
+  }
+  if (cpu_supports_sse41()) {
+    return YCbCr420_to_RGB24_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    return YCbCr420_to_RGB24_row_neon;
+  }
+#endif
+
+  return nullptr;
+}
+
+
+YCbCr420_to_RGB_row_kernel get_YCbCr420_to_RGB32_row_kernel()
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    return YCbCr420_to_RGB32_row_avx2;
+  }
+  if (cpu_supports_sse41()) {
+    return YCbCr420_to_RGB32_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    return YCbCr420_to_RGB32_row_neon;
+  }
+#endif
+
+  return nullptr;
+}
+
+
+YCbCr444_to_RGB_float_row_kernel get_YCbCr444_to_RGB_float_row_kernel()
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_avx2()) {
+    return YCbCr444_to_RGB_float_row_avx2;
+  }
+  if (cpu_supports_sse41()) {
+    return YCbCr444_to_RGB_float_row_sse41;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    return YCbCr444_to_RGB_float_row_neon;
+  }
+#endif
+
+  return nullptr;
+}
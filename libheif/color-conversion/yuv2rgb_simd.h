@@ -0,0 +1,116 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_COLORCONVERSION_YUV2RGB_SIMD_H
+#define LIBHEIF_COLORCONVERSION_YUV2RGB_SIMD_H
+
+#include <cstdint>
+#include "cpu_features.h"
+#include "nclx.h"
+
+
+// Fixed-point (8 fractional bits) YCbCr -> RGB coefficients as used by the 8-bit 4:2:0 ops.
+struct YCbCr_to_RGB_int_coefficients
+{
+  int r_cr = 0;
+  int g_cb = 0;
+  int g_cr = 0;
+  int b_cb = 0;
+};
+
+
+// Converts the first pixels of one row of 8-bit, full-range YCbCr 4:2:0 into interleaved RGB or RGBA.
+// 'in_cb' and 'in_cr' point to the chroma row belonging to this luma row.
+// For RGBA output, 'in_a' may be NULL, in which case the alpha is set to 0xFF.
+//
+// The kernels process the row in blocks and return the number of pixels that were converted.
+// This is always an even number. The remaining pixels have to be converted by the scalar code.
+// The results are bit-exact with the scalar implementation in yuv2rgb.cc.
+typedef uint32_t (*YCbCr420_to_RGB_row_kernel)(const uint8_t* in_y,
+                                               const uint8_t* in_cb,
+                                               const uint8_t* in_cr,
+                                               const uint8_t* in_a,
+                                               uint8_t* out,
+                                               uint32_t width,
+                                               const YCbCr_to_RGB_int_coefficients& coeffs);
+
+// Converts the first pixels of one row of 8-bit YCbCr 4:4:4 into interleaved RGB (bytes_per_pixel = 3) or
+// RGBA (bytes_per_pixel = 4) with the floating point coefficients. The fused bilinear 4:2:0 Op uses this on
+// its upsampled chroma rows. For RGBA output, 'in_a' may be NULL, in which case the alpha is set to 0xFF.
+//
+// The kernels evaluate the floating point expressions of the scalar code in yuv2rgb.cc in the same order.
+// Like the RGB -> YCbCr kernels, the results are bit-exact as long as the compiler does not contract the
+// scalar code into fused multiply-adds.
+typedef uint32_t (*YCbCr444_to_RGB_float_row_kernel)(const uint8_t* in_y,
+                                                     const uint8_t* in_cb,
+                                                     const uint8_t* in_cr,
+                                                     const uint8_t* in_a,
+                                                     uint8_t* out, int bytes_per_pixel,
+                                                     uint32_t width,
+                                                     const YCbCr_to_RGB_coefficients& coeffs,
+                                                     bool full_range);
+
+#if HEIF_HAVE_X86_SIMD
+
+uint32_t YCbCr420_to_RGB24_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                     uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs);
+
+uint32_t YCbCr420_to_RGB32_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                     uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs);
+
+uint32_t YCbCr420_to_RGB24_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs);
+
+uint32_t YCbCr420_to_RGB32_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs);
+
+uint32_t YCbCr444_to_RGB_float_row_sse41(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                         uint8_t* out, int bytes_per_pixel, uint32_t width,
+                                         const YCbCr_to_RGB_coefficients& coeffs, bool full_range);
+
+uint32_t YCbCr444_to_RGB_float_row_avx2(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                        uint8_t* out, int bytes_per_pixel, uint32_t width,
+                                        const YCbCr_to_RGB_coefficients& coeffs, bool full_range);
+
+#endif
+
+#if HEIF_HAVE_NEON
+
+uint32_t YCbCr420_to_RGB24_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs);
+
+uint32_t YCbCr420_to_RGB32_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                    uint8_t* out, uint32_t width, const YCbCr_to_RGB_int_coefficients& coeffs);
+
+uint32_t YCbCr444_to_RGB_float_row_neon(const uint8_t* in_y, const uint8_t* in_cb, const uint8_t* in_cr, const uint8_t* in_a,
+                                        uint8_t* out, int bytes_per_pixel, uint32_t width,
+                                        const YCbCr_to_RGB_coefficients& coeffs, bool full_range);
+
+#endif
+
+
+// Return the fastest kernel supported by the CPU, or NULL if there is none.
+YCbCr420_to_RGB_row_kernel get_YCbCr420_to_RGB24_row_kernel();
+
+YCbCr420_to_RGB_row_kernel get_YCbCr420_to_RGB32_row_kernel();
+
+YCbCr444_to_RGB_float_row_kernel get_YCbCr444_to_RGB_float_row_kernel();
+
+#endif //LIBHEIF_COLORCONVERSION_YUV2RGB_SIMD_H
@@ -23,6 +23,8 @@
 #include <vector>
 #include <cinttypes>
 #include <cstddef>
+#include <span>
+#include <optional>
 
 #include <error.h>
 
@@ -34,9 +36,10 @@
  * 
  * @param input pointer to the data to be compressed
  * @param size the length of the input array in bytes
+ * @param level the zlib compression level (-1: default, 0: store the data in uncompressed blocks)
  * @return the corresponding compressed data
  */
-std::vector<uint8_t> compress_zlib(const uint8_t* input, size_t size);
+std::vector<uint8_t> compress_zlib(const uint8_t* input, size_t size, int level = -1);
 
 /**
  * Compress data using deflate method.
@@ -45,9 +48,10 @@ std::vector<uint8_t> compress_zlib(const uint8_t* input, size_t size);
  * 
  * @param input pointer to the data to be compressed
  * @param size the length of the input array in bytes
+ * @param level the zlib compression level (-1: default, 0: store the data in uncompressed blocks)
  * @return the corresponding compressed data
  */
-std::vector<uint8_t> compress_deflate(const uint8_t* input, size_t size);
+std::vector<uint8_t> compress_deflate(const uint8_t* input, size_t size, int level = -1);
 
 /**
  * Decompress zlib compressed data.
@@ -55,13 +59,24 @@ std::vector<uint8_t> compress_deflate(const uint8_t* input, size_t size);
  * This is assumed to be in RFC 1950 format, which is the normal zlib format.
  *
  * @param compressed_input the compressed data to be decompressed
- * @param output pointer to the resulting vector of decompressed data
+ * @param output pointer to the vector that the decompressed data is appended to
  * @return success (Ok) or an error on failure (usually corrupt data)
  * 
  * @sa decompress_deflate
  * @sa compress_zlib
  */
-Error decompress_zlib(const std::vector<uint8_t>& compressed_input, std::vector<uint8_t>* output);
+Error decompress_zlib(std::span<const uint8_t> compressed_input, std::vector<uint8_t>* output);
+
+/**
+ * Decompress zlib compressed data into a buffer of known size.
+ *
+ * Decompression stops when the end of the compressed stream is reached or when the output buffer is full.
+ *
+ * @param compressed_input the compressed data to be decompressed
+ * @param output the buffer for the decompressed data
+ * @return the number of bytes written to the output buffer or an error on failure (usually corrupt data)
+ */
+Result<size_t> decompress_zlib(std::span<const uint8_t> compressed_input, std::span<uint8_t> output);
 
 /**
  * Decompress "deflate" compressed data.
@@ -69,13 +84,24 @@ Error decompress_zlib(const std::vector<uint8_t>& compressed_input, std::vector<
  * This is assumed to be in RFC 1951 format, which is the deflate format.
  *
  * @param compressed_input the compressed data to be decompressed
- * @param output pointer to the resulting vector of decompressed data
+ * @param output pointer to the vector that the decompressed data is appended to
  * @return success (Ok) or an error on failure (usually corrupt data)
  * 
  * @sa decompress_zlib
  * @sa compress_deflate
  */
-Error decompress_deflate(const std::vector<uint8_t>& compressed_input, std::vector<uint8_t>* output);
+Error decompress_deflate(std::span<const uint8_t> compressed_input, std::vector<uint8_t>* output);
+
+/**
+ * Decompress "deflate" compressed data into a buffer of known size.
+ *
+ * Decompression stops when the end of the compressed stream is reached or when the output buffer is full.
+ *
+ * @param compressed_input the compressed data to be decompressed
+ * @param output the buffer for the decompressed data
+ * @return the number of bytes written to the output buffer or an error on failure (usually corrupt data)
+ */
+Result<size_t> decompress_deflate(std::span<const uint8_t> compressed_input, std::span<uint8_t> output);
 
 #endif
 
@@ -86,12 +112,57 @@ Error decompress_deflate(const std::vector<uint8_t>& compressed_input, std::vect
  * Brotli is described at https://brotli.org/
  *
  * @param compressed_input the compressed data to be decompressed
- * @param output pointer to the resulting vector of decompressed data
+ * @param output pointer to the vector that the decompressed data is appended to
  * @return success (Ok) or an error on failure (usually corrupt data)
  */
-Error decompress_brotli(const std::vector<uint8_t>& compressed_input, std::vector<uint8_t>* output);
+Error decompress_brotli(std::span<const uint8_t> compressed_input, std::vector<uint8_t>* output);
+
+/**
+ * Decompress Brotli compressed data into a buffer of known size.
+ *
+ * Decompression stops when the end of the compressed stream is reached or when the output buffer is full.
+ *
+ * @param compressed_input the compressed data to be decompressed
+ * @param output the buffer for the decompressed data
+ * @return the number of bytes written to the output buffer or an error on failure (usually corrupt data)
+ */
+Result<size_t> decompress_brotli(std::span<const uint8_t> compressed_input, std::span<uint8_t> output);
 
 std::vector<uint8_t> compress_brotli(const uint8_t* input, size_t size);
 #endif
 
+#if HAVE_ZSTD
+/**
+ * Decompress Zstandard compressed data.
+ *
+ * Zstandard is described in RFC 8878.
+ *
+ * @param compressed_input the compressed data to be decompressed
+ * @param output pointer to the vector that the decompressed data is appended to
+ * @return success (Ok) or an error on failure (usually corrupt data)
+ */
+Error decompress_zstd(std::span<const uint8_t> compressed_input, std::vector<uint8_t>* output);
+
+/**
+ * Decompress Zstandard compressed data into a buffer of known size.
+ *
+ * Decompression stops when the end of the compressed stream is reached or when the output buffer is full.
+ *
+ * @param compressed_input the compressed data to be decompressed
+ * @param output the buffer for the decompressed data
+ * @return the number of bytes written to the output buffer or an error on failure (usually corrupt data)
+ */
+Result<size_t> decompress_zstd(std::span<const uint8_t> compressed_input, std::span<uint8_t> output);
+
+/**
+ * Get the decompressed size of Zstandard compressed data from its frame header, without decompressing it.
+ *
+ * @param compressed_input the compressed data
+ * @return the decompressed size, or nothing if the data is not a single frame or the frame header does not store the size
+ */
+std::optional<size_t> get_zstd_decompressed_size(std::span<const uint8_t> compressed_input);
+
+std::vector<uint8_t> compress_zstd(const uint8_t* input, size_t size);
+#endif
+
 #endif //LIBHEIF_COMPRESSION_H
@@ -25,66 +25,103 @@
 const size_t BUF_SIZE = (1 << 18);
 #include <brotli/decode.h>
 #include <brotli/encode.h>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "error.h"
 
 
-Error decompress_brotli(const std::vector<uint8_t> &compressed_input, std::vector<uint8_t> *output)
+static Error brotli_decoder_error(BrotliDecoderResult result, BrotliDecoderState* state)
 {
-    BrotliDecoderResult result = BROTLI_DECODER_RESULT_ERROR;
-    std::vector<uint8_t> buffer(BUF_SIZE, 0);
+    std::stringstream sstr;
+    if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
+    {
+        sstr << "Error performing brotli inflate - insufficient data.\n";
+    }
+    else if (result == BROTLI_DECODER_RESULT_ERROR)
+    {
+        const char* errorMessage = BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state));
+        sstr << "Error performing brotli inflate - " << errorMessage << "\n";
+    }
+    else
+    {
+        const char* errorMessage = BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state));
+        sstr << "Unknown error performing brotli inflate - " << errorMessage << "\n";
+    }
+
+    return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
+}
+
+
+// Decodes into the unused end of the output vector, which is enlarged whenever it is full.
+Error decompress_brotli(std::span<const uint8_t> compressed_input, std::vector<uint8_t> *output)
+{
+    const size_t start_size = output->size();
+    size_t capacity = std::max(compressed_input.size() * 4, BUF_SIZE);
+    size_t out_size = 0;
+
+    output->resize(start_size + capacity);
+
     size_t available_in = compressed_input.size();
-    const std::uint8_t *next_in = reinterpret_cast<const std::uint8_t *>(compressed_input.data());
-    size_t available_out = buffer.size();
-    std::uint8_t *next_output = buffer.data();
+    const std::uint8_t *next_in = compressed_input.data();
 
     std::unique_ptr<BrotliDecoderState, void(*)(BrotliDecoderState*)> state(BrotliDecoderCreateInstance(0, 0, 0), BrotliDecoderDestroyInstance);
 
     while (true)
     {
-        result = BrotliDecoderDecompressStream(state.get(), &available_in, &next_in, &available_out, &next_output, 0);
+        size_t available_out = capacity - out_size;
+        std::uint8_t *next_output = output->data() + start_size + out_size;
+
+        BrotliDecoderResult result = BrotliDecoderDecompressStream(state.get(), &available_in, &next_in, &available_out, &next_output, 0);
+        out_size = capacity - available_out;
 
         if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
         {
-            output->insert(output->end(), buffer.data(), buffer.data() + std::distance(buffer.data(), next_output));
-            available_out = buffer.size();
-            next_output = buffer.data();
+            capacity *= 2;
+            output->resize(start_size + capacity);
         }
         else if (result == BROTLI_DECODER_RESULT_SUCCESS)
         {
-            output->insert(output->end(), buffer.data(), buffer.data() + std::distance(buffer.data(), next_output));
             break;
         }
-        else if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
-        {
-            std::stringstream sstr;
-            sstr << "Error performing brotli inflate - insufficient data.\n";
-            return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
-        }
-        else if (result == BROTLI_DECODER_RESULT_ERROR)
-        {
-            const char* errorMessage = BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state.get()));
-            std::stringstream sstr;
-            sstr << "Error performing brotli inflate - " << errorMessage << "\n";
-            return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
-        }
         else
         {
-            const char* errorMessage = BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state.get()));
-            std::stringstream sstr;
-            sstr << "Unknown error performing brotli inflate - " << errorMessage << "\n";
-            return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
+            output->resize(start_size);
+            return brotli_decoder_error(result, state.get());
         }
     }
 
+    output->resize(start_size + out_size);
+
     return Error::Ok;
 }
 
 
+Result<size_t> decompress_brotli(std::span<const uint8_t> compressed_input, std::span<uint8_t> output)
+{
+    size_t available_in = compressed_input.size();
+    const std::uint8_t *next_in = compressed_input.data();
+    size_t available_out = output.size();
+    std::uint8_t *next_output = output.data();
+
+    std::unique_ptr<BrotliDecoderState, void(*)(BrotliDecoderState*)> state(BrotliDecoderCreateInstance(0, 0, 0), BrotliDecoderDestroyInstance);
+
+    BrotliDecoderResult result = BrotliDecoderDecompressStream(state.get(), &available_in, &next_in, &available_out, &next_output, 0);
+
+    if (result != BROTLI_DECODER_RESULT_SUCCESS && result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+    {
+        return brotli_decoder_error(result, state.get());
+    }
+
+    return output.size() - available_out;
+}
+
+
 std::vector<uint8_t> compress_brotli(const uint8_t* input, size_t size)
 {
   std::unique_ptr<BrotliEncoderState, void(*)(BrotliEncoderState*)> state(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr), BrotliEncoderDestroyInstance);
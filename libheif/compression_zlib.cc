@@ -25,10 +25,12 @@
 #if HAVE_ZLIB
 
 #include <zlib.h>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <limits>
 
-std::vector<uint8_t> compress(const uint8_t* input, size_t size, int windowSize)
+std::vector<uint8_t> compress(const uint8_t* input, size_t size, int windowSize, int level)
 {
   std::vector<uint8_t> output;
 
@@ -50,7 +52,7 @@ std::vector<uint8_t> compress(const uint8_t* input, size_t size, int windowSize)
   strm.zfree = Z_NULL;
   strm.opaque = Z_NULL;
 
-  int err = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowSize, 8, Z_DEFAULT_STRATEGY);
+  int err = deflateInit2(&strm, level, Z_DEFLATED, windowSize, 8, Z_DEFAULT_STRATEGY);
   if (err != Z_OK) {
     return {}; // TODO: return error
   }
@@ -80,79 +82,150 @@ std::vector<uint8_t> compress(const uint8_t* input, size_t size, int windowSize)
 }
 
 
-Error do_inflate(const std::vector<uint8_t>& compressed_input, int windowSize, std::vector<uint8_t> *output)
+static Error inflate_init(z_stream& strm, std::span<const uint8_t> compressed_input, int windowSize)
 {
-
-  // decompress data with zlib
-
-  const int outBufferSize = 8192;
-  uint8_t dst[outBufferSize];
-
-  z_stream strm;
   memset(&strm, 0, sizeof(z_stream));
 
-  strm.avail_in = (int)compressed_input.size();
+  strm.avail_in = (uInt)compressed_input.size();
   strm.next_in = (Bytef*) compressed_input.data();
 
-  strm.avail_out = outBufferSize;
-  strm.next_out = (Bytef*) dst;
-
   strm.zalloc = Z_NULL;
   strm.zfree = Z_NULL;
   strm.opaque = Z_NULL;
 
-  int err = -1;
-
-  err = inflateInit2(&strm, windowSize);
+  int err = inflateInit2(&strm, windowSize);
   if (err != Z_OK) {
     std::stringstream sstr;
     sstr << "Error initialising zlib inflate: " << (strm.msg ? strm.msg : "NULL") << " (" << err << ")\n";
     return Error(heif_error_Memory_allocation_error, heif_suberror_Compression_initialisation_error, sstr.str());
   }
 
-  do {
-    strm.next_out = dst;
-    strm.avail_out = outBufferSize;
+  return Error::Ok;
+}
 
-    err = inflate(&strm, Z_FINISH);
-    if (err == Z_BUF_ERROR || err == Z_OK) {
-      // this is the usual case when we run out of buffer space
-      // -> do nothing
+
+static Error inflate_error(z_stream& strm, int err)
+{
+  std::stringstream sstr;
+  sstr << "Error performing zlib inflate: " << (strm.msg ? strm.msg : "NULL") << " (" << err << ")\n";
+  inflateEnd(&strm);
+  return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
+}
+
+
+// Inflates into the unused end of the output vector, which is enlarged whenever it is full.
+// This avoids copying the data through an intermediate buffer.
+static Error do_inflate(std::span<const uint8_t> compressed_input, int windowSize, std::vector<uint8_t> *output)
+{
+  z_stream strm;
+  Error error = inflate_init(strm, compressed_input, windowSize);
+  if (error) {
+    return error;
+  }
+
+  const size_t start_size = output->size();
+  size_t capacity = std::max(compressed_input.size() * 4, size_t{8192});
+  size_t out_size = 0;
+
+  output->resize(start_size + capacity);
+
+  int err;
+  for (;;) {
+    size_t avail = std::min(capacity - out_size, size_t{std::numeric_limits<uInt>::max()});
+    strm.next_out = (Bytef*) (output->data() + start_size + out_size);
+    strm.avail_out = (uInt) avail;
+
+    err = inflate(&strm, Z_NO_FLUSH);
+    out_size += avail - strm.avail_out;
+
+    if (err == Z_STREAM_END) {
+      break;
     }
-    else if (err == Z_NEED_DICT || err == Z_DATA_ERROR || err == Z_STREAM_ERROR) {
-      inflateEnd(&strm);
-      std::stringstream sstr;
-      sstr << "Error performing zlib inflate: " << (strm.msg ? strm.msg : "NULL") << " (" << err << ")\n";
-      return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
+    else if (err == Z_NEED_DICT || err == Z_DATA_ERROR || err == Z_STREAM_ERROR || err == Z_MEM_ERROR) {
+      output->resize(start_size);
+      return inflate_error(strm, err);
     }
+    else if (strm.avail_out == 0) {
+      capacity *= 2;
+      output->resize(start_size + capacity);
+    }
+    else if (strm.avail_in == 0) {
+      // all input consumed, but the end of the stream was not reached
+      output->resize(start_size);
+      return inflate_error(strm, Z_BUF_ERROR);
+    }
+  }
 
-    // append decoded data to output
-    output->insert(output->end(), dst, dst + outBufferSize - strm.avail_out);
-  } while (err != Z_STREAM_END);
+  inflateEnd(&strm);
+
+  output->resize(start_size + out_size);
+
+  return Error::Ok;
+}
+
+
+static Result<size_t> do_inflate(std::span<const uint8_t> compressed_input, int windowSize, std::span<uint8_t> output)
+{
+  z_stream strm;
+  Error error = inflate_init(strm, compressed_input, windowSize);
+  if (error) {
+    return error;
+  }
+
+  size_t out_size = 0;
 
+  while (out_size < output.size()) {
+    size_t avail = std::min(output.size() - out_size, size_t{std::numeric_limits<uInt>::max()});
+    strm.next_out = (Bytef*) (output.data() + out_size);
+    strm.avail_out = (uInt) avail;
+
+    int err = inflate(&strm, Z_NO_FLUSH);
+    out_size += avail - strm.avail_out;
+
+    if (err == Z_STREAM_END) {
+      break;
+    }
+    else if (err == Z_NEED_DICT || err == Z_DATA_ERROR || err == Z_STREAM_ERROR || err == Z_MEM_ERROR) {
+      return inflate_error(strm, err);
+    }
+    else if (strm.avail_out != 0 && strm.avail_in == 0) {
+      // all input consumed, but the end of the stream was not reached
+      return inflate_error(strm, Z_BUF_ERROR);
+    }
+  }
 
   inflateEnd(&strm);
 
-  return Error::Ok;
+  return out_size;
 }
 
-std::vector<uint8_t> compress_zlib(const uint8_t* input, size_t size)
+std::vector<uint8_t> compress_zlib(const uint8_t* input, size_t size, int level)
 {
-  return compress(input, size, 15);
+  return compress(input, size, 15, level);
 }
 
-std::vector<uint8_t> compress_deflate(const uint8_t* input, size_t size)
+std::vector<uint8_t> compress_deflate(const uint8_t* input, size_t size, int level)
 {
-  return compress(input, size, -15);
+  return compress(input, size, -15, level);
 }
 
 
-Error decompress_zlib(const std::vector<uint8_t>& compressed_input, std::vector<uint8_t> *output)
+Error decompress_zlib(std::span<const uint8_t> compressed_input, std::vector<uint8_t> *output)
 {
   return do_inflate(compressed_input, 15, output);
 }
 
-Error decompress_deflate(const std::vector<uint8_t>& compressed_input, std::vector<uint8_t> *output)
+Result<size_t> decompress_zlib(std::span<const uint8_t> compressed_input, std::span<uint8_t> output)
+{
+  return do_inflate(compressed_input, 15, output);
+}
+
+Error decompress_deflate(std::span<const uint8_t> compressed_input, std::vector<uint8_t> *output)
+{
+  return do_inflate(compressed_input, -15, output);
+}
+
+Result<size_t> decompress_deflate(std::span<const uint8_t> compressed_input, std::span<uint8_t> output)
 {
   return do_inflate(compressed_input, -15, output);
 }
@@ -0,0 +1,163 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "compression.h"
+
+#if HAVE_ZSTD
+
+#include <zstd.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "error.h"
+
+
+using ZstdDecoderContext = std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)>;
+
+
+static Error zstd_error(size_t code)
+{
+  std::stringstream sstr;
+  sstr << "Error performing zstd decompression - " << ZSTD_getErrorName(code) << "\n";
+  return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data, sstr.str());
+}
+
+
+static Error zstd_truncated_error()
+{
+  return Error(heif_error_Invalid_input, heif_suberror_Decompression_invalid_data,
+               "Error performing zstd decompression - insufficient data.\n");
+}
+
+
+// Decodes into the unused end of the output vector, which is enlarged whenever it is full.
+Error decompress_zstd(std::span<const uint8_t> compressed_input, std::vector<uint8_t>* output)
+{
+  ZstdDecoderContext dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  if (!dctx) {
+    return Error(heif_error_Memory_allocation_error, heif_suberror_Compression_initialisation_error,
+                 "Error initialising zstd decompression");
+  }
+
+  const size_t start_size = output->size();
+  size_t capacity = std::max(compressed_input.size() * 4, ZSTD_DStreamOutSize());
+
+  output->resize(start_size + capacity);
+
+  ZSTD_inBuffer in{compressed_input.data(), compressed_input.size(), 0};
+  ZSTD_outBuffer out{output->data() + start_size, capacity, 0};
+
+  for (;;) {
+    size_t ret = ZSTD_decompressStream(dctx.get(), &out, &in);
+    if (ZSTD_isError(ret)) {
+      output->resize(start_size);
+      return zstd_error(ret);
+    }
+
+    if (ret == 0 && in.pos == in.size) {
+      // end of the last frame
+      break;
+    }
+
+    if (out.pos == out.size) {
+      capacity *= 2;
+      output->resize(start_size + capacity);
+      out.dst = output->data() + start_size;
+      out.size = capacity;
+    }
+    else if (in.pos == in.size) {
+      output->resize(start_size);
+      return zstd_truncated_error();
+    }
+  }
+
+  output->resize(start_size + out.pos);
+
+  return Error::Ok;
+}
+
+
+Result<size_t> decompress_zstd(std::span<const uint8_t> compressed_input, std::span<uint8_t> output)
+{
+  ZstdDecoderContext dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  if (!dctx) {
+    return Error(heif_error_Memory_allocation_error, heif_suberror_Compression_initialisation_error,
+                 "Error initialising zstd decompression");
+  }
+
+  ZSTD_inBuffer in{compressed_input.data(), compressed_input.size(), 0};
+  ZSTD_outBuffer out{output.data(), output.size(), 0};
+
+  while (out.pos < out.size) {
+    size_t ret = ZSTD_decompressStream(dctx.get(), &out, &in);
+    if (ZSTD_isError(ret)) {
+      return zstd_error(ret);
+    }
+
+    if (ret == 0 && in.pos == in.size) {
+      break;
+    }
+
+    if (out.pos < out.size && in.pos == in.size) {
+      return zstd_truncated_error();
+    }
+  }
+
+  return out.pos;
+}
+
+
+std::optional<size_t> get_zstd_decompressed_size(std::span<const uint8_t> compressed_input)
+{
+  // The content size in the frame header is only the total size if the data consists of a single frame.
+  size_t frame_size = ZSTD_findFrameCompressedSize(compressed_input.data(), compressed_input.size());
+  if (ZSTD_isError(frame_size) || frame_size != compressed_input.size()) {
+    return std::nullopt;
+  }
+
+  unsigned long long content_size = ZSTD_getFrameContentSize(compressed_input.data(), compressed_input.size());
+  if (content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+      content_size == ZSTD_CONTENTSIZE_ERROR ||
+      content_size > std::numeric_limits<size_t>::max()) {
+    return std::nullopt;
+  }
+
+  return static_cast<size_t>(content_size);
+}
+
+
+std::vector<uint8_t> compress_zstd(const uint8_t* input, size_t size)
+{
+  std::vector<uint8_t> result(ZSTD_compressBound(size));
+
+  size_t compressed_size = ZSTD_compress(result.data(), result.size(), input, size, ZSTD_CLEVEL_DEFAULT);
+  if (ZSTD_isError(compressed_size)) {
+    return {};
+  }
+
+  result.resize(compressed_size);
+  return result;
+}
+
+#endif
@@ -30,6 +30,9 @@
 #include <limits>
 #include <cmath>
 #include <deque>
+#include <optional>
+#include <set>
+#include <functional>
 #include "image-items/image_item.h"
 #include <codecs/hevc_boxes.h>
 #include "sequences/track.h"
@@ -47,6 +50,8 @@
 #include "libheif/api_structs.h"
 #include "security_limits.h"
 #include "compression.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
 #include "color-conversion/colorconversion.h"
 #include "plugin_registry.h"
 #include "image-items/hevc.h"
@@ -58,6 +63,8 @@
 #include "image-items/grid.h"
 #include "image-items/overlay.h"
 #include "image-items/tiled.h"
+#include "image_scaling.h"
+#include "thread_pool.h"
 
 #if WITH_UNCOMPRESSED_CODEC
 #include "image-items/unc_image.h"
@@ -97,6 +104,100 @@ struct heif_error heif_encoder::alloc()
 }
 
 
+Result<std::shared_ptr<heif_encoder>> heif_encoder::clone()
+{
+  auto copy = std::make_shared<heif_encoder>(plugin);
+  heif_error err = copy->alloc();
+  if (err.code) {
+    return Error(err.code, err.subcode, err.message ? err.message : "");
+  }
+
+  // quality and lossless are not necessarily included in the parameter list
+
+  int value;
+  if (plugin->get_parameter_quality(encoder, &value).code == heif_error_Ok) {
+    plugin->set_parameter_quality(copy->encoder, value);
+  }
+
+  if (plugin->get_parameter_lossless(encoder, &value).code == heif_error_Ok) {
+    plugin->set_parameter_lossless(copy->encoder, value);
+  }
+
+  for (const struct heif_encoder_parameter* const* params = plugin->list_parameters(encoder);
+       *params;
+       params++) {
+    const char* name = (*params)->name;
+
+    switch ((*params)->type) {
+      case heif_encoder_parameter_type_integer:
+        if (plugin->get_parameter_integer(encoder, name, &value).code == heif_error_Ok) {
+          err = plugin->set_parameter_integer(copy->encoder, name, value);
+        }
+        break;
+      case heif_encoder_parameter_type_boolean:
+        if (plugin->get_parameter_boolean(encoder, name, &value).code == heif_error_Ok) {
+          err = plugin->set_parameter_boolean(copy->encoder, name, value);
+        }
+        break;
+      case heif_encoder_parameter_type_string: {
+        char str[256];
+        str[0] = 0;
+        if (plugin->get_parameter_string(encoder, name, str, sizeof(str)).code == heif_error_Ok) {
+          err = plugin->set_parameter_string(copy->encoder, name, str);
+        }
+        break;
+      }
+    }
+
+    if (err.code) {
+      return Error(err.code, err.subcode, err.message ? err.message : "");
+    }
+  }
+
+  return copy;
+}
+
+
+static const struct heif_encoder_parameter* find_threads_parameter(const struct heif_encoder_plugin* plugin, void* encoder)
+{
+  for (const struct heif_encoder_parameter* const* params = plugin->list_parameters(encoder);
+       *params;
+       params++) {
+    if (strcmp((*params)->name, heif_encoder_parameter_name_threads) == 0 &&
+        (*params)->type == heif_encoder_parameter_type_integer) {
+      return *params;
+    }
+  }
+
+  return nullptr;
+}
+
+
+bool heif_encoder::get_threads_parameter(int* threads) const
+{
+  if (!find_threads_parameter(plugin, encoder)) {
+    return false;
+  }
+
+  return plugin->get_parameter_integer(encoder, heif_encoder_parameter_name_threads, threads).code == heif_error_Ok;
+}
+
+
+bool heif_encoder::set_threads_parameter(int threads)
+{
+  const struct heif_encoder_parameter* param = find_threads_parameter(plugin, encoder);
+  if (!param) {
+    return false;
+  }
+
+  if (param->integer.have_minimum_maximum) {
+    threads = std::clamp(threads, param->integer.minimum, param->integer.maximum);
+  }
+
+  return plugin->set_parameter_integer(encoder, heif_encoder_parameter_name_threads, threads).code == heif_error_Ok;
+}
+
+
 HeifContext::HeifContext()
 {
   const char* security_limits_variable = getenv("LIBHEIF_SECURITY_LIMITS");
@@ -109,6 +210,9 @@ HeifContext::HeifContext()
     m_limits = global_security_limits;
   }
 
+  // Enough for a few full-resolution images, since entries are only needed until all derived images are decoded.
+  m_derived_image_source_cache.set_max_bytes(64 * 1024 * 1024);
+
   reset_to_empty_heif();
 }
 
@@ -144,6 +248,14 @@ static void copy_security_limits(heif_security_limits* dst, const heif_security_
     dst->min_memory_margin = src->min_memory_margin;
     dst->max_memory_margin = src->max_memory_margin;
   }
+
+  if (src->version >= 3) {
+    dst->max_total_memory = src->max_total_memory;
+  }
+
+  if (src->version >= 4) {
+    dst->plane_allocation = src->plane_allocation;
+  }
 }
 
 
@@ -159,10 +271,55 @@ void HeifContext::set_security_limits(const heif_security_limits* limits)
 }
 
 
-Error HeifContext::read(const std::shared_ptr<StreamReader>& reader)
+void HeifContext::init_heif_file_for_reading()
 {
   m_heif_file = std::make_shared<HeifFile>();
   m_heif_file->set_security_limits(&m_limits);
+  m_heif_file->set_lazy_box_parsing(m_lazy_box_parsing);
+  m_heif_file->set_initial_read_size(m_initial_read_size);
+  m_heif_file->set_data_cache_size(m_item_data_cache_size);
+  m_heif_file->set_max_read_gap(m_max_read_gap);
+}
+
+
+// The item data of the image and of its grid tiles or overlay layers.
+static std::vector<HeifFile::ItemDataRange> get_image_data_ranges(const HeifFile& file, heif_item_id id)
+{
+  std::vector<HeifFile::ItemDataRange> ranges;
+
+  HeifFile::ItemDataRange image_range;
+  image_range.item_id = id;
+  ranges.push_back(image_range);
+
+  // The tiles of 'tili' images are loaded on demand. Only the images referenced by 'grid' or 'iovl' are all needed.
+  auto iref_box = file.get_iref_box();
+  if (iref_box && file.get_item_type_4cc(id) != fourcc("tili")) {
+    for (heif_item_id ref : iref_box->get_references(id, fourcc("dimg"))) {
+      HeifFile::ItemDataRange range;
+      range.item_id = ref;
+      ranges.push_back(range);
+    }
+  }
+
+  return ranges;
+}
+
+
+void HeifContext::prefetch_primary_image_data() const
+{
+  m_heif_file->preload_item_data_ranges(get_image_data_ranges(*m_heif_file, m_primary_image->get_id()));
+}
+
+
+bool HeifContext::request_image_data_async(heif_item_id id, std::function<void()> on_available) const
+{
+  return m_heif_file->request_item_data_ranges_async(get_image_data_ranges(*m_heif_file, id), std::move(on_available));
+}
+
+
+Error HeifContext::read(const std::shared_ptr<StreamReader>& reader)
+{
+  init_heif_file_for_reading();
   Error err = m_heif_file->read(reader);
   if (err) {
     return err;
@@ -171,10 +328,20 @@ Error HeifContext::read(const std::shared_ptr<StreamReader>& reader)
   return interpret_heif_file();
 }
 
+Error HeifContext::read_with_header_index(const std::shared_ptr<StreamReader>& reader, const uint8_t* index, size_t index_size)
+{
+  auto streamResult = FileLayout::read_header_index(index, index_size, reader);
+  if (streamResult.error) {
+    return streamResult.error;
+  }
+
+  return read(*streamResult);
+}
+
+
 Error HeifContext::read_from_file(const char* input_filename)
 {
-  m_heif_file = std::make_shared<HeifFile>();
-  m_heif_file->set_security_limits(&m_limits);
+  init_heif_file_for_reading();
   Error err = m_heif_file->read_from_file(input_filename);
   if (err) {
     return err;
@@ -185,8 +352,7 @@ Error HeifContext::read_from_file(const char* input_filename)
 
 Error HeifContext::read_from_memory(const void* data, size_t size, bool copy)
 {
-  m_heif_file = std::make_shared<HeifFile>();
-  m_heif_file->set_security_limits(&m_limits);
+  init_heif_file_for_reading();
   Error err = m_heif_file->read_from_memory(data, size, copy);
   if (err) {
     return err;
@@ -286,14 +452,40 @@ static uint64_t rescale(uint64_t duration, uint32_t old_base, uint32_t new_base)
 }
 
 
-void HeifContext::write(StreamWriter& writer)
+Error HeifContext::write(StreamWriter& writer)
 {
+  if (Error err = prepare_for_writing()) {
+    return err;
+  }
+
+  return m_heif_file->write(writer);
+}
+
+
+Error HeifContext::write(const OutputWriteFunction& output, const OutputSeekFunction& seek)
+{
+  if (Error err = prepare_for_writing()) {
+    return err;
+  }
+
+  return m_heif_file->write(output, seek);
+}
+
+
+Error HeifContext::prepare_for_writing()
+{
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
   // --- finalize some parameters
 
   uint64_t max_sequence_duration = 0;
   if (auto mvhd = m_heif_file->get_mvhd_box()) {
     for (const auto& track : m_tracks) {
-      track.second->finalize_track();
+      if (Error err = track.second->finalize_track()) {
+        return err;
+      }
 
       // rescale track duration to movie timescale units
 
@@ -316,26 +508,45 @@ void HeifContext::write(StreamWriter& writer)
   }
 
   // --- serialize regions
+  //     Region items that already have data have been read from a file and are copied unchanged.
+
+  auto region_is_stored = [this](heif_item_id id) {
+    auto iloc = m_heif_file->get_iloc_box();
+    return iloc && iloc->find_item(id) != nullptr;
+  };
 
   for (auto& image : m_all_images) {
     for (auto region : image.second->get_region_item_ids()) {
-      m_heif_file->add_iref_reference(region,
-                                      fourcc("cdsc"), {image.first});
+      if (!region_is_stored(region)) {
+        m_heif_file->add_iref_reference(region,
+                                        fourcc("cdsc"), {image.first});
+      }
     }
   }
 
   for (auto& region : m_region_items) {
+    if (region_is_stored(region->item_id)) {
+      continue;
+    }
+
     std::vector<uint8_t> data_array;
     Error err = region->encode(data_array);
-    // TODO: err
+    if (err) {
+      return err;
+    }
 
-    m_heif_file->append_iloc_data(region->item_id, data_array, 0);
+    err = m_heif_file->append_iloc_data(region->item_id, data_array, 0);
+    if (err) {
+      return err;
+    }
   }
 
   // --- post-process images
 
   for (auto& img : m_all_images) {
-    img.second->process_before_write();
+    if (Error err = img.second->process_before_write()) {
+      return err;
+    }
   }
 
   // --- sort item properties
@@ -344,11 +555,236 @@ void HeifContext::write(StreamWriter& writer)
     ipma->sort_properties(m_heif_file->get_ipco_box());
   }
 
-  // --- write to file
+  // --- order of the image data
+
+  if (m_image_data_order == heif_image_data_order_as_added) {
+    m_heif_file->set_mdat_item_order({});
+  }
+  else {
+    m_heif_file->set_mdat_item_order(get_progressive_item_order());
+  }
+
+  return Error::Ok;
+}
+
+
+// Interleaves the bits of x and y.
+static uint64_t morton_code(uint32_t x, uint32_t y)
+{
+  uint64_t code = 0;
+  for (int bit = 0; bit < 32; bit++) {
+    code |= (uint64_t{(x >> bit) & 1} << (2 * bit)) |
+            (uint64_t{(y >> bit) & 1} << (2 * bit + 1));
+  }
+
+  return code;
+}
+
+
+std::vector<heif_item_id> HeifContext::get_progressive_item_order() const
+{
+  std::vector<heif_item_id> order;
+  std::set<heif_item_id> added;
+
+  auto iref = m_heif_file->get_iref_box();
+
+  // Adds an image after the images it is derived from.
+  std::function<void(const std::shared_ptr<ImageItem>&)> add_image = [&](const std::shared_ptr<ImageItem>& image) {
+    if (!image || !added.insert(image->get_id()).second) {
+      return;
+    }
+
+    std::vector<heif_item_id> source_ids;
+    if (iref) {
+      source_ids = iref->get_references(image->get_id(), fourcc("dimg"));
+    }
+
+    if (auto grid = std::dynamic_pointer_cast<ImageItem_Grid>(image)) {
+      const ImageGrid& spec = grid->get_grid_spec();
+      const uint32_t columns = spec.get_columns();
+
+      if (m_image_data_order == heif_image_data_order_progressive_z_order && columns > 0 &&
+          source_ids.size() == size_t{columns} * spec.get_rows()) {
+        std::vector<uint64_t> codes(source_ids.size());
+        for (size_t i = 0; i < source_ids.size(); i++) {
+          codes[i] = morton_code(static_cast<uint32_t>(i % columns), static_cast<uint32_t>(i / columns));
+        }
+
+        std::vector<size_t> tile_order(source_ids.size());
+        for (size_t i = 0; i < tile_order.size(); i++) {
+          tile_order[i] = i;
+        }
+
+        std::sort(tile_order.begin(), tile_order.end(), [&codes](size_t a, size_t b) { return codes[a] < codes[b]; });
+
+        std::vector<heif_item_id> ordered_ids;
+        for (size_t i : tile_order) {
+          ordered_ids.push_back(source_ids[i]);
+        }
+
+        source_ids = std::move(ordered_ids);
+      }
+    }
+
+    for (heif_item_id source_id : source_ids) {
+      auto source = m_all_images.find(source_id);
+      if (source != m_all_images.end()) {
+        add_image(source->second);
+      }
+    }
+
+    order.push_back(image->get_id());
+  };
+
+  // The images that reference 'id' with an 'iref' reference of type 'ref_type'.
+  // The relations between the images are only stored in the 'iref' box while a file is created.
+  auto get_referencing_images = [&](heif_item_id id, uint32_t ref_type) {
+    std::vector<std::shared_ptr<ImageItem>> images;
+
+    if (iref) {
+      for (const auto& image : m_all_images) {
+        std::vector<heif_item_id> refs = iref->get_references(image.first, ref_type);
+        if (std::find(refs.begin(), refs.end(), id) != refs.end()) {
+          images.push_back(image.second);
+        }
+      }
+    }
+
+    return images;
+  };
+
+  auto is_alpha_image = [&](heif_item_id id) {
+    auto auxC = m_heif_file->get_property_for_item<Box_auxC>(id);
+    return auxC && (auxC->get_aux_type() == "urn:mpeg:avc:2015:auxid:1" ||
+                    auxC->get_aux_type() == "urn:mpeg:hevc:2015:auxid:1" ||
+                    auxC->get_aux_type() == "urn:mpeg:mpegB:cicp:systems:auxiliary:alpha");
+  };
+
+  // Adds an image after its alpha image.
+  auto add_image_with_alpha = [&](const std::shared_ptr<ImageItem>& image) {
+    for (const auto& aux : get_referencing_images(image->get_id(), fourcc("auxl"))) {
+      if (is_alpha_image(aux->get_id())) {
+        add_image(aux);
+      }
+    }
+
+    add_image(image);
+  };
+
+  // Adds a top-level image after its thumbnails and smaller pyramid layers, followed by its other auxiliary images.
+  auto add_top_level_image = [&](const std::shared_ptr<ImageItem>& image) {
+    for (const auto& thumbnail : get_referencing_images(image->get_id(), fourcc("thmb"))) {
+      add_image_with_alpha(thumbnail);
+    }
+
+    for (const auto& layer : get_pyramid_layers(image->get_id())) {
+      if (layer != image) {
+        add_image_with_alpha(layer);
+      }
+    }
+
+    add_image_with_alpha(image);
+
+    for (const auto& aux : get_referencing_images(image->get_id(), fourcc("auxl"))) {
+      add_image(aux);
+    }
+  };
+
+  if (m_primary_image) {
+    add_top_level_image(m_primary_image);
+  }
+
+  for (const auto& image : m_top_level_images) {
+    add_top_level_image(image);
+  }
+
+  return order;
+}
+
+Result<std::span<const uint8_t>> HeifContext::get_borrowed_item_data(heif_item_id id, heif_metadata_compression* out_compression)
+{
+  std::span<const uint8_t> data = m_heif_file->get_item_data_without_copy(id, out_compression);
+  if (!data.empty()) {
+    return data;
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_borrowed_item_data_mutex);
+#endif
+
+  const bool decompressed = (out_compression == nullptr);
+
+  auto iter = m_borrowed_item_data.find({id, decompressed});
+  if (iter == m_borrowed_item_data.end()) {
+    BorrowedItemData copy;
+    if (decompressed && m_heif_file->get_item_data_compression(id) != heif_metadata_compression_off) {
+      // Share the data with the decompressed metadata cache. Holding the reference keeps it valid after eviction.
+      auto dataResult = get_decompressed_metadata(id);
+      if (dataResult.error) {
+        return dataResult.error;
+      }
+
+      copy.data = dataResult.value;
+    }
+    else {
+      auto data = std::make_shared<std::vector<uint8_t>>();
+      Error err = m_heif_file->get_item_data(id, data.get(), decompressed ? nullptr : &copy.compression);
+      if (err) {
+        return err;
+      }
+
+      copy.data = std::move(data);
+    }
+
+    iter = m_borrowed_item_data.emplace(std::make_pair(id, decompressed), std::move(copy)).first;
+  }
+
+  if (out_compression) {
+    *out_compression = iter->second.compression;
+  }
+
+  return std::span<const uint8_t>(*iter->second.data);
+}
+
+
+Result<std::shared_ptr<const std::vector<uint8_t>>> HeifContext::get_decompressed_metadata(heif_item_id id) const
+{
+  if (auto data = m_decompressed_metadata_cache.get(id)) {
+    return data;
+  }
+
+  auto data = std::make_shared<std::vector<uint8_t>>();
+  Error err = m_heif_file->get_uncompressed_item_data(id, data.get());
+  if (err) {
+    return err;
+  }
+
+  std::shared_ptr<const std::vector<uint8_t>> const_data = std::move(data);
+  m_decompressed_metadata_cache.put(id, const_data);
+
+  return const_data;
+}
+
+
+Result<size_t> HeifContext::get_decompressed_metadata_size(heif_item_id id) const
+{
+  if (auto data = m_decompressed_metadata_cache.get(id)) {
+    return data->size();
+  }
+
+  if (std::optional<size_t> size = m_heif_file->get_decompressed_item_data_size(id)) {
+    return *size;
+  }
+
+  auto dataResult = get_decompressed_metadata(id);
+  if (dataResult.error) {
+    return dataResult.error;
+  }
 
-  m_heif_file->write(writer);
+  return dataResult.value->size();
 }
 
+
 std::string HeifContext::debug_dump_boxes() const
 {
   return m_heif_file->debug_dump_boxes();
@@ -389,6 +825,8 @@ void HeifContext::remove_top_level_image(const std::shared_ptr<ImageItem>& image
 
 Error HeifContext::interpret_heif_file()
 {
+  HEIF_TRACE_SCOPE("file", "interpret");
+
   if (m_heif_file->has_images()) {
     Error err = interpret_heif_file_images();
     if (err) {
@@ -396,7 +834,14 @@ Error HeifContext::interpret_heif_file()
     }
   }
 
-  if (m_heif_file->has_sequences()) {
+  if (m_prefetch_primary_image && m_primary_image) {
+    prefetch_primary_image_data();
+  }
+
+  if (m_heif_file->has_deferred_moov_box()) {
+    m_has_deferred_tracks = true;
+  }
+  else if (m_heif_file->has_sequences()) {
     Error err = interpret_heif_file_sequences();
     if (err) {
       return err;
@@ -412,6 +857,8 @@ Error HeifContext::interpret_heif_file_images()
   m_all_images.clear();
   m_top_level_images.clear();
   m_primary_image.reset();
+  m_num_derived_image_references.clear();
+  m_derived_image_source_cache.clear();
 
 
   // --- reference all non-hidden images
@@ -855,6 +1302,22 @@ Error HeifContext::interpret_heif_file_images()
   }
 
 
+  // --- count the references from derived images, to find images that are the source of several of them
+
+  if (iref_box) {
+    for (const auto& pair : m_all_images) {
+      uint32_t item_type = m_heif_file->get_item_type_4cc(pair.first);
+      if (item_type != fourcc("iden") && item_type != fourcc("iovl")) {
+        continue;
+      }
+
+      for (heif_item_id ref : iref_box->get_references(pair.first, fourcc("dimg"))) {
+        m_num_derived_image_references[ref]++;
+      }
+    }
+  }
+
+
   // --- read metadata and assign to image
 
   for (heif_item_id id : image_IDs) {
@@ -877,7 +1340,21 @@ Error HeifContext::interpret_heif_file_images()
     metadata->content_type = content_type;
     metadata->item_uri_type = std::move(item_uri_type);
 
-    Error err = m_heif_file->get_uncompressed_item_data(id, &(metadata->m_data));
+    // Large Exif or XMP data is not copied when the input file is held in memory.
+    // Compressed data is decompressed when it is accessed.
+    Error err;
+    heif_metadata_compression compression = m_heif_file->get_item_data_compression(id);
+    if (compression != heif_metadata_compression_off &&
+        compression != heif_metadata_compression_unknown) {
+      metadata->m_compressed = true;
+    }
+    else {
+      metadata->m_data_without_copy = m_heif_file->get_item_data_without_copy(id, nullptr);
+      if (metadata->m_data_without_copy.empty()) {
+        err = m_heif_file->get_uncompressed_item_data(id, &(metadata->m_data));
+      }
+    }
+
     if (err) {
       if (item_type == fourcc("Exif") || item_type == fourcc("mime")) {
         // these item types should have data
@@ -1161,6 +1638,15 @@ Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_image(heif_item_id I
                                                                   const struct heif_decoding_options& options,
                                                                   bool decode_only_tile, uint32_t tx, uint32_t ty) const
 {
+  DecodingStatisticsCollector statistics(options.statistics);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::optional<ThreadPool::NodeScope> node_scope;
+  if (m_numa_node >= 0) {
+    node_scope.emplace(m_numa_node);
+  }
+#endif
+
   std::shared_ptr<ImageItem> imgitem;
   if (m_all_images.find(ID) != m_all_images.end()) {
     imgitem = m_all_images.find(ID)->second;
@@ -1172,22 +1658,297 @@ Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_image(heif_item_id I
   }
 
 
-  auto decodingResult = imgitem->decode_image(options, decode_only_tile, tx, ty);
-  if (decodingResult.error) {
-    return decodingResult.error;
-  }
+  // --- return a copy of a cached tile
 
-  std::shared_ptr<HeifPixelImage> img = decodingResult.value;
+  std::optional<DecodedTileCache::Key> cache_key;
 
+  if (decode_only_tile && m_decoded_tile_cache.is_enabled()) {
+    cache_key.emplace(ID, tx, ty, out_colorspace, out_chroma, options);
 
-  // --- convert to output chroma format
+    if (auto cached_img = m_decoded_tile_cache.get(*cache_key)) {
+      DecodingStatistics::add(&DecodingStatistics::num_tile_cache_hits, 1);
+      return cached_img->create_copy(&m_limits);
+    }
 
-  auto img_result = convert_to_output_colorspace(img, out_colorspace, out_chroma, options);
-  if (img_result.error) {
-    return img_result.error;
-  }
-  else {
-    img = *img_result;
+    DecodingStatistics::add(&DecodingStatistics::num_tile_cache_misses, 1);
+  }
+
+
+  uint64_t start_time_us = get_monotonic_time_us();
+
+
+  // --- decode a cheaper representation if the image cannot be decoded until the deadline
+
+  heif_decoding_options item_options = options;
+  DeadlineFallback fallback;
+
+  if (options.deadline_us && !decode_only_tile) {
+    fallback = select_deadline_fallback(imgitem, options);
+    if (fallback.type == heif_decoding_fallback_reduced_resolution) {
+      item_options.target_scale_denominator = fallback.scale_denominator;
+    }
+    else if (fallback.type != heif_decoding_fallback_none) {
+      imgitem = fallback.item;
+    }
+  }
+
+
+  ImageItem::OutputFormat output_format{out_colorspace, out_chroma};
+
+  auto decodingResult = imgitem->decode_image(item_options, decode_only_tile, tx, ty, &output_format);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = decodingResult.value;
+
+
+  // --- convert to output chroma format (if not already done while decoding)
+
+  auto img_result = convert_to_output_colorspace(img, out_colorspace, out_chroma, options);
+  if (img_result.error) {
+    return img_result.error;
+  }
+  else {
+    img = *img_result;
+  }
+
+  img->add_warnings(imgitem->get_decoding_warnings());
+
+
+  // --- report the fallback and remember the decoding time for the following deadline estimates
+
+  if (img->get_decoding_fallback() == heif_decoding_fallback_none) {
+    if (fallback.type == heif_decoding_fallback_reduced_resolution && img->get_decoding_scale_denominator() == 1) {
+      // the decoder did not reduce the resolution
+    }
+    else {
+      img->set_decoding_fallback(fallback.type);
+    }
+
+    if (!decode_only_tile && options.max_coded_data_size == 0) {
+      m_decoding_time_estimator.add_measurement(imgitem->get_compression_format(),
+                                                uint64_t{img->get_width()} * img->get_height(),
+                                                get_monotonic_time_us() - start_time_us);
+    }
+  }
+
+  if (cache_key) {
+    // The cache keeps the decoded image. The caller gets a copy that it may modify.
+    m_decoded_tile_cache.put(*cache_key, img);
+    return img->create_copy(&m_limits);
+  }
+
+  return img;
+}
+
+
+
+HeifContext::DeadlineFallback HeifContext::select_deadline_fallback(const std::shared_ptr<ImageItem>& imgitem,
+                                                                    const heif_decoding_options& options) const
+{
+  DeadlineFallback fallback;
+
+  uint64_t now = get_monotonic_time_us();
+  uint64_t remaining_us = (options.deadline_us > now) ? options.deadline_us - now : 0;
+
+  uint64_t full_pixels = uint64_t{imgitem->get_width()} * imgitem->get_height();
+
+  // Without previous decoding times, the full image is decoded.
+  std::optional<uint64_t> full_time_us = m_decoding_time_estimator.estimate_time_us(imgitem->get_compression_format(), full_pixels);
+  if (!full_time_us || *full_time_us <= remaining_us || full_pixels == 0) {
+    return fallback;
+  }
+
+  auto estimate = [&](const std::shared_ptr<ImageItem>& item, uint64_t num_pixels) {
+    // Formats without own measurements are assumed to decode as fast as the full image.
+    std::optional<uint64_t> time_us = m_decoding_time_estimator.estimate_time_us(item->get_compression_format(), num_pixels);
+    return time_us ? *time_us : *full_time_us * num_pixels / full_pixels;
+  };
+
+  std::vector<DeadlineFallback> candidates;
+
+  if (!options.ignore_transformations) {
+    for (const auto& layer : get_pyramid_layers(imgitem->get_id())) {
+      candidates.push_back({layer, 1, heif_decoding_fallback_pyramid_layer});
+    }
+
+    for (const auto& thumbnail : imgitem->get_thumbnails()) {
+      candidates.push_back({thumbnail, 1, heif_decoding_fallback_thumbnail});
+    }
+  }
+
+  // Only these decoders can skip resolution levels (see heif_decoding_options.target_scale_denominator).
+  heif_compression_format format = imgitem->get_compression_format();
+  if (format == heif_compression_JPEG || format == heif_compression_JPEG2000 || format == heif_compression_HTJ2K) {
+    for (uint8_t d = 2; d <= 8; d *= 2) {
+      candidates.push_back({imgitem, d, heif_decoding_fallback_reduced_resolution});
+    }
+  }
+
+  // Take the largest representation that can be decoded in time, or the fastest one if none can.
+
+  uint64_t best_pixels = 0;
+  uint64_t fastest_time_us = *full_time_us;
+  DeadlineFallback fastest;
+
+  for (const auto& candidate : candidates) {
+    if (candidate.item->get_item_error()) {
+      continue;
+    }
+
+    uint64_t d = candidate.scale_denominator;
+    uint64_t pixels = uint64_t{candidate.item->get_width()} * candidate.item->get_height() / (d * d);
+    if (pixels == 0 || pixels >= full_pixels) {
+      continue;
+    }
+
+    uint64_t time_us = estimate(candidate.item, pixels);
+
+    if (time_us <= remaining_us && pixels > best_pixels) {
+      fallback = candidate;
+      best_pixels = pixels;
+    }
+
+    if (time_us < fastest_time_us) {
+      fastest = candidate;
+      fastest_time_us = time_us;
+    }
+  }
+
+  if (fallback.type == heif_decoding_fallback_none) {
+    fallback = fastest;
+  }
+
+  return fallback;
+}
+
+
+Error HeifContext::decode_image_into(heif_item_id ID,
+                                     const struct heif_decoding_options& options,
+                                     const std::shared_ptr<HeifPixelImage>& target) const
+{
+  auto iter = m_all_images.find(ID);
+  if (iter == m_all_images.end() || iter->second == nullptr) {
+    return Error(heif_error_Invalid_input, heif_suberror_Nonexisting_item_referenced);
+  }
+
+  std::shared_ptr<ImageItem> imgitem = iter->second;
+
+  if (auto error = imgitem->get_item_error()) {
+    return error;
+  }
+
+  {
+    DecodingStatisticsCollector statistics(options.statistics);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::optional<ThreadPool::NodeScope> node_scope;
+    if (m_numa_node >= 0) {
+      node_scope.emplace(m_numa_node);
+    }
+#endif
+
+    auto intoResult = imgitem->decode_full_image_into(options, target);
+    if (intoResult.error) {
+      return intoResult.error;
+    }
+
+    if (*intoResult) {
+      return Error::Ok;
+    }
+  }
+
+
+  // --- decode into a separate image and copy it into the target
+
+  // The target has the size of the full image. Thus, no cheaper representation can be decoded into it.
+  heif_decoding_options full_options = options;
+  full_options.deadline_us = 0;
+
+  auto decodingResult = decode_image(ID, target->get_colorspace(), target->get_chroma_format(), full_options, false, 0, 0);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = *decodingResult;
+
+  bool same_layout = (img->get_width() == target->get_width() &&
+                      img->get_height() == target->get_height() &&
+                      img->get_channel_set() == target->get_channel_set());
+
+  for (heif_channel channel : img->get_channel_set()) {
+    if (img->get_bits_per_pixel(channel) != target->get_bits_per_pixel(channel)) {
+      same_layout = false;
+    }
+  }
+
+  if (!same_layout) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Unsupported_parameter,
+                 "Decoded image does not match the size, planes or bit depth of the output buffers"};
+  }
+
+  return target->copy_image_to(img, 0, 0);
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_primary_image_from_memory(const void* data, size_t size,
+                                                                                      heif_colorspace out_colorspace,
+                                                                                      heif_chroma out_chroma,
+                                                                                      const struct heif_decoding_options& options)
+{
+  HeifContext ctx;
+
+  if (Error err = ctx.read_from_memory(data, size, false)) {
+    return err;
+  }
+
+  std::shared_ptr<ImageItem> primary_image = ctx.get_primary_image(true);
+  if (!primary_image) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_No_or_invalid_primary_item};
+  }
+
+  if (auto errImage = std::dynamic_pointer_cast<ImageItem_Error>(primary_image)) {
+    return errImage->get_item_error();
+  }
+
+  return ctx.decode_image(primary_image->get_id(), out_colorspace, out_chroma, options, false, 0, 0);
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_image_region(heif_item_id ID,
+                                                                         heif_colorspace out_colorspace,
+                                                                         heif_chroma out_chroma,
+                                                                         const struct heif_decoding_options& options,
+                                                                         uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+{
+  DecodingStatisticsCollector statistics(options.statistics);
+
+  auto iter = m_all_images.find(ID);
+  if (iter == m_all_images.end() || iter->second == nullptr) {
+    return Error(heif_error_Invalid_input, heif_suberror_Nonexisting_item_referenced);
+  }
+
+  std::shared_ptr<ImageItem> imgitem = iter->second;
+
+  auto decodingResult = imgitem->decode_image_region(options, x0, y0, w, h);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = decodingResult.value;
+
+
+  // --- convert to output chroma format
+
+  auto img_result = convert_to_output_colorspace(img, out_colorspace, out_chroma, options);
+  if (img_result.error) {
+    return img_result.error;
+  }
+  else {
+    img = *img_result;
   }
 
   img->add_warnings(imgitem->get_decoding_warnings());
@@ -1196,6 +1957,304 @@ Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_image(heif_item_id I
 }
 
 
+Error HeifContext::decode_image_to_gpu_surfaces(heif_item_id ID,
+                                                heif_gpu_surface_type type,
+                                                const struct heif_decoding_options& options,
+                                                GpuSurfaceList& out_surfaces) const
+{
+  DecodingStatisticsCollector statistics(options.statistics);
+
+  auto iter = m_all_images.find(ID);
+  if (iter == m_all_images.end() || iter->second == nullptr) {
+    return Error(heif_error_Invalid_input, heif_suberror_Nonexisting_item_referenced);
+  }
+
+  if (auto error = iter->second->get_item_error()) {
+    return error;
+  }
+
+  return iter->second->decode_to_gpu_surfaces(options, type, 0, 0, out_surfaces);
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_image_at_size(heif_item_id ID,
+                                                                          heif_colorspace out_colorspace,
+                                                                          heif_chroma out_chroma,
+                                                                          const struct heif_decoding_options& options,
+                                                                          uint32_t max_width, uint32_t max_height) const
+{
+  DecodingStatisticsCollector statistics(options.statistics);
+
+  auto iter = m_all_images.find(ID);
+  if (iter == m_all_images.end() || iter->second == nullptr) {
+    return Error(heif_error_Invalid_input, heif_suberror_Nonexisting_item_referenced);
+  }
+
+  std::shared_ptr<ImageItem> imgitem = iter->second;
+
+  if (max_width == 0 || max_height == 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Maximum image size is empty"};
+  }
+
+
+  // --- compute output size
+
+  uint32_t width, height;
+  if (options.ignore_transformations) {
+    width = imgitem->get_ispe_width();
+    height = imgitem->get_ispe_height();
+  }
+  else {
+    width = imgitem->get_width();
+    height = imgitem->get_height();
+  }
+
+  if (width == 0 || height == 0) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_No_ispe_property,
+                 "Image has no size"};
+  }
+
+  uint32_t out_width = width;
+  uint32_t out_height = height;
+
+  if (width > max_width || height > max_height) {
+    if (uint64_t{width} * max_height <= uint64_t{height} * max_width) {
+      out_height = max_height;
+      out_width = std::max(uint32_t{1}, static_cast<uint32_t>(uint64_t{width} * max_height / height));
+    }
+    else {
+      out_width = max_width;
+      out_height = std::max(uint32_t{1}, static_cast<uint32_t>(uint64_t{height} * max_width / width));
+    }
+  }
+
+
+  // --- choose the smallest image that is at least as large as the output
+
+  std::shared_ptr<ImageItem> source = imgitem;
+
+  if (!options.ignore_transformations) {
+    std::vector<std::shared_ptr<ImageItem>> candidates = imgitem->get_thumbnails();
+
+    for (const auto& layer : get_pyramid_layers(ID)) {
+      candidates.push_back(layer);
+    }
+
+    for (const auto& candidate : candidates) {
+      if (candidate->get_item_error()) {
+        continue;
+      }
+
+      uint32_t w = candidate->get_width();
+      uint32_t h = candidate->get_height();
+
+      if (w >= out_width && h >= out_height &&
+          uint64_t{w} * h < uint64_t{source->get_width()} * source->get_height()) {
+        source = candidate;
+      }
+    }
+  }
+
+
+  auto decodingResult = source->decode_image_scaled(options, out_width, out_height);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = *decodingResult;
+
+
+  // --- convert to output chroma format
+
+  auto img_result = convert_to_output_colorspace(img, out_colorspace, out_chroma, options);
+  if (img_result.error) {
+    return img_result.error;
+  }
+  else {
+    img = *img_result;
+  }
+
+  img->add_warnings(source->get_decoding_warnings());
+
+  return img;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_derived_image_source(const ImageItem& source,
+                                                                                 const struct heif_decoding_options& options) const
+{
+  auto references = m_num_derived_image_references.find(source.get_id());
+  bool shared_source = (references != m_num_derived_image_references.end() && references->second > 1);
+
+  if (!shared_source || !m_derived_image_source_cache.is_enabled()) {
+    return source.decode_image(options, false, 0, 0);
+  }
+
+  DecodedTileCache::Key cache_key(source.get_id(), 0, 0, heif_colorspace_undefined, heif_chroma_undefined, options);
+
+  if (auto cached_img = m_derived_image_source_cache.get(cache_key)) {
+    return cached_img->create_copy(&m_limits);
+  }
+
+  auto decodingResult = source.decode_image(options, false, 0, 0);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  // The cache keeps the decoded image. The derived image gets a copy that it may modify.
+  m_derived_image_source_cache.put(cache_key, *decodingResult);
+  return (*decodingResult)->create_copy(&m_limits);
+}
+
+
+std::vector<std::shared_ptr<ImageItem>> HeifContext::get_pyramid_layers(heif_item_id ID) const
+{
+  std::vector<std::shared_ptr<ImageItem>> layers;
+
+  auto grpl = m_heif_file->get_grpl_box();
+  if (!grpl) {
+    return layers;
+  }
+
+  for (const auto& group : grpl->get_all_child_boxes()) {
+    auto pymd = std::dynamic_pointer_cast<Box_pymd>(group);
+    if (!pymd) {
+      continue;
+    }
+
+    const auto& layer_ids = pymd->get_item_ids();
+    if (std::find(layer_ids.begin(), layer_ids.end(), ID) == layer_ids.end()) {
+      continue;
+    }
+
+    for (heif_item_id layer_id : layer_ids) {
+      auto layer = m_all_images.find(layer_id);
+      if (layer != m_all_images.end() && layer->second && !layer->second->get_item_error()) {
+        layers.push_back(layer->second);
+      }
+    }
+
+    break;
+  }
+
+  std::stable_sort(layers.begin(), layers.end(), [](const std::shared_ptr<ImageItem>& a, const std::shared_ptr<ImageItem>& b) {
+    return uint64_t{a->get_ispe_width()} * a->get_ispe_height() < uint64_t{b->get_ispe_width()} * b->get_ispe_height();
+  });
+
+  return layers;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifContext::decode_image_region_at_scale(heif_item_id ID,
+                                                                                  heif_colorspace out_colorspace,
+                                                                                  heif_chroma out_chroma,
+                                                                                  const struct heif_decoding_options& options,
+                                                                                  uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                                                                                  uint32_t out_width, uint32_t out_height) const
+{
+  DecodingStatisticsCollector statistics(options.statistics);
+
+  auto iter = m_all_images.find(ID);
+  if (iter == m_all_images.end() || iter->second == nullptr) {
+    return Error(heif_error_Invalid_input, heif_suberror_Nonexisting_item_referenced);
+  }
+
+  std::shared_ptr<ImageItem> imgitem = iter->second;
+  if (auto error = imgitem->get_item_error()) {
+    return error;
+  }
+
+  if (w == 0 || h == 0 || out_width == 0 || out_height == 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Region or output size is empty"};
+  }
+
+  auto image_size = [&options](const std::shared_ptr<ImageItem>& item) {
+    if (options.ignore_transformations) {
+      return std::make_pair(item->get_ispe_width(), item->get_ispe_height());
+    }
+    else {
+      return std::make_pair(item->get_width(), item->get_height());
+    }
+  };
+
+  auto [width, height] = image_size(imgitem);
+
+  if (uint64_t{x0} + w > width || uint64_t{y0} + h > height) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Region is outside of the image"};
+  }
+
+
+  // --- choose the smallest layer in which the region has at least the output size
+
+  std::shared_ptr<ImageItem> source = imgitem;
+  uint32_t source_width = width;
+  uint32_t source_height = height;
+
+  for (const auto& layer : get_pyramid_layers(ID)) {
+    auto [layer_width, layer_height] = image_size(layer);
+
+    if (uint64_t{layer_width} * w >= uint64_t{out_width} * width &&
+        uint64_t{layer_height} * h >= uint64_t{out_height} * height &&
+        uint64_t{layer_width} * layer_height < uint64_t{source_width} * source_height) {
+      source = layer;
+      source_width = layer_width;
+      source_height = layer_height;
+    }
+  }
+
+
+  // --- map the region into the layer coordinates (rounded outwards)
+
+  uint32_t layer_x0 = static_cast<uint32_t>(uint64_t{x0} * source_width / width);
+  uint32_t layer_y0 = static_cast<uint32_t>(uint64_t{y0} * source_height / height);
+  uint32_t layer_x1 = static_cast<uint32_t>((uint64_t{x0 + w} * source_width + width - 1) / width);
+  uint32_t layer_y1 = static_cast<uint32_t>((uint64_t{y0 + h} * source_height + height - 1) / height);
+
+  layer_x1 = std::min(std::max(layer_x1, layer_x0 + 1), source_width);
+  layer_y1 = std::min(std::max(layer_y1, layer_y0 + 1), source_height);
+
+  auto decodingResult = source->decode_image_region(options, layer_x0, layer_y0, layer_x1 - layer_x0, layer_y1 - layer_y0);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = *decodingResult;
+
+  if (img->get_width() != out_width || img->get_height() != out_height) {
+    std::shared_ptr<HeifPixelImage> scaled;
+    Error err = img->scale_nearest_neighbor(scaled, out_width, out_height, get_security_limits());
+    if (err) {
+      return err;
+    }
+
+    img = std::move(scaled);
+  }
+
+
+  // --- convert to output chroma format
+
+  auto img_result = convert_to_output_colorspace(img, out_colorspace, out_chroma, options);
+  if (img_result.error) {
+    return img_result.error;
+  }
+  else {
+    img = *img_result;
+  }
+
+  img->add_warnings(source->get_decoding_warnings());
+
+  return img;
+}
+
+
+extern heif_color_conversion_options_ext normalize_options(const heif_color_conversion_options_ext* input_options);
 
 Result<std::shared_ptr<HeifPixelImage>> HeifContext::convert_to_output_colorspace(std::shared_ptr<HeifPixelImage> img,
                                                                                   heif_colorspace out_colorspace,
@@ -1212,61 +2271,351 @@ Result<std::shared_ptr<HeifPixelImage>> HeifContext::convert_to_output_colorspac
   bool different_chroma = (target_chroma != img->get_chroma_format());
   bool different_colorspace = (target_colorspace != img->get_colorspace());
 
-  uint8_t img_bpp = img->get_visual_image_bits_per_pixel();
-  uint8_t converted_output_bpp = (options.convert_hdr_to_8bit && img_bpp > 8) ? 8 : 0 /* keep input depth */;
+  uint8_t img_bpp = img->get_visual_image_bits_per_pixel();
+  uint8_t converted_output_bpp = (options.convert_hdr_to_8bit && img_bpp > 8) ? 8 : 0 /* keep input depth */;
+
+  heif_color_conversion_options_ext options_ext = normalize_options(options.color_conversion_options_ext);
+
+  bool different_premultiplication = false;
+  if (options_ext.alpha_premultiplication_mode != heif_alpha_premultiplication_mode_keep) {
+    bool premultiplied = (options_ext.alpha_premultiplication_mode == heif_alpha_premultiplication_mode_premultiplied);
+    different_premultiplication = (img->is_premultiplied_alpha() != premultiplied);
+  }
+
+  if (different_chroma ||
+      different_colorspace ||
+      converted_output_bpp ||
+      (img->has_alpha() && (options_ext.alpha_composition_mode != heif_alpha_composition_mode_none ||
+                            different_premultiplication))) {
+
+    // Without an explicit number of conversion threads, use the decoding threads of the context.
+    if (options.color_conversion_options_ext == nullptr || options.color_conversion_options_ext->version < 2) {
+      options_ext.max_threads = m_max_decoding_threads;
+    }
+
+    DecodingStageTimer timer(&DecodingStatistics::color_conversion_time_us);
+
+    return convert_colorspace(img, target_colorspace, target_chroma, nullptr, converted_output_bpp,
+                                         options.color_conversion_options, &options_ext,
+                                         get_security_limits());
+  }
+  else {
+    return img;
+  }
+}
+
+
+static Result<std::shared_ptr<HeifPixelImage>>
+create_alpha_image_from_image_alpha_channel(const std::shared_ptr<HeifPixelImage>& image,
+                                            const heif_security_limits* limits)
+{
+  // --- generate alpha image
+
+  std::shared_ptr<HeifPixelImage> alpha_image = std::make_shared<HeifPixelImage>();
+  alpha_image->create(image->get_width(), image->get_height(),
+                      heif_colorspace_monochrome, heif_chroma_monochrome);
+
+  if (image->has_channel(heif_channel_Alpha)) {
+    alpha_image->copy_new_plane_from(image, heif_channel_Alpha, heif_channel_Y, limits);
+  }
+  else if (image->get_chroma_format() == heif_chroma_interleaved_RGBA) {
+    if (auto err = alpha_image->extract_alpha_from_RGBA(image, limits)) {
+      return err;
+    }
+  }
+  // TODO: 16 bit
+
+  // --- set nclx profile with full-range flag
+
+  auto nclx = std::make_shared<color_profile_nclx>();
+  nclx->set_undefined();
+  nclx->set_full_range_flag(true); // this is the default, but just to be sure in case the defaults change
+  alpha_image->set_color_profile_nclx(nclx);
+
+  return alpha_image;
+}
+
+
+Result<std::shared_ptr<ImageItem>> HeifContext::encode_image(const std::shared_ptr<HeifPixelImage>& pixel_image,
+                                struct heif_encoder* encoder,
+                                const struct heif_encoding_options& in_options,
+                                enum heif_image_input_class input_class)
+{
+  auto compressionResult = compress_image(pixel_image, encoder, in_options, input_class);
+  if (compressionResult.error) {
+    return compressionResult.error;
+  }
+
+  return add_compressed_image(*compressionResult.value, encoder);
+}
+
+
+static size_t get_compressed_size(const HeifContext::CompressedImage& compressed)
+{
+  size_t size = compressed.coded_data.bitstream.size();
+  if (compressed.alpha) {
+    size += get_compressed_size(*compressed.alpha);
+  }
+
+  return size;
+}
+
+
+namespace {
+  // Interval of the target size search. All qualities up to 'best_fit' fit into the target size,
+  // all qualities from 'lowest_oversized' on exceed it.
+  struct QualityBracket
+  {
+    int best_fit = -1;
+    int lowest_oversized = 101;
+
+    bool done() const { return lowest_oversized - best_fit <= 1; }
+
+    void add(int quality, bool fits)
+    {
+      if (fits) {
+        best_fit = std::max(best_fit, quality);
+      }
+      else {
+        lowest_oversized = std::min(lowest_oversized, quality);
+      }
+    }
+
+    // Up to 'n' qualities that divide the open interval into equal parts.
+    std::vector<int> split(int n) const
+    {
+      std::vector<int> probes;
+      for (int i = 1; i <= n; i++) {
+        int q = best_fit + (lowest_oversized - best_fit) * i / (n + 1);
+        if (q > best_fit && q < lowest_oversized && (probes.empty() || probes.back() != q)) {
+          probes.push_back(q);
+        }
+      }
+
+      return probes;
+    }
+  };
+}
+
+
+Result<std::shared_ptr<ImageItem>> HeifContext::encode_image_with_target_size(const std::shared_ptr<HeifPixelImage>& pixel_image,
+                                                                              struct heif_encoder* encoder,
+                                                                              const struct heif_encoding_options& options,
+                                                                              size_t target_size,
+                                                                              int* out_quality)
+{
+  // The full resolution search starts in this distance around the quality found at half resolution.
+  const int kHalfResolutionMargin = 8;
+
+  // Images smaller than this are searched at full resolution only.
+  const uint32_t kMinHalfResolutionSize = 256;
+
+  auto conversionResult = convert_image_for_encoding(pixel_image, encoder, options);
+  if (conversionResult.error) {
+    return conversionResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> converted = *conversionResult;
+
+
+  // --- one encoder copy per parallel probe, so that the user's encoder keeps its settings
+
+  int num_probes = 1;
+  int thread_budget = get_encoding_thread_budget();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (thread_budget == 0) {
+    thread_budget = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  num_probes = std::max(1, get_max_encoding_threads());
+  if (thread_budget > 0) {
+    num_probes = std::min(num_probes, thread_budget);
+  }
+#endif
+
+  std::vector<std::shared_ptr<heif_encoder>> probe_encoders;
+  for (int i = 0; i < num_probes; i++) {
+    auto cloneResult = encoder->clone();
+    if (cloneResult.error) {
+      return cloneResult.error;
+    }
+
+    std::shared_ptr<heif_encoder> probe_encoder = *cloneResult;
+    probe_encoder->plugin->set_parameter_lossless(probe_encoder->encoder, false);
+    if (thread_budget > 0) {
+      probe_encoder->set_threads_parameter(std::max(1, thread_budget / num_probes));
+    }
+
+    probe_encoders.push_back(std::move(probe_encoder));
+  }
+
+
+  // Encodes 'image' at all 'qualities', 'num_probes' at a time, and returns the results in the same order.
+
+  auto encode_probes = [&](const std::shared_ptr<HeifPixelImage>& image,
+                           const std::vector<int>& qualities) -> Result<std::vector<std::shared_ptr<CompressedImage>>> {
+    std::vector<std::shared_ptr<CompressedImage>> results(qualities.size());
+    std::vector<Error> errors(qualities.size());
+
+    auto encode_probe = [&](size_t idx, heif_encoder* probe_encoder) {
+      heif_error err = probe_encoder->plugin->set_parameter_quality(probe_encoder->encoder, qualities[idx]);
+      if (err.code) {
+        errors[idx] = Error(err.code, err.subcode, err.message ? err.message : "");
+        return;
+      }
+
+      auto compressionResult = compress_image(image, probe_encoder, options, heif_image_input_class_normal, image);
+      if (compressionResult.error) {
+        errors[idx] = compressionResult.error;
+      }
+      else {
+        results[idx] = *compressionResult;
+      }
+    };
+
+    for (size_t first = 0; first < qualities.size(); first += num_probes) {
+      size_t n = std::min(qualities.size() - first, static_cast<size_t>(num_probes));
+
+#if ENABLE_MULTITHREADING_SUPPORT
+      TaskGroup tasks;
+      for (size_t i = 1; i < n; i++) {
+        heif_encoder* probe_encoder = probe_encoders[i].get();
+        tasks.run([&encode_probe, first, i, probe_encoder]() { encode_probe(first + i, probe_encoder); });
+      }
+#endif
+
+      encode_probe(first, probe_encoders[0].get());
+
+#if ENABLE_MULTITHREADING_SUPPORT
+      tasks.wait();
+#else
+      for (size_t i = 1; i < n; i++) {
+        encode_probe(first + i, probe_encoders[i].get());
+      }
+#endif
+    }
+
+    for (const Error& err : errors) {
+      if (err) {
+        return err;
+      }
+    }
+
+    return results;
+  };
+
+
+  // --- coarse search on a half resolution image, which has about a quarter of the full resolution size
+
+  QualityBracket bracket;
+  std::vector<int> qualities;
+
+  if (converted->get_width() >= kMinHalfResolutionSize && converted->get_height() >= kMinHalfResolutionSize) {
+    std::shared_ptr<HeifPixelImage> half_resolution;
+    Error err = scale_image(*converted, half_resolution,
+                            converted->get_width() / 2, converted->get_height() / 2,
+                            heif_scaling_filter_area, get_max_encoding_threads(),
+                            get_security_limits());
+    if (err) {
+      return err;
+    }
+
+    QualityBracket coarse;
+    while (!coarse.done()) {
+      qualities = coarse.split(num_probes);
+
+      auto probeResult = encode_probes(half_resolution, qualities);
+      if (probeResult.error) {
+        return probeResult.error;
+      }
+
+      for (size_t i = 0; i < qualities.size(); i++) {
+        coarse.add(qualities[i], get_compressed_size(*(*probeResult)[i]) <= target_size / 4);
+      }
+    }
+
+    int estimate = std::max(coarse.best_fit, 0);
+    qualities = {std::max(estimate - kHalfResolutionMargin, 0),
+                 std::min(estimate + kHalfResolutionMargin, 100)};
+  }
+  else {
+    qualities = bracket.split(num_probes);
+  }
+
+
+  // --- full resolution search
+  //     We keep the coded data of the best fitting quality and of quality 0, which is used when nothing fits.
+
+  std::shared_ptr<CompressedImage> best_fit;
+  std::shared_ptr<CompressedImage> lowest_quality;
+
+  for (;;) {
+    auto probeResult = encode_probes(converted, qualities);
+    if (probeResult.error) {
+      return probeResult.error;
+    }
+
+    for (size_t i = 0; i < qualities.size(); i++) {
+      std::shared_ptr<CompressedImage>& compressed = (*probeResult)[i];
+      bool fits = get_compressed_size(*compressed) <= target_size;
+
+      if (fits && qualities[i] > bracket.best_fit) {
+        best_fit = compressed;
+      }
+      else if (qualities[i] == 0) {
+        lowest_quality = compressed;
+      }
+
+      bracket.add(qualities[i], fits);
+    }
 
-  if (different_chroma ||
-      different_colorspace ||
-      converted_output_bpp ||
-      (img->has_alpha() && options.color_conversion_options_ext && options.color_conversion_options_ext->alpha_composition_mode != heif_alpha_composition_mode_none)) {
+    if (bracket.done()) {
+      break;
+    }
 
-    return convert_colorspace(img, target_colorspace, target_chroma, nullptr, converted_output_bpp,
-                                         options.color_conversion_options, options.color_conversion_options_ext,
-                                         get_security_limits());
+    qualities = bracket.split(num_probes);
   }
-  else {
-    return img;
+
+  // When nothing fits, the search only ends after quality 0 has been probed.
+  assert(best_fit || lowest_quality);
+
+  if (out_quality) {
+    *out_quality = best_fit ? bracket.best_fit : 0;
   }
+
+  return add_compressed_image(best_fit ? *best_fit : *lowest_quality, encoder);
 }
 
 
-static Result<std::shared_ptr<HeifPixelImage>>
-create_alpha_image_from_image_alpha_channel(const std::shared_ptr<HeifPixelImage>& image,
-                                            const heif_security_limits* limits)
+Result<std::shared_ptr<HeifPixelImage>> HeifContext::convert_image_for_encoding(const std::shared_ptr<HeifPixelImage>& pixel_image,
+                                                                                struct heif_encoder* encoder,
+                                                                                const struct heif_encoding_options& in_options)
 {
-  // --- generate alpha image
-
-  std::shared_ptr<HeifPixelImage> alpha_image = std::make_shared<HeifPixelImage>();
-  alpha_image->create(image->get_width(), image->get_height(),
-                      heif_colorspace_monochrome, heif_chroma_monochrome);
-
-  if (image->has_channel(heif_channel_Alpha)) {
-    alpha_image->copy_new_plane_from(image, heif_channel_Alpha, heif_channel_Y, limits);
-  }
-  else if (image->get_chroma_format() == heif_chroma_interleaved_RGBA) {
-    if (auto err = alpha_image->extract_alpha_from_RGBA(image, limits)) {
-      return err;
-    }
+  std::shared_ptr<ImageItem> item = ImageItem::alloc_for_compression_format(this, encoder->plugin->compression_format);
+  if (!item->get_encoder()) {
+    return pixel_image;
   }
-  // TODO: 16 bit
 
-  // --- set nclx profile with full-range flag
-
-  auto nclx = std::make_shared<color_profile_nclx>();
-  nclx->set_undefined();
-  nclx->set_full_range_flag(true); // this is the default, but just to be sure in case the defaults change
-  alpha_image->set_color_profile_nclx(nclx);
+  heif_encoding_options options = in_options;
+  if (const auto* nclx = item->get_encoder()->get_forced_output_nclx()) {
+    options.output_nclx_profile = const_cast<heif_color_profile_nclx*>(nclx);
+  }
 
-  return alpha_image;
+  return item->get_encoder()->convert_colorspace_for_encoding(pixel_image, encoder, options, get_security_limits());
 }
 
 
-Result<std::shared_ptr<ImageItem>> HeifContext::encode_image(const std::shared_ptr<HeifPixelImage>& pixel_image,
-                                struct heif_encoder* encoder,
-                                const struct heif_encoding_options& in_options,
-                                enum heif_image_input_class input_class)
+Result<std::shared_ptr<HeifContext::CompressedImage>> HeifContext::compress_image(const std::shared_ptr<HeifPixelImage>& pixel_image,
+                                                                                  struct heif_encoder* encoder,
+                                                                                  const struct heif_encoding_options& in_options,
+                                                                                  enum heif_image_input_class input_class,
+                                                                                  const std::shared_ptr<HeifPixelImage>& color_converted_image)
 {
+  auto compressed = std::make_shared<CompressedImage>();
+
   std::shared_ptr<ImageItem> output_image_item = ImageItem::alloc_for_compression_format(this, encoder->plugin->compression_format);
+  compressed->item = output_image_item;
 
 
 #if 0
@@ -1293,7 +2642,8 @@ Result<std::shared_ptr<ImageItem>> HeifContext::encode_image(const std::shared_p
   // The reason for doing the color conversion here is that the input might be an RGBA image and the color conversion
   // will extract the alpha plane anyway. We can reuse that plane below instead of having to do a new conversion.
 
-  heif_encoding_options options = in_options;
+  heif_encoding_options& options = compressed->options;
+  options = in_options;
 
   std::shared_ptr<HeifPixelImage> colorConvertedImage;
 
@@ -1302,32 +2652,43 @@ Result<std::shared_ptr<ImageItem>> HeifContext::encode_image(const std::shared_p
       options.output_nclx_profile = const_cast<heif_color_profile_nclx*>(nclx);
     }
 
-    Result<std::shared_ptr<HeifPixelImage>> srcImageResult;
-    srcImageResult = output_image_item->get_encoder()->convert_colorspace_for_encoding(pixel_image,
-                                                                                       encoder,
-                                                                                       options,
-                                                                                       get_security_limits());
-    if (srcImageResult.error) {
-      return srcImageResult.error;
+    if (color_converted_image) {
+      colorConvertedImage = color_converted_image;
     }
+    else {
+      Result<std::shared_ptr<HeifPixelImage>> srcImageResult;
+      srcImageResult = output_image_item->get_encoder()->convert_colorspace_for_encoding(pixel_image,
+                                                                                         encoder,
+                                                                                         options,
+                                                                                         get_security_limits());
+      if (srcImageResult.error) {
+        return srcImageResult.error;
+      }
 
-    colorConvertedImage = srcImageResult.value;
+      colorConvertedImage = srcImageResult.value;
+    }
   }
   else {
     colorConvertedImage = pixel_image;
   }
 
-  Error err = output_image_item->encode_to_item(this,
-                                                colorConvertedImage,
-                                                encoder, options, input_class);
-  if (err) {
-    return err;
+  compressed->image = colorConvertedImage;
+
+
+  // --- compress image
+
+  output_image_item->set_size(colorConvertedImage->get_width(), colorConvertedImage->get_height());
+
+  Result<Encoder::CodedImageData> codingResult = output_image_item->encode_to_bitstream_and_boxes(colorConvertedImage, encoder,
+                                                                                                 options, input_class);
+  if (codingResult.error) {
+    return codingResult.error;
   }
 
-  insert_image_item(output_image_item->get_id(), output_image_item);
+  compressed->coded_data = std::move(codingResult.value);
 
 
-  // --- if there is an alpha channel, add it as an additional image
+  // --- if there is an alpha channel, compress it as an additional image
 
   if (options.save_alpha_channel &&
       colorConvertedImage->has_alpha() &&
@@ -1347,18 +2708,50 @@ Result<std::shared_ptr<ImageItem>> HeifContext::encode_image(const std::shared_p
 
     // --- encode the alpha image
 
-    auto alphaEncodingResult = encode_image(alpha_image, encoder, options,
-                         heif_image_input_class_alpha);
-    if (alphaEncodingResult.error) {
-      return alphaEncodingResult.error;
+    auto alphaCompressionResult = compress_image(alpha_image, encoder, options,
+                                                 heif_image_input_class_alpha);
+    if (alphaCompressionResult.error) {
+      return alphaCompressionResult.error;
+    }
+
+    compressed->alpha = std::move(*alphaCompressionResult);
+    compressed->premultiplied_alpha = pixel_image->is_premultiplied_alpha();
+  }
+
+  return compressed;
+}
+
+
+Result<std::shared_ptr<ImageItem>> HeifContext::add_compressed_image(const CompressedImage& compressed,
+                                                                     struct heif_encoder* encoder)
+{
+  const std::shared_ptr<ImageItem>& output_image_item = compressed.item;
+
+  Error err = output_image_item->add_coded_image_to_item(this,
+                                                         compressed.image,
+                                                         compressed.coded_data,
+                                                         encoder, compressed.options);
+  if (err) {
+    return err;
+  }
+
+  insert_image_item(output_image_item->get_id(), output_image_item);
+
+
+  // --- add the alpha image
+
+  if (compressed.alpha) {
+    auto alphaResult = add_compressed_image(*compressed.alpha, encoder);
+    if (alphaResult.error) {
+      return alphaResult.error;
     }
 
-    std::shared_ptr<ImageItem> heif_alpha_image = *alphaEncodingResult;
+    std::shared_ptr<ImageItem> heif_alpha_image = *alphaResult;
 
     m_heif_file->add_iref_reference(heif_alpha_image->get_id(), fourcc("auxl"), {output_image_item->get_id()});
     m_heif_file->set_auxC_property(heif_alpha_image->get_id(), output_image_item->get_auxC_alpha_channel_type());
 
-    if (pixel_image->is_premultiplied_alpha()) {
+    if (compressed.premultiplied_alpha) {
       m_heif_file->add_iref_reference(output_image_item->get_id(), fourcc("prem"), {heif_alpha_image->get_id()});
     }
   }
@@ -1377,6 +2770,34 @@ Result<std::shared_ptr<ImageItem>> HeifContext::encode_image(const std::shared_p
 }
 
 
+Result<std::shared_ptr<ImageItem>> HeifContext::add_precoded_image(heif_compression_format format,
+                                                                   const Encoder::CodedImageData& coded_data)
+{
+  std::shared_ptr<ImageItem> image_item = ImageItem::alloc_for_compression_format(this, format);
+  if (!image_item) {
+    return Error(heif_error_Unsupported_feature, heif_suberror_Unsupported_codec);
+  }
+
+  Error err = image_item->add_coded_data_to_item(this, coded_data);
+  if (err) {
+    return err;
+  }
+
+  insert_image_item(image_item->get_id(), image_item);
+
+  std::vector<std::shared_ptr<Box>> properties;
+  err = m_heif_file->get_properties(image_item->get_id(), properties);
+  if (err) {
+    return err;
+  }
+  image_item->set_properties(properties);
+
+  m_heif_file->set_brand(format, image_item->is_miaf_compatible());
+
+  return image_item;
+}
+
+
 void HeifContext::set_primary_image(const std::shared_ptr<ImageItem>& image)
 {
   // update heif context
@@ -1558,7 +2979,28 @@ Error HeifContext::add_generic_metadata(const std::shared_ptr<ImageItem>& master
 
   // copy the data into the file, store the pointer to it in an iloc box entry
 
-  m_heif_file->append_iloc_data(metadata_id, data_array, 0);
+  return m_heif_file->append_iloc_data(metadata_id, data_array, 0);
+}
+
+
+Error HeifContext::remove_metadata(const std::shared_ptr<ImageItem>& master_image, heif_item_id metadata_id)
+{
+  const auto& metadata = master_image->get_metadata();
+  bool found = std::any_of(metadata.begin(), metadata.end(), [metadata_id](const std::shared_ptr<ImageMetadata>& m) {
+    return m->item_id == metadata_id;
+  });
+
+  if (!found) {
+    return {heif_error_Usage_error,
+            heif_suberror_Nonexisting_item_referenced,
+            "The image has no metadata with this ID"};
+  }
+
+  if (Error err = m_heif_file->remove_item(metadata_id)) {
+    return err;
+  }
+
+  master_image->remove_metadata(metadata_id);
 
   return Error::Ok;
 }
@@ -1670,6 +3112,182 @@ Result<heif_item_id> HeifContext::add_pyramid_group(const std::vector<heif_item_
 }
 
 
+Result<std::shared_ptr<ImageItem>> HeifContext::encode_image_as_grid(const std::shared_ptr<HeifPixelImage>& image,
+                                                                     uint32_t tile_width, uint32_t tile_height,
+                                                                     struct heif_encoder* encoder,
+                                                                     const struct heif_encoding_options& options)
+{
+  if (tile_width == 0 || tile_height == 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Grid tile size may not be zero"};
+  }
+
+  const uint32_t width = image->get_width();
+  const uint32_t height = image->get_height();
+
+  if (width <= tile_width && height <= tile_height) {
+    return encode_image(image, encoder, options, heif_image_input_class_normal);
+  }
+
+  const uint32_t columns = (width + tile_width - 1) / tile_width;
+  const uint32_t rows = (height + tile_height - 1) / tile_height;
+
+  if (rows > 0xFFFF || columns > 0xFFFF) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_image_size,
+                 "Number of tile rows/columns may not exceed 65535"};
+  }
+
+  // Tiles inside the image reference the image without copying. Only the tiles at the right
+  // and bottom border are copied, since they are padded to the full tile size.
+
+  std::vector<std::shared_ptr<HeifPixelImage>> tiles;
+
+  for (uint32_t y = 0; y < rows; y++) {
+    for (uint32_t x = 0; x < columns; x++) {
+      uint32_t x0 = x * tile_width;
+      uint32_t y0 = y * tile_height;
+      uint32_t w = std::min(tile_width, width - x0);
+      uint32_t h = std::min(tile_height, height - y0);
+
+      Result<std::shared_ptr<HeifPixelImage>> tileResult;
+      if (w == tile_width && h == tile_height) {
+        tileResult = image->create_view(x0, y0, w, h);
+      }
+
+      if (!tileResult.value) {
+        tileResult = image->crop(x0, x0 + w - 1, y0, y0 + h - 1, get_security_limits());
+        if (tileResult.error) {
+          return tileResult.error;
+        }
+
+        if (Error err = (*tileResult)->extend_to_size_with_zero(tile_width, tile_height, get_security_limits())) {
+          return err;
+        }
+      }
+
+      tiles.push_back(*tileResult);
+    }
+  }
+
+  // The orientation applies to the whole image, not to each tile.
+  heif_encoding_options tile_options = options;
+  tile_options.image_orientation = heif_orientation_normal;
+
+  auto gridResult = ImageItem_Grid::add_and_encode_full_grid(this, tiles,
+                                                             static_cast<uint16_t>(rows),
+                                                             static_cast<uint16_t>(columns),
+                                                             encoder, tile_options,
+                                                             width, height);
+  if (gridResult.error) {
+    return gridResult.error;
+  }
+
+  m_heif_file->add_orientation_properties((*gridResult)->get_id(), options.image_orientation);
+
+  return std::shared_ptr<ImageItem>(*gridResult);
+}
+
+
+Result<heif_item_id> HeifContext::encode_pyramid(const std::shared_ptr<HeifPixelImage>& image,
+                                                 uint32_t tile_width, uint32_t tile_height,
+                                                 struct heif_encoder* encoder,
+                                                 const struct heif_encoding_options& options,
+                                                 std::shared_ptr<ImageItem>& out_base_image)
+{
+  if (tile_width == 0 || tile_height == 0 || tile_width > 0xFFFF || tile_height > 0xFFFF) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Pyramid tile size must be between 1 and 65535"};
+  }
+
+  // --- layer sizes, from full resolution down to the first layer that fits into a single tile
+  //     The sizes are derived from the full resolution with shifts, such that the binning factors are powers of two.
+
+  const uint32_t base_width = image->get_width();
+  const uint32_t base_height = image->get_height();
+
+  std::vector<std::pair<uint32_t, uint32_t>> layer_sizes;
+  layer_sizes.emplace_back(base_width, base_height);
+
+  for (int shift = 1; shift < 16; shift++) {
+    auto [w, h] = layer_sizes.back();
+    if (w <= tile_width && h <= tile_height) {
+      break;
+    }
+
+    if ((base_width >> shift) == 0 || (base_height >> shift) == 0) {
+      break;
+    }
+
+    layer_sizes.emplace_back(base_width >> shift, base_height >> shift);
+  }
+
+  // --- encode the layers
+  //     While a layer is encoded, the next smaller layer is scaled from it in the thread pool.
+
+  std::vector<heif_item_id> layer_ids;
+  std::shared_ptr<HeifPixelImage> layer = image;
+
+  for (size_t i = 0; i < layer_sizes.size(); i++) {
+    std::shared_ptr<HeifPixelImage> next_layer;
+    Error scaling_error;
+
+    auto scale_next_layer = [&]() {
+      scaling_error = scale_image(*layer, next_layer,
+                                  layer_sizes[i + 1].first, layer_sizes[i + 1].second,
+                                  heif_scaling_filter_area, get_max_encoding_threads(),
+                                  get_security_limits());
+    };
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    TaskGroup scaling;
+#endif
+
+    if (i + 1 < layer_sizes.size()) {
+#if ENABLE_MULTITHREADING_SUPPORT
+      if (get_max_encoding_threads() > 0) {
+        scaling.run(scale_next_layer);
+      }
+      else
+#endif
+      {
+        scale_next_layer();
+      }
+    }
+
+    auto encodingResult = encode_image_as_grid(layer, tile_width, tile_height, encoder, options);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    scaling.wait();
+#endif
+
+    if (encodingResult.error) {
+      return encodingResult.error;
+    }
+
+    if (scaling_error) {
+      return scaling_error;
+    }
+
+    std::shared_ptr<ImageItem> layer_item = *encodingResult;
+
+    if (i == 0) {
+      out_base_image = layer_item;
+    }
+    else {
+      m_heif_file->get_infe_box(layer_item->get_id())->set_hidden_item(true);
+    }
+
+    layer_ids.push_back(layer_item->get_id());
+    layer = std::move(next_layer);
+  }
+
+  return add_pyramid_group(layer_ids);
+}
+
+
 Error HeifContext::interpret_heif_file_sequences()
 {
   m_tracks.clear();
@@ -1695,12 +3313,73 @@ Error HeifContext::interpret_heif_file_sequences()
     }
   }
 
+  // The 'moov' box of a fragmented file usually has no duration. It is computed from the samples in the fragments.
+
+  if (mvhd && mvhd->get_duration() == 0 && !m_heif_file->get_movie_fragments().empty()) {
+    uint64_t max_sequence_duration = 0;
+    for (const auto& track : m_tracks) {
+      uint64_t duration = rescale(track.second->get_duration_in_media_units(), track.second->get_timescale(),
+                                  mvhd->get_time_scale());
+      max_sequence_duration = std::max(max_sequence_duration, duration);
+    }
+
+    mvhd->set_duration(max_sequence_duration);
+  }
+
   return Error::Ok;
 }
 
 
-std::vector<uint32_t> HeifContext::get_track_IDs() const
+Error HeifContext::load_deferred_tracks()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_deferred_tracks_mutex);
+#endif
+
+  if (m_has_deferred_tracks) {
+    m_has_deferred_tracks = false;
+
+    m_deferred_tracks_error = m_heif_file->load_deferred_moov_box();
+    if (!m_deferred_tracks_error) {
+      m_deferred_tracks_error = interpret_heif_file_sequences();
+    }
+
+    if (m_deferred_tracks_error) {
+      m_tracks.clear();
+      m_visual_track_id = 0;
+    }
+  }
+
+  return m_deferred_tracks_error;
+}
+
+
+bool HeifContext::has_sequence() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_deferred_tracks_mutex);
+#endif
+
+  return m_has_deferred_tracks || m_deferred_tracks_error || !m_tracks.empty();
+}
+
+
+Result<int> HeifContext::get_number_of_tracks()
 {
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
+  return static_cast<int>(m_tracks.size());
+}
+
+
+Result<std::vector<uint32_t>> HeifContext::get_track_IDs()
+{
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
   std::vector<uint32_t> ids;
 
   for (const auto& track : m_tracks) {
@@ -1715,6 +3394,16 @@ Result<std::shared_ptr<Track>> HeifContext::get_track(uint32_t track_id)
 {
   assert(has_sequence());
 
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
+  if (m_tracks.empty()) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Unspecified,
+                 "Image sequence has no tracks"};
+  }
+
   if (track_id != 0) {
     auto iter = m_tracks.find(track_id);
     if (iter == m_tracks.end()) {
@@ -1734,8 +3423,12 @@ Result<std::shared_ptr<Track>> HeifContext::get_track(uint32_t track_id)
 }
 
 
-uint32_t HeifContext::get_sequence_timescale() const
+Result<uint32_t> HeifContext::get_sequence_timescale()
 {
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
   auto mvhd = m_heif_file->get_mvhd_box();
   if (!mvhd) {
     return 0;
@@ -1745,8 +3438,12 @@ uint32_t HeifContext::get_sequence_timescale() const
 }
 
 
-void HeifContext::set_sequence_timescale(uint32_t timescale)
+Error HeifContext::set_sequence_timescale(uint32_t timescale)
 {
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
   get_heif_file()->init_for_sequence();
 
   auto mvhd = m_heif_file->get_mvhd_box();
@@ -1761,11 +3458,17 @@ void HeifContext::set_sequence_timescale(uint32_t timescale)
   */
 
   mvhd->set_time_scale(timescale);
+
+  return Error::Ok;
 }
 
 
-uint64_t HeifContext::get_sequence_duration() const
+Result<uint64_t> HeifContext::get_sequence_duration()
 {
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
   auto mvhd = m_heif_file->get_mvhd_box();
   if (!mvhd) {
     return 0;
@@ -1775,10 +3478,48 @@ uint64_t HeifContext::get_sequence_duration() const
 }
 
 
+Error HeifContext::start_fragmented_writing(OutputWriteFunction write, uint32_t samples_per_fragment)
+{
+  if (!m_tracks.empty()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Fragmented writing has to be started before tracks are added"};
+  }
+
+  if (Error err = m_heif_file->start_fragmented_writing(std::move(write))) {
+    return err;
+  }
+
+  m_samples_per_fragment = samples_per_fragment;
+
+  return Error::Ok;
+}
+
+
+Error HeifContext::check_tracks_can_be_added() const
+{
+  if (m_heif_file->is_fragmented_file_start_written()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Tracks cannot be added after the first fragment has been written"};
+  }
+
+  return Error::Ok;
+}
+
+
 Result<std::shared_ptr<Track_Visual>> HeifContext::add_visual_sequence_track(heif_track_info* info,
                                                                              uint32_t handler_type,
                                                                              uint16_t width, uint16_t height)
 {
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
+  if (Error err = check_tracks_can_be_added()) {
+    return err;
+  }
+
   m_heif_file->init_for_sequence();
 
   std::shared_ptr<Track_Visual> trak = std::make_shared<Track_Visual>(this, 0, width, height, info, handler_type);
@@ -1791,6 +3532,14 @@ Result<std::shared_ptr<Track_Visual>> HeifContext::add_visual_sequence_track(hei
 Result<std::shared_ptr<class Track_Metadata>> HeifContext::add_uri_metadata_sequence_track(heif_track_info* info,
                                                                                            std::string uri)
 {
+  if (Error err = load_deferred_tracks()) {
+    return err;
+  }
+
+  if (Error err = check_tracks_can_be_added()) {
+    return err;
+  }
+
   m_heif_file->init_for_sequence();
 
   std::shared_ptr<Track_Metadata> trak = std::make_shared<Track_Metadata>(this, 0, uri, info);
@@ -21,12 +21,19 @@
 #ifndef LIBHEIF_CONTEXT_H
 #define LIBHEIF_CONTEXT_H
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
+#include <span>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
 
 #include "error.h"
 
@@ -34,10 +41,17 @@
 #include "libheif/heif_experimental.h"
 #include "libheif/heif_plugin.h"
 #include "bitstream.h"
+#include "mdat_data.h"
 
 #include "box.h" // only for color_profile, TODO: maybe move the color_profiles to its own header
 
 #include "region.h"
+#include "codecs/encoder.h"
+#include "codecs/decoder_instance_pool.h"
+#include "memory_budget.h"
+#include "decoded_tile_cache.h"
+#include "decompressed_metadata_cache.h"
+#include "decoding_statistics.h"
 
 class HeifFile;
 
@@ -64,6 +78,53 @@ public:
 
   int get_max_decoding_threads() const { return m_max_decoding_threads; }
 
+  // The NUMA node on which the decoding tasks are executed (-1: node of the decoding thread).
+  void set_numa_node(int numa_node) { m_numa_node = numa_node; }
+
+  // Unused decoder plugin instances that are kept for decoding further images.
+  const std::shared_ptr<DecoderInstancePool>& get_decoder_instance_pool() const { return m_decoder_instance_pool; }
+
+  // Memory reserved by parallel tile decoding, limited by heif_security_limits::max_total_memory.
+  DecodingMemoryBudget& get_decoding_memory_budget() const { return m_decoding_memory_budget; }
+
+  // Tiles decoded by decode_image() with decode_only_tile=true. Disabled by default.
+  DecodedTileCache& get_decoded_tile_cache() const { return m_decoded_tile_cache; }
+
+  // Images that are referenced by several derived images ('iden', 'iovl'). Keeps them for decoding the next
+  // derived image. Enabled with a small size by default.
+  DecodedTileCache& get_derived_image_source_cache() const { return m_derived_image_source_cache; }
+
+  // Compressed metadata items that have been decompressed by get_decompressed_metadata().
+  DecompressedMetadataCache& get_decompressed_metadata_cache() const { return m_decompressed_metadata_cache; }
+
+  // Decodes an image that a derived image ('iden', 'iovl') is computed from. When other derived images reference the
+  // same image, it is decoded only once and then copied from the source cache. The returned image may be modified.
+  Result<std::shared_ptr<HeifPixelImage>> decode_derived_image_source(const ImageItem& source,
+                                                                      const struct heif_decoding_options& options) const;
+
+  void set_max_encoding_threads(int max_threads) { m_max_encoding_threads = max_threads; }
+
+  int get_max_encoding_threads() const { return m_max_encoding_threads; }
+
+  void set_encoding_thread_budget(int num_threads) { m_encoding_thread_budget = num_threads; }
+
+  // Total number of threads of encoders running in parallel. 0 = number of hardware threads, negative = not limited.
+  int get_encoding_thread_budget() const { return m_encoding_thread_budget; }
+
+  // Only has an effect on files that are read afterwards.
+  void set_lazy_box_parsing(bool flag) { m_lazy_box_parsing = flag; }
+
+  // Only has an effect on files that are read afterwards.
+  void set_initial_read_size(uint32_t size) { m_initial_read_size = size; }
+
+  // Only has an effect on files that are read afterwards.
+  void set_prefetch_primary_image(bool flag) { m_prefetch_primary_image = flag; }
+
+  // Only has an effect on files that are read afterwards.
+  void set_item_data_cache_size(size_t size) { m_item_data_cache_size = size; }
+
+  void set_max_read_gap(uint64_t max_gap) { m_max_read_gap = max_gap; }
+
   void set_security_limits(const heif_security_limits* limits);
 
   [[nodiscard]] heif_security_limits* get_security_limits() { return &m_limits; }
@@ -76,6 +137,10 @@ public:
 
   Error read_from_memory(const void* data, size_t size, bool copy);
 
+  // Reads the file structure from a header index written by HeifFile::write_header_index().
+  // Only the image data is read from 'reader'.
+  Error read_with_header_index(const std::shared_ptr<StreamReader>& reader, const uint8_t* index, size_t index_size);
+
   std::shared_ptr<HeifFile> get_heif_file() const { return m_heif_file; }
 
 
@@ -106,6 +171,71 @@ public:
                                                        const struct heif_decoding_options& options,
                                                        bool decode_only_tile, uint32_t tx, uint32_t ty) const;
 
+  // Decodes the image into the planes of 'target', which defines the output format.
+  // The image is decoded into 'target' directly if possible. Otherwise, the decoded image is copied into it.
+  Error decode_image_into(heif_item_id ID,
+                          const struct heif_decoding_options& options,
+                          const std::shared_ptr<HeifPixelImage>& target) const;
+
+  // Requests the data of the image (and of its grid tiles or overlay layers) asynchronously from the StreamReader and
+  // calls 'on_available' when it has been loaded. Returns false if the StreamReader does not support asynchronous
+  // requests. 'on_available' is not called in that case.
+  bool request_image_data_async(heif_item_id id, std::function<void()> on_available) const;
+
+  // Returns the item data like HeifFile::get_item_data(), in memory that stays valid until the context is destroyed.
+  // The data is not copied if it is held in memory in one range and does not have to be decompressed.
+  // Otherwise, a copy is made once and kept by the context.
+  Result<std::span<const uint8_t>> get_borrowed_item_data(heif_item_id id, heif_metadata_compression* out_compression);
+
+  // Compressed metadata is decompressed when it is first accessed, not when the file is loaded.
+  // The decompressed data is kept in the decompressed metadata cache for the next access.
+  Result<std::shared_ptr<const std::vector<uint8_t>>> get_decompressed_metadata(heif_item_id id) const;
+
+  // Size of the decompressed metadata. It is taken from the compressed stream header if it stores the size.
+  // Otherwise, the data is decompressed (and cached for the following get_decompressed_metadata()).
+  Result<size_t> get_decompressed_metadata_size(heif_item_id id) const;
+
+  // Reads a file from memory without copying it and decodes its primary image. Used for batch decoding.
+  static Result<std::shared_ptr<HeifPixelImage>> decode_primary_image_from_memory(const void* data, size_t size,
+                                                                                  heif_colorspace out_colorspace,
+                                                                                  heif_chroma out_chroma,
+                                                                                  const struct heif_decoding_options& options);
+
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_region(heif_item_id ID,
+                                                              heif_colorspace out_colorspace,
+                                                              heif_chroma out_chroma,
+                                                              const struct heif_decoding_options& options,
+                                                              uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const;
+
+  // Decodes the image scaled to fit into max_width x max_height (keeping the aspect ratio, without upscaling).
+  // The smallest image that has at least the output size is decoded. This can be a thumbnail or a layer of
+  // a 'pymd' pyramid group that contains the image.
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_at_size(heif_item_id ID,
+                                                               heif_colorspace out_colorspace,
+                                                               heif_chroma out_chroma,
+                                                               const struct heif_decoding_options& options,
+                                                               uint32_t max_width, uint32_t max_height) const;
+
+  // Returns the layers of the 'pymd' pyramid group that contains the image, sorted from the smallest to the largest.
+  // The list is empty if the image is not part of a pyramid.
+  std::vector<std::shared_ptr<ImageItem>> get_pyramid_layers(heif_item_id ID) const;
+
+  // Decodes the region (x0,y0,w,h) of the image, scaled to out_width x out_height.
+  // The region is decoded from the smallest layer of the pyramid group that contains the image that still has at least
+  // the output resolution. Only the tiles of that layer which overlap with the region are decoded.
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_region_at_scale(heif_item_id ID,
+                                                                       heif_colorspace out_colorspace,
+                                                                       heif_chroma out_chroma,
+                                                                       const struct heif_decoding_options& options,
+                                                                       uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                                                                       uint32_t out_width, uint32_t out_height) const;
+
+  // Decodes the coded image into GPU surfaces, one per tile.
+  Error decode_image_to_gpu_surfaces(heif_item_id ID,
+                                     heif_gpu_surface_type type,
+                                     const struct heif_decoding_options& options,
+                                     class GpuSurfaceList& out_surfaces) const;
+
   Result<std::shared_ptr<HeifPixelImage>> convert_to_output_colorspace(std::shared_ptr<HeifPixelImage> img,
                                                                        heif_colorspace out_colorspace,
                                                                        heif_chroma out_chroma,
@@ -118,7 +248,12 @@ public:
 
   // === writing ===
 
-  void write(StreamWriter& writer);
+  Error write(StreamWriter& writer);
+
+  // Passes the file in several parts to 'output'. See HeifFile::write().
+  Error write(const OutputWriteFunction& output, const OutputSeekFunction& seek);
+
+  void set_image_data_order(heif_image_data_order order) { m_image_data_order = order; }
 
   // Create all boxes necessary for an empty HEIF file.
   // Note that this is no valid HEIF file, since some boxes (e.g. pitm) are generated, but
@@ -130,6 +265,60 @@ public:
                                                   const struct heif_encoding_options& options,
                                                   enum heif_image_input_class input_class);
 
+  // Encodes the image as a 'grid' of tiles with the given size when it does not fit into a single tile, otherwise as
+  // a single image. The tiles reference the image without copying, except at the right and bottom border, and are
+  // encoded in parallel. The orientation given in 'options' is assigned to the grid instead of the tiles.
+  Result<std::shared_ptr<ImageItem>> encode_image_as_grid(const std::shared_ptr<HeifPixelImage>& image,
+                                                          uint32_t tile_width, uint32_t tile_height,
+                                                          struct heif_encoder* encoder,
+                                                          const struct heif_encoding_options& options);
+
+  // Searches for the highest quality at which the coded image (including its alpha channel) is not larger than
+  // 'target_size' bytes. The color conversion is done only once. The search is started on a half resolution copy
+  // of the image and the probes at each step are encoded in parallel with copies of 'encoder'. The settings of
+  // 'encoder' itself are not changed. If even quality 0 exceeds the target size, the image is coded with quality 0.
+  Result<std::shared_ptr<ImageItem>> encode_image_with_target_size(const std::shared_ptr<HeifPixelImage>& image,
+                                                                   struct heif_encoder* encoder,
+                                                                   const struct heif_encoding_options& options,
+                                                                   size_t target_size,
+                                                                   int* out_quality);
+
+  // encode_image() is split into two stages:
+  // compress_image() does the color conversion and compression (also of the alpha channel) without modifying the file.
+  // It can be called from several threads in parallel when each thread uses its own encoder instance.
+  // add_compressed_image() then adds the image items to the file. Items are created in the order of these calls.
+
+  struct CompressedImage
+  {
+    std::shared_ptr<ImageItem> item;
+    std::shared_ptr<HeifPixelImage> image; // color converted input image
+    heif_encoding_options options;
+    Encoder::CodedImageData coded_data;
+    bool premultiplied_alpha = false;
+
+    std::shared_ptr<CompressedImage> alpha;
+  };
+
+  // The color conversion that compress_image() applies before encoding. It only reads the settings of the encoder,
+  // thus it can run in parallel to the encoding of another image with the same encoder.
+  Result<std::shared_ptr<HeifPixelImage>> convert_image_for_encoding(const std::shared_ptr<HeifPixelImage>& image,
+                                                                     struct heif_encoder* encoder,
+                                                                     const struct heif_encoding_options& options);
+
+  // 'color_converted_image' may pass the result of convert_image_for_encoding() for 'image'.
+  Result<std::shared_ptr<CompressedImage>> compress_image(const std::shared_ptr<HeifPixelImage>& image,
+                                                          struct heif_encoder* encoder,
+                                                          const struct heif_encoding_options& options,
+                                                          enum heif_image_input_class input_class,
+                                                          const std::shared_ptr<HeifPixelImage>& color_converted_image = nullptr);
+
+  Result<std::shared_ptr<ImageItem>> add_compressed_image(const CompressedImage& compressed,
+                                                          struct heif_encoder* encoder);
+
+  // Adds an image item for data that has been coded outside of libheif.
+  Result<std::shared_ptr<ImageItem>> add_precoded_image(heif_compression_format format,
+                                                        const Encoder::CodedImageData& coded_data);
+
   void set_primary_image(const std::shared_ptr<ImageItem>& image);
 
   bool is_primary_image_set() const { return m_primary_image != nullptr; }
@@ -150,10 +339,22 @@ public:
                              uint32_t item_type, const char* content_type, const char* item_uri_type,
                              heif_metadata_compression compression, heif_item_id* out_item_id);
 
+  Error remove_metadata(const std::shared_ptr<ImageItem>& master_image, heif_item_id metadata_id);
+
   heif_property_id add_property(heif_item_id targetItem, std::shared_ptr<Box> property, bool essential);
 
   Result<heif_item_id> add_pyramid_group(const std::vector<heif_item_id>& layers);
 
+  // Encodes 'image' and its downscaled versions as the layers of a 'pymd' pyramid group. Each layer has half the size
+  // of the previous one, down to the first layer that fits into a single tile. Layers larger than one tile are
+  // encoded as grid images with the given tile size. The smaller layers are hidden.
+  // Returns the ID of the pyramid group and the full resolution layer in 'out_base_image'.
+  Result<heif_item_id> encode_pyramid(const std::shared_ptr<HeifPixelImage>& image,
+                                      uint32_t tile_width, uint32_t tile_height,
+                                      struct heif_encoder* encoder,
+                                      const struct heif_encoding_options& options,
+                                      std::shared_ptr<ImageItem>& out_base_image);
+
   // --- region items
 
   void add_region_item(std::shared_ptr<RegionItem> region_item)
@@ -178,26 +379,33 @@ public:
 
   // === sequences ==
 
-  bool has_sequence() const { return !m_tracks.empty(); }
+  // Also true when the deferred 'moov' box could not be parsed. The track functions then return that error.
+  bool has_sequence() const;
 
-  int get_number_of_tracks() const { return static_cast<int>(m_tracks.size()); }
+  Result<int> get_number_of_tracks();
 
-  std::vector<uint32_t> get_track_IDs() const;
+  Result<std::vector<uint32_t>> get_track_IDs();
 
   // If 0 is passed as track_id, the main visual track is returned (we assume that there is only one visual track).
   Result<std::shared_ptr<Track>> get_track(uint32_t track_id);
 
-  uint32_t get_sequence_timescale() const;
+  Result<uint32_t> get_sequence_timescale();
 
-  uint64_t get_sequence_duration() const;
+  Result<uint64_t> get_sequence_duration();
 
-  void set_sequence_timescale(uint32_t timescale);
+  Error set_sequence_timescale(uint32_t timescale);
 
   Result<std::shared_ptr<class Track_Visual>> add_visual_sequence_track(struct heif_track_info*, uint32_t handler_type,
                                                                         uint16_t width, uint16_t height);
 
   Result<std::shared_ptr<class Track_Metadata>> add_uri_metadata_sequence_track(struct heif_track_info*, std::string uri);
 
+  // Writes the samples in movie fragments of at least 'samples_per_fragment' samples (see HeifFile::start_fragmented_writing()).
+  // Has to be called before any track is added.
+  Error start_fragmented_writing(OutputWriteFunction write, uint32_t samples_per_fragment);
+
+  uint32_t get_samples_per_fragment() const { return m_samples_per_fragment; }
+
 private:
   std::map<heif_item_id, std::shared_ptr<ImageItem>> m_all_images;
 
@@ -211,6 +419,57 @@ private:
 
   int m_max_decoding_threads = 4;
 
+  int m_numa_node = -1;
+
+  std::shared_ptr<DecoderInstancePool> m_decoder_instance_pool = std::make_shared<DecoderInstancePool>();
+
+  mutable DecodingMemoryBudget m_decoding_memory_budget;
+
+  mutable DecodedTileCache m_decoded_tile_cache;
+
+  mutable DecodedTileCache m_derived_image_source_cache;
+
+  mutable DecompressedMetadataCache m_decompressed_metadata_cache;
+
+  // Decoding times of the images decoded so far, for choosing a cheaper representation when there is a deadline.
+  mutable DecodingTimeEstimator m_decoding_time_estimator;
+
+  struct DeadlineFallback
+  {
+    std::shared_ptr<ImageItem> item;
+    uint8_t scale_denominator = 1;
+    heif_decoding_fallback type = heif_decoding_fallback_none;
+  };
+
+  // Chooses what to decode instead of 'imgitem' when its estimated decoding time exceeds options.deadline_us.
+  DeadlineFallback select_deadline_fallback(const std::shared_ptr<ImageItem>& imgitem,
+                                            const heif_decoding_options& options) const;
+
+  // Number of references from derived images ('iden', 'iovl') to each image.
+  std::unordered_map<heif_item_id, uint32_t> m_num_derived_image_references;
+
+  heif_image_data_order m_image_data_order = heif_image_data_order_as_added;
+
+  // Copies of the item data returned by get_borrowed_item_data(), indexed by item ID and whether the data is decompressed.
+  struct BorrowedItemData
+  {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    heif_metadata_compression compression = heif_metadata_compression_off;
+  };
+
+  std::map<std::pair<heif_item_id, bool>, BorrowedItemData> m_borrowed_item_data;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::mutex m_borrowed_item_data_mutex;
+#endif
+
+  // The items in the order in which their data is written for heif_image_data_order_progressive(_z_order).
+  std::vector<heif_item_id> get_progressive_item_order() const;
+
+  int m_max_encoding_threads = 0;
+
+  int m_encoding_thread_budget = 0;
+
   heif_security_limits m_limits;
 
   std::vector<std::shared_ptr<RegionItem>> m_region_items;
@@ -219,6 +478,35 @@ private:
 
   std::map<uint32_t, std::shared_ptr<Track>> m_tracks;
   uint32_t m_visual_track_id = 0;
+  uint32_t m_samples_per_fragment = 0;
+
+  Error check_tracks_can_be_added() const;
+
+  bool m_lazy_box_parsing = false;
+
+  // The deferred tracks are loaded by the first track access, which may come from several threads.
+  // A failed load is not repeated. Its error is returned by all following track accesses.
+  bool m_has_deferred_tracks = false;
+  Error m_deferred_tracks_error;
+#if ENABLE_MULTITHREADING_SUPPORT
+  mutable std::mutex m_deferred_tracks_mutex;
+#endif
+
+  uint32_t m_initial_read_size = 0; // 0: FileLayout default
+  bool m_prefetch_primary_image = false;
+  size_t m_item_data_cache_size = 0;
+  uint64_t m_max_read_gap = 64 * 1024;
+
+  void init_heif_file_for_reading();
+
+  // Announces the data of the primary image (and of its grid tiles or overlay layers) to the StreamReader.
+  void prefetch_primary_image_data() const;
+
+  // Parses the 'moov' box and creates the tracks if this was deferred when reading the file.
+  Error load_deferred_tracks();
+
+  // Finalizes the tracks and serializes the remaining items before the file is written.
+  Error prepare_for_writing();
 
   Error interpret_heif_file();
 
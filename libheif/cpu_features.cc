@@ -0,0 +1,145 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cpu_features.h"
+#include <cstdlib>
+#include <cstring>
+
+#if HEIF_HAVE_X86_SIMD && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+
+#if HEIF_HAVE_X86_SIMD && defined(_MSC_VER)
+
+static bool msvc_cpu_supports(int leaf, int reg, int bit)
+{
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < leaf) {
+    return false;
+  }
+
+  __cpuidex(info, leaf, 0);
+  return (info[reg] & (1 << bit)) != 0;
+}
+
+#endif
+
+
+enum class SimdLimit
+{
+  scalar,
+  sse41,
+  none
+};
+
+
+// LIBHEIF_SIMD restricts the SIMD code paths that may be used. This is mainly for testing the
+// scalar (or SSE4.1) kernels on CPUs that support more.
+static SimdLimit get_simd_limit()
+{
+  static const SimdLimit limit = []() {
+    const char* env = getenv("LIBHEIF_SIMD");
+    if (env == nullptr) {
+      return SimdLimit::none;
+    }
+
+    if (strcmp(env, "scalar") == 0 || strcmp(env, "off") == 0 || strcmp(env, "OFF") == 0) {
+      return SimdLimit::scalar;
+    }
+    else if (strcmp(env, "sse4.1") == 0) {
+      return SimdLimit::sse41;
+    }
+    else {
+      return SimdLimit::none;
+    }
+  }();
+
+  return limit;
+}
+
+
+bool cpu_supports_sse41()
+{
+  if (get_simd_limit() == SimdLimit::scalar) {
+    return false;
+  }
+
+#if HEIF_HAVE_X86_SIMD && defined(_MSC_VER)
+  static const bool supported = msvc_cpu_supports(1, 2, 19);
+  return supported;
+#elif HEIF_HAVE_X86_SIMD
+  static const bool supported = __builtin_cpu_supports("sse4.1");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+
+bool cpu_supports_avx2()
+{
+  if (get_simd_limit() != SimdLimit::none) {
+    return false;
+  }
+
+#if HEIF_HAVE_X86_SIMD && defined(_MSC_VER)
+  // AVX2 also requires that the OS saves the YMM registers (OSXSAVE + XCR0).
+  static const bool supported = (msvc_cpu_supports(1, 2, 27) &&
+                                 (_xgetbv(0) & 0x6) == 0x6 &&
+                                 msvc_cpu_supports(7, 1, 5));
+  return supported;
+#elif HEIF_HAVE_X86_SIMD
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+
+bool cpu_supports_neon()
+{
+  if (get_simd_limit() == SimdLimit::scalar) {
+    return false;
+  }
+
+  // When the compiler targets NEON, all CPUs running this code support it.
+  return HEIF_HAVE_NEON;
+}
+
+
+const char* cpu_simd_level()
+{
+  if (cpu_supports_avx2()) {
+    return "avx2";
+  }
+  else if (cpu_supports_sse41()) {
+    return "sse4.1";
+  }
+  else if (cpu_supports_neon()) {
+    return "neon";
+  }
+  else {
+    return "scalar";
+  }
+}
@@ -0,0 +1,81 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_CPU_FEATURES_H
+#define LIBHEIF_CPU_FEATURES_H
+
+// --- Which SIMD code paths can be compiled on this platform.
+//
+// The x86 kernels are compiled with per-function target attributes, so that the rest of the
+// library can still be built for the baseline architecture. Which kernel is used is decided
+// at runtime with cpu_supports_*().
+//
+// Emscripten builds with '-msimd128 -mfpu=neon' define __ARM_NEON and use the NEON kernels,
+// which are translated to WebAssembly SIMD.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HEIF_HAVE_X86_SIMD 1
+#else
+#define HEIF_HAVE_X86_SIMD 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+#define HEIF_HAVE_NEON 1
+#else
+#define HEIF_HAVE_NEON 0
+#endif
+
+#if HEIF_HAVE_X86_SIMD && (defined(__GNUC__) || defined(__clang__))
+#define HEIF_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define HEIF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HEIF_TARGET_SSE41
+#define HEIF_TARGET_AVX2
+#endif
+
+
+// --- Row kernels
+//
+// The SIMD code of the color conversions (color-conversion/*_simd.h) consists of row kernels. A row kernel
+// processes the first part of a row in blocks and returns how much of the row it has processed, counted in
+// the unit given in its header (samples, pixels or bytes). The rest of the row has to be processed by the
+// scalar code.
+//
+// The kernels of a conversion are collected in a table, which is returned by its get_*_row_kernels() function.
+// Each entry is the fastest kernel supported by the CPU, or NULL if there is none. The table is set up at the
+// first call. Conversions with a single kernel return it with get_*_row_kernel() instead.
+
+
+// All kernel tables select their implementation with these functions.
+// The environment variable LIBHEIF_SIMD can restrict the code paths that are used:
+//   "scalar" (or "off"): no SIMD at all,
+//   "sse4.1": no AVX2.
+// It is read once, on the first call.
+
+bool cpu_supports_sse41();
+
+bool cpu_supports_avx2();
+
+bool cpu_supports_neon();
+
+// Name of the best code path that the kernels use: "avx2", "sse4.1", "neon" or "scalar".
+const char* cpu_simd_level();
+
+#endif //LIBHEIF_CPU_FEATURES_H
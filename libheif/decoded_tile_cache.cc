@@ -0,0 +1,163 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoded_tile_cache.h"
+#include "pixelimage.h"
+
+
+extern heif_color_conversion_options_ext normalize_options(const heif_color_conversion_options_ext* input_options);
+
+
+DecodedTileCache::Key::Key(heif_item_id id, uint32_t tile_x, uint32_t tile_y,
+                           heif_colorspace colorspace, heif_chroma chroma,
+                           const heif_decoding_options& options)
+    : m_id(id), m_tile_x(tile_x), m_tile_y(tile_y),
+      m_colorspace(colorspace), m_chroma(chroma),
+      m_ignore_transformations(options.ignore_transformations),
+      m_convert_hdr_to_8bit(options.convert_hdr_to_8bit),
+      m_strict_decoding(options.strict_decoding),
+      m_decoder_id(options.decoder_id ? options.decoder_id : ""),
+      m_color_conversion_options(options.color_conversion_options),
+      m_color_conversion_options_ext(normalize_options(options.color_conversion_options_ext)),
+      m_target_scale_denominator(options.target_scale_denominator),
+      m_max_coded_data_size(options.max_coded_data_size),
+      m_max_quality_layers(options.max_quality_layers)
+{
+}
+
+
+bool DecodedTileCache::Key::operator<(const Key& other) const
+{
+  return tie() < other.tie();
+}
+
+
+static size_t get_image_memory_size(const HeifPixelImage& image)
+{
+  size_t size = 0;
+
+  for (heif_channel channel : image.get_channel_set()) {
+    size_t stride;
+    image.get_plane(channel, &stride);
+    size += stride * image.get_height(channel);
+  }
+
+  return size;
+}
+
+
+void DecodedTileCache::set_max_bytes(size_t max_bytes)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  m_max_bytes = max_bytes;
+  evict(max_bytes);
+}
+
+
+size_t DecodedTileCache::get_max_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_max_bytes;
+}
+
+
+size_t DecodedTileCache::get_cached_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_cached_bytes;
+}
+
+
+std::shared_ptr<const HeifPixelImage> DecodedTileCache::get(const Key& key)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  auto iter = m_index.find(key);
+  if (iter == m_index.end()) {
+    return nullptr;
+  }
+
+  // move to the front of the LRU list
+  m_entries.splice(m_entries.begin(), m_entries, iter->second);
+
+  return iter->second->image;
+}
+
+
+void DecodedTileCache::put(const Key& key, const std::shared_ptr<const HeifPixelImage>& image)
+{
+  size_t size = get_image_memory_size(*image);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  if (size > m_max_bytes) {
+    return;
+  }
+
+  // Another thread may have decoded the same tile in the meantime.
+  auto iter = m_index.find(key);
+  if (iter != m_index.end()) {
+    m_cached_bytes -= iter->second->size;
+    m_entries.erase(iter->second);
+    m_index.erase(iter);
+  }
+
+  evict(m_max_bytes - size);
+
+  m_entries.push_front({key, image, size});
+  m_index.emplace(key, m_entries.begin());
+  m_cached_bytes += size;
+}
+
+
+void DecodedTileCache::clear()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  evict(0);
+}
+
+
+void DecodedTileCache::evict(size_t max_bytes)
+{
+  // m_mutex must be locked
+
+  while (m_cached_bytes > max_bytes) {
+    const Entry& entry = m_entries.back();
+    m_cached_bytes -= entry.size;
+    m_index.erase(entry.key);
+    m_entries.pop_back();
+  }
+}
@@ -0,0 +1,134 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_DECODED_TILE_CACHE_H
+#define LIBHEIF_DECODED_TILE_CACHE_H
+
+#include "libheif/heif.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+class HeifPixelImage;
+
+
+// Least-recently-used cache of the tiles decoded (and color converted) by heif_image_handle_decode_image_tile().
+// Each HeifContext has its own cache. It is disabled (max. size 0) by default.
+//
+// The cached images must not be modified. Callers hand out copies of them.
+class DecodedTileCache
+{
+public:
+  struct Key
+  {
+    Key(heif_item_id id, uint32_t tile_x, uint32_t tile_y,
+        heif_colorspace colorspace, heif_chroma chroma,
+        const heif_decoding_options& options);
+
+    bool operator<(const Key& other) const;
+
+  private:
+    heif_item_id m_id;
+    uint32_t m_tile_x, m_tile_y;
+    heif_colorspace m_colorspace;
+    heif_chroma m_chroma;
+
+    // --- the decoding options that change the decoded pixels
+
+    uint8_t m_ignore_transformations;
+    uint8_t m_convert_hdr_to_8bit;
+    uint8_t m_strict_decoding;
+    std::string m_decoder_id;
+    heif_color_conversion_options m_color_conversion_options;
+    heif_color_conversion_options_ext m_color_conversion_options_ext;
+    uint8_t m_target_scale_denominator;
+    uint64_t m_max_coded_data_size;
+    int m_max_quality_layers;
+
+    // The output ICC profile is compared by its address, assuming that the profile data does not change.
+    auto tie() const
+    {
+      const heif_color_conversion_options& c = m_color_conversion_options;
+      const heif_color_conversion_options_ext& e = m_color_conversion_options_ext;
+
+      return std::tie(m_id, m_tile_x, m_tile_y, m_colorspace, m_chroma,
+                      m_ignore_transformations, m_convert_hdr_to_8bit, m_strict_decoding, m_decoder_id,
+                      c.preferred_chroma_downsampling_algorithm, c.preferred_chroma_upsampling_algorithm,
+                      c.only_use_preferred_chroma_algorithm,
+                      e.alpha_composition_mode, e.background_red, e.background_green, e.background_blue,
+                      e.secondary_background_red, e.secondary_background_green, e.secondary_background_blue,
+                      e.checkerboard_square_size, e.alpha_premultiplication_mode, e.bit_depth_reduction_method,
+                      e.output_icc_profile, e.output_icc_profile_size, e.rendering_intent, e.demosaic_method,
+                      m_target_scale_denominator, m_max_coded_data_size, m_max_quality_layers);
+    }
+  };
+
+  DecodedTileCache() = default;
+
+  DecodedTileCache(const DecodedTileCache&) = delete;
+
+  DecodedTileCache& operator=(const DecodedTileCache&) = delete;
+
+  // Maximum number of bytes of the cached images. Setting this to 0 disables the cache and frees all images.
+  void set_max_bytes(size_t max_bytes);
+
+  size_t get_max_bytes() const;
+
+  size_t get_cached_bytes() const;
+
+  bool is_enabled() const { return get_max_bytes() != 0; }
+
+  // Returns NULL if the tile is not in the cache.
+  std::shared_ptr<const HeifPixelImage> get(const Key& key);
+
+  // Images larger than the maximum cache size are not stored.
+  void put(const Key& key, const std::shared_ptr<const HeifPixelImage>& image);
+
+  void clear();
+
+private:
+  struct Entry
+  {
+    Key key;
+    std::shared_ptr<const HeifPixelImage> image;
+    size_t size;
+  };
+
+  void evict(size_t max_bytes);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  mutable std::mutex m_mutex;
+#endif
+
+  std::list<Entry> m_entries; // most recently used first
+  std::map<Key, std::list<Entry>::iterator> m_index;
+  size_t m_cached_bytes = 0;
+  size_t m_max_bytes = 0;
+};
+
+#endif //LIBHEIF_DECODED_TILE_CACHE_H
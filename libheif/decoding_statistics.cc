@@ -0,0 +1,169 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoding_statistics.h"
+#include <algorithm>
+
+
+static thread_local DecodingStatistics* t_current_statistics = nullptr;
+static thread_local DecodingStageTimer* t_current_stage_timer = nullptr;
+
+
+static uint64_t microseconds_since(std::chrono::steady_clock::time_point start)
+{
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+
+DecodingStatistics* DecodingStatistics::current()
+{
+  return t_current_statistics;
+}
+
+
+void DecodingStatistics::add_to(heif_decoding_statistics* out, uint64_t total_time_us) const
+{
+  if (out->version >= 1) {
+    out->total_time_us += total_time_us;
+    out->read_time_us += read_time_us;
+    out->codec_time_us += codec_time_us;
+    out->color_conversion_time_us += color_conversion_time_us;
+    out->tile_paste_time_us += tile_paste_time_us;
+    out->bytes_read += bytes_read;
+    out->num_codec_decodes += num_codec_decodes;
+    out->num_planes_allocated += num_planes_allocated;
+    out->bytes_allocated += bytes_allocated;
+    out->num_planes_copied += num_planes_copied;
+  }
+
+  if (out->version >= 2) {
+    out->num_tile_cache_hits += num_tile_cache_hits;
+    out->num_tile_cache_misses += num_tile_cache_misses;
+  }
+}
+
+
+DecodingStatisticsScope::DecodingStatisticsScope(DecodingStatistics* statistics)
+    : m_previous(t_current_statistics)
+{
+  t_current_statistics = statistics;
+}
+
+
+DecodingStatisticsScope::~DecodingStatisticsScope()
+{
+  t_current_statistics = m_previous;
+}
+
+
+DecodingStatisticsCollector::DecodingStatisticsCollector(heif_decoding_statistics* out)
+{
+  if (out && !t_current_statistics) {
+    m_out = out;
+    m_previous = t_current_statistics;
+    m_start = std::chrono::steady_clock::now();
+
+    t_current_statistics = &m_statistics;
+  }
+}
+
+
+DecodingStatisticsCollector::~DecodingStatisticsCollector()
+{
+  if (m_out) {
+    t_current_statistics = m_previous;
+
+    m_statistics.add_to(m_out, microseconds_since(m_start));
+  }
+}
+
+
+DecodingStageTimer::DecodingStageTimer(std::atomic<uint64_t> DecodingStatistics::* stage)
+    : m_statistics(t_current_statistics), m_stage(stage)
+{
+  if (m_statistics) {
+    m_parent = t_current_stage_timer;
+    t_current_stage_timer = this;
+
+    m_start = std::chrono::steady_clock::now();
+  }
+}
+
+
+DecodingStageTimer::~DecodingStageTimer()
+{
+  if (m_statistics) {
+    uint64_t elapsed_us = microseconds_since(m_start);
+
+    (m_statistics->*m_stage).fetch_add(elapsed_us - std::min(m_nested_us, elapsed_us), std::memory_order_relaxed);
+
+    if (m_parent) {
+      m_parent->m_nested_us += elapsed_us;
+    }
+
+    t_current_stage_timer = m_parent;
+  }
+}
+
+
+uint64_t get_monotonic_time_us()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+
+void DecodingTimeEstimator::add_measurement(heif_compression_format format, uint64_t num_pixels, uint64_t time_us)
+{
+  if (num_pixels == 0) {
+    return;
+  }
+
+  double us_per_pixel = static_cast<double>(time_us) / static_cast<double>(num_pixels);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  auto iter = m_us_per_pixel.find(format);
+  if (iter == m_us_per_pixel.end()) {
+    m_us_per_pixel[format] = us_per_pixel;
+  }
+  else {
+    // Adapt to changes (e.g. CPU load), but do not let a single outlier dominate.
+    iter->second = 0.75 * iter->second + 0.25 * us_per_pixel;
+  }
+}
+
+
+std::optional<uint64_t> DecodingTimeEstimator::estimate_time_us(heif_compression_format format, uint64_t num_pixels) const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  auto iter = m_us_per_pixel.find(format);
+  if (iter == m_us_per_pixel.end()) {
+    return std::nullopt;
+  }
+
+  return static_cast<uint64_t>(iter->second * static_cast<double>(num_pixels));
+}
@@ -0,0 +1,155 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_DECODING_STATISTICS_H
+#define LIBHEIF_DECODING_STATISTICS_H
+
+#include "libheif/heif.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+
+// Collects the heif_decoding_statistics of one decoding call.
+//
+// The statistics of the calling thread are found through a thread-local pointer, such that also code without
+// access to the decoding options (file reading, plane allocation) can add to them. Tasks that run on other
+// threads have to take over the pointer with a DecodingStatisticsScope.
+// When no statistics are requested, the pointer is NULL and all functions return after checking it.
+class DecodingStatistics
+{
+public:
+  std::atomic<uint64_t> read_time_us{0};
+  std::atomic<uint64_t> codec_time_us{0};
+  std::atomic<uint64_t> color_conversion_time_us{0};
+  std::atomic<uint64_t> tile_paste_time_us{0};
+  std::atomic<uint64_t> bytes_read{0};
+  std::atomic<uint64_t> num_codec_decodes{0};
+  std::atomic<uint64_t> num_planes_allocated{0};
+  std::atomic<uint64_t> bytes_allocated{0};
+  std::atomic<uint64_t> num_planes_copied{0};
+  std::atomic<uint64_t> num_tile_cache_hits{0};
+  std::atomic<uint64_t> num_tile_cache_misses{0};
+
+  // The statistics of the current thread, or NULL.
+  static DecodingStatistics* current();
+
+  static void add(std::atomic<uint64_t> DecodingStatistics::* counter, uint64_t value)
+  {
+    if (DecodingStatistics* statistics = current()) {
+      (statistics->*counter).fetch_add(value, std::memory_order_relaxed);
+    }
+  }
+
+  // Adds the values to the public struct.
+  void add_to(heif_decoding_statistics* out, uint64_t total_time_us) const;
+};
+
+
+// Sets the statistics of the current thread while the scope exists.
+class DecodingStatisticsScope
+{
+public:
+  explicit DecodingStatisticsScope(DecodingStatistics* statistics);
+
+  ~DecodingStatisticsScope();
+
+  DecodingStatisticsScope(const DecodingStatisticsScope&) = delete;
+
+  DecodingStatisticsScope& operator=(const DecodingStatisticsScope&) = delete;
+
+private:
+  DecodingStatistics* m_previous;
+};
+
+
+// Collects the statistics of a top-level decoding call into heif_decoding_options::statistics.
+// Nested decoding calls add to the statistics of the outer call.
+class DecodingStatisticsCollector
+{
+public:
+  explicit DecodingStatisticsCollector(heif_decoding_statistics* out);
+
+  ~DecodingStatisticsCollector();
+
+  DecodingStatisticsCollector(const DecodingStatisticsCollector&) = delete;
+
+  DecodingStatisticsCollector& operator=(const DecodingStatisticsCollector&) = delete;
+
+private:
+  heif_decoding_statistics* m_out = nullptr;
+  DecodingStatistics m_statistics;
+  DecodingStatistics* m_previous = nullptr;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+
+// Adds the time of the scope to a stage time of the current statistics.
+// The time of stage timers nested in this one (on the same thread) is not counted for this stage.
+class DecodingStageTimer
+{
+public:
+  explicit DecodingStageTimer(std::atomic<uint64_t> DecodingStatistics::* stage);
+
+  ~DecodingStageTimer();
+
+  DecodingStageTimer(const DecodingStageTimer&) = delete;
+
+  DecodingStageTimer& operator=(const DecodingStageTimer&) = delete;
+
+private:
+  DecodingStatistics* m_statistics;
+  std::atomic<uint64_t> DecodingStatistics::* m_stage;
+  DecodingStageTimer* m_parent = nullptr;
+  uint64_t m_nested_us = 0;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+
+
+// Current time of the steady clock in microseconds. This is the clock of heif_decoding_options::deadline_us.
+uint64_t get_monotonic_time_us();
+
+
+// Estimates the decoding time of an image from the times of the images decoded before.
+// It keeps a moving average of the time per pixel for each compression format.
+class DecodingTimeEstimator
+{
+public:
+  void add_measurement(heif_compression_format format, uint64_t num_pixels, uint64_t time_us);
+
+  // Returns no value if no image of this format has been decoded yet.
+  std::optional<uint64_t> estimate_time_us(heif_compression_format format, uint64_t num_pixels) const;
+
+private:
+#if ENABLE_MULTITHREADING_SUPPORT
+  mutable std::mutex m_mutex;
+#endif
+
+  std::map<heif_compression_format, double> m_us_per_pixel;
+};
+
+#endif //LIBHEIF_DECODING_STATISTICS_H
@@ -0,0 +1,121 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decompressed_metadata_cache.h"
+
+
+void DecompressedMetadataCache::set_max_bytes(size_t max_bytes)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  m_max_bytes = max_bytes;
+  evict(max_bytes);
+}
+
+
+size_t DecompressedMetadataCache::get_max_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_max_bytes;
+}
+
+
+size_t DecompressedMetadataCache::get_cached_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_cached_bytes;
+}
+
+
+DecompressedMetadataCache::Data DecompressedMetadataCache::get(heif_item_id id)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  auto iter = m_index.find(id);
+  if (iter != m_index.end()) {
+    // move to the front of the LRU list
+    m_entries.splice(m_entries.begin(), m_entries, iter->second);
+
+    return iter->second->data;
+  }
+
+  auto weak_iter = m_weak_index.find(id);
+  if (weak_iter == m_weak_index.end()) {
+    return nullptr;
+  }
+
+  Data data = weak_iter->second.lock();
+  if (!data) {
+    m_weak_index.erase(weak_iter);
+  }
+
+  return data;
+}
+
+
+void DecompressedMetadataCache::put(heif_item_id id, const Data& data)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  m_weak_index[id] = data;
+
+  if (data->size() > m_max_bytes) {
+    return;
+  }
+
+  // Another thread may have decompressed the same item in the meantime.
+  auto iter = m_index.find(id);
+  if (iter != m_index.end()) {
+    m_cached_bytes -= iter->second->data->size();
+    m_entries.erase(iter->second);
+    m_index.erase(iter);
+  }
+
+  evict(m_max_bytes - data->size());
+
+  m_entries.push_front({id, data});
+  m_index.emplace(id, m_entries.begin());
+  m_cached_bytes += data->size();
+}
+
+
+void DecompressedMetadataCache::evict(size_t max_bytes)
+{
+  // m_mutex must be locked
+
+  while (m_cached_bytes > max_bytes) {
+    const Entry& entry = m_entries.back();
+    m_cached_bytes -= entry.data->size();
+    m_index.erase(entry.id);
+    m_entries.pop_back();
+  }
+}
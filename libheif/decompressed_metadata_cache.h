@@ -0,0 +1,85 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_DECOMPRESSED_METADATA_CACHE_H
+#define LIBHEIF_DECOMPRESSED_METADATA_CACHE_H
+
+#include "libheif/heif.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+
+// Least-recently-used cache of decompressed metadata items. Each HeifContext has its own cache.
+// Evicted data stays accessible through the cache as long as a caller still holds a reference to it.
+class DecompressedMetadataCache
+{
+public:
+  using Data = std::shared_ptr<const std::vector<uint8_t>>;
+
+  DecompressedMetadataCache() = default;
+
+  DecompressedMetadataCache(const DecompressedMetadataCache&) = delete;
+
+  DecompressedMetadataCache& operator=(const DecompressedMetadataCache&) = delete;
+
+  // Maximum number of bytes of the cached data. Setting this to 0 only keeps the data that is still referenced.
+  void set_max_bytes(size_t max_bytes);
+
+  size_t get_max_bytes() const;
+
+  size_t get_cached_bytes() const;
+
+  // Returns NULL if the item is not in the cache.
+  Data get(heif_item_id id);
+
+  void put(heif_item_id id, const Data& data);
+
+private:
+  struct Entry
+  {
+    heif_item_id id;
+    Data data;
+  };
+
+  void evict(size_t max_bytes);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  mutable std::mutex m_mutex;
+#endif
+
+  std::list<Entry> m_entries; // most recently used first
+  std::map<heif_item_id, std::list<Entry>::iterator> m_index;
+
+  // All data that has been put into the cache, including evicted data that is still referenced by a caller.
+  std::map<heif_item_id, std::weak_ptr<const std::vector<uint8_t>>> m_weak_index;
+
+  size_t m_cached_bytes = 0;
+  size_t m_max_bytes = 16 * 1024 * 1024;
+};
+
+#endif //LIBHEIF_DECOMPRESSED_METADATA_CACHE_H
@@ -39,10 +39,10 @@ Error::Error() = default;
 
 Error::Error(heif_error_code c,
                    heif_suberror_code sc,
-                   const std::string& msg)
+                   std::string msg)
     : error_code(c),
       sub_error_code(sc),
-      message(msg)
+      message(std::move(msg))
 {
 }
 
@@ -31,6 +31,7 @@
 #include <istream>
 #include <ostream>
 #include <sstream>
+#include <utility>
 
 #include "libheif/heif.h"
 #include <cassert>
@@ -75,7 +76,7 @@ public:
 
   Error(heif_error_code c,
         heif_suberror_code sc = heif_suberror_Unspecified,
-        const std::string& msg = "");
+        std::string msg = "");
 
   static const Error Ok;
 
@@ -118,10 +119,16 @@ template <typename T> class Result
 public:
   Result() = default;
 
-  Result(const T& v) : value(v), error(Error::Ok) {}
+  // A default constructed Error is the success state. It does not allocate, since its message is empty.
+  Result(const T& v) : value(v) {}
+
+  // Returning a local variable moves it into the Result (e.g. a bitstream vector) instead of copying it.
+  Result(T&& v) : value(std::move(v)) {}
 
   Result(const Error& e) : error(e) {}
 
+  Result(Error&& e) : error(std::move(e)) {}
+
   operator bool() const { return error.error_code == heif_error_Ok; }
 
   T& operator*()
@@ -130,6 +137,12 @@ public:
     return value;
   }
 
+  const T& operator*() const
+  {
+    assert(error.error_code == heif_error_Ok);
+    return value;
+  }
+
   T value{};
   Error error;
 };
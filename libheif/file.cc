@@ -23,6 +23,9 @@
 #include "libheif/heif.h"
 #include "libheif/heif_properties.h"
 #include "compression.h"
+#include "security_limits.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
 #include "image-items/jpeg2000.h"
 #include "image-items/jpeg.h"
 #include "image-items/vvc.h"
@@ -38,6 +41,8 @@
 #include <cstring>
 #include <cassert>
 #include <algorithm>
+#include <map>
+#include <set>
 
 #include "libheif/heif_cxx.h"
 
@@ -102,6 +107,27 @@ std::shared_ptr<Box_infe> HeifFile::get_infe_box(heif_item_id ID)
 
 Error HeifFile::read_from_file(const char* input_filename)
 {
+  auto streamResult = open_file_stream(input_filename);
+  if (streamResult.error) {
+    return streamResult.error;
+  }
+
+  return read(*streamResult);
+}
+
+
+Result<std::shared_ptr<StreamReader>> HeifFile::open_file_stream(const char* input_filename)
+{
+  // Prefer a memory mapping so that the decoders can access the compressed data without copying it.
+  if (auto mmap_stream = StreamReader_mmap::open(input_filename)) {
+    return std::shared_ptr<StreamReader>(mmap_stream);
+  }
+
+  // Files that cannot be mapped (e.g. because they are too large for the address space) are read with pread().
+  if (auto fd_stream = StreamReader_fd::open(input_filename)) {
+    return std::shared_ptr<StreamReader>(fd_stream);
+  }
+
 #if defined(__MINGW32__) || defined(__MINGW64__) || defined(_MSC_VER)
   auto input_stream_istr = std::unique_ptr<std::istream>(new std::ifstream(convert_utf8_path_to_utf16(input_filename).c_str(), std::ios_base::binary));
 #else
@@ -113,8 +139,7 @@ Error HeifFile::read_from_file(const char* input_filename)
     return Error(heif_error_Input_does_not_exist, heif_suberror_Unspecified, sstr.str());
   }
 
-  auto input_stream = std::make_shared<StreamReader_istream>(std::move(input_stream_istr));
-  return read(input_stream);
+  return std::shared_ptr<StreamReader>(std::make_shared<StreamReader_istream>(std::move(input_stream_istr)));
 }
 
 
@@ -128,10 +153,17 @@ Error HeifFile::read_from_memory(const void* data, size_t size, bool copy)
 
 Error HeifFile::read(const std::shared_ptr<StreamReader>& reader)
 {
+  HEIF_TRACE_SCOPE("file", "open");
+
   assert(m_limits);
 
   m_input_stream = reader;
 
+  // The file structure is parsed from the original reader. Only the item data goes through the cache.
+  if (m_data_cache_size) {
+    m_input_stream = std::make_shared<StreamReader_range_cache>(reader, m_data_cache_size);
+  }
+
   Error err;
   err = m_file_layout->read(reader, m_limits);
   if (err) {
@@ -285,528 +317,1669 @@ void HeifFile::set_sequence_brand(heif_compression_format format)
 }
 
 
-size_t HeifFile::append_mdat_data(const std::vector<uint8_t>& data)
-{
-  if (!m_mdat_data) {
-    m_mdat_data = std::make_unique<MdatData_Memory>();
-  }
+// In WriteMode::Streaming, this space at the start of the file is reserved for the 'ftyp' box.
+// The remaining bytes are filled with a 'free' box.
+static const uint64_t streaming_ftyp_space = 256;
 
-  return m_mdat_data->append_data(data);
-}
+// The 'mdat' header in WriteMode::Streaming always uses a 64-bit size since the size is not known in advance.
+static const uint64_t mdat_header_size_64bit = 16;
 
 
-void HeifFile::write(StreamWriter& writer)
+Error HeifFile::set_write_mode(FileLayout::WriteMode mode)
 {
-  for (auto& box : m_top_level_boxes) {
-#if ENABLE_EXPERIMENTAL_MINI_FORMAT
-    if (box == nullptr) {
-      // Either mini or meta will be null, just ignore that one
-      continue;
-    }
-#endif
-    box->derive_box_version_recursive();
-    Error err = box->write(writer);
-    (void)err; // TODO: error ?
+  if (m_mdat_data) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "The write mode has to be set before data is added to the file"};
   }
 
-  if (m_iloc_box) {
-    // TODO: rewrite to use MdatData class
-    Error err = m_iloc_box->write_mdat_after_iloc(writer);
-    (void)err; // TODO: error ?
+  if (mode == FileLayout::WriteMode::Streaming) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Use start_streaming() to enable WriteMode::Streaming"};
   }
 
-  if (m_mdat_data) {
-    Result<size_t> mdatResult = write_mdat(writer);
-    if (mdatResult.error) {
-      return; // TODO: error ?
-    }
-
-    for (auto& box : m_top_level_boxes) {
-      box->patch_file_pointers_recursively(writer, mdatResult.value);
-    }
+  if (mode == FileLayout::WriteMode::Fragmented) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Use start_fragmented_writing() to enable WriteMode::Fragmented"};
   }
+
+  m_write_mode = mode;
+
+  return Error::Ok;
 }
 
 
-std::string HeifFile::debug_dump_boxes() const
+Error HeifFile::start_streaming(OutputWriteFunction write, OutputSeekFunction seek)
 {
-  std::stringstream sstr;
+  if (m_mdat_data) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Streaming has to be started before data is added to the file"};
+  }
 
-  bool first = true;
+  if (!write || !seek) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "Streaming output requires a write and a seek function"};
+  }
 
-  for (const auto& box : m_top_level_boxes) {
-#if ENABLE_EXPERIMENTAL_MINI_FORMAT
-    if (box == nullptr) {
-      // Either mini or meta will be null, just ignore that one
-      continue;
-    }
-#endif
-    // dump box content for debugging
+  // --- reserve space for 'ftyp' and the 'mdat' header
 
-    if (first) {
-      first = false;
-    }
-    else {
-      sstr << "\n";
-    }
+  StreamWriter header;
+  header.write32(static_cast<uint32_t>(streaming_ftyp_space));
+  header.write32(fourcc("free"));
+  header.skip(static_cast<int>(streaming_ftyp_space - 8));
 
-    Indent indent;
-    sstr << box->dump(indent);
+  write_mdat_header(header, 0, true);
+
+  const auto& data = header.get_data();
+  if (Error err = write(data.data(), data.size())) {
+    return err;
   }
 
-  return sstr.str();
+  m_mdat_data = std::make_unique<MdatData_Output>(std::move(write), std::move(seek),
+                                                  streaming_ftyp_space + mdat_header_size_64bit);
+  m_write_mode = FileLayout::WriteMode::Streaming;
+
+  return Error::Ok;
 }
 
 
-Error HeifFile::parse_heif_file()
+Error HeifFile::start_fragmented_writing(OutputWriteFunction write)
 {
-  // --- read all top-level boxes
+  if (m_mdat_data || m_write_mode == FileLayout::WriteMode::Streaming) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Fragmented writing has to be started before data is added to the file"};
+  }
 
-#if 0
-  for (;;) {
-    std::shared_ptr<Box> box;
-    Error error = Box::read(range, &box);
+  if (!write) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "Fragmented output requires a write function"};
+  }
 
-    if (range.error() || range.eof()) {
-      break;
-    }
+  m_fragment_output = std::move(write);
+  m_write_mode = FileLayout::WriteMode::Fragmented;
 
-    // When an EOF error is returned, this is not really a fatal exception,
-    // but simply the indication that we reached the end of the file.
-    // TODO: this design should be cleaned up
-    if (error.error_code == heif_error_Invalid_input && error.sub_error_code == heif_suberror_End_of_data) {
-      break;
-    }
+  return Error::Ok;
+}
 
-    if (error != Error::Ok) {
-      return error;
-    }
 
-    m_top_level_boxes.push_back(box);
+Error HeifFile::write_fragmented_file_start()
+{
+  if (!m_moov_box) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "A fragmented file has to contain a sequence track"};
+  }
 
+  // --- announce the movie fragments for all tracks
 
-    // extract relevant boxes (ftyp, meta)
+  auto mvex = std::make_shared<Box_mvex>();
 
-    if (box->get_short_type() == fourcc("meta")) {
-      m_meta_box = std::dynamic_pointer_cast<Box_meta>(box);
+  for (const auto& trak : m_moov_box->get_child_boxes<Box_trak>()) {
+    auto tkhd = trak->get_child_box<Box_tkhd>();
+    auto mdia = trak->get_child_box<Box_mdia>();
+    auto minf = mdia ? mdia->get_child_box<Box_minf>() : nullptr;
+    auto stbl = minf ? minf->get_child_box<Box_stbl>() : nullptr;
+    auto stsd = stbl ? stbl->get_child_box<Box_stsd>() : nullptr;
+    if (!tkhd || !stsd) {
+      return {heif_error_Encoding_error,
+              heif_suberror_Unspecified,
+              "Incomplete 'trak' box"};
     }
 
-    if (box->get_short_type() == fourcc("ftyp")) {
-      m_ftyp_box = std::dynamic_pointer_cast<Box_ftyp>(box);
+    // The sample descriptions are stored in 'moov', which cannot be changed afterward.
+    if (stsd->get_num_sample_entries() == 0) {
+      return {heif_error_Usage_error,
+              heif_suberror_Unspecified,
+              "All tracks of a fragmented file need their first sample before the first fragment is written"};
     }
-  }
-#endif
 
-  m_ftyp_box = m_file_layout->get_ftyp_box();
-  if (!m_ftyp_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_ftyp_box);
+    auto trex = std::make_shared<Box_trex>();
+    trex->set_track_id(tkhd->get_track_id());
+    mvex->append_child_box(trex);
   }
 
-  m_top_level_boxes.push_back(m_ftyp_box);
+  m_moov_box->append_child_box(mvex);
 
-  bool is_brand_msf1 = m_ftyp_box->has_compatible_brand(heif_brand2_msf1);
+  StreamWriter writer;
 
-  // --- check whether this is a HEIF file and its structural format
+  for (auto& box : m_top_level_boxes) {
+    if (box == nullptr) {
+      continue;
+    }
 
-  if (!m_ftyp_box->has_compatible_brand(heif_brand2_heic) &&
-      !m_ftyp_box->has_compatible_brand(heif_brand2_heix) &&
-      !m_ftyp_box->has_compatible_brand(heif_brand2_mif1) &&
-      !m_ftyp_box->has_compatible_brand(heif_brand2_avif) &&
-      !m_ftyp_box->has_compatible_brand(heif_brand2_1pic) &&
-#if ENABLE_EXPERIMENTAL_MINI_FORMAT
-      !(m_ftyp_box->get_major_brand() == heif_brand2_mif3) &&
-#endif
-      !m_ftyp_box->has_compatible_brand(heif_brand2_jpeg) &&
-      !is_brand_msf1) {
-    std::stringstream sstr;
-    sstr << "File does not include any supported brands.\n";
+    box->derive_box_version_recursive();
+    if (Error err = box->write(writer)) {
+      return err;
+    }
+  }
 
-    return Error(heif_error_Unsupported_filetype,
-                 heif_suberror_Unspecified,
-                 sstr.str());
-      }
+  m_fragmented_file_start_written = true;
 
-#if ENABLE_EXPERIMENTAL_MINI_FORMAT
-  m_mini_box = m_file_layout->get_mini_box();
-  m_top_level_boxes.push_back(m_mini_box);
+  const auto& data = writer.get_data();
+  return m_fragment_output(data.data(), data.size());
+}
 
-  if (m_mini_box) {
-    Error err = m_mini_box->create_expanded_boxes(this);
-    if (err) {
+
+Error HeifFile::write_fragment(const std::shared_ptr<Box_traf>& traf, const std::vector<uint8_t>& mdat_data)
+{
+  assert(m_write_mode == FileLayout::WriteMode::Fragmented);
+
+  if (!m_fragmented_file_start_written) {
+    if (Error err = write_fragmented_file_start()) {
       return err;
     }
-    return Error::Ok;
   }
-#endif
 
-  m_meta_box = m_file_layout->get_meta_box();
-  if (m_meta_box) {
-    m_top_level_boxes.push_back(m_meta_box);
-  }
+  auto moof = std::make_shared<Box_moof>();
 
-  // TODO: we are missing 'mdat' top level boxes
+  auto mfhd = std::make_shared<Box_mfhd>();
+  mfhd->set_sequence_number(++m_fragment_sequence_number);
+  moof->append_child_box(mfhd);
+  moof->append_child_box(traf);
 
-  m_moov_box = m_file_layout->get_moov_box();
-  if (m_moov_box) {
-    m_top_level_boxes.push_back(m_moov_box);
+  StreamWriter writer;
+  moof->derive_box_version_recursive();
+  if (Error err = moof->write(writer)) {
+    return err;
   }
 
-  // if we didn't find the mini box, meta is required
+  // The file pointers are relative to the 'moof' box ('default-base-is-moof').
 
-  if (!m_meta_box && !is_brand_msf1) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_meta_box);
-  }
+  size_t moof_size = writer.get_position();
+  write_mdat_header(writer, mdat_data.size(), false);
+  moof->patch_file_pointers_recursively(writer, writer.get_position());
 
-  if (!m_moov_box && is_brand_msf1) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_moov_box);
+  if (writer.get_position() - moof_size + mdat_data.size() > std::numeric_limits<int32_t>::max()) {
+    return {heif_error_Encoding_error,
+            heif_suberror_Unspecified,
+            "Movie fragment exceeds the maximum size"};
   }
 
-  if (m_meta_box) {
-    auto err = parse_heif_images();
-    if (err) {
-      return err;
-    }
+  const auto& header = writer.get_data();
+  if (Error err = m_fragment_output(header.data(), header.size())) {
+    return err;
   }
 
-  if (m_moov_box) {
-    auto err = parse_heif_sequences();
-    if (err) {
+  return m_fragment_output(mdat_data.data(), mdat_data.size());
+}
+
+
+Error HeifFile::create_mdat_data()
+{
+  if (m_write_mode == FileLayout::WriteMode::TmpFile) {
+    auto tmpfile = std::make_unique<MdatData_TmpFile>();
+    if (Error err = tmpfile->open()) {
       return err;
     }
+
+    m_mdat_data = std::move(tmpfile);
+  }
+  else {
+    m_mdat_data = std::make_unique<MdatData_Memory>();
   }
 
   return Error::Ok;
 }
 
 
-Error HeifFile::parse_heif_images()
+Result<uint64_t> HeifFile::append_mdat_data(const std::vector<uint8_t>& data)
 {
-  m_hdlr_box = m_meta_box->get_child_box<Box_hdlr>();
-  if (STRICT_PARSING && !m_hdlr_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_hdlr_box);
+  if (m_write_mode == FileLayout::WriteMode::Fragmented) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Unspecified,
+                 "Image data cannot be added to a fragmented file"};
   }
 
-  if (m_hdlr_box &&
-      m_hdlr_box->get_handler_type() != fourcc("pict")) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_pict_handler);
+  if (!m_input_item_data_imported) {
+    if (Error err = import_input_item_data()) {
+      return err;
+    }
   }
 
+  if (!m_mdat_data) {
+    if (Error err = create_mdat_data()) {
+      return err;
+    }
+  }
 
-  // --- find mandatory boxes needed for image decoding
+  return m_mdat_data->append_data(data);
+}
 
-  m_pitm_box = m_meta_box->get_child_box<Box_pitm>();
-  if (!m_pitm_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_pitm_box);
-  }
 
-  m_iprp_box = m_meta_box->get_child_box<Box_iprp>();
-  if (!m_iprp_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_iprp_box);
-  }
+Error HeifFile::import_input_item_data()
+{
+  m_input_item_data_imported = true;
 
-  m_ipco_box = m_iprp_box->get_child_box<Box_ipco>();
-  if (!m_ipco_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_ipco_box);
+  if (!m_input_stream) {
+    return Error::Ok;
   }
 
-  auto ipma_boxes = m_iprp_box->get_child_boxes<Box_ipma>();
-  if (ipma_boxes.empty()) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_ipma_box);
-  }
-  for (size_t i=1;i<ipma_boxes.size();i++) {
-    ipma_boxes[0]->insert_entries_from_other_ipma_box(*ipma_boxes[i]);
+  if (has_sequences()) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unspecified,
+            "Files with sequence tracks cannot be written again"};
   }
-  m_ipma_box = ipma_boxes[0];
 
-  m_iloc_box = m_meta_box->get_child_box<Box_iloc>();
-  if (!m_iloc_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_iloc_box);
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+  // The 'mini' box cannot describe modified files. It is replaced with the full 'meta' box that was created from it.
+  if (m_mini_box) {
+    std::replace(m_top_level_boxes.begin(), m_top_level_boxes.end(),
+                 std::static_pointer_cast<Box>(m_mini_box), std::static_pointer_cast<Box>(m_meta_box));
+    m_mini_box.reset();
+
+    heif_brand2 brand = m_ftyp_box->get_minor_version();
+    m_ftyp_box->set_major_brand(brand);
+    m_ftyp_box->set_minor_version(0);
+    m_ftyp_box->add_compatible_brand(brand);
+    m_ftyp_box->add_compatible_brand(heif_brand2_mif1);
   }
+#endif
 
-  m_idat_box = m_meta_box->get_child_box<Box_idat>();
+  if (m_idat_box) {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_input_stream->get_read_mutex());
+#endif
 
-  m_iref_box = m_meta_box->get_child_box<Box_iref>();
-  if (m_iref_box) {
-    Error error = check_for_ref_cycle(get_primary_image_ID(), m_iref_box);
-    if (error) {
-      return error;
+    if (Error err = m_idat_box->load_data_for_writing(m_input_stream, m_limits)) {
+      return err;
     }
   }
 
-  m_iinf_box = m_meta_box->get_child_box<Box_iinf>();
-  if (!m_iinf_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_iinf_box);
+  if (!m_iloc_box) {
+    return Error::Ok;
   }
 
-  m_grpl_box = m_meta_box->get_child_box<Box_grpl>();
+  // --- collect the file ranges of all items stored in the file
+
+  struct FileRange
+  {
+    uint64_t start, end;
+    uint64_t mdat_position;
+  };
+
+  std::vector<FileRange> ranges;
+
+  for (const auto& item : m_iloc_box->get_items()) {
+    if (item.construction_method != 0) {
+      continue;
+    }
+
+    if (item.data_reference_index != 0) {
+      return {heif_error_Unsupported_feature,
+              heif_suberror_Unspecified,
+              "Item data stored in other files cannot be copied"};
+    }
+
+    for (const auto& extent : item.extents) {
+      if (extent.length == 0) {
+        return {heif_error_Unsupported_feature,
+                heif_suberror_Unspecified,
+                "Item extents that extend to the end of the file cannot be copied"};
+      }
+
+      uint64_t start = item.base_offset + extent.offset;
+      if (start < item.base_offset || start + extent.length < start) {
+        return {heif_error_Invalid_input,
+                heif_suberror_End_of_data,
+                "Item extent lies outside of the file"};
+      }
+
+      ranges.push_back({start, start + extent.length, 0});
+    }
+  }
+
+  // --- merge overlapping ranges, so that data shared between items is only copied once
+
+  std::sort(ranges.begin(), ranges.end(), [](const FileRange& a, const FileRange& b) {
+    return a.start < b.start;
+  });
+
+  std::vector<FileRange> merged;
+  for (const auto& range : ranges) {
+    if (!merged.empty() && range.start <= merged.back().end) {
+      merged.back().end = std::max(merged.back().end, range.end);
+    }
+    else {
+      merged.push_back(range);
+    }
+  }
+
+  // --- copy the ranges into the 'mdat' data
+
+  if (m_write_mode == FileLayout::WriteMode::Streaming) {
+    // The data has to be written to the output immediately.
+
+    for (auto& range : merged) {
+      range.mdat_position = m_mdat_data->get_data_size();
+
+      Error err = MdatData_InputFile::copy_input_range(*m_input_stream, range.start, range.end - range.start,
+                                                       [this](const uint8_t* data, size_t size) {
+                                                         return m_mdat_data->append_data(std::vector<uint8_t>(data, data + size)).error;
+                                                       });
+      if (err) {
+        return err;
+      }
+    }
+  }
+  else {
+    assert(!m_mdat_data);
+
+    if (Error err = create_mdat_data()) {
+      return err;
+    }
+
+    auto input_data = std::make_unique<MdatData_InputFile>(m_input_stream, std::move(m_mdat_data));
+
+    for (auto& range : merged) {
+      Result<uint64_t> posResult = input_data->append_input_range(range.start, range.end - range.start);
+      if (!posResult) {
+        return posResult.error;
+      }
+
+      range.mdat_position = *posResult;
+    }
+
+    m_mdat_data = std::move(input_data);
+  }
+
+  m_iloc_box->set_mdat_positions_from_file_offsets([&merged](uint64_t file_offset) {
+    auto iter = std::upper_bound(merged.begin(), merged.end(), file_offset,
+                                 [](uint64_t offset, const FileRange& range) { return offset < range.start; });
+    assert(iter != merged.begin());
+    --iter;
+
+    return iter->mdat_position + (file_offset - iter->start);
+  });
+
+  return Error::Ok;
+}
+
+
+void HeifFile::write_mdat_header(StreamWriter& writer, uint64_t mdat_data_size, bool force_64bit_size)
+{
+  if (!force_64bit_size && mdat_data_size <= 0xFFFFFFFF - 8) {
+    writer.write32((uint32_t) (mdat_data_size + 8));
+    writer.write32(fourcc("mdat"));
+  }
+  else {
+    // box size > 4 GB
+
+    writer.write32(1);
+    writer.write32(fourcc("mdat"));
+    writer.write64(mdat_data_size + 8 + 8);
+  }
+}
+
+
+Error HeifFile::write(StreamWriter& writer)
+{
+  if (m_write_mode == FileLayout::WriteMode::Streaming ||
+      m_write_mode == FileLayout::WriteMode::Fragmented) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "A streamed file cannot be written into memory"};
+  }
+
+  return write([&writer](const uint8_t* data, size_t size) {
+                 writer.write(data, size);
+                 return Error::Ok;
+               },
+               nullptr);
+}
+
+
+Error HeifFile::write(const OutputWriteFunction& output, const OutputSeekFunction& seek)
+{
+  if (!m_input_item_data_imported) {
+    if (Error err = import_input_item_data()) {
+      return err;
+    }
+  }
+
+  if (!m_iloc_box || (!m_input_stream && m_mdat_item_order.empty())) {
+    return write_file(output, seek);
+  }
+
+  // The file offsets of the items are overwritten with their positions in the output file and their 'mdat' positions
+  // may be reordered. Restore them afterward, so that the items can still be read and the file can be written again.
+
+  std::vector<Box_iloc::Item> input_items = m_iloc_box->get_items();
+
+  Error err = write_file(output, seek);
+
+  m_iloc_box->set_items(std::move(input_items));
+
+  return err;
+}
+
+
+Error HeifFile::write_file(const OutputWriteFunction& output, const OutputSeekFunction& seek)
+{
+  if (m_write_mode == FileLayout::WriteMode::Streaming) {
+    return write_streaming_file_end(output, seek);
+  }
+
+  if (m_write_mode == FileLayout::WriteMode::Fragmented) {
+    // All samples have been written in fragments. Only a file without samples still needs its start.
+    return m_fragmented_file_start_written ? Error::Ok : write_fragmented_file_start();
+  }
+
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+  if (m_write_mini_format) {
+    Result<std::shared_ptr<Box_mini>> miniResult = create_mini_box();
+    if (miniResult) {
+      StreamWriter writer;
+
+      if (Error err = (*miniResult)->create_ftyp_box()->write(writer)) {
+        return err;
+      }
+
+      if (Error err = (*miniResult)->write(writer)) {
+        return err;
+      }
+
+      const auto& data = writer.get_data();
+      return output(data.data(), data.size());
+    }
+
+    // The file content cannot be represented in the 'mini' format. Write a full 'meta' box instead.
+  }
+#endif
+
+  std::vector<MdatRange> mdat_ranges;
+  if (m_mdat_data && m_iloc_box && !m_mdat_item_order.empty() && !has_sequences()) {
+    mdat_ranges = reorder_mdat_extents();
+  }
+
+  // --- write all boxes in front of the 'mdat' box
+
+  StreamWriter writer;
+
+  for (auto& box : m_top_level_boxes) {
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+    if (box == nullptr) {
+      // Either mini or meta will be null, just ignore that one
+      continue;
+    }
+#endif
+    box->derive_box_version_recursive();
+    if (Error err = box->write(writer)) {
+      return err;
+    }
+  }
+
+  if (m_mdat_data) {
+    write_mdat_header(writer, m_mdat_data->get_data_size(), false);
+
+    uint64_t data_start = writer.get_position();
+
+    if (m_iloc_box) {
+      m_iloc_box->set_mdat_data_start(writer, data_start);
+    }
+
+    for (auto& box : m_top_level_boxes) {
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+      if (box == nullptr) {
+        continue;
+      }
+#endif
+      box->patch_file_pointers_recursively(writer, data_start);
+    }
+  }
+
+  const auto& data = writer.get_data();
+  if (Error err = output(data.data(), data.size())) {
+    return err;
+  }
+
+  if (m_mdat_data) {
+    if (mdat_ranges.empty()) {
+      return m_mdat_data->write(output);
+    }
+
+    for (const MdatRange& range : mdat_ranges) {
+      if (Error err = m_mdat_data->write_range(range.position, range.size, output)) {
+        return err;
+      }
+    }
+  }
+
+  return Error::Ok;
+}
+
+
+std::vector<HeifFile::MdatRange> HeifFile::reorder_mdat_extents()
+{
+  std::vector<Box_iloc::Item> items = m_iloc_box->get_items();
+  const uint64_t mdat_size = m_mdat_data->get_data_size();
+
+  // --- the blocks of 'mdat' data referenced by the items (position -> size)
+  //     Items with identical extents share a block. Partially overlapping extents cannot be reordered.
+
+  std::map<uint64_t, uint64_t> blocks;
+
+  for (const auto& item : items) {
+    if (item.construction_method != 0) {
+      continue;
+    }
+
+    for (const auto& extent : item.extents) {
+      if (extent.length == 0) {
+        continue;
+      }
+
+      auto inserted = blocks.emplace(extent.mdat_position, extent.length);
+      if (!inserted.second && inserted.first->second != extent.length) {
+        return {};
+      }
+    }
+  }
+
+  uint64_t end = 0;
+  for (const auto& block : blocks) {
+    if (block.first < end || block.second > mdat_size - block.first) {
+      return {};
+    }
+
+    end = block.first + block.second;
+  }
+
+  // --- the blocks of the listed items first, then all remaining data in its original order
+
+  std::vector<MdatRange> ranges;
+  std::set<uint64_t> placed_blocks;
+
+  for (heif_item_id id : m_mdat_item_order) {
+    const Box_iloc::Item* item = m_iloc_box->find_item(id);
+    if (!item || item->construction_method != 0) {
+      continue;
+    }
+
+    for (const auto& extent : item->extents) {
+      if (extent.length != 0 && placed_blocks.insert(extent.mdat_position).second) {
+        ranges.push_back({extent.mdat_position, extent.length});
+      }
+    }
+  }
+
+  uint64_t position = 0;
+  for (const auto& block : blocks) {
+    if (block.first > position) {
+      ranges.push_back({position, block.first - position});
+    }
+
+    if (placed_blocks.insert(block.first).second) {
+      ranges.push_back({block.first, block.second});
+    }
+
+    position = block.first + block.second;
+  }
+
+  if (position < mdat_size) {
+    ranges.push_back({position, mdat_size - position});
+  }
+
+  // --- move the extents to the new positions of their blocks
+
+  std::map<uint64_t, uint64_t> new_positions;
+  uint64_t new_position = 0;
+  for (const MdatRange& range : ranges) {
+    new_positions[range.position] = new_position;
+    new_position += range.size;
+  }
+
+  for (auto& item : items) {
+    if (item.construction_method != 0) {
+      continue;
+    }
+
+    for (auto& extent : item.extents) {
+      if (extent.length != 0) {
+        extent.mdat_position = new_positions[extent.mdat_position];
+      }
+    }
+  }
+
+  m_iloc_box->set_items(std::move(items));
+
+  // --- write consecutive ranges in one piece
+
+  std::vector<MdatRange> merged;
+  for (const MdatRange& range : ranges) {
+    if (!merged.empty() && merged.back().position + merged.back().size == range.position) {
+      merged.back().size += range.size;
+    }
+    else {
+      merged.push_back(range);
+    }
+  }
+
+  return merged;
+}
+
+
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+Result<std::shared_ptr<Box_mini>> HeifFile::create_mini_box() const
+{
+  // The 'mini' format is meant for small images. Larger files are not copied into memory.
+  const uint64_t max_mini_mdat_size = 64 * 1024 * 1024;
+
+  for (const auto& box : m_top_level_boxes) {
+    if (box && box != m_ftyp_box && box != m_meta_box) {
+      return Error{heif_error_Unsupported_feature,
+                   heif_suberror_Unspecified,
+                   "File with additional top-level boxes cannot be written as 'mini' box"};
+    }
+  }
+
+  std::vector<uint8_t> mdat_data;
+
+  if (m_mdat_data) {
+    if (m_mdat_data->get_data_size() > max_mini_mdat_size) {
+      return Error{heif_error_Unsupported_feature,
+                   heif_suberror_Unspecified,
+                   "Image data too large for 'mini' box"};
+    }
+
+    StreamWriter mdat_writer;
+    if (Error err = m_mdat_data->write(mdat_writer)) {
+      return err;
+    }
+
+    mdat_data = mdat_writer.get_data();
+  }
+
+  return Box_mini::create_from_file(*this, mdat_data);
+}
+#endif
+
+
+Error HeifFile::write_streaming_file_end(const OutputWriteFunction& output, const OutputSeekFunction& seek)
+{
+  if (!seek) {
+    return {heif_error_Usage_error,
+            heif_suberror_Null_pointer_argument,
+            "Streaming output requires a seek function"};
+  }
+
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+  if (m_mini_box) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unspecified,
+            "The 'mini' format cannot be written in WriteMode::Streaming"};
+  }
+#endif
+
+  auto* mdat = static_cast<MdatData_Output*>(m_mdat_data.get());
+  uint64_t data_start = mdat->get_data_start();
+  uint64_t mdat_end = data_start + mdat->get_data_size();
+
+  // --- write all boxes except 'ftyp' behind the 'mdat' box
+  //     The file pointers are already known since the 'mdat' data is at a fixed position.
+
+  StreamWriter tail;
+
+  for (auto& box : m_top_level_boxes) {
+    if (box == nullptr || box == m_ftyp_box) {
+      continue;
+    }
+
+    box->derive_box_version_recursive();
+    if (Error err = box->write(tail)) {
+      return err;
+    }
+  }
+
+  if (m_iloc_box) {
+    m_iloc_box->set_mdat_data_start(tail, data_start);
+  }
+
+  for (auto& box : m_top_level_boxes) {
+    if (box != nullptr) {
+      box->patch_file_pointers_recursively(tail, data_start);
+    }
+  }
+
+  const auto& tail_data = tail.get_data();
+  if (Error err = output(tail_data.data(), tail_data.size())) {
+    return err;
+  }
+
+  // --- fill in the 'ftyp' box and the 'mdat' header at the start of the file
+
+  StreamWriter header;
+  m_ftyp_box->derive_box_version_recursive();
+  if (Error err = m_ftyp_box->write(header)) {
+    return err;
+  }
+
+  uint64_t ftyp_size = header.get_position();
+  if (ftyp_size != streaming_ftyp_space) {
+    if (ftyp_size + 8 > streaming_ftyp_space) {
+      return {heif_error_Encoding_error,
+              heif_suberror_Unspecified,
+              "The 'ftyp' box is too large for the space reserved in the streamed file"};
+    }
+
+    header.write32(static_cast<uint32_t>(streaming_ftyp_space - ftyp_size));
+    header.write32(fourcc("free"));
+    header.skip(static_cast<int>(streaming_ftyp_space - ftyp_size - 8));
+  }
+
+  write_mdat_header(header, mdat->get_data_size(), true);
+
+  if (Error err = seek(0)) {
+    return err;
+  }
+
+  const auto& header_data = header.get_data();
+  if (Error err = output(header_data.data(), header_data.size())) {
+    return err;
+  }
+
+  return seek(mdat_end + tail_data.size());
+}
+
+
+std::string HeifFile::debug_dump_boxes() const
+{
+  std::stringstream sstr;
+
+  bool first = true;
+
+  for (const auto& box : m_top_level_boxes) {
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+    if (box == nullptr) {
+      // Either mini or meta will be null, just ignore that one
+      continue;
+    }
+#endif
+    // dump box content for debugging
+
+    if (first) {
+      first = false;
+    }
+    else {
+      sstr << "\n";
+    }
+
+    Indent indent;
+    sstr << box->dump(indent);
+  }
+
+  return sstr.str();
+}
+
+
+Error HeifFile::parse_heif_file()
+{
+  HEIF_TRACE_SCOPE("file", "parse boxes");
+
+  // --- read all top-level boxes
+
+#if 0
+  for (;;) {
+    std::shared_ptr<Box> box;
+    Error error = Box::read(range, &box);
+
+    if (range.error() || range.eof()) {
+      break;
+    }
+
+    // When an EOF error is returned, this is not really a fatal exception,
+    // but simply the indication that we reached the end of the file.
+    // TODO: this design should be cleaned up
+    if (error.error_code == heif_error_Invalid_input && error.sub_error_code == heif_suberror_End_of_data) {
+      break;
+    }
+
+    if (error != Error::Ok) {
+      return error;
+    }
+
+    m_top_level_boxes.push_back(box);
+
+
+    // extract relevant boxes (ftyp, meta)
+
+    if (box->get_short_type() == fourcc("meta")) {
+      m_meta_box = std::dynamic_pointer_cast<Box_meta>(box);
+    }
+
+    if (box->get_short_type() == fourcc("ftyp")) {
+      m_ftyp_box = std::dynamic_pointer_cast<Box_ftyp>(box);
+    }
+  }
+#endif
+
+  m_ftyp_box = m_file_layout->get_ftyp_box();
+  if (!m_ftyp_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_ftyp_box);
+  }
+
+  m_top_level_boxes.push_back(m_ftyp_box);
+
+  bool is_brand_msf1 = m_ftyp_box->has_compatible_brand(heif_brand2_msf1);
+
+  // --- check whether this is a HEIF file and its structural format
+
+  if (!m_ftyp_box->has_compatible_brand(heif_brand2_heic) &&
+      !m_ftyp_box->has_compatible_brand(heif_brand2_heix) &&
+      !m_ftyp_box->has_compatible_brand(heif_brand2_mif1) &&
+      !m_ftyp_box->has_compatible_brand(heif_brand2_avif) &&
+      !m_ftyp_box->has_compatible_brand(heif_brand2_1pic) &&
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+      !(m_ftyp_box->get_major_brand() == heif_brand2_mif3) &&
+#endif
+      !m_ftyp_box->has_compatible_brand(heif_brand2_jpeg) &&
+      !is_brand_msf1) {
+    std::stringstream sstr;
+    sstr << "File does not include any supported brands.\n";
+
+    return Error(heif_error_Unsupported_filetype,
+                 heif_suberror_Unspecified,
+                 sstr.str());
+      }
+
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+  m_mini_box = m_file_layout->get_mini_box();
+  m_top_level_boxes.push_back(m_mini_box);
+
+  if (m_mini_box) {
+    Error err = m_mini_box->create_expanded_boxes(this);
+    if (err) {
+      return err;
+    }
+    return Error::Ok;
+  }
+#endif
+
+  m_meta_box = m_file_layout->get_meta_box();
+  if (m_meta_box) {
+    m_top_level_boxes.push_back(m_meta_box);
+  }
+
+  // TODO: we are missing 'mdat' top level boxes
+
+  m_moov_box = m_file_layout->get_moov_box();
+  if (m_moov_box) {
+    m_top_level_boxes.push_back(m_moov_box);
+  }
+  else if (m_file_layout->has_deferred_moov_box()) {
+    m_has_deferred_moov_box = true;
+    m_deferred_moov_box_index = m_top_level_boxes.size();
+  }
+
+  // if we didn't find the mini box, meta is required
+
+  if (!m_meta_box && !is_brand_msf1) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_meta_box);
+  }
+
+  if (!has_sequences() && is_brand_msf1) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_moov_box);
+  }
+
+  if (m_meta_box) {
+    auto err = parse_heif_images();
+    if (err) {
+      return err;
+    }
+  }
+
+  if (m_moov_box) {
+    auto err = parse_heif_sequences();
+    if (err) {
+      return err;
+    }
+  }
+
+  return Error::Ok;
+}
+
+
+Error HeifFile::parse_heif_images()
+{
+  m_hdlr_box = m_meta_box->get_child_box<Box_hdlr>();
+  if (STRICT_PARSING && !m_hdlr_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_hdlr_box);
+  }
+
+  if (m_hdlr_box &&
+      m_hdlr_box->get_handler_type() != fourcc("pict")) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_pict_handler);
+  }
+
+
+  // --- find mandatory boxes needed for image decoding
+
+  m_pitm_box = m_meta_box->get_child_box<Box_pitm>();
+  if (!m_pitm_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_pitm_box);
+  }
+
+  m_iprp_box = m_meta_box->get_child_box<Box_iprp>();
+  if (!m_iprp_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_iprp_box);
+  }
+
+  m_ipco_box = m_iprp_box->get_child_box<Box_ipco>();
+  if (!m_ipco_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_ipco_box);
+  }
+
+  auto ipma_boxes = m_iprp_box->get_child_boxes<Box_ipma>();
+  if (ipma_boxes.empty()) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_ipma_box);
+  }
+  for (size_t i=1;i<ipma_boxes.size();i++) {
+    ipma_boxes[0]->insert_entries_from_other_ipma_box(*ipma_boxes[i]);
+  }
+  m_ipma_box = ipma_boxes[0];
+
+  m_iloc_box = m_meta_box->get_child_box<Box_iloc>();
+  if (!m_iloc_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_iloc_box);
+  }
+
+  m_iloc_box->set_max_read_gap(m_max_read_gap);
+
+  m_idat_box = m_meta_box->get_child_box<Box_idat>();
+
+  m_iref_box = m_meta_box->get_child_box<Box_iref>();
+  if (m_iref_box) {
+    Error error = check_for_ref_cycle(get_primary_image_ID(), m_iref_box);
+    if (error) {
+      return error;
+    }
+  }
+
+  m_iinf_box = m_meta_box->get_child_box<Box_iinf>();
+  if (!m_iinf_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_iinf_box);
+  }
+
+  m_grpl_box = m_meta_box->get_child_box<Box_grpl>();
 
 
   // --- build list of images
 
-  std::vector<std::shared_ptr<Box_infe>> infe_boxes = m_iinf_box->get_child_boxes<Box_infe>();
+  std::vector<std::shared_ptr<Box_infe>> infe_boxes = m_iinf_box->get_child_boxes<Box_infe>();
+
+  for (auto& infe_box : infe_boxes) {
+    if (!infe_box) {
+      return Error(heif_error_Invalid_input,
+                   heif_suberror_No_infe_box);
+    }
+
+    m_infe_boxes.insert(std::make_pair(infe_box->get_item_ID(), infe_box));
+  }
+
+  return Error::Ok;
+}
+
+
+Error HeifFile::load_deferred_moov_box()
+{
+  if (!m_has_deferred_moov_box) {
+    return Error::Ok;
+  }
+
+  m_has_deferred_moov_box = false;
+
+  auto moovResult = m_file_layout->read_deferred_moov_box(m_limits);
+  if (moovResult.error) {
+    return moovResult.error;
+  }
+
+  m_moov_box = *moovResult;
+  m_top_level_boxes.insert(m_top_level_boxes.begin() + static_cast<std::ptrdiff_t>(m_deferred_moov_box_index), m_moov_box);
+
+  Error err = parse_heif_sequences();
+  if (err) {
+    // Do not leave a half-initialized sequence behind.
+    m_mvhd_box.reset();
+    return err;
+  }
+
+  return Error::Ok;
+}
+
+
+Error HeifFile::parse_heif_sequences()
+{
+  m_mvhd_box = m_moov_box->get_child_box<Box_mvhd>();
+  if (!m_mvhd_box) {
+    return {heif_error_Invalid_input,
+            heif_suberror_Unspecified,
+            "No mvhd box in image sequence."};
+  }
+
+  return Error::Ok;
+}
+
+
+Error HeifFile::check_for_ref_cycle(heif_item_id ID,
+                                    const std::shared_ptr<Box_iref>& iref_box) const
+{
+  std::unordered_set<heif_item_id> parent_items;
+  return check_for_ref_cycle_recursion(ID, iref_box, parent_items);
+}
+
+
+Error HeifFile::check_for_ref_cycle_recursion(heif_item_id ID,
+                                    const std::shared_ptr<Box_iref>& iref_box,
+                                    std::unordered_set<heif_item_id>& parent_items) const {
+  if (parent_items.find(ID) != parent_items.end()) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_Item_reference_cycle,
+                 "Image reference cycle");
+  }
+  parent_items.insert(ID);
+
+  std::vector<heif_item_id> image_references = iref_box->get_references(ID, fourcc("dimg"));
+  for (heif_item_id reference_idx : image_references) {
+    Error error = check_for_ref_cycle_recursion(reference_idx, iref_box, parent_items);
+    if (error) {
+      return error;
+    }
+  }
+
+  parent_items.erase(ID);
+  return Error::Ok;
+}
+
+
+bool HeifFile::item_exists(heif_item_id ID) const
+{
+  auto image_iter = m_infe_boxes.find(ID);
+  return image_iter != m_infe_boxes.end();
+}
+
+
+bool HeifFile::has_item_with_id(heif_item_id ID) const
+{
+  auto infe_box = get_infe_box(ID);
+  return infe_box != nullptr;
+}
+
+
+uint32_t HeifFile::get_item_type_4cc(heif_item_id ID) const
+{
+  auto infe_box = get_infe_box(ID);
+  if (!infe_box) {
+    return 0;
+  }
+
+  return infe_box->get_item_type_4cc();
+}
+
+
+std::string HeifFile::get_content_type(heif_item_id ID) const
+{
+  auto infe_box = get_infe_box(ID);
+  if (!infe_box) {
+    return "";
+  }
+
+  return infe_box->get_content_type();
+}
+
+std::string HeifFile::get_item_uri_type(heif_item_id ID) const
+{
+  auto infe_box = get_infe_box(ID);
+  if (!infe_box) {
+    return "";
+  }
+
+  return infe_box->get_item_uri_type();
+}
+
+
+Error HeifFile::get_properties(heif_item_id imageID,
+                               std::vector<std::shared_ptr<Box>>& properties) const
+{
+  if (!m_ipco_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_ipco_box);
+  }
+  else if (!m_ipma_box) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_No_ipma_box);
+  }
+
+  return m_ipco_box->get_properties_for_item_ID(imageID, m_ipma_box, properties);
+}
+
+
+Error HeifFile::get_uncompressed_item_data(heif_item_id ID, std::vector<uint8_t>* data) const
+{
+  assert(m_limits);
+
+#if ENABLE_PARALLEL_TILE_DECODING
+  // std::lock_guard<std::mutex> guard(m_read_mutex);   // TODO: I think that this is not needed anymore because this function is not used for image data anymore.
+#endif
+
+  if (!item_exists(ID)) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Nonexisting_item_referenced);
+  }
+
+  auto infe_box = get_infe_box(ID);
+  if (!infe_box) {
+    return Error(heif_error_Usage_error,
+                 heif_suberror_Nonexisting_item_referenced);
+  }
+
 
-  for (auto& infe_box : infe_boxes) {
-    if (!infe_box) {
-      return Error(heif_error_Invalid_input,
-                   heif_suberror_No_infe_box);
+  uint32_t item_type = infe_box->get_item_type_4cc();
+  std::string content_type = infe_box->get_content_type();
+
+  // --- decompress data
+
+  Error error;
+  bool read_uncompressed = true;
+  if (item_type == fourcc("mime")) {
+    std::string encoding = infe_box->get_content_encoding();
+    if (encoding == "compress_zlib") {
+#if HAVE_ZLIB
+      read_uncompressed = false;
+      std::vector<uint8_t> compressed_data;
+      std::span<const uint8_t> compressed_view;
+      error = get_item_data_view(ID, compressed_data, compressed_view);
+      if (error) {
+        return error;
+      }
+      error = decompress_zlib(compressed_view, data);
+      if (error) {
+        return error;
+      }
+#else
+      return Error(heif_error_Unsupported_feature,
+                   heif_suberror_Unsupported_header_compression_method,
+                   encoding);
+#endif
+    }
+    else if (encoding == "deflate") {
+#if HAVE_ZLIB
+      read_uncompressed = false;
+      std::vector<uint8_t> compressed_data;
+      std::span<const uint8_t> compressed_view;
+      error = get_item_data_view(ID, compressed_data, compressed_view);
+      if (error) {
+        return error;
+      }
+      error = decompress_deflate(compressed_view, data);
+      if (error) {
+        return error;
+      }
+#else
+      return Error(heif_error_Unsupported_feature,
+                   heif_suberror_Unsupported_header_compression_method,
+                   encoding);
+#endif
+    }
+    else if (encoding == "br") {
+#if HAVE_BROTLI
+      read_uncompressed = false;
+      std::vector<uint8_t> compressed_data;
+      std::span<const uint8_t> compressed_view;
+      error = get_item_data_view(ID, compressed_data, compressed_view);
+      if (error) {
+        return error;
+      }
+      error = decompress_brotli(compressed_view, data);
+      if (error) {
+        return error;
+      }
+#else
+      return Error(heif_error_Unsupported_feature,
+                   heif_suberror_Unsupported_header_compression_method,
+                   encoding);
+#endif
+    }
+    else if (encoding == "zstd") {
+#if HAVE_ZSTD
+      read_uncompressed = false;
+      std::vector<uint8_t> compressed_data;
+      std::span<const uint8_t> compressed_view;
+      error = get_item_data_view(ID, compressed_data, compressed_view);
+      if (error) {
+        return error;
+      }
+      error = decompress_zstd(compressed_view, data);
+      if (error) {
+        return error;
+      }
+#else
+      return Error(heif_error_Unsupported_feature,
+                   heif_suberror_Unsupported_header_compression_method,
+                   encoding);
+#endif
     }
+  }
 
-    m_infe_boxes.insert(std::make_pair(infe_box->get_item_ID(), infe_box));
+  if (read_uncompressed) {
+    return m_iloc_box->read_data(ID, m_input_stream, m_idat_box, data, m_limits);
   }
 
   return Error::Ok;
 }
 
 
-Error HeifFile::parse_heif_sequences()
+Error HeifFile::append_data_from_file_range(std::vector<uint8_t>& out_data, uint64_t offset, uint32_t size) const
 {
-  m_mvhd_box = m_moov_box->get_child_box<Box_mvhd>();
-  if (!m_mvhd_box) {
+  DecodingStageTimer timer(&DecodingStatistics::read_time_us);
+  DecodingStatistics::add(&DecodingStatistics::bytes_read, size);
+
+  auto old_size = out_data.size();
+  out_data.resize(old_size + size);
+
+  bool success = m_input_stream->read_at(offset, out_data.data() + old_size, size);
+  if (!success) {
+    // TODO: error
+  }
+
+  return {};
+}
+
+
+Error HeifFile::read_file_range(uint8_t* out_data, uint64_t offset, uint32_t size) const
+{
+  DecodingStageTimer timer(&DecodingStatistics::read_time_us);
+  DecodingStatistics::add(&DecodingStatistics::bytes_read, size);
+
+  if (!m_input_stream->read_at(offset, out_data, size)) {
     return {heif_error_Invalid_input,
-            heif_suberror_Unspecified,
-            "No mvhd box in image sequence."};
+            heif_suberror_End_of_data,
+            "Cannot read file range"};
   }
 
   return Error::Ok;
 }
 
 
-Error HeifFile::check_for_ref_cycle(heif_item_id ID,
-                                    const std::shared_ptr<Box_iref>& iref_box) const
+Error HeifFile::append_data_from_iloc(heif_item_id ID, std::vector<uint8_t>& out_data, uint64_t offset, uint64_t size) const
 {
-  std::unordered_set<heif_item_id> parent_items;
-  return check_for_ref_cycle_recursion(ID, iref_box, parent_items);
+  const Box_iloc::Item* item = m_iloc_box->find_item(ID);
+  if (!item) {
+    std::stringstream sstr;
+    sstr << "Item with ID " << ID << " has no compressed data";
+
+    return {heif_error_Invalid_input,
+            heif_suberror_No_item_data,
+            sstr.str()};
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::read_time_us);
+
+  size_t old_size = out_data.size();
+  Error error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &out_data, offset, size, m_limits);
+  DecodingStatistics::add(&DecodingStatistics::bytes_read, out_data.size() - old_size);
+
+  return error;
 }
 
 
-Error HeifFile::check_for_ref_cycle_recursion(heif_item_id ID,
-                                    const std::shared_ptr<Box_iref>& iref_box,
-                                    std::unordered_set<heif_item_id>& parent_items) const {
-  if (parent_items.find(ID) != parent_items.end()) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_Item_reference_cycle,
-                 "Image reference cycle");
+Result<uint64_t> HeifFile::get_item_data_size(heif_item_id ID) const
+{
+  const Box_iloc::Item* item = m_iloc_box ? m_iloc_box->find_item(ID) : nullptr;
+  if (!item) {
+    std::stringstream sstr;
+    sstr << "Item with ID " << ID << " has no compressed data";
+
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_No_item_data,
+                 sstr.str()};
   }
-  parent_items.insert(ID);
 
-  std::vector<heif_item_id> image_references = iref_box->get_references(ID, fourcc("dimg"));
-  for (heif_item_id reference_idx : image_references) {
-    Error error = check_for_ref_cycle_recursion(reference_idx, iref_box, parent_items);
-    if (error) {
-      return error;
+  uint64_t size = 0;
+  for (const auto& extent : item->extents) {
+    if (extent.length > MAX_FILE_POS - size) {
+      return Error{heif_error_Invalid_input,
+                   heif_suberror_Security_limit_exceeded,
+                   "iloc data pointers out of allowed range"};
     }
+
+    size += extent.length;
   }
 
-  parent_items.erase(ID);
+  return size;
+}
+
+
+Result<uint64_t> HeifFile::get_available_item_data_size(heif_item_id ID, uint64_t available_file_size) const
+{
+  auto sizeResult = get_item_data_size(ID);
+  if (sizeResult.error) {
+    return sizeResult.error;
+  }
+
+  std::vector<std::pair<uint64_t, uint64_t>> file_ranges;
+  get_item_file_ranges(ID, 0, *sizeResult, file_ranges);
+
+  // Data in the 'idat' box is part of the file header and always available.
+  if (file_ranges.empty()) {
+    return *sizeResult;
+  }
+
+  uint64_t available_size = 0;
+  for (const auto& range : file_ranges) {
+    if (range.second <= available_file_size) {
+      available_size += range.second - range.first;
+    }
+    else {
+      if (range.first < available_file_size) {
+        available_size += available_file_size - range.first;
+      }
+      break;
+    }
+  }
+
+  return available_size;
+}
+
+
+void HeifFile::get_item_file_ranges(heif_item_id ID, uint64_t offset, uint64_t size,
+                                    std::vector<std::pair<uint64_t, uint64_t>>& out_ranges) const
+{
+  if (m_iloc_box) {
+    m_iloc_box->get_file_ranges(ID, offset, size, out_ranges);
+  }
+}
+
+
+std::span<const uint8_t> HeifFile::get_item_data_without_copy(heif_item_id ID) const
+{
+  if (!m_iloc_box) {
+    return {};
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::read_time_us);
+
+  uint64_t size = 0;
+  const uint8_t* data = m_iloc_box->get_direct_data_pointer(ID, m_input_stream, &size);
+  if (!data) {
+    return {};
+  }
+
+  // Let the copying path generate the error message when the data exceeds the security limits.
+  if (m_limits->max_memory_block_size && size > m_limits->max_memory_block_size) {
+    return {};
+  }
+
+  DecodingStatistics::add(&DecodingStatistics::bytes_read, size);
+
+  return {data, static_cast<size_t>(size)};
+}
+
+
+Error HeifFile::get_item_data_view(heif_item_id ID, std::vector<uint8_t>& storage, std::span<const uint8_t>& out_view) const
+{
+  out_view = get_item_data_without_copy(ID);
+  if (!out_view.empty()) {
+    return Error::Ok;
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::read_time_us);
+
+  size_t old_size = storage.size();
+  Error error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &storage, m_limits);
+  DecodingStatistics::add(&DecodingStatistics::bytes_read, storage.size() - old_size);
+  if (error) {
+    return error;
+  }
+
+  out_view = storage;
   return Error::Ok;
 }
 
 
-bool HeifFile::item_exists(heif_item_id ID) const
+std::span<const uint8_t> HeifFile::get_file_range_without_copy(uint64_t offset, uint32_t size) const
 {
-  auto image_iter = m_infe_boxes.find(ID);
-  return image_iter != m_infe_boxes.end();
+  if (size == 0 || offset > MAX_FILE_POS) {
+    return {};
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::read_time_us);
+
+  const uint8_t* data = m_input_stream->get_direct_data_pointer(offset, offset + size);
+  if (!data) {
+    return {};
+  }
+
+  DecodingStatistics::add(&DecodingStatistics::bytes_read, size);
+
+  return {data, size};
 }
 
 
-bool HeifFile::has_item_with_id(heif_item_id ID) const
+std::vector<std::pair<uint64_t, uint64_t>> HeifFile::get_merged_file_ranges(const std::vector<ItemDataRange>& ranges) const
 {
-  auto infe_box = get_infe_box(ID);
-  return infe_box != nullptr;
+  std::vector<std::pair<uint64_t, uint64_t>> file_ranges;
+
+  if (!m_iloc_box) {
+    return file_ranges;
+  }
+
+  for (const auto& range : ranges) {
+    m_iloc_box->get_file_ranges(range.item_id, range.offset, range.size, file_ranges);
+  }
+
+  return merge_file_ranges(std::move(file_ranges));
 }
 
 
-uint32_t HeifFile::get_item_type_4cc(heif_item_id ID) const
+std::vector<std::pair<uint64_t, uint64_t>> HeifFile::merge_file_ranges(std::vector<std::pair<uint64_t, uint64_t>> file_ranges) const
 {
-  auto infe_box = get_infe_box(ID);
-  if (!infe_box) {
-    return 0;
+  if (file_ranges.empty()) {
+    return file_ranges;
+  }
+
+  std::sort(file_ranges.begin(), file_ranges.end());
+
+  std::vector<std::pair<uint64_t, uint64_t>> merged_ranges{file_ranges[0]};
+
+  for (size_t i = 1; i < file_ranges.size(); i++) {
+    if (file_ranges[i].first <= merged_ranges.back().second ||
+        file_ranges[i].first - merged_ranges.back().second <= m_max_read_gap) {
+      merged_ranges.back().second = std::max(merged_ranges.back().second, file_ranges[i].second);
+    }
+    else {
+      merged_ranges.push_back(file_ranges[i]);
+    }
+  }
+
+  return merged_ranges;
+}
+
+
+void HeifFile::preload_item_data_ranges(const std::vector<ItemDataRange>& ranges) const
+{
+  if (!m_input_stream) {
+    return;
   }
 
-  return infe_box->get_item_type_4cc();
+  for (const auto& range : get_merged_file_ranges(ranges)) {
+    if (!m_input_stream->request_range_async(range.first, range.second)) {
+      m_input_stream->preload_range_hint(range.first, range.second);
+    }
+  }
+}
+
+
+void HeifFile::fetch_item_data_ranges(const std::vector<ItemDataRange>& ranges) const
+{
+  if (!m_input_stream) {
+    return;
+  }
+
+  fetch_merged_file_ranges(get_merged_file_ranges(ranges));
+}
+
+
+void HeifFile::fetch_file_ranges(std::vector<std::pair<uint64_t, uint64_t>> file_ranges) const
+{
+  if (!m_input_stream) {
+    return;
+  }
+
+  fetch_merged_file_ranges(merge_file_ranges(std::move(file_ranges)));
+}
+
+
+void HeifFile::fetch_merged_file_ranges(const std::vector<std::pair<uint64_t, uint64_t>>& merged_ranges) const
+{
+  // Only read as much into the cache as it can hold. Otherwise, the first ranges would be evicted again before use.
+  size_t cache_budget = m_data_cache_size;
+
+  for (const auto& range : merged_ranges) {
+    if (m_input_stream->get_direct_data_pointer(range.first, range.second)) {
+      continue;
+    }
+
+    if (range.second - range.first > MAX_FILE_POS) {
+      continue;
+    }
+
+    // Readers that support asynchronous requests answer the request_range() calls of the single items from this request.
+    if (m_input_stream->request_range_async(range.first, range.second)) {
+      continue;
+    }
+
+    auto size = static_cast<size_t>(range.second - range.first);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_input_stream->get_read_mutex());
+#endif
+
+    if (m_input_stream->wait_for_file_size(range.second) != StreamReader::grow_status::size_reached ||
+        m_input_stream->request_range(range.first, range.second) == 0) {
+      continue;
+    }
+
+    // Reading the requested range through the StreamReader_range_cache puts it into the cache.
+    // This is the same as read_at(), but we already hold the read mutex.
+    if (size <= cache_budget) {
+      std::vector<uint8_t> data(size);
+      if (m_input_stream->seek(range.first) && m_input_stream->read(data.data(), size)) {
+        DecodingStatistics::add(&DecodingStatistics::bytes_read, size);
+        cache_budget -= size;
+      }
+    }
+  }
 }
 
 
-std::string HeifFile::get_content_type(heif_item_id ID) const
+bool HeifFile::request_item_data_ranges_async(const std::vector<ItemDataRange>& ranges, std::function<void()> on_completed) const
 {
-  auto infe_box = get_infe_box(ID);
-  if (!infe_box) {
-    return "";
+  if (!m_input_stream) {
+    return false;
   }
 
-  return infe_box->get_content_type();
-}
-
-std::string HeifFile::get_item_uri_type(heif_item_id ID) const
-{
-  auto infe_box = get_infe_box(ID);
-  if (!infe_box) {
-    return "";
+  std::vector<std::pair<uint64_t, uint64_t>> file_ranges = get_merged_file_ranges(ranges);
+  if (file_ranges.empty()) {
+    return false;
   }
 
-  return infe_box->get_item_uri_type();
+  return m_input_stream->request_ranges_async(file_ranges, std::move(on_completed));
 }
 
 
-Error HeifFile::get_properties(heif_item_id imageID,
-                               std::vector<std::shared_ptr<Box>>& properties) const
+static heif_metadata_compression get_content_encoding_compression(const std::string& encoding)
 {
-  if (!m_ipco_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_ipco_box);
+  if (encoding.empty()) {
+    return heif_metadata_compression_off;
   }
-  else if (!m_ipma_box) {
-    return Error(heif_error_Invalid_input,
-                 heif_suberror_No_ipma_box);
+  else if (encoding == "compress_zlib") {
+    return heif_metadata_compression_zlib;
+  }
+  else if (encoding == "deflate") {
+    return heif_metadata_compression_deflate;
+  }
+  else if (encoding == "br") {
+    return heif_metadata_compression_brotli;
+  }
+  else if (encoding == "zstd") {
+    return heif_metadata_compression_zstd;
+  }
+  else {
+    return heif_metadata_compression_unknown;
   }
-
-  return m_ipco_box->get_properties_for_item_ID(imageID, m_ipma_box, properties);
 }
 
 
-Error HeifFile::get_uncompressed_item_data(heif_item_id ID, std::vector<uint8_t>* data) const
+std::span<const uint8_t> HeifFile::get_item_data_without_copy(heif_item_id ID, heif_metadata_compression* out_compression) const
 {
-  assert(m_limits);
-
-#if ENABLE_PARALLEL_TILE_DECODING
-  // std::lock_guard<std::mutex> guard(m_read_mutex);   // TODO: I think that this is not needed anymore because this function is not used for image data anymore.
-#endif
-
-  if (!item_exists(ID)) {
-    return Error(heif_error_Usage_error,
-                 heif_suberror_Nonexisting_item_referenced);
-  }
-
   auto infe_box = get_infe_box(ID);
   if (!infe_box) {
-    return Error(heif_error_Usage_error,
-                 heif_suberror_Nonexisting_item_referenced);
+    return {};
   }
 
+  heif_metadata_compression compression = heif_metadata_compression_off;
+  if (infe_box->get_item_type_4cc() == fourcc("mime")) {
+    compression = get_content_encoding_compression(infe_box->get_content_encoding());
+  }
 
-  uint32_t item_type = infe_box->get_item_type_4cc();
-  std::string content_type = infe_box->get_content_type();
-
-  // --- decompress data
-
-  Error error;
-  bool read_uncompressed = true;
-  if (item_type == fourcc("mime")) {
-    std::string encoding = infe_box->get_content_encoding();
-    if (encoding == "compress_zlib") {
-#if HAVE_ZLIB
-      read_uncompressed = false;
-      std::vector<uint8_t> compressed_data;
-      error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &compressed_data, m_limits);
-      if (error) {
-        return error;
-      }
-      error = decompress_zlib(compressed_data, data);
-      if (error) {
-        return error;
-      }
-#else
-      return Error(heif_error_Unsupported_feature,
-                   heif_suberror_Unsupported_header_compression_method,
-                   encoding);
-#endif
-    }
-    else if (encoding == "deflate") {
-#if HAVE_ZLIB
-      read_uncompressed = false;
-      std::vector<uint8_t> compressed_data;
-      error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &compressed_data, m_limits);
-      if (error) {
-        return error;
-      }
-      error = decompress_deflate(compressed_data, data);
-      if (error) {
-        return error;
-      }
-#else
-      return Error(heif_error_Unsupported_feature,
-                   heif_suberror_Unsupported_header_compression_method,
-                   encoding);
-#endif
-    }
-    else if (encoding == "br") {
-#if HAVE_BROTLI
-      read_uncompressed = false;
-      std::vector<uint8_t> compressed_data;
-      error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &compressed_data, m_limits);
-      if (error) {
-        return error;
-      }
-      error = decompress_brotli(compressed_data, data);
-      if (error) {
-        return error;
-      }
-#else
-      return Error(heif_error_Unsupported_feature,
-                   heif_suberror_Unsupported_header_compression_method,
-                   encoding);
-#endif
-    }
+  // Decompressed data always has to be copied.
+  if (compression != heif_metadata_compression_off && out_compression == nullptr) {
+    return {};
   }
 
-  if (read_uncompressed) {
-    return m_iloc_box->read_data(ID, m_input_stream, m_idat_box, data, m_limits);
+  std::span<const uint8_t> data = get_item_data_without_copy(ID);
+  if (!data.empty() && out_compression) {
+    *out_compression = compression;
   }
 
-  return Error(heif_error_Unsupported_feature, heif_suberror_Unsupported_codec);
+  return data;
 }
 
 
-Error HeifFile::append_data_from_file_range(std::vector<uint8_t>& out_data, uint64_t offset, uint32_t size) const
+heif_metadata_compression HeifFile::get_item_data_compression(heif_item_id ID) const
 {
-  bool success = m_input_stream->seek(offset);
-  if (!success) {
-    // TODO: error
-  }
-
-  auto old_size = out_data.size();
-  out_data.resize(old_size + size);
-
-  success = m_input_stream->read(out_data.data() + old_size, size);
-  if (!success) {
-    // TODO: error
+  auto infe_box = get_infe_box(ID);
+  if (!infe_box || infe_box->get_item_type_4cc() != fourcc("mime")) {
+    return heif_metadata_compression_off;
   }
 
-  return {};
+  return get_content_encoding_compression(infe_box->get_content_encoding());
 }
 
 
-Error HeifFile::append_data_from_iloc(heif_item_id ID, std::vector<uint8_t>& out_data, uint64_t offset, uint64_t size) const
+std::optional<size_t> HeifFile::get_decompressed_item_data_size(heif_item_id ID) const
 {
-  const auto& items = m_iloc_box->get_items();
-  const Box_iloc::Item* item = nullptr;
-  for (const auto& i : items) {
-    if (i.item_ID == ID) {
-      item = &i;
-      break;
+#if HAVE_ZSTD
+  if (get_item_data_compression(ID) == heif_metadata_compression_zstd) {
+    std::vector<uint8_t> compressed_data;
+    std::span<const uint8_t> compressed_view;
+    if (get_item_data_view(ID, compressed_data, compressed_view)) {
+      return std::nullopt;
     }
-  }
-  if (!item) {
-    std::stringstream sstr;
-    sstr << "Item with ID " << ID << " has no compressed data";
 
-    return {heif_error_Invalid_input,
-            heif_suberror_No_item_data,
-            sstr.str()};
+    return get_zstd_decompressed_size(compressed_view);
   }
+#endif
 
-  return m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &out_data, offset, size, m_limits);
+  // zlib, deflate and brotli streams do not store the decompressed size.
+  // Uncompressed data is not handled here because it is read when the file is loaded.
+  return std::nullopt;
 }
 
 
@@ -838,11 +2011,9 @@ Error HeifFile::get_item_data(heif_item_id ID, std::vector<uint8_t>* out_data, h
 
   // --- mime data
 
-  std::string encoding = infe_box->get_content_encoding();
-
-  heif_metadata_compression compression;
+  heif_metadata_compression compression = get_content_encoding_compression(infe_box->get_content_encoding());
 
-  if (encoding.empty()) {
+  if (compression == heif_metadata_compression_off) {
     // shortcut for case of uncompressed mime data
 
     if (out_compression) {
@@ -851,48 +2022,47 @@ Error HeifFile::get_item_data(heif_item_id ID, std::vector<uint8_t>* out_data, h
 
     return m_iloc_box->read_data(ID, m_input_stream, m_idat_box, out_data, m_limits);
   }
-  else if (encoding == "compress_zlib") {
-    compression = heif_metadata_compression_zlib;
-  }
-  else if (encoding == "deflate") {
-    compression = heif_metadata_compression_deflate;
-  }
-  else if (encoding == "br") {
-    compression = heif_metadata_compression_brotli;
-  }
-  else {
-    compression = heif_metadata_compression_unknown;
-  }
-
-  // read compressed data
-
-  std::vector<uint8_t> compressed_data;
-  error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &compressed_data, m_limits);
-  if (error) {
-    return error;
-  }
 
   // return compressed data, if we do not want to have it uncompressed
 
   const bool do_decode = (out_compression == nullptr);
   if (!do_decode) {
+    std::vector<uint8_t> compressed_data;
+    error = m_iloc_box->read_data(ID, m_input_stream, m_idat_box, &compressed_data, m_limits);
+    if (error) {
+      return error;
+    }
+
     *out_compression = compression;
     *out_data = std::move(compressed_data);
     return Error::Ok;
   }
 
+  // read compressed data
+
+  std::vector<uint8_t> compressed_data;
+  std::span<const uint8_t> compressed_view;
+  error = get_item_data_view(ID, compressed_data, compressed_view);
+  if (error) {
+    return error;
+  }
+
   // decompress the data
 
   switch (compression) {
 #if HAVE_ZLIB
     case heif_metadata_compression_zlib:
-      return decompress_zlib(compressed_data, out_data);
+      return decompress_zlib(compressed_view, out_data);
     case heif_metadata_compression_deflate:
-      return decompress_deflate(compressed_data, out_data);
+      return decompress_deflate(compressed_view, out_data);
 #endif
 #if HAVE_BROTLI
     case heif_metadata_compression_brotli:
-      return decompress_brotli(compressed_data, out_data);
+      return decompress_brotli(compressed_view, out_data);
+#endif
+#if HAVE_ZSTD
+    case heif_metadata_compression_zstd:
+      return decompress_zstd(compressed_view, out_data);
 #endif
     default:
       return {heif_error_Unsupported_filetype, heif_suberror_Unsupported_header_compression_method};
@@ -1152,6 +2322,15 @@ Error HeifFile::set_item_data(const std::shared_ptr<Box_infe>& item, const uint8
 #endif
   }
   // TODO: brotli
+  else if (compression == heif_metadata_compression_zstd) {
+#if HAVE_ZSTD
+    data_array = compress_zstd((const uint8_t*) data, size);
+    item->set_content_encoding("zstd");
+#else
+    return Error(heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_header_compression_method);
+#endif
+  }
   else {
     // uncompressed data, plain copy
 
@@ -1163,9 +2342,7 @@ Error HeifFile::set_item_data(const std::shared_ptr<Box_infe>& item, const uint8
 
   // copy the data into the file, store the pointer to it in an iloc box entry
 
-  append_iloc_data(item->get_item_ID(), data_array, 0);
-
-  return Error::Ok;
+  return append_iloc_data(item->get_item_ID(), data_array, 0);
 }
 
 
@@ -1186,21 +2363,90 @@ Error HeifFile::set_precompressed_item_data(const std::shared_ptr<Box_infe>& ite
 
   // copy the data into the file, store the pointer to it in an iloc box entry
 
-  append_iloc_data(item->get_item_ID(), data_array, 0);
+  return append_iloc_data(item->get_item_ID(), data_array, 0);
+}
+
 
-  return Error::Ok;
+Error HeifFile::append_iloc_data(heif_item_id id, const std::vector<uint8_t>& nal_packets, uint8_t construction_method)
+{
+  if (construction_method != 0) {
+    return m_iloc_box->append_data(id, nal_packets, construction_method);
+  }
+
+  Result<uint64_t> posResult = append_mdat_data(nal_packets);
+  if (!posResult) {
+    return posResult.error;
+  }
+
+  return m_iloc_box->append_mdat_extent(id, *posResult, nal_packets.size());
 }
 
 
-void HeifFile::append_iloc_data(heif_item_id id, const std::vector<uint8_t>& nal_packets, uint8_t construction_method)
+Error HeifFile::replace_iloc_data(heif_item_id id, uint64_t offset, const std::vector<uint8_t>& data, uint8_t construction_method)
 {
-  m_iloc_box->append_data(id, nal_packets, construction_method);
+  const Box_iloc::Item* item = m_iloc_box->find_item(id);
+
+  if (construction_method != 0 || !item || item->construction_method != 0 || !m_mdat_data) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Only item data in the 'mdat' box can be replaced"};
+  }
+
+  // map the item data range to the 'mdat' extents
+
+  uint64_t data_start = 0;
+  for (const auto& extent : item->extents) {
+    if (data_start == data.size()) {
+      break;
+    }
+
+    if (offset >= extent.length) {
+      offset -= extent.length;
+      continue;
+    }
+
+    uint64_t write_n = std::min(extent.length - offset, data.size() - data_start);
+
+    if (Error err = m_mdat_data->replace_data(extent.mdat_position + offset, data.data() + data_start, write_n)) {
+      return err;
+    }
+
+    data_start += write_n;
+    offset = 0;
+  }
+
+  if (data_start != data.size()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Replaced data exceeds the item data"};
+  }
+
+  return Error::Ok;
 }
 
 
-void HeifFile::replace_iloc_data(heif_item_id id, uint64_t offset, const std::vector<uint8_t>& data, uint8_t construction_method)
+uint8_t* HeifFile::get_iloc_data_for_writing(heif_item_id id, uint64_t offset, uint64_t size)
 {
-  m_iloc_box->replace_data(id, offset, data, construction_method);
+  const Box_iloc::Item* item = m_iloc_box->find_item(id);
+
+  if (!item || item->construction_method != 0 || !m_mdat_data) {
+    return nullptr;
+  }
+
+  for (const auto& extent : item->extents) {
+    if (offset >= extent.length) {
+      offset -= extent.length;
+      continue;
+    }
+
+    if (size > extent.length - offset) {
+      return nullptr;
+    }
+
+    return m_mdat_data->get_data_for_writing(extent.mdat_position + offset, size);
+  }
+
+  return nullptr;
 }
 
 
@@ -1215,6 +2461,39 @@ void HeifFile::set_primary_item_id(heif_item_id id)
 }
 
 
+Error HeifFile::remove_item(heif_item_id id)
+{
+  auto iter = m_infe_boxes.find(id);
+  if (iter == m_infe_boxes.end()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Nonexisting_item_referenced};
+  }
+
+  if (m_pitm_box && m_pitm_box->get_item_ID() == id) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "The primary item cannot be removed"};
+  }
+
+  m_iinf_box->remove_child_box(iter->second);
+  m_infe_boxes.erase(iter);
+
+  if (m_iloc_box) {
+    m_iloc_box->remove_item(id);
+  }
+
+  if (m_iref_box) {
+    m_iref_box->remove_references_of_item(id);
+  }
+
+  if (m_ipma_box) {
+    m_ipma_box->remove_entries_for_item_ID(id);
+  }
+
+  return Error::Ok;
+}
+
+
 void HeifFile::set_ipco_box(std::shared_ptr<Box_ipco> ipco)
 {
   m_ipco_box = ipco;
@@ -1316,29 +2595,3 @@ std::wstring HeifFile::convert_utf8_path_to_utf16(std::string str)
   return ret;
 }
 #endif
-
-
-Result<size_t> HeifFile::write_mdat(StreamWriter& writer)
-{
-  // --- write mdat box
-
-  size_t mdatSize = m_mdat_data->get_data_size();
-
-  if (mdatSize <= 0xFFFFFFFF - 8) {
-    writer.write32((uint32_t) (mdatSize + 8));
-    writer.write32(fourcc("mdat"));
-  }
-  else {
-    // box size > 4 GB
-
-    writer.write32(1);
-    writer.write32(fourcc("mdat"));
-    writer.write64(mdatSize+8+8);
-  }
-
-  size_t dataStartPos = writer.get_position();
-
-  m_mdat_data->write(writer);
-
-  return dataStartPos;
-}
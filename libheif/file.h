@@ -34,9 +34,12 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <functional>
 #include <unordered_set>
 #include <limits>
+#include <span>
 #include <utility>
+#include <optional>
 #include "mdat_data.h"
 
 #if ENABLE_PARALLEL_TILE_DECODING
@@ -54,6 +57,8 @@ class Box_moov;
 
 class Box_mvhd;
 
+class Box_traf;
+
 
 
 class HeifFile
@@ -73,9 +78,31 @@ public:
 
   Error read_from_memory(const void* data, size_t size, bool copy);
 
+  static Result<std::shared_ptr<StreamReader>> open_file_stream(const char* input_filename);
+
+  Error write_header_index(StreamWriter& writer) const { return m_file_layout->write_header_index(writer); }
+
   bool has_images() const { return m_meta_box != nullptr; }
 
-  bool has_sequences() const { return m_moov_box != nullptr; }
+  // When enabled before read(), the 'moov' box of image sequences is not parsed until load_deferred_moov_box() is called.
+  void set_lazy_box_parsing(bool flag) { m_file_layout->set_defer_moov_parsing(flag); }
+
+  // Size of the first request when reading the file. 0 selects the default.
+  void set_initial_read_size(uint32_t size) { m_file_layout->set_initial_read_size(size); }
+
+  // When set to a non-zero size before read(), the item data read from the file is kept in a cache
+  // of this size (see StreamReader_range_cache).
+  void set_data_cache_size(size_t size) { m_data_cache_size = size; }
+
+  // File ranges of item data that are separated by at most this many bytes are read with a single request.
+  // Has to be set before read().
+  void set_max_read_gap(uint64_t max_gap) { m_max_read_gap = max_gap; }
+
+  bool has_sequences() const { return m_moov_box != nullptr || m_has_deferred_moov_box; }
+
+  bool has_deferred_moov_box() const { return m_has_deferred_moov_box; }
+
+  Error load_deferred_moov_box();
 
   std::shared_ptr<StreamReader> get_reader() { return m_input_stream; }
 
@@ -91,9 +118,47 @@ public:
 
   void set_hdlr_box(std::shared_ptr<Box_hdlr> box) { m_hdlr_box = std::move(box); }
 
-  size_t append_mdat_data(const std::vector<uint8_t>& data);
+  // Selects where the 'mdat' data is kept until the file is written (WriteMode::Floating or WriteMode::TmpFile).
+  // This has to be set before any data is added to the file.
+  Error set_write_mode(FileLayout::WriteMode mode);
+
+  FileLayout::WriteMode get_write_mode() const { return m_write_mode; }
+
+  // Writes the file with a 'mini' box instead of the 'meta' box if the file content can be represented with it.
+  // Has no effect in WriteMode::Streaming.
+  void set_write_mini_format(bool flag) { m_write_mini_format = flag; }
+
+  // The 'mdat' data of these items is written first, in this order. The data of all other items and the remaining
+  // 'mdat' data follow in their original order. Only used in WriteMode::Floating and WriteMode::TmpFile
+  // and for files without sequence tracks, whose samples are referenced from outside of the 'iloc' box.
+  void set_mdat_item_order(std::vector<heif_item_id> order) { m_mdat_item_order = std::move(order); }
+
+  // Switches to WriteMode::Streaming. The 'mdat' data is passed to 'write' as soon as it is added.
+  // The start of the file is reserved for the 'ftyp' box and the 'mdat' header. They are filled in by write().
+  Error start_streaming(OutputWriteFunction write, OutputSeekFunction seek);
+
+  // Switches to WriteMode::Fragmented. The sequence samples are passed to 'write' in movie fragments.
+  // 'ftyp', 'meta' and 'moov' are written before the first fragment. Image data cannot be added in this mode.
+  Error start_fragmented_writing(OutputWriteFunction write);
+
+  bool is_fragmented_file_start_written() const { return m_fragmented_file_start_written; }
 
-  void write(StreamWriter& writer);
+  // Writes a 'moof' box with the track fragment, followed by an 'mdat' box with 'mdat_data'.
+  // The file pointers in 'traf' are relative to the start of 'mdat_data'.
+  Error write_fragment(const std::shared_ptr<Box_traf>& traf, const std::vector<uint8_t>& mdat_data);
+
+  // The movie fragments of a file that has been read.
+  const std::vector<FileLayout::MovieFragment>& get_movie_fragments() const { return m_file_layout->get_movie_fragments(); }
+
+  // returns the position of the data relative to the start of the 'mdat' payload
+  Result<uint64_t> append_mdat_data(const std::vector<uint8_t>& data);
+
+  // Writes the complete file into memory. Not possible in WriteMode::Streaming.
+  Error write(StreamWriter& writer);
+
+  // Passes the file in several parts to 'output'. 'seek' is only needed in WriteMode::Streaming.
+  // In this mode, the same functions as for start_streaming() have to be passed.
+  Error write(const OutputWriteFunction& output, const OutputSeekFunction& seek);
 
   int get_num_images() const { return static_cast<int>(m_infe_boxes.size()); }
 
@@ -117,14 +182,72 @@ public:
 
   Error append_data_from_file_range(std::vector<uint8_t>& out_data, uint64_t offset, uint32_t size) const;
 
+  // Reads the file range into memory provided by the caller.
+  Error read_file_range(uint8_t* out_data, uint64_t offset, uint32_t size) const;
+
   Error append_data_from_iloc(heif_item_id ID, std::vector<uint8_t>& out_data, uint64_t offset, uint64_t size) const;
 
   Error append_data_from_iloc(heif_item_id ID, std::vector<uint8_t>& out_data) const {
     return append_data_from_iloc(ID, out_data, 0, std::numeric_limits<uint64_t>::max());
   }
 
+  // Total size of the item data according to the 'iloc' extents, without reading the data.
+  Result<uint64_t> get_item_data_size(heif_item_id ID) const;
+
+  // Size of the beginning of the item data that is stored below the file position 'available_file_size'.
+  Result<uint64_t> get_available_item_data_size(heif_item_id ID, uint64_t available_file_size) const;
+
+  // Appends the file ranges [start, end) in which the item data range [offset, offset+size) is stored.
+  void get_item_file_ranges(heif_item_id ID, uint64_t offset, uint64_t size,
+                            std::vector<std::pair<uint64_t, uint64_t>>& out_ranges) const;
+
+  // Returns the item data without copying it if the input file is held in memory (or memory-mapped) and
+  // the data is stored in one contiguous range. Returns an empty span if append_data_from_iloc() has to be used.
+  std::span<const uint8_t> get_item_data_without_copy(heif_item_id ID) const;
+
+  std::span<const uint8_t> get_file_range_without_copy(uint64_t offset, uint32_t size) const;
+
+  // Sets 'out_view' to the item data. If it cannot be accessed without copying, it is read into 'storage'.
+  Error get_item_data_view(heif_item_id ID, std::vector<uint8_t>& storage, std::span<const uint8_t>& out_view) const;
+
+  struct ItemDataRange
+  {
+    heif_item_id item_id = 0;
+    uint64_t offset = 0;
+    uint64_t size = std::numeric_limits<uint64_t>::max();
+  };
+
+  // Sends preload hints to the StreamReader for all file ranges that store the given item data ranges.
+  // Adjacent and overlapping ranges are merged so that a network reader can fetch them with few requests.
+  // Readers that support asynchronous range requests start fetching the ranges immediately.
+  void preload_item_data_ranges(const std::vector<ItemDataRange>& ranges) const;
+
+  // Requests the file ranges of the item data asynchronously and calls 'on_completed' when all of them are available.
+  // Returns false if the StreamReader does not support asynchronous requests. 'on_completed' is not called in that case.
+  bool request_item_data_ranges_async(const std::vector<ItemDataRange>& ranges, std::function<void()> on_completed) const;
+
+  // Requests the file ranges of the item data with as few request_range() calls as possible, before the items
+  // are read one by one. When the item data cache is enabled, the merged ranges are also read into the cache,
+  // so that the following item reads do not access the StreamReader at all.
+  // Errors are ignored. They are reported when the items themselves are read.
+  void fetch_item_data_ranges(const std::vector<ItemDataRange>& ranges) const;
+
+  // Like fetch_item_data_ranges(), but for file ranges [start, end), e.g. of sequence samples.
+  void fetch_file_ranges(std::vector<std::pair<uint64_t, uint64_t>> file_ranges) const;
+
   Error get_item_data(heif_item_id ID, std::vector<uint8_t> *out_data, heif_metadata_compression* out_compression) const;
 
+  // Like get_item_data(), but returns the data without copying it. Returns an empty span if this is not possible
+  // because the data is not held in memory in one range, or because it has to be decompressed.
+  std::span<const uint8_t> get_item_data_without_copy(heif_item_id ID, heif_metadata_compression* out_compression) const;
+
+  // Compression method of the item data as stored in the file.
+  heif_metadata_compression get_item_data_compression(heif_item_id ID) const;
+
+  // Size of the decompressed item data if it can be determined without decompressing the data
+  // (e.g. from the zstd frame header).
+  std::optional<size_t> get_decompressed_item_data_size(heif_item_id ID) const;
+
   std::shared_ptr<Box_ftyp> get_ftyp_box() { return m_ftyp_box; }
 
   void init_meta_box() { m_meta_box = std::make_shared<Box_meta>(); }
@@ -211,16 +334,26 @@ public:
 
   Error set_precompressed_item_data(const std::shared_ptr<Box_infe>& item, const uint8_t* data, size_t size, std::string content_encoding);
 
-  void append_iloc_data(heif_item_id id, const std::vector<uint8_t>& nal_packets, uint8_t construction_method);
+  Error append_iloc_data(heif_item_id id, const std::vector<uint8_t>& nal_packets, uint8_t construction_method);
+
+  // Overwrites item data that has been appended before. Only supported for data in the 'mdat' box.
+  Error replace_iloc_data(heif_item_id id, uint64_t offset, const std::vector<uint8_t>& data, uint8_t construction_method = 0);
 
-  void replace_iloc_data(heif_item_id id, uint64_t offset, const std::vector<uint8_t>& data, uint8_t construction_method = 0);
+  // Returns a pointer through which 'size' bytes of item data, starting at 'offset', can be overwritten in place.
+  // Returns nullptr if the range is not held in memory in one piece. Use replace_iloc_data() in that case.
+  uint8_t* get_iloc_data_for_writing(heif_item_id id, uint64_t offset, uint64_t size);
 
   void set_iloc_box(std::shared_ptr<Box_iloc>);
 
   std::shared_ptr<Box_iloc> get_iloc_box() { return m_iloc_box; }
 
+  std::shared_ptr<const Box_iloc> get_iloc_box() const { return m_iloc_box; }
+
   void set_primary_item_id(heif_item_id id);
 
+  // Removes the item and all references to it. The item data is not written into the output file.
+  Error remove_item(heif_item_id id);
+
   void add_iref_reference(heif_item_id from, uint32_t type,
                           const std::vector<heif_item_id>& to);
 
@@ -242,6 +375,15 @@ public:
   std::shared_ptr<Box_mvhd> get_mvhd_box() { return m_mvhd_box; }
 
 private:
+  // Returns the file ranges of the item data ranges, sorted, with overlapping ranges and ranges that are
+  // separated by at most m_max_read_gap bytes merged.
+  std::vector<std::pair<uint64_t, uint64_t>> get_merged_file_ranges(const std::vector<ItemDataRange>& ranges) const;
+
+  std::vector<std::pair<uint64_t, uint64_t>> merge_file_ranges(std::vector<std::pair<uint64_t, uint64_t>> file_ranges) const;
+
+  // Reads the merged file ranges (see fetch_item_data_ranges()).
+  void fetch_merged_file_ranges(const std::vector<std::pair<uint64_t, uint64_t>>& merged_ranges) const;
+
 #if ENABLE_PARALLEL_TILE_DECODING
   mutable std::mutex m_read_mutex;
 #endif
@@ -250,6 +392,9 @@ private:
 
   std::shared_ptr<StreamReader> m_input_stream;
 
+  size_t m_data_cache_size = 0;
+  uint64_t m_max_read_gap = 64 * 1024;
+
   std::vector<std::shared_ptr<Box> > m_top_level_boxes;
 
   std::shared_ptr<Box_ftyp> m_ftyp_box;
@@ -272,16 +417,58 @@ private:
 
   std::map<heif_item_id, std::shared_ptr<Box_infe> > m_infe_boxes;
 
+  FileLayout::WriteMode m_write_mode = FileLayout::WriteMode::Floating;
+  bool m_write_mini_format = false;
+
   std::unique_ptr<MdatData> m_mdat_data;
 
-  // returns the position of the first data byte in the file
-  Result<size_t> write_mdat(StreamWriter& writer);
+  std::vector<heif_item_id> m_mdat_item_order;
+
+  struct MdatRange
+  {
+    uint64_t position;
+    uint64_t size;
+  };
+
+  // Moves the 'iloc' extents to the positions given by m_mdat_item_order.
+  // Returns the ranges of the current 'mdat' data in the new order, or an empty list if the data is not reordered.
+  std::vector<MdatRange> reorder_mdat_extents();
+
+  static void write_mdat_header(StreamWriter& writer, uint64_t mdat_data_size, bool force_64bit_size);
+
+  Error create_mdat_data();
+
+  Error write_file(const OutputWriteFunction& output, const OutputSeekFunction& seek);
+
+  Error write_streaming_file_end(const OutputWriteFunction& output, const OutputSeekFunction& seek);
+
+  // --- WriteMode::Fragmented
+
+  OutputWriteFunction m_fragment_output;
+  uint32_t m_fragment_sequence_number = 0;
+  bool m_fragmented_file_start_written = false;
+
+  // Writes all top-level boxes. 'moov' gets an 'mvex' box that announces the movie fragments.
+  Error write_fragmented_file_start();
+
+#if ENABLE_EXPERIMENTAL_MINI_FORMAT
+  // Returns an error if the file cannot be written with a 'mini' box.
+  Result<std::shared_ptr<Box_mini>> create_mini_box() const;
+#endif
+
+  // When a file that has been read is written again, the data of its items is copied from the input file.
+  bool m_input_item_data_imported = false;
+
+  Error import_input_item_data();
 
   // --- sequences
 
   std::shared_ptr<Box_moov> m_moov_box;
   std::shared_ptr<Box_mvhd> m_mvhd_box;
 
+  bool m_has_deferred_moov_box = false;
+  size_t m_deferred_moov_box_index = 0; // position of the 'moov' box in m_top_level_boxes
+
   const heif_security_limits* m_limits = nullptr;
 
   Error parse_heif_file();
@@ -20,7 +20,12 @@
 
 #include "file_layout.h"
 #include "sequences/seq_boxes.h"
+#include "security_limits.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <limits>
+#include <mutex>
 
 
 FileLayout::FileLayout()
@@ -28,22 +33,23 @@ FileLayout::FileLayout()
   auto ftyp = std::make_shared<Box_ftyp>();
   ftyp->set_output_position(0);
   m_boxes.push_back(ftyp);
-
-  // TODO: these variables are not used yet
-  (void)m_writeMode;
-  (void)m_file_size;
 }
 
 
 Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_security_limits* limits)
 {
   m_boxes.clear();
+  m_header_ranges.clear();
 
   m_stream_reader = stream;
 
+  // Boxes of a previous read() keep their arena alive.
+  m_box_arena = std::make_shared<BoxArena>();
+  BoxArena::Scope arena_scope(m_box_arena);
+
   // --- read initial range, large enough to cover 'ftyp' box
 
-  m_max_length = stream->request_range(0, INITIAL_FTYP_REQUEST);
+  m_max_length = stream->request_range(0, m_initial_read_size);
 
   if (m_max_length < MAXIMUM_BOX_HEADER_SIZE) {
     return {heif_error_Invalid_input,
@@ -51,6 +57,8 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
             "File size too small."};
   }
 
+  m_header_ranges.emplace_back(0, std::min(m_max_length, m_initial_read_size));
+
   // --- read 'ftyp' box header
 
   BitstreamRange ftyp_hdr_range(m_stream_reader, m_max_length);
@@ -101,14 +109,23 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
   bool mini_found = false;
   bool moov_found = false;
 
+  // A 'moof' box is only used when the following 'mdat' box with its sample data is complete.
+  MovieFragment pending_fragment;
+
   for (;;) {
     // TODO: overflow
     uint64_t next_box_header_end = next_box_start + MAXIMUM_BOX_HEADER_SIZE;
     if (next_box_header_end > m_max_length) {
-      m_max_length = stream->request_range(next_box_start, next_box_header_end);
+      // Read ahead, because the next box may be small (e.g. a 'meta' box after a large 'mdat').
+      uint64_t read_ahead_end = next_box_start + std::max(m_initial_read_size, uint64_t{MAXIMUM_BOX_HEADER_SIZE});
+      m_max_length = stream->request_range(next_box_start, read_ahead_end);
     }
 
-    if (next_box_header_end > m_max_length) {
+    auto end_of_input_data = [&]() -> Error {
+      if (m_max_length == next_box_start) {
+        m_file_size = m_max_length;
+      }
+
       if (meta_found || mini_found || moov_found) {
         return Error::Ok;
       }
@@ -117,15 +134,27 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
                 heif_suberror_Unspecified,
                 "Insufficient input data"};
       }
+    };
+
+    // A box at the end of the file may be smaller than the maximum header size (e.g. the 'mdat' of a small fragment).
+    if (next_box_start + MINIMUM_BOX_HEADER_SIZE > m_max_length) {
+      return end_of_input_data();
     }
 
     BitstreamRange box_range(m_stream_reader, next_box_start, m_max_length);
     BoxHeader box_header;
     err = box_header.parse_header(box_range);
     if (err) {
+      if (next_box_header_end > m_max_length) {
+        // incomplete header at the end of the available data
+        return end_of_input_data();
+      }
+
       return err;
     }
 
+    m_header_ranges.emplace_back(next_box_start, next_box_start + box_header.get_header_size());
+
     if (box_header.get_short_type() == fourcc("meta")) {
       const uint64_t meta_box_start = next_box_start;
       if (box_header.get_box_size() == 0) {
@@ -147,6 +176,8 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
                 "Cannot read full meta box"};
       }
 
+      m_header_ranges.emplace_back(meta_box_start, end_of_meta_box);
+
       BitstreamRange meta_box_range(m_stream_reader, meta_box_start, end_of_meta_box);
       std::shared_ptr<Box> meta_box;
       err = Box::read(meta_box_range, &meta_box, limits);
@@ -179,6 +210,8 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
                 heif_suberror_Invalid_mini_box,
                 "Cannot read full mini box"};
       }
+      m_header_ranges.emplace_back(mini_box_start, end_of_mini_box);
+
       BitstreamRange mini_box_range(m_stream_reader, mini_box_start, end_of_mini_box);
       std::shared_ptr<Box> mini_box;
       err = Box::read(mini_box_range, &mini_box, heif_get_global_security_limits());
@@ -194,6 +227,10 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
       }
 
       mini_found = true;
+
+      // The 'mini' box contains all image data. Any following boxes are ignored by HeifFile, hence
+      // we can stop here and do not have to request more data.
+      return Error::Ok;
     }
 #endif
 
@@ -218,17 +255,74 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
                 "Cannot read full moov box"};
       }
 
-      BitstreamRange moov_box_range(m_stream_reader, moov_box_start, end_of_moov_box);
-      std::shared_ptr<Box> moov_box;
-      err = Box::read(moov_box_range, &moov_box, limits);
+      m_header_ranges.emplace_back(moov_box_start, end_of_moov_box);
+
+      if (m_defer_moov_parsing) {
+        m_deferred_moov_box_start = moov_box_start;
+        m_deferred_moov_box_end = end_of_moov_box;
+      }
+      else {
+        BitstreamRange moov_box_range(m_stream_reader, moov_box_start, end_of_moov_box);
+        std::shared_ptr<Box> moov_box;
+        err = Box::read(moov_box_range, &moov_box, limits);
+        if (err) {
+          return err;
+        }
+
+        m_boxes.push_back(moov_box);
+        m_moov_box = std::dynamic_pointer_cast<Box_moov>(moov_box);
+      }
+
+      moov_found = true;
+    }
+
+    if (box_header.get_short_type() == fourcc("moof")) {
+      const uint64_t moof_box_start = next_box_start;
+      uint64_t end_of_moof_box = moof_box_start + box_header.get_box_size();
+      if (box_header.get_box_size() == 0 ||
+          std::numeric_limits<uint64_t>::max() - box_header.get_box_size() < moof_box_start) {
+        return {heif_error_Invalid_input,
+                heif_suberror_Unspecified,
+                "Invalid 'moof' box size"};
+      }
+
+      if (m_max_length < end_of_moof_box) {
+        m_max_length = m_stream_reader->request_range(moof_box_start, end_of_moof_box);
+      }
+
+      if (m_max_length < end_of_moof_box) {
+        // The fragment is still being written.
+        return (meta_found || moov_found) ? Error::Ok : Error{heif_error_Invalid_input,
+                                                              heif_suberror_Unspecified,
+                                                              "Insufficient input data"};
+      }
+
+      m_header_ranges.emplace_back(moof_box_start, end_of_moof_box);
+
+      BitstreamRange moof_box_range(m_stream_reader, moof_box_start, end_of_moof_box);
+      std::shared_ptr<Box> moof_box;
+      err = Box::read(moof_box_range, &moof_box, limits);
       if (err) {
         return err;
       }
 
-      m_boxes.push_back(moov_box);
-      m_moov_box = std::dynamic_pointer_cast<Box_moov>(moov_box);
+      pending_fragment.moof = std::dynamic_pointer_cast<Box_moof>(moof_box);
+      pending_fragment.file_offset = moof_box_start;
+    }
+    else if (box_header.get_short_type() == fourcc("mdat") && pending_fragment.moof) {
+      bool complete = true;
 
-      moov_found = true;
+      if (box_header.get_box_size() != Box::size_until_end_of_file &&
+          box_header.get_box_size() <= std::numeric_limits<uint64_t>::max() - next_box_start) {
+        uint64_t end_of_mdat_box = next_box_start + box_header.get_box_size();
+        complete = (m_stream_reader->request_range(end_of_mdat_box - 1, end_of_mdat_box) >= end_of_mdat_box);
+      }
+
+      if (complete) {
+        m_movie_fragments.push_back(pending_fragment);
+      }
+
+      pending_fragment = {};
     }
 
     uint64_t boxSize = box_header.get_box_size();
@@ -256,13 +350,215 @@ Error FileLayout::read(const std::shared_ptr<StreamReader>& stream, const heif_s
 }
 
 
-void FileLayout::set_write_mode(WriteMode writeMode, const std::shared_ptr<StreamWriter>& writer)
+Result<std::shared_ptr<Box_moov>> FileLayout::read_deferred_moov_box(const heif_security_limits* limits)
+{
+  assert(has_deferred_moov_box());
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_stream_reader->get_read_mutex());
+#endif
+
+  uint64_t moov_box_start = m_deferred_moov_box_start;
+  uint64_t end_of_moov_box = m_deferred_moov_box_end;
+
+  // Only try once, also when parsing fails.
+  m_deferred_moov_box_start = 0;
+  m_deferred_moov_box_end = 0;
+
+  // The data has already been requested in read().
+
+  BoxArena::Scope arena_scope(m_box_arena);
+
+  BitstreamRange moov_box_range(m_stream_reader, moov_box_start, end_of_moov_box);
+  std::shared_ptr<Box> moov_box;
+  Error err = Box::read(moov_box_range, &moov_box, limits);
+  if (err) {
+    return err;
+  }
+
+  m_boxes.push_back(moov_box);
+  m_moov_box = std::dynamic_pointer_cast<Box_moov>(moov_box);
+
+  if (!m_moov_box) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_No_moov_box};
+  }
+
+  return m_moov_box;
+}
+
+
+static const uint8_t header_index_version = 1;
+
+// Number of bytes at the start of the file that are compared with the index when it is read.
+static const size_t header_index_check_size = 64;
+
+
+static uint64_t fnv1a_hash(const uint8_t* data, size_t size)
 {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 0x100000001b3;
+  }
 
+  return hash;
 }
 
 
-Error FileLayout::write(std::shared_ptr<StreamWriter>& stream)
+Error FileLayout::write_header_index(StreamWriter& writer) const
 {
+  if (!m_stream_reader || m_header_ranges.empty()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Header index can only be written for files that have been read"};
+  }
+
+  // --- merge the ranges
+
+  std::vector<std::pair<uint64_t, uint64_t>> ranges = m_header_ranges;
+  std::sort(ranges.begin(), ranges.end());
+
+  std::vector<std::pair<uint64_t, uint64_t>> merged_ranges;
+  merged_ranges.push_back(ranges[0]);
+
+  for (size_t i = 1; i < ranges.size(); i++) {
+    if (ranges[i].first <= merged_ranges.back().second) {
+      merged_ranges.back().second = std::max(merged_ranges.back().second, ranges[i].second);
+    }
+    else {
+      merged_ranges.push_back(ranges[i]);
+    }
+  }
+
+  // --- write ranges with their data
+
+  StreamWriter index;
+  index.write32(fourcc("hidx"));
+  index.write8(header_index_version);
+  index.write64(m_file_size == INVALID_FILE_SIZE ? 0 : m_file_size);
+  index.write32(static_cast<uint32_t>(merged_ranges.size()));
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_stream_reader->get_read_mutex());
+#endif
+
+    for (const auto& range : merged_ranges) {
+      std::vector<uint8_t> data(range.second - range.first);
+
+      if (m_stream_reader->request_range(range.first, range.second) < range.second ||
+          !m_stream_reader->seek(range.first) ||
+          !m_stream_reader->read(data.data(), data.size())) {
+        return {heif_error_Invalid_input,
+                heif_suberror_End_of_data,
+                "Cannot read header data for index"};
+      }
+
+      index.write64(range.first);
+      index.write64(data.size());
+      index.write(data);
+    }
+  }
+
+  const std::vector<uint8_t>& index_data = index.get_data();
+  index.write64(fnv1a_hash(index_data.data(), index_data.size()));
+
+  writer.write(index.get_data());
+
   return Error::Ok;
 }
+
+
+Result<std::shared_ptr<StreamReader>> FileLayout::read_header_index(const uint8_t* data, size_t size,
+                                                                    const std::shared_ptr<StreamReader>& stream)
+{
+  const Error invalid_index_error{heif_error_Invalid_input,
+                                  heif_suberror_Unspecified,
+                                  "Invalid header index"};
+
+  // --- check integrity
+
+  const size_t header_size = 4 + 1 + 8 + 4;
+
+  if (size < header_size + 8) {
+    return invalid_index_error;
+  }
+
+  auto read_be = [](const uint8_t* p, int nBytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < nBytes; i++) {
+      v = (v << 8) | p[i];
+    }
+    return v;
+  };
+
+  if (read_be(data + size - 8, 8) != fnv1a_hash(data, size - 8) ||
+      read_be(data, 4) != fourcc("hidx")) {
+    return invalid_index_error;
+  }
+
+  if (data[4] != header_index_version) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unspecified,
+                 "Unsupported header index version"};
+  }
+
+  // --- read ranges
+
+  uint64_t file_size = read_be(data + 5, 8);
+  auto num_ranges = static_cast<uint32_t>(read_be(data + 13, 4));
+
+  size_t pos = header_size;
+  const size_t end = size - 8;
+
+  std::vector<StreamReader_cached::CachedRange> ranges;
+
+  for (uint32_t i = 0; i < num_ranges; i++) {
+    if (end - pos < 16) {
+      return invalid_index_error;
+    }
+
+    StreamReader_cached::CachedRange range;
+    range.start = read_be(data + pos, 8);
+    uint64_t range_size = read_be(data + pos + 8, 8);
+    pos += 16;
+
+    if (range_size > end - pos || range.start > static_cast<uint64_t>(MAX_FILE_POS)) {
+      return invalid_index_error;
+    }
+
+    range.data.assign(data + pos, data + pos + range_size);
+    pos += range_size;
+
+    ranges.push_back(std::move(range));
+  }
+
+  if (pos != end) {
+    return invalid_index_error;
+  }
+
+  // --- check that the index belongs to this file
+
+  // We only compare the start of the file with a single request. Checking all ranges would cost us
+  // the I/O that we want to save.
+
+  if (ranges.empty() || ranges[0].start != 0) {
+    return invalid_index_error;
+  }
+
+  size_t check_size = std::min(ranges[0].data.size(), header_index_check_size);
+  uint8_t file_data[header_index_check_size];
+
+  if (stream->request_range(0, check_size) < check_size ||
+      !stream->seek(0) ||
+      !stream->read(file_data, check_size) ||
+      memcmp(file_data, ranges[0].data.data(), check_size) != 0) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Unspecified,
+                 "Header index does not match the file"};
+  }
+
+  return std::shared_ptr<StreamReader>(std::make_shared<StreamReader_cached>(stream, std::move(ranges), file_size));
+}
+
@@ -24,6 +24,7 @@
 #include "error.h"
 #include "bitstream.h"
 #include "box.h"
+#include "box_arena.h"
 #if ENABLE_EXPERIMENTAL_MINI_FORMAT
 #include "mini.h"
 #endif
@@ -33,26 +34,52 @@
 
 class Box_moov;
 
+class Box_moof;
+
 
 class FileLayout
 {
 public:
+  // Where the 'mdat' data is kept while a file is created (see HeifFile::set_write_mode()).
   enum class WriteMode {
     Streaming, // 'mdat' data will be written to output immediately
     Floating,  // 'mdat' data will be held in memory until written
-    TmpFile    // 'mdat' data will be written to temporary file and copied into final file
+    TmpFile,   // 'mdat' data will be written to temporary file and copied into final file
+    Fragmented // sequence samples are written in movie fragments ('moof'+'mdat') while they are added
+  };
+
+  struct MovieFragment
+  {
+    std::shared_ptr<Box_moof> moof;
+    uint64_t file_offset = 0; // start of the 'moof' box
   };
 
-  // Generate a file in WriteMode::Floating
   FileLayout();
 
   Error read(const std::shared_ptr<StreamReader>& stream, const heif_security_limits* limits);
 
-  // For WriteMode::Streaming, writer cannot be null.
-  void set_write_mode(WriteMode writeMode, const std::shared_ptr<StreamWriter>& writer = nullptr);
+  // When enabled, read() only requests the 'moov' box data and records its position.
+  // The box is parsed later by read_deferred_moov_box().
+  void set_defer_moov_parsing(bool flag) { m_defer_moov_parsing = flag; }
+
+  // Number of bytes that are requested at the start of the file and for each box header that is not available yet.
+  // With a larger size, network readers can usually get 'ftyp' and 'meta' with the first request. 0 selects the default.
+  void set_initial_read_size(uint32_t size) { m_initial_read_size = (size != 0 ? size : INITIAL_FTYP_REQUEST); }
+
+  bool has_deferred_moov_box() const { return m_deferred_moov_box_end != 0; }
+
+  Result<std::shared_ptr<Box_moov>> read_deferred_moov_box(const heif_security_limits* limits);
+
+  // --- header index
+
+  // Writes the file ranges that read() accessed (the box headers, 'ftyp', 'meta' and 'moov') with their data.
+  // Reading a file through a StreamReader_cached with these ranges does not need any input for the file structure.
+  Error write_header_index(StreamWriter& writer) const;
 
-  // For WriteMode::Streaming, stream must be null.
-  Error write(std::shared_ptr<StreamWriter>& stream);
+  // Checks the integrity of the index and that it matches the start of the file in 'stream'.
+  // Returns a StreamReader_cached that serves the indexed ranges and forwards all other accesses to 'stream'.
+  static Result<std::shared_ptr<StreamReader>> read_header_index(const uint8_t* data, size_t size,
+                                                                 const std::shared_ptr<StreamReader>& stream);
 
 
   // --- access to boxes
@@ -67,12 +94,17 @@ public:
 
   std::shared_ptr<Box_moov> get_moov_box() { return m_moov_box; }
 
-private:
-  WriteMode m_writeMode = WriteMode::Floating;
+  // The boxes parsed by read() are allocated from this arena. It is freed when the last of these boxes is released.
+  const std::shared_ptr<BoxArena>& get_box_arena() const { return m_box_arena; }
+
+  // The movie fragments in file order. Only fragments whose 'mdat' box is completely available are listed,
+  // such that a file can be read while fragments are still appended to it.
+  const std::vector<MovieFragment>& get_movie_fragments() const { return m_movie_fragments; }
 
+private:
   const static uint64_t INVALID_FILE_SIZE = 0xFFFFFFFFFFFFFFFF;
 
-  uint64_t m_file_size = INVALID_FILE_SIZE;
+  uint64_t m_file_size = INVALID_FILE_SIZE; // only known if read() reached the end of the file
 
   // the first one is always 'ftyp'
   std::vector<std::shared_ptr<Box>> m_boxes; // TODO: do we need this ?
@@ -84,13 +116,25 @@ private:
 #endif
   std::shared_ptr<Box_moov> m_moov_box;
 
+  std::vector<MovieFragment> m_movie_fragments;
+
+  uint64_t m_initial_read_size = INITIAL_FTYP_REQUEST;
+
+  bool m_defer_moov_parsing = false;
+  uint64_t m_deferred_moov_box_start = 0;
+  uint64_t m_deferred_moov_box_end = 0;
 
   uint64_t m_max_length = 0; // Length seen so far. It can grow over time.
 
+  // All file ranges [start, end) that have been accessed by read().
+  std::vector<std::pair<uint64_t, uint64_t>> m_header_ranges;
+
   std::shared_ptr<StreamReader> m_stream_reader;
-  std::shared_ptr<StreamWriter> m_stream_writer;
+
+  std::shared_ptr<BoxArena> m_box_arena;
 
   static const uint64_t INITIAL_FTYP_REQUEST = 1024; // should be enough to read ftyp and next box header
+  static const uint16_t MINIMUM_BOX_HEADER_SIZE = 8;
   static const uint16_t MAXIMUM_BOX_HEADER_SIZE = 32;
 };
 
@@ -140,6 +140,7 @@ Error ImageItem_AVC::on_load_file()
   extent.set_from_image_item(get_context()->get_heif_file(), get_id());
 
   m_decoder->set_data_extent(std::move(extent));
+  m_decoder->set_instance_pool(get_context()->get_decoder_instance_pool());
 
   return Error::Ok;
 }
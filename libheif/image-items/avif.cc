@@ -61,11 +61,41 @@ Error ImageItem_AVIF::on_load_file()
   extent.set_from_image_item(get_context()->get_heif_file(), get_id());
 
   m_decoder->set_data_extent(std::move(extent));
+  m_decoder->set_instance_pool(get_context()->get_decoder_instance_pool());
 
   return Error::Ok;
 }
 
 
+uint64_t ImageItem_AVIF::get_incremental_decoding_data_size(uint64_t available_size) const
+{
+  auto a1lx = get_property<Box_a1lx>();
+  if (!a1lx) {
+    return 0;
+  }
+
+  // The size of the last layer is not stored. It extends to the end of the item data.
+
+  uint64_t layers_end = 0;
+  uint64_t decodable_size = 0;
+
+  for (uint32_t layer_size : a1lx->layer_size) {
+    if (layer_size == 0) {
+      break;
+    }
+
+    layers_end += layer_size;
+    if (layers_end > available_size) {
+      break;
+    }
+
+    decodable_size = layers_end;
+  }
+
+  return decodable_size;
+}
+
+
 Result<std::vector<uint8_t>> ImageItem_AVIF::read_bitstream_configuration_data() const
 {
   return m_decoder->read_bitstream_configuration_data();
@@ -48,6 +48,9 @@ public:
 
   Error on_load_file() override;
 
+  // Layered images ('a1lx') can be decoded up to the last layer that is completely available.
+  uint64_t get_incremental_decoding_data_size(uint64_t available_size) const override;
+
 protected:
   Result<std::vector<uint8_t>> read_bitstream_configuration_data() const override;
 
@@ -21,13 +21,20 @@
 #include "grid.h"
 #include "context.h"
 #include "file.h"
+#include "codecs/decoder.h"
+#include "codecs/hevc_enc.h"
+#include "thread_pool.h"
 #include <cstring>
 #include <deque>
-#include <future>
+#include <mutex>
 #include <set>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <libheif/api_structs.h>
 #include "security_limits.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
 
 
 Error ImageGrid::parse(const std::vector<uint8_t>& data)
@@ -221,14 +228,201 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_compressed_image(
     return decode_grid_tile(options, tile_x0, tile_y0);
   }
   else {
-    return decode_full_grid_image(options);
+    // The tiles are placed at full resolution positions.
+    return decode_full_grid_image(get_full_resolution_decoding_options(options));
   }
 }
 
 
-Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(const heif_decoding_options& options) const
+extern heif_color_conversion_options_ext normalize_options(const heif_color_conversion_options_ext* input_options);
+
+bool ImageItem_Grid::can_convert_tiles_separately(const heif_decoding_options& options, const OutputFormat& output_format) const
+{
+  // The tile callback reports the canvas in the decoded format.
+  if (options.on_tile_decoded || output_format.colorspace != heif_colorspace_RGB) {
+    return false;
+  }
+
+  const std::vector<heif_item_id>& image_references = get_grid_tiles();
+  if (image_references.empty()) {
+    return false;
+  }
+
+  std::shared_ptr<const ImageItem> first_tile = get_context()->get_image(image_references[0], true);
+  if (!first_tile || first_tile->get_item_error()) {
+    return false;
+  }
+
+  heif_colorspace tile_colorspace;
+  heif_chroma tile_chroma;
+  if (first_tile->get_coded_image_colorspace(&tile_colorspace, &tile_chroma)) {
+    return false;
+  }
+
+  // Nothing to convert.
+  if (tile_colorspace == output_format.colorspace &&
+      (tile_chroma == output_format.chroma || output_format.chroma == heif_chroma_undefined)) {
+    return false;
+  }
+
+  // Bilinear chroma upsampling interpolates across the tile borders. Converting the tiles separately
+  // would change the pixels along the borders.
+  if (tile_chroma == heif_chroma_420 || tile_chroma == heif_chroma_422) {
+    const heif_color_conversion_options& conversion = options.color_conversion_options;
+    if (!(conversion.only_use_preferred_chroma_algorithm &&
+          conversion.preferred_chroma_upsampling_algorithm == heif_chroma_upsampling_nearest_neighbor)) {
+      return false;
+    }
+  }
+
+  // Dithering and the checkerboard background depend on the pixel position in the image.
+  heif_color_conversion_options_ext options_ext = normalize_options(options.color_conversion_options_ext);
+  if (options_ext.bit_depth_reduction_method == heif_bit_depth_reduction_method_dither ||
+      options_ext.alpha_composition_mode == heif_alpha_composition_mode_checkerboard) {
+    return false;
+  }
+
+  return true;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_compressed_image_converted(const struct heif_decoding_options& options,
+                                                                                          const OutputFormat& output_format) const
 {
-  std::shared_ptr<HeifPixelImage> img; // the decoded image
+  if (!can_convert_tiles_separately(options, output_format)) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  return decode_full_grid_image(get_full_resolution_decoding_options(options), &output_format);
+}
+
+
+Result<bool> ImageItem_Grid::decode_full_image_into(const struct heif_decoding_options& options,
+                                                    const std::shared_ptr<HeifPixelImage>& target) const
+{
+  if (get_alpha_channel() ||
+      options.on_tile_decoded ||
+      (!options.ignore_transformations && has_transformation_properties())) {
+    return false;
+  }
+
+  if (target->get_width() != get_grid_spec().get_width() ||
+      target->get_height() != get_grid_spec().get_height()) {
+    return false;
+  }
+
+  const std::vector<heif_item_id>& image_references = get_grid_tiles();
+  if (image_references.empty()) {
+    return false;
+  }
+
+  std::shared_ptr<const ImageItem> first_tile = get_context()->get_image(image_references[0], true);
+  if (!first_tile || first_tile->get_item_error() ||
+      first_tile->get_alpha_channel() || first_tile->has_coded_alpha_channel()) {
+    return false;
+  }
+
+  heif_colorspace tile_colorspace;
+  heif_chroma tile_chroma;
+  if (first_tile->get_coded_image_colorspace(&tile_colorspace, &tile_chroma)) {
+    return false;
+  }
+
+  OutputFormat output_format{target->get_colorspace(), target->get_chroma_format()};
+  bool convert_tiles = (tile_colorspace != output_format.colorspace || tile_chroma != output_format.chroma);
+
+  if (convert_tiles && !can_convert_tiles_separately(options, output_format)) {
+    return false;
+  }
+
+  // The tiles must end up with the bit depth of the target, otherwise they cannot be pasted.
+
+  bool interleaved = (num_interleaved_pixels_per_plane(output_format.chroma) > 1);
+  heif_channel target_channel = interleaved ? heif_channel_interleaved :
+                                (output_format.colorspace == heif_colorspace_RGB ? heif_channel_R : heif_channel_Y);
+
+  int output_bpp = first_tile->get_luma_bits_per_pixel();
+  if (convert_tiles &&
+      (options.convert_hdr_to_8bit ||
+       output_format.chroma == heif_chroma_interleaved_RGB ||
+       output_format.chroma == heif_chroma_interleaved_RGBA)) {
+    output_bpp = 8;
+  }
+
+  if (target->get_bits_per_pixel(target_channel) != output_bpp) {
+    return false;
+  }
+
+  auto decodeResult = decode_full_grid_image(get_full_resolution_decoding_options(options),
+                                             convert_tiles ? &output_format : nullptr,
+                                             target);
+  if (decodeResult.error) {
+    return decodeResult.error;
+  }
+
+  return true;
+}
+
+
+Error ImageItem_Grid::decode_to_gpu_surfaces(const struct heif_decoding_options& options, heif_gpu_surface_type type,
+                                              uint32_t x0, uint32_t y0, GpuSurfaceList& out_surfaces) const
+{
+  const ImageGrid& grid = get_grid_spec();
+  const std::vector<heif_item_id>& image_references = get_grid_tiles();
+
+  uint32_t tile_width = 0;
+  uint32_t tile_height = 0;
+
+  for (uint32_t y = 0; y < grid.get_rows(); y++) {
+    for (uint32_t x = 0; x < grid.get_columns(); x++) {
+      heif_item_id tileID = image_references[x + y * grid.get_columns()];
+
+      std::shared_ptr<const ImageItem> tileImg = get_context()->get_image(tileID, true);
+      if (!tileImg) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Missing_grid_images,
+                     "Nonexistent grid image referenced"};
+      }
+      if (auto error = tileImg->get_item_error()) {
+        return error;
+      }
+
+      if (x == 0 && y == 0) {
+        tile_width = tileImg->get_width();
+        tile_height = tileImg->get_height();
+      }
+      else if (tileImg->get_width() != tile_width || tileImg->get_height() != tile_height) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Invalid_grid_data,
+                     "Grid tiles have different sizes"};
+      }
+
+      Error err = tileImg->decode_to_gpu_surfaces(options, type, x0 + x * tile_width, y0 + y * tile_height, out_surfaces);
+      if (err) {
+        return err;
+      }
+    }
+  }
+
+  return Error::Ok;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(const heif_decoding_options& options,
+                                                                               const OutputFormat* output_format,
+                                                                               const std::shared_ptr<HeifPixelImage>& canvas) const
+{
+  TileDecodingState state; // contains the decoded image
+  state.image = canvas;
+
+  if (output_format) {
+    // Each tile is converted in the thread that decoded it.
+    state.output_format = output_format;
+    state.conversion_options = options;
+    state.conversion_options_ext = normalize_options(options.color_conversion_options_ext);
+    state.conversion_options_ext.max_threads = 1;
+    state.conversion_options.color_conversion_options_ext = &state.conversion_options_ext;
+  }
 
   const ImageGrid& grid = get_grid_spec();
 
@@ -248,6 +442,17 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
     }
   }
 
+  // --- read the data of all tiles with few requests. The tiles are usually stored contiguously in the file.
+
+  std::vector<HeifFile::ItemDataRange> tile_data_ranges;
+  for (heif_item_id tile_id : image_references) {
+    HeifFile::ItemDataRange range;
+    range.item_id = tile_id;
+    tile_data_ranges.push_back(range);
+  }
+
+  get_file()->fetch_item_data_ranges(tile_data_ranges);
+
   //auto pixi = get_file()->get_property<Box_pixi>(get_id());
 
   const uint32_t w = grid.get_width();
@@ -263,21 +468,16 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
 
 #if ENABLE_PARALLEL_TILE_DECODING
   // remember which tile to put where into the image
-  struct tile_data
-  {
-    heif_item_id tileID;
-    uint32_t x_origin, y_origin;
-  };
+  using tile_data = TilePosition;
 
   std::deque<tile_data> tiles;
   if (get_context()->get_max_decoding_threads() > 0)
     tiles.resize(static_cast<size_t>(grid.get_rows()) * static_cast<size_t>(grid.get_columns()));
-
-  std::deque<std::future<Error> > errs;
 #endif
 
   uint32_t tile_width = 0;
   uint32_t tile_height = 0;
+  int tile_bits_per_pixel = 0;
 
   if (options.start_progress) {
     options.start_progress(heif_progress_step_total, grid.get_rows() * grid.get_columns(), options.progress_user_data);
@@ -286,9 +486,16 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
     options.on_progress(heif_progress_step_total, 0, options.progress_user_data);
   }
 
-  int progress_counter = 0;
   bool cancelled = false;
 
+  // After the deadline, the remaining tiles are skipped. At least one tile is decoded, which creates the canvas.
+  // When decoding into a given canvas, the image is always decoded completely.
+  auto deadline_passed = [&]() {
+    return options.deadline_us != 0 && !canvas && get_monotonic_time_us() >= options.deadline_us;
+  };
+
+  std::vector<std::pair<uint32_t, uint32_t>> skipped_tiles; // tile positions
+
   for (uint32_t y = 0; y < grid.get_rows() && !cancelled; y++) {
     uint32_t x0 = 0;
 
@@ -324,6 +531,7 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
         // remember size of first tile and compare all other tiles against this
         tile_width = src_width;
         tile_height = src_height;
+        tile_bits_per_pixel = tileImg->get_luma_bits_per_pixel();
       }
       else if (src_width != tile_width || src_height != tile_height) {
         return Error{heif_error_Invalid_input,
@@ -345,9 +553,14 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
           }
         }
 
-        err = decode_and_paste_tile_image(tileID, x0, y0, img, options, progress_counter);
-        if (err) {
-          return err;
+        if (state.image && deadline_passed()) {
+          skipped_tiles.emplace_back(x0, y0);
+        }
+        else {
+          err = decode_and_paste_tile_image(tileID, x0, y0, state, options);
+          if (err) {
+            return err;
+          }
         }
       }
 
@@ -360,55 +573,211 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
   }
 
 #if ENABLE_PARALLEL_TILE_DECODING
-  if (get_context()->get_max_decoding_threads() > 0) {
-    // Process all tiles in a set of background threads.
-    // Do not start more than the maximum number of threads.
+  if (get_context()->get_max_decoding_threads() > 0 && !cancelled) {
+    // Decode the tiles with the shared thread pool. Each task takes the next tile that has not been
+    // started yet, so that a slow tile does not hold back the others.
+    // Do not run more tasks in parallel than the maximum number of threads, and not more than
+    // the context's memory budget allows.
+
+    const size_t max_tasks = std::min(tiles.size(), static_cast<size_t>(get_context()->get_max_decoding_threads()));
+
+    DecodingMemoryBudget::Reservation memory_reservation(get_context()->get_decoding_memory_budget(),
+                                                         DecodingMemoryBudget::estimate_tile_memory(tile_width, tile_height, tile_bits_per_pixel),
+                                                         max_tasks,
+                                                         get_context()->get_security_limits()->max_total_memory);
+
+    const size_t num_tasks = memory_reservation.get_num_tasks();
+
+    // The remaining threads are used by the decoder plugins.
+    const heif_decoding_options tile_options = get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), num_tasks);
+
+    // Start the tiles closest to the priority point first.
+
+    std::vector<size_t> tile_order(tiles.size());
+    for (size_t i = 0; i < tile_order.size(); i++) {
+      tile_order[i] = i;
+    }
+
+    if (options.prioritize_tiles_near_point) {
+      auto distance = [&](size_t idx) {
+        int64_t dx = int64_t{tiles[idx].x_origin} + tile_width / 2 - options.tile_priority_x;
+        int64_t dy = int64_t{tiles[idx].y_origin} + tile_height / 2 - options.tile_priority_y;
+        return dx * dx + dy * dy;
+      };
+
+      std::stable_sort(tile_order.begin(), tile_order.end(),
+                       [&](size_t a, size_t b) { return distance(a) < distance(b); });
+    }
+
+    std::vector<Error> tile_errors(tiles.size());
+    std::vector<uint8_t> tile_skipped(tiles.size(), 0);
+    std::atomic<bool> any_tile_decoded{false};
+    std::atomic<size_t> next_tile{0};
+    std::atomic<bool> stop{false};
+    std::atomic<bool> cancel_requested{false};
+    std::mutex cancel_mutex;
+
+    DecodingStatistics* statistics = DecodingStatistics::current();
 
-    while (!tiles.empty() && !cancelled) {
+    auto decode_tiles = [&]() {
+      DecodingStatisticsScope statistics_scope(statistics);
 
-      // If maximum number of threads running, wait until first thread finishes
+      for (;;) {
+        size_t order_idx = next_tile++;
+        if (order_idx >= tiles.size() || stop) {
+          return;
+        }
+
+        size_t idx = tile_order[order_idx];
+
+        if (options.cancel_decoding) {
+          std::lock_guard<std::mutex> lock(cancel_mutex);
+          if (options.cancel_decoding(options.progress_user_data)) {
+            cancel_requested = true;
+            stop = true;
+            return;
+          }
+        }
 
-      if (errs.size() >= (size_t) get_context()->get_max_decoding_threads()) {
-        Error e = errs.front().get();
+        if (any_tile_decoded && deadline_passed()) {
+          tile_skipped[idx] = 1;
+          continue;
+        }
+
+        const tile_data& data = tiles[idx];
+        Error e = decode_and_paste_tile_image(data.tileID, data.x_origin, data.y_origin, state, tile_options);
         if (e) {
-          return e;
+          tile_errors[idx] = e;
+          stop = true;
+        }
+        else {
+          any_tile_decoded = true;
         }
+      }
+    };
+
+    // When the decoder plugin can decode batches of images, each task keeps one decoder session and pushes the
+    // tiles into it in small batches, instead of starting the decoder for each tile.
+    // The batches are small, such that the tasks stay balanced and few decoded tiles are held in memory.
 
-        errs.pop_front();
+    const size_t tiles_per_batch = 4;
+
+    heif_compression_format batch_format = heif_compression_undefined;
+    if (!tiles.empty()) {
+      if (auto firstTile = get_context()->get_image(tiles[0].tileID, true)) {
+        batch_format = firstTile->get_compression_format();
       }
+    }
+
+    bool batch_decoding = (tiles.size() > num_tasks &&
+                           BatchDecoder::supports_batch_decoding(batch_format, tile_options));
 
+    auto decode_tile_batches = [&]() {
+      DecodingStatisticsScope statistics_scope(statistics);
 
-      if (options.cancel_decoding) {
-        if (options.cancel_decoding(options.progress_user_data)) {
-          cancelled = true;
+      BatchDecoder batch;
+      Error e = batch.start(batch_format, tile_options);
+
+      std::vector<TilePosition> batch_tiles;
+      size_t first_idx = 0;
+
+      while (!e) {
+        if (stop) {
+          return;
+        }
+
+        if (options.cancel_decoding) {
+          std::lock_guard<std::mutex> lock(cancel_mutex);
+          if (options.cancel_decoding(options.progress_user_data)) {
+            cancel_requested = true;
+            stop = true;
+            return;
+          }
+        }
+
+        batch_tiles.clear();
+
+        while (batch_tiles.size() < tiles_per_batch) {
+          size_t order_idx = next_tile++;
+          if (order_idx >= tiles.size()) {
+            break;
+          }
+
+          size_t idx = tile_order[order_idx];
+
+          if (any_tile_decoded && deadline_passed()) {
+            tile_skipped[idx] = 1;
+            continue;
+          }
+
+          if (batch_tiles.empty()) {
+            first_idx = idx;
+          }
+
+          batch_tiles.push_back(tiles[idx]);
         }
-      }
 
+        if (batch_tiles.empty()) {
+          return;
+        }
 
-      // Start a new decoding thread
+        e = decode_and_paste_tile_batch(batch, batch_format, batch_tiles, state, tile_options);
+        if (!e) {
+          any_tile_decoded = true;
+        }
+      }
 
-      tile_data data = tiles.front();
-      tiles.pop_front();
+      // The error is reported at the first tile of the batch.
+      tile_errors[first_idx] = e;
+      stop = true;
+    };
 
-      errs.push_back(std::async(std::launch::async,
-                                &ImageItem_Grid::decode_and_paste_tile_image, this,
-                                data.tileID, data.x_origin, data.y_origin, std::ref(img), options,
-                                std::ref(progress_counter)));
+    TaskGroup tasks;
+    for (size_t t = 0; t < num_tasks; t++) {
+      if (batch_decoding) {
+        tasks.run(decode_tile_batches);
+      }
+      else {
+        tasks.run(decode_tiles);
+      }
     }
 
-    // check for decoding errors in remaining tiles
+    tasks.wait();
 
-    while (!errs.empty()) {
-      Error e = errs.front().get();
+    for (const Error& e : tile_errors) {
       if (e) {
         return e;
       }
+    }
+
+    cancelled = cancel_requested;
 
-      errs.pop_front();
+    for (size_t i = 0; i < tiles.size(); i++) {
+      if (tile_skipped[i]) {
+        skipped_tiles.emplace_back(tiles[i].x_origin, tiles[i].y_origin);
+      }
     }
   }
 #endif
 
+  // --- the area of the skipped tiles is black (and transparent)
+
+  if (!skipped_tiles.empty() && !cancelled) {
+    for (heif_channel channel : state.image->get_channel_set()) {
+      uint16_t value = 0;
+      if ((channel == heif_channel_Cb || channel == heif_channel_Cr) &&
+          state.image->get_colorspace() == heif_colorspace_YCbCr) {
+        value = static_cast<uint16_t>(1 << (state.image->get_bits_per_pixel(channel) - 1));
+      }
+
+      for (const auto& [x, y] : skipped_tiles) {
+        state.image->fill_plane_region(channel, value, x, y, tile_width, tile_height);
+      }
+    }
+
+    state.image->set_decoding_fallback(heif_decoding_fallback_partial_image);
+  }
+
   if (options.end_progress) {
     options.end_progress(heif_progress_step_total, options.progress_user_data);
   }
@@ -417,15 +786,125 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_full_grid_image(c
     return Error{heif_error_Canceled, heif_suberror_Unspecified, "Decoding the image was canceled"};
   }
 
+  return state.image;
+}
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_compressed_image_scaled(const struct heif_decoding_options& options,
+                                                                                       uint32_t width, uint32_t height) const
+{
+  const ImageGrid& grid = get_grid_spec();
+
+  const uint32_t grid_width = grid.get_width();
+  const uint32_t grid_height = grid.get_height();
+
+  if (width >= grid_width && height >= grid_height) {
+    return ImageItem::decode_compressed_image_scaled(options, width, height);
+  }
+
+  // Each tile is decoded and scaled into the output image directly. Only one tile at a time is kept at full resolution.
+
+  const std::vector<heif_item_id>& image_references = get_grid_tiles();
+  if (image_references.size() < static_cast<size_t>(grid.get_rows()) * grid.get_columns()) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Missing_grid_images,
+                 "Not enough grid tiles"};
+  }
+
+  if (options.start_progress) {
+    options.start_progress(heif_progress_step_total, grid.get_rows() * grid.get_columns(), options.progress_user_data);
+  }
+
+  std::shared_ptr<HeifPixelImage> img;
+
+  uint32_t tile_width = 0;
+  uint32_t tile_height = 0;
+  int progress_counter = 0;
+
+  for (uint32_t ty = 0; ty < grid.get_rows(); ty++) {
+    for (uint32_t tx = 0; tx < grid.get_columns(); tx++) {
+      if (options.cancel_decoding && options.cancel_decoding(options.progress_user_data)) {
+        return Error{heif_error_Canceled, heif_suberror_Unspecified, "Decoding the image was canceled"};
+      }
+
+      heif_item_id tileID = image_references[ty * grid.get_columns() + tx];
+
+      auto tileItem = get_context()->get_image(tileID, true);
+      if (!tileItem) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Missing_grid_images,
+                     "Nonexistent grid image referenced"};
+      }
+      if (auto error = tileItem->get_item_error()) {
+        return error;
+      }
+
+      auto decodeResult = tileItem->decode_image(get_full_resolution_decoding_options(options), false, 0, 0);
+      if (decodeResult.error) {
+        return decodeResult.error;
+      }
+
+      std::shared_ptr<HeifPixelImage> tile_img = std::move(*decodeResult);
+
+      if (tx == 0 && ty == 0) {
+        tile_width = tile_img->get_width();
+        tile_height = tile_img->get_height();
+
+        if (tile_width < grid_width / grid.get_columns() ||
+            tile_height < grid_height / grid.get_rows()) {
+          return Error{heif_error_Invalid_input,
+                       heif_suberror_Invalid_grid_data,
+                       "Grid tiles do not cover whole image"};
+        }
+
+        img = std::make_shared<HeifPixelImage>();
+        Error err = img->create_clone_image_at_new_size(tile_img, width, height, get_context()->get_security_limits());
+        if (err) {
+          return err;
+        }
+
+        if (img->has_channel(heif_channel_Alpha)) {
+          uint16_t alpha_bpp = img->get_bits_per_pixel(heif_channel_Alpha);
+          img->fill_plane(heif_channel_Alpha, static_cast<uint16_t>((1UL << alpha_bpp) - 1UL));
+        }
+
+        img->forward_all_metadata_from(tile_img);
+      }
+      else if (tile_img->get_width() != tile_width || tile_img->get_height() != tile_height) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Invalid_grid_data,
+                     "Grid tiles have different sizes"};
+      }
+
+      if (tile_img->get_chroma_format() != img->get_chroma_format()) {
+        return Error{heif_error_Invalid_input,
+                     heif_suberror_Wrong_tile_image_chroma_format,
+                     "Image tile has different chroma format than combined image"};
+      }
+
+      Error err = tile_img->paste_scaled_nearest_neighbor_to(img, tx * tile_width, ty * tile_height, grid_width, grid_height);
+      if (err) {
+        return err;
+      }
+
+      if (options.on_progress) {
+        options.on_progress(heif_progress_step_total, ++progress_counter, options.progress_user_data);
+      }
+    }
+  }
+
+  if (options.end_progress) {
+    options.end_progress(heif_progress_step_total, options.progress_user_data);
+  }
+
   return img;
 }
 
+
 Error ImageItem_Grid::decode_and_paste_tile_image(heif_item_id tileID, uint32_t x0, uint32_t y0,
-                                                  std::shared_ptr<HeifPixelImage>& inout_image,
-                                                  const heif_decoding_options& options,
-                                                  int& progress_counter) const
+                                                  TileDecodingState& state,
+                                                  const heif_decoding_options& options) const
 {
-  std::shared_ptr<HeifPixelImage> tile_img;
+  HEIF_TRACE_SCOPE("decode", "grid tile", tileID);
 
   auto tileItem = get_context()->get_image(tileID, true);
   assert(tileItem);
@@ -433,25 +912,252 @@ Error ImageItem_Grid::decode_and_paste_tile_image(heif_item_id tileID, uint32_t
     return error;
   }
 
-  auto decodeResult = tileItem->decode_image(options, false, 0, 0);
+  // Once the canvas exists, the decoder can write the tile into it directly.
+
+  std::shared_ptr<HeifPixelImage> canvas;
+  {
+#if ENABLE_PARALLEL_TILE_DECODING
+    std::lock_guard<std::mutex> lock(state.mutex);
+#endif
+    canvas = state.image;
+  }
+
+  bool decoded_into_canvas = false;
+
+  if (canvas && !state.output_format) {
+    auto intoResult = tileItem->decode_image_into(options, canvas, x0, y0);
+    if (intoResult.error) {
+      return intoResult.error;
+    }
+
+    decoded_into_canvas = std::move(*intoResult);
+  }
+
+  if (!decoded_into_canvas) {
+    Error err = decode_and_copy_tile_image(*tileItem, x0, y0, state, options);
+    if (err) {
+      return err;
+    }
+  }
+
+  report_pasted_tile(*tileItem, x0, y0, state, options);
+
+  return Error::Ok;
+}
+
+
+void ImageItem_Grid::report_pasted_tile(const ImageItem& tileItem, uint32_t x0, uint32_t y0,
+                                        TileDecodingState& state,
+                                        const heif_decoding_options& options) const
+{
+  if (options.on_tile_decoded) {
+    std::shared_ptr<HeifPixelImage> canvas;
+    {
+#if ENABLE_PARALLEL_TILE_DECODING
+      std::lock_guard<std::mutex> lock(state.mutex);
+#endif
+      canvas = state.image;
+    }
+
+    report_decoded_tile(canvas, x0, y0, tileItem.get_width(), tileItem.get_height(), options);
+  }
+
+  if (options.on_progress) {
+#if ENABLE_PARALLEL_TILE_DECODING
+    std::lock_guard<std::mutex> lock(state.mutex);
+#endif
+
+    options.on_progress(heif_progress_step_total, ++state.progress_counter, options.progress_user_data);
+  }
+}
+
+
+Error ImageItem_Grid::decode_and_paste_tile_batch(BatchDecoder& batch, heif_compression_format batch_format,
+                                                  const std::vector<TilePosition>& tiles,
+                                                  TileDecodingState& state,
+                                                  const heif_decoding_options& options) const
+{
+  HEIF_TRACE_SCOPE("decode", "grid tile batch");
+
+  // --- push the coded data of all tiles into the decoder
+
+  std::vector<std::shared_ptr<const ImageItem>> tile_items(tiles.size());
+  size_t num_pushed = 0;
+
+  for (size_t i = 0; i < tiles.size(); i++) {
+    auto tileItem = get_context()->get_image(tiles[i].tileID, true);
+    assert(tileItem);
+    if (auto error = tileItem->get_item_error()) {
+      return error;
+    }
+
+    std::shared_ptr<Decoder> decoder;
+    if (tileItem->get_compression_format() == batch_format) {
+      auto decoderResult = tileItem->get_decoder();
+      if (decoderResult.error) {
+        return decoderResult.error;
+      }
+
+      decoder = std::move(*decoderResult);
+    }
+
+    if (!decoder) {
+      Error err = decode_and_paste_tile_image(tiles[i].tileID, tiles[i].x_origin, tiles[i].y_origin, state, options);
+      if (err) {
+        return err;
+      }
+
+      continue;
+    }
+
+    DataExtent extent;
+    extent.set_from_image_item(get_file(), tiles[i].tileID);
+    decoder->set_data_extent(std::move(extent));
+
+    Error err = batch.push_image(*decoder, i);
+    if (err) {
+      return err;
+    }
+
+    tile_items[i] = tileItem;
+    num_pushed++;
+  }
+
+  if (num_pushed == 0) {
+    return Error::Ok;
+  }
+
+  // --- paste the decoded tiles as they come out of the decoder
+
+  size_t num_pasted = 0;
+
+  for (;;) {
+    uintptr_t i = 0;
+    auto frameResult = batch.get_next_image(&i);
+    if (frameResult.error) {
+      return frameResult.error;
+    }
+
+    if (!*frameResult) {
+      break;
+    }
+
+    if (i >= tiles.size() || !tile_items[i]) {
+      return {heif_error_Decoder_plugin_error,
+              heif_suberror_Unspecified,
+              "Decoder plugin returned an image with an unknown ID"};
+    }
+
+    const TilePosition& tile = tiles[i];
+
+    auto decodeResult = tile_items[i]->decode_image_from_frame(options, std::move(*frameResult));
+    if (decodeResult.error) {
+      return decodeResult.error;
+    }
+
+    Error err = copy_tile_image(std::move(*decodeResult), tile.x_origin, tile.y_origin, state);
+    if (err) {
+      return err;
+    }
+
+    report_pasted_tile(*tile_items[i], tile.x_origin, tile.y_origin, state, options);
+
+    tile_items[i].reset();
+    num_pasted++;
+  }
+
+  if (num_pasted != num_pushed) {
+    return {heif_error_Decoder_plugin_error,
+            heif_suberror_Unspecified,
+            "Decoder plugin did not output all images of the batch"};
+  }
+
+  return Error::Ok;
+}
+
+
+void ImageItem_Grid::report_decoded_tile(const std::shared_ptr<HeifPixelImage>& canvas, uint32_t x0, uint32_t y0,
+                                         uint32_t tile_width, uint32_t tile_height,
+                                         const heif_decoding_options& options) const
+{
+  if (x0 >= canvas->get_width() || y0 >= canvas->get_height()) {
+    return;
+  }
+
+  // The tiles at the right and bottom border may extend beyond the image.
+  uint32_t w = std::min(tile_width, canvas->get_width() - x0);
+  uint32_t h = std::min(tile_height, canvas->get_height() - y0);
+
+  if (w == 0 || h == 0) {
+    return;
+  }
+
+  auto regionResult = canvas->create_view(x0, y0, w, h);
+  if (regionResult.error) {
+    // not aligned to the chroma subsampling
+    regionResult = canvas->crop(x0, x0 + w - 1, y0, y0 + h - 1, get_context()->get_security_limits());
+    if (regionResult.error) {
+      return;
+    }
+  }
+
+  heif_image region;
+  region.image = std::move(*regionResult);
+
+  options.on_tile_decoded(&region, x0, y0, options.progress_user_data);
+}
+
+
+Error ImageItem_Grid::decode_and_copy_tile_image(const ImageItem& tileItem, uint32_t x0, uint32_t y0,
+                                                 TileDecodingState& state,
+                                                 const heif_decoding_options& options) const
+{
+  auto decodeResult = tileItem.decode_image(options, false, 0, 0);
   if (decodeResult.error) {
     return decodeResult.error;
   }
 
-  tile_img = decodeResult.value;
+  return copy_tile_image(std::move(decodeResult.value), x0, y0, state);
+}
+
+
+Error ImageItem_Grid::copy_tile_image(std::shared_ptr<HeifPixelImage> tile_img, uint32_t x0, uint32_t y0,
+                                      TileDecodingState& state) const
+{
+  // --- convert the tile into the output format
+
+  if (state.output_format) {
+    // The color profiles of the grid image are used for the conversion, like for the complete canvas.
+    if (auto nclx = get_color_profile_nclx()) {
+      tile_img->set_color_profile_nclx(nclx);
+    }
+
+    if (auto icc = get_color_profile_icc()) {
+      tile_img->set_color_profile_icc(icc);
+    }
+
+    auto convertResult = get_context()->convert_to_output_colorspace(tile_img, state.output_format->colorspace,
+                                                                     state.output_format->chroma,
+                                                                     state.conversion_options);
+    if (convertResult.error) {
+      return convertResult.error;
+    }
+
+    tile_img = std::move(*convertResult);
+  }
 
   uint32_t w = get_grid_spec().get_width();
   uint32_t h = get_grid_spec().get_height();
 
   // --- generate the image canvas for combining all the tiles
 
-  if (!inout_image) { // this avoids that we normally have to lock a mutex
+  std::shared_ptr<HeifPixelImage> canvas;
+  {
 #if ENABLE_PARALLEL_TILE_DECODING
-    static std::mutex createImageMutex;
-    std::lock_guard<std::mutex> lock(createImageMutex);
+    std::lock_guard<std::mutex> lock(state.mutex);
 #endif
 
-    if (!inout_image) {
+    if (!state.image) {
       auto grid_image = std::make_shared<HeifPixelImage>();
       auto err = grid_image->create_clone_image_at_new_size(tile_img, w, h, get_context()->get_security_limits());
       if (err) {
@@ -470,13 +1176,15 @@ Error ImageItem_Grid::decode_and_paste_tile_image(heif_item_id tileID, uint32_t
 
       grid_image->forward_all_metadata_from(tile_img);
 
-      inout_image = grid_image; // We have to set this at the very end because of the unlocked check to `inout_image` above.
+      state.image = grid_image;
     }
+
+    canvas = state.image;
   }
 
   // --- copy tile into output image
 
-  heif_chroma chroma = inout_image->get_chroma_format();
+  heif_chroma chroma = canvas->get_chroma_format();
 
   if (chroma != tile_img->get_chroma_format()) {
     return {heif_error_Invalid_input,
@@ -485,16 +1193,7 @@ Error ImageItem_Grid::decode_and_paste_tile_image(heif_item_id tileID, uint32_t
   }
 
 
-  inout_image->copy_image_to(tile_img, x0, y0);
-
-  if (options.on_progress) {
-#if ENABLE_PARALLEL_TILE_DECODING
-    static std::mutex progressMutex;
-    std::lock_guard<std::mutex> lock(progressMutex);
-#endif
-
-    options.on_progress(heif_progress_step_total, ++progress_counter, options.progress_user_data);
-  }
+  canvas->copy_image_to(tile_img, x0, y0);
 
   return Error::Ok;
 }
@@ -512,7 +1211,29 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Grid::decode_grid_tile(const h
     return error;
   }
 
-  return tile_item->decode_compressed_image(options, true, tx, ty);
+  // The grid tile is a complete image by itself. Its own tile index is always (0,0).
+  return tile_item->decode_compressed_image(get_full_resolution_decoding_options(options), true, 0, 0);
+}
+
+
+Error ImageItem_Grid::prefetch_tiles(uint32_t tx0, uint32_t ty0, uint32_t tx1, uint32_t ty1) const
+{
+  std::vector<HeifFile::ItemDataRange> ranges;
+
+  for (uint32_t ty = ty0; ty <= ty1; ty++) {
+    for (uint32_t tx = tx0; tx <= tx1; tx++) {
+      uint32_t idx = ty * m_grid_spec.get_columns() + tx;
+      if (idx < m_grid_tile_ids.size()) {
+        HeifFile::ItemDataRange range;
+        range.item_id = m_grid_tile_ids[idx];
+        ranges.push_back(range);
+      }
+    }
+  }
+
+  get_file()->preload_item_data_ranges(ranges);
+
+  return Error::Ok;
 }
 
 
@@ -651,7 +1372,10 @@ Result<std::shared_ptr<ImageItem_Grid>> ImageItem_Grid::add_new_grid_item(HeifCo
 
   ctx->insert_image_item(grid_id, grid_image);
   const int construction_method = 1; // 0=mdat 1=idat
-  file->append_iloc_data(grid_id, grid_data, construction_method);
+  Error err = file->append_iloc_data(grid_id, grid_data, construction_method);
+  if (err) {
+    return err;
+  }
 
   // generate dummy grid item IDs (0)
   std::vector<heif_item_id> tile_ids;
@@ -687,31 +1411,246 @@ Error ImageItem_Grid::add_image_tile(uint32_t tile_x, uint32_t tile_y,
     return encodingResult.error;
   }
 
-  std::shared_ptr<ImageItem> encoded_image = *encodingResult;
+  assign_tile_item(tile_x, tile_y, *encodingResult);
+
+  return Error::Ok;
+}
+
+
+Error ImageItem_Grid::add_precoded_image_tile(uint32_t tile_x, uint32_t tile_y,
+                                              heif_compression_format format,
+                                              std::span<const uint8_t> data)
+{
+  if (format != heif_compression_HEVC) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_codec,
+                 "Only HEVC tiles can be added without encoding"};
+  }
+
+  auto codedResult = Encoder_HEVC::encapsulate_annexb_bitstream(data);
+  if (codedResult.error) {
+    return codedResult.error;
+  }
+
+  auto imageResult = get_context()->add_precoded_image(format, *codedResult);
+  if (imageResult.error) {
+    return imageResult.error;
+  }
+
+  assign_tile_item(tile_x, tile_y, *imageResult);
 
+  return Error::Ok;
+}
+
+
+void ImageItem_Grid::assign_tile_item(uint32_t tile_x, uint32_t tile_y, const std::shared_ptr<ImageItem>& tile_image)
+{
   auto file = get_file();
-  file->get_infe_box(encoded_image->get_id())->set_hidden_item(true); // grid tiles are hidden items
+  file->get_infe_box(tile_image->get_id())->set_hidden_item(true); // grid tiles are hidden items
 
   // Assign tile to grid
   heif_image_tiling tiling = get_heif_image_tiling();
-  file->set_iref_reference(get_id(), fourcc("dimg"), tile_y * tiling.num_columns + tile_x, encoded_image->get_id());
+  file->set_iref_reference(get_id(), fourcc("dimg"), tile_y * tiling.num_columns + tile_x, tile_image->get_id());
 
-  set_grid_tile_id(tile_x, tile_y, encoded_image->get_id());
+  set_grid_tile_id(tile_x, tile_y, tile_image->get_id());
 
   // Add PIXI property (copy from first tile)
-  auto pixi = encoded_image->get_property<Box_pixi>();
+  auto pixi = tile_image->get_property<Box_pixi>();
   add_property(pixi, true);
+}
 
-  return Error::Ok;
+
+Result<std::vector<uint8_t>> ImageItem_Grid::get_annexb_bitstream() const
+{
+  std::vector<uint8_t> annexb;
+  std::vector<uint8_t> previous_parameter_sets;
+
+  for (heif_item_id tileID : m_grid_tile_ids) {
+    auto tileItem = get_context()->get_image(tileID, true);
+    if (!tileItem) {
+      return Error{heif_error_Invalid_input,
+                   heif_suberror_Missing_grid_images,
+                   "Nonexistent grid image referenced"};
+    }
+    if (auto error = tileItem->get_item_error()) {
+      return error;
+    }
+
+    auto decoderResult = tileItem->get_decoder();
+    if (decoderResult.error) {
+      return decoderResult.error;
+    }
+
+    auto parameterSetsResult = (*decoderResult)->read_bitstream_configuration_data();
+    if (parameterSetsResult.error) {
+      return parameterSetsResult.error;
+    }
+
+    bool parameter_sets_changed = (annexb.empty() || *parameterSetsResult != previous_parameter_sets);
+
+    auto tileDataResult = (*decoderResult)->get_annexb_data(parameter_sets_changed);
+    if (tileDataResult.error) {
+      return tileDataResult.error;
+    }
+
+    annexb.insert(annexb.end(), tileDataResult.value.begin(), tileDataResult.value.end());
+    previous_parameter_sets = std::move(parameterSetsResult.value);
+  }
+
+  return annexb;
 }
 
 
+#if ENABLE_MULTITHREADING_SUPPORT
+Result<std::vector<std::shared_ptr<HeifContext::CompressedImage>>>
+ImageItem_Grid::compress_tiles_in_parallel(HeifContext* ctx,
+                                           const std::vector<std::shared_ptr<HeifPixelImage>>& tiles,
+                                           struct heif_encoder* encoder,
+                                           const struct heif_encoding_options& options)
+{
+  const size_t num_tiles = tiles.size();
+  size_t num_threads = std::min(num_tiles, static_cast<size_t>(ctx->get_max_encoding_threads()));
+
+  int thread_budget = ctx->get_encoding_thread_budget();
+  if (thread_budget == 0) {
+    thread_budget = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  if (thread_budget > 0) {
+    num_threads = std::min(num_threads, static_cast<size_t>(thread_budget));
+  }
+
+  // Each thread needs its own encoder instance. The first thread uses the encoder passed in by the user.
+
+  std::vector<std::shared_ptr<heif_encoder>> encoder_copies;
+  for (size_t t = 1; t < num_threads; t++) {
+    auto cloneResult = encoder->clone();
+    if (cloneResult.error) {
+      return cloneResult.error;
+    }
+
+    encoder_copies.push_back(*cloneResult);
+  }
+
+  // Divide the thread budget between the encoders. The user's encoder gets its own setting back at the end.
+
+  int user_encoder_threads = 0;
+  bool restore_user_encoder_threads = false;
+
+  if (thread_budget > 0) {
+    int threads_per_encoder = std::max(1, thread_budget / static_cast<int>(num_threads));
+
+    restore_user_encoder_threads = encoder->get_threads_parameter(&user_encoder_threads);
+    encoder->set_threads_parameter(threads_per_encoder);
+
+    for (auto& encoder_copy : encoder_copies) {
+      encoder_copy->set_threads_parameter(threads_per_encoder);
+    }
+  }
+
+  std::vector<std::shared_ptr<HeifContext::CompressedImage>> compressed_tiles(num_tiles);
+  std::vector<Error> tile_errors(num_tiles);
+
+  if (num_threads == 1) {
+    // With a single encoder, the color conversion of the next tile runs in a second thread while the encoder
+    // codes the current tile. At most two converted tiles are held at a time.
+
+    std::vector<std::shared_ptr<HeifPixelImage>> converted_tiles(num_tiles);
+    std::vector<Error> conversion_errors(num_tiles);
+
+    auto convert_tile = [&](size_t idx) {
+      auto conversionResult = ctx->convert_image_for_encoding(tiles[idx], encoder, options);
+      if (conversionResult.error) {
+        conversion_errors[idx] = conversionResult.error;
+      }
+      else {
+        converted_tiles[idx] = std::move(*conversionResult);
+      }
+    };
+
+    TaskGroup conversion;
+    convert_tile(0);
+
+    for (size_t idx = 0; idx < num_tiles; idx++) {
+      conversion.wait();
+
+      if (conversion_errors[idx]) {
+        tile_errors[idx] = conversion_errors[idx];
+        break;
+      }
+
+      if (idx + 1 < num_tiles) {
+        conversion.run([&convert_tile, idx]() { convert_tile(idx + 1); });
+      }
+
+      auto compressionResult = ctx->compress_image(tiles[idx], encoder, options, heif_image_input_class_normal,
+                                                   converted_tiles[idx]);
+      converted_tiles[idx].reset();
+
+      if (compressionResult.error) {
+        tile_errors[idx] = compressionResult.error;
+        break;
+      }
+
+      compressed_tiles[idx] = std::move(*compressionResult);
+    }
+  }
+  else {
+    std::atomic<size_t> next_tile{0};
+    std::atomic<bool> failed{false};
+
+    auto compress_tiles = [&](heif_encoder* thread_encoder) {
+      for (;;) {
+        size_t idx = next_tile++;
+        if (idx >= num_tiles || failed) {
+          return;
+        }
+
+        auto compressionResult = ctx->compress_image(tiles[idx], thread_encoder, options, heif_image_input_class_normal);
+        if (compressionResult.error) {
+          tile_errors[idx] = compressionResult.error;
+          failed = true;
+        }
+        else {
+          compressed_tiles[idx] = std::move(*compressionResult);
+        }
+      }
+    };
+
+    TaskGroup tasks;
+    for (size_t t = 1; t < num_threads; t++) {
+      heif_encoder* thread_encoder = encoder_copies[t - 1].get();
+      tasks.run([&compress_tiles, thread_encoder]() { compress_tiles(thread_encoder); });
+    }
+
+    compress_tiles(encoder);
+
+    tasks.wait();
+  }
+
+  if (restore_user_encoder_threads) {
+    encoder->set_threads_parameter(user_encoder_threads);
+  }
+
+  for (const Error& err : tile_errors) {
+    if (err) {
+      return err;
+    }
+  }
+
+  return compressed_tiles;
+}
+#endif
+
+
 Result<std::shared_ptr<ImageItem_Grid>> ImageItem_Grid::add_and_encode_full_grid(HeifContext* ctx,
                                                                                  const std::vector<std::shared_ptr<HeifPixelImage>>& tiles,
                                                                                  uint16_t rows,
                                                                                  uint16_t columns,
                                                                                  struct heif_encoder* encoder,
-                                                                                 const struct heif_encoding_options& options)
+                                                                                 const struct heif_encoding_options& options,
+                                                                                 uint32_t output_width,
+                                                                                 uint32_t output_height)
 {
   std::shared_ptr<ImageItem_Grid> griditem;
 
@@ -719,9 +1658,19 @@ Result<std::shared_ptr<ImageItem_Grid>> ImageItem_Grid::add_and_encode_full_grid
 
   ImageGrid grid;
   grid.set_num_tiles(columns, rows);
-  uint32_t tile_width = tiles[0]->get_width(heif_channel_interleaved);
-  uint32_t tile_height = tiles[0]->get_height(heif_channel_interleaved);
-  grid.set_output_size(tile_width * columns, tile_height * rows);
+  uint32_t tile_width = tiles[0]->get_width();
+  uint32_t tile_height = tiles[0]->get_height();
+
+  uint32_t image_width = output_width ? output_width : tile_width * columns;
+  uint32_t image_height = output_height ? output_height : tile_height * rows;
+
+  if (image_width > tile_width * columns || image_height > tile_height * rows) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Grid output size is larger than the area covered by the tiles"};
+  }
+
+  grid.set_output_size(image_width, image_height);
   std::vector<uint8_t> grid_data = grid.write();
 
   auto file = ctx->get_heif_file();
@@ -732,17 +1681,45 @@ Result<std::shared_ptr<ImageItem_Grid>> ImageItem_Grid::add_and_encode_full_grid
 
   std::shared_ptr<Box_pixi> pixi_property;
 
-  for (int i=0; i<rows*columns; i++) {
+  const size_t num_tiles = static_cast<size_t>(rows) * columns;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::vector<std::shared_ptr<HeifContext::CompressedImage>> compressed_tiles;
+
+  if (ctx->get_max_encoding_threads() > 0 && num_tiles > 1) {
+    auto compressionResult = compress_tiles_in_parallel(ctx, tiles, encoder, options);
+    if (compressionResult.error) {
+      return compressionResult.error;
+    }
+
+    compressed_tiles = std::move(compressionResult.value);
+  }
+#endif
+
+  for (size_t i = 0; i < num_tiles; i++) {
     std::shared_ptr<ImageItem> out_tile;
-    auto encodingResult = ctx->encode_image(tiles[i],
-                                            encoder,
-                                            options,
-                                            heif_image_input_class_normal);
+    Result<std::shared_ptr<ImageItem>> encodingResult;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    if (!compressed_tiles.empty()) {
+      // The tiles are added to the file in tile order, independent of the order in which they were compressed.
+      encodingResult = ctx->add_compressed_image(*compressed_tiles[i], encoder);
+      compressed_tiles[i].reset();
+    }
+    else
+#endif
+    {
+      encodingResult = ctx->encode_image(tiles[i],
+                                         encoder,
+                                         options,
+                                         heif_image_input_class_normal);
+    }
+
     if (encodingResult.error) {
       return encodingResult.error;
     }
     else {
-      out_tile = *encodingResult;
+      out_tile = std::move(*encodingResult);
     }
 
     heif_item_id tile_id = out_tile->get_id();
@@ -758,18 +1735,24 @@ Result<std::shared_ptr<ImageItem_Grid>> ImageItem_Grid::add_and_encode_full_grid
 
   heif_item_id grid_id = file->add_new_image(fourcc("grid"));
   griditem = std::make_shared<ImageItem_Grid>(ctx, grid_id);
+  griditem->set_grid_spec(grid);
+  griditem->set_resolution(image_width, image_height);
   ctx->insert_image_item(grid_id, griditem);
   const int construction_method = 1; // 0=mdat 1=idat
-  file->append_iloc_data(grid_id, grid_data, construction_method);
+  Error err = file->append_iloc_data(grid_id, grid_data, construction_method);
+  if (err) {
+    return err;
+  }
 
   // Connect tiles to grid
 
   file->add_iref_reference(grid_id, fourcc("dimg"), tile_ids);
 
-  // Add ISPE property
+  for (size_t i = 0; i < num_tiles; i++) {
+    griditem->set_grid_tile_id(static_cast<uint32_t>(i % columns), static_cast<uint32_t>(i / columns), tile_ids[i]);
+  }
 
-  uint32_t image_width = tile_width * columns;
-  uint32_t image_height = tile_height * rows;
+  // Add ISPE property
 
   auto ispe = std::make_shared<Box_ispe>();
   ispe->set_size(image_width, image_height);
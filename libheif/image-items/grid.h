@@ -22,9 +22,12 @@
 #define LIBHEIF_IMAGEITEM_GRID_H
 
 #include "image_item.h"
+#include "context.h"
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <span>
 
 
 class ImageGrid
@@ -93,12 +96,22 @@ public:
                        const std::shared_ptr<HeifPixelImage>& image,
                        struct heif_encoder* encoder);
 
+  // Adds a tile that has been coded outside of libheif, without re-encoding it.
+  // Currently, only HEVC Annex-B byte streams are supported.
+  Error add_precoded_image_tile(uint32_t tile_x, uint32_t tile_y,
+                                heif_compression_format format,
+                                std::span<const uint8_t> data);
+
+  // When 'output_width' and 'output_height' are 0, the grid image covers all tiles completely.
+  // Otherwise, the tiles at the right and bottom border are cropped to this output size.
   static Result<std::shared_ptr<ImageItem_Grid>> add_and_encode_full_grid(HeifContext* ctx,
                                                                           const std::vector<std::shared_ptr<HeifPixelImage>>& tiles,
                                                                           uint16_t rows,
                                                                           uint16_t columns,
                                                                           struct heif_encoder* encoder,
-                                                                          const struct heif_encoding_options& options);
+                                                                          const struct heif_encoding_options& options,
+                                                                          uint32_t output_width = 0,
+                                                                          uint32_t output_height = 0);
 
 
   // TODO: nclx depends on contained format
@@ -130,9 +143,33 @@ public:
   Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image(const struct heif_decoding_options& options,
                                                                   bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const override;
 
+  // Converts each tile in its decoding thread and copies it into the output canvas.
+  // Only done when converting the tiles separately gives the same result as converting the whole canvas.
+  Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_converted(const struct heif_decoding_options& options,
+                                                                            const OutputFormat& output_format) const override;
+
+  // Pastes the tiles into 'target'. The tiles are decoded into it directly if they are coded in the format of 'target',
+  // otherwise they are converted separately (see decode_compressed_image_converted()).
+  Result<bool> decode_full_image_into(const struct heif_decoding_options& options,
+                                      const std::shared_ptr<HeifPixelImage>& target) const override;
+
+  // The Annex-B byte streams of all tiles in tile order, for decoders that decode the tiles as one mosaic.
+  // Parameter sets are only repeated where they change between tiles.
+  Result<std::vector<uint8_t>> get_annexb_bitstream() const override;
+
+  Error decode_to_gpu_surfaces(const struct heif_decoding_options& options, heif_gpu_surface_type type,
+                               uint32_t x0, uint32_t y0, GpuSurfaceList& out_surfaces) const override;
+
 protected:
+  Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_scaled(const struct heif_decoding_options& options,
+                                                                         uint32_t width, uint32_t height) const override;
+
   Result<std::shared_ptr<Decoder>> get_decoder() const override;
 
+  bool can_decode_tiles_in_parallel() const override { return true; }
+
+  Error prefetch_tiles(uint32_t tx0, uint32_t ty0, uint32_t tx1, uint32_t ty1) const override;
+
 public:
 
   // --- grid specific
@@ -150,6 +187,16 @@ public:
   void get_tile_size(uint32_t& w, uint32_t& h) const override;
 
 private:
+  // Compress all tiles with up to get_max_encoding_threads() threads. The returned images are in tile order.
+  static Result<std::vector<std::shared_ptr<HeifContext::CompressedImage>>>
+  compress_tiles_in_parallel(HeifContext* ctx,
+                             const std::vector<std::shared_ptr<HeifPixelImage>>& tiles,
+                             struct heif_encoder* encoder,
+                             const struct heif_encoding_options& options);
+
+  // Makes the coded image a hidden tile of the grid.
+  void assign_tile_item(uint32_t tile_x, uint32_t tile_y, const std::shared_ptr<ImageItem>& tile_image);
+
   ImageGrid m_grid_spec;
   std::vector<heif_item_id> m_grid_tile_ids;
 
@@ -157,13 +204,67 @@ private:
 
   Error read_grid_spec();
 
-  Result<std::shared_ptr<HeifPixelImage>> decode_full_grid_image(const heif_decoding_options& options) const;
+  // When 'output_format' is set, the tiles are converted into this format before they are copied into the canvas.
+  // When 'canvas' is set, the tiles are pasted into it instead of a newly allocated image.
+  Result<std::shared_ptr<HeifPixelImage>> decode_full_grid_image(const heif_decoding_options& options,
+                                                                 const OutputFormat* output_format = nullptr,
+                                                                 const std::shared_ptr<HeifPixelImage>& canvas = nullptr) const;
+
+  bool can_convert_tiles_separately(const heif_decoding_options& options, const OutputFormat& output_format) const;
 
   Result<std::shared_ptr<HeifPixelImage>> decode_grid_tile(const heif_decoding_options& options, uint32_t tx, uint32_t ty) const;
 
+  // Shared by all threads that decode the tiles of one grid image.
+  // Each decoded image has its own state, so that decoding several images in parallel does not block each other.
+  struct TileDecodingState
+  {
+    std::shared_ptr<HeifPixelImage> image; // the canvas, created from the first decoded tile
+    int progress_counter = 0;
+
+    // format into which the tiles are converted, or NULL to keep the decoded format
+    const OutputFormat* output_format = nullptr;
+    heif_decoding_options conversion_options{};
+    heif_color_conversion_options_ext conversion_options_ext{};
+
+    // protects 'image' and 'progress_counter'
+    std::mutex mutex;
+  };
+
   Error decode_and_paste_tile_image(heif_item_id tileID, uint32_t x0, uint32_t y0,
-                                    std::shared_ptr<HeifPixelImage>& inout_image,
-                                    const heif_decoding_options& options, int& progress_counter) const;
+                                    TileDecodingState& state,
+                                    const heif_decoding_options& options) const;
+
+  struct TilePosition
+  {
+    heif_item_id tileID;
+    uint32_t x_origin, y_origin;
+  };
+
+  // Decodes the tiles with one session of 'batch' and pastes them into the canvas.
+  // Tiles that are not coded in the format of the batch are decoded separately.
+  Error decode_and_paste_tile_batch(class BatchDecoder& batch, heif_compression_format batch_format,
+                                    const std::vector<TilePosition>& tiles,
+                                    TileDecodingState& state,
+                                    const heif_decoding_options& options) const;
+
+  // Calls the tile and progress callbacks after a tile has been pasted into the canvas.
+  void report_pasted_tile(const ImageItem& tileItem, uint32_t x0, uint32_t y0,
+                          TileDecodingState& state,
+                          const heif_decoding_options& options) const;
+
+  // Calls heif_decoding_options::on_tile_decoded with the area of the canvas that has been filled by the tile.
+  void report_decoded_tile(const std::shared_ptr<HeifPixelImage>& canvas, uint32_t x0, uint32_t y0,
+                           uint32_t tile_width, uint32_t tile_height,
+                           const heif_decoding_options& options) const;
+
+  // Decodes the tile into a separate image and copies it into the canvas. Creates the canvas if it does not exist yet.
+  Error decode_and_copy_tile_image(const ImageItem& tileItem, uint32_t x0, uint32_t y0,
+                                   TileDecodingState& state,
+                                   const heif_decoding_options& options) const;
+
+  // Converts the decoded tile into the output format and copies it into the canvas. Creates the canvas if it does not exist yet.
+  Error copy_tile_image(std::shared_ptr<HeifPixelImage> tile_img, uint32_t x0, uint32_t y0,
+                        TileDecodingState& state) const;
 };
 
 
@@ -63,6 +63,7 @@ Error ImageItem_HEVC::on_load_file()
   extent.set_from_image_item(get_context()->get_heif_file(), get_id());
 
   m_decoder->set_data_extent(std::move(extent));
+  m_decoder->set_instance_pool(get_context()->get_decoder_instance_pool());
 
   return Error::Ok;
 }
@@ -86,7 +87,7 @@ std::shared_ptr<class Encoder> ImageItem_HEVC::get_encoder() const
 }
 
 
-void ImageItem_HEVC::set_preencoded_hevc_image(const std::vector<uint8_t>& data)
+Error ImageItem_HEVC::set_preencoded_hevc_image(const std::vector<uint8_t>& data)
 {
   auto hvcC = std::make_shared<Box_hvcC>();
 
@@ -164,7 +165,10 @@ void ImageItem_HEVC::set_preencoded_hevc_image(const std::vector<uint8_t>& data)
             nal_data_with_size[2] = ((nal_data.size() >> 8) & 0xFF);
             nal_data_with_size[3] = ((nal_data.size() >> 0) & 0xFF);
 
-            get_file()->append_iloc_data(get_id(), nal_data_with_size, 0);
+            Error err = get_file()->append_iloc_data(get_id(), nal_data_with_size, 0);
+            if (err) {
+              return err;
+            }
           }
             break;
         }
@@ -178,5 +182,7 @@ void ImageItem_HEVC::set_preencoded_hevc_image(const std::vector<uint8_t>& data)
     }
   }
 
-  get_file()->add_property(get_id(), hvcC, true);
+  add_property(hvcC, true);
+
+  return Error::Ok;
 }
@@ -48,7 +48,7 @@ public:
   Error on_load_file() override;
 
   // currently not used
-  void set_preencoded_hevc_image(const std::vector<uint8_t>& data);
+  Error set_preencoded_hevc_image(const std::vector<uint8_t>& data);
 
 protected:
   Result<std::vector<uint8_t>> read_bitstream_configuration_data() const override;
@@ -77,6 +77,11 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_iden::decode_compressed_image(
     return error;
   }
 
+  if (!decode_tile_only) {
+    // Other derived images may use the same decoded image.
+    return get_context()->decode_derived_image_source(*imgitem, options);
+  }
+
   return imgitem->decode_image(options, decode_tile_only, tile_x0, tile_y0);
 }
 
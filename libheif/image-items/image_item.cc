@@ -36,8 +36,14 @@
 #include "api/libheif/api_structs.h"
 #include "plugin_registry.h"
 #include "security_limits.h"
+#include "thread_pool.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
+#include <mutex>
 #include <cassert>
 #include <cstring>
 //#include <ranges>
@@ -69,8 +75,8 @@ std::shared_ptr<HeifFile> ImageItem::get_file() const
 
 heif_property_id ImageItem::add_property(std::shared_ptr<Box> property, bool essential)
 {
-  // TODO: is this correct? What happens when add_property does deduplicate the property?
   m_properties.push_back(property);
+  m_ispe = get_property_ptr<Box_ispe>();
   return get_file()->add_property(get_id(), property, essential);
 }
 
@@ -78,6 +84,7 @@ heif_property_id ImageItem::add_property(std::shared_ptr<Box> property, bool ess
 heif_property_id ImageItem::add_property_without_deduplication(std::shared_ptr<Box> property, bool essential)
 {
   m_properties.push_back(property);
+  m_ispe = get_property_ptr<Box_ispe>();
   return get_file()->add_property_without_deduplication(get_id(), property, essential);
 }
 
@@ -234,6 +241,8 @@ Result<Encoder::CodedImageData> ImageItem::encode_to_bitstream_and_boxes(const s
                                                                            const struct heif_encoding_options& options,
                                                                            enum heif_image_input_class input_class)
 {
+  HEIF_TRACE_SCOPE("encode", "encode image", get_id());
+
   // === generate compressed image bitstream
 
   Result<Encoder::CodedImageData> encodeResult = encode(image, encoder, options, input_class);
@@ -397,23 +406,47 @@ Error ImageItem::encode_to_item(HeifContext* ctx,
     return codingResult.error;
   }
 
-  Encoder::CodedImageData& codedImage = codingResult.value;
+  return add_coded_image_to_item(ctx, image, codingResult.value, encoder, options);
+}
+
 
+Error ImageItem::add_coded_data_to_item(HeifContext* ctx, const Encoder::CodedImageData& codedImage)
+{
   auto infe_box = ctx->get_heif_file()->add_new_infe_box(get_infe_type());
   heif_item_id image_id = infe_box->get_item_ID();
   set_id(image_id);
 
-  ctx->get_heif_file()->append_iloc_data(image_id, codedImage.bitstream, 0);
+  Error err = ctx->get_heif_file()->append_iloc_data(image_id, codedImage.bitstream, 0);
+  if (err) {
+    return err;
+  }
 
 
   // set item properties
 
-  for (auto& propertyBox : codingResult.value.properties) {
+  for (auto& propertyBox : codedImage.properties) {
     int index = ctx->get_heif_file()->get_ipco_box()->find_or_append_child_box(propertyBox);
     ctx->get_heif_file()->get_ipma_box()->add_property_for_item_ID(image_id, Box_ipma::PropertyAssociation{propertyBox->is_essential(),
                                                                                                            uint16_t(index + 1)});
   }
 
+  return Error::Ok;
+}
+
+
+Error ImageItem::add_coded_image_to_item(HeifContext* ctx,
+                                         const std::shared_ptr<HeifPixelImage>& image,
+                                         const Encoder::CodedImageData& codedImage,
+                                         struct heif_encoder* encoder,
+                                         const struct heif_encoding_options& options)
+{
+  Error err = add_coded_data_to_item(ctx, codedImage);
+  if (err) {
+    return err;
+  }
+
+  heif_item_id image_id = get_id();
+
 
   // MIAF 7.3.6.7
   // This is according to MIAF without Amd2. With Amd2, the restriction has been lifted and the image is MIAF compatible.
@@ -438,29 +471,27 @@ Error ImageItem::encode_to_item(HeifContext* ctx,
 
 bool ImageItem::has_ispe_resolution() const
 {
-  return get_property<Box_ispe>() != nullptr;
+  return m_ispe != nullptr;
 }
 
 uint32_t ImageItem::get_ispe_width() const
 {
-  auto ispe = get_property<Box_ispe>();
-  if (!ispe) {
+  if (!m_ispe) {
     return 0;
   }
   else {
-    return ispe->get_width();
+    return m_ispe->get_width();
   }
 }
 
 
 uint32_t ImageItem::get_ispe_height() const
 {
-  auto ispe = get_property<Box_ispe>();
-  if (!ispe) {
+  if (!m_ispe) {
     return 0;
   }
   else {
-    return ispe->get_height();
+    return m_ispe->get_height();
   }
 }
 
@@ -501,7 +532,7 @@ Error ImageItem::get_coded_image_colorspace(heif_colorspace* out_colorspace, hei
     return decoderResult.error;
   }
 
-  auto decoder = decoderResult.value;
+  auto decoder = std::move(decoderResult.value);
 
   Error err = decoder->get_coded_image_colorspace(out_colorspace, out_chroma);
   if (err) {
@@ -521,7 +552,7 @@ int ImageItem::get_luma_bits_per_pixel() const
     return decoderResult.error;
   }
 
-  auto decoder = decoderResult.value;
+  auto decoder = std::move(decoderResult.value);
 
   return decoder->get_luma_bits_per_pixel();
 }
@@ -534,7 +565,7 @@ int ImageItem::get_chroma_bits_per_pixel() const
     return decoderResult.error;
   }
 
-  auto decoder = decoderResult.value;
+  auto decoder = std::move(decoderResult.value);
 
   return decoder->get_chroma_bits_per_pixel();
 }
@@ -594,15 +625,12 @@ void ImageItem::add_color_profile(const std::shared_ptr<HeifPixelImage>& image,
 
 Error ImageItem::transform_requested_tile_position_to_original_tile_position(uint32_t& tile_x, uint32_t& tile_y) const
 {
-  Result<std::vector<std::shared_ptr<Box>>> propertiesResult = get_properties();
-  if (propertiesResult.error) {
-    return propertiesResult.error;
-  }
+  const std::vector<std::shared_ptr<Box>>& properties = get_properties();
 
   heif_image_tiling tiling = get_heif_image_tiling();
 
-  //for (auto& prop : std::ranges::reverse_view(propertiesResult.value)) {
-  for (auto propIter = propertiesResult.value.rbegin(); propIter != propertiesResult.value.rend(); propIter++) {
+  //for (auto& prop : std::ranges::reverse_view(properties)) {
+  for (auto propIter = properties.rbegin(); propIter != properties.rend(); propIter++) {
     if (auto irot = std::dynamic_pointer_cast<Box_irot>(*propIter)) {
       switch (irot->get_rotation_ccw()) {
         case 90: {
@@ -651,13 +679,145 @@ Error ImageItem::transform_requested_tile_position_to_original_tile_position(uin
 }
 
 
+// Returns the clean aperture crop window of an image with the given size.
+static Error get_clap_crop_window(const std::shared_ptr<Box_clap>& clap, uint32_t img_width, uint32_t img_height,
+                                  uint32_t& out_left, uint32_t& out_top, uint32_t& out_right, uint32_t& out_bottom)
+{
+  int left = clap->left_rounded(img_width);
+  int right = clap->right_rounded(img_width);
+  int top = clap->top_rounded(img_height);
+  int bottom = clap->bottom_rounded(img_height);
+
+  if (left < 0) { left = 0; }
+  if (top < 0) { top = 0; }
+
+  if ((uint32_t) right >= img_width) { right = img_width - 1; }
+  if ((uint32_t) bottom >= img_height) { bottom = img_height - 1; }
+
+  if (left > right ||
+      top > bottom) {
+    return Error(heif_error_Invalid_input,
+                 heif_suberror_Invalid_clean_aperture);
+  }
+
+  out_left = left;
+  out_top = top;
+  out_right = right;
+  out_bottom = bottom;
+
+  return Error::Ok;
+}
+
+
+// A sequence of 'irot' and 'imir' transformations, combined into a rotation followed by an optional horizontal mirroring.
+struct Orientation
+{
+  int rotation_ccw = 0;
+  bool mirror_horizontally = false;
+
+  void rotate_ccw(int angle_degrees)
+  {
+    // A rotation after a mirroring equals the mirroring after the opposite rotation.
+    rotation_ccw = (rotation_ccw + (mirror_horizontally ? 360 - angle_degrees : angle_degrees)) % 360;
+  }
+
+  void mirror(heif_transform_mirror_direction direction)
+  {
+    mirror_horizontally = !mirror_horizontally;
+
+    if (direction == heif_transform_mirror_direction_vertical) {
+      // vertical mirroring = horizontal mirroring + rotation by 180 degrees
+      rotate_ccw(180);
+    }
+  }
+
+  Result<std::shared_ptr<HeifPixelImage>> apply(const std::shared_ptr<HeifPixelImage>& img, const heif_security_limits* limits) const
+  {
+    if (mirror_horizontally && rotation_ccw == 0) {
+      return img->mirror_inplace(heif_transform_mirror_direction_horizontal, limits);
+    }
+    else if (mirror_horizontally && rotation_ccw == 180) {
+      return img->mirror_inplace(heif_transform_mirror_direction_vertical, limits);
+    }
+    else {
+      return img->rotate_ccw_and_mirror(rotation_ccw, mirror_horizontally, limits);
+    }
+  }
+};
+
+
+Result<std::vector<uint8_t>> ImageItem::get_annexb_bitstream() const
+{
+  auto decoderResult = get_decoder();
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  return (*decoderResult)->get_annexb_data(true);
+}
+
+
+Result<heif_orientation> ImageItem::get_exif_orientation() const
+{
+  const std::vector<std::shared_ptr<Box>>& properties = get_properties();
+
+  Orientation orientation;
+
+  for (const auto& property : properties) {
+    if (auto rot = std::dynamic_pointer_cast<Box_irot>(property)) {
+      orientation.rotate_ccw(rot->get_rotation_ccw());
+    }
+    else if (auto mirror = std::dynamic_pointer_cast<Box_imir>(property)) {
+      orientation.mirror(mirror->get_mirror_direction());
+    }
+    else if (std::dynamic_pointer_cast<Box_clap>(property)) {
+      return Error{heif_error_Unsupported_feature,
+                   heif_suberror_Unspecified,
+                   "The clean aperture of the image cannot be expressed as an Exif orientation"};
+    }
+  }
+
+  // Exif orientations mirror after the rotation, which is clockwise.
+  switch (orientation.rotation_ccw) {
+    case 0:
+      return orientation.mirror_horizontally ? heif_orientation_flip_horizontally : heif_orientation_normal;
+    case 90:
+      return orientation.mirror_horizontally ? heif_orientation_rotate_90_cw_then_flip_vertically : heif_orientation_rotate_270_cw;
+    case 180:
+      return orientation.mirror_horizontally ? heif_orientation_flip_vertically : heif_orientation_rotate_180;
+    default:
+      return orientation.mirror_horizontally ? heif_orientation_rotate_90_cw_then_flip_horizontally : heif_orientation_rotate_90_cw;
+  }
+}
+
+
+
 Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image(const struct heif_decoding_options& options,
-                                                                bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const
+                                                                bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0,
+                                                                const OutputFormat* output_format) const
+{
+  return decode_image_internal(options, decode_tile_only, tile_x0, tile_y0, output_format, nullptr);
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image_from_frame(const struct heif_decoding_options& options,
+                                                                           std::shared_ptr<HeifPixelImage> decoded_frame) const
 {
+  return decode_image_internal(options, false, 0, 0, nullptr, std::move(decoded_frame));
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image_internal(const struct heif_decoding_options& options,
+                                                                         bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0,
+                                                                         const OutputFormat* output_format,
+                                                                         std::shared_ptr<HeifPixelImage> decoded_frame) const
+{
+  HEIF_TRACE_SCOPE("decode", decode_tile_only ? "decode tile" : "decode image", get_id());
+
   // --- check whether image size (according to 'ispe') exceeds maximum
 
   if (!decode_tile_only) {
-    auto ispe = get_property<Box_ispe>();
+    const Box_ispe* ispe = m_ispe;
     if (ispe) {
       Error err = check_for_valid_image_size(get_context()->get_security_limits(), ispe->get_width(), ispe->get_height());
       if (err) {
@@ -675,14 +835,90 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image(const struct hei
     }
   }
 
+  // --- reduced-resolution decoding is not possible for tiles and crop windows,
+  //     because their positions are defined on the full-resolution image
+
+  heif_decoding_options item_options = options;
+  if (item_options.target_scale_denominator > 1) {
+    if (decode_tile_only || (options.ignore_transformations == false && get_property_ptr<Box_clap>())) {
+      item_options.target_scale_denominator = 1;
+    }
+  }
+
+  // --- start decoding the alpha channel, if available
+
+  // TODO: this if statement is probably wrong. When we have a tiled image with alpha
+  // channel, then the alpha images should be associated with their respective tiles.
+  // However, the tile images are not part of the m_all_images list.
+  // Fix this, when we have a test image available.
+
+  std::shared_ptr<ImageItem> alpha_image = get_alpha_channel();
+
+  // The progressive decoding data size and the tile callback refer to this image only.
+  heif_decoding_options alpha_options = item_options;
+  alpha_options.max_coded_data_size = 0;
+  alpha_options.max_quality_layers = 0;
+  alpha_options.on_tile_decoded = nullptr;
+
+  Result<std::shared_ptr<HeifPixelImage>> alphaDecodingResult;
+  bool alpha_started = false;
+
+#if ENABLE_PARALLEL_TILE_DECODING
+  // The alpha image is an independent bitstream. Decode it in parallel to the main image.
+  // Declared after everything the task accesses, so that it is waited for before these are destroyed.
+  TaskGroup alpha_task;
+
+  if (alpha_image && get_context()->get_max_decoding_threads() > 1) {
+    item_options = get_decoding_options_with_codec_threads(item_options, get_context()->get_max_decoding_threads(), 2);
+    alpha_options = get_decoding_options_with_codec_threads(alpha_options, get_context()->get_max_decoding_threads(), 2);
+
+    DecodingStatistics* statistics = DecodingStatistics::current();
+
+    alpha_task.run([&, statistics]() {
+      DecodingStatisticsScope statistics_scope(statistics);
+      alphaDecodingResult = alpha_image->decode_image(alpha_options, decode_tile_only, tile_x0, tile_y0);
+    });
+
+    alpha_started = true;
+  }
+#endif
+
+
   // --- decode image
 
-  Result<std::shared_ptr<HeifPixelImage>> decodingResult = decode_compressed_image(options, decode_tile_only, tile_x0, tile_y0);
-  if (decodingResult.error) {
-    return decodingResult.error;
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult;
+
+  // The alpha plane is added before the conversion. Thus, images with alpha are converted afterward.
+  if (output_format && !alpha_image && !decode_tile_only) {
+    decodingResult = decode_compressed_image_converted(item_options, *output_format);
+    if (decodingResult.error) {
+      return decodingResult.error;
+    }
+  }
+
+  // The converted image has the color profile of the conversion output.
+  bool converted = (decodingResult.value != nullptr);
+
+  if (decoded_frame) {
+    decodingResult = std::move(decoded_frame);
+  }
+  else if (!converted) {
+    decodingResult = decode_compressed_image(item_options, decode_tile_only, tile_x0, tile_y0);
+    if (decodingResult.error) {
+      return decodingResult.error;
+    }
   }
 
-  auto img = decodingResult.value;
+  auto img = std::move(decodingResult.value);
+
+  // Derived images like 'iden' already report the denominator of the image they reference.
+  uint8_t scale_denominator = img->get_decoding_scale_denominator();
+  if (item_options.target_scale_denominator > 1 && scale_denominator == 1) {
+    scale_denominator = get_decoding_scale_denominator(img->get_width(), img->get_height());
+  }
+
+  // A 'grid' that missed the deadline reports a partial image.
+  heif_decoding_fallback fallback = img->get_decoding_fallback();
 
   std::shared_ptr<HeifFile> file = m_heif_context->get_heif_file();
 
@@ -692,31 +928,21 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image(const struct hei
   Error error;
 
   if (options.ignore_transformations == false) {
-    Result<std::vector<std::shared_ptr<Box>>> propertiesResult = get_properties();
-    if (propertiesResult.error) {
-      return propertiesResult.error;
-    }
+    const std::vector<std::shared_ptr<Box>>& properties = get_properties();
 
-    const std::vector<std::shared_ptr<Box>>& properties = *propertiesResult;
+    // Consecutive rotations and mirrorings are combined and applied in a single pass.
+    // 'clap' is applied as a zero-copy crop when possible.
+
+    Orientation orientation;
 
     for (const auto& property : properties) {
       if (auto rot = std::dynamic_pointer_cast<Box_irot>(property)) {
-        auto rotateResult = img->rotate_ccw(rot->get_rotation_ccw(), m_heif_context->get_security_limits());
-        if (rotateResult.error) {
-          return error;
-        }
-
-        img = rotateResult.value;
+        orientation.rotate_ccw(rot->get_rotation_ccw());
       }
 
 
       if (auto mirror = std::dynamic_pointer_cast<Box_imir>(property)) {
-        auto mirrorResult = img->mirror_inplace(mirror->get_mirror_direction(),
-                                                get_context()->get_security_limits());
-        if (mirrorResult.error) {
-          return error;
-        }
-        img = mirrorResult.value;
+        orientation.mirror(mirror->get_mirror_direction());
       }
 
 
@@ -724,97 +950,150 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image(const struct hei
         // For tiles decoding, we do not process the 'clap' because this is handled by a shift of the tiling grid.
 
         if (auto clap = std::dynamic_pointer_cast<Box_clap>(property)) {
-          std::shared_ptr<HeifPixelImage> clap_img;
-
-          uint32_t img_width = img->get_width();
-          uint32_t img_height = img->get_height();
-
-          int left = clap->left_rounded(img_width);
-          int right = clap->right_rounded(img_width);
-          int top = clap->top_rounded(img_height);
-          int bottom = clap->bottom_rounded(img_height);
-
-          if (left < 0) { left = 0; }
-          if (top < 0) { top = 0; }
+          auto orientedResult = orientation.apply(img, m_heif_context->get_security_limits());
+          if (orientedResult.error) {
+            return orientedResult.error;
+          }
 
-          if ((uint32_t) right >= img_width) { right = img_width - 1; }
-          if ((uint32_t) bottom >= img_height) { bottom = img_height - 1; }
+          img = std::move(*orientedResult);
+          orientation = {};
 
-          if (left > right ||
-              top > bottom) {
-            return Error(heif_error_Invalid_input,
-                         heif_suberror_Invalid_clean_aperture);
+          uint32_t left, top, right, bottom;
+          error = get_clap_crop_window(clap, img->get_width(), img->get_height(), left, top, right, bottom);
+          if (error) {
+            return error;
           }
 
-          auto cropResult = img->crop(left, right, top, bottom, m_heif_context->get_security_limits());
+          auto cropResult = img->crop_inplace(left, right, top, bottom, m_heif_context->get_security_limits());
           if (cropResult.error) {
             return cropResult.error;
           }
 
-          img = cropResult.value;
+          img = std::move(cropResult.value);
         }
       }
     }
+
+    auto orientedResult = orientation.apply(img, m_heif_context->get_security_limits());
+    if (orientedResult.error) {
+      return orientedResult.error;
+    }
+
+    img = std::move(*orientedResult);
   }
 
 
   // --- add alpha channel, if available
 
-  // TODO: this if statement is probably wrong. When we have a tiled image with alpha
-  // channel, then the alpha images should be associated with their respective tiles.
-  // However, the tile images are not part of the m_all_images list.
-  // Fix this, when we have a test image available.
-
-  std::shared_ptr<ImageItem> alpha_image = get_alpha_channel();
   if (alpha_image) {
-    auto alphaDecodingResult = alpha_image->decode_image(options, decode_tile_only, tile_x0, tile_y0);
+#if ENABLE_PARALLEL_TILE_DECODING
+    alpha_task.wait();
+#endif
+
+    if (!alpha_started) {
+      alphaDecodingResult = alpha_image->decode_image(alpha_options, decode_tile_only, tile_x0, tile_y0);
+    }
+
     if (alphaDecodingResult.error) {
       return alphaDecodingResult.error;
     }
 
-    std::shared_ptr<HeifPixelImage> alpha = alphaDecodingResult.value;
-
-    // TODO: check that sizes are the same and that we have an Y channel
-    // BUT: is there any indication in the standard that the alpha channel should have the same size?
-
-    // TODO: convert in case alpha is decoded as RGB interleaved
-
-    heif_channel channel;
-    switch (alpha->get_colorspace()) {
-      case heif_colorspace_YCbCr:
-      case heif_colorspace_monochrome:
-        channel = heif_channel_Y;
-        break;
-      case heif_colorspace_RGB:
-        channel = heif_channel_R;
-        break;
-      case heif_colorspace_undefined:
-      default:
-        return Error(heif_error_Invalid_input,
-                     heif_suberror_Unsupported_color_conversion);
+    if ((*alphaDecodingResult)->get_decoding_fallback() == heif_decoding_fallback_partial_image) {
+      fallback = heif_decoding_fallback_partial_image;
     }
 
+    error = add_alpha_plane(img, *alphaDecodingResult);
+    if (error) {
+      return error;
+    }
+  }
 
-    // TODO: we should include a decoding option to control whether libheif should automatically scale the alpha channel, and if so, which scaling filter (enum: Off, NN, Bilinear, ...).
-    //       It might also be that a specific output format implies that alpha is scaled (RGBA32). That would favor an enum for the scaling filter option + a bool to switch auto-filtering on.
-    //       But we can only do this when libheif itself doesn't assume anymore that the alpha channel has the same resolution.
+  auto converted_nclx = img->get_color_profile_nclx();
 
-    if ((alpha_image->get_width() != img->get_width()) || (alpha_image->get_height() != img->get_height())) {
-      std::shared_ptr<HeifPixelImage> scaled_alpha;
-      Error err = alpha->scale_nearest_neighbor(scaled_alpha, img->get_width(), img->get_height(), m_heif_context->get_security_limits());
-      if (err) {
-        return err;
-      }
-      alpha = std::move(scaled_alpha);
-    }
-    img->transfer_plane_from_image_as(alpha, channel, heif_channel_Alpha);
+  set_decoded_image_properties(img);
+  img->set_decoding_scale_denominator(scale_denominator);
+  img->set_decoding_fallback(fallback);
 
-    if (is_premultiplied_alpha()) {
-      img->set_premultiplied_alpha(true);
+  if (converted) {
+    img->set_color_profile_nclx(converted_nclx);
+  }
+
+  return img;
+}
+
+
+Error ImageItem::add_alpha_plane(const std::shared_ptr<HeifPixelImage>& img, const std::shared_ptr<HeifPixelImage>& alpha) const
+{
+  return add_alpha_plane(img, alpha, img->get_width(), img->get_height(), 0, 0);
+}
+
+
+Error ImageItem::add_alpha_plane(const std::shared_ptr<HeifPixelImage>& img, const std::shared_ptr<HeifPixelImage>& alpha,
+                                 uint32_t full_width, uint32_t full_height, uint32_t x0, uint32_t y0) const
+{
+  // TODO: convert in case alpha is decoded as RGB interleaved
+
+  heif_channel channel;
+  switch (alpha->get_colorspace()) {
+    case heif_colorspace_YCbCr:
+    case heif_colorspace_monochrome:
+      channel = heif_channel_Y;
+      break;
+    case heif_colorspace_RGB:
+      channel = heif_channel_R;
+      break;
+    case heif_colorspace_undefined:
+    default:
+      return Error(heif_error_Invalid_input,
+                   heif_suberror_Unsupported_color_conversion);
+  }
+
+  // The alpha plane gets the bit depth of the color planes.
+
+  int alpha_bpp = alpha->get_bits_per_pixel(channel);
+  int bpp = alpha_bpp;
+  switch (img->get_colorspace()) {
+    case heif_colorspace_YCbCr:
+    case heif_colorspace_monochrome:
+      bpp = img->has_channel(heif_channel_Y) ? img->get_bits_per_pixel(heif_channel_Y) : alpha_bpp;
+      break;
+    case heif_colorspace_RGB:
+      bpp = img->has_channel(heif_channel_R) ? img->get_bits_per_pixel(heif_channel_R) : alpha_bpp;
+      break;
+    default:
+      break;
+  }
+
+  // TODO: we should include a decoding option to control whether libheif should automatically scale the alpha channel, and if so, which scaling filter (enum: Off, NN, Bilinear, ...).
+  //       It might also be that a specific output format implies that alpha is scaled (RGBA32). That would favor an enum for the scaling filter option + a bool to switch auto-filtering on.
+  //       But we can only do this when libheif itself doesn't assume anymore that the alpha channel has the same resolution.
+
+  if (alpha->get_width(channel) == img->get_width() && alpha->get_height(channel) == img->get_height() &&
+      full_width == img->get_width() && full_height == img->get_height() &&
+      bpp == alpha_bpp) {
+    // the decoded plane can be used without copy
+    img->transfer_plane_from_image_as(alpha, channel, heif_channel_Alpha);
+  }
+  else {
+    // Scale, crop and convert the bit depth in one pass directly into the alpha plane of the output image.
+    Error err = img->copy_new_plane_scaled_from(alpha, channel, heif_channel_Alpha, bpp,
+                                                full_width, full_height, x0, y0,
+                                                m_heif_context->get_security_limits());
+    if (err) {
+      return err;
     }
   }
 
+  if (is_premultiplied_alpha()) {
+    img->set_premultiplied_alpha(true);
+  }
+
+  return Error::Ok;
+}
+
 
+void ImageItem::set_decoded_image_properties(const std::shared_ptr<HeifPixelImage>& img) const
+{
   // --- set color profile
 
   // If there is an NCLX profile in the HEIF/AVIF metadata, use this for the color conversion.
@@ -833,42 +1112,629 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image(const struct hei
 
   // --- attach metadata to image
 
+  // CLLI
+
+  auto clli = get_property_ptr<Box_clli>();
+  if (clli) {
+    img->set_clli(clli->clli);
+  }
+
+  // MDCV
+
+  auto mdcv = get_property_ptr<Box_mdcv>();
+  if (mdcv) {
+    img->set_mdcv(mdcv->mdcv);
+  }
+
+  // PASP
+
+  auto pasp = get_property_ptr<Box_pasp>();
+  if (pasp) {
+    img->set_pixel_ratio(pasp->hSpacing, pasp->vSpacing);
+  }
+
+  // TAI
+
+  auto itai = get_property_ptr<Box_itai>();
+  if (itai) {
+    img->set_tai_timestamp(itai->get_tai_timestamp_packet());
+  }
+}
+
+
+bool ImageItem::has_transformation_properties() const
+{
+  for (const auto& property : get_properties()) {
+    if (dynamic_cast<const Box_irot*>(property.get()) ||
+        dynamic_cast<const Box_imir*>(property.get()) ||
+        dynamic_cast<const Box_clap*>(property.get())) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+Result<bool> ImageItem::decode_image_into(const struct heif_decoding_options& options,
+                                          const std::shared_ptr<HeifPixelImage>& target, uint32_t x0, uint32_t y0) const
+{
+  if (get_compression_format() == heif_compression_undefined || get_alpha_channel()) {
+    return false;
+  }
+
+  const Box_ispe* ispe = m_ispe;
+  if (!ispe) {
+    return false;
+  }
+
+  Error err = check_for_valid_image_size(get_context()->get_security_limits(), ispe->get_width(), ispe->get_height());
+  if (err) {
+    return err;
+  }
+
+  if (options.ignore_transformations == false && has_transformation_properties()) {
+    return false;
+  }
+
+  auto decoderResult = get_decoder();
+  if (decoderResult.error) {
+    return false;
+  }
+
+  auto decoder = std::move(decoderResult.value);
+
+  DataExtent extent;
+  extent.set_from_image_item(get_file(), get_id());
+  decoder->set_data_extent(std::move(extent));
+
+  heif_decoding_options decoder_options = get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), 1);
+
+  return decoder->decode_single_frame_into_image(get_full_resolution_decoding_options(decoder_options), target, x0, y0);
+}
+
+
+uint8_t ImageItem::get_decoding_scale_denominator(uint32_t decoded_width, uint32_t decoded_height) const
+{
+  const Box_ispe* ispe = m_ispe;
+  if (!ispe) {
+    return 1;
+  }
+
+  // The decoders round the reduced size up. Take the smallest denominator that matches.
+  for (uint32_t d = 1; d <= 8; d *= 2) {
+    if ((ispe->get_width() + d - 1) / d == decoded_width &&
+        (ispe->get_height() + d - 1) / d == decoded_height) {
+      return static_cast<uint8_t>(d);
+    }
+  }
+
+  return 1;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image_region(const struct heif_decoding_options& options,
+                                                                       uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+{
+  if (w == 0 || h == 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Decoding region is empty"};
+  }
+
+  if (!has_ispe_resolution()) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unspecified,
+                 "Region decoding requires an 'ispe' property"};
+  }
+
+
+  // --- collect the transformations and the image size before each of them
+
+  struct Transformation
   {
-    auto ipco_box = file->get_ipco_box();
-    auto ipma_box = file->get_ipma_box();
+    std::shared_ptr<Box> property;
+    uint32_t in_width, in_height;
+    uint32_t crop_left = 0, crop_top = 0;
+  };
 
-    // CLLI
+  std::vector<Transformation> transformations;
 
-    auto clli = get_property<Box_clli>();
-    if (clli) {
-      img->set_clli(clli->clli);
+  uint32_t width = get_ispe_width();
+  uint32_t height = get_ispe_height();
+
+  if (options.ignore_transformations == false) {
+    const std::vector<std::shared_ptr<Box>>& properties = get_properties();
+
+    for (const auto& property : properties) {
+      if (auto rot = std::dynamic_pointer_cast<Box_irot>(property)) {
+        transformations.push_back({property, width, height});
+
+        if (rot->get_rotation_ccw() == 90 || rot->get_rotation_ccw() == 270) {
+          std::swap(width, height);
+        }
+      }
+      else if (std::dynamic_pointer_cast<Box_imir>(property)) {
+        transformations.push_back({property, width, height});
+      }
+      else if (auto clap = std::dynamic_pointer_cast<Box_clap>(property)) {
+        uint32_t left, top, right, bottom;
+        Error err = get_clap_crop_window(clap, width, height, left, top, right, bottom);
+        if (err) {
+          return err;
+        }
+
+        transformations.push_back({property, width, height, left, top});
+
+        width = right - left + 1;
+        height = bottom - top + 1;
+      }
     }
+  }
+
+  if (x0 >= width || y0 >= height ||
+      w > width - x0 || h > height - y0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Decoding region is outside of the image"};
+  }
+
+
+  // --- map the region back into the coded image
+
+  uint32_t rx = x0, ry = y0, rw = w, rh = h;
 
-    // MDCV
+  for (auto iter = transformations.rbegin(); iter != transformations.rend(); ++iter) {
+    if (auto rot = std::dynamic_pointer_cast<Box_irot>(iter->property)) {
+      uint32_t new_x = rx, new_y = ry;
 
-    auto mdcv = get_property<Box_mdcv>();
-    if (mdcv) {
-      img->set_mdcv(mdcv->mdcv);
+      switch (rot->get_rotation_ccw()) {
+        case 90:
+          new_x = iter->in_width - (ry + rh);
+          new_y = rx;
+          std::swap(rw, rh);
+          break;
+        case 180:
+          new_x = iter->in_width - (rx + rw);
+          new_y = iter->in_height - (ry + rh);
+          break;
+        case 270:
+          new_x = ry;
+          new_y = iter->in_height - (rx + rw);
+          std::swap(rw, rh);
+          break;
+        default:
+          break;
+      }
+
+      rx = new_x;
+      ry = new_y;
+    }
+    else if (auto mirror = std::dynamic_pointer_cast<Box_imir>(iter->property)) {
+      if (mirror->get_mirror_direction() == heif_transform_mirror_direction_horizontal) {
+        rx = iter->in_width - (rx + rw);
+      }
+      else {
+        ry = iter->in_height - (ry + rh);
+      }
+    }
+    else {
+      // clap
+      rx += iter->crop_left;
+      ry += iter->crop_top;
     }
+  }
+
+
+  // --- decode region of the coded image
+
+  auto decodingResult = decode_compressed_image_region(get_full_resolution_decoding_options(options), rx, ry, rw, rh);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
 
-    // PASP
+  std::shared_ptr<HeifPixelImage> img = std::move(*decodingResult);
 
-    auto pasp = get_property<Box_pasp>();
-    if (pasp) {
-      img->set_pixel_ratio(pasp->hSpacing, pasp->vSpacing);
+
+  // --- apply rotation and mirroring to the region ('clap' is already covered by the region position)
+
+  Orientation orientation;
+
+  for (const auto& transformation : transformations) {
+    if (auto rot = std::dynamic_pointer_cast<Box_irot>(transformation.property)) {
+      orientation.rotate_ccw(rot->get_rotation_ccw());
+    }
+    else if (auto mirror = std::dynamic_pointer_cast<Box_imir>(transformation.property)) {
+      orientation.mirror(mirror->get_mirror_direction());
+    }
+  }
+
+  auto orientedResult = orientation.apply(img, m_heif_context->get_security_limits());
+  if (orientedResult.error) {
+    return orientedResult.error;
+  }
+
+  img = std::move(*orientedResult);
+
+
+  // --- add alpha channel, if available
+
+  std::shared_ptr<ImageItem> alpha_image = get_alpha_channel();
+  if (alpha_image) {
+    Error err;
+
+    if (alpha_image->get_width() == width && alpha_image->get_height() == height) {
+      auto alphaDecodingResult = alpha_image->decode_image_region(options, x0, y0, w, h);
+      if (alphaDecodingResult.error) {
+        return alphaDecodingResult.error;
+      }
+
+      err = add_alpha_plane(img, *alphaDecodingResult);
     }
+    else {
+      // The alpha image has a different resolution. The region is sampled from the full alpha image
+      // while it is written into the alpha plane.
+
+      auto alphaDecodingResult = alpha_image->decode_image(get_full_resolution_decoding_options(options), false, 0, 0);
+      if (alphaDecodingResult.error) {
+        return alphaDecodingResult.error;
+      }
 
-    // TAI
+      err = add_alpha_plane(img, *alphaDecodingResult, width, height, x0, y0);
+    }
 
-    auto itai = get_property<Box_itai>();
-    if (itai) {
-      img->set_tai_timestamp(itai->get_tai_timestamp_packet());
+    if (err) {
+      return err;
     }
   }
 
+  set_decoded_image_properties(img);
+
   return img;
 }
 
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_image_scaled(const struct heif_decoding_options& options,
+                                                                       uint32_t width, uint32_t height) const
+{
+  if (width == 0 || height == 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Scaled image size is empty"};
+  }
+
+  Error err = check_for_valid_image_size(get_context()->get_security_limits(), width, height);
+  if (err) {
+    return err;
+  }
+
+
+  // --- collect the rotations and mirrorings
+
+  std::vector<std::shared_ptr<Box>> transformations;
+
+  uint32_t coded_width = width;
+  uint32_t coded_height = height;
+
+  if (options.ignore_transformations == false) {
+    const std::vector<std::shared_ptr<Box>>& properties = get_properties();
+
+    for (const auto& property : properties) {
+      if (auto rot = std::dynamic_pointer_cast<Box_irot>(property)) {
+        transformations.push_back(property);
+
+        if (rot->get_rotation_ccw() == 90 || rot->get_rotation_ccw() == 270) {
+          std::swap(coded_width, coded_height);
+        }
+      }
+      else if (std::dynamic_pointer_cast<Box_imir>(property)) {
+        transformations.push_back(property);
+      }
+      else if (std::dynamic_pointer_cast<Box_clap>(property)) {
+        // The crop window is defined on the full-resolution image. Decode it and scale the result.
+
+        auto decodingResult = decode_image(options, false, 0, 0);
+        if (decodingResult.error) {
+          return decodingResult.error;
+        }
+
+        std::shared_ptr<HeifPixelImage> img = std::move(*decodingResult);
+        if (img->get_width() == width && img->get_height() == height) {
+          return img;
+        }
+
+        std::shared_ptr<HeifPixelImage> scaled_img;
+        err = img->scale_nearest_neighbor(scaled_img, width, height, m_heif_context->get_security_limits());
+        if (err) {
+          return err;
+        }
+
+        scaled_img->forward_all_metadata_from(img);
+        scaled_img->add_warnings(img->get_warnings());
+        return scaled_img;
+      }
+    }
+  }
+
+
+  // --- decode scaled coded image
+
+  auto decodingResult = decode_compressed_image_scaled(options, coded_width, coded_height);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = std::move(*decodingResult);
+
+
+  // --- apply rotation and mirroring
+
+  for (const auto& property : transformations) {
+    if (auto rot = std::dynamic_pointer_cast<Box_irot>(property)) {
+      auto rotateResult = img->rotate_ccw(rot->get_rotation_ccw(), m_heif_context->get_security_limits());
+      if (rotateResult.error) {
+        return rotateResult.error;
+      }
+
+      img = std::move(*rotateResult);
+    }
+    else if (auto mirror = std::dynamic_pointer_cast<Box_imir>(property)) {
+      auto mirrorResult = img->mirror_inplace(mirror->get_mirror_direction(),
+                                              get_context()->get_security_limits());
+      if (mirrorResult.error) {
+        return mirrorResult.error;
+      }
+
+      img = std::move(*mirrorResult);
+    }
+  }
+
+
+  // --- add alpha channel, if available
+
+  std::shared_ptr<ImageItem> alpha_image = get_alpha_channel();
+  if (alpha_image) {
+    auto alphaDecodingResult = alpha_image->decode_image_scaled(options, width, height);
+    if (alphaDecodingResult.error) {
+      return alphaDecodingResult.error;
+    }
+
+    err = add_alpha_plane(img, *alphaDecodingResult);
+    if (err) {
+      return err;
+    }
+  }
+
+  set_decoded_image_properties(img);
+
+  return img;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_compressed_image_scaled(const struct heif_decoding_options& options,
+                                                                                  uint32_t width, uint32_t height) const
+{
+  heif_decoding_options scaled_options = options;
+
+  const Box_ispe* ispe = m_ispe;
+  if (ispe) {
+    Error err = check_for_valid_image_size(get_context()->get_security_limits(), ispe->get_width(), ispe->get_height());
+    if (err) {
+      return err;
+    }
+
+    // Let the decoder skip the resolution that would be discarded by the scaling anyway.
+
+    if (scaled_options.target_scale_denominator <= 1) {
+      scaled_options.target_scale_denominator = 1;
+      for (uint32_t d = 2; d <= 8; d *= 2) {
+        if ((ispe->get_width() + d - 1) / d < width || (ispe->get_height() + d - 1) / d < height) {
+          break;
+        }
+        scaled_options.target_scale_denominator = static_cast<uint8_t>(d);
+      }
+    }
+  }
+
+  auto decodingResult = decode_compressed_image(scaled_options, false, 0, 0);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = std::move(*decodingResult);
+  if (img->get_width() == width && img->get_height() == height) {
+    return img;
+  }
+
+  std::shared_ptr<HeifPixelImage> scaled_img;
+  Error err = img->scale_nearest_neighbor(scaled_img, width, height, m_heif_context->get_security_limits());
+  if (err) {
+    return err;
+  }
+
+  scaled_img->forward_all_metadata_from(img);
+  scaled_img->add_warnings(img->get_warnings());
+  return scaled_img;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_compressed_image_region(const struct heif_decoding_options& options,
+                                                                                  uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+{
+  heif_image_tiling tiling = get_heif_image_tiling();
+
+  std::shared_ptr<HeifPixelImage> img;
+
+  // position of the decoded image ('img') in the coded image
+  uint32_t img_x0 = 0, img_y0 = 0;
+
+  if (tiling.num_columns * tiling.num_rows <= 1 ||
+      tiling.tile_width == 0 || tiling.tile_height == 0) {
+    auto areaResult = decode_compressed_image_area(options, x0, y0, w, h);
+    if (areaResult.error) {
+      return areaResult.error;
+    }
+
+    if (*areaResult) {
+      img = std::move(*areaResult);
+      img_x0 = x0;
+      img_y0 = y0;
+    }
+    else {
+      auto decodingResult = decode_compressed_image(options, false, 0, 0);
+      if (decodingResult.error) {
+        return decodingResult.error;
+      }
+
+      img = std::move(*decodingResult);
+    }
+  }
+  else {
+    // --- decode only the tiles that overlap with the region
+
+    uint32_t tx0 = x0 / tiling.tile_width;
+    uint32_t ty0 = y0 / tiling.tile_height;
+    uint32_t tx1 = std::min((x0 + w - 1) / tiling.tile_width, tiling.num_columns - 1);
+    uint32_t ty1 = std::min((y0 + h - 1) / tiling.tile_height, tiling.num_rows - 1);
+
+    img_x0 = tx0 * tiling.tile_width;
+    img_y0 = ty0 * tiling.tile_height;
+
+    uint32_t canvas_width = std::min(tiling.image_width, (tx1 + 1) * tiling.tile_width) - img_x0;
+    uint32_t canvas_height = std::min(tiling.image_height, (ty1 + 1) * tiling.tile_height) - img_y0;
+
+    Error err = check_for_valid_image_size(get_context()->get_security_limits(), canvas_width, canvas_height);
+    if (err) {
+      return err;
+    }
+
+    err = prefetch_tiles(tx0, ty0, tx1, ty1);
+    if (err) {
+      return err;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> tiles;
+    for (uint32_t ty = ty0; ty <= ty1; ty++) {
+      for (uint32_t tx = tx0; tx <= tx1; tx++) {
+        tiles.emplace_back(tx, ty);
+      }
+    }
+
+#if ENABLE_PARALLEL_TILE_DECODING
+    std::mutex canvas_mutex;
+#endif
+
+    heif_decoding_options tile_options = options;
+
+    auto decode_and_paste_tile = [&](uint32_t tx, uint32_t ty) -> Error {
+      HEIF_TRACE_SCOPE("decode", "region tile", get_id());
+
+      auto tileResult = decode_compressed_image(tile_options, true, tx, ty);
+      if (tileResult.error) {
+        return tileResult.error;
+      }
+
+      std::shared_ptr<HeifPixelImage> tile_img = std::move(*tileResult);
+
+      {
+#if ENABLE_PARALLEL_TILE_DECODING
+        std::lock_guard<std::mutex> lock(canvas_mutex);
+#endif
+
+        if (!img) {
+          auto canvas = std::make_shared<HeifPixelImage>();
+          Error err = canvas->create_clone_image_at_new_size(tile_img, canvas_width, canvas_height, get_context()->get_security_limits());
+          if (err) {
+            return err;
+          }
+
+          canvas->forward_all_metadata_from(tile_img);
+          img = canvas;
+        }
+      }
+
+      if (img->get_chroma_format() != tile_img->get_chroma_format()) {
+        return {heif_error_Invalid_input,
+                heif_suberror_Wrong_tile_image_chroma_format,
+                "Image tile has different chroma format than combined image"};
+      }
+
+      return img->copy_image_to(tile_img, tx * tiling.tile_width - img_x0, ty * tiling.tile_height - img_y0);
+    };
+
+#if ENABLE_PARALLEL_TILE_DECODING
+    if (can_decode_tiles_in_parallel() && get_context()->get_max_decoding_threads() > 0 && tiles.size() > 1) {
+      const size_t max_tasks = std::min(tiles.size(), static_cast<size_t>(get_context()->get_max_decoding_threads()));
+
+      DecodingMemoryBudget::Reservation memory_reservation(get_context()->get_decoding_memory_budget(),
+                                                           DecodingMemoryBudget::estimate_tile_memory(tiling.tile_width, tiling.tile_height,
+                                                                                                      get_luma_bits_per_pixel()),
+                                                           max_tasks,
+                                                           get_context()->get_security_limits()->max_total_memory);
+
+      const size_t num_tasks = memory_reservation.get_num_tasks();
+
+      tile_options = get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), num_tasks);
+
+      std::vector<Error> tile_errors(tiles.size());
+      std::atomic<size_t> next_tile{0};
+
+      DecodingStatistics* statistics = DecodingStatistics::current();
+
+      auto decode_tiles = [&]() {
+        DecodingStatisticsScope statistics_scope(statistics);
+
+        for (size_t i = next_tile++; i < tiles.size(); i = next_tile++) {
+          tile_errors[i] = decode_and_paste_tile(tiles[i].first, tiles[i].second);
+        }
+      };
+
+      TaskGroup tasks;
+      for (size_t t = 0; t < num_tasks; t++) {
+        tasks.run(decode_tiles);
+      }
+
+      tasks.wait();
+
+      for (const Error& e : tile_errors) {
+        if (e) {
+          return e;
+        }
+      }
+    }
+    else
+#endif
+    {
+      for (const auto& tile : tiles) {
+        err = decode_and_paste_tile(tile.first, tile.second);
+        if (err) {
+          return err;
+        }
+      }
+    }
+  }
+
+
+  // --- crop to the requested region
+
+  if (x0 < img_x0 || y0 < img_y0 ||
+      x0 - img_x0 + w > img->get_width() ||
+      y0 - img_y0 + h > img->get_height()) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Unspecified,
+                 "Decoded image is smaller than its 'ispe' size"};
+  }
+
+  if (x0 == img_x0 && y0 == img_y0 && w == img->get_width() && h == img->get_height()) {
+    return img;
+  }
+
+  return img->crop(x0 - img_x0, x0 - img_x0 + w - 1,
+                   y0 - img_y0, y0 - img_y0 + h - 1,
+                   get_context()->get_security_limits());
+}
+
+
 #if 0
 Result<std::vector<uint8_t>> ImageItem::read_bitstream_configuration_data_override(heif_item_id itemId, heif_compression_format format) const
 {
@@ -895,11 +1761,37 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem::decode_compressed_image(const
     return decoderResult.error;
   }
 
-  auto decoder = decoderResult.value;
+  auto decoder = std::move(decoderResult.value);
+
+  decoder->set_data_extent(std::move(extent));
+
+  return decoder->decode_single_frame_from_compressed_data(get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), 1));
+}
+
+
+Error ImageItem::decode_to_gpu_surfaces(const struct heif_decoding_options& options, heif_gpu_surface_type type,
+                                         uint32_t x0, uint32_t y0, GpuSurfaceList& out_surfaces) const
+{
+  DataExtent extent;
+  extent.set_from_image_item(get_file(), get_id());
+
+  auto decoderResult = get_decoder();
+  if (decoderResult.error) {
+    return decoderResult.error;
+  }
+
+  auto decoder = std::move(decoderResult.value);
 
   decoder->set_data_extent(std::move(extent));
 
-  return decoder->decode_single_frame_from_compressed_data(options);
+  auto surfaceResult = decoder->decode_single_frame_to_gpu_surface(options, type);
+  if (surfaceResult.error) {
+    return surfaceResult.error;
+  }
+
+  out_surfaces.add(*surfaceResult, x0, y0);
+
+  return Error::Ok;
 }
 
 
@@ -930,28 +1822,9 @@ heif_image_tiling ImageItem::get_heif_image_tiling() const
 }
 
 
-Result<std::vector<std::shared_ptr<Box>>> ImageItem::get_properties() const
-{
-  std::vector<std::shared_ptr<Box>> properties;
-  auto ipco_box = get_file()->get_ipco_box();
-  auto ipma_box = get_file()->get_ipma_box();
-  Error error = ipco_box->get_properties_for_item_ID(m_id, ipma_box, properties);
-  if (error) {
-    return error;
-  }
-
-  return properties;
-}
-
-
 Error ImageItem::process_image_transformations_on_tiling(heif_image_tiling& tiling) const
 {
-  Result<std::vector<std::shared_ptr<Box>>> propertiesResult = get_properties();
-  if (propertiesResult.error) {
-    return propertiesResult.error;
-  }
-
-  const std::vector<std::shared_ptr<Box>>& properties = *propertiesResult;
+  const std::vector<std::shared_ptr<Box>>& properties = get_properties();
 
   uint32_t left_excess = 0;
   uint32_t top_excess = 0;
@@ -24,11 +24,14 @@
 #include "api/libheif/heif.h"
 #include "error.h"
 #include "nclx.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
 #include <utility>
+#include <span>
 #include "api/libheif/heif_plugin.h"
+#include "api/libheif/heif_experimental.h"
 #include "codecs/encoder.h"
 
 
@@ -44,7 +47,16 @@ public:
   std::string item_type;  // e.g. "Exif"
   std::string content_type;
   std::string item_uri_type;
+
+  // The data references the input file if it is held in memory and does not have to be decompressed.
+  // Otherwise, it is copied into 'm_data'.
+  std::span<const uint8_t> get_data() const { return m_data_without_copy.empty() ? std::span<const uint8_t>(m_data) : m_data_without_copy; }
+
   std::vector<uint8_t> m_data;
+  std::span<const uint8_t> m_data_without_copy;
+
+  // Compressed data is not loaded with the file. Use HeifContext::get_decompressed_metadata() to access it.
+  bool m_compressed = false;
 };
 
 
@@ -93,6 +105,7 @@ public:
 
   void set_properties(std::vector<std::shared_ptr<Box>> properties) {
     m_properties = std::move(properties);
+    m_ispe = get_property_ptr<Box_ispe>();
   }
 
   template<class BoxType>
@@ -107,6 +120,20 @@ public:
     return nullptr;
   }
 
+  // Like get_property(), but without taking a reference. Use this on the decoding path, where the
+  // property is only read. The pointer is valid as long as the item holds the property.
+  template<class BoxType>
+  const BoxType* get_property_ptr() const
+  {
+    for (auto& property : m_properties) {
+      if (auto box = dynamic_cast<const BoxType*>(property.get())) {
+        return box;
+      }
+    }
+
+    return nullptr;
+  }
+
   heif_property_id add_property(std::shared_ptr<Box> property, bool essential);
 
   heif_property_id add_property_without_deduplication(std::shared_ptr<Box> property, bool essential);
@@ -154,7 +181,7 @@ public:
 
   Error postprocess_coded_image_colorspace(heif_colorspace* inout_colorspace, heif_chroma* inout_chroma) const;
 
-  virtual void process_before_write() { }
+  virtual Error process_before_write() { return Error::Ok; }
 
   // -- thumbnails
 
@@ -269,6 +296,13 @@ public:
 
   const std::vector<std::shared_ptr<ImageMetadata>>& get_metadata() const { return m_metadata; }
 
+  void remove_metadata(heif_item_id id)
+  {
+    m_metadata.erase(std::remove_if(m_metadata.begin(), m_metadata.end(),
+                                    [id](const std::shared_ptr<ImageMetadata>& m) { return m->item_id == id; }),
+                     m_metadata.end());
+  }
+
 
   // --- miaf
 
@@ -284,13 +318,132 @@ public:
 
   Error init_decoder_from_item(heif_item_id id);
 
+  // The output format requested from HeifContext::decode_image().
+  struct OutputFormat
+  {
+    heif_colorspace colorspace;
+    heif_chroma chroma;
+  };
+
+  // When 'output_format' is set, images that are composed of several parts may already convert the parts into
+  // this format while decoding them (see decode_compressed_image_converted()).
   Result<std::shared_ptr<HeifPixelImage>> decode_image(const struct heif_decoding_options& options,
-                                                       bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const;
+                                                       bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0,
+                                                       const OutputFormat* output_format = nullptr) const;
+
+  // Like decode_image() for the full image, but uses 'decoded_frame' as the output of the decoder plugin instead of
+  // decoding the coded data. This is for images that were decoded together with other images in one decoder
+  // session (see BatchDecoder).
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_from_frame(const struct heif_decoding_options& options,
+                                                                  std::shared_ptr<HeifPixelImage> decoded_frame) const;
 
   virtual Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image(const struct heif_decoding_options& options,
                                                                           bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const;
 
-  Result<std::vector<std::shared_ptr<Box>>> get_properties() const;
+  // Decodes the full image and converts it into 'output_format' on the way, like HeifContext::convert_to_output_colorspace()
+  // would convert the decoded image. Returns nullptr if the image does not support this for the given options.
+  virtual Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_converted(const struct heif_decoding_options& options,
+                                                                                    const OutputFormat& output_format) const
+  {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  // Decode the image directly into the planes of 'target', with its top-left corner at (x0,y0).
+  // This is only possible for coded images without alpha channel and transformations, when the decoder plugin
+  // supports it. Returns false if the image was not decoded. decode_image() has to be used in that case.
+  Result<bool> decode_image_into(const struct heif_decoding_options& options,
+                                 const std::shared_ptr<HeifPixelImage>& target, uint32_t x0, uint32_t y0) const;
+
+  // Whether the image has 'irot', 'imir' or 'clap' properties.
+  bool has_transformation_properties() const;
+
+  // Decode the full image directly into 'target', which has the requested output format and the image size.
+  // Returns false if this is not possible without an intermediate image.
+  virtual Result<bool> decode_full_image_into(const struct heif_decoding_options& options,
+                                              const std::shared_ptr<HeifPixelImage>& target) const
+  {
+    return decode_image_into(options, target, 0, 0);
+  }
+
+  // Decode the coded image (before transformations) into GPU surfaces, with its top-left corner at (x0,y0).
+  // Images that consist of several tiles add one surface per tile.
+  virtual Error decode_to_gpu_surfaces(const struct heif_decoding_options& options, heif_gpu_surface_type type,
+                                       uint32_t x0, uint32_t y0, class GpuSurfaceList& out_surfaces) const;
+
+  // Decode a rectangular region of the image. The region is given in the coordinates of the image after
+  // the transformations ('clap', 'irot', 'imir') have been applied, unless options.ignore_transformations is set.
+  // For tiled images, only the tiles overlapping the region are decoded.
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_region(const struct heif_decoding_options& options,
+                                                              uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const;
+
+  // Decode the image scaled to width x height (nearest neighbor). The size is given after the transformations
+  // have been applied, unless options.ignore_transformations is set.
+  // Images that consist of several tiles are scaled tile by tile, without assembling the full-resolution image.
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_scaled(const struct heif_decoding_options& options,
+                                                              uint32_t width, uint32_t height) const;
+
+  // Decode the coded image (before transformations) scaled to width x height.
+  // The default implementation decodes the full image and scales it afterwards.
+  virtual Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_scaled(const struct heif_decoding_options& options,
+                                                                                 uint32_t width, uint32_t height) const;
+
+  // Decode a region of the coded image (before transformations) by decoding all overlapping tiles
+  // and cropping the result to the region.
+  Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_region(const struct heif_decoding_options& options,
+                                                                         uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const;
+
+  // Progressive decoding: the smallest size of the coded data larger than 'coded_data_size' at which more of the
+  // image can be decoded (see heif_decoding_options.max_coded_data_size).
+  virtual Result<uint64_t> get_next_progressive_data_size(uint64_t coded_data_size) const
+  {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_codec,
+                 "Progressive decoding is only supported for JPEG 2000 images"};
+  }
+
+  // Incremental decoding: the size of the beginning of the coded data from which an intermediate image can be
+  // decoded when only 'available_size' bytes of it are loaded. Returns 0 if no image can be decoded from it yet.
+  virtual uint64_t get_incremental_decoding_data_size(uint64_t available_size) const { return 0; }
+
+  const std::vector<std::shared_ptr<Box>>& get_properties() const { return m_properties; }
+
+protected:
+  // Whether decode_compressed_image() may be called for several tiles concurrently.
+  virtual bool can_decode_tiles_in_parallel() const { return false; }
+
+  // Decode only the area of w x h samples at (x0,y0) of the coded image, when the codec can skip the rest of the bitstream.
+  // Returns a null image if this is not supported. The default implementation does not support it.
+  virtual Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_area(const struct heif_decoding_options& options,
+                                                                              uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+  {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  // Called before the tiles in the range [tx0,tx1] x [ty0,ty1] are decoded. Images that store their
+  // tiles in one item use this to load the required tile index data in one go and to send preload hints
+  // for the tile data to the StreamReader.
+  virtual Error prefetch_tiles(uint32_t tx0, uint32_t ty0, uint32_t tx1, uint32_t ty1) const { return Error::Ok; }
+
+private:
+  // When 'decoded_frame' is set, it is used instead of decoding the coded data.
+  Result<std::shared_ptr<HeifPixelImage>> decode_image_internal(const struct heif_decoding_options& options,
+                                                                bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0,
+                                                                const OutputFormat* output_format,
+                                                                std::shared_ptr<HeifPixelImage> decoded_frame) const;
+
+  Error add_alpha_plane(const std::shared_ptr<HeifPixelImage>& img, const std::shared_ptr<HeifPixelImage>& alpha) const;
+
+  // Adds the alpha plane for the area at (x0;y0) of 'img', where 'alpha' covers the full 'full_width' x 'full_height' image.
+  Error add_alpha_plane(const std::shared_ptr<HeifPixelImage>& img, const std::shared_ptr<HeifPixelImage>& alpha,
+                        uint32_t full_width, uint32_t full_height, uint32_t x0, uint32_t y0) const;
+
+  // Set the color profiles and the metadata properties (clli, mdcv, pasp, itai) of the decoded image.
+  void set_decoded_image_properties(const std::shared_ptr<HeifPixelImage>& img) const;
+
+  // Derives the resolution reduction of a decoded coded image from its size and the 'ispe' size.
+  uint8_t get_decoding_scale_denominator(uint32_t decoded_width, uint32_t decoded_height) const;
+
+public:
 
   // === encoding ===
 
@@ -305,6 +458,17 @@ public:
                        const struct heif_encoding_options& options,
                        enum heif_image_input_class input_class);
 
+  // Store the bitstream and the properties of the coded image data as a new item in the file.
+  Error add_coded_data_to_item(HeifContext* ctx, const Encoder::CodedImageData& codedImage);
+
+  // Second part of encode_to_item(): store the coded image data as a new item in the file.
+  // In contrast to encode_to_bitstream_and_boxes(), this modifies the HeifFile and cannot run in parallel.
+  Error add_coded_image_to_item(HeifContext* ctx,
+                                const std::shared_ptr<HeifPixelImage>& image,
+                                const Encoder::CodedImageData& codedImage,
+                                struct heif_encoder* encoder,
+                                const struct heif_encoding_options& options);
+
   const std::shared_ptr<const color_profile_nclx>& get_color_profile_nclx() const { return m_color_profile_nclx; }
 
   const std::shared_ptr<const color_profile_raw>& get_color_profile_icc() const { return m_color_profile_icc; }
@@ -361,6 +525,13 @@ public:
 
   Error transform_requested_tile_position_to_original_tile_position(uint32_t& tile_x, uint32_t& tile_y) const;
 
+  // The 'irot' and 'imir' transformations of the item, expressed as an Exif orientation.
+  // Returns an error if the item has transformations that cannot be expressed this way ('clap').
+  Result<heif_orientation> get_exif_orientation() const;
+
+  // The coded data with its parameter sets as an Annex-B byte stream (AVC, HEVC and VVC images).
+  virtual Result<std::vector<uint8_t>> get_annexb_bitstream() const;
+
   virtual Result<std::shared_ptr<class Decoder>> get_decoder() const
   {
     return Error{
@@ -376,6 +547,9 @@ private:
   HeifContext* m_heif_context;
   std::vector<std::shared_ptr<Box>> m_properties;
 
+  // Resolved from m_properties, since the size is queried for every decoded image and tile.
+  const Box_ispe* m_ispe = nullptr;
+
   heif_item_id m_id = 0;
   uint32_t m_width = 0, m_height = 0;  // after all transformations have been applied
   bool m_is_primary = false;
@@ -42,6 +42,159 @@ ImageItem_JPEG::ImageItem_JPEG(HeifContext* ctx)
 }
 
 
+static const uint8_t JPEG_SOI = 0xD8;
+static const uint8_t JPEG_SOS = 0xDA;
+static const uint8_t JPEG_APP0 = 0xE0;
+static const uint8_t JPEG_APP1 = 0xE1;
+
+static const uint16_t EXIF_TAG_ORIENTATION = 0x0112;
+static const uint16_t EXIF_TYPE_SHORT = 3;
+
+
+// Sets the orientation tag in the first IFD of the TIFF structure of Exif data.
+// Returns false if there is no orientation tag.
+static bool set_exif_orientation_tag(uint8_t* tiff, size_t size, uint16_t orientation)
+{
+  if (size < 8) {
+    return false;
+  }
+
+  bool little_endian;
+  if (tiff[0] == 'I' && tiff[1] == 'I') {
+    little_endian = true;
+  }
+  else if (tiff[0] == 'M' && tiff[1] == 'M') {
+    little_endian = false;
+  }
+  else {
+    return false;
+  }
+
+  auto read16 = [&](size_t pos) -> uint16_t {
+    return little_endian ? static_cast<uint16_t>(tiff[pos] | (tiff[pos + 1] << 8))
+                         : static_cast<uint16_t>((tiff[pos] << 8) | tiff[pos + 1]);
+  };
+
+  auto read32 = [&](size_t pos) -> uint32_t {
+    return little_endian ? (uint32_t{read16(pos + 2)} << 16) | read16(pos)
+                         : (uint32_t{read16(pos)} << 16) | read16(pos + 2);
+  };
+
+  size_t ifd = read32(4);
+  if (ifd + 2 > size) {
+    return false;
+  }
+
+  uint16_t num_entries = read16(ifd);
+
+  for (size_t i = 0; i < num_entries; i++) {
+    size_t entry = ifd + 2 + 12 * i;
+    if (entry + 12 > size) {
+      return false;
+    }
+
+    if (read16(entry) == EXIF_TAG_ORIENTATION && read16(entry + 2) == EXIF_TYPE_SHORT) {
+      uint8_t* value = tiff + entry + 8;
+      if (little_endian) {
+        value[0] = static_cast<uint8_t>(orientation & 0xFF);
+        value[1] = static_cast<uint8_t>(orientation >> 8);
+      }
+      else {
+        value[0] = static_cast<uint8_t>(orientation >> 8);
+        value[1] = static_cast<uint8_t>(orientation & 0xFF);
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+Result<std::vector<uint8_t>> ImageItem_JPEG::get_jpeg_bitstream() const
+{
+  if (!m_decoder) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Unspecified,
+                 "JPEG image has no coded data"};
+  }
+
+  Result<heif_orientation> orientationResult = get_exif_orientation();
+  if (orientationResult.error) {
+    return orientationResult.error;
+  }
+
+  const auto orientation = static_cast<uint16_t>(*orientationResult);
+
+  auto dataResult = m_decoder->get_compressed_data();
+  if (dataResult.error) {
+    return dataResult.error;
+  }
+
+  std::vector<uint8_t> data = std::move(dataResult.value);
+
+  const Error error_invalid_segments{heif_error_Invalid_input,
+                                     heif_suberror_Unspecified,
+                                     "Invalid JPEG marker segments"};
+
+  if (data.size() < 2 || data[0] != 0xFF || data[1] != JPEG_SOI) {
+    return error_invalid_segments;
+  }
+
+  // --- overwrite the orientation of an Exif segment in the bitstream
+
+  size_t exif_insert_pos = 2;
+
+  for (size_t pos = 2; pos + 4 <= data.size() && data[pos] == 0xFF && data[pos + 1] != JPEG_SOS;) {
+    uint8_t marker = data[pos + 1];
+    size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    if (length < 2 || pos + 2 + length > data.size()) {
+      return error_invalid_segments;
+    }
+
+    if (marker == JPEG_APP1 && length >= 8 && memcmp(&data[pos + 4], "Exif\0\0", 6) == 0) {
+      if (!set_exif_orientation_tag(&data[pos + 10], length - 8, orientation) &&
+          orientation != heif_orientation_normal) {
+        return Error{heif_error_Unsupported_feature,
+                     heif_suberror_Unspecified,
+                     "The Exif data of the JPEG bitstream has no orientation tag"};
+      }
+
+      return data;
+    }
+
+    // A JFIF segment has to stay directly after the SOI marker.
+    if (marker == JPEG_APP0) {
+      exif_insert_pos = pos + 2 + length;
+    }
+
+    pos += 2 + length;
+  }
+
+  // --- insert an Exif segment that only contains the orientation
+
+  if (orientation != heif_orientation_normal) {
+    const uint8_t exif_segment[] = {
+        0xFF, JPEG_APP1, 0, 34,
+        'E', 'x', 'i', 'f', 0, 0,
+        // TIFF header, big endian, first IFD at offset 8
+        'M', 'M', 0, 42, 0, 0, 0, 8,
+        // IFD with one entry: orientation (SHORT, count 1)
+        0, 1,
+        EXIF_TAG_ORIENTATION >> 8, EXIF_TAG_ORIENTATION & 0xFF, 0, EXIF_TYPE_SHORT, 0, 0, 0, 1,
+        0, static_cast<uint8_t>(orientation), 0, 0,
+        // no next IFD
+        0, 0, 0, 0
+    };
+
+    data.insert(data.begin() + exif_insert_pos, std::begin(exif_segment), std::end(exif_segment));
+  }
+
+  return data;
+}
+
+
 Result<std::vector<uint8_t>> ImageItem_JPEG::read_bitstream_configuration_data() const
 {
   return m_decoder->read_bitstream_configuration_data();
@@ -71,6 +224,7 @@ Error ImageItem_JPEG::on_load_file()
   extent.set_from_image_item(get_context()->get_heif_file(), get_id());
 
   m_decoder->set_data_extent(std::move(extent));
+  m_decoder->set_instance_pool(get_context()->get_decoder_instance_pool());
 
   return Error::Ok;
 }
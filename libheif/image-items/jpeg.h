@@ -42,6 +42,11 @@ public:
 
   Error on_load_file() override;
 
+  uint64_t get_incremental_decoding_data_size(uint64_t available_size) const override { return available_size; }
+
+  // The complete JPEG bitstream ('jpgC' header and item data) with the item orientation written as Exif orientation.
+  Result<std::vector<uint8_t>> get_jpeg_bitstream() const;
+
 protected:
   Result<std::shared_ptr<Decoder>> get_decoder() const override;
 
@@ -73,6 +73,42 @@ std::shared_ptr<class Encoder> ImageItem_JPEG2000::get_encoder() const
 }
 
 
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_JPEG2000::decode_compressed_image_area(const struct heif_decoding_options& options,
+                                                                                       uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+{
+  // JPEG 2000 codestreams are often split into codec-internal tiles. Only those intersecting with the area have to be decoded.
+
+  if (!m_decoder) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  DataExtent extent;
+  extent.set_from_image_item(get_file(), get_id());
+
+  m_decoder->set_data_extent(std::move(extent));
+
+  return m_decoder->decode_single_frame_area(get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), 1),
+                                             x0, y0, w, h);
+}
+
+
+Result<uint64_t> ImageItem_JPEG2000::get_next_progressive_data_size(uint64_t coded_data_size) const
+{
+  DataExtent extent;
+  extent.set_from_image_item(get_file(), get_id());
+
+  auto sizeResult = extent.get_data_size();
+  if (sizeResult.error) {
+    return sizeResult.error;
+  }
+
+  return get_next_jpeg2000_tile_part_end(*sizeResult, coded_data_size,
+                                         [&extent](uint64_t offset, uint64_t size) {
+                                           return extent.read_data(offset, size);
+                                         });
+}
+
+
 Error ImageItem_JPEG2000::on_load_file()
 {
   auto j2kH = get_property<Box_j2kH>();
@@ -88,6 +124,7 @@ Error ImageItem_JPEG2000::on_load_file()
   extent.set_from_image_item(get_context()->get_heif_file(), get_id());
 
   m_decoder->set_data_extent(std::move(extent));
+  m_decoder->set_instance_pool(get_context()->get_decoder_instance_pool());
 
   return Error::Ok;
 }
@@ -48,9 +48,16 @@ protected:
 
   std::shared_ptr<Encoder> get_encoder() const override;
 
+  Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_area(const struct heif_decoding_options& options,
+                                                                      uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const override;
+
 public:
   Error on_load_file() override;
 
+  Result<uint64_t> get_next_progressive_data_size(uint64_t coded_data_size) const override;
+
+  uint64_t get_incremental_decoding_data_size(uint64_t available_size) const override { return available_size; }
+
 private:
   std::shared_ptr<class Decoder_JPEG2000> m_decoder;
   std::shared_ptr<class Encoder_JPEG2000> m_encoder;
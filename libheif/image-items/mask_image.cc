@@ -20,6 +20,7 @@
  * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <array>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
@@ -57,10 +58,122 @@ Error Box_mskC::write(StreamWriter& writer) const
 }
 
 
-Error MaskImageCodec::decode_mask_image(const HeifContext* context,
-                                        heif_item_id ID,
-                                        std::shared_ptr<HeifPixelImage>& img,
-                                        const std::vector<uint8_t>& data)
+// --- 1-bit mask kernels
+
+// Each entry holds the 8 unpacked pixels of one mask byte.
+static constexpr std::array<std::array<uint8_t, 8>, 256> make_unpack_table()
+{
+  std::array<std::array<uint8_t, 8>, 256> table{};
+  for (int v = 0; v < 256; v++) {
+    for (int b = 0; b < 8; b++) {
+      table[v][b] = (v & (0x80 >> b)) ? 255 : 0;
+    }
+  }
+  return table;
+}
+
+static constexpr auto mask_unpack_table = make_unpack_table();
+
+
+static inline uint8_t get_mask_bit(const uint8_t* src, uint64_t bit)
+{
+  return (src[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+
+void unpack_mask_bits(const uint8_t* src, uint64_t src_bit_offset, uint8_t* dst, uint32_t num_pixels)
+{
+  uint32_t x = 0;
+
+  // single bits up to the next byte boundary
+
+  for (; x < num_pixels && ((src_bit_offset + x) & 7) != 0; x++) {
+    dst[x] = get_mask_bit(src, src_bit_offset + x) ? 255 : 0;
+  }
+
+  // whole bytes
+
+  const uint8_t* p = src + ((src_bit_offset + x) >> 3);
+  for (; x + 8 <= num_pixels; x += 8) {
+    memcpy(dst + x, mask_unpack_table[*p++].data(), 8);
+  }
+
+  // remaining bits
+
+  for (; x < num_pixels; x++) {
+    dst[x] = get_mask_bit(src, src_bit_offset + x) ? 255 : 0;
+  }
+}
+
+
+void pack_mask_bits(const uint8_t* src, uint32_t num_pixels, uint8_t threshold, uint8_t* dst, uint64_t dst_bit_offset)
+{
+  uint32_t x = 0;
+
+  for (; x < num_pixels && ((dst_bit_offset + x) & 7) != 0; x++) {
+    uint64_t bit = dst_bit_offset + x;
+    dst[bit >> 3] |= uint8_t((src[x] >= threshold) << (7 - (bit & 7)));
+  }
+
+  // Branch-free, so that the compiler can vectorize it.
+  uint8_t* p = dst + ((dst_bit_offset + x) >> 3);
+  for (; x + 8 <= num_pixels; x += 8) {
+    const uint8_t* in = src + x;
+    *p++ = uint8_t(((in[0] >= threshold) << 7) |
+                   ((in[1] >= threshold) << 6) |
+                   ((in[2] >= threshold) << 5) |
+                   ((in[3] >= threshold) << 4) |
+                   ((in[4] >= threshold) << 3) |
+                   ((in[5] >= threshold) << 2) |
+                   ((in[6] >= threshold) << 1) |
+                   ((in[7] >= threshold) << 0));
+  }
+
+  for (; x < num_pixels; x++) {
+    uint64_t bit = dst_bit_offset + x;
+    dst[bit >> 3] |= uint8_t((src[x] >= threshold) << (7 - (bit & 7)));
+  }
+}
+
+
+void copy_mask_bits(const uint8_t* src, uint64_t src_bit_offset, uint8_t* dst, uint32_t num_bits)
+{
+  if (num_bits == 0) {
+    return;
+  }
+
+  const uint8_t* p = src + (src_bit_offset >> 3);
+  int shift = (int) (src_bit_offset & 7);
+  uint32_t num_full_bytes = num_bits / 8;
+  uint32_t num_remaining_bits = num_bits % 8;
+
+  if (shift == 0) {
+    memcpy(dst, p, num_full_bytes + (num_remaining_bits ? 1 : 0));
+  }
+  else {
+    for (uint32_t i = 0; i < num_full_bytes; i++) {
+      dst[i] = uint8_t((p[i] << shift) | (p[i + 1] >> (8 - shift)));
+    }
+
+    if (num_remaining_bits) {
+      uint8_t v = uint8_t(p[num_full_bytes] << shift);
+      if (num_remaining_bits > (uint32_t) (8 - shift)) {
+        v |= uint8_t(p[num_full_bytes + 1] >> (8 - shift));
+      }
+      dst[num_full_bytes] = v;
+    }
+  }
+
+  if (num_remaining_bits) {
+    dst[num_full_bytes] &= uint8_t(0xFF << (8 - num_remaining_bits));
+  }
+}
+
+
+static Error get_mask_configuration(const HeifContext* context,
+                                    heif_item_id ID,
+                                    const std::vector<uint8_t>& data,
+                                    uint32_t* out_width, uint32_t* out_height, uint8_t* out_bits_per_pixel)
 {
   auto image = context->get_image(ID, false);
   if (!image) {
@@ -90,39 +203,112 @@ Error MaskImageCodec::decode_mask_image(const HeifContext* context,
                   "Missing required box for mask codec");
   }
 
-  if ((mskC->get_bits_per_pixel() != 8) && (mskC->get_bits_per_pixel() != 16))
+  uint8_t bits_per_pixel = mskC->get_bits_per_pixel();
+  if ((bits_per_pixel != 1) && (bits_per_pixel != 8) && (bits_per_pixel != 16))
   {
     return Error(heif_error_Unsupported_feature,
                  heif_suberror_Unsupported_data_version,
                  "Unsupported bit depth for mask item");
   }
 
-  if (data.size() < width * height) {
+  uint64_t data_size = ((uint64_t) width * height * bits_per_pixel + 7) / 8;
+  if (data.size() < data_size) {
     return {heif_error_Invalid_input,
             heif_suberror_Unspecified,
             "Mask image data is too short"};
   }
 
+  *out_width = width;
+  *out_height = height;
+  *out_bits_per_pixel = bits_per_pixel;
+
+  return Error::Ok;
+}
+
+
+Error MaskImageCodec::decode_mask_image(const HeifContext* context,
+                                        heif_item_id ID,
+                                        std::shared_ptr<HeifPixelImage>& img,
+                                        const std::vector<uint8_t>& data)
+{
+  uint32_t width, height;
+  uint8_t bits_per_pixel;
+  Error err = get_mask_configuration(context, ID, data, &width, &height, &bits_per_pixel);
+  if (err) {
+    return err;
+  }
+
+  // 1-bit masks are expanded to 8 bits with the values 0 and 255.
+
   img = std::make_shared<HeifPixelImage>();
   img->create(width, height, heif_colorspace_monochrome, heif_chroma_monochrome);
-  auto err = img->add_plane(heif_channel_Y, width, height, mskC->get_bits_per_pixel(),
-                            context->get_security_limits());
+  err = img->add_plane(heif_channel_Y, width, height, bits_per_pixel == 1 ? 8 : bits_per_pixel,
+                       context->get_security_limits());
   if (err) {
     return err;
   }
 
   size_t stride;
   uint8_t* dst = img->get_plane(heif_channel_Y, &stride);
-  if (((uint32_t)stride) == width) {
-    memcpy(dst, data.data(), data.size());
+
+  if (bits_per_pixel == 1) {
+    for (uint32_t y = 0; y < height; y++) {
+      unpack_mask_bits(data.data(), (uint64_t) y * width, dst + y * stride, width);
+    }
   }
-  else
-  {
-    for (uint32_t i = 0; i < height; i++)
-    {
-      memcpy(dst + i * stride, data.data() + i * width, width);
+  else {
+    size_t row_size = width * (size_t) (bits_per_pixel / 8);
+
+    if (stride == row_size) {
+      memcpy(dst, data.data(), row_size * height);
+    }
+    else {
+      for (uint32_t i = 0; i < height; i++) {
+        memcpy(dst + i * stride, data.data() + i * row_size, row_size);
+      }
     }
   }
+
+  return Error::Ok;
+}
+
+
+Error MaskImageCodec::decode_mask_bitset(const HeifContext* context,
+                                         heif_item_id ID,
+                                         const std::vector<uint8_t>& data,
+                                         uint8_t* dst, size_t dst_stride)
+{
+  uint32_t width, height;
+  uint8_t bits_per_pixel;
+  Error err = get_mask_configuration(context, ID, data, &width, &height, &bits_per_pixel);
+  if (err) {
+    return err;
+  }
+
+  size_t row_bytes = (width + 7) / 8;
+
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = dst + y * dst_stride;
+
+    if (bits_per_pixel == 1) {
+      copy_mask_bits(data.data(), (uint64_t) y * width, row, width);
+    }
+    else if (bits_per_pixel == 8) {
+      memset(row, 0, row_bytes);
+      pack_mask_bits(data.data() + (size_t) y * width, width, 0x80, row, 0);
+    }
+    else {
+      // 16-bit samples are stored in the same byte order as in the decoded image plane.
+      memset(row, 0, row_bytes);
+      const uint8_t* src = data.data() + (size_t) y * width * 2;
+      for (uint32_t x = 0; x < width; x++) {
+        uint16_t v;
+        memcpy(&v, src + 2 * x, 2);
+        row[x >> 3] |= uint8_t((v >= 0x8000) << (7 - (x & 7)));
+      }
+    }
+  }
+
   return Error::Ok;
 }
 
@@ -168,7 +354,8 @@ Result<Encoder::CodedImageData> ImageItem_mask::encode(const std::shared_ptr<Hei
                  "Unsupported colourspace for mask region");
   }
 
-  if (image->get_bits_per_pixel(heif_channel_Y) != 8)
+  int bits_per_pixel = image->get_bits_per_pixel(heif_channel_Y);
+  if (bits_per_pixel != 1 && bits_per_pixel != 8)
   {
     return Error(heif_error_Unsupported_feature,
                  heif_suberror_Unsupported_data_version,
@@ -176,16 +363,21 @@ Result<Encoder::CodedImageData> ImageItem_mask::encode(const std::shared_ptr<Hei
   }
 
   // TODO: we could add an option to lossless-compress this data
-  std::vector<uint8_t> data;
   size_t src_stride;
   uint8_t* src_data = image->get_plane(heif_channel_Y, &src_stride);
 
   uint32_t w = image->get_width();
   uint32_t h = image->get_height();
 
-  data.resize(w * h);
-
-  if (w == (uint32_t)src_stride) {
+  if (bits_per_pixel == 1) {
+    // 1-bit images store one pixel per byte. Pack them without padding between rows.
+    std::vector<uint8_t> data(((uint64_t) w * h + 7) / 8);
+    for (uint32_t y = 0; y < h; y++) {
+      pack_mask_bits(src_data + y * src_stride, w, 1, data.data(), (uint64_t) y * w);
+    }
+    codedImageData.append(data.data(), data.size());
+  }
+  else if (w == (uint32_t)src_stride) {
     codedImageData.append(src_data, w*h);
   }
   else {
@@ -202,6 +394,18 @@ Result<Encoder::CodedImageData> ImageItem_mask::encode(const std::shared_ptr<Hei
 }
 
 
+Error ImageItem_mask::decode_bitset(uint8_t* dst, size_t dst_stride) const
+{
+  std::vector<uint8_t> data;
+  Error error = get_file()->append_data_from_iloc(get_id(), data);
+  if (error) {
+    return error;
+  }
+
+  return MaskImageCodec::decode_mask_bitset(get_context(), get_id(), data, dst, dst_stride);
+}
+
+
 int ImageItem_mask::get_luma_bits_per_pixel() const
 {
   auto mskC = get_property<Box_mskC>();
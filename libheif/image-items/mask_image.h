@@ -69,6 +69,21 @@ private:
   uint8_t m_bits_per_pixel = 0;
 };
 
+// --- 1-bit mask kernels
+// Bits are stored MSB first without padding between rows, as in 1-bit mask items and inline region masks.
+
+// Unpacks 'num_pixels' bits, starting at bit 'src_bit_offset' of 'src', into bytes with the values 0 and 255.
+void unpack_mask_bits(const uint8_t* src, uint64_t src_bit_offset, uint8_t* dst, uint32_t num_pixels);
+
+// Sets the bits for 'num_pixels' pixels, starting at bit 'dst_bit_offset' of 'dst', for all pixels in 'src' that are >= 'threshold'.
+// The destination bits must be zero before.
+void pack_mask_bits(const uint8_t* src, uint32_t num_pixels, uint8_t threshold, uint8_t* dst, uint64_t dst_bit_offset);
+
+// Copies 'num_bits' bits, starting at bit 'src_bit_offset' of 'src', to the start of 'dst'.
+// The remaining bits of the last destination byte are set to zero.
+void copy_mask_bits(const uint8_t* src, uint64_t src_bit_offset, uint8_t* dst, uint32_t num_bits);
+
+
 class MaskImageCodec
 {
 public:
@@ -76,6 +91,13 @@ public:
                                   heif_item_id ID,
                                   std::shared_ptr<HeifPixelImage>& img,
                                   const std::vector<uint8_t>& data);
+
+  // Decodes the mask to one bit per pixel, MSB first, with 'dst_stride' bytes per row.
+  // Mask items with more than one bit per pixel are thresholded at half of the maximum value.
+  static Error decode_mask_bitset(const HeifContext* context,
+                                  heif_item_id ID,
+                                  const std::vector<uint8_t>& data,
+                                  uint8_t* dst, size_t dst_stride);
 };
 
 
@@ -104,6 +126,8 @@ public:
                                          struct heif_encoder* encoder,
                                          const struct heif_encoding_options& options,
                                          enum heif_image_input_class input_class) override;
+
+  Error decode_bitset(uint8_t* dst, size_t dst_stride) const;
 };
 
 #endif //LIBHEIF_MASK_IMAGE_H
@@ -21,8 +21,17 @@
 #include "overlay.h"
 #include "context.h"
 #include "file.h"
+#include "codecs/decoder.h"
 #include "color-conversion/colorconversion.h"
 #include "security_limits.h"
+#include "common_utils.h"
+#include "thread_pool.h"
+#include "decoding_statistics.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <set>
+#include <vector>
 
 
 template<typename I>
@@ -49,7 +58,7 @@ static int32_t readvec_signed(const std::vector<uint8_t>& data, int& ptr, int le
   bool negative = (val & high_bit) != 0;
 
   if (negative) {
-    return -static_cast<int32_t>((~val) & 0x7fffffff) -1;
+    return -static_cast<int32_t>((~val) & (high_bit - 1)) - 1;
   }
   else {
     return static_cast<int32_t>(val);
@@ -276,41 +285,190 @@ Error ImageItem_Overlay::read_overlay_spec()
 Result<std::shared_ptr<HeifPixelImage>> ImageItem_Overlay::decode_compressed_image(const struct heif_decoding_options& options,
                                                                                    bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const
 {
-  return decode_overlay_image(options);
+  // The layer offsets are defined on the full-resolution canvas.
+  return decode_overlay_image(get_full_resolution_decoding_options(options));
 }
 
 
-Result<std::shared_ptr<HeifPixelImage>> ImageItem_Overlay::decode_overlay_image(const heif_decoding_options& options) const
+static bool equal_nclx(const std::shared_ptr<const color_profile_nclx>& a,
+                       const std::shared_ptr<const color_profile_nclx>& b)
 {
-  std::shared_ptr<HeifPixelImage> img;
+  if (!a || !b) {
+    return !a && !b;
+  }
 
-  uint32_t w = m_overlay_spec.get_canvas_width();
-  uint32_t h = m_overlay_spec.get_canvas_height();
+  return (a->get_colour_primaries() == b->get_colour_primaries() &&
+          a->get_transfer_characteristics() == b->get_transfer_characteristics() &&
+          a->get_matrix_coefficients() == b->get_matrix_coefficients() &&
+          a->get_full_range_flag() == b->get_full_range_flag());
+}
 
-  Error err = check_for_valid_image_size(get_context()->get_security_limits(), w, h);
-  if (err) {
-    return err;
+
+// Checks whether all layers can be composited without converting them first.
+// This requires that they share the same planar format and color profile. Layers with subsampled chroma
+// additionally have to be aligned to the chroma grid and may not be blended with an alpha channel.
+static bool layers_share_native_format(const std::vector<std::shared_ptr<HeifPixelImage>>& layers,
+                                       const ImageOverlay& overlay_spec)
+{
+  if (layers.empty()) {
+    return false;
   }
 
-  // TODO: seems we always have to compose this in RGB since the background color is an RGB value
-  img = std::make_shared<HeifPixelImage>();
-  img->create(w, h,
-              heif_colorspace_RGB,
-              heif_chroma_444);
-  if (auto error = img->add_plane(heif_channel_R, w, h, 8, get_context()->get_security_limits())) { // TODO: other bit depths
-    return error;
+  const auto& first = layers[0];
+  heif_colorspace colorspace = first->get_colorspace();
+  heif_chroma chroma = first->get_chroma_format();
+
+  if ((colorspace != heif_colorspace_RGB &&
+       colorspace != heif_colorspace_YCbCr &&
+       colorspace != heif_colorspace_monochrome) ||
+      num_interleaved_pixels_per_plane(chroma) != 1) {
+    return false;
   }
-  if (auto error = img->add_plane(heif_channel_G, w, h, 8, get_context()->get_security_limits())) { // TODO: other bit depths
-    return error;
+
+  uint32_t sub_h = chroma_h_subsampling(chroma);
+  uint32_t sub_v = chroma_v_subsampling(chroma);
+  bool subsampled = (sub_h != 1 || sub_v != 1);
+
+  std::set<heif_channel> channels = first->get_channel_set();
+  channels.erase(heif_channel_Alpha);
+
+  for (size_t i = 0; i < layers.size(); i++) {
+    const auto& layer = layers[i];
+
+    if (layer->get_colorspace() != colorspace ||
+        layer->get_chroma_format() != chroma ||
+        !equal_nclx(layer->get_color_profile_nclx(), first->get_color_profile_nclx())) {
+      return false;
+    }
+
+    std::set<heif_channel> layer_channels = layer->get_channel_set();
+    bool has_alpha = (layer_channels.erase(heif_channel_Alpha) > 0);
+    if (layer_channels != channels) {
+      return false;
+    }
+
+    for (heif_channel channel : channels) {
+      if (layer->get_bits_per_pixel(channel) != first->get_bits_per_pixel(channel)) {
+        return false;
+      }
+    }
+
+    if (subsampled) {
+      int32_t dx, dy;
+      overlay_spec.get_offset(i, &dx, &dy);
+
+      if (has_alpha || dx % static_cast<int32_t>(sub_h) != 0 || dy % static_cast<int32_t>(sub_v) != 0) {
+        return false;
+      }
+    }
   }
-  if (auto error = img->add_plane(heif_channel_B, w, h, 8, get_context()->get_security_limits())) { // TODO: other bit depths
+
+  return true;
+}
+
+
+// Creates the canvas in the format of 'format_image' (without alpha) and fills it with the RGB background color.
+static Result<std::shared_ptr<HeifPixelImage>> create_overlay_canvas(uint32_t w, uint32_t h,
+                                                                     const HeifPixelImage& format_image,
+                                                                     const uint16_t bkg_color[4],
+                                                                     const heif_decoding_options& options,
+                                                                     const heif_security_limits* limits)
+{
+  heif_colorspace colorspace = format_image.get_colorspace();
+  heif_chroma chroma = format_image.get_chroma_format();
+
+  auto canvas = std::make_shared<HeifPixelImage>();
+  canvas->create(w, h, colorspace, chroma);
+  canvas->set_color_profile_nclx(format_image.get_color_profile_nclx());
+
+  for (heif_channel channel : format_image.get_channel_set()) {
+    if (channel == heif_channel_Alpha) {
+      continue;
+    }
+
+    uint32_t plane_w, plane_h;
+    get_subsampled_size(w, h, channel, chroma, &plane_w, &plane_h);
+
+    if (auto error = canvas->add_plane(channel, plane_w, plane_h, format_image.get_bits_per_pixel(channel), limits)) {
+      return error;
+    }
+  }
+
+  if (colorspace == heif_colorspace_RGB) {
+    if (auto error = canvas->fill_RGB_16bit(bkg_color[0], bkg_color[1], bkg_color[2], bkg_color[3])) {
+      return error;
+    }
+
+    return canvas;
+  }
+
+
+  // The background color is given in RGB. Convert a single chroma block of it into the canvas format.
+
+  uint32_t block_w = chroma_h_subsampling(chroma);
+  uint32_t block_h = chroma_v_subsampling(chroma);
+  int bpp = format_image.get_visual_image_bits_per_pixel();
+
+  auto bkg = std::make_shared<HeifPixelImage>();
+  bkg->create(block_w, block_h, heif_colorspace_RGB, heif_chroma_444);
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    if (auto error = bkg->add_plane(channel, block_w, block_h, bpp, limits)) {
+      return error;
+    }
+  }
+
+  if (auto error = bkg->fill_RGB_16bit(bkg_color[0], bkg_color[1], bkg_color[2], bkg_color[3])) {
     return error;
   }
 
-  uint16_t bkg_color[4];
-  m_overlay_spec.get_background_color(bkg_color);
+  // There is no direct conversion to monochrome. Take the luma of the YCbCr conversion instead.
+  heif_colorspace bkg_colorspace = colorspace;
+  heif_chroma bkg_chroma = chroma;
+  if (colorspace == heif_colorspace_monochrome) {
+    bkg_colorspace = heif_colorspace_YCbCr;
+    bkg_chroma = heif_chroma_444;
+  }
+
+  auto bkgResult = convert_colorspace(bkg, bkg_colorspace, bkg_chroma, format_image.get_color_profile_nclx(), bpp,
+                                      options.color_conversion_options, options.color_conversion_options_ext, limits);
+  if (bkgResult.error) {
+    return bkgResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> converted_bkg = *bkgResult;
+
+  for (heif_channel channel : canvas->get_channel_set()) {
+    if (!converted_bkg->has_channel(channel) ||
+        converted_bkg->get_bits_per_pixel(channel) != canvas->get_bits_per_pixel(channel)) {
+      return Error{heif_error_Unsupported_feature,
+                   heif_suberror_Unsupported_color_conversion,
+                   "Cannot convert 'iovl' background color to the canvas format"};
+    }
+
+    size_t stride;
+    uint16_t value;
+    if (converted_bkg->get_bits_per_pixel(channel) <= 8) {
+      value = converted_bkg->get_channel<uint8_t>(channel, &stride)[0];
+    }
+    else {
+      value = converted_bkg->get_channel<uint16_t>(channel, &stride)[0];
+    }
+
+    canvas->fill_plane(channel, value);
+  }
+
+  return canvas;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_Overlay::decode_overlay_image(const heif_decoding_options& options) const
+{
+  uint32_t w = m_overlay_spec.get_canvas_width();
+  uint32_t h = m_overlay_spec.get_canvas_height();
+
+  const heif_security_limits* limits = get_context()->get_security_limits();
 
-  err = img->fill_RGB_16bit(bkg_color[0], bkg_color[1], bkg_color[2], bkg_color[3]);
+  Error err = check_for_valid_image_size(limits, w, h);
   if (err) {
     return err;
   }
@@ -332,33 +490,149 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Overlay::decode_overlay_image(
     if (auto error = imgItem->get_item_error()) {
       return error;
     }
+  }
+
+
+  // --- The layers are independent of each other until they are composited.
+  //     Decode all of them first (in parallel, if possible) and paste them afterward in the specified order.
+
+  const size_t num_layers = m_overlay_image_ids.size();
+
+  heif_decoding_options layer_options = options;
+  size_t num_tasks = 1;
+
+#if ENABLE_PARALLEL_TILE_DECODING
+  if (get_context()->get_max_decoding_threads() > 0 && num_layers > 1) {
+    num_tasks = std::min(num_layers, static_cast<size_t>(get_context()->get_max_decoding_threads()));
+    layer_options = get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), num_tasks);
+  }
+#endif
+
+  std::vector<Error> layer_errors(num_layers);
+
+  auto for_each_layer = [&](const std::function<Error(size_t)>& process_layer) -> Error {
+#if ENABLE_PARALLEL_TILE_DECODING
+    if (num_tasks > 1) {
+      std::atomic<size_t> next_layer{0};
+      DecodingStatistics* statistics = DecodingStatistics::current();
+
+      TaskGroup tasks;
+      for (size_t t = 0; t < num_tasks; t++) {
+        tasks.run([&]() {
+          DecodingStatisticsScope statistics_scope(statistics);
+
+          for (size_t i = next_layer++; i < num_layers; i = next_layer++) {
+            layer_errors[i] = process_layer(i);
+          }
+        });
+      }
+
+      tasks.wait();
+    }
+    else
+#endif
+    {
+      for (size_t i = 0; i < num_layers; i++) {
+        layer_errors[i] = process_layer(i);
+        if (layer_errors[i]) {
+          return layer_errors[i];
+        }
+      }
+    }
+
+    // report the error of the first layer that failed
+    for (const Error& layer_error : layer_errors) {
+      if (layer_error) {
+        return layer_error;
+      }
+    }
+
+    return Error::Ok;
+  };
 
-    auto decodeResult = imgItem->decode_image(options, false, 0,0);
+  std::vector<std::shared_ptr<HeifPixelImage>> layers(num_layers);
+
+  err = for_each_layer([&](size_t i) -> Error {
+    auto imgItem = get_context()->get_image(m_overlay_image_ids[i], true);
+
+    auto decodeResult = get_context()->decode_derived_image_source(*imgItem, layer_options);
     if (decodeResult.error) {
       return decodeResult.error;
     }
 
-    std::shared_ptr<HeifPixelImage> overlay_img = decodeResult.value;
+    layers[i] = *decodeResult;
+    return Error::Ok;
+  });
+  if (err) {
+    return err;
+  }
+
+
+  // --- Composite in the format of the layers if they all share it. Otherwise, convert them to RGB.
 
+  uint16_t bkg_color[4];
+  m_overlay_spec.get_background_color(bkg_color);
+
+  std::shared_ptr<HeifPixelImage> img;
 
-    // process overlay in RGB space
+  if (layers_share_native_format(layers, m_overlay_spec)) {
+    // If the background color cannot be converted into the canvas format, we fall back to compositing in RGB.
+    auto canvasResult = create_overlay_canvas(w, h, *layers[0], bkg_color, options, limits);
+    if (canvasResult) {
+      img = *canvasResult;
+    }
+  }
+
+  if (!img) {
+    int bpp = 8;
+    for (const auto& layer : layers) {
+      bpp = std::max(bpp, static_cast<int>(layer->get_visual_image_bits_per_pixel()));
+    }
 
-    if (overlay_img->get_colorspace() != heif_colorspace_RGB ||
-        overlay_img->get_chroma_format() != heif_chroma_444) {
-      auto overlay_img_result = convert_colorspace(overlay_img, heif_colorspace_RGB, heif_chroma_444, nullptr, 0, options.color_conversion_options, options.color_conversion_options_ext,
-                                                   get_context()->get_security_limits());
-      if (overlay_img_result.error) {
-        return overlay_img_result.error;
+    HeifPixelImage format_image;
+    format_image.create(1, 1, heif_colorspace_RGB, heif_chroma_444);
+    for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+      if (auto error = format_image.add_plane(channel, 1, 1, bpp, limits)) {
+        return error;
       }
-      else {
-        overlay_img = *overlay_img_result;
+    }
+
+    auto canvasResult = create_overlay_canvas(w, h, format_image, bkg_color, options, limits);
+    if (canvasResult.error) {
+      return canvasResult.error;
+    }
+
+    img = *canvasResult;
+
+    err = for_each_layer([&](size_t i) -> Error {
+      auto& layer = layers[i];
+
+      if (layer->get_colorspace() != heif_colorspace_RGB ||
+          layer->get_chroma_format() != heif_chroma_444 ||
+          !layer->has_channel(heif_channel_R) ||
+          layer->get_bits_per_pixel(heif_channel_R) != bpp) {
+        auto convResult = convert_colorspace(layer, heif_colorspace_RGB, heif_chroma_444, nullptr, bpp,
+                                             options.color_conversion_options, options.color_conversion_options_ext,
+                                             limits);
+        if (convResult.error) {
+          return convResult.error;
+        }
+
+        layer = *convResult;
       }
+
+      return Error::Ok;
+    });
+    if (err) {
+      return err;
     }
+  }
 
+  for (size_t i = 0; i < num_layers; i++) {
     int32_t dx, dy;
     m_overlay_spec.get_offset(i, &dx, &dy);
 
-    err = img->overlay(overlay_img, dx, dy);
+    err = img->overlay(layers[i], dx, dy);
     if (err) {
       if (err.error_code == heif_error_Invalid_input &&
           err.sub_error_code == heif_suberror_Overlay_image_outside_of_canvas) {
@@ -368,6 +642,9 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_Overlay::decode_overlay_image(
         return err;
       }
     }
+
+    // release the layer as soon as it is pasted
+    layers[i].reset();
   }
 
   return img;
@@ -437,7 +714,10 @@ Result<std::shared_ptr<ImageItem_Overlay>> ImageItem_Overlay::add_new_overlay_it
   std::shared_ptr<ImageItem_Overlay> iovl_image = std::make_shared<ImageItem_Overlay>(ctx, iovl_id);
   ctx->insert_image_item(iovl_id, iovl_image);
   const int construction_method = 1; // 0=mdat 1=idat
-  file->append_iloc_data(iovl_id, iovl_data, construction_method);
+  Error err = file->append_iloc_data(iovl_id, iovl_data, construction_method);
+  if (err) {
+    return err;
+  }
 
   // Connect images to overlay
   file->add_iref_reference(iovl_id, fourcc("dimg"), ref_ids);
@@ -540,12 +540,7 @@ Error ImageItem_Tiled::on_load_file()
   // For backwards compatibility: copy over properties from `tili` item.
   // TODO: remove when spec is final and old test images have been converted
   if (tilC_box->get_version() == 1) {
-    auto propertiesResult = get_properties();
-    if (propertiesResult.error) {
-      return propertiesResult.error;
-    }
-
-    m_tile_item->set_properties(*propertiesResult);
+    m_tile_item->set_properties(get_properties());
   }
   else {
     // --- This is the new method
@@ -578,6 +573,8 @@ Error ImageItem_Tiled::on_load_file()
             "'tili' image with unsupported compression format."};
   }
 
+  m_tile_decoder->set_instance_pool(get_context()->get_decoder_instance_pool());
+
   if (m_preload_offset_table) {
     if (Error err = m_tild_header.read_full_offset_table(heif_file, get_id(), get_context()->get_security_limits())) {
       return err;
@@ -626,7 +623,10 @@ ImageItem_Tiled::add_new_tiled_item(HeifContext* ctx, const heif_tiled_image_par
   std::vector<uint8_t> header_data = tild_header.write_offset_table();
 
   const int construction_method = 0; // 0=mdat 1=idat
-  file->append_iloc_data(tild_id, header_data, construction_method);
+  Error err = file->append_iloc_data(tild_id, header_data, construction_method);
+  if (err) {
+    return err;
+  }
 
 
   if (parameters->image_width > 0xFFFFFFFF || parameters->image_height > 0xFFFFFFFF) {
@@ -674,7 +674,7 @@ Error ImageItem_Tiled::add_image_tile(uint32_t tile_x, uint32_t tile_y,
     return colorConversionResult.error;
   }
 
-  std::shared_ptr<HeifPixelImage> colorConvertedImage = colorConversionResult.value;
+  std::shared_ptr<HeifPixelImage> colorConvertedImage = std::move(colorConversionResult.value);
 
   Result<Encoder::CodedImageData> encodeResult = item->encode_to_bitstream_and_boxes(colorConvertedImage, encoder, *options, heif_image_input_class_normal); // TODO (other than JPEG)
   heif_encoding_options_free(options);
@@ -684,7 +684,10 @@ Error ImageItem_Tiled::add_image_tile(uint32_t tile_x, uint32_t tile_y,
   }
 
   const int construction_method = 0; // 0=mdat 1=idat
-  get_file()->append_iloc_data(get_id(), encodeResult.value.bitstream, construction_method);
+  Error err = get_file()->append_iloc_data(get_id(), encodeResult.value.bitstream, construction_method);
+  if (err) {
+    return err;
+  }
 
   auto& header = m_tild_header;
 
@@ -731,7 +734,7 @@ Error ImageItem_Tiled::add_image_tile(uint32_t tile_x, uint32_t tile_y,
 
     switch (propertyBox->get_short_type()) {
       case fourcc("pixi"):
-        get_file()->add_property(get_id(), propertyBox, propertyBox->is_essential());
+        add_property(propertyBox, propertyBox->is_essential());
         break;
     }
   }
@@ -743,14 +746,19 @@ Error ImageItem_Tiled::add_image_tile(uint32_t tile_x, uint32_t tile_y,
 }
 
 
-void ImageItem_Tiled::process_before_write()
+Error ImageItem_Tiled::process_before_write()
 {
+  if (m_next_tild_position == 0) {
+    // The image has been read from a file. Its offset table is copied unchanged.
+    return Error::Ok;
+  }
+
   // overwrite offsets
 
   const int construction_method = 0; // 0=mdat 1=idat
 
   std::vector<uint8_t> header_data = m_tild_header.write_offset_table();
-  get_file()->replace_iloc_data(get_id(), 0, header_data, construction_method);
+  return get_file()->replace_iloc_data(get_id(), 0, header_data, construction_method);
 }
 
 
@@ -772,15 +780,24 @@ Error ImageItem_Tiled::append_compressed_tile_data(std::vector<uint8_t>& data, u
 {
   uint32_t idx = (uint32_t) (ty * nTiles_h(m_tild_header.get_parameters()) + tx);
 
-  if (!m_tild_header.is_tile_offset_known(idx)) {
-    Error err = const_cast<ImageItem_Tiled*>(this)->load_tile_offset_entry(idx);
-    if (err) {
-      return err;
+  uint64_t offset;
+  uint64_t size;
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_offset_table_mutex);
+#endif
+
+    if (!m_tild_header.is_tile_offset_known(idx)) {
+      Error err = const_cast<ImageItem_Tiled*>(this)->load_tile_offset_entry(idx);
+      if (err) {
+        return err;
+      }
     }
-  }
 
-  uint64_t offset = m_tild_header.get_tile_offset(idx);
-  uint64_t size = m_tild_header.get_tile_size(idx);
+    offset = m_tild_header.get_tile_offset(idx);
+    size = m_tild_header.get_tile_size(idx);
+  }
 
   Error err = get_file()->append_data_from_iloc(get_id(), data, offset, size);
   if (err.error_code) {
@@ -815,7 +832,7 @@ ImageItem_Tiled::get_compressed_data_for_tile(uint32_t tx, uint32_t ty) const
   // --- decode
 
   DataExtent extent;
-  extent.m_raw = data;
+  extent.m_raw = std::move(data);
 
   return extent;
 }
@@ -824,6 +841,10 @@ ImageItem_Tiled::get_compressed_data_for_tile(uint32_t tx, uint32_t ty) const
 Result<std::shared_ptr<HeifPixelImage>>
 ImageItem_Tiled::decode_grid_tile(const heif_decoding_options& options, uint32_t tx, uint32_t ty) const
 {
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_tile_decoder_mutex);
+#endif
+
   Result<DataExtent> extentResult = get_compressed_data_for_tile(tx, ty);
   if (extentResult.error) {
     return extentResult.error;
@@ -831,7 +852,9 @@ ImageItem_Tiled::decode_grid_tile(const heif_decoding_options& options, uint32_t
 
   m_tile_decoder->set_data_extent(std::move(*extentResult));
 
-  return m_tile_decoder->decode_single_frame_from_compressed_data(options);
+  heif_decoding_options tile_options = get_decoding_options_with_codec_threads(options, get_context()->get_max_decoding_threads(), 1);
+
+  return m_tile_decoder->decode_single_frame_from_compressed_data(get_full_resolution_decoding_options(tile_options));
 }
 
 
@@ -844,6 +867,81 @@ Error ImageItem_Tiled::load_tile_offset_entry(uint32_t idx)
 }
 
 
+Error ImageItem_Tiled::prefetch_tiles(uint32_t tx0, uint32_t ty0, uint32_t tx1, uint32_t ty1) const
+{
+  const uint32_t nColumns = nTiles_h(m_tild_header.get_parameters());
+  const uint32_t entry_size = m_tild_header.get_offset_table_entry_size();
+  const uint32_t nEntries = mReadChunkSize_bytes / entry_size;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_offset_table_mutex);
+#endif
+
+  // --- collect the parts of the offset table that are still missing
+
+  std::vector<std::pair<uint32_t, uint32_t>> table_ranges;
+
+  for (uint32_t ty = ty0; ty <= ty1; ty++) {
+    for (uint32_t tx = tx0; tx <= tx1; tx++) {
+      uint32_t idx = ty * nColumns + tx;
+      if (!m_tild_header.is_tile_offset_known(idx)) {
+        table_ranges.push_back(m_tild_header.get_tile_offset_table_range_to_read(idx, nEntries));
+      }
+    }
+  }
+
+  if (!table_ranges.empty()) {
+    std::sort(table_ranges.begin(), table_ranges.end());
+
+    std::vector<std::pair<uint32_t, uint32_t>> merged_ranges{table_ranges[0]};
+    for (size_t i = 1; i < table_ranges.size(); i++) {
+      if (table_ranges[i].first <= merged_ranges.back().second) {
+        merged_ranges.back().second = std::max(merged_ranges.back().second, table_ranges[i].second);
+      }
+      else {
+        merged_ranges.push_back(table_ranges[i]);
+      }
+    }
+
+    // Announce all ranges before reading the first one so that the reader can fetch them together.
+
+    std::vector<HeifFile::ItemDataRange> hints;
+    for (const auto& range : merged_ranges) {
+      hints.push_back({get_id(), uint64_t{range.first} * entry_size, uint64_t{range.second - range.first} * entry_size});
+    }
+
+    get_file()->preload_item_data_ranges(hints);
+
+    for (const auto& range : merged_ranges) {
+      Error err = const_cast<TiledHeader&>(m_tild_header).read_offset_table_range(get_file(), get_id(), range.first, range.second);
+      if (err) {
+        return err;
+      }
+    }
+  }
+
+  // --- announce the tile data
+
+  std::vector<HeifFile::ItemDataRange> hints;
+
+  for (uint32_t ty = ty0; ty <= ty1; ty++) {
+    for (uint32_t tx = tx0; tx <= tx1; tx++) {
+      uint32_t idx = ty * nColumns + tx;
+      uint64_t offset = m_tild_header.get_tile_offset(idx);
+      uint32_t size = m_tild_header.get_tile_size(idx);
+
+      if (offset != TILD_OFFSET_NOT_AVAILABLE && offset != TILD_OFFSET_SEE_LOWER_RESOLUTION_LAYER && size != 0) {
+        hints.push_back({get_id(), offset, size});
+      }
+    }
+  }
+
+  get_file()->preload_item_data_ranges(hints);
+
+  return Error::Ok;
+}
+
+
 heif_image_tiling ImageItem_Tiled::get_heif_image_tiling() const
 {
   heif_image_tiling tiling{};
@@ -876,6 +974,10 @@ Error ImageItem_Tiled::get_coded_image_colorspace(heif_colorspace* out_colorspac
 {
   uint32_t tx=0, ty=0; // TODO: find a tile that is defined.
 
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_tile_decoder_mutex);
+#endif
+
   Result<DataExtent> extentResult = get_compressed_data_for_tile(tx, ty);
   if (extentResult.error) {
     return extentResult.error;
@@ -896,6 +998,10 @@ Error ImageItem_Tiled::get_coded_image_colorspace(heif_colorspace* out_colorspac
 
 int ImageItem_Tiled::get_luma_bits_per_pixel() const
 {
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_tile_decoder_mutex);
+#endif
+
   DataExtent any_tile_extent;
   append_compressed_tile_data(any_tile_extent.m_raw, 0,0); // TODO: use tile that is already loaded
   m_tile_decoder->set_data_extent(std::move(any_tile_extent));
@@ -905,6 +1011,10 @@ int ImageItem_Tiled::get_luma_bits_per_pixel() const
 
 int ImageItem_Tiled::get_chroma_bits_per_pixel() const
 {
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_tile_decoder_mutex);
+#endif
+
   DataExtent any_tile_extent;
   append_compressed_tile_data(any_tile_extent.m_raw, 0,0); // TODO: use tile that is already loaded
   m_tile_decoder->set_data_extent(std::move(any_tile_extent));
@@ -28,6 +28,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include "libheif/heif_experimental.h"
 
@@ -163,7 +164,7 @@ public:
 
   Error on_load_file() override;
 
-  void process_before_write() override;
+  Error process_before_write() override;
 
   Error get_coded_image_colorspace(heif_colorspace* out_colorspace, heif_chroma* out_chroma) const override;
 
@@ -207,6 +208,11 @@ private:
   std::shared_ptr<ImageItem> m_tile_item;
   std::shared_ptr<class Decoder> m_tile_decoder;
 
+  // The offset table is loaded lazily and the tiles share one decoder. Tiles of the same image can be
+  // decoded from several threads, but the decoding of tiles is serialized.
+  mutable std::mutex m_offset_table_mutex;
+  mutable std::mutex m_tile_decoder_mutex;
+
   Result<DataExtent>
   get_compressed_data_for_tile(uint32_t tx, uint32_t ty) const;
 
@@ -214,6 +220,8 @@ private:
 
   Error load_tile_offset_entry(uint32_t idx);
 
+  Error prefetch_tiles(uint32_t tx0, uint32_t ty0, uint32_t tx1, uint32_t ty1) const override;
+
   Error append_compressed_tile_data(std::vector<uint8_t>& data, uint32_t tx, uint32_t ty) const;
 };
 
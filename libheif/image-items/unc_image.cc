@@ -18,6 +18,7 @@
  * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <bit>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
@@ -25,6 +26,7 @@
 #include <iostream>
 #include <cassert>
 #include <utility>
+#include <limits>
 
 #include "common_utils.h"
 #include "context.h"
@@ -37,7 +39,11 @@
 #include "codecs/uncompressed/unc_dec.h"
 #include "codecs/uncompressed/unc_enc.h"
 #include "codecs/uncompressed/unc_codec.h"
+#include "codecs/uncompressed/decoder_abstract.h"
 #include "image_item.h"
+#include "thread_pool.h"
+#include "decoding_statistics.h"
+#include "tracing.h"
 
 
 
@@ -74,6 +80,25 @@ ImageItem_uncompressed::ImageItem_uncompressed(HeifContext* ctx)
   m_encoder = std::make_shared<Encoder_uncompressed>();
 }
 
+struct ImageItem_uncompressed::PendingTile
+{
+  uint32_t tile_idx = 0;
+  std::vector<uint8_t> raw_data;
+  std::vector<uint8_t> compressed_data;
+
+  // heif_unci_compression_auto: the tile compressed with each of the candidate methods
+  uint64_t raw_size = 0;
+  std::vector<std::vector<uint8_t>> candidate_data;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  // Declared last, so that it is destroyed first and waits for the compression task.
+  TaskGroup task;
+#endif
+};
+
+
+ImageItem_uncompressed::~ImageItem_uncompressed() = default;
+
 
 Result<std::shared_ptr<HeifPixelImage>> ImageItem_uncompressed::decode_compressed_image(const struct heif_decoding_options& options,
                                                                                 bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const
@@ -82,6 +107,10 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_uncompressed::decode_compresse
 
   std::vector<uint8_t> data;
 
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+  HEIF_TRACE_SCOPE("decode", "codec");
+
   Error err;
 
   if (decode_tile_only) {
@@ -105,6 +134,78 @@ Result<std::shared_ptr<HeifPixelImage>> ImageItem_uncompressed::decode_compresse
 }
 
 
+extern heif_color_conversion_options_ext normalize_options(const heif_color_conversion_options_ext* input_options);
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_uncompressed::decode_compressed_image_converted(const struct heif_decoding_options& options,
+                                                                                                  const OutputFormat& output_format) const
+{
+  auto cpat = get_property<Box_cpat>();
+  auto cmpd = get_property<Box_cmpd>();
+  if (!cpat || !cmpd || output_format.colorspace != heif_colorspace_RGB) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  auto patternResult = get_filter_array_pattern(cpat, cmpd);
+  if (patternResult.error) {
+    return patternResult.error;
+  }
+
+  auto rawResult = decode_compressed_image(options, false, 0, 0);
+  if (rawResult.error) {
+    return rawResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> raw = *rawResult;
+
+  // Only the filter array itself is demosaiced. Images with additional components are converted as usual.
+  if (raw->get_colorspace() != heif_colorspace_monochrome ||
+      raw->has_alpha()) {
+    return std::shared_ptr<HeifPixelImage>();
+  }
+
+  heif_color_conversion_options_ext options_ext = normalize_options(options.color_conversion_options_ext);
+
+  // Without an explicit number of conversion threads, use the decoding threads of the context.
+  if (options.color_conversion_options_ext == nullptr || options.color_conversion_options_ext->version < 2) {
+    options_ext.max_threads = get_context()->get_max_decoding_threads();
+  }
+
+  DecodingStageTimer timer(&DecodingStatistics::color_conversion_time_us);
+
+  auto rgbResult = demosaic_filter_array(raw, *patternResult, options_ext.demosaic_method, options_ext.max_threads,
+                                         get_context()->get_security_limits());
+  if (rgbResult.error) {
+    return rgbResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> rgb = *rgbResult;
+
+  // The demosaiced image keeps the color profile of the image item.
+  rgb->set_color_profile_nclx(get_color_profile_nclx());
+
+  return rgb;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> ImageItem_uncompressed::decode_compressed_image_area(const struct heif_decoding_options& options,
+                                                                                           uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+{
+  DecodingStageTimer timer(&DecodingStatistics::codec_time_us);
+  HEIF_TRACE_SCOPE("decode", "codec area");
+
+  auto areaResult = UncompressedImageCodec::decode_uncompressed_image_area(get_context(), get_id(), x0, y0, w, h);
+  if (areaResult.error) {
+    return areaResult.error;
+  }
+
+  if (*areaResult) {
+    DecodingStatistics::add(&DecodingStatistics::num_codec_decodes, 1);
+  }
+
+  return areaResult;
+}
+
+
 struct unciHeaders
 {
   std::shared_ptr<Box_uncC> uncC;
@@ -144,130 +245,146 @@ static Result<unciHeaders> generate_headers(const std::shared_ptr<const HeifPixe
 }
 
 
-Result<std::vector<uint8_t>> encode_image_tile(const std::shared_ptr<const HeifPixelImage>& src_image)
+// Returns the planes in the order of the components that fill_cmpd_and_uncC() writes into 'uncC'.
+static Result<std::vector<heif_channel>> get_encoded_channels(const std::shared_ptr<const HeifPixelImage>& src_image)
 {
-  std::vector<uint8_t> data;
-
-  if (src_image->get_colorspace() == heif_colorspace_YCbCr)
-  {
-    uint64_t offset = 0;
-    for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr})
-    {
-      size_t src_stride;
-      uint32_t src_width = src_image->get_width(channel);
-      uint32_t src_height = src_image->get_height(channel);
-      const uint8_t* src_data = src_image->get_plane(channel, &src_stride);
-      uint64_t out_size = src_width * uint64_t{src_height};
-      data.resize(data.size() + out_size);
-      for (uint32_t y = 0; y < src_height; y++) {
-        memcpy(data.data() + offset + y * src_width, src_data + src_stride * y, src_width);
-      }
-      offset += out_size;
-    }
+  std::vector<heif_channel> channels;
 
-    return data;
-  }
-  else if (src_image->get_colorspace() == heif_colorspace_RGB)
-  {
-    if (src_image->get_chroma_format() == heif_chroma_444)
-    {
-      uint64_t offset = 0;
-      std::vector<heif_channel> channels = {heif_channel_R, heif_channel_G, heif_channel_B};
-      if (src_image->has_channel(heif_channel_Alpha))
-      {
-        channels.push_back(heif_channel_Alpha);
-      }
-      for (heif_channel channel : channels)
-      {
-        size_t src_stride;
-        const uint8_t* src_data = src_image->get_plane(channel, &src_stride);
-        uint64_t out_size = static_cast<uint64_t>(src_image->get_height()) * src_image->get_width();
-
-        data.resize(data.size() + out_size);
-        for (uint32_t y = 0; y < src_image->get_height(); y++) {
-          memcpy(data.data() + offset + y * src_image->get_width(), src_data + y * src_stride, src_image->get_width());
-        }
+  switch (src_image->get_colorspace()) {
+    case heif_colorspace_YCbCr:
+      channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+      break;
 
-        offset += out_size;
-      }
-
-      return data;
-    }
-    else if ((src_image->get_chroma_format() == heif_chroma_interleaved_RGB) ||
-             (src_image->get_chroma_format() == heif_chroma_interleaved_RGBA) ||
-             (src_image->get_chroma_format() == heif_chroma_interleaved_RRGGBB_BE) ||
-             (src_image->get_chroma_format() == heif_chroma_interleaved_RRGGBB_LE) ||
-             (src_image->get_chroma_format() == heif_chroma_interleaved_RRGGBBAA_BE) ||
-             (src_image->get_chroma_format() == heif_chroma_interleaved_RRGGBBAA_LE))
-    {
-      int bytes_per_pixel = 0;
+    case heif_colorspace_RGB:
       switch (src_image->get_chroma_format()) {
-        case heif_chroma_interleaved_RGB:
-          bytes_per_pixel=3;
+        case heif_chroma_444:
+          channels = {heif_channel_R, heif_channel_G, heif_channel_B};
           break;
+        case heif_chroma_interleaved_RGB:
         case heif_chroma_interleaved_RGBA:
-          bytes_per_pixel=4;
-          break;
         case heif_chroma_interleaved_RRGGBB_BE:
         case heif_chroma_interleaved_RRGGBB_LE:
-          bytes_per_pixel=6;
-          break;
         case heif_chroma_interleaved_RRGGBBAA_BE:
         case heif_chroma_interleaved_RRGGBBAA_LE:
-          bytes_per_pixel=8;
-          break;
+          return std::vector<heif_channel>{heif_channel_interleaved};
         default:
-          assert(false);
+          return Error(heif_error_Unsupported_feature,
+                       heif_suberror_Unsupported_data_version,
+                       "Unsupported RGB chroma");
       }
+      break;
 
-      size_t src_stride;
-      const uint8_t* src_data = src_image->get_plane(heif_channel_interleaved, &src_stride);
-      uint64_t out_size = static_cast<uint64_t>(src_image->get_height()) * src_image->get_width() * bytes_per_pixel;
-      data.resize(out_size);
-      for (uint32_t y = 0; y < src_image->get_height(); y++) {
-        memcpy(data.data() + y * src_image->get_width() * bytes_per_pixel, src_data + src_stride * y, src_image->get_width() * bytes_per_pixel);
-      }
+    case heif_colorspace_monochrome:
+      channels = {heif_channel_Y};
+      break;
 
-      return data;
-    }
-    else
-    {
+    default:
       return Error(heif_error_Unsupported_feature,
                    heif_suberror_Unsupported_data_version,
-                   "Unsupported RGB chroma");
-    }
+                   "Unsupported colourspace");
   }
-  else if (src_image->get_colorspace() == heif_colorspace_monochrome)
-  {
-    uint64_t offset = 0;
-    std::vector<heif_channel> channels;
-    if (src_image->has_channel(heif_channel_Alpha))
-    {
-      channels = {heif_channel_Y, heif_channel_Alpha};
-    }
-    else
-    {
-      channels = {heif_channel_Y};
+
+  if (src_image->get_colorspace() != heif_colorspace_YCbCr &&
+      src_image->has_channel(heif_channel_Alpha)) {
+    channels.push_back(heif_channel_Alpha);
+  }
+
+  return channels;
+}
+
+
+static uint64_t get_encoded_bytes_per_row(const std::shared_ptr<const HeifPixelImage>& src_image, heif_channel channel)
+{
+  uint32_t width = src_image->get_width(channel);
+
+  if (channel == heif_channel_interleaved) {
+    return uint64_t{width} * (src_image->get_storage_bits_per_pixel(channel) / 8);
+  }
+  else {
+    return uint64_t{width} * (src_image->get_bits_per_pixel(channel) > 8 ? 2 : 1);
+  }
+}
+
+
+// Copies the rows of one plane. Samples with more than 8 bits are written in big-endian byte order.
+static uint8_t* encode_plane(const std::shared_ptr<const HeifPixelImage>& src_image, heif_channel channel, uint8_t* dst)
+{
+  size_t src_stride;
+  const uint8_t* src_data = src_image->get_plane(channel, &src_stride);
+  uint32_t height = src_image->get_height(channel);
+  uint64_t row_bytes = get_encoded_bytes_per_row(src_image, channel);
+
+  bool swap_bytes;
+  if (channel == heif_channel_interleaved) {
+    heif_chroma chroma = src_image->get_chroma_format();
+    swap_bytes = (chroma == heif_chroma_interleaved_RRGGBB_LE ||
+                  chroma == heif_chroma_interleaved_RRGGBBAA_LE);
+  }
+  else {
+    swap_bytes = (src_image->get_bits_per_pixel(channel) > 8 &&
+                  std::endian::native == std::endian::little);
+  }
+
+  for (uint32_t y = 0; y < height; y++) {
+    if (swap_bytes) {
+      unc_swap16_row(src_data + src_stride * y, dst, static_cast<uint32_t>(row_bytes / 2));
     }
-    for (heif_channel channel : channels)
-    {
-      size_t src_stride;
-      const uint8_t* src_data = src_image->get_plane(channel, &src_stride);
-      uint64_t out_size = static_cast<uint64_t>(src_image->get_height()) * src_stride;
-      data.resize(data.size() + out_size);
-      memcpy(data.data() + offset, src_data, out_size);
-      offset += out_size;
+    else {
+      memcpy(dst, src_data + src_stride * y, row_bytes);
     }
 
-    return data;
+    dst += row_bytes;
   }
-  else
-  {
-    return Error(heif_error_Unsupported_feature,
-                 heif_suberror_Unsupported_data_version,
-                 "Unsupported colourspace");
+
+  return dst;
+}
+
+
+static Result<uint64_t> get_encoded_tile_size(const std::shared_ptr<const HeifPixelImage>& src_image)
+{
+  Result<std::vector<heif_channel>> channels = get_encoded_channels(src_image);
+  if (channels.error) {
+    return channels.error;
   }
 
+  uint64_t size = 0;
+  for (heif_channel channel : *channels) {
+    size += get_encoded_bytes_per_row(src_image, channel) * src_image->get_height(channel);
+  }
+
+  return size;
+}
+
+
+static Error encode_image_tile(const std::shared_ptr<const HeifPixelImage>& src_image, uint8_t* dst)
+{
+  Result<std::vector<heif_channel>> channels = get_encoded_channels(src_image);
+  if (channels.error) {
+    return channels.error;
+  }
+
+  for (heif_channel channel : *channels) {
+    dst = encode_plane(src_image, channel, dst);
+  }
+
+  return Error::Ok;
+}
+
+
+static Result<std::vector<uint8_t>> encode_image_tile(const std::shared_ptr<const HeifPixelImage>& src_image)
+{
+  Result<uint64_t> size = get_encoded_tile_size(src_image);
+  if (size.error) {
+    return size.error;
+  }
+
+  std::vector<uint8_t> data(*size);
+
+  if (Error err = encode_image_tile(src_image, data.data())) {
+    return err;
+  }
+
+  return data;
 }
 
 
@@ -315,12 +432,68 @@ Result<Encoder::CodedImageData> ImageItem_uncompressed::encode_static(const std:
     return codedBitstreamResult.error;
   }
 
-  codedImageData.bitstream = *codedBitstreamResult;
+  codedImageData.bitstream = std::move(*codedBitstreamResult);
 
   return codedImageData;
 }
 
 
+namespace {
+  struct CompressionCandidate
+  {
+    uint32_t compression_type;
+    bool stored; // 'defl' with uncompressed blocks
+  };
+}
+
+
+// The methods tried with heif_unci_compression_auto. 'zlib' is not tried, because it is 'defl' with an additional checksum.
+static const std::vector<CompressionCandidate>& get_compression_candidates()
+{
+  static const std::vector<CompressionCandidate> candidates = {
+#if HAVE_ZLIB
+      {fourcc("defl"), false},
+      {fourcc("defl"), true},
+#endif
+#if HAVE_BROTLI
+      {fourcc("brot"), false},
+#endif
+#if HAVE_ZSTD
+      {fourcc("zstd"), false},
+#endif
+  };
+
+  return candidates;
+}
+
+
+// Estimated cost of a compressed tile. For decoding speed, the file size is weighted against the time for
+// decompressing the tile, with the decompression of one byte costing as much as a fraction of a byte in the file.
+// The decompression speeds are rough relative figures: zstd decompresses several times faster than deflate and
+// brotli, stored deflate blocks are merely copied. With these weights, a tile is stored when compression saves
+// less than about a quarter of its size.
+static double get_compression_cost(heif_unci_compression_selection selection, const CompressionCandidate& candidate,
+                                   uint64_t compressed_size, uint64_t raw_size)
+{
+  if (selection != heif_unci_compression_selection_decoding_speed) {
+    return static_cast<double>(compressed_size);
+  }
+
+  double decompression_cost_per_byte;
+  if (candidate.stored) {
+    decompression_cost_per_byte = 0.02;
+  }
+  else if (candidate.compression_type == fourcc("zstd")) {
+    decompression_cost_per_byte = 0.08;
+  }
+  else {
+    decompression_cost_per_byte = 0.25;
+  }
+
+  return static_cast<double>(compressed_size) + decompression_cost_per_byte * static_cast<double>(raw_size);
+}
+
+
 Result<std::shared_ptr<ImageItem_uncompressed>> ImageItem_uncompressed::add_unci_item(HeifContext* ctx,
                                                                                       const heif_unci_image_parameters* parameters,
                                                                                       const struct heif_encoding_options* encoding_options,
@@ -335,6 +508,40 @@ Result<std::shared_ptr<ImageItem_uncompressed>> ImageItem_uncompressed::add_unci
                  "ISO 23001-17 image size must be an integer multiple of the tile size."};
   }
 
+  // Check that the compression method is supported
+
+  uint32_t compression_type = 0;
+
+  if (parameters->compression == heif_unci_compression_off) {
+  }
+  else if (parameters->compression == heif_unci_compression_auto && !get_compression_candidates().empty()) {
+    // preliminary, replaced when the method has been selected
+    compression_type = get_compression_candidates()[0].compression_type;
+  }
+#if HAVE_ZLIB
+  else if (parameters->compression == heif_unci_compression_deflate) {
+    compression_type = fourcc("defl");
+  }
+  else if (parameters->compression == heif_unci_compression_zlib) {
+    compression_type = fourcc("zlib");
+  }
+#endif
+#if HAVE_BROTLI
+  else if (parameters->compression == heif_unci_compression_brotli) {
+    compression_type = fourcc("brot");
+  }
+#endif
+#if HAVE_ZSTD
+  else if (parameters->compression == heif_unci_compression_zstd) {
+    compression_type = fourcc("zstd");
+  }
+#endif
+  else {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_generic_compression_method,
+                 "The 'unci' compression method is not supported by this build of libheif."};
+  }
+
   // Create 'unci' Item
 
   auto file = ctx->get_heif_file();
@@ -376,26 +583,20 @@ Result<std::shared_ptr<ImageItem_uncompressed>> ImageItem_uncompressed::add_unci
     auto cmpC = std::make_shared<Box_cmpC>();
     cmpC->set_compressed_unit_type(heif_cmpC_compressed_unit_type_image_tile);
 
-    if (false) {
-    }
-#if HAVE_ZLIB
-    else if (parameters->compression == heif_unci_compression_deflate) {
-      cmpC->set_compression_type(fourcc("defl"));
-    }
-    else if (parameters->compression == heif_unci_compression_zlib) {
-      cmpC->set_compression_type(fourcc("zlib"));
-    }
-#endif
-#if HAVE_BROTLI
-    else if (parameters->compression == heif_unci_compression_brotli) {
-      cmpC->set_compression_type(fourcc("brot"));
+    cmpC->set_compression_type(compression_type);
+
+    if (parameters->compression == heif_unci_compression_auto) {
+      unci_image->m_select_compression = true;
+      if (parameters->version >= 2) {
+        unci_image->m_compression_selection = parameters->compression_selection;
+      }
+
+      // The compression type is still changed, so the box must not be shared with other images.
+      unci_image->add_property_without_deduplication(cmpC, true);
     }
-#endif
     else {
-      assert(false);
+      unci_image->add_property(cmpC, true);
     }
-
-    unci_image->add_property(cmpC, true);
     unci_image->add_property_without_deduplication(icef, true); // icef is empty. A normal add_property() would lead to a wrong deduplication.
   }
 
@@ -412,7 +613,10 @@ Result<std::shared_ptr<ImageItem_uncompressed>> ImageItem_uncompressed::add_unci
 
     for (uint64_t i = 0; i < nTiles; i++) {
       const int construction_method = 0; // 0=mdat 1=idat
-      file->append_iloc_data(unci_id, dummydata, construction_method);
+      Error err = file->append_iloc_data(unci_id, dummydata, construction_method);
+      if (err) {
+        return err;
+      }
     }
   }
 
@@ -423,6 +627,160 @@ Result<std::shared_ptr<ImageItem_uncompressed>> ImageItem_uncompressed::add_unci
 }
 
 
+static std::vector<uint8_t> compress_unit(uint32_t compression_type, const std::vector<uint8_t>& raw_data)
+{
+  (void)raw_data;
+
+  switch (compression_type) {
+#if HAVE_ZLIB
+    case fourcc("defl"):
+      return compress_deflate(raw_data.data(), raw_data.size());
+    case fourcc("zlib"):
+      return compress_zlib(raw_data.data(), raw_data.size());
+#endif
+#if HAVE_BROTLI
+    case fourcc("brot"):
+      return compress_brotli(raw_data.data(), raw_data.size());
+#endif
+#if HAVE_ZSTD
+    case fourcc("zstd"):
+      return compress_zstd(raw_data.data(), raw_data.size());
+#endif
+    default:
+      assert(false);
+      return {};
+  }
+}
+
+
+static std::vector<uint8_t> compress_unit(const CompressionCandidate& candidate, const std::vector<uint8_t>& raw_data)
+{
+#if HAVE_ZLIB
+  if (candidate.stored) {
+    return compress_deflate(raw_data.data(), raw_data.size(), 0);
+  }
+#endif
+
+  return compress_unit(candidate.compression_type, raw_data);
+}
+
+
+Error ImageItem_uncompressed::write_compressed_tile(uint32_t tile_idx, const std::vector<uint8_t>& compressed_data)
+{
+  Error err = get_file()->append_iloc_data(get_id(), compressed_data, 0);
+  if (err) {
+    return err;
+  }
+
+  Box_icef::CompressedUnitInfo unit_info;
+  unit_info.unit_offset = m_next_tile_write_pos;
+  unit_info.unit_size = compressed_data.size();
+
+  std::shared_ptr<Box_icef> icef = get_property<Box_icef>();
+  icef->set_component(tile_idx, unit_info);
+
+  m_next_tile_write_pos += compressed_data.size();
+
+  return Error::Ok;
+}
+
+
+Error ImageItem_uncompressed::write_pending_tiles(size_t max_pending)
+{
+  while (m_pending_tiles.size() > max_pending) {
+    PendingTile& tile = *m_pending_tiles.front();
+#if ENABLE_MULTITHREADING_SUPPORT
+    tile.task.wait();
+#endif
+
+    Error err = write_compressed_tile(tile.tile_idx, tile.compressed_data);
+
+    m_pending_tiles.pop_front();
+
+    if (err) {
+      return err;
+    }
+  }
+
+  return Error::Ok;
+}
+
+
+Error ImageItem_uncompressed::select_compression_method()
+{
+  const std::vector<CompressionCandidate>& candidates = get_compression_candidates();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  for (auto& tile : m_pending_tiles) {
+    tile->task.wait();
+  }
+#endif
+
+  // Cost of coding a tile with 'compression_type'. For 'defl', this is the cheaper one of the compressed and stored variant.
+
+  auto get_tile_cost = [&](const PendingTile& tile, uint32_t compression_type, size_t* out_candidate_idx) {
+    double min_cost = std::numeric_limits<double>::max();
+
+    for (size_t c = 0; c < candidates.size(); c++) {
+      if (candidates[c].compression_type != compression_type) {
+        continue;
+      }
+
+      double cost = get_compression_cost(m_compression_selection, candidates[c], tile.candidate_data[c].size(), tile.raw_size);
+      if (cost < min_cost) {
+        min_cost = cost;
+        *out_candidate_idx = c;
+      }
+    }
+
+    return min_cost;
+  };
+
+  uint32_t best_compression_type = candidates[0].compression_type;
+  double best_cost = std::numeric_limits<double>::max();
+
+  for (const CompressionCandidate& method : candidates) {
+    if (method.stored) {
+      continue;
+    }
+
+    double cost = 0;
+    size_t candidate_idx;
+    for (const auto& tile : m_pending_tiles) {
+      cost += get_tile_cost(*tile, method.compression_type, &candidate_idx);
+    }
+
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_compression_type = method.compression_type;
+    }
+  }
+
+  get_property<Box_cmpC>()->set_compression_type(best_compression_type);
+  m_select_compression = false;
+
+  for (auto& tile : m_pending_tiles) {
+    size_t candidate_idx = 0;
+    get_tile_cost(*tile, best_compression_type, &candidate_idx);
+
+    tile->compressed_data = std::move(tile->candidate_data[candidate_idx]);
+    tile->candidate_data.clear();
+  }
+
+  return write_pending_tiles(0);
+}
+
+
+Error ImageItem_uncompressed::process_before_write()
+{
+  if (m_select_compression) {
+    return select_compression_method();
+  }
+
+  return write_pending_tiles(0);
+}
+
+
 Error ImageItem_uncompressed::add_image_tile(uint32_t tile_x, uint32_t tile_y, const std::shared_ptr<const HeifPixelImage>& image)
 {
   std::shared_ptr<Box_uncC> uncC = get_property<Box_uncC>();
@@ -433,11 +791,6 @@ Error ImageItem_uncompressed::add_image_tile(uint32_t tile_x, uint32_t tile_y, c
 
   uint32_t tile_idx = tile_y * uncC->get_number_of_tile_columns() + tile_x;
 
-  Result<std::vector<uint8_t>> codedBitstreamResult = encode_image_tile(image);
-  if (codedBitstreamResult.error) {
-    return codedBitstreamResult.error;
-  }
-
   std::shared_ptr<Box_cmpC> cmpC = get_property<Box_cmpC>();
   std::shared_ptr<Box_icef> icef = get_property<Box_icef>();
 
@@ -449,41 +802,107 @@ Error ImageItem_uncompressed::add_image_tile(uint32_t tile_x, uint32_t tile_y, c
 
     uint64_t tile_data_size = uncC->compute_tile_data_size_bytes(tile_width, tile_height);
 
-    get_file()->replace_iloc_data(get_id(), tile_idx * tile_data_size, *codedBitstreamResult, 0);
+    // If the 'mdat' data is held in memory, write the tile directly into its place.
+
+    Result<uint64_t> encoded_size = get_encoded_tile_size(image);
+    if (encoded_size.error) {
+      return encoded_size.error;
+    }
+
+    if (*encoded_size == tile_data_size) {
+      if (uint8_t* dst = get_file()->get_iloc_data_for_writing(get_id(), tile_idx * tile_data_size, tile_data_size)) {
+        return encode_image_tile(image, dst);
+      }
+    }
+
+    Result<std::vector<uint8_t>> codedBitstreamResult = encode_image_tile(image);
+    if (codedBitstreamResult.error) {
+      return codedBitstreamResult.error;
+    }
+
+    return get_file()->replace_iloc_data(get_id(), tile_idx * tile_data_size, *codedBitstreamResult, 0);
   }
   else {
-    std::vector<uint8_t> compressed_data;
-    const std::vector<uint8_t>& raw_data = codedBitstreamResult.value;
-    (void)raw_data;
+    Result<std::vector<uint8_t>> codedBitstreamResult = encode_image_tile(image);
+    if (codedBitstreamResult.error) {
+      return codedBitstreamResult.error;
+    }
 
-    uint32_t compr = cmpC->get_compression_type();
-    switch (compr) {
-#if HAVE_ZLIB
-      case fourcc("defl"):
-        compressed_data = compress_deflate(raw_data.data(), raw_data.size());
-        break;
-      case fourcc("zlib"):
-        compressed_data = compress_zlib(raw_data.data(), raw_data.size());
-        break;
+#if ENABLE_MULTITHREADING_SUPPORT
+    int max_threads = get_context()->get_max_encoding_threads();
 #endif
-#if HAVE_BROTLI
-      case fourcc("brot"):
-        compressed_data = compress_brotli(raw_data.data(), raw_data.size());
-        break;
+
+    if (m_select_compression) {
+      const std::vector<CompressionCandidate>& candidates = get_compression_candidates();
+
+      auto pending = std::make_unique<PendingTile>();
+      pending->tile_idx = tile_idx;
+      pending->raw_size = codedBitstreamResult.value.size();
+      pending->raw_data = std::move(codedBitstreamResult.value);
+      pending->candidate_data.resize(candidates.size());
+
+      PendingTile* tile = pending.get();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+      if (max_threads > 0) {
+        // The candidate methods are also tried in parallel.
+        tile->task.run([tile, &candidates]() {
+          TaskGroup candidate_tasks;
+          for (size_t c = 1; c < candidates.size(); c++) {
+            candidate_tasks.run([tile, &candidates, c]() {
+              tile->candidate_data[c] = compress_unit(candidates[c], tile->raw_data);
+            });
+          }
+
+          tile->candidate_data[0] = compress_unit(candidates[0], tile->raw_data);
+          candidate_tasks.wait();
+
+          std::vector<uint8_t>().swap(tile->raw_data);
+        });
+      }
+      else
 #endif
-      default:
-        assert(false);
-        break;
+      {
+        for (size_t c = 0; c < candidates.size(); c++) {
+          tile->candidate_data[c] = compress_unit(candidates[c], tile->raw_data);
+        }
+
+        std::vector<uint8_t>().swap(tile->raw_data);
+      }
+
+      m_pending_tiles.push_back(std::move(pending));
+
+      return Error::Ok;
     }
 
-    get_file()->append_iloc_data(get_id(), compressed_data, 0);
+    uint32_t compression_type = cmpC->get_compression_type();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    if (max_threads > 0) {
+      auto pending = std::make_unique<PendingTile>();
+      pending->tile_idx = tile_idx;
+      pending->raw_data = std::move(codedBitstreamResult.value);
+
+      PendingTile* tile = pending.get();
+      tile->task.run([tile, compression_type]() {
+        tile->compressed_data = compress_unit(compression_type, tile->raw_data);
+        std::vector<uint8_t>().swap(tile->raw_data);
+      });
+
+      m_pending_tiles.push_back(std::move(pending));
 
-    Box_icef::CompressedUnitInfo unit_info;
-    unit_info.unit_offset = m_next_tile_write_pos;
-    unit_info.unit_size = compressed_data.size();
-    icef->set_component(tile_idx, unit_info);
+      // Keep more tiles in flight than there are threads, so that the workers do not run out of work
+      // while we wait for the oldest tile.
+      return write_pending_tiles(2 * static_cast<size_t>(max_threads));
+    }
+
+    Error err = write_pending_tiles(0);
+    if (err) {
+      return err;
+    }
+#endif
 
-    m_next_tile_write_pos += compressed_data.size();
+    return write_compressed_tile(tile_idx, compress_unit(compression_type, codedBitstreamResult.value));
   }
 
   return Error::Ok;
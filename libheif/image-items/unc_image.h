@@ -31,6 +31,10 @@
 #include <vector>
 #include <memory>
 
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <deque>
+#endif
+
 class HeifContext;
 
 
@@ -41,6 +45,8 @@ public:
 
   ImageItem_uncompressed(HeifContext* ctx);
 
+  ~ImageItem_uncompressed() override;
+
   uint32_t get_infe_type() const override { return fourcc("unci"); }
 
   heif_compression_format get_compression_format() const override { return heif_compression_uncompressed; }
@@ -61,6 +67,10 @@ public:
   Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image(const struct heif_decoding_options& options,
                                                                   bool decode_tile_only, uint32_t tile_x0, uint32_t tile_y0) const override;
 
+  // Filter array images ('cpat') that are decoded to RGB are demosaiced directly after decoding the raw samples.
+  Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_converted(const struct heif_decoding_options& options,
+                                                                            const OutputFormat& output_format) const override;
+
   heif_image_tiling get_heif_image_tiling() const override;
 
   Error on_load_file() override;
@@ -82,11 +92,20 @@ public:
                                                                 const struct heif_encoding_options* encoding_options,
                                                                 const std::shared_ptr<const HeifPixelImage>& prototype);
 
+  // With generic compression and max_encoding_threads > 0, the tile is compressed in the background.
+  // The compressed tiles are written in the order in which they were added, as in the sequential case.
+  // With heif_unci_compression_auto, the tiles are written in process_before_write(), after selecting the method.
   Error add_image_tile(uint32_t tile_x, uint32_t tile_y, const std::shared_ptr<const HeifPixelImage>& image);
 
+  Error process_before_write() override;
+
 protected:
   Result<std::shared_ptr<Decoder>> get_decoder() const override;
 
+  // Images that are not split into tiles are decoded row by row, reading only the rows of the area.
+  Result<std::shared_ptr<HeifPixelImage>> decode_compressed_image_area(const struct heif_decoding_options& options,
+                                                                      uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const override;
+
   std::shared_ptr<Encoder> get_encoder() const override;
 
 private:
@@ -100,6 +119,23 @@ private:
                                                      */
 
   uint64_t m_next_tile_write_pos = 0;
+
+  Error write_compressed_tile(uint32_t tile_idx, const std::vector<uint8_t>& compressed_data);
+
+  struct PendingTile;
+
+  // Tiles that are being compressed, in the order in which they have to be written.
+  std::deque<std::unique_ptr<PendingTile>> m_pending_tiles;
+
+  // Waits for and writes the oldest pending tiles until at most 'max_pending' are left.
+  Error write_pending_tiles(size_t max_pending);
+
+  // heif_unci_compression_auto: the pending tiles are compressed with all candidate methods until
+  // select_compression_method() chooses the one for the image.
+  bool m_select_compression = false;
+  heif_unci_compression_selection m_compression_selection = heif_unci_compression_selection_smallest_size;
+
+  Error select_compression_method();
 };
 
 #endif //LIBHEIF_UNC_IMAGE_H
@@ -0,0 +1,774 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "image_scaling.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+// --- filter coefficients
+
+// Every output sample is computed from 'num_taps' consecutive input samples, starting at 'start[i]'.
+// Shorter filters (at the image borders) are padded with zero weights.
+struct FilterCoefficients
+{
+  uint32_t num_taps = 0;
+  std::vector<uint32_t> start;
+  std::vector<float> weights; // num_taps weights for each output sample
+};
+
+
+static double sinc(double x)
+{
+  if (x == 0.0) {
+    return 1.0;
+  }
+
+  x *= M_PI;
+  return std::sin(x) / x;
+}
+
+
+static double lanczos3(double x)
+{
+  if (std::abs(x) >= 3.0) {
+    return 0.0;
+  }
+
+  return sinc(x) * sinc(x / 3.0);
+}
+
+
+// Weights for the input samples [first, first + weights.size()) of one output sample.
+// The weights are not normalized yet.
+static void compute_filter_weights(heif_scaling_filter filter, uint32_t out_pos, double scale,
+                                   int64_t& first, std::vector<double>& weights)
+{
+  weights.clear();
+
+  if (filter == heif_scaling_filter_area) {
+    // Overlap of each input sample with the area covered by the output sample.
+
+    double begin = out_pos * scale;
+    double end = begin + scale;
+
+    first = static_cast<int64_t>(std::floor(begin));
+    auto last = static_cast<int64_t>(std::ceil(end));
+
+    for (int64_t i = first; i < last; i++) {
+      double w = std::min(end, static_cast<double>(i + 1)) - std::max(begin, static_cast<double>(i));
+      weights.push_back(std::max(w, 0.0));
+    }
+  }
+  else {
+    // When downscaling, the filter is stretched to the input sample distance.
+
+    double filter_scale = std::max(scale, 1.0);
+    double center = (out_pos + 0.5) * scale;
+    double support = 3.0 * filter_scale;
+
+    first = static_cast<int64_t>(std::floor(center - support));
+    auto last = static_cast<int64_t>(std::ceil(center + support));
+
+    for (int64_t i = first; i <= last; i++) {
+      weights.push_back(lanczos3((static_cast<double>(i) + 0.5 - center) / filter_scale));
+    }
+  }
+}
+
+
+static FilterCoefficients compute_filter_coefficients(heif_scaling_filter filter, uint32_t in_size, uint32_t out_size)
+{
+  const double scale = static_cast<double>(in_size) / out_size;
+
+  // --- compute the weights of each output sample, clamping input positions to the image
+
+  std::vector<std::vector<double>> all_weights(out_size);
+  std::vector<uint32_t> first_input(out_size);
+  uint32_t max_taps = 1;
+
+  std::vector<double> weights;
+
+  for (uint32_t i = 0; i < out_size; i++) {
+    int64_t first;
+    compute_filter_weights(filter, i, scale, first, weights);
+
+    auto lo = static_cast<uint32_t>(std::clamp<int64_t>(first, 0, in_size - 1));
+    auto hi = static_cast<uint32_t>(std::clamp<int64_t>(first + static_cast<int64_t>(weights.size()) - 1, 0, in_size - 1));
+
+    std::vector<double>& w = all_weights[i];
+    w.assign(hi - lo + 1, 0.0);
+
+    for (size_t k = 0; k < weights.size(); k++) {
+      auto pos = static_cast<uint32_t>(std::clamp<int64_t>(first + static_cast<int64_t>(k), lo, hi));
+      w[pos - lo] += weights[k];
+    }
+
+    first_input[i] = lo;
+    max_taps = std::max(max_taps, static_cast<uint32_t>(w.size()));
+  }
+
+
+  // --- normalize and store with a fixed number of taps
+
+  FilterCoefficients coeffs;
+  coeffs.num_taps = max_taps;
+  coeffs.start.resize(out_size);
+  coeffs.weights.assign(static_cast<size_t>(out_size) * max_taps, 0.0f);
+
+  for (uint32_t i = 0; i < out_size; i++) {
+    const std::vector<double>& w = all_weights[i];
+
+    double sum = 0;
+    for (double v : w) {
+      sum += v;
+    }
+
+    if (sum == 0) {
+      sum = 1;
+    }
+
+    // Move the window to the left at the right image border, so that it does not extend beyond the image.
+    uint32_t start = std::min(first_input[i], in_size - max_taps);
+    uint32_t offset = first_input[i] - start;
+
+    coeffs.start[i] = start;
+    for (size_t k = 0; k < w.size(); k++) {
+      coeffs.weights[i * max_taps + offset + k] = static_cast<float>(w[k] / sum);
+    }
+  }
+
+  return coeffs;
+}
+
+
+// --- row kernels
+
+// Horizontal filter for planes with one component.
+typedef void (*horizontal_filter_1_kernel)(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width);
+
+// Horizontal filter for interleaved planes with four components.
+typedef void (*horizontal_filter_4_kernel)(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width);
+
+// out[x] = sum_k weights[k] * rows[k][x]
+typedef void (*vertical_filter_kernel)(const float* const* rows, const float* weights, uint32_t num_taps,
+                                       float* out, uint32_t n);
+
+
+static void horizontal_filter_1_scalar(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + coeffs.start[x];
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    float sum = 0;
+    for (uint32_t k = 0; k < taps; k++) {
+      sum += w[k] * p[k];
+    }
+
+    out[x] = sum;
+  }
+}
+
+
+static void horizontal_filter_4_scalar(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + static_cast<size_t>(coeffs.start[x]) * 4;
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    float sum[4] = {0, 0, 0, 0};
+    for (uint32_t k = 0; k < taps; k++) {
+      for (int c = 0; c < 4; c++) {
+        sum[c] += w[k] * p[k * 4 + c];
+      }
+    }
+
+    for (int c = 0; c < 4; c++) {
+      out[x * 4 + c] = sum[c];
+    }
+  }
+}
+
+
+static void horizontal_filter_n(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width,
+                                uint32_t num_components)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + static_cast<size_t>(coeffs.start[x]) * num_components;
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    for (uint32_t c = 0; c < num_components; c++) {
+      float sum = 0;
+      for (uint32_t k = 0; k < taps; k++) {
+        sum += w[k] * p[k * num_components + c];
+      }
+
+      out[x * num_components + c] = sum;
+    }
+  }
+}
+
+
+static void vertical_filter_scalar(const float* const* rows, const float* weights, uint32_t num_taps,
+                                   float* out, uint32_t n)
+{
+  for (uint32_t x = 0; x < n; x++) {
+    float sum = 0;
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum += weights[k] * rows[k][x];
+    }
+
+    out[x] = sum;
+  }
+}
+
+
+#if HEIF_HAVE_X86_SIMD
+
+HEIF_TARGET_SSE41
+static void horizontal_filter_1_sse41(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + coeffs.start[x];
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    __m128 sum = _mm_setzero_ps();
+    uint32_t k = 0;
+    for (; k + 4 <= taps; k += 4) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(w + k), _mm_loadu_ps(p + k)));
+    }
+
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+
+    float result = _mm_cvtss_f32(sum);
+    for (; k < taps; k++) {
+      result += w[k] * p[k];
+    }
+
+    out[x] = result;
+  }
+}
+
+
+HEIF_TARGET_SSE41
+static void horizontal_filter_4_sse41(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + static_cast<size_t>(coeffs.start[x]) * 4;
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t k = 0; k < taps; k++) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(p + k * 4)));
+    }
+
+    _mm_storeu_ps(out + x * 4, sum);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+static void vertical_filter_sse41(const float* const* rows, const float* weights, uint32_t num_taps,
+                                  float* out, uint32_t n)
+{
+  uint32_t x = 0;
+  for (; x + 4 <= n; x += 4) {
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + x)));
+    }
+
+    _mm_storeu_ps(out + x, sum);
+  }
+
+  for (; x < n; x++) {
+    float sum = 0;
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum += weights[k] * rows[k][x];
+    }
+
+    out[x] = sum;
+  }
+}
+
+
+HEIF_TARGET_AVX2
+static void vertical_filter_avx2(const float* const* rows, const float* weights, uint32_t num_taps,
+                                 float* out, uint32_t n)
+{
+  uint32_t x = 0;
+  for (; x + 8 <= n; x += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + x)));
+    }
+
+    _mm256_storeu_ps(out + x, sum);
+  }
+
+  for (; x < n; x++) {
+    float sum = 0;
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum += weights[k] * rows[k][x];
+    }
+
+    out[x] = sum;
+  }
+}
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+static void horizontal_filter_1_neon(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + coeffs.start[x];
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    float32x4_t sum = vdupq_n_f32(0);
+    uint32_t k = 0;
+    for (; k + 4 <= taps; k += 4) {
+      sum = vmlaq_f32(sum, vld1q_f32(w + k), vld1q_f32(p + k));
+    }
+
+    float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    float result = vget_lane_f32(vpadd_f32(half, half), 0);
+    for (; k < taps; k++) {
+      result += w[k] * p[k];
+    }
+
+    out[x] = result;
+  }
+}
+
+
+static void horizontal_filter_4_neon(const float* in, const FilterCoefficients& coeffs, float* out, uint32_t out_width)
+{
+  const uint32_t taps = coeffs.num_taps;
+
+  for (uint32_t x = 0; x < out_width; x++) {
+    const float* p = in + static_cast<size_t>(coeffs.start[x]) * 4;
+    const float* w = coeffs.weights.data() + static_cast<size_t>(x) * taps;
+
+    float32x4_t sum = vdupq_n_f32(0);
+    for (uint32_t k = 0; k < taps; k++) {
+      sum = vmlaq_n_f32(sum, vld1q_f32(p + k * 4), w[k]);
+    }
+
+    vst1q_f32(out + x * 4, sum);
+  }
+}
+
+
+static void vertical_filter_neon(const float* const* rows, const float* weights, uint32_t num_taps,
+                                 float* out, uint32_t n)
+{
+  uint32_t x = 0;
+  for (; x + 4 <= n; x += 4) {
+    float32x4_t sum = vdupq_n_f32(0);
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum = vmlaq_n_f32(sum, vld1q_f32(rows[k] + x), weights[k]);
+    }
+
+    vst1q_f32(out + x, sum);
+  }
+
+  for (; x < n; x++) {
+    float sum = 0;
+    for (uint32_t k = 0; k < num_taps; k++) {
+      sum += weights[k] * rows[k][x];
+    }
+
+    out[x] = sum;
+  }
+}
+
+#endif
+
+
+struct ScalingKernels
+{
+  horizontal_filter_1_kernel horizontal_1 = horizontal_filter_1_scalar;
+  horizontal_filter_4_kernel horizontal_4 = horizontal_filter_4_scalar;
+  vertical_filter_kernel vertical = vertical_filter_scalar;
+};
+
+
+static ScalingKernels select_scaling_kernels()
+{
+  ScalingKernels kernels;
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    kernels.horizontal_1 = horizontal_filter_1_sse41;
+    kernels.horizontal_4 = horizontal_filter_4_sse41;
+    kernels.vertical = vertical_filter_sse41;
+  }
+  if (cpu_supports_avx2()) {
+    kernels.vertical = vertical_filter_avx2;
+  }
+#endif
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    kernels.horizontal_1 = horizontal_filter_1_neon;
+    kernels.horizontal_4 = horizontal_filter_4_neon;
+    kernels.vertical = vertical_filter_neon;
+  }
+#endif
+
+  return kernels;
+}
+
+
+static const ScalingKernels& get_scaling_kernels()
+{
+  static const ScalingKernels kernels = select_scaling_kernels();
+  return kernels;
+}
+
+
+// --- plane scaling
+
+enum class SampleFormat
+{
+  u8,
+  u16, // native byte order
+  u16_BE,
+  u16_LE
+};
+
+
+struct PlaneLayout
+{
+  SampleFormat format;
+  uint32_t num_components;
+  float max_value;
+};
+
+
+static void load_row(const uint8_t* in, const PlaneLayout& layout, uint32_t n, float* out)
+{
+  switch (layout.format) {
+    case SampleFormat::u8:
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] = in[i];
+      }
+      break;
+    case SampleFormat::u16: {
+      const auto* in16 = reinterpret_cast<const uint16_t*>(in);
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] = in16[i];
+      }
+      break;
+    }
+    case SampleFormat::u16_BE:
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] = static_cast<float>((in[2 * i] << 8) | in[2 * i + 1]);
+      }
+      break;
+    case SampleFormat::u16_LE:
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] = static_cast<float>(in[2 * i] | (in[2 * i + 1] << 8));
+      }
+      break;
+  }
+}
+
+
+static inline uint16_t round_and_clip(float v, float max_value)
+{
+  // The Lanczos filter overshoots at edges.
+  v = std::min(std::max(v + 0.5f, 0.0f), max_value);
+  return static_cast<uint16_t>(v);
+}
+
+
+static void store_row(const float* in, const PlaneLayout& layout, uint32_t n, uint8_t* out)
+{
+  switch (layout.format) {
+    case SampleFormat::u8:
+      for (uint32_t i = 0; i < n; i++) {
+        out[i] = static_cast<uint8_t>(round_and_clip(in[i], layout.max_value));
+      }
+      break;
+    case SampleFormat::u16: {
+      auto* out16 = reinterpret_cast<uint16_t*>(out);
+      for (uint32_t i = 0; i < n; i++) {
+        out16[i] = round_and_clip(in[i], layout.max_value);
+      }
+      break;
+    }
+    case SampleFormat::u16_BE:
+      for (uint32_t i = 0; i < n; i++) {
+        uint16_t v = round_and_clip(in[i], layout.max_value);
+        out[2 * i] = static_cast<uint8_t>(v >> 8);
+        out[2 * i + 1] = static_cast<uint8_t>(v & 0xFF);
+      }
+      break;
+    case SampleFormat::u16_LE:
+      for (uint32_t i = 0; i < n; i++) {
+        uint16_t v = round_and_clip(in[i], layout.max_value);
+        out[2 * i] = static_cast<uint8_t>(v & 0xFF);
+        out[2 * i + 1] = static_cast<uint8_t>(v >> 8);
+      }
+      break;
+  }
+}
+
+
+static PlaneLayout get_plane_layout(const HeifPixelImage& image, heif_channel channel)
+{
+  PlaneLayout layout{};
+
+  int bpp = image.get_bits_per_pixel(channel);
+
+  if (channel == heif_channel_interleaved) {
+    switch (image.get_chroma_format()) {
+      case heif_chroma_interleaved_RGB:
+        layout = {SampleFormat::u8, 3};
+        break;
+      case heif_chroma_interleaved_RGBA:
+        layout = {SampleFormat::u8, 4};
+        break;
+      case heif_chroma_interleaved_RRGGBB_BE:
+        layout = {SampleFormat::u16_BE, 3};
+        break;
+      case heif_chroma_interleaved_RRGGBBAA_BE:
+        layout = {SampleFormat::u16_BE, 4};
+        break;
+      case heif_chroma_interleaved_RRGGBB_LE:
+        layout = {SampleFormat::u16_LE, 3};
+        break;
+      case heif_chroma_interleaved_RRGGBBAA_LE:
+        layout = {SampleFormat::u16_LE, 4};
+        break;
+      default:
+        assert(false);
+        break;
+    }
+
+    // The bit depth of interleaved planes is given per component.
+    if (layout.format == SampleFormat::u8) {
+      bpp = std::min(bpp, 8);
+    }
+    else if (bpp > 16) {
+      bpp = 16;
+    }
+  }
+  else {
+    layout = {bpp <= 8 ? SampleFormat::u8 : SampleFormat::u16, 1};
+  }
+
+  layout.max_value = static_cast<float>((1 << bpp) - 1);
+
+  return layout;
+}
+
+
+static void scale_plane_rows(const HeifPixelImage& input, heif_channel channel, HeifPixelImage& output,
+                             const PlaneLayout& layout,
+                             const FilterCoefficients& h_coeffs, const FilterCoefficients& v_coeffs,
+                             uint32_t out_y0, uint32_t out_y1)
+{
+  const ScalingKernels& kernels = get_scaling_kernels();
+
+  const uint32_t in_width = input.get_width(channel);
+  const uint32_t out_width = output.get_width(channel);
+  const uint32_t nc = layout.num_components;
+
+  size_t in_stride;
+  const uint8_t* in_data = input.get_plane(channel, &in_stride);
+
+  size_t out_stride;
+  uint8_t* out_data = output.get_plane(channel, &out_stride);
+
+
+  // --- filter the input rows of this band horizontally
+
+  const uint32_t first_row = v_coeffs.start[out_y0];
+  const uint32_t last_row = v_coeffs.start[out_y1 - 1] + v_coeffs.num_taps; // exclusive
+
+  const size_t h_row_size = static_cast<size_t>(out_width) * nc;
+  std::vector<float> h_rows((last_row - first_row) * h_row_size);
+
+  std::vector<float> in_row(static_cast<size_t>(in_width) * nc);
+
+  for (uint32_t y = first_row; y < last_row; y++) {
+    load_row(in_data + y * in_stride, layout, in_width * nc, in_row.data());
+
+    float* out_row = h_rows.data() + (y - first_row) * h_row_size;
+
+    if (nc == 1) {
+      kernels.horizontal_1(in_row.data(), h_coeffs, out_row, out_width);
+    }
+    else if (nc == 4) {
+      kernels.horizontal_4(in_row.data(), h_coeffs, out_row, out_width);
+    }
+    else {
+      horizontal_filter_n(in_row.data(), h_coeffs, out_row, out_width, nc);
+    }
+  }
+
+
+  // --- filter vertically
+
+  std::vector<const float*> rows(v_coeffs.num_taps);
+  std::vector<float> out_row(h_row_size);
+
+  for (uint32_t y = out_y0; y < out_y1; y++) {
+    for (uint32_t k = 0; k < v_coeffs.num_taps; k++) {
+      rows[k] = h_rows.data() + (v_coeffs.start[y] + k - first_row) * h_row_size;
+    }
+
+    kernels.vertical(rows.data(), v_coeffs.weights.data() + static_cast<size_t>(y) * v_coeffs.num_taps,
+                     v_coeffs.num_taps, out_row.data(), static_cast<uint32_t>(h_row_size));
+
+    store_row(out_row.data(), layout, static_cast<uint32_t>(h_row_size), out_data + y * out_stride);
+  }
+}
+
+
+static void scale_plane(const HeifPixelImage& input, heif_channel channel, HeifPixelImage& output,
+                        heif_scaling_filter filter, int max_threads)
+{
+  const PlaneLayout layout = get_plane_layout(input, channel);
+
+  const uint32_t out_width = output.get_width(channel);
+  const uint32_t out_height = output.get_height(channel);
+
+  const FilterCoefficients h_coeffs = compute_filter_coefficients(filter, input.get_width(channel), out_width);
+  const FilterCoefficients v_coeffs = compute_filter_coefficients(filter, input.get_height(channel), out_height);
+
+  // Each band filters the input rows that it needs horizontally. Bands should be large enough
+  // so that the rows shared with the neighboring bands do not matter.
+  const uint32_t min_band_height = 32;
+
+  uint32_t num_bands = 1;
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (max_threads > 1) {
+    num_bands = std::min(static_cast<uint32_t>(max_threads), std::max(uint32_t{1}, out_height / min_band_height));
+  }
+#else
+  (void) max_threads;
+  (void) min_band_height;
+#endif
+
+  if (num_bands == 1) {
+    scale_plane_rows(input, channel, output, layout, h_coeffs, v_coeffs, 0, out_height);
+    return;
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  TaskGroup tasks;
+  for (uint32_t b = 0; b < num_bands; b++) {
+    uint32_t y0 = static_cast<uint32_t>(static_cast<uint64_t>(out_height) * b / num_bands);
+    uint32_t y1 = static_cast<uint32_t>(static_cast<uint64_t>(out_height) * (b + 1) / num_bands);
+
+    tasks.run([&, y0, y1]() {
+      scale_plane_rows(input, channel, output, layout, h_coeffs, v_coeffs, y0, y1);
+    });
+  }
+
+  tasks.wait();
+#endif
+}
+
+
+Error scale_image(const HeifPixelImage& input, std::shared_ptr<HeifPixelImage>& output,
+                  uint32_t width, uint32_t height,
+                  heif_scaling_filter filter, int max_threads,
+                  const heif_security_limits* limits)
+{
+  if (filter == heif_scaling_filter_nearest_neighbor) {
+    return input.scale_nearest_neighbor(output, width, height, limits);
+  }
+
+  if (filter != heif_scaling_filter_area && filter != heif_scaling_filter_lanczos3) {
+    return {heif_error_Usage_error, heif_suberror_Unsupported_parameter, "Unknown scaling filter"};
+  }
+
+  if (width == 0 || height == 0) {
+    return {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Scaled image size is empty"};
+  }
+
+
+  // --- create output image with the same planes
+
+  auto out_img = std::make_shared<HeifPixelImage>();
+  out_img->create(width, height, input.get_colorspace(), input.get_chroma_format());
+
+  const heif_chroma chroma = input.get_chroma_format();
+
+  for (heif_channel channel : input.get_channel_set()) {
+    if (auto err = out_img->add_plane(channel,
+                                      channel_width(width, chroma, channel),
+                                      channel_height(height, chroma, channel),
+                                      input.get_bits_per_pixel(channel), limits)) {
+      return err;
+    }
+  }
+
+
+  // --- scale all channels
+
+  for (heif_channel channel : input.get_channel_set()) {
+    if (input.get_width(channel) == 0 || input.get_height(channel) == 0) {
+      return {heif_error_Invalid_input, heif_suberror_Unspecified, "Cannot scale empty image plane"};
+    }
+
+    scale_plane(input, channel, *out_img, filter, max_threads);
+  }
+
+  output = std::move(out_img);
+
+  return Error::Ok;
+}
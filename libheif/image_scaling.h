@@ -0,0 +1,39 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_IMAGE_SCALING_H
+#define LIBHEIF_IMAGE_SCALING_H
+
+#include "pixelimage.h"
+#include "error.h"
+#include <libheif/heif_image.h>
+#include <memory>
+
+
+// Scales all planes of the image with the given filter.
+// The area and Lanczos3 filters are separable: each plane is first filtered horizontally into a float buffer
+// and then vertically. Chroma planes are scaled at their own resolution.
+// With max_threads > 1, bands of output rows are scaled in parallel in the thread pool.
+Error scale_image(const HeifPixelImage& input, std::shared_ptr<HeifPixelImage>& output,
+                  uint32_t width, uint32_t height,
+                  heif_scaling_filter filter, int max_threads,
+                  const heif_security_limits* limits);
+
+#endif //LIBHEIF_IMAGE_SCALING_H
@@ -24,12 +24,12 @@
 #include "plugin_registry.h"
 #include "common_utils.h"
 #include "color-conversion/colorconversion.h"
+#include "thread_pool.h"
+#include "plane_buffer_pool.h"
 
-#if ENABLE_MULTITHREADING_SUPPORT
-
-#include <mutex>
-
-#endif
+#include <atomic>
+#include <fstream>
+#include <algorithm>
 
 #if defined(_WIN32)
 #include "plugins_windows.h"
@@ -45,6 +45,8 @@ void heif_unload_all_plugins();
 
 void heif_unregister_encoder_plugin(const heif_encoder_plugin* plugin);
 
+static void load_or_defer_plugins_in_directory(const char* directory);
+
 std::vector<std::string> get_plugin_paths()
 {
   std::vector<std::string> plugin_paths;
@@ -85,7 +87,7 @@ static bool default_plugins_registered = true; // because they are implicitly re
 
 #if ENABLE_MULTITHREADING_SUPPORT
 
-static std::recursive_mutex& heif_init_mutex()
+std::recursive_mutex& heif_init_mutex()
 {
   static std::recursive_mutex init_mutex;
   return init_mutex;
@@ -119,14 +121,10 @@ struct heif_error heif_init(struct heif_init_params*)
     }
 
 #if ENABLE_PLUGIN_LOADING
-    struct heif_error err{};
     std::vector<std::string> plugin_paths = get_plugin_paths();
 
     for (const auto& dir : plugin_paths) {
-      err = heif_load_plugins(dir.c_str(), nullptr, nullptr, 0);
-      if (err.code != 0) {
-        return err;
-      }
+      load_or_defer_plugins_in_directory(dir.c_str());
     }
 #endif
   }
@@ -158,6 +156,12 @@ void heif_deinit()
     heif_unload_all_plugins();
 
     ColorConversionPipeline::release_ops();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    ThreadPool::global().stop_workers();
+#endif
+
+    PlaneBufferPool::global().clear();
   }
 
   // Note: contrary to heif_init() I think it does not matter whether we decrease the counter before or after deinitialization.
@@ -170,6 +174,7 @@ void heif_deinit()
 #include <vector>
 #include <string>
 #include <cstring>
+#include <sstream>
 
 #if ENABLE_PLUGIN_LOADING
 
@@ -189,6 +194,21 @@ struct loaded_plugin
 
 static std::vector<loaded_plugin> sLoadedPlugins;
 
+
+// A plugin library with a manifest. It is loaded when one of its formats is needed for the first time.
+struct deferred_plugin
+{
+  std::string filename;
+  heif_plugin_type type = heif_plugin_type_decoder;
+  std::vector<heif_compression_format> formats;
+  int priority = 0; // 0 = not declared
+};
+
+static std::vector<deferred_plugin> sDeferredPlugins;
+
+// Allows checking for deferred plugins without locking the mutex.
+static std::atomic<size_t> sNumDeferredPlugins{0};
+
 MAYBE_UNUSED heif_error error_dlopen{heif_error_Plugin_loading_error, heif_suberror_Plugin_loading_error, "Cannot open plugin (dlopen)."};
 MAYBE_UNUSED heif_error error_plugin_not_loaded{heif_error_Plugin_loading_error, heif_suberror_Plugin_is_not_loaded, "Trying to remove a plugin that is not loaded."};
 MAYBE_UNUSED heif_error error_cannot_read_plugin_directory{heif_error_Plugin_loading_error, heif_suberror_Cannot_read_plugin_directory, "Cannot read plugin directory."};
@@ -308,6 +328,9 @@ void heif_unload_all_plugins()
   }
 
   sLoadedPlugins.clear();
+
+  sDeferredPlugins.clear();
+  sNumDeferredPlugins = 0;
 }
 
 
@@ -347,6 +370,161 @@ struct heif_error heif_load_plugins(const char* directory,
   return heif_error_ok;
 }
 
+
+static bool parse_compression_format_name(const std::string& name, heif_compression_format* out_format)
+{
+  static const struct
+  {
+    const char* name;
+    heif_compression_format format;
+  } format_names[] = {
+      {"hevc",         heif_compression_HEVC},
+      {"avc",          heif_compression_AVC},
+      {"jpeg",         heif_compression_JPEG},
+      {"av1",          heif_compression_AV1},
+      {"vvc",          heif_compression_VVC},
+      {"evc",          heif_compression_EVC},
+      {"jpeg2000",     heif_compression_JPEG2000},
+      {"uncompressed", heif_compression_uncompressed},
+      {"mask",         heif_compression_mask},
+      {"htj2k",        heif_compression_HTJ2K}
+  };
+
+  for (const auto& f : format_names) {
+    if (name == f.name) {
+      *out_format = f.format;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// Returns false if there is no manifest or if we cannot use it (e.g. because it names a format that we do not know).
+// The plugin is then loaded immediately.
+static bool read_plugin_manifest(const std::string& library_filename, deferred_plugin* out_plugin)
+{
+  std::ifstream istr(library_filename + ".manifest");
+  if (!istr) {
+    return false;
+  }
+
+  bool have_type = false;
+
+  std::string line;
+  while (std::getline(istr, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    auto pos = line.find('=');
+    if (pos == std::string::npos) {
+      return false;
+    }
+
+    std::string key = line.substr(0, pos);
+    std::string value = line.substr(pos + 1);
+
+    if (key == "type") {
+      if (value == "decoder") {
+        out_plugin->type = heif_plugin_type_decoder;
+      }
+      else if (value == "encoder") {
+        out_plugin->type = heif_plugin_type_encoder;
+      }
+      else {
+        return false;
+      }
+
+      have_type = true;
+    }
+    else if (key == "formats") {
+      std::istringstream formats(value);
+      std::string name;
+      while (std::getline(formats, name, ',')) {
+        heif_compression_format format;
+        if (!parse_compression_format_name(name, &format)) {
+          return false;
+        }
+
+        out_plugin->formats.push_back(format);
+      }
+    }
+    else if (key == "priority") {
+      out_plugin->priority = atoi(value.c_str());
+    }
+
+    // Unknown keys are ignored such that later versions can add more information.
+  }
+
+  out_plugin->filename = library_filename;
+
+  return have_type && !out_plugin->formats.empty();
+}
+
+
+static void load_or_defer_plugins_in_directory(const char* directory)
+{
+  for (const auto& filename : list_all_potential_plugins_in_directory(directory)) {
+    deferred_plugin plugin;
+    if (read_plugin_manifest(filename, &plugin)) {
+      sDeferredPlugins.push_back(plugin);
+    }
+    else {
+      const struct heif_plugin_info* info = nullptr;
+      heif_load_plugin(filename.c_str(), &info);
+    }
+  }
+
+  sNumDeferredPlugins = sDeferredPlugins.size();
+}
+
+
+bool load_deferred_plugins(heif_plugin_type type, heif_compression_format format, int min_priority)
+{
+  if (sNumDeferredPlugins == 0) {
+    return false;
+  }
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::recursive_mutex> lock(heif_init_mutex());
+#endif
+
+  bool any_loaded = false;
+
+  for (size_t i = 0; i < sDeferredPlugins.size();) {
+    const deferred_plugin& plugin = sDeferredPlugins[i];
+
+    bool needed = (plugin.type == type &&
+                   (format == heif_compression_undefined ||
+                    std::find(plugin.formats.begin(), plugin.formats.end(), format) != plugin.formats.end()) &&
+                   (plugin.priority == 0 || plugin.priority > min_priority));
+
+    if (!needed) {
+      i++;
+      continue;
+    }
+
+    std::string filename = plugin.filename;
+    sDeferredPlugins.erase(sDeferredPlugins.begin() + i);
+
+    // When loading fails, dlopen() already printed the reason.
+    const struct heif_plugin_info* info = nullptr;
+    if (heif_load_plugin(filename.c_str(), &info).code == heif_error_Ok) {
+      any_loaded = true;
+    }
+  }
+
+  sNumDeferredPlugins = sDeferredPlugins.size();
+
+  return any_loaded;
+}
+
 #else
 static heif_error heif_error_plugins_unsupported{heif_error_Unsupported_feature, heif_suberror_Unspecified, "Plugins are not supported"};
 
@@ -376,6 +554,12 @@ struct heif_error heif_load_plugins(const char* directory,
   return heif_error_plugins_unsupported;
 }
 
+
+bool load_deferred_plugins(heif_plugin_type type, heif_compression_format format, int min_priority)
+{
+  return false;
+}
+
 #endif
 
 
@@ -23,16 +23,20 @@
 #define LIBHEIF_INIT_H
 
 #include "libheif/heif.h"
+#include "libheif/heif_plugin.h"
 #include <string>
 #include <vector>
 
+#if ENABLE_MULTITHREADING_SUPPORT
+
+#include <mutex>
+
+#endif
+
 extern heif_error error_dlopen;
 extern heif_error error_plugin_not_loaded;
 extern heif_error error_cannot_read_plugin_directory;
 
-// TODO: later, we might defer the default plugin initialization to when they are actually used for the first time.
-// That would prevent them from being initialized every time at program start, even when the application software uses heif_init() later on.
-
 // Note: the loaded plugin is not released automatically then the class is released, because this would require that
 // we reference-count the handle. We do not really need this since releasing the library explicitly with release() is simple enough.
 class PluginLibrary
@@ -51,4 +55,22 @@ std::vector<std::string> get_plugin_paths();
 // This is for implicit initialization when heif_init() is not called.
 void load_plugins_if_not_initialized_yet();
 
+#if ENABLE_MULTITHREADING_SUPPORT
+// Guards the initialization and the plugin lists.
+std::recursive_mutex& heif_init_mutex();
+#endif
+
+// Plugins in the plugin directories that have a manifest file ("<library filename>.manifest") are not loaded
+// in heif_init(). They are loaded when a plugin of their type and format is needed for the first time:
+//
+//   # comment
+//   type=decoder                  (or 'encoder')
+//   formats=jpeg2000,htj2k        (hevc, avc, jpeg, av1, vvc, evc, jpeg2000, uncompressed, mask, htj2k)
+//   priority=100                  (optional, the priority that the plugin will report)
+//
+// load_deferred_plugins() loads all deferred plugins of 'type' supporting 'format' (heif_compression_undefined: any format)
+// that declare a priority above 'min_priority' (or no priority at all).
+// Returns true if any plugin was loaded.
+bool load_deferred_plugins(heif_plugin_type type, heif_compression_format format, int min_priority = 0);
+
 #endif //LIBHEIF_INIT_H
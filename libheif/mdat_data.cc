@@ -0,0 +1,463 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mdat_data.h"
+#include "box.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+
+// Block size when copying the data to the output.
+static const size_t copy_block_size = 1024 * 1024;
+
+
+Result<uint64_t> MdatData_Memory::append_data(const std::vector<uint8_t>& data)
+{
+  uint64_t startPos = m_data.size();
+  m_data.insert(m_data.end(), data.begin(), data.end());
+  return startPos;
+}
+
+
+Error MdatData_Memory::replace_data(uint64_t position, const uint8_t* data, size_t size)
+{
+  uint8_t* dst = get_data_for_writing(position, size);
+  if (!dst) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Replaced data lies outside of the 'mdat' data"};
+  }
+
+  if (size != 0) {
+    memcpy(dst, data, size);
+  }
+
+  return Error::Ok;
+}
+
+
+uint8_t* MdatData_Memory::get_data_for_writing(uint64_t position, uint64_t size)
+{
+  if (position > m_data.size() || size > m_data.size() - position) {
+    return nullptr;
+  }
+
+  return m_data.data() + position;
+}
+
+
+Error MdatData_Memory::write(StreamWriter& writer)
+{
+  writer.write(m_data);
+  return Error::Ok;
+}
+
+
+Error MdatData_Memory::write(const OutputWriteFunction& output)
+{
+  if (m_data.empty()) {
+    return Error::Ok;
+  }
+
+  return output(m_data.data(), m_data.size());
+}
+
+
+static Error check_range(uint64_t position, uint64_t size, uint64_t data_size)
+{
+  if (position > data_size || size > data_size - position) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Range lies outside of the 'mdat' data"};
+  }
+
+  return Error::Ok;
+}
+
+
+Error MdatData_Memory::write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output)
+{
+  if (Error err = check_range(position, size, m_data.size())) {
+    return err;
+  }
+
+  if (size == 0) {
+    return Error::Ok;
+  }
+
+  return output(m_data.data() + position, static_cast<size_t>(size));
+}
+
+
+MdatData_TmpFile::~MdatData_TmpFile()
+{
+  if (m_file) {
+    fclose(m_file);
+  }
+}
+
+
+Error MdatData_TmpFile::open()
+{
+  m_file = tmpfile();
+  if (!m_file) {
+    return {heif_error_Encoding_error,
+            heif_suberror_Cannot_write_output_data,
+            "Cannot create temporary file"};
+  }
+
+  return Error::Ok;
+}
+
+
+Error MdatData_TmpFile::seek(uint64_t position)
+{
+#if defined(_WIN32)
+  int result = _fseeki64(m_file, static_cast<__int64>(position), SEEK_SET);
+#else
+  int result = fseeko(m_file, static_cast<off_t>(position), SEEK_SET);
+#endif
+
+  if (result != 0) {
+    return {heif_error_Encoding_error,
+            heif_suberror_Cannot_write_output_data,
+            "Cannot seek in temporary file"};
+  }
+
+  return Error::Ok;
+}
+
+
+Result<uint64_t> MdatData_TmpFile::append_data(const std::vector<uint8_t>& data)
+{
+  // The file position is always at the end, except while replace_data() or write() are running.
+
+  if (!data.empty() && fwrite(data.data(), 1, data.size(), m_file) != data.size()) {
+    return Error{heif_error_Encoding_error,
+                 heif_suberror_Cannot_write_output_data,
+                 "Could not write to temporary file (storage full?)"};
+  }
+
+  uint64_t startPos = m_size;
+  m_size += data.size();
+  return startPos;
+}
+
+
+Error MdatData_TmpFile::replace_data(uint64_t position, const uint8_t* data, size_t size)
+{
+  if (position > m_size || size > m_size - position) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Replaced data lies outside of the 'mdat' data"};
+  }
+
+  if (Error err = seek(position)) {
+    return err;
+  }
+
+  bool ok = (size == 0 || fwrite(data, 1, size, m_file) == size);
+
+  if (Error err = seek(m_size)) {
+    return err;
+  }
+
+  if (!ok) {
+    return {heif_error_Encoding_error,
+            heif_suberror_Cannot_write_output_data,
+            "Could not write to temporary file"};
+  }
+
+  return Error::Ok;
+}
+
+
+Error MdatData_TmpFile::read_blocks(uint64_t position, uint64_t size,
+                                    const std::function<void(const uint8_t* data, size_t size)>& block_callback)
+{
+  if (Error err = check_range(position, size, m_size)) {
+    return err;
+  }
+
+  if (fflush(m_file) != 0) {
+    return {heif_error_Encoding_error,
+            heif_suberror_Cannot_write_output_data,
+            "Could not write to temporary file (storage full?)"};
+  }
+
+  if (Error err = seek(position)) {
+    return err;
+  }
+
+  std::vector<uint8_t> block(static_cast<size_t>(std::min(static_cast<uint64_t>(copy_block_size), size)));
+
+  uint64_t remaining = size;
+  while (remaining > 0) {
+    size_t n = static_cast<size_t>(std::min(static_cast<uint64_t>(block.size()), remaining));
+    if (fread(block.data(), 1, n, m_file) != n) {
+      (void) seek(m_size);
+      return {heif_error_Encoding_error,
+              heif_suberror_Cannot_write_output_data,
+              "Could not read temporary file"};
+    }
+
+    block_callback(block.data(), n);
+    remaining -= n;
+  }
+
+  return seek(m_size);
+}
+
+
+Error MdatData_TmpFile::write(StreamWriter& writer)
+{
+  return read_blocks(0, m_size, [&writer](const uint8_t* data, size_t size) {
+    writer.write(data, size);
+  });
+}
+
+
+Error MdatData_TmpFile::write(const OutputWriteFunction& output)
+{
+  return write_range(0, m_size, output);
+}
+
+
+Error MdatData_TmpFile::write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output)
+{
+  Error output_error;
+
+  Error err = read_blocks(position, size, [&](const uint8_t* block, size_t block_size) {
+    if (!output_error) {
+      output_error = output(block, block_size);
+    }
+  });
+
+  return output_error ? output_error : err;
+}
+
+
+Result<uint64_t> MdatData_Output::append_data(const std::vector<uint8_t>& data)
+{
+  if (!data.empty()) {
+    if (Error err = m_write(data.data(), data.size())) {
+      return err;
+    }
+  }
+
+  uint64_t startPos = m_size;
+  m_size += data.size();
+  return startPos;
+}
+
+
+Error MdatData_Output::replace_data(uint64_t position, const uint8_t* data, size_t size)
+{
+  if (position > m_size || size > m_size - position) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Replaced data lies outside of the 'mdat' data"};
+  }
+
+  if (size == 0) {
+    return Error::Ok;
+  }
+
+  if (Error err = m_seek(m_data_start + position)) {
+    return err;
+  }
+
+  if (Error err = m_write(data, size)) {
+    return err;
+  }
+
+  return m_seek(m_data_start + m_size);
+}
+
+
+Error MdatData_Output::write(StreamWriter&)
+{
+  return {heif_error_Usage_error,
+          heif_suberror_Unspecified,
+          "The 'mdat' data has already been written to the output"};
+}
+
+
+Error MdatData_Output::write(const OutputWriteFunction&)
+{
+  return {heif_error_Usage_error,
+          heif_suberror_Unspecified,
+          "The 'mdat' data has already been written to the output"};
+}
+
+
+Result<uint64_t> MdatData_InputFile::append_input_range(uint64_t file_offset, uint64_t size)
+{
+  if (m_appended_data->get_data_size() != 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Unspecified,
+                 "Input file data has to be added before other data"};
+  }
+
+  if (!m_input_ranges.empty() &&
+      m_input_ranges.back().file_offset + m_input_ranges.back().size == file_offset) {
+    m_input_ranges.back().size += size;
+  }
+  else {
+    m_input_ranges.push_back({file_offset, size});
+  }
+
+  uint64_t startPos = m_input_size;
+  m_input_size += size;
+  return startPos;
+}
+
+
+Result<uint64_t> MdatData_InputFile::append_data(const std::vector<uint8_t>& data)
+{
+  Result<uint64_t> posResult = m_appended_data->append_data(data);
+  if (!posResult) {
+    return posResult.error;
+  }
+
+  return m_input_size + *posResult;
+}
+
+
+Error MdatData_InputFile::replace_data(uint64_t position, const uint8_t* data, size_t size)
+{
+  if (position < m_input_size) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Data copied from the input file cannot be replaced"};
+  }
+
+  return m_appended_data->replace_data(position - m_input_size, data, size);
+}
+
+
+uint8_t* MdatData_InputFile::get_data_for_writing(uint64_t position, uint64_t size)
+{
+  if (position < m_input_size) {
+    return nullptr;
+  }
+
+  return m_appended_data->get_data_for_writing(position - m_input_size, size);
+}
+
+
+Error MdatData_InputFile::copy_input_range(StreamReader& input, uint64_t file_offset, uint64_t size,
+                                           const OutputWriteFunction& output)
+{
+  std::vector<uint8_t> block(static_cast<size_t>(std::min(static_cast<uint64_t>(copy_block_size), size)));
+
+  while (size > 0) {
+    size_t n = static_cast<size_t>(std::min(static_cast<uint64_t>(block.size()), size));
+
+    {
+#if ENABLE_MULTITHREADING_SUPPORT
+      std::lock_guard<std::mutex> lock(input.get_read_mutex());
+#endif
+
+      StreamReader::grow_status status = input.wait_for_file_size(file_offset + n);
+      if (status != StreamReader::grow_status::size_reached) {
+        return {heif_error_Invalid_input,
+                heif_suberror_End_of_data,
+                "Item data lies outside of the input file"};
+      }
+    }
+
+    if (!input.read_at(file_offset, block.data(), n)) {
+      return {heif_error_Invalid_input,
+              heif_suberror_End_of_data,
+              "Cannot read item data from the input file"};
+    }
+
+    if (Error err = output(block.data(), n)) {
+      return err;
+    }
+
+    file_offset += n;
+    size -= n;
+  }
+
+  return Error::Ok;
+}
+
+
+Error MdatData_InputFile::write(StreamWriter& writer)
+{
+  return write([&writer](const uint8_t* data, size_t size) {
+    writer.write(data, size);
+    return Error::Ok;
+  });
+}
+
+
+Error MdatData_InputFile::write(const OutputWriteFunction& output)
+{
+  for (const auto& range : m_input_ranges) {
+    if (Error err = copy_input_range(*m_input, range.file_offset, range.size, output)) {
+      return err;
+    }
+  }
+
+  return m_appended_data->write(output);
+}
+
+
+Error MdatData_InputFile::write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output)
+{
+  if (Error err = check_range(position, size, get_data_size())) {
+    return err;
+  }
+
+  // --- the part that is copied from the input file
+
+  uint64_t range_start = 0;
+
+  for (const auto& range : m_input_ranges) {
+    if (size == 0) {
+      return Error::Ok;
+    }
+
+    uint64_t range_end = range_start + range.size;
+
+    if (position < range_end) {
+      uint64_t n = std::min(size, range_end - position);
+      if (Error err = copy_input_range(*m_input, range.file_offset + (position - range_start), n, output)) {
+        return err;
+      }
+
+      position += n;
+      size -= n;
+    }
+
+    range_start = range_end;
+  }
+
+  if (size == 0) {
+    return Error::Ok;
+  }
+
+  return m_appended_data->write_range(position - m_input_size, size, output);
+}
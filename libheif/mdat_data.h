@@ -21,45 +21,188 @@
 #ifndef LIBHEIF_MDAT_DATA_H
 #define LIBHEIF_MDAT_DATA_H
 
+#include "error.h"
+#include "bitstream.h"
+
 #include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
 #include <vector>
-#include <cassert>
-#include <algorithm>
 
 
+// Receives the next part of the output file.
+using OutputWriteFunction = std::function<Error(const uint8_t* data, size_t size)>;
+
+// Moves the output position. The next OutputWriteFunction call overwrites the file at this position.
+using OutputSeekFunction = std::function<Error(uint64_t position)>;
+
+
+// Holds the 'mdat' payload (compressed image and sequence data) while a file is created.
+// All positions are relative to the start of the payload.
 class MdatData
 {
 public:
   virtual ~MdatData() = default;
 
   // returns the start position of the appended data
-  virtual size_t append_data(const std::vector<uint8_t>& data) = 0;
+  virtual Result<uint64_t> append_data(const std::vector<uint8_t>& data) = 0;
+
+  // Overwrites data that has been appended before.
+  virtual Error replace_data(uint64_t position, const uint8_t* data, size_t size) = 0;
 
-  virtual size_t get_data_size() const = 0;
+  // Returns a pointer into data that has been appended before, through which it can be overwritten
+  // in place. Returns nullptr if the data is not held in memory.
+  virtual uint8_t* get_data_for_writing(uint64_t position, uint64_t size) { return nullptr; }
 
+  virtual uint64_t get_data_size() const = 0;
+
+  // Copies all data into the writer.
   virtual Error write(StreamWriter&) = 0;
+
+  // Passes all data in blocks to 'output'.
+  virtual Error write(const OutputWriteFunction& output) = 0;
+
+  // Passes the data in [position, position+size) in blocks to 'output'.
+  virtual Error write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output)
+  {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "The 'mdat' data cannot be written in parts"};
+  }
 };
 
 
 class MdatData_Memory : public MdatData
 {
 public:
-  size_t append_data(const std::vector<uint8_t>& data) override {
-    size_t startPos = m_data.size();
-    m_data.insert(m_data.end(), data.begin(), data.end());
-    return startPos;
-  }
+  Result<uint64_t> append_data(const std::vector<uint8_t>& data) override;
 
-  size_t get_data_size() const override { return m_data.size(); }
+  Error replace_data(uint64_t position, const uint8_t* data, size_t size) override;
 
-  Error write(StreamWriter& writer) override
-  {
-    writer.write(m_data);
-    return Error::Ok;
-  }
+  uint8_t* get_data_for_writing(uint64_t position, uint64_t size) override;
+
+  uint64_t get_data_size() const override { return m_data.size(); }
+
+  Error write(StreamWriter& writer) override;
+
+  Error write(const OutputWriteFunction& output) override;
+
+  Error write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output) override;
 
 private:
   std::vector<uint8_t> m_data;
 };
 
+
+// Keeps the data in a temporary file, which is deleted automatically when it is closed.
+class MdatData_TmpFile : public MdatData
+{
+public:
+  ~MdatData_TmpFile() override;
+
+  Error open();
+
+  Result<uint64_t> append_data(const std::vector<uint8_t>& data) override;
+
+  Error replace_data(uint64_t position, const uint8_t* data, size_t size) override;
+
+  uint64_t get_data_size() const override { return m_size; }
+
+  Error write(StreamWriter& writer) override;
+
+  Error write(const OutputWriteFunction& output) override;
+
+  Error write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output) override;
+
+private:
+  FILE* m_file = nullptr;
+  uint64_t m_size = 0;
+
+  Error seek(uint64_t position);
+
+  // Reads [position, position+size) in blocks.
+  Error read_blocks(uint64_t position, uint64_t size,
+                    const std::function<void(const uint8_t* data, size_t size)>& block_callback);
+};
+
+
+// Writes the data directly into the output file, starting at 'data_start'.
+// The data is not kept and cannot be written again.
+class MdatData_Output : public MdatData
+{
+public:
+  MdatData_Output(OutputWriteFunction write, OutputSeekFunction seek, uint64_t data_start)
+      : m_write(std::move(write)), m_seek(std::move(seek)), m_data_start(data_start) {}
+
+  Result<uint64_t> append_data(const std::vector<uint8_t>& data) override;
+
+  // Seeks back in the output file and returns to its end afterward.
+  Error replace_data(uint64_t position, const uint8_t* data, size_t size) override;
+
+  uint64_t get_data_size() const override { return m_size; }
+
+  uint64_t get_data_start() const { return m_data_start; }
+
+  Error write(StreamWriter& writer) override;
+
+  Error write(const OutputWriteFunction& output) override;
+
+  const OutputWriteFunction& get_write_function() const { return m_write; }
+
+  const OutputSeekFunction& get_seek_function() const { return m_seek; }
+
+private:
+  OutputWriteFunction m_write;
+  OutputSeekFunction m_seek;
+  uint64_t m_data_start;
+  uint64_t m_size = 0;
+};
+
+// Data of a file that has been read and is written again.
+// The item data of the input file is not held in memory. It is copied in blocks from the input stream
+// when the file is written. Data added afterward is stored in 'appended_data'.
+class MdatData_InputFile : public MdatData
+{
+public:
+  MdatData_InputFile(std::shared_ptr<StreamReader> input, std::unique_ptr<MdatData> appended_data)
+      : m_input(std::move(input)), m_appended_data(std::move(appended_data)) {}
+
+  // Adds a range of the input file. Has to be called before any other data is appended.
+  // Returns the position of the range in the 'mdat' data.
+  Result<uint64_t> append_input_range(uint64_t file_offset, uint64_t size);
+
+  Result<uint64_t> append_data(const std::vector<uint8_t>& data) override;
+
+  // Only data that has been appended with append_data() can be replaced.
+  Error replace_data(uint64_t position, const uint8_t* data, size_t size) override;
+
+  uint8_t* get_data_for_writing(uint64_t position, uint64_t size) override;
+
+  uint64_t get_data_size() const override { return m_input_size + m_appended_data->get_data_size(); }
+
+  Error write(StreamWriter& writer) override;
+
+  Error write(const OutputWriteFunction& output) override;
+
+  Error write_range(uint64_t position, uint64_t size, const OutputWriteFunction& output) override;
+
+  // Passes the input file range [file_offset, file_offset+size) in blocks to 'output'.
+  static Error copy_input_range(StreamReader& input, uint64_t file_offset, uint64_t size,
+                                const OutputWriteFunction& output);
+
+private:
+  std::shared_ptr<StreamReader> m_input;
+  std::unique_ptr<MdatData> m_appended_data;
+
+  struct InputRange
+  {
+    uint64_t file_offset;
+    uint64_t size;
+  };
+
+  std::vector<InputRange> m_input_ranges;
+  uint64_t m_input_size = 0;
+};
+
 #endif //LIBHEIF_MDAT_DATA_H
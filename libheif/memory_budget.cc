@@ -0,0 +1,164 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <fstream>
+#include <string>
+
+#if __linux__
+#include <unistd.h>
+#endif
+
+
+MemoryBudget::MemoryBudget()
+    : m_max_bytes(get_default_max_bytes())
+{
+}
+
+
+MemoryBudget& MemoryBudget::global()
+{
+  static MemoryBudget budget;
+  return budget;
+}
+
+
+bool MemoryBudget::reserve(size_t size, size_t margin, bool check)
+{
+  uint64_t used = m_used_bytes;
+
+  do {
+    uint64_t max_bytes = m_max_bytes;
+    if (check && max_bytes != 0 &&
+        (size > max_bytes || margin > max_bytes - size || used > max_bytes - size - margin)) {
+      return false;
+    }
+  } while (!m_used_bytes.compare_exchange_weak(used, used + size));
+
+  return true;
+}
+
+
+uint64_t DecodingMemoryBudget::estimate_tile_memory(uint32_t width, uint32_t height, int bits_per_pixel)
+{
+  uint64_t bytes_per_component = (bits_per_pixel > 8) ? 2 : 1;
+  return 2 * 4 * bytes_per_component * width * height;
+}
+
+
+size_t DecodingMemoryBudget::reserve_tasks(uint64_t task_size, size_t max_tasks, uint64_t max_bytes)
+{
+  uint64_t used = m_used_bytes;
+  size_t num_tasks;
+
+  do {
+    num_tasks = max_tasks;
+
+    if (max_bytes != 0 && task_size != 0) {
+      uint64_t available = (used < max_bytes) ? max_bytes - used : 0;
+      num_tasks = static_cast<size_t>(std::min(static_cast<uint64_t>(max_tasks), available / task_size));
+    }
+
+    num_tasks = std::max(num_tasks, size_t{1});
+  } while (!m_used_bytes.compare_exchange_weak(used, used + num_tasks * task_size));
+
+  return num_tasks;
+}
+
+
+#if __linux__
+// Reads a cgroup memory limit. Returns 0 if the file does not exist or there is no limit ("max").
+static uint64_t read_cgroup_limit(const std::string& filename)
+{
+  std::ifstream istr(filename);
+  std::string value;
+  if (!(istr >> value) || value.empty() || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+    return 0;
+  }
+
+  try {
+    return std::stoull(value);
+  }
+  catch (const std::exception&) {
+    return 0;
+  }
+}
+
+
+static uint64_t get_cgroup_memory_limit()
+{
+  // --- cgroup v2: the line "0::<path>" in /proc/self/cgroup names the cgroup of the process
+
+  std::ifstream cgroup_file("/proc/self/cgroup");
+  std::string line;
+  while (std::getline(cgroup_file, line)) {
+    if (line.compare(0, 3, "0::") == 0) {
+      std::string path = line.substr(3);
+      if (path == "/") {
+        path.clear();
+      }
+
+      if (uint64_t limit = read_cgroup_limit("/sys/fs/cgroup" + path + "/memory.max")) {
+        return limit;
+      }
+    }
+  }
+
+  if (uint64_t limit = read_cgroup_limit("/sys/fs/cgroup/memory.max")) {
+    return limit;
+  }
+
+  // --- cgroup v1 (without a limit, this is a huge number and the physical memory size will be smaller)
+
+  return read_cgroup_limit("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+}
+#endif
+
+
+uint64_t MemoryBudget::get_default_max_bytes()
+{
+#if __linux__
+  uint64_t physical_memory = 0;
+
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (pages > 0 && page_size > 0) {
+    physical_memory = static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+  }
+
+  uint64_t cgroup_limit = get_cgroup_memory_limit();
+
+  if (cgroup_limit == 0) {
+    return physical_memory;
+  }
+  else if (physical_memory == 0) {
+    return cgroup_limit;
+  }
+  else {
+    return std::min(cgroup_limit, physical_memory);
+  }
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,111 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_MEMORY_BUDGET_H
+#define LIBHEIF_MEMORY_BUDGET_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Counts the memory of all live image planes allocated by HeifPixelImage::ImagePlane::alloc()
+// and checks new allocations against a ceiling.
+//
+// The budget is shared by all HeifContexts. By default, the ceiling is the memory limit of the
+// cgroup the process runs in, or the physical memory size if there is no cgroup limit.
+class MemoryBudget
+{
+public:
+  MemoryBudget();
+
+  MemoryBudget(const MemoryBudget&) = delete;
+
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  static MemoryBudget& global();
+
+  // Setting the ceiling to 0 disables the check.
+  void set_max_bytes(uint64_t max_bytes) { m_max_bytes = max_bytes; }
+
+  uint64_t get_max_bytes() const { return m_max_bytes; }
+
+  uint64_t get_used_bytes() const { return m_used_bytes; }
+
+  // Counts 'size' bytes as used. Fails without counting them if the used memory plus 'margin'
+  // would exceed the ceiling. With check=false, the memory is counted without checking the ceiling.
+  bool reserve(size_t size, size_t margin, bool check = true);
+
+  void release(size_t size) { m_used_bytes -= size; }
+
+  // The cgroup memory limit (Linux only), or the physical memory size. Returns 0 if neither is known.
+  static uint64_t get_default_max_bytes();
+
+private:
+  std::atomic<uint64_t> m_max_bytes;
+  std::atomic<uint64_t> m_used_bytes{0};
+};
+
+
+// Memory reserved by the parallel tile decoding of one HeifContext.
+// Before starting its tasks, a tile scheduler reserves the estimated memory of the tiles that it decodes at the same
+// time. When the budget (heif_security_limits::max_total_memory) is used up, it runs fewer tasks in parallel.
+class DecodingMemoryBudget
+{
+public:
+  // Estimated memory of decoding a tile: the decoder's frame buffer and the HeifPixelImage it is copied to,
+  // each with up to four components.
+  static uint64_t estimate_tile_memory(uint32_t width, uint32_t height, int bits_per_pixel);
+
+  // Reserves the memory of up to 'max_tasks' tasks with 'task_size' bytes each such that the total
+  // does not exceed 'max_bytes' (0 = no limit). At least one task is always granted, such that decoding
+  // can proceed. Returns the number of tasks. Their memory has to be released with release().
+  size_t reserve_tasks(uint64_t task_size, size_t max_tasks, uint64_t max_bytes);
+
+  void release(uint64_t size) { m_used_bytes -= size; }
+
+  uint64_t get_used_bytes() const { return m_used_bytes; }
+
+  // Holds a reservation until it goes out of scope.
+  class Reservation
+  {
+  public:
+    Reservation(DecodingMemoryBudget& budget, uint64_t task_size, size_t max_tasks, uint64_t max_bytes)
+        : m_budget(budget), m_num_tasks(budget.reserve_tasks(task_size, max_tasks, max_bytes)), m_size(task_size * m_num_tasks) {}
+
+    ~Reservation() { m_budget.release(m_size); }
+
+    Reservation(const Reservation&) = delete;
+
+    Reservation& operator=(const Reservation&) = delete;
+
+    size_t get_num_tasks() const { return m_num_tasks; }
+
+  private:
+    DecodingMemoryBudget& m_budget;
+    size_t m_num_tasks;
+    uint64_t m_size;
+  };
+
+private:
+  std::atomic<uint64_t> m_used_bytes{0};
+};
+
+#endif //LIBHEIF_MEMORY_BUDGET_H
@@ -31,13 +31,29 @@
 #include <utility>
 
 
+static std::vector<uint8_t> to_vector(std::span<const uint8_t> bytes)
+{
+  return {bytes.begin(), bytes.end()};
+}
+
+
 Error Box_mini::parse(BitstreamRange &range, const heif_security_limits *limits)
 {
   uint64_t start_offset = range.get_istream()->get_position();
   std::size_t length = range.get_remaining_bytes();
-  std::vector<uint8_t> mini_data(length);
-  range.read(mini_data.data(), mini_data.size());
-  BitReader bits(mini_data.data(), (int)(mini_data.size()));
+
+  // Parse directly from the file data if the StreamReader provides it. Otherwise, it is read with a single read.
+  range.buffer_remaining_data();
+
+  std::vector<uint8_t> mini_data;
+  const uint8_t* data = range.get_buffered_data();
+  if (!data) {
+    mini_data.resize(length);
+    range.read(mini_data.data(), mini_data.size());
+    data = mini_data.data();
+  }
+
+  BitReader bits(data, (int)length);
   m_version = bits.get_bits8(2);
   m_explicit_codec_types_flag = bits.get_flag();
   m_float_flag = bits.get_flag();
@@ -408,28 +424,28 @@ Error Box_mini::parse(BitstreamRange &range, const heif_security_limits *limits)
   // Chunks
   if (m_alpha_flag && (m_alpha_item_data_size > 0) && (alpha_item_codec_config_size > 0))
   {
-    m_alpha_item_codec_config = bits.read_bytes(alpha_item_codec_config_size);
+    m_alpha_item_codec_config = to_vector(bits.read_bytes(alpha_item_codec_config_size));
   }
   if (m_hdr_flag && m_gainmap_flag && (gainmap_item_codec_config_size > 0))
   {
-    m_gainmap_item_codec_config = bits.read_bytes(gainmap_item_codec_config_size);
+    m_gainmap_item_codec_config = to_vector(bits.read_bytes(gainmap_item_codec_config_size));
   }
   if (main_item_codec_config_size > 0)
   {
-    m_main_item_codec_config = bits.read_bytes(main_item_codec_config_size);
+    m_main_item_codec_config = to_vector(bits.read_bytes(main_item_codec_config_size));
   }
 
   if (m_icc_flag)
   {
-    m_icc_data = bits.read_bytes(icc_data_size);
+    m_icc_data = to_vector(bits.read_bytes(icc_data_size));
   }
   if (m_hdr_flag && m_gainmap_flag && m_tmap_icc_flag)
   {
-    m_tmap_icc_data = bits.read_bytes(tmap_icc_data_size);
+    m_tmap_icc_data = to_vector(bits.read_bytes(tmap_icc_data_size));
   }
   if (m_hdr_flag && m_gainmap_flag && (gainmap_metadata_size > 0))
   {
-    m_gainmap_metadata = bits.read_bytes(gainmap_metadata_size);
+    m_gainmap_metadata = to_vector(bits.read_bytes(gainmap_metadata_size));
   }
 
   if (m_alpha_flag && (m_alpha_item_data_size > 0))
@@ -917,15 +933,17 @@ Error Box_mini::create_expanded_boxes(class HeifFile* file)
   // TODO: replace this placeholder with pixi box version 1 once that is supported
   ipco_box->append_child_box(std::make_shared<Box_free>()); // placeholder for entry 8
 
-  if (get_orientation() == 2) {
+  // The orientation is the EXIF orientation value (1-8).
+
+  if (get_orientation() == 3) {
     std::shared_ptr<Box_irot> irot = std::make_shared<Box_irot>();
     irot->set_rotation_ccw(2 * 90);
     ipco_box->append_child_box(irot); // entry 9
-  } else if ((get_orientation() == 4) || (get_orientation() == 6) || (get_orientation() == 7)) {
+  } else if ((get_orientation() == 5) || (get_orientation() == 7) || (get_orientation() == 8)) {
     std::shared_ptr<Box_irot> irot = std::make_shared<Box_irot>();
     irot->set_rotation_ccw(1 * 90);
     ipco_box->append_child_box(irot); // entry 9
-  } else if (get_orientation() == 5) {
+  } else if (get_orientation() == 6) {
     std::shared_ptr<Box_irot> irot = std::make_shared<Box_irot>();
     irot->set_rotation_ccw(3 * 90);
     ipco_box->append_child_box(irot); // entry 9
@@ -933,11 +951,11 @@ Error Box_mini::create_expanded_boxes(class HeifFile* file)
     ipco_box->append_child_box(std::make_shared<Box_free>()); // placeholder for entry 9
   }
 
-  if ((get_orientation() == 1) || (get_orientation() == 6)) {
+  if ((get_orientation() == 2) || (get_orientation() == 7)) {
     std::shared_ptr<Box_imir> imir = std::make_shared<Box_imir>();
     imir->set_mirror_direction(heif_transform_mirror_direction_horizontal);
     ipco_box->append_child_box(imir); // entry 10
-  } else if ((get_orientation() == 3) || (get_orientation() == 4)) {
+  } else if ((get_orientation() == 4) || (get_orientation() == 5)) {
     std::shared_ptr<Box_imir> imir = std::make_shared<Box_imir>();
     imir->set_mirror_direction(heif_transform_mirror_direction_vertical);
     ipco_box->append_child_box(imir); // entry 10
@@ -1030,3 +1048,505 @@ Error Box_mini::create_expanded_boxes(class HeifFile* file)
 
   return Error::Ok;
 }
+
+
+static heif_brand2 get_brand_for_item_type(uint32_t item_type)
+{
+  switch (item_type) {
+    case fourcc("av01"):
+      return heif_brand2_avif;
+    case fourcc("hvc1"):
+      return heif_brand2_heic;
+    default:
+      return 0;
+  }
+}
+
+
+static Error mini_unsupported(const char* reason)
+{
+  return {heif_error_Unsupported_feature,
+          heif_suberror_Unspecified,
+          std::string("File cannot be written as 'mini' box: ") + reason};
+}
+
+
+namespace {
+  struct MiniImageProperties
+  {
+    std::vector<uint8_t> codec_config;
+    uint8_t chroma_subsampling = 0;
+    uint8_t bit_depth = 8;
+
+    std::shared_ptr<Box_ispe> ispe;
+    std::shared_ptr<const color_profile_nclx> nclx;
+    std::shared_ptr<const color_profile_raw> icc;
+    std::shared_ptr<Box_auxC> auxC;
+
+    int rotation_ccw = 0;
+    bool mirror = false;
+    heif_transform_mirror_direction mirror_direction = heif_transform_mirror_direction_horizontal;
+  };
+}
+
+
+// EXIF orientation of an 'irot' transformation followed by an 'imir' transformation (see create_expanded_boxes()).
+static uint8_t get_exif_orientation(const MiniImageProperties& props)
+{
+  int rotation_index = props.rotation_ccw / 90;
+
+  if (!props.mirror) {
+    const uint8_t orientation[4] = {1, 8, 3, 6};
+    return orientation[rotation_index];
+  }
+  else if (props.mirror_direction == heif_transform_mirror_direction_horizontal) {
+    const uint8_t orientation[4] = {2, 7, 4, 5};
+    return orientation[rotation_index];
+  }
+  else {
+    const uint8_t orientation[4] = {4, 5, 2, 7};
+    return orientation[rotation_index];
+  }
+}
+
+
+static Error get_mini_image_properties(const HeifFile& file, heif_item_id id, MiniImageProperties& out_props)
+{
+  std::vector<std::shared_ptr<Box>> properties;
+  if (Error err = file.get_properties(id, properties)) {
+    return err;
+  }
+
+  for (const auto& property : properties) {
+    if (auto hvcC = std::dynamic_pointer_cast<Box_hvcC>(property)) {
+      out_props.chroma_subsampling = hvcC->get_configuration().chroma_format;
+      out_props.bit_depth = hvcC->get_configuration().bit_depth_luma;
+    }
+    else if (auto av1C = std::dynamic_pointer_cast<Box_av1C>(property)) {
+      const auto& config = av1C->get_configuration();
+      switch (config.get_heif_chroma()) {
+        case heif_chroma_monochrome:
+          out_props.chroma_subsampling = 0;
+          break;
+        case heif_chroma_420:
+          out_props.chroma_subsampling = 1;
+          break;
+        case heif_chroma_422:
+          out_props.chroma_subsampling = 2;
+          break;
+        case heif_chroma_444:
+          out_props.chroma_subsampling = 3;
+          break;
+        default:
+          return mini_unsupported("unsupported AV1 chroma format");
+      }
+      out_props.bit_depth = config.high_bitdepth ? (config.twelve_bit ? 12 : 10) : 8;
+    }
+    else if (auto ispe = std::dynamic_pointer_cast<Box_ispe>(property)) {
+      out_props.ispe = ispe;
+      continue;
+    }
+    else if (std::dynamic_pointer_cast<Box_free>(property)) {
+      // placeholder written by create_expanded_boxes()
+      continue;
+    }
+    else if (std::dynamic_pointer_cast<Box_pixi>(property)) {
+      // derived from the codec configuration when reading the 'mini' box
+      continue;
+    }
+    else if (auto colr = std::dynamic_pointer_cast<Box_colr>(property)) {
+      if (auto nclx = std::dynamic_pointer_cast<const color_profile_nclx>(colr->get_color_profile())) {
+        out_props.nclx = nclx;
+      }
+      else if (colr->get_color_profile_type() == fourcc("prof")) {
+        out_props.icc = std::dynamic_pointer_cast<const color_profile_raw>(colr->get_color_profile());
+      }
+      else {
+        return mini_unsupported("unsupported color profile type");
+      }
+      continue;
+    }
+    else if (auto auxC = std::dynamic_pointer_cast<Box_auxC>(property)) {
+      out_props.auxC = auxC;
+      continue;
+    }
+    else if (auto irot = std::dynamic_pointer_cast<Box_irot>(property)) {
+      if (out_props.mirror || out_props.rotation_ccw != 0) {
+        return mini_unsupported("unsupported order of transformations");
+      }
+      out_props.rotation_ccw = irot->get_rotation_ccw();
+      continue;
+    }
+    else if (auto imir = std::dynamic_pointer_cast<Box_imir>(property)) {
+      if (out_props.mirror) {
+        return mini_unsupported("unsupported order of transformations");
+      }
+      out_props.mirror = true;
+      out_props.mirror_direction = imir->get_mirror_direction();
+      continue;
+    }
+    else {
+      return mini_unsupported("unsupported item property");
+    }
+
+    // --- codec configuration: store the box content without box header
+
+    if (!out_props.codec_config.empty()) {
+      return mini_unsupported("more than one codec configuration");
+    }
+
+    StreamWriter writer;
+    if (Error err = property->write(writer)) {
+      return err;
+    }
+
+    const std::vector<uint8_t>& box_data = writer.get_data();
+    out_props.codec_config.assign(box_data.begin() + 8, box_data.end());
+  }
+
+  if (out_props.codec_config.empty() || !out_props.ispe) {
+    return mini_unsupported("missing codec configuration or image size");
+  }
+
+  return Error::Ok;
+}
+
+
+static Error get_mini_item_data(const HeifFile& file, heif_item_id id, const std::vector<uint8_t>& mdat_data,
+                                std::vector<uint8_t>& out_data)
+{
+  for (const auto& item : file.get_iloc_box()->get_items()) {
+    if (item.item_ID != id) {
+      continue;
+    }
+
+    if (item.construction_method != 0 || item.data_reference_index != 0) {
+      return mini_unsupported("item data is not stored in the 'mdat' box");
+    }
+
+    for (const auto& extent : item.extents) {
+      if (extent.mdat_position > mdat_data.size() || extent.length > mdat_data.size() - extent.mdat_position) {
+        return {heif_error_Invalid_input,
+                heif_suberror_End_of_data,
+                "Item extent lies outside of the 'mdat' data"};
+      }
+
+      out_data.insert(out_data.end(),
+                      mdat_data.begin() + (std::ptrdiff_t) extent.mdat_position,
+                      mdat_data.begin() + (std::ptrdiff_t) (extent.mdat_position + extent.length));
+    }
+
+    return Error::Ok;
+  }
+
+  return mini_unsupported("item without data");
+}
+
+
+Result<std::shared_ptr<Box_mini>> Box_mini::create_from_file(const HeifFile& file, const std::vector<uint8_t>& mdat_data)
+{
+  if (file.has_sequences() || file.get_grpl_box() || !file.get_iloc_box()) {
+    return mini_unsupported("unsupported file structure");
+  }
+
+  auto iref = file.get_iref_box();
+
+
+  // --- identify the items
+
+  heif_item_id primary_id = file.get_primary_image_ID();
+  auto primary_infe = file.get_infe_box(primary_id);
+  if (!primary_infe) {
+    return mini_unsupported("no primary image");
+  }
+
+  uint32_t item_type = primary_infe->get_item_type_4cc();
+  heif_brand2 brand = get_brand_for_item_type(item_type);
+  if (brand == 0) {
+    return mini_unsupported("unsupported image codec");
+  }
+
+  if (iref && iref->has_references(primary_id)) {
+    return mini_unsupported("primary image references other items");
+  }
+
+  heif_item_id alpha_id = 0;
+  heif_item_id exif_id = 0;
+  heif_item_id xmp_id = 0;
+
+  for (heif_item_id id : file.get_item_IDs()) {
+    if (id == primary_id) {
+      continue;
+    }
+
+    std::vector<Box_iref::Reference> references;
+    if (iref) {
+      references = iref->get_references_from(id);
+    }
+
+    if (references.size() != 1 || references[0].to_item_ID != std::vector<heif_item_id>{primary_id}) {
+      return mini_unsupported("item that does not belong to the primary image");
+    }
+
+    auto infe = file.get_infe_box(id);
+    uint32_t reference_type = references[0].header.get_short_type();
+
+    if (reference_type == fourcc("auxl") && infe->get_item_type_4cc() == item_type && alpha_id == 0) {
+      alpha_id = id;
+    }
+    else if (reference_type == fourcc("cdsc") && infe->get_item_type_4cc() == fourcc("Exif") && exif_id == 0) {
+      exif_id = id;
+    }
+    else if (reference_type == fourcc("cdsc") && infe->get_item_type_4cc() == fourcc("mime") &&
+             infe->get_content_type() == "application/rdf+xml" && infe->get_content_encoding().empty() &&
+             xmp_id == 0) {
+      xmp_id = id;
+    }
+    else {
+      return mini_unsupported("unsupported item");
+    }
+  }
+
+
+  // --- image properties
+
+  MiniImageProperties props;
+  if (Error err = get_mini_image_properties(file, primary_id, props)) {
+    return err;
+  }
+
+  if (props.auxC) {
+    return mini_unsupported("primary image is an auxiliary image");
+  }
+
+  // Without 'nclx', the color parameters would be taken from the coded image, but the 'mini' box always specifies them.
+  if (!props.nclx) {
+    return mini_unsupported("no nclx color profile");
+  }
+
+  auto mini = std::make_shared<Box_mini>();
+
+  mini->m_width = props.ispe->get_width();
+  mini->m_height = props.ispe->get_height();
+  if (mini->m_width == 0 || mini->m_width > (1 << 15) || mini->m_height == 0 || mini->m_height > (1 << 15)) {
+    return mini_unsupported("image size");
+  }
+
+  if (props.bit_depth < 8 || props.bit_depth > 16) {
+    return mini_unsupported("bit depth");
+  }
+
+  mini->m_chroma_subsampling = props.chroma_subsampling;
+  mini->m_bit_depth = props.bit_depth;
+  mini->m_orientation = get_exif_orientation(props);
+  mini->m_main_item_codec_config = props.codec_config;
+
+  mini->m_icc_flag = (props.icc != nullptr);
+  if (props.icc) {
+    mini->m_icc_data = props.icc->get_data();
+  }
+
+  mini->m_colour_primaries = props.nclx->get_colour_primaries();
+  mini->m_transfer_characteristics = props.nclx->get_transfer_characteristics();
+  mini->m_matrix_coefficients = props.nclx->get_matrix_coefficients();
+  mini->m_full_range_flag = props.nclx->get_full_range_flag();
+
+  mini->m_explicit_cicp_flag = (mini->m_colour_primaries != (mini->m_icc_flag ? 2 : 1) ||
+                                mini->m_transfer_characteristics != (mini->m_icc_flag ? 2 : 13) ||
+                                mini->m_matrix_coefficients != (mini->m_chroma_subsampling == 0 ? 2 : 6));
+
+  if (Error err = get_mini_item_data(file, primary_id, mdat_data, mini->m_main_item_data)) {
+    return err;
+  }
+
+  if (alpha_id) {
+    MiniImageProperties alpha_props;
+    if (Error err = get_mini_image_properties(file, alpha_id, alpha_props)) {
+      return err;
+    }
+
+    if (!alpha_props.auxC ||
+        (alpha_props.auxC->get_aux_type() != "urn:mpeg:mpegB:cicp:systems:auxiliary:alpha" &&
+         alpha_props.auxC->get_aux_type() != "urn:mpeg:hevc:2015:auxid:1") ||
+        alpha_props.nclx || alpha_props.icc ||
+        alpha_props.ispe->get_width() != mini->m_width || alpha_props.ispe->get_height() != mini->m_height ||
+        get_exif_orientation(alpha_props) != mini->m_orientation) {
+      return mini_unsupported("unsupported alpha image");
+    }
+
+    mini->m_alpha_flag = true;
+    mini->m_alpha_item_codec_config = alpha_props.codec_config;
+
+    if (Error err = get_mini_item_data(file, alpha_id, mdat_data, mini->m_alpha_item_data)) {
+      return err;
+    }
+
+    if (mini->m_alpha_item_data.empty()) {
+      return mini_unsupported("empty alpha image");
+    }
+  }
+
+  if (exif_id) {
+    mini->m_exif_flag = true;
+    if (Error err = get_mini_item_data(file, exif_id, mdat_data, mini->m_exif_data)) {
+      return err;
+    }
+  }
+
+  if (xmp_id) {
+    mini->m_xmp_flag = true;
+    if (Error err = get_mini_item_data(file, xmp_id, mdat_data, mini->m_xmp_data)) {
+      return err;
+    }
+  }
+
+
+  // --- check that the sizes fit into the 'mini' box fields
+
+  const size_t max_metadata_size = 1 << 20;
+  const size_t max_codec_config_size = (1 << 12) - 1;
+  const size_t max_item_data_size = (1 << 28) - 1;
+
+  if ((mini->m_icc_flag && (mini->m_icc_data.empty() || mini->m_icc_data.size() > max_metadata_size)) ||
+      (mini->m_exif_flag && (mini->m_exif_data.empty() || mini->m_exif_data.size() > max_metadata_size)) ||
+      (mini->m_xmp_flag && (mini->m_xmp_data.empty() || mini->m_xmp_data.size() > max_metadata_size)) ||
+      mini->m_main_item_codec_config.size() > max_codec_config_size ||
+      mini->m_alpha_item_codec_config.size() > max_codec_config_size ||
+      mini->m_main_item_data.empty() || mini->m_main_item_data.size() > max_item_data_size + 1 ||
+      mini->m_alpha_item_data.size() > max_item_data_size) {
+    return mini_unsupported("data too large");
+  }
+
+  mini->m_infe_type = item_type;
+  mini->m_main_item_data_size = (uint32_t) mini->m_main_item_data.size();
+  mini->m_alpha_item_data_size = (uint32_t) mini->m_alpha_item_data.size();
+  mini->m_exif_item_data_size = (uint32_t) mini->m_exif_data.size();
+  mini->m_xmp_item_data_size = (uint32_t) mini->m_xmp_data.size();
+
+  return mini;
+}
+
+
+std::shared_ptr<Box_ftyp> Box_mini::create_ftyp_box() const
+{
+  auto ftyp = std::make_shared<Box_ftyp>();
+  ftyp->set_major_brand(heif_brand2_mif3);
+  ftyp->set_minor_version(get_brand_for_item_type(m_infe_type));
+  return ftyp;
+}
+
+
+Error Box_mini::write(StreamWriter& writer) const
+{
+  if (m_explicit_codec_types_flag || m_float_flag || m_hdr_flag) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unspecified,
+            "Writing 'mini' boxes with explicit codec types, float or HDR images is not supported"};
+  }
+
+  size_t box_start = reserve_box_header_space(writer);
+
+  bool small_dimensions_flag = (m_width <= 128 && m_height <= 128);
+  bool has_metadata = (m_icc_flag || m_exif_flag || m_xmp_flag);
+  bool few_metadata_bytes_flag = (m_icc_data.size() <= 1024 && m_exif_data.size() <= 1024 && m_xmp_data.size() <= 1024);
+  bool few_codec_config_bytes_flag = (m_main_item_codec_config.size() < 8 && m_alpha_item_codec_config.size() < 8);
+  bool few_item_data_bytes_flag = (m_main_item_data.size() <= (1 << 15) && m_alpha_item_data.size() < (1 << 15));
+
+  int metadata_size_bits = few_metadata_bytes_flag ? 10 : 20;
+  int codec_config_size_bits = few_codec_config_bytes_flag ? 3 : 12;
+  int item_data_size_bits = few_item_data_bytes_flag ? 15 : 28;
+
+  BitWriter bits;
+  bits.write_bits(m_version, 2);
+  bits.write_flag(m_explicit_codec_types_flag);
+  bits.write_flag(m_float_flag);
+  bits.write_flag(m_full_range_flag);
+  bits.write_flag(m_alpha_flag);
+  bits.write_flag(m_explicit_cicp_flag);
+  bits.write_flag(m_hdr_flag);
+  bits.write_flag(m_icc_flag);
+  bits.write_flag(m_exif_flag);
+  bits.write_flag(m_xmp_flag);
+  bits.write_bits(m_chroma_subsampling, 2);
+  bits.write_bits(m_orientation - 1, 3);
+  bits.write_flag(small_dimensions_flag);
+  bits.write_bits(m_width - 1, small_dimensions_flag ? 7 : 15);
+  bits.write_bits(m_height - 1, small_dimensions_flag ? 7 : 15);
+
+  if ((m_chroma_subsampling == 1) || (m_chroma_subsampling == 2)) {
+    bits.write_flag(m_chroma_is_horizontally_centred);
+  }
+  if (m_chroma_subsampling == 1) {
+    bits.write_flag(m_chroma_is_vertically_centred);
+  }
+
+  bool high_bit_depth_flag = (m_bit_depth > 8);
+  bits.write_flag(high_bit_depth_flag);
+  if (high_bit_depth_flag) {
+    bits.write_bits(m_bit_depth - 9, 3);
+  }
+
+  if (m_alpha_flag) {
+    bits.write_flag(m_alpha_is_premultiplied);
+  }
+
+  if (m_explicit_cicp_flag) {
+    bits.write_bits(m_colour_primaries, 8);
+    bits.write_bits(m_transfer_characteristics, 8);
+    if (m_chroma_subsampling != 0) {
+      bits.write_bits(m_matrix_coefficients, 8);
+    }
+  }
+
+  // --- chunk sizes
+
+  if (has_metadata) {
+    bits.write_flag(few_metadata_bytes_flag);
+  }
+  bits.write_flag(few_codec_config_bytes_flag);
+  bits.write_flag(few_item_data_bytes_flag);
+
+  if (m_icc_flag) {
+    bits.write_bits((uint32_t) m_icc_data.size() - 1, metadata_size_bits);
+  }
+
+  bits.write_bits((uint32_t) m_main_item_codec_config.size(), codec_config_size_bits);
+  bits.write_bits((uint32_t) m_main_item_data.size() - 1, item_data_size_bits);
+
+  if (m_alpha_flag) {
+    bits.write_bits((uint32_t) m_alpha_item_data.size(), item_data_size_bits);
+  }
+  if (m_alpha_flag && !m_alpha_item_data.empty()) {
+    bits.write_bits((uint32_t) m_alpha_item_codec_config.size(), codec_config_size_bits);
+  }
+
+  if (m_exif_flag) {
+    bits.write_bits((uint32_t) m_exif_data.size() - 1, metadata_size_bits);
+  }
+  if (m_xmp_flag) {
+    bits.write_bits((uint32_t) m_xmp_data.size() - 1, metadata_size_bits);
+  }
+
+  bits.skip_to_byte_boundary();
+
+  // --- chunks
+
+  if (m_alpha_flag && !m_alpha_item_data.empty()) {
+    bits.write_bytes(m_alpha_item_codec_config);
+  }
+  bits.write_bytes(m_main_item_codec_config);
+  if (m_icc_flag) {
+    bits.write_bytes(m_icc_data);
+  }
+
+  bits.write_bytes(m_alpha_item_data);
+  bits.write_bytes(m_main_item_data);
+  bits.write_bytes(m_exif_data);
+  bits.write_bytes(m_xmp_data);
+
+  writer.write(bits.get_data());
+
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
@@ -38,6 +38,15 @@ public:
 
   Error create_expanded_boxes(class HeifFile* file);
 
+  // Creates a 'mini' box that describes the same image as the 'meta' box of 'file'. The item data is taken from
+  // 'mdat_data', the content of the 'mdat' box. Returns an error if the file cannot be represented in a 'mini' box.
+  static Result<std::shared_ptr<Box_mini>> create_from_file(const class HeifFile& file, const std::vector<uint8_t>& mdat_data);
+
+  // The 'ftyp' box that has to be written in front of this box.
+  std::shared_ptr<Box_ftyp> create_ftyp_box() const;
+
+  Error write(StreamWriter& writer) const override;
+
   bool get_icc_flag() const { return m_icc_flag; }
   bool get_exif_flag() const { return m_exif_flag; }
   bool get_xmp_flag() const { return m_xmp_flag; }
@@ -152,6 +161,13 @@ private:
   uint32_t m_exif_item_data_size = 0;
   uint64_t m_xmp_item_data_offset = 0;
   uint32_t m_xmp_item_data_size = 0;
+
+  // --- item data, only used for writing
+
+  std::vector<uint8_t> m_alpha_item_data;
+  std::vector<uint8_t> m_main_item_data;
+  std::vector<uint8_t> m_exif_data;
+  std::vector<uint8_t> m_xmp_data;
 };
 
 #endif
@@ -22,19 +22,20 @@
 #include "pixelimage.h"
 #include "common_utils.h"
 #include "security_limits.h"
+#include "plane_buffer_pool.h"
+#include "memory_budget.h"
+#include "decoding_statistics.h"
+#include "rotation_simd.h"
+#include "color-conversion/alpha_simd.h"
 
 #include <cassert>
 #include <cstring>
 #include <utility>
 #include <limits>
 #include <algorithm>
+#include <atomic>
 #include <color-conversion/colorconversion.h>
 
-#if __linux__
-#include <sys/mman.h>
-#include <sys/sysinfo.h>
-#endif
-
 heif_chroma chroma_from_subsampling(int h, int v)
 {
   if (h == 2 && v == 2) {
@@ -97,15 +98,8 @@ uint32_t channel_height(uint32_t h, heif_chroma chroma, heif_channel channel)
 HeifPixelImage::~HeifPixelImage()
 {
   for (auto& iter : m_planes) {
-
-#if __linux__
-    munlock(iter.second.allocated_mem, iter.second.allocation_size);
-#endif
-
-    delete[] iter.second.allocated_mem;
+    iter.second.release_memory();
   }
-
-  heif_tai_timestamp_packet_release(m_tai_timestamp);
 }
 
 
@@ -189,6 +183,18 @@ void HeifPixelImage::create(uint32_t width, uint32_t height, heif_colorspace col
   m_chroma = chroma;
 }
 
+static uint8_t* align_pointer(uint8_t* p, uint16_t alignment)
+{
+  auto mem_start_addr = (uint64_t) p;
+  auto mem_start_offset = (mem_start_addr & (alignment - 1U));
+  if (mem_start_offset != 0) {
+    p += alignment - mem_start_offset;
+  }
+
+  return p;
+}
+
+
 static uint32_t rounded_size(uint32_t s)
 {
   s = (s + 1U) & ~1U;
@@ -242,6 +248,99 @@ Error HeifPixelImage::add_channel(heif_channel channel, uint32_t width, uint32_t
 }
 
 
+Error HeifPixelImage::add_external_plane(heif_channel channel, uint32_t width, uint32_t height, int bit_depth,
+                                         uint8_t* data, size_t stride, std::shared_ptr<void> memory_owner)
+{
+  if (has_channel(channel)) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Image already has a plane for this channel"};
+  }
+
+  if (width == 0 || height == 0 || data == nullptr) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "External plane has no pixel data"};
+  }
+
+  if (m_chroma == heif_chroma_interleaved_RGB && bit_depth == 24) {
+    bit_depth = 8;
+  }
+
+  if (m_chroma == heif_chroma_interleaved_RGBA && bit_depth == 32) {
+    bit_depth = 8;
+  }
+
+  if (bit_depth < 1 || bit_depth > 128) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Invalid bit depth of external plane"};
+  }
+
+  ImagePlane plane;
+  plane.m_width = width;
+  plane.m_height = height;
+  plane.m_bit_depth = static_cast<uint8_t>(bit_depth);
+  plane.m_num_interleaved_components = static_cast<uint8_t>(num_interleaved_pixels_per_plane(m_chroma));
+  plane.m_datatype = heif_channel_datatype_unsigned_integer;
+
+  uint64_t bytes_per_row = uint64_t{width} * plane.get_bytes_per_pixel() * plane.m_num_interleaved_components;
+  if (stride < bytes_per_row || stride > std::numeric_limits<uint32_t>::max()) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Invalid stride of external plane"};
+  }
+
+  // There is no memory beyond the visible area that we could use for padding.
+  plane.m_mem_width = width;
+  plane.m_mem_height = height;
+
+  plane.mem = data;
+  plane.stride = static_cast<uint32_t>(stride);
+  plane.external_memory = std::move(memory_owner);
+
+  m_planes.insert(std::make_pair(channel, plane));
+  return Error::Ok;
+}
+
+
+static std::atomic<uint16_t> s_plane_alignment{16};
+
+
+Error HeifPixelImage::set_plane_alignment(int alignment)
+{
+  if (alignment < 16 || alignment > 4096 || (alignment & (alignment - 1)) != 0) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Plane alignment must be a power of two between 16 and 4096"};
+  }
+
+  s_plane_alignment = static_cast<uint16_t>(alignment);
+  return Error::Ok;
+}
+
+
+int HeifPixelImage::get_plane_alignment()
+{
+  return s_plane_alignment;
+}
+
+
+void HeifPixelImage::ImagePlane::release_memory()
+{
+  if (allocated_mem) {
+    MemoryBudget::global().release(allocation_size);
+  }
+
+  PlaneBufferPool::global().release(allocated_mem, allocation_size, allocation_flags);
+  external_memory.reset();
+
+  allocated_mem = nullptr;
+  allocation_size = 0;
+  mem = nullptr;
+}
+
+
 Error HeifPixelImage::ImagePlane::alloc(uint32_t width, uint32_t height, heif_channel_datatype datatype, int bit_depth,
                                         int num_interleaved_components,
                                         const heif_security_limits* limits)
@@ -249,8 +348,8 @@ Error HeifPixelImage::ImagePlane::alloc(uint32_t width, uint32_t height, heif_ch
   assert(bit_depth >= 1);
   assert(bit_depth <= 128);
 
-  // use 16 byte alignment (enough for 128 bit data-types). Every row is an integer number of data-elements.
-  uint16_t alignment = 16; // must be power of two
+  // Use at least 16 byte alignment (enough for 128 bit data-types). Every row is an integer number of data-elements.
+  uint16_t alignment = s_plane_alignment; // must be power of two
 
   m_width = width;
   m_height = height;
@@ -288,98 +387,73 @@ Error HeifPixelImage::ImagePlane::alloc(uint32_t width, uint32_t height, heif_ch
 
   allocation_size = static_cast<size_t>(m_mem_height) * stride + alignment - 1;
 
-  try {
-#if __linux__
-    // 50% of the allocated memory size should remain as free memory (allocation of 1 GB fails if there is not at least 1.5 GB free).
-    size_t memory_margin = allocation_size / 2;
+  // --- check the memory budget
 
-    // limit the memory margin to an upper limit
+  // 50% of the allocated memory size should remain free in the budget (allocation of 1 GB fails if the budget has not at least 1.5 GB left).
+  size_t memory_margin = allocation_size / 2;
 
-    uint64_t max_memory_margin = limits ? limits->max_memory_margin : heif_get_global_security_limits()->max_memory_margin;
-    uint64_t min_memory_margin = limits ? limits->min_memory_margin : heif_get_global_security_limits()->min_memory_margin;
-    assert(max_memory_margin >= min_memory_margin);
+  // limit the memory margin to an upper limit
 
-    if (memory_margin > max_memory_margin) {
-      memory_margin = max_memory_margin;
-    }
+  uint64_t max_memory_margin = limits ? limits->max_memory_margin : heif_get_global_security_limits()->max_memory_margin;
+  uint64_t min_memory_margin = limits ? limits->min_memory_margin : heif_get_global_security_limits()->min_memory_margin;
+  assert(max_memory_margin >= min_memory_margin);
 
-    if (memory_margin < min_memory_margin) {
-      memory_margin = min_memory_margin;
-    }
+  if (memory_margin > max_memory_margin) {
+    memory_margin = max_memory_margin;
+  }
 
-    if (std::numeric_limits<size_t>::max() - memory_margin < allocation_size) {
-      return {heif_error_Memory_allocation_error,
-              heif_suberror_Unspecified,
-              "memory size integer overflow"};
-    }
+  if (memory_margin < min_memory_margin) {
+    memory_margin = min_memory_margin;
+  }
 
-    if (max_memory_margin > 0) {
-      // query free memory
+  if (std::numeric_limits<size_t>::max() - memory_margin < allocation_size) {
+    return {heif_error_Memory_allocation_error,
+            heif_suberror_Unspecified,
+            "memory size integer overflow"};
+  }
 
-      struct sysinfo info;
-      int err = sysinfo(&info);
-      if (err != 0) {
-        return {heif_error_Memory_allocation_error,
-                heif_suberror_Unspecified,
-                "sysinfo() failed"};
-      }
+  MemoryBudget& budget = MemoryBudget::global();
 
-      uint64_t free_memory = info.freeram + info.bufferram;
+  if (!budget.reserve(allocation_size, memory_margin, max_memory_margin > 0)) {
+    std::stringstream sstr;
+    sstr << "Allocating " << allocation_size << " bytes exceeds the image memory budget of "
+         << budget.get_max_bytes() << " bytes (" << budget.get_used_bytes() << " bytes in use)";
 
-      // requested memory exceeds safe size
+    allocation_size = 0;
 
-      if (allocation_size + memory_margin > free_memory) {
-        return {heif_error_Memory_allocation_error,
-                heif_suberror_Unspecified,
-                "free memory margin exceeded"};
-      }
-    }
-#endif
+    return {heif_error_Memory_allocation_error,
+            heif_suberror_Security_limit_exceeded,
+            sstr.str()};
+  }
 
-    // --- allocate memory
+  // --- reuse a buffer of a released plane
 
-    allocated_mem = new uint8_t[allocation_size];
-    uint8_t* mem_8 = allocated_mem;
+  allocation_flags = (limits && limits->version >= 4) ? limits->plane_allocation : 0;
 
-#if __linux__
-    // --- lock memory (allocate physical memory to fail fast if not enough physical memory is available)
+  allocated_mem = PlaneBufferPool::global().acquire(allocation_size, allocation_flags);
+  if (!allocated_mem) {
 
-    int ret = mlock(allocated_mem, allocation_size);
-    if (ret != 0) {
-      std::stringstream sstr;
-      sstr << "Cannot lock " << allocation_size << " bytes of memory, OS error: " << strerror(errno);
+    // --- allocate memory
 
-      delete[] allocated_mem;
-      allocated_mem = nullptr;
+    Result<uint8_t*> memResult = PlaneBufferPool::allocate_buffer(allocation_size, allocation_flags);
+    if (memResult.error) {
+      budget.release(allocation_size);
       allocation_size = 0;
 
-      return {heif_error_Memory_allocation_error,
-              heif_suberror_Unspecified,
-              sstr.str()};
+      return memResult.error;
     }
-#endif
-
 
-    // shift beginning of image data to aligned memory position
+    allocated_mem = *memResult;
+  }
 
-    auto mem_start_addr = (uint64_t) mem_8;
-    auto mem_start_offset = (mem_start_addr & (alignment - 1U));
-    if (mem_start_offset != 0) {
-      mem_8 += alignment - mem_start_offset;
-    }
+  // shift beginning of image data to aligned memory position
 
-    mem = mem_8;
+  mem = align_pointer(allocated_mem, alignment);
 
-    return Error::Ok;
-  }
-  catch (const std::bad_alloc& excpt) {
-    std::stringstream sstr;
-    sstr << "Allocating " << static_cast<size_t>(m_mem_height) * stride + alignment - 1 << " bytes failed";
+  DecodingStatistics::add(&DecodingStatistics::num_planes_allocated, 1);
+  DecodingStatistics::add(&DecodingStatistics::bytes_allocated, allocation_size);
 
-    return {heif_error_Memory_allocation_error,
-            heif_suberror_Unspecified,
-            sstr.str()};
-  }
+  return Error::Ok;
 }
 
 
@@ -422,6 +496,7 @@ Error HeifPixelImage::extend_padding_to_size(uint32_t width, uint32_t height, bo
                plane->m_width * bytes_per_pixel);
       }
 
+      planeIter.second.release_memory();
       planeIter.second = newPlane;
       plane = &planeIter.second;
     }
@@ -497,6 +572,7 @@ Error HeifPixelImage::extend_to_size_with_zero(uint32_t width, uint32_t height,
                plane->m_width * bytes_per_pixel);
       }
 
+      planeIter.second.release_memory();
       planeIter.second = newPlane;
       plane = &planeIter.second;
     }
@@ -712,6 +788,152 @@ Error HeifPixelImage::copy_new_plane_from(const std::shared_ptr<const HeifPixelI
 }
 
 
+Error HeifPixelImage::share_plane_from(const std::shared_ptr<const HeifPixelImage>& src_image,
+                                       heif_channel src_channel,
+                                       heif_channel dst_channel)
+{
+  auto src_plane_iter = src_image->m_planes.find(src_channel);
+  if (src_plane_iter == src_image->m_planes.end() || has_channel(dst_channel)) {
+    return Error::InternalError;
+  }
+
+  ImagePlane plane = src_plane_iter->second;
+
+  // Keep the owner of the memory alive: the caller's memory of an external plane, the image of which the source is a view,
+  // or the source image itself.
+  if (!plane.external_memory) {
+    if (src_image->m_view_source) {
+      plane.external_memory = src_image->m_view_source;
+    }
+    else {
+      plane.external_memory = src_image;
+    }
+  }
+
+  // The memory is released by its owner.
+  plane.allocated_mem = nullptr;
+  plane.allocation_size = 0;
+
+  // The padding belongs to the source plane. Like for views, extend_padding_to_size() has to allocate a separate plane.
+  plane.m_mem_width = plane.m_width;
+  plane.m_mem_height = plane.m_height;
+
+  m_planes.insert(std::make_pair(dst_channel, plane));
+
+  return Error::Ok;
+}
+
+
+template <typename S, typename D>
+static void copy_scaled_plane_rows(const uint8_t* src, size_t src_stride,
+                                   uint8_t* dst, size_t dst_stride,
+                                   uint32_t width, uint32_t height,
+                                   const std::vector<uint32_t>& src_x, const std::vector<uint32_t>& src_y,
+                                   const std::vector<uint16_t>& lut)
+{
+  const uint32_t max_value = static_cast<uint32_t>(lut.size() - 1);
+
+  for (uint32_t y = 0; y < height; y++) {
+    const auto* in = reinterpret_cast<const S*>(src + src_y[y] * src_stride);
+    auto* out = reinterpret_cast<D*>(dst + y * dst_stride);
+
+    if (lut.empty()) {
+      for (uint32_t x = 0; x < width; x++) {
+        out[x] = static_cast<D>(in[src_x[x]]);
+      }
+    }
+    else {
+      for (uint32_t x = 0; x < width; x++) {
+        out[x] = static_cast<D>(lut[std::min(static_cast<uint32_t>(in[src_x[x]]), max_value)]);
+      }
+    }
+  }
+}
+
+
+Error HeifPixelImage::copy_new_plane_scaled_from(const std::shared_ptr<const HeifPixelImage>& src_image,
+                                                 heif_channel src_channel,
+                                                 heif_channel dst_channel,
+                                                 int dst_bit_depth,
+                                                 uint32_t full_width, uint32_t full_height,
+                                                 uint32_t x0, uint32_t y0,
+                                                 const heif_security_limits* limits)
+{
+  assert(src_image->has_channel(src_channel));
+  assert(!has_channel(dst_channel));
+
+  const int src_bit_depth = src_image->get_bits_per_pixel(src_channel);
+  const int src_storage_bits = src_image->get_storage_bits_per_pixel(src_channel);
+  const int dst_storage_bits = dst_bit_depth > 8 ? 16 : 8;
+
+  if (src_image->get_datatype(src_channel) != heif_channel_datatype_unsigned_integer ||
+      (src_storage_bits != 8 && src_storage_bits != 16) ||
+      dst_bit_depth < 1 || dst_bit_depth > 16) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unsupported_bit_depth,
+            "Plane can only be rescaled with unsigned integer samples of up to 16 bits"};
+  }
+
+  const uint32_t src_width = src_image->get_width(src_channel);
+  const uint32_t src_height = src_image->get_height(src_channel);
+  const uint32_t width = get_width();
+  const uint32_t height = get_height();
+
+  if (full_width == 0 || full_height == 0 ||
+      uint64_t{x0} + width > full_width || uint64_t{y0} + height > full_height) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Plane area is outside of the scaled source plane"};
+  }
+
+  if (auto err = add_plane(dst_channel, width, height, dst_bit_depth, limits)) {
+    return err;
+  }
+
+  // nearest-neighbor sample positions, computed like in scale_nearest_neighbor()
+
+  std::vector<uint32_t> src_x(width), src_y(height);
+  for (uint32_t x = 0; x < width; x++) {
+    src_x[x] = static_cast<uint32_t>((uint64_t{x0} + x) * src_width / full_width);
+  }
+  for (uint32_t y = 0; y < height; y++) {
+    src_y[y] = static_cast<uint32_t>((uint64_t{y0} + y) * src_height / full_height);
+  }
+
+  // Bit depth conversion with rounding. The table stays empty when the bit depth is unchanged.
+
+  std::vector<uint16_t> lut;
+  if (src_bit_depth != dst_bit_depth) {
+    const uint32_t src_max = (1U << src_bit_depth) - 1;
+    const uint32_t dst_max = (1U << dst_bit_depth) - 1;
+
+    lut.resize(size_t{src_max} + 1);
+    for (uint32_t v = 0; v <= src_max; v++) {
+      lut[v] = static_cast<uint16_t>((v * dst_max + src_max / 2) / src_max);
+    }
+  }
+
+  size_t src_stride, dst_stride;
+  const uint8_t* src = src_image->get_plane(src_channel, &src_stride);
+  uint8_t* dst = get_plane(dst_channel, &dst_stride);
+
+  if (src_storage_bits == 8 && dst_storage_bits == 8) {
+    copy_scaled_plane_rows<uint8_t, uint8_t>(src, src_stride, dst, dst_stride, width, height, src_x, src_y, lut);
+  }
+  else if (src_storage_bits == 8) {
+    copy_scaled_plane_rows<uint8_t, uint16_t>(src, src_stride, dst, dst_stride, width, height, src_x, src_y, lut);
+  }
+  else if (dst_storage_bits == 8) {
+    copy_scaled_plane_rows<uint16_t, uint8_t>(src, src_stride, dst, dst_stride, width, height, src_x, src_y, lut);
+  }
+  else {
+    copy_scaled_plane_rows<uint16_t, uint16_t>(src, src_stride, dst, dst_stride, width, height, src_x, src_y, lut);
+  }
+
+  return Error::Ok;
+}
+
+
 Error HeifPixelImage::extract_alpha_from_RGBA(const std::shared_ptr<const HeifPixelImage>& src_image,
                                               const heif_security_limits* limits)
 {
@@ -788,6 +1010,63 @@ void HeifPixelImage::fill_plane(heif_channel dst_channel, uint16_t value)
 }
 
 
+void HeifPixelImage::fill_plane_region(heif_channel dst_channel, uint16_t value,
+                                       uint32_t x0, uint32_t y0, uint32_t w, uint32_t h)
+{
+  int num_interleaved = num_interleaved_pixels_per_plane(m_chroma);
+
+  if (dst_channel == heif_channel_Cb || dst_channel == heif_channel_Cr) {
+    uint32_t sub_h = chroma_h_subsampling(m_chroma);
+    uint32_t sub_v = chroma_v_subsampling(m_chroma);
+
+    w = (x0 + w + sub_h - 1) / sub_h - x0 / sub_h;
+    h = (y0 + h + sub_v - 1) / sub_v - y0 / sub_v;
+    x0 /= sub_h;
+    y0 /= sub_v;
+  }
+
+  uint32_t width = get_width(dst_channel);
+  uint32_t height = get_height(dst_channel);
+
+  if (x0 >= width || y0 >= height) {
+    return;
+  }
+
+  w = std::min(w, width - x0);
+  h = std::min(h, height - y0);
+
+  int bpp = get_bits_per_pixel(dst_channel);
+
+  if (bpp <= 8) {
+    size_t dst_stride = 0;
+    uint8_t* dst = get_plane(dst_channel, &dst_stride);
+
+    for (uint32_t y = y0; y < y0 + h; y++) {
+      memset(dst + y * dst_stride + x0 * num_interleaved, value, w * num_interleaved);
+    }
+  }
+  else if (bpp <= 16 && get_datatype(dst_channel) == heif_channel_datatype_unsigned_integer) {
+    size_t dst_stride = 0;
+    uint16_t* dst = get_channel<uint16_t>(dst_channel, &dst_stride);
+
+    for (uint32_t y = y0; y < y0 + h; y++) {
+      std::fill_n(dst + y * dst_stride + x0 * num_interleaved, w * num_interleaved, value);
+    }
+  }
+  else {
+    // wider and floating point samples are cleared to zero
+
+    size_t dst_stride = 0;
+    uint8_t* dst = get_plane(dst_channel, &dst_stride);
+    size_t bytes_per_pixel = get_storage_bits_per_pixel(dst_channel) / 8;
+
+    for (uint32_t y = y0; y < y0 + h; y++) {
+      memset(dst + y * dst_stride + x0 * bytes_per_pixel, 0, w * bytes_per_pixel);
+    }
+  }
+}
+
+
 void HeifPixelImage::transfer_plane_from_image_as(const std::shared_ptr<HeifPixelImage>& source,
                                                   heif_channel src_channel,
                                                   heif_channel dst_channel)
@@ -797,6 +1076,11 @@ void HeifPixelImage::transfer_plane_from_image_as(const std::shared_ptr<HeifPixe
   ImagePlane plane = source->m_planes[src_channel];
   source->m_planes.erase(src_channel);
 
+  // A plane of a view does not own its memory. Keep the image owning it alive.
+  if (source->m_view_source && !m_view_source) {
+    m_view_source = source->m_view_source;
+  }
+
   m_planes.insert(std::make_pair(dst_channel, plane));
 }
 
@@ -827,7 +1111,10 @@ bool is_interleaved_with_alpha(heif_chroma chroma)
 
 Error HeifPixelImage::copy_image_to(const std::shared_ptr<const HeifPixelImage>& source, uint32_t x0, uint32_t y0)
 {
+  DecodingStageTimer timer(&DecodingStatistics::tile_paste_time_us);
+
   std::set<enum heif_channel> channels = source->get_channel_set();
+  DecodingStatistics::add(&DecodingStatistics::num_planes_copied, channels.size());
 
   uint32_t w = get_width();
   uint32_t h = get_height();
@@ -875,8 +1162,67 @@ Error HeifPixelImage::copy_image_to(const std::shared_ptr<const HeifPixelImage>&
 }
 
 
+// A pixel of N bytes, for transformations that only move pixels around.
+template<size_t N>
+struct PixelBytes
+{
+  uint8_t bytes[N];
+};
+
+
+// Calls 'f' with a value of a type that has the size of one pixel (with all its interleaved components).
+// Returns false if there is no such type.
+template<typename F>
+static bool with_pixel_type(int pixel_size, F&& f)
+{
+  switch (pixel_size) {
+    case 1:
+      f(uint8_t{});
+      return true;
+    case 2:
+      f(uint16_t{});
+      return true;
+    case 3:
+      f(PixelBytes<3>{});
+      return true;
+    case 4:
+      f(uint32_t{});
+      return true;
+    case 6:
+      f(PixelBytes<6>{});
+      return true;
+    case 8:
+      f(uint64_t{});
+      return true;
+    case 12:
+      f(PixelBytes<12>{});
+      return true;
+    case 16:
+      f(heif_complex64{});
+      return true;
+    default:
+      return false;
+  }
+}
+
+
 Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_degrees, const heif_security_limits* limits)
 {
+  return rotate_ccw_and_mirror(angle_degrees, false, limits);
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw_and_mirror(int angle_degrees, bool mirror_horizontally,
+                                                                              const heif_security_limits* limits)
+{
+  if (angle_degrees == 0) {
+    if (mirror_horizontally) {
+      return mirror_inplace(heif_transform_mirror_direction_horizontal, limits);
+    }
+
+    return shared_from_this();
+  }
+
   // --- for some subsampled chroma colorspaces, we have to transform to 4:4:4 before rotation
 
   bool need_conversion = false;
@@ -888,6 +1234,9 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
     else if (angle_degrees == 180 && has_odd_height()) {
       need_conversion = true;
     }
+    else if (mirror_horizontally && has_odd_width()) {
+      need_conversion = true;
+    }
   }
   else if (get_chroma_format() == heif_chroma_420) {
     if (angle_degrees == 90 && has_odd_width()) {
@@ -899,6 +1248,9 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
     else if (angle_degrees == 270 && has_odd_height()) {
       need_conversion = true;
     }
+    else if (mirror_horizontally && (has_odd_width() || has_odd_height())) {
+      need_conversion = true;
+    }
   }
 
   if (need_conversion) {
@@ -910,16 +1262,12 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
       return converted_image_result.error;
     }
 
-    return (*converted_image_result)->rotate_ccw(angle_degrees, limits);
+    return (*converted_image_result)->rotate_ccw_and_mirror(angle_degrees, mirror_horizontally, limits);
   }
 
 
   // --- create output image
 
-  if (angle_degrees == 0) {
-    return shared_from_this();
-  }
-
   uint32_t out_width = m_width;
   uint32_t out_height = m_height;
 
@@ -937,14 +1285,6 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
     heif_channel channel = plane_pair.first;
     const ImagePlane &plane = plane_pair.second;
 
-    /*
-    if (plane.bit_depth != 8) {
-      return Error(heif_error_Unsupported_feature,
-                   heif_suberror_Unspecified,
-                   "Can currently only rotate images with 8 bits per pixel");
-    }
-    */
-
     uint32_t out_plane_width = plane.m_width;
     uint32_t out_plane_height = plane.m_height;
 
@@ -952,7 +1292,13 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
       std::swap(out_plane_width, out_plane_height);
     }
 
-    Error err = out_img->add_channel(channel, out_plane_width, out_plane_height, plane.m_datatype, plane.m_bit_depth, limits);
+    Error err;
+    if (plane.m_num_interleaved_components > 1) {
+      err = out_img->add_plane(channel, out_plane_width, out_plane_height, plane.m_bit_depth, limits);
+    }
+    else {
+      err = out_img->add_channel(channel, out_plane_width, out_plane_height, plane.m_datatype, plane.m_bit_depth, limits);
+    }
     if (err) {
       return err;
     }
@@ -961,20 +1307,14 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
     assert(out_plane_iter != out_img->m_planes.end());
     ImagePlane& out_plane = out_plane_iter->second;
 
-    if (plane.m_bit_depth <= 8) {
-      plane.rotate_ccw<uint8_t>(angle_degrees, out_plane);
-    }
-    else if (plane.m_bit_depth <= 16) {
-      plane.rotate_ccw<uint16_t>(angle_degrees, out_plane);
-    }
-    else if (plane.m_bit_depth <= 32) {
-      plane.rotate_ccw<uint32_t>(angle_degrees, out_plane);
-    }
-    else if (plane.m_bit_depth <= 64) {
-      plane.rotate_ccw<uint64_t>(angle_degrees, out_plane);
-    }
-    else if (plane.m_bit_depth <= 128) {
-      plane.rotate_ccw<heif_complex64>(angle_degrees, out_plane);
+    bool supported = with_pixel_type(plane.get_bytes_per_pixel() * plane.m_num_interleaved_components, [&](auto pixel) {
+      plane.rotate_ccw<decltype(pixel)>(angle_degrees, mirror_horizontally, out_plane);
+    });
+
+    if (!supported) {
+      return Error{heif_error_Unsupported_feature,
+                   heif_suberror_Unspecified,
+                   "Cannot rotate images with this pixel format"};
     }
   }
   // --- pass the color profiles to the new image
@@ -986,33 +1326,104 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::rotate_ccw(int angle_deg
 }
 
 template<typename T>
-void HeifPixelImage::ImagePlane::rotate_ccw(int angle_degrees,
+void HeifPixelImage::ImagePlane::rotate_ccw(int angle_degrees, bool mirror_horizontally,
                                             ImagePlane& out_plane) const
 {
+  // Pixels with 3 components may not be a divisor of the stride. Hence, all offsets are in bytes.
+
+  const ptrdiff_t pixel = sizeof(T);
   uint32_t w = m_width;
   uint32_t h = m_height;
 
-  uint32_t in_stride = stride / uint32_t(sizeof(T));
-  const T* in_data = static_cast<const T*>(mem);
+  auto* in_data = static_cast<const uint8_t*>(mem);
+  ptrdiff_t is = stride;
 
-  uint32_t out_stride = out_plane.stride / uint32_t(sizeof(T));
-  T* out_data = static_cast<T*>(out_plane.mem);
+  auto* out_data = static_cast<uint8_t*>(out_plane.mem);
+  size_t out_stride = out_plane.stride;
 
-  if (angle_degrees == 270) {
-    for (uint32_t x = 0; x < h; x++)
-      for (uint32_t y = 0; y < w; y++) {
-        out_data[y * out_stride + x] = in_data[(h - 1 - x) * in_stride + y];
-      }
-  } else if (angle_degrees == 180) {
-    for (uint32_t y = 0; y < h; y++)
-      for (uint32_t x = 0; x < w; x++) {
-        out_data[y * out_stride + x] = in_data[(h - 1 - y) * in_stride + (w - 1 - x)];
+  uint32_t out_w = out_plane.m_width;
+  uint32_t out_h = out_plane.m_height;
+
+  // The input pixel of output position (x,y) is at in_data[start + x * step_x + y * step_y].
+
+  ptrdiff_t start, step_x, step_y;
+
+  switch (angle_degrees) {
+    case 90:
+      start = (w - 1) * pixel;
+      step_x = is;
+      step_y = -pixel;
+      break;
+    case 180:
+      start = (h - 1) * is + (w - 1) * pixel;
+      step_x = -pixel;
+      step_y = -is;
+      break;
+    case 270:
+      start = (h - 1) * is;
+      step_x = -is;
+      step_y = pixel;
+      break;
+    default:
+      start = 0;
+      step_x = pixel;
+      step_y = is;
+      break;
+  }
+
+  if (mirror_horizontally) {
+    start += (out_w - 1) * step_x;
+    step_x = -step_x;
+  }
+
+  auto copy_rows = [&](uint32_t x0, uint32_t y0, uint32_t bw, uint32_t bh) {
+    for (uint32_t y = y0; y < y0 + bh; y++) {
+      const uint8_t* in = in_data + start + x0 * step_x + y * step_y;
+      T* out_row = reinterpret_cast<T*>(out_data + y * out_stride) + x0;
+
+      for (uint32_t x = 0; x < bw; x++) {
+        out_row[x] = *reinterpret_cast<const T*>(in + x * step_x);
       }
-  } else if (angle_degrees == 90) {
-    for (uint32_t x = 0; x < h; x++)
-      for (uint32_t y = 0; y < w; y++) {
-        out_data[y * out_stride + x] = in_data[x * in_stride + (w - 1 - y)];
+    }
+  };
+
+  if (angle_degrees != 90 && angle_degrees != 270) {
+    copy_rows(0, 0, out_w, out_h);
+    return;
+  }
+
+  // The rows of the output are columns of the input. Process the output in tiles, such that the
+  // input rows of a tile stay in the cache, and transpose blocks of the tile with SIMD when possible.
+
+  TransposeKernel kernel = get_transpose_kernel(sizeof(T));
+  const uint32_t block = kernel.transpose ? kernel.block_size : 16;
+  const uint32_t tile = std::max(block, uint32_t(64 / sizeof(T)) / block * block);
+
+  for (uint32_t ty = 0; ty < out_h; ty += tile) {
+    for (uint32_t tx = 0; tx < out_w; tx += tile) {
+      uint32_t ty_end = std::min(ty + tile, out_h);
+      uint32_t tx_end = std::min(tx + tile, out_w);
+
+      for (uint32_t by = ty; by < ty_end; by += block) {
+        for (uint32_t bx = tx; bx < tx_end; bx += block) {
+          uint32_t bw = std::min(block, tx_end - bx);
+          uint32_t bh = std::min(block, ty_end - by);
+
+          if (kernel.transpose && bw == block && bh == block) {
+            // step_y is one pixel forward or backward. The kernel reads the block rows left to right.
+            const uint8_t* in = in_data + start + bx * step_x + by * step_y;
+            const uint8_t* src = (step_y > 0) ? in : in - (block - 1) * pixel;
+            uint8_t* dst = out_data + (step_y > 0 ? by : by + block - 1) * out_stride + bx * pixel;
+            ptrdiff_t dst_stride = (step_y > 0) ? ptrdiff_t(out_stride) : -ptrdiff_t(out_stride);
+
+            kernel.transpose(src, step_x, dst, dst_stride);
+          }
+          else {
+            copy_rows(bx, by, bw, bh);
+          }
+        }
       }
+    }
   }
 }
 
@@ -1023,17 +1434,16 @@ void HeifPixelImage::ImagePlane::mirror_inplace(heif_transform_mirror_direction
   uint32_t w = m_width;
   uint32_t h = m_height;
 
-  T* data = static_cast<T*>(mem);
+  auto* data = static_cast<uint8_t*>(mem);
 
   if (direction == heif_transform_mirror_direction_horizontal) {
     for (uint32_t y = 0; y < h; y++) {
-      for (uint32_t x = 0; x < w / 2; x++)
-        std::swap(data[y * stride / sizeof(T) + x], data[y * stride / sizeof(T) + w - 1 - x]);
+      T* row = reinterpret_cast<T*>(data + y * stride);
+      std::reverse(row, row + w);
     }
   } else {
     for (uint32_t y = 0; y < h / 2; y++) {
-      for (uint32_t x = 0; x < w; x++)
-        std::swap(data[y * stride / sizeof(T) + x], data[(h - 1 - y) * stride / sizeof(T) + x]);
+      std::swap_ranges(data + y * stride, data + y * stride + w * sizeof(T), data + (h - 1 - y) * stride);
     }
   }
 }
@@ -1073,22 +1483,11 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::mirror_inplace(heif_tran
   for (auto& plane_pair : m_planes) {
     ImagePlane& plane = plane_pair.second;
 
-    if (plane.m_bit_depth <= 8) {
-      plane.mirror_inplace<uint8_t>(direction);
-    }
-    else if (plane.m_bit_depth <= 16) {
-      plane.mirror_inplace<uint16_t>(direction);
-    }
-    else if (plane.m_bit_depth <= 32) {
-      plane.mirror_inplace<uint32_t>(direction);
-    }
-    else if (plane.m_bit_depth <= 64) {
-      plane.mirror_inplace<uint64_t>(direction);
-    }
-    else if (plane.m_bit_depth <= 128) {
-      plane.mirror_inplace<heif_complex64>(direction);
-    }
-    else {
+    bool supported = with_pixel_type(plane.get_bytes_per_pixel() * plane.m_num_interleaved_components, [&](auto pixel) {
+      plane.mirror_inplace<decltype(pixel)>(direction);
+    });
+
+    if (!supported) {
       std::stringstream sstr;
       sstr << "Cannot mirror images with " << plane.m_bit_depth << " bits per pixel";
       return Error{heif_error_Unsupported_feature,
@@ -1162,16 +1561,26 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::crop(uint32_t left, uint
     const ImagePlane& plane = plane_pair.second;
 
     uint32_t plane_left = get_subsampled_size_h(left, channel, m_chroma, scaling_mode::is_divisible);
-    uint32_t plane_right = get_subsampled_size_h(right, channel, m_chroma, scaling_mode::round_up); // keep more chroma
+    uint32_t plane_right = get_subsampled_size_h(right, channel, m_chroma, scaling_mode::round_down); // chroma sample covering the last column
     uint32_t plane_top = get_subsampled_size_v(top, channel, m_chroma, scaling_mode::is_divisible); // is always divisible
-    uint32_t plane_bottom = get_subsampled_size_v(bottom, channel, m_chroma, scaling_mode::round_up); // keep more chroma
-
-    auto err = out_img->add_channel(channel,
-                                    plane_right - plane_left + 1,
-                                    plane_bottom - plane_top + 1,
-                                    plane.m_datatype,
-                                    plane.m_bit_depth,
-                                    limits);
+    uint32_t plane_bottom = get_subsampled_size_v(bottom, channel, m_chroma, scaling_mode::round_down); // chroma sample covering the last row
+
+    Error err;
+    if (plane.m_num_interleaved_components > 1) {
+      err = out_img->add_plane(channel,
+                               plane_right - plane_left + 1,
+                               plane_bottom - plane_top + 1,
+                               plane.m_bit_depth,
+                               limits);
+    }
+    else {
+      err = out_img->add_channel(channel,
+                                 plane_right - plane_left + 1,
+                                 plane_bottom - plane_top + 1,
+                                 plane.m_datatype,
+                                 plane.m_bit_depth,
+                                 limits);
+    }
     if (err) {
       return err;
     }
@@ -1180,7 +1589,7 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::crop(uint32_t left, uint
     assert(out_plane_iter != out_img->m_planes.end());
     ImagePlane& out_plane = out_plane_iter->second;
 
-    int bytes_per_pixel = plane.get_bytes_per_pixel();
+    int bytes_per_pixel = plane.get_bytes_per_pixel() * plane.m_num_interleaved_components;
     plane.crop(plane_left, plane_right, plane_top, plane_bottom, bytes_per_pixel, out_plane);
   }
 
@@ -1193,6 +1602,185 @@ Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::crop(uint32_t left, uint
 }
 
 
+bool HeifPixelImage::can_reference_window_at(uint32_t left, uint32_t top) const
+{
+  // --- the window has to start at a full chroma sample
+
+  if (get_chroma_format() == heif_chroma_422 && (left & 1) == 1) {
+    return false;
+  }
+  else if (get_chroma_format() == heif_chroma_420 &&
+           ((left & 1) == 1 || (top & 1) == 1)) {
+    return false;
+  }
+
+  // --- all planes have to start at the window without losing their alignment
+
+  uint32_t alignment = s_plane_alignment;
+
+  for (const auto& plane_pair : m_planes) {
+    const ImagePlane& plane = plane_pair.second;
+
+    uint32_t plane_left = get_subsampled_size_h(left, plane_pair.first, m_chroma, scaling_mode::is_divisible);
+    uint32_t bytes_per_pixel = plane.get_bytes_per_pixel() * plane.m_num_interleaved_components;
+
+    if ((plane_left * bytes_per_pixel) % alignment != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::crop_inplace(uint32_t left, uint32_t right, uint32_t top, uint32_t bottom,
+                                                                     const heif_security_limits* limits)
+{
+  if (left == 0 && top == 0 && right == m_width - 1 && bottom == m_height - 1) {
+    return shared_from_this();
+  }
+
+  if (!can_reference_window_at(left, top)) {
+    return crop(left, right, top, bottom, limits);
+  }
+
+
+  // --- narrow all planes to the crop window
+
+  for (auto& plane_pair : m_planes) {
+    heif_channel channel = plane_pair.first;
+    ImagePlane& plane = plane_pair.second;
+
+    uint32_t plane_left = get_subsampled_size_h(left, channel, m_chroma, scaling_mode::is_divisible);
+    uint32_t plane_right = get_subsampled_size_h(right, channel, m_chroma, scaling_mode::round_down); // chroma sample covering the last column
+    uint32_t plane_top = get_subsampled_size_v(top, channel, m_chroma, scaling_mode::is_divisible);
+    uint32_t plane_bottom = get_subsampled_size_v(bottom, channel, m_chroma, scaling_mode::round_down); // chroma sample covering the last row
+
+    uint32_t bytes_per_pixel = plane.get_bytes_per_pixel() * plane.m_num_interleaved_components;
+
+    // 'allocated_mem' is kept, such that the memory is still released as a whole.
+    plane.mem = static_cast<uint8_t*>(plane.mem) + static_cast<size_t>(plane_top) * plane.stride + plane_left * bytes_per_pixel;
+    plane.m_width = plane_right - plane_left + 1;
+    plane.m_height = plane_bottom - plane_top + 1;
+    plane.m_mem_width -= plane_left;
+    plane.m_mem_height -= plane_top;
+  }
+
+  m_width = right - left + 1;
+  m_height = bottom - top + 1;
+
+  return shared_from_this();
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::create_copy(const heif_security_limits* limits) const
+{
+  auto copy = std::make_shared<HeifPixelImage>();
+  copy->create(m_width, m_height, m_colorspace, m_chroma);
+
+  for (const auto& plane_pair : m_planes) {
+    const ImagePlane& plane = plane_pair.second;
+
+    ImagePlane new_plane;
+    if (Error err = new_plane.alloc(plane.m_width, plane.m_height, plane.m_datatype, plane.m_bit_depth,
+                                    plane.m_num_interleaved_components, limits)) {
+      return err;
+    }
+
+    size_t bytes_per_line = static_cast<size_t>(plane.m_width) * plane.get_bytes_per_pixel() * plane.m_num_interleaved_components;
+
+    for (uint32_t y = 0; y < plane.m_height; y++) {
+      memcpy(static_cast<uint8_t*>(new_plane.mem) + y * static_cast<size_t>(new_plane.stride),
+             static_cast<const uint8_t*>(plane.mem) + y * static_cast<size_t>(plane.stride),
+             bytes_per_line);
+    }
+
+    copy->m_planes.insert(std::make_pair(plane_pair.first, new_plane));
+  }
+
+  copy->forward_all_metadata_from(shared_from_this());
+  copy->m_sample_duration = m_sample_duration;
+  copy->m_decoding_scale_denominator = m_decoding_scale_denominator;
+  copy->m_decoding_fallback = m_decoding_fallback;
+  copy->m_gimi_sample_content_id = m_gimi_sample_content_id;
+  copy->add_warnings(m_warnings);
+
+  return copy;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> HeifPixelImage::create_view(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const
+{
+  if (w == 0 || h == 0 ||
+      x0 >= m_width || y0 >= m_height ||
+      w > m_width - x0 || h > m_height - y0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "View area is not inside the image"};
+  }
+
+  if (!can_reference_window_at(x0, y0)) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "View area does not start at an aligned position in all planes"};
+  }
+
+  auto view = std::make_shared<HeifPixelImage>();
+  view->create(w, h, m_colorspace, m_chroma);
+  view->forward_all_metadata_from(shared_from_this());
+
+  // A view of a view references the image that owns the memory.
+  view->m_view_source = m_view_source ? m_view_source : shared_from_this();
+
+  for (const auto& plane_pair : m_planes) {
+    heif_channel channel = plane_pair.first;
+    const ImagePlane& plane = plane_pair.second;
+
+    uint32_t plane_left = get_subsampled_size_h(x0, channel, m_chroma, scaling_mode::is_divisible);
+    uint32_t plane_right = get_subsampled_size_h(x0 + w - 1, channel, m_chroma, scaling_mode::round_down);
+    uint32_t plane_top = get_subsampled_size_v(y0, channel, m_chroma, scaling_mode::is_divisible);
+    uint32_t plane_bottom = get_subsampled_size_v(y0 + h - 1, channel, m_chroma, scaling_mode::round_down);
+
+    uint32_t bytes_per_pixel = plane.get_bytes_per_pixel() * plane.m_num_interleaved_components;
+
+    ImagePlane view_plane = plane;
+    view_plane.mem = static_cast<uint8_t*>(plane.mem) + static_cast<size_t>(plane_top) * plane.stride + plane_left * bytes_per_pixel;
+    view_plane.m_width = plane_right - plane_left + 1;
+    view_plane.m_height = plane_bottom - plane_top + 1;
+
+    // The memory around the view belongs to the source image. Limiting the memory size to the view
+    // makes extend_padding_to_size() allocate a separate plane instead of writing into the neighboring pixels.
+    view_plane.m_mem_width = view_plane.m_width;
+    view_plane.m_mem_height = view_plane.m_height;
+
+    // The memory is released by the source image.
+    view_plane.allocated_mem = nullptr;
+    view_plane.allocation_size = 0;
+
+    view->m_planes.insert(std::make_pair(channel, view_plane));
+  }
+
+  return view;
+}
+
+
+bool HeifPixelImage::owns_plane_memory() const
+{
+  if (is_view()) {
+    return false;
+  }
+
+  for (const auto& plane_pair : m_planes) {
+    // external and shared planes do not have allocated memory
+    if (plane_pair.second.allocated_mem == nullptr) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
 void HeifPixelImage::ImagePlane::crop(uint32_t left, uint32_t right, uint32_t top, uint32_t bottom,
                                       int bytes_per_pixel, ImagePlane& out_plane) const
 {
@@ -1227,19 +1815,14 @@ Error HeifPixelImage::fill_RGB_16bit(uint16_t r, uint16_t g, uint16_t b, uint16_
 
     }
 
-    ImagePlane& plane = plane_iter->second;
+    const ImagePlane& plane = plane_iter->second;
 
-    if (plane.m_bit_depth != 8) {
+    if (plane.m_bit_depth > 16) {
       return {heif_error_Unsupported_feature,
               heif_suberror_Unspecified,
-              "Can currently only fill images with 8 bits per pixel"};
+              "Can currently only fill images with up to 16 bits per pixel"};
     }
 
-    size_t h = plane.m_height;
-
-    size_t stride = plane.stride;
-    auto* data = static_cast<uint8_t*>(plane.mem);
-
     uint16_t val16;
     switch (channel) {
       case heif_channel_R:
@@ -1261,157 +1844,200 @@ Error HeifPixelImage::fill_RGB_16bit(uint16_t r, uint16_t g, uint16_t b, uint16_
         assert(false);
     }
 
-    auto val8 = static_cast<uint8_t>(val16 >> 8U);
-
+    // the 16-bit color value is reduced to the plane's bit depth by dropping the lower bits
+    fill_plane(channel, static_cast<uint16_t>(val16 >> (16 - plane.m_bit_depth)));
+  }
 
-    // memset() even when h * stride > sizeof(size_t)
+  return Error::Ok;
+}
 
-    if (std::numeric_limits<size_t>::max() / stride > h) {
-      // can fill in one step
-      memset(data, val8, stride * h);
-    }
-    else {
-      // fill line by line
-      auto* p = data;
 
-      for (size_t y=0;y<h;y++) {
-        memset(p, val8, stride);
-        p += stride;
-      }
-    }
+static uint32_t composite_row_simd(const uint8_t* in, const uint8_t* alpha, uint8_t* out, uint32_t width,
+                                   int alpha_bpp, uint32_t max_value, bool premultiplied)
+{
+  const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+  if (alpha_bpp == 8 && max_value == 255 && kernels.composite8) {
+    return kernels.composite8(in, alpha, out, width, premultiplied);
   }
 
-  return Error::Ok;
+  return 0;
 }
 
 
-uint32_t negate_negative_int32(int32_t x)
+static uint32_t composite_row_simd(const uint16_t* in, const uint16_t* alpha, uint16_t* out, uint32_t width,
+                                   int alpha_bpp, uint32_t max_value, bool premultiplied)
 {
-  assert(x <= 0);
-
-  if (x == INT32_MIN) {
-    return static_cast<uint32_t>(INT32_MAX) + 1;
-  }
-  else {
-    return static_cast<uint32_t>(-x);
+  const Alpha_row_kernels& kernels = get_alpha_row_kernels();
+  if (kernels.composite16) {
+    return kernels.composite16(in, alpha, out, width, alpha_bpp, static_cast<uint16_t>(max_value), premultiplied);
   }
+
+  return 0;
 }
 
 
-Error HeifPixelImage::overlay(std::shared_ptr<HeifPixelImage>& overlay, int32_t dx, int32_t dy)
+// There are no kernels for color and alpha with different sample sizes.
+template<typename T, typename A>
+static uint32_t composite_row_simd(const T*, const A*, T*, uint32_t, int, uint32_t, bool)
 {
-  std::set<enum heif_channel> channels = overlay->get_channel_set();
+  return 0;
+}
 
-  bool has_alpha = overlay->has_channel(heif_channel_Alpha);
-  //bool has_alpha_me = has_channel(heif_channel_Alpha);
 
-  size_t alpha_stride = 0;
-  uint8_t* alpha_p;
-  alpha_p = overlay->get_plane(heif_channel_Alpha, &alpha_stride);
+template<typename T, typename A>
+static void overlay_plane(T* out_p, size_t out_stride,
+                          const T* in_p, size_t in_stride,
+                          const A* alpha_p, size_t alpha_stride, int alpha_bpp, int bpp, bool premultiplied,
+                          uint32_t sub_h, uint32_t sub_v,
+                          uint32_t in_x0, uint32_t in_y0, uint32_t out_x0, uint32_t out_y0,
+                          uint32_t w, uint32_t h)
+{
+  auto max_value = static_cast<uint32_t>((1UL << bpp) - 1);
 
-  for (heif_channel channel : channels) {
-    if (!has_channel(channel)) {
+  for (uint32_t y = 0; y < h; y++) {
+    T* out_row = out_p + (out_y0 + y) * out_stride + out_x0;
+    const T* in_row = in_p + (in_y0 + y) * in_stride + in_x0;
+
+    if (!alpha_p) {
+      memcpy(out_row, in_row, w * sizeof(T));
       continue;
     }
 
-    size_t in_stride = 0;
-    const uint8_t* in_p;
+    // the alpha plane has full resolution, take the sample at the top-left pixel of subsampled chroma
+    const A* alpha_row = alpha_p + (in_y0 + y) * sub_v * alpha_stride + in_x0 * sub_h;
 
-    size_t out_stride = 0;
-    uint8_t* out_p;
+    // skip the fully transparent parts at both ends of the row
+    uint32_t x_start = 0;
+    uint32_t x_end = w;
+    while (x_start < x_end && alpha_row[x_start * sub_h] == 0) {
+      x_start++;
+    }
+    while (x_end > x_start && alpha_row[(x_end - 1) * sub_h] == 0) {
+      x_end--;
+    }
 
-    in_p = overlay->get_plane(channel, &in_stride);
-    out_p = get_plane(channel, &out_stride);
+    uint32_t x = x_start;
+    if (sub_h == 1 && x_end > x_start) {
+      x += composite_row_simd(in_row + x_start, alpha_row + x_start, out_row + x_start, x_end - x_start,
+                              alpha_bpp, max_value, premultiplied);
+    }
 
-    uint32_t in_w = overlay->get_width(channel);
-    uint32_t in_h = overlay->get_height(channel);
+    for (; x < x_end; x++) {
+      out_row[x] = static_cast<T>(flatten_sample(in_row[x], alpha_row[x * sub_h], out_row[x],
+                                                 alpha_bpp, max_value, premultiplied));
+    }
+  }
+}
 
-    uint32_t out_w = get_width(channel);
-    uint32_t out_h = get_height(channel);
 
-    // top-left points where to start copying in source and destination
-    uint32_t in_x0;
-    uint32_t in_y0;
-    uint32_t out_x0;
-    uint32_t out_y0;
+template<typename T>
+static void overlay_plane_with_alpha_type(T* out_p, size_t out_stride,
+                                          const T* in_p, size_t in_stride,
+                                          const HeifPixelImage& overlay, int bpp,
+                                          uint32_t sub_h, uint32_t sub_v,
+                                          uint32_t in_x0, uint32_t in_y0, uint32_t out_x0, uint32_t out_y0,
+                                          uint32_t w, uint32_t h)
+{
+  if (!overlay.has_channel(heif_channel_Alpha)) {
+    overlay_plane<T, uint8_t>(out_p, out_stride, in_p, in_stride, nullptr, 0, 0, bpp, false,
+                              sub_h, sub_v, in_x0, in_y0, out_x0, out_y0, w, h);
+    return;
+  }
 
-    if (dx > 0 && static_cast<uint32_t>(dx) >= out_w) {
-      // the overlay image is completely outside the right border -> skip overlaying
-      return Error::Ok;
-    }
-    else if (dx < 0 && in_w <= negate_negative_int32(dx)) {
-      // the overlay image is completely outside the left border -> skip overlaying
-      return Error::Ok;
-    }
+  int alpha_bpp = overlay.get_bits_per_pixel(heif_channel_Alpha);
+  bool premultiplied = overlay.is_premultiplied_alpha();
+  size_t alpha_stride = 0;
 
-    if (dx < 0) {
-      // overlay image started partially outside of left border
+  if (alpha_bpp <= 8) {
+    const auto* alpha_p = overlay.get_channel<uint8_t>(heif_channel_Alpha, &alpha_stride);
+    overlay_plane(out_p, out_stride, in_p, in_stride, alpha_p, alpha_stride, alpha_bpp, bpp, premultiplied,
+                  sub_h, sub_v, in_x0, in_y0, out_x0, out_y0, w, h);
+  }
+  else {
+    const auto* alpha_p = overlay.get_channel<uint16_t>(heif_channel_Alpha, &alpha_stride);
+    overlay_plane(out_p, out_stride, in_p, in_stride, alpha_p, alpha_stride, alpha_bpp, bpp, premultiplied,
+                  sub_h, sub_v, in_x0, in_y0, out_x0, out_y0, w, h);
+  }
+}
 
-      in_x0 = negate_negative_int32(dx);
-      out_x0 = 0;
-      in_w = in_w - in_x0; // in_x0 < in_w because in_w > -dx = in_x0
-    }
-    else {
-      in_x0 = 0;
-      out_x0 = static_cast<uint32_t>(dx);
-    }
 
-    // we know that dx >= 0 && dx < out_w
+// Clips the overlay plane of size 'in_size', placed at 'offset', against the canvas plane of size 'out_size'.
+// Returns false if nothing remains visible.
+static bool clip_overlay_range(int64_t offset, uint32_t in_size, uint32_t out_size,
+                               uint32_t* in_start, uint32_t* out_start, uint32_t* size)
+{
+  int64_t start = std::max<int64_t>(0, -offset);
+  int64_t end = std::min<int64_t>(in_size, int64_t{out_size} - offset);
+  if (end <= start) {
+    return false;
+  }
 
-    if (static_cast<uint32_t>(dx) > UINT32_MAX - in_w ||
-        dx + in_w > out_w) {
-      // overlay image extends partially outside of right border
+  *in_start = static_cast<uint32_t>(start);
+  *out_start = static_cast<uint32_t>(start + offset);
+  *size = static_cast<uint32_t>(end - start);
+  return true;
+}
 
-      in_w = out_w - static_cast<uint32_t>(dx); // we know that dx < out_w from first condition
-    }
 
+static int64_t floor_div(int64_t a, int64_t b)
+{
+  int64_t q = a / b;
+  return (a % b != 0 && a < 0) ? q - 1 : q;
+}
 
-    if (dy > 0 && static_cast<uint32_t>(dy) >= out_h) {
-      // the overlay image is completely outside the bottom border -> skip overlaying
-      return Error::Ok;
-    }
-    else if (dy < 0 && in_h <= negate_negative_int32(dy)) {
-      // the overlay image is completely outside the top border -> skip overlaying
-      return Error::Ok;
-    }
 
-    if (dy < 0) {
-      // overlay image started partially outside of top border
+Error HeifPixelImage::overlay(std::shared_ptr<HeifPixelImage>& overlay, int32_t dx, int32_t dy)
+{
+  if (num_interleaved_pixels_per_plane(m_chroma) != 1 ||
+      num_interleaved_pixels_per_plane(overlay->get_chroma_format()) != 1) {
+    return {heif_error_Unsupported_feature,
+            heif_suberror_Unspecified,
+            "Overlaying is only supported for images with planar channels"};
+  }
 
-      in_y0 = negate_negative_int32(dy);
-      out_y0 = 0;
-      in_h = in_h - in_y0; // in_y0 < in_h because in_h > -dy = in_y0
-    }
-    else {
-      in_y0 = 0;
-      out_y0 = static_cast<uint32_t>(dy);
+  std::set<enum heif_channel> channels = overlay->get_channel_set();
+
+  for (heif_channel channel : channels) {
+    if (!has_channel(channel)) {
+      continue;
     }
 
-    // we know that dy >= 0 && dy < out_h
+    int bpp = get_bits_per_pixel(channel);
+    if (overlay->get_bits_per_pixel(channel) != bpp) {
+      return {heif_error_Unsupported_feature,
+              heif_suberror_Unspecified,
+              "Overlay image has a different bit depth than the canvas"};
+    }
 
-    if (static_cast<uint32_t>(dy) > UINT32_MAX - in_h ||
-        dy + in_h > out_h) {
-      // overlay image extends partially outside of bottom border
+    // Chroma planes are placed at the subsampled offset (rounded down for unaligned offsets).
 
-      in_h = out_h - static_cast<uint32_t>(dy); // we know that dy < out_h from first condition
+    uint32_t sub_h = 1, sub_v = 1;
+    if (channel == heif_channel_Cb || channel == heif_channel_Cr) {
+      sub_h = chroma_h_subsampling(overlay->get_chroma_format());
+      sub_v = chroma_v_subsampling(overlay->get_chroma_format());
     }
 
+    uint32_t in_x0, in_y0, out_x0, out_y0, w, h;
+    if (!clip_overlay_range(floor_div(dx, sub_h), overlay->get_width(channel), get_width(channel), &in_x0, &out_x0, &w) ||
+        !clip_overlay_range(floor_div(dy, sub_v), overlay->get_height(channel), get_height(channel), &in_y0, &out_y0, &h)) {
+      // the overlay image is completely outside of the canvas -> skip overlaying
+      continue;
+    }
 
-    for (uint32_t y = in_y0; y < in_h; y++) {
-      if (!has_alpha) {
-        memcpy(out_p + out_x0 + (out_y0 + y - in_y0) * out_stride,
-               in_p + in_x0 + y * in_stride,
-               in_w - in_x0);
-      }
-      else {
-        for (uint32_t x = in_x0; x < in_w; x++) {
-          uint8_t* outptr = &out_p[out_x0 + (out_y0 + y - in_y0) * out_stride + x];
-          uint8_t in_val = in_p[in_x0 + y * in_stride + x];
-          uint8_t alpha_val = alpha_p[in_x0 + y * in_stride + x];
+    size_t in_stride = 0;
+    size_t out_stride = 0;
 
-          *outptr = (uint8_t) ((in_val * alpha_val + *outptr * (255 - alpha_val)) / 255);
-        }
-      }
+    if (bpp <= 8) {
+      const auto* in_p = overlay->get_channel<uint8_t>(channel, &in_stride);
+      auto* out_p = get_channel<uint8_t>(channel, &out_stride);
+      overlay_plane_with_alpha_type(out_p, out_stride, in_p, in_stride, *overlay, bpp,
+                                    sub_h, sub_v, in_x0, in_y0, out_x0, out_y0, w, h);
+    }
+    else {
+      const auto* in_p = overlay->get_channel<uint16_t>(channel, &in_stride);
+      auto* out_p = get_channel<uint16_t>(channel, &out_stride);
+      overlay_plane_with_alpha_type(out_p, out_stride, in_p, in_stride, *overlay, bpp,
+                                    sub_h, sub_v, in_x0, in_y0, out_x0, out_y0, w, h);
     }
   }
 
@@ -1550,6 +2176,70 @@ Error HeifPixelImage::scale_nearest_neighbor(std::shared_ptr<HeifPixelImage>& ou
 }
 
 
+Error HeifPixelImage::paste_scaled_nearest_neighbor_to(const std::shared_ptr<HeifPixelImage>& out, uint32_t x0, uint32_t y0,
+                                                       uint32_t full_width, uint32_t full_height) const
+{
+  const uint64_t out_width = out->get_width();
+  const uint64_t out_height = out->get_height();
+  const heif_chroma chroma = out->get_chroma_format();
+
+  for (const auto& plane_pair : m_planes) {
+    heif_channel channel = plane_pair.first;
+    const ImagePlane& plane = plane_pair.second;
+
+    if (!out->has_channel(channel)) {
+      return {heif_error_Invalid_input, heif_suberror_Unspecified, "scaling input has extra color plane"};
+    }
+
+    if (out->get_bits_per_pixel(channel) != get_bits_per_pixel(channel)) {
+      return {heif_error_Invalid_input, heif_suberror_Wrong_tile_image_pixel_depth};
+    }
+
+    // Sample positions are computed like in scale_nearest_neighbor(), with the luma scaling factor for all channels.
+
+    const uint64_t xs = channel_width(x0, chroma, channel);
+    const uint64_t ys = channel_height(y0, chroma, channel);
+    const uint64_t xe = xs + get_width(channel);
+    const uint64_t ye = ys + get_height(channel);
+
+    const uint32_t out_w = out->get_width(channel);
+    const uint32_t out_h = out->get_height(channel);
+
+    const uint32_t bytes_per_pixel = get_storage_bits_per_pixel(channel) / 8;
+
+    size_t out_stride = 0;
+    uint8_t* out_data = out->get_plane(channel, &out_stride);
+
+    const auto* in_data = static_cast<const uint8_t*>(plane.mem);
+
+    // first output position that maps into this image
+    uint64_t ox_start = (xs * out_width + full_width - 1) / full_width;
+    uint64_t oy_start = (ys * out_height + full_height - 1) / full_height;
+
+    for (uint64_t oy = oy_start; oy < out_h; oy++) {
+      uint64_t iy = oy * full_height / out_height;
+      if (iy >= ye) {
+        break;
+      }
+
+      const uint8_t* in_row = in_data + (iy - ys) * plane.stride;
+      uint8_t* out_row = out_data + oy * out_stride;
+
+      for (uint64_t ox = ox_start; ox < out_w; ox++) {
+        uint64_t ix = ox * full_width / out_width;
+        if (ix >= xe) {
+          break;
+        }
+
+        memcpy(out_row + ox * bytes_per_pixel, in_row + (ix - xs) * bytes_per_pixel, bytes_per_pixel);
+      }
+    }
+  }
+
+  return Error::Ok;
+}
+
+
 void HeifPixelImage::forward_all_metadata_from(const std::shared_ptr<const HeifPixelImage>& src_image)
 {
   set_color_profile_nclx(src_image->get_color_profile_nclx());
@@ -1619,6 +2309,13 @@ Error HeifPixelImage::create_clone_image_at_new_size(const std::shared_ptr<const
       }
       break;
     case heif_colorspace_RGB:
+      if (source->has_channel(heif_channel_interleaved)) {
+        if (auto err = add_plane(heif_channel_interleaved, w, h, source->get_bits_per_pixel(heif_channel_interleaved), limits)) {
+          return err;
+        }
+        break;
+      }
+
       if (auto err = add_plane(heif_channel_R, w, h, source->get_bits_per_pixel(heif_channel_R), limits)) {
         return err;
       }
@@ -1634,7 +2331,7 @@ Error HeifPixelImage::create_clone_image_at_new_size(const std::shared_ptr<const
       break;
   }
 
-  if (source->has_alpha()) {
+  if (source->has_channel(heif_channel_Alpha)) {
       if (auto err = add_plane(heif_channel_Alpha, w, h, source->get_bits_per_pixel(heif_channel_Alpha), limits)) {
         return err;
       }
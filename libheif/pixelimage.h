@@ -90,6 +90,13 @@ public:
   Error add_channel(heif_channel channel, uint32_t width, uint32_t height, heif_channel_datatype datatype, int bit_depth,
                     const heif_security_limits* limits);
 
+  // Adds a plane that uses memory of the caller without copying it.
+  // The memory has to stay valid while 'memory_owner' is held. It is released together with the last
+  // image referencing the plane (e.g. this image or views of it). 'memory_owner' may be NULL when the
+  // caller keeps the memory alive otherwise.
+  Error add_external_plane(heif_channel channel, uint32_t width, uint32_t height, int bit_depth,
+                           uint8_t* data, size_t stride, std::shared_ptr<void> memory_owner);
+
   bool has_channel(heif_channel channel) const;
 
   // Has alpha information either as a separate channel or in the interleaved format.
@@ -113,6 +120,10 @@ public:
 
   heif_chroma get_chroma_format() const { return m_chroma; }
 
+  // Changes the chroma format without touching the planes. Only for conversions that modify the image in place
+  // and keep the memory layout, like swapping the byte order of interleaved samples.
+  void set_chroma_format(heif_chroma chroma) { m_chroma = chroma; }
+
   heif_colorspace get_colorspace() const { return m_colorspace; }
 
   std::set<enum heif_channel> get_channel_set() const;
@@ -166,10 +177,32 @@ public:
                             heif_channel dst_channel,
                             const heif_security_limits* limits);
 
+  // Adds 'dst_channel' as a reference to the memory of 'src_channel' without copying it.
+  // The plane keeps 'src_image' alive. Since writing into the plane changes 'src_image' and vice versa,
+  // this is only for planes that are not modified anymore, like the unchanged planes passed through a color conversion Op.
+  Error share_plane_from(const std::shared_ptr<const HeifPixelImage>& src_image,
+                         heif_channel src_channel,
+                         heif_channel dst_channel);
+
+  // Adds 'dst_channel' with the full size of this image and fills it from 'src_channel' in one pass.
+  // The source plane is scaled with nearest-neighbor sampling to 'full_width' x 'full_height' and the area
+  // starting at (x0;y0) is copied. The samples are rescaled to 'dst_bit_depth'.
+  // Without scaling or bit depth change, this is a plain copy.
+  Error copy_new_plane_scaled_from(const std::shared_ptr<const HeifPixelImage>& src_image,
+                                   heif_channel src_channel,
+                                   heif_channel dst_channel,
+                                   int dst_bit_depth,
+                                   uint32_t full_width, uint32_t full_height,
+                                   uint32_t x0, uint32_t y0,
+                                   const heif_security_limits* limits);
+
   Error extract_alpha_from_RGBA(const std::shared_ptr<const HeifPixelImage>& srcimage, const heif_security_limits* limits);
 
   void fill_plane(heif_channel dst_channel, uint16_t value);
 
+  // Fills the area (x0,y0,w,h) of the plane. The area is given in luma samples and is scaled for subsampled chroma planes.
+  void fill_plane_region(heif_channel dst_channel, uint16_t value, uint32_t x0, uint32_t y0, uint32_t w, uint32_t h);
+
   Error fill_new_plane(heif_channel dst_channel, uint16_t value, int width, int height, int bpp, const heif_security_limits* limits);
 
   void transfer_plane_from_image_as(const std::shared_ptr<HeifPixelImage>& source,
@@ -180,11 +213,39 @@ public:
 
   Result<std::shared_ptr<HeifPixelImage>> rotate_ccw(int angle_degrees, const heif_security_limits* limits);
 
+  // Rotates the image and then mirrors it horizontally in a single pass.
+  Result<std::shared_ptr<HeifPixelImage>> rotate_ccw_and_mirror(int angle_degrees, bool mirror_horizontally,
+                                                                const heif_security_limits* limits);
+
   Result<std::shared_ptr<HeifPixelImage>> mirror_inplace(heif_transform_mirror_direction, const heif_security_limits* limits);
 
   Result<std::shared_ptr<HeifPixelImage>> crop(uint32_t left, uint32_t right, uint32_t top, uint32_t bottom,
                                                const heif_security_limits* limits) const;
 
+  // Crops the image without copying the pixel data: the planes are narrowed to a window of their
+  // existing memory, with the same stride.
+  // When this is not possible (the crop window is not aligned to the chroma subsampling or to the
+  // plane alignment), a cropped copy is returned instead.
+  Result<std::shared_ptr<HeifPixelImage>> crop_inplace(uint32_t left, uint32_t right, uint32_t top, uint32_t bottom,
+                                                       const heif_security_limits* limits);
+
+  // Returns an image that references the area (x0,y0,w,h) of this image's planes without copying them.
+  // The view keeps this image alive and writing into the view changes this image.
+  // The area has to lie inside the image and has to start at a position at which all planes
+  // keep their chroma subsampling and plane alignment (see can_reference_window_at()).
+  Result<std::shared_ptr<HeifPixelImage>> create_view(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h) const;
+
+  bool is_view() const { return m_view_source != nullptr; }
+
+  // Whether all plane memory has been allocated by this image. Otherwise, it may be shared with a caller or another image.
+  bool owns_plane_memory() const;
+
+  // Returns a copy of the image with its own plane memory, including the metadata and warnings.
+  Result<std::shared_ptr<HeifPixelImage>> create_copy(const heif_security_limits* limits) const;
+
+  // Whether the planes can be narrowed to a window starting at (left,top) without copying.
+  bool can_reference_window_at(uint32_t left, uint32_t top) const;
+
   Error fill_RGB_16bit(uint16_t r, uint16_t g, uint16_t b, uint16_t a);
 
   Error overlay(std::shared_ptr<HeifPixelImage>& overlay, int32_t dx, int32_t dy);
@@ -192,6 +253,12 @@ public:
   Error scale_nearest_neighbor(std::shared_ptr<HeifPixelImage>& output, uint32_t width, uint32_t height,
                                const heif_security_limits* limits) const;
 
+  // Copies the samples of this image into 'out', which is the scaled version (as with scale_nearest_neighbor())
+  // of a full image of size full_width x full_height in which this image is placed at (x0,y0).
+  // This gives the same result as assembling the full image and scaling it afterwards.
+  Error paste_scaled_nearest_neighbor_to(const std::shared_ptr<HeifPixelImage>& out, uint32_t x0, uint32_t y0,
+                                         uint32_t full_width, uint32_t full_height) const;
+
   void set_color_profile_nclx(const std::shared_ptr<const color_profile_nclx>& profile) { m_color_profile_nclx = profile; }
 
   const std::shared_ptr<const color_profile_nclx>& get_color_profile_nclx() const { return m_color_profile_nclx; }
@@ -252,15 +319,16 @@ public:
   void unset_mdcv() { m_mdcv_set = false; }
 
   Error set_tai_timestamp(const heif_tai_timestamp_packet* tai) {
-    delete m_tai_timestamp;
+    heif_tai_timestamp_packet packet{};
+    packet.version = 1;
+    heif_tai_timestamp_packet_copy(&packet, tai);
 
-    m_tai_timestamp = heif_tai_timestamp_packet_alloc();
-    heif_tai_timestamp_packet_copy(m_tai_timestamp, tai);
+    m_tai_timestamp = packet;
     return Error::Ok;
   }
 
   const heif_tai_timestamp_packet* get_tai_timestamp() const {
-    return m_tai_timestamp;
+    return m_tai_timestamp ? &*m_tai_timestamp : nullptr;
   }
 
 #if HEIF_ENABLE_EXPERIMENTAL_FEATURES
@@ -277,6 +345,18 @@ public:
 
   uint32_t get_sample_duration() const { return m_sample_duration; }
 
+  // --- reduced-resolution decoding
+
+  // The factor by which the decoder reduced the coded image size (see heif_decoding_options.target_scale_denominator).
+  void set_decoding_scale_denominator(uint8_t d) { m_decoding_scale_denominator = d; }
+
+  uint8_t get_decoding_scale_denominator() const { return m_decoding_scale_denominator; }
+
+  // The cheaper representation that was decoded to meet heif_decoding_options.deadline_us.
+  void set_decoding_fallback(heif_decoding_fallback f) { m_decoding_fallback = f; }
+
+  heif_decoding_fallback get_decoding_fallback() const { return m_decoding_fallback; }
+
   // --- warnings
 
   void add_warning(Error warning) { m_warnings.emplace_back(std::move(warning)); }
@@ -285,6 +365,13 @@ public:
 
   const std::vector<Error>& get_warnings() const { return m_warnings; }
 
+  // --- memory layout
+
+  // Alignment of the plane start and the row stride of all planes allocated from now on.
+  static Error set_plane_alignment(int alignment);
+
+  static int get_plane_alignment();
+
 private:
   struct ImagePlane
   {
@@ -292,6 +379,9 @@ private:
     Error alloc(uint32_t width, uint32_t height, heif_channel_datatype datatype, int bit_depth, int num_interleaved_components,
                 const heif_security_limits* limits);
 
+    // Returns the memory to the PlaneBufferPool.
+    void release_memory();
+
     heif_channel_datatype m_datatype = heif_channel_datatype_unsigned_integer;
     uint8_t m_bit_depth = 0;
     uint8_t m_num_interleaved_components = 1;
@@ -306,7 +396,9 @@ private:
 
     void* mem = nullptr; // aligned memory start
     uint8_t* allocated_mem = nullptr; // unaligned memory we allocated
+    std::shared_ptr<const void> external_memory; // keeps memory passed in by the caller, or the image of a shared plane, alive
     size_t   allocation_size = 0;
+    uint32_t allocation_flags = 0; // heif_plane_allocation_flags of 'allocated_mem'
     uint32_t stride = 0; // bytes per line
 
     int get_bytes_per_pixel() const;
@@ -314,7 +406,7 @@ private:
     template <typename T> void mirror_inplace(heif_transform_mirror_direction);
 
     template<typename T>
-    void rotate_ccw(int angle_degrees, ImagePlane& out_plane) const;
+    void rotate_ccw(int angle_degrees, bool mirror_horizontally, ImagePlane& out_plane) const;
 
     void crop(uint32_t left, uint32_t right, uint32_t top, uint32_t bottom, int bytes_per_pixel, ImagePlane& out_plane) const;
   };
@@ -329,6 +421,9 @@ private:
 
   std::map<heif_channel, ImagePlane> m_planes;
 
+  // When this image is a view (see create_view()), the image that owns the plane memory.
+  std::shared_ptr<const HeifPixelImage> m_view_source;
+
   uint32_t m_PixelAspectRatio_h = 1;
   uint32_t m_PixelAspectRatio_v = 1;
   heif_content_light_level m_clli{};
@@ -337,7 +432,10 @@ private:
 
   uint32_t m_sample_duration = 0; // duration of a sequence frame
 
-  heif_tai_timestamp_packet* m_tai_timestamp = nullptr;
+  uint8_t m_decoding_scale_denominator = 1;
+  heif_decoding_fallback m_decoding_fallback = heif_decoding_fallback_none;
+
+  std::optional<heif_tai_timestamp_packet> m_tai_timestamp;
 
   std::optional<std::string> m_gimi_sample_content_id;
 
@@ -0,0 +1,250 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "plane_buffer_pool.h"
+
+#include "libheif/heif.h"
+
+#if __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+
+PlaneBufferPool::~PlaneBufferPool()
+{
+  clear();
+}
+
+
+PlaneBufferPool& PlaneBufferPool::global()
+{
+  static PlaneBufferPool pool;
+  return pool;
+}
+
+
+void PlaneBufferPool::set_max_cached_bytes(size_t max_bytes)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  m_max_cached_bytes = max_bytes;
+  evict(max_bytes);
+}
+
+
+size_t PlaneBufferPool::get_max_cached_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_max_cached_bytes;
+}
+
+
+size_t PlaneBufferPool::get_cached_bytes() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  return m_cached_bytes;
+}
+
+
+uint8_t* PlaneBufferPool::acquire(size_t size, uint32_t allocation_flags)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  // Search from the back; the most recently released buffers are most likely still in the cache.
+
+  for (auto iter = m_buffers.rbegin(); iter != m_buffers.rend(); ++iter) {
+    if (iter->size == size && iter->allocation_flags == allocation_flags) {
+      uint8_t* mem = iter->mem;
+      m_buffers.erase(std::next(iter).base());
+      m_cached_bytes -= size;
+      return mem;
+    }
+  }
+
+  return nullptr;
+}
+
+
+void PlaneBufferPool::release(uint8_t* buffer, size_t size, uint32_t allocation_flags)
+{
+  if (buffer == nullptr) {
+    return;
+  }
+
+  {
+#if ENABLE_MULTITHREADING_SUPPORT
+    std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+    if (size <= m_max_cached_bytes) {
+      evict(m_max_cached_bytes - size);
+
+      m_buffers.push_back({buffer, size, allocation_flags});
+      m_cached_bytes += size;
+      return;
+    }
+  }
+
+  free_buffer(buffer, size, allocation_flags);
+}
+
+
+void PlaneBufferPool::clear()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_mutex);
+#endif
+
+  evict(0);
+}
+
+
+void PlaneBufferPool::evict(size_t max_bytes)
+{
+  // m_mutex must be locked
+
+  while (m_cached_bytes > max_bytes) {
+    const Buffer& buffer = m_buffers.front();
+    free_buffer(buffer.mem, buffer.size, buffer.allocation_flags);
+    m_cached_bytes -= buffer.size;
+    m_buffers.pop_front();
+  }
+}
+
+
+#if __linux__
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+// Sets the memory policy of the (not yet faulted in) pages to the NUMA node of the calling thread.
+// This is done with the system calls directly to avoid a dependency on libnuma.
+static void bind_to_local_numa_node(uint8_t* mem, size_t size)
+{
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+  unsigned int cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= 8 * sizeof(unsigned long)) {
+    return;
+  }
+
+  unsigned long nodemask = 1UL << node;
+
+  // best effort; the pages are placed by the default policy if this fails
+  (void) syscall(SYS_mbind, mem, size, MPOL_PREFERRED, &nodemask, node + 2, 0);
+#else
+  (void) mem;
+  (void) size;
+#endif
+}
+#endif
+
+
+Result<uint8_t*> PlaneBufferPool::allocate_buffer(size_t size, uint32_t allocation_flags)
+{
+  uint8_t* mem = nullptr;
+
+#if __linux__
+  bool use_huge_pages = (allocation_flags & heif_plane_allocation_huge_pages) && size > huge_page_size;
+
+  if (use_huge_pages || (allocation_flags & heif_plane_allocation_numa_local)) {
+    // madvise() and mbind() work on whole pages
+    size_t alignment = use_huge_pages ? huge_page_size : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    void* p = nullptr;
+    if (posix_memalign(&p, alignment, size) == 0) {
+      mem = static_cast<uint8_t*>(p);
+    }
+  }
+  else {
+    mem = static_cast<uint8_t*>(malloc(size));
+  }
+#else
+  mem = static_cast<uint8_t*>(malloc(size));
+#endif
+
+  if (mem == nullptr) {
+    std::stringstream sstr;
+    sstr << "Allocating " << size << " bytes failed";
+
+    return Error{heif_error_Memory_allocation_error,
+                 heif_suberror_Unspecified,
+                 sstr.str()};
+  }
+
+#if __linux__
+  if (use_huge_pages) {
+    // only a hint, the kernel may not support transparent huge pages
+    (void) madvise(mem, size, MADV_HUGEPAGE);
+  }
+
+  if (allocation_flags & heif_plane_allocation_numa_local) {
+    bind_to_local_numa_node(mem, size);
+  }
+
+  if (allocation_flags & heif_plane_allocation_lock_memory) {
+    // --- lock memory (allocate physical memory to fail fast if not enough physical memory is available)
+
+    if (mlock(mem, size) != 0) {
+      std::stringstream sstr;
+      sstr << "Cannot lock " << size << " bytes of memory, OS error: " << strerror(errno);
+
+      free(mem);
+
+      return Error{heif_error_Memory_allocation_error,
+                   heif_suberror_Unspecified,
+                   sstr.str()};
+    }
+  }
+#endif
+
+  return mem;
+}
+
+
+void PlaneBufferPool::free_buffer(uint8_t* buffer, size_t size, uint32_t allocation_flags)
+{
+#if __linux__
+  if (allocation_flags & heif_plane_allocation_lock_memory) {
+    munlock(buffer, size);
+  }
+#else
+  (void) size;
+  (void) allocation_flags;
+#endif
+
+  free(buffer);
+}
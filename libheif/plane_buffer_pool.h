@@ -0,0 +1,94 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_PLANE_BUFFER_POOL_H
+#define LIBHEIF_PLANE_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include "error.h"
+
+#if ENABLE_MULTITHREADING_SUPPORT
+#include <mutex>
+#endif
+
+
+// Keeps the memory of released image planes for reuse by planes of the same allocation size.
+// When decoding sequences or many tiles of the same size, this saves the allocation and the
+// free-memory check of HeifPixelImage::ImagePlane::alloc() for each image.
+//
+// The pool is shared by all HeifContexts. It is disabled (max. size 0) by default.
+class PlaneBufferPool
+{
+public:
+  PlaneBufferPool() = default;
+
+  ~PlaneBufferPool();
+
+  PlaneBufferPool(const PlaneBufferPool&) = delete;
+
+  PlaneBufferPool& operator=(const PlaneBufferPool&) = delete;
+
+  static PlaneBufferPool& global();
+
+  // Maximum number of bytes held by unused buffers. Setting this to 0 disables the pool.
+  void set_max_cached_bytes(size_t max_bytes);
+
+  size_t get_max_cached_bytes() const;
+
+  size_t get_cached_bytes() const;
+
+  // Returns an unused buffer of exactly 'size' bytes that was allocated with the same heif_plane_allocation_flags,
+  // or NULL if there is none.
+  uint8_t* acquire(size_t size, uint32_t allocation_flags);
+
+  // Keeps the buffer for reuse. When this would exceed the maximum pool size, the oldest buffers are freed.
+  void release(uint8_t* buffer, size_t size, uint32_t allocation_flags);
+
+  // Frees all unused buffers.
+  void clear();
+
+  // Allocates plane memory as specified by the heif_plane_allocation_flags.
+  static Result<uint8_t*> allocate_buffer(size_t size, uint32_t allocation_flags);
+
+  // Frees plane memory that was allocated by allocate_buffer().
+  static void free_buffer(uint8_t* buffer, size_t size, uint32_t allocation_flags);
+
+private:
+  struct Buffer
+  {
+    uint8_t* mem;
+    size_t size;
+    uint32_t allocation_flags;
+  };
+
+  void evict(size_t max_bytes);
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  mutable std::mutex m_mutex;
+#endif
+
+  std::deque<Buffer> m_buffers; // oldest first
+  size_t m_cached_bytes = 0;
+  size_t m_max_cached_bytes = 0;
+};
+
+#endif //LIBHEIF_PLANE_BUFFER_POOL_H
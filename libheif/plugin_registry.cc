@@ -21,6 +21,7 @@
 #include <utility>
 #include <cstring>
 #include <algorithm>
+#include <map>
 
 #include "plugin_registry.h"
 #include "init.h"
@@ -105,14 +106,34 @@
 #include "plugins/encoder_openjph.h"
 #endif
 
+#if HAVE_OPENJPH_DECODER
+#include "plugins/decoder_openjph.h"
+#endif
+
 std::set<const struct heif_decoder_plugin*> s_decoder_plugins;
 
 std::multiset<std::unique_ptr<struct heif_encoder_descriptor>,
               encoder_descriptor_priority_order> s_encoder_descriptors;
 
+// Plugin selections of get_decoder() / get_encoder(). These are cleared whenever a plugin is (un)registered.
+// The decoder key is (format, name_id), with an empty name for the default decoder.
+static std::map<std::pair<heif_compression_format, std::string>, const struct heif_decoder_plugin*> s_decoder_cache;
+static std::map<heif_compression_format, const struct heif_encoder_plugin*> s_encoder_cache;
+
+static void clear_plugin_caches()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::recursive_mutex> lock(heif_init_mutex());
+#endif
+
+  s_decoder_cache.clear();
+  s_encoder_cache.clear();
+}
+
 std::set<const struct heif_decoder_plugin*>& get_decoder_plugins()
 {
   load_plugins_if_not_initialized_yet();
+  load_deferred_plugins(heif_plugin_type_decoder, heif_compression_undefined);
 
   return s_decoder_plugins;
 }
@@ -121,6 +142,7 @@ extern std::multiset<std::unique_ptr<struct heif_encoder_descriptor>,
                      encoder_descriptor_priority_order>& get_encoder_descriptors()
 {
   load_plugins_if_not_initialized_yet();
+  load_deferred_plugins(heif_plugin_type_encoder, heif_compression_undefined);
 
   return s_encoder_descriptors;
 }
@@ -208,6 +230,10 @@ void register_default_plugins()
   register_encoder(get_encoder_plugin_openjph());
 #endif
 
+#if HAVE_OPENJPH_DECODER
+  register_decoder(get_decoder_plugin_openjph());
+#endif
+
 #if HAVE_OpenH264_DECODER
   register_decoder(get_decoder_plugin_openh264());
 #endif
@@ -228,13 +254,14 @@ void register_decoder(const heif_decoder_plugin* decoder_plugin)
   }
 
   s_decoder_plugins.insert(decoder_plugin);
+
+  clear_plugin_caches();
 }
 
 
-const struct heif_decoder_plugin* get_decoder(enum heif_compression_format type, const char* name_id)
+static const struct heif_decoder_plugin* find_loaded_decoder(enum heif_compression_format type, const char* name_id,
+                                                             int* out_priority)
 {
-  load_plugins_if_not_initialized_yet();
-
   int highest_priority = 0;
   const struct heif_decoder_plugin* best_plugin = nullptr;
 
@@ -244,6 +271,7 @@ const struct heif_decoder_plugin* get_decoder(enum heif_compression_format type,
 
     if (priority > 0 && name_id && plugin->plugin_api_version >= 3) {
       if (strcmp(name_id, plugin->id_name) == 0) {
+        *out_priority = priority;
         return plugin;
       }
     }
@@ -254,10 +282,44 @@ const struct heif_decoder_plugin* get_decoder(enum heif_compression_format type,
     }
   }
 
+  *out_priority = highest_priority;
   return best_plugin;
 }
 
 
+const struct heif_decoder_plugin* get_decoder(enum heif_compression_format type, const char* name_id)
+{
+  load_plugins_if_not_initialized_yet();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::recursive_mutex> lock(heif_init_mutex());
+#endif
+
+  auto cache_key = std::make_pair(type, std::string(name_id ? name_id : ""));
+  auto cached = s_decoder_cache.find(cache_key);
+  if (cached != s_decoder_cache.end()) {
+    return cached->second;
+  }
+
+  // We can only check the ID of a plugin after loading it.
+  if (name_id) {
+    load_deferred_plugins(heif_plugin_type_decoder, type);
+  }
+
+  int priority;
+  const struct heif_decoder_plugin* plugin = find_loaded_decoder(type, name_id, &priority);
+
+  // Only deferred plugins with a higher priority can replace the plugin.
+  if (load_deferred_plugins(heif_plugin_type_decoder, type, priority)) {
+    plugin = find_loaded_decoder(type, name_id, &priority);
+  }
+
+  s_decoder_cache[cache_key] = plugin;
+
+  return plugin;
+}
+
+
 void register_encoder(const heif_encoder_plugin* encoder_plugin)
 {
   if (encoder_plugin->init_plugin) {
@@ -268,26 +330,67 @@ void register_encoder(const heif_encoder_plugin* encoder_plugin)
   descriptor->plugin = encoder_plugin;
 
   s_encoder_descriptors.insert(std::move(descriptor));
+
+  clear_plugin_caches();
 }
 
 
+static std::vector<const struct heif_encoder_descriptor*>
+filter_loaded_encoder_descriptors(enum heif_compression_format format,
+                                  const char* name);
+
+
 const struct heif_encoder_plugin* get_encoder(enum heif_compression_format type)
 {
   load_plugins_if_not_initialized_yet();
 
-  auto filtered_encoder_descriptors = get_filtered_encoder_descriptors(type, nullptr);
-  if (filtered_encoder_descriptors.size() > 0) {
-    return filtered_encoder_descriptors[0]->plugin;
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::recursive_mutex> lock(heif_init_mutex());
+#endif
+
+  auto cached = s_encoder_cache.find(type);
+  if (cached != s_encoder_cache.end()) {
+    return cached->second;
   }
-  else {
-    return nullptr;
+
+  auto filtered_encoder_descriptors = filter_loaded_encoder_descriptors(type, nullptr);
+
+  // Only deferred plugins with a higher priority can replace the plugin.
+  int priority = filtered_encoder_descriptors.empty() ? 0 : filtered_encoder_descriptors[0]->plugin->priority;
+  if (load_deferred_plugins(heif_plugin_type_encoder, type, priority)) {
+    filtered_encoder_descriptors = filter_loaded_encoder_descriptors(type, nullptr);
+  }
+
+  const struct heif_encoder_plugin* plugin = nullptr;
+  if (filtered_encoder_descriptors.size() > 0) {
+    plugin = filtered_encoder_descriptors[0]->plugin;
   }
+
+  s_encoder_cache[type] = plugin;
+
+  return plugin;
 }
 
 
 std::vector<const struct heif_encoder_descriptor*>
 get_filtered_encoder_descriptors(enum heif_compression_format format,
                                  const char* name)
+{
+  load_plugins_if_not_initialized_yet();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::recursive_mutex> lock(heif_init_mutex());
+#endif
+
+  load_deferred_plugins(heif_plugin_type_encoder, format);
+
+  return filter_loaded_encoder_descriptors(format, name);
+}
+
+
+static std::vector<const struct heif_encoder_descriptor*>
+filter_loaded_encoder_descriptors(enum heif_compression_format format,
+                                  const char* name)
 {
   std::vector<const struct heif_encoder_descriptor*> filtered_descriptors;
 
@@ -316,6 +419,8 @@ void heif_unregister_decoder_plugins()
     }
   }
   s_decoder_plugins.clear();
+
+  clear_plugin_caches();
 }
 
 void heif_unregister_encoder_plugins()
@@ -326,6 +431,8 @@ void heif_unregister_encoder_plugins()
     }
   }
   s_encoder_descriptors.clear();
+
+  clear_plugin_caches();
 }
 
 #if ENABLE_PLUGIN_LOADING
@@ -335,6 +442,8 @@ void heif_unregister_encoder_plugin(const heif_encoder_plugin* plugin)
     (*plugin->cleanup_plugin)();
   }
 
+  clear_plugin_caches();
+
   for (auto iter = s_encoder_descriptors.begin() ; iter != s_encoder_descriptors.end(); ++iter) {
     if ((*iter)->plugin == plugin) {
       s_encoder_descriptors.erase(iter);
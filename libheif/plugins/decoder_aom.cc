@@ -36,7 +36,13 @@ struct aom_decoder
 
   aom_codec_iface_t* iface;
 
+  // 0 = libaom default
+  unsigned int num_threads = 0;
+
   bool strict_decoding = false;
+
+  int (* decoding_callback)(float progress, void* callback_data) = nullptr;
+  void* decoding_callback_data = nullptr;
 };
 
 static const char kSuccess[] = "Success";
@@ -132,6 +138,50 @@ void aom_set_strict_decoding(void* decoder_raw, int flag)
 }
 
 
+struct heif_error aom_set_num_threads(void* decoder_raw, int num_threads)
+{
+  struct aom_decoder* decoder = (aom_decoder*) decoder_raw;
+
+  unsigned int threads = static_cast<unsigned int>(std::max(num_threads, 1));
+  if (threads == decoder->num_threads) {
+    struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+    return err;
+  }
+
+  // The number of threads can only be set when initializing the codec.
+
+  if (decoder->codec_initialized) {
+    aom_codec_destroy(&decoder->codec);
+    decoder->codec_initialized = false;
+  }
+
+  aom_codec_dec_cfg_t cfg{};
+  cfg.threads = threads;
+  cfg.allow_lowbitdepth = 1;
+
+  aom_codec_err_t aomerr = aom_codec_dec_init(&decoder->codec, decoder->iface, &cfg, 0);
+  if (aomerr) {
+    struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, aom_codec_err_to_string(aomerr)};
+    return err;
+  }
+
+  decoder->codec_initialized = true;
+  decoder->num_threads = threads;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
+// libheif truncates layered images ('a1lx') at layer boundaries. libaom outputs the last
+// layer that is contained in the data, because all layers are decoded as one temporal unit.
+struct heif_error aom_set_progressive_decoding(void* decoder_raw, int max_quality_layers, int data_is_truncated)
+{
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
 struct heif_error aom_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
 {
   struct aom_decoder* decoder = (struct aom_decoder*) decoder_raw;
@@ -139,6 +189,12 @@ struct heif_error aom_push_data(void* decoder_raw, const void* frame_data, size_
   const char* ver = aom_codec_version_str();
   (void)ver;
 
+  // libaom decodes the whole temporal unit in aom_codec_decode(). It can only be canceled before.
+  if (decoder->decoding_callback && decoder->decoding_callback(-1.0f, decoder->decoding_callback_data)) {
+    struct heif_error err = {heif_error_Canceled, heif_suberror_Unspecified, kEmptyString};
+    return err;
+  }
+
   aom_codec_err_t aomerr;
   aomerr = aom_codec_decode(&decoder->codec, (const uint8_t*) frame_data, frame_size, NULL);
   if (aomerr) {
@@ -152,6 +208,15 @@ struct heif_error aom_push_data(void* decoder_raw, const void* frame_data, size_
 }
 
 
+void aom_set_decoding_callback(void* decoder_raw, int (* callback)(float progress, void* callback_data), void* callback_data)
+{
+  struct aom_decoder* decoder = (struct aom_decoder*) decoder_raw;
+
+  decoder->decoding_callback = callback;
+  decoder->decoding_callback_data = callback_data;
+}
+
+
 struct heif_error aom_decode_image(void* decoder_raw, struct heif_image** out_img)
 {
   struct aom_decoder* decoder = (struct aom_decoder*) decoder_raw;
@@ -276,7 +341,7 @@ struct heif_error aom_decode_image(void* decoder_raw, struct heif_image** out_im
 
 static const struct heif_decoder_plugin decoder_aom
     {
-        3,
+        4,
         aom_plugin_name,
         aom_init_plugin,
         aom_deinit_plugin,
@@ -286,7 +351,19 @@ static const struct heif_decoder_plugin decoder_aom
         aom_push_data,
         aom_decode_image,
         aom_set_strict_decoding,
-        "aom"
+        "aom",
+        nullptr,
+        nullptr,
+        nullptr,
+        aom_set_num_threads,
+        nullptr,
+        nullptr,
+        aom_set_progressive_decoding,
+        nullptr,
+        nullptr,
+        nullptr,
+        nullptr,
+        aom_set_decoding_callback
     };
 
 
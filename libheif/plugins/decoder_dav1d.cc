@@ -29,6 +29,8 @@
 #include <cstdio>
 #include <limits>
 #include <utility>
+#include <algorithm>
+#include <deque>
 
 #include <dav1d/version.h>
 #include <dav1d/dav1d.h>
@@ -39,6 +41,16 @@ struct dav1d_decoder
   Dav1dContext* context;
   Dav1dData data;
   bool strict_decoding = false;
+  bool low_latency = false;
+
+  int (* decoding_callback)(float progress, void* callback_data) = nullptr;
+  void* decoding_callback_data = nullptr;
+
+  // --- sequence decoding
+
+  bool sequence_started = false;
+  bool sequence_flushed = false;
+  std::deque<Dav1dData> pending_samples; // samples that have not been accepted by dav1d yet
 };
 
 static const char kEmptyString[] = "";
@@ -101,6 +113,10 @@ struct heif_error dav1d_new_decoder(void** dec)
 
   decoder->settings.all_layers = 0;
 
+  // Still images consist of a single frame. Decoding several frames in parallel (frame threading) would only
+  // allocate additional frame contexts. It is enabled for image sequences.
+  decoder->settings.max_frame_delay = 1;
+
   if (dav1d_open(&decoder->context, &decoder->settings) != 0) {
     delete decoder;
     struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kSuccess};
@@ -127,6 +143,9 @@ void dav1d_free_decoder(void* decoder_raw)
   if (decoder->data.sz) {
     dav1d_data_unref(&decoder->data);
   }
+  for (Dav1dData& sample : decoder->pending_samples) {
+    dav1d_data_unref(&sample);
+  }
   if (decoder->context) {
     dav1d_close(&decoder->context);
   }
@@ -135,6 +154,63 @@ void dav1d_free_decoder(void* decoder_raw)
 }
 
 
+// dav1d starts its threads in dav1d_open(). Changing the settings of the threads requires opening the context again.
+static bool dav1d_reopen_context(struct dav1d_decoder* decoder)
+{
+  if (decoder->context) {
+    dav1d_close(&decoder->context);
+  }
+
+  if (dav1d_open(&decoder->context, &decoder->settings) != 0) {
+    decoder->context = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+
+struct heif_error dav1d_reset_decoder(void* decoder_raw)
+{
+  auto* decoder = (dav1d_decoder*) decoder_raw;
+
+  if (decoder->data.sz) {
+    dav1d_data_unref(&decoder->data);
+  }
+
+  for (Dav1dData& sample : decoder->pending_samples) {
+    dav1d_data_unref(&sample);
+  }
+  decoder->pending_samples.clear();
+
+  if (!decoder->context) {
+    return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+  }
+
+  if (decoder->settings.max_frame_delay != 1) {
+    // the decoder was used for a sequence with frame threading
+    decoder->settings.max_frame_delay = 1;
+    if (!dav1d_reopen_context(decoder)) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+    }
+  }
+  else {
+    // drops all pending pictures, but keeps the worker threads
+    dav1d_flush(decoder->context);
+  }
+
+  decoder->strict_decoding = false;
+  decoder->low_latency = false;
+  decoder->decoding_callback = nullptr;
+  decoder->decoding_callback_data = nullptr;
+  decoder->sequence_started = false;
+  decoder->sequence_flushed = false;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
 void dav1d_set_strict_decoding(void* decoder_raw, int flag)
 {
   struct dav1d_decoder* decoder = (dav1d_decoder*) decoder_raw;
@@ -142,6 +218,33 @@ void dav1d_set_strict_decoding(void* decoder_raw, int flag)
   decoder->strict_decoding = flag;
 }
 
+
+struct heif_error dav1d_set_num_threads(void* decoder_raw, int num_threads)
+{
+  auto* decoder = (dav1d_decoder*) decoder_raw;
+
+  // dav1d limits the number of threads
+  num_threads = std::min(std::max(num_threads, 1), 256);
+
+  if (decoder->settings.n_threads != num_threads) {
+    decoder->settings.n_threads = num_threads;
+
+    if (!dav1d_reopen_context(decoder)) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+    }
+  }
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+// libheif truncates layered images ('a1lx') at layer boundaries. Since only the highest spatial
+// layer is output (all_layers = 0), dav1d returns the last layer that is contained in the data.
+struct heif_error dav1d_set_progressive_decoding(void* decoder_raw, int max_quality_layers, int data_is_truncated)
+{
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
 struct heif_error dav1d_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
 {
   auto* decoder = (struct dav1d_decoder*) decoder_raw;
@@ -161,19 +264,22 @@ struct heif_error dav1d_push_data(void* decoder_raw, const void* frame_data, siz
 }
 
 
-struct heif_error dav1d_decode_image(void* decoder_raw, struct heif_image** out_img)
+static struct heif_error dav1d_get_decoded_frame(struct dav1d_decoder* decoder, Dav1dPicture* frame)
 {
-  auto* decoder = (struct dav1d_decoder*) decoder_raw;
-
   struct heif_error err;
 
-  Dav1dPicture frame;
-  memset(&frame, 0, sizeof(Dav1dPicture));
+  memset(frame, 0, sizeof(Dav1dPicture));
 
   bool flushed = false;
 
   for (;;) {
 
+    // dav1d decodes a frame in one call. Layered images ('a1lx') can be canceled between the layers.
+    if (decoder->decoding_callback && decoder->decoding_callback(-1.0f, decoder->decoding_callback_data)) {
+      err = {heif_error_Canceled, heif_suberror_Unspecified, kEmptyString};
+      return err;
+    }
+
     int res = dav1d_send_data(decoder->context, &decoder->data);
     if ((res < 0) && (res != DAV1D_ERR(EAGAIN))) {
       err = {heif_error_Decoder_plugin_error,
@@ -182,7 +288,7 @@ struct heif_error dav1d_decode_image(void* decoder_raw, struct heif_image** out_
       return err;
     }
 
-    res = dav1d_get_picture(decoder->context, &frame);
+    res = dav1d_get_picture(decoder->context, frame);
     if (!flushed && res == DAV1D_ERR(EAGAIN)) {
       if (decoder->data.sz == 0) {
         flushed = true;
@@ -200,31 +306,99 @@ struct heif_error dav1d_decode_image(void* decoder_raw, struct heif_image** out_
     }
   }
 
-  heif_chroma chroma;
-  heif_colorspace colorspace;
+  err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
+static bool get_frame_chroma(const Dav1dPicture& frame, heif_colorspace* colorspace, heif_chroma* chroma)
+{
   switch (frame.p.layout) {
     case DAV1D_PIXEL_LAYOUT_I420:
-      chroma = heif_chroma_420;
-      colorspace = heif_colorspace_YCbCr;
-      break;
+      *chroma = heif_chroma_420;
+      *colorspace = heif_colorspace_YCbCr;
+      return true;
     case DAV1D_PIXEL_LAYOUT_I422:
-      chroma = heif_chroma_422;
-      colorspace = heif_colorspace_YCbCr;
-      break;
+      *chroma = heif_chroma_422;
+      *colorspace = heif_colorspace_YCbCr;
+      return true;
     case DAV1D_PIXEL_LAYOUT_I444:
-      chroma = heif_chroma_444;
-      colorspace = heif_colorspace_YCbCr;
-      break;
+      *chroma = heif_chroma_444;
+      *colorspace = heif_colorspace_YCbCr;
+      return true;
     case DAV1D_PIXEL_LAYOUT_I400:
-      chroma = heif_chroma_monochrome;
-      colorspace = heif_colorspace_monochrome;
-      break;
-    default: {
-      err = {heif_error_Decoder_plugin_error,
-             heif_suberror_Unspecified,
-             kEmptyString};
-      return err;
+      *chroma = heif_chroma_monochrome;
+      *colorspace = heif_colorspace_monochrome;
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+static const heif_channel channel2plane[3] = {
+    heif_channel_Y,
+    heif_channel_Cb,
+    heif_channel_Cr
+};
+
+
+// Copies the planes of the frame into 'image', with the top-left corner at (x0,y0).
+// Parts that extend beyond the planes of 'image' are discarded.
+static void copy_frame_planes(const Dav1dPicture& frame, heif_chroma chroma,
+                              struct heif_image* image, uint32_t x0, uint32_t y0)
+{
+  int num_planes = (chroma == heif_chroma_monochrome ? 1 : 3);
+
+  for (int c = 0; c < num_planes; c++) {
+    int bpp = frame.p.bpc;
+
+    const uint8_t* data = (uint8_t*) frame.data[c];
+    int stride = (int) frame.stride[c > 0 ? 1 : 0];
+
+    uint32_t w, h;
+    get_subsampled_size(frame.p.w, frame.p.h,
+                        channel2plane[c], chroma, &w, &h);
+
+    uint32_t xs, ys;
+    get_subsampled_size(x0, y0, channel2plane[c], chroma, &xs, &ys);
+
+    uint32_t target_w = heif_image_get_width(image, channel2plane[c]);
+    uint32_t target_h = heif_image_get_height(image, channel2plane[c]);
+    if (xs >= target_w || ys >= target_h) {
+      continue;
     }
+
+    uint32_t copy_w = std::min(w, target_w - xs);
+    uint32_t copy_h = std::min(h, target_h - ys);
+
+    int bytes_per_pixel = (bpp + 7) / 8;
+
+    size_t dst_stride;
+    uint8_t* dst_mem = heif_image_get_plane2(image, channel2plane[c], &dst_stride);
+    dst_mem += ys * dst_stride + xs * bytes_per_pixel;
+
+    for (uint32_t y = 0; y < copy_h; y++) {
+      memcpy(dst_mem + y * dst_stride, data + y * stride, copy_w * bytes_per_pixel);
+    }
+  }
+}
+
+
+// Converts the frame into a new heif_image and releases the frame.
+static struct heif_error dav1d_convert_frame(struct dav1d_decoder* decoder, Dav1dPicture& frame, struct heif_image** out_img)
+{
+  struct heif_error err;
+
+  heif_chroma chroma;
+  heif_colorspace colorspace;
+  if (!get_frame_chroma(frame, &colorspace, &chroma)) {
+    dav1d_picture_unref(&frame);
+
+    err = {heif_error_Decoder_plugin_error,
+           heif_suberror_Unspecified,
+           kEmptyString};
+    return err;
   }
 
 
@@ -235,6 +409,7 @@ struct heif_error dav1d_decode_image(void* decoder_raw, struct heif_image** out_
                           &heif_img);
   if (err.code != heif_error_Ok) {
     assert(heif_img == nullptr);
+    dav1d_picture_unref(&frame);
     return err;
   }
 
@@ -252,56 +427,218 @@ struct heif_error dav1d_decode_image(void* decoder_raw, struct heif_image** out_
 
   // --- transfer data from Dav1dPicture to HeifPixelImage
 
-  heif_channel channel2plane[3] = {
-      heif_channel_Y,
-      heif_channel_Cb,
-      heif_channel_Cr
-  };
-
-
-  // --- copy image data
-
   int num_planes = (chroma == heif_chroma_monochrome ? 1 : 3);
 
   for (int c = 0; c < num_planes; c++) {
-    int bpp = frame.p.bpc;
-
-    const uint8_t* data = (uint8_t*) frame.data[c];
-    int stride = (int) frame.stride[c > 0 ? 1 : 0];
-
     uint32_t w, h;
     get_subsampled_size(frame.p.w, frame.p.h,
                         channel2plane[c], chroma, &w, &h);
 
-    err = heif_image_add_plane(heif_img, channel2plane[c], w, h, bpp);
+    err = heif_image_add_plane(heif_img, channel2plane[c], w, h, frame.p.bpc);
     if (err.code != heif_error_Ok) {
       heif_image_release(heif_img);
+      dav1d_picture_unref(&frame);
       return err;
     }
+  }
 
-    size_t dst_stride;
-    uint8_t* dst_mem = heif_image_get_plane2(heif_img, channel2plane[c], &dst_stride);
+  copy_frame_planes(frame, chroma, heif_img, 0, 0);
 
-    int bytes_per_pixel = (bpp + 7) / 8;
+  dav1d_picture_unref(&frame);
 
-    for (uint32_t y = 0; y < h; y++) {
-      memcpy(dst_mem + y * dst_stride, data + y * stride, w * bytes_per_pixel);
-    }
+  *out_img = heif_img;
+
+
+  err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
+struct heif_error dav1d_decode_image(void* decoder_raw, struct heif_image** out_img)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  Dav1dPicture frame;
+  struct heif_error err = dav1d_get_decoded_frame(decoder, &frame);
+  if (err.code != heif_error_Ok) {
+    return err;
   }
 
-  dav1d_picture_unref(&frame);
+  return dav1d_convert_frame(decoder, frame, out_img);
+}
 
-  *out_img = heif_img;
 
+struct heif_error dav1d_decode_image_into(void* decoder_raw, struct heif_image* target, uint32_t x0, uint32_t y0)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  Dav1dPicture frame;
+  struct heif_error err = dav1d_get_decoded_frame(decoder, &frame);
+  if (err.code != heif_error_Ok) {
+    return err;
+  }
+
+  heif_chroma chroma;
+  heif_colorspace colorspace;
+  if (!get_frame_chroma(frame, &colorspace, &chroma) ||
+      chroma != heif_image_get_chroma_format(target) ||
+      frame.p.bpc != heif_image_get_bits_per_pixel_range(target, heif_channel_Y)) {
+    dav1d_picture_unref(&frame);
+
+    err = {heif_error_Unsupported_feature,
+           heif_suberror_Unsupported_color_conversion,
+           "Decoded image format does not match the target image"};
+    return err;
+  }
+
+  copy_frame_planes(frame, chroma, target, x0, y0);
+
+  dav1d_picture_unref(&frame);
 
   err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
   return err;
 }
 
 
+void dav1d_set_low_latency_decoding(void* decoder_raw, int flag)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  decoder->low_latency = flag;
+}
+
+
+void dav1d_set_decoding_callback(void* decoder_raw, int (* callback)(float progress, void* callback_data), void* callback_data)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  decoder->decoding_callback = callback;
+  decoder->decoding_callback_data = callback_data;
+}
+
+
+// --- sequences with inter-frame prediction
+//
+// The samples are queued and sent to dav1d as soon as it accepts more data. The sample's user_data is passed
+// through the timestamp of the data. Unless low-latency decoding is requested, dav1d decodes several frames
+// in parallel (frame threading), which delays the output by a few frames.
+
+static struct heif_error dav1d_push_sequence_sample(void* decoder_raw, const void* data, size_t size, uintptr_t user_data)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  if (!decoder->sequence_started) {
+    decoder->sequence_started = true;
+
+    int max_frame_delay = (decoder->low_latency ? 1 : 0); // 0: chosen by dav1d from the number of threads
+    if (decoder->settings.max_frame_delay != max_frame_delay) {
+      decoder->settings.max_frame_delay = max_frame_delay;
+      if (!dav1d_reopen_context(decoder)) {
+        return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+      }
+    }
+
+    // The configuration OBUs (from push_data()) are sent before the first sample.
+    if (decoder->data.sz) {
+      decoder->pending_samples.push_back(decoder->data);
+      memset(&decoder->data, 0, sizeof(Dav1dData));
+    }
+  }
+
+  Dav1dData sample;
+  memset(&sample, 0, sizeof(Dav1dData));
+
+  uint8_t* d = dav1d_data_create(&sample, size);
+  if (d == nullptr) {
+    return {heif_error_Memory_allocation_error, heif_suberror_Unspecified, kSuccess};
+  }
+
+  memcpy(d, data, size);
+  sample.m.timestamp = static_cast<int64_t>(user_data);
+
+  decoder->pending_samples.push_back(sample);
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
+static struct heif_error dav1d_flush_sequence(void* decoder_raw)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  decoder->sequence_flushed = true;
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
+static struct heif_error dav1d_get_next_sequence_image(void* decoder_raw, struct heif_image** out_img, uintptr_t* out_user_data)
+{
+  auto* decoder = (struct dav1d_decoder*) decoder_raw;
+
+  *out_img = nullptr;
+
+  if (!decoder->context) {
+    return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+  }
+
+  Dav1dPicture frame;
+  memset(&frame, 0, sizeof(Dav1dPicture));
+
+  bool draining = false;
+
+  for (;;) {
+    // --- send the queued samples until dav1d has to output pictures before it accepts more data
+
+    while (!decoder->pending_samples.empty()) {
+      Dav1dData& sample = decoder->pending_samples.front();
+
+      int res = dav1d_send_data(decoder->context, &sample);
+      if (res < 0 && res != DAV1D_ERR(EAGAIN)) {
+        dav1d_data_unref(&sample);
+        decoder->pending_samples.pop_front();
+        return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+      }
+
+      if (sample.sz > 0) {
+        break;
+      }
+
+      decoder->pending_samples.pop_front();
+    }
+
+    int res = dav1d_get_picture(decoder->context, &frame);
+    if (res == 0) {
+      break;
+    }
+    else if (res != DAV1D_ERR(EAGAIN)) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+    }
+
+    if (!decoder->pending_samples.empty()) {
+      continue;
+    }
+
+    // When no data was sent since the last call, dav1d_get_picture() waits for the frames that are still
+    // being decoded in parallel. After the end of the sequence, this outputs the remaining images.
+    if (decoder->sequence_flushed && !draining) {
+      draining = true;
+      continue;
+    }
+
+    // needs more samples, or all images have been output
+    return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  }
+
+  *out_user_data = static_cast<uintptr_t>(frame.m.timestamp);
+
+  return dav1d_convert_frame(decoder, frame, out_img);
+}
+
+
 static const struct heif_decoder_plugin decoder_dav1d
     {
-        3,
+        4,
         dav1d_plugin_name,
         dav1d_init_plugin,
         dav1d_deinit_plugin,
@@ -311,7 +648,19 @@ static const struct heif_decoder_plugin decoder_dav1d
         dav1d_push_data,
         dav1d_decode_image,
         dav1d_set_strict_decoding,
-        "dav1d"
+        "dav1d",
+        nullptr,
+        dav1d_decode_image_into,
+        dav1d_reset_decoder,
+        dav1d_set_num_threads,
+        nullptr,
+        nullptr,
+        dav1d_set_progressive_decoding,
+        dav1d_push_sequence_sample,
+        dav1d_flush_sequence,
+        dav1d_get_next_sequence_image,
+        dav1d_set_low_latency_decoding,
+        dav1d_set_decoding_callback
     };
 
 
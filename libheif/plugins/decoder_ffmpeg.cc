@@ -20,6 +20,7 @@
 
 #include "libheif/heif.h"
 #include "libheif/heif_plugin.h"
+#include "libheif/heif_experimental.h"
 #include "decoder_ffmpeg.h"
 #include "nalu_utils.h"
 
@@ -30,10 +31,17 @@
 
 #include <memory>
 #include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 extern "C"
 {
     #include <libavcodec/avcodec.h>
+    #include <libavutil/hwcontext.h>
+    #include <libavutil/hwcontext_drm.h>
+    #include <libavutil/pixdesc.h>
 }
 
 
@@ -45,36 +53,113 @@ struct ffmpeg_decoder
 
 static const int FFMPEG_DECODER_PLUGIN_PRIORITY = 90;
 
-#define MAX_PLUGIN_NAME_LENGTH 80
+// When a hardware decoder is configured, it is preferred over the software decoders.
+// Note: the priority in the plugin manifest (plugins/CMakeLists.txt) must not be lower than this.
+static const int FFMPEG_HWACCEL_DECODER_PLUGIN_PRIORITY = 110;
+
+#define MAX_PLUGIN_NAME_LENGTH 160
 
 static char plugin_name[MAX_PLUGIN_NAME_LENGTH];
 
 
+// Hardware device selected with the environment variable LIBHEIF_FFMPEG_HWACCEL="<type>[:<device>]",
+// e.g. "vaapi:/dev/dri/renderD128", "cuda" or "videotoolbox".
+// The device is opened once and shared by all decoders. It is NULL when decoding in software.
+static AVBufferRef* hw_device_ctx = nullptr;
+static enum AVPixelFormat hw_pix_fmt = AV_PIX_FMT_NONE;
+
+// Why the requested hardware device is not used. It is reported in the plugin name.
+static std::string hwaccel_fallback_reason;
+
+
 static const char* ffmpeg_plugin_name()
 {
-  snprintf(plugin_name, MAX_PLUGIN_NAME_LENGTH, "FFMPEG HEVC decoder %s", av_version_info());
+  if (hw_device_ctx) {
+    const auto* device = (const AVHWDeviceContext*) hw_device_ctx->data;
+    snprintf(plugin_name, MAX_PLUGIN_NAME_LENGTH, "FFMPEG HEVC decoder %s (%s)", av_version_info(),
+             av_hwdevice_get_type_name(device->type));
+  }
+  else if (!hwaccel_fallback_reason.empty()) {
+    snprintf(plugin_name, MAX_PLUGIN_NAME_LENGTH, "FFMPEG HEVC decoder %s (software, %s)", av_version_info(),
+             hwaccel_fallback_reason.c_str());
+  }
+  else {
+    snprintf(plugin_name, MAX_PLUGIN_NAME_LENGTH, "FFMPEG HEVC decoder %s", av_version_info());
+  }
   plugin_name[MAX_PLUGIN_NAME_LENGTH - 1] = 0; //null-terminated
 
   return plugin_name;
 }
 
 
-static void ffmpeg_init_plugin()
+static void ffmpeg_init_hwaccel()
 {
+  const char* hwaccel_variable = getenv("LIBHEIF_FFMPEG_HWACCEL");
+  if (hwaccel_variable == nullptr || *hwaccel_variable == 0) {
+    return;
+  }
+
+  std::string hwaccel = hwaccel_variable;
+  std::string device_name;
+  size_t colon = hwaccel.find(':');
+  if (colon != std::string::npos) {
+    device_name = hwaccel.substr(colon + 1);
+    hwaccel = hwaccel.substr(0, colon);
+  }
+
+  enum AVHWDeviceType type = av_hwdevice_find_type_by_name(hwaccel.c_str());
+  if (type == AV_HWDEVICE_TYPE_NONE) {
+    hwaccel_fallback_reason = "unknown device type '" + hwaccel + "'";
+    return;
+  }
+
+  const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_HEVC);
+  if (!codec) {
+    return;
+  }
 
+  for (int i = 0;; i++) {
+    const AVCodecHWConfig* config = avcodec_get_hw_config(codec, i);
+    if (!config) {
+      hwaccel_fallback_reason = "device type '" + hwaccel + "' not supported";
+      return;
+    }
+
+    if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type) {
+      hw_pix_fmt = config->pix_fmt;
+      break;
+    }
+  }
+
+  if (av_hwdevice_ctx_create(&hw_device_ctx, type, device_name.empty() ? nullptr : device_name.c_str(), nullptr, 0) < 0) {
+    hwaccel_fallback_reason = std::string("cannot open device '") + hwaccel_variable + "'";
+    hw_device_ctx = nullptr;
+    hw_pix_fmt = AV_PIX_FMT_NONE;
+  }
+}
+
+
+static void ffmpeg_init_plugin()
+{
+  ffmpeg_init_hwaccel();
 }
 
 
 static void ffmpeg_deinit_plugin()
 {
+  if (hw_device_ctx) {
+    av_buffer_unref(&hw_device_ctx);
+  }
 
+  hw_pix_fmt = AV_PIX_FMT_NONE;
+  hwaccel_fallback_reason.clear();
 }
 
 
 static int ffmpeg_does_support_format(enum heif_compression_format format)
 {
   if (format == heif_compression_HEVC) {
-    return FFMPEG_DECODER_PLUGIN_PRIORITY;
+    return hw_device_ctx ? FFMPEG_HWACCEL_DECODER_PLUGIN_PRIORITY : FFMPEG_DECODER_PLUGIN_PRIORITY;
   }
   else {
     return 0;
@@ -129,6 +214,9 @@ static heif_chroma ffmpeg_get_chroma_format(enum AVPixelFormat pix_fmt) {
     case AV_PIX_FMT_YUV420P12LE:
     case AV_PIX_FMT_YUV420P14LE:
     case AV_PIX_FMT_YUV420P16LE:
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_P010LE:
+    case AV_PIX_FMT_P016LE:
       return heif_chroma_420;
 
     case AV_PIX_FMT_YUV422P:
@@ -191,8 +279,10 @@ static int get_ffmpeg_format_bpp(enum AVPixelFormat pix_fmt)
     case AV_PIX_FMT_YUVJ420P:
     case AV_PIX_FMT_YUV422P:
     case AV_PIX_FMT_YUV444P:
+    case AV_PIX_FMT_NV12:
       return 8;
     case AV_PIX_FMT_GRAY10LE:
+    case AV_PIX_FMT_P010LE:
     case AV_PIX_FMT_YUV420P10LE:
     case AV_PIX_FMT_YUV422P10LE:
     case AV_PIX_FMT_YUV444P10LE:
@@ -208,6 +298,7 @@ static int get_ffmpeg_format_bpp(enum AVPixelFormat pix_fmt)
     case AV_PIX_FMT_YUV444P14LE:
       return 14;
     case AV_PIX_FMT_GRAY16LE:
+    case AV_PIX_FMT_P016LE:
     case AV_PIX_FMT_YUV420P16LE:
     case AV_PIX_FMT_YUV422P16LE:
     case AV_PIX_FMT_YUV444P16LE:
@@ -217,7 +308,60 @@ static int get_ffmpeg_format_bpp(enum AVPixelFormat pix_fmt)
   }
 }
 
-static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc_frame, AVPacket* hevc_pkt, struct heif_image** image)
+static enum AVPixelFormat ffmpeg_get_hw_format(AVCodecContext* ctx, const enum AVPixelFormat* pix_fmts)
+{
+  for (const enum AVPixelFormat* p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+    if (*p == hw_pix_fmt) {
+      return *p;
+    }
+  }
+
+  // The hardware cannot decode this stream (e.g. because of its chroma format). Decode it in software.
+  return avcodec_default_get_format(ctx, pix_fmts);
+}
+
+
+// Copies one component of the frame into a plane. This also handles the semi-planar formats (NV12, P010)
+// that hardware decoders output, where Cb and Cr are interleaved and the samples may be stored in the upper bits.
+static void ffmpeg_copy_component(const AVFrame* frame, const AVPixFmtDescriptor* desc, int component, int bpp,
+                                  uint8_t* dst_mem, size_t dst_stride, int w, int h)
+{
+  const AVComponentDescriptor& comp = desc->comp[component];
+
+  int stride = frame->linesize[comp.plane];
+  const uint8_t* data = frame->data[comp.plane] + comp.offset;
+
+  int bytes_per_pixel = (bpp + 7) / 8;
+  int shift = comp.shift + (comp.depth - bpp);
+
+  if (comp.step == bytes_per_pixel && shift == 0) {
+    for (int y = 0; y < h; y++) {
+      memcpy(dst_mem + y * dst_stride, data + y * stride, w * bytes_per_pixel);
+    }
+  }
+  else if (bytes_per_pixel == 1) {
+    for (int y = 0; y < h; y++) {
+      const uint8_t* src = data + y * stride;
+      uint8_t* dst = dst_mem + y * dst_stride;
+      for (int x = 0; x < w; x++) {
+        dst[x] = src[x * comp.step];
+      }
+    }
+  }
+  else {
+    for (int y = 0; y < h; y++) {
+      const uint8_t* src = data + y * stride;
+      auto* dst = (uint16_t*) (dst_mem + y * dst_stride);
+      for (int x = 0; x < w; x++) {
+        const uint8_t* s = src + x * comp.step;
+        dst[x] = (uint16_t) ((s[0] | (s[1] << 8)) >> shift);
+      }
+    }
+  }
+}
+
+
+static struct heif_error hevc_receive_frame(AVCodecContext* hevc_dec_ctx, AVFrame* hevc_frame, AVPacket* hevc_pkt)
 {
     int ret;
 
@@ -238,15 +382,52 @@ static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc
         return err;
     }
 
+    return heif_error_success;
+}
+
+
+static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc_frame, AVFrame* sw_frame, AVPacket* hevc_pkt, struct heif_image** image)
+{
+    int ret;
+
+    struct heif_error receive_err = hevc_receive_frame(hevc_dec_ctx, hevc_frame, hevc_pkt);
+    if (receive_err.code != heif_error_Ok) {
+        return receive_err;
+    }
+
+    const AVFrame* frame = hevc_frame;
+    enum AVPixelFormat pix_fmt = (enum AVPixelFormat) hevc_frame->format;
+    int bpp = get_ffmpeg_format_bpp(pix_fmt);
+
+    // Download frames decoded in hardware. The bit depth is that of the coded stream,
+    // because the downloaded format may use larger samples.
+    if (hevc_frame->format == hw_pix_fmt && hevc_frame->hw_frames_ctx) {
+        av_frame_unref(sw_frame);
 
-    heif_chroma chroma = ffmpeg_get_chroma_format(hevc_dec_ctx->pix_fmt);
-    if (chroma != heif_chroma_undefined)
+        ret = av_hwframe_transfer_data(sw_frame, hevc_frame, 0);
+        if (ret < 0) {
+            struct heif_error err = { heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "Error in av_hwframe_transfer_data" };
+            return err;
+        }
+
+        frame = sw_frame;
+        pix_fmt = (enum AVPixelFormat) sw_frame->format;
+        bpp = get_ffmpeg_format_bpp(hevc_dec_ctx->sw_pix_fmt);
+        if (bpp == 0 || bpp > get_ffmpeg_format_bpp(pix_fmt)) {
+            bpp = get_ffmpeg_format_bpp(pix_fmt);
+        }
+    }
+
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+
+    heif_chroma chroma = ffmpeg_get_chroma_format(pix_fmt);
+    if (chroma != heif_chroma_undefined && desc != nullptr)
     {
         bool is_mono = (chroma == heif_chroma_monochrome);
 
         heif_error err;
-        err = heif_image_create(hevc_frame->width,
-            hevc_frame->height,
+        err = heif_image_create(frame->width,
+            frame->height,
             is_mono ? heif_colorspace_monochrome : heif_colorspace_YCbCr,
             chroma,
             image);
@@ -264,7 +445,6 @@ static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc
 
         for (int channel = 0; channel < nPlanes; channel++) {
 
-            int bpp = get_ffmpeg_format_bpp(hevc_dec_ctx->pix_fmt);
             if (bpp == 0) {
               heif_image_release(*image);
               err = { heif_error_Decoder_plugin_error,
@@ -273,11 +453,8 @@ static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc
               return err;
             }
 
-            int stride = hevc_frame->linesize[channel];
-            const uint8_t* data = hevc_frame->data[channel];
-
-            int w = ffmpeg_get_chroma_width(hevc_frame, channel2plane[channel], chroma);
-            int h = ffmpeg_get_chroma_height(hevc_frame, channel2plane[channel], chroma);
+            int w = ffmpeg_get_chroma_width(frame, channel2plane[channel], chroma);
+            int h = ffmpeg_get_chroma_height(frame, channel2plane[channel], chroma);
             if (w <= 0 || h <= 0) {
                 heif_image_release(*image);
                 err = { heif_error_Decoder_plugin_error,
@@ -295,11 +472,7 @@ static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc
             size_t dst_stride;
             uint8_t* dst_mem = heif_image_get_plane2(*image, channel2plane[channel], &dst_stride);
 
-            int bytes_per_pixel = (bpp + 7) / 8;
-
-            for (int y = 0; y < h; y++) {
-                memcpy(dst_mem + y * dst_stride, data + y * stride, w * bytes_per_pixel);
-            }
+            ffmpeg_copy_component(frame, desc, channel, bpp, dst_mem, dst_stride, w, h);
         }
 
         return heif_error_success;
@@ -313,8 +486,100 @@ static struct heif_error hevc_decode(AVCodecContext* hevc_dec_ctx, AVFrame* hevc
     }
 }
 
-static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
-                                                  struct heif_image** out_img)
+static void ffmpeg_release_gpu_surface(void* release_data)
+{
+  AVFrame* frame = (AVFrame*) release_data;
+  av_frame_free(&frame);
+}
+
+
+// Exports the hardware frame as a GPU surface. The surface keeps a reference to the frame, which keeps
+// the hardware surface and the device alive after the decoder was freed.
+static struct heif_error hevc_export_gpu_surface(AVCodecContext* hevc_dec_ctx, const AVFrame* hevc_frame,
+                                                 int surface_type, struct heif_gpu_surface* out_surface)
+{
+  if (hevc_frame->format != hw_pix_fmt || !hevc_frame->hw_frames_ctx) {
+    return { heif_error_Unsupported_feature, heif_suberror_Unspecified, "Image was not decoded in hardware" };
+  }
+
+  const auto* device = (const AVHWDeviceContext*) hw_device_ctx->data;
+
+  AVFrame* surface_frame = nullptr;
+
+  if (surface_type == heif_gpu_surface_type_DMA_BUF &&
+      (device->type == AV_HWDEVICE_TYPE_VAAPI || device->type == AV_HWDEVICE_TYPE_DRM)) {
+    surface_frame = av_frame_alloc();
+    if (!surface_frame) {
+      return { heif_error_Memory_allocation_error, heif_suberror_Unspecified, "av_frame_alloc returned error" };
+    }
+
+    surface_frame->format = AV_PIX_FMT_DRM_PRIME;
+    if (av_hwframe_map(surface_frame, hevc_frame, AV_HWFRAME_MAP_READ) < 0) {
+      av_frame_free(&surface_frame);
+      return { heif_error_Unsupported_feature, heif_suberror_Unspecified, "Cannot map frame to DMA-BUF" };
+    }
+
+    const auto* drm = (const AVDRMFrameDescriptor*) surface_frame->data[0];
+    if (drm->nb_layers > 4) {
+      av_frame_free(&surface_frame);
+      return { heif_error_Unsupported_feature, heif_suberror_Unspecified, "Too many DMA-BUF layers" };
+    }
+
+    out_surface->num_layers = drm->nb_layers;
+    for (int l = 0; l < drm->nb_layers; l++) {
+      const AVDRMLayerDescriptor& layer = drm->layers[l];
+      heif_gpu_surface_dma_buf_layer& out_layer = out_surface->layers[l];
+
+      out_layer.drm_format = layer.format;
+      out_layer.num_planes = std::min(layer.nb_planes, 4);
+      for (int p = 0; p < out_layer.num_planes; p++) {
+        const AVDRMObjectDescriptor& object = drm->objects[layer.planes[p].object_index];
+        out_layer.planes[p].fd = object.fd;
+        out_layer.planes[p].format_modifier = object.format_modifier;
+        out_layer.planes[p].offset = (uint64_t) layer.planes[p].offset;
+        out_layer.planes[p].pitch = (uint32_t) layer.planes[p].pitch;
+      }
+    }
+  }
+  else if (surface_type == heif_gpu_surface_type_CVPixelBuffer &&
+           device->type == AV_HWDEVICE_TYPE_VIDEOTOOLBOX) {
+    surface_frame = av_frame_clone(hevc_frame);
+    if (!surface_frame) {
+      return { heif_error_Memory_allocation_error, heif_suberror_Unspecified, "av_frame_clone returned error" };
+    }
+
+    out_surface->native_handle = surface_frame->data[3];
+  }
+  else if (surface_type == heif_gpu_surface_type_D3D11_texture &&
+           device->type == AV_HWDEVICE_TYPE_D3D11VA) {
+    surface_frame = av_frame_clone(hevc_frame);
+    if (!surface_frame) {
+      return { heif_error_Memory_allocation_error, heif_suberror_Unspecified, "av_frame_clone returned error" };
+    }
+
+    out_surface->native_handle = surface_frame->data[0];
+    out_surface->texture_array_index = (uint32_t) (intptr_t) surface_frame->data[1];
+  }
+  else {
+    return { heif_error_Unsupported_feature, heif_suberror_Unspecified, "Surface type not supported by the hardware device" };
+  }
+
+  out_surface->width = hevc_frame->width;
+  out_surface->height = hevc_frame->height;
+  out_surface->chroma = ffmpeg_get_chroma_format(hevc_dec_ctx->sw_pix_fmt);
+  out_surface->bits_per_pixel = get_ffmpeg_format_bpp(hevc_dec_ctx->sw_pix_fmt);
+  out_surface->release = ffmpeg_release_gpu_surface;
+  out_surface->release_data = surface_frame;
+
+  return heif_error_success;
+}
+
+
+// Decodes into 'out_img', or into a GPU surface if 'out_surface' is not NULL.
+static struct heif_error ffmpeg_decode(void* decoder_raw,
+                                       struct heif_image** out_img,
+                                       int surface_type,
+                                       struct heif_gpu_surface* out_surface)
 {
   struct ffmpeg_decoder* decoder = (struct ffmpeg_decoder*) decoder_raw;
 
@@ -408,6 +673,7 @@ static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
   AVCodecContext* hevc_codecContext = NULL;
   AVPacket* hevc_pkt = NULL;
   AVFrame* hevc_frame = NULL;
+  AVFrame* sw_frame = NULL;
   AVCodecParameters* hevc_codecParam = NULL;
   struct heif_color_profile_nclx* nclx = NULL;
   int ret = 0;
@@ -416,6 +682,7 @@ static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
 
   uint8_t* parse_hevc_data = NULL;
   int parse_hevc_data_size = 0;
+  bool frame_decoded = false;
 
   uint8_t video_full_range_flag = 0;
   uint8_t color_primaries = 0;
@@ -448,6 +715,11 @@ static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
     goto errexit;
   }
 
+  if (hw_device_ctx) {
+    hevc_codecContext->hw_device_ctx = av_buffer_ref(hw_device_ctx);
+    hevc_codecContext->get_format = ffmpeg_get_hw_format;
+  }
+
   /* open it */
   if (avcodec_open2(hevc_codecContext, hevc_codec, NULL) < 0) {
     err = { heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "avcodec_open2 returned error" };
@@ -460,6 +732,12 @@ static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
     goto errexit;
   }
 
+  sw_frame = av_frame_alloc();
+  if (!sw_frame) {
+    err = { heif_error_Memory_allocation_error, heif_suberror_Unspecified, "av_frame_alloc returned error" };
+    goto errexit;
+  }
+
   parse_hevc_data = hevc_data;
   parse_hevc_data_size = (int)hevc_data_size;
   while (parse_hevc_data_size > 0) {
@@ -475,12 +753,26 @@ static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
 
       if (hevc_pkt->size)
       {
-	err = hevc_decode(hevc_codecContext, hevc_frame, hevc_pkt, out_img);
+	if (out_surface)
+	  err = hevc_receive_frame(hevc_codecContext, hevc_frame, hevc_pkt);
+	else
+	  err = hevc_decode(hevc_codecContext, hevc_frame, sw_frame, hevc_pkt, out_img);
 	if (err.code != heif_error_Ok)
 	  goto errexit;
+	frame_decoded = true;
       }
   }
 
+  if (out_surface) {
+    if (!frame_decoded) {
+      err = { heif_error_Decoder_plugin_error, heif_suberror_End_of_data, "No image decoded" };
+    }
+    else {
+      err = hevc_export_gpu_surface(hevc_codecContext, hevc_frame, surface_type, out_surface);
+    }
+    goto errexit;
+  }
+
   hevc_codecParam = avcodec_parameters_alloc();
   if (!hevc_codecParam) {
     err = { heif_error_Memory_allocation_error, heif_suberror_Unspecified, "avcodec_parameters_alloc returned error" };
@@ -510,15 +802,34 @@ errexit:
   if (hevc_parser) av_parser_close(hevc_parser);
   if (hevc_codecContext) avcodec_free_context(&hevc_codecContext);
   if (hevc_frame) av_frame_free(&hevc_frame);
+  if (sw_frame) av_frame_free(&sw_frame);
   if (hevc_pkt) av_packet_free(&hevc_pkt);
   if (nclx) heif_nclx_color_profile_free(nclx);
 
   return err;
 }
 
+static struct heif_error ffmpeg_v1_decode_image(void* decoder_raw,
+                                                  struct heif_image** out_img)
+{
+  return ffmpeg_decode(decoder_raw, out_img, 0, nullptr);
+}
+
+
+static struct heif_error ffmpeg_decode_image_to_gpu_surface(void* decoder_raw, int surface_type,
+                                                            struct heif_gpu_surface* out_surface)
+{
+  if (!hw_device_ctx) {
+    return { heif_error_Unsupported_feature, heif_suberror_Unspecified, "No hardware device configured (LIBHEIF_FFMPEG_HWACCEL)" };
+  }
+
+  return ffmpeg_decode(decoder_raw, nullptr, surface_type, out_surface);
+}
+
+
 static const struct heif_decoder_plugin decoder_ffmpeg
     {
-        3,
+        4,
         ffmpeg_plugin_name,
         ffmpeg_init_plugin,
         ffmpeg_deinit_plugin,
@@ -528,7 +839,12 @@ static const struct heif_decoder_plugin decoder_ffmpeg
         ffmpeg_v1_push_data,
         ffmpeg_v1_decode_image,
         ffmpeg_set_strict_decoding,
-        "ffmpeg"
+        "ffmpeg",
+        nullptr,
+        nullptr,
+        nullptr,
+        nullptr,
+        ffmpeg_decode_image_to_gpu_surface
     };
 
 const struct heif_decoder_plugin* get_decoder_plugin_ffmpeg()
@@ -27,6 +27,7 @@
 #include <csetjmp>
 #include <vector>
 #include <cstdio>
+#include <algorithm>
 
 extern "C" {
 #include <jpeglib.h>
@@ -36,6 +37,12 @@ extern "C" {
 struct jpeg_decoder
 {
   std::vector<uint8_t> data;
+
+  // libjpeg scales the DCT to 1/1, 1/2, 1/4 or 1/8
+  unsigned int scale_denominator = 1;
+
+  // Only the beginning of the JPEG data is available. libjpeg decodes the complete scans.
+  bool data_is_truncated = false;
 };
 
 static const char kSuccess[] = "Success";
@@ -105,12 +112,47 @@ void jpeg_free_decoder(void* decoder_raw)
 }
 
 
+struct heif_error jpeg_reset_decoder(void* decoder_raw)
+{
+  struct jpeg_decoder* decoder = (jpeg_decoder*) decoder_raw;
+
+  decoder->data.clear();
+  decoder->scale_denominator = 1;
+  decoder->data_is_truncated = false;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
 void jpeg_set_strict_decoding(void* decoder_raw, int flag)
 {
 //  struct jpeg_decoder* decoder = (jpeg_decoder*) decoder_raw;
 }
 
 
+void jpeg_set_target_scale_denominator(void* decoder_raw, int denominator)
+{
+  struct jpeg_decoder* decoder = (jpeg_decoder*) decoder_raw;
+
+  decoder->scale_denominator = 1;
+  while (decoder->scale_denominator < 8 && (int) decoder->scale_denominator * 2 <= denominator) {
+    decoder->scale_denominator *= 2;
+  }
+}
+
+
+struct heif_error jpeg_set_progressive_decoding(void* decoder_raw, int max_quality_layers, int data_is_truncated)
+{
+  struct jpeg_decoder* decoder = (jpeg_decoder*) decoder_raw;
+
+  decoder->data_is_truncated = data_is_truncated;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
 struct heif_error jpeg_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
 {
   struct jpeg_decoder* decoder = (struct jpeg_decoder*) decoder_raw;
@@ -145,11 +187,93 @@ void on_jpeg_error(j_common_ptr cinfo)
 }
 
 
-struct heif_error jpeg_decode_image(void* decoder_raw, struct heif_image** out_img)
+// libjpeg warns about the premature end of truncated data. This is expected for progressive decoding.
+void on_jpeg_message_ignored(j_common_ptr cinfo, int msg_level)
 {
-  struct jpeg_decoder* decoder = (struct jpeg_decoder*) decoder_raw;
+}
 
 
+static const struct heif_error error_target_format_mismatch = {
+    heif_error_Unsupported_feature,
+    heif_suberror_Unsupported_color_conversion,
+    "Decoded image format does not match the target image"
+};
+
+
+// Writable area of the target plane when placing an image of size w x h at (x0,y0).
+static uint8_t* get_target_plane_area(struct heif_image* target, enum heif_channel channel,
+                                      uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                                      size_t* out_stride, uint32_t* out_w, uint32_t* out_h)
+{
+  uint32_t target_w = heif_image_get_width(target, channel);
+  uint32_t target_h = heif_image_get_height(target, channel);
+
+  *out_w = (x0 < target_w) ? std::min(w, target_w - x0) : 0;
+  *out_h = (y0 < target_h) ? std::min(h, target_h - y0) : 0;
+
+  uint8_t* p = heif_image_get_plane2(target, channel, out_stride);
+  if (*out_w == 0 || *out_h == 0) {
+    return p;
+  }
+
+  return p + y0 * *out_stride + x0;
+}
+
+
+#if JPEG_LIB_VERSION >= 70
+#define DCT_H_SCALED_SIZE(comp) ((comp)->DCT_h_scaled_size)
+#define DCT_V_SCALED_SIZE(comp) ((comp)->DCT_v_scaled_size)
+#else
+#define DCT_H_SCALED_SIZE(comp) ((comp)->DCT_scaled_size)
+#define DCT_V_SCALED_SIZE(comp) ((comp)->DCT_scaled_size)
+#endif
+
+
+// The chroma format in which libjpeg outputs the raw (not upsampled) YCbCr components,
+// or heif_chroma_undefined if it does not correspond to one of ours.
+// jpeg_calc_output_dimensions() has to be called before.
+static enum heif_chroma get_raw_output_chroma(const struct jpeg_decompress_struct& cinfo)
+{
+  if (cinfo.jpeg_color_space != JCS_YCbCr || cinfo.num_components != 3) {
+    return heif_chroma_undefined;
+  }
+
+  const jpeg_component_info* comp = cinfo.comp_info;
+
+  if (comp[0].downsampled_width != cinfo.output_width ||
+      comp[0].downsampled_height != cinfo.output_height ||
+      comp[1].downsampled_width != comp[2].downsampled_width ||
+      comp[1].downsampled_height != comp[2].downsampled_height) {
+    return heif_chroma_undefined;
+  }
+
+  JDIMENSION w = cinfo.output_width;
+  JDIMENSION h = cinfo.output_height;
+  JDIMENSION cw = comp[1].downsampled_width;
+  JDIMENSION ch = comp[1].downsampled_height;
+
+  // With DCT scaling, libjpeg-turbo may decode the chroma components with a larger DCT size than luma.
+  // The output subsampling may then be different from the coded one.
+
+  if (cw == w && ch == h) {
+    return heif_chroma_444;
+  }
+  else if (cw == (w + 1) / 2 && ch == h) {
+    return heif_chroma_422;
+  }
+  else if (cw == (w + 1) / 2 && ch == (h + 1) / 2) {
+    return heif_chroma_420;
+  }
+  else {
+    return heif_chroma_undefined;
+  }
+}
+
+
+// Decodes into 'target' at (x0,y0) if it is not NULL. Otherwise, a new image is returned in 'out_img'.
+static struct heif_error jpeg_decode(struct jpeg_decoder* decoder, struct heif_image** out_img,
+                                     struct heif_image* target, uint32_t x0, uint32_t y0)
+{
   struct jpeg_decompress_struct cinfo;
   struct my_error_manager jerr;
 
@@ -166,6 +290,9 @@ struct heif_error jpeg_decode_image(void* decoder_raw, struct heif_image** out_i
 
   cinfo.err = jpeg_std_error(&jerr.mgr);
   jerr.mgr.error_exit = on_jpeg_error;
+  if (decoder->data_is_truncated) {
+    jerr.mgr.emit_message = on_jpeg_message_ignored;
+  }
   if (setjmp(jerr.setjmp_buffer)) {
     // If we get here, the JPEG code has signaled an error.
 
@@ -188,6 +315,10 @@ struct heif_error jpeg_decode_image(void* decoder_raw, struct heif_image** out_i
 
   jpeg_read_header(&cinfo, TRUE);
 
+  // The output size is rounded up: output_width = ceil(image_width / scale_denom).
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = decoder->scale_denominator;
+
 //  bool embeddedIccFlag = ReadICCProfileFromJPEG(&cinfo, &iccBuffer, &iccLen);
 //  bool embeddedXMPFlag = ReadXMPFromJPEG(&cinfo, xmpData);
 //  if (embeddedXMPFlag) {
@@ -201,126 +332,240 @@ struct heif_error jpeg_decode_image(void* decoder_raw, struct heif_image** out_i
 //  }
 
   if (cinfo.jpeg_color_space == JCS_GRAYSCALE) {
+    if (target && (heif_image_get_chroma_format(target) != heif_chroma_monochrome ||
+                   heif_image_get_bits_per_pixel_range(target, heif_channel_Y) != 8)) {
+      jpeg_destroy_decompress(&cinfo);
+      return error_target_format_mismatch;
+    }
+
     cinfo.out_color_space = JCS_GRAYSCALE;
 
     jpeg_start_decompress(&cinfo);
 
+    // Rows that do not fit into the target are decoded into this buffer.
+    const JDIMENSION max_rows = 16;
     JSAMPARRAY buffer;
     buffer = (*cinfo.mem->alloc_sarray)
-        ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+        ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, max_rows);
 
 
     // create destination image
 
-    struct heif_image* heif_img = nullptr;
-    struct heif_error err = heif_image_create(cinfo.output_width, cinfo.output_height,
-                                              heif_colorspace_monochrome,
-                                              heif_chroma_monochrome,
-                                              &heif_img);
-    if (err.code != heif_error_Ok) {
-      assert(heif_img==nullptr);
-      return err;
-    }
+    struct heif_image* heif_img = target;
+
+    if (!target) {
+      struct heif_error err = heif_image_create(cinfo.output_width, cinfo.output_height,
+                                                heif_colorspace_monochrome,
+                                                heif_chroma_monochrome,
+                                                &heif_img);
+      if (err.code != heif_error_Ok) {
+        assert(heif_img==nullptr);
+        return err;
+      }
 
-    heif_image_add_plane(heif_img, heif_channel_Y, cinfo.output_width, cinfo.output_height, 8);
+      heif_image_add_plane(heif_img, heif_channel_Y, cinfo.output_width, cinfo.output_height, 8);
+    }
 
     size_t y_stride;
-    uint8_t* py = heif_image_get_plane2(heif_img, heif_channel_Y, &y_stride);
+    uint32_t out_w, out_h;
+    uint8_t* py = get_target_plane_area(heif_img, heif_channel_Y, x0, y0, cinfo.output_width, cinfo.output_height,
+                                        &y_stride, &out_w, &out_h);
 
 
-    // read the image
+    // read the image, several rows at a time and directly into the target plane where the rows fit
+
+    JSAMPROW rows[max_rows];
 
     while (cinfo.output_scanline < cinfo.output_height) {
-      (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+      uint32_t y_start = cinfo.output_scanline;
+
+      for (JDIMENSION i = 0; i < max_rows; i++) {
+        uint32_t y = y_start + i;
+        rows[i] = (y < out_h && out_w == cinfo.output_width) ? py + y * y_stride : buffer[i];
+      }
 
-      memcpy(py + (cinfo.output_scanline - 1) * y_stride, *buffer, cinfo.output_width);
+      JDIMENSION n = jpeg_read_scanlines(&cinfo, rows, max_rows);
+      if (n == 0) {
+        break;
+      }
+
+      for (JDIMENSION i = 0; i < n; i++) {
+        uint32_t y = y_start + i;
+        if (y < out_h && rows[i] == buffer[i]) {
+          memcpy(py + y * y_stride, buffer[i], out_w);
+        }
+      }
     }
 
-    *out_img = heif_img;
+    if (!target) {
+      *out_img = heif_img;
+    }
   }
   else {
     cinfo.out_color_space = JCS_YCbCr;
 
+    // Read the components in their coded subsampling if possible. Otherwise, libjpeg upsamples the chroma and
+    // it is subsampled to 4:2:0 again below.
+
+    cinfo.raw_data_out = TRUE;
+    jpeg_calc_output_dimensions(&cinfo);
+
+    enum heif_chroma chroma = get_raw_output_chroma(cinfo);
+    if (chroma == heif_chroma_undefined) {
+      cinfo.raw_data_out = FALSE;
+      chroma = heif_chroma_420;
+    }
+
+    if (target && (heif_image_get_chroma_format(target) != chroma ||
+                   heif_image_get_bits_per_pixel_range(target, heif_channel_Y) != 8 ||
+                   heif_image_get_bits_per_pixel_range(target, heif_channel_Cb) != 8 ||
+                   heif_image_get_bits_per_pixel_range(target, heif_channel_Cr) != 8)) {
+      jpeg_destroy_decompress(&cinfo);
+      return error_target_format_mismatch;
+    }
+
     jpeg_start_decompress(&cinfo);
 
-    JSAMPARRAY buffer;
-    buffer = (*cinfo.mem->alloc_sarray)
-        ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+    uint32_t chroma_shift_x = (chroma == heif_chroma_444) ? 0 : 1;
+    uint32_t chroma_shift_y = (chroma == heif_chroma_420) ? 1 : 0;
+    uint32_t chroma_width = (cinfo.output_width + chroma_shift_x) >> chroma_shift_x;
+    uint32_t chroma_height = (cinfo.output_height + chroma_shift_y) >> chroma_shift_y;
 
 
     // create destination image
 
-    struct heif_image* heif_img = nullptr;
-    struct heif_error err = heif_image_create(cinfo.output_width, cinfo.output_height,
-                                              heif_colorspace_YCbCr,
-                                              heif_chroma_420,
-                                              &heif_img);
-    if (err.code != heif_error_Ok) {
-      assert(heif_img==nullptr);
-      return err;
-    }
+    struct heif_image* heif_img = target;
 
-    err = heif_image_add_plane(heif_img, heif_channel_Y, cinfo.output_width, cinfo.output_height, 8);
-    if (err.code) {
-      return err;
-    }
-    err = heif_image_add_plane(heif_img, heif_channel_Cb, (cinfo.output_width + 1) / 2, (cinfo.output_height + 1) / 2, 8);
-    if (err.code) {
-      return err;
-    }
-    err = heif_image_add_plane(heif_img, heif_channel_Cr, (cinfo.output_width + 1) / 2, (cinfo.output_height + 1) / 2, 8);
-    if (err.code) {
-      return err;
+    if (!target) {
+      struct heif_error err = heif_image_create(cinfo.output_width, cinfo.output_height,
+                                                heif_colorspace_YCbCr,
+                                                chroma,
+                                                &heif_img);
+      if (err.code != heif_error_Ok) {
+        assert(heif_img==nullptr);
+        return err;
+      }
+
+      err = heif_image_add_plane(heif_img, heif_channel_Y, cinfo.output_width, cinfo.output_height, 8);
+      if (err.code) {
+        return err;
+      }
+      err = heif_image_add_plane(heif_img, heif_channel_Cb, chroma_width, chroma_height, 8);
+      if (err.code) {
+        return err;
+      }
+      err = heif_image_add_plane(heif_img, heif_channel_Cr, chroma_width, chroma_height, 8);
+      if (err.code) {
+        return err;
+      }
     }
 
     size_t y_stride;
     size_t cb_stride;
     size_t cr_stride;
-    uint8_t* py = heif_image_get_plane2(heif_img, heif_channel_Y, &y_stride);
-    uint8_t* pcb = heif_image_get_plane2(heif_img, heif_channel_Cb, &cb_stride);
-    uint8_t* pcr = heif_image_get_plane2(heif_img, heif_channel_Cr, &cr_stride);
+    uint32_t out_w, out_h, out_cw, out_ch;
+    uint8_t* py = get_target_plane_area(heif_img, heif_channel_Y, x0, y0, cinfo.output_width, cinfo.output_height,
+                                        &y_stride, &out_w, &out_h);
+    uint8_t* pcb = get_target_plane_area(heif_img, heif_channel_Cb, x0 >> chroma_shift_x, y0 >> chroma_shift_y,
+                                         chroma_width, chroma_height,
+                                         &cb_stride, &out_cw, &out_ch);
+    uint8_t* pcr = get_target_plane_area(heif_img, heif_channel_Cr, x0 >> chroma_shift_x, y0 >> chroma_shift_y,
+                                         chroma_width, chroma_height,
+                                         &cr_stride, &out_cw, &out_ch);
 
     // read the image
 
-    //printf("jpeg size: %d %d\n",cinfo.output_width, cinfo.output_height);
+    if (cinfo.raw_data_out) {
+      // jpeg_read_raw_data() decodes one row of iMCUs per call. The components are decoded into buffers
+      // that cover the complete DCT blocks and are then copied into the target planes.
 
-    while (cinfo.output_scanline < cinfo.output_height) {
-      JOCTET* bufp;
+      uint8_t* planes[3] = {py, pcb, pcr};
+      size_t strides[3] = {y_stride, cb_stride, cr_stride};
+      uint32_t plane_widths[3] = {out_w, out_cw, out_cw};
+      uint32_t plane_heights[3] = {out_h, out_ch, out_ch};
 
-      (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+      JSAMPARRAY component_rows[3];
+      JDIMENSION rows_per_iMCU[3];
 
-      bufp = buffer[0];
+      for (int c = 0; c < 3; c++) {
+        jpeg_component_info* comp = &cinfo.comp_info[c];
+        rows_per_iMCU[c] = comp->v_samp_factor * DCT_V_SCALED_SIZE(comp);
+        component_rows[c] = (*cinfo.mem->alloc_sarray)
+            ((j_common_ptr) &cinfo, JPOOL_IMAGE, comp->width_in_blocks * DCT_H_SCALED_SIZE(comp), rows_per_iMCU[c]);
+      }
 
-      int y = cinfo.output_scanline - 1;
+      for (uint32_t iMCU_row = 0; cinfo.output_scanline < cinfo.output_height; iMCU_row++) {
+        if (jpeg_read_raw_data(&cinfo, component_rows, rows_per_iMCU[0]) == 0) {
+          break;
+        }
 
-      for (unsigned int x = 0; x < cinfo.output_width; x += 2) {
-        py[y * y_stride + x] = *bufp++;
-        pcb[y / 2 * cb_stride + x / 2] = *bufp++;
-        pcr[y / 2 * cr_stride + x / 2] = *bufp++;
+        for (int c = 0; c < 3; c++) {
+          for (JDIMENSION i = 0; i < rows_per_iMCU[c]; i++) {
+            uint32_t y = iMCU_row * rows_per_iMCU[c] + i;
+            if (y >= plane_heights[c]) {
+              break;
+            }
 
-        if (x + 1 < cinfo.output_width) {
-          py[y * y_stride + x + 1] = *bufp++;
+            memcpy(planes[c] + y * strides[c], component_rows[c][i], plane_widths[c]);
+          }
         }
-
-        bufp += 2;
       }
+    }
+    else {
+      JSAMPARRAY buffer;
+      buffer = (*cinfo.mem->alloc_sarray)
+          ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+
+      //printf("jpeg size: %d %d\n",cinfo.output_width, cinfo.output_height);
 
+      while (cinfo.output_scanline < cinfo.output_height) {
+        JOCTET* bufp;
 
-      if (cinfo.output_scanline < cinfo.output_height) {
         (void) jpeg_read_scanlines(&cinfo, buffer, 1);
 
         bufp = buffer[0];
 
-        y = cinfo.output_scanline - 1;
+        uint32_t y = cinfo.output_scanline - 1;
 
-        for (unsigned int x = 0; x < cinfo.output_width; x++) {
-          py[y * y_stride + x] = *bufp++;
-          bufp += 2;
+        if (y < out_h) {
+          for (uint32_t x = 0; x < out_w; x += 2) {
+            py[y * y_stride + x] = *bufp++;
+
+            if (x / 2 < out_cw && y / 2 < out_ch) {
+              pcb[y / 2 * cb_stride + x / 2] = bufp[0];
+              pcr[y / 2 * cr_stride + x / 2] = bufp[1];
+            }
+            bufp += 2;
+
+            if (x + 1 < out_w) {
+              py[y * y_stride + x + 1] = *bufp++;
+            }
+
+            bufp += 2;
+          }
+        }
+
+
+        if (cinfo.output_scanline < cinfo.output_height) {
+          (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+
+          bufp = buffer[0];
+
+          y = cinfo.output_scanline - 1;
+
+          if (y < out_h) {
+            for (uint32_t x = 0; x < out_w; x++) {
+              py[y * y_stride + x] = *bufp++;
+              bufp += 2;
+            }
+          }
         }
       }
     }
 
-    *out_img = heif_img;
+    if (!target) {
+      *out_img = heif_img;
+    }
   }
 
 //  if (embeddedIccFlag && iccLen > 0) {
@@ -338,9 +583,25 @@ struct heif_error jpeg_decode_image(void* decoder_raw, struct heif_image** out_i
 }
 
 
+struct heif_error jpeg_decode_image(void* decoder_raw, struct heif_image** out_img)
+{
+  struct jpeg_decoder* decoder = (struct jpeg_decoder*) decoder_raw;
+
+  return jpeg_decode(decoder, out_img, nullptr, 0, 0);
+}
+
+
+struct heif_error jpeg_decode_image_into(void* decoder_raw, struct heif_image* target, uint32_t x0, uint32_t y0)
+{
+  struct jpeg_decoder* decoder = (struct jpeg_decoder*) decoder_raw;
+
+  return jpeg_decode(decoder, nullptr, target, x0, y0);
+}
+
+
 static const struct heif_decoder_plugin decoder_jpeg
     {
-        3,
+        4,
         jpeg_plugin_name,
         jpeg_init_plugin,
         jpeg_deinit_plugin,
@@ -350,7 +611,14 @@ static const struct heif_decoder_plugin decoder_jpeg
         jpeg_push_data,
         jpeg_decode_image,
         jpeg_set_strict_decoding,
-        "jpeg"
+        "jpeg",
+        jpeg_set_target_scale_denominator,
+        jpeg_decode_image_into,
+        jpeg_reset_decoder,
+        nullptr,
+        nullptr,
+        nullptr,
+        jpeg_set_progressive_decoding
     };
 
 
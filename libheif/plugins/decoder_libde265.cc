@@ -26,6 +26,7 @@
 #include <assert.h>
 #include <memory>
 #include <cstring>
+#include <algorithm>
 
 #include <libde265/de265.h>
 
@@ -33,8 +34,16 @@
 
 struct libde265_decoder
 {
-  de265_decoder_context* ctx;
+  // Started with the first data, such that the worker threads are only started with the final number of threads.
+  de265_decoder_context* ctx = nullptr;
+  int num_worker_threads = 1;
   bool strict_decoding = false;
+
+  int (* decoding_callback)(float progress, void* callback_data) = nullptr;
+  void* decoding_callback_data = nullptr;
+
+  // The pushed images of the current batch are flushed with the first get_next_batch_image().
+  bool batch_flushed = false;
 };
 
 static const char kEmptyString[] = "";
@@ -85,6 +94,65 @@ static int libde265_does_support_format(enum heif_compression_format format)
 }
 
 
+static const heif_channel channel2plane[3] = {
+    heif_channel_Y,
+    heif_channel_Cb,
+    heif_channel_Cr
+};
+
+
+// Copies the planes of the de265_image into 'image', with the top-left corner at (x0,y0).
+// Parts that extend beyond the planes of 'image' are discarded.
+static struct heif_error copy_libde265_image_planes(const struct de265_image* de265img,
+                                                    struct heif_image* image,
+                                                    uint32_t x0, uint32_t y0)
+{
+  bool is_mono = (de265_get_chroma_format(de265img) == de265_chroma_mono);
+  int num_planes = (is_mono ? 1 : 3);
+
+  for (int c = 0; c < num_planes; c++) {
+    int stride;
+    const uint8_t* data = de265_get_image_plane(de265img, c, &stride);
+
+    int w = de265_get_image_width(de265img, c);
+    int h = de265_get_image_height(de265img, c);
+
+    uint32_t xs = x0, ys = y0;
+    if (c > 0) {
+      de265_chroma chroma = de265_get_chroma_format(de265img);
+      if (chroma == de265_chroma_420 || chroma == de265_chroma_422) {
+        xs /= 2;
+      }
+      if (chroma == de265_chroma_420) {
+        ys /= 2;
+      }
+    }
+
+    int target_w = heif_image_get_width(image, channel2plane[c]);
+    int target_h = heif_image_get_height(image, channel2plane[c]);
+    if (xs >= (uint32_t) target_w || ys >= (uint32_t) target_h) {
+      continue;
+    }
+
+    int copy_w = std::min(w, target_w - (int) xs);
+    int copy_h = std::min(h, target_h - (int) ys);
+
+    int bpp = de265_get_bits_per_pixel(de265img, c);
+    int bytes_per_pixel = (bpp + 7) / 8;
+
+    size_t dst_stride;
+    uint8_t* dst_mem = heif_image_get_plane2(image, channel2plane[c], &dst_stride);
+    dst_mem += ys * dst_stride + xs * bytes_per_pixel;
+
+    for (int y = 0; y < copy_h; y++) {
+      memcpy(dst_mem + y * dst_stride, data + y * stride, copy_w * bytes_per_pixel);
+    }
+  }
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
 static struct heif_error convert_libde265_image_to_heif_image(struct libde265_decoder* decoder,
                                                               const struct de265_image* de265img,
                                                               struct heif_image** image)
@@ -103,13 +171,6 @@ static struct heif_error convert_libde265_image_to_heif_image(struct libde265_de
 
   // --- transfer data from de265_image to HeifPixelImage
 
-  heif_channel channel2plane[3] = {
-      heif_channel_Y,
-      heif_channel_Cb,
-      heif_channel_Cr
-  };
-
-
   int bpp = de265_get_bits_per_pixel(de265img, 0);
 
   int num_planes = (is_mono ? 1 : 3);
@@ -123,9 +184,6 @@ static struct heif_error convert_libde265_image_to_heif_image(struct libde265_de
       return err;
     }
 
-    int stride;
-    const uint8_t* data = de265_get_image_plane(de265img, c, &stride);
-
     int w = de265_get_image_width(de265img, c);
     int h = de265_get_image_height(de265img, c);
     if (w <= 0 || h <= 0) {
@@ -141,37 +199,63 @@ static struct heif_error convert_libde265_image_to_heif_image(struct libde265_de
       heif_image_release(*image);
       return err;
     }
+  }
 
-    size_t dst_stride;
-    uint8_t* dst_mem = heif_image_get_plane2(*image, channel2plane[c], &dst_stride);
+  return copy_libde265_image_planes(de265img, *image, 0, 0);
+}
 
-    int bytes_per_pixel = (bpp + 7) / 8;
 
-    for (int y = 0; y < h; y++) {
-      memcpy(dst_mem + y * dst_stride, data + y * stride, w * bytes_per_pixel);
-    }
+// Checks that the de265_image can be copied into 'target' without conversion.
+static bool libde265_image_matches_target(const struct de265_image* de265img, const struct heif_image* target)
+{
+  bool is_mono = (de265_get_chroma_format(de265img) == de265_chroma_mono);
+
+  if (heif_image_get_chroma_format(target) != (heif_chroma) de265_get_chroma_format(de265img)) {
+    return false;
   }
 
+  int num_planes = (is_mono ? 1 : 3);
 
-  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  for (int c = 0; c < num_planes; c++) {
+    if (heif_image_get_bits_per_pixel_range(target, channel2plane[c]) != de265_get_bits_per_pixel(de265img, c)) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 
-static struct heif_error libde265_new_decoder(void** dec)
+static de265_decoder_context* new_libde265_context(int num_worker_threads)
 {
-  struct libde265_decoder* decoder = new libde265_decoder();
-  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
-
-  decoder->ctx = de265_new_decoder();
+  de265_decoder_context* ctx = de265_new_decoder();
 #if defined(__EMSCRIPTEN__)
   // Speed up decoding from JavaScript.
-  de265_set_parameter_bool(decoder->ctx, DE265_DECODER_PARAM_DISABLE_DEBLOCKING, 1);
-  de265_set_parameter_bool(decoder->ctx, DE265_DECODER_PARAM_DISABLE_SAO, 1);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DISABLE_DEBLOCKING, 1);
+  de265_set_parameter_bool(ctx, DE265_DECODER_PARAM_DISABLE_SAO, 1);
+  (void) num_worker_threads;
 #else
   // Worker threads are not supported when running on Emscripten.
-  de265_start_worker_threads(decoder->ctx, 1);
+  de265_start_worker_threads(ctx, num_worker_threads);
 #endif
 
+  return ctx;
+}
+
+
+static void start_libde265_context_if_needed(libde265_decoder* decoder)
+{
+  if (!decoder->ctx) {
+    decoder->ctx = new_libde265_context(decoder->num_worker_threads);
+  }
+}
+
+
+static struct heif_error libde265_new_decoder(void** dec)
+{
+  struct libde265_decoder* decoder = new libde265_decoder();
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+
   *dec = decoder;
   return err;
 }
@@ -180,8 +264,10 @@ static void libde265_free_decoder(void* decoder_raw)
 {
   struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
 
-  de265_error err = de265_free_decoder(decoder->ctx);
-  (void) err;
+  if (decoder->ctx) {
+    de265_error err = de265_free_decoder(decoder->ctx);
+    (void) err;
+  }
 
   delete decoder;
 }
@@ -195,12 +281,37 @@ void libde265_set_strict_decoding(void* decoder_raw, int flag)
 }
 
 
+static struct heif_error libde265_set_num_threads(void* decoder_raw, int num_threads)
+{
+  struct libde265_decoder* decoder = (libde265_decoder*) decoder_raw;
+
+  // libde265 limits the number of worker threads
+  num_threads = std::min(std::max(num_threads, 1), 32);
+
+  if (num_threads != decoder->num_worker_threads) {
+    // The worker threads cannot be changed after they were started. Start again with a new decoder context.
+    if (decoder->ctx) {
+      de265_error err = de265_free_decoder(decoder->ctx);
+      (void) err;
+
+      decoder->ctx = nullptr;
+    }
+
+    decoder->num_worker_threads = num_threads;
+  }
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
 #if LIBDE265_NUMERIC_VERSION >= 0x02000000
 
 static struct heif_error libde265_v2_push_data(void* decoder_raw, const void* data, size_t size)
 {
   struct libde265_decoder* decoder = (struct libde265_decoder*)decoder_raw;
 
+  start_libde265_context_if_needed(decoder);
+
   const uint8_t* cdata = (const uint8_t*)data;
 
   size_t ptr=0;
@@ -242,6 +353,8 @@ static struct heif_error libde265_v2_decode_image(void* decoder_raw,
 {
   struct libde265_decoder* decoder = (struct libde265_decoder*)decoder_raw;
 
+  start_libde265_context_if_needed(decoder);
+
   de265_push_end_of_stream(decoder->ctx);
 
   int action = de265_get_action(decoder->ctx, 1);
@@ -270,6 +383,8 @@ static struct heif_error libde265_v1_push_data(void* decoder_raw, const void* da
 {
   struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
 
+  start_libde265_context_if_needed(decoder);
+
   const uint8_t* cdata = (const uint8_t*) data;
 
   size_t ptr = 0;
@@ -303,12 +418,48 @@ static struct heif_error libde265_v1_push_data(void* decoder_raw, const void* da
 }
 
 
+// Sets the nclx profile of the bitstream. In strict mode, the image is released if the profile is invalid.
+static struct heif_error set_libde265_nclx_color_profile(struct libde265_decoder* decoder,
+                                                        const struct de265_image* image,
+                                                        struct heif_image** out_img)
+{
+  struct heif_color_profile_nclx* nclx = heif_nclx_color_profile_alloc();
+#if LIBDE265_NUMERIC_VERSION >= 0x01000700
+  HEIF_WARN_OR_FAIL(decoder->strict_decoding, *out_img, heif_nclx_color_profile_set_color_primaries(nclx, static_cast<uint16_t>(de265_get_image_colour_primaries(image))),
+                    {
+                      heif_nclx_color_profile_free(nclx);
+                      heif_image_release(*out_img);
+                      *out_img = nullptr;
+                    });
+  HEIF_WARN_OR_FAIL(decoder->strict_decoding, *out_img, heif_nclx_color_profile_set_transfer_characteristics(nclx, static_cast<uint16_t>(de265_get_image_transfer_characteristics(image))),
+                    {
+                      heif_nclx_color_profile_free(nclx);
+                      heif_image_release(*out_img);
+                      *out_img = nullptr;
+                    });
+  HEIF_WARN_OR_FAIL(decoder->strict_decoding, *out_img, heif_nclx_color_profile_set_matrix_coefficients(nclx, static_cast<uint16_t>(de265_get_image_matrix_coefficients(image))),
+                    {
+                      heif_nclx_color_profile_free(nclx);
+                      heif_image_release(*out_img);
+                      *out_img = nullptr;
+                    });
+  nclx->full_range_flag = (bool) de265_get_image_full_range_flag(image);
+#endif
+  heif_image_set_nclx_color_profile(*out_img, nclx);
+  heif_nclx_color_profile_free(nclx);
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
 static struct heif_error libde265_v1_decode_image(void* decoder_raw,
                                                   struct heif_image** out_img)
 {
   struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
   struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
 
+  start_libde265_context_if_needed(decoder);
+
   de265_flush_data(decoder->ctx);
 
   // TODO(farindk): Set "err" if no image was decoded.
@@ -316,6 +467,16 @@ static struct heif_error libde265_v1_decode_image(void* decoder_raw,
   de265_error decode_err;
   *out_img = nullptr;
   do {
+    // de265_decode() decodes one NAL unit at a time. Decoding can be canceled between the slices.
+    if (decoder->decoding_callback && decoder->decoding_callback(-1.0f, decoder->decoding_callback_data)) {
+      if (*out_img) {
+        heif_image_release(*out_img);
+        *out_img = nullptr;
+      }
+
+      return {heif_error_Canceled, heif_suberror_Unspecified, kEmptyString};
+    }
+
     more = 0;
     decode_err = de265_decode(decoder->ctx, &more);
     if (decode_err != DE265_OK) {
@@ -336,30 +497,10 @@ static struct heif_error libde265_v1_decode_image(void* decoder_raw,
         return err;
       }
 
-      struct heif_color_profile_nclx* nclx = heif_nclx_color_profile_alloc();
-#if LIBDE265_NUMERIC_VERSION >= 0x01000700
-      HEIF_WARN_OR_FAIL(decoder->strict_decoding, *out_img, heif_nclx_color_profile_set_color_primaries(nclx, static_cast<uint16_t>(de265_get_image_colour_primaries(image))),
-                        {
-                          heif_nclx_color_profile_free(nclx);
-                          heif_image_release(*out_img);
-                          *out_img = nullptr;
-                        });
-      HEIF_WARN_OR_FAIL(decoder->strict_decoding, *out_img, heif_nclx_color_profile_set_transfer_characteristics(nclx, static_cast<uint16_t>(de265_get_image_transfer_characteristics(image))),
-                        {
-                          heif_nclx_color_profile_free(nclx);
-                          heif_image_release(*out_img);
-                          *out_img = nullptr;
-                        });
-      HEIF_WARN_OR_FAIL(decoder->strict_decoding, *out_img, heif_nclx_color_profile_set_matrix_coefficients(nclx, static_cast<uint16_t>(de265_get_image_matrix_coefficients(image))),
-                        {
-                          heif_nclx_color_profile_free(nclx);
-                          heif_image_release(*out_img);
-                          *out_img = nullptr;
-                        });
-      nclx->full_range_flag = (bool) de265_get_image_full_range_flag(image);
-#endif
-      heif_image_set_nclx_color_profile(*out_img, nclx);
-      heif_nclx_color_profile_free(nclx);
+      err = set_libde265_nclx_color_profile(decoder, image, out_img);
+      if (err.code != heif_error_Ok) {
+        return err;
+      }
 
       de265_release_next_picture(decoder->ctx);
     }
@@ -369,6 +510,215 @@ static struct heif_error libde265_v1_decode_image(void* decoder_raw,
 }
 
 
+static struct heif_error libde265_v1_decode_image_into(void* decoder_raw,
+                                                       struct heif_image* target,
+                                                       uint32_t x0, uint32_t y0)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+
+  start_libde265_context_if_needed(decoder);
+
+  de265_flush_data(decoder->ctx);
+
+  bool image_decoded = false;
+  int more;
+  de265_error decode_err;
+  do {
+    // de265_decode() decodes one NAL unit at a time. Decoding can be canceled between the slices.
+    if (decoder->decoding_callback && decoder->decoding_callback(-1.0f, decoder->decoding_callback_data)) {
+      return {heif_error_Canceled, heif_suberror_Unspecified, kEmptyString};
+    }
+
+    more = 0;
+    decode_err = de265_decode(decoder->ctx, &more);
+    if (decode_err != DE265_OK) {
+      break;
+    }
+
+    const struct de265_image* image = de265_get_next_picture(decoder->ctx);
+    if (image) {
+      if (!libde265_image_matches_target(image, target)) {
+        de265_release_next_picture(decoder->ctx);
+        return {heif_error_Unsupported_feature,
+                heif_suberror_Unsupported_color_conversion,
+                "Decoded image format does not match the target image"};
+      }
+
+      err = copy_libde265_image_planes(image, target, x0, y0);
+
+      de265_release_next_picture(decoder->ctx);
+
+      if (err.code != heif_error_Ok) {
+        return err;
+      }
+
+      image_decoded = true;
+    }
+  } while (more);
+
+  if (!image_decoded) {
+    return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, kEmptyString};
+  }
+
+  return err;
+}
+
+
+// --- sequences with inter-frame prediction
+//
+// The samples are pushed as they come and libde265 outputs the pictures in presentation order.
+// The sample's user_data is passed through the PTS of the NAL units.
+
+static struct heif_error libde265_v1_push_sequence_sample(void* decoder_raw, const void* data, size_t size, uintptr_t user_data)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+
+  start_libde265_context_if_needed(decoder);
+
+  const uint8_t* cdata = (const uint8_t*) data;
+
+  size_t ptr = 0;
+  while (ptr < size) {
+    if (4 > size - ptr) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_End_of_data, kEmptyString};
+    }
+
+    uint32_t nal_size = static_cast<uint32_t>((cdata[ptr] << 24) | (cdata[ptr + 1] << 16) | (cdata[ptr + 2] << 8) | (cdata[ptr + 3]));
+    ptr += 4;
+
+    if (nal_size > size - ptr) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_End_of_data, kEmptyString};
+    }
+
+    de265_error push_err = de265_push_NAL(decoder->ctx, cdata + ptr, nal_size, static_cast<de265_PTS>(user_data), nullptr);
+    if (push_err != DE265_OK) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, de265_get_error_text(push_err)};
+    }
+
+    ptr += nal_size;
+  }
+
+  de265_push_end_of_frame(decoder->ctx);
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
+static struct heif_error libde265_v1_flush_sequence(void* decoder_raw)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+
+  start_libde265_context_if_needed(decoder);
+
+  de265_flush_data(decoder->ctx);
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
+static struct heif_error libde265_v1_get_next_sequence_image(void* decoder_raw, struct heif_image** out_img, uintptr_t* out_user_data)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+
+  start_libde265_context_if_needed(decoder);
+
+  *out_img = nullptr;
+
+  for (;;) {
+    const struct de265_image* image = de265_peek_next_picture(decoder->ctx);
+    if (image) {
+      struct heif_error err = convert_libde265_image_to_heif_image(decoder, image, out_img);
+      if (err.code == heif_error_Ok) {
+        err = set_libde265_nclx_color_profile(decoder, image, out_img);
+      }
+
+      *out_user_data = static_cast<uintptr_t>(de265_get_image_PTS(image));
+
+      de265_release_next_picture(decoder->ctx);
+      return err;
+    }
+
+    int more = 0;
+    de265_error decode_err = de265_decode(decoder->ctx, &more);
+    if (decode_err == DE265_ERROR_WAITING_FOR_INPUT_DATA) {
+      // all pushed samples are decoded
+      return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+    }
+    else if (decode_err != DE265_OK) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, de265_get_error_text(decode_err)};
+    }
+
+    if (!more && !de265_peek_next_picture(decoder->ctx)) {
+      // end of the flushed sequence
+      return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+    }
+  }
+}
+
+
+// --- batch decoding of independent images
+//
+// The images are pushed like the samples of a sequence, each with its own parameter sets. libde265 decodes
+// them one after the other in the same context, without starting a new decoder for each image.
+
+static struct heif_error libde265_v1_push_batch_image(void* decoder_raw, const void* data, size_t size, uintptr_t image_id)
+{
+  return libde265_v1_push_sequence_sample(decoder_raw, data, size, image_id);
+}
+
+
+static struct heif_error libde265_v1_get_next_batch_image(void* decoder_raw, struct heif_image** out_img, uintptr_t* out_image_id)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+
+  start_libde265_context_if_needed(decoder);
+
+  if (!decoder->batch_flushed) {
+    de265_flush_data(decoder->ctx);
+    decoder->batch_flushed = true;
+  }
+
+  struct heif_error err = libde265_v1_get_next_sequence_image(decoder_raw, out_img, out_image_id);
+
+  if (err.code == heif_error_Ok && *out_img == nullptr) {
+    // The batch is complete. Reopen the input for the next batch.
+    de265_reset(decoder->ctx);
+    decoder->batch_flushed = false;
+  }
+
+  return err;
+}
+
+
+static struct heif_error libde265_v1_reset_decoder(void* decoder_raw)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+
+  // Removes all pending input data and pictures. The parameter sets are sent again with the next image.
+  if (decoder->ctx) {
+    de265_reset(decoder->ctx);
+  }
+
+  decoder->strict_decoding = false;
+  decoder->batch_flushed = false;
+  decoder->decoding_callback = nullptr;
+  decoder->decoding_callback_data = nullptr;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
+static void libde265_v1_set_decoding_callback(void* decoder_raw, int (* callback)(float progress, void* callback_data),
+                                              void* callback_data)
+{
+  struct libde265_decoder* decoder = (struct libde265_decoder*) decoder_raw;
+
+  decoder->decoding_callback = callback;
+  decoder->decoding_callback_data = callback_data;
+}
+
 #endif
 
 
@@ -391,7 +741,7 @@ static const struct heif_decoder_plugin decoder_libde265
 
 static const struct heif_decoder_plugin decoder_libde265
     {
-        3,
+        4,
         libde265_plugin_name,
         libde265_init_plugin,
         libde265_deinit_plugin,
@@ -401,7 +751,21 @@ static const struct heif_decoder_plugin decoder_libde265
         libde265_v1_push_data,
         libde265_v1_decode_image,
         libde265_set_strict_decoding,
-        "libde265"
+        "libde265",
+        nullptr,
+        libde265_v1_decode_image_into,
+        libde265_v1_reset_decoder,
+        libde265_set_num_threads,
+        nullptr,
+        nullptr,
+        nullptr,
+        libde265_v1_push_sequence_sample,
+        libde265_v1_flush_sequence,
+        libde265_v1_get_next_sequence_image,
+        nullptr,
+        libde265_v1_set_decoding_callback,
+        libde265_v1_push_batch_image,
+        libde265_v1_get_next_batch_image
     };
 
 #endif
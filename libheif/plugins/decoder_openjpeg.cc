@@ -36,6 +36,23 @@ struct openjpeg_decoder
 {
   std::vector<uint8_t> encoded_data;
   size_t read_position = 0;
+
+  // The image is decoded with the resolution reduced by 2^reduce_levels, if the codestream has enough resolution levels.
+  int reduce_levels = 0;
+
+  int num_threads = 0;
+
+  // Only this area (in full-resolution image samples) is decoded, when set.
+  bool has_decode_area = false;
+  uint32_t area_x0 = 0, area_y0 = 0, area_width = 0, area_height = 0;
+
+  // progressive decoding
+  int max_quality_layers = 0;
+  bool data_is_truncated = false;
+
+  int (* decoding_callback)(float progress, void* callback_data) = nullptr;
+  void* decoding_callback_data = nullptr;
+  bool canceled = false;
 };
 
 
@@ -103,6 +120,52 @@ void openjpeg_set_strict_decoding(void* decoder_raw, int flag)
 }
 
 
+void openjpeg_set_target_scale_denominator(void* decoder_raw, int denominator)
+{
+  struct openjpeg_decoder* decoder = (openjpeg_decoder*) decoder_raw;
+
+  decoder->reduce_levels = 0;
+  while (decoder->reduce_levels < 3 && (2 << decoder->reduce_levels) <= denominator) {
+    decoder->reduce_levels++;
+  }
+}
+
+
+struct heif_error openjpeg_set_num_threads(void* decoder_raw, int num_threads)
+{
+  struct openjpeg_decoder* decoder = (openjpeg_decoder*) decoder_raw;
+
+  decoder->num_threads = num_threads;
+
+  return heif_error_ok;
+}
+
+
+struct heif_error openjpeg_set_decode_area(void* decoder_raw, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height)
+{
+  struct openjpeg_decoder* decoder = (openjpeg_decoder*) decoder_raw;
+
+  decoder->has_decode_area = true;
+  decoder->area_x0 = x0;
+  decoder->area_y0 = y0;
+  decoder->area_width = width;
+  decoder->area_height = height;
+
+  return heif_error_ok;
+}
+
+
+struct heif_error openjpeg_set_progressive_decoding(void* decoder_raw, int max_quality_layers, int data_is_truncated)
+{
+  struct openjpeg_decoder* decoder = (openjpeg_decoder*) decoder_raw;
+
+  decoder->max_quality_layers = max_quality_layers;
+  decoder->data_is_truncated = data_is_truncated;
+
+  return heif_error_ok;
+}
+
+
 struct heif_error openjpeg_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
 {
   struct openjpeg_decoder* decoder = (struct openjpeg_decoder*) decoder_raw;
@@ -114,6 +177,15 @@ struct heif_error openjpeg_push_data(void* decoder_raw, const void* frame_data,
 }
 
 
+void openjpeg_set_decoding_callback(void* decoder_raw, int (* callback)(float progress, void* callback_data), void* callback_data)
+{
+  struct openjpeg_decoder* decoder = (openjpeg_decoder*) decoder_raw;
+
+  decoder->decoding_callback = callback;
+  decoder->decoding_callback_data = callback_data;
+}
+
+
 //**************************************************************************
 
 //  This will read from our memory to the buffer.
@@ -131,6 +203,16 @@ static OPJ_SIZE_T opj_memory_stream_read(void* p_buffer, OPJ_SIZE_T p_nb_bytes,
     return (OPJ_SIZE_T) -1;
   }
 
+  // OpenJPEG reads the data of each codestream tile before decoding it. Canceling ends the stream.
+
+  if (decoder->decoding_callback) {
+    float progress = (float) decoder->read_position / (float) data_size;
+    if (decoder->canceled || decoder->decoding_callback(progress, decoder->decoding_callback_data)) {
+      decoder->canceled = true;
+      return (OPJ_SIZE_T) -1;
+    }
+  }
+
   // Check if we are reading more than we have.
 
   if (p_nb_bytes > (data_size - decoder->read_position)) {
@@ -225,7 +307,10 @@ opj_stream_t* opj_stream_create_default_memory_stream(openjpeg_decoder* p_decode
 {
   opj_stream_t* stream;
 
-  if (!(stream = opj_stream_default_create(p_is_read_stream))) {
+  // With a cancellation callback, the data is read in smaller chunks, such that it is checked more often.
+  OPJ_SIZE_T chunk_size = p_decoder->decoding_callback ? 64 * 1024 : OPJ_J2K_STREAM_CHUNK_SIZE;
+
+  if (!(stream = opj_stream_create(chunk_size, p_is_read_stream))) {
     return nullptr;
   }
 
@@ -264,12 +349,31 @@ struct heif_error openjpeg_decode_image(void* decoder_raw, struct heif_image** o
 
   // Initialize Decoder
   opj_set_default_decoder_parameters(&decompression_parameters);
+  if (decoder->max_quality_layers > 0) {
+    decompression_parameters.cp_layer = (OPJ_UINT32) decoder->max_quality_layers;
+  }
+
   success = opj_setup_decoder(l_codec.get(), &decompression_parameters);
   if (!success) {
     struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "opj_setup_decoder()"};
     return err;
   }
 
+  // Since OpenJPEG 2.5, truncated codestreams are only decoded in non-strict mode.
+#if (OPJ_VERSION_MAJOR > 2) || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 5)
+  if (decoder->data_is_truncated) {
+    opj_decoder_set_strict_mode(l_codec.get(), OPJ_FALSE);
+  }
+#endif
+
+  // The code-blocks of each codestream tile are decoded in parallel.
+  // This has to be set before reading the header.
+#if (OPJ_VERSION_MAJOR > 2) || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 3)
+  if (decoder->num_threads > 1 && opj_has_thread_support()) {
+    opj_codec_set_threads(l_codec.get(), decoder->num_threads);
+  }
+#endif
+
 
   // Create Input Stream
 
@@ -281,6 +385,11 @@ struct heif_error openjpeg_decode_image(void* decoder_raw, struct heif_image** o
   // Read Codestream Header
   opj_image_t* image_ptr = nullptr;
   success = opj_read_header(stream.get(), l_codec.get(), &image_ptr);
+  if (decoder->canceled) {
+    opj_image_destroy(image_ptr);
+    struct heif_error err = {heif_error_Canceled, heif_suberror_Unspecified, "Decoding was canceled"};
+    return err;
+  }
   if (!success) {
     struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "opj_read_header()"};
     return err;
@@ -299,19 +408,58 @@ struct heif_error openjpeg_decode_image(void* decoder_raw, struct heif_image** o
     return err;
   }
 
-  const int width = (image->x1 - image->x0);
-  const int height = (image->y1 - image->y0);
+  // --- reduced-resolution decoding
+  // The number of resolution levels is only known after reading the header. Lower resolution
+  // reductions, down to full resolution, are tried when there are not enough levels.
+
+  int reduce_levels = decoder->reduce_levels;
+  while (reduce_levels > 0 && !opj_set_decoded_resolution_factor(l_codec.get(), reduce_levels)) {
+    reduce_levels--;
+  }
+
+  // --- decode only the codestream tiles intersecting with the area
+  // The area is given relative to the image origin on the reference grid.
+
+  if (decoder->has_decode_area) {
+    if (decoder->area_width > image->x1 - image->x0 - decoder->area_x0 ||
+        decoder->area_height > image->y1 - image->y0 - decoder->area_y0 ||
+        decoder->area_x0 >= image->x1 - image->x0 ||
+        decoder->area_y0 >= image->y1 - image->y0) {
+      struct heif_error err = {heif_error_Usage_error, heif_suberror_Invalid_parameter_value, "Decoding area is outside of the image"};
+      return err;
+    }
+
+    success = opj_set_decode_area(l_codec.get(), image.get(),
+                                  (OPJ_INT32) (image->x0 + decoder->area_x0),
+                                  (OPJ_INT32) (image->y0 + decoder->area_y0),
+                                  (OPJ_INT32) (image->x0 + decoder->area_x0 + decoder->area_width),
+                                  (OPJ_INT32) (image->y0 + decoder->area_y0 + decoder->area_height));
+    if (!success) {
+      struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "opj_set_decode_area()"};
+      return err;
+    }
+  }
+
+  // Reduced image sizes are rounded up on the reference grid.
+  const OPJ_UINT32 f = 1U << reduce_levels;
+  const int width = (int) (((image->x1 + f - 1) >> reduce_levels) - ((image->x0 + f - 1) >> reduce_levels));
+  const int height = (int) (((image->y1 + f - 1) >> reduce_levels) - ((image->y0 + f - 1) >> reduce_levels));
 
 
   /* Get the decoded image */
   success = opj_decode(l_codec.get(), stream.get(), image.get());
+  if (decoder->canceled) {
+    struct heif_error err = {heif_error_Canceled, heif_suberror_Unspecified, "Decoding was canceled"};
+    return err;
+  }
   if (!success) {
     struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "opj_decode()"};
     return err;
   }
 
 
-  success = opj_end_decompress(l_codec.get(), stream.get());
+  // The end of a truncated codestream is missing.
+  success = decoder->data_is_truncated || opj_end_decompress(l_codec.get(), stream.get());
   if (!success) {
     struct heif_error err = {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "opj_end_decompress()"};
     return err;
@@ -398,7 +546,7 @@ struct heif_error openjpeg_decode_image(void* decoder_raw, struct heif_image** o
 
 
 static const struct heif_decoder_plugin decoder_openjpeg{
-    3,
+    4,
     openjpeg_plugin_name,
     openjpeg_init_plugin,
     openjpeg_deinit_plugin,
@@ -408,7 +556,19 @@ static const struct heif_decoder_plugin decoder_openjpeg{
     openjpeg_push_data,
     openjpeg_decode_image,
     openjpeg_set_strict_decoding,
-    "openjpeg"
+    "openjpeg",
+    openjpeg_set_target_scale_denominator,
+    nullptr,
+    nullptr,
+    openjpeg_set_num_threads,
+    nullptr,
+    openjpeg_set_decode_area,
+    openjpeg_set_progressive_decoding,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    openjpeg_set_decoding_callback
 };
 
 const struct heif_decoder_plugin* get_decoder_plugin_openjpeg()
@@ -0,0 +1,368 @@
+/*
+ * OpenJPH codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libheif/heif.h"
+#include "libheif/heif_plugin.h"
+#include "decoder_openjph.h"
+
+#include "openjph/ojph_mem.h"
+#include "openjph/ojph_defs.h"
+#include "openjph/ojph_file.h"
+#include "openjph/ojph_codestream.h"
+#include "openjph/ojph_params.h"
+#include "openjph/ojph_version.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+// OpenJPH only decodes HT code-blocks. Plain JPEG 2000 is left to OpenJPEG.
+// For HTJ2K, it is preferred over OpenJPEG (priority 90), as it is considerably faster.
+static const int OPENJPH_PLUGIN_PRIORITY_HTJ2K = 100;
+
+struct openjph_decoder
+{
+  std::vector<uint8_t> encoded_data;
+
+  bool strict_decoding = false;
+
+  // The image is decoded with the resolution reduced by 2^reduce_levels, if the codestream has enough resolution levels.
+  int reduce_levels = 0;
+
+  // OpenJPH reports errors with exceptions. We keep a copy of the message for the returned heif_error.
+  std::string error_message;
+};
+
+
+#define MAX_PLUGIN_NAME_LENGTH 80
+static char plugin_name[MAX_PLUGIN_NAME_LENGTH];
+
+static const char* openjph_plugin_name()
+{
+  snprintf(plugin_name, MAX_PLUGIN_NAME_LENGTH,
+           "OpenJPH %s.%s.%s",
+           OJPH_INT_TO_STRING(OPENJPH_VERSION_MAJOR),
+           OJPH_INT_TO_STRING(OPENJPH_VERSION_MINOR),
+           OJPH_INT_TO_STRING(OPENJPH_VERSION_PATCH));
+  plugin_name[MAX_PLUGIN_NAME_LENGTH - 1] = 0;
+
+  return plugin_name;
+}
+
+
+static void openjph_init_plugin()
+{
+}
+
+
+static void openjph_deinit_plugin()
+{
+}
+
+
+static int openjph_does_support_format(enum heif_compression_format format)
+{
+  if (format == heif_compression_HTJ2K) {
+    return OPENJPH_PLUGIN_PRIORITY_HTJ2K;
+  }
+  else {
+    return 0;
+  }
+}
+
+
+static struct heif_error openjph_new_decoder(void** dec)
+{
+  auto* decoder = new openjph_decoder();
+
+  *dec = decoder;
+
+  return heif_error_ok;
+}
+
+
+static void openjph_free_decoder(void* decoder_raw)
+{
+  auto* decoder = (openjph_decoder*) decoder_raw;
+
+  delete decoder;
+}
+
+
+static void openjph_set_strict_decoding(void* decoder_raw, int flag)
+{
+  auto* decoder = (openjph_decoder*) decoder_raw;
+
+  decoder->strict_decoding = flag;
+}
+
+
+static void openjph_set_target_scale_denominator(void* decoder_raw, int denominator)
+{
+  auto* decoder = (openjph_decoder*) decoder_raw;
+
+  decoder->reduce_levels = 0;
+  while (decoder->reduce_levels < 3 && (2 << decoder->reduce_levels) <= denominator) {
+    decoder->reduce_levels++;
+  }
+}
+
+
+static struct heif_error openjph_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
+{
+  auto* decoder = (openjph_decoder*) decoder_raw;
+  const auto* frame_data_src = (const uint8_t*) frame_data;
+
+  decoder->encoded_data.insert(decoder->encoded_data.end(), frame_data_src, frame_data_src + frame_size);
+
+  return heif_error_ok;
+}
+
+
+static struct heif_error openjph_reset_decoder(void* decoder_raw)
+{
+  auto* decoder = (openjph_decoder*) decoder_raw;
+
+  decoder->encoded_data.clear();
+  decoder->strict_decoding = false;
+  decoder->reduce_levels = 0;
+
+  return heif_error_ok;
+}
+
+
+// Copies one decoded line into the image plane, clamped to the range of the bit depth.
+template <typename T>
+static void openjph_copy_line(const ojph::line_buf* line, T* out, uint32_t width, int bit_depth)
+{
+  const ojph::si32 max_value = (ojph::si32) ((1U << bit_depth) - 1);
+  const ojph::si32* in = line->i32;
+
+  for (uint32_t x = 0; x < width; x++) {
+    out[x] = (T) std::clamp(in[x], (ojph::si32) 0, max_value);
+  }
+}
+
+
+static struct heif_error openjph_decode_codestream(openjph_decoder* decoder, struct heif_image** out_img)
+{
+  ojph::mem_infile infile;
+  infile.open(decoder->encoded_data.data(), decoder->encoded_data.size());
+
+  ojph::codestream codestream;
+
+  if (!decoder->strict_decoding) {
+    codestream.enable_resilience();
+  }
+
+  codestream.read_headers(&infile);
+
+  ojph::param_siz siz = codestream.access_siz();
+  ojph::param_cod cod = codestream.access_cod();
+
+  const ojph::ui32 num_components = siz.get_num_components();
+
+  heif_colorspace colorspace;
+  heif_chroma chroma;
+  std::vector<heif_channel> channels;
+
+  if (num_components == 1) {
+    colorspace = heif_colorspace_monochrome;
+    chroma = heif_chroma_monochrome;
+    channels = {heif_channel_Y};
+  }
+  else if (num_components == 3) {
+    ojph::point ds0 = siz.get_downsampling(0);
+    ojph::point ds1 = siz.get_downsampling(1);
+    ojph::point ds2 = siz.get_downsampling(2);
+
+    if (ds0.x != 1 || ds0.y != 1 || ds1.x != ds2.x || ds1.y != ds2.y) {
+      return {heif_error_Unsupported_feature, heif_suberror_Unsupported_data_version, "Unsupported component subsampling"};
+    }
+
+    colorspace = heif_colorspace_YCbCr;
+    channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+
+    if (ds1.x == 1 && ds1.y == 1) {
+      chroma = heif_chroma_444;
+    }
+    else if (ds1.x == 2 && ds1.y == 1) {
+      chroma = heif_chroma_422;
+    }
+    else if (ds1.x == 2 && ds1.y == 2) {
+      chroma = heif_chroma_420;
+    }
+    else {
+      return {heif_error_Unsupported_feature, heif_suberror_Unsupported_data_version, "Unsupported component subsampling"};
+    }
+  }
+  else {
+    return {heif_error_Unsupported_feature, heif_suberror_Unsupported_data_version, "Number of components must be 3 or 1"};
+  }
+
+  for (ojph::ui32 c = 0; c < num_components; c++) {
+    if (siz.is_signed(c) || siz.get_bit_depth(c) > 16) {
+      return {heif_error_Unsupported_feature, heif_suberror_Unsupported_bit_depth, "Only unsigned components with up to 16 bits are supported"};
+    }
+  }
+
+
+  // --- reduced-resolution decoding
+
+  ojph::ui32 reduce_levels = std::min((ojph::ui32) decoder->reduce_levels, cod.get_num_decompositions());
+  if (reduce_levels > 0) {
+    codestream.restrict_input_resolution(reduce_levels, reduce_levels);
+  }
+
+  // With a color transform, OpenJPH can only output the components interleaved line by line.
+  codestream.set_planar(!cod.is_using_color_transform());
+
+  codestream.create();
+
+
+  // --- create output image
+
+  const uint32_t width = siz.get_recon_width(0);
+  const uint32_t height = siz.get_recon_height(0);
+
+  struct heif_error err = heif_image_create((int) width, (int) height, colorspace, chroma, out_img);
+  if (err.code) {
+    return err;
+  }
+
+  struct plane
+  {
+    uint8_t* data;
+    size_t stride;
+    uint32_t width;
+    uint32_t height;
+    int bit_depth;
+    uint32_t next_line = 0;
+  };
+
+  std::vector<plane> planes;
+  uint32_t total_lines = 0;
+
+  for (ojph::ui32 c = 0; c < num_components; c++) {
+    plane p{};
+    p.width = siz.get_recon_width(c);
+    p.height = siz.get_recon_height(c);
+    p.bit_depth = (int) siz.get_bit_depth(c);
+
+    err = heif_image_add_plane(*out_img, channels[c], (int) p.width, (int) p.height, p.bit_depth);
+    if (err.code) {
+      heif_image_release(*out_img);
+      *out_img = nullptr;
+      return err;
+    }
+
+    p.data = heif_image_get_plane2(*out_img, channels[c], &p.stride);
+
+    planes.push_back(p);
+    total_lines += p.height;
+  }
+
+
+  // --- decode lines
+  // Independent of planar or interleaved output, OpenJPH tells us the component of each line.
+
+  for (uint32_t i = 0; i < total_lines; i++) {
+    ojph::ui32 comp_num;
+    ojph::line_buf* line = codestream.pull(comp_num);
+
+    if (line == nullptr || comp_num >= num_components || planes[comp_num].next_line >= planes[comp_num].height) {
+      heif_image_release(*out_img);
+      *out_img = nullptr;
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "OpenJPH returned unexpected image lines"};
+    }
+
+    plane& p = planes[comp_num];
+    uint8_t* out = p.data + p.next_line * p.stride;
+
+    if (p.bit_depth <= 8) {
+      openjph_copy_line(line, out, p.width, p.bit_depth);
+    }
+    else {
+      openjph_copy_line(line, (uint16_t*) out, p.width, p.bit_depth);
+    }
+
+    p.next_line++;
+  }
+
+  codestream.close();
+
+  return heif_error_ok;
+}
+
+
+static struct heif_error openjph_decode_image(void* decoder_raw, struct heif_image** out_img)
+{
+  auto* decoder = (openjph_decoder*) decoder_raw;
+
+  *out_img = nullptr;
+
+  try {
+    return openjph_decode_codestream(decoder, out_img);
+  }
+  catch (const std::exception& e) {
+    if (*out_img) {
+      heif_image_release(*out_img);
+      *out_img = nullptr;
+    }
+
+    decoder->error_message = std::string("OpenJPH: ") + e.what();
+    return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, decoder->error_message.c_str()};
+  }
+}
+
+
+static const struct heif_decoder_plugin decoder_openjph{
+    4,
+    openjph_plugin_name,
+    openjph_init_plugin,
+    openjph_deinit_plugin,
+    openjph_does_support_format,
+    openjph_new_decoder,
+    openjph_free_decoder,
+    openjph_push_data,
+    openjph_decode_image,
+    openjph_set_strict_decoding,
+    "openjph",
+    openjph_set_target_scale_denominator,
+    nullptr,
+    openjph_reset_decoder,
+    nullptr
+};
+
+const struct heif_decoder_plugin* get_decoder_plugin_openjph()
+{
+  return &decoder_openjph;
+}
+
+
+#if PLUGIN_OPENJPH_DECODER
+heif_plugin_info plugin_info {
+  1,
+  heif_plugin_type_decoder,
+  &decoder_openjph
+};
+#endif
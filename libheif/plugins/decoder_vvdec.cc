@@ -25,6 +25,7 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+#include <deque>
 
 #include <vvdec/vvdec.h>
 
@@ -36,14 +37,31 @@
 
 struct vvdec_decoder
 {
+  vvdecParams params;
   vvdecDecoder* decoder = nullptr;
   vvdecAccessUnit* au = nullptr;
 
+  // vvdec starts its threads when the decoder is opened and cannot continue decoding after it has been flushed.
+  // The decoder is opened again before the next data is sent to it.
+  bool needs_reopen = true;
+  bool data_sent = false;
+
   bool strict_decoding = false;
 
-  std::vector<std::vector<uint8_t>> nalus;
+  int (* decoding_callback)(float progress, void* callback_data) = nullptr;
+  void* decoding_callback_data = nullptr;
+
+  std::vector<std::vector<uint8_t>> nalus; // from push_data(), sent with the next image
+
+  // --- sequence and batch decoding
+
+  bool sequence_flushed = false;
+  bool batch_flushed = false;
+  bool end_of_stream = false;
+  std::deque<vvdecFrame*> pending_frames; // output by vvdec, but not returned yet
 };
 
+static const char kEmptyString[] = "";
 static const char kSuccess[] = "Success";
 
 static const int VVDEC_PLUGIN_PRIORITY = 100;
@@ -89,14 +107,45 @@ static int vvdec_does_support_format(enum heif_compression_format format)
 }
 
 
+static void vvdec_release_pending_frames(struct vvdec_decoder* decoder)
+{
+  for (vvdecFrame* frame : decoder->pending_frames) {
+    vvdec_frame_unref(decoder->decoder, frame);
+  }
+
+  decoder->pending_frames.clear();
+}
+
+
+static bool vvdec_open_if_needed(struct vvdec_decoder* decoder)
+{
+  if (!decoder->needs_reopen) {
+    return decoder->decoder != nullptr;
+  }
+
+  vvdec_release_pending_frames(decoder);
+
+  if (decoder->decoder) {
+    vvdec_decoder_close(decoder->decoder);
+  }
+
+  decoder->decoder = vvdec_decoder_open(&decoder->params);
+  decoder->needs_reopen = false;
+  decoder->data_sent = false;
+  decoder->end_of_stream = false;
+
+  return decoder->decoder != nullptr;
+}
+
+
 struct heif_error vvdec_new_decoder(void** dec)
 {
   auto* decoder = new vvdec_decoder();
 
-  vvdecParams params;
-  vvdec_params_default(&params);
-  params.logLevel = VVDEC_INFO;
-  decoder->decoder = vvdec_decoder_open(&params);
+  vvdec_params_default(&decoder->params);
+  decoder->params.logLevel = VVDEC_INFO;
+
+  // The decoder is opened with the first data, such that set_num_threads() does not start the threads again.
 
   const int MaxNaluSize = 256 * 1024;
   decoder->au = vvdec_accessUnit_alloc();
@@ -118,6 +167,10 @@ void vvdec_free_decoder(void* decoder_raw)
     return;
   }
 
+  if (decoder->decoder) {
+    vvdec_release_pending_frames(decoder);
+  }
+
   if (decoder->au) {
     vvdec_accessUnit_free(decoder->au);
     decoder->au = nullptr;
@@ -132,6 +185,32 @@ void vvdec_free_decoder(void* decoder_raw)
 }
 
 
+struct heif_error vvdec_reset_decoder(void* decoder_raw)
+{
+  auto* decoder = (vvdec_decoder*) decoder_raw;
+
+  decoder->nalus.clear();
+
+  if (decoder->decoder) {
+    vvdec_release_pending_frames(decoder);
+  }
+
+  // A decoder that has not received data since it was opened can be used as is.
+  if (decoder->data_sent) {
+    decoder->needs_reopen = true;
+  }
+
+  decoder->strict_decoding = false;
+  decoder->decoding_callback = nullptr;
+  decoder->decoding_callback_data = nullptr;
+  decoder->sequence_flushed = false;
+  decoder->batch_flushed = false;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
 void vvdec_set_strict_decoding(void* decoder_raw, int flag)
 {
   auto* decoder = (vvdec_decoder*) decoder_raw;
@@ -140,32 +219,58 @@ void vvdec_set_strict_decoding(void* decoder_raw, int flag)
 }
 
 
-struct heif_error vvdec_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
+struct heif_error vvdec_set_num_threads(void* decoder_raw, int num_threads)
 {
-  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+  auto* decoder = (vvdec_decoder*) decoder_raw;
+
+  // With one thread, vvdec decodes in the calling thread (threads = 0).
+  // Otherwise, the number of parsing threads is chosen by vvdec from the number of decoding threads.
+  int threads = (num_threads > 1 ? num_threads : 0);
+  int parse_threads = (num_threads > 1 ? -1 : 0);
+
+  if (decoder->params.threads != threads || decoder->params.parseThreads != parse_threads) {
+    decoder->params.threads = threads;
+    decoder->params.parseThreads = parse_threads;
+    decoder->needs_reopen = true;
+  }
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
 
+// Splits the length-prefixed NAL units and appends them with start codes to 'nalus'.
+static struct heif_error vvdec_split_nalus(const void* frame_data, size_t frame_size,
+                                           std::vector<std::vector<uint8_t>>& nalus)
+{
   const auto* data = (const uint8_t*) frame_data;
 
-  for (;;) {
+  while (frame_size > 0) {
+    if (frame_size < 4) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_End_of_data, kEmptyString};
+    }
+
     uint32_t size = ((((uint32_t) data[0]) << 24) |
                      (((uint32_t) data[1]) << 16) |
                      (((uint32_t) data[2]) << 8) |
                      (data[3]));
 
     data += 4;
+    frame_size -= 4;
+
+    if (size > frame_size) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_End_of_data, kEmptyString};
+    }
 
     std::vector<uint8_t> nalu;
+    nalu.reserve(3 + size);
     nalu.push_back(0);
     nalu.push_back(0);
     nalu.push_back(1);
     nalu.insert(nalu.end(), data, data + size);
 
-    decoder->nalus.push_back(nalu);
+    nalus.push_back(std::move(nalu));
     data += size;
-    frame_size -= 4 + size;
-    if (frame_size == 0) {
-      break;
-    }
+    frame_size -= size;
   }
 
   struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
@@ -173,47 +278,91 @@ struct heif_error vvdec_push_data(void* decoder_raw, const void* frame_data, siz
 }
 
 
-struct heif_error vvdec_decode_image(void* decoder_raw, struct heif_image** out_img)
+struct heif_error vvdec_push_data(void* decoder_raw, const void* frame_data, size_t frame_size)
 {
   auto* decoder = (struct vvdec_decoder*) decoder_raw;
 
-  vvdecFrame* frame = nullptr;
+  return vvdec_split_nalus(frame_data, frame_size, decoder->nalus);
+}
 
-  // --- prepare AU payload with maximum NALU size
 
-  size_t max_payload_size = 0;
-  for (const auto& nalu : decoder->nalus) {
-    max_payload_size = std::max(max_payload_size, nalu.size());
-  }
+void vvdec_set_decoding_callback(void* decoder_raw, int (* callback)(float progress, void* callback_data), void* callback_data)
+{
+  auto* decoder = (vvdec_decoder*) decoder_raw;
 
-  if (decoder->au == nullptr || max_payload_size > (size_t) decoder->au->payloadSize) {
+  decoder->decoding_callback = callback;
+  decoder->decoding_callback_data = callback_data;
+}
+
+
+// Sends one NAL unit to the decoder. The 'cts' is returned with the frame that is decoded from it.
+// A frame that is output by vvdec is returned in 'frame', which is NULL otherwise.
+static int vvdec_send_nalu(struct vvdec_decoder* decoder, const std::vector<uint8_t>& nalu, uint64_t cts, vvdecFrame** frame)
+{
+  if (decoder->au == nullptr || nalu.size() > (size_t) decoder->au->payloadSize) {
     if (decoder->au) {
       vvdec_accessUnit_free(decoder->au);
     }
 
     decoder->au = vvdec_accessUnit_alloc();
     vvdec_accessUnit_default(decoder->au);
-    vvdec_accessUnit_alloc_payload(decoder->au, (int)max_payload_size);
+    vvdec_accessUnit_alloc_payload(decoder->au, (int) nalu.size());
+  }
+
+  memcpy(decoder->au->payload, nalu.data(), nalu.size());
+  decoder->au->payloadUsedSize = (int) nalu.size();
+  decoder->au->cts = cts;
+  decoder->au->ctsValid = true;
+
+  decoder->data_sent = true;
+
+  *frame = nullptr;
+  return vvdec_decode(decoder->decoder, decoder->au, frame);
+}
+
+
+static bool vvdec_is_error(int ret)
+{
+  return ret != VVDEC_OK && ret != VVDEC_EOF && ret != VVDEC_TRY_AGAIN;
+}
+
+
+// Decodes the NAL units from push_data() into a single frame. The frame has to be released with vvdec_frame_unref().
+static struct heif_error vvdec_get_decoded_frame(struct vvdec_decoder* decoder, vvdecFrame** out_frame)
+{
+  if (!vvdec_open_if_needed(decoder)) {
+    decoder->nalus.clear();
+    return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "cannot open vvdec decoder"};
   }
 
+  vvdecFrame* frame = nullptr;
+
   // --- feed NALUs into decoder, flush when done
 
   for (int i = 0;; i++) {
     int ret;
 
-    if (i < (int) decoder->nalus.size()) {
-      const auto& nalu = decoder->nalus[i];
-
-      memcpy(decoder->au->payload, nalu.data(), nalu.size());
-      decoder->au->payloadUsedSize = (int) nalu.size();
+    // vvdec decodes one NAL unit at a time. Decoding can be canceled between the slices.
+    if (decoder->decoding_callback) {
+      float progress = decoder->nalus.empty() ? -1.0f : std::min(1.0f, (float) i / (float) decoder->nalus.size());
+      if (decoder->decoding_callback(progress, decoder->decoding_callback_data)) {
+        decoder->nalus.clear();
+        decoder->needs_reopen = true;
+        return {heif_error_Canceled, heif_suberror_Unspecified, "Decoding was canceled"};
+      }
+    }
 
-      ret = vvdec_decode(decoder->decoder, decoder->au, &frame);
+    if (i < (int) decoder->nalus.size()) {
+      ret = vvdec_send_nalu(decoder, decoder->nalus[i], 0, &frame);
     }
     else {
       ret = vvdec_flush(decoder->decoder, &frame);
+      decoder->end_of_stream = true;
     }
 
-    if (ret != VVDEC_OK && ret != VVDEC_EOF && ret != VVDEC_TRY_AGAIN) {
+    if (vvdec_is_error(ret)) {
+      decoder->nalus.clear();
+      decoder->needs_reopen = true;
       return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "vvdec decoding error"};
     }
 
@@ -222,34 +371,97 @@ struct heif_error vvdec_decode_image(void* decoder_raw, struct heif_image** out_
     }
 
     if (ret == VVDEC_EOF) {
+      decoder->nalus.clear();
       return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "no frame decoded"};
     }
   }
 
-
   decoder->nalus.clear();
 
-  // --- convert decoded frame to heif_image
+  *out_frame = frame;
+
+  struct heif_error err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
 
-  heif_chroma chroma;
-  heif_colorspace colorspace;
 
+static void get_frame_chroma(const vvdecFrame* frame, heif_colorspace* colorspace, heif_chroma* chroma)
+{
   if (frame->colorFormat == VVDEC_CF_YUV400_PLANAR) {
-    chroma = heif_chroma_monochrome;
-    colorspace = heif_colorspace_monochrome;
+    *chroma = heif_chroma_monochrome;
+    *colorspace = heif_colorspace_monochrome;
   }
   else {
     if (frame->colorFormat == VVDEC_CF_YUV444_PLANAR) {
-      chroma = heif_chroma_444;
+      *chroma = heif_chroma_444;
     }
     else if (frame->colorFormat == VVDEC_CF_YUV422_PLANAR) {
-      chroma = heif_chroma_422;
+      *chroma = heif_chroma_422;
     }
     else {
-      chroma = heif_chroma_420;
+      *chroma = heif_chroma_420;
     }
-    colorspace = heif_colorspace_YCbCr;
+    *colorspace = heif_colorspace_YCbCr;
   }
+}
+
+
+static const heif_channel channel2plane[3] = {
+    heif_channel_Y,
+    heif_channel_Cb,
+    heif_channel_Cr
+};
+
+
+// Copies the planes of the frame into 'image', with the top-left corner at (x0,y0).
+// Parts that extend beyond the planes of 'image' are discarded.
+static void copy_frame_planes(const vvdecFrame* frame, heif_chroma chroma,
+                              struct heif_image* image, uint32_t x0, uint32_t y0)
+{
+  int num_planes = (chroma == heif_chroma_monochrome ? 1 : 3);
+
+  for (int c = 0; c < num_planes; c++) {
+    int bpp = (int) frame->bitDepth;
+
+    const auto& plane = frame->planes[c];
+    const uint8_t* data = plane.ptr;
+    size_t stride = plane.stride;
+
+    uint32_t xs = x0, ys = y0;
+    if (c > 0) {
+      // the offset is a multiple of the chroma subsampling factors
+      xs >>= (chroma == heif_chroma_444 ? 0 : 1);
+      ys >>= (chroma == heif_chroma_420 ? 1 : 0);
+    }
+
+    uint32_t target_w = heif_image_get_width(image, channel2plane[c]);
+    uint32_t target_h = heif_image_get_height(image, channel2plane[c]);
+    if (xs >= target_w || ys >= target_h) {
+      continue;
+    }
+
+    uint32_t copy_w = std::min(plane.width, target_w - xs);
+    uint32_t copy_h = std::min(plane.height, target_h - ys);
+
+    int bytes_per_pixel = (bpp + 7) / 8;
+
+    size_t dst_stride;
+    uint8_t* dst_mem = heif_image_get_plane2(image, channel2plane[c], &dst_stride);
+    dst_mem += ys * dst_stride + xs * bytes_per_pixel;
+
+    for (uint32_t y = 0; y < copy_h; y++) {
+      memcpy(dst_mem + y * dst_stride, data + y * stride, copy_w * bytes_per_pixel);
+    }
+  }
+}
+
+
+// Converts the frame into a new heif_image and releases the frame.
+static struct heif_error vvdec_convert_frame(struct vvdec_decoder* decoder, vvdecFrame* frame, struct heif_image** out_img)
+{
+  heif_chroma chroma;
+  heif_colorspace colorspace;
+  get_frame_chroma(frame, &colorspace, &chroma);
 
   struct heif_image* heif_img = nullptr;
   struct heif_error err = heif_image_create((int)frame->width,
@@ -259,6 +471,7 @@ struct heif_error vvdec_decode_image(void* decoder_raw, struct heif_image** out_
                                             &heif_img);
   if (err.code != heif_error_Ok) {
     assert(heif_img == nullptr);
+    vvdec_frame_unref(decoder->decoder, frame);
     return err;
   }
 
@@ -277,58 +490,197 @@ struct heif_error vvdec_decode_image(void* decoder_raw, struct heif_image** out_
 
   // --- transfer data from vvdecFrame to HeifPixelImage
 
-  heif_channel channel2plane[3] = {
-      heif_channel_Y,
-      heif_channel_Cb,
-      heif_channel_Cr
-  };
-
-
   int num_planes = (chroma == heif_chroma_monochrome ? 1 : 3);
 
   for (int c = 0; c < num_planes; c++) {
-    int bpp = (int)frame->bitDepth;
-
     const auto& plane = frame->planes[c];
-    const uint8_t* data = plane.ptr;
-    int stride = (int)plane.stride;
-
-    int w = (int)plane.width;
-    int h = (int)plane.height;
 
-    err = heif_image_add_plane(heif_img, channel2plane[c], w, h, bpp);
+    err = heif_image_add_plane(heif_img, channel2plane[c], (int) plane.width, (int) plane.height, (int) frame->bitDepth);
     if (err.code != heif_error_Ok) {
       heif_image_release(heif_img);
+      vvdec_frame_unref(decoder->decoder, frame);
       return err;
     }
+  }
 
-    size_t dst_stride;
-    uint8_t* dst_mem = heif_image_get_plane2(heif_img, channel2plane[c], &dst_stride);
+  copy_frame_planes(frame, chroma, heif_img, 0, 0);
 
-    int bytes_per_pixel = (bpp + 7) / 8;
+  vvdec_frame_unref(decoder->decoder, frame);
 
-    for (int y = 0; y < h; y++) {
-      memcpy(dst_mem + y * dst_stride, data + y * stride, w * bytes_per_pixel);
-    }
+  *out_img = heif_img;
 
-#if 0
-      std::cout << "DATA " << c << " " << w << " " << h << " bpp:" << bpp << "\n";
-      std::cout << write_raw_data_as_hex(dst_mem, w*h, {}, {});
-      std::cout << "---\n";
-#endif
+  err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
+struct heif_error vvdec_decode_image(void* decoder_raw, struct heif_image** out_img)
+{
+  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+
+  vvdecFrame* frame = nullptr;
+  struct heif_error err = vvdec_get_decoded_frame(decoder, &frame);
+  if (err.code != heif_error_Ok) {
+    return err;
   }
 
-  *out_img = heif_img;
+  return vvdec_convert_frame(decoder, frame, out_img);
+}
+
+
+struct heif_error vvdec_decode_image_into(void* decoder_raw, struct heif_image* target, uint32_t x0, uint32_t y0)
+{
+  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+
+  vvdecFrame* frame = nullptr;
+  struct heif_error err = vvdec_get_decoded_frame(decoder, &frame);
+  if (err.code != heif_error_Ok) {
+    return err;
+  }
+
+  heif_chroma chroma;
+  heif_colorspace colorspace;
+  get_frame_chroma(frame, &colorspace, &chroma);
+
+  if (chroma != heif_image_get_chroma_format(target) ||
+      (int) frame->bitDepth != heif_image_get_bits_per_pixel_range(target, heif_channel_Y)) {
+    vvdec_frame_unref(decoder->decoder, frame);
+
+    err = {heif_error_Unsupported_feature,
+           heif_suberror_Unsupported_color_conversion,
+           "Decoded image format does not match the target image"};
+    return err;
+  }
+
+  copy_frame_planes(frame, chroma, target, x0, y0);
 
   vvdec_frame_unref(decoder->decoder, frame);
 
+  err = {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  return err;
+}
+
+
+// --- sequences with inter-frame prediction
+//
+// The NAL units of the samples are sent to vvdec as they come. The sample's user_data is passed through the
+// composition timestamp (cts) of the access unit. vvdec outputs the frames in presentation order.
+
+static struct heif_error vvdec_push_sequence_sample(void* decoder_raw, const void* data, size_t size, uintptr_t user_data)
+{
+  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+
+  if (!vvdec_open_if_needed(decoder)) {
+    return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "cannot open vvdec decoder"};
+  }
+
+  // The configuration NAL units (from push_data()) are sent before the first sample.
+  std::vector<std::vector<uint8_t>> nalus = std::move(decoder->nalus);
+  decoder->nalus.clear();
+
+  struct heif_error err = vvdec_split_nalus(data, size, nalus);
+  if (err.code != heif_error_Ok) {
+    return err;
+  }
+
+  for (const auto& nalu : nalus) {
+    vvdecFrame* frame = nullptr;
+    int ret = vvdec_send_nalu(decoder, nalu, static_cast<uint64_t>(user_data), &frame);
+    if (vvdec_is_error(ret)) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "vvdec decoding error"};
+    }
+
+    if (frame) {
+      decoder->pending_frames.push_back(frame);
+    }
+  }
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
+static struct heif_error vvdec_flush_sequence(void* decoder_raw)
+{
+  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+
+  decoder->sequence_flushed = true;
+
+  return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+}
+
+
+static struct heif_error vvdec_get_next_sequence_image(void* decoder_raw, struct heif_image** out_img, uintptr_t* out_user_data)
+{
+  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+
+  *out_img = nullptr;
+
+  if (decoder->pending_frames.empty() && decoder->sequence_flushed && !decoder->end_of_stream && decoder->decoder) {
+    // the frames that are still held back by vvdec are output one by one
+    vvdecFrame* frame = nullptr;
+    int ret = vvdec_flush(decoder->decoder, &frame);
+    if (vvdec_is_error(ret)) {
+      return {heif_error_Decoder_plugin_error, heif_suberror_Unspecified, "vvdec decoding error"};
+    }
+
+    if (frame) {
+      decoder->pending_frames.push_back(frame);
+    }
+
+    if (ret == VVDEC_EOF) {
+      decoder->end_of_stream = true;
+    }
+  }
+
+  if (decoder->pending_frames.empty()) {
+    // needs more samples, or all images have been output
+    return {heif_error_Ok, heif_suberror_Unspecified, kSuccess};
+  }
+
+  vvdecFrame* frame = decoder->pending_frames.front();
+  decoder->pending_frames.pop_front();
+
+  *out_user_data = static_cast<uintptr_t>(frame->cts);
+
+  return vvdec_convert_frame(decoder, frame, out_img);
+}
+
+
+// --- batch decoding of independent images
+//
+// The images are sent like the samples of a sequence, each with its own parameter sets. vvdec decodes them
+// one after the other with the same decoder threads. Since vvdec cannot continue after it has been flushed,
+// the decoder is opened again for the next batch, but not for each image.
+
+static struct heif_error vvdec_push_batch_image(void* decoder_raw, const void* data, size_t size, uintptr_t image_id)
+{
+  return vvdec_push_sequence_sample(decoder_raw, data, size, image_id);
+}
+
+
+static struct heif_error vvdec_get_next_batch_image(void* decoder_raw, struct heif_image** out_img, uintptr_t* out_image_id)
+{
+  auto* decoder = (struct vvdec_decoder*) decoder_raw;
+
+  decoder->sequence_flushed = true;
+  decoder->batch_flushed = true;
+
+  struct heif_error err = vvdec_get_next_sequence_image(decoder_raw, out_img, out_image_id);
+
+  if (err.code == heif_error_Ok && *out_img == nullptr && decoder->end_of_stream) {
+    // The batch is complete.
+    decoder->needs_reopen = true;
+    decoder->sequence_flushed = false;
+    decoder->batch_flushed = false;
+  }
+
   return err;
 }
 
 
 static const struct heif_decoder_plugin decoder_vvdec
     {
-        3,
+        4,
         vvdec_plugin_name,
         vvdec_init_plugin,
         vvdec_deinit_plugin,
@@ -338,7 +690,21 @@ static const struct heif_decoder_plugin decoder_vvdec
         vvdec_push_data,
         vvdec_decode_image,
         vvdec_set_strict_decoding,
-        "vvdec"
+        "vvdec",
+        nullptr,
+        vvdec_decode_image_into,
+        vvdec_reset_decoder,
+        vvdec_set_num_threads,
+        nullptr,
+        nullptr,
+        nullptr,
+        vvdec_push_sequence_sample,
+        vvdec_flush_sequence,
+        vvdec_get_next_sequence_image,
+        nullptr,
+        vvdec_set_decoding_callback,
+        vvdec_push_batch_image,
+        vvdec_get_next_batch_image
     };
 
 
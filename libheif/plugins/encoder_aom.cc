@@ -23,6 +23,7 @@
 #include "common_utils.h"
 #include <algorithm>
 #include <cstring>
+#include <deque>
 #include <cassert>
 #include <sstream>
 #include <vector>
@@ -54,6 +55,10 @@ struct encoder_struct_aom
 {
   ~encoder_struct_aom()
   {
+    if (sequence_codec_initialized) {
+      aom_codec_destroy(&sequence_codec);
+    }
+
     for (auto* error : aom_errors) {
       delete[] error;
     }
@@ -99,6 +104,23 @@ struct encoder_struct_aom
   std::vector<uint8_t> compressedData;
   bool data_read = false;
 
+  // --- sequence encoding
+
+  heif_sequence_encoding_options sequence_options{};
+  aom_codec_ctx_t sequence_codec;
+  bool sequence_codec_initialized = false;
+
+  struct coded_frame
+  {
+    std::vector<uint8_t> data;
+    uintptr_t frame_number = 0;
+    bool is_keyframe = false;
+  };
+
+  // in decoding order
+  std::deque<coded_frame> coded_frames;
+  bool coded_frame_returned = false;
+
   // --- error message copies
 
   std::mutex aom_errors_mutex;
@@ -165,9 +187,10 @@ static const char* kParam_alpha_max_q = "alpha-max-q";
 static const char* kParam_lossless_alpha = "lossless-alpha";
 static const char* kParam_auto_tiles = "auto-tiles";
 static const char* kParam_enable_intra_block_copy = "enable-intrabc";
-static const char* kParam_threads = "threads";
+static const char* kParam_threads = heif_encoder_parameter_name_threads;
 static const char* kParam_realtime = "realtime";
 static const char* kParam_speed = "speed";
+static const char* kParam_speed_class = heif_encoder_parameter_name_speed_class;
 
 static const char* kParam_chroma = "chroma";
 static const char* const kParam_chroma_valid_values[] = {
@@ -189,6 +212,12 @@ static char plugin_name[MAX_PLUGIN_NAME_LENGTH];
 static void aom_set_default_parameters(void* encoder);
 
 
+static int aom_max_speed()
+{
+  return aom_codec_version_major() >= 3 ? 9 : 8;
+}
+
+
 static const char* aom_plugin_name()
 {
   const char* encoder_name = aom_codec_iface_name(aom_codec_av1_cx());
@@ -222,6 +251,19 @@ static void aom_init_parameters()
   p->has_default = true;
   d[i++] = p++;
 
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_speed_class;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 6;
+  p->has_default = false; // the default is set with the native speed parameter
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 9;
+  p->integer.valid_values = NULL;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   assert(i < MAX_NPARAMETERS);
   p->version = 2;
   p->name = kParam_speed;
@@ -230,12 +272,7 @@ static void aom_init_parameters()
   p->has_default = true;
   p->integer.have_minimum_maximum = true;
   p->integer.minimum = 0;
-  if (aom_codec_version_major() >= 3) {
-    p->integer.maximum = 9;
-  }
-  else {
-    p->integer.maximum = 8;
-  }
+  p->integer.maximum = aom_max_speed();
   p->integer.valid_values = NULL;
   p->integer.num_valid_values = 0;
   d[i++] = p++;
@@ -536,6 +573,14 @@ struct heif_error aom_set_parameter_integer(void* encoder_raw, const char* name,
       encoder->alpha_max_q_set = true;
       return heif_error_ok;
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (value < 0 || value > 9) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    encoder->cpu_used = (value * aom_max_speed() + 4) / 9;
+    return heif_error_ok;
+  }
 
   set_value(kParam_min_q, min_q);
   set_value(kParam_max_q, max_q);
@@ -567,6 +612,10 @@ struct heif_error aom_get_parameter_integer(void* encoder_raw, const char* name,
       *value = encoder->alpha_min_q_set ? encoder->alpha_min_q : encoder->min_q;
       return heif_error_ok;
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    *value = (encoder->cpu_used * 9 + aom_max_speed() / 2) / aom_max_speed();
+    return heif_error_ok;
+  }
 
   get_value(kParam_min_q, min_q);
   get_value(kParam_max_q, max_q);
@@ -795,11 +844,12 @@ if (check_aom_error(aom_error, &codec, encoder, &err)) { \
 }
 
 
-struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* image,
-                                   heif_image_input_class input_class)
-{
-  struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
+using aom_image_ptr = std::unique_ptr<aom_image_t, void (*)(aom_image_t*)>;
+
 
+// Copies the libheif image into a newly allocated aom image.
+static struct heif_error aom_copy_image(const struct heif_image* image, aom_image_ptr& out_image)
+{
   struct heif_error err;
 
   const int source_width = heif_image_get_width(image, heif_channel_Y);
@@ -831,28 +881,23 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
   aom_img_fmt_t img_format = AOM_IMG_FMT_NONE;
 
   int chroma_height = 0;
-  int chroma_sample_position = AOM_CSP_UNKNOWN;
 
   switch (chroma) {
     case heif_chroma_420:
     case heif_chroma_monochrome:
       img_format = AOM_IMG_FMT_I420;
       chroma_height = (source_height+1)/2;
-      chroma_sample_position = AOM_CSP_UNKNOWN; // TODO: change this to CSP_CENTER in the future (https://github.com/AOMediaCodec/av1-avif/issues/88)
       break;
     case heif_chroma_422:
       img_format = AOM_IMG_FMT_I422;
       chroma_height = (source_height+1)/2;
-      chroma_sample_position = AOM_CSP_COLOCATED;
       break;
     case heif_chroma_444:
       img_format = AOM_IMG_FMT_I444;
       chroma_height = source_height;
-      chroma_sample_position = AOM_CSP_COLOCATED;
       break;
     default:
       img_format = AOM_IMG_FMT_NONE;
-      chroma_sample_position = AOM_CSP_UNKNOWN;
       assert(false);
       break;
   }
@@ -861,9 +906,9 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
     img_format = (aom_img_fmt_t) (img_format | AOM_IMG_FMT_HIGHBITDEPTH);
   }
 
-  std::unique_ptr<aom_image_t, void (*)(aom_image_t*)> input_image(aom_img_alloc(nullptr, img_format,
-                                                                                 source_width, source_height, 1),
-                                                                   aom_img_free);
+  aom_image_ptr input_image(aom_img_alloc(nullptr, img_format,
+                                          source_width, source_height, 1),
+                            aom_img_free);
   if (!input_image) {
     err = {heif_error_Memory_allocation_error,
            heif_suberror_Unspecified,
@@ -921,12 +966,39 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
     }
   }
 
+  out_image = std::move(input_image);
+
+  return heif_error_ok;
+}
 
 
+// Configures and initializes the codec for 'image'.
+// When encoding a sequence, 'sequence' contains its GOP parameters. It is NULL for still images.
+// If the function succeeds, the caller has to destroy the codec with aom_codec_destroy().
+static struct heif_error aom_init_codec(encoder_struct_aom* encoder, const struct heif_image* image,
+                                        heif_image_input_class input_class,
+                                        const struct heif_sequence_encoding_options* sequence,
+                                        aom_codec_ctx_t* out_codec)
+{
+  struct heif_error err;
+
+  aom_codec_ctx_t& codec = *out_codec;
+
+  const int source_width = heif_image_get_width(image, heif_channel_Y);
+  const int source_height = heif_image_get_height(image, heif_channel_Y);
+
+  const heif_chroma chroma = heif_image_get_chroma_format(image);
+
+  int bpp_y = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
+
+  int chroma_sample_position = AOM_CSP_COLOCATED;
+  if (chroma == heif_chroma_420 || chroma == heif_chroma_monochrome) {
+    chroma_sample_position = AOM_CSP_UNKNOWN; // TODO: change this to CSP_CENTER in the future (https://github.com/AOMediaCodec/av1-avif/issues/88)
+  }
+
   // --- configure codec
 
   aom_codec_iface_t* iface;
-  aom_codec_ctx_t codec;
 
   iface = aom_codec_av1_cx();
   //encoder->encoder = get_aom_encoder_by_name("av1");
@@ -945,6 +1017,9 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
   // aom 2.0
   unsigned int aomUsage = AOM_USAGE_GOOD_QUALITY;
 #endif
+  if (sequence) {
+    aomUsage = AOM_USAGE_GOOD_QUALITY;
+  }
   if (encoder->realtime_mode) {
     aomUsage = AOM_USAGE_REALTIME;
   }
@@ -963,22 +1038,45 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
 
   cfg.g_w = source_width;
   cfg.g_h = source_height;
-  // Set the max number of frames to encode to 1. This makes the libaom encoder
-  // set still_picture and reduced_still_picture_header to 1 in the AV1 sequence
-  // header OBU.
-  cfg.g_limit = 1;
-
-  // Use the default settings of the new AOM_USAGE_ALL_INTRA (added in
-  // https://crbug.com/aomedia/2959).
-  //
-  // Set g_lag_in_frames to 0 to reduce the number of frame buffers (from 20
-  // to 2) in libaom's lookahead structure. This reduces memory consumption when
-  // encoding a single image.
-  cfg.g_lag_in_frames = 0;
-  // Disable automatic placement of key frames by the encoder.
-  cfg.kf_mode = AOM_KF_DISABLED;
-  // Tell libaom that all frames will be key frames.
-  cfg.kf_max_dist = 0;
+
+  if (sequence) {
+    // One timebase tick per frame. The frame numbers are used as timestamps.
+    if (sequence->framerate_numerator && sequence->framerate_denominator) {
+      cfg.g_timebase.num = (int) sequence->framerate_denominator;
+      cfg.g_timebase.den = (int) sequence->framerate_numerator;
+    }
+
+    // Without look-ahead, there are no hidden alt-ref frames predicted from future images.
+    if (sequence->gop_structure == heif_sequence_gop_structure_lowdelay) {
+      cfg.g_lag_in_frames = 0;
+    }
+
+    cfg.kf_mode = AOM_KF_AUTO;
+    if (sequence->keyframe_distance_min > 0) {
+      cfg.kf_min_dist = sequence->keyframe_distance_min;
+    }
+    if (sequence->keyframe_distance_max > 0) {
+      cfg.kf_max_dist = sequence->keyframe_distance_max;
+    }
+  }
+  else {
+    // Set the max number of frames to encode to 1. This makes the libaom encoder
+    // set still_picture and reduced_still_picture_header to 1 in the AV1 sequence
+    // header OBU.
+    cfg.g_limit = 1;
+
+    // Use the default settings of the new AOM_USAGE_ALL_INTRA (added in
+    // https://crbug.com/aomedia/2959).
+    //
+    // Set g_lag_in_frames to 0 to reduce the number of frame buffers (from 20
+    // to 2) in libaom's lookahead structure. This reduces memory consumption when
+    // encoding a single image.
+    cfg.g_lag_in_frames = 0;
+    // Disable automatic placement of key frames by the encoder.
+    cfg.kf_mode = AOM_KF_DISABLED;
+    // Tell libaom that all frames will be key frames.
+    cfg.kf_max_dist = 0;
+  }
 
   cfg.g_profile = seq_profile;
   cfg.g_bit_depth = (aom_bit_depth_t) bpp_y;
@@ -1034,7 +1132,7 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
     return err;
   }
 
-  // automatically destroy aom_codec_ctx_t when we leave the function
+  // automatically destroy aom_codec_ctx_t when we leave the function with an error
   auto codec_ctx_deleter = std::unique_ptr<aom_codec_ctx_t, aom_codec_err_t (*)(aom_codec_ctx_t*)>(&codec, aom_codec_destroy);
 
   aom_codec_err_t aom_error;
@@ -1114,27 +1212,20 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
   }
 #endif
 
-  // --- encode frame
+  // the caller destroys the codec
+  codec_ctx_deleter.release();
 
-  res = aom_codec_encode(&codec, input_image.get(),
-                         0, // only encoding a single frame
-                         1,
-                         0); // no flags
+  return heif_error_ok;
+}
 
-  if (res != AOM_CODEC_OK) {
-    err = {
-        heif_error_Encoder_plugin_error,
-        heif_suberror_Encoder_encoding,
-        encoder->set_aom_error(aom_codec_error_detail(&codec))
-    };
-    return err;
-  }
 
-  encoder->compressedData.clear();
+// Appends the compressed frame data of all available packets.
+static void aom_append_packets(encoder_struct_aom* encoder, aom_codec_ctx_t* codec)
+{
   const aom_codec_cx_pkt_t* pkt = NULL;
   aom_codec_iter_t iter = NULL; // for extracting the compressed packets
 
-  while ((pkt = aom_codec_get_cx_data(&codec, &iter)) != NULL) {
+  while ((pkt = aom_codec_get_cx_data(codec, &iter)) != NULL) {
 
     if (pkt->kind == AOM_CODEC_CX_FRAME_PKT) {
       //std::cerr.write((char*)pkt->data.frame.buf, pkt->data.frame.sz);
@@ -1156,6 +1247,49 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
       encoder->data_read = false;
     }
   }
+}
+
+
+struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* image,
+                                   heif_image_input_class input_class)
+{
+  struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
+
+  struct heif_error err;
+
+  aom_image_ptr input_image(nullptr, aom_img_free);
+  err = aom_copy_image(image, input_image);
+  if (err.code) {
+    return err;
+  }
+
+  aom_codec_ctx_t codec;
+  err = aom_init_codec(encoder, image, input_class, nullptr, &codec);
+  if (err.code) {
+    return err;
+  }
+
+  // automatically destroy aom_codec_ctx_t when we leave the function
+  auto codec_ctx_deleter = std::unique_ptr<aom_codec_ctx_t, aom_codec_err_t (*)(aom_codec_ctx_t*)>(&codec, aom_codec_destroy);
+
+  // --- encode frame
+
+  aom_codec_err_t res = aom_codec_encode(&codec, input_image.get(),
+                                         0, // only encoding a single frame
+                                         1,
+                                         0); // no flags
+
+  if (res != AOM_CODEC_OK) {
+    err = {
+        heif_error_Encoder_plugin_error,
+        heif_suberror_Encoder_encoding,
+        encoder->set_aom_error(aom_codec_error_detail(&codec))
+    };
+    return err;
+  }
+
+  encoder->compressedData.clear();
+  aom_append_packets(encoder, &codec);
 
   int flags = 0;
   res = aom_codec_encode(&codec, NULL, -1, 0, flags);
@@ -1166,57 +1300,182 @@ struct heif_error aom_encode_image(void* encoder_raw, const struct heif_image* i
     return err;
   }
 
-  iter = NULL;
+  aom_append_packets(encoder, &codec);
+
+  return heif_error_ok;
+}
+
+
+struct heif_error aom_get_compressed_data(void* encoder_raw, uint8_t** data, int* size,
+                                          enum heif_encoded_data_type* type)
+{
+  struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
+
+  if (encoder->data_read) {
+    *size = 0;
+    *data = nullptr;
+  }
+  else {
+    *size = (int) encoder->compressedData.size();
+    *data = encoder->compressedData.data();
+    encoder->data_read = true;
+  }
+
+  return heif_error_ok;
+}
+
+
+// --- sequence encoding
+
+struct heif_error aom_start_sequence_encoding(void* encoder_raw, const struct heif_sequence_encoding_options* options)
+{
+  struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
+
+  if (encoder->sequence_codec_initialized) {
+    aom_codec_destroy(&encoder->sequence_codec);
+    encoder->sequence_codec_initialized = false;
+  }
+
+  // The codec is initialized with the first frame, when the image format is known.
+  encoder->sequence_options = *options;
+  encoder->coded_frames.clear();
+  encoder->coded_frame_returned = false;
+
+  return heif_error_ok;
+}
 
-  while ((pkt = aom_codec_get_cx_data(&codec, &iter)) != NULL) {
 
+// Moves the available packets into the queue of coded frames. Each packet is one temporal unit.
+static void aom_queue_coded_frames(encoder_struct_aom* encoder)
+{
+  const aom_codec_cx_pkt_t* pkt = NULL;
+  aom_codec_iter_t iter = NULL;
+
+  while ((pkt = aom_codec_get_cx_data(&encoder->sequence_codec, &iter)) != NULL) {
     if (pkt->kind == AOM_CODEC_CX_FRAME_PKT) {
-      //std::cerr.write((char*)pkt->data.frame.buf, pkt->data.frame.sz);
+      encoder_struct_aom::coded_frame frame;
+      frame.data.assign((const uint8_t*) pkt->data.frame.buf,
+                        (const uint8_t*) pkt->data.frame.buf + pkt->data.frame.sz);
+      frame.frame_number = (uintptr_t) pkt->data.frame.pts;
+      frame.is_keyframe = (pkt->data.frame.flags & AOM_FRAME_IS_KEY) != 0;
 
-      //printf("packet of size: %d\n",(int)pkt->data.frame.sz);
+      encoder->coded_frames.push_back(std::move(frame));
+    }
+  }
+}
 
 
-      // TODO: split the received data into separate OBUs
-      // This allows libheif to easily extract the sequence header for the av1C header
+struct heif_error aom_encode_sequence_frame(void* encoder_raw, const struct heif_image* image,
+                                            heif_image_input_class input_class,
+                                            uintptr_t frame_number)
+{
+  struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
 
-      size_t n = pkt->data.frame.sz;
-      size_t oldSize = encoder->compressedData.size();
-      encoder->compressedData.resize(oldSize + n);
+  struct heif_error err;
 
-      memcpy(encoder->compressedData.data() + oldSize,
-             pkt->data.frame.buf,
-             n);
+  aom_image_ptr input_image(nullptr, aom_img_free);
+  err = aom_copy_image(image, input_image);
+  if (err.code) {
+    return err;
+  }
 
-      encoder->data_read = false;
+  if (!encoder->sequence_codec_initialized) {
+    err = aom_init_codec(encoder, image, input_class, &encoder->sequence_options, &encoder->sequence_codec);
+    if (err.code) {
+      return err;
     }
+
+    encoder->sequence_codec_initialized = true;
   }
 
+  aom_codec_err_t res = aom_codec_encode(&encoder->sequence_codec, input_image.get(),
+                                         (aom_codec_pts_t) frame_number,
+                                         1,
+                                         0); // no flags
+
+  if (res != AOM_CODEC_OK) {
+    err = {
+        heif_error_Encoder_plugin_error,
+        heif_suberror_Encoder_encoding,
+        encoder->set_aom_error(aom_codec_error_detail(&encoder->sequence_codec))
+    };
+    return err;
+  }
+
+  aom_queue_coded_frames(encoder);
+
   return heif_error_ok;
 }
 
 
-struct heif_error aom_get_compressed_data(void* encoder_raw, uint8_t** data, int* size,
-                                          enum heif_encoded_data_type* type)
+struct heif_error aom_end_sequence_encoding(void* encoder_raw)
 {
   struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
 
-  if (encoder->data_read) {
-    *size = 0;
-    *data = nullptr;
+  if (!encoder->sequence_codec_initialized) {
+    return heif_error_ok;
   }
-  else {
-    *size = (int) encoder->compressedData.size();
-    *data = encoder->compressedData.data();
-    encoder->data_read = true;
+
+  // Flush until the encoder has no more frames.
+
+  for (;;) {
+    aom_codec_err_t res = aom_codec_encode(&encoder->sequence_codec, NULL, -1, 0, 0);
+    if (res != AOM_CODEC_OK) {
+      struct heif_error err = {
+          heif_error_Encoder_plugin_error,
+          heif_suberror_Encoder_encoding,
+          encoder->set_aom_error(aom_codec_error_detail(&encoder->sequence_codec))
+      };
+      return err;
+    }
+
+    size_t num_frames = encoder->coded_frames.size();
+    aom_queue_coded_frames(encoder);
+
+    if (encoder->coded_frames.size() == num_frames) {
+      break;
+    }
+  }
+
+  return heif_error_ok;
+}
+
+
+struct heif_error aom_get_compressed_data2(void* encoder_raw, uint8_t** data, int* size,
+                                           uintptr_t* frame_number, int* is_keyframe,
+                                           enum heif_encoded_data_type* type)
+{
+  struct encoder_struct_aom* encoder = (struct encoder_struct_aom*) encoder_raw;
+
+  *data = nullptr;
+  *size = 0;
+
+  if (encoder->coded_frames.empty()) {
+    return heif_error_ok;
+  }
+
+  if (encoder->coded_frame_returned) {
+    // end of frame
+    encoder->coded_frames.pop_front();
+    encoder->coded_frame_returned = false;
+    return heif_error_ok;
   }
 
+  auto& frame = encoder->coded_frames.front();
+  *data = frame.data.data();
+  *size = (int) frame.data.size();
+  *frame_number = frame.frame_number;
+  *is_keyframe = frame.is_keyframe;
+
+  encoder->coded_frame_returned = true;
+
   return heif_error_ok;
 }
 
 
 static const struct heif_encoder_plugin encoder_plugin_aom
     {
-        /* plugin_api_version */ 3,
+        /* plugin_api_version */ 4,
         /* compression_format */ heif_compression_AV1,
         /* id_name */ "aom",
         /* priority */ AOM_PLUGIN_PRIORITY,
@@ -1244,7 +1503,11 @@ static const struct heif_encoder_plugin encoder_plugin_aom
         /* encode_image */ aom_encode_image,
         /* get_compressed_data */ aom_get_compressed_data,
         /* query_input_colorspace (v2) */ aom_query_input_colorspace2,
-        /* query_encoded_size (v3) */ nullptr
+        /* query_encoded_size (v3) */ nullptr,
+        /* start_sequence_encoding (v4) */ aom_start_sequence_encoding,
+        /* encode_sequence_frame (v4) */ aom_encode_sequence_frame,
+        /* end_sequence_encoding (v4) */ aom_end_sequence_encoding,
+        /* get_compressed_data2 (v4) */ aom_get_compressed_data2
     };
 
 const struct heif_encoder_plugin* get_encoder_plugin_aom()
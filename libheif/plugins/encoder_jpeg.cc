@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <memory>
 #include <cstdio>
+#include <cstdlib>
 #include <csetjmp>
 
 extern "C" {
@@ -34,13 +35,43 @@ extern "C" {
 }
 
 
+#if defined(LIBJPEG_TURBO_VERSION) || (JPEG_LIB_VERSION_MAJOR < 9 || (JPEG_LIB_VERSION_MAJOR == 9 && JPEG_LIB_VERSION_MINOR < 4))
+typedef unsigned long jpeg_mem_size;
+#else
+typedef size_t jpeg_mem_size;
+#endif
+
+
+struct ErrorHandler
+{
+  struct jpeg_error_mgr pub;  /* "public" fields */
+  jmp_buf setjmp_buffer;  /* for return to caller */
+};
+
+
 struct encoder_struct_jpeg
 {
   int quality;
 
+  // --- compressor
+
+  // The compressor is kept for all images coded with this encoder instance. When the next image has the same
+  // size, chroma format and quality, the quantization and Huffman tables set up for the previous one are reused.
+
+  struct jpeg_compress_struct cinfo;
+  struct ErrorHandler jerr;
+  bool cinfo_created = false;
+
+  bool cinfo_configured = false;
+  JDIMENSION configured_width = 0;
+  JDIMENSION configured_height = 0;
+  heif_chroma configured_chroma = heif_chroma_undefined;
+  int configured_quality = -1;
+
   // --- output
 
-  std::vector<uint8_t> compressed_data;
+  unsigned char* compressed_data = nullptr; // allocated by libjpeg
+  jpeg_mem_size compressed_size = 0;
   bool data_read = false;
 };
 
@@ -141,6 +172,12 @@ void jpeg_free_encoder(void* encoder_raw)
 {
   auto* encoder = (struct encoder_struct_jpeg*) encoder_raw;
 
+  if (encoder->cinfo_created) {
+    jpeg_destroy_compress(&encoder->cinfo);
+  }
+
+  free(encoder->compressed_data);
+
   delete encoder;
 }
 
@@ -312,6 +349,13 @@ void jpeg_query_input_colorspace2(void* encoder_raw, heif_colorspace* colorspace
 
   // TODO: support encoding greyscale JPEGs
 
+  // YCbCr input is coded in its own subsampling, everything else is converted to 4:2:0.
+
+  if (*colorspace == heif_colorspace_YCbCr &&
+      (*chroma == heif_chroma_420 || *chroma == heif_chroma_422 || *chroma == heif_chroma_444)) {
+    return;
+  }
+
   *colorspace = heif_colorspace_YCbCr;
   *chroma = heif_chroma_420;
 }
@@ -325,12 +369,6 @@ void jpeg_query_encoded_size(void* encoder_raw, uint32_t input_width, uint32_t i
 }
 
 
-struct ErrorHandler
-{
-  struct jpeg_error_mgr pub;  /* "public" fields */
-  jmp_buf setjmp_buffer;  /* for return to caller */
-};
-
 static void OnJpegError(j_common_ptr cinfo)
 {
   ErrorHandler* handler = reinterpret_cast<ErrorHandler*>(cinfo->err);
@@ -343,83 +381,145 @@ struct heif_error jpeg_encode_image(void* encoder_raw, const struct heif_image*
 {
   auto* encoder = (struct encoder_struct_jpeg*) encoder_raw;
 
-
-  struct jpeg_compress_struct cinfo;
-  struct ErrorHandler jerr;
-  cinfo.err = jpeg_std_error(reinterpret_cast<struct jpeg_error_mgr*>(&jerr));
-  jerr.pub.error_exit = &OnJpegError;
-  if (setjmp(jerr.setjmp_buffer)) {
-    cinfo.err->output_message(reinterpret_cast<j_common_ptr>(&cinfo));
-    jpeg_destroy_compress(&cinfo);
-    return heif_error{heif_error_Encoding_error, heif_suberror_Encoder_encoding, "JPEG encoding error"};
+  heif_chroma chroma = heif_image_get_chroma_format(image);
+  if (heif_image_get_colorspace(image) != heif_colorspace_YCbCr ||
+      (chroma != heif_chroma_420 && chroma != heif_chroma_422 && chroma != heif_chroma_444)) {
+    return heif_error{heif_error_Encoding_error, heif_suberror_Unsupported_color_conversion, "JPEG encoder requires YCbCr 4:2:0, 4:2:2 or 4:4:4 input."};
   }
 
-  if (heif_image_get_bits_per_pixel(image, heif_channel_Y) != 8) {
-    jpeg_destroy_compress(&cinfo);
+  if (heif_image_get_bits_per_pixel(image, heif_channel_Y) != 8 ||
+      heif_image_get_bits_per_pixel(image, heif_channel_Cb) != 8 ||
+      heif_image_get_bits_per_pixel(image, heif_channel_Cr) != 8) {
     return heif_error{heif_error_Encoding_error, heif_suberror_Encoder_encoding, "Cannot write JPEG image with >8 bpp."};
   }
 
-  uint8_t* outbuffer = nullptr;
-#if defined(LIBJPEG_TURBO_VERSION) || (JPEG_LIB_VERSION_MAJOR < 9 || (JPEG_LIB_VERSION_MAJOR == 9 && JPEG_LIB_VERSION_MINOR < 4))
-  unsigned long outlength = 0;
-#else
-  size_t outlength = 0;
-#endif
+  struct jpeg_compress_struct& cinfo = encoder->cinfo;
+
+  if (!encoder->cinfo_created) {
+    cinfo.err = jpeg_std_error(reinterpret_cast<struct jpeg_error_mgr*>(&encoder->jerr));
+    encoder->jerr.pub.error_exit = &OnJpegError;
+    jpeg_create_compress(&cinfo);
+    encoder->cinfo_created = true;
+  }
+
+  free(encoder->compressed_data);
+  encoder->compressed_data = nullptr;
+  encoder->compressed_size = 0;
+
+  if (setjmp(encoder->jerr.setjmp_buffer)) {
+    cinfo.err->output_message(reinterpret_cast<j_common_ptr>(&cinfo));
 
-  jpeg_create_compress(&cinfo);
-  jpeg_mem_dest(&cinfo, &outbuffer, &outlength);
+    // Return the compressor to its idle state such that it can be used for the next image.
+    jpeg_abort_compress(&cinfo);
+    encoder->cinfo_configured = false;
+    free(encoder->compressed_data);
+    encoder->compressed_data = nullptr;
+    encoder->compressed_size = 0;
 
-  cinfo.image_width = heif_image_get_width(image, heif_channel_Y);
-  cinfo.image_height = heif_image_get_height(image, heif_channel_Y);
-  cinfo.input_components = 3;
-  cinfo.in_color_space = JCS_YCbCr;
-  jpeg_set_defaults(&cinfo);
-  static const boolean kForceBaseline = TRUE;
-  jpeg_set_quality(&cinfo, encoder->quality, kForceBaseline);
+    return heif_error{heif_error_Encoding_error, heif_suberror_Encoder_encoding, "JPEG encoding error"};
+  }
+
+  // The output buffer is passed on without copying it and released with the next image.
+  jpeg_mem_dest(&cinfo, &encoder->compressed_data, &encoder->compressed_size);
+
+  JDIMENSION width = heif_image_get_width(image, heif_channel_Y);
+  JDIMENSION height = heif_image_get_height(image, heif_channel_Y);
+
+  if (!encoder->cinfo_configured ||
+      encoder->configured_width != width ||
+      encoder->configured_height != height ||
+      encoder->configured_chroma != chroma ||
+      encoder->configured_quality != encoder->quality) {
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    static const boolean kForceBaseline = TRUE;
+    jpeg_set_quality(&cinfo, encoder->quality, kForceBaseline);
+
+    // The planes are passed to libjpeg in their own subsampling, without interleaving and chroma upsampling.
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = (chroma == heif_chroma_444) ? 1 : 2;
+    cinfo.comp_info[0].v_samp_factor = (chroma == heif_chroma_420) ? 2 : 1;
+    for (int c = 1; c < 3; c++) {
+      cinfo.comp_info[c].h_samp_factor = 1;
+      cinfo.comp_info[c].v_samp_factor = 1;
+    }
+
+    encoder->cinfo_configured = true;
+    encoder->configured_width = width;
+    encoder->configured_height = height;
+    encoder->configured_chroma = chroma;
+    encoder->configured_quality = encoder->quality;
+  }
+
+  // Each image is a complete JPEG stream (including all tables) that is stored in its own item.
   static const boolean kWriteAllTables = TRUE;
   jpeg_start_compress(&cinfo, kWriteAllTables);
 
 
+  // jpeg_write_raw_data() codes one row of iMCUs per call. It reads the complete DCT blocks of each component,
+  // which may extend beyond the plane. The rows are taken directly from the planes if they cover the whole
+  // blocks. Otherwise, they are copied into a buffer that is padded by replicating the last column.
+  // Rows below the plane repeat its last row.
+
+  const heif_channel channels[3] = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+  const uint8_t* planes[3];
+  size_t strides[3];
+  uint32_t plane_widths[3];
+  uint32_t plane_heights[3];
 
-  size_t stride_y;
-  const uint8_t* row_y = heif_image_get_plane_readonly2(image, heif_channel_Y,
-                                                        &stride_y);
-  size_t stride_u;
-  const uint8_t* row_u = heif_image_get_plane_readonly2(image, heif_channel_Cb,
-                                                        &stride_u);
-  size_t stride_v;
-  const uint8_t* row_v = heif_image_get_plane_readonly2(image, heif_channel_Cr,
-                                                        &stride_v);
-
-  JSAMPARRAY buffer = cinfo.mem->alloc_sarray(
-      reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE,
-      cinfo.image_width * cinfo.input_components, 1);
-  JSAMPROW row[1] = {buffer[0]};
-
-  while (cinfo.next_scanline < cinfo.image_height) {
-    size_t offset_y = cinfo.next_scanline * stride_y;
-    const uint8_t* start_y = &row_y[offset_y];
-    size_t offset_u = (cinfo.next_scanline / 2) * stride_u;
-    const uint8_t* start_u = &row_u[offset_u];
-    size_t offset_v = (cinfo.next_scanline / 2) * stride_v;
-    const uint8_t* start_v = &row_v[offset_v];
-
-    JOCTET* bufp = buffer[0];
-    for (JDIMENSION x = 0; x < cinfo.image_width; ++x) {
-      *bufp++ = start_y[x];
-      *bufp++ = start_u[x / 2];
-      *bufp++ = start_v[x / 2];
+  JSAMPARRAY component_rows[3];
+  JSAMPARRAY padded_rows[3];
+  JDIMENSION rows_per_iMCU[3];
+
+  for (int c = 0; c < 3; c++) {
+    planes[c] = heif_image_get_plane_readonly2(image, channels[c], &strides[c]);
+    plane_widths[c] = heif_image_get_width(image, channels[c]);
+    plane_heights[c] = heif_image_get_height(image, channels[c]);
+
+    jpeg_component_info* comp = &cinfo.comp_info[c];
+    rows_per_iMCU[c] = comp->v_samp_factor * DCTSIZE;
+    component_rows[c] = (*cinfo.mem->alloc_sarray)
+        (reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, 1, rows_per_iMCU[c]);
+
+    JDIMENSION padded_width = comp->width_in_blocks * DCTSIZE;
+    if (padded_width > plane_widths[c]) {
+      padded_rows[c] = (*cinfo.mem->alloc_sarray)
+          (reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, padded_width, rows_per_iMCU[c]);
+    }
+    else {
+      padded_rows[c] = nullptr;
     }
-    jpeg_write_scanlines(&cinfo, row, 1);
   }
+
+  for (JDIMENSION iMCU_row = 0; cinfo.next_scanline < cinfo.image_height; iMCU_row++) {
+    for (int c = 0; c < 3; c++) {
+      JDIMENSION padded_width = cinfo.comp_info[c].width_in_blocks * DCTSIZE;
+
+      for (JDIMENSION i = 0; i < rows_per_iMCU[c]; i++) {
+        uint32_t y = std::min(iMCU_row * rows_per_iMCU[c] + i, plane_heights[c] - 1);
+        const uint8_t* src = planes[c] + y * strides[c];
+
+        if (padded_rows[c]) {
+          JSAMPROW dst = padded_rows[c][i];
+          memcpy(dst, src, plane_widths[c]);
+          memset(dst + plane_widths[c], src[plane_widths[c] - 1], padded_width - plane_widths[c]);
+          component_rows[c][i] = dst;
+        }
+        else {
+          component_rows[c][i] = const_cast<JSAMPROW>(src);
+        }
+      }
+    }
+
+    jpeg_write_raw_data(&cinfo, component_rows, rows_per_iMCU[0]);
+  }
+
   jpeg_finish_compress(&cinfo);
-  jpeg_destroy_compress(&cinfo);
 
   encoder->data_read = false;
-  encoder->compressed_data.resize(outlength);
-  memcpy(encoder->compressed_data.data(), outbuffer, outlength);
-
-  free(outbuffer);
 
   return heif_error_ok;
 }
@@ -435,8 +535,8 @@ struct heif_error jpeg_get_compressed_data(void* encoder_raw, uint8_t** data, in
     *size = 0;
   }
   else {
-    *data = encoder->compressed_data.data();
-    *size = (int) encoder->compressed_data.size();
+    *data = encoder->compressed_data;
+    *size = (int) encoder->compressed_size;
     encoder->data_read = true;
   }
 
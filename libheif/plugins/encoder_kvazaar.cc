@@ -43,11 +43,20 @@ struct encoder_struct_kvazaar
 {
   int quality = 75;
   bool lossless = false;
+  int speed_class = -1; // -1: the encoder defaults without a preset
 
   std::vector<uint8_t> output_data;
   size_t output_idx = 0;
 };
 
+static const char* kParam_speed_class = heif_encoder_parameter_name_speed_class;
+
+// sorted from the fastest to the slowest preset, such that the speed class N selects preset 9-N
+static const char* const kPresets[] = {
+    "ultrafast", "superfast", "veryfast", "faster", "fast", "medium",
+    "slow", "slower", "veryslow", "placebo", nullptr
+};
+
 static const int kvazaar_PLUGIN_PRIORITY = 100;
 
 #define MAX_PLUGIN_NAME_LENGTH 80
@@ -97,6 +106,19 @@ static void kvazaar_init_parameters()
   p->has_default = true;
   d[i++] = p++;
 
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_speed_class;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 4; // "medium"
+  p->has_default = false; // without a speed class, no preset is applied
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 9;
+  p->integer.valid_values = NULL;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   d[i++] = nullptr;
 }
 
@@ -208,6 +230,14 @@ static struct heif_error kvazaar_set_parameter_integer(void* encoder_raw, const
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return kvazaar_set_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (value < 0 || value > 9) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    encoder->speed_class = value;
+    return heif_error_ok;
+  }
 
   return heif_error_unsupported_parameter;
 }
@@ -222,6 +252,15 @@ static struct heif_error kvazaar_get_parameter_integer(void* encoder_raw, const
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return kvazaar_get_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (encoder->speed_class < 0) {
+      // not set, the encoder does not use a preset
+      return heif_error_invalid_parameter_value;
+    }
+
+    *value = encoder->speed_class;
+    return heif_error_ok;
+  }
 
   return heif_error_unsupported_parameter;
 }
@@ -418,6 +457,10 @@ static struct heif_error kvazaar_encode_image(void* encoder_raw, const struct he
   kvz_config* config = uconfig.get();
   api->config_init(config); // param, encoder->preset.c_str(), encoder->tune.c_str());
 
+  if (encoder->speed_class >= 0) {
+    api->config_parse(config, "preset", kPresets[9 - encoder->speed_class]);
+  }
+
 #if HAVE_KVAZAAR_ENABLE_LOGGING
   config->enable_logging_output = 0;
 #endif
@@ -55,8 +55,9 @@ struct encoder_struct_rav1e
 //static const char* kError_out_of_memory = "Out of memory";
 
 static const char* kParam_min_q = "min-q";
-static const char* kParam_threads = "threads";
+static const char* kParam_threads = heif_encoder_parameter_name_threads;
 static const char* kParam_speed = "speed";
+static const char* kParam_speed_class = heif_encoder_parameter_name_speed_class;
 
 static const char* kParam_chroma = "chroma";
 static const char* const kParam_chroma_valid_values[] = {
@@ -98,6 +99,19 @@ static void rav1e_init_parameters()
   const struct heif_encoder_parameter** d = rav1e_encoder_parameter_ptrs;
   int i = 0;
 
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_speed_class;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 7;
+  p->has_default = false; // the default is set with the native speed parameter
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 9;
+  p->integer.valid_values = NULL;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   assert(i < MAX_NPARAMETERS);
   p->version = 2;
   p->name = kParam_speed;
@@ -319,6 +333,15 @@ struct heif_error rav1e_set_parameter_integer(void* encoder_raw, const char* nam
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return rav1e_set_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (value < 0 || value > 9) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    // rav1e speeds 0 (slowest) to 10 (fastest)
+    encoder->speed = (value * 10 + 4) / 9;
+    return heif_error_ok;
+  }
 
   set_value(kParam_min_q, min_q);
   set_value(kParam_threads, threads);
@@ -339,6 +362,10 @@ struct heif_error rav1e_get_parameter_integer(void* encoder_raw, const char* nam
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return rav1e_get_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    *value = (encoder->speed * 9 + 5) / 10;
+    return heif_error_ok;
+  }
 
   get_value(kParam_min_q, min_q);
   get_value(kParam_threads, threads);
@@ -23,6 +23,7 @@
 #include "encoder_svt.h"
 #include <vector>
 #include <cstring>
+#include <deque>
 #include <cassert>
 #include <algorithm>
 #include <memory>
@@ -65,6 +66,22 @@ struct encoder_struct_svt
 
   std::vector<uint8_t> compressed_data;
   bool data_read = false;
+
+  // --- sequence encoding
+
+  heif_sequence_encoding_options sequence_options{};
+  EbComponentType* sequence_encoder = nullptr;
+
+  struct coded_frame
+  {
+    std::vector<uint8_t> data;
+    uintptr_t frame_number = 0;
+    bool is_keyframe = false;
+  };
+
+  // in decoding order
+  std::deque<coded_frame> coded_frames;
+  bool coded_frame_returned = false;
 };
 
 //static const char* kError_out_of_memory = "Out of memory";
@@ -72,8 +89,9 @@ struct encoder_struct_svt
 static const char* kParam_min_q = "min-q";
 static const char* kParam_max_q = "max-q";
 static const char* kParam_qp = "qp";
-static const char* kParam_threads = "threads";
+static const char* kParam_threads = heif_encoder_parameter_name_threads;
 static const char* kParam_speed = "speed";
+static const char* kParam_speed_class = heif_encoder_parameter_name_speed_class;
 
 #if SVT_AV1_CHECK_VERSION(0, 9, 1)
 static const char* kParam_tune = "tune";
@@ -128,7 +146,7 @@ int int_log2(int pow2_value)
   return v;
 }
 
-#define MAX_NPARAMETERS 11
+#define MAX_NPARAMETERS 12
 
 static struct heif_encoder_parameter svt_encoder_params[MAX_NPARAMETERS];
 static const struct heif_encoder_parameter* svt_encoder_parameter_ptrs[MAX_NPARAMETERS + 1];
@@ -139,6 +157,19 @@ static void svt_init_parameters()
   const struct heif_encoder_parameter** d = svt_encoder_parameter_ptrs;
   int i = 0;
 
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_speed_class;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 8;
+  p->has_default = false; // the default is set with the native speed parameter
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 9;
+  p->integer.valid_values = nullptr;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   assert(i < MAX_NPARAMETERS);
   p->version = 2;
   p->name = kParam_speed;
@@ -305,10 +336,15 @@ struct heif_error svt_new_encoder(void** enc)
   return err;
 }
 
+static void svt_close_sequence_encoder(struct encoder_struct_svt* encoder);
+
+
 void svt_free_encoder(void* encoder_raw)
 {
   auto* encoder = (struct encoder_struct_svt*) encoder_raw;
 
+  svt_close_sequence_encoder(encoder);
+
   delete encoder;
 }
 
@@ -415,6 +451,15 @@ struct heif_error svt_set_parameter_integer(void* encoder_raw, const char* name,
     encoder->qp_set = true;
     return heif_error_ok;
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (value < 0 || value > 9) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    // SVT-AV1 presets 0 (slowest) to 13 (fastest)
+    encoder->speed = (value * 13 + 4) / 9;
+    return heif_error_ok;
+  }
 
   set_value(kParam_min_q, min_q);
   set_value(kParam_max_q, max_q);
@@ -436,6 +481,10 @@ struct heif_error svt_get_parameter_integer(void* encoder_raw, const char* name,
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return svt_get_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    *value = (encoder->speed * 9 + 6) / 13;
+    return heif_error_ok;
+  }
 
   get_value(kParam_min_q, min_q);
   get_value(kParam_max_q, max_q);
@@ -650,60 +699,68 @@ void svt_query_encoded_size(void* encoder_raw, uint32_t input_width, uint32_t in
 }
 
 
-struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* image,
-                                   heif_image_input_class input_class)
+// Determines the SVT color format of the image. Returns false for unsupported chroma formats.
+static bool svt_get_color_format(const struct heif_image* image, heif_image_input_class input_class,
+                                 EbColorFormat* out_color_format, uint8_t* out_yShift)
 {
-  auto* encoder = (struct encoder_struct_svt*) encoder_raw;
-  EbErrorType res = EB_ErrorNone;
-
-  encoder->compressed_data.clear();
-
-  int w = heif_image_get_width(image, heif_channel_Y);
-  int h = heif_image_get_height(image, heif_channel_Y);
-
-  uint32_t encoded_width, encoded_height;
-  svt_query_encoded_size(encoder_raw, w, h, &encoded_width, &encoded_height);
-
-  // Note: it is ok to cast away the const, as the image content is not changed.
-  // However, we have to guarantee that there are no plane pointers or stride values kept over calling the svt_encode_image() function.
-  heif_error err = heif_image_extend_padding_to_size(const_cast<struct heif_image*>(image),
-                                                     (int) encoded_width,
-                                                     (int) encoded_height);
-  if (err.code) {
-    return err;
-  }
-
   const heif_chroma chroma = heif_image_get_chroma_format(image);
-  int bitdepth_y = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
 
-  uint8_t yShift = 0;
-  EbColorFormat color_format = EB_YUV420;
+  *out_yShift = 0;
+  *out_color_format = EB_YUV420;
 
   if (input_class == heif_image_input_class_alpha) {
-    color_format = EB_YUV420;
+    *out_color_format = EB_YUV420;
     //chromaPosition = RA_CHROMA_SAMPLE_POSITION_UNKNOWN;
-    yShift = 1;
+    *out_yShift = 1;
   }
   else {
     switch (chroma) {
       case heif_chroma_444:
-        color_format = EB_YUV444;
+        *out_color_format = EB_YUV444;
         //chromaPosition = RA_CHROMA_SAMPLE_POSITION_COLOCATED;
         break;
       case heif_chroma_422:
-        color_format = EB_YUV422;
+        *out_color_format = EB_YUV422;
         //chromaPosition = RA_CHROMA_SAMPLE_POSITION_COLOCATED;
         break;
       case heif_chroma_420:
-        color_format = EB_YUV420;
+        *out_color_format = EB_YUV420;
         //chromaPosition = RA_CHROMA_SAMPLE_POSITION_UNKNOWN; // TODO: set to CENTER when AV1 and svt supports this
-        yShift = 1;
+        *out_yShift = 1;
         break;
       default:
-        return heif_error_codec_library_error;
+        return false;
     }
   }
 
+  return true;
+}
+
+
+// Creates and initializes the SVT encoder for 'image'.
+// When encoding a sequence, 'sequence' contains its GOP parameters. It is NULL for still images.
+static struct heif_error svt_init_encoder(struct encoder_struct_svt* encoder, const struct heif_image* image,
+                                          heif_image_input_class input_class,
+                                          const struct heif_sequence_encoding_options* sequence,
+                                          EbComponentType** out_svt_encoder)
+{
+  EbErrorType res = EB_ErrorNone;
+
+  int w = heif_image_get_width(image, heif_channel_Y);
+  int h = heif_image_get_height(image, heif_channel_Y);
+
+  uint32_t encoded_width, encoded_height;
+  svt_query_encoded_size(encoder, w, h, &encoded_width, &encoded_height);
+
+  int bitdepth_y = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
+
+  uint8_t yShift = 0;
+  EbColorFormat color_format = EB_YUV420;
+
+  if (!svt_get_color_format(image, input_class, &color_format, &yShift)) {
+    return heif_error_codec_library_error;
+  }
+
 
   // --- initialize the encoder
 
@@ -730,7 +787,7 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
 #endif
 
   struct heif_color_profile_nclx* nclx = nullptr;
-  err = heif_image_get_nclx_color_profile(image, &nclx);
+  heif_error err = heif_image_get_nclx_color_profile(image, &nclx);
   if (err.code != heif_error_Ok) {
     nclx = nullptr;
   }
@@ -810,6 +867,22 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
     svt_config.profile = HIGH_PROFILE;
   }
 
+  if (sequence) {
+    if (sequence->framerate_numerator && sequence->framerate_denominator) {
+      svt_config.frame_rate_numerator = sequence->framerate_numerator;
+      svt_config.frame_rate_denominator = sequence->framerate_denominator;
+    }
+
+    // SVT-AV1 has no minimum keyframe distance.
+    if (sequence->keyframe_distance_max > 0) {
+      svt_config.intra_period_length = sequence->keyframe_distance_max - 1;
+    }
+
+    if (sequence->gop_structure == heif_sequence_gop_structure_lowdelay) {
+      svt_config.pred_structure = 1; // low delay
+    }
+  }
+
   res = svt_av1_enc_set_parameter(svt_encoder, &svt_config);
   if (res == EB_ErrorBadParameter) {
     svt_av1_enc_deinit(svt_encoder);
@@ -824,11 +897,55 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
     return heif_error_codec_library_error;
   }
 
+  *out_svt_encoder = svt_encoder;
+
+  return heif_error_ok;
+}
+
+
+// An SVT input picture that references the planes of a heif_image.
+struct svt_input_picture
+{
+  EbBufferHeaderType buffer;
+  EbSvtIOFormat format;
+  std::vector<uint8_t> dummy_color_plane;
+};
+
+
+static struct heif_error svt_fill_input_picture(struct encoder_struct_svt* encoder, const struct heif_image* image,
+                                                heif_image_input_class input_class,
+                                                svt_input_picture& picture)
+{
+  int w = heif_image_get_width(image, heif_channel_Y);
+  int h = heif_image_get_height(image, heif_channel_Y);
+
+  uint32_t encoded_width, encoded_height;
+  svt_query_encoded_size(encoder, w, h, &encoded_width, &encoded_height);
+
+  // Note: it is ok to cast away the const, as the image content is not changed.
+  // However, we have to guarantee that there are no plane pointers or stride values kept over calling the svt_encode_image() function.
+  heif_error err = heif_image_extend_padding_to_size(const_cast<struct heif_image*>(image),
+                                                     (int) encoded_width,
+                                                     (int) encoded_height);
+  if (err.code) {
+    return err;
+  }
+
+  int bitdepth_y = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
+
+  uint8_t yShift = 0;
+  EbColorFormat color_format = EB_YUV420;
+
+  if (!svt_get_color_format(image, input_class, &color_format, &yShift)) {
+    return heif_error_codec_library_error;
+  }
+
 
   // --- copy libheif image to svt image
 
-  EbBufferHeaderType input_buffer;
-  input_buffer.p_buffer = (uint8_t*) (new EbSvtIOFormat());
+  EbBufferHeaderType& input_buffer = picture.buffer;
+  memset(&input_buffer, 0, sizeof(EbBufferHeaderType));
+  input_buffer.p_buffer = (uint8_t*) (&picture.format);
 
   memset(input_buffer.p_buffer, 0, sizeof(EbSvtIOFormat));
   input_buffer.size = sizeof(EbBufferHeaderType);
@@ -839,7 +956,7 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
   auto* input_picture_buffer = (EbSvtIOFormat*) input_buffer.p_buffer;
 
   int bytesPerPixel = bitdepth_y > 8 ? 2 : 1;
-  std::vector<uint8_t> dummy_color_plane;
+  std::vector<uint8_t>& dummy_color_plane = picture.dummy_color_plane;
   if (input_class == heif_image_input_class_alpha) {
     size_t stride;
     input_picture_buffer->luma = (uint8_t*) heif_image_get_plane_readonly2(image, heif_channel_Y, &stride);
@@ -892,13 +1009,53 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
   input_buffer.flags = 0;
   input_buffer.pts = 0;
 
+  return heif_error_ok;
+}
+
+
+static EbErrorType svt_send_eos(EbComponentType* svt_encoder)
+{
+  EbBufferHeaderType flush_input_buffer;
+  flush_input_buffer.n_alloc_len = 0;
+  flush_input_buffer.n_filled_len = 0;
+  flush_input_buffer.n_tick_count = 0;
+  flush_input_buffer.p_app_private = nullptr;
+  flush_input_buffer.flags = EB_BUFFERFLAG_EOS;
+  flush_input_buffer.p_buffer = nullptr;
+  flush_input_buffer.metadata = nullptr;
+
+  return svt_av1_enc_send_picture(svt_encoder, &flush_input_buffer);
+}
+
+
+struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* image,
+                                   heif_image_input_class input_class)
+{
+  auto* encoder = (struct encoder_struct_svt*) encoder_raw;
+  EbErrorType res = EB_ErrorNone;
+
+  encoder->compressed_data.clear();
+
+  svt_input_picture input_picture;
+  heif_error err = svt_fill_input_picture(encoder, image, input_class, input_picture);
+  if (err.code) {
+    return err;
+  }
+
+  EbComponentType* svt_encoder = nullptr;
+  err = svt_init_encoder(encoder, image, input_class, nullptr, &svt_encoder);
+  if (err.code) {
+    return err;
+  }
+
+  EbBufferHeaderType& input_buffer = input_picture.buffer;
+
   EbAv1PictureType frame_type = EB_AV1_KEY_PICTURE;
 
   input_buffer.pic_type = frame_type;
 
   res = svt_av1_enc_send_picture(svt_encoder, &input_buffer);
   if (res != EB_ErrorNone) {
-    delete input_buffer.p_buffer;
     svt_av1_enc_deinit(svt_encoder);
     svt_av1_enc_deinit_handle(svt_encoder);
     return heif_error_codec_library_error;
@@ -907,21 +1064,9 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
 
   // --- flush encoder
 
-  EbErrorType ret = EB_ErrorNone;
-
-  EbBufferHeaderType flush_input_buffer;
-  flush_input_buffer.n_alloc_len = 0;
-  flush_input_buffer.n_filled_len = 0;
-  flush_input_buffer.n_tick_count = 0;
-  flush_input_buffer.p_app_private = nullptr;
-  flush_input_buffer.flags = EB_BUFFERFLAG_EOS;
-  flush_input_buffer.p_buffer = nullptr;
-  flush_input_buffer.metadata = nullptr;
-
-  ret = svt_av1_enc_send_picture(svt_encoder, &flush_input_buffer);
+  EbErrorType ret = svt_send_eos(svt_encoder);
 
   if (ret != EB_ErrorNone) {
-    delete input_buffer.p_buffer;
     svt_av1_enc_deinit(svt_encoder);
     svt_av1_enc_deinit_handle(svt_encoder);
     return heif_error_codec_library_error;
@@ -956,7 +1101,6 @@ struct heif_error svt_encode_image(void* encoder_raw, const struct heif_image* i
   } while (res == EB_ErrorNone && !encode_at_eos);
 
 
-  delete input_buffer.p_buffer;
   svt_av1_enc_deinit(svt_encoder);
   svt_av1_enc_deinit_handle(svt_encoder);
 
@@ -988,9 +1132,164 @@ struct heif_error svt_get_compressed_data(void* encoder_raw, uint8_t** data, int
 }
 
 
+// --- sequence encoding
+
+static void svt_close_sequence_encoder(struct encoder_struct_svt* encoder)
+{
+  if (encoder->sequence_encoder) {
+    svt_av1_enc_deinit(encoder->sequence_encoder);
+    svt_av1_enc_deinit_handle(encoder->sequence_encoder);
+    encoder->sequence_encoder = nullptr;
+  }
+}
+
+
+struct heif_error svt_start_sequence_encoding(void* encoder_raw, const struct heif_sequence_encoding_options* options)
+{
+  auto* encoder = (struct encoder_struct_svt*) encoder_raw;
+
+  svt_close_sequence_encoder(encoder);
+
+  // The encoder is initialized with the first frame, when the image format is known.
+  encoder->sequence_options = *options;
+  encoder->coded_frames.clear();
+  encoder->coded_frame_returned = false;
+
+  return heif_error_ok;
+}
+
+
+// Moves the available packets into the queue of coded frames.
+// With 'done_sending_pics', this waits until the encoder has returned all frames.
+static struct heif_error svt_queue_coded_frames(struct encoder_struct_svt* encoder, bool done_sending_pics)
+{
+  for (;;) {
+    EbBufferHeaderType* output_buf = nullptr;
+
+    EbErrorType res = svt_av1_enc_get_packet(encoder->sequence_encoder, &output_buf, (uint8_t) done_sending_pics);
+    if (res == EB_NoErrorEmptyQueue) {
+      return heif_error_ok;
+    }
+    else if (res != EB_ErrorNone) {
+      return heif_error_codec_library_error;
+    }
+
+    if (output_buf == nullptr) {
+      return heif_error_ok;
+    }
+
+    bool encode_at_eos = ((output_buf->flags & EB_BUFFERFLAG_EOS) == EB_BUFFERFLAG_EOS);
+
+    if (output_buf->p_buffer && (output_buf->n_filled_len > 0)) {
+      auto frame_number = (uintptr_t) output_buf->pts;
+
+      // Each packet should be a complete temporal unit. Just in case, we join packets of the same frame.
+      if (encoder->coded_frames.empty() || encoder->coded_frames.back().frame_number != frame_number) {
+        encoder_struct_svt::coded_frame frame;
+        frame.frame_number = frame_number;
+        frame.is_keyframe = (output_buf->pic_type == EB_AV1_KEY_PICTURE);
+        encoder->coded_frames.push_back(std::move(frame));
+      }
+
+      auto& data = encoder->coded_frames.back().data;
+      data.insert(data.end(), output_buf->p_buffer, output_buf->p_buffer + output_buf->n_filled_len);
+    }
+
+    svt_av1_enc_release_out_buffer(&output_buf);
+
+    if (encode_at_eos) {
+      return heif_error_ok;
+    }
+  }
+}
+
+
+struct heif_error svt_encode_sequence_frame(void* encoder_raw, const struct heif_image* image,
+                                            heif_image_input_class input_class,
+                                            uintptr_t frame_number)
+{
+  auto* encoder = (struct encoder_struct_svt*) encoder_raw;
+
+  svt_input_picture input_picture;
+  heif_error err = svt_fill_input_picture(encoder, image, input_class, input_picture);
+  if (err.code) {
+    return err;
+  }
+
+  if (!encoder->sequence_encoder) {
+    err = svt_init_encoder(encoder, image, input_class, &encoder->sequence_options, &encoder->sequence_encoder);
+    if (err.code) {
+      return err;
+    }
+  }
+
+  input_picture.buffer.pts = (int64_t) frame_number;
+
+  // The encoder copies the picture. The image planes are not referenced after this call.
+  EbErrorType res = svt_av1_enc_send_picture(encoder->sequence_encoder, &input_picture.buffer);
+  if (res != EB_ErrorNone) {
+    return heif_error_codec_library_error;
+  }
+
+  return svt_queue_coded_frames(encoder, false);
+}
+
+
+struct heif_error svt_end_sequence_encoding(void* encoder_raw)
+{
+  auto* encoder = (struct encoder_struct_svt*) encoder_raw;
+
+  if (!encoder->sequence_encoder) {
+    return heif_error_ok;
+  }
+
+  if (svt_send_eos(encoder->sequence_encoder) != EB_ErrorNone) {
+    return heif_error_codec_library_error;
+  }
+
+  heif_error err = svt_queue_coded_frames(encoder, true);
+
+  svt_close_sequence_encoder(encoder);
+
+  return err;
+}
+
+
+struct heif_error svt_get_compressed_data2(void* encoder_raw, uint8_t** data, int* size,
+                                           uintptr_t* frame_number, int* is_keyframe,
+                                           enum heif_encoded_data_type* type)
+{
+  auto* encoder = (struct encoder_struct_svt*) encoder_raw;
+
+  *data = nullptr;
+  *size = 0;
+
+  if (encoder->coded_frames.empty()) {
+    return heif_error_ok;
+  }
+
+  if (encoder->coded_frame_returned) {
+    // end of frame
+    encoder->coded_frames.pop_front();
+    encoder->coded_frame_returned = false;
+    return heif_error_ok;
+  }
+
+  auto& frame = encoder->coded_frames.front();
+  *data = frame.data.data();
+  *size = (int) frame.data.size();
+  *frame_number = frame.frame_number;
+  *is_keyframe = frame.is_keyframe;
+
+  encoder->coded_frame_returned = true;
+
+  return heif_error_ok;
+}
+
+
 static const struct heif_encoder_plugin encoder_plugin_svt
     {
-        /* plugin_api_version */ 3,
+        /* plugin_api_version */ 4,
         /* compression_format */ heif_compression_AV1,
         /* id_name */ "svt",
         /* priority */ SVT_PLUGIN_PRIORITY,
@@ -1022,7 +1321,11 @@ static const struct heif_encoder_plugin encoder_plugin_svt
         /* encode_image */ svt_encode_image,
         /* get_compressed_data */ svt_get_compressed_data,
         /* query_input_colorspace (v2) */ svt_query_input_colorspace2,
-        /* query_encoded_size (v3) */ svt_query_encoded_size
+        /* query_encoded_size (v3) */ svt_query_encoded_size,
+        /* start_sequence_encoding (v4) */ svt_start_sequence_encoding,
+        /* encode_sequence_frame (v4) */ svt_encode_sequence_frame,
+        /* end_sequence_encoding (v4) */ svt_end_sequence_encoding,
+        /* get_compressed_data2 (v4) */ svt_get_compressed_data2
     };
 
 const struct heif_encoder_plugin* get_encoder_plugin_svt()
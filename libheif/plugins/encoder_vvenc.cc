@@ -45,11 +45,20 @@ struct encoder_struct_vvenc
 {
   int quality = 32;
   bool lossless = false;
+  int speed_class = 4;
 
   std::vector<uint8_t> output_data;
   size_t output_idx = 0;
 };
 
+static const char* kParam_speed_class = heif_encoder_parameter_name_speed_class;
+
+// vvenc has five presets, each is selected by two neighboring speed classes
+static const vvencPresetMode kPresets[] = {
+    VVENC_SLOWER, VVENC_SLOWER, VVENC_SLOW, VVENC_SLOW, VVENC_MEDIUM,
+    VVENC_MEDIUM, VVENC_FAST, VVENC_FAST, VVENC_FASTER, VVENC_FASTER
+};
+
 static const int vvenc_PLUGIN_PRIORITY = 100;
 
 #define MAX_PLUGIN_NAME_LENGTH 80
@@ -99,6 +108,19 @@ static void vvenc_init_parameters()
   p->has_default = true;
   d[i++] = p++;
 
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_speed_class;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 4; // VVENC_MEDIUM
+  p->has_default = true;
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 9;
+  p->integer.valid_values = NULL;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   d[i++] = nullptr;
 }
 
@@ -210,6 +232,14 @@ static struct heif_error vvenc_set_parameter_integer(void* encoder_raw, const ch
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return vvenc_set_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (value < 0 || value > 9) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    encoder->speed_class = value;
+    return heif_error_ok;
+  }
 
   return heif_error_unsupported_parameter;
 }
@@ -224,6 +254,10 @@ static struct heif_error vvenc_get_parameter_integer(void* encoder_raw, const ch
   else if (strcmp(name, heif_encoder_parameter_name_lossless) == 0) {
     return vvenc_get_parameter_lossless(encoder, value);
   }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    *value = encoder->speed_class;
+    return heif_error_ok;
+  }
 
   return heif_error_unsupported_parameter;
 }
@@ -443,7 +477,7 @@ static struct heif_error vvenc_encode_image(void* encoder_raw, const struct heif
 
   int ret = vvenc_init_default(&params, encoded_width, encoded_height, 25, 0,
                                encoder_quality,
-                               VVENC_MEDIUM);
+                               kPresets[encoder->speed_class]);
   if (ret != VVENC_OK) {
     // TODO: cleanup memory
 
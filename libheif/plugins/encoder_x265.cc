@@ -27,6 +27,7 @@
 #include <cstring>
 #include <cstdio>
 #include <cassert>
+#include <deque>
 #include <vector>
 
 extern "C" {
@@ -86,6 +87,51 @@ struct encoder_struct_x265
   int logLevel = X265_LOG_NONE;
 
   std::string last_error_message;
+
+  // Incremented whenever a parameter changes, such that an open encoder is not reused with outdated settings.
+  uint32_t parameters_generation = 0;
+
+  // --- still image encoder reuse
+
+  // The encoder is kept open after encoding a still image. When the next image has the same format
+  // (e.g. the tiles of a grid image), it is encoded with the same encoder instance.
+  struct still_image_format
+  {
+    int width = 0;
+    int height = 0;
+    heif_colorspace colorspace = heif_colorspace_undefined;
+    heif_chroma chroma = heif_chroma_undefined;
+    int bit_depth = 0;
+    heif_image_input_class input_class = heif_image_input_class_normal;
+    bool has_nclx = false;
+    heif_color_primaries color_primaries = heif_color_primaries_unspecified;
+    heif_transfer_characteristics transfer_characteristics = heif_transfer_characteristic_unspecified;
+    heif_matrix_coefficients matrix_coefficients = heif_matrix_coefficients_unspecified;
+    uint8_t full_range_flag = 0;
+    uint32_t parameters_generation = 0;
+
+    bool operator==(const still_image_format&) const = default;
+  };
+
+  still_image_format still_format;
+  bool still_encoder_reusable = false;
+  int64_t still_pts = 0;
+
+  // --- sequence encoding
+
+  heif_sequence_encoding_options sequence_options{};
+  x265_param* sequence_param = nullptr;
+
+  struct coded_frame
+  {
+    std::vector<std::vector<uint8_t>> nals;
+    uintptr_t frame_number = 0;
+    bool is_keyframe = false;
+  };
+
+  // in decoding order
+  std::deque<coded_frame> coded_frames;
+  size_t coded_frame_nal_index = 0;
 };
 
 
@@ -106,6 +152,8 @@ void encoder_struct_x265::add_param(const parameter& p)
   // and add the new parameter at the end of the list
 
   parameters.push_back(p);
+
+  parameters_generation++;
 }
 
 
@@ -153,7 +201,10 @@ static const char* kParam_preset = "preset";
 static const char* kParam_tune = "tune";
 static const char* kParam_TU_intra_depth = "tu-intra-depth";
 static const char* kParam_complexity = "complexity";
+static const char* kParam_threads = heif_encoder_parameter_name_threads;
+static const char* kParam_speed_class = heif_encoder_parameter_name_speed_class;
 
+// sorted from the fastest to the slowest preset, such that the speed class N selects preset 9-N
 static const char* const kParam_preset_valid_values[] = {
     "ultrafast", "superfast", "veryfast", "faster", "fast", "medium",
     "slow", "slower", "veryslow", "placebo", nullptr
@@ -229,6 +280,20 @@ static void x265_init_parameters()
   p->has_default = true;
   d[i++] = p++;
 
+  // Listed before the preset, such that copying all parameters keeps an explicitly set preset.
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_speed_class;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 3; // "slow"
+  p->has_default = false;
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 9;
+  p->integer.valid_values = NULL;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   assert(i < MAX_NPARAMETERS);
   p->version = 2;
   p->name = kParam_preset;
@@ -282,6 +347,19 @@ static void x265_init_parameters()
   p->string.valid_values = kParam_chroma_valid_values;
   d[i++] = p++;
 
+  assert(i < MAX_NPARAMETERS);
+  p->version = 2;
+  p->name = kParam_threads;
+  p->type = heif_encoder_parameter_type_integer;
+  p->integer.default_value = 0; // 0 = size of the thread pool chosen by x265
+  p->has_default = false;
+  p->integer.have_minimum_maximum = true;
+  p->integer.minimum = 0;
+  p->integer.maximum = 256;
+  p->integer.valid_values = NULL;
+  p->integer.num_valid_values = 0;
+  d[i++] = p++;
+
   d[i++] = nullptr;
 }
 
@@ -310,7 +388,8 @@ static struct heif_error x265_new_encoder(void** enc)
   struct heif_error err = heif_error_ok;
 
 
-  // encoder has to be allocated in x265_encode_image, because it needs to know the image size
+  // encoder has to be allocated in x265_encode_image, because it needs to know the image size.
+  // It is kept open for following images of the same size and format.
   encoder->encoder = nullptr;
 
   encoder->nals = nullptr;
@@ -337,6 +416,10 @@ static void x265_free_encoder(void* encoder_raw)
     api->encoder_close(encoder->encoder);
   }
 
+  if (encoder->sequence_param) {
+    x265_api_get(encoder->bit_depth)->param_free(encoder->sequence_param);
+  }
+
   delete encoder;
 }
 
@@ -391,6 +474,7 @@ static struct heif_error x265_set_parameter_logging_level(void* encoder_raw, int
   }
 
   encoder->logLevel = logging;
+  encoder->parameters_generation++;
 
   return heif_error_ok;
 }
@@ -431,6 +515,23 @@ static struct heif_error x265_set_parameter_integer(void* encoder_raw, const cha
     encoder->add_param(name, value);
     return heif_error_ok;
   }
+  else if (strcmp(name, kParam_threads) == 0) {
+    if (value < 0 || value > 256) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    encoder->add_param(name, value);
+    return heif_error_ok;
+  }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    if (value < 0 || value > 9) {
+      return heif_error_invalid_parameter_value;
+    }
+
+    encoder->preset = kParam_preset_valid_values[9 - value];
+    encoder->parameters_generation++;
+    return heif_error_ok;
+  }
 
   return heif_error_unsupported_parameter;
 }
@@ -453,6 +554,20 @@ static struct heif_error x265_get_parameter_integer(void* encoder_raw, const cha
     *value = encoder->get_param(name).value_int;
     return heif_error_ok;
   }
+  else if (strcmp(name, kParam_threads) == 0) {
+    *value = encoder->get_param(name).value_int;
+    return heif_error_ok;
+  }
+  else if (strcmp(name, kParam_speed_class) == 0) {
+    for (int i = 0; kParam_preset_valid_values[i]; i++) {
+      if (encoder->preset == kParam_preset_valid_values[i]) {
+        *value = 9 - i;
+        return heif_error_ok;
+      }
+    }
+
+    return heif_error_invalid_parameter_value;
+  }
 
   return heif_error_unsupported_parameter;
 }
@@ -502,6 +617,7 @@ static struct heif_error x265_set_parameter_string(void* encoder_raw, const char
     }
 
     encoder->preset = value;
+    encoder->parameters_generation++;
     return heif_error_ok;
   }
   else if (strcmp(name, kParam_tune) == 0) {
@@ -510,6 +626,7 @@ static struct heif_error x265_set_parameter_string(void* encoder_raw, const char
     }
 
     encoder->tune = value;
+    encoder->parameters_generation++;
     return heif_error_ok;
   }
   else if (strncmp(name, "x265:", 5) == 0) {
@@ -641,19 +758,13 @@ static int rounded_size(int s)
 }
 
 
-static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_image* image,
-                                           heif_image_input_class input_class)
+// Sets up the encoder parameters for 'image'.
+// When encoding a sequence, 'sequence' contains its GOP parameters. It is NULL for still images.
+static struct heif_error x265_alloc_param(struct encoder_struct_x265* encoder, const struct heif_image* image,
+                                          heif_image_input_class input_class,
+                                          const struct heif_sequence_encoding_options* sequence,
+                                          x265_param** out_param)
 {
-  struct encoder_struct_x265* encoder = (struct encoder_struct_x265*) encoder_raw;
-
-  // close previous encoder if there is still one hanging around
-  if (encoder->encoder) {
-    const x265_api* api = x265_api_get(encoder->bit_depth);
-    api->encoder_close(encoder->encoder);
-    encoder->encoder = nullptr;
-  }
-
-
   int bit_depth = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
   bool isGreyscale = (heif_image_get_colorspace(image) == heif_colorspace_monochrome);
   heif_chroma chroma = heif_image_get_chroma_format(image);
@@ -671,17 +782,34 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
   x265_param* param = api->param_alloc();
   api->param_default_preset(param, encoder->preset.c_str(), encoder->tune.c_str());
 
-  if (bit_depth == 8) api->param_apply_profile(param, "mainstillpicture");
-  else if (bit_depth == 10) api->param_apply_profile(param, "main10-intra");
-  else if (bit_depth == 12) api->param_apply_profile(param, "main12-intra");
+  if (sequence) {
+    if (bit_depth == 8) api->param_apply_profile(param, "main");
+    else if (bit_depth == 10) api->param_apply_profile(param, "main10");
+    else if (bit_depth == 12) api->param_apply_profile(param, "main12");
+    else {
+      api->param_free(param);
+      return heif_error_unsupported_parameter;
+    }
+  }
   else {
-    api->param_free(param);
-    return heif_error_unsupported_parameter;
+    if (bit_depth == 8) api->param_apply_profile(param, "mainstillpicture");
+    else if (bit_depth == 10) api->param_apply_profile(param, "main10-intra");
+    else if (bit_depth == 12) api->param_apply_profile(param, "main12-intra");
+    else {
+      api->param_free(param);
+      return heif_error_unsupported_parameter;
+    }
   }
 
 
-  param->fpsNum = 1;
-  param->fpsDenom = 1;
+  if (sequence && sequence->framerate_numerator && sequence->framerate_denominator) {
+    param->fpsNum = sequence->framerate_numerator;
+    param->fpsDenom = sequence->framerate_denominator;
+  }
+  else {
+    param->fpsNum = 1;
+    param->fpsDenom = 1;
+  }
 
 
   // x265 cannot encode images smaller than one CTU size
@@ -736,6 +864,7 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
       ctu = "16";
       break;
     default:
+      api->param_free(param);
       struct heif_error err = {
           heif_error_Encoder_plugin_error,
           heif_suberror_Invalid_parameter_value,
@@ -747,7 +876,38 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
   // BPG uses CQP. It does not seem to be better though.
   //  param->rc.rateControlMode = X265_RC_CQP;
   //  param->rc.qp = (100 - encoder->quality)/2;
-  param->totalFrames = 1;
+  if (sequence) {
+    param->totalFrames = 0; // unknown
+
+    // Keyframes are IDR frames such that each of them starts a new decodable sequence.
+    param->bOpenGOP = 0;
+
+    if (sequence->keyframe_distance_max > 0) {
+      param->keyframeMax = sequence->keyframe_distance_max;
+    }
+
+    if (sequence->keyframe_distance_min > 0) {
+      param->keyframeMin = sequence->keyframe_distance_min;
+    }
+
+    if (sequence->gop_structure == heif_sequence_gop_structure_lowdelay) {
+      api->param_parse(param, "bframes", "0");
+    }
+  }
+  else {
+    // The encoder may be reused for several images (see x265_encode_image()). Each image is coded
+    // as a self-contained IDR picture with its own parameter sets, and the settings below make x265
+    // return it from the same encoder_encode() call without having to flush the encoder.
+    param->totalFrames = 0;
+    param->keyframeMax = 1;
+    param->bOpenGOP = 0;
+    api->param_parse(param, "repeat-headers", "1");
+    api->param_parse(param, "bframes", "0");
+    api->param_parse(param, "rc-lookahead", "0");
+    api->param_parse(param, "scenecut", "0");
+    api->param_parse(param, "cutree", "0");
+    api->param_parse(param, "frame-threads", "1");
+  }
 
   if (isGreyscale) {
     param->internalCsp = X265_CSP_I400;
@@ -858,9 +1018,16 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
         api->param_parse(param, "wpp", "0"); // setting to 0 significantly increases computation time
       }
     }
+    else if (p.name == kParam_threads) {
+      if (p.value_int > 0) {
+        auto valString = std::to_string(p.value_int);
+        api->param_parse(param, "pools", valString.c_str());
+      }
+    }
     else if (strncmp(p.name.c_str(), "x265:", 5) == 0) {
       std::string x265p = p.name.substr(5);
       if (api->param_parse(param, x265p.c_str(), p.value_string.c_str()) < 0) {
+        api->param_free(param);
         encoder->last_error_message = std::string{"Unsupported x265 encoder parameter: "} + x265p;
 
         return {
@@ -882,11 +1049,22 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
   param->sourceWidth = rounded_size(param->sourceWidth);
   param->sourceHeight = rounded_size(param->sourceHeight);
 
+  *out_param = param;
+
+  return heif_error_ok;
+}
+
+
+// Wraps the image planes into an x265_picture. Free it with picture_free().
+static struct heif_error x265_alloc_picture(const x265_api* api, x265_param* param,
+                                            const struct heif_image* image,
+                                            x265_picture** out_pic)
+{
   // Note: it is ok to cast away the const, as the image content is not changed.
   // However, we have to guarantee that there are no plane pointers or stride values kept over calling the svt_encode_image() function.
-  err = heif_image_extend_padding_to_size(const_cast<struct heif_image*>(image),
-                                          param->sourceWidth,
-                                          param->sourceHeight);
+  heif_error err = heif_image_extend_padding_to_size(const_cast<struct heif_image*>(image),
+                                                     param->sourceWidth,
+                                                     param->sourceHeight);
   if (err.code) {
     return err;
   }
@@ -894,7 +1072,7 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
   x265_picture* pic = api->picture_alloc();
   api->picture_init(param, pic);
 
-  if (isGreyscale) {
+  if (heif_image_get_colorspace(image) == heif_colorspace_monochrome) {
     pic->planes[0] = (void*) heif_image_get_plane_readonly(image, heif_channel_Y, &pic->stride[0]);
   }
   else {
@@ -903,29 +1081,149 @@ static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_
     pic->planes[2] = (void*) heif_image_get_plane_readonly(image, heif_channel_Cr, &pic->stride[2]);
   }
 
-  pic->bitDepth = bit_depth;
+  pic->bitDepth = param->internalBitDepth;
 
+  *out_pic = pic;
 
-  encoder->bit_depth = bit_depth;
+  return heif_error_ok;
+}
 
-  encoder->encoder = api->encoder_open(param);
+
+// Passes 'pic' (NULL to flush) to the encoder. The output NALs are stored in encoder->nals.
+static int x265_encode_picture(struct encoder_struct_x265* encoder, x265_picture* pic, x265_picture* pic_out)
+{
+  const x265_api* api = x265_api_get(encoder->bit_depth);
 
 #if X265_BUILD == 212
   // In x265 build version 212, the signature of the encoder_encode() function was changed. But it was changed back in version 213.
   // https://bitbucket.org/multicoreware/x265_git/issues/952/crash-in-libheif-tests
-  x265_picture* out_pic = NULL;
-  api->encoder_encode(encoder->encoder,
-                      &encoder->nals,
-                      &encoder->num_nals,
-                      pic,
-                      &out_pic);
+  x265_picture* out_pic = pic_out;
+  return api->encoder_encode(encoder->encoder,
+                             &encoder->nals,
+                             &encoder->num_nals,
+                             pic,
+                             &out_pic);
 #else
-  api->encoder_encode(encoder->encoder,
-                      &encoder->nals,
-                      &encoder->num_nals,
-                      pic,
-                      NULL);
+  return api->encoder_encode(encoder->encoder,
+                             &encoder->nals,
+                             &encoder->num_nals,
+                             pic,
+                             pic_out);
 #endif
+}
+
+
+// Removes the start code. Returns false for NALs that should not be written into the file.
+static bool x265_prepare_nal_for_output(uint8_t** data, int* size)
+{
+  // --- skip start code ---
+
+  // skip '0' bytes
+  while (**data == 0 && *size > 0) {
+    (*data)++;
+    (*size)--;
+  }
+
+  // skip '1' byte
+  (*data)++;
+  (*size)--;
+
+
+  // --- skip NALs with irrelevant data ---
+
+  if (*size >= 3 && (*data)[0] == 0x4e && (*data)[2] == 5) {
+    // skip "unregistered user data SEI"
+    return false;
+  }
+
+  return true;
+}
+
+
+static encoder_struct_x265::still_image_format x265_get_still_image_format(const struct encoder_struct_x265* encoder,
+                                                                         const struct heif_image* image,
+                                                                         heif_image_input_class input_class)
+{
+  encoder_struct_x265::still_image_format format;
+  format.width = heif_image_get_width(image, heif_channel_Y);
+  format.height = heif_image_get_height(image, heif_channel_Y);
+  format.colorspace = heif_image_get_colorspace(image);
+  format.chroma = heif_image_get_chroma_format(image);
+  format.bit_depth = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
+  format.input_class = input_class;
+  format.parameters_generation = encoder->parameters_generation;
+
+  struct heif_color_profile_nclx* nclx = nullptr;
+  heif_error err = heif_image_get_nclx_color_profile(image, &nclx);
+  if (err.code == heif_error_Ok && nclx) {
+    format.has_nclx = true;
+    format.color_primaries = nclx->color_primaries;
+    format.transfer_characteristics = nclx->transfer_characteristics;
+    format.matrix_coefficients = nclx->matrix_coefficients;
+    format.full_range_flag = nclx->full_range_flag;
+  }
+
+  heif_nclx_color_profile_free(nclx);
+
+  return format;
+}
+
+
+static void x265_close_encoder(struct encoder_struct_x265* encoder)
+{
+  if (encoder->encoder) {
+    const x265_api* api = x265_api_get(encoder->bit_depth);
+    api->encoder_close(encoder->encoder);
+    encoder->encoder = nullptr;
+  }
+
+  encoder->still_encoder_reusable = false;
+}
+
+
+static struct heif_error x265_encode_image(void* encoder_raw, const struct heif_image* image,
+                                           heif_image_input_class input_class)
+{
+  struct encoder_struct_x265* encoder = (struct encoder_struct_x265*) encoder_raw;
+
+  encoder_struct_x265::still_image_format format = x265_get_still_image_format(encoder, image, input_class);
+
+  // close the previous encoder if it cannot be reused for this image
+  if (encoder->encoder && !(encoder->still_encoder_reusable && encoder->still_format == format)) {
+    x265_close_encoder(encoder);
+  }
+
+  x265_param* param = nullptr;
+  struct heif_error err = x265_alloc_param(encoder, image, input_class, nullptr, &param);
+  if (err.code) {
+    return err;
+  }
+
+  const x265_api* api = x265_api_get(param->internalBitDepth);
+
+  x265_picture* pic = nullptr;
+  err = x265_alloc_picture(api, param, image, &pic);
+  if (err.code) {
+    api->param_free(param);
+    return err;
+  }
+
+  if (!encoder->encoder) {
+    encoder->bit_depth = param->internalBitDepth;
+    encoder->encoder = api->encoder_open(param);
+    encoder->still_format = format;
+    encoder->still_encoder_reusable = true;
+    encoder->still_pts = 0;
+  }
+
+  pic->pts = encoder->still_pts++;
+
+  x265_encode_picture(encoder, pic, NULL);
+
+  // If x265 did not return the picture immediately, it has to be flushed and cannot be reused.
+  if (encoder->num_nals == 0) {
+    encoder->still_encoder_reusable = false;
+  }
 
   api->picture_free(pic);
   api->param_free(param);
@@ -949,34 +1247,13 @@ static struct heif_error x265_get_compressed_data(void* encoder_raw, uint8_t** d
     return heif_error_ok;
   }
 
-  const x265_api* api = x265_api_get(encoder->bit_depth);
-
   for (;;) {
     while (encoder->nal_output_counter < encoder->num_nals) {
       *data = encoder->nals[encoder->nal_output_counter].payload;
       *size = encoder->nals[encoder->nal_output_counter].sizeBytes;
       encoder->nal_output_counter++;
 
-      // --- skip start code ---
-
-      // skip '0' bytes
-      while (**data == 0 && *size > 0) {
-        (*data)++;
-        (*size)--;
-      }
-
-      // skip '1' byte
-      (*data)++;
-      (*size)--;
-
-
-      // --- skip NALs with irrelevant data ---
-
-      if (*size >= 3 && (*data)[0] == 0x4e && (*data)[2] == 5) {
-        // skip "unregistered user data SEI"
-
-      }
-      else {
+      if (x265_prepare_nal_for_output(data, size)) {
         // output NAL
 
         return heif_error_ok;
@@ -986,21 +1263,17 @@ static struct heif_error x265_get_compressed_data(void* encoder_raw, uint8_t** d
 
     encoder->nal_output_counter = 0;
 
+    if (encoder->still_encoder_reusable) {
+      // The complete picture has been returned. Keep the encoder open for the next image.
+      encoder->num_nals = 0;
 
-#if X265_BUILD == 212
-    x265_picture* out_pic = NULL;
-    int result = api->encoder_encode(encoder->encoder,
-                                     &encoder->nals,
-                                     &encoder->num_nals,
-                                     NULL,
-                                     &out_pic);
-#else
-    int result = api->encoder_encode(encoder->encoder,
-                                     &encoder->nals,
-                                     &encoder->num_nals,
-                                     NULL,
-                                     NULL);
-#endif
+      *data = nullptr;
+      *size = 0;
+
+      return heif_error_ok;
+    }
+
+    int result = x265_encode_picture(encoder, NULL, NULL);
     if (result <= 0) {
       *data = nullptr;
       *size = 0;
@@ -1011,9 +1284,157 @@ static struct heif_error x265_get_compressed_data(void* encoder_raw, uint8_t** d
 }
 
 
+// --- sequence encoding
+
+static struct heif_error x265_start_sequence_encoding(void* encoder_raw, const struct heif_sequence_encoding_options* options)
+{
+  struct encoder_struct_x265* encoder = (struct encoder_struct_x265*) encoder_raw;
+
+  x265_close_encoder(encoder);
+
+  if (encoder->sequence_param) {
+    x265_api_get(encoder->bit_depth)->param_free(encoder->sequence_param);
+    encoder->sequence_param = nullptr;
+  }
+
+  // The encoder is opened with the first frame, when the image format is known.
+  encoder->sequence_options = *options;
+  encoder->coded_frames.clear();
+  encoder->coded_frame_nal_index = 0;
+
+  return heif_error_ok;
+}
+
+
+// Moves the NALs returned by the last x265_encode_picture() call into the queue of coded frames.
+static void x265_queue_coded_frame(struct encoder_struct_x265* encoder, const x265_picture& pic_out)
+{
+  if (encoder->num_nals == 0) {
+    return;
+  }
+
+  encoder_struct_x265::coded_frame frame;
+  frame.frame_number = static_cast<uintptr_t>(pic_out.pts);
+  frame.is_keyframe = (pic_out.sliceType == X265_TYPE_IDR);
+
+  for (uint32_t i = 0; i < encoder->num_nals; i++) {
+    uint8_t* data = encoder->nals[i].payload;
+    int size = static_cast<int>(encoder->nals[i].sizeBytes);
+
+    if (x265_prepare_nal_for_output(&data, &size)) {
+      frame.nals.emplace_back(data, data + size);
+    }
+  }
+
+  encoder->num_nals = 0;
+
+  encoder->coded_frames.push_back(std::move(frame));
+}
+
+
+static struct heif_error x265_encode_sequence_frame(void* encoder_raw, const struct heif_image* image,
+                                                    heif_image_input_class input_class,
+                                                    uintptr_t frame_number)
+{
+  struct encoder_struct_x265* encoder = (struct encoder_struct_x265*) encoder_raw;
+
+  if (encoder->encoder == nullptr) {
+    x265_param* param = nullptr;
+    struct heif_error err = x265_alloc_param(encoder, image, input_class, &encoder->sequence_options, &param);
+    if (err.code) {
+      return err;
+    }
+
+    encoder->bit_depth = param->internalBitDepth;
+    encoder->encoder = x265_api_get(encoder->bit_depth)->encoder_open(param);
+    encoder->sequence_param = param;
+  }
+
+  const x265_api* api = x265_api_get(encoder->bit_depth);
+
+  x265_picture* pic = nullptr;
+  struct heif_error err = x265_alloc_picture(api, encoder->sequence_param, image, &pic);
+  if (err.code) {
+    return err;
+  }
+
+  pic->pts = static_cast<int64_t>(frame_number);
+
+  x265_picture pic_out;
+  api->picture_init(encoder->sequence_param, &pic_out);
+
+  int result = x265_encode_picture(encoder, pic, &pic_out);
+  api->picture_free(pic);
+
+  if (result > 0) {
+    x265_queue_coded_frame(encoder, pic_out);
+  }
+
+  return heif_error_ok;
+}
+
+
+static struct heif_error x265_end_sequence_encoding(void* encoder_raw)
+{
+  struct encoder_struct_x265* encoder = (struct encoder_struct_x265*) encoder_raw;
+
+  if (encoder->encoder == nullptr) {
+    return heif_error_ok;
+  }
+
+  const x265_api* api = x265_api_get(encoder->bit_depth);
+
+  for (;;) {
+    x265_picture pic_out;
+    api->picture_init(encoder->sequence_param, &pic_out);
+
+    int result = x265_encode_picture(encoder, NULL, &pic_out);
+    if (result <= 0) {
+      break;
+    }
+
+    x265_queue_coded_frame(encoder, pic_out);
+  }
+
+  return heif_error_ok;
+}
+
+
+static struct heif_error x265_get_compressed_data2(void* encoder_raw, uint8_t** data, int* size,
+                                                   uintptr_t* frame_number, int* is_keyframe,
+                                                   enum heif_encoded_data_type* type)
+{
+  struct encoder_struct_x265* encoder = (struct encoder_struct_x265*) encoder_raw;
+
+  *data = nullptr;
+  *size = 0;
+
+  if (encoder->coded_frames.empty()) {
+    return heif_error_ok;
+  }
+
+  auto& frame = encoder->coded_frames.front();
+
+  if (encoder->coded_frame_nal_index == frame.nals.size()) {
+    // end of frame
+    encoder->coded_frames.pop_front();
+    encoder->coded_frame_nal_index = 0;
+    return heif_error_ok;
+  }
+
+  auto& nal = frame.nals[encoder->coded_frame_nal_index++];
+  *data = nal.data();
+  *size = static_cast<int>(nal.size());
+  *frame_number = frame.frame_number;
+  *is_keyframe = frame.is_keyframe;
+
+  return heif_error_ok;
+}
+
+
 static const struct heif_encoder_plugin encoder_plugin_x265
     {
-        /* plugin_api_version */ 2,
+        /* plugin_api_version */ 4,
         /* compression_format */ heif_compression_HEVC,
         /* id_name */ "x265",
         /* priority */ X265_PLUGIN_PRIORITY,
@@ -1040,7 +1461,12 @@ static const struct heif_encoder_plugin encoder_plugin_x265
         /* query_input_colorspace */ x265_query_input_colorspace,
         /* encode_image */ x265_encode_image,
         /* get_compressed_data */ x265_get_compressed_data,
-        /* query_input_colorspace (v2) */ x265_query_input_colorspace2
+        /* query_input_colorspace (v2) */ x265_query_input_colorspace2,
+        /* query_encoded_size (v3) */ nullptr,
+        /* start_sequence_encoding (v4) */ x265_start_sequence_encoding,
+        /* encode_sequence_frame (v4) */ x265_encode_sequence_frame,
+        /* end_sequence_encoding (v4) */ x265_end_sequence_encoding,
+        /* get_compressed_data2 (v4) */ x265_get_compressed_data2
     };
 
 const struct heif_encoder_plugin* get_encoder_plugin_x265()
@@ -24,6 +24,7 @@
 #include "box.h"
 #include "libheif/heif_regions.h"
 #include <algorithm>
+#include <cmath>
 #include <utility>
 
 
@@ -61,6 +62,9 @@ Error RegionItem::parse(const std::vector<uint8_t>& data)
 
   uint8_t region_count = data[dataOffset];
   dataOffset += 1;
+
+  mRegions.reserve(mRegions.size() + region_count);
+
   for (int i = 0; i < region_count; i++) {
     if (data.size() <= dataOffset) {
       return Error(heif_error_Invalid_input, heif_suberror_Invalid_region_data,
@@ -112,6 +116,9 @@ Error RegionItem::parse(const std::vector<uint8_t>& data)
 
     mRegions.push_back(region);
   }
+
+  m_index_valid = false;
+
   return Error::Ok;
 }
 
@@ -160,6 +167,13 @@ Error RegionItem::encode(std::vector<uint8_t>& result) const
     return Error(heif_error_Encoding_error, heif_suberror_Too_many_regions);
   }
 
+  size_t total_size = writer.data_size() + 1;
+  for (auto& region : mRegions) {
+    total_size += region->get_encoded_size(field_size_bytes);
+  }
+
+  writer.reserve(total_size);
+
   writer.write8((uint8_t) mRegions.size());
 
   for (auto& region : mRegions) {
@@ -227,6 +241,17 @@ static bool exceeds_u16(uint32_t v)
 }
 
 
+static void write_signed(StreamWriter& writer, int field_size_bytes, int32_t v)
+{
+  if (field_size_bytes == 4) {
+    writer.write32s(v);
+  }
+  else {
+    writer.write16s((int16_t) v);
+  }
+}
+
+
 bool RegionGeometry_Point::encode_needs_32bit() const
 {
   return exceeds_s16(x) || exceeds_s16(y);
@@ -236,8 +261,14 @@ bool RegionGeometry_Point::encode_needs_32bit() const
 void RegionGeometry_Point::encode(StreamWriter& writer, int field_size_bytes) const
 {
   writer.write8(heif_region_type_point);
-  writer.write(field_size_bytes, x);
-  writer.write(field_size_bytes, y);
+  write_signed(writer, field_size_bytes, x);
+  write_signed(writer, field_size_bytes, y);
+}
+
+
+size_t RegionGeometry_Point::get_encoded_size(int field_size_bytes) const
+{
+  return 1 + 2 * field_size_bytes;
 }
 
 
@@ -267,12 +298,18 @@ bool RegionGeometry_Rectangle::encode_needs_32bit() const
 void RegionGeometry_Rectangle::encode(StreamWriter& writer, int field_size_bytes) const
 {
   writer.write8(heif_region_type_rectangle);
-  writer.write(field_size_bytes, x);
-  writer.write(field_size_bytes, y);
+  write_signed(writer, field_size_bytes, x);
+  write_signed(writer, field_size_bytes, y);
   writer.write(field_size_bytes, width);
   writer.write(field_size_bytes, height);
 }
 
+
+size_t RegionGeometry_Rectangle::get_encoded_size(int field_size_bytes) const
+{
+  return 1 + 4 * field_size_bytes;
+}
+
 Error RegionGeometry_Ellipse::parse(const std::vector<uint8_t>& data,
                                     int field_size,
                                     unsigned int* dataOffset)
@@ -298,13 +335,19 @@ bool RegionGeometry_Ellipse::encode_needs_32bit() const
 void RegionGeometry_Ellipse::encode(StreamWriter& writer, int field_size_bytes) const
 {
   writer.write8(heif_region_type_ellipse);
-  writer.write(field_size_bytes, x);
-  writer.write(field_size_bytes, y);
+  write_signed(writer, field_size_bytes, x);
+  write_signed(writer, field_size_bytes, y);
   writer.write(field_size_bytes, radius_x);
   writer.write(field_size_bytes, radius_y);
 }
 
 
+size_t RegionGeometry_Ellipse::get_encoded_size(int field_size_bytes) const
+{
+  return 1 + 4 * field_size_bytes;
+}
+
+
 
 Error RegionGeometry_Polygon::parse(const std::vector<uint8_t>& data,
                                     int field_size,
@@ -326,6 +369,8 @@ Error RegionGeometry_Polygon::parse(const std::vector<uint8_t>& data,
                  "Insufficient data remaining for polygon");
   }
 
+  points.reserve(numPoints);
+
   for (uint32_t i = 0; i < numPoints; i++) {
     Point p;
     p.x = parse_signed(data, field_size, dataOffset);
@@ -357,12 +402,18 @@ Error RegionGeometry_ReferencedMask::parse(const std::vector<uint8_t>& data,
 void RegionGeometry_ReferencedMask::encode(StreamWriter& writer, int field_size_bytes) const
 {
   writer.write8(heif_region_type_referenced_mask);
-  writer.write(field_size_bytes, x);
-  writer.write(field_size_bytes, y);
+  write_signed(writer, field_size_bytes, x);
+  write_signed(writer, field_size_bytes, y);
   writer.write(field_size_bytes, width);
   writer.write(field_size_bytes, height);
 }
 
+
+size_t RegionGeometry_ReferencedMask::get_encoded_size(int field_size_bytes) const
+{
+  return 1 + 4 * field_size_bytes;
+}
+
 bool RegionGeometry_Polygon::encode_needs_32bit() const
 {
   if (exceeds_u16((uint32_t)points.size())) {
@@ -386,12 +437,18 @@ void RegionGeometry_Polygon::encode(StreamWriter& writer, int field_size_bytes)
   writer.write(field_size_bytes, points.size());
 
   for (auto& p : points) {
-    writer.write(field_size_bytes, p.x);
-    writer.write(field_size_bytes, p.y);
+    write_signed(writer, field_size_bytes, p.x);
+    write_signed(writer, field_size_bytes, p.y);
   }
 }
 
 
+size_t RegionGeometry_Polygon::get_encoded_size(int field_size_bytes) const
+{
+  return 1 + field_size_bytes + points.size() * 2 * field_size_bytes;
+}
+
+
 Error RegionGeometry_InlineMask::parse(const std::vector<uint8_t>& data,
                                        int field_size,
                                        unsigned int* dataOffset)
@@ -411,13 +468,14 @@ Error RegionGeometry_InlineMask::parse(const std::vector<uint8_t>& data,
     return Error(heif_error_Invalid_input, heif_suberror_Invalid_region_data,
                  "Deflate compressed inline mask is not yet supported");
   }
-  unsigned int additionalBytesRequired = width * height / 8;
+  uint64_t additionalBytesRequired = ((uint64_t) width * height + 7) / 8;
   if (data.size() - *dataOffset < additionalBytesRequired) {
         return Error(heif_error_Invalid_input, heif_suberror_Invalid_region_data,
                  "Insufficient data remaining for inline mask region data[]");
   }
   mask_data.resize(additionalBytesRequired);
   std::copy(data.begin() + *dataOffset, data.begin() + *dataOffset + additionalBytesRequired, mask_data.begin());
+  *dataOffset = *dataOffset + (unsigned int) additionalBytesRequired;
   return Error::Ok;
 }
 
@@ -425,8 +483,8 @@ Error RegionGeometry_InlineMask::parse(const std::vector<uint8_t>& data,
 void RegionGeometry_InlineMask::encode(StreamWriter& writer, int field_size_bytes) const
 {
   writer.write8(heif_region_type_inline_mask);
-  writer.write(field_size_bytes, x);
-  writer.write(field_size_bytes, y);
+  write_signed(writer, field_size_bytes, x);
+  write_signed(writer, field_size_bytes, y);
   writer.write(field_size_bytes, width);
   writer.write(field_size_bytes, height);
   writer.write8(0); // coding method
@@ -435,6 +493,316 @@ void RegionGeometry_InlineMask::encode(StreamWriter& writer, int field_size_byte
 }
 
 
+size_t RegionGeometry_InlineMask::get_encoded_size(int field_size_bytes) const
+{
+  return 1 + 4 * field_size_bytes + 1 + mask_data.size();
+}
+
+
+// --- bounding boxes and point tests
+
+bool RegionGeometry::contains_point(int32_t x, int32_t y) const
+{
+  RegionBoundingBox box = get_bounding_box();
+  return x >= box.x0 && x < box.x1 && y >= box.y0 && y < box.y1;
+}
+
+
+RegionBoundingBox RegionGeometry_Point::get_bounding_box() const
+{
+  return {x, y, int64_t{x} + 1, int64_t{y} + 1};
+}
+
+
+RegionBoundingBox RegionGeometry_Rectangle::get_bounding_box() const
+{
+  return {x, y, int64_t{x} + width, int64_t{y} + height};
+}
+
+
+RegionBoundingBox RegionGeometry_Ellipse::get_bounding_box() const
+{
+  return {int64_t{x} - radius_x, int64_t{y} - radius_y,
+          int64_t{x} + radius_x + 1, int64_t{y} + radius_y + 1};
+}
+
+
+bool RegionGeometry_Ellipse::contains_point(int32_t px, int32_t py) const
+{
+  if (radius_x == 0 || radius_y == 0) {
+    return RegionGeometry::contains_point(px, py);
+  }
+
+  double dx = (px - double(x)) / radius_x;
+  double dy = (py - double(y)) / radius_y;
+  return dx * dx + dy * dy <= 1.0;
+}
+
+
+RegionBoundingBox RegionGeometry_Polygon::get_bounding_box() const
+{
+  if (points.empty()) {
+    return {};
+  }
+
+  RegionBoundingBox box{points[0].x, points[0].y, points[0].x, points[0].y};
+  for (const auto& p : points) {
+    box.x0 = std::min(box.x0, int64_t{p.x});
+    box.y0 = std::min(box.y0, int64_t{p.y});
+    box.x1 = std::max(box.x1, int64_t{p.x});
+    box.y1 = std::max(box.y1, int64_t{p.y});
+  }
+
+  box.x1++;
+  box.y1++;
+  return box;
+}
+
+
+static bool point_on_segment(int64_t px, int64_t py,
+                             const RegionGeometry_Polygon::Point& a, const RegionGeometry_Polygon::Point& b)
+{
+  int64_t cross = (int64_t{b.x} - a.x) * (py - a.y) - (int64_t{b.y} - a.y) * (px - a.x);
+  if (cross != 0) {
+    return false;
+  }
+
+  return px >= std::min(a.x, b.x) && px <= std::max(a.x, b.x) &&
+         py >= std::min(a.y, b.y) && py <= std::max(a.y, b.y);
+}
+
+
+bool RegionGeometry_Polygon::contains_point(int32_t px, int32_t py) const
+{
+  size_t n = points.size();
+  if (n == 0) {
+    return false;
+  }
+
+  if (n == 1) {
+    return points[0].x == px && points[0].y == py;
+  }
+
+  size_t num_segments = closed ? n : n - 1;
+  for (size_t i = 0; i < num_segments; i++) {
+    if (point_on_segment(px, py, points[i], points[(i + 1) % n])) {
+      return true;
+    }
+  }
+
+  if (!closed) {
+    return false;
+  }
+
+  // even-odd rule: count the edges crossed by a ray from the point to the right
+  bool inside = false;
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    const Point& a = points[i];
+    const Point& b = points[j];
+
+    if ((a.y > py) != (b.y > py)) {
+      double x_cross = a.x + (double(py) - a.y) * (double(b.x) - a.x) / (double(b.y) - a.y);
+      if (px < x_cross) {
+        inside = !inside;
+      }
+    }
+  }
+
+  return inside;
+}
+
+
+RegionBoundingBox RegionGeometry_ReferencedMask::get_bounding_box() const
+{
+  return {x, y, int64_t{x} + width, int64_t{y} + height};
+}
+
+
+bool RegionGeometry_ReferencedMask::mask_contains_point(const std::shared_ptr<const HeifPixelImage>& mask,
+                                                        const RegionBoundingBox& box, int32_t x, int32_t y)
+{
+  if (x < box.x0 || x >= box.x1 || y < box.y0 || y >= box.y1) {
+    return false;
+  }
+
+  if (!mask->has_channel(heif_channel_Y)) {
+    return false;
+  }
+
+  uint32_t mask_width = mask->get_width(heif_channel_Y);
+  uint32_t mask_height = mask->get_height(heif_channel_Y);
+
+  auto mx = static_cast<uint32_t>((x - box.x0) * mask_width / (box.x1 - box.x0));
+  auto my = static_cast<uint32_t>((y - box.y0) * mask_height / (box.y1 - box.y0));
+
+  size_t stride;
+  if (mask->get_bits_per_pixel(heif_channel_Y) <= 8) {
+    const auto* p = mask->get_channel<uint8_t>(heif_channel_Y, &stride);
+    return p[my * stride + mx] != 0;
+  }
+  else {
+    const auto* p = mask->get_channel<uint16_t>(heif_channel_Y, &stride);
+    return p[my * stride + mx] != 0;
+  }
+}
+
+
+RegionBoundingBox RegionGeometry_InlineMask::get_bounding_box() const
+{
+  return {x, y, int64_t{x} + width, int64_t{y} + height};
+}
+
+
+bool RegionGeometry_InlineMask::contains_point(int32_t px, int32_t py) const
+{
+  if (!RegionGeometry::contains_point(px, py)) {
+    return false;
+  }
+
+  uint64_t pixel_index = uint64_t(py - y) * width + uint64_t(px - x);
+  if (pixel_index / 8 >= mask_data.size()) {
+    return false;
+  }
+
+  return (mask_data[pixel_index / 8] & (0x80U >> (pixel_index % 8))) != 0;
+}
+
+
+// --- spatial index
+
+void RegionItem::build_index() const
+{
+  m_bounding_boxes.clear();
+  m_grid_cells.clear();
+  m_large_regions.clear();
+
+  for (const auto& region : mRegions) {
+    m_bounding_boxes.push_back(region->get_bounding_box());
+  }
+
+  if (m_bounding_boxes.empty()) {
+    m_grid_columns = m_grid_rows = 0;
+    m_index_valid = true;
+    return;
+  }
+
+  m_grid_area = m_bounding_boxes[0];
+  for (const auto& box : m_bounding_boxes) {
+    m_grid_area.x0 = std::min(m_grid_area.x0, box.x0);
+    m_grid_area.y0 = std::min(m_grid_area.y0, box.y0);
+    m_grid_area.x1 = std::max(m_grid_area.x1, box.x1);
+    m_grid_area.y1 = std::max(m_grid_area.y1, box.y1);
+  }
+
+  // About one region per cell.
+  auto grid_size = static_cast<uint32_t>(std::ceil(std::sqrt(double(m_bounding_boxes.size()))));
+  int64_t area_width = std::max(int64_t{1}, m_grid_area.x1 - m_grid_area.x0);
+  int64_t area_height = std::max(int64_t{1}, m_grid_area.y1 - m_grid_area.y0);
+
+  m_cell_width = (area_width + grid_size - 1) / grid_size;
+  m_cell_height = (area_height + grid_size - 1) / grid_size;
+  m_grid_columns = static_cast<uint32_t>((area_width + m_cell_width - 1) / m_cell_width);
+  m_grid_rows = static_cast<uint32_t>((area_height + m_cell_height - 1) / m_cell_height);
+  m_grid_cells.resize(size_t{m_grid_columns} * m_grid_rows);
+
+  const uint64_t max_cells_per_region = std::max(uint64_t{4}, uint64_t{m_grid_columns} * m_grid_rows / 4);
+
+  for (int i = 0; i < (int) m_bounding_boxes.size(); i++) {
+    const auto& box = m_bounding_boxes[i];
+    if (box.x1 <= box.x0 || box.y1 <= box.y0) {
+      continue; // empty regions cannot intersect anything
+    }
+
+    auto cx0 = static_cast<uint32_t>((box.x0 - m_grid_area.x0) / m_cell_width);
+    auto cy0 = static_cast<uint32_t>((box.y0 - m_grid_area.y0) / m_cell_height);
+    auto cx1 = static_cast<uint32_t>((box.x1 - 1 - m_grid_area.x0) / m_cell_width);
+    auto cy1 = static_cast<uint32_t>((box.y1 - 1 - m_grid_area.y0) / m_cell_height);
+
+    if (uint64_t{cx1 - cx0 + 1} * (cy1 - cy0 + 1) > max_cells_per_region) {
+      m_large_regions.push_back(i);
+      continue;
+    }
+
+    for (uint32_t cy = cy0; cy <= cy1; cy++) {
+      for (uint32_t cx = cx0; cx <= cx1; cx++) {
+        m_grid_cells[size_t{cy} * m_grid_columns + cx].push_back(i);
+      }
+    }
+  }
+
+  m_index_valid = true;
+}
+
+
+std::vector<int> RegionItem::find_candidates(const RegionBoundingBox& area) const
+{
+  if (!m_index_valid) {
+    build_index();
+  }
+
+  std::vector<int> candidates = m_large_regions;
+
+  if (m_grid_columns > 0 && m_grid_area.intersects(area)) {
+    int64_t x0 = std::max(area.x0, m_grid_area.x0);
+    int64_t y0 = std::max(area.y0, m_grid_area.y0);
+    int64_t x1 = std::min(area.x1, m_grid_area.x1);
+    int64_t y1 = std::min(area.y1, m_grid_area.y1);
+
+    auto cx0 = static_cast<uint32_t>((x0 - m_grid_area.x0) / m_cell_width);
+    auto cy0 = static_cast<uint32_t>((y0 - m_grid_area.y0) / m_cell_height);
+    auto cx1 = std::min(m_grid_columns - 1, static_cast<uint32_t>((x1 - 1 - m_grid_area.x0) / m_cell_width));
+    auto cy1 = std::min(m_grid_rows - 1, static_cast<uint32_t>((y1 - 1 - m_grid_area.y0) / m_cell_height));
+
+    for (uint32_t cy = cy0; cy <= cy1; cy++) {
+      for (uint32_t cx = cx0; cx <= cx1; cx++) {
+        const auto& cell = m_grid_cells[size_t{cy} * m_grid_columns + cx];
+        candidates.insert(candidates.end(), cell.begin(), cell.end());
+      }
+    }
+  }
+
+  // Regions spanning several cells are found more than once.
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  std::vector<int> result;
+  for (int i : candidates) {
+    if (m_bounding_boxes[i].intersects(area)) {
+      result.push_back(i);
+    }
+  }
+
+  return result;
+}
+
+
+std::vector<int> RegionItem::find_regions_in_rectangle(int32_t x, int32_t y, uint32_t width, uint32_t height) const
+{
+  if (width == 0 || height == 0) {
+    return {};
+  }
+
+  std::lock_guard<std::mutex> lock(m_index_mutex);
+
+  return find_candidates({x, y, int64_t{x} + width, int64_t{y} + height});
+}
+
+
+std::vector<int> RegionItem::find_regions_at_point(int32_t x, int32_t y) const
+{
+  std::lock_guard<std::mutex> lock(m_index_mutex);
+
+  std::vector<int> result;
+  for (int i : find_candidates({x, y, int64_t{x} + 1, int64_t{y} + 1})) {
+    if (mRegions[i]->contains_point(x, y)) {
+      result.push_back(i);
+    }
+  }
+
+  return result;
+}
+
+
 RegionCoordinateTransform RegionCoordinateTransform::create(std::shared_ptr<HeifFile> file,
                                                             heif_item_id item_id,
                                                             int reference_width, int reference_height)
@@ -24,12 +24,25 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include "pixelimage.h"
 #include "libheif/heif_regions.h"
 
 
 class RegionGeometry;
 
+// Bounding box of a region geometry in the reference coordinate system of the region item.
+// x1 and y1 are exclusive.
+struct RegionBoundingBox
+{
+  int64_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+  bool intersects(const RegionBoundingBox& b) const
+  {
+    return x0 < b.x1 && b.x0 < x1 && y0 < b.y1 && b.y0 < y1;
+  }
+};
+
 class RegionItem
 {
 public:
@@ -42,21 +55,54 @@ public:
 
   Error encode(std::vector<uint8_t>& result) const;
 
-  int get_number_of_regions() { return (int) mRegions.size(); }
+  int get_number_of_regions() const { return (int) mRegions.size(); }
 
-  std::vector<std::shared_ptr<RegionGeometry>> get_regions() { return mRegions; }
+  const std::vector<std::shared_ptr<RegionGeometry>>& get_regions() const { return mRegions; }
 
   void add_region(const std::shared_ptr<RegionGeometry>& region)
   {
+    std::lock_guard<std::mutex> lock(m_index_mutex);
     mRegions.push_back(region);
+    m_index_valid = false;
   }
 
+  void add_regions(const std::vector<std::shared_ptr<RegionGeometry>>& regions)
+  {
+    std::lock_guard<std::mutex> lock(m_index_mutex);
+    mRegions.insert(mRegions.end(), regions.begin(), regions.end());
+    m_index_valid = false;
+  }
+
+  // Indices of all regions whose bounding box intersects the rectangle, in ascending order.
+  std::vector<int> find_regions_in_rectangle(int32_t x, int32_t y, uint32_t width, uint32_t height) const;
+
+  // Indices of all regions that contain the point, in ascending order.
+  // Referenced masks are only checked against their bounding box, because the mask image is not available here.
+  std::vector<int> find_regions_at_point(int32_t x, int32_t y) const;
+
   heif_item_id item_id = 0;
   uint32_t reference_width = 0;
   uint32_t reference_height = 0;
 
 private:
   std::vector<std::shared_ptr<RegionGeometry>> mRegions;
+
+  // --- spatial index, built on the first query
+
+  // Regions are sorted into a uniform grid of cells over the bounding box of all regions.
+  // Regions covering many cells are kept in a separate list that is checked for every query.
+  mutable std::mutex m_index_mutex;
+  mutable bool m_index_valid = false;
+  mutable std::vector<RegionBoundingBox> m_bounding_boxes;
+  mutable RegionBoundingBox m_grid_area;
+  mutable int64_t m_cell_width = 1, m_cell_height = 1;
+  mutable uint32_t m_grid_columns = 0, m_grid_rows = 0;
+  mutable std::vector<std::vector<int>> m_grid_cells;
+  mutable std::vector<int> m_large_regions;
+
+  void build_index() const;
+
+  std::vector<int> find_candidates(const RegionBoundingBox& area) const;
 };
 
 
@@ -73,6 +119,14 @@ public:
 
   virtual void encode(StreamWriter&, int field_size_bytes) const {}
 
+  // Number of bytes written by encode(), including the geometry type.
+  virtual size_t get_encoded_size(int field_size_bytes) const { return 1; }
+
+  virtual RegionBoundingBox get_bounding_box() const = 0;
+
+  // The default implementation checks the bounding box.
+  virtual bool contains_point(int32_t x, int32_t y) const;
+
 protected:
   uint32_t parse_unsigned(const std::vector<uint8_t>& data, int field_size, unsigned int* dataOffset);
 
@@ -88,8 +142,12 @@ public:
 
   void encode(StreamWriter&, int field_size_bytes) const override;
 
+  size_t get_encoded_size(int field_size_bytes) const override;
+
   heif_region_type getRegionType() override { return heif_region_type_point; }
 
+  RegionBoundingBox get_bounding_box() const override;
+
   int32_t x, y;
 };
 
@@ -102,8 +160,12 @@ public:
 
   void encode(StreamWriter&, int field_size_bytes) const override;
 
+  size_t get_encoded_size(int field_size_bytes) const override;
+
   heif_region_type getRegionType() override { return heif_region_type_rectangle; }
 
+  RegionBoundingBox get_bounding_box() const override;
+
   int32_t x, y;
   uint32_t width, height;
 };
@@ -117,8 +179,14 @@ public:
 
   void encode(StreamWriter&, int field_size_bytes) const override;
 
+  size_t get_encoded_size(int field_size_bytes) const override;
+
   heif_region_type getRegionType() override { return heif_region_type_ellipse; }
 
+  RegionBoundingBox get_bounding_box() const override;
+
+  bool contains_point(int32_t px, int32_t py) const override;
+
   int32_t x, y;
   uint32_t radius_x, radius_y;
 };
@@ -132,11 +200,18 @@ public:
 
   void encode(StreamWriter&, int field_size_bytes) const override;
 
+  size_t get_encoded_size(int field_size_bytes) const override;
+
   heif_region_type getRegionType() override
   {
     return closed ? heif_region_type_polygon : heif_region_type_polyline;
   }
 
+  RegionBoundingBox get_bounding_box() const override;
+
+  // Closed polygons contain the points inside (even-odd rule), polylines only the points on their segments.
+  bool contains_point(int32_t px, int32_t py) const override;
+
   struct Point
   {
     int32_t x, y;
@@ -153,11 +228,36 @@ public:
 
   void encode(StreamWriter&, int field_size_bytes) const override;
 
+  size_t get_encoded_size(int field_size_bytes) const override;
+
   heif_region_type getRegionType() override { return heif_region_type_referenced_mask; }
 
+  RegionBoundingBox get_bounding_box() const override;
+
+  // Checks the pixel of the mask image at the position. The mask image is scaled to the region size.
+  static bool mask_contains_point(const std::shared_ptr<const HeifPixelImage>& mask,
+                                  const RegionBoundingBox& box, int32_t x, int32_t y);
+
   int32_t x,y;
   uint32_t width, height;
   heif_item_id referenced_item;
+
+  // The decoded mask image is cached, because it is needed by every point query.
+  std::shared_ptr<const HeifPixelImage> get_cached_mask() const
+  {
+    std::lock_guard<std::mutex> lock(m_mask_mutex);
+    return m_cached_mask;
+  }
+
+  void set_cached_mask(std::shared_ptr<const HeifPixelImage> mask) const
+  {
+    std::lock_guard<std::mutex> lock(m_mask_mutex);
+    m_cached_mask = std::move(mask);
+  }
+
+private:
+  mutable std::mutex m_mask_mutex;
+  mutable std::shared_ptr<const HeifPixelImage> m_cached_mask;
 };
 
 class RegionGeometry_InlineMask : public RegionGeometry
@@ -167,11 +267,17 @@ public:
 
   void encode(StreamWriter&, int field_size_bytes) const override;
 
+  size_t get_encoded_size(int field_size_bytes) const override;
+
   int32_t x,y;
   uint32_t width, height;
   std::vector<uint8_t> mask_data;
 
   heif_region_type getRegionType() override { return heif_region_type_inline_mask; }
+
+  RegionBoundingBox get_bounding_box() const override;
+
+  bool contains_point(int32_t px, int32_t py) const override;
 };
 
 class HeifFile;
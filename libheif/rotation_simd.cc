@@ -0,0 +1,220 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rotation_simd.h"
+
+#if HEIF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if HEIF_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+// All kernels use the same scheme: N rows of N samples are transposed with log2(N) rounds of
+// interleaving row i with row i+N/2. After the last round, register k holds column k.
+
+
+#if HEIF_HAVE_X86_SIMD
+
+// --- SSE4.1 (the kernels only need SSE2, but are dispatched together with the other x86 kernels)
+
+#define HEIF_TRANSPOSE_ROUND(unpacklo, unpackhi, N) \
+  { \
+    __m128i t[N]; \
+    for (int i = 0; i < N / 2; i++) { \
+      t[2 * i] = unpacklo(r[i], r[i + N / 2]); \
+      t[2 * i + 1] = unpackhi(r[i], r[i + N / 2]); \
+    } \
+    for (int i = 0; i < N; i++) { \
+      r[i] = t[i]; \
+    } \
+  }
+
+
+HEIF_TARGET_SSE41
+void transpose_block_16x16_u8_sse41(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride)
+{
+  __m128i r[16];
+  for (int i = 0; i < 16; i++) {
+    r[i] = _mm_loadu_si128((const __m128i*) (src + i * src_stride));
+  }
+
+  for (int round = 0; round < 4; round++) {
+    HEIF_TRANSPOSE_ROUND(_mm_unpacklo_epi8, _mm_unpackhi_epi8, 16)
+  }
+
+  for (int k = 0; k < 16; k++) {
+    _mm_storeu_si128((__m128i*) (dst + k * dst_stride), r[k]);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+void transpose_block_8x8_u16_sse41(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride)
+{
+  __m128i r[8];
+  for (int i = 0; i < 8; i++) {
+    r[i] = _mm_loadu_si128((const __m128i*) (src + i * src_stride));
+  }
+
+  for (int round = 0; round < 3; round++) {
+    HEIF_TRANSPOSE_ROUND(_mm_unpacklo_epi16, _mm_unpackhi_epi16, 8)
+  }
+
+  for (int k = 0; k < 8; k++) {
+    _mm_storeu_si128((__m128i*) (dst + k * dst_stride), r[k]);
+  }
+}
+
+
+HEIF_TARGET_SSE41
+void transpose_block_4x4_u32_sse41(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride)
+{
+  __m128i r[4];
+  for (int i = 0; i < 4; i++) {
+    r[i] = _mm_loadu_si128((const __m128i*) (src + i * src_stride));
+  }
+
+  for (int round = 0; round < 2; round++) {
+    HEIF_TRANSPOSE_ROUND(_mm_unpacklo_epi32, _mm_unpackhi_epi32, 4)
+  }
+
+  for (int k = 0; k < 4; k++) {
+    _mm_storeu_si128((__m128i*) (dst + k * dst_stride), r[k]);
+  }
+}
+
+#undef HEIF_TRANSPOSE_ROUND
+
+#endif
+
+
+#if HEIF_HAVE_NEON
+
+// --- NEON
+
+// vzipq_*() returns the interleaved low halves in val[0] and the interleaved high halves in val[1].
+#define HEIF_TRANSPOSE_ROUND(vector_type, zip, N) \
+  { \
+    vector_type t[N]; \
+    for (int i = 0; i < N / 2; i++) { \
+      auto z = zip(r[i], r[i + N / 2]); \
+      t[2 * i] = z.val[0]; \
+      t[2 * i + 1] = z.val[1]; \
+    } \
+    for (int i = 0; i < N; i++) { \
+      r[i] = t[i]; \
+    } \
+  }
+
+
+void transpose_block_16x16_u8_neon(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride)
+{
+  uint8x16_t r[16];
+  for (int i = 0; i < 16; i++) {
+    r[i] = vld1q_u8(src + i * src_stride);
+  }
+
+  for (int round = 0; round < 4; round++) {
+    HEIF_TRANSPOSE_ROUND(uint8x16_t, vzipq_u8, 16)
+  }
+
+  for (int k = 0; k < 16; k++) {
+    vst1q_u8(dst + k * dst_stride, r[k]);
+  }
+}
+
+
+void transpose_block_8x8_u16_neon(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride)
+{
+  uint16x8_t r[8];
+  for (int i = 0; i < 8; i++) {
+    r[i] = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i * src_stride));
+  }
+
+  for (int round = 0; round < 3; round++) {
+    HEIF_TRANSPOSE_ROUND(uint16x8_t, vzipq_u16, 8)
+  }
+
+  for (int k = 0; k < 8; k++) {
+    vst1q_u16(reinterpret_cast<uint16_t*>(dst + k * dst_stride), r[k]);
+  }
+}
+
+
+void transpose_block_4x4_u32_neon(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride)
+{
+  uint32x4_t r[4];
+  for (int i = 0; i < 4; i++) {
+    r[i] = vld1q_u32(reinterpret_cast<const uint32_t*>(src + i * src_stride));
+  }
+
+  for (int round = 0; round < 2; round++) {
+    HEIF_TRANSPOSE_ROUND(uint32x4_t, vzipq_u32, 4)
+  }
+
+  for (int k = 0; k < 4; k++) {
+    vst1q_u32(reinterpret_cast<uint32_t*>(dst + k * dst_stride), r[k]);
+  }
+}
+
+#undef HEIF_TRANSPOSE_ROUND
+
+#endif
+
+
+TransposeKernel get_transpose_kernel(size_t sample_size)
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    switch (sample_size) {
+      case 1:
+        return {transpose_block_16x16_u8_sse41, 16};
+      case 2:
+        return {transpose_block_8x8_u16_sse41, 8};
+      case 4:
+        return {transpose_block_4x4_u32_sse41, 4};
+      default:
+        break;
+    }
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  if (cpu_supports_neon()) {
+    switch (sample_size) {
+      case 1:
+        return {transpose_block_16x16_u8_neon, 16};
+      case 2:
+        return {transpose_block_8x8_u16_neon, 8};
+      case 4:
+        return {transpose_block_4x4_u32_neon, 4};
+      default:
+        break;
+    }
+  }
+#endif
+
+  (void) sample_size;
+
+  return {};
+}
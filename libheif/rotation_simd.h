@@ -0,0 +1,59 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_ROTATION_SIMD_H
+#define LIBHEIF_ROTATION_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include "cpu_features.h"
+
+
+// Transposes a square block of samples: dst[k * dst_stride + i] = src[i * src_stride + k].
+// The strides are in bytes and may be negative, which mirrors the block vertically or horizontally.
+using transpose_block_function = void (*)(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+
+struct TransposeKernel
+{
+  transpose_block_function transpose = nullptr;
+  uint32_t block_size = 0; // in samples
+};
+
+// SIMD kernel for samples of 'sample_size' bytes (1, 2 or 4), if available on this CPU.
+TransposeKernel get_transpose_kernel(size_t sample_size);
+
+
+#if HEIF_HAVE_X86_SIMD
+void transpose_block_16x16_u8_sse41(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+
+void transpose_block_8x8_u16_sse41(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+
+void transpose_block_4x4_u32_sse41(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+#endif
+
+#if HEIF_HAVE_NEON
+void transpose_block_16x16_u8_neon(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+
+void transpose_block_8x8_u16_neon(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+
+void transpose_block_4x4_u32_neon(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride);
+#endif
+
+#endif //LIBHEIF_ROTATION_SIMD_H
@@ -23,7 +23,7 @@
 
 
 struct heif_security_limits global_security_limits {
-    .version = 2,
+    .version = 4,
 
     // --- version 1
 
@@ -49,12 +49,20 @@ struct heif_security_limits global_security_limits {
     .max_memory_margin = 1 * 1024*1024*1024, // 1 GB
 
     .max_sample_description_box_entries = 1024,
-    .max_sample_group_description_box_entries = 1024
+    .max_sample_group_description_box_entries = 1024,
+
+    // --- version 3
+
+    .max_total_memory = 0,
+
+    // --- version 4
+
+    .plane_allocation = 0
 };
 
 
 struct heif_security_limits disabled_security_limits{
-        .version = 2
+        .version = 4
 };
 
 
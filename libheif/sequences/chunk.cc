@@ -79,24 +79,27 @@ Chunk::Chunk(HeifContext* ctx, uint32_t track_id, std::shared_ptr<const Box> sam
 
   m_next_sample_to_be_decoded = first_sample;
 
-  for (uint32_t i=0;i<num_samples;i++) {
-    SampleFileRange range;
-    range.offset = file_offset;
-    if (stsz->has_fixed_sample_size()) {
-      range.size = stsz->get_fixed_sample_size();
-    }
-    else {
-      range.size = stsz->get_sample_sizes()[first_sample + i];
-    }
-
-    m_sample_ranges.push_back(range);
-
-    file_offset += range.size;
+  m_file_offset = file_offset;
+  m_sizes_sum_before_chunk = stsz->get_sample_sizes_sum(first_sample);
+  m_sample_sizes = stsz;
+
+  m_sample_description = std::dynamic_pointer_cast<const Box_VisualSampleEntry>(sample_description_box);
+  m_decoder = create_decoder();
+}
+
+
+std::shared_ptr<Decoder> Chunk::create_decoder() const
+{
+  if (!m_sample_description) {
+    return nullptr;
   }
 
-  if (auto visualSampleDescription = std::dynamic_pointer_cast<const Box_VisualSampleEntry>(sample_description_box)) {
-    m_decoder = Decoder::alloc_for_sequence_sample_description_box(visualSampleDescription);
+  auto decoder = Decoder::alloc_for_sequence_sample_description_box(m_sample_description);
+  if (decoder) {
+    decoder->set_instance_pool(m_ctx->get_decoder_instance_pool());
   }
+
+  return decoder;
 }
 
 
@@ -107,7 +110,22 @@ DataExtent Chunk::get_data_extent_for_sample(uint32_t n) const
 
   DataExtent extent;
   extent.set_file_range(m_ctx->get_heif_file(),
-                        m_sample_ranges[n - m_first_sample].offset,
-                        m_sample_ranges[n - m_first_sample].size);
+                        get_file_offset_for_sample(n),
+                        get_sample_size(n));
   return extent;
 }
+
+
+uint64_t Chunk::get_file_offset_for_sample(uint32_t n) const
+{
+  assert(n >= m_first_sample);
+  assert(n <= m_last_sample);
+
+  return m_file_offset + m_sample_sizes->get_sample_sizes_sum(n) - m_sizes_sum_before_chunk;
+}
+
+
+uint32_t Chunk::get_sample_size(uint32_t n) const
+{
+  return m_sample_sizes->get_sample_size(n);
+}
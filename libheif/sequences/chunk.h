@@ -43,8 +43,13 @@ public:
 
   heif_compression_format get_compression_format() const { return m_compression_format; }
 
+  std::shared_ptr<const Box_VisualSampleEntry> get_sample_description() const { return m_sample_description; }
+
   virtual std::shared_ptr<class Decoder> get_decoder() const { return m_decoder; }
 
+  // Allocates another decoder for the samples of this chunk, such that samples can be decoded in parallel.
+  std::shared_ptr<class Decoder> create_decoder() const;
+
   virtual std::shared_ptr<class Encoder> get_encoder() const { return m_encoder; }
 
   uint32_t first_sample_number() const { return m_first_sample; }
@@ -53,6 +58,10 @@ public:
 
   DataExtent get_data_extent_for_sample(uint32_t n) const;
 
+  uint64_t get_file_offset_for_sample(uint32_t n) const;
+
+  uint32_t get_sample_size(uint32_t n) const;
+
 private:
   HeifContext* m_ctx = nullptr;
   uint32_t m_track_id = 0;
@@ -66,13 +75,13 @@ private:
 
   uint32_t m_next_sample_to_be_decoded = 0;
 
-  struct SampleFileRange
-  {
-    uint64_t offset = 0;
-    uint32_t size = 0;
-  };
+  // The sample positions are computed from the sample sizes in the 'stsz' table
+  // instead of storing a file range for each sample.
+  uint64_t m_file_offset = 0;
+  uint64_t m_sizes_sum_before_chunk = 0;
+  std::shared_ptr<const Box_stsz> m_sample_sizes;
 
-  std::vector<SampleFileRange> m_sample_ranges;
+  std::shared_ptr<const Box_VisualSampleEntry> m_sample_description;
 
   std::shared_ptr<class Decoder> m_decoder;
   std::shared_ptr<class Encoder> m_encoder;
@@ -0,0 +1,188 @@
+/*
+ * HEIF image base codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sample_multiplexer.h"
+#include "file.h"
+#include <algorithm>
+#include <utility>
+
+
+SampleMultiplexer::SampleMultiplexer(std::shared_ptr<HeifFile> file, std::vector<std::shared_ptr<Track>> tracks)
+    : m_file(std::move(file))
+{
+  for (auto& track : tracks) {
+    TrackState state;
+    state.num_samples = track->get_number_of_samples();
+    state.track = std::move(track);
+    m_tracks.push_back(std::move(state));
+  }
+}
+
+
+static uint64_t get_first_file_offset(const Track::SampleFileRanges& ranges)
+{
+  uint64_t offset = ranges.data.offset;
+
+  for (const FileRange& aux : {ranges.content_id, ranges.tai_timestamp}) {
+    if (aux.size) {
+      offset = std::min(offset, aux.offset);
+    }
+  }
+
+  return offset;
+}
+
+
+Result<int> SampleMultiplexer::select_next_track(const std::vector<uint32_t>& positions) const
+{
+  int next_track = -1;
+  uint64_t next_offset = 0;
+
+  for (size_t i = 0; i < m_tracks.size(); i++) {
+    if (positions[i] >= m_tracks[i].num_samples) {
+      continue;
+    }
+
+    auto rangesResult = m_tracks[i].track->get_sample_file_ranges(positions[i]);
+    if (rangesResult.error) {
+      return rangesResult.error;
+    }
+
+    uint64_t offset = get_first_file_offset(*rangesResult);
+    if (next_track == -1 || offset < next_offset) {
+      next_track = static_cast<int>(i);
+      next_offset = offset;
+    }
+  }
+
+  return next_track;
+}
+
+
+Result<SampleMultiplexer::Sample> SampleMultiplexer::get_next_sample()
+{
+  std::vector<uint32_t> positions;
+  for (const auto& state : m_tracks) {
+    positions.push_back(state.next_sample);
+  }
+
+  Result<int> selectResult = select_next_track(positions);
+  if (selectResult.error) {
+    return selectResult.error;
+  }
+
+  if (*selectResult < 0) {
+    return Error{heif_error_End_of_sequence,
+                 heif_suberror_Unspecified,
+                 "End of sequence"};
+  }
+
+  TrackState& state = m_tracks[*selectResult];
+
+  auto sampleResult = state.track->read_sample_raw_data(state.next_sample,
+                                                        [this](const FileRange& range) {
+                                                          return read_range(range);
+                                                        });
+  if (sampleResult.error) {
+    return sampleResult.error;
+  }
+
+  state.next_sample++;
+
+  Sample sample;
+  sample.track_id = state.track->get_id();
+  sample.sample = *sampleResult;
+
+  return sample;
+}
+
+
+Result<std::vector<uint8_t>> SampleMultiplexer::read_range(const FileRange& range)
+{
+  if (range.size == 0) {
+    return std::vector<uint8_t>{};
+  }
+
+  if (range.offset < m_buffer_offset ||
+      range.offset + range.size > m_buffer_offset + m_buffer.size()) {
+    if (Error err = fill_buffer(range)) {
+      return err;
+    }
+  }
+
+  auto begin = m_buffer.begin() + static_cast<ptrdiff_t>(range.offset - m_buffer_offset);
+  return std::vector<uint8_t>(begin, begin + range.size);
+}
+
+
+Error SampleMultiplexer::fill_buffer(const FileRange& range)
+{
+  uint64_t start = range.offset;
+  uint64_t end = range.offset + range.size;
+
+  // --- walk through the following samples in the same order as get_next_sample() and extend the block
+  //     as long as their ranges follow closely
+
+  std::vector<uint32_t> positions;
+  for (const auto& state : m_tracks) {
+    positions.push_back(state.next_sample);
+  }
+
+  for (int n = 0; n < max_lookahead_samples; n++) {
+    Result<int> selectResult = select_next_track(positions);
+    if (selectResult.error || *selectResult < 0) {
+      break;
+    }
+
+    auto rangesResult = m_tracks[*selectResult].track->get_sample_file_ranges(positions[*selectResult]);
+    if (rangesResult.error) {
+      break;
+    }
+
+    bool block_complete = false;
+
+    for (const FileRange& r : {rangesResult.value.data, rangesResult.value.content_id, rangesResult.value.tai_timestamp}) {
+      if (r.size == 0 || r.offset < start) {
+        // Empty, or in front of the block. The latter has already been read or needs a separate read.
+        continue;
+      }
+
+      if (r.offset > end + max_gap_size || r.offset + r.size - start > max_block_size) {
+        block_complete = true;
+        break;
+      }
+
+      end = std::max(end, r.offset + r.size);
+    }
+
+    if (block_complete) {
+      break;
+    }
+
+    positions[*selectResult]++;
+  }
+
+  // --- read the block
+
+  m_buffer.clear();
+  m_buffer_offset = start;
+
+  return m_file->append_data_from_file_range(m_buffer, start, static_cast<uint32_t>(end - start));
+}
@@ -0,0 +1,88 @@
+/*
+ * HEIF image base codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_SAMPLE_MULTIPLEXER_H
+#define LIBHEIF_SAMPLE_MULTIPLEXER_H
+
+#include "error.h"
+#include "sequences/track.h"
+#include <memory>
+#include <vector>
+
+
+class HeifFile;
+
+
+// Reads the raw samples of several tracks in the order in which they are stored in the file.
+//
+// The samples of each track are still returned in decoding order. Among the tracks, the sample that starts
+// first in the file (including its sample auxiliary information) is returned next.
+// The data is read in blocks that cover the neighbouring samples of all tracks. Thus, reading all samples
+// of a file with interleaved tracks only needs forward reads.
+class SampleMultiplexer
+{
+public:
+  SampleMultiplexer(std::shared_ptr<HeifFile> file, std::vector<std::shared_ptr<Track>> tracks);
+
+  struct Sample
+  {
+    uint32_t track_id = 0;
+    heif_raw_sequence_sample* sample = nullptr;
+  };
+
+  // Returns heif_error_End_of_sequence after the last sample of all tracks.
+  Result<Sample> get_next_sample();
+
+private:
+  std::shared_ptr<HeifFile> m_file;
+
+  struct TrackState
+  {
+    std::shared_ptr<Track> track;
+    uint32_t next_sample = 0;
+    uint32_t num_samples = 0;
+  };
+
+  std::vector<TrackState> m_tracks;
+
+  // Returns the index into m_tracks of the track whose next sample comes first, or -1 at the end.
+  // 'positions' holds the next sample of each track.
+  Result<int> select_next_track(const std::vector<uint32_t>& positions) const;
+
+  Result<std::vector<uint8_t>> read_range(const FileRange& range);
+
+  // Reads a block starting at 'range' that also covers the ranges of the following samples, as long as
+  // they are close to each other.
+  Error fill_buffer(const FileRange& range);
+
+  uint64_t m_buffer_offset = 0;
+  std::vector<uint8_t> m_buffer;
+
+  // The gap between two ranges up to which they are read in one block. The data in the gap is skipped.
+  static constexpr uint64_t max_gap_size = 64 * 1024;
+
+  static constexpr uint64_t max_block_size = 4 * 1024 * 1024;
+
+  // Maximum number of samples that are looked ahead to plan a block.
+  static constexpr int max_lookahead_samples = 1024;
+};
+
+
+#endif //LIBHEIF_SAMPLE_MULTIPLEXER_H
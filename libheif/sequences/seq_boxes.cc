@@ -19,6 +19,7 @@
  */
 
 #include "sequences/seq_boxes.h"
+#include <algorithm>
 #include <iomanip>
 #include <set>
 #include <limits>
@@ -540,6 +541,8 @@ Error Box_stsd::write(StreamWriter& writer) const
 
 Error Box_stts::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_version() > 0) {
@@ -557,19 +560,39 @@ Error Box_stts::parse(BitstreamRange& range, const heif_security_limits* limits)
             sstr.str()};
   }
 
-  m_entries.resize(entry_count);
+  m_entries.reserve(entry_count);
+  m_entry_starts.reserve(entry_count);
 
   for (uint32_t i = 0; i < entry_count; i++) {
     TimeToSample entry;
     entry.sample_count = range.read32();
     entry.sample_delta = range.read32();
-    m_entries[i] = entry;
+
+    if (range.error()) {
+      return range.get_error();
+    }
+
+    add_entry(entry);
   }
 
   return range.get_error();
 }
 
 
+void Box_stts::add_entry(const TimeToSample& entry)
+{
+  EntryStart start{0, 0};
+  if (!m_entries.empty()) {
+    const TimeToSample& last = m_entries.back();
+    start.first_sample = m_entry_starts.back().first_sample + last.sample_count;
+    start.start_time = m_entry_starts.back().start_time + last.sample_count * uint64_t(last.sample_delta);
+  }
+
+  m_entries.push_back(entry);
+  m_entry_starts.push_back(start);
+}
+
+
 std::string Box_stts::dump(Indent& indent) const
 {
   std::ostringstream sstr;
@@ -598,29 +621,71 @@ Error Box_stts::write(StreamWriter& writer) const
 }
 
 
-uint32_t Box_stts::get_sample_duration(uint32_t sample_idx)
+uint32_t Box_stts::get_sample_duration(uint32_t sample_idx) const
 {
-  size_t i = 0;
-  while (i < m_entries.size()) {
-    if (sample_idx < m_entries[i].sample_count) {
-      return m_entries[i].sample_delta;
-    }
-    else {
-      sample_idx -= m_entries[i].sample_count;
-    }
+  // find the last entry that starts at or before 'sample_idx'
+  auto it = std::upper_bound(m_entry_starts.begin(), m_entry_starts.end(), sample_idx,
+                             [](uint32_t idx, const EntryStart& start) { return idx < start.first_sample; });
+  if (it == m_entry_starts.begin()) {
+    return 0;
+  }
+
+  size_t i = std::distance(m_entry_starts.begin(), it) - 1;
+  if (sample_idx - m_entry_starts[i].first_sample < m_entries[i].sample_count) {
+    return m_entries[i].sample_delta;
   }
 
   return 0;
 }
 
 
+uint64_t Box_stts::get_sample_decoding_time(uint32_t sample_idx) const
+{
+  auto it = std::upper_bound(m_entry_starts.begin(), m_entry_starts.end(), sample_idx,
+                             [](uint32_t idx, const EntryStart& start) { return idx < start.first_sample; });
+  if (it == m_entry_starts.begin()) {
+    return 0;
+  }
+
+  // Samples after the end of the table get the end time of the last entry.
+
+  size_t i = std::distance(m_entry_starts.begin(), it) - 1;
+  uint32_t n = std::min(sample_idx - m_entry_starts[i].first_sample, m_entries[i].sample_count);
+
+  return m_entry_starts[i].start_time + n * uint64_t(m_entries[i].sample_delta);
+}
+
+
+uint32_t Box_stts::get_sample_at_time(uint64_t time) const
+{
+  auto it = std::upper_bound(m_entry_starts.begin(), m_entry_starts.end(), time,
+                             [](uint64_t t, const EntryStart& start) { return t < start.start_time; });
+  if (it == m_entry_starts.begin()) {
+    return 0;
+  }
+
+  // Entries with zero duration share their start time with the following entry. Since we take the last
+  // entry starting at or before 'time', 'time' is always within this entry, unless it is after the end.
+
+  size_t i = std::distance(m_entry_starts.begin(), it) - 1;
+  const TimeToSample& entry = m_entries[i];
+  uint64_t offset = time - m_entry_starts[i].start_time;
+
+  if (offset < entry.sample_count * uint64_t(entry.sample_delta)) {
+    return m_entry_starts[i].first_sample + static_cast<uint32_t>(offset / entry.sample_delta);
+  }
+
+  return m_entry_starts[i].first_sample + entry.sample_count;
+}
+
+
 void Box_stts::append_sample_duration(uint32_t duration)
 {
   if (m_entries.empty() || m_entries.back().sample_delta != duration) {
     TimeToSample entry;
     entry.sample_delta = duration;
     entry.sample_count = 1;
-    m_entries.push_back(entry);
+    add_entry(entry);
     return;
   }
 
@@ -628,24 +693,164 @@ void Box_stts::append_sample_duration(uint32_t duration)
 }
 
 
-uint64_t Box_stts::get_total_duration(bool include_last_frame_duration)
+uint64_t Box_stts::get_total_duration(bool include_last_frame_duration) const
+{
+  if (m_entries.empty()) {
+    return 0;
+  }
+
+  const TimeToSample& last = m_entries.back();
+  uint64_t total = m_entry_starts.back().start_time + last.sample_count * uint64_t(last.sample_delta);
+
+  if (!include_last_frame_duration) {
+    total -= last.sample_delta;
+  }
+
+  return total;
+}
+
+
+Error Box_ctts::parse(BitstreamRange& range, const heif_security_limits* limits)
+{
+  range.buffer_remaining_data();
+
+  parse_full_box_header(range);
+
+  if (get_version() > 1) {
+    return unsupported_version_error("ctts");
+  }
+
+  uint32_t entry_count = range.read32();
+  if (limits->max_memory_block_size && uint64_t(entry_count) * sizeof(OffsetToSample) > limits->max_memory_block_size) {
+    std::stringstream sstr;
+    sstr << "Allocating " << static_cast<uint64_t>(entry_count) * sizeof(OffsetToSample) << " bytes for the 'ctts' table exceeds the security limit of "
+         << limits->max_memory_block_size << " bytes";
+
+    return {heif_error_Memory_allocation_error,
+            heif_suberror_Security_limit_exceeded,
+            sstr.str()};
+  }
+
+  m_entries.resize(entry_count);
+  m_entry_first_samples.resize(entry_count);
+
+  uint64_t first_sample = 0;
+
+  for (uint32_t i = 0; i < entry_count; i++) {
+    OffsetToSample entry;
+    entry.sample_count = range.read32();
+    if (get_version() == 0) {
+      // unsigned in version 0, but offsets larger than 2^31 are not used in practice
+      uint32_t offset = range.read32();
+      entry.sample_offset = static_cast<int32_t>(std::min(offset, uint32_t(std::numeric_limits<int32_t>::max())));
+    }
+    else {
+      entry.sample_offset = range.read32s();
+    }
+    m_entries[i] = entry;
+
+    if (first_sample > std::numeric_limits<uint32_t>::max()) {
+      return {heif_error_Invalid_input,
+              heif_suberror_Unspecified,
+              "'ctts' box describes more than 2^32 samples"};
+    }
+
+    m_entry_first_samples[i] = static_cast<uint32_t>(first_sample);
+    first_sample += entry.sample_count;
+  }
+
+  return range.get_error();
+}
+
+
+std::string Box_ctts::dump(Indent& indent) const
 {
-  uint64_t total = 0;
+  std::ostringstream sstr;
+  sstr << Box::dump(indent);
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    sstr << indent << "[" << i << "] : cnt=" << m_entries[i].sample_count << ", offset=" << m_entries[i].sample_offset << "\n";
+  }
+
+  return sstr.str();
+}
 
+
+void Box_ctts::derive_box_version()
+{
+  bool negative_offsets = false;
   for (const auto& entry : m_entries) {
-    total += entry.sample_count * uint64_t(entry.sample_delta);
+    if (entry.sample_offset < 0) {
+      negative_offsets = true;
+    }
   }
 
-  if (!include_last_frame_duration && !m_entries.empty()) {
-    total -= m_entries.back().sample_delta;
+  set_version(negative_offsets ? 1 : 0);
+}
+
+
+Error Box_ctts::write(StreamWriter& writer) const
+{
+  size_t box_start = reserve_box_header_space(writer);
+
+  writer.write32(static_cast<uint32_t>(m_entries.size()));
+  for (const auto& sample : m_entries) {
+    writer.write32(sample.sample_count);
+    writer.write32s(sample.sample_offset);
   }
 
-  return total;
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
+
+
+int32_t Box_ctts::get_sample_offset(uint32_t sample_idx) const
+{
+  // find the last entry that starts at or before 'sample_idx'
+  auto it = std::upper_bound(m_entry_first_samples.begin(), m_entry_first_samples.end(), sample_idx);
+  if (it == m_entry_first_samples.begin()) {
+    return 0;
+  }
+
+  size_t i = std::distance(m_entry_first_samples.begin(), it) - 1;
+  if (sample_idx - m_entry_first_samples[i] < m_entries[i].sample_count) {
+    return m_entries[i].sample_offset;
+  }
+
+  return 0;
+}
+
+
+void Box_ctts::append_sample_offset(int32_t offset)
+{
+  if (m_entries.empty() || m_entries.back().sample_offset != offset) {
+    OffsetToSample entry;
+    entry.sample_offset = offset;
+    entry.sample_count = 1;
+
+    m_entry_first_samples.push_back(get_number_of_samples());
+    m_entries.push_back(entry);
+    return;
+  }
+
+  m_entries.back().sample_count++;
+}
+
+
+uint32_t Box_ctts::get_number_of_samples() const
+{
+  if (m_entries.empty()) {
+    return 0;
+  }
+
+  return m_entry_first_samples.back() + m_entries.back().sample_count;
 }
 
 
 Error Box_stsc::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_version() > 0) {
@@ -673,6 +878,10 @@ Error Box_stsc::parse(BitstreamRange& range, const heif_security_limits* limits)
     m_entries[i] = entry;
   }
 
+  if (!m_entries.empty()) {
+    m_number_of_chunks = m_entries.back().first_chunk;
+  }
+
   return range.get_error();
 }
 
@@ -696,8 +905,17 @@ Error Box_stsc::write(StreamWriter& writer) const
 {
   size_t box_start = reserve_box_header_space(writer);
 
-  writer.write32(static_cast<uint32_t>(m_entries.size()));
-  for (const auto& sample : m_entries) {
+  // The last chunk has not been merged into its run by add_chunk() yet.
+  size_t nEntries = m_entries.size();
+  if (nEntries >= 2 &&
+      m_entries[nEntries - 1].samples_per_chunk == m_entries[nEntries - 2].samples_per_chunk &&
+      m_entries[nEntries - 1].sample_description_index == m_entries[nEntries - 2].sample_description_index) {
+    nEntries--;
+  }
+
+  writer.write32(static_cast<uint32_t>(nEntries));
+  for (size_t i = 0; i < nEntries; i++) {
+    const auto& sample = m_entries[i];
     writer.write32(sample.first_chunk);
     writer.write32(sample.samples_per_chunk);
     writer.write32(sample.sample_description_index);
@@ -712,20 +930,35 @@ Error Box_stsc::write(StreamWriter& writer) const
 const Box_stsc::SampleToChunk* Box_stsc::get_chunk(uint32_t idx) const
 {
   assert(idx>=1);
-  for (size_t i = 0 ; i < m_entries.size();i++) {
-    if (idx >= m_entries[i].first_chunk && (i==m_entries.size()-1 || idx < m_entries[i+1].first_chunk)) {
-      return &m_entries[i];
-    }
+
+  // The entries are sorted by 'first_chunk'. Find the last entry that starts at or before 'idx'.
+  auto it = std::upper_bound(m_entries.begin(), m_entries.end(), idx,
+                             [](uint32_t chunk_idx, const SampleToChunk& entry) { return chunk_idx < entry.first_chunk; });
+  if (it == m_entries.begin()) {
+    return nullptr;
   }
 
-  return nullptr;
+  return &*(it - 1);
 }
 
 
 void Box_stsc::add_chunk(uint32_t description_index)
 {
+  // The previous chunk is complete now. If it continues the run of the entry before it, drop its own entry.
+  if (m_entries.size() >= 2) {
+    const SampleToChunk& last = m_entries[m_entries.size() - 1];
+    const SampleToChunk& run = m_entries[m_entries.size() - 2];
+    if (last.samples_per_chunk == run.samples_per_chunk &&
+        last.sample_description_index == run.sample_description_index) {
+      m_entries.pop_back();
+    }
+  }
+
+  // The new chunk gets its own entry since the number of samples is not known yet.
+  m_number_of_chunks++;
+
   SampleToChunk entry;
-  entry.first_chunk = 1; // TODO
+  entry.first_chunk = m_number_of_chunks;
   entry.samples_per_chunk = 0;
   entry.sample_description_index = description_index;
   m_entries.push_back(entry);
@@ -740,23 +973,32 @@ void Box_stsc::increase_samples_in_chunk(uint32_t nFrames)
 }
 
 
+// The chunk and aux info offsets are relative to the start of the 'mdat' data until they are patched.
+// Like for 'iloc', guess an upper bound for the size of the boxes in front of the 'mdat'.
+static const uint64_t maximum_header_size_guess = 0x10000000; // 256 MB
+
+
 Error Box_stco::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
+  bool large_offsets = (get_short_type() == fourcc("co64"));
+
   if (get_version() > 0) {
-    return unsupported_version_error("stco");
+    return unsupported_version_error(large_offsets ? "co64" : "stco");
   }
 
   uint32_t entry_count = range.read32();
 
   // check required memory
 
-  uint64_t mem_size = entry_count * sizeof(uint32_t);
+  uint64_t mem_size = entry_count * sizeof(uint64_t);
   if (limits->max_memory_block_size && mem_size > limits->max_memory_block_size) {
     std::stringstream sstr;
-    sstr << "Allocating " << mem_size << " bytes for the 'stco' table exceeds the security limit of "
-         << limits->max_memory_block_size << " bytes";
+    sstr << "Allocating " << mem_size << " bytes for the '" << fourcc_to_string(get_short_type())
+         << "' table exceeds the security limit of " << limits->max_memory_block_size << " bytes";
 
     return {heif_error_Memory_allocation_error,
             heif_suberror_Security_limit_exceeded,
@@ -764,7 +1006,7 @@ Error Box_stco::parse(BitstreamRange& range, const heif_security_limits* limits)
   }
 
   for (uint32_t i = 0; i < entry_count; i++) {
-    m_offsets.push_back(range.read32());
+    m_offsets.push_back(large_offsets ? range.read64() : range.read32());
 
     if (range.error()) {
       return range.get_error();
@@ -787,6 +1029,22 @@ std::string Box_stco::dump(Indent& indent) const
 }
 
 
+void Box_stco::derive_box_version()
+{
+  uint64_t max_offset = 0;
+  for (uint64_t offset : m_offsets) {
+    max_offset = std::max(max_offset, offset);
+  }
+
+  if (max_offset + maximum_header_size_guess > 0xFFFFFFFF) {
+    set_short_type(fourcc("co64"));
+  }
+  else {
+    set_short_type(fourcc("stco"));
+  }
+}
+
+
 Error Box_stco::write(StreamWriter& writer) const
 {
   size_t box_start = reserve_box_header_space(writer);
@@ -795,8 +1053,15 @@ Error Box_stco::write(StreamWriter& writer) const
 
   m_offset_start_pos = writer.get_position();
 
-  for (uint32_t offset : m_offsets) {
-    writer.write32(offset);
+  bool large_offsets = (get_short_type() == fourcc("co64"));
+
+  for (uint64_t offset : m_offsets) {
+    if (large_offsets) {
+      writer.write64(offset);
+    }
+    else {
+      writer.write32(static_cast<uint32_t>(offset));
+    }
   }
 
   prepend_header(writer, box_start);
@@ -811,8 +1076,13 @@ void Box_stco::patch_file_pointers(StreamWriter& writer, size_t offset)
 
   writer.set_position(m_offset_start_pos);
 
-  for (uint32_t chunk_offset : m_offsets) {
-    if (chunk_offset + offset > std::numeric_limits<uint32_t>::max()) {
+  bool large_offsets = (get_short_type() == fourcc("co64"));
+
+  for (uint64_t chunk_offset : m_offsets) {
+    if (large_offsets) {
+      writer.write64(chunk_offset + offset);
+    }
+    else if (chunk_offset + offset > std::numeric_limits<uint32_t>::max()) {
       writer.write32(0); // TODO: error
     }
     else {
@@ -827,13 +1097,28 @@ void Box_stco::patch_file_pointers(StreamWriter& writer, size_t offset)
 
 Error Box_stsz::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
+  bool compact = (get_short_type() == fourcc("stz2"));
+
   if (get_version() > 0) {
-    return unsupported_version_error("stsz");
+    return unsupported_version_error(compact ? "stz2" : "stsz");
+  }
+
+  if (compact) {
+    m_compact_field_size = static_cast<uint8_t>(range.read32() & 0xFF);
+    if (m_compact_field_size != 4 && m_compact_field_size != 8 && m_compact_field_size != 16) {
+      return {heif_error_Invalid_input,
+              heif_suberror_Unspecified,
+              "Invalid field size in 'stz2' box"};
+    }
+  }
+  else {
+    m_fixed_sample_size = range.read32();
   }
 
-  m_fixed_sample_size = range.read32();
   m_sample_count = range.read32();
 
   if (m_fixed_sample_size == 0) {
@@ -842,20 +1127,46 @@ Error Box_stsz::parse(BitstreamRange& range, const heif_security_limits* limits)
     uint64_t mem_size = m_sample_count * sizeof(uint32_t);
     if (limits->max_memory_block_size && mem_size > limits->max_memory_block_size) {
       std::stringstream sstr;
-      sstr << "Allocating " << mem_size << " bytes for the 'stsz' table exceeds the security limit of "
-           << limits->max_memory_block_size << " bytes";
+      sstr << "Allocating " << mem_size << " bytes for the '" << fourcc_to_string(get_short_type())
+           << "' table exceeds the security limit of " << limits->max_memory_block_size << " bytes";
 
       return {heif_error_Memory_allocation_error,
               heif_suberror_Security_limit_exceeded,
               sstr.str()};
     }
 
+    uint8_t packed_sizes = 0;
+
     for (uint32_t i = 0; i < m_sample_count; i++) {
-      m_sample_sizes.push_back(range.read32());
+      uint32_t size;
+
+      switch (m_compact_field_size) {
+        case 4:
+          // two samples per byte, the first one in the upper nibble
+          if (i % 2 == 0) {
+            packed_sizes = range.read8();
+            size = packed_sizes >> 4;
+          }
+          else {
+            size = packed_sizes & 0x0F;
+          }
+          break;
+        case 8:
+          size = range.read8();
+          break;
+        case 16:
+          size = range.read16();
+          break;
+        default:
+          size = range.read32();
+          break;
+      }
 
       if (range.error()) {
         return range.get_error();
       }
+
+      add_variable_sample_size(size);
     }
   }
 
@@ -867,6 +1178,9 @@ std::string Box_stsz::dump(Indent& indent) const
 {
   std::ostringstream sstr;
   sstr << Box::dump(indent);
+  if (m_compact_field_size) {
+    sstr << indent << "field size: " << int(m_compact_field_size) << "\n";
+  }
   sstr << indent << "sample count: " << m_sample_count << "\n";
   if (m_fixed_sample_size == 0) {
     for (size_t i = 0; i < m_sample_sizes.size(); i++) {
@@ -881,17 +1195,64 @@ std::string Box_stsz::dump(Indent& indent) const
 }
 
 
+void Box_stsz::derive_box_version()
+{
+  m_compact_field_size = 0;
+
+  if (m_fixed_sample_size == 0 && m_sample_count > 0) {
+    if (m_max_sample_size < 0x10) {
+      m_compact_field_size = 4;
+    }
+    else if (m_max_sample_size < 0x100) {
+      m_compact_field_size = 8;
+    }
+    else if (m_max_sample_size < 0x10000) {
+      m_compact_field_size = 16;
+    }
+  }
+
+  set_short_type(m_compact_field_size ? fourcc("stz2") : fourcc("stsz"));
+}
+
+
 Error Box_stsz::write(StreamWriter& writer) const
 {
   size_t box_start = reserve_box_header_space(writer);
 
-  writer.write32(m_fixed_sample_size);
+  if (m_compact_field_size) {
+    writer.write32(m_compact_field_size); // 24 bits reserved, 8 bits field size
+  }
+  else {
+    writer.write32(m_fixed_sample_size);
+  }
+
   writer.write32(m_sample_count);
+
   if (m_fixed_sample_size == 0) {
     assert(m_sample_count == m_sample_sizes.size());
 
-    for (uint32_t size : m_sample_sizes) {
-      writer.write32(size);
+    switch (m_compact_field_size) {
+      case 4:
+        for (size_t i = 0; i < m_sample_sizes.size(); i += 2) {
+          uint32_t second = (i + 1 < m_sample_sizes.size()) ? m_sample_sizes[i + 1] : 0;
+          writer.write8(static_cast<uint8_t>((m_sample_sizes[i] << 4) | second));
+        }
+        break;
+      case 8:
+        for (uint32_t size : m_sample_sizes) {
+          writer.write8(static_cast<uint8_t>(size));
+        }
+        break;
+      case 16:
+        for (uint32_t size : m_sample_sizes) {
+          writer.write16(static_cast<uint16_t>(size));
+        }
+        break;
+      default:
+        for (uint32_t size : m_sample_sizes) {
+          writer.write32(size);
+        }
+        break;
     }
   }
 
@@ -901,6 +1262,53 @@ Error Box_stsz::write(StreamWriter& writer) const
 }
 
 
+uint32_t Box_stsz::get_sample_size(uint32_t sample_idx) const
+{
+  if (sample_idx >= m_sample_count) {
+    return 0;
+  }
+
+  if (m_fixed_sample_size != 0) {
+    return m_fixed_sample_size;
+  }
+
+  return m_sample_sizes[sample_idx];
+}
+
+
+uint64_t Box_stsz::get_sample_sizes_sum(uint32_t sample_idx) const
+{
+  if (m_fixed_sample_size != 0) {
+    return std::min(sample_idx, m_sample_count) * uint64_t(m_fixed_sample_size);
+  }
+
+  if (sample_idx >= m_sample_sizes.size()) {
+    return m_sizes_sum;
+  }
+
+  uint32_t block = sample_idx / sizes_sum_index_step;
+  uint64_t sum = m_sizes_sum_index[block];
+
+  for (uint32_t i = block * sizes_sum_index_step; i < sample_idx; i++) {
+    sum += m_sample_sizes[i];
+  }
+
+  return sum;
+}
+
+
+void Box_stsz::add_variable_sample_size(uint32_t size)
+{
+  if (m_sample_sizes.size() % sizes_sum_index_step == 0) {
+    m_sizes_sum_index.push_back(m_sizes_sum);
+  }
+
+  m_sample_sizes.push_back(size);
+  m_sizes_sum += size;
+  m_max_sample_size = std::max(m_max_sample_size, size);
+}
+
+
 void Box_stsz::append_sample_size(uint32_t size)
 {
   if (m_sample_count == 0 && size != 0) {
@@ -916,13 +1324,13 @@ void Box_stsz::append_sample_size(uint32_t size)
 
   if (m_fixed_sample_size != 0) {
     for (uint32_t i = 0; i < m_sample_count; i++) {
-      m_sample_sizes.push_back(m_fixed_sample_size);
+      add_variable_sample_size(m_fixed_sample_size);
     }
 
     m_fixed_sample_size = 0;
   }
 
-  m_sample_sizes.push_back(size);
+  add_variable_sample_size(size);
   m_sample_count++;
 
   assert(m_sample_count == m_sample_sizes.size());
@@ -931,6 +1339,8 @@ void Box_stsz::append_sample_size(uint32_t size)
 
 Error Box_stss::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_version() > 0) {
@@ -1302,6 +1712,8 @@ Error Box_sbgp::write(StreamWriter& writer) const
 
 Error Box_sbgp::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_version() > 1) {
@@ -1316,9 +1728,11 @@ Error Box_sbgp::parse(BitstreamRange& range, const heif_security_limits* limits)
 
   uint32_t count = range.read32();
 
-  if (limits->max_memory_block_size && uint64_t(count) * 2 * sizeof(uint32_t) > limits->max_memory_block_size) {
+  // the entries and the index of their first samples
+  uint64_t table_size = uint64_t(count) * (sizeof(Entry) + sizeof(uint64_t));
+  if (limits->max_memory_block_size && table_size > limits->max_memory_block_size) {
     std::stringstream sstr;
-    sstr << "Allocating " << static_cast<uint64_t>(count) * 2 * sizeof(uint32_t) << " bytes for the 'sample to group' table exceeds the security limit of "
+    sstr << "Allocating " << table_size << " bytes for the 'sample to group' table exceeds the security limit of "
          << limits->max_memory_block_size << " bytes";
 
     return {heif_error_Memory_allocation_error,
@@ -1326,28 +1740,63 @@ Error Box_sbgp::parse(BitstreamRange& range, const heif_security_limits* limits)
             sstr.str()};
   }
 
+  uint64_t first_sample = 0;
+
   for (uint32_t i = 0; i < count; i++) {
     Entry e;
     e.sample_count = range.read32();
     e.group_description_index = range.read32();
     m_entries.push_back(e);
+
+    m_first_sample_of_entry.push_back(first_sample);
+    first_sample += e.sample_count;
   }
 
+  m_first_sample_of_entry.push_back(first_sample);
+
   return range.get_error();
 }
 
 
-std::string SampleGroupEntry_refs::dump() const
+void Box_sbgp::get_group_description_indices(uint32_t first_sample, uint32_t count, uint32_t unmapped_index,
+                                             uint32_t* out_indices) const
 {
-  std::stringstream sstr;
-  if (m_sample_id==0) {
-    sstr << "0 (non-ref) refs =";
-  }
-  else {
-    sstr << m_sample_id << " refs =";
-  }
-  for (uint32_t ref : m_direct_reference_sample_id) {
-    sstr << ' ' << ref;
+  // Find the last entry that starts at or before 'first_sample'. Entries with zero samples are skipped
+  // because the following entry starts at the same sample.
+  size_t entry_idx = 0;
+  if (!m_entries.empty()) {
+    auto it = std::upper_bound(m_first_sample_of_entry.begin(), m_first_sample_of_entry.end() - 1, uint64_t{first_sample});
+    entry_idx = static_cast<size_t>(it - m_first_sample_of_entry.begin()) - 1;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t sample_idx = uint64_t{first_sample} + i;
+
+    while (entry_idx < m_entries.size() && sample_idx >= m_first_sample_of_entry[entry_idx + 1]) {
+      entry_idx++;
+    }
+
+    if (entry_idx < m_entries.size()) {
+      out_indices[i] = m_entries[entry_idx].group_description_index;
+    }
+    else {
+      out_indices[i] = unmapped_index;
+    }
+  }
+}
+
+
+std::string SampleGroupEntry_refs::dump() const
+{
+  std::stringstream sstr;
+  if (m_sample_id==0) {
+    sstr << "0 (non-ref) refs =";
+  }
+  else {
+    sstr << m_sample_id << " refs =";
+  }
+  for (uint32_t ref : m_direct_reference_sample_id) {
+    sstr << ' ' << ref;
   }
 
   return sstr.str();
@@ -1355,7 +1804,19 @@ std::string SampleGroupEntry_refs::dump() const
 
 Error SampleGroupEntry_refs::write(StreamWriter& writer) const
 {
-  return {};
+  if (m_direct_reference_sample_id.size() > 0xFF) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Too many direct references in 'refs' sample group entry."};
+  }
+
+  writer.write32(m_sample_id);
+  writer.write8(static_cast<uint8_t>(m_direct_reference_sample_id.size()));
+  for (uint32_t ref : m_direct_reference_sample_id) {
+    writer.write32(ref);
+  }
+
+  return Error::Ok;
 }
 
 Error SampleGroupEntry_refs::parse(BitstreamRange& range, const heif_security_limits*)
@@ -1372,14 +1833,13 @@ Error SampleGroupEntry_refs::parse(BitstreamRange& range, const heif_security_li
 
 void Box_sgpd::derive_box_version()
 {
-  if (m_default_length) {
-    set_version(1);
-    assert(!m_default_sample_description_index);
+  if (m_default_group_description_index) {
+    set_version(2);
     return;
   }
 
-  if (m_default_sample_description_index) {
-    set_version(2);
+  if (m_default_length) {
+    set_version(1);
     return;
   }
 
@@ -1396,8 +1856,8 @@ std::string Box_sgpd::dump(Indent& indent) const
   if (m_default_length) {
     sstr << indent << "default_length: " << *m_default_length << "\n";
   }
-  if (m_default_sample_description_index) {
-    sstr << indent << "default_sample_description_index: " << *m_default_sample_description_index << "\n";
+  if (m_default_group_description_index) {
+    sstr << indent << "default_group_description_index: " << *m_default_group_description_index << "\n";
   }
 
   for (size_t i=0; i<m_entries.size(); i++) {
@@ -1426,12 +1886,12 @@ Error Box_sgpd::parse(BitstreamRange& range, const heif_security_limits* limits)
 
   m_grouping_type = range.read32();
 
-  if (get_version() == 1) {
+  if (get_version() >= 1) {
     m_default_length = range.read32();
   }
 
   if (get_version() >= 2) {
-    m_default_sample_description_index = range.read32();
+    m_default_group_description_index = range.read32();
   }
 
   uint32_t entry_count = range.read32();
@@ -1451,18 +1911,62 @@ Error Box_sgpd::parse(BitstreamRange& range, const heif_security_limits* limits)
   for (uint32_t i = 0; i < entry_count; i++) {
     Entry entry;
 
-    if (get_version() == 1) {
+    std::optional<uint32_t> length;
+
+    if (get_version() >= 1) {
       if (*m_default_length == 0) {
         entry.description_length = range.read32();
+        length = entry.description_length;
+      }
+      else {
+        length = *m_default_length;
+      }
+    }
+
+    // Keep the payload when its length is known. Known entry types are parsed from the payload.
+
+    if (length) {
+      if (limits->max_memory_block_size && *length > limits->max_memory_block_size) {
+        return {heif_error_Memory_allocation_error,
+                heif_suberror_Security_limit_exceeded,
+                "Sample group description exceeds the security limit"};
+      }
+
+      if (*length > range.get_remaining_bytes()) {
+        return {heif_error_Invalid_input,
+                heif_suberror_End_of_data,
+                "Sample group description exceeds the 'sgpd' box"};
+      }
+
+      entry.data.resize(*length);
+      if (!range.read(entry.data.data(), entry.data.size())) {
+        return range.get_error();
       }
     }
 
     switch (m_grouping_type) {
       case fourcc("refs"): {
         entry.sample_group_entry = std::make_shared<SampleGroupEntry_refs>();
-        Error err = entry.sample_group_entry->parse(range, limits);
-        if (err) {
-          return err;
+
+        if (length) {
+          auto reader = std::make_shared<StreamReader_memory>(entry.data.data(), entry.data.size(), false);
+          BitstreamRange entry_range(reader, entry.data.size());
+          entry.sample_group_entry->parse(entry_range, limits);
+          if (Error err = entry_range.get_error()) {
+            return err;
+          }
+        }
+        else {
+          Error err = entry.sample_group_entry->parse(range, limits);
+          if (err) {
+            return err;
+          }
+
+          StreamWriter writer;
+          if (Error err2 = entry.sample_group_entry->write(writer)) {
+            return err2;
+          }
+          entry.data = writer.get_data();
         }
 
         break;
@@ -1475,7 +1979,17 @@ Error Box_sgpd::parse(BitstreamRange& range, const heif_security_limits* limits)
     m_entries.emplace_back(std::move(entry));
   }
 
-  return Error::Ok;
+  return range.get_error();
+}
+
+
+const std::vector<uint8_t>* Box_sgpd::get_entry_data(uint32_t index) const
+{
+  if (index == 0 || index > m_entries.size()) {
+    return nullptr;
+  }
+
+  return &m_entries[index - 1].data;
 }
 
 
@@ -1644,6 +2158,8 @@ Error Box_saiz::write(StreamWriter& writer) const
 
 Error Box_saiz::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_flags() & 1) {
@@ -1668,7 +2184,7 @@ Error Box_saiz::parse(BitstreamRange& range, const heif_security_limits* limits)
               sstr.str()};
     }
 
-    m_sample_sizes.reserve(m_num_samples);
+    m_sample_sizes.resize(m_num_samples);
     range.read(m_sample_sizes.data(), m_num_samples);
   }
 
@@ -1689,7 +2205,7 @@ void Box_saio::set_aux_info_type(uint32_t aux_info_type, uint32_t aux_info_type_
 
 void Box_saio::add_sample_offset(uint64_t s)
 {
-  if (s > 0xFFFFFFFF) {
+  if (s + maximum_header_size_guess > 0xFFFFFFFF) {
     m_need_64bit = true;
     set_version(1);
   }
@@ -1792,6 +2308,8 @@ Error Box_saio::write(StreamWriter& writer) const
 
 Error Box_saio::parse(BitstreamRange& range, const heif_security_limits* limits)
 {
+  range.buffer_remaining_data();
+
   parse_full_box_header(range);
 
   if (get_flags() & 1) {
@@ -1825,7 +2343,7 @@ Error Box_saio::parse(BitstreamRange& range, const heif_security_limits* limits)
       offset = range.read32();
     }
 
-    m_sample_offset[i] = offset;
+    m_sample_offset.push_back(offset);
 
     if (range.error()) {
       return range.get_error();
@@ -2015,3 +2533,447 @@ void Box_tref::add_references(uint32_t to_track_id, uint32_t type)
 
   m_references.push_back(ref);
 }
+
+
+Error Box_trex::parse(BitstreamRange& range, const heif_security_limits* limits)
+{
+  parse_full_box_header(range);
+
+  if (get_version() > 0) {
+    return unsupported_version_error("trex");
+  }
+
+  m_track_id = range.read32();
+  m_default_sample_description_index = range.read32();
+  m_default_sample_duration = range.read32();
+  m_default_sample_size = range.read32();
+  m_default_sample_flags = range.read32();
+
+  return range.get_error();
+}
+
+
+std::string Box_trex::dump(Indent& indent) const
+{
+  std::ostringstream sstr;
+  sstr << FullBox::dump(indent);
+  sstr << indent << "track ID: " << m_track_id << "\n"
+       << indent << "default sample description index: " << m_default_sample_description_index << "\n"
+       << indent << "default sample duration: " << m_default_sample_duration << "\n"
+       << indent << "default sample size: " << m_default_sample_size << "\n"
+       << indent << "default sample flags: 0x" << std::hex << m_default_sample_flags << std::dec << "\n";
+
+  return sstr.str();
+}
+
+
+Error Box_trex::write(StreamWriter& writer) const
+{
+  size_t box_start = reserve_box_header_space(writer);
+
+  writer.write32(m_track_id);
+  writer.write32(m_default_sample_description_index);
+  writer.write32(m_default_sample_duration);
+  writer.write32(m_default_sample_size);
+  writer.write32(m_default_sample_flags);
+
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
+
+
+Error Box_mfhd::parse(BitstreamRange& range, const heif_security_limits* limits)
+{
+  parse_full_box_header(range);
+
+  if (get_version() > 0) {
+    return unsupported_version_error("mfhd");
+  }
+
+  m_sequence_number = range.read32();
+
+  return range.get_error();
+}
+
+
+std::string Box_mfhd::dump(Indent& indent) const
+{
+  std::ostringstream sstr;
+  sstr << FullBox::dump(indent);
+  sstr << indent << "sequence number: " << m_sequence_number << "\n";
+
+  return sstr.str();
+}
+
+
+Error Box_mfhd::write(StreamWriter& writer) const
+{
+  size_t box_start = reserve_box_header_space(writer);
+
+  writer.write32(m_sequence_number);
+
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
+
+
+Error Box_tfhd::parse(BitstreamRange& range, const heif_security_limits* limits)
+{
+  parse_full_box_header(range);
+
+  if (get_version() > 0) {
+    return unsupported_version_error("tfhd");
+  }
+
+  m_track_id = range.read32();
+
+  if (has_base_data_offset()) {
+    m_base_data_offset = range.read64();
+  }
+
+  if (has_sample_description_index()) {
+    m_sample_description_index = range.read32();
+  }
+
+  if (has_default_sample_duration()) {
+    m_default_sample_duration = range.read32();
+  }
+
+  if (has_default_sample_size()) {
+    m_default_sample_size = range.read32();
+  }
+
+  if (has_default_sample_flags()) {
+    m_default_sample_flags = range.read32();
+  }
+
+  return range.get_error();
+}
+
+
+std::string Box_tfhd::dump(Indent& indent) const
+{
+  std::ostringstream sstr;
+  sstr << FullBox::dump(indent);
+  sstr << indent << "track ID: " << m_track_id << "\n";
+
+  if (has_base_data_offset()) {
+    sstr << indent << "base data offset: " << m_base_data_offset << "\n";
+  }
+
+  if (get_flags() & default_base_is_moof) {
+    sstr << indent << "default base is moof\n";
+  }
+
+  if (has_sample_description_index()) {
+    sstr << indent << "sample description index: " << m_sample_description_index << "\n";
+  }
+
+  if (has_default_sample_duration()) {
+    sstr << indent << "default sample duration: " << m_default_sample_duration << "\n";
+  }
+
+  if (has_default_sample_size()) {
+    sstr << indent << "default sample size: " << m_default_sample_size << "\n";
+  }
+
+  if (has_default_sample_flags()) {
+    sstr << indent << "default sample flags: 0x" << std::hex << m_default_sample_flags << std::dec << "\n";
+  }
+
+  return sstr.str();
+}
+
+
+void Box_tfhd::set_sample_description_index(uint32_t idx)
+{
+  m_sample_description_index = idx;
+  set_flags(get_flags() | sample_description_index_present);
+}
+
+
+Error Box_tfhd::write(StreamWriter& writer) const
+{
+  size_t box_start = reserve_box_header_space(writer);
+
+  writer.write32(m_track_id);
+
+  if (has_base_data_offset()) {
+    writer.write64(m_base_data_offset);
+  }
+
+  if (has_sample_description_index()) {
+    writer.write32(m_sample_description_index);
+  }
+
+  if (has_default_sample_duration()) {
+    writer.write32(m_default_sample_duration);
+  }
+
+  if (has_default_sample_size()) {
+    writer.write32(m_default_sample_size);
+  }
+
+  if (has_default_sample_flags()) {
+    writer.write32(m_default_sample_flags);
+  }
+
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
+
+
+Error Box_tfdt::parse(BitstreamRange& range, const heif_security_limits* limits)
+{
+  parse_full_box_header(range);
+
+  if (get_version() > 1) {
+    return unsupported_version_error("tfdt");
+  }
+
+  if (get_version() == 1) {
+    m_base_media_decode_time = range.read64();
+  }
+  else {
+    m_base_media_decode_time = range.read32();
+  }
+
+  return range.get_error();
+}
+
+
+std::string Box_tfdt::dump(Indent& indent) const
+{
+  std::ostringstream sstr;
+  sstr << FullBox::dump(indent);
+  sstr << indent << "base media decode time: " << m_base_media_decode_time << "\n";
+
+  return sstr.str();
+}
+
+
+void Box_tfdt::derive_box_version()
+{
+  set_version(m_base_media_decode_time > 0xFFFFFFFF ? 1 : 0);
+}
+
+
+Error Box_tfdt::write(StreamWriter& writer) const
+{
+  size_t box_start = reserve_box_header_space(writer);
+
+  if (get_version() == 1) {
+    writer.write64(m_base_media_decode_time);
+  }
+  else {
+    writer.write32(static_cast<uint32_t>(m_base_media_decode_time));
+  }
+
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
+
+
+Error Box_trun::parse(BitstreamRange& range, const heif_security_limits* limits)
+{
+  range.buffer_remaining_data();
+
+  parse_full_box_header(range);
+
+  if (get_version() > 1) {
+    return unsupported_version_error("trun");
+  }
+
+  uint32_t sample_count = range.read32();
+
+  if (has_data_offset()) {
+    m_data_offset = range.read32s();
+  }
+
+  if (has_first_sample_flags()) {
+    m_first_sample_flags = range.read32();
+  }
+
+  // check required memory
+
+  uint64_t mem_size = uint64_t(sample_count) * sizeof(Sample);
+  if (limits->max_memory_block_size && mem_size > limits->max_memory_block_size) {
+    std::stringstream sstr;
+    sstr << "Allocating " << mem_size << " bytes for the 'trun' table exceeds the security limit of "
+         << limits->max_memory_block_size << " bytes";
+
+    return {heif_error_Memory_allocation_error,
+            heif_suberror_Security_limit_exceeded,
+            sstr.str()};
+  }
+
+  // Each sample takes up to 16 bytes. This prevents allocating a large table for a truncated box.
+  if (sample_count > range.get_remaining_bytes()) {
+    return {heif_error_Invalid_input,
+            heif_suberror_End_of_data,
+            "'trun' box is shorter than its sample count"};
+  }
+
+  m_samples.resize(sample_count);
+
+  for (uint32_t i = 0; i < sample_count; i++) {
+    Sample& sample = m_samples[i];
+
+    if (get_flags() & sample_duration_present) {
+      sample.duration = range.read32();
+    }
+
+    if (get_flags() & sample_size_present) {
+      sample.size = range.read32();
+    }
+
+    if (get_flags() & sample_flags_present) {
+      sample.flags = range.read32();
+    }
+
+    if (get_flags() & sample_composition_time_offsets_present) {
+      if (get_version() == 0) {
+        uint32_t offset = range.read32();
+        sample.composition_offset = static_cast<int32_t>(std::min(offset, uint32_t(std::numeric_limits<int32_t>::max())));
+      }
+      else {
+        sample.composition_offset = range.read32s();
+      }
+    }
+
+    if (range.error()) {
+      return range.get_error();
+    }
+  }
+
+  return range.get_error();
+}
+
+
+std::string Box_trun::dump(Indent& indent) const
+{
+  std::ostringstream sstr;
+  sstr << FullBox::dump(indent);
+
+  if (has_data_offset()) {
+    sstr << indent << "data offset: " << m_data_offset << "\n";
+  }
+
+  if (has_first_sample_flags()) {
+    sstr << indent << "first sample flags: 0x" << std::hex << m_first_sample_flags << std::dec << "\n";
+  }
+
+  for (size_t i = 0; i < m_samples.size(); i++) {
+    sstr << indent << "[" << i << "] :";
+
+    if (get_flags() & sample_duration_present) {
+      sstr << " duration=" << m_samples[i].duration;
+    }
+
+    if (get_flags() & sample_size_present) {
+      sstr << " size=" << m_samples[i].size;
+    }
+
+    if (get_flags() & sample_flags_present) {
+      sstr << " flags=0x" << std::hex << m_samples[i].flags << std::dec;
+    }
+
+    if (get_flags() & sample_composition_time_offsets_present) {
+      sstr << " composition offset=" << m_samples[i].composition_offset;
+    }
+
+    sstr << "\n";
+  }
+
+  return sstr.str();
+}
+
+
+void Box_trun::add_sample(const Sample& sample)
+{
+  set_flags(get_flags() | sample_duration_present | sample_size_present | sample_flags_present);
+
+  if (sample.composition_offset != 0) {
+    set_flags(get_flags() | sample_composition_time_offsets_present);
+  }
+
+  m_samples.push_back(sample);
+}
+
+
+void Box_trun::set_data_offset(int32_t offset)
+{
+  m_data_offset = offset;
+  set_flags(get_flags() | data_offset_present);
+}
+
+
+void Box_trun::derive_box_version()
+{
+  bool negative_offsets = false;
+  for (const auto& sample : m_samples) {
+    if (sample.composition_offset < 0) {
+      negative_offsets = true;
+    }
+  }
+
+  set_version(negative_offsets ? 1 : 0);
+}
+
+
+Error Box_trun::write(StreamWriter& writer) const
+{
+  size_t box_start = reserve_box_header_space(writer);
+
+  writer.write32(static_cast<uint32_t>(m_samples.size()));
+
+  if (has_data_offset()) {
+    m_data_offset_pos = writer.get_position();
+    writer.write32s(m_data_offset);
+  }
+
+  if (has_first_sample_flags()) {
+    writer.write32(m_first_sample_flags);
+  }
+
+  for (const auto& sample : m_samples) {
+    if (get_flags() & sample_duration_present) {
+      writer.write32(sample.duration);
+    }
+
+    if (get_flags() & sample_size_present) {
+      writer.write32(sample.size);
+    }
+
+    if (get_flags() & sample_flags_present) {
+      writer.write32(sample.flags);
+    }
+
+    if (get_flags() & sample_composition_time_offsets_present) {
+      writer.write32s(sample.composition_offset);
+    }
+  }
+
+  prepend_header(writer, box_start);
+
+  return Error::Ok;
+}
+
+
+void Box_trun::patch_file_pointers(StreamWriter& writer, size_t offset)
+{
+  if (!has_data_offset()) {
+    return;
+  }
+
+  size_t oldPosition = writer.get_position();
+
+  writer.set_position(m_data_offset_pos);
+  writer.write32s(static_cast<int32_t>(m_data_offset + offset));
+
+  writer.set_position(oldPosition);
+}
@@ -333,17 +333,74 @@ public:
     uint32_t sample_delta;
   };
 
-  uint32_t get_sample_duration(uint32_t sample_idx);
+  uint32_t get_sample_duration(uint32_t sample_idx) const;
+
+  // Sum of the durations of all samples before 'sample_idx' (in media timescale units).
+  uint64_t get_sample_decoding_time(uint32_t sample_idx) const;
+
+  // Returns the index of the sample that is displayed at 'time' (in media timescale units).
+  // If 'time' is after the end of the last sample, the total number of samples is returned.
+  uint32_t get_sample_at_time(uint64_t time) const;
 
   void append_sample_duration(uint32_t duration);
 
-  uint64_t get_total_duration(bool include_last_frame_duration);
+  uint64_t get_total_duration(bool include_last_frame_duration) const;
 
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
 
 private:
   std::vector<TimeToSample> m_entries;
+
+  // For each entry, the index of its first sample and its start time.
+  // With this, samples and times can be looked up with a binary search over the run-length entries.
+  struct EntryStart {
+    uint32_t first_sample;
+    uint64_t start_time;
+  };
+
+  std::vector<EntryStart> m_entry_starts;
+
+  void add_entry(const TimeToSample& entry);
+};
+
+
+// Composition Time to Sample Box
+class Box_ctts : public FullBox {
+public:
+  Box_ctts()
+  {
+    set_short_type(fourcc("ctts"));
+  }
+
+  std::string dump(Indent&) const override;
+
+  const char* debug_box_name() const override { return "Composition Time to Sample"; }
+
+  Error write(StreamWriter& writer) const override;
+
+  void derive_box_version() override;
+
+  struct OffsetToSample {
+    uint32_t sample_count;
+    int32_t sample_offset;
+  };
+
+  // Returns 0 for samples that are not covered by the table.
+  int32_t get_sample_offset(uint32_t sample_idx) const;
+
+  void append_sample_offset(int32_t offset);
+
+  uint32_t get_number_of_samples() const;
+
+protected:
+  Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  std::vector<OffsetToSample> m_entries;
+
+  // index of the first sample of each entry, for a binary search of the sample offsets
+  std::vector<uint32_t> m_entry_first_samples;
 };
 
 
@@ -372,6 +429,8 @@ public:
   // idx counting starts at 1
   const SampleToChunk* get_chunk(uint32_t idx) const;
 
+  // Starts a new chunk. The entry of the previous chunk is merged into the run before it
+  // when both have the same number of samples and sample description.
   void add_chunk(uint32_t description_index);
 
   void increase_samples_in_chunk(uint32_t nFrames);
@@ -387,10 +446,12 @@ protected:
 
 private:
   std::vector<SampleToChunk> m_entries;
+  uint32_t m_number_of_chunks = 0; // when writing
 };
 
 
 // Chunk Offset Box
+// This class handles both, 'stco' and 'co64'. When writing, 'co64' is used if the offsets may exceed 32 bits.
 class Box_stco : public FullBox {
 public:
   Box_stco()
@@ -400,13 +461,15 @@ public:
 
   std::string dump(Indent&) const override;
 
-  const char* debug_box_name() const override { return "Sample Offset"; }
+  const char* debug_box_name() const override { return get_short_type() == fourcc("co64") ? "Chunk Large Offset" : "Sample Offset"; }
 
   Error write(StreamWriter& writer) const override;
 
-  void add_chunk_offset(uint32_t offset) { m_offsets.push_back(offset); }
+  void derive_box_version() override;
+
+  void add_chunk_offset(uint64_t offset) { m_offsets.push_back(offset); }
 
-  const std::vector<uint32_t>& get_offsets() const { return m_offsets; }
+  const std::vector<uint64_t>& get_offsets() const { return m_offsets; }
 
   void patch_file_pointers(StreamWriter&, size_t offset) override;
 
@@ -414,13 +477,14 @@ protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
 
 private:
-  std::vector<uint32_t> m_offsets;
+  std::vector<uint64_t> m_offsets;
 
   mutable size_t m_offset_start_pos = 0;
 };
 
 
 // Sample Size Box
+// This class handles both, 'stsz' and the compact 'stz2'. When writing, 'stz2' is used if all sample sizes fit into 16 bits.
 class Box_stsz : public FullBox {
 public:
   Box_stsz()
@@ -430,15 +494,23 @@ public:
 
   std::string dump(Indent&) const override;
 
-  const char* debug_box_name() const override { return "Sample Size"; }
+  const char* debug_box_name() const override { return m_compact_field_size ? "Compact Sample Size" : "Sample Size"; }
 
   Error write(StreamWriter& writer) const override;
 
+  void derive_box_version() override;
+
   bool has_fixed_sample_size() const { return m_fixed_sample_size != 0; }
 
   uint32_t get_fixed_sample_size() const { return m_fixed_sample_size; }
 
-  const std::vector<uint32_t>& get_sample_sizes() const { return m_sample_sizes; }
+  uint32_t get_sample_count() const { return m_sample_count; }
+
+  // Returns 0 for samples that are not covered by the table.
+  uint32_t get_sample_size(uint32_t sample_idx) const;
+
+  // Sum of the sizes of all samples before 'sample_idx'.
+  uint64_t get_sample_sizes_sum(uint32_t sample_idx) const;
 
   void append_sample_size(uint32_t size);
 
@@ -449,6 +521,18 @@ private:
   uint32_t m_fixed_sample_size = 0;
   uint32_t m_sample_count = 0;
   std::vector<uint32_t> m_sample_sizes;
+  uint32_t m_max_sample_size = 0;
+
+  // 4, 8 or 16 when the box is a 'stz2', 0 for 'stsz'
+  uint8_t m_compact_field_size = 0;
+
+  // The sum of the sample sizes before every 'sizes_sum_index_step'th sample.
+  // Sample offsets are computed from this with at most 'sizes_sum_index_step'-1 additions.
+  static constexpr uint32_t sizes_sum_index_step = 64;
+  std::vector<uint64_t> m_sizes_sum_index;
+  uint64_t m_sizes_sum = 0;
+
+  void add_variable_sample_size(uint32_t size);
 };
 
 
@@ -468,6 +552,9 @@ public:
 
   void add_sync_sample(uint32_t sample_idx) { m_sync_samples.push_back(sample_idx); }
 
+  // Note: sample numbers in 'stss' start at 1.
+  const std::vector<uint32_t>& get_sync_samples() const { return m_sync_samples; }
+
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
 
@@ -512,7 +599,7 @@ private:
 struct VisualSampleEntry {
   // from SampleEntry
   //const unsigned int(8)[6] reserved = 0;
-  uint16_t data_reference_index;
+  uint16_t data_reference_index = 1;
 
   // VisualSampleEntry
 
@@ -581,7 +668,7 @@ protected:
 private:
   // from SampleEntry
   //const unsigned int(8)[6] reserved = 0;
-  uint16_t data_reference_index;
+  uint16_t data_reference_index = 1;
 };
 
 
@@ -626,6 +713,19 @@ public:
 
   Error write(StreamWriter& writer) const override;
 
+  uint32_t get_grouping_type() const { return m_grouping_type; }
+
+  std::optional<uint32_t> get_grouping_type_parameter() const { return m_grouping_type_parameter; }
+
+  // Number of samples described by the table.
+  uint64_t get_number_of_mapped_samples() const { return m_first_sample_of_entry.empty() ? 0 : m_first_sample_of_entry.back(); }
+
+  // Writes the group description indices of 'count' samples, starting at 'first_sample', into 'out_indices'.
+  // Samples after the end of the table get 'unmapped_index'.
+  // Finding the first sample takes O(log n) in the number of table entries.
+  void get_group_description_indices(uint32_t first_sample, uint32_t count, uint32_t unmapped_index,
+                                     uint32_t* out_indices) const;
+
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
 
@@ -639,6 +739,9 @@ private:
   };
 
   std::vector<Entry> m_entries;
+
+  // Index of the first sample of each entry, followed by the total number of samples.
+  std::vector<uint64_t> m_first_sample_of_entry;
 };
 
 
@@ -686,17 +789,29 @@ public:
 
   Error write(StreamWriter& writer) const override;
 
+  uint32_t get_grouping_type() const { return m_grouping_type; }
+
+  // Group of the samples that are not mapped by the 'sbgp' box. 0 if they are in no group.
+  uint32_t get_default_group_description_index() const { return m_default_group_description_index.value_or(0); }
+
+  uint32_t get_number_of_entries() const { return static_cast<uint32_t>(m_entries.size()); }
+
+  // The payload of the description 'index' (counting starts at 1). Returns NULL if there is no such description.
+  // The payload is only available when its length is known, i.e. for version >= 1 or for known grouping types.
+  const std::vector<uint8_t>* get_entry_data(uint32_t index) const;
+
 protected:
   Error parse(BitstreamRange& range, const heif_security_limits*) override;
 
 private:
   uint32_t m_grouping_type = 0; // 4cc
-  std::optional<uint32_t> m_default_length; // version 1  (0 -> variable length)
-  std::optional<uint32_t> m_default_sample_description_index;; // version >= 2
+  std::optional<uint32_t> m_default_length; // version >= 1  (0 -> variable length)
+  std::optional<uint32_t> m_default_group_description_index; // version >= 2
 
   struct Entry {
-    uint32_t description_length = 0; // if version==1 && m_default_length == 0
+    uint32_t description_length = 0; // if version>=1 && m_default_length == 0
     std::shared_ptr<SampleGroupEntry> sample_group_entry;
+    std::vector<uint8_t> data;
   };
 
   std::vector<Entry> m_entries;
@@ -848,4 +963,260 @@ private:
 };
 
 
+// --- movie fragments
+
+// Movie Extends Box
+class Box_mvex : public Box_container {
+public:
+  Box_mvex() : Box_container("mvex") {}
+
+  const char* debug_box_name() const override { return "Movie Extends"; }
+};
+
+
+// Track Extends Box
+class Box_trex : public FullBox {
+public:
+  Box_trex()
+  {
+    set_short_type(fourcc("trex"));
+  }
+
+  std::string dump(Indent&) const override;
+
+  const char* debug_box_name() const override { return "Track Extends"; }
+
+  Error write(StreamWriter& writer) const override;
+
+  uint32_t get_track_id() const { return m_track_id; }
+
+  void set_track_id(uint32_t id) { m_track_id = id; }
+
+  uint32_t get_default_sample_description_index() const { return m_default_sample_description_index; }
+
+  uint32_t get_default_sample_duration() const { return m_default_sample_duration; }
+
+  uint32_t get_default_sample_size() const { return m_default_sample_size; }
+
+  uint32_t get_default_sample_flags() const { return m_default_sample_flags; }
+
+protected:
+  Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  uint32_t m_track_id = 0;
+  uint32_t m_default_sample_description_index = 1;
+  uint32_t m_default_sample_duration = 0;
+  uint32_t m_default_sample_size = 0;
+  uint32_t m_default_sample_flags = 0;
+};
+
+
+// Movie Fragment Box
+class Box_moof : public Box_container {
+public:
+  Box_moof() : Box_container("moof") {}
+
+  const char* debug_box_name() const override { return "Movie Fragment"; }
+};
+
+
+// Movie Fragment Header Box
+class Box_mfhd : public FullBox {
+public:
+  Box_mfhd()
+  {
+    set_short_type(fourcc("mfhd"));
+  }
+
+  std::string dump(Indent&) const override;
+
+  const char* debug_box_name() const override { return "Movie Fragment Header"; }
+
+  Error write(StreamWriter& writer) const override;
+
+  uint32_t get_sequence_number() const { return m_sequence_number; }
+
+  void set_sequence_number(uint32_t n) { m_sequence_number = n; }
+
+protected:
+  Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  uint32_t m_sequence_number = 0;
+};
+
+
+// Track Fragment Box
+class Box_traf : public Box_container {
+public:
+  Box_traf() : Box_container("traf") {}
+
+  const char* debug_box_name() const override { return "Track Fragment"; }
+};
+
+
+// Track Fragment Header Box
+class Box_tfhd : public FullBox {
+public:
+  Box_tfhd()
+  {
+    set_short_type(fourcc("tfhd"));
+  }
+
+  enum Flags : uint32_t {
+    base_data_offset_present = 0x000001,
+    sample_description_index_present = 0x000002,
+    default_sample_duration_present = 0x000008,
+    default_sample_size_present = 0x000010,
+    default_sample_flags_present = 0x000020,
+    duration_is_empty = 0x010000,
+    default_base_is_moof = 0x020000
+  };
+
+  std::string dump(Indent&) const override;
+
+  const char* debug_box_name() const override { return "Track Fragment Header"; }
+
+  Error write(StreamWriter& writer) const override;
+
+  uint32_t get_track_id() const { return m_track_id; }
+
+  void set_track_id(uint32_t id) { m_track_id = id; }
+
+  bool has_base_data_offset() const { return get_flags() & base_data_offset_present; }
+
+  uint64_t get_base_data_offset() const { return m_base_data_offset; }
+
+  bool has_sample_description_index() const { return get_flags() & sample_description_index_present; }
+
+  uint32_t get_sample_description_index() const { return m_sample_description_index; }
+
+  void set_sample_description_index(uint32_t idx);
+
+  bool has_default_sample_duration() const { return get_flags() & default_sample_duration_present; }
+
+  uint32_t get_default_sample_duration() const { return m_default_sample_duration; }
+
+  bool has_default_sample_size() const { return get_flags() & default_sample_size_present; }
+
+  uint32_t get_default_sample_size() const { return m_default_sample_size; }
+
+  bool has_default_sample_flags() const { return get_flags() & default_sample_flags_present; }
+
+  uint32_t get_default_sample_flags() const { return m_default_sample_flags; }
+
+protected:
+  Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  uint32_t m_track_id = 0;
+  uint64_t m_base_data_offset = 0;
+  uint32_t m_sample_description_index = 0;
+  uint32_t m_default_sample_duration = 0;
+  uint32_t m_default_sample_size = 0;
+  uint32_t m_default_sample_flags = 0;
+};
+
+
+// Track Fragment Base Media Decode Time Box
+class Box_tfdt : public FullBox {
+public:
+  Box_tfdt()
+  {
+    set_short_type(fourcc("tfdt"));
+  }
+
+  std::string dump(Indent&) const override;
+
+  const char* debug_box_name() const override { return "Track Fragment Decode Time"; }
+
+  Error write(StreamWriter& writer) const override;
+
+  void derive_box_version() override;
+
+  uint64_t get_base_media_decode_time() const { return m_base_media_decode_time; }
+
+  void set_base_media_decode_time(uint64_t t) { m_base_media_decode_time = t; }
+
+protected:
+  Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  uint64_t m_base_media_decode_time = 0;
+};
+
+
+// Track Fragment Run Box
+class Box_trun : public FullBox {
+public:
+  Box_trun()
+  {
+    set_short_type(fourcc("trun"));
+  }
+
+  enum Flags : uint32_t {
+    data_offset_present = 0x000001,
+    first_sample_flags_present = 0x000004,
+    sample_duration_present = 0x000100,
+    sample_size_present = 0x000200,
+    sample_flags_present = 0x000400,
+    sample_composition_time_offsets_present = 0x000800
+  };
+
+  // The fields that are not present in the box are taken from the defaults in 'tfhd' and 'trex'.
+  struct Sample {
+    uint32_t duration = 0;
+    uint32_t size = 0;
+    uint32_t flags = 0;
+    int32_t composition_offset = 0;
+  };
+
+  std::string dump(Indent&) const override;
+
+  const char* debug_box_name() const override { return "Track Fragment Run"; }
+
+  Error write(StreamWriter& writer) const override;
+
+  void derive_box_version() override;
+
+  // Written boxes always contain the duration, size and flags of each sample.
+  void add_sample(const Sample& sample);
+
+  const std::vector<Sample>& get_samples() const { return m_samples; }
+
+  uint32_t get_num_samples() const { return static_cast<uint32_t>(m_samples.size()); }
+
+  bool has_data_offset() const { return get_flags() & data_offset_present; }
+
+  // Offset of the first sample relative to the base data offset of the track fragment.
+  // When writing, the offset is relative to the 'mdat' payload and patch_file_pointers() adds the position of the payload.
+  int32_t get_data_offset() const { return m_data_offset; }
+
+  void set_data_offset(int32_t offset);
+
+  bool has_first_sample_flags() const { return get_flags() & first_sample_flags_present; }
+
+  uint32_t get_first_sample_flags() const { return m_first_sample_flags; }
+
+  void patch_file_pointers(StreamWriter&, size_t offset) override;
+
+protected:
+  Error parse(BitstreamRange& range, const heif_security_limits*) override;
+
+private:
+  int32_t m_data_offset = 0;
+  uint32_t m_first_sample_flags = 0;
+  std::vector<Sample> m_samples;
+
+  mutable size_t m_data_offset_pos = 0;
+};
+
+
+// Bits of the sample flags in 'trex', 'tfhd' and 'trun'.
+constexpr uint32_t sample_flags_is_non_sync_sample = 0x00010000;
+constexpr uint32_t sample_flags_depends_on_others = 0x01000000;
+constexpr uint32_t sample_flags_depends_on_no_others = 0x02000000;
+
+
 #endif //SEQ_BOXES_H
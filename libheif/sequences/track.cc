@@ -27,6 +27,7 @@
 #include "sequences/track_metadata.h"
 #include "libheif/api_structs.h"
 #include <limits>
+#include <algorithm>
 
 
 void heif_track_info_copy(heif_track_info* dst, const heif_track_info* src)
@@ -53,13 +54,24 @@ void heif_track_info_copy(heif_track_info* dst, const heif_track_info* src)
       dst->gimi_track_content_id = nullptr;
     }
   }
+
+  if (src->version >= 2 && dst->version >= 2) {
+    dst->gop_structure = src->gop_structure;
+    dst->keyframe_distance_min = src->keyframe_distance_min;
+    dst->keyframe_distance_max = src->keyframe_distance_max;
+  }
+
+  if (src->version >= 3 && dst->version >= 3) {
+    dst->max_chunk_size = src->max_chunk_size;
+    dst->max_chunk_duration = src->max_chunk_duration;
+  }
 }
 
 
 heif_track_info* heif_track_info_alloc()
 {
   auto* info = new heif_track_info;
-  info->version = 1;
+  info->version = 3;
 
   info->track_timescale = 90000;
   info->write_aux_info_interleaved = false;
@@ -69,6 +81,13 @@ heif_track_info* heif_track_info_alloc()
   info->with_gimi_track_content_id = false;
   info->gimi_track_content_id = nullptr;
 
+  info->gop_structure = heif_sequence_gop_structure_intra_only;
+  info->keyframe_distance_min = 0;
+  info->keyframe_distance_max = 0;
+
+  info->max_chunk_size = 64 * 1024;
+  info->max_chunk_duration = 0;
+
   return info;
 }
 
@@ -119,45 +138,126 @@ void SampleAuxInfoHelper::add_nonpresent_sample()
 }
 
 
-void SampleAuxInfoHelper::write_interleaved(const std::shared_ptr<class HeifFile>& file)
+Error SampleAuxInfoHelper::write_interleaved(const std::shared_ptr<class HeifFile>& file)
 {
   if (m_interleaved && !m_data.empty()) {
-    uint64_t pos = file->append_mdat_data(m_data);
-    m_saio->add_sample_offset(pos);
+    Result<uint64_t> posResult = file->append_mdat_data(m_data);
+    if (!posResult) {
+      return posResult.error;
+    }
+
+    m_saio->add_sample_offset(*posResult);
 
     m_data.clear();
   }
+
+  return Error::Ok;
 }
 
-void SampleAuxInfoHelper::write_all(const std::shared_ptr<class Box>& parent, const std::shared_ptr<class HeifFile>& file)
+Error SampleAuxInfoHelper::write_all(const std::shared_ptr<class Box>& parent, const std::shared_ptr<class HeifFile>& file)
 {
   parent->append_child_box(m_saiz);
   parent->append_child_box(m_saio);
 
   if (!m_data.empty()) {
-    uint64_t pos = file->append_mdat_data(m_data);
-    m_saio->add_sample_offset(pos);
+    Result<uint64_t> posResult = file->append_mdat_data(m_data);
+    if (!posResult) {
+      return posResult.error;
+    }
+
+    m_saio->add_sample_offset(*posResult);
   }
+
+  return Error::Ok;
+}
+
+
+void SampleAuxInfoHelper::write_fragment(const std::shared_ptr<class Box>& traf, std::vector<uint8_t>& mdat_data)
+{
+  traf->append_child_box(m_saiz);
+  traf->append_child_box(m_saio);
+
+  // relative to the 'mdat' payload, moved to the fragment base by HeifFile::write_fragment()
+  m_saio->add_sample_offset(mdat_data.size());
+  mdat_data.insert(mdat_data.end(), m_data.begin(), m_data.end());
+
+  uint32_t aux_info_type = m_saiz->get_aux_info_type();
+  uint32_t aux_info_type_parameter = m_saiz->get_aux_info_type_parameter();
+
+  m_saiz = std::make_shared<Box_saiz>();
+  m_saio = std::make_shared<Box_saio>();
+  set_aux_info_type(aux_info_type, aux_info_type_parameter);
+
+  m_data.clear();
 }
 
 
 SampleAuxInfoReader::SampleAuxInfoReader(std::shared_ptr<Box_saiz> saiz,
-                                         std::shared_ptr<Box_saio> saio)
+                                         std::shared_ptr<Box_saio> saio,
+                                         const std::vector<uint32_t>& samples_per_chunk)
+{
+  m_aux_info_type = saiz->get_aux_info_type();
+  m_aux_info_type_parameter = saiz->get_aux_info_type_parameter();
+
+  auto nSamples = saiz->get_num_samples();
+  auto nOffsets = saio->get_num_samples();
+
+  if (nOffsets == 1 || nOffsets == nSamples || nOffsets != samples_per_chunk.size()) {
+    add_fragment(saiz, saio, 0, 0);
+    return;
+  }
+
+  // One offset for each chunk. The information of the samples in a chunk is stored contiguously.
+
+  uint32_t sample_idx = 0;
+  for (uint32_t chunk_idx = 0; chunk_idx < nOffsets; chunk_idx++) {
+    uint64_t offset = saio->get_sample_offset(chunk_idx);
+
+    for (uint32_t i = 0; i < samples_per_chunk[chunk_idx] && sample_idx < nSamples; i++, sample_idx++) {
+      SampleInfoRange range;
+      range.size = saiz->get_sample_size(sample_idx);
+      range.offset = offset;
+      offset += range.size;
+
+      m_samples.push_back(range);
+    }
+  }
+}
+
+
+SampleAuxInfoReader::SampleAuxInfoReader(uint32_t aux_info_type, uint32_t aux_info_type_parameter)
+    : m_aux_info_type(aux_info_type),
+      m_aux_info_type_parameter(aux_info_type_parameter)
 {
-  m_saiz = saiz;
-  m_saio = saio;
+}
+
+
+void SampleAuxInfoReader::add_fragment(const std::shared_ptr<Box_saiz>& saiz, const std::shared_ptr<Box_saio>& saio,
+                                       uint64_t base_offset, uint32_t first_sample)
+{
+  // samples of preceding fragments without this information
+  if (m_samples.size() < first_sample) {
+    m_samples.resize(first_sample);
+  }
+
+  auto nSamples = saiz->get_num_samples();
+
+  bool contiguous = (saio->get_num_samples() == 1);
+  uint64_t offset = base_offset + saio->get_sample_offset(0);
 
-  m_contiguous = (saio->get_num_samples() == 1);
-  if (m_contiguous) {
-    uint64_t offset = saio->get_sample_offset(0);
-    auto nSamples = saiz->get_num_samples();
+  for (uint32_t i = 0; i < nSamples; i++) {
+    SampleInfoRange range;
+    range.size = saiz->get_sample_size(i);
 
-    for (uint32_t i=0;i<nSamples;i++) {
-      m_contiguous_offsets.push_back(offset);
-      offset += saiz->get_sample_size(i);
+    if (contiguous) {
+      range.offset = offset;
+      offset += range.size;
+    }
+    else {
+      range.offset = base_offset + saio->get_sample_offset(i);
     }
 
-    // TODO: we could add a special case for contiguous data with constant size
+    m_samples.push_back(range);
   }
 }
 
@@ -165,26 +265,22 @@ SampleAuxInfoReader::SampleAuxInfoReader(std::shared_ptr<Box_saiz> saiz,
 heif_sample_aux_info_type SampleAuxInfoReader::get_type() const
 {
   heif_sample_aux_info_type type;
-  type.type = m_saiz->get_aux_info_type();
-  type.parameter = m_saiz->get_aux_info_type_parameter();
+  type.type = m_aux_info_type;
+  type.parameter = m_aux_info_type_parameter;
   return type;
 }
 
 
 Result<std::vector<uint8_t>> SampleAuxInfoReader::get_sample_info(const HeifFile* file, uint32_t idx)
 {
-  uint64_t offset;
-  if (m_contiguous) {
-    offset = m_contiguous_offsets[idx];
-  }
-  else {
-    offset = m_saio->get_sample_offset(idx);
-  }
+  std::vector<uint8_t> data;
 
-  uint8_t size = m_saiz->get_sample_size(idx);
+  FileRange range = get_sample_range(idx);
+  if (range.size == 0) {
+    return data;
+  }
 
-  std::vector<uint8_t> data;
-  Error err = file->append_data_from_file_range(data, offset, size);
+  Error err = file->append_data_from_file_range(data, range.offset, range.size);
   if (err) {
     return err;
   }
@@ -193,6 +289,54 @@ Result<std::vector<uint8_t>> SampleAuxInfoReader::get_sample_info(const HeifFile
 }
 
 
+FileRange SampleAuxInfoReader::get_sample_range(uint32_t idx) const
+{
+  FileRange range;
+
+  if (idx < m_samples.size()) {
+    range.offset = m_samples[idx].offset;
+    range.size = m_samples[idx].size;
+  }
+
+  return range;
+}
+
+
+Error SampleAuxInfoReader::read_sample_infos(const HeifFile* file, uint32_t first_sample, uint32_t count,
+                                             std::vector<uint8_t>& out_data) const
+{
+  uint64_t run_offset = 0;
+  uint64_t run_size = 0;
+
+  for (uint32_t i = 0; i <= count; i++) {
+    FileRange range;
+    if (i < count) {
+      range = get_sample_range(first_sample + i);
+      if (range.size == 0) {
+        continue;
+      }
+
+      if (run_size > 0 && range.offset == run_offset + run_size &&
+          run_size + range.size <= std::numeric_limits<uint32_t>::max()) {
+        run_size += range.size;
+        continue;
+      }
+    }
+
+    if (run_size > 0) {
+      if (Error err = file->append_data_from_file_range(out_data, run_offset, static_cast<uint32_t>(run_size))) {
+        return err;
+      }
+    }
+
+    run_offset = range.offset;
+    run_size = range.size;
+  }
+
+  return Error::Ok;
+}
+
+
 std::shared_ptr<class HeifFile> Track::get_file() const
 {
   return m_heif_context->get_heif_file();
@@ -262,8 +406,10 @@ Track::Track(HeifContext* ctx, const std::shared_ptr<Box_trak>& trak_box)
   }
 
   m_stts = stbl->get_child_box<Box_stts>();
+  m_stss = stbl->get_child_box<Box_stss>(); // optional: when missing, all samples are sync samples
+  m_ctts = stbl->get_child_box<Box_ctts>(); // optional: when missing, the samples are in presentation order
 
-  const std::vector<uint32_t>& chunk_offsets = m_stco->get_offsets();
+  const std::vector<uint64_t>& chunk_offsets = m_stco->get_offsets();
   assert(chunk_offsets.size() <= (size_t) std::numeric_limits<uint32_t>::max()); // There cannot be more than uint32_t chunks.
 
   uint32_t current_sample_idx = 0;
@@ -303,6 +449,11 @@ Track::Track(HeifContext* ctx, const std::shared_ptr<Box_trak>& trak_box)
   std::vector<std::shared_ptr<Box_saiz>> saiz_boxes = stbl->get_child_boxes<Box_saiz>();
   std::vector<std::shared_ptr<Box_saio>> saio_boxes = stbl->get_child_boxes<Box_saio>();
 
+  std::vector<uint32_t> samples_per_chunk;
+  for (const auto& chunk : m_chunks) {
+    samples_per_chunk.push_back(chunk->last_sample_number() - chunk->first_sample_number() + 1);
+  }
+
   for (const auto& saiz : saiz_boxes) {
     uint32_t aux_info_type = saiz->get_aux_info_type();
     uint32_t aux_info_type_parameter = saiz->get_aux_info_type_parameter();
@@ -320,15 +471,37 @@ Track::Track(HeifContext* ctx, const std::shared_ptr<Box_trak>& trak_box)
 
     if (saio) {
       if (aux_info_type == fourcc("suid")) {
-        m_aux_reader_content_ids = std::make_unique<SampleAuxInfoReader>(saiz, saio);
+        m_aux_reader_content_ids = std::make_unique<SampleAuxInfoReader>(saiz, saio, samples_per_chunk);
       }
 
       if (aux_info_type == fourcc("stai")) {
-        m_aux_reader_tai_timestamps = std::make_unique<SampleAuxInfoReader>(saiz, saio);
+        m_aux_reader_tai_timestamps = std::make_unique<SampleAuxInfoReader>(saiz, saio, samples_per_chunk);
       }
     }
   }
 
+  // --- read sample groups
+
+  for (const auto& sbgp : stbl->get_child_boxes<Box_sbgp>()) {
+    // only the first grouping of each type is used
+    if (!find_sample_grouping(sbgp->get_grouping_type())) {
+      m_sample_groupings.push_back({sbgp->get_grouping_type(), sbgp, nullptr});
+    }
+  }
+
+  for (const auto& sgpd : stbl->get_child_boxes<Box_sgpd>()) {
+    auto grouping = std::find_if(m_sample_groupings.begin(), m_sample_groupings.end(),
+                                 [&sgpd](const SampleGrouping& g) { return g.grouping_type == sgpd->get_grouping_type(); });
+    if (grouping == m_sample_groupings.end()) {
+      m_sample_groupings.push_back({sgpd->get_grouping_type(), nullptr, sgpd});
+    }
+    else if (!grouping->sgpd) {
+      grouping->sgpd = sgpd;
+    }
+  }
+
+  read_movie_fragments();
+
   // --- read track properties
 
   m_track_info = heif_track_info_alloc();
@@ -437,8 +610,11 @@ Track::Track(HeifContext* ctx, uint32_t track_id, heif_track_info* info, uint32_
   m_stco = std::make_shared<Box_stco>();
   m_stbl->append_child_box(m_stco);
 
-  m_stss = std::make_shared<Box_stss>();
-  m_stbl->append_child_box(m_stss);
+  // The sync samples of a fragmented file are marked in the fragments.
+  if (!is_writing_fragments()) {
+    m_stss = std::make_shared<Box_stss>();
+    m_stbl->append_child_box(m_stss);
+  }
 
   if (info) {
     m_track_info = heif_track_info_alloc();
@@ -555,13 +731,32 @@ bool Track::end_of_sequence_reached() const
 }
 
 
-void Track::finalize_track()
+Error Track::finalize_track()
 {
-  if (m_aux_helper_tai_timestamps) m_aux_helper_tai_timestamps->write_all(m_stbl, get_file());
-  if (m_aux_helper_content_ids) m_aux_helper_content_ids->write_all(m_stbl, get_file());
+  if (is_writing_fragments()) {
+    return flush_fragment();
+  }
+
+  if (Error err = flush_pending_chunk()) {
+    return err;
+  }
+
+  if (m_aux_helper_tai_timestamps) {
+    if (Error err = m_aux_helper_tai_timestamps->write_all(m_stbl, get_file())) {
+      return err;
+    }
+  }
+
+  if (m_aux_helper_content_ids) {
+    if (Error err = m_aux_helper_content_ids->write_all(m_stbl, get_file())) {
+      return err;
+    }
+  }
 
   uint64_t duration = m_stts->get_total_duration(false);
   m_mdhd->set_duration(duration);
+
+  return Error::Ok;
 }
 
 
@@ -588,12 +783,28 @@ void Track::add_chunk(heif_compression_format format)
   auto chunk = std::make_shared<Chunk>(m_heif_context, m_id, format);
   m_chunks.push_back(chunk);
 
-  int chunkIdx = (uint32_t) m_chunks.size();
-  m_stsc->add_chunk(chunkIdx);
+  // The samples of fragmented files are not listed in the sample tables.
+  if (!is_writing_fragments()) {
+    int chunkIdx = (uint32_t) m_chunks.size();
+    m_stsc->add_chunk(chunkIdx);
+  }
 }
 
-void Track::set_sample_description_box(std::shared_ptr<Box> sample_description_box)
+Error Track::set_sample_description_box(std::shared_ptr<Box> sample_description_box)
 {
+  if (is_writing_fragments()) {
+    // The pending samples refer to the previous sample description.
+    if (Error err = flush_fragment()) {
+      return err;
+    }
+
+    if (get_file()->is_fragmented_file_start_written()) {
+      return {heif_error_Usage_error,
+              heif_suberror_Unspecified,
+              "The sample description of a track cannot change after the first fragment has been written"};
+    }
+  }
+
   // --- add 'taic' when we store timestamps as sample auxiliary information
 
   if (m_track_info->with_tai_timestamps != heif_sample_aux_info_presence_none) {
@@ -603,24 +814,71 @@ void Track::set_sample_description_box(std::shared_ptr<Box> sample_description_b
   }
 
   m_stsd->add_sample_entry(sample_description_box);
+
+  return Error::Ok;
 }
 
 
 Error Track::write_sample_data(const std::vector<uint8_t>& raw_data, uint32_t sample_duration, bool is_sync_sample,
-                               const heif_tai_timestamp_packet* tai, const std::string& gimi_contentID)
+                               const heif_tai_timestamp_packet* tai, const std::string& gimi_contentID,
+                               int32_t composition_offset)
 {
-  size_t data_start = m_heif_context->get_heif_file()->append_mdat_data(raw_data);
+  if (is_writing_fragments()) {
+    if (Error err = write_sample_data_to_fragment(raw_data, sample_duration, is_sync_sample, composition_offset)) {
+      return err;
+    }
+
+    if (Error err = add_sample_aux_info(tai, gimi_contentID)) {
+      return err;
+    }
+
+    m_next_sample_to_be_processed++;
+
+    return Error::Ok;
+  }
+
+  bool batch_samples = (m_batch_samples_into_chunks && m_track_info && m_track_info->max_chunk_size != 0);
 
-  // first sample in chunk? -> write chunk offset
+  if (batch_samples) {
+    // The previous chunk has been written. Start a new one with the same sample description.
+    if (m_pending_chunk_samples == 0 && !m_stsc->last_chunk_empty()) {
+      m_stsc->add_chunk(m_stsc->get_chunks().back().sample_description_index);
+    }
 
-  if (m_stsc->last_chunk_empty()) {
-    // if auxiliary data is interleaved, write it between the chunks
-    if (m_aux_helper_tai_timestamps) m_aux_helper_tai_timestamps->write_interleaved(get_file());
-    if (m_aux_helper_content_ids) m_aux_helper_content_ids->write_interleaved(get_file());
+    if (m_pending_chunk_data.capacity() == 0) {
+      m_pending_chunk_data.reserve(m_track_info->max_chunk_size);
+    }
 
-    // TODO
-    assert(data_start < 0xFF000000); // add some headroom for header data
-    m_stco->add_chunk_offset(static_cast<uint32_t>(data_start));
+    m_pending_chunk_data.insert(m_pending_chunk_data.end(), raw_data.begin(), raw_data.end());
+    m_pending_chunk_samples++;
+    m_pending_chunk_duration += sample_duration;
+  }
+  else {
+    Result<uint64_t> dataStartResult = m_heif_context->get_heif_file()->append_mdat_data(raw_data);
+    if (!dataStartResult) {
+      return dataStartResult.error;
+    }
+
+    uint64_t data_start = *dataStartResult;
+
+    // first sample in chunk? -> write chunk offset
+
+    if (m_stsc->last_chunk_empty()) {
+      // if auxiliary data is interleaved, write it between the chunks
+      if (m_aux_helper_tai_timestamps) {
+        if (Error err = m_aux_helper_tai_timestamps->write_interleaved(get_file())) {
+          return err;
+        }
+      }
+
+      if (m_aux_helper_content_ids) {
+        if (Error err = m_aux_helper_content_ids->write_interleaved(get_file())) {
+          return err;
+        }
+      }
+
+      m_stco->add_chunk_offset(data_start);
+    }
   }
 
   m_stsc->increase_samples_in_chunk(1);
@@ -633,7 +891,74 @@ Error Track::write_sample_data(const std::vector<uint8_t>& raw_data, uint32_t sa
 
   m_stts->append_sample_duration(sample_duration);
 
+  // The 'ctts' box is only written when the decoding order differs from the presentation order.
+  if (composition_offset != 0 && !m_ctts) {
+    m_ctts = std::make_shared<Box_ctts>();
+    m_stbl->append_child_box(m_ctts);
+
+    for (uint32_t i = 0; i < m_next_sample_to_be_processed; i++) {
+      m_ctts->append_sample_offset(0);
+    }
+  }
+
+  if (m_ctts) {
+    m_ctts->append_sample_offset(composition_offset);
+  }
+
+  if (Error err = add_sample_aux_info(tai, gimi_contentID)) {
+    return err;
+  }
+
+  m_next_sample_to_be_processed++;
 
+  if (batch_samples) {
+    if (m_pending_chunk_data.size() >= m_track_info->max_chunk_size ||
+        (m_track_info->max_chunk_duration != 0 && m_pending_chunk_duration >= m_track_info->max_chunk_duration)) {
+      return flush_pending_chunk();
+    }
+  }
+
+  return Error::Ok;
+}
+
+
+Error Track::flush_pending_chunk()
+{
+  if (m_pending_chunk_samples == 0) {
+    return Error::Ok;
+  }
+
+  // The auxiliary information of the samples in the chunk is written in front of it.
+  if (m_aux_helper_tai_timestamps) {
+    if (Error err = m_aux_helper_tai_timestamps->write_interleaved(get_file())) {
+      return err;
+    }
+  }
+
+  if (m_aux_helper_content_ids) {
+    if (Error err = m_aux_helper_content_ids->write_interleaved(get_file())) {
+      return err;
+    }
+  }
+
+  Result<uint64_t> dataStartResult = m_heif_context->get_heif_file()->append_mdat_data(m_pending_chunk_data);
+  if (!dataStartResult) {
+    return dataStartResult.error;
+  }
+
+  m_stco->add_chunk_offset(*dataStartResult);
+
+  // keep the allocated buffer for the next chunk
+  m_pending_chunk_data.clear();
+  m_pending_chunk_samples = 0;
+  m_pending_chunk_duration = 0;
+
+  return Error::Ok;
+}
+
+
+Error Track::add_sample_aux_info(const heif_tai_timestamp_packet* tai, const std::string& gimi_contentID)
+{
   // --- sample timestamp
 
   if (m_track_info) {
@@ -675,13 +1000,291 @@ Error Track::write_sample_data(const std::vector<uint8_t>& raw_data, uint32_t sa
 #endif
   }
 
+  return Error::Ok;
+}
 
-  m_next_sample_to_be_processed++;
+
+bool Track::is_writing_fragments() const
+{
+  return get_file()->get_write_mode() == FileLayout::WriteMode::Fragmented;
+}
+
+
+Error Track::write_sample_data_to_fragment(const std::vector<uint8_t>& raw_data, uint32_t sample_duration,
+                                           bool is_sync_sample, int32_t composition_offset)
+{
+  // Fragments start with a sync sample, such that each of them can be decoded on its own.
+  if (m_fragment_trun && is_sync_sample &&
+      m_fragment_trun->get_num_samples() >= m_heif_context->get_samples_per_fragment()) {
+    if (Error err = flush_fragment()) {
+      return err;
+    }
+  }
+
+  if (!m_fragment_trun) {
+    m_fragment_trun = std::make_shared<Box_trun>();
+  }
+
+  Box_trun::Sample sample;
+  sample.duration = sample_duration;
+  sample.size = static_cast<uint32_t>(raw_data.size());
+  sample.flags = is_sync_sample ? sample_flags_depends_on_no_others
+                                : (sample_flags_depends_on_others | sample_flags_is_non_sync_sample);
+  sample.composition_offset = composition_offset;
+  m_fragment_trun->add_sample(sample);
+
+  m_fragment_data.insert(m_fragment_data.end(), raw_data.begin(), raw_data.end());
+
+  return Error::Ok;
+}
+
+
+Error Track::flush_fragment()
+{
+  if (!m_fragment_trun) {
+    return Error::Ok;
+  }
+
+  auto file = get_file();
+
+  // The 'moov' box is written with the first fragment.
+  auto mvhd = file->get_mvhd_box();
+  if (mvhd && mvhd->get_time_scale() == 0) {
+    mvhd->set_time_scale(get_timescale());
+  }
+
+  auto traf = std::make_shared<Box_traf>();
+
+  auto tfhd = std::make_shared<Box_tfhd>();
+  tfhd->set_track_id(m_id);
+  tfhd->set_flags(Box_tfhd::default_base_is_moof);
+  tfhd->set_sample_description_index(static_cast<uint32_t>(m_stsd->get_num_sample_entries()));
+  traf->append_child_box(tfhd);
+
+  auto tfdt = std::make_shared<Box_tfdt>();
+  tfdt->set_base_media_decode_time(m_fragment_decode_time);
+  traf->append_child_box(tfdt);
+
+  // the samples are at the start of the 'mdat' payload
+  m_fragment_trun->set_data_offset(0);
+  traf->append_child_box(m_fragment_trun);
+
+  if (m_aux_helper_tai_timestamps) {
+    m_aux_helper_tai_timestamps->write_fragment(traf, m_fragment_data);
+  }
+
+  if (m_aux_helper_content_ids) {
+    m_aux_helper_content_ids->write_fragment(traf, m_fragment_data);
+  }
+
+  if (Error err = file->write_fragment(traf, m_fragment_data)) {
+    return err;
+  }
+
+  for (const auto& sample : m_fragment_trun->get_samples()) {
+    m_fragment_decode_time += sample.duration;
+  }
+
+  m_fragment_trun.reset();
+  m_fragment_data.clear();
 
   return Error::Ok;
 }
 
 
+void Track::read_movie_fragments()
+{
+  auto file = get_file();
+
+  const auto& fragments = file->get_movie_fragments();
+  if (fragments.empty()) {
+    return;
+  }
+
+  auto moov = file->get_moov_box();
+  auto mvex = moov ? moov->get_child_box<Box_mvex>() : nullptr;
+  if (!mvex) {
+    return;
+  }
+
+  auto trex_boxes = mvex->get_child_boxes<Box_trex>();
+  auto find_trex = [&trex_boxes](uint32_t track_id) -> std::shared_ptr<Box_trex> {
+    for (const auto& trex : trex_boxes) {
+      if (trex->get_track_id() == track_id) {
+        return trex;
+      }
+    }
+    return nullptr;
+  };
+
+  if (!m_stts) {
+    m_stts = std::make_shared<Box_stts>();
+  }
+
+  uint32_t sample_idx = get_number_of_samples();
+
+  for (const auto& fragment : fragments) {
+    // Without explicit base offset, the data of a track fragment follows the data of the previous one.
+    uint64_t next_base_offset = fragment.file_offset;
+
+    for (const auto& traf : fragment.moof->get_child_boxes<Box_traf>()) {
+      auto tfhd = traf->get_child_box<Box_tfhd>();
+      if (!tfhd) {
+        return;
+      }
+
+      auto trex = find_trex(tfhd->get_track_id());
+      if (!trex) {
+        return;
+      }
+
+      uint64_t base_offset = next_base_offset;
+      if (tfhd->has_base_data_offset()) {
+        base_offset = tfhd->get_base_data_offset();
+      }
+      else if (tfhd->get_flags() & Box_tfhd::default_base_is_moof) {
+        base_offset = fragment.file_offset;
+      }
+
+      uint32_t default_duration = tfhd->has_default_sample_duration() ? tfhd->get_default_sample_duration() : trex->get_default_sample_duration();
+      uint32_t default_size = tfhd->has_default_sample_size() ? tfhd->get_default_sample_size() : trex->get_default_sample_size();
+      uint32_t default_flags = tfhd->has_default_sample_flags() ? tfhd->get_default_sample_flags() : trex->get_default_sample_flags();
+
+      bool own_track = (tfhd->get_track_id() == m_id);
+
+      std::shared_ptr<const Box> sample_description;
+      if (own_track) {
+        uint32_t description_index = tfhd->has_sample_description_index() ? tfhd->get_sample_description_index() : trex->get_default_sample_description_index();
+        if (description_index == 0) {
+          return;
+        }
+
+        sample_description = m_stsd->get_sample_entry(description_index - 1);
+        if (!sample_description) {
+          return;
+        }
+
+        if (m_first_taic == nullptr) {
+          m_first_taic = sample_description->get_child_box<Box_taic>();
+        }
+      }
+
+      uint32_t traf_first_sample = sample_idx;
+      uint64_t data_pos = base_offset;
+
+      for (const auto& trun : traf->get_child_boxes<Box_trun>()) {
+        if (trun->has_data_offset()) {
+          data_pos = base_offset + static_cast<int64_t>(trun->get_data_offset());
+        }
+
+        uint64_t run_start = data_pos;
+        uint32_t trun_flags = trun->get_flags();
+        const auto& samples = trun->get_samples();
+
+        for (size_t i = 0; i < samples.size(); i++) {
+          uint32_t size = (trun_flags & Box_trun::sample_size_present) ? samples[i].size : default_size;
+          data_pos += size;
+
+          if (!own_track) {
+            continue;
+          }
+
+          uint32_t duration = (trun_flags & Box_trun::sample_duration_present) ? samples[i].duration : default_duration;
+
+          uint32_t flags = default_flags;
+          if (trun_flags & Box_trun::sample_flags_present) {
+            flags = samples[i].flags;
+          }
+          else if (i == 0 && trun->has_first_sample_flags()) {
+            flags = trun->get_first_sample_flags();
+          }
+
+          m_stsz->append_sample_size(size);
+          m_stts->append_sample_duration(duration);
+
+          bool is_sync_sample = !(flags & sample_flags_is_non_sync_sample);
+          uint32_t sample_number = sample_idx + static_cast<uint32_t>(i);
+
+          if (!is_sync_sample && !m_stss) {
+            // all previous samples were sync samples
+            m_stss = std::make_shared<Box_stss>();
+            for (uint32_t s = 0; s < sample_number; s++) {
+              m_stss->add_sync_sample(s + 1);
+            }
+          }
+
+          if (is_sync_sample && m_stss) {
+            m_stss->add_sync_sample(sample_number + 1);
+          }
+
+          int32_t composition_offset = samples[i].composition_offset;
+          if (composition_offset != 0 && !m_ctts) {
+            m_ctts = std::make_shared<Box_ctts>();
+            for (uint32_t s = 0; s < sample_number; s++) {
+              m_ctts->append_sample_offset(0);
+            }
+          }
+
+          if (m_ctts) {
+            m_ctts->append_sample_offset(composition_offset);
+          }
+        }
+
+        if (own_track && !samples.empty()) {
+          auto num_samples = static_cast<uint32_t>(samples.size());
+          m_chunks.push_back(std::make_shared<Chunk>(m_heif_context, m_id, sample_description,
+                                                     sample_idx, num_samples, run_start, m_stsz));
+          sample_idx += num_samples;
+        }
+      }
+
+      next_base_offset = data_pos;
+
+      if (!own_track) {
+        continue;
+      }
+
+      // --- sample auxiliary information of the fragment
+
+      std::vector<std::shared_ptr<Box_saio>> saio_boxes = traf->get_child_boxes<Box_saio>();
+
+      for (const auto& saiz : traf->get_child_boxes<Box_saiz>()) {
+        for (const auto& saio : saio_boxes) {
+          if (saio->get_aux_info_type() != saiz->get_aux_info_type() ||
+              saio->get_aux_info_type_parameter() != saiz->get_aux_info_type_parameter()) {
+            continue;
+          }
+
+          std::unique_ptr<SampleAuxInfoReader>* reader = nullptr;
+          if (saiz->get_aux_info_type() == fourcc("suid")) {
+            reader = &m_aux_reader_content_ids;
+          }
+          else if (saiz->get_aux_info_type() == fourcc("stai")) {
+            reader = &m_aux_reader_tai_timestamps;
+          }
+
+          if (reader) {
+            if (!*reader) {
+              *reader = std::make_unique<SampleAuxInfoReader>(saiz->get_aux_info_type(),
+                                                              saiz->get_aux_info_type_parameter());
+            }
+
+            (*reader)->add_fragment(saiz, saio, base_offset, traf_first_sample);
+          }
+
+          break;
+        }
+      }
+    }
+  }
+
+  // The 'moov' box of a fragmented file usually has no duration.
+  if (m_mdhd->get_duration() == 0) {
+    m_mdhd->set_duration(m_stts->get_total_duration(false));
+  }
+}
+
+
 void Track::add_reference_to_track(uint32_t referenceType, uint32_t to_track_id)
 {
   if (!m_tref) {
@@ -693,79 +1296,404 @@ void Track::add_reference_to_track(uint32_t referenceType, uint32_t to_track_id)
 }
 
 
+uint32_t Track::get_number_of_samples() const
+{
+  if (m_chunks.empty()) {
+    return 0;
+  }
+
+  return m_chunks.back()->last_sample_number() + 1;
+}
+
+
+uint32_t Track::get_sync_sample_at_or_before(uint32_t sample_idx) const
+{
+  if (!m_stss) {
+    return sample_idx;
+  }
+
+  // stss sample numbers start at 1 and are sorted in increasing order
+
+  const std::vector<uint32_t>& sync_samples = m_stss->get_sync_samples();
+  auto iter = std::upper_bound(sync_samples.begin(), sync_samples.end(), sample_idx + 1);
+  if (iter == sync_samples.begin()) {
+    // No preceding sync sample. Start at the beginning.
+    return 0;
+  }
+
+  return *(iter - 1) - 1;
+}
+
+
+uint32_t Track::get_sync_sample_at_or_after(uint32_t sample_idx) const
+{
+  if (!m_stss) {
+    return std::min(sample_idx, get_number_of_samples());
+  }
+
+  const std::vector<uint32_t>& sync_samples = m_stss->get_sync_samples();
+  auto iter = std::lower_bound(sync_samples.begin(), sync_samples.end(), uint64_t{sample_idx} + 1);
+  if (iter == sync_samples.end()) {
+    return get_number_of_samples();
+  }
+
+  return std::min(*iter - 1, get_number_of_samples());
+}
+
+
+Error Track::seek_to_sample(uint32_t sample_idx)
+{
+  uint32_t num_samples = get_number_of_samples();
+  if (sample_idx > num_samples) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Sample index is beyond the end of the sequence"};
+  }
+
+  m_next_sample_to_be_processed = sample_idx;
+
+  m_current_chunk = static_cast<uint32_t>(std::min(find_chunk_for_sample(sample_idx),
+                                                   m_chunks.empty() ? 0 : m_chunks.size() - 1));
+
+  return Error::Ok;
+}
+
+
+Result<uint32_t> Track::get_sample_at_time(uint64_t time) const
+{
+  if (!m_stts) {
+    return Error{heif_error_Invalid_input,
+                 heif_suberror_Unspecified,
+                 "Track has no 'stts' box"};
+  }
+
+  return std::min(m_stts->get_sample_at_time(time), get_number_of_samples());
+}
+
+
+int64_t Track::get_sample_presentation_time(uint32_t sample_idx) const
+{
+  int64_t time = 0;
+
+  if (m_stts) {
+    time = static_cast<int64_t>(m_stts->get_sample_decoding_time(sample_idx));
+  }
+
+  if (m_ctts) {
+    time += m_ctts->get_sample_offset(sample_idx);
+  }
+
+  return time;
+}
+
+
+size_t Track::find_chunk_for_sample(uint32_t sample_idx) const
+{
+  // find the first chunk that ends at or after 'sample_idx'
+  auto it = std::lower_bound(m_chunks.begin(), m_chunks.end(), sample_idx,
+                             [](const std::shared_ptr<Chunk>& chunk, uint32_t idx) { return chunk->last_sample_number() < idx; });
+
+  return std::distance(m_chunks.begin(), it);
+}
+
+
 Result<heif_raw_sequence_sample*> Track::get_next_sample_raw_data()
 {
-  if (m_current_chunk > m_chunks.size()) {
+  if (m_next_sample_to_be_processed >= get_number_of_samples()) {
     return Error{heif_error_End_of_sequence,
                  heif_suberror_Unspecified,
                  "End of sequence"};
   }
 
-  while (m_next_sample_to_be_processed > m_chunks[m_current_chunk]->last_sample_number()) {
-    m_current_chunk++;
+  auto file = get_file();
+
+  auto sampleResult = read_sample_raw_data(m_next_sample_to_be_processed,
+                                           [&file](const FileRange& range) -> Result<std::vector<uint8_t>> {
+                                             std::vector<uint8_t> data;
+                                             if (Error err = file->append_data_from_file_range(data, range.offset, range.size)) {
+                                               return err;
+                                             }
+                                             return data;
+                                           });
+  if (sampleResult.error) {
+    return sampleResult.error;
+  }
+
+  m_next_sample_to_be_processed++;
+
+  return sampleResult;
+}
+
+
+Result<uint32_t> Track::read_next_raw_samples(uint8_t* buffer, size_t buffer_size,
+                                              heif_raw_sequence_sample_info* out_infos, uint32_t max_samples)
+{
+  auto file = get_file();
+
+  uint32_t num_samples = std::min(max_samples, get_number_of_samples() - m_next_sample_to_be_processed);
+
+  // --- collect the samples that fit into the buffer
+
+  size_t buffer_pos = 0;
+  uint32_t n = 0;
+
+  for (; n < num_samples; n++) {
+    uint32_t sample_idx = m_next_sample_to_be_processed + n;
+
+    size_t chunk_idx = find_chunk_for_sample(sample_idx);
+    if (chunk_idx >= m_chunks.size()) {
+      break;
+    }
+
+    uint32_t size = m_chunks[chunk_idx]->get_sample_size(sample_idx);
+    if (size > buffer_size - buffer_pos) {
+      break;
+    }
+
+    heif_raw_sequence_sample_info& info = out_infos[n];
+    info.data_offset = buffer_pos;
+    info.data_size = size;
+    info.duration = m_stts ? m_stts->get_sample_duration(sample_idx) : 0;
+    info.has_tai_timestamp = false;
+    info.tai_timestamp = {};
+
+    buffer_pos += size;
+  }
+
+  if (n == 0 && num_samples > 0) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "The next sample does not fit into the buffer"};
+  }
+
+  // --- read the data, one read for each run of samples that are stored contiguously
+
+  uint64_t run_file_offset = 0;
+  size_t run_buffer_pos = 0;
+  uint64_t run_size = 0;
+
+  for (uint32_t i = 0; i <= n; i++) {
+    uint64_t file_offset = 0;
+    if (i < n) {
+      uint32_t sample_idx = m_next_sample_to_be_processed + i;
+      file_offset = m_chunks[find_chunk_for_sample(sample_idx)]->get_file_offset_for_sample(sample_idx);
+
+      if (run_size > 0 &&
+          file_offset == run_file_offset + run_size &&
+          run_size + out_infos[i].data_size <= std::numeric_limits<uint32_t>::max()) {
+        run_size += out_infos[i].data_size;
+        continue;
+      }
+    }
+
+    if (run_size > 0) {
+      if (Error err = file->read_file_range(buffer + run_buffer_pos, run_file_offset, static_cast<uint32_t>(run_size))) {
+        return err;
+      }
+    }
+
+    if (i < n) {
+      run_file_offset = file_offset;
+      run_buffer_pos = out_infos[i].data_offset;
+      run_size = out_infos[i].data_size;
+    }
+  }
+
+  // --- TAI timestamps
+
+  if (m_aux_reader_tai_timestamps) {
+    std::vector<uint8_t> tai_data;
+    if (Error err = m_aux_reader_tai_timestamps->read_sample_infos(file.get(), m_next_sample_to_be_processed, n, tai_data)) {
+      return err;
+    }
+
+    size_t tai_pos = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t size = m_aux_reader_tai_timestamps->get_sample_range(m_next_sample_to_be_processed + i).size;
+      if (size == 0) {
+        continue;
+      }
+
+      auto resultTai = Box_itai::decode_tai_from_bitstream(tai_data.data() + tai_pos, size);
+      if (resultTai.error) {
+        return resultTai.error;
+      }
+
+      tai_pos += size;
+
+      out_infos[i].has_tai_timestamp = true;
+      out_infos[i].tai_timestamp = resultTai.value;
+    }
+  }
+
+  m_next_sample_to_be_processed += n;
+
+  return n;
+}
+
+
+Result<bool> Track::read_tai_timestamp(uint32_t sample_idx, heif_tai_timestamp_packet* out_tai) const
+{
+  if (!m_aux_reader_tai_timestamps) {
+    return false;
+  }
+
+  FileRange range = m_aux_reader_tai_timestamps->get_sample_range(sample_idx);
+  if (range.size == 0) {
+    return false;
+  }
+
+  // The size of sample auxiliary information is limited to 255 bytes by 'saiz'.
+  uint8_t data[0xFF];
+  if (Error err = get_file()->read_file_range(data, range.offset, static_cast<uint32_t>(range.size))) {
+    return err;
+  }
 
-    if (m_current_chunk > m_chunks.size()) {
-      return Error{heif_error_End_of_sequence,
-                   heif_suberror_Unspecified,
-                   "End of sequence"};
+  auto resultTai = Box_itai::decode_tai_from_bitstream(data, range.size);
+  if (resultTai.error) {
+    return resultTai.error;
+  }
+
+  *out_tai = resultTai.value;
+  return true;
+}
+
+
+Error Track::read_tai_timestamps(uint32_t first_sample, uint32_t count,
+                                 uint64_t* out_tai_timestamps, uint8_t* out_flags) const
+{
+  if (count > get_number_of_samples() || first_sample > get_number_of_samples() - count) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Sample range is beyond the end of the sequence"};
+  }
+
+  std::vector<uint8_t> data;
+  if (m_aux_reader_tai_timestamps) {
+    if (Error err = m_aux_reader_tai_timestamps->read_sample_infos(get_file().get(), first_sample, count, data)) {
+      return err;
+    }
+  }
+
+  size_t pos = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t size = 0;
+    if (m_aux_reader_tai_timestamps) {
+      size = m_aux_reader_tai_timestamps->get_sample_range(first_sample + i).size;
+    }
+
+    if (size == 0) {
+      out_tai_timestamps[i] = 0;
+      if (out_flags) {
+        out_flags[i] = 0;
+      }
+      continue;
+    }
+
+    auto resultTai = Box_itai::decode_tai_from_bitstream(data.data() + pos, size);
+    if (resultTai.error) {
+      return resultTai.error;
+    }
+
+    pos += size;
+
+    const heif_tai_timestamp_packet& tai = *resultTai;
+    out_tai_timestamps[i] = tai.tai_timestamp;
+
+    if (out_flags) {
+      out_flags[i] = static_cast<uint8_t>(heif_tai_timestamp_flag_present |
+                                          (tai.synchronization_state ? heif_tai_timestamp_flag_synchronized : 0) |
+                                          (tai.timestamp_generation_failure ? heif_tai_timestamp_flag_generation_failure : 0) |
+                                          (tai.timestamp_is_modified ? heif_tai_timestamp_flag_modified : 0));
     }
   }
 
-  const std::shared_ptr<Chunk>& chunk = m_chunks[m_current_chunk];
+  return Error::Ok;
+}
+
+
+Result<Track::SampleFileRanges> Track::get_sample_file_ranges(uint32_t sample_idx) const
+{
+  size_t chunk_idx = find_chunk_for_sample(sample_idx);
+  if (chunk_idx >= m_chunks.size() || sample_idx < m_chunks[chunk_idx]->first_sample_number()) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Sample index is beyond the end of the sequence"};
+  }
+
+  const std::shared_ptr<Chunk>& chunk = m_chunks[chunk_idx];
+
+  SampleFileRanges ranges;
+  ranges.data.offset = chunk->get_file_offset_for_sample(sample_idx);
+  ranges.data.size = chunk->get_sample_size(sample_idx);
+
+  if (m_aux_reader_content_ids) {
+    ranges.content_id = m_aux_reader_content_ids->get_sample_range(sample_idx);
+  }
+
+  if (m_aux_reader_tai_timestamps) {
+    ranges.tai_timestamp = m_aux_reader_tai_timestamps->get_sample_range(sample_idx);
+  }
+
+  return ranges;
+}
+
+
+Result<heif_raw_sequence_sample*> Track::read_sample_raw_data(uint32_t sample_idx, const FileRangeReader& read) const
+{
+  auto rangesResult = get_sample_file_ranges(sample_idx);
+  if (rangesResult.error) {
+    return rangesResult.error;
+  }
+
+  const SampleFileRanges& ranges = *rangesResult;
 
-  DataExtent extent = chunk->get_data_extent_for_sample(m_next_sample_to_be_processed);
-  auto readResult = extent.read_data();
+  auto readResult = read(ranges.data);
   if (readResult.error) {
     return readResult.error;
   }
 
-  heif_raw_sequence_sample* sample = new heif_raw_sequence_sample();
-  sample->data = *readResult.value;
+  auto sample = std::make_unique<heif_raw_sequence_sample>();
+  sample->data = std::move(*readResult);
 
   // read sample duration
 
   if (m_stts) {
-    sample->duration = m_stts->get_sample_duration(m_next_sample_to_be_processed);
+    sample->duration = m_stts->get_sample_duration(sample_idx);
   }
 
   // --- read sample auxiliary data
 
-  if (m_aux_reader_content_ids) {
-    auto readResult = m_aux_reader_content_ids->get_sample_info(get_file().get(), m_next_sample_to_be_processed);
+  if (ranges.content_id.size) {
+    auto readResult = read(ranges.content_id);
     if (readResult.error) {
       return readResult.error;
     }
 
-    if (!readResult.value.empty()) {
-      Result<std::string> convResult = vector_to_string(readResult.value);
-      if (convResult.error) {
-        return convResult.error;
-      }
-
-      sample->gimi_sample_content_id = convResult.value;
+    Result<std::string> convResult = vector_to_string(readResult.value);
+    if (convResult.error) {
+      return convResult.error;
     }
+
+    sample->gimi_sample_content_id = convResult.value;
   }
 
-  if (m_aux_reader_tai_timestamps) {
-    auto readResult = m_aux_reader_tai_timestamps->get_sample_info(get_file().get(), m_next_sample_to_be_processed);
+  if (ranges.tai_timestamp.size) {
+    auto readResult = read(ranges.tai_timestamp);
     if (readResult.error) {
       return readResult.error;
     }
 
-    if (!readResult.value.empty()) {
-      auto resultTai = Box_itai::decode_tai_from_vector(readResult.value);
-      if (resultTai.error) {
-        return resultTai.error;
-      }
-
-      sample->timestamp = heif_tai_timestamp_packet_alloc();
-      heif_tai_timestamp_packet_copy(sample->timestamp, &resultTai.value);
+    auto resultTai = Box_itai::decode_tai_from_vector(readResult.value);
+    if (resultTai.error) {
+      return resultTai.error;
     }
-  }
 
-  m_next_sample_to_be_processed++;
+    sample->timestamp = heif_tai_timestamp_packet_alloc();
+    heif_tai_timestamp_packet_copy(sample->timestamp, &resultTai.value);
+  }
 
-  return sample;
+  return sample.release();
 }
 
 
@@ -778,3 +1706,77 @@ std::vector<heif_sample_aux_info_type> Track::get_sample_aux_info_types() const
 
   return types;
 }
+
+
+const Track::SampleGrouping* Track::find_sample_grouping(uint32_t grouping_type) const
+{
+  for (const auto& grouping : m_sample_groupings) {
+    if (grouping.grouping_type == grouping_type) {
+      return &grouping;
+    }
+  }
+
+  return nullptr;
+}
+
+
+std::vector<uint32_t> Track::get_sample_grouping_types() const
+{
+  std::vector<uint32_t> types;
+  for (const auto& grouping : m_sample_groupings) {
+    types.push_back(grouping.grouping_type);
+  }
+
+  return types;
+}
+
+
+Error Track::get_sample_group_description_indices(uint32_t grouping_type, uint32_t first_sample, uint32_t count,
+                                                  uint32_t* out_indices) const
+{
+  if (count > get_number_of_samples() || first_sample > get_number_of_samples() - count) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Sample range is beyond the end of the sequence"};
+  }
+
+  const SampleGrouping* grouping = find_sample_grouping(grouping_type);
+  if (!grouping) {
+    return {heif_error_Usage_error,
+            heif_suberror_Invalid_parameter_value,
+            "Track has no sample grouping of this type"};
+  }
+
+  // samples that are not mapped by the 'sbgp' box belong to the default group
+  uint32_t default_index = grouping->sgpd ? grouping->sgpd->get_default_group_description_index() : 0;
+
+  if (grouping->sbgp) {
+    grouping->sbgp->get_group_description_indices(first_sample, count, default_index, out_indices);
+  }
+  else {
+    std::fill(out_indices, out_indices + count, default_index);
+  }
+
+  return Error::Ok;
+}
+
+
+Result<const std::vector<uint8_t>*> Track::get_sample_group_description(uint32_t grouping_type,
+                                                                       uint32_t description_index) const
+{
+  const SampleGrouping* grouping = find_sample_grouping(grouping_type);
+  if (!grouping) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Track has no sample grouping of this type"};
+  }
+
+  const std::vector<uint8_t>* data = grouping->sgpd ? grouping->sgpd->get_entry_data(description_index) : nullptr;
+  if (!data) {
+    return Error{heif_error_Usage_error,
+                 heif_suberror_Invalid_parameter_value,
+                 "Sample group description index does not exist"};
+  }
+
+  return data;
+}
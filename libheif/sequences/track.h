@@ -28,6 +28,7 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <functional>
 
 class HeifContext;
 
@@ -38,6 +39,17 @@ class Chunk;
 class Box_trak;
 
 
+// A range of bytes in the input file. Ranges with size 0 are empty.
+struct FileRange
+{
+  uint64_t offset = 0;
+  uint32_t size = 0;
+};
+
+// Reads a range of the input file. This allows to serve the data from a read-ahead buffer.
+using FileRangeReader = std::function<Result<std::vector<uint8_t>>(const FileRange&)>;
+
+
 class SampleAuxInfoHelper
 {
 public:
@@ -49,9 +61,13 @@ public:
 
   void add_nonpresent_sample();
 
-  void write_interleaved(const std::shared_ptr<class HeifFile>& file);
+  Error write_interleaved(const std::shared_ptr<class HeifFile>& file);
+
+  Error write_all(const std::shared_ptr<class Box>& parent, const std::shared_ptr<class HeifFile>& file);
 
-  void write_all(const std::shared_ptr<class Box>& parent, const std::shared_ptr<class HeifFile>& file);
+  // Adds 'saiz' and 'saio' for the samples of a movie fragment to 'traf' and appends their data to 'mdat_data'.
+  // Afterward, the information of the next fragment can be collected.
+  void write_fragment(const std::shared_ptr<class Box>& traf, std::vector<uint8_t>& mdat_data);
 
 private:
   std::shared_ptr<class Box_saiz> m_saiz;
@@ -66,19 +82,43 @@ private:
 class SampleAuxInfoReader
 {
 public:
+  // 'samples_per_chunk' is needed when the 'saio' box has one offset for each chunk.
   SampleAuxInfoReader(std::shared_ptr<Box_saiz>,
-                      std::shared_ptr<Box_saio>);
+                      std::shared_ptr<Box_saio>,
+                      const std::vector<uint32_t>& samples_per_chunk = {});
+
+  // for information that is only stored in movie fragments
+  SampleAuxInfoReader(uint32_t aux_info_type, uint32_t aux_info_type_parameter);
+
+  // Appends the information of the samples in a track fragment, starting at sample 'first_sample'.
+  // The 'saio' offsets are relative to 'base_offset'.
+  void add_fragment(const std::shared_ptr<Box_saiz>&, const std::shared_ptr<Box_saio>&,
+                    uint64_t base_offset, uint32_t first_sample);
 
   heif_sample_aux_info_type get_type() const;
 
+  // Returns empty data for samples without information.
   Result<std::vector<uint8_t>> get_sample_info(const HeifFile* file, uint32_t idx);
 
+  // Returns an empty range for samples without information.
+  FileRange get_sample_range(uint32_t idx) const;
+
+  // Reads the information of 'count' samples, starting at 'first_sample', into 'out_data', one after the other.
+  // The sizes of the individual entries are given by get_sample_range(). Neighbouring ranges are read in one piece.
+  Error read_sample_infos(const HeifFile* file, uint32_t first_sample, uint32_t count,
+                          std::vector<uint8_t>& out_data) const;
+
 private:
-  std::shared_ptr<class Box_saiz> m_saiz;
-  std::shared_ptr<class Box_saio> m_saio;
+  uint32_t m_aux_info_type = 0;
+  uint32_t m_aux_info_type_parameter = 0;
 
-  bool m_contiguous;
-  std::vector<uint64_t> m_contiguous_offsets;
+  struct SampleInfoRange
+  {
+    uint64_t offset = 0;
+    uint8_t size = 0;
+  };
+
+  std::vector<SampleInfoRange> m_samples;
 };
 
 
@@ -116,10 +156,23 @@ public:
 
   std::shared_ptr<class Box_taic> get_first_cluster_taic() { return m_first_taic; }
 
-  bool end_of_sequence_reached() const;
+  virtual bool end_of_sequence_reached() const;
+
+  uint32_t get_number_of_samples() const;
+
+  // Position the track such that the next sample that is read or decoded is 'sample_idx'.
+  // Passing the number of samples positions the track at the end of the sequence.
+  virtual Error seek_to_sample(uint32_t sample_idx);
+
+  // Index of the sample displayed at 'time' (in track timescale units).
+  // Returns the number of samples if 'time' is after the end of the sequence.
+  Result<uint32_t> get_sample_at_time(uint64_t time) const;
+
+  // The decoding time of the sample plus its composition time offset (in track timescale units).
+  int64_t get_sample_presentation_time(uint32_t sample_idx) const;
 
   // Compute some parameters after all frames have been encoded (for example: track duration).
-  void finalize_track();
+  virtual Error finalize_track();
 
   const heif_track_info* get_track_info() const { return m_track_info; }
 
@@ -129,9 +182,56 @@ public:
 
   Result<heif_raw_sequence_sample*> get_next_sample_raw_data();
 
+  // Reads the data of the following samples into 'buffer', as many as fit into it (up to 'max_samples').
+  // The data of samples that follow each other in the file is read in one piece.
+  // Returns the number of samples read and advances the track position by it.
+  Result<uint32_t> read_next_raw_samples(uint8_t* buffer, size_t buffer_size,
+                                         heif_raw_sequence_sample_info* out_infos, uint32_t max_samples);
+
+  // Returns false if the sample has no TAI timestamp.
+  Result<bool> read_tai_timestamp(uint32_t sample_idx, heif_tai_timestamp_packet* out_tai) const;
+
+  // Fills the arrays with 'count' entries, see heif_track_get_tai_timestamps().
+  Error read_tai_timestamps(uint32_t first_sample, uint32_t count,
+                            uint64_t* out_tai_timestamps, uint8_t* out_flags) const;
+
+  // The file ranges of a sample and of its auxiliary information.
+  struct SampleFileRanges
+  {
+    FileRange data;
+    FileRange content_id;
+    FileRange tai_timestamp;
+  };
+
+  Result<SampleFileRanges> get_sample_file_ranges(uint32_t sample_idx) const;
+
+  // Reads a sample with its auxiliary information through 'read'. The position of the track is not changed.
+  Result<heif_raw_sequence_sample*> read_sample_raw_data(uint32_t sample_idx, const FileRangeReader& read) const;
+
   std::vector<heif_sample_aux_info_type> get_sample_aux_info_types() const;
 
+  // --- sample groups ('sbgp' / 'sgpd' in the sample table)
+
+  std::vector<uint32_t> get_sample_grouping_types() const;
+
+  // Fills 'out_indices' with the group description index of 'count' samples, starting at 'first_sample'.
+  // Samples that are in no group of this type get 0.
+  Error get_sample_group_description_indices(uint32_t grouping_type, uint32_t first_sample, uint32_t count,
+                                             uint32_t* out_indices) const;
+
+  // The payload of the group description 'description_index' (counting starts at 1).
+  Result<const std::vector<uint8_t>*> get_sample_group_description(uint32_t grouping_type, uint32_t description_index) const;
+
 protected:
+  // Index into m_chunks of the chunk that contains 'sample_idx'. Returns m_chunks.size() if there is none.
+  size_t find_chunk_for_sample(uint32_t sample_idx) const;
+
+  // Returns the sync sample from which decoding has to start to reconstruct sample 'sample_idx'.
+  uint32_t get_sync_sample_at_or_before(uint32_t sample_idx) const;
+
+  // Returns the first sync sample at or after 'sample_idx', or the number of samples if there is none.
+  uint32_t get_sync_sample_at_or_after(uint32_t sample_idx) const;
+
   HeifContext* m_heif_context = nullptr;
   uint32_t m_id = 0;
   uint32_t m_handler_type = 0;
@@ -156,6 +256,7 @@ protected:
   std::shared_ptr<class Box_stco> m_stco;
   std::shared_ptr<class Box_stts> m_stts;
   std::shared_ptr<class Box_stss> m_stss;
+  std::shared_ptr<class Box_ctts> m_ctts; // optional
   std::shared_ptr<class Box_stsz> m_stsz;
 
   std::shared_ptr<class Box_tref> m_tref; // optional
@@ -170,6 +271,48 @@ protected:
 
   std::shared_ptr<class Box_taic> m_first_taic; // the TAIC of the first chunk
 
+  // --- sample groups
+
+  struct SampleGrouping
+  {
+    uint32_t grouping_type;
+    std::shared_ptr<const class Box_sbgp> sbgp; // NULL if all samples are in the default group
+    std::shared_ptr<const class Box_sgpd> sgpd; // NULL if the file has no descriptions for this grouping
+  };
+
+  std::vector<SampleGrouping> m_sample_groupings;
+
+  const SampleGrouping* find_sample_grouping(uint32_t grouping_type) const;
+
+  // --- movie fragments
+
+  // Appends the samples of this track in the movie fragments of the file to the sample tables.
+  // Reading stops at the first fragment that cannot be interpreted.
+  void read_movie_fragments();
+
+  // Samples of the fragment that has not been written yet (WriteMode::Fragmented).
+  std::shared_ptr<class Box_trun> m_fragment_trun;
+  std::vector<uint8_t> m_fragment_data;
+  uint64_t m_fragment_decode_time = 0; // decoding time of the first sample in the fragment
+
+  bool is_writing_fragments() const;
+
+  Error flush_fragment();
+
+
+  // --- collecting samples into chunks
+
+  // When set, write_sample_data() collects the samples in m_pending_chunk_data until the chunk reaches the
+  // 'max_chunk_size' or 'max_chunk_duration' of the track info. The chunk is then written in one piece.
+  bool m_batch_samples_into_chunks = false;
+
+  std::vector<uint8_t> m_pending_chunk_data;
+  uint32_t m_pending_chunk_samples = 0;
+  uint64_t m_pending_chunk_duration = 0;
+
+  // Writes the collected samples as one chunk. Does nothing if there are none.
+  Error flush_pending_chunk();
+
 
   // --- Helper functions for writing samples.
 
@@ -180,12 +323,23 @@ protected:
   // Has to be called when we call add_chunk().
   // It is not merged with add_chunk() because the sample_description_box may need information from the
   // first encoded frame.
-  void set_sample_description_box(std::shared_ptr<Box> sample_description_box);
+  // In a fragmented file, this is not possible any more after the first fragment has been written.
+  Error set_sample_description_box(std::shared_ptr<Box> sample_description_box);
 
   // Write the actual sample data. `tai` may be null and `gimi_contentID` may be empty.
   // In these cases, no timestamp or no contentID will be written, respectively.
+  // `composition_offset` is the presentation time minus the decoding time of the sample.
   Error write_sample_data(const std::vector<uint8_t>& raw_data, uint32_t sample_duration, bool is_sync_sample,
-                          const heif_tai_timestamp_packet* tai, const std::string& gimi_contentID);
+                          const heif_tai_timestamp_packet* tai, const std::string& gimi_contentID,
+                          int32_t composition_offset = 0);
+
+private:
+  Error add_sample_aux_info(const heif_tai_timestamp_packet* tai, const std::string& gimi_contentID);
+
+  // Adds the sample to the pending movie fragment. A fragment is written before the next sync sample
+  // when it has reached the number of samples set with HeifContext::start_fragmented_writing().
+  Error write_sample_data_to_fragment(const std::vector<uint8_t>& raw_data, uint32_t sample_duration,
+                                      bool is_sync_sample, int32_t composition_offset);
 };
 
 
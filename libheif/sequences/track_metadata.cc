@@ -27,7 +27,7 @@
 Track_Metadata::Track_Metadata(HeifContext* ctx, const std::shared_ptr<Box_trak>& trak)
     : Track(ctx, trak)
 {
-  const std::vector<uint32_t>& chunk_offsets = m_stco->get_offsets();
+  const std::vector<uint64_t>& chunk_offsets = m_stco->get_offsets();
 
   // Find sequence resolution
 
@@ -55,6 +55,9 @@ Track_Metadata::Track_Metadata(HeifContext* ctx, uint32_t track_id, std::string
 {
   auto nmhd = std::make_shared<Box_nmhd>();
   m_minf->append_child_box(nmhd);
+
+  // Metadata samples are usually small. Write them in larger chunks.
+  m_batch_samples_into_chunks = true;
 }
 
 
@@ -148,7 +151,9 @@ Error Track_Metadata::write_raw_metadata(const Metadata& metadata)
     sample_description_box->append_child_box(uri);
 
     add_chunk(heif_compression_undefined);
-    set_sample_description_box(sample_description_box);
+    if (Error err = set_sample_description_box(sample_description_box)) {
+      return err;
+    }
   }
 
   Error err = write_sample_data(metadata.raw_metadata, metadata.duration, true,
@@ -25,123 +25,961 @@
 #include "pixelimage.h"
 #include "context.h"
 #include "libheif/api_structs.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+extern heif_color_conversion_options_ext normalize_options(const heif_color_conversion_options_ext* input_options);
 
 
 Track_Visual::Track_Visual(HeifContext* ctx, const std::shared_ptr<Box_trak>& trak)
     : Track(ctx, trak)
 {
-  const std::vector<uint32_t>& chunk_offsets = m_stco->get_offsets();
+  if (!m_stco) {
+    return;
+  }
+
+  const std::vector<uint64_t>& chunk_offsets = m_stco->get_offsets();
+
+  // Find sequence resolution
+
+  std::shared_ptr<const Box> sample_description;
+
+  if (!chunk_offsets.empty())  {
+    auto* s2c = m_stsc->get_chunk(static_cast<uint32_t>(1));
+    if (!s2c) {
+      return;
+    }
+
+    Box_stsc::SampleToChunk sampleToChunk = *s2c;
+
+    sample_description = m_stsd->get_sample_entry(sampleToChunk.sample_description_index - 1);
+  }
+  else if (!m_chunks.empty()) {
+    // The samples of fragmented files are all in the movie fragments.
+    sample_description = m_stsd->get_sample_entry(0);
+  }
+
+  if (sample_description) {
+    auto visual_sample_description = std::dynamic_pointer_cast<const Box_VisualSampleEntry>(sample_description);
+    if (!visual_sample_description) {
+      return; // TODO
+    }
+
+    m_width = visual_sample_description->get_VisualSampleEntry_const().width;
+    m_height = visual_sample_description->get_VisualSampleEntry_const().height;
+  }
+}
+
+
+Track_Visual::Track_Visual(HeifContext* ctx, uint32_t track_id, uint16_t width, uint16_t height,
+                           heif_track_info* info, uint32_t handler_type)
+    : Track(ctx, track_id, info, handler_type)
+{
+  m_tkhd->set_resolution(width, height);
+  //m_hdlr->set_handler_type(handler_type);  already done in Track()
+
+  auto vmhd = std::make_shared<Box_vmhd>();
+  m_minf->append_child_box(vmhd);
+}
+
+
+Track_Visual::~Track_Visual()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  stop_lookahead();
+  m_parallel_encoding_tasks.wait();
+#endif
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> Track_Visual::decode_next_image_sample(const struct heif_decoding_options& options)
+{
+  init_sample_decoding(options);
+
+  // The decoded images are collected in the reorder buffer until it is known which image is presented next.
+
+  for (;;) {
+    if (m_reorder_buffer.size() > m_reorder_depth ||
+        (m_all_samples_decoded && !m_reorder_buffer.empty())) {
+      auto first = m_reorder_buffer.begin();
+      std::shared_ptr<HeifPixelImage> image = std::move(first->second);
+      m_reorder_buffer.erase(first);
+
+      return image;
+    }
+
+    if (m_all_samples_decoded) {
+      return Error{heif_error_End_of_sequence,
+                   heif_suberror_Unspecified,
+                   "End of sequence"};
+    }
+
+    auto decodingResult = decode_next_sample(options);
+    if (decodingResult.error) {
+      if (decodingResult.error.error_code == heif_error_End_of_sequence) {
+        m_all_samples_decoded = true;
+        continue;
+      }
+
+      return decodingResult.error;
+    }
+
+    // After seeking to a sample that is no sync sample, the samples before it are only decoded as references.
+    if (decodingResult.value.sample_idx < m_seek_target_sample) {
+      continue;
+    }
+
+    m_reorder_buffer.emplace(get_sample_presentation_time(decodingResult.value.sample_idx),
+                             std::move(decodingResult.value.image));
+  }
+}
+
+
+void Track_Visual::init_sample_decoding(const struct heif_decoding_options& options)
+{
+  if (m_sample_decoding_initialized) {
+    return;
+  }
+
+  m_sample_decoding_initialized = true;
+
+  uint32_t num_samples = get_number_of_samples();
+
+  // --- samples with inter-frame prediction
+
+  bool has_dependent_samples = (m_stss && m_stss->get_sync_samples().size() < num_samples);
+
+  if (has_dependent_samples && !m_chunks.empty()) {
+    auto decoder = m_chunks[0]->get_decoder();
+    m_use_sequence_decoder = (decoder && decoder->supports_sequence_decoding(options));
+  }
+
+  // --- reorder depth
+  //
+  // The image at presentation rank r can be output when all samples up to need[r] (the largest decoding index
+  // of the images presented until r) have been decoded. After decoding sample k, (k+1) - ready(k) images wait
+  // for their output, where ready(k) is the number of ranks with need[r] <= k.
+
+  if (!m_ctts || num_samples == 0) {
+    return;
+  }
+
+  std::vector<std::pair<int64_t, uint32_t>> presentation_order(num_samples);
+  for (uint32_t i = 0; i < num_samples; i++) {
+    presentation_order[i] = {get_sample_presentation_time(i), i};
+  }
+
+  std::sort(presentation_order.begin(), presentation_order.end());
+
+  std::vector<uint32_t> need(num_samples);
+  uint32_t max_decoding_idx = 0;
+  for (uint32_t r = 0; r < num_samples; r++) {
+    max_decoding_idx = std::max(max_decoding_idx, presentation_order[r].second);
+    need[r] = max_decoding_idx;
+  }
+
+  uint32_t ready = 0;
+  for (uint32_t k = 0; k < num_samples; k++) {
+    while (ready < num_samples && need[ready] <= k) {
+      ready++;
+    }
+
+    m_reorder_depth = std::max(m_reorder_depth, k + 1 - ready);
+  }
+}
+
+
+Result<Track_Visual::DecodedSample> Track_Visual::decode_next_sample(const struct heif_decoding_options& options)
+{
+  if (m_use_sequence_decoder) {
+    return decode_next_sample_with_sequence_decoder(options);
+  }
+
+  // Each sample is decoded independently with the decoder of its chunk.
+
+  auto sampleResult = take_next_sample();
+  if (sampleResult.error) {
+    return sampleResult.error;
+  }
+
+  const SampleToDecode& sample = *sampleResult;
+
+  auto imageResult = decode_sample(sample, *sample.chunk->get_decoder(), options, 1);
+  if (imageResult.error) {
+    return imageResult.error;
+  }
+
+  DecodedSample decoded;
+  decoded.sample_idx = sample.sample_idx;
+  decoded.image = *imageResult;
+
+  return decoded;
+}
+
+
+Result<Track_Visual::DecodedSample> Track_Visual::decode_next_sample_with_sequence_decoder(const struct heif_decoding_options& options)
+{
+  for (;;) {
+    // --- return the next image that the decoder has finished
+
+    if (m_sequence_decoder) {
+      uintptr_t user_data = 0;
+      auto imageResult = m_sequence_decoder->get_next_sequence_image(&user_data);
+      if (imageResult.error) {
+        return imageResult.error;
+      }
+
+      if (*imageResult) {
+        if (m_num_samples_in_sequence_decoder > 0) {
+          m_num_samples_in_sequence_decoder--;
+        }
+
+        DecodedSample decoded;
+        decoded.sample_idx = static_cast<uint32_t>(user_data);
+        decoded.image = *imageResult;
+
+        if (Error err = set_sample_properties(decoded.image, decoded.sample_idx)) {
+          return err;
+        }
+
+        return decoded;
+      }
+
+      if (m_sequence_decoder_flushed) {
+        // All images of this decoder have been output. Images that the decoder dropped are not waited for.
+        m_sequence_decoder->end_sequence_decoding();
+        m_sequence_decoder.reset();
+        m_num_samples_in_sequence_decoder = 0;
+      }
+    }
+
+    // --- push the next sample into the decoder
+
+    auto sampleResult = take_next_sample();
+    if (sampleResult.error) {
+      if (sampleResult.error.error_code == heif_error_End_of_sequence && m_sequence_decoder) {
+        if (Error err = m_sequence_decoder->flush_sequence()) {
+          return err;
+        }
+
+        m_sequence_decoder_flushed = true;
+        continue;
+      }
+
+      return sampleResult.error;
+    }
+
+    const SampleToDecode& sample = *sampleResult;
+
+    if (m_sequence_decoder && sample.chunk->get_sample_description() != m_sequence_sample_description) {
+      // A new sample description starts a new coded sequence. Output the images of the previous one first
+      // and take this sample again afterwards.
+      m_next_sample_to_be_processed--;
+
+      if (Error err = m_sequence_decoder->flush_sequence()) {
+        return err;
+      }
+
+      m_sequence_decoder_flushed = true;
+      continue;
+    }
+
+    if (!m_sequence_decoder) {
+      auto decoder = sample.chunk->create_decoder();
+      if (!decoder) {
+        return Error{heif_error_Unsupported_feature,
+                     heif_suberror_Unsupported_codec,
+                     "No decoder for the sample description of the track"};
+      }
+
+      heif_decoding_options sequence_options = get_decoding_options_with_codec_threads(options, m_heif_context->get_max_decoding_threads(), 1);
+
+      if (Error err = decoder->start_sequence_decoding(get_full_resolution_decoding_options(sequence_options))) {
+        return err;
+      }
+
+      m_sequence_decoder = decoder;
+      m_sequence_sample_description = sample.chunk->get_sample_description();
+      m_sequence_decoder_flushed = false;
+    }
+
+    m_sequence_decoder->set_data_extent(sample.chunk->get_data_extent_for_sample(sample.sample_idx));
+
+    if (Error err = m_sequence_decoder->push_sequence_sample(sample.sample_idx)) {
+      return err;
+    }
+
+    m_num_samples_in_sequence_decoder++;
+  }
+}
+
+
+bool Track_Visual::all_images_output() const
+{
+  if (!m_reorder_buffer.empty() || m_num_samples_in_sequence_decoder > 0) {
+    return false;
+  }
+
+  return Track::end_of_sequence_reached();
+}
+
+
+void Track_Visual::reset_sample_decoding()
+{
+  if (m_sequence_decoder) {
+    m_sequence_decoder->end_sequence_decoding();
+    m_sequence_decoder.reset();
+  }
+
+  m_sequence_sample_description.reset();
+  m_sequence_decoder_flushed = false;
+  m_num_samples_in_sequence_decoder = 0;
+
+  m_reorder_buffer.clear();
+  m_all_samples_decoded = false;
+}
+
+
+Error Track_Visual::seek_to_sample(uint32_t sample_idx)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  stop_lookahead();
+#endif
+
+  reset_sample_decoding();
+
+  uint32_t start_sample = sample_idx;
+  if (sample_idx < get_number_of_samples()) {
+    start_sample = get_sync_sample_at_or_before(sample_idx);
+  }
+
+  Error err = Track::seek_to_sample(start_sample);
+  if (err) {
+    return err;
+  }
+
+  m_seek_target_sample = sample_idx;
+
+  return Error::Ok;
+}
+
+
+Result<Track_Visual::SampleToDecode> Track_Visual::take_next_sample()
+{
+  if (m_current_chunk >= m_chunks.size()) {
+    return Error{heif_error_End_of_sequence,
+                 heif_suberror_Unspecified,
+                 "End of sequence"};
+  }
+
+  while (m_next_sample_to_be_processed > m_chunks[m_current_chunk]->last_sample_number()) {
+    m_current_chunk++;
+
+    if (m_current_chunk >= m_chunks.size()) {
+      return Error{heif_error_End_of_sequence,
+                   heif_suberror_Unspecified,
+                   "End of sequence"};
+    }
+  }
+
+  SampleToDecode sample;
+  sample.chunk = m_chunks[m_current_chunk];
+  sample.sample_idx = m_next_sample_to_be_processed;
+
+  assert(sample.chunk->get_decoder());
+
+  m_next_sample_to_be_processed++;
+
+  return sample;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> Track_Visual::decode_sample(const SampleToDecode& sample, Decoder& decoder,
+                                                                    const struct heif_decoding_options& options,
+                                                                    size_t num_parallel_decodes,
+                                                                    bool full_resolution)
+{
+  decoder.set_data_extent(sample.chunk->get_data_extent_for_sample(sample.sample_idx));
+
+  heif_decoding_options frame_options = get_decoding_options_with_codec_threads(options, m_heif_context->get_max_decoding_threads(),
+                                                                                num_parallel_decodes);
+  if (full_resolution) {
+    frame_options = get_full_resolution_decoding_options(frame_options);
+  }
+
+  Result<std::shared_ptr<HeifPixelImage>> decodingResult = decoder.decode_single_frame_from_compressed_data(frame_options);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  auto image = decodingResult.value;
+
+  if (Error err = set_sample_properties(image, sample.sample_idx)) {
+    return err;
+  }
+
+  return image;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> Track_Visual::decode_sync_sample(const SampleToDecode& sample,
+                                                                         uint32_t out_width, uint32_t out_height,
+                                                                         heif_colorspace out_colorspace,
+                                                                         heif_chroma out_chroma,
+                                                                         const struct heif_decoding_options& options,
+                                                                         size_t num_parallel_decodes)
+{
+  auto decoder = sample.chunk->create_decoder();
+  if (!decoder) {
+    return Error{heif_error_Unsupported_feature,
+                 heif_suberror_Unsupported_codec,
+                 "No decoder for the sample description of the sync sample"};
+  }
+
+  auto decodingResult = decode_sample(sample, *decoder, options, num_parallel_decodes, false);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  std::shared_ptr<HeifPixelImage> img = std::move(*decodingResult);
+
+  if (out_width != 0 && (img->get_width() != out_width || img->get_height() != out_height)) {
+    std::shared_ptr<HeifPixelImage> scaled;
+    Error err = img->scale_nearest_neighbor(scaled, out_width, out_height, m_heif_context->get_security_limits());
+    if (err) {
+      return err;
+    }
+
+    scaled->forward_all_metadata_from(img);
+    scaled->set_sample_duration(img->get_sample_duration());
+    if (img->get_tai_timestamp()) {
+      scaled->set_tai_timestamp(img->get_tai_timestamp());
+    }
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+    if (img->has_gimi_sample_content_id()) {
+      scaled->set_gimi_sample_content_id(img->get_gimi_sample_content_id());
+    }
+#endif
+
+    img = std::move(scaled);
+  }
+
+  return m_heif_context->convert_to_output_colorspace(img, out_colorspace, out_chroma, options);
+}
+
+
+Result<std::vector<Track_Visual::DecodedSample>> Track_Visual::decode_sync_samples(uint32_t sample_distance,
+                                                                                   uint32_t max_images,
+                                                                                   uint32_t max_width,
+                                                                                   uint32_t max_height,
+                                                                                   heif_colorspace out_colorspace,
+                                                                                   heif_chroma out_chroma,
+                                                                                   const struct heif_decoding_options& options)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  stop_lookahead();
+#endif
+
+  uint32_t num_samples = get_number_of_samples();
+
+  // After a seek, the track position is the seek target, not the sync sample at which decoding would restart.
+  uint32_t position = std::max(m_next_sample_to_be_processed, m_seek_target_sample);
+
+  // --- select the sync samples
+
+  std::vector<SampleToDecode> samples;
+  std::vector<std::pair<uint64_t, uint64_t>> file_ranges;
+
+  while (samples.size() < max_images && position < num_samples) {
+    uint32_t sync_sample = get_sync_sample_at_or_after(position);
+    if (sync_sample >= num_samples) {
+      position = num_samples;
+      break;
+    }
+
+    size_t chunk_idx = find_chunk_for_sample(sync_sample);
+    if (chunk_idx >= m_chunks.size()) {
+      position = num_samples;
+      break;
+    }
+
+    SampleToDecode sample;
+    sample.chunk = m_chunks[chunk_idx];
+    sample.sample_idx = sync_sample;
+    samples.push_back(sample);
+
+    uint64_t offset = sample.chunk->get_file_offset_for_sample(sync_sample);
+    file_ranges.emplace_back(offset, offset + sample.chunk->get_sample_size(sync_sample));
+
+    position = static_cast<uint32_t>(std::min(uint64_t{sync_sample} + std::max(sample_distance, uint32_t{1}),
+                                              uint64_t{num_samples}));
+  }
+
+  if (Error err = seek_to_sample(position)) {
+    return err;
+  }
+
+  if (samples.empty()) {
+    return Error{heif_error_End_of_sequence,
+                 heif_suberror_Unspecified,
+                 "End of sequence"};
+  }
+
+  // --- output size, keeping the aspect ratio and never scaling up
+
+  uint32_t out_width = 0;
+  uint32_t out_height = 0;
+
+  heif_decoding_options sample_options = options;
+  sample_options.target_scale_denominator = 1;
+
+  if (max_width != 0 && max_height != 0 && m_width != 0 && m_height != 0) {
+    out_width = m_width;
+    out_height = m_height;
+
+    if (m_width > max_width || m_height > max_height) {
+      if (uint64_t{m_width} * max_height <= uint64_t{m_height} * max_width) {
+        out_height = max_height;
+        out_width = std::max(uint32_t{1}, static_cast<uint32_t>(uint64_t{m_width} * max_height / m_height));
+      }
+      else {
+        out_width = max_width;
+        out_height = std::max(uint32_t{1}, static_cast<uint32_t>(uint64_t{m_height} * max_width / m_width));
+      }
+    }
+
+    // Let the decoder skip the resolution that would be discarded by the scaling anyway.
+    for (uint32_t d = 2; d <= 8; d *= 2) {
+      if ((m_width + d - 1) / d < out_width || (m_height + d - 1) / d < out_height) {
+        break;
+      }
+      sample_options.target_scale_denominator = static_cast<uint8_t>(d);
+    }
+  }
+
+  // --- read the data of the selected samples with as few requests as possible
+
+  get_file()->fetch_file_ranges(std::move(file_ranges));
+
+  // --- decode the samples. Each sync sample can be decoded on its own.
+
+  std::vector<Result<std::shared_ptr<HeifPixelImage>>> results(samples.size());
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  {
+    TaskGroup tasks;
+
+    for (size_t i = 0; i < samples.size(); i++) {
+      tasks.run([&, i]() {
+        results[i] = decode_sync_sample(samples[i], out_width, out_height, out_colorspace, out_chroma,
+                                        sample_options, samples.size());
+      });
+    }
+  }
+#else
+  for (size_t i = 0; i < samples.size(); i++) {
+    results[i] = decode_sync_sample(samples[i], out_width, out_height, out_colorspace, out_chroma, sample_options, 1);
+  }
+#endif
+
+  std::vector<DecodedSample> decoded(samples.size());
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (results[i].error) {
+      return results[i].error;
+    }
+
+    decoded[i].sample_idx = samples[i].sample_idx;
+    decoded[i].image = std::move(*results[i]);
+  }
+
+  return decoded;
+}
+
+
+Error Track_Visual::set_sample_properties(const std::shared_ptr<HeifPixelImage>& image, uint32_t sample_idx) const
+{
+  if (m_stts) {
+    image->set_sample_duration(m_stts->get_sample_duration(sample_idx));
+  }
+
+  // --- read sample auxiliary data
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+  if (m_aux_reader_content_ids) {
+    auto readResult = m_aux_reader_content_ids->get_sample_info(get_file().get(), sample_idx);
+    if (readResult.error) {
+      return readResult.error;
+    }
+
+    Result<std::string> convResult = vector_to_string(readResult.value);
+    if (convResult.error) {
+      return convResult.error;
+    }
+
+    image->set_gimi_sample_content_id(convResult.value);
+  }
+#endif
+
+  heif_tai_timestamp_packet tai;
+  auto taiResult = read_tai_timestamp(sample_idx, &tai);
+  if (taiResult.error) {
+    return taiResult.error;
+  }
+
+  if (*taiResult) {
+    image->set_tai_timestamp(&tai);
+  }
+
+  return Error::Ok;
+}
+
+
+Result<std::shared_ptr<HeifPixelImage>> Track_Visual::decode_next_image(heif_colorspace out_colorspace,
+                                                                        heif_chroma out_chroma,
+                                                                        const struct heif_decoding_options& options)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::unique_lock<std::mutex> lock(m_lookahead_mutex);
+
+  if (m_lookahead_depth > 0 || m_lookahead_task_running || !m_decoded_frames.empty()) {
+    auto parameters = std::make_shared<const DecodingParameters>(out_colorspace, out_chroma, options);
+
+    // The following images will be converted with the parameters of this call.
+    m_lookahead_parameters = parameters;
+
+    if (m_decoded_frames.empty() && !m_lookahead_end_reached) {
+      start_lookahead_task(lock);
+    }
+
+    // This blocks without helping the thread pool. That is fine, since we are called by the application and not from a pool task.
+    m_lookahead_cond.wait(lock, [this]() { return !m_decoded_frames.empty() || !m_lookahead_task_running; });
+  }
+
+  // When the queue is still empty, the look-ahead has been switched off or reached the end of the sequence.
+  // Continue with the synchronous decoding below, which also reports the end of the sequence.
+
+  if (!m_decoded_frames.empty()) {
+    auto parameters = m_lookahead_parameters;
+
+    DecodedFrame frame = std::move(m_decoded_frames.front());
+    m_decoded_frames.pop_front();
+
+    // refill the queue while the caller processes this image
+    if (!m_lookahead_end_reached) {
+      start_lookahead_task(lock);
+    }
+
+    lock.unlock();
+
+    if (frame.error) {
+      return frame.error;
+    }
+
+    if (frame.converted_image && frame.parameters->has_same_conversion(*parameters)) {
+      return frame.converted_image;
+    }
+
+    return m_heif_context->convert_to_output_colorspace(frame.decoded_image, out_colorspace, out_chroma, options);
+  }
+
+  lock.unlock();
+#endif
+
+  auto decodingResult = decode_next_image_sample(options);
+  if (decodingResult.error) {
+    return decodingResult.error;
+  }
+
+  return m_heif_context->convert_to_output_colorspace(*decodingResult, out_colorspace, out_chroma, options);
+}
+
+
+void Track_Visual::set_decoding_lookahead(uint32_t num_frames)
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  // Without worker threads, decoding ahead would only delay the current image.
+  if (ThreadPool::global().get_num_threads() == 0) {
+    num_frames = 0;
+  }
+
+  std::lock_guard<std::mutex> lock(m_lookahead_mutex);
+  m_lookahead_depth = num_frames;
+#else
+  (void) num_frames;
+#endif
+}
+
+
+bool Track_Visual::end_of_sequence_reached() const
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  std::lock_guard<std::mutex> lock(m_lookahead_mutex);
+
+  if (!m_decoded_frames.empty()) {
+    return false;
+  }
+
+  if (m_lookahead_task_running) {
+    // The decoded image will end up in the queue. Or the task notices the end of the sequence.
+    return false;
+  }
+#endif
+
+  return all_images_output();
+}
+
+
+#if ENABLE_MULTITHREADING_SUPPORT
+
+Track_Visual::DecodingParameters::DecodingParameters(heif_colorspace in_colorspace, heif_chroma in_chroma,
+                                                     const heif_decoding_options& in_options)
+    : colorspace(in_colorspace), chroma(in_chroma), options(in_options)
+{
+  // The callbacks and their user data may not be valid anymore when the image is decoded in the background.
+  options.start_progress = nullptr;
+  options.on_progress = nullptr;
+  options.end_progress = nullptr;
+  options.progress_user_data = nullptr;
 
-  // Find sequence resolution
+  if (options.version >= 6) {
+    options.cancel_decoding = nullptr;
+  }
 
-  if (!chunk_offsets.empty())  {
-    auto* s2c = m_stsc->get_chunk(static_cast<uint32_t>(1));
-    if (!s2c) {
-      return;
-    }
+  if (options.version >= 4 && options.decoder_id) {
+    decoder_id = options.decoder_id;
+    options.decoder_id = decoder_id.c_str();
+  }
 
-    Box_stsc::SampleToChunk sampleToChunk = *s2c;
+  if (options.version >= 7 && options.color_conversion_options_ext) {
+    // normalize, since the struct passed in may be of an older (smaller) version
+    color_conversion_options_ext = normalize_options(options.color_conversion_options_ext);
+    options.color_conversion_options_ext = &color_conversion_options_ext;
+  }
+}
 
-    auto sample_description = m_stsd->get_sample_entry(sampleToChunk.sample_description_index - 1);
-    if (!sample_description) {
-      return; // TODO
+
+bool Track_Visual::DecodingParameters::has_same_conversion(const DecodingParameters& b) const
+{
+  if (colorspace != b.colorspace || chroma != b.chroma) {
+    return false;
+  }
+
+  if (options.version != b.options.version ||
+      options.convert_hdr_to_8bit != b.options.convert_hdr_to_8bit) {
+    return false;
+  }
+
+  if (options.version >= 5) {
+    const auto& c1 = options.color_conversion_options;
+    const auto& c2 = b.options.color_conversion_options;
+    if (c1.preferred_chroma_downsampling_algorithm != c2.preferred_chroma_downsampling_algorithm ||
+        c1.preferred_chroma_upsampling_algorithm != c2.preferred_chroma_upsampling_algorithm ||
+        c1.only_use_preferred_chroma_algorithm != c2.only_use_preferred_chroma_algorithm) {
+      return false;
     }
+  }
 
-    auto visual_sample_description = std::dynamic_pointer_cast<const Box_VisualSampleEntry>(sample_description);
-    if (!visual_sample_description) {
-      return; // TODO
+  if (options.version >= 7) {
+    if ((options.color_conversion_options_ext == nullptr) != (b.options.color_conversion_options_ext == nullptr)) {
+      return false;
     }
 
-    m_width = visual_sample_description->get_VisualSampleEntry_const().width;
-    m_height = visual_sample_description->get_VisualSampleEntry_const().height;
+    if (options.color_conversion_options_ext) {
+      const auto& e1 = color_conversion_options_ext;
+      const auto& e2 = b.color_conversion_options_ext;
+      if (e1.alpha_composition_mode != e2.alpha_composition_mode ||
+          e1.background_red != e2.background_red ||
+          e1.background_green != e2.background_green ||
+          e1.background_blue != e2.background_blue ||
+          e1.secondary_background_red != e2.secondary_background_red ||
+          e1.secondary_background_green != e2.secondary_background_green ||
+          e1.secondary_background_blue != e2.secondary_background_blue ||
+          e1.checkerboard_square_size != e2.checkerboard_square_size ||
+          e1.max_threads != e2.max_threads) {
+        return false;
+      }
+    }
   }
+
+  return true;
 }
 
 
-Track_Visual::Track_Visual(HeifContext* ctx, uint32_t track_id, uint16_t width, uint16_t height,
-                           heif_track_info* info, uint32_t handler_type)
-    : Track(ctx, track_id, info, handler_type)
+void Track_Visual::start_lookahead_task(std::unique_lock<std::mutex>& lock)
 {
-  m_tkhd->set_resolution(width, height);
-  //m_hdlr->set_handler_type(handler_type);  already done in Track()
+  if (m_lookahead_task_running || m_decoded_frames.size() >= m_lookahead_depth) {
+    return;
+  }
 
-  auto vmhd = std::make_shared<Box_vmhd>();
-  m_minf->append_child_box(vmhd);
+  m_lookahead_task_running = true;
+
+  // Submit without holding the lock. Without worker threads, the pool runs the task immediately in this thread.
+  lock.unlock();
+  m_lookahead_tasks.run([this]() { run_lookahead(); });
+  lock.lock();
 }
 
 
-Result<std::shared_ptr<HeifPixelImage>> Track_Visual::decode_next_image_sample(const struct heif_decoding_options& options)
+void Track_Visual::stop_lookahead()
 {
-  if (m_current_chunk > m_chunks.size()) {
-    return Error{heif_error_End_of_sequence,
-                 heif_suberror_Unspecified,
-                 "End of sequence"};
+  {
+    std::lock_guard<std::mutex> lock(m_lookahead_mutex);
+    m_lookahead_stop = true;
   }
 
-  while (m_next_sample_to_be_processed > m_chunks[m_current_chunk]->last_sample_number()) {
-    m_current_chunk++;
+  // Helps executing the pool tasks while waiting, in case the look-ahead task is still queued.
+  m_lookahead_tasks.wait();
 
-    if (m_current_chunk > m_chunks.size()) {
-      return Error{heif_error_End_of_sequence,
-                   heif_suberror_Unspecified,
-                   "End of sequence"};
-    }
-  }
+  std::lock_guard<std::mutex> lock(m_lookahead_mutex);
 
-  const std::shared_ptr<Chunk>& chunk = m_chunks[m_current_chunk];
+  m_lookahead_stop = false;
+
+  m_decoded_frames.clear();
+  m_lookahead_end_reached = false;
+}
 
-  auto decoder = chunk->get_decoder();
-  assert(decoder);
 
-  decoder->set_data_extent(chunk->get_data_extent_for_sample(m_next_sample_to_be_processed));
+Track_Visual::DecodedFrame Track_Visual::convert_decoded_frame(Result<std::shared_ptr<HeifPixelImage>> decodingResult,
+                                                               const std::shared_ptr<const DecodingParameters>& parameters)
+{
+  DecodedFrame frame;
 
-  Result<std::shared_ptr<HeifPixelImage>> decodingResult = decoder->decode_single_frame_from_compressed_data(options);
   if (decodingResult.error) {
-    m_next_sample_to_be_processed++;
-    return decodingResult.error;
+    frame.error = decodingResult.error;
+    return frame;
   }
 
-  auto image = decodingResult.value;
+  frame.decoded_image = *decodingResult;
 
-  if (m_stts) {
-    image->set_sample_duration(m_stts->get_sample_duration(m_next_sample_to_be_processed));
+  auto conversionResult = m_heif_context->convert_to_output_colorspace(frame.decoded_image,
+                                                                       parameters->colorspace,
+                                                                       parameters->chroma,
+                                                                       parameters->options);
+  // On error, the conversion is repeated (with the parameters of the caller) when the image is requested.
+  if (!conversionResult.error) {
+    frame.converted_image = *conversionResult;
+    frame.parameters = parameters;
   }
 
-  // --- read sample auxiliary data
+  return frame;
+}
 
-#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
-  if (m_aux_reader_content_ids) {
-    auto readResult = m_aux_reader_content_ids->get_sample_info(get_file().get(), m_next_sample_to_be_processed);
-    if (readResult.error) {
-      return readResult.error;
+
+std::vector<Track_Visual::DecodedFrame> Track_Visual::decode_frames_ahead(const std::shared_ptr<const DecodingParameters>& parameters,
+                                                                         size_t max_frames)
+{
+  std::vector<DecodedFrame> frames;
+
+  init_sample_decoding(parameters->options);
+
+  // Samples before a seek target are decoded and dropped by decode_next_image_sample().
+  // Samples that depend on each other or have to be reordered are also decoded one after the other.
+  if (max_frames <= 1 || m_next_sample_to_be_processed < m_seek_target_sample || decodes_samples_sequentially()) {
+    frames.push_back(convert_decoded_frame(decode_next_image_sample(parameters->options), parameters));
+    return frames;
+  }
+
+  // Each sample is decoded with its own decoder instance, starting from its compressed data alone.
+  // Thus, the following samples can be decoded (and converted) in parallel.
+
+  std::vector<SampleToDecode> samples;
+  while (samples.size() < max_frames) {
+    auto sampleResult = take_next_sample();
+    if (sampleResult.error) {
+      break;
     }
 
-    Result<std::string> convResult = vector_to_string(readResult.value);
-    if (convResult.error) {
-      return convResult.error;
+    samples.push_back(*sampleResult);
+  }
+
+  frames.resize(samples.size());
+
+  {
+    TaskGroup tasks;
+
+    for (size_t i = 0; i < samples.size(); i++) {
+      tasks.run([this, &samples, &frames, &parameters, i]() {
+        auto decoder = samples[i].chunk->create_decoder();
+        frames[i] = convert_decoded_frame(decode_sample(samples[i], *decoder, parameters->options, samples.size()),
+                                          parameters);
+      });
     }
+  }
 
-    image->set_gimi_sample_content_id(convResult.value);
+  // Reached the end of the sequence: the last entry reports it.
+  if (samples.size() < max_frames) {
+    frames.push_back(convert_decoded_frame(decode_next_image_sample(parameters->options), parameters));
   }
-#endif
 
-  if (m_aux_reader_tai_timestamps) {
-    auto readResult = m_aux_reader_tai_timestamps->get_sample_info(get_file().get(), m_next_sample_to_be_processed);
-    if (readResult.error) {
-      return readResult.error;
+  return frames;
+}
+
+
+void Track_Visual::run_lookahead()
+{
+  for (;;) {
+    std::shared_ptr<const DecodingParameters> parameters;
+    size_t max_frames;
+
+    {
+      std::lock_guard<std::mutex> lock(m_lookahead_mutex);
+
+      if (m_lookahead_stop || m_decoded_frames.size() >= m_lookahead_depth || all_images_output()) {
+        m_lookahead_end_reached = all_images_output();
+        m_lookahead_task_running = false;
+        m_lookahead_cond.notify_all();
+        return;
+      }
+
+      parameters = m_lookahead_parameters;
+
+      // Decode as many frames in parallel as there are decoding threads, but not more than we may queue.
+      max_frames = std::min(m_lookahead_depth - m_decoded_frames.size(),
+                            (size_t) std::max(m_heif_context->get_max_decoding_threads(), 1));
     }
 
-    auto resultTai = Box_itai::decode_tai_from_vector(readResult.value);
-    if (resultTai.error) {
-      return resultTai.error;
+    std::vector<DecodedFrame> frames = decode_frames_ahead(parameters, max_frames);
+
+    std::lock_guard<std::mutex> lock(m_lookahead_mutex);
+
+    bool end_of_sequence = false;
+
+    for (auto& frame : frames) {
+      end_of_sequence = (frame.error.error_code == heif_error_End_of_sequence);
+
+      m_decoded_frames.push_back(std::move(frame));
     }
 
-    image->set_tai_timestamp(&resultTai.value);
+    m_lookahead_cond.notify_all();
+
+    if (end_of_sequence) {
+      m_lookahead_end_reached = true;
+      m_lookahead_task_running = false;
+      return;
+    }
   }
+}
 
-  m_next_sample_to_be_processed++;
+#endif
 
-  return image;
+
+static std::shared_ptr<Box_VisualSampleEntry> create_sample_description_box(const std::shared_ptr<Encoder>& encoder,
+                                                                           const Encoder::CodedImageData& data,
+                                                                           uint32_t width, uint32_t height)
+{
+  auto sample_description_box = encoder->get_sample_description_box(data);
+  VisualSampleEntry& visualSampleEntry = sample_description_box->get_VisualSampleEntry();
+  visualSampleEntry.width = static_cast<uint16_t>(width);
+  visualSampleEntry.height = static_cast<uint16_t>(height);
+
+  auto ccst = std::make_shared<Box_ccst>();
+  ccst->set_coding_constraints(data.codingConstraints);
+  sample_description_box->append_child_box(ccst);
+
+  return sample_description_box;
 }
 
 
@@ -157,6 +995,18 @@ Error Track_Visual::encode_image(std::shared_ptr<HeifPixelImage> image,
             "Input image resolution too high"};
   }
 
+  if (m_sequence_ended) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "Cannot add images after the end of the sequence."};
+  }
+
+  if (m_sequence_encoder && m_sequence_encoder != h_encoder) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "The encoder cannot be changed while encoding a sequence with inter-frame prediction."};
+  }
+
   // === generate compressed image bitstream
 
   // generate new chunk for first image or when compression formats don't match
@@ -164,6 +1014,13 @@ Error Track_Visual::encode_image(std::shared_ptr<HeifPixelImage> image,
   bool add_sample_description = false;
 
   if (m_chunks.empty() || m_chunks.back()->get_compression_format() != h_encoder->plugin->compression_format) {
+#if ENABLE_MULTITHREADING_SUPPORT
+    // the frames still being encoded belong to the previous chunk
+    if (Error err = write_parallel_encoded_frames(0)) {
+      return err;
+    }
+#endif
+
     add_chunk(h_encoder->plugin->compression_format);
     add_sample_description = true;
   }
@@ -191,6 +1048,28 @@ Error Track_Visual::encode_image(std::shared_ptr<HeifPixelImage> image,
 
   std::shared_ptr<HeifPixelImage> colorConvertedImage = srcImageResult.value;
 
+  // --- encode with inter-frame prediction (the sequence encoding is started with the first image of the chunk)
+
+  if (add_sample_description &&
+      m_track_info && m_track_info->gop_structure != heif_sequence_gop_structure_intra_only &&
+      encoder->supports_sequence_encoding(h_encoder)) {
+    if (Error err = start_sequence_encoding(h_encoder, colorConvertedImage)) {
+      return err;
+    }
+  }
+
+  if (m_sequence_encoder) {
+    return push_sequence_frame(image, colorConvertedImage, input_class);
+  }
+
+  // --- the images are coded independently, encode several of them in parallel
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (m_heif_context->get_max_encoding_threads() > 1) {
+    return encode_image_in_parallel(image, colorConvertedImage, h_encoder, options, input_class, add_sample_description);
+  }
+#endif
+
   // --- encode image
 
   Result<Encoder::CodedImageData> encodeResult = encoder->encode(colorConvertedImage, h_encoder, options, input_class);
@@ -198,33 +1077,353 @@ Error Track_Visual::encode_image(std::shared_ptr<HeifPixelImage> image,
     return encodeResult.error;
   }
 
-  const Encoder::CodedImageData& data = encodeResult.value;
+  return write_coded_image(encoder, encodeResult.value, image, colorConvertedImage, add_sample_description);
+}
 
 
+Error Track_Visual::write_coded_image(const std::shared_ptr<Encoder>& encoder,
+                                      const Encoder::CodedImageData& data,
+                                      const std::shared_ptr<HeifPixelImage>& image,
+                                      const std::shared_ptr<HeifPixelImage>& colorConvertedImage,
+                                      bool add_sample_description)
+{
   // --- generate SampleDescriptionBox
 
   if (add_sample_description) {
-    auto sample_description_box = encoder->get_sample_description_box(data);
-    VisualSampleEntry& visualSampleEntry = sample_description_box->get_VisualSampleEntry();
-    visualSampleEntry.width = static_cast<uint16_t>(colorConvertedImage->get_width());
-    visualSampleEntry.height = static_cast<uint16_t>(colorConvertedImage->get_height());
+    if (Error err = set_sample_description_box(create_sample_description_box(encoder, data,
+                                                                              colorConvertedImage->get_width(),
+                                                                              colorConvertedImage->get_height()))) {
+      return err;
+    }
+  }
+
+  return write_sample_data(data.bitstream,
+                           colorConvertedImage->get_sample_duration(),
+                           data.is_sync_frame,
+                           image->get_tai_timestamp(),
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+                           image->has_gimi_sample_content_id() ? image->get_gimi_sample_content_id() : std::string{});
+#else
+                           std::string{});
+#endif
+}
+
+
+#if ENABLE_MULTITHREADING_SUPPORT
+Error Track_Visual::encode_image_in_parallel(const std::shared_ptr<HeifPixelImage>& image,
+                                             const std::shared_ptr<HeifPixelImage>& colorConvertedImage,
+                                             struct heif_encoder* h_encoder,
+                                             const struct heif_encoding_options& options,
+                                             heif_image_input_class input_class,
+                                             bool add_sample_description)
+{
+  const auto max_frames = static_cast<size_t>(m_heif_context->get_max_encoding_threads());
+
+  // The encoder copies are made from the first encoder passed in. Start over when the caller switches encoders.
+
+  if (h_encoder != m_parallel_encoding_source) {
+    if (Error err = write_parallel_encoded_frames(0)) {
+      return err;
+    }
+
+    m_parallel_encoders.clear();
+    m_idle_parallel_encoders.clear();
+    m_parallel_encoding_source = h_encoder;
+  }
+
+  // make room in the queue
+
+  if (Error err = write_parallel_encoded_frames(max_frames - 1)) {
+    return err;
+  }
+
+  auto frame = std::make_shared<ParallelEncodedFrame>();
+  frame->encoder = m_chunks.back()->get_encoder();
+  frame->image = image;
+  frame->colorConvertedImage = colorConvertedImage;
+  frame->options = options;
+  frame->options.output_nclx_profile = nullptr; // only used by the color conversion, which is done already
+  frame->input_class = input_class;
+  frame->add_sample_description = add_sample_description;
+
+  {
+    std::lock_guard<std::mutex> lock(m_parallel_encoding_mutex);
+
+    // Each frame that is being encoded needs its own encoder instance.
+
+    if (m_parallel_encoders.size() <= m_parallel_encoded_frames.size()) {
+      auto cloneResult = h_encoder->clone();
+      if (cloneResult.error) {
+        return cloneResult.error;
+      }
+
+      // Divide the thread budget between the encoders, as for grid tiles.
+
+      int thread_budget = m_heif_context->get_encoding_thread_budget();
+      if (thread_budget == 0) {
+        thread_budget = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+      }
+
+      if (thread_budget > 0) {
+        (*cloneResult)->set_threads_parameter(std::max(1, thread_budget / static_cast<int>(max_frames)));
+      }
+
+      m_parallel_encoders.push_back(*cloneResult);
+      m_idle_parallel_encoders.push_back(*cloneResult);
+    }
+
+    m_parallel_encoded_frames.push_back(frame);
+  }
+
+  m_parallel_encoding_tasks.run([this, frame]() {
+    std::shared_ptr<heif_encoder> encoder;
+    {
+      std::lock_guard<std::mutex> lock(m_parallel_encoding_mutex);
+      encoder = m_idle_parallel_encoders.back();
+      m_idle_parallel_encoders.pop_back();
+    }
+
+    auto encodeResult = frame->encoder->encode(frame->colorConvertedImage, encoder.get(), frame->options, frame->input_class);
+
+    std::lock_guard<std::mutex> lock(m_parallel_encoding_mutex);
+
+    if (encodeResult.error) {
+      frame->error = encodeResult.error;
+    }
+    else {
+      frame->data = std::move(encodeResult.value);
+    }
+
+    frame->finished = true;
+    m_idle_parallel_encoders.push_back(encoder);
+    m_parallel_encoding_cond.notify_all();
+  });
+
+  // write the frames that are already finished
+
+  return write_parallel_encoded_frames(max_frames);
+}
+
+
+Error Track_Visual::write_parallel_encoded_frames(size_t max_pending)
+{
+  std::unique_lock<std::mutex> lock(m_parallel_encoding_mutex);
+
+  // After an error, the remaining frames are dropped.
+  Error error;
+
+  while (!m_parallel_encoded_frames.empty()) {
+    std::shared_ptr<ParallelEncodedFrame> frame = m_parallel_encoded_frames.front();
+
+    if (!frame->finished) {
+      if (!error && m_parallel_encoded_frames.size() <= max_pending) {
+        break;
+      }
+
+      m_parallel_encoding_cond.wait(lock, [&frame]() { return frame->finished; });
+    }
+
+    m_parallel_encoded_frames.pop_front();
+
+    if (error) {
+      continue;
+    }
+
+    lock.unlock();
+
+    if (frame->error) {
+      error = frame->error;
+    }
+    else {
+      error = write_coded_image(frame->encoder, frame->data, frame->image, frame->colorConvertedImage,
+                                frame->add_sample_description);
+    }
+
+    lock.lock();
+  }
+
+  return error;
+}
+#endif
+
+
+Error Track_Visual::start_sequence_encoding(struct heif_encoder* h_encoder,
+                                            const std::shared_ptr<HeifPixelImage>& first_image)
+{
+  heif_sequence_encoding_options seq_options;
+  seq_options.version = 1;
+  seq_options.gop_structure = m_track_info->gop_structure;
+  seq_options.keyframe_distance_min = m_track_info->keyframe_distance_min;
+  seq_options.keyframe_distance_max = m_track_info->keyframe_distance_max;
+  seq_options.framerate_numerator = get_timescale();
+  seq_options.framerate_denominator = std::max(first_image->get_sample_duration(), uint32_t(1));
+
+  if (Error err = m_chunks.back()->get_encoder()->start_sequence_encoding(h_encoder, seq_options)) {
+    return err;
+  }
+
+  m_sequence_encoder = h_encoder;
+  m_sequence_frame_width = static_cast<uint16_t>(first_image->get_width());
+  m_sequence_frame_height = static_cast<uint16_t>(first_image->get_height());
+
+  return Error::Ok;
+}
 
-    auto ccst = std::make_shared<Box_ccst>();
-    ccst->set_coding_constraints(data.codingConstraints);
-    sample_description_box->append_child_box(ccst);
 
-    set_sample_description_box(sample_description_box);
+Error Track_Visual::push_sequence_frame(const std::shared_ptr<HeifPixelImage>& image,
+                                        const std::shared_ptr<HeifPixelImage>& colorConvertedImage,
+                                        heif_image_input_class input_class)
+{
+  SequenceFrameInfo info;
+  info.duration = colorConvertedImage->get_sample_duration();
+
+  if (!m_sequence_frames.empty()) {
+    info.presentation_time = m_sequence_frames.back().presentation_time + m_sequence_frames.back().duration;
+  }
+
+  if (const heif_tai_timestamp_packet* tai = image->get_tai_timestamp()) {
+    info.has_tai = true;
+    info.tai = *tai;
   }
 
-  write_sample_data(data.bitstream,
-                    colorConvertedImage->get_sample_duration(),
-                    data.is_sync_frame,
-                    image->get_tai_timestamp(),
 #if HEIF_ENABLE_EXPERIMENTAL_FEATURES
-                    image->has_gimi_sample_content_id() ? image->get_gimi_sample_content_id() : std::string{});
+  if (image->has_gimi_sample_content_id()) {
+    info.gimi_contentID = image->get_gimi_sample_content_id();
+  }
+#endif
+
+  m_sequence_frames.push_back(info);
+
+  auto encoder = m_chunks.back()->get_encoder();
+
+  if (Error err = encoder->encode_sequence_frame(colorConvertedImage, m_sequence_encoder, input_class,
+                                                 m_sequence_frames.size() - 1)) {
+    return err;
+  }
+
+  return write_coded_sequence_frames();
+}
+
+
+Error Track_Visual::write_coded_sequence_frames()
+{
+  auto encoder = m_chunks.back()->get_encoder();
+
+  for (;;) {
+    auto frameResult = encoder->get_coded_sequence_frame(m_sequence_encoder);
+    if (frameResult.error) {
+      return frameResult.error;
+    }
+
+    if (!frameResult.value) {
+      return Error::Ok;
+    }
+
+    const Encoder::CodedSequenceFrame& frame = *frameResult.value;
+
+    if (frame.frame_number >= m_sequence_frames.size() ||
+        m_sequence_frames_written >= m_sequence_frames.size()) {
+      return {heif_error_Encoder_plugin_error,
+              heif_suberror_Unspecified,
+              "Encoder plugin returned a frame that was not passed to it."};
+    }
+
+    if (m_sequence_frames_written == 0) {
+      if (Error err = set_sample_description_box(create_sample_description_box(encoder, frame.data,
+                                                                                m_sequence_frame_width,
+                                                                                m_sequence_frame_height))) {
+        return err;
+      }
+    }
+
+    // The samples are written in decoding order. Sample 'k' gets the duration of the k-th frame in presentation
+    // order such that its decoding time equals the presentation time of that frame. The composition offset
+    // then shifts it to the presentation time of the frame actually coded in this sample.
+
+    SequenceFrameInfo& coded_frame = m_sequence_frames[frame.frame_number];
+    const SequenceFrameInfo& slot = m_sequence_frames[m_sequence_frames_written];
+
+    int64_t composition_offset = static_cast<int64_t>(coded_frame.presentation_time) -
+                                 static_cast<int64_t>(slot.presentation_time);
+    if (composition_offset < std::numeric_limits<int32_t>::min() ||
+        composition_offset > std::numeric_limits<int32_t>::max()) {
+      return {heif_error_Encoding_error,
+              heif_suberror_Unspecified,
+              "Frame reordering delay too large for the track timescale."};
+    }
+
+    if (Error err = write_sample_data(frame.data.bitstream,
+                                      slot.duration,
+                                      frame.data.is_sync_frame,
+                                      coded_frame.has_tai ? &coded_frame.tai : nullptr,
+                                      coded_frame.gimi_contentID,
+                                      static_cast<int32_t>(composition_offset))) {
+      return err;
+    }
+
+    coded_frame.gimi_contentID.clear();
+
+    m_sequence_frames_written++;
+  }
+}
+
+
+Error Track_Visual::encode_end_of_sequence(struct heif_encoder* h_encoder)
+{
+  if (!m_sequence_encoder) {
+    // the images are coded independently, only those encoded in parallel may still be pending
+    m_sequence_ended = true;
+
+#if ENABLE_MULTITHREADING_SUPPORT
+    return write_parallel_encoded_frames(0);
 #else
-  std::string{});
+    return Error::Ok;
 #endif
+  }
+
+  if (h_encoder != m_sequence_encoder) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "The end of the sequence has to be signaled with the encoder that coded the sequence."};
+  }
+
+  auto encoder = m_chunks.back()->get_encoder();
+
+  if (Error err = encoder->end_sequence_encoding(m_sequence_encoder)) {
+    return err;
+  }
+
+  if (Error err = write_coded_sequence_frames()) {
+    return err;
+  }
+
+  if (m_sequence_frames_written != m_sequence_frames.size()) {
+    return {heif_error_Encoder_plugin_error,
+            heif_suberror_Unspecified,
+            "Encoder plugin did not return all frames of the sequence."};
+  }
+
+  m_sequence_encoder = nullptr;
+  m_sequence_ended = true;
+  m_sequence_frames.clear();
 
   return Error::Ok;
 }
+
+
+Error Track_Visual::finalize_track()
+{
+#if ENABLE_MULTITHREADING_SUPPORT
+  if (Error err = write_parallel_encoded_frames(0)) {
+    return err;
+  }
+#endif
+
+  if (m_sequence_encoder) {
+    return {heif_error_Usage_error,
+            heif_suberror_Unspecified,
+            "heif_track_encode_end_of_sequence() has to be called after the last image of a track with inter-frame prediction."};
+  }
+
+  return Track::finalize_track();
+}
@@ -22,10 +22,19 @@
 #define LIBHEIF_TRACK_VISUAL_H
 
 #include "track.h"
+#include "codecs/encoder.h"
 #include <string>
+#include <map>
 #include <memory>
 #include <vector>
 
+#if ENABLE_MULTITHREADING_SUPPORT
+#include "thread_pool.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#endif
+
 
 class Track_Visual : public Track {
 public:
@@ -36,7 +45,7 @@ public:
 
   Track_Visual(HeifContext* ctx, const std::shared_ptr<Box_trak>&); // when reading the file
 
-  ~Track_Visual() override = default;
+  ~Track_Visual() override;
 
   uint16_t get_width() const { return m_width; }
 
@@ -44,14 +53,257 @@ public:
 
   Result<std::shared_ptr<HeifPixelImage>> decode_next_image_sample(const struct heif_decoding_options& options);
 
+  // Decodes the next image and converts it to the output colorspace.
+  // With look-ahead enabled, the following images are decoded and converted in the background while
+  // the caller processes this image.
+  Result<std::shared_ptr<HeifPixelImage>> decode_next_image(heif_colorspace out_colorspace,
+                                                            heif_chroma out_chroma,
+                                                            const struct heif_decoding_options& options);
+
+  // Maximum number of images that are decoded ahead. 0 disables look-ahead.
+  void set_decoding_lookahead(uint32_t num_frames);
+
+  bool end_of_sequence_reached() const override;
+
+  struct DecodedSample
+  {
+    uint32_t sample_idx = 0;
+    std::shared_ptr<HeifPixelImage> image;
+  };
+
+  // Decodes up to 'max_images' sync samples, starting at the track position. Each selected sample is at least
+  // 'sample_distance' samples after the previous one. The data of the other samples is not read.
+  // The images are scaled down to fit into max_width x max_height (0 x 0: full resolution).
+  // Afterwards, the track is positioned where the selection of the next call starts.
+  // Returns heif_error_End_of_sequence if there is no further sync sample.
+  Result<std::vector<DecodedSample>> decode_sync_samples(uint32_t sample_distance, uint32_t max_images,
+                                                         uint32_t max_width, uint32_t max_height,
+                                                         heif_colorspace out_colorspace, heif_chroma out_chroma,
+                                                         const struct heif_decoding_options& options);
+
+  // Positions the track at the preceding sync sample. The samples up to 'sample_idx' are then
+  // decoded (and dropped) with the next decode_next_image_sample().
+  Error seek_to_sample(uint32_t sample_idx) override;
+
   Error encode_image(std::shared_ptr<HeifPixelImage> image,
                      struct heif_encoder* encoder,
                      const struct heif_encoding_options& options,
                      heif_image_input_class image_class);
 
+  // Writes the frames that are still buffered in the encoder when encoding with inter-frame prediction.
+  Error encode_end_of_sequence(struct heif_encoder* encoder);
+
+  Error finalize_track() override;
+
 private:
   uint16_t m_width = 0;
   uint16_t m_height = 0;
+
+  // --- encoding with inter-frame prediction
+
+  // Properties of a frame that are needed when the encoder returns its coded data.
+  struct SequenceFrameInfo
+  {
+    uint32_t duration = 0;
+    uint64_t presentation_time = 0;
+
+    bool has_tai = false;
+    heif_tai_timestamp_packet tai{};
+    std::string gimi_contentID;
+  };
+
+  // Non-NULL while the frames are passed to an encoder with inter-frame prediction.
+  struct heif_encoder* m_sequence_encoder = nullptr;
+  bool m_sequence_ended = false;
+  uint16_t m_sequence_frame_width = 0;
+  uint16_t m_sequence_frame_height = 0;
+
+  // indexed by frame number (presentation order)
+  std::vector<SequenceFrameInfo> m_sequence_frames;
+  uint32_t m_sequence_frames_written = 0;
+
+  Error start_sequence_encoding(struct heif_encoder* encoder, const std::shared_ptr<HeifPixelImage>& first_image);
+
+  Error push_sequence_frame(const std::shared_ptr<HeifPixelImage>& image,
+                            const std::shared_ptr<HeifPixelImage>& colorConvertedImage,
+                            heif_image_input_class input_class);
+
+  // Writes all frames that the encoder has finished.
+  Error write_coded_sequence_frames();
+
+  // Writes an independently coded image as the next sample.
+  Error write_coded_image(const std::shared_ptr<class Encoder>& encoder,
+                          const Encoder::CodedImageData& data,
+                          const std::shared_ptr<HeifPixelImage>& image,
+                          const std::shared_ptr<HeifPixelImage>& colorConvertedImage,
+                          bool add_sample_description);
+
+  // After seeking, the samples before this one are decoded without returning them.
+  uint32_t m_seek_target_sample = 0;
+
+  struct SampleToDecode
+  {
+    std::shared_ptr<class Chunk> chunk;
+    uint32_t sample_idx = 0;
+  };
+
+  // Returns the next sample and advances the track position (returns heif_error_End_of_sequence at the end).
+  Result<SampleToDecode> take_next_sample();
+
+  // Does not change the track position. 'num_parallel_decodes' samples share the codec threads.
+  // Reduced-resolution decoding (target_scale_denominator) is only possible for samples that are decoded independently.
+  Result<std::shared_ptr<HeifPixelImage>> decode_sample(const SampleToDecode& sample, class Decoder& decoder,
+                                                        const struct heif_decoding_options& options,
+                                                        size_t num_parallel_decodes,
+                                                        bool full_resolution = true);
+
+  // Decodes a sync sample with its own decoder and scales it to out_width x out_height (0 x 0: decoded size).
+  Result<std::shared_ptr<HeifPixelImage>> decode_sync_sample(const SampleToDecode& sample,
+                                                             uint32_t out_width, uint32_t out_height,
+                                                             heif_colorspace out_colorspace, heif_chroma out_chroma,
+                                                             const struct heif_decoding_options& options,
+                                                             size_t num_parallel_decodes);
+
+  // Sets the duration and the sample auxiliary information of the decoded image.
+  Error set_sample_properties(const std::shared_ptr<HeifPixelImage>& image, uint32_t sample_idx) const;
+
+  // --- decoding order and presentation order
+
+  // Determines how the samples are decoded. This is done before the first sample is decoded, because the
+  // sample tables of fragmented files are only complete after the movie fragments have been read.
+  void init_sample_decoding(const struct heif_decoding_options& options);
+
+  bool m_sample_decoding_initialized = false;
+
+  // The samples depend on each other (not all samples are sync samples) and the decoder plugin can keep
+  // its state between samples. All samples are then decoded with one decoder instance in decoding order.
+  bool m_use_sequence_decoder = false;
+
+  // Number of decoded images that have to be held back to output the images in presentation order.
+  // It is derived from the composition time offsets ('ctts') and is 0 if the decoding order is the presentation order.
+  uint32_t m_reorder_depth = 0;
+
+  // The images cannot be decoded in parallel by the look-ahead.
+  bool decodes_samples_sequentially() const { return m_use_sequence_decoder || m_reorder_depth > 0; }
+
+  // Returns the next image in the output order of the decoder (returns heif_error_End_of_sequence at the end).
+  Result<DecodedSample> decode_next_sample(const struct heif_decoding_options& options);
+
+  Result<DecodedSample> decode_next_sample_with_sequence_decoder(const struct heif_decoding_options& options);
+
+  std::shared_ptr<class Decoder> m_sequence_decoder;
+  std::shared_ptr<const class Box_VisualSampleEntry> m_sequence_sample_description;
+  bool m_sequence_decoder_flushed = false;
+  uint32_t m_num_samples_in_sequence_decoder = 0;
+
+  // Decoded images that wait for their output, sorted by presentation time.
+  std::multimap<int64_t, std::shared_ptr<HeifPixelImage>> m_reorder_buffer;
+  bool m_all_samples_decoded = false;
+
+  // All images have been returned (including those held back in the decoder and in the reorder buffer).
+  bool all_images_output() const;
+
+  // Drops the decoder state and the images held back (when seeking).
+  void reset_sample_decoding();
+
+#if ENABLE_MULTITHREADING_SUPPORT
+  // A private copy of the decoding parameters that can be used after the API call returned.
+  struct DecodingParameters
+  {
+    heif_colorspace colorspace = heif_colorspace_undefined;
+    heif_chroma chroma = heif_chroma_undefined;
+    heif_decoding_options options{};
+    std::string decoder_id;
+    heif_color_conversion_options_ext color_conversion_options_ext{};
+
+    DecodingParameters(heif_colorspace colorspace, heif_chroma chroma, const heif_decoding_options& options);
+
+    bool has_same_conversion(const DecodingParameters&) const;
+  };
+
+  struct DecodedFrame
+  {
+    Error error;
+    std::shared_ptr<HeifPixelImage> decoded_image;
+
+    // converted with the parameters
+    std::shared_ptr<HeifPixelImage> converted_image;
+    std::shared_ptr<const DecodingParameters> parameters;
+  };
+
+  // Starts the look-ahead task if it is not running and the queue is not full.
+  // 'lock' must hold m_lookahead_mutex. It is released while the task is submitted.
+  void start_lookahead_task(std::unique_lock<std::mutex>& lock);
+
+  void run_lookahead();
+
+  DecodedFrame convert_decoded_frame(Result<std::shared_ptr<HeifPixelImage>> decodingResult,
+                                     const std::shared_ptr<const DecodingParameters>& parameters);
+
+  // Decodes up to 'max_frames' of the following samples in parallel.
+  // The last frame has the heif_error_End_of_sequence error if the end of the sequence was reached.
+  std::vector<DecodedFrame> decode_frames_ahead(const std::shared_ptr<const DecodingParameters>& parameters,
+                                                size_t max_frames);
+
+  // Waits until the look-ahead task has finished and drops all images decoded ahead.
+  void stop_lookahead();
+
+  uint32_t m_lookahead_depth = 0;
+
+  // Everything below is protected by the mutex.
+  // The decoder state (and m_next_sample_to_be_processed) is only accessed by the look-ahead task
+  // while it is running.
+  mutable std::mutex m_lookahead_mutex;
+  std::condition_variable m_lookahead_cond;
+  std::deque<DecodedFrame> m_decoded_frames;
+  std::shared_ptr<const DecodingParameters> m_lookahead_parameters;
+  bool m_lookahead_task_running = false;
+  bool m_lookahead_end_reached = false;
+  bool m_lookahead_stop = false;
+
+  TaskGroup m_lookahead_tasks;
+
+  // --- encoding independent frames in parallel (see heif_context_set_max_encoding_threads())
+
+  struct ParallelEncodedFrame
+  {
+    std::shared_ptr<class Encoder> encoder;
+    std::shared_ptr<HeifPixelImage> image;
+    std::shared_ptr<HeifPixelImage> colorConvertedImage;
+    heif_encoding_options options{};
+    heif_image_input_class input_class = heif_image_input_class_normal;
+    bool add_sample_description = false;
+
+    // set by the encoding task
+    bool finished = false;
+    Error error;
+    Encoder::CodedImageData data;
+  };
+
+  Error encode_image_in_parallel(const std::shared_ptr<HeifPixelImage>& image,
+                                 const std::shared_ptr<HeifPixelImage>& colorConvertedImage,
+                                 struct heif_encoder* encoder,
+                                 const struct heif_encoding_options& options,
+                                 heif_image_input_class input_class,
+                                 bool add_sample_description);
+
+  // Writes the frames at the front of the queue that have been encoded. Waits for the encoding of the frames
+  // until at most 'max_pending' frames are left in the queue.
+  Error write_parallel_encoded_frames(size_t max_pending);
+
+  // Everything below is protected by the mutex.
+  // The frames are queued in the order in which they are written to the track.
+  std::mutex m_parallel_encoding_mutex;
+  std::condition_variable m_parallel_encoding_cond;
+  std::deque<std::shared_ptr<ParallelEncodedFrame>> m_parallel_encoded_frames;
+
+  // Copies of the caller's encoder. There are as many as frames can be encoded at the same time.
+  struct heif_encoder* m_parallel_encoding_source = nullptr;
+  std::vector<std::shared_ptr<heif_encoder>> m_parallel_encoders;
+  std::vector<std::shared_ptr<heif_encoder>> m_idle_parallel_encoders;
+
+  TaskGroup m_parallel_encoding_tasks;
+#endif
 };
 
 
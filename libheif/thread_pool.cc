@@ -0,0 +1,590 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.h"
+
+#if ENABLE_MULTITHREADING_SUPPORT
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <utility>
+
+#if __linux__
+#include <cerrno>
+#include <fstream>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+
+// The pool and queue that the current thread is working for, if it is a worker thread.
+static thread_local ThreadPool* tl_current_pool = nullptr;
+static thread_local size_t tl_current_queue = 0;
+
+// The NUMA node set by ThreadPool::NodeScope (-1: the node of the current thread).
+static thread_local int tl_preferred_numa_node = -1;
+
+static const size_t no_own_queue = std::numeric_limits<size_t>::max();
+
+
+#if __linux__
+// Parses a list of CPUs or nodes like "0-3,8,10-11".
+static std::vector<int> parse_id_list(const std::string& list)
+{
+  std::vector<int> ids;
+
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+      for (int id = first; id <= last; id++) {
+        ids.push_back(id);
+      }
+    }
+    catch (const std::exception&) {
+      return {};
+    }
+
+    pos = end + 1;
+  }
+
+  return ids;
+}
+
+
+// Returns the NUMA node of each CPU, indexed by the CPU number.
+static std::vector<int> read_cpu_numa_nodes()
+{
+  std::vector<int> cpu_nodes;
+
+  std::ifstream online_file("/sys/devices/system/node/online");
+  std::string online;
+  if (!(online_file >> online)) {
+    return cpu_nodes;
+  }
+
+  for (int node : parse_id_list(online)) {
+    std::ifstream cpulist_file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string cpulist;
+    if (!(cpulist_file >> cpulist)) {
+      continue;
+    }
+
+    for (int cpu : parse_id_list(cpulist)) {
+      if (cpu >= static_cast<int>(cpu_nodes.size())) {
+        cpu_nodes.resize(static_cast<size_t>(cpu) + 1, -1);
+      }
+
+      cpu_nodes[static_cast<size_t>(cpu)] = node;
+    }
+  }
+
+  return cpu_nodes;
+}
+#endif
+
+
+static int get_current_cpu()
+{
+#if __linux__
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+
+// Restricts the calling thread to the CPUs and lowers its priority.
+static void apply_worker_placement(const std::vector<int>& cpus, int priority_reduction)
+{
+#if __linux__
+  if (!cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  }
+
+  if (priority_reduction > 0) {
+    // On Linux, the nice value is a property of each thread.
+    auto tid = static_cast<id_t>(syscall(SYS_gettid));
+
+    errno = 0;
+    int nice_value = getpriority(PRIO_PROCESS, tid);
+    if (errno == 0) {
+      setpriority(PRIO_PROCESS, tid, std::min(nice_value + priority_reduction, 19));
+    }
+  }
+#elif defined(_WIN32)
+  if (!cpus.empty()) {
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus) {
+      if (cpu < static_cast<int>(8 * sizeof(DWORD_PTR))) {
+        mask |= DWORD_PTR{1} << cpu;
+      }
+    }
+
+    if (mask) {
+      SetThreadAffinityMask(GetCurrentThread(), mask);
+    }
+  }
+
+  if (priority_reduction > 0) {
+    SetThreadPriority(GetCurrentThread(), priority_reduction >= 10 ? THREAD_PRIORITY_LOWEST : THREAD_PRIORITY_BELOW_NORMAL);
+  }
+#else
+  (void) cpus;
+  (void) priority_reduction;
+#endif
+}
+
+
+ThreadPool::ThreadPool(int num_threads)
+    : m_num_threads(std::max(num_threads, 0))
+{
+  m_queues.push_back(std::make_unique<WorkQueue>());
+  for (int i = 1; i < m_num_threads; i++) {
+    m_queues.push_back(std::make_unique<WorkQueue>());
+  }
+}
+
+
+ThreadPool::NodeScope::NodeScope(int numa_node)
+    : m_previous(tl_preferred_numa_node)
+{
+  tl_preferred_numa_node = numa_node;
+}
+
+
+ThreadPool::NodeScope::~NodeScope()
+{
+  tl_preferred_numa_node = m_previous;
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  stop_workers();
+}
+
+
+ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool(std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+  return pool;
+}
+
+
+void ThreadPool::set_num_threads(int num_threads)
+{
+  num_threads = std::max(num_threads, 0);
+
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
+
+  if (num_threads == m_num_threads) {
+    return;
+  }
+
+  join_workers();
+
+  // Rebuild the queues and keep the tasks that have not been started yet.
+
+  std::unique_lock<std::shared_mutex> queues_lock(m_queues_mutex);
+
+  std::deque<std::function<void()>> remaining_tasks;
+  for (auto& queue : m_queues) {
+    for (auto& task : queue->tasks) {
+      remaining_tasks.push_back(std::move(task));
+    }
+  }
+
+  m_queues.clear();
+  for (int i = 0; i < std::max(num_threads, 1); i++) {
+    m_queues.push_back(std::make_unique<WorkQueue>());
+  }
+
+  m_queues[0]->tasks = std::move(remaining_tasks);
+
+  m_num_threads = num_threads;
+
+  assign_queue_placement();
+}
+
+
+int ThreadPool::get_num_threads() const
+{
+  return m_num_threads;
+}
+
+
+void ThreadPool::set_options(const Options& options)
+{
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
+
+  join_workers();
+
+  std::unique_lock<std::shared_mutex> queues_lock(m_queues_mutex);
+
+  m_options = options;
+
+  m_cpu_numa_nodes.clear();
+#if __linux__
+  if (m_options.numa_aware) {
+    m_cpu_numa_nodes = read_cpu_numa_nodes();
+  }
+#endif
+
+  assign_queue_placement();
+}
+
+
+int ThreadPool::get_numa_node_of_cpu(int cpu) const
+{
+  if (cpu < 0 || cpu >= static_cast<int>(m_cpu_numa_nodes.size())) {
+    return -1;
+  }
+
+  return m_cpu_numa_nodes[static_cast<size_t>(cpu)];
+}
+
+
+void ThreadPool::assign_queue_placement()
+{
+  // m_queues_mutex must be locked exclusively
+
+  for (auto& queue : m_queues) {
+    queue->cpus.clear();
+    queue->numa_node = -1;
+  }
+
+  std::vector<int> cpus = m_options.cpus;
+  if (cpus.empty() && m_options.numa_aware) {
+    for (int cpu = 0; cpu < static_cast<int>(m_cpu_numa_nodes.size()); cpu++) {
+      if (m_cpu_numa_nodes[static_cast<size_t>(cpu)] >= 0) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+
+  if (cpus.empty()) {
+    return;
+  }
+
+  // Each worker may run on all CPUs of its NUMA node. The workers are distributed evenly over the nodes.
+
+  std::map<int, std::vector<int>> node_cpus;
+  for (int cpu : cpus) {
+    node_cpus[m_options.numa_aware ? get_numa_node_of_cpu(cpu) : -1].push_back(cpu);
+  }
+
+  auto node = node_cpus.begin();
+  for (auto& queue : m_queues) {
+    queue->numa_node = node->first;
+    queue->cpus = node->second;
+
+    if (++node == node_cpus.end()) {
+      node = node_cpus.begin();
+    }
+  }
+}
+
+
+size_t ThreadPool::select_queue_for_external_task()
+{
+  // m_queues_mutex must be locked
+
+  if (m_options.numa_aware) {
+    int node = tl_preferred_numa_node;
+    if (node < 0) {
+      node = get_numa_node_of_cpu(get_current_cpu());
+    }
+
+    if (node >= 0) {
+      const size_t num_queues = m_queues.size();
+      const size_t start = m_next_queue++;
+
+      for (size_t i = 0; i < num_queues; i++) {
+        size_t queue_index = (start + i) % num_queues;
+        if (m_queues[queue_index]->numa_node == node) {
+          return queue_index;
+        }
+      }
+    }
+  }
+
+  return m_next_queue++ % m_queues.size();
+}
+
+
+void ThreadPool::stop_workers()
+{
+  std::lock_guard<std::mutex> control_lock(m_control_mutex);
+
+  join_workers();
+}
+
+
+void ThreadPool::start_workers()
+{
+  // m_control_mutex must be locked
+
+  for (int i = 0; i < m_num_threads; i++) {
+    m_workers.emplace_back(&ThreadPool::worker_main, this, static_cast<size_t>(i));
+  }
+}
+
+
+void ThreadPool::join_workers()
+{
+  // m_control_mutex must be locked
+
+  if (m_workers.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    m_stop = true;
+  }
+
+  m_wakeup.notify_all();
+
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+
+  m_workers.clear();
+
+  std::lock_guard<std::mutex> lock(m_sleep_mutex);
+  m_stop = false;
+}
+
+
+void ThreadPool::submit(std::function<void()> task)
+{
+  bool has_workers;
+
+  {
+    std::lock_guard<std::mutex> control_lock(m_control_mutex);
+
+    if (m_num_threads > 0 && m_workers.empty()) {
+      start_workers();
+    }
+
+    has_workers = (m_num_threads > 0);
+  }
+
+  if (!has_workers) {
+    task();
+    return;
+  }
+
+  {
+    std::shared_lock<std::shared_mutex> queues_lock(m_queues_mutex);
+
+    size_t queue_index;
+    if (tl_current_pool == this && tl_current_queue < m_queues.size() &&
+        (tl_preferred_numa_node < 0 || m_queues[tl_current_queue]->numa_node == tl_preferred_numa_node)) {
+      queue_index = tl_current_queue;
+    }
+    else {
+      queue_index = select_queue_for_external_task();
+    }
+
+    WorkQueue& queue = *m_queues[queue_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+
+    // Count the task while it is still locked in its queue. Otherwise, a worker could pop it and decrement
+    // the counter before it was incremented.
+    m_num_queued_tasks++;
+  }
+
+  {
+    // Workers check the counter under m_sleep_mutex before they go to sleep.
+    // Taking the lock here ensures that they either see the new task or receive the notification.
+    std::lock_guard<std::mutex> lock(m_sleep_mutex);
+  }
+
+  m_wakeup.notify_one();
+}
+
+
+bool ThreadPool::pop_task(size_t own_queue, std::function<void()>& out_task)
+{
+  std::shared_lock<std::shared_mutex> queues_lock(m_queues_mutex);
+
+  const size_t num_queues = m_queues.size();
+
+  // Take the most recently added task from our own queue, as its data is probably still in the cache.
+
+  if (own_queue < num_queues) {
+    WorkQueue& queue = *m_queues[own_queue];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      out_task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      m_num_queued_tasks--;
+      return true;
+    }
+  }
+
+  // Steal the oldest task from one of the other queues.
+  // In a NUMA-aware pool, we first try the queues of our own node. The other nodes' tasks are only taken when
+  // there is no work on our node, because an idle worker that does not take a queued task would spin.
+
+  size_t start = (own_queue < num_queues) ? own_queue + 1 : m_next_queue.load();
+
+  int own_node = -1;
+  if (m_options.numa_aware) {
+    own_node = (own_queue < num_queues) ? m_queues[own_queue]->numa_node : tl_preferred_numa_node;
+  }
+
+  for (int pass = (own_node >= 0 ? 0 : 1); pass < 2; pass++) {
+    for (size_t i = 0; i < num_queues; i++) {
+      WorkQueue& queue = *m_queues[(start + i) % num_queues];
+      if (pass == 0 && queue.numa_node != own_node) {
+        continue;
+      }
+
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        out_task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        m_num_queued_tasks--;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+bool ThreadPool::run_pending_task()
+{
+  if (m_num_queued_tasks == 0) {
+    return false;
+  }
+
+  std::function<void()> task;
+  if (!pop_task(tl_current_pool == this ? tl_current_queue : no_own_queue, task)) {
+    return false;
+  }
+
+  task();
+  return true;
+}
+
+
+void ThreadPool::worker_main(size_t queue_index)
+{
+  tl_current_pool = this;
+  tl_current_queue = queue_index;
+
+  {
+    std::shared_lock<std::shared_mutex> queues_lock(m_queues_mutex);
+    apply_worker_placement(m_queues[queue_index]->cpus, m_options.priority_reduction);
+  }
+
+  for (;;) {
+    std::function<void()> task;
+    if (pop_task(queue_index, task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+    m_wakeup.wait(lock, [this]() { return m_stop || m_num_queued_tasks > 0; });
+    if (m_stop) {
+      break;
+    }
+  }
+
+  tl_current_pool = nullptr;
+}
+
+
+void TaskGroup::run(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_num_running++;
+  }
+
+  m_pool.submit([this, task = std::move(task)]() {
+    task();
+
+    // Notify while holding the lock. Otherwise, the waiting thread could destroy the TaskGroup before we call notify.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_num_running == 0) {
+      m_finished.notify_all();
+    }
+  });
+}
+
+
+void TaskGroup::wait()
+{
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_num_running == 0) {
+        return;
+      }
+    }
+
+    if (m_pool.run_pending_task()) {
+      continue;
+    }
+
+    // All queues are empty, i.e. the remaining tasks of this group are currently being executed by other threads.
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [this]() { return m_num_running == 0; });
+    return;
+  }
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_THREAD_POOL_H
+#define LIBHEIF_THREAD_POOL_H
+
+#if ENABLE_MULTITHREADING_SUPPORT
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing thread pool that is shared by all HeifContexts.
+//
+// Each worker thread has its own task queue. Tasks submitted from within a worker are put into the
+// worker's own queue, tasks from other threads are distributed round-robin. Idle workers steal tasks
+// from the other queues.
+//
+// The workers can be pinned to a set of CPUs and run with reduced priority (see Options). A NUMA-aware pool
+// keeps tasks on the NUMA node of the thread that submits them, or on the node of the active NodeScope.
+//
+// Code that waits for tasks should use a TaskGroup. It executes pending tasks while waiting, so that
+// tasks can themselves start and wait for sub-tasks without deadlocking the pool.
+class ThreadPool
+{
+public:
+  // Placement of the worker threads (see heif_thread_pool_options).
+  struct Options
+  {
+    std::vector<int> cpus; // empty: all CPUs
+    int priority_reduction = 0;
+    bool numa_aware = false;
+  };
+
+  explicit ThreadPool(int num_threads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // The pool used by libheif. It defaults to one worker per CPU core.
+  static ThreadPool& global();
+
+  // Must not be called from within one of the pool's tasks.
+  void set_num_threads(int num_threads);
+
+  int get_num_threads() const;
+
+  // Must not be called from within one of the pool's tasks. The workers are restarted with the new options.
+  void set_options(const Options& options);
+
+  // While a NodeScope exists, the tasks submitted from this thread are executed by the workers of this NUMA node
+  // (if the pool is NUMA-aware). Without a scope, the tasks stay on the node of the submitting thread.
+  class NodeScope
+  {
+  public:
+    explicit NodeScope(int numa_node);
+
+    ~NodeScope();
+
+    NodeScope(const NodeScope&) = delete;
+
+    NodeScope& operator=(const NodeScope&) = delete;
+
+  private:
+    int m_previous;
+  };
+
+  // Joins all worker threads. They will be restarted when the next task is submitted.
+  void stop_workers();
+
+  // When the pool has no worker threads, the task is executed immediately in the calling thread.
+  void submit(std::function<void()> task);
+
+  // Executes one queued task in the calling thread. Returns false if there was none.
+  bool run_pending_task();
+
+private:
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+
+    // The worker of this queue runs on these CPUs and on this NUMA node (-1: not restricted / unknown).
+    std::vector<int> cpus;
+    int numa_node = -1;
+  };
+
+  // Assigns the CPUs and NUMA nodes to the queues. m_queues_mutex must be locked exclusively.
+  void assign_queue_placement();
+
+  // The queue for a task submitted from outside of the pool.
+  size_t select_queue_for_external_task();
+
+  int get_numa_node_of_cpu(int cpu) const;
+
+  void start_workers();
+
+  void join_workers();
+
+  void worker_main(size_t queue_index);
+
+  bool pop_task(size_t own_queue, std::function<void()>& out_task);
+
+  std::atomic<int> m_num_threads;
+
+  // Protects m_workers against concurrent start/stop.
+  std::mutex m_control_mutex;
+  std::vector<std::thread> m_workers;
+
+  // Taken exclusively only while the set of queues is rebuilt.
+  std::shared_mutex m_queues_mutex;
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  std::atomic<size_t> m_next_queue{0};
+
+  std::mutex m_sleep_mutex;
+  std::condition_variable m_wakeup;
+  std::atomic<size_t> m_num_queued_tasks{0};
+  bool m_stop = false;
+
+  Options m_options;
+  std::vector<int> m_cpu_numa_nodes; // NUMA node of each CPU, when the pool is NUMA-aware
+};
+
+
+// A set of tasks that can be waited for.
+class TaskGroup
+{
+public:
+  explicit TaskGroup(ThreadPool& pool = ThreadPool::global()) : m_pool(pool) {}
+
+  ~TaskGroup() { wait(); }
+
+  void run(std::function<void()> task);
+
+  // Blocks until all tasks of this group have finished.
+  // While waiting, the calling thread helps executing queued tasks. These may also be tasks of other groups.
+  // Hence, do not call wait() while holding a lock that any task submitted to the pool might acquire.
+  void wait();
+
+private:
+  ThreadPool& m_pool;
+
+  std::mutex m_mutex;
+  std::condition_variable m_finished;
+  size_t m_num_running = 0;
+};
+
+#endif
+
+#endif //LIBHEIF_THREAD_POOL_H
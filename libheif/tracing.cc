@@ -0,0 +1,138 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tracing.h"
+
+#if ENABLE_TRACING
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <typeindex>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+
+struct TraceSink
+{
+  heif_trace_sink sink;
+  void* user_data;
+};
+
+static std::mutex s_sink_mutex;
+
+// Sinks are never freed, because a running TraceScope may still use a replaced one.
+// They are only allocated when the application sets a new sink, which is rare.
+static std::atomic<const TraceSink*> s_current_sink{nullptr};
+
+static std::atomic<uint32_t> s_next_thread_id{1};
+
+static uint32_t current_thread_id()
+{
+  static thread_local uint32_t thread_id = s_next_thread_id++;
+  return thread_id;
+}
+
+static uint64_t microseconds(std::chrono::steady_clock::time_point t)
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count());
+}
+
+
+TraceScope::TraceScope(const char* category, const char* name, uint32_t item_id)
+{
+  if (s_current_sink.load(std::memory_order_acquire)) {
+    m_category = category;
+    m_name = name;
+    m_item_id = item_id;
+    m_start = std::chrono::steady_clock::now();
+  }
+}
+
+
+TraceScope::~TraceScope()
+{
+  if (!m_name) {
+    return;
+  }
+
+  const TraceSink* sink = s_current_sink.load(std::memory_order_acquire);
+  if (!sink) {
+    return;
+  }
+
+  auto end = std::chrono::steady_clock::now();
+
+  heif_trace_event event{};
+  event.version = 1;
+  event.category = m_category;
+  event.name = m_name;
+  event.item_id = m_item_id;
+  event.thread_id = current_thread_id();
+  event.start_us = microseconds(m_start);
+  event.duration_us = microseconds(end) - event.start_us;
+
+  sink->sink.trace_event(&event, sink->user_data);
+}
+
+
+const char* trace_type_name(const std::type_info& type)
+{
+  static std::mutex names_mutex;
+  static std::map<std::type_index, std::string> names;
+
+  std::lock_guard<std::mutex> lock(names_mutex);
+
+  auto iter = names.find(type);
+  if (iter != names.end()) {
+    return iter->second.c_str();
+  }
+
+  std::string name = type.name();
+
+#if defined(__GNUG__)
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  if (status == 0 && demangled) {
+    name = demangled;
+  }
+  free(demangled);
+#endif
+
+  return names.emplace(type, name).first->second.c_str();
+}
+
+
+void set_trace_sink(const heif_trace_sink* sink, void* sink_user_data)
+{
+  std::lock_guard<std::mutex> lock(s_sink_mutex);
+
+  if (!sink) {
+    s_current_sink.store(nullptr, std::memory_order_release);
+  }
+  else {
+    auto* new_sink = new TraceSink{*sink, sink_user_data};
+    s_current_sink.store(new_sink, std::memory_order_release);
+  }
+}
+#endif
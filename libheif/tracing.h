@@ -0,0 +1,70 @@
+/*
+ * HEIF codec.
+ * Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+ *
+ * This file is part of libheif.
+ *
+ * libheif is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libheif is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libheif.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBHEIF_TRACING_H
+#define LIBHEIF_TRACING_H
+
+#include "libheif/heif_tracing.h"
+#include <cstdint>
+
+#if ENABLE_TRACING
+#include <chrono>
+#include <typeinfo>
+
+
+// Reports the time of its scope to the trace sink set with heif_set_trace_sink().
+// The category and name have to be static strings.
+class TraceScope
+{
+public:
+  TraceScope(const char* category, const char* name, uint32_t item_id = 0);
+
+  ~TraceScope();
+
+  TraceScope(const TraceScope&) = delete;
+
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  const char* m_category = nullptr;
+  const char* m_name = nullptr;
+  uint32_t m_item_id = 0;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+// Readable name of a class, for use as trace event name. The string stays valid until the program exits.
+const char* trace_type_name(const std::type_info& type);
+
+// Replaces the process-wide trace sink. NULL stops tracing.
+void set_trace_sink(const heif_trace_sink* sink, void* sink_user_data);
+
+#define HEIF_TRACE_CONCAT2(a, b) a##b
+#define HEIF_TRACE_CONCAT(a, b) HEIF_TRACE_CONCAT2(a, b)
+
+// HEIF_TRACE_SCOPE(category, name [, item_id])
+#define HEIF_TRACE_SCOPE(...) TraceScope HEIF_TRACE_CONCAT(heif_trace_scope_, __LINE__)(__VA_ARGS__)
+
+#else
+
+#define HEIF_TRACE_SCOPE(...) do {} while (false)
+
+#endif
+
+#endif //LIBHEIF_TRACING_H
@@ -55,55 +55,235 @@ HeifImage.prototype.is_primary = function() {
 
 HeifImage.prototype.display = function(image_data, callback) {
     // Defer color conversion.
-    var w = this.get_width();
-    var h = this.get_height();
-
     setTimeout(function() {
 
-        // If image hasn't been loaded yet, decode the image
+        // Decode directly into the ImageData. When it is smaller than the image,
+        // the image is scaled down to the size of the ImageData.
 
         if (!this.img) {
-            var img = Module.heif_js_decode_image2(this.handle,
-              Module.heif_colorspace.heif_colorspace_RGB, Module.heif_chroma.heif_chroma_interleaved_RGBA);
-            if (!img || img.code) {
-                console.log("Decoding image failed", this.handle, img);
+            var err = Module.heif_js_decode_image_rgba(this.handle, image_data.data,
+              image_data.width, image_data.height);
+            if (!err || err.code !== Module.heif_error_code.heif_error_Ok) {
+                console.log("Decoding image failed", this.handle, err);
 
                 callback(null);
                 return;
             }
+        }
 
-            for (let c of img.channels) {
-                if (c.id == Module.heif_channel.heif_channel_interleaved) {
-
-                    // copy image into output array
-
-                    if (c.stride == c.width * 4) {
-                        image_data.data.set(c.data);
-                    } else {
-                        for (let y = 0; y < c.height; y++) {
-                            let slice = c.data.slice(y * c.stride, y * c.stride + c.width * 4);
-                            let offset = y * c.width * 4;
-                            image_data.data.set(slice, offset);
-                        }
-                    }
-                }
-            }
+        callback(image_data);
+    }.bind(this), 0);
+};
 
-            Module.heif_image_release(img.image);
+// Decodes the region (x, y, width, height) of the image into the ImageData, which must have the size of the region.
+// With a HeifRangeReader, only the tiles that overlap with the region are downloaded.
+HeifImage.prototype.displayRegion = function(image_data, x, y, callback) {
+    setTimeout(function() {
+        var err = Module.heif_js_decode_image_region_rgba(this.handle, image_data.data,
+          x, y, image_data.width, image_data.height);
+        if (!err || err.code !== Module.heif_error_code.heif_error_Ok) {
+            console.log("Decoding image region failed", this.handle, err);
+
+            callback(null);
+            return;
         }
 
         callback(image_data);
     }.bind(this), 0);
 };
 
+// Reads a file with HTTP range requests, such that only the parts of the file that libheif needs are downloaded.
+// This lets a viewer show the primary image or a region of a large tiled image without loading the whole file.
+//
+// libheif reads synchronously. Hence, the requests are made with a synchronous XMLHttpRequest, which browsers only
+// allow in a Web Worker. Cross-origin servers have to expose the 'Content-Range' header.
+// Instead of a URL, 'source' can be an object {size, readRangeSync(start, end)} that returns the bytes [start, end)
+// as a Uint8Array.
+//
+// Options:
+//   blockSize       - granularity of the downloaded and cached data (default: 64 KiB)
+//   maxRequestSize  - requests are extended by the ranges that libheif announced to need next (e.g. the following
+//                     tiles of a region) up to this size (default: 4 MiB)
+var HeifRangeReader = function(source, options) {
+    options = options || {};
+    this.blockSize = options.blockSize || 65536;
+    this.maxRequestSize = options.maxRequestSize || 4 * 1024 * 1024;
+    this.blocks = new Map(); // block index -> Uint8Array
+    this.hints = [];         // [start, end] ranges from preload_range_hint()
+
+    if (typeof source === "string") {
+        this.url = source;
+        this.size = this._fetchSize();
+    } else {
+        this.readRangeSync = source.readRangeSync;
+        this.size = source.size;
+    }
+
+    this.id = HeifRangeReader._nextId++;
+    HeifRangeReader._readers.set(this.id, this);
+};
+
+HeifRangeReader._nextId = 1;
+HeifRangeReader._readers = new Map();
+
+HeifRangeReader._get = function(id) {
+    return HeifRangeReader._readers.get(id);
+};
+
+HeifRangeReader.prototype.free = function() {
+    HeifRangeReader._readers.delete(this.id);
+    this.blocks.clear();
+};
+
+HeifRangeReader.prototype._sendRequest = function(start, end) {
+    var xhr = new XMLHttpRequest();
+    xhr.open("GET", this.url, false);
+    xhr.responseType = "arraybuffer";
+    xhr.setRequestHeader("Range", "bytes=" + start + "-" + (end - 1));
+    xhr.send();
+
+    if (xhr.status !== 200 && xhr.status !== 206) {
+        throw new Error("HTTP range request failed with status " + xhr.status);
+    }
+
+    return xhr;
+};
+
+HeifRangeReader.prototype._fetchSize = function() {
+    var xhr = this._sendRequest(0, 1);
+    if (xhr.status === 200) {
+        // The server does not support range requests and sent the whole file.
+        this.wholeFile = new Uint8Array(xhr.response);
+        return this.wholeFile.length;
+    }
+
+    var range = xhr.getResponseHeader("Content-Range");
+    var match = range && range.match(/\/(\d+)$/);
+    if (!match) {
+        throw new Error("Cannot determine the file size (missing Content-Range header)");
+    }
+
+    return parseInt(match[1], 10);
+};
+
+HeifRangeReader.prototype._readSync = function(start, end) {
+    if (this.readRangeSync) {
+        return this.readRangeSync(start, end);
+    }
+
+    if (this.wholeFile) {
+        return this.wholeFile.subarray(start, end);
+    }
+
+    var xhr = this._sendRequest(start, end);
+    var data = new Uint8Array(xhr.response);
+    return (xhr.status === 200) ? data.subarray(start, end) : data;
+};
+
+// Downloads the blocks of the range [start, end) that are not cached yet.
+HeifRangeReader.prototype._request = function(start, end) {
+    try {
+        var bs = this.blockSize;
+        var first = Math.floor(start / bs);
+        var last = Math.floor((Math.max(end, start + 1) - 1) / bs);
+
+        while (first <= last && this.blocks.has(first)) {
+            first++;
+        }
+        while (last >= first && this.blocks.has(last)) {
+            last--;
+        }
+        if (first > last) {
+            return true;
+        }
+
+        // Fetch the announced ranges that follow directly with the same request.
+        var fetchStart = first * bs;
+        var fetchEnd = Math.min((last + 1) * bs, this.size);
+        this.hints.sort(function(a, b) { return a[0] - b[0]; });
+        var remaining = [];
+        for (var i = 0; i < this.hints.length; i++) {
+            var hint = this.hints[i];
+            if (hint[0] >= fetchStart && hint[1] <= fetchEnd) {
+                continue;
+            }
+            if (hint[0] >= fetchStart && hint[0] <= fetchEnd + bs && hint[1] - fetchStart <= this.maxRequestSize) {
+                fetchEnd = Math.max(fetchEnd, hint[1]);
+            } else {
+                remaining.push(hint);
+            }
+        }
+        this.hints = remaining;
+
+        fetchEnd = Math.min(Math.ceil(fetchEnd / bs) * bs, this.size);
+
+        var data = this._readSync(fetchStart, fetchEnd);
+        if (data.length !== fetchEnd - fetchStart) {
+            return false;
+        }
+
+        for (var pos = 0; pos < data.length; pos += bs) {
+            this.blocks.set(first + pos / bs, data.slice(pos, Math.min(pos + bs, data.length)));
+        }
+
+        return true;
+    } catch (e) {
+        console.log("HeifRangeReader:", e.message);
+        return false;
+    }
+};
+
+// Copies the range [position, position+size) into the WASM heap at 'ptr'.
+HeifRangeReader.prototype._read = function(position, size, ptr) {
+    if (position + size > this.size || !this._request(position, position + size)) {
+        return false;
+    }
+
+    var bs = this.blockSize;
+    while (size > 0) {
+        var block = this.blocks.get(Math.floor(position / bs));
+        var offset = position % bs;
+        var n = Math.min(size, block.length - offset);
+        HEAPU8.set(block.subarray(offset, offset + n), ptr);
+
+        position += n;
+        ptr += n;
+        size -= n;
+    }
+
+    return true;
+};
+
+HeifRangeReader.prototype._hint = function(start, end) {
+    this.hints.push([start, Math.min(end, this.size)]);
+};
+
+HeifRangeReader.prototype._release = function(start, end) {
+    // Only drop the blocks that lie completely inside the range.
+    var bs = this.blockSize;
+    for (var b = Math.ceil(start / bs); b * bs < this.size && Math.min((b + 1) * bs, this.size) <= end; b++) {
+        this.blocks.delete(b);
+    }
+};
+
 var HeifDecoder = function() {
     this.decoder = null;
+    this.reader = null;
 };
 
-HeifDecoder.prototype.decode = function(buffer) {
+HeifDecoder.prototype._reset = function() {
     if (this.decoder) {
         Module.heif_context_free(this.decoder);
+        this.decoder = null;
+    }
+    if (this.reader) {
+        Module.heif_js_range_reader_free(this.reader.id);
+        this.reader = null;
     }
+};
+
+HeifDecoder.prototype.decode = function(buffer) {
+    this._reset();
     this.decoder = Module.heif_context_alloc();
     if (!this.decoder) {
         console.log("Could not create HEIF context");
@@ -115,6 +295,29 @@ HeifDecoder.prototype.decode = function(buffer) {
         return [];
     }
 
+    return this._getImages();
+};
+
+// Like decode(), but reads the file on demand through a HeifRangeReader. The reader has to be kept
+// until the images are no longer used.
+HeifDecoder.prototype.decodeRange = function(reader) {
+    this._reset();
+    this.decoder = Module.heif_context_alloc();
+    if (!this.decoder) {
+        console.log("Could not create HEIF context");
+        return [];
+    }
+    this.reader = reader;
+    var error = Module.heif_js_context_read_from_range_reader(this.decoder, reader.id);
+    if (error.code !== Module.heif_error_code.heif_error_Ok) {
+        console.log("Could not parse HEIF file", error.message);
+        return [];
+    }
+
+    return this._getImages();
+};
+
+HeifDecoder.prototype._getImages = function() {
     var ids = Module.heif_js_context_get_list_of_top_level_image_IDs(this.decoder);
     if (!ids || ids.code) {
         console.log("Error loading image ids", ids);
@@ -146,6 +349,7 @@ var fourcc = function(s) {
 
 Module.HeifImage = HeifImage;
 Module.HeifDecoder = HeifDecoder;
+Module.HeifRangeReader = HeifRangeReader;
 Module.fourcc = fourcc;
 
 // Expose enum values.
@@ -42,3 +42,29 @@ const image_data = decoder.decode(data);
 
 console.log('Loaded images:', image_data.length);
 assert(image_data.length > 0, "Should have loaded images")
+
+// Read the file on demand through a HeifRangeReader and check that the same images are found.
+const fd = fs.openSync('examples/example.heic', 'r');
+let bytes_read = 0;
+const reader = new libheif.HeifRangeReader({
+    size: data.length,
+    readRangeSync: function(start, end) {
+        const buffer = new Uint8Array(end - start);
+        fs.readSync(fd, buffer, 0, end - start, start);
+        bytes_read += end - start;
+        return buffer;
+    }
+}, {blockSize: 4096});
+
+const range_decoder = new libheif.HeifDecoder();
+const range_image_data = range_decoder.decodeRange(reader);
+
+console.log('Loaded images with range reader:', range_image_data.length, 'bytes read:', bytes_read);
+assert(range_image_data.length === image_data.length, "Should have loaded the same images with the range reader")
+
+const first_image = range_image_data[0];
+const region = {data: new Uint8Array(16 * 16 * 4), width: 16, height: 16};
+first_image.displayRegion(region, 0, 0, function(result) {
+    assert(result !== null, "Should have decoded a region with the range reader");
+    fs.closeSync(fd);
+});
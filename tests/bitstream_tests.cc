@@ -29,7 +29,9 @@
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <bitstream.h>
+#include "codecs/nalu_utils.h"
 
 
 TEST_CASE("read bits") {
@@ -77,6 +79,67 @@ TEST_CASE("read uint32") {
   REQUIRE(overlap == 0b111000101000001100001111000111);
 }
 
+TEST_CASE("read bits of varying length") {
+  std::vector<uint8_t> byteArray(97);
+  for (size_t i = 0; i < byteArray.size(); i++) {
+    byteArray[i] = static_cast<uint8_t>(i * 37 + 11);
+  }
+
+  BitReader uut(byteArray.data(), (int)byteArray.size());
+
+  size_t bitpos = 0;
+  for (int n = 1; bitpos + n <= byteArray.size() * 8; n = n % 32 + 1) {
+    uint32_t expected = 0;
+    for (int b = 0; b < n; b++, bitpos++) {
+      expected = (expected << 1) | ((byteArray[bitpos / 8] >> (7 - bitpos % 8)) & 1);
+    }
+
+    REQUIRE(uut.get_bits(n) == expected);
+  }
+}
+
+TEST_CASE("read Exp-Golomb codes") {
+  // 1 | 010 | 011 | 00100 | 00101 | 20 zeros, 1, 1111 followed by 16 zeros | 30 zeros, 1
+  std::vector<uint8_t> byteArray{0b10100110, 0b01000010, 0b10000000, 0b00000000, 0b00000111, 0b11000000,
+                                 0b00000000, 0b00000000, 0, 0, 0, 0b10000000};
+  BitReader uut(byteArray.data(), (int)byteArray.size());
+
+  int value;
+  REQUIRE(uut.get_uvlc(&value));
+  REQUIRE(value == 0);
+  REQUIRE(uut.get_uvlc(&value));
+  REQUIRE(value == 1);
+  REQUIRE(uut.get_svlc(&value));
+  REQUIRE(value == -1);
+  REQUIRE(uut.get_uvlc(&value));
+  REQUIRE(value == 3);
+  REQUIRE(uut.get_svlc(&value));
+  REQUIRE(value == -2);
+  REQUIRE(uut.get_uvlc(&value));
+  REQUIRE(value == (1 << 20) - 1 + 0xF0000);
+
+  // too many leading zeros
+  REQUIRE(!uut.get_uvlc(&value));
+}
+
+TEST_CASE("read bytes") {
+  std::vector<uint8_t> byteArray{1, 2, 3, 4, 5, 6};
+  BitReader uut(byteArray.data(), (int)byteArray.size());
+
+  REQUIRE(uut.get_bits8(8) == 1);
+
+  std::span<const uint8_t> bytes = uut.read_bytes(3);
+  REQUIRE(bytes.size() == 3);
+  REQUIRE(bytes.data() == byteArray.data() + 1);
+  REQUIRE(uut.get_bits8(8) == 5);
+
+  // only one byte left
+  bytes = uut.read_bytes(4);
+  REQUIRE(bytes.size() == 1);
+  REQUIRE(bytes[0] == 6);
+  REQUIRE(uut.get_bits_remaining() == 0);
+}
+
 TEST_CASE("read float") {
   std::vector<uint8_t> byteArray{0x40, 0x00, 0x00, 0x00};
   std::shared_ptr<StreamReader_memory> stream = std::make_shared<StreamReader_memory>(byteArray.data(), (int)byteArray.size(), false);
@@ -84,3 +147,101 @@ TEST_CASE("read float") {
   float f = uut.read_float32();
   REQUIRE(f == 2.0);
 }
+
+TEST_CASE("skip bytes") {
+  std::vector<uint8_t> byteArray(100);
+  for (size_t i = 0; i < byteArray.size(); i++) {
+    byteArray[i] = static_cast<uint8_t>(i);
+  }
+
+  BitReader uut(byteArray.data(), (int)byteArray.size());
+  REQUIRE(uut.get_bits8(8) == 0);
+  REQUIRE(uut.is_at_byte_boundary());
+  REQUIRE(uut.get_current_byte_pointer() == byteArray.data() + 1);
+  REQUIRE(uut.get_bytes_remaining() == 99);
+
+  // jump over the bits that are already buffered and beyond
+  uut.skip_bytes(20);
+  REQUIRE(uut.get_current_byte_index() == 21);
+  REQUIRE(uut.get_current_byte_pointer() == byteArray.data() + 21);
+  REQUIRE(uut.get_bits8(8) == 21);
+
+  // not at a byte boundary
+  REQUIRE(uut.get_bits8(4) == 1);
+  REQUIRE(!uut.is_at_byte_boundary());
+  uut.skip_bytes(2);
+  REQUIRE(uut.get_bits8(4) == (24 & 0x0F));
+  REQUIRE(uut.get_bits8(8) == 25);
+
+  uut.skip_bytes(74);
+  REQUIRE(uut.get_bytes_remaining() == 0);
+  REQUIRE(uut.get_bits_remaining() == 0);
+}
+
+
+static void check_buffered_range(const std::shared_ptr<StreamReader>& stream)
+{
+  BitstreamRange parent(stream, 12, nullptr);
+  BitstreamRange uut(stream, 10, &parent);
+  uut.buffer_remaining_data();
+
+  // the data has been consumed from the stream and the parent range
+  REQUIRE(stream->get_position() == 10);
+  REQUIRE(parent.get_remaining_bytes() == 2);
+
+  REQUIRE(uut.read16() == 0x0102);
+  REQUIRE(uut.read_fixed_string(4) == "ab");
+  uut.skip(1);
+  REQUIRE(uut.read24() == 0x0a0b0c);
+  REQUIRE(uut.eof());
+  REQUIRE(!uut.error());
+
+  REQUIRE(uut.read8() == 0);
+  REQUIRE(uut.error());
+
+  REQUIRE(parent.read16() == 0x0d0e);
+}
+
+
+TEST_CASE("buffered range") {
+  std::vector<uint8_t> byteArray{0x01, 0x02, 2, 'a', 'b', 0, 0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e};
+
+  SECTION("memory stream") {
+    check_buffered_range(std::make_shared<StreamReader_memory>(byteArray.data(), byteArray.size(), false));
+  }
+
+  SECTION("istream") {
+    auto istr = std::make_unique<std::istringstream>(std::string(byteArray.begin(), byteArray.end()));
+    check_buffered_range(std::make_shared<StreamReader_istream>(std::move(istr)));
+  }
+}
+
+
+TEST_CASE("NAL units to Annex-B and back") {
+  // two NAL units with 2-byte sizes, the second one ends with a zero byte
+  std::vector<uint8_t> length_prefixed{0x00, 0x03, 0x40, 0x01, 0x0c,
+                                       0x00, 0x04, 0x26, 0x01, 0xaf, 0x00};
+
+  std::vector<uint8_t> annexb;
+  REQUIRE(append_nal_units_as_annexb(annexb, length_prefixed, 2) == Error::Ok);
+  REQUIRE(annexb == std::vector<uint8_t>{0, 0, 0, 1, 0x40, 0x01, 0x0c,
+                                         0, 0, 0, 1, 0x26, 0x01, 0xaf, 0x00});
+
+  // trailing zero bytes cannot be distinguished from the next start code
+  auto nal_units = split_annexb_nal_units(annexb);
+  REQUIRE(nal_units.size() == 2);
+  REQUIRE(std::vector<uint8_t>(nal_units[0].begin(), nal_units[0].end()) == std::vector<uint8_t>{0x40, 0x01, 0x0c});
+  REQUIRE(std::vector<uint8_t>(nal_units[1].begin(), nal_units[1].end()) == std::vector<uint8_t>{0x26, 0x01, 0xaf});
+
+  // 3-byte start codes and leading garbage
+  std::vector<uint8_t> short_start_codes{0xff, 0, 0, 1, 0x42, 0x01, 0, 0, 1, 0x44};
+  nal_units = split_annexb_nal_units(short_start_codes);
+  REQUIRE(nal_units.size() == 2);
+  REQUIRE(nal_units[0].size() == 2);
+  REQUIRE(nal_units[1].size() == 1);
+
+  // NAL unit size exceeds the data
+  std::vector<uint8_t> truncated{0x00, 0x00, 0x00, 0x05, 0x40, 0x01};
+  annexb.clear();
+  REQUIRE(append_nal_units_as_annexb(annexb, truncated, 4).error_code == heif_error_Invalid_input);
+}
@@ -63,3 +63,24 @@ TEST_CASE("add_box") {
   REQUIRE(ipco->find_or_append_child_box(ispe2) == 1);
   REQUIRE(ipco->find_or_append_child_box(ispe3) == 0);
 }
+
+TEST_CASE("add_box with children appended or removed directly") {
+  auto make_ispe = [](uint32_t w, uint32_t h) {
+    auto ispe = std::make_shared<Box_ispe>();
+    ispe->set_size(w, h);
+    return ispe;
+  };
+
+  std::shared_ptr<Box_ipco> ipco = std::make_shared<Box_ipco>();
+  REQUIRE(ipco->find_or_append_child_box(make_ispe(100, 200)) == 0);
+
+  // like the properties read from a file
+  std::shared_ptr<Box_ispe> appended = make_ispe(100, 250);
+  ipco->append_child_box(appended);
+  REQUIRE(ipco->find_or_append_child_box(make_ispe(100, 250)) == 1);
+  REQUIRE(ipco->find_or_append_child_box(make_ispe(100, 300)) == 2);
+
+  ipco->remove_child_box(appended);
+  REQUIRE(ipco->find_or_append_child_box(make_ispe(100, 300)) == 1);
+  REQUIRE(ipco->find_or_append_child_box(make_ispe(100, 250)) == 2);
+}
@@ -27,8 +27,28 @@
 #include <iomanip>
 #include "catch_amalgamated.hpp"
 #include "color-conversion/colorconversion.h"
+#include "color-conversion/yuv2rgb_simd.h"
+#include "color-conversion/rgb2yuv_simd.h"
+#include "color-conversion/alpha.h"
+#include "color-conversion/alpha_simd.h"
+#include "color-conversion/chroma_sampling_simd.h"
+#include "color-conversion/rgb2rgb_simd.h"
+#include "color-conversion/hdr_sdr_simd.h"
+#include "color-conversion/hdr_sdr.h"
+#include "color-conversion/float_conversion_simd.h"
+#include "color-conversion/tensor.h"
+#include "color-conversion/tensor_simd.h"
+#include "color-conversion/gain_map.h"
+#include "color-conversion/gain_map_simd.h"
+#include "color-conversion/yuv2rgb.h"
+#include "color-conversion/chroma_sampling.h"
+#include "color-conversion/rgb2rgb.h"
 #include "pixelimage.h"
+#include "nclx.h"
+#include "common_utils.h"
 #include <cmath>
+#include <cstdlib>
+#include <string>
 
 // Enable for more verbose test output.
 constexpr bool kEnableDebugOutput = false;
@@ -736,3 +756,2299 @@ TEST_CASE("RGB 5-6-5 to RGB")
   assert_plane(out, heif_channel_G, {28, 32, 36, 40, 44, 48});
   assert_plane(out, heif_channel_B, {107, 115, 123, 132, 140, 148});
 }
+
+
+static void check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB_row_kernel kernel, int bytes_per_pixel)
+{
+  const uint32_t width = 75; // odd width, not a multiple of the SIMD block size
+
+  std::vector<uint8_t> y(width), cb((width + 1) / 2), cr((width + 1) / 2), a(width);
+  for (uint32_t x = 0; x < width; x++) {
+    y[x] = (uint8_t) (x * 37 + 11);
+    a[x] = (uint8_t) (x * 13);
+  }
+  for (uint32_t x = 0; x < cb.size(); x++) {
+    cb[x] = (uint8_t) (x * 71 + 3);
+    cr[x] = (uint8_t) (255 - x * 53);
+  }
+
+  auto coeffs = get_YCbCr_to_RGB_coefficients(heif_matrix_coefficients_ITU_R_BT_601_6, heif_color_primaries_ITU_R_BT_709_5);
+  YCbCr_to_RGB_int_coefficients c;
+  c.r_cr = static_cast<int>(std::lround(256 * coeffs.r_cr));
+  c.g_cr = static_cast<int>(std::lround(256 * coeffs.g_cr));
+  c.g_cb = static_cast<int>(std::lround(256 * coeffs.g_cb));
+  c.b_cb = static_cast<int>(std::lround(256 * coeffs.b_cb));
+
+  std::vector<uint8_t> out(width * bytes_per_pixel, 0);
+  uint32_t converted = kernel(y.data(), cb.data(), cr.data(), a.data(), out.data(), width, c);
+  REQUIRE(converted > 0);
+  REQUIRE(converted <= width);
+
+  for (uint32_t x = 0; x < converted; x++) {
+    INFO("column: " << x);
+    int yv = y[x];
+    int cbv = cb[x / 2] - 128;
+    int crv = cr[x / 2] - 128;
+
+    REQUIRE(out[x * bytes_per_pixel + 0] == clip_int_u8(yv + ((c.r_cr * crv + 128) >> 8)));
+    REQUIRE(out[x * bytes_per_pixel + 1] == clip_int_u8(yv + ((c.g_cb * cbv + c.g_cr * crv + 128) >> 8)));
+    REQUIRE(out[x * bytes_per_pixel + 2] == clip_int_u8(yv + ((c.b_cb * cbv + 128) >> 8)));
+    if (bytes_per_pixel == 4) {
+      REQUIRE(out[x * bytes_per_pixel + 3] == a[x]);
+    }
+  }
+
+  // pixels behind the converted range must not be touched
+  for (uint32_t i = converted * bytes_per_pixel; i < out.size(); i++) {
+    REQUIRE(out[i] == 0);
+  }
+}
+
+
+TEST_CASE("YCbCr420 to RGB SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB24_row_sse41, 3);
+    check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB32_row_sse41, 4);
+  }
+
+  if (cpu_supports_avx2()) {
+    check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB24_row_avx2, 3);
+    check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB32_row_avx2, 4);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB24_row_neon, 3);
+  check_YCbCr420_to_RGB_row_kernel(YCbCr420_to_RGB32_row_neon, 4);
+#endif
+}
+
+
+TEST_CASE("SIMD code path override")
+{
+  const char* env = getenv("LIBHEIF_SIMD");
+  std::string level = cpu_simd_level();
+
+  if (env && (std::string(env) == "scalar" || std::string(env) == "off")) {
+    REQUIRE(!cpu_supports_sse41());
+    REQUIRE(!cpu_supports_avx2());
+    REQUIRE(!cpu_supports_neon());
+    REQUIRE(level == "scalar");
+  }
+  else if (env && std::string(env) == "sse4.1") {
+    REQUIRE(!cpu_supports_avx2());
+    REQUIRE(level != "avx2");
+  }
+
+  REQUIRE((level == "avx2") == cpu_supports_avx2());
+}
+
+
+TEST_CASE("Pipeline cache")
+{
+  ColorState input(heif_colorspace_YCbCr, heif_chroma_420, false, 8);
+  input.nclx_profile.set_sRGB_defaults();
+  ColorState target(heif_colorspace_RGB, heif_chroma_interleaved_RGB, false, 8);
+  target.nclx_profile.set_sRGB_defaults();
+
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+  heif_color_conversion_options_ext options_ext{};
+
+  ColorConversionPipeline::clear_pipeline_cache();
+
+  ColorConversionPipeline uncached;
+  REQUIRE(uncached.construct_pipeline(input, target, options, options_ext));
+
+  ColorConversionPipeline cached;
+  REQUIRE(cached.construct_pipeline(input, target, options, options_ext));
+  REQUIRE(cached.debug_dump_pipeline() == uncached.debug_dump_pipeline());
+
+  // different options must not reuse the cached pipeline
+
+  options.preferred_chroma_upsampling_algorithm = heif_chroma_upsampling_nearest_neighbor;
+
+  ColorConversionPipeline nearest_neighbor;
+  REQUIRE(nearest_neighbor.construct_pipeline(input, target, options, options_ext));
+  REQUIRE(nearest_neighbor.debug_dump_pipeline() != uncached.debug_dump_pipeline());
+
+  // unsupported conversions are cached as well
+
+  ColorState unsupported_target(heif_colorspace_YCbCr, heif_chroma_interleaved_RGB, false, 8);
+  ColorConversionPipeline unsupported;
+  REQUIRE(!unsupported.construct_pipeline(input, unsupported_target, options, options_ext));
+  REQUIRE(!unsupported.construct_pipeline(input, unsupported_target, options, options_ext));
+}
+
+
+static void check_RGB24_32_to_YCbCr_row_kernels(RGB24_32_to_Y_row_kernel luma_kernel,
+                                                RGB24_32_to_CbCr420_row_kernel chroma_kernel,
+                                                int bytes_per_pixel, bool full_range)
+{
+  const uint32_t width = 75; // odd width, not a multiple of the SIMD block size
+
+  std::vector<uint8_t> row0(width * bytes_per_pixel), row1(width * bytes_per_pixel);
+  for (uint32_t i = 0; i < row0.size(); i++) {
+    row0[i] = (uint8_t) (i * 37 + 11);
+    row1[i] = (uint8_t) (255 - i * 53);
+  }
+
+  auto coeffs = get_RGB_to_YCbCr_coefficients(heif_matrix_coefficients_ITU_R_BT_601_6, heif_color_primaries_ITU_R_BT_709_5);
+
+  std::vector<uint8_t> out_y(width, 0);
+  uint32_t converted = luma_kernel(row0.data(), bytes_per_pixel, out_y.data(), width, coeffs, full_range);
+  REQUIRE(converted > 0);
+  REQUIRE(converted <= width);
+
+  for (uint32_t x = 0; x < converted; x++) {
+    INFO("column: " << x);
+    const uint8_t* p = &row0[x * bytes_per_pixel];
+    float yv = p[0] * coeffs.c[0][0] + p[1] * coeffs.c[0][1] + p[2] * coeffs.c[0][2];
+    uint8_t expected = full_range ? clip_f_u8(yv) : (uint8_t) (clip_f_u16(yv * 0.85547f, 219) + 16);
+    REQUIRE(out_y[x] == expected);
+  }
+
+  for (uint32_t x = converted; x < width; x++) {
+    REQUIRE(out_y[x] == 0);
+  }
+
+  const uint32_t num_samples = width / 2;
+  std::vector<uint8_t> out_cb(num_samples, 0), out_cr(num_samples, 0);
+  converted = chroma_kernel(row0.data(), row1.data(), bytes_per_pixel, out_cb.data(), out_cr.data(), num_samples,
+                            coeffs, full_range);
+  REQUIRE(converted > 0);
+  REQUIRE(converted <= num_samples);
+
+  for (uint32_t x = 0; x < converted; x++) {
+    INFO("chroma column: " << x);
+    uint8_t rgb[3];
+    for (int c = 0; c < 3; c++) {
+      uint32_t i0 = 2 * x * bytes_per_pixel + c;
+      uint32_t i1 = i0 + bytes_per_pixel;
+      rgb[c] = uint8_t((row0[i0] + row0[i1] + row1[i0] + row1[i1]) / 4);
+    }
+
+    float cb = rgb[0] * coeffs.c[1][0] + rgb[1] * coeffs.c[1][1] + rgb[2] * coeffs.c[1][2];
+    float cr = rgb[0] * coeffs.c[2][0] + rgb[1] * coeffs.c[2][1] + rgb[2] * coeffs.c[2][2];
+
+    REQUIRE(out_cb[x] == (full_range ? clip_f_u8(cb + 128) : clip_f_u8(cb * 0.875f + 128.0f)));
+    REQUIRE(out_cr[x] == (full_range ? clip_f_u8(cr + 128) : clip_f_u8(cr * 0.875f + 128.0f)));
+  }
+
+  for (uint32_t x = converted; x < num_samples; x++) {
+    REQUIRE(out_cb[x] == 0);
+    REQUIRE(out_cr[x] == 0);
+  }
+}
+
+
+static void check_RGB16_planar_to_YCbCr_row_kernels(RGB16_planar_to_Y_row_kernel luma_kernel,
+                                                    RGB16_planar_to_CbCr420_row_kernel chroma_kernel,
+                                                    int bpp, bool full_range)
+{
+  const uint32_t width = 75;
+  const uint16_t maxval = (uint16_t) ((1 << bpp) - 1);
+
+  std::vector<uint16_t> planes[2][3];
+  for (int row = 0; row < 2; row++) {
+    for (int c = 0; c < 3; c++) {
+      planes[row][c].resize(width);
+      for (uint32_t x = 0; x < width; x++) {
+        planes[row][c][x] = (uint16_t) ((x * 997 + c * 4099 + row * 30011) & maxval);
+      }
+    }
+  }
+
+  auto coeffs = get_RGB_to_YCbCr_coefficients(heif_matrix_coefficients_ITU_R_BT_709_5, heif_color_primaries_ITU_R_BT_709_5);
+  float limited_range_offset = static_cast<float>(16 << (bpp - 8));
+  uint16_t halfRange = (uint16_t) (1 << (bpp - 1));
+
+  std::vector<uint16_t> out_y(width, 0);
+  uint32_t converted = luma_kernel(planes[0][0].data(), planes[0][1].data(), planes[0][2].data(),
+                                   out_y.data(), width, coeffs, full_range, bpp);
+  REQUIRE(converted > 0);
+  REQUIRE(converted <= width);
+
+  for (uint32_t x = 0; x < converted; x++) {
+    INFO("column: " << x);
+    float r = planes[0][0][x];
+    float g = planes[0][1][x];
+    float b = planes[0][2][x];
+    float v = r * coeffs.c[0][0] + g * coeffs.c[0][1] + b * coeffs.c[0][2];
+    if (!full_range) {
+      v = (((v * 219) / 256) + limited_range_offset);
+    }
+    REQUIRE(out_y[x] == clip_f_u16(v, maxval));
+  }
+
+  const uint32_t num_samples = width / 2;
+  std::vector<uint16_t> out_cb(num_samples, 0), out_cr(num_samples, 0);
+  const uint16_t* const row0[3] = {planes[0][0].data(), planes[0][1].data(), planes[0][2].data()};
+  const uint16_t* const row1[3] = {planes[1][0].data(), planes[1][1].data(), planes[1][2].data()};
+  converted = chroma_kernel(row0, row1, out_cb.data(), out_cr.data(), num_samples, coeffs, full_range, bpp);
+  REQUIRE(converted > 0);
+  REQUIRE(converted <= num_samples);
+
+  for (uint32_t x = 0; x < converted; x++) {
+    INFO("chroma column: " << x);
+    float rgb[3];
+    for (int c = 0; c < 3; c++) {
+      rgb[c] = planes[0][c][2 * x];
+      rgb[c] += planes[0][c][2 * x + 1];
+      rgb[c] += planes[1][c][2 * x];
+      rgb[c] += planes[1][c][2 * x + 1];
+      rgb[c] *= 0.25f;
+    }
+
+    float cb = rgb[0] * coeffs.c[1][0] + rgb[1] * coeffs.c[1][1] + rgb[2] * coeffs.c[1][2];
+    float cr = rgb[0] * coeffs.c[2][0] + rgb[1] * coeffs.c[2][1] + rgb[2] * coeffs.c[2][2];
+    if (!full_range) {
+      cb = (cb * 224) / 256;
+      cr = (cr * 224) / 256;
+    }
+
+    REQUIRE(out_cb[x] == clip_f_u16(cb + halfRange, maxval));
+    REQUIRE(out_cr[x] == clip_f_u16(cr + halfRange, maxval));
+  }
+
+  for (uint32_t x = converted; x < num_samples; x++) {
+    REQUIRE(out_cb[x] == 0);
+    REQUIRE(out_cr[x] == 0);
+  }
+}
+
+
+static void check_RGB_to_YCbCr_row_kernels(RGB24_32_to_Y_row_kernel luma_kernel,
+                                           RGB24_32_to_CbCr420_row_kernel chroma_kernel,
+                                           RGB16_planar_to_Y_row_kernel luma16_kernel,
+                                           RGB16_planar_to_CbCr420_row_kernel chroma16_kernel)
+{
+  for (bool full_range : {true, false}) {
+    check_RGB24_32_to_YCbCr_row_kernels(luma_kernel, chroma_kernel, 3, full_range);
+    check_RGB24_32_to_YCbCr_row_kernels(luma_kernel, chroma_kernel, 4, full_range);
+
+    for (int bpp : {10, 12, 16}) {
+      check_RGB16_planar_to_YCbCr_row_kernels(luma16_kernel, chroma16_kernel, bpp, full_range);
+    }
+  }
+}
+
+
+TEST_CASE("RGB to YCbCr420 SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    check_RGB_to_YCbCr_row_kernels(RGB24_32_to_Y_row_sse41, RGB24_32_to_CbCr420_row_sse41,
+                                   RGB16_planar_to_Y_row_sse41, RGB16_planar_to_CbCr420_row_sse41);
+  }
+
+  if (cpu_supports_avx2()) {
+    check_RGB_to_YCbCr_row_kernels(RGB24_32_to_Y_row_avx2, RGB24_32_to_CbCr420_row_avx2,
+                                   RGB16_planar_to_Y_row_avx2, RGB16_planar_to_CbCr420_row_avx2);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_RGB_to_YCbCr_row_kernels(RGB24_32_to_Y_row_neon, RGB24_32_to_CbCr420_row_neon,
+                                 RGB16_planar_to_Y_row_neon, RGB16_planar_to_CbCr420_row_neon);
+#endif
+}
+
+
+static std::shared_ptr<HeifPixelImage> create_YCbCr420_test_image(uint32_t width, uint32_t height, int bpp,
+                                                                  bool has_alpha, bool full_range)
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, heif_colorspace_YCbCr, heif_chroma_420);
+
+  auto nclx = std::make_shared<color_profile_nclx>();
+  nclx->set_matrix_coefficients(heif_matrix_coefficients_ITU_R_BT_709_5);
+  nclx->set_full_range_flag(full_range);
+  img->set_color_profile_nclx(nclx);
+
+  uint32_t cw = (width + 1) / 2;
+  uint32_t ch = (height + 1) / 2;
+
+  std::vector<std::tuple<heif_channel, uint32_t, uint32_t>> planes = {{heif_channel_Y,  width, height},
+                                                                      {heif_channel_Cb, cw,    ch},
+                                                                      {heif_channel_Cr, cw,    ch}};
+  if (has_alpha) {
+    planes.emplace_back(heif_channel_Alpha, width, height);
+  }
+
+  uint32_t maxval = (1U << bpp) - 1;
+  uint32_t seed = 1;
+
+  for (const auto& [channel, w, h] : planes) {
+    REQUIRE(!img->add_plane(channel, w, h, bpp, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(channel, &stride);
+
+    for (uint32_t y = 0; y < h; y++) {
+      for (uint32_t x = 0; x < w; x++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t v = (seed >> 8) & maxval;
+        if (bpp > 8) {
+          ((uint16_t*) (p + y * stride))[x] = (uint16_t) v;
+        }
+        else {
+          p[y * stride + x] = (uint8_t) v;
+        }
+      }
+    }
+  }
+
+  return img;
+}
+
+
+template<class Pixel>
+static void check_fused_bilinear_to_interleaved_RGB(int bpp, bool has_alpha, bool full_range, heif_chroma out_chroma)
+{
+  INFO("bpp: " << bpp << " alpha: " << has_alpha << " full range: " << full_range << " output: " << out_chroma);
+
+  const bool out_alpha = (out_chroma == heif_chroma_interleaved_RGBA ||
+                          out_chroma == heif_chroma_interleaved_RRGGBBAA_BE ||
+                          out_chroma == heif_chroma_interleaved_RRGGBBAA_LE);
+  const bool out_le = (out_chroma == heif_chroma_interleaved_RRGGBB_LE ||
+                       out_chroma == heif_chroma_interleaved_RRGGBBAA_LE);
+
+  heif_color_conversion_options options{};
+  options.preferred_chroma_upsampling_algorithm = heif_chroma_upsampling_bilinear;
+  options.only_use_preferred_chroma_algorithm = true;
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+
+  const heif_security_limits* limits = heif_get_disabled_security_limits();
+
+  ColorState in_state(heif_colorspace_YCbCr, heif_chroma_420, has_alpha, bpp);
+  ColorState out_state(heif_colorspace_RGB, out_chroma, out_alpha, bpp);
+
+  ColorConversionPipeline pipeline;
+  REQUIRE(pipeline.construct_pipeline(in_state, out_state, options, options_ext));
+  INFO(pipeline.debug_dump_pipeline());
+  REQUIRE(pipeline.debug_dump_pipeline().find("has 1 steps") != std::string::npos);
+
+  for (auto [width, height] : {std::pair<uint32_t, uint32_t>{1, 1}, {2, 2}, {5, 3}, {37, 22}}) {
+    INFO("size: " << width << "x" << height);
+
+    auto img = create_YCbCr420_test_image(width, height, bpp, has_alpha, full_range);
+    in_state.nclx_profile = *img->get_color_profile_nclx();
+
+    // --- individual steps of the unfused conversion
+
+    ColorState state444(heif_colorspace_YCbCr, heif_chroma_444, has_alpha, bpp);
+    ColorState state_rgb(heif_colorspace_RGB, heif_chroma_444, has_alpha, bpp);
+
+    auto step1 = Op_YCbCr420_bilinear_to_YCbCr444<Pixel>().convert_colorspace(img, in_state, state444, options, options_ext, limits);
+    REQUIRE(step1);
+    (*step1)->set_color_profile_nclx(img->get_color_profile_nclx());
+
+    auto step2 = Op_YCbCr_to_RGB<Pixel>().convert_colorspace(*step1, state444, state_rgb, options, options_ext, limits);
+    REQUIRE(step2);
+
+    Result<std::shared_ptr<HeifPixelImage>> step3;
+    if (bpp == 8) {
+      step3 = Op_RGB_to_RGB24_32().convert_colorspace(*step2, state_rgb, out_state, options, options_ext, limits);
+    }
+    else {
+      ColorState state_be(heif_colorspace_RGB,
+                          out_alpha ? heif_chroma_interleaved_RRGGBBAA_BE : heif_chroma_interleaved_RRGGBB_BE,
+                          out_alpha, bpp);
+      step3 = Op_RGB_HDR_to_RRGGBBaa_BE().convert_colorspace(*step2, state_rgb, state_be, options, options_ext, limits);
+      REQUIRE(step3);
+      if (out_le) {
+        step3 = Op_RRGGBBaa_swap_endianness().convert_colorspace(*step3, state_be, out_state, options, options_ext, limits);
+      }
+    }
+    REQUIRE(step3);
+
+    // --- fused conversion
+
+    auto fused = Op_YCbCr420_bilinear_to_interleaved_RGB<Pixel>().convert_colorspace(img, in_state, out_state,
+                                                                                      options, options_ext, limits);
+    REQUIRE(fused);
+    REQUIRE((*fused)->get_chroma_format() == (*step3)->get_chroma_format());
+
+    size_t fused_stride, ref_stride;
+    const uint8_t* fused_p = (*fused)->get_plane(heif_channel_interleaved, &fused_stride);
+    const uint8_t* ref_p = (*step3)->get_plane(heif_channel_interleaved, &ref_stride);
+
+    uint32_t row_bytes = width * (out_alpha ? 4 : 3) * (bpp > 8 ? 2 : 1);
+    for (uint32_t y = 0; y < height; y++) {
+      INFO("row: " << y);
+      REQUIRE(memcmp(fused_p + y * fused_stride, ref_p + y * ref_stride, row_bytes) == 0);
+    }
+  }
+}
+
+
+TEST_CASE("Fused YCbCr420 bilinear to interleaved RGB")
+{
+  for (bool full_range : {true, false}) {
+    for (bool has_alpha : {false, true}) {
+      check_fused_bilinear_to_interleaved_RGB<uint8_t>(8, has_alpha, full_range, heif_chroma_interleaved_RGB);
+      check_fused_bilinear_to_interleaved_RGB<uint8_t>(8, has_alpha, full_range, heif_chroma_interleaved_RGBA);
+
+      for (int bpp : {10, 12}) {
+        if (!has_alpha) {
+          check_fused_bilinear_to_interleaved_RGB<uint16_t>(bpp, has_alpha, full_range, heif_chroma_interleaved_RRGGBB_LE);
+          check_fused_bilinear_to_interleaved_RGB<uint16_t>(bpp, has_alpha, full_range, heif_chroma_interleaved_RRGGBB_BE);
+        }
+        check_fused_bilinear_to_interleaved_RGB<uint16_t>(bpp, has_alpha, full_range, heif_chroma_interleaved_RRGGBBAA_LE);
+        check_fused_bilinear_to_interleaved_RGB<uint16_t>(bpp, has_alpha, full_range, heif_chroma_interleaved_RRGGBBAA_BE);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("YCbCr to RGB 8-bit tables")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_ext options_ext{};
+  const heif_security_limits* limits = heif_get_disabled_security_limits();
+
+  // 256x256 image with all Y values in each row and all Cb/Cr values in each column
+
+  const uint32_t size = 256;
+
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(size, size, heif_colorspace_YCbCr, heif_chroma_444);
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    REQUIRE(!img->add_plane(channel, size, size, 8, limits));
+  }
+
+  size_t stride_y, stride_cb, stride_cr;
+  uint8_t* p_y = img->get_plane(heif_channel_Y, &stride_y);
+  uint8_t* p_cb = img->get_plane(heif_channel_Cb, &stride_cb);
+  uint8_t* p_cr = img->get_plane(heif_channel_Cr, &stride_cr);
+
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      p_y[y * stride_y + x] = static_cast<uint8_t>(x);
+      p_cb[y * stride_cb + x] = static_cast<uint8_t>(y);
+      p_cr[y * stride_cr + x] = static_cast<uint8_t>(255 - y);
+    }
+  }
+
+  for (uint16_t matrix : {heif_matrix_coefficients_ITU_R_BT_709_5,
+                          heif_matrix_coefficients_ITU_R_BT_601_6,
+                          heif_matrix_coefficients_ITU_R_BT_2020_2_non_constant_luminance}) {
+    for (bool full_range : {true, false}) {
+      INFO("matrix: " << matrix << " full range: " << full_range);
+
+      auto nclx = std::make_shared<color_profile_nclx>();
+      nclx->set_matrix_coefficients(matrix);
+      nclx->set_full_range_flag(full_range);
+      img->set_color_profile_nclx(nclx);
+
+      ColorState in_state(heif_colorspace_YCbCr, heif_chroma_444, false, 8);
+      in_state.nclx_profile = *nclx;
+      ColorState out_state(heif_colorspace_RGB, heif_chroma_444, false, 8);
+
+      auto rgb = Op_YCbCr_to_RGB<uint8_t>().convert_colorspace(img, in_state, out_state, options, options_ext, limits);
+      REQUIRE(rgb);
+
+      // --- compare with the floating point formula
+
+      YCbCr_to_RGB_coefficients coeffs = get_YCbCr_to_RGB_coefficients(matrix, nclx->get_colour_primaries());
+
+      size_t stride_r, stride_g, stride_b;
+      const uint8_t* p_r = (*rgb)->get_plane(heif_channel_R, &stride_r);
+      const uint8_t* p_g = (*rgb)->get_plane(heif_channel_G, &stride_g);
+      const uint8_t* p_b = (*rgb)->get_plane(heif_channel_B, &stride_b);
+
+      for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+          float yv = static_cast<float>(p_y[y * stride_y + x]);
+          float cb = static_cast<float>(p_cb[y * stride_cb + x] - 128);
+          float cr = static_cast<float>(p_cr[y * stride_cr + x] - 128);
+
+          if (!full_range) {
+            yv = (yv - 16.0f) * 1.1689f;
+            cb = cb * 1.1429f;
+            cr = cr * 1.1429f;
+          }
+
+          INFO("x: " << x << " y: " << y);
+          REQUIRE(p_r[y * stride_r + x] == clip_f_u16(yv + coeffs.r_cr * cr, 255));
+          REQUIRE(p_g[y * stride_g + x] == clip_f_u16(yv + coeffs.g_cb * cb + coeffs.g_cr * cr, 255));
+          REQUIRE(p_b[y * stride_b + x] == clip_f_u16(yv + coeffs.b_cb * cb, 255));
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Bilinear upsampling borders")
+{
+  heif_color_conversion_options options = {
+      .preferred_chroma_upsampling_algorithm = heif_chroma_upsampling_bilinear,
+      .only_use_preferred_chroma_algorithm = true};
+
+  std::shared_ptr<HeifPixelImage> img = std::make_shared<HeifPixelImage>();
+  img->create(6, 6, heif_colorspace_YCbCr, heif_chroma_420);
+
+  auto error = img->fill_new_plane(heif_channel_Y, 128, 6, 6, 8, nullptr);
+  REQUIRE(!error);
+
+  fill_plane(img, heif_channel_Cb, 3, 3,
+             {0, 40, 80,
+              0, 40, 80,
+              0, 40, 80});
+  fill_plane(img, heif_channel_Cr, 3, 3,
+             {0, 0, 0,
+              40, 40, 40,
+              80, 80, 80});
+
+  auto conversionResult = convert_colorspace(img, heif_colorspace_YCbCr, heif_chroma_444, nullptr, 8, options, nullptr, heif_get_disabled_security_limits());
+  REQUIRE(conversionResult);
+  std::shared_ptr<HeifPixelImage> out = *conversionResult;
+
+  // the border rows and columns are interpolated between their own neighbors
+
+  const std::vector<uint8_t> ramp = {0, 10, 30, 50, 70, 80};
+
+  std::vector<uint8_t> expected_cb, expected_cr;
+  for (int y = 0; y < 6; y++) {
+    for (uint8_t v : ramp) {
+      expected_cb.push_back(v);
+    }
+  }
+  for (uint8_t v : ramp) {
+    for (int x = 0; x < 6; x++) {
+      expected_cr.push_back(v);
+    }
+  }
+
+  assert_plane(out, heif_channel_Cb, expected_cb);
+  assert_plane(out, heif_channel_Cr, expected_cr);
+}
+
+
+static std::shared_ptr<HeifPixelImage> create_random_image(const ColorState& state, int width, int height)
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, state.colorspace, state.chroma);
+  img->set_color_profile_nclx(std::make_shared<color_profile_nclx>(state.nclx_profile));
+
+  uint32_t seed = 7;
+
+  // GetPlanes() assumes even sizes, so only use it for the list of channels
+  for (const Plane& plane : GetPlanes(state, width, height)) {
+    uint32_t plane_width = channel_width(width, state.chroma, plane.channel);
+    uint32_t plane_height = channel_height(height, state.chroma, plane.channel);
+    REQUIRE(!img->add_plane(plane.channel, plane_width, plane_height, plane.bit_depth, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(plane.channel, &stride);
+    uint32_t row_bytes = plane_width * img->get_storage_bits_per_pixel(plane.channel) / 8;
+    bool hdr_planar = (plane.bit_depth > 8 && plane.channel != heif_channel_interleaved);
+
+    for (uint32_t y = 0; y < plane_height; y++) {
+      for (uint32_t x = 0; x < row_bytes; x++) {
+        seed = seed * 1103515245 + 12345;
+        p[y * stride + x] = (uint8_t) (seed >> 16);
+      }
+
+      if (hdr_planar) {
+        auto* row = (uint16_t*) (p + y * stride);
+        for (uint32_t x = 0; x < plane_width; x++) {
+          row[x] &= (uint16_t) ((1 << plane.bit_depth) - 1);
+        }
+      }
+    }
+  }
+
+  return img;
+}
+
+
+TEST_CASE("Strip processing")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+
+  color_profile_nclx nclx;
+  nclx.set_matrix_coefficients(heif_matrix_coefficients_ITU_R_BT_601_6);
+  nclx.set_full_range_flag(false);
+
+  std::vector<std::pair<ColorState, ColorState>> conversions = {
+      {ColorState(heif_colorspace_YCbCr, heif_chroma_420, false, 8), ColorState(heif_colorspace_RGB, heif_chroma_444, false, 8)},
+      {ColorState(heif_colorspace_YCbCr, heif_chroma_420, true, 10), ColorState(heif_colorspace_RGB, heif_chroma_interleaved_RGBA, true, 8)},
+      {ColorState(heif_colorspace_YCbCr, heif_chroma_422, false, 8), ColorState(heif_colorspace_RGB, heif_chroma_interleaved_RGB, false, 8)},
+      {ColorState(heif_colorspace_RGB, heif_chroma_interleaved_RGBA, true, 8), ColorState(heif_colorspace_YCbCr, heif_chroma_420, true, 10)},
+      {ColorState(heif_colorspace_RGB, heif_chroma_444, false, 10), ColorState(heif_colorspace_YCbCr, heif_chroma_420, false, 8)},
+  };
+
+  for (auto& [input_state, target_state] : conversions) {
+    input_state.nclx_profile = nclx;
+    target_state.nclx_profile = nclx;
+
+    ColorConversionPipeline pipeline;
+    REQUIRE(pipeline.construct_pipeline(input_state, target_state, options, options_ext));
+    INFO(pipeline.debug_dump_pipeline());
+
+    for (auto [width, height] : {std::pair<int, int>{13, 37}, {16, 40}}) {
+      auto in_image = create_random_image(input_state, width, height);
+
+      pipeline.set_strip_height(0);
+      auto reference = pipeline.convert_image(in_image, nullptr);
+      REQUIRE(reference);
+
+      for (uint32_t strip_height : {2, 4, 9}) {
+        INFO("size: " << width << "x" << height << " strip height: " << strip_height);
+
+        pipeline.set_strip_height(strip_height);
+        auto result = pipeline.convert_image(in_image, nullptr);
+        REQUIRE(result);
+
+        REQUIRE((*result)->get_chroma_format() == (*reference)->get_chroma_format());
+        REQUIRE((*result)->get_channel_set() == (*reference)->get_channel_set());
+        REQUIRE((*result)->get_color_profile_nclx()->get_matrix_coefficients() ==
+                (*reference)->get_color_profile_nclx()->get_matrix_coefficients());
+        REQUIRE((*result)->get_color_profile_nclx()->get_full_range_flag() ==
+                (*reference)->get_color_profile_nclx()->get_full_range_flag());
+
+        for (heif_channel channel : (*reference)->get_channel_set()) {
+          INFO("channel: " << channel);
+          REQUIRE((*result)->get_width(channel) == (*reference)->get_width(channel));
+          REQUIRE((*result)->get_height(channel) == (*reference)->get_height(channel));
+
+          size_t ref_stride, result_stride;
+          const uint8_t* ref_p = (*reference)->get_plane(channel, &ref_stride);
+          const uint8_t* result_p = (*result)->get_plane(channel, &result_stride);
+          uint32_t row_bytes = (*reference)->get_width(channel) * (*reference)->get_storage_bits_per_pixel(channel) / 8;
+
+          for (uint32_t y = 0; y < (*reference)->get_height(channel); y++) {
+            INFO("row: " << y);
+            REQUIRE(memcmp(ref_p + y * ref_stride, result_p + y * result_stride, row_bytes) == 0);
+          }
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Threaded conversion")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext* options_ext = heif_color_conversion_options_ext_alloc();
+  REQUIRE(options_ext->version >= 2);
+  REQUIRE(options_ext->max_threads == 1);
+
+  std::vector<std::pair<ColorState, ColorState>> conversions = {
+      // single step
+      {ColorState(heif_colorspace_YCbCr, heif_chroma_420, false, 8), ColorState(heif_colorspace_RGB, heif_chroma_interleaved_RGB, false, 8)},
+      // multiple steps
+      {ColorState(heif_colorspace_RGB, heif_chroma_interleaved_RGB, false, 8), ColorState(heif_colorspace_YCbCr, heif_chroma_420, false, 10)},
+  };
+
+  for (auto& [input_state, target_state] : conversions) {
+    color_profile_nclx nclx;
+    nclx.set_matrix_coefficients(heif_matrix_coefficients_ITU_R_BT_601_6);
+    input_state.nclx_profile = nclx;
+    target_state.nclx_profile = nclx;
+
+    // 4 MP, larger than the threshold for threaded conversion
+    auto in_image = create_random_image(input_state, 2000, 2001);
+
+    options_ext->max_threads = 1;
+    ColorConversionPipeline single_threaded;
+    REQUIRE(single_threaded.construct_pipeline(input_state, target_state, options, *options_ext));
+    auto reference = single_threaded.convert_image(in_image, nullptr);
+    REQUIRE(reference);
+
+    options_ext->max_threads = 4;
+    ColorConversionPipeline threaded;
+    REQUIRE(threaded.construct_pipeline(input_state, target_state, options, *options_ext));
+    auto result = threaded.convert_image(in_image, nullptr);
+    REQUIRE(result);
+
+    for (heif_channel channel : (*reference)->get_channel_set()) {
+      INFO("channel: " << channel);
+      REQUIRE((*result)->get_height(channel) == (*reference)->get_height(channel));
+
+      size_t ref_stride, result_stride;
+      const uint8_t* ref_p = (*reference)->get_plane(channel, &ref_stride);
+      const uint8_t* result_p = (*result)->get_plane(channel, &result_stride);
+      uint32_t row_bytes = (*reference)->get_width(channel) * (*reference)->get_storage_bits_per_pixel(channel) / 8;
+
+      for (uint32_t y = 0; y < (*reference)->get_height(channel); y++) {
+        INFO("row: " << y);
+        REQUIRE(memcmp(ref_p + y * ref_stride, result_p + y * result_stride, row_bytes) == 0);
+      }
+    }
+  }
+
+  heif_color_conversion_options_ext_free(options_ext);
+}
+
+
+static void check_alpha_row_kernels(const Alpha_row_kernels& kernels)
+{
+  const uint32_t* reciprocals = get_unpremultiply_reciprocals_8bit();
+
+  // --- 8 bit: all color/alpha combinations in one row, including the invalid premultiplied colors > alpha
+
+  const uint32_t width8 = 256 * 256 + 13;
+  std::vector<uint8_t> c8(width8), a8(width8), out8(width8), rgba(width8 * 4), out_rgba(width8 * 4);
+  for (uint32_t x = 0; x < width8; x++) {
+    c8[x] = (uint8_t) (x & 0xFF);
+    a8[x] = (uint8_t) ((x >> 8) & 0xFF);
+    for (int c = 0; c < 4; c++) {
+      rgba[4 * x + c] = (uint8_t) ((x * (c + 1) + c * 77) & 0xFF);
+    }
+  }
+
+  auto check_rgba = [&](Alpha_RGBA32_row_kernel kernel, bool premultiply) {
+    std::fill(out_rgba.begin(), out_rgba.end(), 0);
+    uint32_t n = kernel(rgba.data(), out_rgba.data(), width8);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width8);
+    for (uint32_t x = 0; x < n; x++) {
+      const uint8_t a = rgba[4 * x + 3];
+      for (int c = 0; c < 3; c++) {
+        INFO("pixel: " << x << " component: " << c);
+        REQUIRE(out_rgba[4 * x + c] == (premultiply ?
+                                        premultiply_sample(rgba[4 * x + c], a, 8) :
+                                        unpremultiply_sample8(rgba[4 * x + c], a, reciprocals)));
+      }
+      REQUIRE(out_rgba[4 * x + 3] == a);
+    }
+  };
+
+  if (kernels.premultiply8) {
+    uint32_t n = kernels.premultiply8(c8.data(), a8.data(), out8.data(), width8);
+    REQUIRE(n > 0);
+    for (uint32_t x = 0; x < n; x++) {
+      REQUIRE(out8[x] == premultiply_sample(c8[x], a8[x], 8));
+    }
+  }
+
+  if (kernels.unpremultiply8) {
+    uint32_t n = kernels.unpremultiply8(c8.data(), a8.data(), out8.data(), width8);
+    REQUIRE(n > 0);
+    for (uint32_t x = 0; x < n; x++) {
+      REQUIRE(out8[x] == unpremultiply_sample8(c8[x], a8[x], reciprocals));
+    }
+  }
+
+  if (kernels.premultiply_rgba32) {
+    check_rgba(kernels.premultiply_rgba32, true);
+  }
+
+  if (kernels.unpremultiply_rgba32) {
+    check_rgba(kernels.unpremultiply_rgba32, false);
+  }
+
+  if (kernels.flatten8) {
+    for (bool premultiplied : {false, true}) {
+      uint32_t n = kernels.flatten8(c8.data(), a8.data(), out8.data(), width8, 200, premultiplied);
+      REQUIRE(n > 0);
+      for (uint32_t x = 0; x < n; x++) {
+        INFO("premultiplied: " << premultiplied << " color: " << (int) c8[x] << " alpha: " << (int) a8[x]);
+        REQUIRE(out8[x] == flatten_sample(c8[x], a8[x], 200, 8, 255, premultiplied));
+      }
+    }
+  }
+
+  // --- high bit depths
+
+  for (int bpp : {10, 12, 16}) {
+    INFO("bpp: " << bpp);
+
+    const uint32_t width16 = 1000 + 7;
+    const uint32_t max_value = (1U << bpp) - 1;
+    std::vector<uint16_t> c16(width16), a16(width16), out16(width16);
+    for (uint32_t x = 0; x < width16; x++) {
+      a16[x] = (uint16_t) ((x * 7919U) & max_value);
+      c16[x] = (uint16_t) ((x * 104729U) & max_value);
+    }
+    a16[0] = 0;
+    a16[1] = (uint16_t) max_value;
+    c16[1] = (uint16_t) max_value;
+
+    if (kernels.premultiply16) {
+      uint32_t n = kernels.premultiply16(c16.data(), a16.data(), out16.data(), width16, bpp);
+      REQUIRE(n > 0);
+      for (uint32_t x = 0; x < n; x++) {
+        REQUIRE(out16[x] == premultiply_sample(c16[x], a16[x], bpp));
+      }
+    }
+
+    if (kernels.unpremultiply16) {
+      uint32_t n = kernels.unpremultiply16(c16.data(), a16.data(), out16.data(), width16, bpp);
+      REQUIRE(n > 0);
+      for (uint32_t x = 0; x < n; x++) {
+        REQUIRE(out16[x] == unpremultiply_sample16(c16[x], a16[x], bpp));
+      }
+    }
+
+    if (kernels.flatten16) {
+      const uint16_t bkg = (uint16_t) (max_value * 3 / 4);
+      for (bool premultiplied : {false, true}) {
+        uint32_t n = kernels.flatten16(c16.data(), a16.data(), out16.data(), width16, bkg, bpp, (uint16_t) max_value, premultiplied);
+        REQUIRE(n > 0);
+        for (uint32_t x = 0; x < n; x++) {
+          INFO("premultiplied: " << premultiplied << " color: " << c16[x] << " alpha: " << a16[x]);
+          REQUIRE(out16[x] == flatten_sample(c16[x], a16[x], bkg, bpp, max_value, premultiplied));
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Alpha SIMD kernels")
+{
+  // the scalar reference is rounded exactly
+  for (uint32_t a = 0; a < 256; a++) {
+    for (uint32_t c = 0; c < 256; c++) {
+      REQUIRE(premultiply_sample(c, a, 8) == (2 * c * a + 255) / 510);
+    }
+  }
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    Alpha_row_kernels kernels;
+    kernels.premultiply8 = premultiply_alpha8_row_sse41;
+    kernels.unpremultiply8 = unpremultiply_alpha8_row_sse41;
+    kernels.premultiply16 = premultiply_alpha16_row_sse41;
+    kernels.unpremultiply16 = unpremultiply_alpha16_row_sse41;
+    kernels.premultiply_rgba32 = premultiply_RGBA32_row_sse41;
+    kernels.unpremultiply_rgba32 = unpremultiply_RGBA32_row_sse41;
+    kernels.flatten8 = flatten_alpha8_row_sse41;
+    kernels.flatten16 = flatten_alpha16_row_sse41;
+    check_alpha_row_kernels(kernels);
+  }
+
+  if (cpu_supports_avx2()) {
+    Alpha_row_kernels kernels;
+    kernels.premultiply8 = premultiply_alpha8_row_avx2;
+    kernels.unpremultiply8 = unpremultiply_alpha8_row_avx2;
+    kernels.premultiply16 = premultiply_alpha16_row_avx2;
+    kernels.unpremultiply16 = unpremultiply_alpha16_row_avx2;
+    kernels.premultiply_rgba32 = premultiply_RGBA32_row_avx2;
+    kernels.unpremultiply_rgba32 = unpremultiply_RGBA32_row_avx2;
+    kernels.flatten8 = flatten_alpha8_row_avx2;
+    kernels.flatten16 = flatten_alpha16_row_avx2;
+    check_alpha_row_kernels(kernels);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_alpha_row_kernels(get_alpha_row_kernels());
+#endif
+}
+
+
+static void check_chroma_sampling_row_kernels(const Chroma_sampling_row_kernels& kernels)
+{
+  const uint32_t width = 203; // not a multiple of the SIMD block sizes
+
+  std::vector<uint8_t> row8[2];
+  std::vector<uint16_t> row16[2];
+  for (int r = 0; r < 2; r++) {
+    row8[r].resize(2 * width);
+    row16[r].resize(2 * width);
+    for (uint32_t x = 0; x < 2 * width; x++) {
+      row8[r][x] = (uint8_t) (x * (37 + 18 * r) + 11);
+      row16[r][x] = (uint16_t) (x * (7919 + 1511 * r) + 101);
+    }
+    // extreme values at the start of the row
+    row8[r][0] = row8[r][1] = 255;
+    row16[r][0] = row16[r][1] = 0xFFFF;
+  }
+
+  // --- upsampling with all vertical weights of the 4:2:0 filter
+
+  for (auto [w0, w1] : {std::pair{4U, 0U}, {3U, 1U}, {1U, 3U}}) {
+    std::vector<uint8_t> out8(2 * width, 0);
+    uint32_t n = kernels.upsample8(row8[0].data(), row8[1].data(), w0, w1, out8.data(), width);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t cx = 0; cx < n; cx++) {
+      INFO("weights: " << w0 << "," << w1 << " sample: " << cx);
+      uint32_t v0 = chroma_vertical_sum(row8[0][cx], row8[1][cx], w0, w1);
+      uint32_t v1 = chroma_vertical_sum(row8[0][cx + 1], row8[1][cx + 1], w0, w1);
+      REQUIRE(out8[2 * cx] == chroma_upsample_sample(v0, v1));
+      REQUIRE(out8[2 * cx + 1] == chroma_upsample_sample(v1, v0));
+    }
+    for (uint32_t x = 2 * n; x < out8.size(); x++) {
+      REQUIRE(out8[x] == 0);
+    }
+
+    std::vector<uint16_t> out16(2 * width, 0);
+    n = kernels.upsample16(row16[0].data(), row16[1].data(), w0, w1, out16.data(), width);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t cx = 0; cx < n; cx++) {
+      INFO("weights: " << w0 << "," << w1 << " sample: " << cx);
+      uint32_t v0 = chroma_vertical_sum(row16[0][cx], row16[1][cx], w0, w1);
+      uint32_t v1 = chroma_vertical_sum(row16[0][cx + 1], row16[1][cx + 1], w0, w1);
+      REQUIRE(out16[2 * cx] == chroma_upsample_sample(v0, v1));
+      REQUIRE(out16[2 * cx + 1] == chroma_upsample_sample(v1, v0));
+    }
+    for (uint32_t x = 2 * n; x < out16.size(); x++) {
+      REQUIRE(out16[x] == 0);
+    }
+  }
+
+  // --- downsampling
+
+  std::vector<uint8_t> out8(width, 0);
+  uint32_t n = kernels.downsample420_8(row8[0].data(), row8[1].data(), out8.data(), width);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+  for (uint32_t x = 0; x < n; x++) {
+    INFO("sample: " << x);
+    REQUIRE(out8[x] == chroma_average_2x2(row8[0][2 * x], row8[0][2 * x + 1], row8[1][2 * x], row8[1][2 * x + 1]));
+  }
+
+  std::fill(out8.begin(), out8.end(), 0);
+  n = kernels.downsample422_8(row8[1].data(), out8.data(), width);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+  for (uint32_t x = 0; x < n; x++) {
+    INFO("sample: " << x);
+    REQUIRE(out8[x] == chroma_average_2x1(row8[1][2 * x], row8[1][2 * x + 1]));
+  }
+
+  std::vector<uint16_t> out16(width, 0);
+  n = kernels.downsample420_16(row16[0].data(), row16[1].data(), out16.data(), width);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+  for (uint32_t x = 0; x < n; x++) {
+    INFO("sample: " << x);
+    REQUIRE(out16[x] == chroma_average_2x2(row16[0][2 * x], row16[0][2 * x + 1], row16[1][2 * x], row16[1][2 * x + 1]));
+  }
+
+  std::fill(out16.begin(), out16.end(), 0);
+  n = kernels.downsample422_16(row16[1].data(), out16.data(), width);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+  for (uint32_t x = 0; x < n; x++) {
+    INFO("sample: " << x);
+    REQUIRE(out16[x] == chroma_average_2x1(row16[1][2 * x], row16[1][2 * x + 1]));
+  }
+}
+
+
+TEST_CASE("Chroma sampling SIMD kernels")
+{
+  // the 4:2:0 filter with a single row is the 4:2:2 filter
+  for (uint32_t a = 0; a < 256; a++) {
+    for (uint32_t b = 0; b < 256; b++) {
+      REQUIRE(chroma_upsample_sample(4 * a, 4 * b) == (3 * a + b + 2) / 4);
+    }
+  }
+
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    Chroma_sampling_row_kernels kernels;
+    kernels.upsample8 = upsample_chroma8_row_sse41;
+    kernels.upsample16 = upsample_chroma16_row_sse41;
+    kernels.downsample420_8 = downsample_chroma420_8_row_sse41;
+    kernels.downsample420_16 = downsample_chroma420_16_row_sse41;
+    kernels.downsample422_8 = downsample_chroma422_8_row_sse41;
+    kernels.downsample422_16 = downsample_chroma422_16_row_sse41;
+    check_chroma_sampling_row_kernels(kernels);
+  }
+
+  if (cpu_supports_avx2()) {
+    Chroma_sampling_row_kernels kernels;
+    kernels.upsample8 = upsample_chroma8_row_avx2;
+    kernels.upsample16 = upsample_chroma16_row_avx2;
+    kernels.downsample420_8 = downsample_chroma420_8_row_avx2;
+    kernels.downsample420_16 = downsample_chroma420_16_row_avx2;
+    kernels.downsample422_8 = downsample_chroma422_8_row_avx2;
+    kernels.downsample422_16 = downsample_chroma422_16_row_avx2;
+    check_chroma_sampling_row_kernels(kernels);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_chroma_sampling_row_kernels(get_chroma_sampling_row_kernels());
+#endif
+}
+
+
+static void check_YCbCr444_to_RGB_float_row_kernel(YCbCr444_to_RGB_float_row_kernel kernel)
+{
+  const uint32_t width = 75;
+
+  std::vector<uint8_t> y(width), cb(width), cr(width), a(width);
+  for (uint32_t x = 0; x < width; x++) {
+    y[x] = (uint8_t) (x * 37 + 11);
+    cb[x] = (uint8_t) (x * 71 + 3);
+    cr[x] = (uint8_t) (255 - x * 53);
+    a[x] = (uint8_t) (x * 13);
+  }
+
+  auto coeffs = get_YCbCr_to_RGB_coefficients(heif_matrix_coefficients_ITU_R_BT_709_5, heif_color_primaries_ITU_R_BT_709_5);
+
+  for (int bytes_per_pixel : {3, 4}) {
+    for (bool full_range : {true, false}) {
+      std::vector<uint8_t> out(width * bytes_per_pixel, 0);
+      uint32_t converted = kernel(y.data(), cb.data(), cr.data(), a.data(), out.data(), bytes_per_pixel, width,
+                                  coeffs, full_range);
+      REQUIRE(converted > 0);
+      REQUIRE(converted <= width);
+
+      for (uint32_t x = 0; x < converted; x++) {
+        INFO("column: " << x << " full range: " << full_range);
+
+        // the scalar code of the fused 4:2:0 Op
+        float yv = static_cast<float>(y[x]);
+        float cbv = static_cast<float>(cb[x] - 128);
+        float crv = static_cast<float>(cr[x] - 128);
+
+        if (!full_range) {
+          yv = (yv - 16.0f) * 1.1689f;
+          cbv = cbv * 1.1429f;
+          crv = crv * 1.1429f;
+        }
+
+        REQUIRE(out[x * bytes_per_pixel + 0] == clip_f_u16(yv + coeffs.r_cr * crv, 255));
+        REQUIRE(out[x * bytes_per_pixel + 1] == clip_f_u16(yv + coeffs.g_cb * cbv + coeffs.g_cr * crv, 255));
+        REQUIRE(out[x * bytes_per_pixel + 2] == clip_f_u16(yv + coeffs.b_cb * cbv, 255));
+        if (bytes_per_pixel == 4) {
+          REQUIRE(out[x * bytes_per_pixel + 3] == a[x]);
+        }
+      }
+
+      for (uint32_t i = converted * bytes_per_pixel; i < out.size(); i++) {
+        REQUIRE(out[i] == 0);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("YCbCr444 to RGB float SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    check_YCbCr444_to_RGB_float_row_kernel(YCbCr444_to_RGB_float_row_sse41);
+  }
+
+  if (cpu_supports_avx2()) {
+    check_YCbCr444_to_RGB_float_row_kernel(YCbCr444_to_RGB_float_row_avx2);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_YCbCr444_to_RGB_float_row_kernel(YCbCr444_to_RGB_float_row_neon);
+#endif
+}
+
+
+static void check_RGB_interleave_row_kernels(const RGB_interleave_row_kernels& kernels)
+{
+  const uint32_t width = 203; // not a multiple of the SIMD block sizes
+
+  std::vector<uint8_t> planes[4];
+  for (int c = 0; c < 4; c++) {
+    planes[c].resize(width);
+    for (uint32_t x = 0; x < width; x++) {
+      planes[c][x] = (uint8_t) (x * (37 + 20 * c) + 11 * c);
+    }
+  }
+
+  // --- interleaving
+
+  struct InterleaveKernel
+  {
+    Interleave_RGB8_row_kernel kernel;
+    int components;
+    bool big_endian;
+  };
+
+  for (const InterleaveKernel& k : {InterleaveKernel{kernels.interleave_rgb24, 3, false},
+                                    InterleaveKernel{kernels.interleave_rgba32, 4, false},
+                                    InterleaveKernel{kernels.interleave_rrggbb_be, 3, true},
+                                    InterleaveKernel{kernels.interleave_rrggbbaa_be, 4, true}}) {
+    for (bool with_alpha : {true, false}) {
+      const int bytes_per_sample = k.big_endian ? 2 : 1;
+      std::vector<uint8_t> out(width * k.components * bytes_per_sample, 0x55);
+
+      uint32_t n = k.kernel(planes[0].data(), planes[1].data(), planes[2].data(),
+                            with_alpha ? planes[3].data() : nullptr, out.data(), width);
+      REQUIRE(n > 0);
+      REQUIRE(n <= width);
+
+      for (uint32_t x = 0; x < n; x++) {
+        for (int c = 0; c < k.components; c++) {
+          INFO("components: " << k.components << " big endian: " << k.big_endian << " pixel: " << x << " component: " << c);
+          uint8_t expected = (c == 3 && !with_alpha) ? 0xFF : planes[c][x];
+          size_t idx = (x * k.components + c) * bytes_per_sample;
+          if (k.big_endian) {
+            REQUIRE(out[idx] == 0);
+            REQUIRE(out[idx + 1] == expected);
+          }
+          else {
+            REQUIRE(out[idx] == expected);
+          }
+        }
+      }
+
+      for (size_t i = n * k.components * bytes_per_sample; i < out.size(); i++) {
+        REQUIRE(out[i] == 0x55);
+      }
+    }
+  }
+
+  // --- deinterleaving
+
+  for (int components : {3, 4}) {
+    std::vector<uint8_t> in(width * components);
+    for (uint32_t x = 0; x < width; x++) {
+      for (int c = 0; c < components; c++) {
+        in[x * components + c] = planes[c][x];
+      }
+    }
+
+    Deinterleave_RGB8_row_kernel kernel = (components == 4) ? kernels.deinterleave_rgba32 : kernels.deinterleave_rgb24;
+
+    for (bool with_alpha : {true, false}) {
+      std::vector<uint8_t> out[4];
+      for (auto& o : out) {
+        o.resize(width, 0x55);
+      }
+
+      uint32_t n = kernel(in.data(), out[0].data(), out[1].data(), out[2].data(),
+                          with_alpha ? out[3].data() : nullptr, width);
+      REQUIRE(n > 0);
+      REQUIRE(n <= width);
+
+      for (uint32_t x = 0; x < width; x++) {
+        INFO("components: " << components << " pixel: " << x);
+        for (int c = 0; c < 3; c++) {
+          REQUIRE(out[c][x] == (x < n ? planes[c][x] : 0x55));
+        }
+
+        bool alpha_written = (x < n && components == 4 && with_alpha);
+        REQUIRE(out[3][x] == (alpha_written ? planes[3][x] : 0x55));
+      }
+    }
+  }
+
+  // --- byte swap, into a separate buffer and in place
+
+  const uint32_t num_bytes = 2 * width;
+  std::vector<uint8_t> in(num_bytes);
+  for (uint32_t i = 0; i < num_bytes; i++) {
+    in[i] = (uint8_t) (i * 29 + 7);
+  }
+
+  std::vector<uint8_t> out(num_bytes, 0x55);
+  uint32_t n = kernels.swap_bytes16(in.data(), out.data(), num_bytes);
+  REQUIRE(n > 0);
+  REQUIRE(n <= num_bytes);
+  REQUIRE(n % 2 == 0);
+  for (uint32_t i = 0; i < num_bytes; i++) {
+    REQUIRE(out[i] == (i < n ? in[i ^ 1] : 0x55));
+  }
+
+  std::vector<uint8_t> inplace = in;
+  REQUIRE(kernels.swap_bytes16(inplace.data(), inplace.data(), num_bytes) == n);
+  for (uint32_t i = 0; i < num_bytes; i++) {
+    REQUIRE(inplace[i] == (i < n ? in[i ^ 1] : in[i]));
+  }
+}
+
+
+TEST_CASE("RGB interleave SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    RGB_interleave_row_kernels kernels;
+    kernels.interleave_rgb24 = interleave_RGB24_row_sse41;
+    kernels.interleave_rgba32 = interleave_RGBA32_row_sse41;
+    kernels.interleave_rrggbb_be = interleave_RRGGBB_BE_row_sse41;
+    kernels.interleave_rrggbbaa_be = interleave_RRGGBBAA_BE_row_sse41;
+    kernels.deinterleave_rgb24 = deinterleave_RGB24_row_sse41;
+    kernels.deinterleave_rgba32 = deinterleave_RGBA32_row_sse41;
+    kernels.swap_bytes16 = swap_bytes16_row_sse41;
+    check_RGB_interleave_row_kernels(kernels);
+
+    if (cpu_supports_avx2()) {
+      kernels.swap_bytes16 = swap_bytes16_row_avx2;
+      check_RGB_interleave_row_kernels(kernels);
+    }
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_RGB_interleave_row_kernels(get_RGB_interleave_row_kernels());
+#endif
+}
+
+
+TEST_CASE("In-place endianness swap")
+{
+  const uint32_t width = 37, height = 5;
+
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBBAA_LE);
+  REQUIRE(!img->add_plane(heif_channel_interleaved, width, height, 12, nullptr));
+
+  size_t stride;
+  uint16_t* p = (uint16_t*) img->get_plane(heif_channel_interleaved, &stride);
+  stride /= 2;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < 4 * width; x++) {
+      p[y * stride + x] = (uint16_t) ((x * 97 + y * 13) & 0xFFF);
+    }
+  }
+
+  ColorState input_state(heif_colorspace_RGB, heif_chroma_interleaved_RRGGBBAA_LE, true, 12);
+  ColorState target_state(heif_colorspace_RGB, heif_chroma_interleaved_RRGGBBAA_BE, true, 12);
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_ext options_ext{};
+
+  Op_RRGGBBaa_swap_endianness op;
+  REQUIRE(op.supports_in_place_conversion());
+
+  auto copy = op.convert_colorspace(img, input_state, target_state, options, options_ext, nullptr);
+  REQUIRE(copy);
+
+  REQUIRE(!op.convert_colorspace_in_place(img, input_state, target_state, options, options_ext));
+  REQUIRE(img->get_chroma_format() == heif_chroma_interleaved_RRGGBBAA_BE);
+  REQUIRE((*copy)->get_chroma_format() == heif_chroma_interleaved_RRGGBBAA_BE);
+
+  const uint8_t* swapped = img->get_plane(heif_channel_interleaved, &stride);
+  size_t copy_stride;
+  const uint8_t* expected = (*copy)->get_plane(heif_channel_interleaved, &copy_stride);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < 4 * width; x++) {
+      uint16_t v = (uint16_t) ((x * 97 + y * 13) & 0xFFF);
+      INFO("x: " << x << " y: " << y);
+      REQUIRE(swapped[y * stride + 2 * x] == (v >> 8));
+      REQUIRE(swapped[y * stride + 2 * x + 1] == (v & 0xFF));
+      REQUIRE(expected[y * copy_stride + 2 * x] == (v >> 8));
+      REQUIRE(expected[y * copy_stride + 2 * x + 1] == (v & 0xFF));
+    }
+  }
+}
+
+
+TEST_CASE("Shared planes")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+
+  ColorState input_state(heif_colorspace_YCbCr, heif_chroma_444, true, 8);
+  ColorState target_state(heif_colorspace_YCbCr, heif_chroma_420, true, 8);
+
+  auto in_image = create_random_image(input_state, 32, 16);
+
+  size_t in_y_stride;
+  const uint8_t* in_y = in_image->get_plane(heif_channel_Y, &in_y_stride);
+  std::vector<uint8_t> y_copy(in_y, in_y + in_y_stride * 16);
+
+  SECTION("chroma subsampling passes luma and alpha through") {
+    ColorConversionPipeline pipeline;
+    REQUIRE(pipeline.construct_pipeline(input_state, target_state, options, options_ext));
+    pipeline.set_strip_height(0);
+
+    auto result = pipeline.convert_image(in_image, nullptr);
+    REQUIRE(result);
+
+    size_t stride;
+    REQUIRE((*result)->get_plane(heif_channel_Y, &stride) == in_y);
+    REQUIRE((*result)->get_plane(heif_channel_Alpha, &stride) == in_image->get_plane(heif_channel_Alpha, &stride));
+    REQUIRE(!(*result)->owns_plane_memory());
+
+    // the shared planes keep the memory of the input alive
+    in_image.reset();
+
+    const uint8_t* y = (*result)->get_plane(heif_channel_Y, &stride);
+    REQUIRE(stride == in_y_stride);
+    REQUIRE(memcmp(y, y_copy.data(), y_copy.size()) == 0);
+  }
+
+  SECTION("dropping the alpha plane does not copy") {
+    ColorState no_alpha_state = input_state;
+    no_alpha_state.has_alpha = false;
+
+    Op_drop_alpha_plane op;
+    auto result = op.convert_colorspace(in_image, input_state, no_alpha_state, options, options_ext, nullptr);
+    REQUIRE(result);
+    REQUIRE(!(*result)->has_channel(heif_channel_Alpha));
+
+    for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+      size_t stride;
+      REQUIRE((*result)->get_plane(channel, &stride) == in_image->get_plane(channel, &stride));
+    }
+  }
+}
+
+
+TEST_CASE("Monochrome to RGB")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+
+  const uint32_t width = 37, height = 11;
+
+  for (int bpp : {8, 12}) {
+    for (bool has_alpha : {false, true}) {
+      std::vector<ColorState> targets = {ColorState(heif_colorspace_RGB, heif_chroma_444, has_alpha, bpp)};
+      if (bpp == 8) {
+        if (!has_alpha) {
+          targets.emplace_back(heif_colorspace_RGB, heif_chroma_interleaved_RGB, false, 8);
+        }
+        targets.emplace_back(heif_colorspace_RGB, heif_chroma_interleaved_RGBA, true, 8);
+      }
+
+      ColorState input_state(heif_colorspace_monochrome, heif_chroma_monochrome, has_alpha, bpp);
+      auto in_image = create_random_image(input_state, width, height);
+
+      size_t in_stride, in_a_stride = 0;
+      const uint8_t* in_y = in_image->get_plane(heif_channel_Y, &in_stride);
+      const uint8_t* in_a = has_alpha ? in_image->get_plane(heif_channel_Alpha, &in_a_stride) : nullptr;
+
+      for (const ColorState& target_state : targets) {
+        INFO("from: " << input_state << "\nto: " << target_state);
+
+        // no 4:2:0 intermediate with synthetic chroma planes
+
+        ColorConversionPipeline pipeline;
+        REQUIRE(pipeline.construct_pipeline(input_state, target_state, options, options_ext));
+        INFO(pipeline.debug_dump_pipeline());
+        REQUIRE(pipeline.debug_dump_pipeline().find("final pipeline has 1 steps") == 0);
+
+        auto result = pipeline.convert_image(in_image, nullptr);
+        REQUIRE(result);
+
+        if (target_state.chroma == heif_chroma_444) {
+          for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+            size_t stride;
+            const uint8_t* p = (*result)->get_plane(channel, &stride);
+            for (uint32_t y = 0; y < height; y++) {
+              REQUIRE(memcmp(p + y * stride, in_y + y * in_stride, width * (bpp > 8 ? 2 : 1)) == 0);
+            }
+          }
+
+          REQUIRE((*result)->has_channel(heif_channel_Alpha) == has_alpha);
+        }
+        else {
+          int components = (target_state.chroma == heif_chroma_interleaved_RGBA) ? 4 : 3;
+
+          size_t stride;
+          const uint8_t* p = (*result)->get_plane(heif_channel_interleaved, &stride);
+          for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+              uint8_t v = in_y[y * in_stride + x];
+              REQUIRE(p[y * stride + components * x + 0] == v);
+              REQUIRE(p[y * stride + components * x + 1] == v);
+              REQUIRE(p[y * stride + components * x + 2] == v);
+              if (components == 4) {
+                REQUIRE(p[y * stride + 4 * x + 3] == (in_a ? in_a[y * in_a_stride + x] : 0xFF));
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Alpha premultiplication conversion")
+{
+  const uint32_t width = 37, height = 3;
+
+  auto in_image = std::make_shared<HeifPixelImage>();
+  in_image->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B, heif_channel_Alpha}) {
+    REQUIRE(!in_image->add_plane(channel, width, height, 8, nullptr));
+  }
+
+  auto value = [](heif_channel channel, uint32_t x, uint32_t y) -> uint8_t {
+    if (channel == heif_channel_Alpha) {
+      return (uint8_t) ((x * 7 + y * 90) & 0xFF);
+    }
+    return (uint8_t) ((x * 29 + y * 50 + channel * 60) & 0xFF);
+  };
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B, heif_channel_Alpha}) {
+    size_t stride;
+    uint8_t* p = in_image->get_plane(channel, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        p[y * stride + x] = value(channel, x, y);
+      }
+    }
+  }
+
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext* options_ext = heif_color_conversion_options_ext_alloc();
+  REQUIRE(options_ext->version >= 3);
+  REQUIRE(options_ext->alpha_premultiplication_mode == heif_alpha_premultiplication_mode_keep);
+
+  // --- straight planar RGB to premultiplied interleaved RGBA
+
+  options_ext->alpha_premultiplication_mode = heif_alpha_premultiplication_mode_premultiplied;
+  auto premultiplied = convert_colorspace(in_image, heif_colorspace_RGB, heif_chroma_interleaved_RGBA, nullptr, 8,
+                                          options, options_ext, nullptr);
+  REQUIRE(premultiplied);
+  REQUIRE((*premultiplied)->is_premultiplied_alpha());
+
+  size_t stride;
+  const uint8_t* p = (*premultiplied)->get_plane(heif_channel_interleaved, &stride);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      INFO("x: " << x << " y: " << y);
+      uint8_t a = value(heif_channel_Alpha, x, y);
+      REQUIRE(p[y * stride + 4 * x + 0] == premultiply_sample(value(heif_channel_R, x, y), a, 8));
+      REQUIRE(p[y * stride + 4 * x + 1] == premultiply_sample(value(heif_channel_G, x, y), a, 8));
+      REQUIRE(p[y * stride + 4 * x + 2] == premultiply_sample(value(heif_channel_B, x, y), a, 8));
+      REQUIRE(p[y * stride + 4 * x + 3] == a);
+    }
+  }
+
+  // --- keeping the premultiplication does not convert the colors
+
+  options_ext->alpha_premultiplication_mode = heif_alpha_premultiplication_mode_keep;
+  auto kept = convert_colorspace(*premultiplied, heif_colorspace_RGB, heif_chroma_interleaved_RGBA, nullptr, 8,
+                                 options, options_ext, nullptr);
+  REQUIRE(kept);
+  REQUIRE(*kept == *premultiplied);
+
+  // --- back to straight alpha
+
+  options_ext->alpha_premultiplication_mode = heif_alpha_premultiplication_mode_straight;
+  auto straight = convert_colorspace(*premultiplied, heif_colorspace_RGB, heif_chroma_444, nullptr, 8,
+                                     options, options_ext, nullptr);
+  REQUIRE(straight);
+  REQUIRE(!(*straight)->is_premultiplied_alpha());
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    const uint8_t* s = (*straight)->get_plane(channel, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        INFO("x: " << x << " y: " << y << " channel: " << channel);
+        uint8_t a = value(heif_channel_Alpha, x, y);
+        uint8_t expected = unpremultiply_sample8(premultiply_sample(value(channel, x, y), a, 8), a,
+                                                 get_unpremultiply_reciprocals_8bit());
+        REQUIRE(s[y * stride + x] == expected);
+        if (a == 255) {
+          REQUIRE(s[y * stride + x] == value(channel, x, y));
+        }
+      }
+    }
+  }
+
+  // --- composing premultiplied colors onto a background
+
+  options_ext->alpha_premultiplication_mode = heif_alpha_premultiplication_mode_premultiplied;
+  auto premultiplied_planar = convert_colorspace(in_image, heif_colorspace_RGB, heif_chroma_444, nullptr, 8,
+                                                 options, options_ext, nullptr);
+  REQUIRE(premultiplied_planar);
+  REQUIRE((*premultiplied_planar)->is_premultiplied_alpha());
+
+  options_ext->alpha_premultiplication_mode = heif_alpha_premultiplication_mode_keep;
+  options_ext->alpha_composition_mode = heif_alpha_composition_mode_solid_color;
+  options_ext->background_red = options_ext->background_green = options_ext->background_blue = 0xFFFF;
+
+  for (bool premultiplied_input : {false, true}) {
+    auto input = premultiplied_input ? *premultiplied_planar : in_image;
+    auto flattened = convert_colorspace(input, heif_colorspace_RGB, heif_chroma_444, nullptr, 8,
+                                        options, options_ext, nullptr);
+    REQUIRE(flattened);
+    REQUIRE(!(*flattened)->has_channel(heif_channel_Alpha));
+
+    const uint8_t* r = (*flattened)->get_plane(heif_channel_R, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        INFO("x: " << x << " y: " << y << " premultiplied: " << premultiplied_input);
+        uint8_t a = value(heif_channel_Alpha, x, y);
+        uint8_t c = value(heif_channel_R, x, y);
+        uint32_t expected = premultiplied_input ?
+                            flatten_sample(premultiply_sample(c, a, 8), a, 255, 8, 255, true) :
+                            flatten_sample(c, a, 255, 8, 255, false);
+        REQUIRE(r[y * stride + x] == expected);
+      }
+    }
+  }
+
+  heif_color_conversion_options_ext_free(options_ext);
+}
+
+
+static void check_bit_depth_row_kernels(Widen_8_to_16_row_kernel widen, Narrow_16_to_8_row_kernel narrow)
+{
+  const uint32_t width = 1000 + 11;
+
+  std::vector<uint8_t> in8(width), out8(width);
+  std::vector<uint16_t> in16(width), out16(width);
+  for (uint32_t x = 0; x < width; x++) {
+    in8[x] = (uint8_t) (x * 59 + 3);
+    in16[x] = (uint16_t) (x * 40503U);
+  }
+  in16[0] = 0xFFFF;
+
+  for (int bits = 9; bits <= 16; bits++) {
+    INFO("bits: " << bits);
+
+    uint32_t n = widen(in8.data(), out16.data(), width, bits);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t x = 0; x < n; x++) {
+      REQUIRE(out16[x] == (uint16_t) ((in8[x] << (bits - 8)) | (in8[x] >> (16 - bits))));
+    }
+
+    const int shift = bits - 8;
+    for (auto [offset_even, offset_odd] : {std::pair<uint16_t, uint16_t>{0, 0}, {1, 0}, {0, 1}, {3, 1}, {128, 128}}) {
+      if (offset_even >= (1 << shift) || offset_odd >= (1 << shift)) {
+        continue;
+      }
+
+      n = narrow(in16.data(), out8.data(), width, shift, offset_even, offset_odd);
+      REQUIRE(n > 0);
+      REQUIRE(n <= width);
+      for (uint32_t x = 0; x < n; x++) {
+        INFO("x: " << x);
+        uint32_t offset = (x & 1) ? offset_odd : offset_even;
+        REQUIRE(out8[x] == std::min(std::min(in16[x] + offset, 0xFFFFU) >> shift, 255U));
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Bit depth SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    check_bit_depth_row_kernels(widen_8_to_16_row_sse41, narrow_16_to_8_row_sse41);
+  }
+
+  if (cpu_supports_avx2()) {
+    check_bit_depth_row_kernels(widen_8_to_16_row_avx2, narrow_16_to_8_row_avx2);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_bit_depth_row_kernels(widen_8_to_16_row_neon, narrow_16_to_8_row_neon);
+#endif
+
+  // scalar reduction methods
+  const uint16_t in[4] = {0x3FF, 0x201, 0x202, 0x203};
+  uint8_t out[4];
+
+  reduce_row_to_8bit(in, out, 4, 10, heif_bit_depth_reduction_method_truncate, 0);
+  REQUIRE(std::vector<uint8_t>(out, out + 4) == std::vector<uint8_t>{0xFF, 0x80, 0x80, 0x80});
+
+  reduce_row_to_8bit(in, out, 4, 10, heif_bit_depth_reduction_method_round, 0);
+  REQUIRE(std::vector<uint8_t>(out, out + 4) == std::vector<uint8_t>{0xFF, 0x80, 0x81, 0x81});
+
+  // 2x2 dither pattern for 2 dropped bits: {0, 2}, {3, 1}
+  reduce_row_to_8bit(in, out, 4, 10, heif_bit_depth_reduction_method_dither, 0);
+  REQUIRE(std::vector<uint8_t>(out, out + 4) == std::vector<uint8_t>{0xFF, 0x80, 0x80, 0x81});
+  reduce_row_to_8bit(in, out, 4, 10, heif_bit_depth_reduction_method_dither, 1);
+  REQUIRE(std::vector<uint8_t>(out, out + 4) == std::vector<uint8_t>{0xFF, 0x80, 0x81, 0x81});
+}
+
+
+TEST_CASE("Fused HDR YCbCr420 to interleaved RGB")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext* options_ext = heif_color_conversion_options_ext_alloc();
+  REQUIRE(options_ext->version >= 4);
+  REQUIRE(options_ext->bit_depth_reduction_method == heif_bit_depth_reduction_method_truncate);
+
+  color_profile_nclx nclx;
+  nclx.set_matrix_coefficients(heif_matrix_coefficients_ITU_R_BT_601_6);
+  nclx.set_full_range_flag(true);
+
+  for (heif_chroma out_chroma : {heif_chroma_interleaved_RGB, heif_chroma_interleaved_RGBA}) {
+    for (auto method : {heif_bit_depth_reduction_method_truncate,
+                        heif_bit_depth_reduction_method_round,
+                        heif_bit_depth_reduction_method_dither}) {
+      options_ext->bit_depth_reduction_method = method;
+      INFO("chroma: " << out_chroma << " method: " << method);
+
+      ColorState input_state(heif_colorspace_YCbCr, heif_chroma_420, out_chroma == heif_chroma_interleaved_RGBA, 10);
+      input_state.nclx_profile = nclx;
+      ColorState target_state(heif_colorspace_RGB, out_chroma, out_chroma == heif_chroma_interleaved_RGBA, 8);
+      target_state.nclx_profile = nclx;
+
+      // the bit depth reduction is done in the same pass as the RGB conversion
+
+      ColorConversionPipeline pipeline;
+      REQUIRE(pipeline.construct_pipeline(input_state, target_state, options, *options_ext));
+      INFO(pipeline.debug_dump_pipeline());
+      REQUIRE(pipeline.debug_dump_pipeline().find("final pipeline has 1 steps") == 0);
+
+      auto in_image = create_random_image(input_state, 75, 31);
+      auto fused = pipeline.convert_image(in_image, nullptr);
+      REQUIRE(fused);
+
+      // the same result as reducing the planes to 8 bits first
+
+      ColorState sdr_state = input_state;
+      sdr_state.bits_per_pixel = 8;
+
+      ColorConversionPipeline to_sdr;
+      REQUIRE(to_sdr.construct_pipeline(input_state, sdr_state, options, *options_ext));
+      auto sdr_image = to_sdr.convert_image(in_image, nullptr);
+      REQUIRE(sdr_image);
+
+      ColorConversionPipeline to_rgb;
+      REQUIRE(to_rgb.construct_pipeline(sdr_state, target_state, options, *options_ext));
+      INFO(to_rgb.debug_dump_pipeline());
+      auto reference = to_rgb.convert_image(*sdr_image, nullptr);
+      REQUIRE(reference);
+
+      size_t ref_stride, fused_stride;
+      const uint8_t* ref_p = (*reference)->get_plane(heif_channel_interleaved, &ref_stride);
+      const uint8_t* fused_p = (*fused)->get_plane(heif_channel_interleaved, &fused_stride);
+      uint32_t row_bytes = 75 * (out_chroma == heif_chroma_interleaved_RGBA ? 4 : 3);
+
+      for (uint32_t y = 0; y < 31; y++) {
+        INFO("row: " << y);
+        REQUIRE(memcmp(ref_p + y * ref_stride, fused_p + y * fused_stride, row_bytes) == 0);
+      }
+    }
+  }
+
+  heif_color_conversion_options_ext_free(options_ext);
+}
+
+
+static void check_gain_map_row_kernel(Gain_map_row_kernel kernel)
+{
+  const uint32_t width = 37;
+  std::vector<float> base(width), gain(width);
+  for (uint32_t x = 0; x < width; x++) {
+    base[x] = (float) x / 8.0f - 0.5f;
+    gain[x] = 0.5f + (float) (x % 5);
+  }
+
+  std::vector<uint16_t> out(width);
+  uint32_t n = kernel(base.data(), gain.data(), out.data(), width, 0.015625f, 0.03125f, 65535.0f / 4);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+
+  for (uint32_t x = 0; x < n; x++) {
+    INFO("x: " << x);
+    float v = ((base[x] + 0.015625f) * gain[x] - 0.03125f) * (65535.0f / 4) + 0.5f;
+    REQUIRE(out[x] == (uint16_t) std::min(std::max(v, 0.0f), 65535.0f));
+  }
+}
+
+
+TEST_CASE("Gain map SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    check_gain_map_row_kernel(apply_gain_row_sse41);
+  }
+
+  if (cpu_supports_avx2()) {
+    check_gain_map_row_kernel(apply_gain_row_avx2);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_gain_map_row_kernel(apply_gain_row_neon);
+#endif
+}
+
+
+static std::shared_ptr<HeifPixelImage> create_linear_rgb_image(uint32_t width, uint32_t height, uint8_t value)
+{
+  auto image = std::make_shared<HeifPixelImage>();
+  image->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    REQUIRE(!image->add_plane(channel, width, height, 8, nullptr));
+    image->fill_plane(channel, value);
+  }
+
+  auto nclx = std::make_shared<color_profile_nclx>();
+  nclx->set_transfer_characteristics(heif_transfer_characteristic_linear);
+  image->set_color_profile_nclx(nclx);
+
+  return image;
+}
+
+
+static std::shared_ptr<HeifPixelImage> create_gain_map(uint32_t width, uint32_t height, const std::vector<uint8_t>& values)
+{
+  auto image = std::make_shared<HeifPixelImage>();
+  image->create(width, height, heif_colorspace_monochrome, heif_chroma_monochrome);
+  REQUIRE(!image->add_plane(heif_channel_Y, width, height, 8, nullptr));
+
+  size_t stride;
+  uint8_t* p = image->get_plane(heif_channel_Y, &stride);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      p[y * stride + x] = values[(y * width + x) % values.size()];
+    }
+  }
+
+  return image;
+}
+
+
+TEST_CASE("Apply gain map")
+{
+  heif_gain_map_parameters params{};
+  params.version = 1;
+  for (int c = 0; c < 3; c++) {
+    params.gain_map_min[c] = 0.0f;
+    params.gain_map_max[c] = 1.0f;
+    params.gamma[c] = 1.0f;
+    params.base_offset[c] = 0.0f;
+    params.alternate_offset[c] = 0.0f;
+  }
+  params.base_hdr_headroom = 0.0f;
+  params.alternate_hdr_headroom = 2.0f;
+
+  const float base_linear = 128.0f / 255.0f;
+
+  auto expected = [&](float gain_factor, float headroom) {
+    float v = std::min(base_linear * gain_factor / std::exp2(headroom), 1.0f);
+    return (uint16_t) (v * 65535.0f + 0.5f);
+  };
+
+  SECTION("uniform gain map at different headrooms") {
+    auto base = create_linear_rgb_image(37, 3, 128);
+    auto gain = create_gain_map(5, 2, {255});
+
+    for (float headroom : {0.0f, 1.0f, 2.0f, 3.0f}) {
+      INFO("headroom: " << headroom);
+      auto result = apply_gain_map(base, gain, params, headroom, nullptr);
+      REQUIRE(result);
+      auto out = *result;
+
+      REQUIRE(out->get_colorspace() == heif_colorspace_RGB);
+      REQUIRE(out->get_bits_per_pixel(heif_channel_G) == 16);
+      REQUIRE(out->get_color_profile_nclx()->get_transfer_characteristics() == heif_transfer_characteristic_linear);
+
+      // full gain (x2) at the alternate headroom, no gain for SDR displays
+      float weight = std::min(headroom / 2.0f, 1.0f);
+      uint16_t value = expected(std::exp2(weight), headroom);
+
+      for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+        size_t stride;
+        const uint16_t* p = out->get_channel<uint16_t>(channel, &stride);
+        for (uint32_t y = 0; y < 3; y++) {
+          for (uint32_t x = 0; x < 37; x++) {
+            INFO("x: " << x << " y: " << y);
+            REQUIRE(std::abs(p[y * stride + x] - value) <= 1);
+          }
+        }
+      }
+    }
+  }
+
+  SECTION("gain map is scaled bilinearly") {
+    auto base = create_linear_rgb_image(4, 1, 128);
+    auto gain = create_gain_map(2, 1, {0, 255});
+
+    auto result = apply_gain_map(base, gain, params, 2.0f, nullptr);
+    REQUIRE(result);
+
+    size_t stride;
+    const uint16_t* p = (*result)->get_channel<uint16_t>(heif_channel_R, &stride);
+
+    // sample positions in the gain map: 0, 0.25, 0.75, 1
+    REQUIRE(std::abs(p[0] - expected(1.0f, 2.0f)) <= 1);
+    REQUIRE(std::abs(p[1] - expected(1.25f, 2.0f)) <= 1);
+    REQUIRE(std::abs(p[2] - expected(1.75f, 2.0f)) <= 1);
+    REQUIRE(std::abs(p[3] - expected(2.0f, 2.0f)) <= 1);
+  }
+
+  SECTION("headroom from clli") {
+    auto base = create_linear_rgb_image(4, 4, 128);
+    base->set_clli({406, 0});
+    auto gain = create_gain_map(1, 1, {255});
+
+    REQUIRE(get_hdr_headroom_from_metadata(*base, 5.0f) == Catch::Approx(1.0f));
+
+    auto result = apply_gain_map(base, gain, params, -1.0f, nullptr);
+    REQUIRE(result);
+    REQUIRE((*result)->get_clli().max_content_light_level == 406);
+
+    size_t stride;
+    const uint16_t* p = (*result)->get_channel<uint16_t>(heif_channel_B, &stride);
+    REQUIRE(std::abs(p[0] - expected(std::exp2(0.5f), 1.0f)) <= 1);
+  }
+
+  SECTION("invalid parameters") {
+    auto base = create_linear_rgb_image(4, 4, 128);
+    auto gain = create_gain_map(1, 1, {255});
+
+    params.gamma[1] = 0.0f;
+    auto result = apply_gain_map(base, gain, params, 1.0f, nullptr);
+    REQUIRE(!result);
+    REQUIRE(result.error.sub_error_code == heif_suberror_Invalid_parameter_value);
+  }
+}
+
+
+TEST_CASE("Half float conversion")
+{
+  REQUIRE(float_to_half(1.0f) == 0x3C00);
+  REQUIRE(float_to_half(-2.0f) == 0xC000);
+  REQUIRE(float_to_half(65504.0f) == 0x7BFF);
+  REQUIRE(float_to_half(65520.0f) == 0x7C00); // rounds to infinity
+  REQUIRE(float_to_half(std::ldexp(1.0f, -24)) == 0x0001);
+  REQUIRE(float_to_half(std::ldexp(1.0f, -26)) == 0x0000);
+  REQUIRE(float_to_half(1.0f + std::ldexp(1.0f, -11)) == 0x3C00); // tie, rounds to even
+  REQUIRE(float_to_half(1.0f + 3 * std::ldexp(1.0f, -11)) == 0x3C02);
+  REQUIRE(std::isnan(half_to_float(float_to_half(std::nanf("")))));
+
+  // all values that are not NaN survive the round trip
+  for (uint32_t h = 0; h <= 0xFFFF; h++) {
+    if ((h & 0x7C00) == 0x7C00 && (h & 0x3FF) != 0) {
+      continue;
+    }
+
+    INFO("half: " << h);
+    REQUIRE(float_to_half(half_to_float(static_cast<uint16_t>(h))) == h);
+  }
+
+  REQUIRE(half_to_float(0x3555) == Catch::Approx(1.0f / 3).epsilon(0.001));
+  REQUIRE(half_to_float(0x0001) == std::ldexp(1.0f, -24));
+}
+
+
+static void check_float_row_kernels(const Float_row_kernels& kernels)
+{
+  const uint32_t width = 101;
+
+  std::vector<float> in_float(width);
+  for (uint32_t x = 0; x < width; x++) {
+    in_float[x] = static_cast<float>(x) / 90.0f - 0.05f;
+  }
+  in_float[3] = std::nanf("");
+  in_float[4] = -std::numeric_limits<float>::infinity();
+  in_float[5] = std::numeric_limits<float>::infinity();
+  in_float[6] = 0.5f / 255; // rounding tie for 8 bit
+  in_float[7] = 1.5f / 255;
+
+  if (kernels.float_to_uint8) {
+    std::vector<uint8_t> out(width);
+    uint32_t n = kernels.float_to_uint8(in_float.data(), out.data(), width, 255.0f, 255.0f);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t x = 0; x < n; x++) {
+      INFO("x: " << x);
+      REQUIRE(out[x] == float_to_uint_sample(in_float[x], 255.0f, 255.0f));
+    }
+  }
+
+  if (kernels.float_to_uint16) {
+    for (int bits : {10, 16}) {
+      float max_value = static_cast<float>((1 << bits) - 1);
+      std::vector<uint16_t> out(width);
+      uint32_t n = kernels.float_to_uint16(in_float.data(), out.data(), width, max_value, max_value);
+      REQUIRE(n > 0);
+      REQUIRE(n <= width);
+      for (uint32_t x = 0; x < n; x++) {
+        INFO("bits: " << bits << " x: " << x);
+        REQUIRE(out[x] == float_to_uint_sample(in_float[x], max_value, max_value));
+      }
+    }
+  }
+
+  if (kernels.uint8_to_float) {
+    std::vector<uint8_t> in(width);
+    std::vector<float> out(width);
+    for (uint32_t x = 0; x < width; x++) {
+      in[x] = static_cast<uint8_t>(x * 37);
+    }
+
+    uint32_t n = kernels.uint8_to_float(in.data(), out.data(), width, 1.0f / 255);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t x = 0; x < n; x++) {
+      REQUIRE(out[x] == static_cast<float>(in[x]) * (1.0f / 255));
+    }
+  }
+
+  if (kernels.uint16_to_float) {
+    std::vector<uint16_t> in(width);
+    std::vector<float> out(width);
+    for (uint32_t x = 0; x < width; x++) {
+      in[x] = static_cast<uint16_t>(x * 40503U);
+    }
+
+    uint32_t n = kernels.uint16_to_float(in.data(), out.data(), width, 1.0f / 65535);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t x = 0; x < n; x++) {
+      REQUIRE(out[x] == static_cast<float>(in[x]) * (1.0f / 65535));
+    }
+  }
+
+  if (kernels.half_to_float) {
+    std::vector<uint16_t> in(width);
+    std::vector<float> out(width);
+    for (uint32_t x = 0; x < width; x++) {
+      in[x] = static_cast<uint16_t>(x * 643U); // includes subnormals and infinity (0x7C00 = 31 * 1024)
+    }
+    in[50] = 0x7C00;
+
+    uint32_t n = kernels.half_to_float(in.data(), out.data(), width);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t x = 0; x < n; x++) {
+      INFO("half: " << in[x]);
+      if ((in[x] & 0x7C00) == 0x7C00 && (in[x] & 0x3FF) != 0) {
+        REQUIRE(std::isnan(out[x]));
+      }
+      else {
+        REQUIRE(out[x] == half_to_float(in[x]));
+      }
+    }
+  }
+
+  if (kernels.float_to_half) {
+    std::vector<float> in(width);
+    std::vector<uint16_t> out(width);
+    for (uint32_t x = 0; x < width; x++) {
+      in[x] = std::ldexp(1.0f + static_cast<float>(x) / 64, static_cast<int>(x % 40) - 26) * ((x & 1) ? -1.0f : 1.0f);
+    }
+
+    uint32_t n = kernels.float_to_half(in.data(), out.data(), width);
+    REQUIRE(n > 0);
+    REQUIRE(n <= width);
+    for (uint32_t x = 0; x < n; x++) {
+      INFO("float: " << in[x]);
+      REQUIRE(out[x] == float_to_half(in[x]));
+    }
+  }
+}
+
+
+TEST_CASE("Float conversion SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    Float_row_kernels kernels;
+    kernels.float_to_uint8 = float_to_uint8_row_sse41;
+    kernels.float_to_uint16 = float_to_uint16_row_sse41;
+    kernels.uint8_to_float = uint8_to_float_row_sse41;
+    kernels.uint16_to_float = uint16_to_float_row_sse41;
+    check_float_row_kernels(kernels);
+  }
+
+  if (cpu_supports_avx2()) {
+    Float_row_kernels kernels;
+    kernels.float_to_uint8 = float_to_uint8_row_avx2;
+    kernels.float_to_uint16 = float_to_uint16_row_avx2;
+    kernels.uint8_to_float = uint8_to_float_row_avx2;
+    kernels.uint16_to_float = uint16_to_float_row_avx2;
+    kernels.half_to_float = half_to_float_row_f16c;
+    kernels.float_to_half = float_to_half_row_f16c;
+    check_float_row_kernels(kernels);
+  }
+#endif
+
+#if HEIF_HAVE_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+  check_float_row_kernels(get_float_row_kernels());
+#endif
+}
+
+
+static void check_tensor_row_kernels(const Tensor_row_kernels& kernels)
+{
+  const uint32_t width = 37;
+
+  std::vector<float> in[3];
+  for (int c = 0; c < 3; c++) {
+    for (uint32_t x = 0; x < width; x++) {
+      in[c].push_back(static_cast<float>((x * 37 + c * 101) % 256));
+    }
+  }
+
+  // --- lerp
+
+  std::vector<float> out(width, -1.0f);
+  uint32_t n = kernels.lerp(in[0].data(), in[1].data(), out.data(), width, 0.375f);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+
+  for (uint32_t x = 0; x < width; x++) {
+    if (x < n) {
+      REQUIRE(out[x] == in[0][x] + 0.375f * (in[1][x] - in[0][x]));
+    }
+    else {
+      REQUIRE(out[x] == -1.0f);
+    }
+  }
+
+  // --- matrix (BT.601 limited range with ImageNet normalization)
+
+  TensorMatrix matrix;
+  const float m[3][3] = {{1.1689f / 255, 0, 1.402f * 1.1429f / 255},
+                         {1.1689f / 255, -0.344f * 1.1429f / 255, -0.714f * 1.1429f / 255},
+                         {1.1689f / 255, 1.772f * 1.1429f / 255, 0}};
+  for (int c = 0; c < 3; c++) {
+    for (int k = 0; k < 3; k++) {
+      matrix.m[c][k] = m[c][k];
+    }
+    matrix.offset[c] = -0.1f * static_cast<float>(c) - 0.07f;
+    matrix.scale[c] = 1 / 0.225f;
+    matrix.bias[c] = -0.45f / 0.225f;
+  }
+
+  std::vector<float> rgb[3];
+  for (auto& row : rgb) {
+    row.resize(width, -100.0f);
+  }
+
+  n = kernels.matrix(in[0].data(), in[1].data(), in[2].data(), rgb[0].data(), rgb[1].data(), rgb[2].data(), width, matrix);
+  REQUIRE(n > 0);
+  REQUIRE(n <= width);
+
+  for (int c = 0; c < 3; c++) {
+    for (uint32_t x = 0; x < width; x++) {
+      if (x < n) {
+        REQUIRE(std::abs(rgb[c][x] - tensor_matrix_sample(matrix, c, in[0][x], in[1][x], in[2][x])) < 1e-5f);
+      }
+      else {
+        REQUIRE(rgb[c][x] == -100.0f);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Tensor SIMD kernels")
+{
+#if HEIF_HAVE_X86_SIMD
+  if (cpu_supports_sse41()) {
+    Tensor_row_kernels kernels;
+    kernels.lerp = tensor_lerp_row_sse41;
+    kernels.matrix = tensor_matrix_row_sse41;
+    check_tensor_row_kernels(kernels);
+  }
+
+  if (cpu_supports_avx2()) {
+    Tensor_row_kernels kernels;
+    kernels.lerp = tensor_lerp_row_avx2;
+    kernels.matrix = tensor_matrix_row_avx2;
+    check_tensor_row_kernels(kernels);
+  }
+#endif
+
+#if HEIF_HAVE_NEON
+  check_tensor_row_kernels(get_tensor_row_kernels());
+#endif
+}
+
+
+TEST_CASE("Tensor of a floating point image")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+  options_ext.max_threads = 1;
+
+  const uint32_t width = 37, height = 11;
+
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    REQUIRE(!img->add_channel(channel, width, height, heif_channel_datatype_floating_point, 32, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(channel, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        ((float*) (p + y * stride))[x] = static_cast<float>(x + y * width + channel) / (width * height);
+      }
+    }
+  }
+
+  heif_tensor_options tensor_options{};
+  tensor_options.layout = heif_tensor_layout_interleaved;
+  tensor_options.datatype = heif_tensor_datatype_float32;
+  for (int c = 0; c < 3; c++) {
+    tensor_options.std[c] = 1.0f;
+  }
+
+  // The image is converted to 16 bit integer samples first, values above 1 are clamped.
+  std::vector<float> tensor(3 * width * height);
+  Error err = convert_to_tensor(img, tensor_options, tensor.data(), tensor.size() * sizeof(float),
+                                options, options_ext, nullptr);
+  REQUIRE(!err);
+
+  const heif_channel channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        float expected = std::min(static_cast<float>(x + y * width + channels[c]) / (width * height), 1.0f);
+        REQUIRE(std::abs(tensor[(y * width + x) * 3 + c] - expected) < 1e-4f);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Floating point image conversion")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+  options_ext.max_threads = 1;
+
+  const uint32_t width = 37, height = 11;
+
+  for (int float_bits : {16, 32}) {
+    INFO("float bits: " << float_bits);
+
+    auto img = std::make_shared<HeifPixelImage>();
+    img->create(width, height, heif_colorspace_RGB, heif_chroma_444);
+
+    for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+      REQUIRE(!img->add_channel(channel, width, height, heif_channel_datatype_floating_point, float_bits, nullptr));
+
+      size_t stride;
+      uint8_t* p = img->get_plane(channel, &stride);
+      for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+          // includes values outside of [0,1]
+          float v = static_cast<float>(x + y * width + channel) / (width * height) * 1.2f - 0.1f;
+          if (float_bits == 16) {
+            ((uint16_t*) (p + y * stride))[x] = float_to_half(v);
+          }
+          else {
+            ((float*) (p + y * stride))[x] = v;
+          }
+        }
+      }
+    }
+
+    auto sample = [&](heif_channel channel, uint32_t x, uint32_t y) {
+      size_t stride;
+      const uint8_t* p = img->get_plane(channel, &stride);
+      return float_bits == 16 ? half_to_float(((const uint16_t*) (p + y * stride))[x]) : ((const float*) (p + y * stride))[x];
+    };
+
+    // --- to interleaved 8 bit RGB
+
+    auto result = convert_colorspace(img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr, 8, options, &options_ext, nullptr);
+    REQUIRE(result);
+
+    size_t stride;
+    const uint8_t* rgb = (*result)->get_plane(heif_channel_interleaved, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        REQUIRE(rgb[y * stride + 3 * x + 0] == float_to_uint_sample(sample(heif_channel_R, x, y), 255.0f, 255.0f));
+        REQUIRE(rgb[y * stride + 3 * x + 2] == float_to_uint_sample(sample(heif_channel_B, x, y), 255.0f, 255.0f));
+      }
+    }
+
+    // --- to planar 12 bit
+
+    result = convert_colorspace(img, heif_colorspace_RGB, heif_chroma_444, nullptr, 12, options, &options_ext, nullptr);
+    REQUIRE(result);
+    REQUIRE((*result)->get_datatype(heif_channel_G) == heif_channel_datatype_unsigned_integer);
+    REQUIRE((*result)->get_bits_per_pixel(heif_channel_G) == 12);
+
+    const uint8_t* g = (*result)->get_plane(heif_channel_G, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        REQUIRE(((const uint16_t*) (g + y * stride))[x] == float_to_uint_sample(sample(heif_channel_G, x, y), 4095.0f, 4095.0f));
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Integer to floating point conversion")
+{
+  heif_color_conversion_options options{};
+  heif_color_conversion_options_set_defaults(&options);
+
+  heif_color_conversion_options_ext options_ext{};
+  options_ext.alpha_composition_mode = heif_alpha_composition_mode_none;
+
+  ColorState input_state(heif_colorspace_monochrome, heif_chroma_monochrome, false, 10);
+
+  ColorState float_state = input_state;
+  float_state.datatype = heif_channel_datatype_floating_point;
+  float_state.bits_per_pixel = 32;
+
+  ColorState half_state = float_state;
+  half_state.bits_per_pixel = 16;
+
+  // large enough to be converted in several row bands
+  auto in_image = create_random_image(input_state, 1024, 1025);
+
+  for (int max_threads : {1, 4}) {
+    INFO("threads: " << max_threads);
+    options_ext.max_threads = max_threads;
+
+    ColorConversionPipeline to_float;
+    REQUIRE(to_float.construct_pipeline(input_state, float_state, options, options_ext));
+    auto float_image = to_float.convert_image(in_image, nullptr);
+    REQUIRE(float_image);
+    REQUIRE((*float_image)->get_datatype(heif_channel_Y) == heif_channel_datatype_floating_point);
+
+    ColorConversionPipeline to_half;
+    REQUIRE(to_half.construct_pipeline(float_state, half_state, options, options_ext));
+    auto half_image = to_half.convert_image(*float_image, nullptr);
+    REQUIRE(half_image);
+    REQUIRE((*half_image)->get_bits_per_pixel(heif_channel_Y) == 16);
+
+    // float32 reproduces the 10 bit integers exactly
+    ColorConversionPipeline back;
+    REQUIRE(back.construct_pipeline(float_state, input_state, options, options_ext));
+    auto back_image = back.convert_image(*float_image, nullptr);
+    REQUIRE(back_image);
+
+    size_t in_stride, float_stride, half_stride, back_stride;
+    const uint8_t* in_p = in_image->get_plane(heif_channel_Y, &in_stride);
+    const uint8_t* float_p = (*float_image)->get_plane(heif_channel_Y, &float_stride);
+    const uint8_t* half_p = (*half_image)->get_plane(heif_channel_Y, &half_stride);
+    const uint8_t* back_p = (*back_image)->get_plane(heif_channel_Y, &back_stride);
+
+    for (uint32_t y = 0; y < in_image->get_height(); y++) {
+      for (uint32_t x = 0; x < in_image->get_width(); x++) {
+        uint16_t in = ((const uint16_t*) (in_p + y * in_stride))[x];
+        float f = ((const float*) (float_p + y * float_stride))[x];
+
+        REQUIRE(f == static_cast<float>(in) * (1.0f / 1023));
+        REQUIRE(((const uint16_t*) (half_p + y * half_stride))[x] == float_to_half(f));
+        REQUIRE(((const uint16_t*) (back_p + y * back_stride))[x] == in);
+      }
+    }
+  }
+}
@@ -0,0 +1,248 @@
+/*
+  libheif unit tests for the C++ wrapper and asynchronous decoding
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_cxx.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "test_utils.h"
+
+
+template <typename T>
+static bool same_pixels(const heif::PlaneView<T>& view, const heif::PlaneView<const uint8_t>& full,
+                        int x0, int y0, int bytes_per_pixel)
+{
+  for (int y = 0; y < view.height; y++) {
+    if (memcmp(view.row(y), full.row(y0 + y) + x0 * bytes_per_pixel, view.width * bytes_per_pixel) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+TEST_CASE("Decode tiles, regions and asynchronously with the C++ wrapper")
+{
+  heif_image* tiles[6];
+  for (heif_image*& tile : tiles) {
+    tile = createImage_RGB_planar();
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif::Context ctx;
+  ctx.read_from_memory_without_copy(file_data.data(), file_data.size());
+  const heif::ImageHandle handle = ctx.get_primary_image_handle();
+
+  heif::Image full = const_cast<heif::ImageHandle&>(handle).decode_image(heif_colorspace_RGB, heif_chroma_interleaved_RGB);
+  const heif::Image& const_full = full;
+  heif::PlaneView<const uint8_t> full_view = const_full.get_plane_view(heif_channel_interleaved);
+  REQUIRE(!full_view.empty());
+  REQUIRE(full_view.width == handle.get_width());
+  REQUIRE(full_view.height == handle.get_height());
+  REQUIRE(full_view.bits_per_pixel == 24);
+  REQUIRE(full.get_plane_view(heif_channel_Alpha).empty());
+
+  heif_image_tiling tiling = handle.get_image_tiling();
+  REQUIRE(tiling.num_columns == 3);
+  REQUIRE(tiling.num_rows == 2);
+
+  heif::Image tile = handle.decode_image_tile(1, 1, heif_colorspace_RGB, heif_chroma_interleaved_RGB);
+  heif::PlaneView<uint8_t> tile_view = tile.get_plane_view(heif_channel_interleaved);
+  REQUIRE(tile_view.width == (int) tiling.tile_width);
+  REQUIRE(same_pixels(tile_view, full_view, tiling.tile_width, tiling.tile_height, 3));
+
+  REQUIRE_THROWS_AS(handle.decode_image_region(handle.get_width(), 0, 10, 10, heif_colorspace_RGB, heif_chroma_interleaved_RGB),
+                    heif::Error);
+
+  // a region across the tile borders, into a move-only image
+  heif::UniqueImage region = heif::decode_image_region(handle.get_raw_image_handle(),
+                                                       tiling.tile_width - 10, tiling.tile_height - 20, 50, 40,
+                                                       heif_colorspace_RGB, heif_chroma_interleaved_RGB);
+  heif::PlaneView<uint8_t> region_view = heif::get_plane_view(region.get(), heif_channel_interleaved);
+  REQUIRE(region_view.width == 50);
+  REQUIRE(region_view.height == 40);
+  REQUIRE(same_pixels(region_view, full_view, tiling.tile_width - 10, tiling.tile_height - 20, 3));
+
+  // into a buffer of the caller
+  size_t stride = full_view.width * 3 + 16;
+  std::vector<uint8_t> buffer(stride * full_view.height);
+  uint8_t* const planes[] = {buffer.data()};
+  const size_t strides[] = {stride};
+  handle.decode_image_into(heif_colorspace_RGB, heif_chroma_interleaved_RGB, planes, strides);
+
+  heif::PlaneView<const uint8_t> buffer_view;
+  buffer_view.data = buffer.data();
+  buffer_view.stride = stride;
+  buffer_view.width = full_view.width;
+  buffer_view.height = full_view.height;
+  REQUIRE(same_pixels(buffer_view, full_view, 0, 0, 3));
+
+  // asynchronously
+  std::future<heif::Image> future = handle.decode_image_async(heif_colorspace_RGB, heif_chroma_interleaved_RGB);
+  std::future<heif::UniqueImage> unique_future = heif::decode_image_async(handle.get_raw_image_handle(),
+                                                                          heif_colorspace_RGB,
+                                                                          heif_chroma_interleaved_RGB);
+
+  heif::Image async_image = future.get();
+  REQUIRE(same_pixels(async_image.get_plane_view(heif_channel_interleaved), full_view, 0, 0, 3));
+
+  heif::UniqueImage async_unique_image = unique_future.get();
+  REQUIRE(same_pixels(heif::get_plane_view(async_unique_image.get(), heif_channel_interleaved), full_view, 0, 0, 3));
+
+  // decoding errors are thrown by the future
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  options->cancel_decoding = [](void*) { return 1; };
+  std::future<heif::Image> canceled = handle.decode_image_async(heif_colorspace_RGB, heif_chroma_interleaved_RGB, options);
+  REQUIRE_THROWS_AS(canceled.get(), heif::Error);
+  heif_decoding_options_free(options);
+
+  REQUIRE(!ctx.has_sequence());
+  REQUIRE(ctx.get_track_ids().empty());
+}
+
+
+TEST_CASE("Decode image asynchronously")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  struct AsyncResult
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool completed = false;
+    heif_image* image = nullptr;
+    heif_error_code error = heif_error_Ok;
+  };
+
+  auto on_completion = [](heif_image* image, heif_error error, void* userdata) {
+    auto* result = static_cast<AsyncResult*>(userdata);
+    std::lock_guard<std::mutex> lock(result->mutex);
+    result->image = image;
+    result->error = error.code;
+    result->completed = true;
+    result->cv.notify_all();
+  };
+
+  auto decode_async = [&](heif_context* ctx) {
+    heif_image_handle* handle;
+    heif_error err = heif_context_get_primary_image_handle(ctx, &handle);
+    REQUIRE(err.code == heif_error_Ok);
+
+    AsyncResult result;
+    err = heif_decode_image_async(handle, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr, on_completion, &result);
+    REQUIRE(err.code == heif_error_Ok);
+
+    // the handle does not have to be kept
+    heif_image_handle_release(handle);
+
+    std::unique_lock<std::mutex> lock(result.mutex);
+    result.cv.wait(lock, [&result]() { return result.completed; });
+
+    REQUIRE(result.error == heif_error_Ok);
+    REQUIRE(result.image != nullptr);
+    std::vector<uint8_t> pixels = get_interleaved_pixels(result.image, 0, 0, 480, 240);
+    heif_image_release(result.image);
+    return pixels;
+  };
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  std::vector<uint8_t> expected = get_interleaved_pixels(img, 0, 0, 480, 240);
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+
+  REQUIRE(decode_async(ctx) == expected);
+  heif_context_free(ctx);
+
+  // with a reader that completes the range requests from another thread
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+  reader.reader_api_version = 3;
+  reader.request_range_async = [](uint64_t start_pos, uint64_t end_pos,
+                                  void (*on_completion)(heif_reader_range_request_result, void*),
+                                  void* completion_userdata, void* userdata) {
+    auto* r = static_cast<RecordingReader*>(userdata);
+    r->async_requests.emplace_back(start_pos, end_pos);
+
+    heif_reader_range_request_result result{};
+    result.status = heif_reader_grow_status_size_reached;
+    result.range_end = end_pos;
+
+    r->completion_threads.emplace_back([=]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      on_completion(result, completion_userdata);
+    });
+  };
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  recorder.async_requests.clear();
+  REQUIRE(decode_async(ctx) == expected);
+
+  // the grid tiles are stored in one block
+  REQUIRE(recorder.async_requests.size() == 1);
+
+  heif_context_free(ctx);
+
+  for (auto& thread : recorder.completion_threads) {
+    thread.join();
+  }
+}
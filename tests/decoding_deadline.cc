@@ -0,0 +1,169 @@
+/*
+  libheif unit tests for decoding with a deadline
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <cstdint>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Decode a partial grid image when the deadline has passed")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_decoding_threads(ctx, 0);
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* full;
+  err = heif_decode_image(handle, &full, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_decoding_fallback(full) == heif_decoding_fallback_none);
+
+  // The first tile is decoded, the others are skipped.
+
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  options->deadline_us = 1;
+
+  heif_image* partial;
+  err = heif_decode_image(handle, &partial, heif_colorspace_RGB, heif_chroma_444, options);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_decoding_fallback(partial) == heif_decoding_fallback_partial_image);
+  REQUIRE(heif_image_get_primary_width(partial) == 480);
+  REQUIRE(heif_image_get_primary_height(partial) == 240);
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    size_t full_stride, partial_stride;
+    const uint8_t* full_data = heif_image_get_plane_readonly2(full, channel, &full_stride);
+    const uint8_t* partial_data = heif_image_get_plane_readonly2(partial, channel, &partial_stride);
+
+    for (uint32_t y = 0; y < 240; y++) {
+      for (uint32_t x = 0; x < 480; x++) {
+        uint8_t expected = (x < 160 && y < 120) ? full_data[y * full_stride + x] : 0;
+        REQUIRE(partial_data[y * partial_stride + x] == expected);
+      }
+    }
+  }
+
+  heif_image_release(partial);
+  heif_decoding_options_free(options);
+  heif_image_release(full);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Decode the thumbnail when the image cannot be decoded until the deadline")
+{
+  heif_image* image = create_gradient_image(400, 200, 0);
+
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, image, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* thumbnail_handle;
+  err = heif_context_encode_thumbnail(ctx, image, handle, encoder, nullptr, 100, &thumbnail_handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_handle_release(thumbnail_handle);
+  heif_image_handle_release(handle);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+  heif_image_release(image);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  options->deadline_us = heif_get_monotonic_time_us();
+
+  // Without a previous decoding time, the full image is decoded.
+
+  heif_image* decoded;
+  err = heif_decode_image(handle, &decoded, heif_colorspace_RGB, heif_chroma_444, options);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_primary_width(decoded) == 400);
+  REQUIRE(heif_image_get_decoding_fallback(decoded) == heif_decoding_fallback_none);
+  heif_image_release(decoded);
+
+  // Now, the decoding time is known and exceeds the deadline.
+
+  options->deadline_us = heif_get_monotonic_time_us();
+
+  err = heif_decode_image(handle, &decoded, heif_colorspace_RGB, heif_chroma_444, options);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_primary_width(decoded) == 100);
+  REQUIRE(heif_image_get_decoding_fallback(decoded) == heif_decoding_fallback_thumbnail);
+  heif_image_release(decoded);
+
+  // enough time
+
+  options->deadline_us = heif_get_monotonic_time_us() + 60 * 1000000;
+
+  err = heif_decode_image(handle, &decoded, heif_colorspace_RGB, heif_chroma_444, options);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_primary_width(decoded) == 400);
+  REQUIRE(heif_image_get_decoding_fallback(decoded) == heif_decoding_fallback_none);
+  heif_image_release(decoded);
+
+  heif_decoding_options_free(options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
@@ -0,0 +1,337 @@
+/*
+  libheif unit tests
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "pixelimage.h"
+#include "libheif/heif.h"
+#include "color-conversion/demosaic.h"
+#include "color-conversion/demosaic_simd.h"
+#include <functional>
+#include <random>
+#include <vector>
+
+
+static FilterArrayPattern make_pattern(uint16_t width, uint16_t height, const char* colors)
+{
+  FilterArrayPattern pattern;
+  pattern.width = width;
+  pattern.height = height;
+
+  for (const char* c = colors; *c; c++) {
+    switch (*c) {
+      case 'R':
+        pattern.channels.push_back(heif_channel_R);
+        break;
+      case 'G':
+        pattern.channels.push_back(heif_channel_G);
+        break;
+      case 'B':
+        pattern.channels.push_back(heif_channel_B);
+        break;
+      default:
+        pattern.channels.push_back(heif_channel_Y);
+        break;
+    }
+  }
+
+  return pattern;
+}
+
+
+static int channel_index(heif_channel c)
+{
+  return c == heif_channel_R ? 0 : (c == heif_channel_G ? 1 : 2);
+}
+
+
+// Raw image that samples value(color, x, y) through the filter array.
+static std::shared_ptr<HeifPixelImage> create_raw_image(uint32_t width, uint32_t height, int bpp,
+                                                        const FilterArrayPattern& pattern,
+                                                        const std::function<uint16_t(int, uint32_t, uint32_t)>& value)
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, heif_colorspace_monochrome, heif_chroma_monochrome);
+  REQUIRE(!img->add_plane(heif_channel_Y, width, height, bpp, nullptr));
+
+  size_t stride;
+  uint8_t* p = img->get_plane(heif_channel_Y, &stride);
+
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint16_t v = value(channel_index(pattern.at(x, y)), x, y);
+      if (bpp > 8) {
+        reinterpret_cast<uint16_t*>(p + y * stride)[x] = v;
+      }
+      else {
+        p[y * stride + x] = static_cast<uint8_t>(v);
+      }
+    }
+  }
+
+  return img;
+}
+
+
+static uint16_t get_sample(const std::shared_ptr<const HeifPixelImage>& img, heif_channel channel, uint32_t x, uint32_t y)
+{
+  size_t stride;
+  const uint8_t* p = img->get_plane(channel, &stride);
+
+  if (img->get_bits_per_pixel(channel) > 8) {
+    return reinterpret_cast<const uint16_t*>(p + y * stride)[x];
+  }
+  else {
+    return p[y * stride + x];
+  }
+}
+
+
+static std::shared_ptr<HeifPixelImage> demosaic(const std::shared_ptr<const HeifPixelImage>& raw,
+                                                const FilterArrayPattern& pattern,
+                                                heif_demosaic_method method, int max_threads = 1)
+{
+  auto result = demosaic_filter_array(raw, pattern, method, max_threads, heif_get_global_security_limits());
+  REQUIRE(!result.error);
+
+  auto rgb = *result;
+  REQUIRE(rgb->get_colorspace() == heif_colorspace_RGB);
+  REQUIRE(rgb->get_chroma_format() == heif_chroma_444);
+  REQUIRE(rgb->get_bits_per_pixel(heif_channel_R) == raw->get_bits_per_pixel(heif_channel_Y));
+
+  return rgb;
+}
+
+
+static const heif_channel rgb_channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+
+static const char* bayer_patterns[4] = {"RGGB", "GRBG", "BGGR", "GBRG"};
+
+
+TEST_CASE("Demosaic linear gradients")
+{
+  const uint32_t width = 70;
+  const uint32_t height = 20;
+
+  for (int bpp : {8, 12, 16}) {
+    uint16_t scale = bpp == 8 ? 1 : (bpp == 12 ? 20 : 150);
+
+    for (const char* colors : bayer_patterns) {
+      FilterArrayPattern pattern = make_pattern(2, 2, colors);
+
+      SECTION(std::string("bilinear ") + colors + " " + std::to_string(bpp) + " bit") {
+        // Each color has its own gradient. Bilinear interpolation reproduces them exactly.
+        auto value = [scale](int c, uint32_t x, uint32_t y) {
+          const uint32_t offset[3] = {10, 40, 5};
+          const uint32_t dx[3] = {1, 2, 1};
+          const uint32_t dy[3] = {2, 1, 1};
+          return static_cast<uint16_t>(scale * (offset[c] + dx[c] * x + dy[c] * y));
+        };
+
+        auto raw = create_raw_image(width, height, bpp, pattern, value);
+        auto rgb = demosaic(raw, pattern, heif_demosaic_method_bilinear);
+
+        for (uint32_t y = 1; y < height - 1; y++) {
+          for (uint32_t x = 1; x < width - 1; x++) {
+            for (int c = 0; c < 3; c++) {
+              REQUIRE(get_sample(rgb, rgb_channels[c], x, y) == value(c, x, y));
+            }
+          }
+        }
+      }
+
+      SECTION(std::string("gradient corrected ") + colors + " " + std::to_string(bpp) + " bit") {
+        // The gradient correction assumes that all colors change alike.
+        auto value = [scale](int, uint32_t x, uint32_t y) {
+          return static_cast<uint16_t>(scale * (20 + x + 2 * y));
+        };
+
+        auto raw = create_raw_image(width, height, bpp, pattern, value);
+        auto rgb = demosaic(raw, pattern, heif_demosaic_method_gradient_corrected);
+
+        for (uint32_t y = 2; y < height - 2; y++) {
+          for (uint32_t x = 2; x < width - 2; x++) {
+            for (int c = 0; c < 3; c++) {
+              REQUIRE(get_sample(rgb, rgb_channels[c], x, y) == value(c, x, y));
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Demosaic constant colors")
+{
+  const uint16_t colors[3] = {100, 150, 200};
+  auto value = [&colors](int c, uint32_t, uint32_t) { return colors[c]; };
+
+  std::vector<FilterArrayPattern> patterns{
+      make_pattern(2, 2, "RGGB"),
+      make_pattern(2, 2, "GBRG"),
+      make_pattern(4, 4, "RRGGRRGGGGBBGGBB"), // quad Bayer
+      make_pattern(3, 1, "RGB")
+  };
+
+  for (const auto& pattern : patterns) {
+    for (heif_demosaic_method method : {heif_demosaic_method_bilinear, heif_demosaic_method_gradient_corrected}) {
+      for (uint32_t size : {1, 3, 5, 37}) {
+        auto raw = create_raw_image(size, size + 2, 8, pattern, value);
+        auto rgb = demosaic(raw, pattern, method);
+
+        for (uint32_t y = 0; y < size + 2; y++) {
+          for (uint32_t x = 0; x < size; x++) {
+            for (int c = 0; c < 3; c++) {
+              if (size == 1 && pattern.width > 1) {
+                // colors that are not in the first column are not available
+                continue;
+              }
+              REQUIRE(get_sample(rgb, rgb_channels[c], x, y) == colors[c]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Demosaic color missing in pattern")
+{
+  FilterArrayPattern pattern = make_pattern(2, 2, "RGGW");
+  auto raw = create_raw_image(40, 10, 8, pattern, [](int, uint32_t, uint32_t) { return uint16_t{80}; });
+  auto rgb = demosaic(raw, pattern, heif_demosaic_method_bilinear);
+
+  for (uint32_t y = 0; y < 10; y++) {
+    for (uint32_t x = 0; x < 40; x++) {
+      REQUIRE(get_sample(rgb, heif_channel_R, x, y) == 80);
+      REQUIRE(get_sample(rgb, heif_channel_G, x, y) == 80);
+      REQUIRE(get_sample(rgb, heif_channel_B, x, y) == 0);
+    }
+  }
+}
+
+
+TEST_CASE("Demosaic bilinear rounding")
+{
+  // The SIMD kernels have to compute the same rounded averages as the scalar code.
+  FilterArrayPattern pattern = make_pattern(2, 2, "GRBG");
+
+  for (int bpp : {8, 16}) {
+    std::mt19937 rng(bpp);
+    std::uniform_int_distribution<uint32_t> dist(0, (1u << bpp) - 1);
+
+    const uint32_t width = 101, height = 7;
+    std::vector<uint16_t> samples(width * height);
+    for (auto& s : samples) {
+      s = static_cast<uint16_t>(dist(rng));
+    }
+
+    auto raw = create_raw_image(width, height, bpp, pattern,
+                                [&](int, uint32_t x, uint32_t y) { return samples[y * width + x]; });
+    auto rgb = demosaic(raw, pattern, heif_demosaic_method_bilinear);
+
+    auto s = [&](uint32_t x, uint32_t y) { return uint32_t{samples[y * width + x]}; };
+
+    for (uint32_t y = 1; y < height - 1; y++) {
+      for (uint32_t x = 1; x < width - 1; x++) {
+        uint32_t h = demosaic_avg(s(x - 1, y), s(x + 1, y));
+        uint32_t v = demosaic_avg(s(x, y - 1), s(x, y + 1));
+        uint32_t d = demosaic_avg(demosaic_avg(s(x - 1, y - 1), s(x + 1, y - 1)),
+                                  demosaic_avg(s(x - 1, y + 1), s(x + 1, y + 1)));
+        uint32_t cross = demosaic_avg(h, v);
+
+        uint32_t expected[3];
+        heif_channel self = pattern.at(x, y);
+        if (self == heif_channel_G) {
+          bool r_horizontal = pattern.at(x + 1, y) == heif_channel_R;
+          expected[0] = r_horizontal ? h : v;
+          expected[1] = s(x, y);
+          expected[2] = r_horizontal ? v : h;
+        }
+        else if (self == heif_channel_R) {
+          expected[0] = s(x, y);
+          expected[1] = cross;
+          expected[2] = d;
+        }
+        else {
+          expected[0] = d;
+          expected[1] = cross;
+          expected[2] = s(x, y);
+        }
+
+        for (int c = 0; c < 3; c++) {
+          REQUIRE(get_sample(rgb, rgb_channels[c], x, y) == expected[c]);
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Demosaic in parallel row bands")
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint32_t> dist(0, 1023);
+
+  FilterArrayPattern pattern = make_pattern(2, 2, "RGGB");
+
+  const uint32_t width = 1024, height = 600;
+  std::vector<uint16_t> samples(width * height);
+  for (auto& s : samples) {
+    s = static_cast<uint16_t>(dist(rng));
+  }
+
+  auto raw = create_raw_image(width, height, 10, pattern,
+                              [&](int, uint32_t x, uint32_t y) { return samples[y * width + x]; });
+
+  for (heif_demosaic_method method : {heif_demosaic_method_bilinear, heif_demosaic_method_gradient_corrected}) {
+    auto single = demosaic(raw, pattern, method, 1);
+    auto threaded = demosaic(raw, pattern, method, 4);
+
+    for (heif_channel channel : rgb_channels) {
+      for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+          REQUIRE(get_sample(single, channel, x, y) == get_sample(threaded, channel, x, y));
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Demosaic unsupported input")
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(8, 8, heif_colorspace_RGB, heif_chroma_444);
+  for (heif_channel channel : rgb_channels) {
+    REQUIRE(!img->add_plane(channel, 8, 8, 8, nullptr));
+  }
+
+  auto result = demosaic_filter_array(img, make_pattern(2, 2, "RGGB"), heif_demosaic_method_bilinear, 1,
+                                      heif_get_global_security_limits());
+  REQUIRE(result.error.error_code == heif_error_Unsupported_feature);
+}
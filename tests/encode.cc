@@ -156,3 +156,297 @@ TEST_CASE( "ispe odd size", "[heif_context]" ) {
   test_ispe_size(heif_compression_AV1, heif_orientation_rotate_90_cw, 121,99, 121,99);
   test_ispe_size(heif_compression_AV1, heif_orientation_rotate_90_cw, 120,100, 120,100);
 }
+
+
+TEST_CASE( "Plane alignment and buffer pool", "[heif_image]" )
+{
+  REQUIRE(heif_set_image_plane_alignment(48).code == heif_error_Usage_error);
+  REQUIRE(heif_set_image_plane_alignment(8).code == heif_error_Usage_error);
+  REQUIRE(heif_set_image_plane_alignment(64).code == heif_error_Ok);
+
+  heif_set_image_buffer_pool_size(16 * 1024 * 1024);
+
+  const uint8_t* first_plane;
+
+  {
+    heif_image* image;
+    heif_error error = heif_image_create(100, 50, heif_colorspace_monochrome, heif_chroma_monochrome, &image);
+    REQUIRE(!error.code);
+    REQUIRE(!heif_image_add_plane(image, heif_channel_Y, 100, 50, 8).code);
+
+    int stride;
+    first_plane = heif_image_get_plane_readonly(image, heif_channel_Y, &stride);
+    REQUIRE(reinterpret_cast<uintptr_t>(first_plane) % 64 == 0);
+    REQUIRE(stride % 64 == 0);
+
+    heif_image_release(image);
+  }
+
+  // a new image of the same size gets the buffer of the released one
+
+  {
+    heif_image* image;
+    heif_error error = heif_image_create(100, 50, heif_colorspace_monochrome, heif_chroma_monochrome, &image);
+    REQUIRE(!error.code);
+    REQUIRE(!heif_image_add_plane(image, heif_channel_Y, 100, 50, 8).code);
+
+    int stride;
+    REQUIRE(heif_image_get_plane_readonly(image, heif_channel_Y, &stride) == first_plane);
+
+    heif_image_release(image);
+  }
+
+  heif_set_image_buffer_pool_size(0);
+  REQUIRE(heif_set_image_plane_alignment(16).code == heif_error_Ok);
+}
+
+
+TEST_CASE( "Plane allocation flags", "[heif_image]" )
+{
+  const int w = 2048;
+  const int h = 1100; // larger than a 2 MB huge page
+
+  heif_image* image;
+  heif_error error = heif_image_create(w, h, heif_colorspace_monochrome, heif_chroma_monochrome, &image);
+  REQUIRE(!error.code);
+  REQUIRE(!heif_image_add_plane(image, heif_channel_Y, w, h, 8).code);
+
+  int stride;
+  uint8_t* p = heif_image_get_plane(image, heif_channel_Y, &stride);
+  for (int y = 0; y < h; y++) {
+    memset(p + y * stride, y & 0xFF, w);
+  }
+
+  heif_security_limits limits = *heif_get_global_security_limits();
+  limits.plane_allocation = heif_plane_allocation_huge_pages | heif_plane_allocation_numa_local;
+
+  heif_image* copy;
+  error = heif_image_extract_area(image, 0, 0, w, h, &limits, &copy);
+  REQUIRE(!error.code);
+
+  int copy_stride;
+  const uint8_t* q = heif_image_get_plane_readonly(copy, heif_channel_Y, &copy_stride);
+#if __linux__
+  REQUIRE(reinterpret_cast<uintptr_t>(q) % (2 * 1024 * 1024) == 0);
+#endif
+  for (int y = 0; y < h; y++) {
+    REQUIRE(memcmp(p + y * stride, q + y * copy_stride, w) == 0);
+  }
+
+  heif_image_release(copy);
+  heif_image_release(image);
+}
+
+
+TEST_CASE( "Image memory budget", "[heif_image]" )
+{
+  uint64_t default_budget = heif_get_image_memory_budget();
+  uint64_t used = heif_get_image_memory_in_use();
+
+  // the default memory margin is 100 MB
+
+  heif_set_image_memory_budget(200 * 1024 * 1024);
+
+  heif_image* image;
+  heif_error error = heif_image_create(100, 50, heif_colorspace_monochrome, heif_chroma_monochrome, &image);
+  REQUIRE(!error.code);
+  REQUIRE(!heif_image_add_plane(image, heif_channel_Y, 100, 50, 8).code);
+  REQUIRE(heif_get_image_memory_in_use() >= used + 100 * 50);
+
+  heif_set_image_memory_budget(50 * 1024 * 1024);
+  error = heif_image_add_plane(image, heif_channel_Cb, 100, 50, 8);
+  REQUIRE(error.code == heif_error_Memory_allocation_error);
+  REQUIRE(error.subcode == heif_suberror_Security_limit_exceeded);
+
+  heif_image_release(image);
+  REQUIRE(heif_get_image_memory_in_use() == used);
+
+  heif_set_image_memory_budget(default_budget);
+}
+
+
+TEST_CASE( "Reduced-resolution decoding", "[heif_decoding_options]" )
+{
+  const int width = 100, height = 60;
+
+  heif_image* img;
+  heif_image_create(width, height, heif_colorspace_YCbCr, heif_chroma_420, &img);
+  fill_new_plane(img, heif_channel_Y, width, height);
+  fill_new_plane(img, heif_channel_Cb, (width + 1) / 2, (height + 1) / 2);
+  fill_new_plane(img, heif_channel_Cr, (width + 1) / 2, (height + 1) / 2);
+
+  std::string filename = get_tests_output_file_path("reduced_resolution.heif");
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* enc = get_encoder_or_skip_test(heif_compression_JPEG);
+
+  heif_error err = heif_context_encode_image(ctx, img, enc, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_context_write_to_file(ctx, filename.c_str());
+  REQUIRE(err.code == heif_error_Ok);
+  heif_encoder_release(enc);
+  heif_image_release(img);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_file(ctx, filename.c_str(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle = get_primary_image_handle(ctx);
+
+  if (!heif_have_decoder_for_format(heif_compression_JPEG)) {
+    heif_image_handle_release(handle);
+    heif_context_free(ctx);
+    SKIP("Decoder for JPEG not found, skipping test");
+  }
+
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  REQUIRE(options->target_scale_denominator == 1);
+
+  struct {
+    int denominator;
+    int expected_width, expected_height;
+  } cases[] = {
+      {1, 100, 60},
+      {4, 25, 15},
+      {8, 13, 8},
+      {3, 50, 30}, // rounded down to the next supported denominator
+  };
+
+  for (const auto& c : cases) {
+    options->target_scale_denominator = (uint8_t) c.denominator;
+
+    heif_image* out;
+    err = heif_decode_image(handle, &out, heif_colorspace_YCbCr, heif_chroma_420, options);
+    REQUIRE(err.code == heif_error_Ok);
+
+    REQUIRE(heif_image_get_primary_width(out) == c.expected_width);
+    REQUIRE(heif_image_get_primary_height(out) == c.expected_height);
+    REQUIRE(heif_image_get_decoding_scale_denominator(out) == (c.denominator == 3 ? 2 : c.denominator));
+
+    heif_image_release(out);
+  }
+
+  heif_decoding_options_free(options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE( "Decode grid tiles into the grid image", "[heif_decoding]" )
+{
+  const int tile_width = 64, tile_height = 48;
+
+  heif_image* tiles[4];
+  for (int i = 0; i < 4; i++) {
+    heif_image_create(tile_width, tile_height, heif_colorspace_YCbCr, heif_chroma_420, &tiles[i]);
+    fill_new_plane(tiles[i], heif_channel_Y, tile_width, tile_height);
+    fill_new_plane(tiles[i], heif_channel_Cb, tile_width / 2, tile_height / 2);
+    fill_new_plane(tiles[i], heif_channel_Cr, tile_width / 2, tile_height / 2);
+
+    int stride;
+    uint8_t* p = heif_image_get_plane(tiles[i], heif_channel_Y, &stride);
+    for (int y = 0; y < tile_height; y++) {
+      memset(p + y * stride, 40 * (i + 1), tile_width);
+    }
+  }
+
+  std::string filename = get_tests_output_file_path("grid_decode_into.heif");
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* enc = get_encoder_or_skip_test(heif_compression_JPEG);
+
+  heif_error err = heif_context_encode_grid(ctx, tiles, 2, 2, enc, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_context_write_to_file(ctx, filename.c_str());
+  REQUIRE(err.code == heif_error_Ok);
+  heif_encoder_release(enc);
+  heif_context_free(ctx);
+
+  for (auto* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  if (!heif_have_decoder_for_format(heif_compression_JPEG)) {
+    SKIP("Decoder for JPEG not found, skipping test");
+  }
+
+  for (int threads : {0, 4}) {
+    ctx = heif_context_alloc();
+    heif_context_set_max_decoding_threads(ctx, threads);
+    err = heif_context_read_from_file(ctx, filename.c_str(), nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image_handle* handle = get_primary_image_handle(ctx);
+
+    heif_image* img;
+    err = heif_decode_image(handle, &img, heif_colorspace_YCbCr, heif_chroma_420, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(heif_image_get_primary_width(img) == 2 * tile_width);
+    REQUIRE(heif_image_get_primary_height(img) == 2 * tile_height);
+
+    // every tile has to be at its position in the grid image, identical to the separately decoded tile
+
+    for (uint32_t ty = 0; ty < 2; ty++) {
+      for (uint32_t tx = 0; tx < 2; tx++) {
+        heif_image* tile;
+        err = heif_image_handle_decode_image_tile(handle, &tile, heif_colorspace_YCbCr, heif_chroma_420, nullptr, tx, ty);
+        REQUIRE(err.code == heif_error_Ok);
+
+        for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+          size_t stride, tile_stride;
+          const uint8_t* p = heif_image_get_plane_readonly2(img, channel, &stride);
+          const uint8_t* tp = heif_image_get_plane_readonly2(tile, channel, &tile_stride);
+
+          int w = heif_image_get_width(tile, channel);
+          int h = heif_image_get_height(tile, channel);
+
+          for (int y = 0; y < h; y++) {
+            REQUIRE(memcmp(p + (ty * h + y) * stride + tx * w, tp + y * tile_stride, w) == 0);
+          }
+        }
+
+        size_t tile_stride;
+        const uint8_t* tp = heif_image_get_plane_readonly2(tile, heif_channel_Y, &tile_stride);
+        REQUIRE(std::abs(tp[tile_height / 2 * tile_stride + tile_width / 2] - 40 * (int) (ty * 2 + tx + 1)) <= 2);
+
+        heif_image_release(tile);
+      }
+    }
+
+    heif_image_release(img);
+    heif_image_handle_release(handle);
+    heif_context_free(ctx);
+  }
+}
+
+
+TEST_CASE( "Encode with target size", "[heif_encoder]" )
+{
+  heif_image* img;
+  heif_image_create(256, 256, heif_colorspace_YCbCr, heif_chroma_420, &img);
+  fill_new_plane(img, heif_channel_Y, 256, 256);
+  fill_new_plane(img, heif_channel_Cb, 128, 128);
+  fill_new_plane(img, heif_channel_Cr, 128, 128);
+
+  heif_encoder* enc = get_encoder_or_skip_test(heif_compression_uncompressed);
+
+  // The uncompressed codec ignores the quality, so the image either fits at the highest quality or not at all.
+
+  for (size_t target_size : {size_t{1000000}, size_t{1000}}) {
+    heif_context* ctx = heif_context_alloc();
+
+    int quality = -1;
+    heif_image_handle* handle = nullptr;
+    heif_error err = heif_context_encode_image_with_target_size(ctx, img, enc, nullptr, target_size, &quality, &handle);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(handle != nullptr);
+    REQUIRE(quality == (target_size == 1000000 ? 100 : 0));
+
+    heif_image_handle_release(handle);
+    heif_context_free(ctx);
+  }
+
+  heif_encoder_release(enc);
+  heif_image_release(img);
+}
@@ -47,3 +47,68 @@ TEST_CASE("parse file layout") {
 
   // TODO: read file where 'meta' box is not the first one after 'ftyp'
 }
+
+
+TEST_CASE("parsed boxes are allocated from an arena") {
+  auto istr = std::unique_ptr<std::istream>(new std::ifstream(tests_data_directory + "/uncompressed_comp_ABGR.heif", std::ios::binary));
+  auto reader = std::make_shared<StreamReader_istream>(std::move(istr));
+
+  std::shared_ptr<Box_meta> meta;
+  std::weak_ptr<BoxArena> arena;
+
+  {
+    FileLayout file;
+    Error err = file.read(reader, heif_get_global_security_limits());
+    REQUIRE(err.error_code == heif_error_Ok);
+
+    arena = file.get_box_arena();
+    REQUIRE(file.get_box_arena()->get_allocated_bytes() > 0);
+
+    meta = file.get_meta_box();
+    REQUIRE(meta);
+  }
+
+  // The boxes keep the arena alive after the FileLayout has been destroyed.
+  REQUIRE(!arena.expired());
+  REQUIRE(!meta->get_child_boxes<Box_iinf>().empty());
+
+  Indent indent;
+  REQUIRE(meta->dump(indent).find("ipco") != std::string::npos);
+
+  meta.reset();
+  REQUIRE(arena.expired());
+
+  // Boxes created outside of FileLayout::read() are not allocated from an arena.
+  REQUIRE(BoxArena::current() == nullptr);
+}
+
+
+TEST_CASE("memory-mapped StreamReader") {
+  std::string filename = tests_data_directory + "/uncompressed_comp_ABGR.heif";
+
+  auto mmap_reader = StreamReader_mmap::open(filename.c_str());
+  REQUIRE(mmap_reader);
+
+  std::ifstream istr(filename, std::ios::binary);
+  std::vector<uint8_t> file_data((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+  REQUIRE(!file_data.empty());
+
+  REQUIRE(mmap_reader->wait_for_file_size(file_data.size()) == StreamReader::grow_status::size_reached);
+  REQUIRE(mmap_reader->wait_for_file_size(file_data.size() + 1) == StreamReader::grow_status::size_beyond_eof);
+
+  const uint8_t* direct = mmap_reader->get_direct_data_pointer(0, file_data.size());
+  REQUIRE(direct != nullptr);
+  REQUIRE(memcmp(direct, file_data.data(), file_data.size()) == 0);
+  REQUIRE(mmap_reader->get_direct_data_pointer(0, file_data.size() + 1) == nullptr);
+
+  uint8_t buf[8];
+  REQUIRE(mmap_reader->seek(4));
+  REQUIRE(mmap_reader->read(buf, 4));
+  REQUIRE(memcmp(buf, "ftyp", 4) == 0);
+  REQUIRE(mmap_reader->get_position() == 8);
+
+  REQUIRE(mmap_reader->seek(file_data.size() - 2));
+  REQUIRE(!mmap_reader->read(buf, 4));
+
+  REQUIRE(StreamReader_mmap::open((tests_data_directory + "/does_not_exist.heif").c_str()) == nullptr);
+}
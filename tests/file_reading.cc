@@ -0,0 +1,501 @@
+/*
+  libheif unit tests for reading files through heif_reader
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Region decoding sends preload hints for the required tiles")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  recorder.preload_hints.clear();
+
+  // covers the two right tiles of the upper row
+
+  heif_image* img;
+  err = heif_decode_image_region(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                 170, 10, 200, 50);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // The tiles are stored one after the other, so the hints are merged into one range.
+  REQUIRE(recorder.preload_hints.size() == 1);
+  REQUIRE(recorder.preload_hints[0].second - recorder.preload_hints[0].first == 2 * 160 * 120 * 3);
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Item data cache serves repeated reads of the same item")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_item_data_cache_size(ctx, 1024 * 1024);
+  heif_error err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  auto decode_tile = [&]() {
+    heif_image* img;
+    heif_error e = heif_image_handle_decode_image_tile(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB,
+                                                        nullptr, 1, 0);
+    REQUIRE(e.code == heif_error_Ok);
+    std::vector<uint8_t> pixels = get_interleaved_pixels(img, 0, 0, 160, 120);
+    heif_image_release(img);
+    return pixels;
+  };
+
+  recorder.range_requests.clear();
+  std::vector<uint8_t> first = decode_tile();
+  REQUIRE(!recorder.range_requests.empty());
+
+  recorder.range_requests.clear();
+  REQUIRE(decode_tile() == first);
+  REQUIRE(recorder.range_requests.empty());
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Region decoding of an untiled image reads only the rows of the region")
+{
+  heif_image* input = create_gradient_image(400, 300, 7);
+
+  heif_context* enc_ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(enc_ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_encode_image(enc_ctx, input, encoder, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(enc_ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(enc_ctx);
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+
+  heif_context* ctx = heif_context_alloc();
+  err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  recorder.reads.clear();
+
+  heif_image* img;
+  err = heif_decode_image_region(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                 50, 100, 120, 10);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // The components are stored as separate planes. Ten rows are read from each of them.
+  REQUIRE(recorder.reads.size() == 3);
+  for (const auto& read : recorder.reads) {
+    REQUIRE(read.second - read.first == 10 * 400);
+  }
+
+  heif_image* full;
+  err = heif_decode_image(handle, &full, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(get_interleaved_pixels(img, 0, 0, 120, 10) == get_interleaved_pixels(full, 50, 100, 120, 10));
+
+  heif_image_release(full);
+  heif_image_release(img);
+  heif_image_release(input);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Full grid decoding reads all tiles with one request")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_item_data_cache_size(ctx, 1024 * 1024);
+  heif_error err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  recorder.range_requests.clear();
+  recorder.reads.clear();
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(recorder.range_requests.size() == 1);
+  REQUIRE(recorder.range_requests[0].second - recorder.range_requests[0].first == 6 * 160 * 120 * 3);
+  REQUIRE(recorder.reads.size() == 1);
+
+  // compare with the image decoded from memory
+
+  heif_context* mem_ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(mem_ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* mem_handle;
+  err = heif_context_get_primary_image_handle(mem_ctx, &mem_handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* mem_img;
+  err = heif_decode_image(mem_handle, &mem_img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(get_interleaved_pixels(img, 0, 0, 480, 240) == get_interleaved_pixels(mem_img, 0, 0, 480, 240));
+
+  heif_image_release(mem_img);
+  heif_image_handle_release(mem_handle);
+  heif_context_free(mem_ctx);
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Region decoding requests the required tiles asynchronously")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+  reader.reader_api_version = 3;
+
+  // complete the requests from another thread, like a network reader would do
+  reader.request_range_async = [](uint64_t start_pos, uint64_t end_pos,
+                                  void (*on_completion)(heif_reader_range_request_result, void*),
+                                  void* completion_userdata, void* userdata) {
+    auto* r = static_cast<RecordingReader*>(userdata);
+    r->async_requests.emplace_back(start_pos, end_pos);
+
+    heif_reader_range_request_result result{};
+    result.status = heif_reader_grow_status_size_reached;
+    result.range_end = end_pos;
+
+    r->completion_threads.emplace_back([=]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      on_completion(result, completion_userdata);
+    });
+  };
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  recorder.async_requests.clear();
+
+  heif_image* img;
+  err = heif_decode_image_region(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                 170, 10, 200, 50);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(recorder.preload_hints.empty());
+  REQUIRE(recorder.async_requests.size() == 1);
+  REQUIRE(recorder.async_requests[0].second - recorder.async_requests[0].first == 2 * 160 * 120 * 3);
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  for (auto& thread : recorder.completion_threads) {
+    thread.join();
+  }
+}
+
+
+TEST_CASE("Image data is read with read_at() if the reader supports it")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  auto decode = [&](const heif_reader& reader, RecordingReader& recorder) {
+    heif_context* ctx = heif_context_alloc();
+    heif_error err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image_handle* handle;
+    err = heif_context_get_primary_image_handle(ctx, &handle);
+    REQUIRE(err.code == heif_error_Ok);
+
+    recorder.reads.clear();
+
+    heif_image* img;
+    err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    std::vector<uint8_t> pixels = get_interleaved_pixels(img, 0, 0, 480, 240);
+
+    heif_image_release(img);
+    heif_image_handle_release(handle);
+    heif_context_free(ctx);
+    return pixels;
+  };
+
+  RecordingReader serial_recorder;
+  serial_recorder.data = &file_data;
+  std::vector<uint8_t> expected = decode(get_recording_reader(), serial_recorder);
+  REQUIRE(!serial_recorder.reads.empty());
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+  reader.reader_api_version = 4;
+
+  // called from the tile decoding threads concurrently
+  reader.read_at = [](uint64_t position, void* buffer, size_t size, void* userdata) -> int {
+    auto* r = static_cast<RecordingReader*>(userdata);
+    if (position + size > r->data->size()) {
+      return 1;
+    }
+    memcpy(buffer, r->data->data() + position, size);
+    r->positional_reads++;
+    return 0;
+  };
+
+  REQUIRE(decode(reader, recorder) == expected);
+  REQUIRE(recorder.positional_reads == 6);
+  REQUIRE(recorder.reads.empty());
+}
+
+
+static heif_context* read_with_recorder(RecordingReader& recorder, const std::vector<uint8_t>* index)
+{
+  // the context keeps a pointer to the reader
+  static const heif_reader reader = get_recording_reader();
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err;
+  if (index) {
+    err = heif_context_read_from_index(ctx, index->data(), index->size(), &reader, &recorder, nullptr);
+  }
+  else {
+    err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  }
+
+  if (err.code != heif_error_Ok) {
+    heif_context_free(ctx);
+    return nullptr;
+  }
+
+  return ctx;
+}
+
+
+TEST_CASE("Read file structure from header index")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+
+  heif_context* ctx = read_with_recorder(recorder, nullptr);
+  REQUIRE(ctx != nullptr);
+  size_t requests_without_index = recorder.range_requests.size();
+
+  std::vector<uint8_t> index;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  heif_error err = heif_context_write_header_index(ctx, &writer, &index);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> reference = decode_primary_image(ctx);
+  heif_context_free(ctx);
+
+  // --- open the file again with the index
+
+  recorder.range_requests.clear();
+  ctx = read_with_recorder(recorder, &index);
+  REQUIRE(ctx != nullptr);
+  REQUIRE(recorder.range_requests.size() < requests_without_index);
+  REQUIRE(decode_primary_image(ctx) == reference);
+  heif_context_free(ctx);
+
+  // --- a corrupted index is rejected
+
+  std::vector<uint8_t> broken_index = index;
+  broken_index[broken_index.size() / 2] ^= 0xFF;
+  REQUIRE(read_with_recorder(recorder, &broken_index) == nullptr);
+
+  // --- an index of another file is rejected
+
+  std::vector<uint8_t> other_file = file_data;
+  other_file[10] ^= 0xFF; // inside 'ftyp'
+  recorder.data = &other_file;
+  REQUIRE(read_with_recorder(recorder, &index) == nullptr);
+}
+
+
+TEST_CASE("Read-ahead and primary image prefetch")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  RecordingReader recorder;
+  recorder.data = &file_data;
+  heif_reader reader = get_recording_reader();
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(recorder.range_requests[0] == std::make_pair(uint64_t{0}, uint64_t{1024}));
+  REQUIRE(recorder.preload_hints.empty());
+  heif_context_free(ctx);
+
+  // --- larger read-ahead and prefetch of the grid tiles
+
+  recorder.range_requests.clear();
+  recorder.position = 0;
+
+  ctx = heif_context_alloc();
+  heif_context_set_initial_read_size(ctx, 65536);
+  heif_context_set_prefetch_primary_image(ctx, 1);
+  err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(recorder.range_requests[0] == std::make_pair(uint64_t{0}, uint64_t{65536}));
+
+  // All grid tiles are stored one after the other and are announced as one range.
+  REQUIRE(recorder.preload_hints.size() == 1);
+  REQUIRE(recorder.preload_hints[0].second - recorder.preload_hints[0].first == 6 * 160 * 120 * 3);
+
+  heif_context_free(ctx);
+}
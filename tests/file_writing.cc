@@ -0,0 +1,535 @@
+/*
+  libheif unit tests for writing files, temporary files and streaming output
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_experimental.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "test_utils.h"
+
+
+enum class OutputMode
+{
+  Memory,
+  TemporaryFile,
+  Streaming
+};
+
+struct SeekableOutput
+{
+  std::vector<uint8_t> data;
+  size_t position = 0;
+};
+
+static heif_error write_to_seekable_output(struct heif_context*, const void* data, size_t size, void* userdata)
+{
+  auto* out = static_cast<SeekableOutput*>(userdata);
+  if (out->position + size > out->data.size()) {
+    out->data.resize(out->position + size);
+  }
+  memcpy(out->data.data() + out->position, data, size);
+  out->position += size;
+  return heif_error_success;
+}
+
+static heif_error seek_in_seekable_output(struct heif_context*, uint64_t position, void* userdata)
+{
+  auto* out = static_cast<SeekableOutput*>(userdata);
+  REQUIRE(position <= out->data.size());
+  out->position = position;
+  return heif_error_success;
+}
+
+static const char xmp_test_data[] = "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"></x:xmpmeta>";
+
+static std::vector<uint8_t> encode_with_output_mode(OutputMode mode)
+{
+  heif_context* ctx = heif_context_alloc();
+
+  SeekableOutput output;
+  heif_writer writer{};
+  writer.writer_api_version = 2;
+  writer.write = write_to_seekable_output;
+  writer.seek = seek_in_seekable_output;
+
+  heif_error err;
+  if (mode == OutputMode::TemporaryFile) {
+    err = heif_context_store_image_data_in_temporary_file(ctx);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+  else if (mode == OutputMode::Streaming) {
+    err = heif_context_start_streaming(ctx, &writer, &output);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+
+  heif_encoder* encoder;
+  err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* input = create_gradient_image(120, 80, 3);
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, input, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(input);
+
+  err = heif_context_add_XMP_metadata(ctx, handle, xmp_test_data, sizeof(xmp_test_data));
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_handle_release(handle);
+  heif_encoder_release(encoder);
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+  // The data of uncompressed tiles is overwritten when the tiles are added.
+
+  heif_image* prototype = create_gradient_image(32, 32, 0);
+
+  heif_unci_image_parameters params{};
+  params.version = 1;
+  params.image_width = 64;
+  params.image_height = 64;
+  params.tile_width = 32;
+  params.tile_height = 32;
+  params.compression = heif_unci_compression_off;
+
+  err = heif_context_add_unci_image(ctx, &params, nullptr, prototype, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(prototype);
+
+  for (int ty = 0; ty < 2; ty++) {
+    for (int tx = 0; tx < 2; tx++) {
+      heif_image* tile = create_gradient_image(32, 32, ty * 2 + tx + 10);
+      err = heif_context_add_image_tile(ctx, handle, tx, ty, tile, nullptr);
+      REQUIRE(err.code == heif_error_Ok);
+      heif_image_release(tile);
+    }
+  }
+
+  heif_image_handle_release(handle);
+#endif
+
+  if (mode == OutputMode::Memory) {
+    std::vector<uint8_t> data;
+    heif_writer v1_writer{};
+    v1_writer.writer_api_version = 1;
+    v1_writer.write = write_to_vector;
+    err = heif_context_write(ctx, &v1_writer, &data);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_context_free(ctx);
+    return data;
+  }
+
+  err = heif_context_write(ctx, &writer, &output);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(output.position == output.data.size());
+
+  heif_context_free(ctx);
+
+  return output.data;
+}
+
+static std::vector<std::vector<uint8_t>> decode_top_level_images(const std::vector<uint8_t>& file_data)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int n = heif_context_get_number_of_top_level_images(ctx);
+  std::vector<heif_item_id> ids(n);
+  heif_context_get_list_of_top_level_image_IDs(ctx, ids.data(), n);
+
+  std::vector<std::vector<uint8_t>> images;
+
+  for (heif_item_id id : ids) {
+    heif_image_handle* handle;
+    err = heif_context_get_image_handle(ctx, id, &handle);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image* img;
+    err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+    images.push_back(get_interleaved_pixels(img, 0, 0, heif_image_get_primary_width(img), heif_image_get_primary_height(img)));
+    heif_image_release(img);
+
+    heif_item_id metadata_id;
+    if (heif_image_handle_get_list_of_metadata_block_IDs(handle, "mime", &metadata_id, 1) == 1) {
+      std::vector<uint8_t> metadata(heif_image_handle_get_metadata_size(handle, metadata_id));
+      err = heif_image_handle_get_metadata(handle, metadata_id, metadata.data());
+      REQUIRE(err.code == heif_error_Ok);
+      images.push_back(metadata);
+    }
+
+    heif_image_handle_release(handle);
+  }
+
+  heif_context_free(ctx);
+
+  return images;
+}
+
+TEST_CASE("Write image data through a temporary file and as stream")
+{
+  std::vector<uint8_t> memory_file = encode_with_output_mode(OutputMode::Memory);
+  std::vector<uint8_t> tmpfile_file = encode_with_output_mode(OutputMode::TemporaryFile);
+  std::vector<uint8_t> streamed_file = encode_with_output_mode(OutputMode::Streaming);
+
+  // The temporary file does not change the file layout.
+  REQUIRE(tmpfile_file == memory_file);
+
+  std::vector<std::vector<uint8_t>> images = decode_top_level_images(memory_file);
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+  REQUIRE(images.size() == 3);
+#else
+  REQUIRE(images.size() == 2);
+#endif
+  REQUIRE(images[1] == std::vector<uint8_t>(xmp_test_data, xmp_test_data + sizeof(xmp_test_data)));
+
+  REQUIRE(decode_top_level_images(streamed_file) == images);
+}
+
+TEST_CASE("Streaming requires a seekable writer")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  heif_error err = heif_context_start_streaming(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  // The write mode cannot be changed after image data has been added.
+
+  heif_encoder* encoder;
+  err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image* input = create_gradient_image(16, 16, 0);
+  err = heif_context_encode_image(ctx, input, encoder, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(input);
+  heif_encoder_release(encoder);
+
+  err = heif_context_store_image_data_in_temporary_file(ctx);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  heif_context_free(ctx);
+}
+
+TEST_CASE("Stream grid tiles to the output while they are added")
+{
+  const int tile_size = 32;
+  const int columns = 3;
+  const int rows = 2;
+
+  heif_context* ctx = heif_context_alloc();
+
+  SeekableOutput output;
+  heif_writer writer{};
+  writer.writer_api_version = 2;
+  writer.write = write_to_seekable_output;
+  writer.seek = seek_in_seekable_output;
+
+  heif_error err = heif_context_start_streaming(ctx, &writer, &output);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder* encoder;
+  err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  heif_image_handle* grid;
+  err = heif_context_add_grid_image(ctx, tile_size * columns, tile_size * rows, columns, rows, options, &grid);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> expected_pixels;
+
+  for (int ty = 0; ty < rows; ty++) {
+    for (int tx = 0; tx < columns; tx++) {
+      size_t size_before = output.data.size();
+
+      heif_image* tile = create_gradient_image(tile_size, tile_size, ty * columns + tx);
+      err = heif_context_add_image_tile(ctx, grid, tx, ty, tile, encoder);
+      REQUIRE(err.code == heif_error_Ok);
+      heif_image_release(tile);
+
+      // the tile data has been passed to the writer immediately
+      REQUIRE(output.data.size() >= size_before + tile_size * tile_size * 3);
+    }
+  }
+
+  heif_context_set_primary_image(ctx, grid);
+  heif_image_handle_release(grid);
+
+  err = heif_context_write(ctx, &writer, &output);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options_free(options);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- the decoded tiles match the input
+
+  std::vector<std::vector<uint8_t>> images = decode_top_level_images(output.data);
+  REQUIRE(images.size() == 1);
+
+  for (int ty = 0; ty < rows; ty++) {
+    for (int tx = 0; tx < columns; tx++) {
+      heif_image* tile = create_gradient_image(tile_size, tile_size, ty * columns + tx);
+
+      for (int y = 0; y < tile_size; y++) {
+        for (int x = 0; x < tile_size; x++) {
+          size_t idx = ((ty * tile_size + y) * tile_size * columns + tx * tile_size + x) * 3;
+          int stride;
+          const uint8_t* r = heif_image_get_plane_readonly(tile, heif_channel_R, &stride);
+          REQUIRE(images[0][idx] == r[y * stride + x]);
+        }
+      }
+
+      heif_image_release(tile);
+    }
+  }
+}
+
+
+// A grid with 3x2 uniform tiles that are added in reverse order, with a thumbnail encoded afterward.
+static std::vector<uint8_t> encode_grid_with_data_order(heif_image_data_order order, bool temporary_file)
+{
+  const int tile_size = 32;
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_image_data_order(ctx, order);
+
+  heif_error err;
+  if (temporary_file) {
+    err = heif_context_store_image_data_in_temporary_file(ctx);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+
+  heif_encoder* encoder;
+  err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  heif_image_handle* grid;
+  err = heif_context_add_grid_image(ctx, tile_size * 3, tile_size * 2, 3, 2, options, &grid);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int i = 5; i >= 0; i--) {
+    heif_image* tile = create_uniform_image(tile_size, tile_size, static_cast<uint8_t>(20 * (i + 1)));
+    err = heif_context_add_image_tile(ctx, grid, i % 3, i / 3, tile, encoder);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_image_release(tile);
+  }
+
+  heif_context_set_primary_image(ctx, grid);
+
+  heif_image* thumbnail_source = create_uniform_image(tile_size * 3, tile_size * 2, 250);
+  heif_image_handle* thumbnail_handle;
+  err = heif_context_encode_thumbnail(ctx, thumbnail_source, grid, encoder, nullptr, 24, &thumbnail_handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(thumbnail_source);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // The context can be written again with the same layout.
+  std::vector<uint8_t> second_data;
+  err = heif_context_write(ctx, &writer, &second_data);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(second_data == data);
+
+  heif_image_handle_release(thumbnail_handle);
+  heif_image_handle_release(grid);
+  heif_encoding_options_free(options);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  return data;
+}
+
+static size_t find_uniform_data(const std::vector<uint8_t>& data, uint8_t value, size_t size)
+{
+  std::vector<uint8_t> pattern(size, value);
+  auto iter = std::search(data.begin(), data.end(), pattern.begin(), pattern.end());
+  REQUIRE(iter != data.end());
+  return static_cast<size_t>(iter - data.begin());
+}
+
+TEST_CASE("Order the image data for progressive loading")
+{
+  const size_t tile_data_size = 32 * 32 * 3;
+  const size_t thumbnail_data_size = 24 * 16 * 3;
+
+  auto get_tile_order = [&](const std::vector<uint8_t>& data) {
+    std::vector<std::pair<size_t, int>> positions;
+    for (int i = 0; i < 6; i++) {
+      positions.emplace_back(find_uniform_data(data, static_cast<uint8_t>(20 * (i + 1)), tile_data_size), i);
+    }
+
+    std::sort(positions.begin(), positions.end());
+
+    std::vector<int> order;
+    for (const auto& position : positions) {
+      order.push_back(position.second);
+    }
+
+    return order;
+  };
+
+  std::vector<uint8_t> as_added = encode_grid_with_data_order(heif_image_data_order_as_added, false);
+  std::vector<uint8_t> progressive = encode_grid_with_data_order(heif_image_data_order_progressive, false);
+  std::vector<uint8_t> z_order = encode_grid_with_data_order(heif_image_data_order_progressive_z_order, false);
+
+  REQUIRE(get_tile_order(as_added) == std::vector<int>{5, 4, 3, 2, 1, 0});
+  REQUIRE(find_uniform_data(as_added, 250, thumbnail_data_size) > find_uniform_data(as_added, 20, tile_data_size));
+
+  REQUIRE(get_tile_order(progressive) == std::vector<int>{0, 1, 2, 3, 4, 5});
+  REQUIRE(find_uniform_data(progressive, 250, thumbnail_data_size) < find_uniform_data(progressive, 20, tile_data_size));
+
+  REQUIRE(get_tile_order(z_order) == std::vector<int>{0, 1, 3, 4, 2, 5});
+
+  // The data in the temporary file is reordered in the same way.
+  REQUIRE(encode_grid_with_data_order(heif_image_data_order_progressive, true) == progressive);
+
+  // --- the images are unchanged
+
+  std::vector<std::vector<uint8_t>> images = decode_top_level_images(as_added);
+  REQUIRE(decode_top_level_images(progressive) == images);
+  REQUIRE(decode_top_level_images(z_order) == images);
+}
+
+
+TEST_CASE("Rewrite a file without reencoding the image")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* input_image = createImage_RGB_planar();
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, input_image, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  const uint8_t exif[] = {'M', 'M', 0, '*', 0, 0, 0, 8, 0, 0};
+  err = heif_context_add_exif_metadata(ctx, handle, exif, sizeof(exif));
+  REQUIRE(err.code == heif_error_Ok);
+
+  const char xmp[] = "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"/>";
+  err = heif_context_add_XMP_metadata(ctx, handle, xmp, sizeof(xmp));
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle_release(handle);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_release(input_image);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- remove the Exif data and write the file again
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_item_id exif_id;
+  REQUIRE(heif_image_handle_get_list_of_metadata_block_IDs(handle, "Exif", &exif_id, 1) == 1);
+
+  err = heif_context_remove_metadata(ctx, handle, exif_id);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_handle_get_number_of_metadata_blocks(handle, nullptr) == 1);
+
+  err = heif_context_remove_metadata(ctx, handle, exif_id);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  std::vector<uint8_t> rewritten_data;
+  err = heif_context_write(ctx, &writer, &rewritten_data);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(rewritten_data.size() < file_data.size());
+
+  // the image can still be decoded from the input file
+
+  heif_image* original;
+  err = heif_decode_image(handle, &original, heif_colorspace_undefined, heif_chroma_undefined, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  // --- read the rewritten file
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, rewritten_data.data(), rewritten_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(heif_image_handle_get_number_of_metadata_blocks(handle, "Exif") == 0);
+
+  heif_item_id xmp_id;
+  REQUIRE(heif_image_handle_get_list_of_metadata_block_IDs(handle, "mime", &xmp_id, 1) == 1);
+  REQUIRE(heif_image_handle_get_metadata_size(handle, xmp_id) == sizeof(xmp));
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_undefined, heif_chroma_undefined, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    size_t stride, original_stride;
+    const uint8_t* p = heif_image_get_plane_readonly2(img, channel, &stride);
+    const uint8_t* q = heif_image_get_plane_readonly2(original, channel, &original_stride);
+    REQUIRE(p != nullptr);
+    REQUIRE(q != nullptr);
+
+    int width = heif_image_get_width(img, channel);
+    int height = heif_image_get_height(img, channel);
+    for (int y = 0; y < height; y++) {
+      REQUIRE(memcmp(p + y * stride, q + y * original_stride, width) == 0);
+    }
+  }
+
+  heif_image_release(img);
+  heif_image_release(original);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
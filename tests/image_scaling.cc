@@ -0,0 +1,195 @@
+/*
+  libheif unit tests
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "image_scaling.h"
+#include "pixelimage.h"
+#include <cstring>
+#include <random>
+
+
+static std::shared_ptr<HeifPixelImage> create_random_image(heif_colorspace colorspace, heif_chroma chroma,
+                                                           uint32_t width, uint32_t height, int bpp)
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, colorspace, chroma);
+
+  std::vector<heif_channel> channels;
+  if (chroma == heif_chroma_interleaved_RGB || chroma == heif_chroma_interleaved_RGBA ||
+      chroma == heif_chroma_interleaved_RRGGBB_BE || chroma == heif_chroma_interleaved_RRGGBBAA_LE) {
+    channels = {heif_channel_interleaved};
+  }
+  else if (colorspace == heif_colorspace_YCbCr) {
+    channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+  }
+  else {
+    channels = {heif_channel_R, heif_channel_G, heif_channel_B};
+  }
+
+  std::mt19937 random_generator(width * 1000 + height);
+
+  for (heif_channel channel : channels) {
+    REQUIRE(!img->add_plane(channel, channel_width(width, chroma, channel), channel_height(height, chroma, channel), bpp, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(channel, &stride);
+    uint32_t row_bytes = img->get_width(channel) * img->get_storage_bits_per_pixel(channel) / 8;
+
+    for (uint32_t y = 0; y < img->get_height(channel); y++) {
+      for (uint32_t x = 0; x < row_bytes; x++) {
+        p[y * stride + x] = static_cast<uint8_t>(random_generator());
+      }
+
+      // keep the high-bit-depth samples in range
+      if (bpp > 8 && bpp < 16) {
+        for (uint32_t x = 0; x < row_bytes; x += 2) {
+          if (chroma == heif_chroma_interleaved_RRGGBB_BE) {
+            p[y * stride + x] &= static_cast<uint8_t>((1 << (bpp - 8)) - 1);
+          }
+          else {
+            p[y * stride + x + 1] &= static_cast<uint8_t>((1 << (bpp - 8)) - 1);
+          }
+        }
+      }
+    }
+  }
+
+  return img;
+}
+
+
+static void require_same_planes(const std::shared_ptr<HeifPixelImage>& a, const std::shared_ptr<HeifPixelImage>& b)
+{
+  REQUIRE(a->get_channel_set() == b->get_channel_set());
+
+  for (heif_channel channel : a->get_channel_set()) {
+    INFO("channel: " << channel);
+    REQUIRE(a->get_width(channel) == b->get_width(channel));
+    REQUIRE(a->get_height(channel) == b->get_height(channel));
+
+    size_t a_stride, b_stride;
+    const uint8_t* pa = a->get_plane(channel, &a_stride);
+    const uint8_t* pb = b->get_plane(channel, &b_stride);
+    uint32_t row_bytes = a->get_width(channel) * a->get_storage_bits_per_pixel(channel) / 8;
+
+    for (uint32_t y = 0; y < a->get_height(channel); y++) {
+      INFO("row: " << y);
+      REQUIRE(memcmp(pa + y * a_stride, pb + y * b_stride, row_bytes) == 0);
+    }
+  }
+}
+
+
+TEST_CASE("Area scaling averages pixel blocks")
+{
+  auto img = create_random_image(heif_colorspace_RGB, heif_chroma_interleaved_RGBA, 64, 32, 8);
+
+  std::shared_ptr<HeifPixelImage> out;
+  REQUIRE(!scale_image(*img, out, 16, 8, heif_scaling_filter_area, 1, nullptr));
+  REQUIRE(out->get_chroma_format() == heif_chroma_interleaved_RGBA);
+
+  size_t in_stride, out_stride;
+  const uint8_t* in = img->get_plane(heif_channel_interleaved, &in_stride);
+  const uint8_t* p = out->get_plane(heif_channel_interleaved, &out_stride);
+
+  for (uint32_t y = 0; y < 8; y++) {
+    for (uint32_t x = 0; x < 16; x++) {
+      for (uint32_t c = 0; c < 4; c++) {
+        int sum = 0;
+        for (uint32_t dy = 0; dy < 4; dy++) {
+          for (uint32_t dx = 0; dx < 4; dx++) {
+            sum += in[(y * 4 + dy) * in_stride + (x * 4 + dx) * 4 + c];
+          }
+        }
+
+        // float rounding may differ by one at exact halves
+        int expected = (sum + 8) / 16;
+        REQUIRE(std::abs(p[y * out_stride + x * 4 + c] - expected) <= 1);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Scaling keeps constant images constant")
+{
+  for (heif_scaling_filter filter : {heif_scaling_filter_area, heif_scaling_filter_lanczos3}) {
+    auto img = std::make_shared<HeifPixelImage>();
+    img->create(101, 77, heif_colorspace_YCbCr, heif_chroma_420);
+    REQUIRE(!img->fill_new_plane(heif_channel_Y, 1000, 101, 77, 10, nullptr));
+    REQUIRE(!img->fill_new_plane(heif_channel_Cb, 200, 51, 39, 10, nullptr));
+    REQUIRE(!img->fill_new_plane(heif_channel_Cr, 1023, 51, 39, 10, nullptr));
+
+    for (auto size : {std::make_pair(33u, 20u), std::make_pair(150u, 90u)}) {
+      std::shared_ptr<HeifPixelImage> out;
+      REQUIRE(!scale_image(*img, out, size.first, size.second, filter, 1, nullptr));
+
+      // chroma is scaled at its subsampled resolution
+      REQUIRE(out->get_width(heif_channel_Cb) == (size.first + 1) / 2);
+      REQUIRE(out->get_height(heif_channel_Cb) == (size.second + 1) / 2);
+
+      for (auto [channel, value] : {std::make_pair(heif_channel_Y, 1000), std::make_pair(heif_channel_Cb, 200),
+                                    std::make_pair(heif_channel_Cr, 1023)}) {
+        size_t stride;
+        const uint16_t* p = out->get_channel<uint16_t>(channel, &stride);
+        for (uint32_t y = 0; y < out->get_height(channel); y++) {
+          for (uint32_t x = 0; x < out->get_width(channel); x++) {
+            REQUIRE(p[y * stride + x] == value);
+          }
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Threaded scaling")
+{
+  struct Format
+  {
+    heif_colorspace colorspace;
+    heif_chroma chroma;
+    int bpp;
+  };
+
+  for (Format format : {Format{heif_colorspace_YCbCr, heif_chroma_420, 8},
+                        Format{heif_colorspace_RGB, heif_chroma_444, 12},
+                        Format{heif_colorspace_RGB, heif_chroma_interleaved_RGB, 8},
+                        Format{heif_colorspace_RGB, heif_chroma_interleaved_RRGGBB_BE, 10},
+                        Format{heif_colorspace_RGB, heif_chroma_interleaved_RRGGBBAA_LE, 16}}) {
+    INFO("chroma: " << format.chroma);
+
+    auto img = create_random_image(format.colorspace, format.chroma, 641, 479, format.bpp);
+
+    for (heif_scaling_filter filter : {heif_scaling_filter_area, heif_scaling_filter_lanczos3}) {
+      std::shared_ptr<HeifPixelImage> reference, result;
+      REQUIRE(!scale_image(*img, reference, 213, 160, filter, 1, nullptr));
+      REQUIRE(!scale_image(*img, result, 213, 160, filter, 4, nullptr));
+
+      require_same_planes(reference, result);
+    }
+  }
+}
@@ -0,0 +1,505 @@
+/*
+  libheif unit tests
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "pixelimage.h"
+#include "libheif/heif.h"
+#include "libheif/heif_properties.h"
+#include "libheif/api_structs.h"
+#include <cstring>
+#include <vector>
+
+
+static std::shared_ptr<HeifPixelImage> create_test_image(heif_chroma chroma, uint32_t width, uint32_t height, int bpp)
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, heif_colorspace_YCbCr, chroma);
+
+  uint16_t value = 1;
+
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    uint32_t w = get_subsampled_size_h(width, channel, chroma, scaling_mode::round_up);
+    uint32_t h = get_subsampled_size_v(height, channel, chroma, scaling_mode::round_up);
+    REQUIRE(!img->add_plane(channel, w, h, bpp, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(channel, &stride);
+
+    for (uint32_t y = 0; y < h; y++) {
+      for (uint32_t x = 0; x < w; x++) {
+        if (bpp > 8) {
+          reinterpret_cast<uint16_t*>(p + y * stride)[x] = value++;
+        }
+        else {
+          p[y * stride + x] = static_cast<uint8_t>(value++);
+        }
+      }
+    }
+  }
+
+  return img;
+}
+
+
+static bool images_equal(const std::shared_ptr<const HeifPixelImage>& a, const std::shared_ptr<const HeifPixelImage>& b)
+{
+  if (a->get_width() != b->get_width() || a->get_height() != b->get_height() ||
+      a->get_chroma_format() != b->get_chroma_format()) {
+    return false;
+  }
+
+  for (heif_channel channel : a->get_channel_set()) {
+    if (!b->has_channel(channel) ||
+        a->get_width(channel) != b->get_width(channel) ||
+        a->get_height(channel) != b->get_height(channel)) {
+      return false;
+    }
+
+    size_t stride_a, stride_b;
+    const uint8_t* pa = a->get_plane(channel, &stride_a);
+    const uint8_t* pb = b->get_plane(channel, &stride_b);
+    uint32_t row_bytes = a->get_width(channel) * a->get_storage_bits_per_pixel(channel) / 8;
+
+    for (uint32_t y = 0; y < a->get_height(channel); y++) {
+      if (memcmp(pa + y * stride_a, pb + y * stride_b, row_bytes) != 0) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+static std::shared_ptr<HeifPixelImage> copy_image(const std::shared_ptr<HeifPixelImage>& img)
+{
+  auto cropResult = img->crop(0, img->get_width() - 1, 0, img->get_height() - 1, nullptr);
+  REQUIRE(cropResult);
+  return *cropResult;
+}
+
+
+TEST_CASE("Fused rotation and mirroring")
+{
+  auto chroma = GENERATE(heif_chroma_444, heif_chroma_420);
+  auto bpp = GENERATE(8, 10);
+
+  auto img = create_test_image(chroma, 8, 6, bpp);
+
+  // rotations by 180 and 270 degrees equal repeated rotations by 90 degrees
+
+  auto rot90 = *img->rotate_ccw(90, nullptr);
+  REQUIRE(rot90->get_width() == 6);
+  REQUIRE(rot90->get_height() == 8);
+
+  auto rot180 = *img->rotate_ccw(180, nullptr);
+  REQUIRE(images_equal(rot180, *rot90->rotate_ccw(90, nullptr)));
+
+  auto rot270 = *img->rotate_ccw(270, nullptr);
+  REQUIRE(images_equal(rot270, *rot180->rotate_ccw(90, nullptr)));
+  REQUIRE(images_equal(img, *rot270->rotate_ccw(90, nullptr)));
+
+  // fused rotation and mirroring equals the rotation followed by mirroring
+
+  int angle = GENERATE(0, 90, 180, 270);
+  INFO("angle: " << angle);
+
+  auto fused = *copy_image(img)->rotate_ccw_and_mirror(angle, true, nullptr);
+
+  auto reference = *copy_image(img)->rotate_ccw(angle, nullptr);
+  reference = *copy_image(reference)->mirror_inplace(heif_transform_mirror_direction_horizontal, nullptr);
+
+  REQUIRE(images_equal(fused, reference));
+}
+
+
+// Reference rotation by 90 degrees, pixel by pixel.
+static std::shared_ptr<HeifPixelImage> rotate_ccw_90_reference(const std::shared_ptr<HeifPixelImage>& img)
+{
+  auto out = std::make_shared<HeifPixelImage>();
+  out->create(img->get_height(), img->get_width(), img->get_colorspace(), img->get_chroma_format());
+
+  for (heif_channel channel : img->get_channel_set()) {
+    uint32_t w = img->get_width(channel);
+    uint32_t h = img->get_height(channel);
+    REQUIRE(!out->add_plane(channel, h, w, img->get_bits_per_pixel(channel), nullptr));
+
+    size_t in_stride, out_stride;
+    const uint8_t* in = img->get_plane(channel, &in_stride);
+    uint8_t* p = out->get_plane(channel, &out_stride);
+    uint32_t pixel_size = img->get_storage_bits_per_pixel(channel) / 8;
+
+    for (uint32_t y = 0; y < w; y++) {
+      for (uint32_t x = 0; x < h; x++) {
+        memcpy(p + y * out_stride + x * pixel_size, in + x * in_stride + (w - 1 - y) * pixel_size, pixel_size);
+      }
+    }
+  }
+
+  return out;
+}
+
+
+TEST_CASE("Blocked rotation of large planes")
+{
+  auto format = GENERATE(std::make_pair(heif_chroma_444, 8),
+                         std::make_pair(heif_chroma_444, 12),
+                         std::make_pair(heif_chroma_interleaved_RGB, 8),
+                         std::make_pair(heif_chroma_interleaved_RGBA, 8),
+                         std::make_pair(heif_chroma_interleaved_RRGGBB_LE, 10));
+  INFO("chroma: " << format.first << ", bpp: " << format.second);
+
+  // not a multiple of the block sizes, to also cover the borders
+  const uint32_t width = 203, height = 117;
+
+  auto img = std::make_shared<HeifPixelImage>();
+  bool interleaved = (format.first != heif_chroma_444);
+  img->create(width, height, interleaved ? heif_colorspace_RGB : heif_colorspace_YCbCr, format.first);
+
+  std::vector<heif_channel> channels;
+  if (interleaved) {
+    channels = {heif_channel_interleaved};
+  }
+  else {
+    channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+  }
+
+  uint8_t value = 0;
+  for (heif_channel channel : channels) {
+    REQUIRE(!img->add_plane(channel, width, height, format.second, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(channel, &stride);
+    uint32_t row_bytes = width * img->get_storage_bits_per_pixel(channel) / 8;
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < row_bytes; x++) {
+        p[y * stride + x] = value;
+        value = static_cast<uint8_t>(value * 7 + 3);
+      }
+    }
+  }
+
+  auto rot90 = *img->rotate_ccw(90, nullptr);
+  REQUIRE(images_equal(rot90, rotate_ccw_90_reference(img)));
+
+  auto rot270 = *img->rotate_ccw(270, nullptr);
+  REQUIRE(images_equal(img, rotate_ccw_90_reference(rot270)));
+
+  for (int angle : {90, 270}) {
+    auto fused = *img->rotate_ccw_and_mirror(angle, true, nullptr);
+    auto reference = *img->rotate_ccw(angle, nullptr);
+    reference = *reference->mirror_inplace(heif_transform_mirror_direction_horizontal, nullptr);
+    REQUIRE(images_equal(fused, reference));
+  }
+}
+
+
+TEST_CASE("Zero-copy crop")
+{
+  auto chroma = GENERATE(heif_chroma_444, heif_chroma_420);
+
+  REQUIRE(!HeifPixelImage::set_plane_alignment(16));
+
+  auto img = create_test_image(chroma, 64, 40, 8);
+  auto reference = *img->crop(32, 60, 2, 36, nullptr);
+
+  size_t stride;
+  const uint8_t* data = img->get_plane(heif_channel_Y, &stride);
+
+  auto cropped = *img->crop_inplace(32, 60, 2, 36, nullptr);
+  REQUIRE(cropped == img);
+  REQUIRE(cropped->get_width() == 29);
+  REQUIRE(cropped->get_height() == 35);
+  REQUIRE(images_equal(cropped, reference));
+
+  size_t cropped_stride;
+  REQUIRE(cropped->get_plane(heif_channel_Y, &cropped_stride) == data + 2 * stride + 32);
+  REQUIRE(cropped_stride == stride);
+
+  // a window that does not start at an aligned column is copied
+
+  img = create_test_image(chroma, 64, 40, 8);
+  reference = *img->crop(2, 50, 2, 36, nullptr);
+  cropped = *img->crop_inplace(2, 50, 2, 36, nullptr);
+  REQUIRE(cropped != img);
+  REQUIRE(images_equal(cropped, reference));
+}
+
+
+TEST_CASE("Image views")
+{
+  auto chroma = GENERATE(heif_chroma_444, heif_chroma_420);
+
+  REQUIRE(!HeifPixelImage::set_plane_alignment(16));
+
+  auto img = create_test_image(chroma, 64, 40, 8);
+  auto reference = *img->crop(32, 60, 2, 36, nullptr);
+
+  size_t stride;
+  uint8_t* data = img->get_plane(heif_channel_Y, &stride);
+
+  auto viewResult = img->create_view(32, 2, 29, 35);
+  REQUIRE(!viewResult.error);
+  auto view = *viewResult;
+  REQUIRE(view->is_view());
+  REQUIRE(images_equal(view, reference));
+
+  size_t view_stride;
+  uint8_t* view_data = view->get_plane(heif_channel_Y, &view_stride);
+  REQUIRE(view_data == data + 2 * stride + 32);
+  REQUIRE(view_stride == stride);
+
+  // the view shares the memory with the source image
+
+  view_data[0] = 0xAB;
+  REQUIRE(data[2 * stride + 32] == 0xAB);
+
+  // a view of a view references the same memory
+
+  auto subview = *view->create_view(0, 4, 16, 8);
+  REQUIRE(subview->get_plane(heif_channel_Y, &view_stride) == data + 6 * stride + 32);
+
+  // padding a view does not write into the neighboring pixels of the source image
+
+  uint8_t neighbor = data[6 * stride + 48];
+  REQUIRE(!subview->extend_padding_to_size(24, 16, true, nullptr));
+  REQUIRE(data[6 * stride + 48] == neighbor);
+  REQUIRE(subview->get_plane(heif_channel_Y, &view_stride) != data + 6 * stride + 32);
+
+  // the view keeps the memory alive
+
+  img.reset();
+  reference->get_plane(heif_channel_Y, &stride)[0] = 0xAB;
+  REQUIRE(images_equal(view, reference));
+
+  // areas that cannot be referenced
+
+  img = create_test_image(chroma, 64, 40, 8);
+  REQUIRE(img->create_view(2, 0, 16, 16).error);
+  REQUIRE(img->create_view(48, 0, 32, 16).error);
+  REQUIRE(img->create_view(0, 40, 16, 1).error);
+  REQUIRE(img->create_view(0, 0, 0, 16).error);
+}
+
+static void count_release(uint8_t*, void* userdata)
+{
+  (*static_cast<int*>(userdata))++;
+}
+
+
+TEST_CASE("External planes")
+{
+  std::vector<uint8_t> data(40 * 20, 7);
+  int num_releases = 0;
+
+  heif_image* image;
+  REQUIRE(heif_image_create(30, 20, heif_colorspace_monochrome, heif_chroma_monochrome, &image).code == heif_error_Ok);
+  REQUIRE(heif_image_add_plane_external(image, heif_channel_Y, 30, 20, 8, data.data(), 40,
+                                        count_release, &num_releases).code == heif_error_Ok);
+
+  // the plane uses the memory of the caller
+
+  size_t stride;
+  REQUIRE(heif_image_get_plane_readonly2(image, heif_channel_Y, &stride) == data.data());
+  REQUIRE(stride == 40);
+
+  // adding a plane a second time fails and does not take over the memory
+
+  REQUIRE(heif_image_add_plane_external(image, heif_channel_Y, 30, 20, 8, data.data(), 40,
+                                        count_release, &num_releases).code == heif_error_Usage_error);
+  REQUIRE(num_releases == 0);
+
+  // the memory is released with the last image referencing it
+
+  heif_image* view;
+  REQUIRE(heif_image_create_view(image, 0, 0, 16, 16, &view).code == heif_error_Ok);
+
+  heif_image_release(image);
+  REQUIRE(num_releases == 0);
+
+  heif_image_release(view);
+  REQUIRE(num_releases == 1);
+
+  // padding copies the plane instead of writing outside of the caller's memory
+
+  REQUIRE(heif_image_create(30, 20, heif_colorspace_monochrome, heif_chroma_monochrome, &image).code == heif_error_Ok);
+  REQUIRE(heif_image_add_plane_external(image, heif_channel_Y, 30, 20, 8, data.data(), 40, nullptr, nullptr).code == heif_error_Ok);
+  REQUIRE(heif_image_extend_padding_to_size(image, 32, 24).code == heif_error_Ok);
+  REQUIRE(heif_image_get_plane_readonly2(image, heif_channel_Y, &stride) != data.data());
+  REQUIRE(data[30] == 7);
+  heif_image_release(image);
+
+  // the stride has to cover a row
+
+  REQUIRE(heif_image_create(30, 20, heif_colorspace_monochrome, heif_chroma_monochrome, &image).code == heif_error_Ok);
+  REQUIRE(heif_image_add_plane_external(image, heif_channel_Y, 30, 20, 16, data.data(), 40, nullptr, nullptr).code == heif_error_Usage_error);
+  heif_image_release(image);
+}
+
+#if WITH_UNCOMPRESSED_CODEC
+static heif_error write_to_vector(heif_context*, const void* data, size_t size, void* userdata)
+{
+  auto* v = static_cast<std::vector<uint8_t>*>(userdata);
+  v->insert(v->end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+  return heif_error_success;
+}
+
+
+TEST_CASE("Combined irot and imir transformations")
+{
+  auto orientation = GENERATE(heif_orientation_normal,
+                              heif_orientation_flip_horizontally,
+                              heif_orientation_rotate_180,
+                              heif_orientation_flip_vertically,
+                              heif_orientation_rotate_90_cw_then_flip_horizontally,
+                              heif_orientation_rotate_90_cw,
+                              heif_orientation_rotate_90_cw_then_flip_vertically,
+                              heif_orientation_rotate_270_cw);
+  INFO("orientation: " << orientation);
+
+  // --- encode an image with the orientation
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder = nullptr;
+  REQUIRE(heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder).code == heif_error_Ok);
+
+  heif_image input{create_test_image(heif_chroma_444, 8, 6, 8)};
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  options->image_orientation = orientation;
+  REQUIRE(heif_context_encode_image(ctx, &input, encoder, options, nullptr).code == heif_error_Ok);
+  heif_encoding_options_free(options);
+  heif_encoder_release(encoder);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  REQUIRE(heif_context_write(ctx, &writer, &data).code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  REQUIRE(heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr).code == heif_error_Ok);
+
+  heif_image_handle* handle = nullptr;
+  REQUIRE(heif_context_get_primary_image_handle(ctx, &handle).code == heif_error_Ok);
+
+  // --- apply the transformations one by one to the untransformed image
+
+  heif_decoding_options* decoding_options = heif_decoding_options_alloc();
+  decoding_options->ignore_transformations = true;
+
+  heif_image* untransformed = nullptr;
+  REQUIRE(heif_decode_image(handle, &untransformed, heif_colorspace_undefined, heif_chroma_undefined, decoding_options).code == heif_error_Ok);
+
+  std::shared_ptr<HeifPixelImage> reference = untransformed->image;
+
+  heif_item_id id = heif_image_handle_get_item_id(handle);
+  heif_property_id transforms[10];
+  int num_transforms = heif_item_get_transformation_properties(ctx, id, transforms, 10);
+
+  for (int i = 0; i < num_transforms; i++) {
+    switch (heif_item_get_property_type(ctx, id, transforms[i])) {
+      case heif_item_property_type_transform_rotation:
+        reference = *reference->rotate_ccw(heif_item_get_property_transform_rotation_ccw(ctx, id, transforms[i]), nullptr);
+        break;
+      case heif_item_property_type_transform_mirror:
+        reference = *copy_image(reference)->mirror_inplace(heif_item_get_property_transform_mirror(ctx, id, transforms[i]), nullptr);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // --- compare with the image decoded with transformations
+
+  heif_image* transformed = nullptr;
+  REQUIRE(heif_decode_image(handle, &transformed, heif_colorspace_undefined, heif_chroma_undefined, nullptr).code == heif_error_Ok);
+
+  REQUIRE(images_equal(transformed->image, reference));
+
+  heif_image_release(transformed);
+  heif_image_release(untransformed);
+  heif_decoding_options_free(decoding_options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+#endif
+
+
+TEST_CASE("Scaled plane copy")
+{
+  auto src = create_test_image(heif_chroma_444, 20, 12, 8);
+
+  SECTION("scale and crop in one pass") {
+    // the region (10;5) 30x18 of the source scaled to 45x27
+    std::shared_ptr<HeifPixelImage> scaled;
+    REQUIRE(!src->scale_nearest_neighbor(scaled, 45, 27, nullptr));
+    auto reference = *scaled->crop(10, 39, 5, 22, nullptr);
+
+    auto img = std::make_shared<HeifPixelImage>();
+    img->create(30, 18, heif_colorspace_monochrome, heif_chroma_monochrome);
+    REQUIRE(!img->copy_new_plane_scaled_from(src, heif_channel_Y, heif_channel_Alpha, 8, 45, 27, 10, 5, nullptr));
+    REQUIRE(img->get_bits_per_pixel(heif_channel_Alpha) == 8);
+
+    size_t ref_stride, stride;
+    const uint8_t* ref = reference->get_plane(heif_channel_Y, &ref_stride);
+    const uint8_t* p = img->get_plane(heif_channel_Alpha, &stride);
+    for (uint32_t y = 0; y < 18; y++) {
+      REQUIRE(memcmp(ref + y * ref_stride, p + y * stride, 30) == 0);
+    }
+  }
+
+  SECTION("bit depth conversion") {
+    auto img = std::make_shared<HeifPixelImage>();
+    img->create(20, 12, heif_colorspace_monochrome, heif_chroma_monochrome);
+    REQUIRE(!img->copy_new_plane_scaled_from(src, heif_channel_Y, heif_channel_Alpha, 10, 20, 12, 0, 0, nullptr));
+    REQUIRE(img->get_bits_per_pixel(heif_channel_Alpha) == 10);
+
+    size_t src_stride, stride;
+    const uint8_t* s = src->get_plane(heif_channel_Y, &src_stride);
+    const uint16_t* p = img->get_channel<uint16_t>(heif_channel_Alpha, &stride);
+    for (uint32_t y = 0; y < 12; y++) {
+      for (uint32_t x = 0; x < 20; x++) {
+        uint32_t v = s[y * src_stride + x];
+        REQUIRE(p[y * stride + x] == (v * 1023 + 127) / 255);
+      }
+    }
+
+    // and back to 8 bit
+    auto img8 = std::make_shared<HeifPixelImage>();
+    img8->create(20, 12, heif_colorspace_monochrome, heif_chroma_monochrome);
+    REQUIRE(!img8->copy_new_plane_scaled_from(img, heif_channel_Alpha, heif_channel_Y, 8, 20, 12, 0, 0, nullptr));
+    const uint8_t* p8 = img8->get_plane(heif_channel_Y, &stride);
+    for (uint32_t y = 0; y < 12; y++) {
+      REQUIRE(memcmp(s + y * src_stride, p8 + y * stride, 20) == 0);
+    }
+  }
+
+  SECTION("area outside of the scaled plane") {
+    auto img = std::make_shared<HeifPixelImage>();
+    img->create(20, 12, heif_colorspace_monochrome, heif_chroma_monochrome);
+    REQUIRE(img->copy_new_plane_scaled_from(src, heif_channel_Y, heif_channel_Alpha, 8, 20, 12, 1, 0, nullptr));
+  }
+}
@@ -0,0 +1,92 @@
+/*
+  libheif unit tests for decoding files that are still being loaded
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <cstdint>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Incremental decoding of a partially loaded file")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* input_image = createImage_RGB_planar();
+  err = heif_context_encode_image(ctx, input_image, encoder, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_release(input_image);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // uncompressed images cannot be decoded from a part of their data
+
+  heif_image* img = nullptr;
+  int is_complete = -1;
+  err = heif_decode_image_incremental(handle, &img, heif_colorspace_undefined, heif_chroma_undefined, nullptr,
+                                      file_data.size() - 1, &is_complete);
+  REQUIRE(err.code == heif_error_Invalid_input);
+  REQUIRE(err.subcode == heif_suberror_End_of_data);
+  REQUIRE(img == nullptr);
+  REQUIRE(is_complete == 0);
+
+  err = heif_decode_image_incremental(handle, &img, heif_colorspace_undefined, heif_chroma_undefined, nullptr,
+                                      file_data.size(), &is_complete);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(img != nullptr);
+  REQUIRE(is_complete == 1);
+  REQUIRE(heif_image_get_primary_width(img) == heif_image_handle_get_width(handle));
+  heif_image_release(img);
+
+  // progressive refinement steps are only known for JPEG 2000
+
+  uint64_t next_size;
+  err = heif_image_handle_get_next_progressive_data_range(handle, 0, &next_size, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Unsupported_feature);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
@@ -0,0 +1,222 @@
+/*
+  libheif unit tests for accessing item data and metadata
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_items.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Borrow item and metadata data without copying")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* image = create_uniform_image(32, 32, 100);
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, image, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(image);
+  heif_encoder_release(encoder);
+
+  std::vector<uint8_t> exif(1000);
+  for (size_t i = 0; i < exif.size(); i++) {
+    exif[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  err = heif_context_add_exif_metadata(ctx, handle, exif.data(), static_cast<int>(exif.size()));
+  REQUIRE(err.code == heif_error_Ok);
+
+  // compressible XMP data
+  std::string xmp(2000, 'x');
+  err = heif_context_add_XMP_metadata2(ctx, handle, xmp.data(), static_cast<int>(xmp.size()), heif_metadata_compression_zlib);
+  const bool has_compressed_xmp = (err.code == heif_error_Ok);
+
+  heif_image_handle_release(handle);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  INFO(err.message);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  auto is_in_file = [&file_data](const uint8_t* p) {
+    return p >= file_data.data() && p < file_data.data() + file_data.size();
+  };
+
+  heif_item_id exif_id;
+  REQUIRE(heif_image_handle_get_list_of_metadata_block_IDs(handle, "Exif", &exif_id, 1) == 1);
+
+  // The Exif item starts with the offset to the TIFF header.
+  const size_t exif_item_size = exif.size() + 4;
+  auto is_exif_item = [&](const uint8_t* p, size_t size) {
+    return size == exif_item_size && memcmp(p + 4, exif.data(), exif.size()) == 0;
+  };
+
+  // The Exif data references the file data.
+  const uint8_t* data;
+  size_t size;
+  err = heif_image_handle_get_metadata_borrowed(handle, exif_id, &data, &size);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(is_in_file(data));
+  REQUIRE(is_exif_item(data, size));
+
+  heif_metadata_compression compression;
+  err = heif_item_get_item_data_borrowed(ctx, exif_id, &compression, &data, &size);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(compression == heif_metadata_compression_off);
+  REQUIRE(is_in_file(data));
+  REQUIRE(is_exif_item(data, size));
+
+  if (has_compressed_xmp) {
+    heif_item_id xmp_id;
+    REQUIRE(heif_image_handle_get_list_of_metadata_block_IDs(handle, "mime", &xmp_id, 1) == 1);
+
+    // The compressed data references the file, the decompressed data is a copy kept by the context.
+    err = heif_item_get_item_data_borrowed(ctx, xmp_id, &compression, &data, &size);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(compression == heif_metadata_compression_zlib);
+    REQUIRE(is_in_file(data));
+    REQUIRE(size < xmp.size());
+
+    err = heif_item_get_item_data_borrowed(ctx, xmp_id, nullptr, &data, &size);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(!is_in_file(data));
+    REQUIRE(std::string(data, data + size) == xmp);
+
+    const uint8_t* data_again;
+    err = heif_item_get_item_data_borrowed(ctx, xmp_id, nullptr, &data_again, &size);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(data_again == data);
+
+    err = heif_image_handle_get_metadata_borrowed(handle, xmp_id, &data, &size);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(std::string(data, data + size) == xmp);
+  }
+
+  err = heif_item_get_item_data_borrowed(ctx, 1000, nullptr, &data, &size);
+  REQUIRE(err.code != heif_error_Ok);
+  REQUIRE(data == nullptr);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Decompress metadata when it is accessed")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* image = create_uniform_image(32, 32, 100);
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, image, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(image);
+  heif_encoder_release(encoder);
+
+  std::string xmp;
+  for (int i = 0; i < 500; i++) {
+    xmp += "<xmp>" + std::to_string(i) + "</xmp>";
+  }
+
+  err = heif_context_add_XMP_metadata2(ctx, handle, xmp.data(), static_cast<int>(xmp.size()), heif_metadata_compression_zlib);
+  heif_image_handle_release(handle);
+  if (err.code != heif_error_Ok) {
+    // no zlib support
+    heif_context_free(ctx);
+    return;
+  }
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_item_id xmp_id;
+  REQUIRE(heif_image_handle_get_list_of_metadata_block_IDs(handle, "mime", &xmp_id, 1) == 1);
+
+  // The size query decompresses the data and keeps it for the following read.
+  REQUIRE(heif_image_handle_get_metadata_size(handle, xmp_id) == xmp.size());
+
+  for (int i = 0; i < 2; i++) {
+    std::vector<uint8_t> data(xmp.size());
+    err = heif_image_handle_get_metadata(handle, xmp_id, data.data());
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(std::string(data.begin(), data.end()) == xmp);
+  }
+
+  const uint8_t* borrowed;
+  size_t borrowed_size;
+  err = heif_image_handle_get_metadata_borrowed(handle, xmp_id, &borrowed, &borrowed_size);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(std::string(borrowed, borrowed + borrowed_size) == xmp);
+
+  // The borrowed data is the same as the decompressed item data.
+  const uint8_t* item_data;
+  size_t item_data_size;
+  err = heif_item_get_item_data_borrowed(ctx, xmp_id, nullptr, &item_data, &item_data_size);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(item_data == borrowed);
+  REQUIRE(item_data_size == borrowed_size);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
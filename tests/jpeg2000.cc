@@ -27,8 +27,10 @@
 #include "catch_amalgamated.hpp"
 #include "libheif/heif.h"
 #include "codecs/jpeg2000_boxes.h"
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <iterator>
 
 
 TEST_CASE( "cdef" )
@@ -727,3 +729,78 @@ TEST_CASE( "codestream - COD + SIZ + CAP other" )
     REQUIRE(uut.get_precision(0) == 8);
     REQUIRE(uut.hasHighThroughputExtension() == false);
 }
+
+static std::vector<uint8_t> make_tile_part(uint8_t tile_part_index, uint32_t Psot)
+{
+    const uint8_t header[14] = {0xFF, 0x90, 0x00, 0x0A, 0x00, 0x00,
+                                (uint8_t) (Psot >> 24), (uint8_t) (Psot >> 16), (uint8_t) (Psot >> 8), (uint8_t) Psot,
+                                tile_part_index, 0x02, 0xFF, 0x93};
+    REQUIRE(Psot >= sizeof(header));
+
+    std::vector<uint8_t> data(Psot, 0x55);
+    std::copy(std::begin(header), std::end(header), data.begin());
+    return data;
+}
+
+static uint64_t next_tile_part_end(const std::vector<uint8_t>& codestream, uint64_t size)
+{
+    auto result = get_next_jpeg2000_tile_part_end(codestream.size(), size,
+                                                  [&codestream](uint64_t offset, uint64_t size) -> Result<std::vector<uint8_t>> {
+                                                      REQUIRE(offset + size <= codestream.size());
+                                                      return std::vector<uint8_t>(codestream.begin() + offset, codestream.begin() + offset + size);
+                                                  });
+    REQUIRE(result.error.error_code == heif_error_Ok);
+    return *result;
+}
+
+TEST_CASE( "codestream tile-part ends from SOT" )
+{
+    // SOC, COD (dummy content), two tile-parts, EOC
+    std::vector<uint8_t> codestream = {0xFF, 0x4F, 0xFF, 0x52, 0x00, 0x04, 0x00, 0x00};
+    for (const auto& tile_part : {make_tile_part(0, 20), make_tile_part(1, 16)}) {
+        codestream.insert(codestream.end(), tile_part.begin(), tile_part.end());
+    }
+    codestream.insert(codestream.end(), {0xFF, 0xD9});
+    REQUIRE(codestream.size() == 46);
+
+    REQUIRE(next_tile_part_end(codestream, 0) == 28);
+    REQUIRE(next_tile_part_end(codestream, 27) == 28);
+    REQUIRE(next_tile_part_end(codestream, 28) == 44);
+    REQUIRE(next_tile_part_end(codestream, 44) == 46);
+    REQUIRE(next_tile_part_end(codestream, 46) == 46);
+}
+
+TEST_CASE( "codestream tile-part ends from TLM" )
+{
+    // SOC, TLM with 16 bit tile-part lengths and no tile indices, two tile-parts, EOC
+    std::vector<uint8_t> codestream = {0xFF, 0x4F, 0xFF, 0x55, 0x00, 0x08, 0x00, 0x00, 0x00, 0x14, 0x00, 0x10};
+    for (const auto& tile_part : {make_tile_part(0, 20), make_tile_part(1, 16)}) {
+        codestream.insert(codestream.end(), tile_part.begin(), tile_part.end());
+    }
+    codestream.insert(codestream.end(), {0xFF, 0xD9});
+
+    REQUIRE(next_tile_part_end(codestream, 0) == 32);
+    REQUIRE(next_tile_part_end(codestream, 32) == 48);
+    REQUIRE(next_tile_part_end(codestream, 48) == 50);
+}
+
+TEST_CASE( "codestream tile-part ends missing SOT" )
+{
+    const uint8_t header[] = {0xFF, 0x4F, 0xFF, 0x90, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x01};
+    std::vector<uint8_t> codestream(0x20 + 2 + 12, 0x00);
+    std::copy(std::begin(header), std::end(header), codestream.begin());
+
+    auto result = get_next_jpeg2000_tile_part_end(codestream.size(), 0,
+                                                  [&codestream](uint64_t offset, uint64_t size) -> Result<std::vector<uint8_t>> {
+                                                      return std::vector<uint8_t>(codestream.begin() + offset, codestream.begin() + offset + size);
+                                                  });
+    REQUIRE(result.error.error_code == heif_error_Ok);
+    REQUIRE(*result == 0x22);
+
+    result = get_next_jpeg2000_tile_part_end(codestream.size(), 0x22,
+                                             [&codestream](uint64_t offset, uint64_t size) -> Result<std::vector<uint8_t>> {
+                                                 return std::vector<uint8_t>(codestream.begin() + offset, codestream.begin() + offset + size);
+                                             });
+    REQUIRE(result.error.error_code == heif_error_Invalid_input);
+    REQUIRE(result.error.sub_error_code == heif_suberror_Invalid_J2K_codestream);
+}
@@ -0,0 +1,311 @@
+/*
+  libheif unit tests for extracting JPEG bitstreams
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_items.h"
+#include "libheif/heif_properties.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "test_utils.h"
+
+
+static std::vector<uint8_t> encode_jpeg_file(heif_orientation orientation)
+{
+  heif_encoder* encoder = get_encoder_or_skip_test(heif_compression_JPEG);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_image* img = create_gradient_image(64, 48, 3);
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  options->image_orientation = orientation;
+
+  heif_error err = heif_context_encode_image(ctx, img, encoder, options, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options_free(options);
+  heif_image_release(img);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  return data;
+}
+
+
+static heif_error get_jpeg_bitstream(heif_context* ctx, heif_item_id id, std::vector<uint8_t>& out_data)
+{
+  heif_image_handle* handle;
+  heif_error err = heif_context_get_image_handle(ctx, id, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  uint8_t* data = nullptr;
+  size_t size = 0;
+  err = heif_image_handle_get_jpeg_bitstream(handle, &data, &size);
+  if (err.code == heif_error_Ok) {
+    out_data.assign(data, data + size);
+    heif_release_bitstream_data(&data);
+  }
+
+  heif_image_handle_release(handle);
+  return err;
+}
+
+
+struct JpegSegment
+{
+  uint8_t marker;
+  size_t pos;
+  size_t length;
+};
+
+// Returns the marker segments in front of the SOS marker.
+static std::vector<JpegSegment> get_jpeg_segments(const std::vector<uint8_t>& data)
+{
+  REQUIRE(data.size() >= 2);
+  REQUIRE(data[0] == 0xFF);
+  REQUIRE(data[1] == 0xD8);
+
+  std::vector<JpegSegment> segments;
+  for (size_t pos = 2;;) {
+    REQUIRE(pos + 4 <= data.size());
+    REQUIRE(data[pos] == 0xFF);
+    if (data[pos + 1] == 0xDA) {
+      return segments;
+    }
+
+    size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    segments.push_back({data[pos + 1], pos, length});
+    pos += 2 + length;
+  }
+}
+
+
+static bool is_exif_segment(const std::vector<uint8_t>& data, const JpegSegment& segment)
+{
+  return segment.marker == 0xE1 && segment.length >= 8 && memcmp(&data[segment.pos + 4], "Exif\0\0", 6) == 0;
+}
+
+
+// Returns the orientation tag in the first IFD of the Exif segment, or 0 if there is no Exif segment.
+static int get_exif_orientation(const std::vector<uint8_t>& data)
+{
+  for (const auto& segment : get_jpeg_segments(data)) {
+    if (!is_exif_segment(data, segment)) {
+      continue;
+    }
+
+    const uint8_t* tiff = &data[segment.pos + 10];
+    bool little_endian = (tiff[0] == 'I');
+
+    auto read16 = [&](size_t pos) -> uint32_t {
+      return little_endian ? (tiff[pos] | (tiff[pos + 1] << 8)) : ((tiff[pos] << 8) | tiff[pos + 1]);
+    };
+
+    auto read32 = [&](size_t pos) -> uint32_t {
+      return little_endian ? (read16(pos + 2) << 16) | read16(pos) : (read16(pos) << 16) | read16(pos + 2);
+    };
+
+    uint32_t ifd = read32(4);
+    for (uint32_t i = 0; i < read16(ifd); i++) {
+      uint32_t entry = ifd + 2 + 12 * i;
+      if (read16(entry) == 0x0112) {
+        return static_cast<int>(read16(entry + 8));
+      }
+    }
+
+    FAIL("Exif segment has no orientation tag");
+  }
+
+  return 0;
+}
+
+
+static void append_be32(std::vector<uint8_t>& data, uint32_t value)
+{
+  data.insert(data.end(), {uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)});
+}
+
+
+// Adds a 'jpeg' image item with the given bitstream, an 'ispe' and optionally an 'irot' and a 'clap' property.
+static heif_item_id add_jpeg_item(heif_context* ctx, const std::vector<uint8_t>& bitstream, int rotation_ccw, bool with_clap)
+{
+  heif_item_id id;
+  heif_error err = heif_context_add_item(ctx, "jpeg", bitstream.data(), static_cast<int>(bitstream.size()), &id);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> ispe = {0, 0, 0, 0};
+  append_be32(ispe, 64);
+  append_be32(ispe, 48);
+  err = heif_item_add_raw_property(ctx, id, heif_fourcc('i', 's', 'p', 'e'), nullptr, ispe.data(), ispe.size(), 0, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  if (rotation_ccw != 0) {
+    const uint8_t irot = static_cast<uint8_t>(rotation_ccw / 90);
+    err = heif_item_add_raw_property(ctx, id, heif_fourcc('i', 'r', 'o', 't'), nullptr, &irot, 1, 1, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+
+  if (with_clap) {
+    std::vector<uint8_t> clap;
+    for (uint32_t value : {32, 1, 24, 1, 0, 1, 0, 1}) {
+      append_be32(clap, value);
+    }
+    err = heif_item_add_raw_property(ctx, id, heif_fourcc('c', 'l', 'a', 'p'), nullptr, clap.data(), clap.size(), 1, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+
+  return id;
+}
+
+
+TEST_CASE("JPEG bitstream carries the image orientation as Exif tag")
+{
+  for (int orientation = heif_orientation_normal; orientation <= heif_orientation_rotate_270_cw; orientation++) {
+    std::vector<uint8_t> file = encode_jpeg_file(static_cast<heif_orientation>(orientation));
+
+    heif_context* ctx = heif_context_alloc();
+    heif_error err = heif_context_read_from_memory_without_copy(ctx, file.data(), file.size(), nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_item_id id;
+    err = heif_context_get_primary_image_ID(ctx, &id);
+    REQUIRE(err.code == heif_error_Ok);
+
+    std::vector<uint8_t> bitstream;
+    err = get_jpeg_bitstream(ctx, id, bitstream);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_context_free(ctx);
+
+    // The Exif segment is inserted behind the JFIF segment.
+    std::vector<JpegSegment> segments = get_jpeg_segments(bitstream);
+    REQUIRE(segments.size() >= 2);
+    REQUIRE(segments[0].marker == 0xE0);
+
+    if (orientation == heif_orientation_normal) {
+      REQUIRE(get_exif_orientation(bitstream) == 0);
+    }
+    else {
+      REQUIRE(is_exif_segment(bitstream, segments[1]));
+      REQUIRE(get_exif_orientation(bitstream) == orientation);
+    }
+  }
+}
+
+
+TEST_CASE("JPEG bitstream with Exif segment, without JFIF segment and with clean aperture")
+{
+  std::vector<uint8_t> file = encode_jpeg_file(heif_orientation_normal);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory(ctx, file.data(), file.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_item_id primary_id;
+  err = heif_context_get_primary_image_ID(ctx, &primary_id);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> jpeg;
+  err = get_jpeg_bitstream(ctx, primary_id, jpeg);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<JpegSegment> segments = get_jpeg_segments(jpeg);
+  REQUIRE(segments[0].marker == 0xE0);
+  const size_t jfif_end = segments[0].pos + 2 + segments[0].length;
+
+  // Little endian Exif with a 'Make' tag followed by the orientation tag (rotate 90 cw).
+  const std::vector<uint8_t> exif = {
+      0xFF, 0xE1, 0, 46,
+      'E', 'x', 'i', 'f', 0, 0,
+      'I', 'I', 42, 0, 8, 0, 0, 0,
+      2, 0,
+      0x0F, 0x01, 2, 0, 4, 0, 0, 0, 'a', 'b', 'c', 0,
+      0x12, 0x01, 3, 0, 1, 0, 0, 0, 6, 0, 0, 0,
+      0, 0, 0, 0
+  };
+
+  std::vector<uint8_t> jpeg_with_exif(jpeg.begin(), jpeg.begin() + jfif_end);
+  jpeg_with_exif.insert(jpeg_with_exif.end(), exif.begin(), exif.end());
+  jpeg_with_exif.insert(jpeg_with_exif.end(), jpeg.begin() + jfif_end, jpeg.end());
+
+  std::vector<uint8_t> jpeg_without_jfif = {0xFF, 0xD8};
+  jpeg_without_jfif.insert(jpeg_without_jfif.end(), jpeg.begin() + jfif_end, jpeg.end());
+
+  heif_item_id rotated_exif_id = add_jpeg_item(ctx, jpeg_with_exif, 90, false);
+  heif_item_id unrotated_exif_id = add_jpeg_item(ctx, jpeg_with_exif, 0, false);
+  heif_item_id no_jfif_id = add_jpeg_item(ctx, jpeg_without_jfif, 180, false);
+  heif_item_id clap_id = add_jpeg_item(ctx, jpeg, 0, true);
+
+  std::vector<uint8_t> rewritten;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_write(ctx, &writer, &rewritten);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, rewritten.data(), rewritten.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> bitstream;
+
+  SECTION("the existing orientation tag is overwritten") {
+    err = get_jpeg_bitstream(ctx, rotated_exif_id, bitstream);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(get_exif_orientation(bitstream) == heif_orientation_rotate_270_cw);
+
+    // Only the orientation value is changed.
+    REQUIRE(bitstream.size() == jpeg_with_exif.size());
+    size_t orientation_pos = jfif_end + 4 + 6 + 8 + 2 + 12 + 8;
+    bitstream[orientation_pos] = jpeg_with_exif[orientation_pos];
+    REQUIRE(bitstream == jpeg_with_exif);
+
+    err = get_jpeg_bitstream(ctx, unrotated_exif_id, bitstream);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(get_exif_orientation(bitstream) == heif_orientation_normal);
+  }
+
+  SECTION("an Exif segment is inserted after SOI if there is no JFIF segment") {
+    err = get_jpeg_bitstream(ctx, no_jfif_id, bitstream);
+    REQUIRE(err.code == heif_error_Ok);
+
+    segments = get_jpeg_segments(bitstream);
+    REQUIRE(segments[0].pos == 2);
+    REQUIRE(is_exif_segment(bitstream, segments[0]));
+    REQUIRE(get_exif_orientation(bitstream) == heif_orientation_rotate_180);
+  }
+
+  SECTION("images with clean aperture are rejected") {
+    err = get_jpeg_bitstream(ctx, clap_id, bitstream);
+    REQUIRE(err.code == heif_error_Unsupported_feature);
+  }
+
+  heif_context_free(ctx);
+}
@@ -37,6 +37,7 @@
 #include "test_utils.h"
 #include "test-config.h"
 #include <file_layout.h>
+#include "libheif/heif_items.h"
 
 TEST_CASE("mini")
 {
@@ -272,3 +273,139 @@ TEST_CASE("check heif mini")
                         "main_item_data offset: 144, size: 4582\n");
 }
 
+
+class RangeCountingReader : public StreamReader_memory
+{
+public:
+  using StreamReader_memory::StreamReader_memory;
+
+  uint64_t request_range(uint64_t start, uint64_t end_pos) override
+  {
+    requested_ends.push_back(end_pos);
+    return StreamReader_memory::request_range(start, end_pos);
+  }
+
+  std::vector<uint64_t> requested_ends;
+};
+
+
+TEST_CASE("mini file does not request data beyond the mini box")
+{
+  std::ifstream istr(tests_data_directory + "/lightning_mini.heif", std::ios::binary);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+  REQUIRE(data.size() > 1024);
+
+  auto reader = std::make_shared<RangeCountingReader>(data.data(), data.size(), false);
+  FileLayout file;
+  Error err = file.read(reader, heif_get_global_security_limits());
+  REQUIRE(err.error_code == heif_error_Ok);
+  REQUIRE(file.get_mini_box() != nullptr);
+
+  // The memory reader already provides the whole 'mini' box with the initial request.
+  // No further request for boxes after the 'mini' box should follow.
+  REQUIRE(reader->requested_ends.size() == 1);
+}
+
+
+static std::shared_ptr<FileLayout> read_file_layout(const std::vector<uint8_t>& data)
+{
+  auto reader = std::make_shared<StreamReader_memory>(data.data(), data.size(), true);
+  auto file = std::make_shared<FileLayout>();
+  Error err = file->read(reader, heif_get_global_security_limits());
+  REQUIRE(err.error_code == heif_error_Ok);
+  return file;
+}
+
+
+TEST_CASE("write mini file")
+{
+  auto filename = GENERATE("lightning_mini.heif", "simple_osm_tile_alpha.avif", "simple_osm_tile_meta.avif");
+
+  std::ifstream istr(tests_data_directory + "/" + filename, std::ios::binary);
+  std::vector<uint8_t> input((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, input.data(), input.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> meta_data;
+  heif_writer writer{1, write_to_vector};
+  REQUIRE(heif_context_write(ctx, &writer, &meta_data).code == heif_error_Ok);
+
+  heif_context_set_write_mini_format(ctx, 1);
+
+  std::vector<uint8_t> mini_data;
+  REQUIRE(heif_context_write(ctx, &writer, &mini_data).code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  REQUIRE(read_file_layout(meta_data)->get_meta_box() != nullptr);
+  REQUIRE(mini_data.size() < meta_data.size());
+
+  // The written 'mini' box describes the same image as the input file.
+
+  auto written = read_file_layout(mini_data);
+  REQUIRE(written->get_ftyp_box()->get_major_brand() == heif_brand2_mif3);
+  REQUIRE(written->get_meta_box() == nullptr);
+  REQUIRE(written->get_mini_box() != nullptr);
+
+  Indent indent;
+  REQUIRE(written->get_mini_box()->dump(indent) == read_file_layout(input)->get_mini_box()->dump(indent));
+
+  // Compare the coded data of the items.
+
+  heif_context* input_ctx = heif_context_alloc();
+  REQUIRE(heif_context_read_from_memory_without_copy(input_ctx, input.data(), input.size(), nullptr).code == heif_error_Ok);
+  heif_context* mini_ctx = heif_context_alloc();
+  REQUIRE(heif_context_read_from_memory_without_copy(mini_ctx, mini_data.data(), mini_data.size(), nullptr).code == heif_error_Ok);
+
+  int num_items = heif_context_get_number_of_items(input_ctx);
+  REQUIRE(heif_context_get_number_of_items(mini_ctx) == num_items);
+
+  std::vector<heif_item_id> ids(num_items);
+  heif_context_get_list_of_item_IDs(input_ctx, ids.data(), num_items);
+
+  for (heif_item_id id : ids) {
+    uint8_t* input_item = nullptr;
+    size_t input_size = 0;
+    REQUIRE(heif_item_get_item_data(input_ctx, id, nullptr, &input_item, &input_size).code == heif_error_Ok);
+
+    uint8_t* mini_item = nullptr;
+    size_t mini_size = 0;
+    REQUIRE(heif_item_get_item_data(mini_ctx, id, nullptr, &mini_item, &mini_size).code == heif_error_Ok);
+
+    REQUIRE(std::vector<uint8_t>(input_item, input_item + input_size) == std::vector<uint8_t>(mini_item, mini_item + mini_size));
+
+    heif_release_item_data(input_ctx, &input_item);
+    heif_release_item_data(mini_ctx, &mini_item);
+  }
+
+  heif_context_free(input_ctx);
+  heif_context_free(mini_ctx);
+}
+
+
+TEST_CASE("write mini file falls back to meta box")
+{
+  heif_image* img = nullptr;
+  REQUIRE(heif_image_create(16, 16, heif_colorspace_RGB, heif_chroma_interleaved_RGB, &img).code == heif_error_Ok);
+  REQUIRE(heif_image_add_plane(img, heif_channel_interleaved, 16, 16, 8).code == heif_error_Ok);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder = nullptr;
+  REQUIRE(heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder).code == heif_error_Ok);
+  REQUIRE(heif_context_encode_image(ctx, img, encoder, nullptr, nullptr).code == heif_error_Ok);
+  heif_encoder_release(encoder);
+  heif_image_release(img);
+
+  // 'unci' images cannot be stored in a 'mini' box
+  heif_context_set_write_mini_format(ctx, 1);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  REQUIRE(heif_context_write(ctx, &writer, &data).code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  auto written = read_file_layout(data);
+  REQUIRE(written->get_meta_box() != nullptr);
+  REQUIRE(written->get_mini_box() == nullptr);
+}
@@ -0,0 +1,232 @@
+/*
+  libheif unit tests for decoding overlay images
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <cstdint>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Decode overlay layers in parallel and in their native format")
+{
+  const int layer_width = 40, layer_height = 30;
+  const int canvas_width = 100, canvas_height = 80;
+  std::vector<int32_t> offsets {0, 0, 30, 20, -10, -6, 76, 60, 20, 70, 50, 10};
+  const int num_layers = static_cast<int>(offsets.size() / 2);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<heif_item_id> layer_ids;
+
+  for (int i = 0; i < num_layers; i++) {
+    heif_image* layer;
+    err = heif_image_create(layer_width, layer_height, heif_colorspace_YCbCr, heif_chroma_420, &layer);
+    REQUIRE(err.code == heif_error_Ok);
+
+    for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+      int w = (channel == heif_channel_Y ? layer_width : layer_width / 2);
+      int h = (channel == heif_channel_Y ? layer_height : layer_height / 2);
+
+      err = heif_image_add_plane(layer, channel, w, h, 8);
+      REQUIRE(err.code == heif_error_Ok);
+
+      int stride;
+      uint8_t* p = heif_image_get_plane(layer, channel, &stride);
+      for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+          p[y * stride + x] = overlay_layer_value(channel, x, y, i);
+        }
+      }
+    }
+
+    heif_image_handle* handle;
+    err = heif_context_encode_image(ctx, layer, encoder, nullptr, &handle);
+    REQUIRE(err.code == heif_error_Ok);
+    layer_ids.push_back(heif_image_handle_get_item_id(handle));
+
+    heif_image_handle_release(handle);
+    heif_image_release(layer);
+  }
+
+  const uint16_t background[4] = {0x8000, 0x8000, 0x8000, 0xFFFF};
+  heif_image_handle* iovl;
+  err = heif_context_add_overlay_image(ctx, canvas_width, canvas_height, static_cast<uint16_t>(num_layers),
+                                       layer_ids.data(), offsets.data(), background, &iovl);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_set_primary_image(ctx, iovl);
+  heif_image_handle_release(iovl);
+
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+
+  std::vector<uint8_t> file_data;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  std::vector<std::vector<uint8_t>> sequential = decode_primary_image_ycbcr420(file_data, 0);
+  REQUIRE(decode_primary_image_ycbcr420(file_data, 4) == sequential);
+
+  // --- the layers are pasted in the given order without a detour through RGB
+
+  int plane_index = 0;
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    int sub = (channel == heif_channel_Y ? 1 : 2);
+    int plane_width = canvas_width / sub;
+
+    for (int y = 0; y < canvas_height / sub; y++) {
+      for (int x = 0; x < plane_width; x++) {
+        int top_layer = -1;
+        for (int i = 0; i < num_layers; i++) {
+          int lx = x - offsets[2 * i] / sub, ly = y - offsets[2 * i + 1] / sub;
+          if (lx >= 0 && lx < layer_width / sub && ly >= 0 && ly < layer_height / sub) {
+            top_layer = i;
+          }
+        }
+
+        if (top_layer >= 0) {
+          INFO(channel << ": " << x << ";" << y);
+          REQUIRE(sequential[plane_index][y * plane_width + x] ==
+                  overlay_layer_value(channel, x - offsets[2 * top_layer] / sub, y - offsets[2 * top_layer + 1] / sub, top_layer));
+        }
+      }
+    }
+
+    plane_index++;
+  }
+}
+
+
+TEST_CASE("Composite overlay layers with alpha")
+{
+  const int layer_width = 48, layer_height = 20;
+  const int canvas_width = 80, canvas_height = 40;
+  int32_t offsets[2] = {10, 5};
+
+  heif_image* layer;
+  heif_error err = heif_image_create(layer_width, layer_height, heif_colorspace_RGB, heif_chroma_444, &layer);
+  REQUIRE(err.code == heif_error_Ok);
+
+  auto layer_value = [](heif_channel channel, int x, int y) -> uint8_t {
+    switch (channel) {
+      case heif_channel_R:
+        return static_cast<uint8_t>(x * 5);
+      case heif_channel_G:
+        return static_cast<uint8_t>(y * 7);
+      case heif_channel_B:
+        return 200;
+      default:
+        // transparent at the left border, opaque in the last column
+        return static_cast<uint8_t>(x < 4 ? 0 : (x == layer_width - 1 ? 255 : x * 5 + y * 3));
+    }
+  };
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B, heif_channel_Alpha}) {
+    err = heif_image_add_plane(layer, channel, layer_width, layer_height, 8);
+    REQUIRE(err.code == heif_error_Ok);
+
+    int stride;
+    uint8_t* p = heif_image_get_plane(layer, channel, &stride);
+    for (int y = 0; y < layer_height; y++) {
+      for (int x = 0; x < layer_width; x++) {
+        p[y * stride + x] = layer_value(channel, x, y);
+      }
+    }
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder;
+  err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* layer_handle;
+  err = heif_context_encode_image(ctx, layer, encoder, nullptr, &layer_handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_item_id layer_id = heif_image_handle_get_item_id(layer_handle);
+  heif_image_handle_release(layer_handle);
+  heif_image_release(layer);
+  heif_encoder_release(encoder);
+
+  const uint16_t background[4] = {0x4000, 0x8000, 0xC000, 0xFFFF};
+  heif_image_handle* iovl;
+  err = heif_context_add_overlay_image(ctx, canvas_width, canvas_height, 1, &layer_id, offsets, background, &iovl);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_set_primary_image(ctx, iovl);
+  heif_image_handle_release(iovl);
+
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+
+  std::vector<uint8_t> file_data;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(!heif_image_has_channel(img, heif_channel_Alpha));
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    int bkg = background[channel - heif_channel_R] >> 8;
+
+    int stride;
+    const uint8_t* p = heif_image_get_plane_readonly(img, channel, &stride);
+    for (int y = 0; y < canvas_height; y++) {
+      for (int x = 0; x < canvas_width; x++) {
+        int lx = x - offsets[0], ly = y - offsets[1];
+        int expected = bkg;
+        if (lx >= 0 && lx < layer_width && ly >= 0 && ly < layer_height) {
+          int a = layer_value(heif_channel_Alpha, lx, ly);
+          expected = (layer_value(channel, lx, ly) * a + bkg * (255 - a) + 127) / 255;
+        }
+
+        INFO(channel << ": " << x << ";" << y);
+        REQUIRE(p[y * stride + x] == expected);
+      }
+    }
+  }
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
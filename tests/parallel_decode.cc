@@ -0,0 +1,328 @@
+/*
+  libheif unit tests for decoding several images in parallel
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_experimental.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Decode several images in parallel")
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* inputs[2] = {create_gradient_image(64, 48, 1), createImage_Mono()};
+  for (heif_image* input : inputs) {
+    err = heif_context_encode_image(ctx, input, encoder, nullptr, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_image_release(input);
+  }
+  heif_encoder_release(encoder);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_item_id ids[2];
+  REQUIRE(heif_context_get_list_of_top_level_image_IDs(ctx, ids, 2) == 2);
+
+  const heif_image_handle* handles[2];
+  for (int i = 0; i < 2; i++) {
+    heif_image_handle* handle;
+    REQUIRE(heif_context_get_image_handle(ctx, ids[i], &handle).code == heif_error_Ok);
+    handles[i] = handle;
+  }
+
+  heif_colorspace colorspaces[2] = {heif_colorspace_RGB, heif_colorspace_monochrome};
+  heif_chroma chromas[2] = {heif_chroma_interleaved_RGB, heif_chroma_monochrome};
+  heif_image* images[2];
+  heif_error errors[2];
+  err = heif_decode_images(handles, 2, colorspaces, chromas, nullptr, images, errors);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int i = 0; i < 2; i++) {
+    REQUIRE(errors[i].code == heif_error_Ok);
+    REQUIRE(images[i] != nullptr);
+
+    heif_image* expected;
+    err = heif_decode_image(handles[i], &expected, colorspaces[i], chromas[i], nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_channel channel = (i == 0 ? heif_channel_interleaved : heif_channel_Y);
+    size_t stride, expected_stride;
+    const uint8_t* p = heif_image_get_plane_readonly2(images[i], channel, &stride);
+    const uint8_t* q = heif_image_get_plane_readonly2(expected, channel, &expected_stride);
+    int width = heif_image_get_width(images[i], channel) * (i == 0 ? 3 : 1);
+    int height = heif_image_get_height(images[i], channel);
+    for (int y = 0; y < height; y++) {
+      REQUIRE(memcmp(p + y * stride, q + y * expected_stride, width) == 0);
+    }
+
+    heif_image_release(expected);
+    heif_image_release(images[i]);
+  }
+
+  REQUIRE(heif_decode_images(handles, -1, colorspaces, chromas, nullptr, images, errors).code == heif_error_Usage_error);
+  REQUIRE(heif_decode_images(handles, 2, colorspaces, nullptr, nullptr, images, errors).code == heif_error_Usage_error);
+
+  for (const heif_image_handle* handle : handles) {
+    heif_image_handle_release(handle);
+  }
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Batch decoding of images in memory")
+{
+  std::vector<std::vector<uint8_t>> files;
+
+  for (int i = 0; i < 5; i++) {
+    heif_image* img = create_gradient_image(20 + i * 7, 10 + i * 3, i * 50);
+
+    heif_context* ctx = heif_context_alloc();
+    heif_encoder* encoder;
+    heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+    REQUIRE(err.code == heif_error_Ok);
+    err = heif_context_encode_image(ctx, img, encoder, nullptr, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_encoder_release(encoder);
+    heif_image_release(img);
+
+    std::vector<uint8_t> file_data;
+    heif_writer writer{1, write_to_vector};
+    err = heif_context_write(ctx, &writer, &file_data);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_context_free(ctx);
+
+    files.push_back(std::move(file_data));
+  }
+
+  // an input that cannot be decoded
+  files.push_back(std::vector<uint8_t>(100, 0));
+
+  std::vector<const void*> data;
+  std::vector<size_t> sizes;
+  for (const auto& file : files) {
+    data.push_back(file.data());
+    sizes.push_back(file.size());
+  }
+
+  std::vector<heif_image*> images(files.size());
+  std::vector<heif_error> errors(files.size());
+  heif_error err = heif_decode_images_from_memory(data.data(), sizes.data(), (int) files.size(),
+                                                  heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                                  images.data(), errors.data());
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (size_t i = 0; i < files.size() - 1; i++) {
+    REQUIRE(errors[i].code == heif_error_Ok);
+    REQUIRE(images[i] != nullptr);
+
+    heif_context* ctx = heif_context_alloc();
+    err = heif_context_read_from_memory_without_copy(ctx, files[i].data(), files[i].size(), nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    int w = heif_image_get_width(images[i], heif_channel_interleaved);
+    int h = heif_image_get_height(images[i], heif_channel_interleaved);
+    REQUIRE(get_interleaved_pixels(images[i], 0, 0, w, h) == decode_primary_image(ctx));
+
+    heif_context_free(ctx);
+    heif_image_release(images[i]);
+  }
+
+  REQUIRE(errors.back().code == heif_error_Invalid_input);
+  REQUIRE(errors.back().message != nullptr);
+  REQUIRE(images.back() == nullptr);
+}
+
+
+TEST_CASE("Decode the source of several derived images once")
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* image = create_gradient_image(40, 30, 0);
+
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, image, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_item_id source_id = heif_image_handle_get_item_id(handle);
+  heif_image_handle_release(handle);
+  heif_image_release(image);
+
+  // two overlays that place the same image at different positions
+
+  std::vector<heif_item_id> overlay_ids;
+  for (int32_t offset : {0, 10}) {
+    int32_t offsets[2] = {offset, offset};
+    const uint16_t background[4] = {0, 0, 0, 0xFFFF};
+
+    heif_image_handle* iovl;
+    err = heif_context_add_overlay_image(ctx, 60, 50, 1, &source_id, offsets, background, &iovl);
+    REQUIRE(err.code == heif_error_Ok);
+    overlay_ids.push_back(heif_image_handle_get_item_id(iovl));
+    heif_context_set_primary_image(ctx, iovl);
+    heif_image_handle_release(iovl);
+  }
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  options->statistics = heif_decoding_statistics_alloc();
+
+  auto decode = [&](heif_item_id id) {
+    heif_image_handle* h;
+    heif_error e = heif_context_get_image_handle(ctx, id, &h);
+    REQUIRE(e.code == heif_error_Ok);
+
+    heif_image* img;
+    e = heif_decode_image(h, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, options);
+    REQUIRE(e.code == heif_error_Ok);
+    std::vector<uint8_t> pixels = get_interleaved_pixels(img, 0, 0, 60, 50);
+
+    heif_image_release(img);
+    heif_image_handle_release(h);
+    return pixels;
+  };
+
+  std::vector<uint8_t> first = decode(overlay_ids[0]);
+  std::vector<uint8_t> second = decode(overlay_ids[1]);
+  REQUIRE(options->statistics->num_codec_decodes == 1);
+
+  // the same pixels without the cache
+
+  heif_context_set_derived_image_source_cache_size(ctx, 0);
+  REQUIRE(decode(overlay_ids[0]) == first);
+  REQUIRE(decode(overlay_ids[1]) == second);
+  REQUIRE(options->statistics->num_codec_decodes == 3);
+
+  heif_decoding_statistics_free(options->statistics);
+  heif_decoding_options_free(options);
+  heif_context_free(ctx);
+}
+
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+TEST_CASE("Decode all images of an entity group")
+{
+  heif_image* image = create_gradient_image(400, 300, 0);
+
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_entity_group_id group_id;
+  err = heif_context_encode_pyramid(ctx, image, 128, 128, encoder, nullptr, nullptr, &group_id);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_encoder_release(encoder);
+  heif_image_release(image);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* images[4];
+  heif_item_id item_ids[4];
+  heif_error errors[4];
+  int num_images;
+
+  err = heif_context_decode_entity_group(ctx, group_id, heif_colorspace_RGB, heif_chroma_444, nullptr, 0, 0,
+                                         images, item_ids, errors, 4, &num_images);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(num_images == 3);
+
+  const int widths[3] = {100, 200, 400};
+  for (int i = 0; i < num_images; i++) {
+    REQUIRE(errors[i].code == heif_error_Ok);
+    REQUIRE(images[i] != nullptr);
+    REQUIRE(heif_image_get_primary_width(images[i]) == widths[i]);
+    heif_image_release(images[i]);
+  }
+
+  // previews are decoded from the smallest layer
+
+  err = heif_context_decode_entity_group(ctx, group_id, heif_colorspace_RGB, heif_chroma_444, nullptr, 50, 50,
+                                         images, nullptr, nullptr, 2, &num_images);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(num_images == 2);
+
+  for (int i = 0; i < num_images; i++) {
+    REQUIRE(images[i] != nullptr);
+    REQUIRE(heif_image_get_primary_width(images[i]) == 50);
+    REQUIRE(heif_image_get_primary_height(images[i]) == 37);
+    heif_image_release(images[i]);
+  }
+
+  err = heif_context_decode_entity_group(ctx, group_id + 100, heif_colorspace_RGB, heif_chroma_444, nullptr, 0, 0,
+                                         images, nullptr, nullptr, 4, &num_images);
+  REQUIRE(err.code != heif_error_Ok);
+  REQUIRE(num_images == 0);
+
+  heif_context_free(ctx);
+}
+
+#endif
@@ -0,0 +1,378 @@
+/*
+  libheif unit tests
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// Performance regression tests. They are only built with WITH_PERFORMANCE_TESTS=ON (see tests/CMakeLists.txt).
+// Each workload is run several times and the fastest run is compared against the baseline file.
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_items.h"
+#include "libheif/heif_properties.h"
+#include "color-conversion/colorconversion.h"
+#include "pixelimage.h"
+#include "test_utils.h"
+#include "test-config.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// --- baseline handling
+
+class PerformanceBaseline
+{
+public:
+  PerformanceBaseline()
+  {
+    if (const char* path = getenv("LIBHEIF_PERFORMANCE_BASELINE")) {
+      m_path = path;
+    }
+
+    if (const char* tolerance = getenv("LIBHEIF_PERFORMANCE_TOLERANCE")) {
+      m_tolerance = atof(tolerance);
+    }
+
+    const char* update = getenv("LIBHEIF_PERFORMANCE_UPDATE_BASELINE");
+    m_update = (update && strcmp(update, "0") != 0);
+
+    std::ifstream istr(m_path);
+    std::string name;
+    double seconds;
+    while (istr >> name >> seconds) {
+      m_times[name] = seconds;
+    }
+  }
+
+  // Returns the baseline time. When there is none, 'seconds' is stored as the new baseline and returned.
+  double check_in(const std::string& name, double seconds)
+  {
+    auto iter = m_times.find(name);
+    if (iter != m_times.end() && !m_update) {
+      return iter->second;
+    }
+
+    m_times[name] = seconds;
+
+    std::ofstream ostr(m_path);
+    for (const auto& [entry_name, entry_seconds] : m_times) {
+      ostr << entry_name << " " << entry_seconds << "\n";
+    }
+
+    return seconds;
+  }
+
+  double tolerance() const { return m_tolerance; }
+
+private:
+  std::string m_path = "performance_baseline.txt";
+  double m_tolerance = 0.25;
+  bool m_update = false;
+  std::map<std::string, double> m_times;
+};
+
+
+static void check_performance(const std::string& name, int num_runs, const std::function<void()>& workload)
+{
+  static PerformanceBaseline baseline;
+
+  // warm up caches and the thread pool
+  workload();
+
+  double fastest = 0;
+  for (int i = 0; i < num_runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    workload();
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    if (i == 0 || duration.count() < fastest) {
+      fastest = duration.count();
+    }
+  }
+
+  double reference = baseline.check_in(name, fastest);
+
+  std::cout << name << ": " << fastest * 1000.0 << " ms (baseline " << reference * 1000.0 << " ms)\n";
+
+  INFO(name << ": " << fastest * 1000.0 << " ms, baseline " << reference * 1000.0 << " ms");
+  CHECK(fastest <= reference * (1.0 + baseline.tolerance()));
+}
+
+
+// --- color conversion
+
+static std::shared_ptr<HeifPixelImage> create_test_image(uint32_t width, uint32_t height,
+                                                         heif_colorspace colorspace, heif_chroma chroma, int bpp)
+{
+  auto img = std::make_shared<HeifPixelImage>();
+  img->create(width, height, colorspace, chroma);
+
+  std::vector<heif_channel> channels;
+  if (colorspace == heif_colorspace_YCbCr) {
+    channels = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+  }
+  else if (chroma == heif_chroma_444) {
+    channels = {heif_channel_R, heif_channel_G, heif_channel_B};
+  }
+  else {
+    channels = {heif_channel_interleaved};
+  }
+
+  uint32_t seed = 1;
+
+  for (heif_channel channel : channels) {
+    uint32_t w = width;
+    uint32_t h = height;
+    if (channel == heif_channel_Cb || channel == heif_channel_Cr) {
+      w = (chroma == heif_chroma_444 ? width : (width + 1) / 2);
+      h = (chroma == heif_chroma_420 ? (height + 1) / 2 : height);
+    }
+
+    REQUIRE(!img->add_plane(channel, w, h, bpp, nullptr));
+
+    size_t stride;
+    uint8_t* p = img->get_plane(channel, &stride);
+
+    for (uint32_t y = 0; y < h; y++) {
+      for (size_t x = 0; x < stride; x++) {
+        seed = seed * 1103515245 + 12345;
+        p[y * stride + x] = (uint8_t) (seed >> 16);
+      }
+
+      if (bpp > 8 && bpp < 16) {
+        // keep the samples within the bit depth
+        auto* p16 = reinterpret_cast<uint16_t*>(p + y * stride);
+        for (size_t x = 0; x < stride / 2; x++) {
+          p16[x] &= (uint16_t) ((1 << bpp) - 1);
+        }
+      }
+    }
+  }
+
+  return img;
+}
+
+
+TEST_CASE("Performance: color conversion", "[performance]")
+{
+  const uint32_t size = 1024;
+
+  heif_color_conversion_options options{};
+  options.version = 1;
+  options.preferred_chroma_downsampling_algorithm = heif_chroma_downsampling_average;
+  options.preferred_chroma_upsampling_algorithm = heif_chroma_upsampling_bilinear;
+  options.only_use_preferred_chroma_algorithm = false;
+
+  for (heif_chroma chroma : {heif_chroma_420, heif_chroma_422, heif_chroma_444}) {
+    for (int bpp : {8, 10}) {
+      heif_chroma rgb_chroma = (bpp == 8 ? heif_chroma_interleaved_RGB : heif_chroma_interleaved_RRGGBB_LE);
+      std::string suffix = std::string(chroma == heif_chroma_420 ? "420" : chroma == heif_chroma_422 ? "422" : "444") +
+                           "_" + std::to_string(bpp) + "bit";
+
+      auto ycbcr = create_test_image(size, size, heif_colorspace_YCbCr, chroma, bpp);
+      check_performance("conversion_YCbCr" + suffix + "_to_RGB", 5, [&]() {
+        auto result = convert_colorspace(ycbcr, heif_colorspace_RGB, rgb_chroma, nullptr, bpp, options, nullptr,
+                                         heif_get_disabled_security_limits());
+        REQUIRE(result);
+      });
+
+      auto rgb = create_test_image(size, size, heif_colorspace_RGB, rgb_chroma, bpp);
+      check_performance("conversion_RGB_to_YCbCr" + suffix, 5, [&]() {
+        auto result = convert_colorspace(rgb, heif_colorspace_YCbCr, chroma, nullptr, bpp, options, nullptr,
+                                         heif_get_disabled_security_limits());
+        REQUIRE(result);
+      });
+    }
+  }
+}
+
+
+// --- decoding from memory
+
+static std::vector<uint8_t> read_test_file(const std::string& filename)
+{
+  std::ifstream istr(tests_data_directory + "/" + filename, std::ios::binary);
+  REQUIRE(istr);
+  return {std::istreambuf_iterator<char>(istr), std::istreambuf_iterator<char>()};
+}
+
+
+static heif_context* read_from_memory(const std::vector<uint8_t>& data)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  return ctx;
+}
+
+
+static void decode_primary_image(heif_context* ctx, heif_colorspace colorspace, heif_chroma chroma)
+{
+  heif_image_handle* handle;
+  heif_error err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, colorspace, chroma, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+}
+
+
+TEST_CASE("Performance: unci decoding", "[performance]")
+{
+  // The test images are small. Each run decodes them many times, which includes parsing the file.
+
+  for (const char* interleave : {"comp", "pix", "row", "mix"}) {
+    const char* image = (strcmp(interleave, "mix") == 0 ? "YUV_420" : "RGB");
+    std::string filename = std::string("uncompressed_") + interleave + "_" + image + ".heif";
+    std::vector<uint8_t> data = read_test_file(filename);
+
+    check_performance(std::string("unci_decode_") + interleave + "_" + image, 5, [&]() {
+      for (int i = 0; i < 200; i++) {
+        heif_context* ctx = read_from_memory(data);
+        decode_primary_image(ctx, heif_colorspace_undefined, heif_chroma_undefined);
+        heif_context_free(ctx);
+      }
+    });
+  }
+}
+
+
+// --- box parsing
+
+static std::vector<uint8_t> write_to_memory(heif_context* ctx)
+{
+  std::vector<uint8_t> data;
+
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = [](heif_context*, const void* chunk, size_t size, void* userdata) {
+    auto* out = static_cast<std::vector<uint8_t>*>(userdata);
+    out->insert(out->end(), static_cast<const uint8_t*>(chunk), static_cast<const uint8_t*>(chunk) + size);
+    return heif_error_success;
+  };
+
+  heif_error err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  return data;
+}
+
+
+TEST_CASE("Performance: parsing large ipma and iloc boxes", "[performance]")
+{
+  const int num_items = 20000;
+
+  // Each item has its own data ('iloc' entry) and its own property ('ipma' entry).
+  // A small primary image is added so that the file gets its brands.
+
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder = get_encoder_or_skip_test(heif_compression_uncompressed);
+  heif_image* img;
+  REQUIRE(heif_image_create(16, 16, heif_colorspace_monochrome, heif_chroma_monochrome, &img).code == heif_error_Ok);
+  fill_new_plane(img, heif_channel_Y, 16, 16);
+  REQUIRE(heif_context_encode_image(ctx, img, encoder, nullptr, nullptr).code == heif_error_Ok);
+  heif_image_release(img);
+  heif_encoder_release(encoder);
+
+  for (int i = 0; i < num_items; i++) {
+    uint8_t item_data[4] = {(uint8_t) (i >> 24), (uint8_t) (i >> 16), (uint8_t) (i >> 8), (uint8_t) i};
+    heif_item_id id;
+    heif_error err = heif_context_add_item(ctx, "test", item_data, sizeof(item_data), &id);
+    REQUIRE(err.code == heif_error_Ok);
+
+    err = heif_item_add_raw_property(ctx, id, heif_fourcc('t', 'e', 's', 't'), nullptr, item_data, sizeof(item_data),
+                                     0, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+
+  std::vector<uint8_t> data = write_to_memory(ctx);
+  heif_context_free(ctx);
+
+  check_performance("parse_ipma_iloc_20000_items", 5, [&]() {
+    heif_context* parsed = heif_context_alloc();
+    heif_context_set_security_limits(parsed, heif_get_disabled_security_limits()); // the default limit is 1000 items
+    heif_error err = heif_context_read_from_memory_without_copy(parsed, data.data(), data.size(), nullptr);
+    INFO(err.message);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_context_free(parsed);
+  });
+}
+
+
+// --- grid decoding
+
+TEST_CASE("Performance: grid decoding", "[performance]")
+{
+  const uint32_t tile_size = 128;
+  const uint16_t tiles_per_row = 8;
+
+  heif_encoder* encoder = get_encoder_or_skip_test(heif_compression_uncompressed);
+
+  std::vector<heif_image*> tiles;
+  for (int i = 0; i < tiles_per_row * tiles_per_row; i++) {
+    heif_image* tile;
+    REQUIRE(heif_image_create(tile_size, tile_size, heif_colorspace_YCbCr, heif_chroma_420, &tile).code == heif_error_Ok);
+    fill_new_plane(tile, heif_channel_Y, tile_size, tile_size);
+    fill_new_plane(tile, heif_channel_Cb, tile_size / 2, tile_size / 2);
+    fill_new_plane(tile, heif_channel_Cr, tile_size / 2, tile_size / 2);
+    tiles.push_back(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_encode_grid(ctx, tiles.data(), tiles_per_row, tiles_per_row, encoder, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> data = write_to_memory(ctx);
+  heif_context_free(ctx);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+  heif_encoder_release(encoder);
+
+  for (int threads : {1, 2, 4, 8}) {
+    heif_context* grid_ctx = read_from_memory(data);
+    heif_context_set_max_decoding_threads(grid_ctx, threads);
+
+    check_performance("grid_decode_to_RGB_" + std::to_string(threads) + "_threads", 5, [&]() {
+      decode_primary_image(grid_ctx, heif_colorspace_RGB, heif_chroma_interleaved_RGB);
+    });
+
+    heif_context_free(grid_ctx);
+  }
+}
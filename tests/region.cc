@@ -586,3 +586,301 @@ TEST_CASE("create inline mask region from image") {
   heif_image_handle_release(readbackHandle);
   heif_context_free(readbackCtx);
 }
+
+static std::vector<heif_region_type> get_region_types(heif_region** regions, int n)
+{
+  std::vector<heif_region_type> types;
+  for (int i = 0; i < n; i++) {
+    types.push_back(heif_region_get_type(regions[i]));
+  }
+  heif_region_release_many(regions, n);
+  return types;
+}
+
+TEST_CASE("query regions by rectangle and point") {
+  if (!heif_have_encoder_for_format(heif_compression_uncompressed)) {
+    SKIP("Skipping test because uncompressed codec is not compiled.");
+  }
+
+  heif_image* img;
+  heif_image_create(64, 64, heif_colorspace_monochrome, heif_chroma_monochrome, &img);
+  fill_new_plane(img, heif_channel_Y, 64, 64);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* enc;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &enc);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, img, enc, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_region_item* item;
+  err = heif_image_handle_add_region_item(handle, 1000, 1000, &item);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // region 0..3
+  REQUIRE(heif_region_item_add_region_rectangle(item, 100, 100, 50, 50, nullptr).code == heif_error_Ok);
+  REQUIRE(heif_region_item_add_region_ellipse(item, 500, 500, 100, 50, nullptr).code == heif_error_Ok);
+  int32_t triangle[6] = {800, 800, 900, 800, 800, 900};
+  REQUIRE(heif_region_item_add_region_polygon(item, triangle, 3, nullptr).code == heif_error_Ok);
+  uint8_t mask_data[2] = {0xF0, 0x00}; // 4x4 mask, only the first row is set
+  REQUIRE(heif_region_item_add_region_inline_mask_data(item, 10, 900, 4, 4, mask_data, sizeof(mask_data), nullptr).code == heif_error_Ok);
+
+  // many small regions to make the grid index non-trivial
+  for (int i = 0; i < 100; i++) {
+    REQUIRE(heif_region_item_add_region_point(item, 300 + i, 50, nullptr).code == heif_error_Ok);
+  }
+
+  int max = heif_region_item_get_number_of_regions(item);
+  std::vector<heif_region*> regions(max);
+
+  int n = heif_region_item_get_regions_in_rectangle(item, 0, 0, 200, 200, regions.data(), max);
+  REQUIRE(get_region_types(regions.data(), n) == std::vector<heif_region_type>{heif_region_type_rectangle});
+
+  n = heif_region_item_get_regions_in_rectangle(item, 390, 0, 20, 60, regions.data(), max);
+  REQUIRE(n == 10);
+  heif_region_release_many(regions.data(), n);
+
+  n = heif_region_item_get_regions_in_rectangle(item, 0, 0, 1000, 1000, regions.data(), max);
+  REQUIRE(n == max);
+  heif_region_release_many(regions.data(), n);
+
+  n = heif_region_item_get_regions_in_rectangle(item, 150, 150, 10, 10, regions.data(), max);
+  REQUIRE(n == 0);
+
+  // the bounding box of the ellipse contains this point, but the ellipse does not
+  n = heif_region_item_get_regions_at_point(item, 590, 540, regions.data(), max);
+  REQUIRE(n == 0);
+  n = heif_region_item_get_regions_at_point(item, 590, 500, regions.data(), max);
+  REQUIRE(get_region_types(regions.data(), n) == std::vector<heif_region_type>{heif_region_type_ellipse});
+
+  n = heif_region_item_get_regions_at_point(item, 820, 820, regions.data(), max);
+  REQUIRE(get_region_types(regions.data(), n) == std::vector<heif_region_type>{heif_region_type_polygon});
+  n = heif_region_item_get_regions_at_point(item, 880, 880, regions.data(), max);
+  REQUIRE(n == 0);
+
+  n = heif_region_item_get_regions_at_point(item, 12, 900, regions.data(), max);
+  REQUIRE(get_region_types(regions.data(), n) == std::vector<heif_region_type>{heif_region_type_inline_mask});
+  n = heif_region_item_get_regions_at_point(item, 12, 901, regions.data(), max);
+  REQUIRE(n == 0);
+
+  n = heif_region_item_get_regions_at_point(item, 350, 50, regions.data(), max);
+  REQUIRE(get_region_types(regions.data(), n) == std::vector<heif_region_type>{heif_region_type_point});
+
+  // adding a region updates the index
+  REQUIRE(heif_region_item_add_region_rectangle(item, 140, 140, 20, 20, nullptr).code == heif_error_Ok);
+  regions.resize(max + 1);
+  n = heif_region_item_get_regions_at_point(item, 145, 145, regions.data(), max + 1);
+  REQUIRE(n == 2);
+  heif_region_release_many(regions.data(), n);
+
+  heif_region_item_release(item);
+  heif_image_handle_release(handle);
+  heif_encoder_release(enc);
+  heif_context_free(ctx);
+  heif_image_release(img);
+}
+
+TEST_CASE("bulk add and get regions") {
+  if (!heif_have_encoder_for_format(heif_compression_uncompressed)) {
+    SKIP("Skipping test because uncompressed codec is not compiled.");
+  }
+
+  heif_image* img;
+  heif_image_create(64, 64, heif_colorspace_monochrome, heif_chroma_monochrome, &img);
+  fill_new_plane(img, heif_channel_Y, 64, 64);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* enc;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &enc);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, img, enc, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_region_item* item;
+  err = heif_image_handle_add_region_item(handle, 1000, 1000, &item);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<int32_t> rects;
+  for (int i = 0; i < 200; i++) {
+    rects.insert(rects.end(), {i * 4, 1000 - i * 4, 10 + i, 20});
+  }
+  REQUIRE(heif_region_item_add_region_rectangles(item, rects.data(), 200).code == heif_error_Ok);
+
+  int32_t pts[4] = {1, 2, -3, 40000};
+  REQUIRE(heif_region_item_add_region_points(item, pts, 2).code == heif_error_Ok);
+
+  int32_t polygon_pts[14] = {0, 0, 10, 0, 0, 10, 100, 100, 200, 100, 200, 200, 100, 200};
+  int polygon_sizes[2] = {3, 4};
+  REQUIRE(heif_region_item_add_region_polygons(item, polygon_pts, polygon_sizes, 2).code == heif_error_Ok);
+
+  int32_t negative_rect[4] = {0, 0, -1, 10};
+  REQUIRE(heif_region_item_add_region_rectangles(item, negative_rect, 1).code == heif_error_Usage_error);
+  REQUIRE(heif_region_item_add_region_points(item, pts, 100).code == heif_error_Usage_error);
+
+  REQUIRE(heif_region_item_get_number_of_regions(item) == 204);
+  REQUIRE(heif_region_item_get_number_of_regions_of_type(item, heif_region_type_rectangle) == 200);
+  REQUIRE(heif_region_item_get_number_of_regions_of_type(item, heif_region_type_point) == 2);
+  REQUIRE(heif_region_item_get_number_of_regions_of_type(item, heif_region_type_polygon) == 2);
+
+  std::vector<int32_t> out_rects(4 * 200);
+  REQUIRE(heif_region_item_get_region_rectangles(item, out_rects.data(), 200) == 200);
+  REQUIRE(out_rects == rects);
+
+  int32_t out_pts[4];
+  REQUIRE(heif_region_item_get_region_points(item, out_pts, 2) == 2);
+  REQUIRE(std::memcmp(out_pts, pts, sizeof(pts)) == 0);
+
+  int out_sizes[2];
+  REQUIRE(heif_region_item_get_region_polygons(item, out_sizes, nullptr, 2) == 2);
+  REQUIRE(out_sizes[0] == 3);
+  REQUIRE(out_sizes[1] == 4);
+  int32_t out_polygon_pts[14];
+  REQUIRE(heif_region_item_get_region_polygons(item, out_sizes, out_polygon_pts, 2) == 2);
+  REQUIRE(std::memcmp(out_polygon_pts, polygon_pts, sizeof(polygon_pts)) == 0);
+
+  // write and read back the file
+
+  heif_region_item_release(item);
+  heif_image_handle_release(handle);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, [](heif_context*, const void* d, size_t size, void* userdata) {
+    auto* out = (std::vector<uint8_t>*) userdata;
+    out->insert(out->end(), (const uint8_t*) d, (const uint8_t*) d + size);
+    return heif_error{heif_error_Ok, heif_suberror_Unspecified, "Success"};
+  }};
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_context* ctx2 = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx2, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(heif_context_get_primary_image_handle(ctx2, &handle).code == heif_error_Ok);
+  REQUIRE(heif_image_handle_get_number_of_region_items(handle) == 1);
+  heif_item_id region_item_id;
+  heif_image_handle_get_list_of_region_item_ids(handle, &region_item_id, 1);
+  REQUIRE(heif_context_get_region_item(ctx2, region_item_id, &item).code == heif_error_Ok);
+
+  REQUIRE(heif_region_item_get_number_of_regions(item) == 204);
+  std::fill(out_rects.begin(), out_rects.end(), 0);
+  REQUIRE(heif_region_item_get_region_rectangles(item, out_rects.data(), 200) == 200);
+  REQUIRE(out_rects == rects);
+  REQUIRE(heif_region_item_get_region_polygons(item, out_sizes, out_polygon_pts, 2) == 2);
+  REQUIRE(std::memcmp(out_polygon_pts, polygon_pts, sizeof(polygon_pts)) == 0);
+
+  heif_region_item_release(item);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx2);
+
+  heif_encoder_release(enc);
+  heif_context_free(ctx);
+  heif_image_release(img);
+}
+
+static std::vector<uint8_t> write_to_memory(heif_context* ctx)
+{
+  std::vector<uint8_t> data;
+  heif_writer writer{1, [](heif_context*, const void* d, size_t size, void* userdata) {
+    auto* out = (std::vector<uint8_t>*) userdata;
+    out->insert(out->end(), (const uint8_t*) d, (const uint8_t*) d + size);
+    return heif_error{heif_error_Ok, heif_suberror_Unspecified, "Success"};
+  }};
+  REQUIRE(heif_context_write(ctx, &writer, &data).code == heif_error_Ok);
+  return data;
+}
+
+static void check_mask_item(int bit_depth)
+{
+  const uint32_t width = 21; // not a multiple of 8, so that the rows of a 1-bit mask are not byte aligned
+  const uint32_t height = 7;
+
+  auto is_set = [](uint32_t x, uint32_t y) { return (x * 3 + y * 5) % 7 < 3; };
+
+  heif_image* mask;
+  heif_image_create(width, height, heif_colorspace_monochrome, heif_chroma_monochrome, &mask);
+  REQUIRE(heif_image_add_plane(mask, heif_channel_Y, width, height, bit_depth).code == heif_error_Ok);
+  size_t stride;
+  uint8_t* p = heif_image_get_plane2(mask, heif_channel_Y, &stride);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      p[y * stride + x] = is_set(x, y) ? (bit_depth == 1 ? 1 : 200) : (bit_depth == 1 ? 0 : 100);
+    }
+  }
+
+  heif_context* ctx = heif_context_alloc();
+
+  // a mask item alone does not make a valid file
+  heif_image* img;
+  heif_image_create(width, height, heif_colorspace_monochrome, heif_chroma_monochrome, &img);
+  fill_new_plane(img, heif_channel_Y, width, height);
+  heif_encoder* enc;
+  REQUIRE(heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &enc).code == heif_error_Ok);
+  REQUIRE(heif_context_encode_image(ctx, img, enc, nullptr, nullptr).code == heif_error_Ok);
+  heif_encoder_release(enc);
+  heif_image_release(img);
+
+  heif_encoder* mask_enc;
+  REQUIRE(heif_context_get_encoder_for_format(ctx, heif_compression_mask, &mask_enc).code == heif_error_Ok);
+  heif_image_handle* handle;
+  REQUIRE(heif_context_encode_image(ctx, mask, mask_enc, nullptr, &handle).code == heif_error_Ok);
+  heif_item_id mask_id = heif_image_handle_get_item_id(handle);
+  heif_image_handle_release(handle);
+  heif_encoder_release(mask_enc);
+  heif_image_release(mask);
+
+  std::vector<uint8_t> data = write_to_memory(ctx);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  REQUIRE(heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr).code == heif_error_Ok);
+  REQUIRE(heif_context_get_image_handle(ctx, mask_id, &handle).code == heif_error_Ok);
+  REQUIRE(heif_image_handle_get_luma_bits_per_pixel(handle) == bit_depth);
+
+  if (bit_depth == 1) {
+    heif_image* decoded;
+    REQUIRE(heif_decode_image(handle, &decoded, heif_colorspace_monochrome, heif_chroma_monochrome, nullptr).code == heif_error_Ok);
+    p = heif_image_get_plane2(decoded, heif_channel_Y, &stride);
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        REQUIRE(p[y * stride + x] == (is_set(x, y) ? 255 : 0));
+      }
+    }
+    heif_image_release(decoded);
+  }
+
+  const size_t bits_stride = 4;
+  std::vector<uint8_t> bits(bits_stride * height, 0xAA);
+  REQUIRE(heif_image_handle_decode_mask_bitset(handle, bits.data(), bits_stride).code == heif_error_Ok);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < 24; x++) {
+      bool bit = (bits[y * bits_stride + x / 8] >> (7 - x % 8)) & 1;
+      REQUIRE(bit == (x < width && is_set(x, y)));
+    }
+  }
+
+  REQUIRE(heif_image_handle_decode_mask_bitset(handle, bits.data(), 2).code == heif_error_Usage_error);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+TEST_CASE("1-bit mask item") {
+  if (!heif_have_encoder_for_format(heif_compression_uncompressed)) {
+    SKIP("Skipping test because uncompressed codec is not compiled.");
+  }
+
+  check_mask_item(1);
+}
+
+TEST_CASE("8-bit mask item to bitset") {
+  if (!heif_have_encoder_for_format(heif_compression_uncompressed)) {
+    SKIP("Skipping test because uncompressed codec is not compiled.");
+  }
+
+  check_mask_item(8);
+}
@@ -0,0 +1,458 @@
+/*
+  libheif unit tests for decoding image regions and tiles
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_experimental.h"
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "test_utils.h"
+
+
+static void check_region_decoding(const std::vector<uint8_t>& file_data, int max_decoding_threads)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_decoding_threads(ctx, max_decoding_threads);
+
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* full;
+  err = heif_decode_image(handle, &full, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int width = heif_image_get_primary_width(full);
+  int height = heif_image_get_primary_height(full);
+
+  struct Region { int x, y, w, h; };
+  std::vector<Region> regions {
+      {0, 0, width, height},
+      {0, 0, 1, 1},
+      {width - 1, height - 1, 1, 1},
+      {10, 20, 30, 40},
+      {width / 3 - 5, height / 2 - 7, 70, 50},
+      {width / 2, 3, width / 2, height - 3}
+  };
+
+  for (const Region& region : regions) {
+    heif_image* img;
+    err = heif_decode_image_region(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                   region.x, region.y, region.w, region.h);
+    INFO(region.x << "," << region.y << " " << region.w << "x" << region.h << ": " << (err.message ? err.message : ""));
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(heif_image_get_primary_width(img) == region.w);
+    REQUIRE(heif_image_get_primary_height(img) == region.h);
+
+    REQUIRE(get_interleaved_pixels(img, 0, 0, region.w, region.h) ==
+            get_interleaved_pixels(full, region.x, region.y, region.w, region.h));
+
+    heif_image_release(img);
+  }
+
+  // --- regions outside of the image are rejected
+
+  heif_image* img;
+  err = heif_decode_image_region(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                 width - 10, 0, 11, 10);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  err = heif_decode_image_region(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                 0, 0, 0, 10);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  heif_image_release(full);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Decode region of grid image")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  check_region_decoding(file_data, 0);
+  check_region_decoding(file_data, 4);
+}
+
+
+TEST_CASE("Decode region of transformed image")
+{
+  for (heif_orientation orientation : {heif_orientation_normal,
+                                       heif_orientation_flip_horizontally,
+                                       heif_orientation_rotate_180,
+                                       heif_orientation_flip_vertically,
+                                       heif_orientation_rotate_90_cw_then_flip_horizontally,
+                                       heif_orientation_rotate_90_cw,
+                                       heif_orientation_rotate_90_cw_then_flip_vertically,
+                                       heif_orientation_rotate_270_cw}) {
+    heif_image* input = create_gradient_image(301, 203, 5);
+
+    heif_context* ctx = heif_context_alloc();
+
+    heif_encoder* encoder;
+    heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_encoding_options* options = heif_encoding_options_alloc();
+    options->image_orientation = orientation;
+
+    err = heif_context_encode_image(ctx, input, encoder, options, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    std::vector<uint8_t> data;
+    heif_writer writer{};
+    writer.writer_api_version = 1;
+    writer.write = write_to_vector;
+    err = heif_context_write(ctx, &writer, &data);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_encoding_options_free(options);
+    heif_encoder_release(encoder);
+    heif_context_free(ctx);
+    heif_image_release(input);
+
+    check_region_decoding(data, 0);
+  }
+}
+
+
+TEST_CASE("Decoded tile cache")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_context_set_decoded_tile_cache_size(ctx, 16 * 1024 * 1024);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  options->statistics = heif_decoding_statistics_alloc();
+
+  auto decode_tile = [&](uint32_t tx, uint32_t ty) {
+    heif_image* img;
+    heif_error e = heif_image_handle_decode_image_tile(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB,
+                                                        options, tx, ty);
+    REQUIRE(e.code == heif_error_Ok);
+    std::vector<uint8_t> pixels = get_interleaved_pixels(img, 0, 0, 160, 120);
+
+    // modifying the returned image does not change the cached tile
+    int stride;
+    uint8_t* p = heif_image_get_plane(img, heif_channel_interleaved, &stride);
+    memset(p, 0, 3 * 160);
+
+    heif_image_release(img);
+    return pixels;
+  };
+
+  std::vector<uint8_t> first = decode_tile(1, 1);
+  REQUIRE(options->statistics->num_tile_cache_misses == 1);
+  REQUIRE(options->statistics->num_tile_cache_hits == 0);
+
+  REQUIRE(decode_tile(1, 1) == first);
+  REQUIRE(options->statistics->num_tile_cache_hits == 1);
+  REQUIRE(options->statistics->num_codec_decodes == 1);
+
+  // a different tile is decoded
+  REQUIRE(decode_tile(0, 1) != first);
+  REQUIRE(options->statistics->num_tile_cache_misses == 2);
+
+  // disabling the cache frees the tiles
+  heif_context_set_decoded_tile_cache_size(ctx, 0);
+  REQUIRE(decode_tile(1, 1) == first);
+  REQUIRE(options->statistics->num_tile_cache_hits == 1);
+  REQUIRE(options->statistics->num_codec_decodes == 3);
+
+  heif_decoding_statistics_free(options->statistics);
+  heif_decoding_options_free(options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Decode images of one context from several threads")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  auto decode = [ctx]() {
+    heif_image_handle* handle;
+    heif_error e = heif_context_get_primary_image_handle(ctx, &handle);
+    if (e.code != heif_error_Ok) {
+      return std::vector<uint8_t>{};
+    }
+
+    std::vector<uint8_t> pixels;
+    heif_image* img;
+    e = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+    if (e.code == heif_error_Ok) {
+      pixels = get_interleaved_pixels(img, 0, 0, 480, 240);
+      heif_image_release(img);
+    }
+
+    heif_image_handle_release(handle);
+    return pixels;
+  };
+
+  std::vector<uint8_t> expected = decode();
+  REQUIRE(!expected.empty());
+
+  // the tiles of each image are also decoded in parallel
+  std::vector<std::vector<uint8_t>> results(4);
+  std::vector<std::thread> threads;
+  for (auto& result : results) {
+    threads.emplace_back([&result, &decode]() { result = decode(); });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& result : results) {
+    REQUIRE(result == expected);
+  }
+
+  heif_context_free(ctx);
+}
+
+
+struct DecodedTile
+{
+  uint32_t x0, y0;
+  int width, height;
+};
+
+struct DecodedTileRecord
+{
+  std::mutex mutex;
+  std::vector<DecodedTile> tiles;
+};
+
+static void record_decoded_tile(const heif_image* region, uint32_t x0, uint32_t y0, void* user_data)
+{
+  auto* record = static_cast<DecodedTileRecord*>(user_data);
+
+  std::lock_guard<std::mutex> lock(record->mutex);
+  record->tiles.push_back({x0, y0, heif_image_get_primary_width(region), heif_image_get_primary_height(region)});
+}
+
+
+TEST_CASE("Report decoded grid tiles in priority order")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // a single decoding thread so that the order of the tiles is deterministic
+  heif_context_set_max_decoding_threads(ctx, 1);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  DecodedTileRecord record;
+
+  heif_decoding_options* options = heif_decoding_options_alloc();
+  options->on_tile_decoded = record_decoded_tile;
+  options->progress_user_data = &record;
+  options->prioritize_tiles_near_point = true;
+  options->tile_priority_x = 479;
+  options->tile_priority_y = 239;
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, options);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(record.tiles.size() == 6);
+
+  std::set<std::pair<uint32_t, uint32_t>> positions;
+  for (const auto& tile : record.tiles) {
+    REQUIRE(tile.width == 160);
+    REQUIRE(tile.height == 120);
+    positions.insert({tile.x0, tile.y0});
+  }
+
+  REQUIRE(positions.size() == 6);
+  REQUIRE(positions.count({0, 0}) == 1);
+  REQUIRE(positions.count({320, 120}) == 1);
+
+  // Without multithreading support, the tiles are decoded in raster order.
+  if (heif_get_thread_pool_size() > 0) {
+    REQUIRE(record.tiles[0].x0 == 320);
+    REQUIRE(record.tiles[0].y0 == 120);
+  }
+
+  heif_image_release(img);
+  heif_decoding_options_free(options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+TEST_CASE("Decode pyramid layer regions at scale")
+{
+  heif_image* image = create_gradient_image(400, 300, 0);
+
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_encode_pyramid(ctx, image, 128, 128, encoder, nullptr, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_image_release(image);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(heif_image_handle_get_number_of_pyramid_layers(handle) == 3);
+
+  heif_item_id layer_id;
+  heif_image_tiling tiling;
+  err = heif_image_handle_get_pyramid_layer(handle, 1, true, &layer_id, &tiling);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(tiling.image_width == 200);
+  REQUIRE(tiling.image_height == 150);
+  REQUIRE(tiling.tile_width == 128);
+  REQUIRE(tiling.num_columns == 2);
+  REQUIRE(tiling.num_rows == 2);
+
+  err = heif_image_handle_get_pyramid_layer(handle, 2, true, nullptr, &tiling);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(tiling.image_width == 400);
+
+  err = heif_image_handle_get_pyramid_layer(handle, 3, true, nullptr, &tiling);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  // The region at half resolution is decoded from the 200x150 layer without scaling.
+
+  heif_image_handle* layer_handle;
+  err = heif_context_get_image_handle(ctx, layer_id, &layer_handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* reference;
+  err = heif_decode_image_region(layer_handle, &reference, heif_colorspace_RGB, heif_chroma_444, nullptr, 100, 50, 50, 50);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* scaled;
+  err = heif_decode_image_region_at_scale(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr,
+                                          200, 100, 100, 100, 50, 50);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(reference));
+  heif_image_release(scaled);
+  heif_image_release(reference);
+
+  // At full resolution, the region is decoded from the full image.
+
+  err = heif_decode_image_region(handle, &reference, heif_colorspace_RGB, heif_chroma_444, nullptr, 200, 100, 100, 100);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_decode_image_region_at_scale(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr,
+                                          200, 100, 100, 100, 100, 100);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(reference));
+  heif_image_release(scaled);
+  heif_image_release(reference);
+
+  heif_image_handle_release(layer_handle);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+#endif
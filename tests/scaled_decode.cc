@@ -0,0 +1,221 @@
+/*
+  libheif unit tests for decoding images at a reduced size
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <cstdint>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Decode grid image at reduced size")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* full;
+  err = heif_decode_image(handle, &full, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // 480x240 grid, scaled to the width
+
+  heif_image* reference;
+  err = heif_image_scale_image(full, &reference, 100, 50, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* scaled;
+  err = heif_decode_image_at_size(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr, 100, 100);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_primary_width(scaled) == 100);
+  REQUIRE(heif_image_get_primary_height(scaled) == 50);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(reference));
+  heif_image_release(scaled);
+
+  // not scaled up
+
+  err = heif_decode_image_at_size(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr, 1000, 1000);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(full));
+  heif_image_release(scaled);
+
+  heif_image_release(reference);
+  heif_image_release(full);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Decode image region at scale")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(heif_image_handle_get_number_of_pyramid_layers(handle) == 0);
+
+  // Without a pyramid, the region is decoded from the image itself.
+
+  heif_image* region;
+  err = heif_decode_image_region(handle, &region, heif_colorspace_RGB, heif_chroma_444, nullptr, 100, 50, 200, 100);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* reference;
+  err = heif_image_scale_image(region, &reference, 100, 50, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* scaled;
+  err = heif_decode_image_region_at_scale(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr,
+                                          100, 50, 200, 100, 100, 50);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(reference));
+  heif_image_release(scaled);
+
+  // region outside of the image
+
+  err = heif_decode_image_region_at_scale(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr,
+                                          400, 0, 100, 100, 50, 50);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  heif_image_release(reference);
+  heif_image_release(region);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Decode image at reduced size from thumbnail")
+{
+  heif_image* image = create_gradient_image(400, 200, 0);
+
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, image, encoder, nullptr, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* thumbnail_handle;
+  err = heif_context_encode_thumbnail(ctx, image, handle, encoder, nullptr, 100, &thumbnail_handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_handle_release(thumbnail_handle);
+  heif_image_handle_release(handle);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_item_id thumbnail_id;
+  REQUIRE(heif_image_handle_get_list_of_thumbnail_IDs(handle, &thumbnail_id, 1) == 1);
+  err = heif_image_handle_get_thumbnail(handle, thumbnail_id, &thumbnail_handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* thumbnail;
+  err = heif_decode_image(thumbnail_handle, &thumbnail, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_primary_width(thumbnail) == 100);
+
+  // The thumbnail is large enough.
+
+  heif_image* scaled;
+  heif_image* reference;
+  err = heif_decode_image_at_size(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr, 80, 80);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_image_scale_image(thumbnail, &reference, 80, 40, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(reference));
+  heif_image_release(scaled);
+  heif_image_release(reference);
+
+  // The thumbnail is too small. The master image is used.
+
+  heif_image* full;
+  err = heif_decode_image(handle, &full, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_decode_image_at_size(handle, &scaled, heif_colorspace_RGB, heif_chroma_444, nullptr, 200, 200);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_image_scale_image(full, &reference, 200, 100, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_planar_pixels(scaled) == get_planar_pixels(reference));
+  heif_image_release(scaled);
+  heif_image_release(reference);
+
+  heif_image_release(full);
+  heif_image_release(thumbnail);
+  heif_image_release(image);
+  heif_image_handle_release(thumbnail_handle);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
@@ -0,0 +1,296 @@
+/*
+  libheif unit tests for the sequence boxes
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "sequences/seq_boxes.h"
+#include "error.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+template <typename T>
+static std::shared_ptr<T> parse_box(const std::vector<uint8_t>& byteArray)
+{
+  auto reader = std::make_shared<StreamReader_memory>(byteArray.data(), byteArray.size(), false);
+
+  BitstreamRange range(reader, byteArray.size());
+  std::shared_ptr<Box> box;
+  Error error = Box::read(range, &box, heif_get_global_security_limits());
+  REQUIRE(error == Error::Ok);
+  REQUIRE(range.error() == 0);
+
+  auto typed_box = std::dynamic_pointer_cast<T>(box);
+  REQUIRE(typed_box);
+  return typed_box;
+}
+
+
+TEST_CASE("sbgp lookup")
+{
+  std::vector<uint8_t> byteArray{
+      0x00, 0x00, 0x00, 0x34, 's', 'b', 'g', 'p',
+      0x00, 0x00, 0x00, 0x00,
+      'r', 'e', 'f', 's',
+      0x00, 0x00, 0x00, 0x04,
+      0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, // empty run
+      0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x02};
+
+  auto sbgp = parse_box<Box_sbgp>(byteArray);
+  REQUIRE(sbgp->get_grouping_type() == fourcc("refs"));
+  REQUIRE(!sbgp->get_grouping_type_parameter());
+  REQUIRE(sbgp->get_number_of_mapped_samples() == 9);
+
+  std::vector<uint32_t> indices(11);
+  sbgp->get_group_description_indices(0, 11, 7, indices.data());
+  REQUIRE(indices == std::vector<uint32_t>{1, 1, 1, 0, 0, 2, 2, 2, 2, 7, 7});
+
+  for (uint32_t first = 0; first < 11; first++) {
+    uint32_t index;
+    sbgp->get_group_description_indices(first, 1, 7, &index);
+    REQUIRE(index == indices[first]);
+  }
+
+  sbgp->get_group_description_indices(4, 3, 7, indices.data());
+  REQUIRE(indices[0] == 0);
+  REQUIRE(indices[1] == 2);
+  REQUIRE(indices[2] == 2);
+}
+
+
+TEST_CASE("sgpd descriptions")
+{
+  std::vector<uint8_t> byteArray{
+      0x00, 0x00, 0x00, 0x32, 's', 'g', 'p', 'd',
+      0x02, 0x00, 0x00, 0x00,
+      'r', 'e', 'f', 's',
+      0x00, 0x00, 0x00, 0x00, // variable length
+      0x00, 0x00, 0x00, 0x01, // default group
+      0x00, 0x00, 0x00, 0x02,
+      0x00, 0x00, 0x00, 0x05,
+      0x00, 0x00, 0x00, 0x01, 0x00,
+      0x00, 0x00, 0x00, 0x09,
+      0x00, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01};
+
+  auto sgpd = parse_box<Box_sgpd>(byteArray);
+  REQUIRE(sgpd->get_grouping_type() == fourcc("refs"));
+  REQUIRE(sgpd->get_default_group_description_index() == 1);
+  REQUIRE(sgpd->get_number_of_entries() == 2);
+
+  REQUIRE(sgpd->get_entry_data(0) == nullptr);
+  REQUIRE(sgpd->get_entry_data(3) == nullptr);
+
+  const std::vector<uint8_t>* data = sgpd->get_entry_data(2);
+  REQUIRE(data != nullptr);
+  REQUIRE(*data == std::vector<uint8_t>{0x00, 0x00, 0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01});
+}
+
+
+TEST_CASE("stco_co64")
+{
+  auto stco = std::make_shared<Box_stco>();
+  stco->add_chunk_offset(0x1000);
+  stco->add_chunk_offset(0x2000);
+  stco->derive_box_version();
+  REQUIRE(stco->get_short_type() == fourcc("stco"));
+
+  // Offsets that may exceed 32 bits after adding the size of the boxes in front of the 'mdat' switch to 'co64'.
+  stco->add_chunk_offset(0x100000000);
+  stco->derive_box_version();
+  REQUIRE(stco->get_short_type() == fourcc("co64"));
+
+  StreamWriter writer;
+  Error err = stco->write(writer);
+  REQUIRE(err.error_code == heif_error_Ok);
+  stco->patch_file_pointers(writer, 0x20);
+
+  std::vector<uint8_t> expected{
+    0x00, 0x00, 0x00, 0x28, 'c', 'o', '6', '4',
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x03,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x20,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x20,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x20
+  };
+  const std::vector<uint8_t> written = writer.get_data();
+  REQUIRE(written == expected);
+
+  auto reader = std::make_shared<StreamReader_memory>(written.data(),
+                                                      written.size(), false);
+
+  BitstreamRange range(reader, written.size());
+  std::shared_ptr<Box> box;
+  Error error = Box::read(range, &box, heif_get_global_security_limits());
+  REQUIRE(error == Error::Ok);
+
+  REQUIRE(box->get_short_type() == fourcc("co64"));
+  std::shared_ptr<Box_stco> co64 = std::dynamic_pointer_cast<Box_stco>(box);
+  REQUIRE(co64 != nullptr);
+  REQUIRE(co64->get_offsets() == std::vector<uint64_t>{0x1020, 0x2020, 0x100000020});
+}
+
+
+TEST_CASE("stsz_stz2")
+{
+  auto stsz = std::make_shared<Box_stsz>();
+  stsz->append_sample_size(3);
+  stsz->append_sample_size(15);
+  stsz->append_sample_size(7);
+  stsz->derive_box_version();
+  REQUIRE(stsz->get_short_type() == fourcc("stz2"));
+
+  StreamWriter writer;
+  Error err = stsz->write(writer);
+  REQUIRE(err.error_code == heif_error_Ok);
+
+  std::vector<uint8_t> expected{
+    0x00, 0x00, 0x00, 0x16, 's', 't', 'z', '2',
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x04,
+    0x00, 0x00, 0x00, 0x03,
+    0x3f, 0x70
+  };
+  const std::vector<uint8_t> written = writer.get_data();
+  REQUIRE(written == expected);
+
+  auto reader = std::make_shared<StreamReader_memory>(written.data(),
+                                                      written.size(), false);
+
+  BitstreamRange range(reader, written.size());
+  std::shared_ptr<Box> box;
+  Error error = Box::read(range, &box, heif_get_global_security_limits());
+  REQUIRE(error == Error::Ok);
+
+  std::shared_ptr<Box_stsz> stz2 = std::dynamic_pointer_cast<Box_stsz>(box);
+  REQUIRE(stz2 != nullptr);
+  REQUIRE(stz2->get_sample_count() == 3);
+  REQUIRE(stz2->get_sample_size(1) == 15);
+  REQUIRE(stz2->get_sample_size(3) == 0);
+  REQUIRE(stz2->get_sample_sizes_sum(2) == 18);
+  REQUIRE(stz2->get_sample_sizes_sum(3) == 25);
+
+  // large sizes are written as a regular 'stsz'
+  stsz->append_sample_size(0x10000);
+  stsz->derive_box_version();
+  REQUIRE(stsz->get_short_type() == fourcc("stsz"));
+}
+
+
+TEST_CASE("stsz_sizes_sum")
+{
+  Box_stsz stsz;
+  uint64_t sum = 0;
+  std::vector<uint64_t> sums;
+
+  for (uint32_t i = 0; i < 200; i++) {
+    sums.push_back(sum);
+    stsz.append_sample_size(i < 100 ? 500 : i);
+    sum += (i < 100 ? 500 : i);
+  }
+
+  for (uint32_t i = 0; i < 200; i++) {
+    REQUIRE(stsz.get_sample_sizes_sum(i) == sums[i]);
+  }
+
+  REQUIRE(stsz.get_sample_sizes_sum(200) == sum);
+  REQUIRE(stsz.get_sample_size(150) == 150);
+}
+
+
+TEST_CASE("stts_lookup")
+{
+  Box_stts stts;
+  for (int i = 0; i < 10; i++) {
+    stts.append_sample_duration(100);
+  }
+  stts.append_sample_duration(0);
+  for (int i = 0; i < 5; i++) {
+    stts.append_sample_duration(50);
+  }
+
+  REQUIRE(stts.get_sample_duration(0) == 100);
+  REQUIRE(stts.get_sample_duration(9) == 100);
+  REQUIRE(stts.get_sample_duration(10) == 0);
+  REQUIRE(stts.get_sample_duration(11) == 50);
+  REQUIRE(stts.get_sample_duration(16) == 0);
+
+  REQUIRE(stts.get_sample_at_time(0) == 0);
+  REQUIRE(stts.get_sample_at_time(999) == 9);
+  REQUIRE(stts.get_sample_at_time(1000) == 11);
+  REQUIRE(stts.get_sample_at_time(1249) == 15);
+  REQUIRE(stts.get_sample_at_time(1250) == 16);
+
+  REQUIRE(stts.get_total_duration(true) == 1250);
+  REQUIRE(stts.get_total_duration(false) == 1200);
+
+  REQUIRE(stts.get_sample_decoding_time(0) == 0);
+  REQUIRE(stts.get_sample_decoding_time(9) == 900);
+  REQUIRE(stts.get_sample_decoding_time(11) == 1000);
+  REQUIRE(stts.get_sample_decoding_time(15) == 1200);
+  REQUIRE(stts.get_sample_decoding_time(16) == 1250);
+}
+
+
+TEST_CASE("ctts_lookup")
+{
+  Box_ctts ctts;
+  for (int gop = 0; gop < 100; gop++) {
+    for (int32_t offset : {0, 300, -100, -100}) {
+      ctts.append_sample_offset(offset);
+    }
+  }
+
+  REQUIRE(ctts.get_number_of_samples() == 400);
+  REQUIRE(ctts.get_sample_offset(0) == 0);
+  REQUIRE(ctts.get_sample_offset(1) == 300);
+  REQUIRE(ctts.get_sample_offset(2) == -100);
+  REQUIRE(ctts.get_sample_offset(3) == -100);
+  REQUIRE(ctts.get_sample_offset(397) == 300);
+  REQUIRE(ctts.get_sample_offset(400) == 0);
+
+  // negative offsets are written with version 1
+
+  StreamWriter writer;
+  ctts.derive_box_version();
+  Error err = ctts.write(writer);
+  REQUIRE(err.error_code == heif_error_Ok);
+
+  std::vector<uint8_t> data = writer.get_data();
+  auto reader = std::make_shared<StreamReader_memory>(data.data(), data.size(), false);
+  BitstreamRange range(reader, data.size());
+  std::shared_ptr<Box> box;
+  err = Box::read(range, &box, heif_get_global_security_limits());
+  REQUIRE(err.error_code == heif_error_Ok);
+
+  auto parsed = std::dynamic_pointer_cast<Box_ctts>(box);
+  REQUIRE(parsed);
+  REQUIRE(parsed->get_version() == 1);
+  REQUIRE(parsed->get_number_of_samples() == 400);
+  REQUIRE(parsed->get_sample_offset(2) == -100);
+  REQUIRE(parsed->get_sample_offset(397) == 300);
+}
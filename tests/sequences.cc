@@ -0,0 +1,1056 @@
+/*
+  libheif unit tests for reading and writing image sequences
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include "libheif/heif_sequences.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <thread>
+#include <vector>
+#include "test_utils.h"
+
+
+static std::vector<uint8_t> encode_sequence(int num_frames, int encoding_threads = 0)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, encoding_threads);
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track_info* info = heif_track_info_alloc();
+
+  heif_track* track;
+  err = heif_context_add_visual_sequence_track(ctx, 64, 48, info, heif_track_type_image_sequence, &track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int i = 0; i < num_frames; i++) {
+    heif_image* img = create_gradient_image(64, 48, i * 11);
+    heif_image_set_duration(img, 100);
+
+    err = heif_track_encode_sequence_image(track, img, encoder, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image_release(img);
+  }
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track_release(track);
+  heif_track_info_release(info);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  return data;
+}
+
+static std::vector<std::vector<uint8_t>> decode_sequence(const std::vector<uint8_t>& file_data, int lookahead,
+                                                         int max_decoding_threads = -1)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  if (max_decoding_threads >= 0) {
+    heif_context_set_max_decoding_threads(ctx, max_decoding_threads);
+  }
+
+  heif_track* track = heif_context_get_track(ctx, 0);
+  REQUIRE(track != nullptr);
+
+  heif_track_set_decoding_lookahead(track, lookahead);
+
+  std::vector<std::vector<uint8_t>> frames;
+
+  for (;;) {
+    heif_image* img;
+    err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+    if (err.code == heif_error_End_of_sequence) {
+      break;
+    }
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(heif_image_get_duration(img) == 100);
+
+    frames.push_back(get_interleaved_pixels(img, 0, 0, 64, 48));
+    heif_image_release(img);
+  }
+
+  // calling it again at the end of the sequence still reports the end
+  heif_image* img;
+  err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_End_of_sequence);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+
+  return frames;
+}
+
+TEST_CASE("Decode sequence with look-ahead")
+{
+  std::vector<uint8_t> file_data = encode_sequence(7);
+
+  auto reference = decode_sequence(file_data, 0);
+  REQUIRE(reference.size() == 7);
+  REQUIRE(reference[0] != reference[1]);
+
+  REQUIRE(decode_sequence(file_data, 1) == reference);
+  REQUIRE(decode_sequence(file_data, 3) == reference);
+  REQUIRE(decode_sequence(file_data, 20) == reference);
+
+  // several frames decoded in parallel
+  REQUIRE(decode_sequence(file_data, 5, 4) == reference);
+  REQUIRE(decode_sequence(file_data, 20, 3) == reference);
+  REQUIRE(decode_sequence(file_data, 3, 1) == reference);
+
+  // release the track while images are still decoded in the background
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track* track = heif_context_get_track(ctx, 0);
+  heif_track_set_decoding_lookahead(track, 5);
+
+  heif_image* img;
+  err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(get_interleaved_pixels(img, 0, 0, 64, 48) == reference[0]);
+  heif_image_release(img);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+}
+
+static std::vector<uint8_t> decode_next_frame(heif_track* track)
+{
+  heif_image* img;
+  heif_error err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> pixels = get_interleaved_pixels(img, 0, 0, 64, 48);
+  heif_image_release(img);
+
+  return pixels;
+}
+
+TEST_CASE("Decode sequence with look-ahead after shrinking the thread pool")
+{
+  std::vector<uint8_t> file_data = encode_sequence(4);
+  auto reference = decode_sequence(file_data, 0);
+
+  int pool_size = heif_get_thread_pool_size();
+  heif_set_thread_pool_size(2);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track* track = heif_context_get_track(ctx, 0);
+  heif_track_set_decoding_lookahead(track, 3);
+
+  // Without worker threads, the look-ahead task runs synchronously in the calling thread.
+  heif_set_thread_pool_size(0);
+
+  for (const auto& frame : reference) {
+    REQUIRE(decode_next_frame(track) == frame);
+  }
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+
+  heif_set_thread_pool_size(pool_size);
+}
+
+TEST_CASE("Parallel sequence encoding")
+{
+  std::vector<uint8_t> serial = encode_sequence(9);
+
+  // the frames are written in the same order, independent of the number of threads
+  for (int threads : {2, 4, 16}) {
+    REQUIRE(encode_sequence(9, threads) == serial);
+  }
+
+  REQUIRE(decode_sequence(serial, 0).size() == 9);
+}
+
+TEST_CASE("Seek in sequence")
+{
+  std::vector<uint8_t> file_data = encode_sequence(7);
+  auto reference = decode_sequence(file_data, 0);
+
+  for (int lookahead : {0, 3}) {
+    heif_context* ctx = heif_context_alloc();
+    heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_track* track = heif_context_get_track(ctx, 0);
+    heif_track_set_decoding_lookahead(track, lookahead);
+
+    REQUIRE(decode_next_frame(track) == reference[0]);
+
+    err = heif_track_seek_to_sample(track, 4);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(decode_next_frame(track) == reference[4]);
+    REQUIRE(decode_next_frame(track) == reference[5]);
+
+    // each frame has a duration of 100
+    err = heif_track_seek_to_time(track, 250);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(decode_next_frame(track) == reference[2]);
+
+    err = heif_track_seek_to_time(track, 5000);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image* img;
+    err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+    REQUIRE(err.code == heif_error_End_of_sequence);
+
+    err = heif_track_seek_to_sample(track, 8);
+    REQUIRE(err.code == heif_error_Usage_error);
+
+    err = heif_track_seek_to_sample(track, 0);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(decode_next_frame(track) == reference[0]);
+
+    heif_track_release(track);
+    heif_context_free(ctx);
+  }
+}
+
+TEST_CASE("Decode sync samples only")
+{
+  std::vector<uint8_t> file_data = encode_sequence(7);
+  auto reference = decode_sequence(file_data, 0);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track* track = heif_context_get_track(ctx, 0);
+
+  heif_image* images[2];
+  uint32_t sample_indices[2];
+  int n;
+
+  err = heif_track_decode_sync_images(track, 3, 0, 0, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                      images, sample_indices, 2, &n);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(n == 2);
+  REQUIRE(sample_indices[0] == 0);
+  REQUIRE(sample_indices[1] == 3);
+  REQUIRE(get_interleaved_pixels(images[0], 0, 0, 64, 48) == reference[0]);
+  REQUIRE(get_interleaved_pixels(images[1], 0, 0, 64, 48) == reference[3]);
+  REQUIRE(heif_image_get_duration(images[1]) == 100);
+  heif_image_release(images[0]);
+  heif_image_release(images[1]);
+
+  // the selection continues with the stride of the previous call
+  err = heif_track_decode_sync_images(track, 3, 32, 32, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                      images, sample_indices, 2, &n);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(n == 1);
+  REQUIRE(sample_indices[0] == 6);
+  REQUIRE(heif_image_get_primary_width(images[0]) == 32);
+  REQUIRE(heif_image_get_primary_height(images[0]) == 24);
+  heif_image_release(images[0]);
+
+  err = heif_track_decode_sync_images(track, 3, 0, 0, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr,
+                                      images, sample_indices, 2, &n);
+  REQUIRE(err.code == heif_error_End_of_sequence);
+  REQUIRE(n == 0);
+
+  // normal decoding continues after a seek
+  err = heif_track_seek_to_sample(track, 5);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(decode_next_frame(track) == reference[5]);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+}
+
+
+static uint32_t read_be32(const std::vector<uint8_t>& data, size_t pos)
+{
+  return (uint32_t(data[pos]) << 24) | (uint32_t(data[pos + 1]) << 16) | (uint32_t(data[pos + 2]) << 8) | data[pos + 3];
+}
+
+static void write_be32(std::vector<uint8_t>& data, size_t pos, uint32_t value)
+{
+  data[pos] = uint8_t(value >> 24);
+  data[pos + 1] = uint8_t(value >> 16);
+  data[pos + 2] = uint8_t(value >> 8);
+  data[pos + 3] = uint8_t(value);
+}
+
+// Finds the child box of the given type in the range [begin,end). Returns the position of its header.
+static size_t find_box(const std::vector<uint8_t>& data, size_t begin, size_t end, const char* type)
+{
+  for (size_t pos = begin; pos + 8 <= end; pos += read_be32(data, pos)) {
+    if (memcmp(&data[pos + 4], type, 4) == 0) {
+      return pos;
+    }
+
+    REQUIRE(read_be32(data, pos) >= 8);
+  }
+
+  FAIL("box not found");
+  return 0;
+}
+
+// Inserts a 'ctts' box (version 0, one entry per sample) into the sample table of the first track.
+// The samples then have to be decoded in file order and output in the presentation order given by the offsets.
+static std::vector<uint8_t> add_composition_offsets(std::vector<uint8_t> file, const std::vector<uint32_t>& offsets)
+{
+  std::vector<size_t> containers;
+  size_t begin = 0;
+  size_t end = file.size();
+  for (const char* type : {"moov", "trak", "mdia", "minf", "stbl"}) {
+    size_t box = find_box(file, begin, end, type);
+    begin = box + 8;
+    end = box + read_be32(file, box);
+    containers.push_back(box);
+  }
+
+  size_t stbl = containers.back();
+  size_t insert_pos = stbl + read_be32(file, stbl);
+
+  std::vector<uint8_t> ctts(16 + 8 * offsets.size());
+  write_be32(ctts, 0, uint32_t(ctts.size()));
+  memcpy(&ctts[4], "ctts", 4);
+  write_be32(ctts, 8, 0);
+  write_be32(ctts, 12, uint32_t(offsets.size()));
+  for (size_t i = 0; i < offsets.size(); i++) {
+    write_be32(ctts, 16 + 8 * i, 1);
+    write_be32(ctts, 20 + 8 * i, offsets[i]);
+  }
+
+  // the sample data moves if it is stored after the 'moov' box
+
+  size_t stco = find_box(file, stbl + 8, insert_pos, "stco");
+  uint32_t num_chunks = read_be32(file, stco + 12);
+  for (uint32_t i = 0; i < num_chunks; i++) {
+    uint32_t offset = read_be32(file, stco + 16 + 4 * i);
+    if (offset >= insert_pos) {
+      write_be32(file, stco + 16 + 4 * i, offset + uint32_t(ctts.size()));
+    }
+  }
+
+  for (size_t container : containers) {
+    write_be32(file, container, read_be32(file, container) + uint32_t(ctts.size()));
+  }
+
+  file.insert(file.begin() + static_cast<ptrdiff_t>(insert_pos), ctts.begin(), ctts.end());
+
+  return file;
+}
+
+TEST_CASE("Decode sequence with reordered samples")
+{
+  std::vector<uint8_t> regular_file = encode_sequence(7);
+  auto coded_frames = decode_sequence(regular_file, 0);
+
+  // presentation times (decoding time + offset): 100, 300, 200, 400, 700, 500, 600
+  std::vector<uint8_t> file_data = add_composition_offsets(regular_file, {100, 200, 0, 100, 300, 0, 0});
+
+  std::vector<std::vector<uint8_t>> expected{coded_frames[0], coded_frames[2], coded_frames[1], coded_frames[3],
+                                             coded_frames[5], coded_frames[6], coded_frames[4]};
+
+  REQUIRE(decode_sequence(file_data, 0) == expected);
+  REQUIRE(decode_sequence(file_data, 3) == expected);
+  REQUIRE(decode_sequence(file_data, 5, 4) == expected);
+
+  // after seeking, the images are also output in presentation order
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track* track = heif_context_get_track(ctx, 0);
+
+  REQUIRE(decode_next_frame(track) == expected[0]);
+  REQUIRE(decode_next_frame(track) == expected[1]);
+
+  err = heif_track_seek_to_sample(track, 4);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(decode_next_frame(track) == coded_frames[5]);
+  REQUIRE(decode_next_frame(track) == coded_frames[6]);
+  REQUIRE(decode_next_frame(track) == coded_frames[4]);
+
+  heif_image* img;
+  err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_End_of_sequence);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+}
+
+TEST_CASE("Fragmented sequence writing")
+{
+  std::vector<uint8_t> regular_file = encode_sequence(7);
+  auto reference = decode_sequence(regular_file, 0);
+
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+
+  err = heif_context_start_fragmented_writing(ctx, &writer, &data, 0);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  err = heif_context_start_fragmented_writing(ctx, &writer, &data, 3);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track_info* info = heif_track_info_alloc();
+  info->with_tai_timestamps = heif_sample_aux_info_presence_mandatory;
+  info->tai_clock_info = heif_tai_clock_info_alloc();
+
+  heif_track* track;
+  err = heif_context_add_visual_sequence_track(ctx, 64, 48, info, heif_track_type_image_sequence, &track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<size_t> written_sizes;
+
+  for (int i = 0; i < 7; i++) {
+    heif_image* img = create_gradient_image(64, 48, i * 11);
+    heif_image_set_duration(img, 100);
+
+    heif_tai_timestamp_packet* tai = heif_tai_timestamp_packet_alloc();
+    tai->tai_timestamp = 1000 + i;
+    heif_image_set_tai_timestamp(img, tai);
+    heif_tai_timestamp_packet_release(tai);
+
+    err = heif_track_encode_sequence_image(track, img, encoder, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image_release(img);
+
+    written_sizes.push_back(data.size());
+  }
+
+  // A fragment is written when the next sample arrives, the last one when the file is finished.
+  REQUIRE(written_sizes[2] == 0);
+  REQUIRE(written_sizes[3] > 0);
+  REQUIRE(written_sizes[5] == written_sizes[3]);
+  REQUIRE(written_sizes[6] > written_sizes[5]);
+
+  heif_track* late_track;
+  err = heif_context_add_visual_sequence_track(ctx, 64, 48, info, heif_track_type_image_sequence, &late_track);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(data.size() > written_sizes[6]);
+
+  heif_track_release(track);
+  heif_track_info_release(info);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  REQUIRE(decode_sequence(data, 0) == reference);
+  REQUIRE(decode_sequence(data, 3) == reference);
+
+  // --- durations and timestamps are read from the fragments
+
+  heif_context* regular_ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(regular_ctx, regular_file.data(), regular_file.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_context_get_sequence_duration(ctx) == heif_context_get_sequence_duration(regular_ctx));
+
+  track = heif_context_get_track(ctx, 0);
+  REQUIRE(track != nullptr);
+
+  for (int i = 0; i < 7; i++) {
+    heif_raw_sequence_sample* sample;
+    err = heif_track_get_next_raw_sequence_sample(track, &sample);
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(heif_raw_sequence_sample_get_duration(sample) == 100);
+    REQUIRE(heif_raw_sequence_sample_has_tai_timestamp(sample));
+    REQUIRE(heif_raw_sequence_sample_get_tai_timestamp(sample)->tai_timestamp == uint64_t(1000 + i));
+    heif_raw_sequence_sample_release(sample);
+  }
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+  heif_context_free(regular_ctx);
+
+  // --- a file that is still being written can be read up to the last complete fragment
+
+  std::vector<uint8_t> partial_file(data.begin(), data.end() - 5);
+  auto partial_frames = decode_sequence(partial_file, 0);
+  REQUIRE(partial_frames.size() == 6);
+  REQUIRE(std::equal(partial_frames.begin(), partial_frames.end(), reference.begin()));
+}
+
+
+TEST_CASE("Multiplexed reading of interleaved tracks")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // Fragments interleave the samples of the tracks in the file.
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_start_fragmented_writing(ctx, &writer, &data, 2);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track_info* info = heif_track_info_alloc();
+  info->with_tai_timestamps = heif_sample_aux_info_presence_mandatory;
+  info->tai_clock_info = heif_tai_clock_info_alloc();
+
+  heif_track* visual_track;
+  err = heif_context_add_visual_sequence_track(ctx, 64, 48, info, heif_track_type_image_sequence, &visual_track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track_info* metadata_info = heif_track_info_alloc();
+
+  heif_track* metadata_track;
+  err = heif_context_add_uri_metadata_sequence_track(ctx, metadata_info, "urn:test:multiplex", &metadata_track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int i = 0; i < 6; i++) {
+    heif_image* img = create_gradient_image(64, 48, i * 11);
+    heif_image_set_duration(img, 100);
+
+    heif_tai_timestamp_packet* tai = heif_tai_timestamp_packet_alloc();
+    tai->tai_timestamp = 1000 + i;
+    heif_image_set_tai_timestamp(img, tai);
+    heif_tai_timestamp_packet_release(tai);
+
+    err = heif_track_encode_sequence_image(visual_track, img, encoder, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_image_release(img);
+
+    heif_raw_sequence_sample* sample = heif_raw_sequence_sample_alloc();
+    uint8_t metadata[3] = {'m', 'd', static_cast<uint8_t>(i)};
+    heif_raw_sequence_sample_set_data(sample, metadata, sizeof(metadata));
+    heif_raw_sequence_sample_set_duration(sample, 100);
+    err = heif_track_add_raw_sequence_sample(metadata_track, sample);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_raw_sequence_sample_release(sample);
+  }
+
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  uint32_t visual_track_id = heif_track_get_id(visual_track);
+  uint32_t metadata_track_id = heif_track_get_id(metadata_track);
+
+  heif_track_release(visual_track);
+  heif_track_release(metadata_track);
+  heif_track_info_release(info);
+  heif_track_info_release(metadata_info);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- reference: read each track separately
+
+  std::map<uint32_t, std::vector<std::vector<uint8_t>>> reference;
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (uint32_t id : {visual_track_id, metadata_track_id}) {
+    heif_track* track = heif_context_get_track(ctx, id);
+    REQUIRE(track != nullptr);
+
+    heif_raw_sequence_sample* sample;
+    while (heif_track_get_next_raw_sequence_sample(track, &sample).code == heif_error_Ok) {
+      size_t size;
+      const uint8_t* sample_data = heif_raw_sequence_sample_get_data(sample, &size);
+      reference[id].emplace_back(sample_data, sample_data + size);
+      heif_raw_sequence_sample_release(sample);
+    }
+
+    heif_track_release(track);
+  }
+
+  heif_context_free(ctx);
+
+  REQUIRE(reference[visual_track_id].size() == 6);
+  REQUIRE(reference[metadata_track_id].size() == 6);
+
+  // --- read all tracks in file order
+
+  RecordingReader recorder;
+  recorder.data = &data;
+  heif_reader reader = get_recording_reader();
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_sample_multiplexer* multiplexer;
+  err = heif_context_create_sample_multiplexer(ctx, nullptr, 0, &multiplexer);
+  REQUIRE(err.code == heif_error_Ok);
+
+  recorder.reads.clear();
+
+  std::map<uint32_t, std::vector<std::vector<uint8_t>>> multiplexed;
+  std::vector<uint32_t> track_order;
+  std::vector<uint64_t> timestamps;
+
+  for (;;) {
+    uint32_t track_id;
+    heif_raw_sequence_sample* sample;
+    err = heif_sample_multiplexer_get_next_sample(multiplexer, &track_id, &sample);
+    if (err.code == heif_error_End_of_sequence) {
+      break;
+    }
+    REQUIRE(err.code == heif_error_Ok);
+
+    size_t size;
+    const uint8_t* sample_data = heif_raw_sequence_sample_get_data(sample, &size);
+    multiplexed[track_id].emplace_back(sample_data, sample_data + size);
+    track_order.push_back(track_id);
+
+    if (track_id == visual_track_id) {
+      const heif_tai_timestamp_packet* tai = heif_raw_sequence_sample_get_tai_timestamp(sample);
+      REQUIRE(tai != nullptr);
+      timestamps.push_back(tai->tai_timestamp);
+    }
+
+    heif_raw_sequence_sample_release(sample);
+  }
+
+  REQUIRE(multiplexed == reference);
+  REQUIRE(timestamps == std::vector<uint64_t>{1000, 1001, 1002, 1003, 1004, 1005});
+
+  // the tracks alternate with the fragments
+  REQUIRE(track_order.size() == 12);
+  REQUIRE(std::find(track_order.begin(), track_order.begin() + 4, metadata_track_id) != track_order.begin() + 4);
+
+  // all data was read with few, forward-only reads
+  REQUIRE(!recorder.reads.empty());
+  REQUIRE(recorder.reads.size() < 12);
+  for (size_t i = 1; i < recorder.reads.size(); i++) {
+    REQUIRE(recorder.reads[i].first >= recorder.reads[i - 1].second);
+  }
+
+  // selecting a single track
+  heif_sample_multiplexer_release(multiplexer);
+  err = heif_context_create_sample_multiplexer(ctx, &metadata_track_id, 1, &multiplexer);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int num_samples = 0;
+  heif_raw_sequence_sample* sample;
+  uint32_t track_id;
+  while (heif_sample_multiplexer_get_next_sample(multiplexer, &track_id, &sample).code == heif_error_Ok) {
+    REQUIRE(track_id == metadata_track_id);
+    heif_raw_sequence_sample_release(sample);
+    num_samples++;
+  }
+  REQUIRE(num_samples == 6);
+
+  heif_sample_multiplexer_release(multiplexer);
+
+  uint32_t invalid_id = 999;
+  err = heif_context_create_sample_multiplexer(ctx, &invalid_id, 1, &multiplexer);
+  REQUIRE(err.code != heif_error_Ok);
+
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Bulk reading of raw samples")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_track_info* info = heif_track_info_alloc();
+  info->with_tai_timestamps = heif_sample_aux_info_presence_optional;
+  info->tai_clock_info = heif_tai_clock_info_alloc();
+
+  heif_track* track;
+  heif_error err = heif_context_add_uri_metadata_sequence_track(ctx, info, "urn:test:bulk", &track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  const int num_samples = 20;
+
+  for (int i = 0; i < num_samples; i++) {
+    heif_raw_sequence_sample* sample = heif_raw_sequence_sample_alloc();
+    std::vector<uint8_t> metadata(1 + i % 5, static_cast<uint8_t>(i));
+    heif_raw_sequence_sample_set_data(sample, metadata.data(), metadata.size());
+    heif_raw_sequence_sample_set_duration(sample, 10 + i);
+
+    if (i % 2 == 0) {
+      heif_tai_timestamp_packet* tai = heif_tai_timestamp_packet_alloc();
+      tai->tai_timestamp = 5000 + i;
+      heif_raw_sequence_sample_set_tai_timestamp(sample, tai);
+      heif_tai_timestamp_packet_release(tai);
+    }
+
+    err = heif_track_add_raw_sequence_sample(track, sample);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_raw_sequence_sample_release(sample);
+  }
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  uint32_t track_id = heif_track_get_id(track);
+
+  heif_track_release(track);
+  heif_track_info_release(info);
+  heif_context_free(ctx);
+
+  RecordingReader recorder;
+  recorder.data = &data;
+  heif_reader reader = get_recording_reader();
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_reader(ctx, &reader, &recorder, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  track = heif_context_get_track(ctx, track_id);
+  REQUIRE(track != nullptr);
+
+  // a buffer that is too small for the first sample
+  uint8_t buffer[32];
+  heif_raw_sequence_sample_info infos[8];
+  int n;
+  err = heif_track_get_next_raw_sequence_samples(track, buffer, 0, infos, 8, &n);
+  REQUIRE(err.code == heif_error_Usage_error);
+  REQUIRE(n == 0);
+
+  recorder.reads.clear();
+
+  int sample_idx = 0;
+  size_t num_reads = 0;
+
+  for (;;) {
+    err = heif_track_get_next_raw_sequence_samples(track, buffer, sizeof(buffer), infos, 8, &n);
+    if (err.code == heif_error_End_of_sequence) {
+      break;
+    }
+    REQUIRE(err.code == heif_error_Ok);
+    REQUIRE(n > 0);
+    REQUIRE(n <= 8);
+
+    num_reads++;
+
+    for (int k = 0; k < n; k++, sample_idx++) {
+      const heif_raw_sequence_sample_info& sample_info = infos[k];
+      REQUIRE(sample_info.data_size == static_cast<uint32_t>(1 + sample_idx % 5));
+      REQUIRE(sample_info.data_offset + sample_info.data_size <= sizeof(buffer));
+      for (uint32_t b = 0; b < sample_info.data_size; b++) {
+        REQUIRE(buffer[sample_info.data_offset + b] == sample_idx);
+      }
+
+      REQUIRE(sample_info.duration == static_cast<uint32_t>(10 + sample_idx));
+
+      REQUIRE(sample_info.has_tai_timestamp == (sample_idx % 2 == 0));
+      if (sample_info.has_tai_timestamp) {
+        REQUIRE(sample_info.tai_timestamp.tai_timestamp == static_cast<uint64_t>(5000 + sample_idx));
+      }
+    }
+  }
+
+  REQUIRE(sample_idx == num_samples);
+
+  // one read for the sample data and one for the TAI timestamps of each call
+  REQUIRE(recorder.reads.size() == 2 * num_reads);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Metadata samples are collected into chunks")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_track_info* info = heif_track_info_alloc();
+  info->with_tai_timestamps = heif_sample_aux_info_presence_mandatory;
+  info->tai_clock_info = heif_tai_clock_info_alloc();
+  info->write_aux_info_interleaved = true;
+  info->max_chunk_size = 16;
+
+  heif_track* track;
+  heif_error err = heif_context_add_uri_metadata_sequence_track(ctx, info, "urn:test:chunks", &track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  const int num_samples = 22;
+
+  for (int i = 0; i < num_samples; i++) {
+    heif_raw_sequence_sample* sample = heif_raw_sequence_sample_alloc();
+    std::vector<uint8_t> metadata(4, static_cast<uint8_t>(i));
+    heif_raw_sequence_sample_set_data(sample, metadata.data(), metadata.size());
+    heif_raw_sequence_sample_set_duration(sample, 5);
+
+    heif_tai_timestamp_packet* tai = heif_tai_timestamp_packet_alloc();
+    tai->tai_timestamp = 1000 + i;
+    heif_raw_sequence_sample_set_tai_timestamp(sample, tai);
+    heif_tai_timestamp_packet_release(tai);
+
+    err = heif_track_add_raw_sequence_sample(track, sample);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_raw_sequence_sample_release(sample);
+  }
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  uint32_t track_id = heif_track_get_id(track);
+
+  heif_track_release(track);
+  heif_track_info_release(info);
+  heif_context_free(ctx);
+
+  // Five chunks with four samples and one with two samples are described by two 'stsc' entries.
+  const uint8_t stsc[] = {'s', 't', 's', 'c'};
+  auto stsc_pos = std::search(data.begin(), data.end(), std::begin(stsc), std::end(stsc));
+  REQUIRE(stsc_pos != data.end());
+  REQUIRE(data.end() - stsc_pos >= 12);
+  REQUIRE(stsc_pos[8] == 0);
+  REQUIRE(stsc_pos[9] == 0);
+  REQUIRE(stsc_pos[10] == 0);
+  REQUIRE(stsc_pos[11] == 2);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  track = heif_context_get_track(ctx, track_id);
+  REQUIRE(track != nullptr);
+
+  for (int i = 0; i < num_samples; i++) {
+    heif_raw_sequence_sample* sample;
+    err = heif_track_get_next_raw_sequence_sample(track, &sample);
+    REQUIRE(err.code == heif_error_Ok);
+
+    size_t size;
+    const uint8_t* sample_data = heif_raw_sequence_sample_get_data(sample, &size);
+    REQUIRE(size == 4);
+    REQUIRE(sample_data[0] == i);
+    REQUIRE(sample_data[3] == i);
+
+    REQUIRE(heif_raw_sequence_sample_has_tai_timestamp(sample));
+    REQUIRE(heif_raw_sequence_sample_get_tai_timestamp(sample)->tai_timestamp == static_cast<uint64_t>(1000 + i));
+
+    heif_raw_sequence_sample_release(sample);
+  }
+
+  heif_raw_sequence_sample* sample;
+  err = heif_track_get_next_raw_sequence_sample(track, &sample);
+  REQUIRE(err.code == heif_error_End_of_sequence);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Bulk reading of TAI timestamps")
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_track_info* info = heif_track_info_alloc();
+  info->with_tai_timestamps = heif_sample_aux_info_presence_optional;
+  info->tai_clock_info = heif_tai_clock_info_alloc();
+
+  heif_track* track;
+  err = heif_context_add_visual_sequence_track(ctx, 64, 48, info, heif_track_type_image_sequence, &track);
+  REQUIRE(err.code == heif_error_Ok);
+
+  const int num_frames = 8;
+
+  for (int i = 0; i < num_frames; i++) {
+    heif_image* img = create_gradient_image(64, 48, i * 11);
+    heif_image_set_duration(img, 100);
+
+    // every third frame without timestamp
+    if (i % 3 != 2) {
+      heif_tai_timestamp_packet* tai = heif_tai_timestamp_packet_alloc();
+      tai->tai_timestamp = 7000 + i;
+      tai->synchronization_state = (i % 2 == 0);
+      heif_image_set_tai_timestamp(img, tai);
+      heif_tai_timestamp_packet_release(tai);
+    }
+
+    err = heif_track_encode_sequence_image(track, img, encoder, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+    heif_image_release(img);
+  }
+
+  std::vector<uint8_t> data;
+  heif_writer writer{1, write_to_vector};
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  uint32_t track_id = heif_track_get_id(track);
+
+  heif_track_release(track);
+  heif_track_info_release(info);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  track = heif_context_get_track(ctx, track_id);
+  REQUIRE(track != nullptr);
+  REQUIRE(heif_track_get_number_of_samples(track) == num_frames);
+
+  uint64_t timestamps[num_frames];
+  uint8_t flags[num_frames];
+  err = heif_track_get_tai_timestamps(track, 0, num_frames, timestamps, flags);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int i = 0; i < num_frames; i++) {
+    if (i % 3 == 2) {
+      REQUIRE(timestamps[i] == 0);
+      REQUIRE(flags[i] == 0);
+    }
+    else {
+      REQUIRE(timestamps[i] == static_cast<uint64_t>(7000 + i));
+      REQUIRE((flags[i] & heif_tai_timestamp_flag_present));
+      REQUIRE(!!(flags[i] & heif_tai_timestamp_flag_synchronized) == (i % 2 == 0));
+      REQUIRE(!(flags[i] & heif_tai_timestamp_flag_modified));
+    }
+  }
+
+  // a part of the track, without flags
+  err = heif_track_get_tai_timestamps(track, 3, 2, timestamps, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(timestamps[0] == 7003);
+  REQUIRE(timestamps[1] == 7004);
+
+  err = heif_track_get_tai_timestamps(track, num_frames - 1, 2, timestamps, flags);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  // decoded frames carry the same timestamps, frames without timestamp can still be decoded
+  for (int i = 0; i < num_frames; i++) {
+    heif_image* img;
+    err = heif_track_decode_next_image(track, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_tai_timestamp_packet* tai = nullptr;
+    err = heif_image_get_tai_timestamp(img, &tai);
+    REQUIRE((tai != nullptr) == (i % 3 != 2));
+    if (tai) {
+      REQUIRE(tai->tai_timestamp == static_cast<uint64_t>(7000 + i));
+      heif_tai_timestamp_packet_release(tai);
+    }
+
+    heif_image_release(img);
+  }
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+}
+
+
+TEST_CASE("Lazy box parsing defers the sequence tracks")
+{
+  std::vector<uint8_t> file_data = encode_sequence(3);
+  auto reference = decode_sequence(file_data, 0);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_lazy_box_parsing(ctx, 1);
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(heif_context_has_sequence(ctx));
+
+  // the first track accesses may come from several threads at once
+  std::vector<int> num_tracks(4);
+  std::vector<std::thread> threads;
+  for (int& n : num_tracks) {
+    threads.emplace_back([ctx, &n]() { n = heif_context_number_of_sequence_tracks(ctx); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(num_tracks == std::vector<int>(4, 1));
+
+  heif_track* track = heif_context_get_track(ctx, 0);
+  REQUIRE(track != nullptr);
+  REQUIRE(decode_next_frame(track) == reference[0]);
+  REQUIRE(decode_next_frame(track) == reference[1]);
+
+  heif_track_release(track);
+  heif_context_free(ctx);
+
+  // Without the 'mvhd' box, the sequence is invalid. This is only detected when the tracks are accessed.
+
+  std::vector<uint8_t> broken_data = file_data;
+  const uint8_t mvhd[4] = {'m', 'v', 'h', 'd'};
+  auto mvhd_pos = std::search(broken_data.begin(), broken_data.end(), mvhd, mvhd + 4);
+  REQUIRE(mvhd_pos != broken_data.end());
+  *mvhd_pos = 'x';
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, broken_data.data(), broken_data.size(), nullptr);
+  REQUIRE(err.code != heif_error_Ok);
+  heif_context_free(ctx);
+
+  ctx = heif_context_alloc();
+  heif_context_set_lazy_box_parsing(ctx, 1);
+  err = heif_context_read_from_memory_without_copy(ctx, broken_data.data(), broken_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_context_get_track(ctx, 0) == nullptr);
+  REQUIRE(heif_context_number_of_sequence_tracks(ctx) == 0);
+
+  // the error is kept for all further track accesses
+  REQUIRE(heif_context_has_sequence(ctx));
+  REQUIRE(heif_context_get_track(ctx, 0) == nullptr);
+
+  heif_sample_multiplexer* multiplexer = nullptr;
+  err = heif_context_create_sample_multiplexer(ctx, nullptr, 0, &multiplexer);
+  REQUIRE(err.code != heif_error_Ok);
+  REQUIRE(multiplexer == nullptr);
+  heif_context_free(ctx);
+}
@@ -0,0 +1,260 @@
+/*
+  libheif unit tests for decoding images to tensors
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "test_utils.h"
+
+
+static std::vector<uint8_t> encode_uncompressed_image(heif_image* image, const heif_color_profile_nclx* nclx = nullptr)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  options->output_nclx_profile = const_cast<heif_color_profile_nclx*>(nclx);
+
+  err = heif_context_encode_image(ctx, image, encoder, options, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_encoding_options_free(options);
+  heif_encoder_release(encoder);
+
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+
+  std::vector<uint8_t> file_data;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_context_free(ctx);
+
+  return file_data;
+}
+
+
+static float half_to_float_value(uint16_t h)
+{
+  int exponent = (h >> 10) & 0x1F;
+  float mantissa = static_cast<float>(h & 0x3FF);
+  float v = (exponent == 0 ? mantissa * std::ldexp(1.0f, -24) : (1024 + mantissa) * std::ldexp(1.0f, exponent - 25));
+  return (h & 0x8000) ? -v : v;
+}
+
+
+TEST_CASE("Decode an image to a float tensor")
+{
+  const int width = 64, height = 48;
+
+  heif_image* image = create_gradient_image(width, height, 10);
+  std::vector<uint8_t> file_data = encode_uncompressed_image(image);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_decoding_threads(ctx, 4);
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  const heif_channel channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+  auto sample = [&](int c, int x, int y) {
+    int stride;
+    const uint8_t* p = heif_image_get_plane_readonly(image, channels[c], &stride);
+    return static_cast<float>(p[y * stride + x]) / 255.0f;
+  };
+
+  // --- planar float32 with the default options
+
+  std::vector<float> tensor(3 * width * height);
+  err = heif_decode_image_to_tensor(handle, nullptr, tensor.data(), tensor.size() * sizeof(float), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int c = 0; c < 3; c++) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        REQUIRE(std::abs(tensor[(c * height + y) * width + x] - sample(c, x, y)) < 1e-6f);
+      }
+    }
+  }
+
+  // --- interleaved float16, normalized
+
+  heif_tensor_options* options = heif_tensor_options_alloc();
+  options->layout = heif_tensor_layout_interleaved;
+  options->datatype = heif_tensor_datatype_float16;
+  const float mean[3] = {0.485f, 0.456f, 0.406f};
+  const float std_dev[3] = {0.229f, 0.224f, 0.225f};
+  for (int c = 0; c < 3; c++) {
+    options->mean[c] = mean[c];
+    options->std[c] = std_dev[c];
+  }
+
+  std::vector<uint16_t> half_tensor(3 * width * height);
+  err = heif_decode_image_to_tensor(handle, options, half_tensor.data(), half_tensor.size() * 2 - 1, nullptr);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  err = heif_decode_image_to_tensor(handle, options, half_tensor.data(), half_tensor.size() * 2, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        float expected = (sample(c, x, y) - mean[c]) / std_dev[c];
+        REQUIRE(std::abs(half_to_float_value(half_tensor[(y * width + x) * 3 + c]) - expected) < 4e-3f);
+      }
+    }
+  }
+
+  // --- scaled to half the size: each value is the average of 2x2 pixels
+
+  options->layout = heif_tensor_layout_planar;
+  options->datatype = heif_tensor_datatype_float32;
+  options->width = width / 2;
+  options->height = height / 2;
+  for (int c = 0; c < 3; c++) {
+    options->mean[c] = 0.0f;
+    options->std[c] = 1.0f;
+  }
+
+  std::vector<float> small_tensor(3 * (width / 2) * (height / 2));
+  err = heif_decode_image_to_tensor(handle, options, small_tensor.data(), small_tensor.size() * sizeof(float), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int c = 0; c < 3; c++) {
+    for (int y = 0; y < height / 2; y++) {
+      for (int x = 0; x < width / 2; x++) {
+        float expected = (sample(c, 2 * x, 2 * y) + sample(c, 2 * x + 1, 2 * y) +
+                          sample(c, 2 * x, 2 * y + 1) + sample(c, 2 * x + 1, 2 * y + 1)) / 4;
+        REQUIRE(std::abs(small_tensor[(c * height / 2 + y) * width / 2 + x] - expected) < 1e-5f);
+      }
+    }
+  }
+
+  heif_tensor_options_free(options);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+  heif_image_release(image);
+}
+
+
+TEST_CASE("Decode a YCbCr 4:2:0 image to a float tensor")
+{
+  const int width = 64, height = 48;
+
+  heif_image* image;
+  heif_error err = heif_image_create(width, height, heif_colorspace_YCbCr, heif_chroma_420, &image);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    int w = (channel == heif_channel_Y ? width : width / 2);
+    int h = (channel == heif_channel_Y ? height : height / 2);
+
+    err = heif_image_add_plane(image, channel, w, h, 8);
+    REQUIRE(err.code == heif_error_Ok);
+
+    int stride;
+    uint8_t* p = heif_image_get_plane(image, channel, &stride);
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        p[y * stride + x] = overlay_layer_value(channel, x, y, 0);
+      }
+    }
+  }
+
+  for (bool full_range : {true, false}) {
+    heif_color_profile_nclx* nclx = heif_nclx_color_profile_alloc();
+    nclx->matrix_coefficients = heif_matrix_coefficients_ITU_R_BT_601_6;
+    nclx->full_range_flag = full_range;
+    heif_image_set_nclx_color_profile(image, nclx);
+
+    std::vector<uint8_t> file_data = encode_uncompressed_image(image, nclx);
+    heif_nclx_color_profile_free(nclx);
+
+    heif_context* ctx = heif_context_alloc();
+    err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    heif_image_handle* handle;
+    err = heif_context_get_primary_image_handle(ctx, &handle);
+    REQUIRE(err.code == heif_error_Ok);
+
+    std::vector<float> tensor(3 * width * height);
+    err = heif_decode_image_to_tensor(handle, nullptr, tensor.data(), tensor.size() * sizeof(float), nullptr);
+    REQUIRE(err.code == heif_error_Ok);
+
+    // The chroma samples are centered between the luma samples, the border samples are repeated.
+    auto chroma = [](heif_channel channel, int x, int y) {
+      float cx = std::clamp((static_cast<float>(x) + 0.5f) / 2 - 0.5f, 0.0f, width / 2 - 1.0f);
+      float cy = std::clamp((static_cast<float>(y) + 0.5f) / 2 - 0.5f, 0.0f, height / 2 - 1.0f);
+      int x0 = static_cast<int>(cx), y0 = static_cast<int>(cy);
+      int x1 = std::min(x0 + 1, width / 2 - 1), y1 = std::min(y0 + 1, height / 2 - 1);
+      float wx = cx - static_cast<float>(x0), wy = cy - static_cast<float>(y0);
+
+      auto v = [&](int px, int py) { return static_cast<float>(overlay_layer_value(channel, px, py, 0)); };
+      float top = v(x0, y0) + wx * (v(x1, y0) - v(x0, y0));
+      float bottom = v(x0, y1) + wx * (v(x1, y1) - v(x0, y1));
+      return top + wy * (bottom - top);
+    };
+
+    const float Kr = 0.299f, Kb = 0.114f, Kg = 1 - Kr - Kb;
+
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        float Y = overlay_layer_value(heif_channel_Y, x, y, 0);
+        float Cb = chroma(heif_channel_Cb, x, y) - 128;
+        float Cr = chroma(heif_channel_Cr, x, y) - 128;
+
+        if (!full_range) {
+          Y = (Y - 16) * 1.1689f;
+          Cb *= 1.1429f;
+          Cr *= 1.1429f;
+        }
+
+        float rgb[3] = {Y + 2 * (1 - Kr) * Cr,
+                        Y - 2 * Kb * (1 - Kb) / Kg * Cb - 2 * Kr * (1 - Kr) / Kg * Cr,
+                        Y + 2 * (1 - Kb) * Cb};
+
+        for (int c = 0; c < 3; c++) {
+          INFO(full_range << " " << c << ": " << x << ";" << y);
+          float expected = std::clamp(rgb[c] / 255, 0.0f, 1.0f);
+          REQUIRE(std::abs(tensor[(c * height + y) * width + x] - expected) < 1e-4f);
+        }
+      }
+    }
+
+    heif_image_handle_release(handle);
+    heif_context_free(ctx);
+  }
+
+  heif_image_release(image);
+}
@@ -27,7 +27,9 @@
 #include "test_utils.h"
 #include "libheif/heif.h"
 #include "test-config.h"
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #include "catch_amalgamated.hpp"
 
 
@@ -170,6 +172,57 @@ struct heif_image * createImage_RGB_planar()
   return image;
 }
 
+struct heif_image * createImage_Mono()
+{
+  struct heif_image *image;
+  struct heif_error err;
+  int w = 1024;
+  int h = 768;
+  err = heif_image_create(w, h, heif_colorspace_monochrome,
+                          heif_chroma_monochrome, &image);
+  if (err.code) {
+    return nullptr;
+  }
+
+  err = heif_image_add_plane(image, heif_channel_Y, w, h, 8);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int stride;
+  uint8_t *p = heif_image_get_plane(image, heif_channel_Y, &stride);
+
+  int y = 0;
+  for (; y < h / 2; y++) {
+    int x = 0;
+    for (; x < w / 3; x++) {
+      p[y * stride + x] = 255;
+    }
+    for (; x < 2 * w / 3; x++) {
+      p[y * stride + x] = 127;
+    }
+    for (; x < w; x++) {
+      p[y * stride + x] = 1;
+    }
+  }
+  for (; y < h; y++) {
+    int x = 0;
+    for (; x < w / 3; x++) {
+      p[y * stride + x] =  (uint8_t) (x % 256);
+    }
+    for (; x < 2 * w / 3; x++) {
+      p[y * stride + x] = (uint8_t) ((255 - x) % 256);
+    }
+    for (; x < w; x++) {
+      p[y * stride + x] =  (uint8_t) ((x + y) % 256);
+    }
+  }
+  if (err.code) {
+    heif_image_release(image);
+    return nullptr;
+  }
+
+  return image;
+}
+
 
 std::string get_path_for_heifio_test_file(std::string filename)
 {
@@ -219,3 +272,262 @@ std::string get_tests_output_file_path(const char* filename)
   dir /= filename;
   return dir.string();
 }
+
+
+heif_error write_to_vector(struct heif_context*, const void* data, size_t size, void* userdata)
+{
+  auto* out = static_cast<std::vector<uint8_t>*>(userdata);
+  out->insert(out->end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+  return heif_error_success;
+}
+
+
+std::vector<uint8_t> encode_grid(heif_image** tiles, int max_encoding_threads, int thread_budget)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, max_encoding_threads);
+  heif_context_set_encoding_thread_budget(ctx, thread_budget);
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_encode_grid(ctx, tiles, 3, 2, encoder, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  return data;
+}
+
+
+std::vector<uint8_t> decode_grid(const std::vector<uint8_t>& file_data, int max_decoding_threads,
+                                        uint64_t max_total_memory)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_decoding_threads(ctx, max_decoding_threads);
+  heif_context_get_security_limits(ctx)->max_total_memory = max_total_memory;
+
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int stride;
+  const uint8_t* p = heif_image_get_plane_readonly(img, heif_channel_interleaved, &stride);
+  int width = heif_image_get_width(img, heif_channel_interleaved);
+  int height = heif_image_get_height(img, heif_channel_interleaved);
+
+  std::vector<uint8_t> pixels;
+  for (int y = 0; y < height; y++) {
+    pixels.insert(pixels.end(), p + y * stride, p + y * stride + width * 3);
+  }
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  return pixels;
+}
+
+
+heif_image* create_gradient_image(int w, int h, int seed)
+{
+  heif_image* image;
+  heif_error err = heif_image_create(w, h, heif_colorspace_RGB, heif_chroma_444, &image);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    err = heif_image_add_plane(image, channel, w, h, 8);
+    REQUIRE(err.code == heif_error_Ok);
+  }
+
+  int stride;
+  uint8_t* r = heif_image_get_plane(image, heif_channel_R, &stride);
+  uint8_t* g = heif_image_get_plane(image, heif_channel_G, &stride);
+  uint8_t* b = heif_image_get_plane(image, heif_channel_B, &stride);
+
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      r[y * stride + x] = static_cast<uint8_t>(x + seed);
+      g[y * stride + x] = static_cast<uint8_t>(y * 3 + seed);
+      b[y * stride + x] = static_cast<uint8_t>(x * y + seed * 7);
+    }
+  }
+
+  return image;
+}
+
+
+std::vector<uint8_t> get_interleaved_pixels(const heif_image* img, int x0, int y0, int w, int h)
+{
+  int stride;
+  const uint8_t* p = heif_image_get_plane_readonly(img, heif_channel_interleaved, &stride);
+
+  std::vector<uint8_t> pixels;
+  for (int y = y0; y < y0 + h; y++) {
+    pixels.insert(pixels.end(), p + y * stride + x0 * 3, p + y * stride + (x0 + w) * 3);
+  }
+
+  return pixels;
+}
+
+
+heif_reader get_recording_reader()
+{
+  heif_reader reader{};
+  reader.reader_api_version = 2;
+  reader.get_position = [](void* userdata) -> int64_t { return static_cast<RecordingReader*>(userdata)->position; };
+  reader.read = [](void* buffer, size_t size, void* userdata) -> int {
+    auto* r = static_cast<RecordingReader*>(userdata);
+    if (r->position + size > r->data->size()) {
+      return 1;
+    }
+    memcpy(buffer, r->data->data() + r->position, size);
+    r->reads.emplace_back(r->position, r->position + size);
+    r->position += size;
+    return 0;
+  };
+  reader.seek = [](int64_t position, void* userdata) -> int {
+    static_cast<RecordingReader*>(userdata)->position = position;
+    return 0;
+  };
+  reader.wait_for_file_size = [](int64_t target_size, void* userdata) {
+    auto* r = static_cast<RecordingReader*>(userdata);
+    return static_cast<uint64_t>(target_size) <= r->data->size() ? heif_reader_grow_status_size_reached : heif_reader_grow_status_size_beyond_eof;
+  };
+  reader.request_range = [](uint64_t start_pos, uint64_t end_pos, void* userdata) {
+    auto* r = static_cast<RecordingReader*>(userdata);
+    r->range_requests.emplace_back(start_pos, end_pos);
+    heif_reader_range_request_result result{};
+    result.status = end_pos <= r->data->size() ? heif_reader_grow_status_size_reached : heif_reader_grow_status_size_beyond_eof;
+    result.range_end = std::min(end_pos, static_cast<uint64_t>(r->data->size()));
+    return result;
+  };
+  reader.preload_range_hint = [](uint64_t start_pos, uint64_t end_pos, void* userdata) {
+    static_cast<RecordingReader*>(userdata)->preload_hints.emplace_back(start_pos, end_pos);
+  };
+  reader.release_file_range = [](uint64_t, uint64_t, void*) {};
+  return reader;
+}
+
+
+std::vector<uint8_t> decode_primary_image(heif_context* ctx)
+{
+  heif_image_handle* handle;
+  heif_error err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> pixels = get_interleaved_pixels(img, 0, 0, heif_image_get_width(img, heif_channel_interleaved),
+                                                       heif_image_get_height(img, heif_channel_interleaved));
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+
+  return pixels;
+}
+
+
+std::vector<uint8_t> get_planar_pixels(const heif_image* img)
+{
+  int w = heif_image_get_width(img, heif_channel_R);
+  int h = heif_image_get_height(img, heif_channel_R);
+
+  std::vector<uint8_t> pixels;
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    int stride;
+    const uint8_t* p = heif_image_get_plane_readonly(img, channel, &stride);
+    for (int y = 0; y < h; y++) {
+      pixels.insert(pixels.end(), p + y * stride, p + y * stride + w);
+    }
+  }
+
+  return pixels;
+}
+
+
+heif_image* create_uniform_image(int w, int h, uint8_t value)
+{
+  heif_image* image;
+  heif_error err = heif_image_create(w, h, heif_colorspace_RGB, heif_chroma_444, &image);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    err = heif_image_add_plane(image, channel, w, h, 8);
+    REQUIRE(err.code == heif_error_Ok);
+
+    int stride;
+    uint8_t* p = heif_image_get_plane(image, channel, &stride);
+    for (int y = 0; y < h; y++) {
+      memset(p + y * stride, value, w);
+    }
+  }
+
+  return image;
+}
+
+
+uint8_t overlay_layer_value(heif_channel channel, int x, int y, int layer)
+{
+  return static_cast<uint8_t>(x * 7 + y * 13 + layer * 51 + channel * 29);
+}
+
+
+std::vector<std::vector<uint8_t>> decode_primary_image_ycbcr420(const std::vector<uint8_t>& file_data,
+                                                                int max_decoding_threads)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_decoding_threads(ctx, max_decoding_threads);
+
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* img;
+  err = heif_decode_image(handle, &img, heif_colorspace_YCbCr, heif_chroma_420, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<std::vector<uint8_t>> planes;
+
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    int width = heif_image_get_width(img, channel);
+    int height = heif_image_get_height(img, channel);
+
+    int stride;
+    const uint8_t* p = heif_image_get_plane_readonly(img, channel, &stride);
+
+    std::vector<uint8_t> pixels;
+    for (int y = 0; y < height; y++) {
+      pixels.insert(pixels.end(), p + y * stride, p + y * stride + width);
+    }
+
+    planes.push_back(pixels);
+  }
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  return planes;
+}
@@ -24,7 +24,12 @@
   SOFTWARE.
 */
 
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "libheif/heif.h"
 
 #include <filesystem>
@@ -43,6 +48,7 @@ struct heif_image * get_primary_image_ycbcr(heif_image_handle * handle, heif_chr
 void fill_new_plane(heif_image* img, heif_channel channel, int w, int h);
 
 struct heif_image * createImage_RGB_planar();
+struct heif_image * createImage_Mono();
 
 std::string get_path_for_heifio_test_file(std::string filename);
 
@@ -51,3 +57,50 @@ heif_encoder* get_encoder_or_skip_test(heif_compression_format format);
 fs::path get_tests_output_dir();
 
 std::string get_tests_output_file_path(const char* filename);
+
+// heif_writer callback that appends the written data to the std::vector<uint8_t> passed as 'userdata'.
+heif_error write_to_vector(struct heif_context*, const void* data, size_t size, void* userdata);
+
+// Encodes the six tiles as a 3x2 grid image with the 'unci' encoder and returns the file data.
+std::vector<uint8_t> encode_grid(heif_image** tiles, int max_encoding_threads, int thread_budget = 0);
+
+// Decodes the primary image to interleaved RGB and returns the pixels without row padding.
+std::vector<uint8_t> decode_grid(const std::vector<uint8_t>& file_data, int max_decoding_threads,
+                                 uint64_t max_total_memory = 0);
+
+// Creates an 8-bit planar RGB image with a gradient pattern that depends on 'seed'.
+heif_image* create_gradient_image(int w, int h, int seed);
+
+// Returns the pixels of the given area of an interleaved RGB image without row padding.
+std::vector<uint8_t> get_interleaved_pixels(const heif_image* img, int x0, int y0, int w, int h);
+
+struct RecordingReader
+{
+  const std::vector<uint8_t>* data = nullptr;
+  int64_t position = 0;
+  std::vector<std::pair<uint64_t, uint64_t>> preload_hints;
+  std::vector<std::pair<uint64_t, uint64_t>> async_requests;
+  std::vector<std::pair<uint64_t, uint64_t>> range_requests;
+  std::vector<std::pair<uint64_t, uint64_t>> reads;
+  std::vector<std::thread> completion_threads;
+  std::atomic<int> positional_reads{0};
+};
+
+// heif_reader (API version 2) reading from the RecordingReader passed as userdata and recording all requests.
+heif_reader get_recording_reader();
+
+// Decodes the primary image of the context to interleaved RGB and returns the pixels without row padding.
+std::vector<uint8_t> decode_primary_image(heif_context* ctx);
+
+// Returns the R, G and B planes of an 8-bit planar RGB image one after the other, without row padding.
+std::vector<uint8_t> get_planar_pixels(const heif_image* img);
+
+// Creates an 8-bit planar RGB image with all samples set to 'value'.
+heif_image* create_uniform_image(int w, int h, uint8_t value);
+
+// Sample value of a test pattern at (x,y). The pattern differs for each channel and for each 'layer'.
+uint8_t overlay_layer_value(heif_channel channel, int x, int y, int layer);
+
+// Decodes the primary image to YCbCr 4:2:0 and returns the Y, Cb and Cr planes without row padding.
+std::vector<std::vector<uint8_t>> decode_primary_image_ycbcr420(const std::vector<uint8_t>& file_data,
+                                                                int max_decoding_threads);
@@ -0,0 +1,104 @@
+/*
+  libheif unit tests for the shared thread pool
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include "libheif/heif.h"
+#include <cstdint>
+#include <vector>
+#include "test_utils.h"
+
+
+TEST_CASE("Decode grid with the shared thread pool")
+{
+  heif_image* tiles[6];
+  for (heif_image*& tile : tiles) {
+    tile = createImage_RGB_planar();
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  std::vector<uint8_t> sequential = decode_grid(file_data, 0);
+  REQUIRE(!sequential.empty());
+
+  int default_pool_size = heif_get_thread_pool_size();
+  REQUIRE(default_pool_size >= 1);
+
+  REQUIRE(decode_grid(file_data, 4) == sequential);
+
+  // a memory budget that is smaller than one tile still decodes one tile at a time
+  REQUIRE(decode_grid(file_data, 4, 1) == sequential);
+
+  heif_set_thread_pool_size(1);
+  REQUIRE(heif_get_thread_pool_size() == 1);
+  REQUIRE(decode_grid(file_data, 4) == sequential);
+
+  // without worker threads, everything is done in the calling thread
+  heif_set_thread_pool_size(0);
+  REQUIRE(decode_grid(file_data, 4) == sequential);
+
+  heif_set_thread_pool_size(default_pool_size);
+}
+
+
+TEST_CASE("Decode grid with pinned worker threads")
+{
+  heif_image* tiles[6];
+  for (heif_image*& tile : tiles) {
+    tile = createImage_RGB_planar();
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  std::vector<uint8_t> sequential = decode_grid(file_data, 0);
+  REQUIRE(!sequential.empty());
+
+  heif_thread_pool_options* options = heif_thread_pool_options_alloc();
+
+  int invalid_cpu = -1;
+  options->cpus = &invalid_cpu;
+  options->num_cpus = 1;
+  REQUIRE(heif_set_thread_pool_options(options).code == heif_error_Usage_error);
+
+  int cpu = 0;
+  options->cpus = &cpu;
+  options->priority_reduction = 1;
+  options->numa_aware = 1;
+  REQUIRE(heif_set_thread_pool_options(options).code == heif_error_Ok);
+  REQUIRE(decode_grid(file_data, 4) == sequential);
+
+  heif_thread_pool_options_free(options);
+
+  REQUIRE(heif_set_thread_pool_options(nullptr).code == heif_error_Ok);
+  REQUIRE(decode_grid(file_data, 4) == sequential);
+}
@@ -26,6 +26,7 @@
 
 #include "catch_amalgamated.hpp"
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include "heifio/decoder.h"
 #include "heifio/decoder_tiff.h"
@@ -139,6 +140,48 @@ TEST_CASE("rgba_planar") {
   REQUIRE(err.code == heif_error_Ok);
   checkRGBA(input_image);
 }
+
+static void checkSamePixels(const InputImage& a, const InputImage& b) {
+  int w = heif_image_get_width(a.image.get(), heif_channel_interleaved);
+  int h = heif_image_get_height(a.image.get(), heif_channel_interleaved);
+  int bytesPerPixel = heif_image_get_bits_per_pixel(a.image.get(), heif_channel_interleaved) / 8;
+
+  size_t strideA, strideB;
+  const uint8_t* pA = heif_image_get_plane_readonly2(a.image.get(), heif_channel_interleaved, &strideA);
+  const uint8_t* pB = heif_image_get_plane_readonly2(b.image.get(), heif_channel_interleaved, &strideB);
+
+  for (int y = 0; y < h; y++) {
+    REQUIRE(memcmp(pA + y * strideA, pB + y * strideB, w * bytesPerPixel) == 0);
+  }
+}
+
+TEST_CASE("rgb_tiled") {
+  InputImage input_image;
+  std::string path = get_path_for_heifio_test_file("rgb_tiled.tif");
+  heif_error err = loadTIFF(path.c_str(), &input_image);
+  REQUIRE(err.code == heif_error_Ok);
+  checkRGB(input_image);
+
+  InputImage strip_image;
+  path = get_path_for_heifio_test_file("rgb.tif");
+  err = loadTIFF(path.c_str(), &strip_image);
+  REQUIRE(err.code == heif_error_Ok);
+  checkSamePixels(input_image, strip_image);
+}
+
+TEST_CASE("rgba_planar_tiled") {
+  InputImage input_image;
+  std::string path = get_path_for_heifio_test_file("rgba_planar_tiled.tif");
+  heif_error err = loadTIFF(path.c_str(), &input_image);
+  REQUIRE(err.code == heif_error_Ok);
+  checkRGBA(input_image);
+
+  InputImage strip_image;
+  path = get_path_for_heifio_test_file("rgba_planar.tif");
+  err = loadTIFF(path.c_str(), &strip_image);
+  REQUIRE(err.code == heif_error_Ok);
+  checkSamePixels(input_image, strip_image);
+}
 #else
 TEST_CASE("no_tiff dummy") {
   // Dummy test if we don't have the TIFF library, so that testing does not fail with "No test ran".
@@ -29,7 +29,12 @@
 #include "libheif/heif.h"
 #include "codecs/uncompressed/unc_types.h"
 #include "codecs/uncompressed/unc_boxes.h"
+#include "codecs/uncompressed/decoder_abstract.h"
+#include "codecs/uncompressed/unc_codec.h"
+#include "bitstream.h"
 #include <cstdint>
+#include <cstring>
+#include <vector>
 #include <iostream>
 
 
@@ -387,6 +392,63 @@ TEST_CASE("cmpC_defl") {
 }
 
 
+TEST_CASE("cpat") {
+    std::vector<uint8_t> byteArray{
+      0x00, 0x00, 0x00, 0x30, 'c', 'p', 'a', 't',
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02,
+      0x00, 0x00, 0x00, 0x00, 0x3f, 0x80, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x01, 0x3f, 0x80, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x01, 0x3f, 0x80, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x02, 0x3f, 0x80, 0x00, 0x00
+      };
+
+    auto reader = std::make_shared<StreamReader_memory>(byteArray.data(),
+                                                        byteArray.size(), false);
+
+    BitstreamRange range(reader, byteArray.size());
+    std::shared_ptr<Box> box;
+    Error error = Box::read(range, &box, heif_get_global_security_limits());
+    REQUIRE(error == Error::Ok);
+    REQUIRE(range.error() == 0);
+
+    std::shared_ptr<Box_cpat> cpat = std::dynamic_pointer_cast<Box_cpat>(box);
+    REQUIRE(cpat != nullptr);
+    REQUIRE(cpat->get_pattern_width() == 2);
+    REQUIRE(cpat->get_pattern_height() == 2);
+    REQUIRE(cpat->get_components().size() == 4);
+    REQUIRE(cpat->get_components()[0].component_index == 0);
+    REQUIRE(cpat->get_components()[1].component_index == 1);
+    REQUIRE(cpat->get_components()[2].component_index == 1);
+    REQUIRE(cpat->get_components()[3].component_index == 2);
+
+    StreamWriter writer;
+    Error err = cpat->write(writer);
+    REQUIRE(err.error_code == heif_error_Ok);
+    REQUIRE(writer.get_data() == byteArray);
+
+    std::shared_ptr<Box_cmpd> cmpd = std::make_shared<Box_cmpd>();
+    for (uint16_t type : {component_type_red, component_type_green, component_type_blue}) {
+      Box_cmpd::Component component;
+      component.component_type = type;
+      cmpd->add_component(component);
+    }
+
+    auto pattern = get_filter_array_pattern(cpat, cmpd);
+    REQUIRE(!pattern.error);
+    REQUIRE(pattern.value.width == 2);
+    REQUIRE(pattern.value.height == 2);
+    REQUIRE(pattern.value.at(0, 0) == heif_channel_R);
+    REQUIRE(pattern.value.at(1, 0) == heif_channel_G);
+    REQUIRE(pattern.value.at(0, 1) == heif_channel_G);
+    REQUIRE(pattern.value.at(1, 1) == heif_channel_B);
+    REQUIRE(pattern.value.at(3, 2) == heif_channel_G);
+
+    std::shared_ptr<Box_cmpd> short_cmpd = std::make_shared<Box_cmpd>();
+    short_cmpd->add_component(cmpd->get_components()[0]);
+    REQUIRE(get_filter_array_pattern(cpat, short_cmpd).error.error_code == heif_error_Invalid_input);
+}
+
+
 TEST_CASE("cmpC_zlib") {
     std::vector<uint8_t> byteArray{
       0x00, 0x00, 0x00, 0x11, 'c', 'm', 'p', 'C',
@@ -644,3 +706,65 @@ TEST_CASE("icef_bad_version") {
     REQUIRE(error.sub_error_code == heif_suberror_Unsupported_data_version);
     REQUIRE(error.message == std::string("icef box data version 1 is not implemented yet"));
 }
+
+
+static std::vector<uint16_t> read_samples_with_bitreader(const std::vector<uint8_t>& data, uint32_t num_samples, int bits)
+{
+  BitReader reader(data.data(), (int)data.size());
+  std::vector<uint16_t> samples;
+  for (uint32_t i = 0; i < num_samples; i++) {
+    samples.push_back((uint16_t)reader.get_bits(bits));
+  }
+  return samples;
+}
+
+static std::vector<uint16_t> native_row_to_samples(const std::vector<uint8_t>& row, uint32_t num_samples, uint32_t bytes_per_sample)
+{
+  std::vector<uint16_t> samples;
+  for (uint32_t i = 0; i < num_samples; i++) {
+    if (bytes_per_sample == 1) {
+      samples.push_back(row[i]);
+    }
+    else {
+      uint16_t v;
+      memcpy(&v, &row[2 * i], 2);
+      samples.push_back(v);
+    }
+  }
+  return samples;
+}
+
+TEST_CASE("unc_row_decoders")
+{
+  std::vector<uint8_t> data(200);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+
+  SECTION("packed") {
+    for (uint32_t bits : {1, 3, 7, 10, 12, 13, 16}) {
+      for (uint32_t num_samples : {1, 2, 3, 4, 5, 7, 31, 64}) {
+        uint32_t bytes_per_sample = (bits + 7) / 8;
+        std::vector<uint8_t> row(num_samples * bytes_per_sample);
+        unc_packed_row_to_native(data.data(), row.data(), num_samples, bits, bytes_per_sample);
+
+        REQUIRE(native_row_to_samples(row, num_samples, bytes_per_sample) ==
+                read_samples_with_bitreader(data, num_samples, (int)bits));
+      }
+    }
+  }
+
+  SECTION("be16") {
+    for (uint32_t num_samples : {1, 7, 8, 9, 33, 100}) {
+      std::vector<uint8_t> row(num_samples * 2);
+      unc_be16_row_to_native(data.data(), row.data(), num_samples, 0x0FFF);
+
+      std::vector<uint16_t> expected = read_samples_with_bitreader(data, num_samples, 16);
+      for (auto& v : expected) {
+        v &= 0x0FFF;
+      }
+
+      REQUIRE(native_row_to_samples(row, num_samples, 2) == expected);
+    }
+  }
+}
@@ -26,10 +26,12 @@
 #include "catch_amalgamated.hpp"
 #include "libheif/heif.h"
 #include "libheif/api_structs.h"
+#include "libheif/heif_tracing.h"
 #include <cstdint>
 #include <stdio.h>
 #include "test_utils.h"
 #include <string.h>
+#include <atomic>
 
 #include "uncompressed_decode.h"
 
@@ -167,3 +169,75 @@ TEST_CASE("check uncompressed is advertised") {
   REQUIRE(heif_have_decoder_for_format(heif_compression_uncompressed));
 }
 
+
+TEST_CASE("check decoding statistics") {
+  auto file = GENERATE(FILES, MONO_FILES, YUV_FILES);
+  auto context = get_context_for_test_file(file);
+  INFO("file name: " << file);
+  heif_image_handle *handle = get_primary_image_handle(context);
+
+  heif_decoding_statistics *statistics = heif_decoding_statistics_alloc();
+  REQUIRE(statistics != nullptr);
+  REQUIRE(statistics->version >= 1);
+
+  heif_decoding_options *options = heif_decoding_options_alloc();
+  options->statistics = statistics;
+
+  heif_image *img = nullptr;
+  heif_error err = heif_decode_image(handle, &img, heif_colorspace_undefined, heif_chroma_undefined, options);
+  REQUIRE(err.code == heif_error_Ok);
+
+  REQUIRE(statistics->bytes_read > 0);
+  REQUIRE(statistics->num_codec_decodes >= 1);
+  REQUIRE(statistics->num_planes_allocated > 0);
+  REQUIRE(statistics->bytes_allocated > 0);
+  REQUIRE(statistics->total_time_us >= statistics->codec_time_us);
+
+  // values accumulate over several decoding calls
+  uint64_t num_codec_decodes = statistics->num_codec_decodes;
+  heif_image_release(img);
+  err = heif_decode_image(handle, &img, heif_colorspace_undefined, heif_chroma_undefined, options);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(statistics->num_codec_decodes == 2 * num_codec_decodes);
+
+  heif_image_release(img);
+  heif_decoding_options_free(options);
+  heif_decoding_statistics_free(statistics);
+  heif_image_handle_release(handle);
+  heif_context_free(context);
+}
+
+static void count_trace_event(const heif_trace_event* event, void* user_data)
+{
+  if (strcmp(event->category, "decode") == 0) {
+    (*static_cast<std::atomic<int>*>(user_data))++;
+  }
+}
+
+TEST_CASE("check trace sink") {
+  std::atomic<int> num_decode_events{0};
+
+  heif_trace_sink sink{};
+  sink.version = 1;
+  sink.trace_event = count_trace_event;
+
+  heif_error err = heif_set_trace_sink(&sink, &num_decode_events);
+  if (!heif_have_tracing_support()) {
+    REQUIRE(err.code == heif_error_Unsupported_feature);
+    return;
+  }
+  REQUIRE(err.code == heif_error_Ok);
+
+  auto context = get_context_for_test_file("uncompressed_comp_RGB.heif");
+  heif_image_handle *handle = get_primary_image_handle(context);
+  heif_image *img = nullptr;
+  err = heif_decode_image(handle, &img, heif_colorspace_undefined, heif_chroma_undefined, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_set_trace_sink(nullptr, nullptr);
+  REQUIRE(num_decode_events > 0);
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(context);
+}
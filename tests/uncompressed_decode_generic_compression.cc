@@ -30,6 +30,8 @@
 #include <stdio.h>
 #include "test_utils.h"
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "uncompressed_decode.h"
 
@@ -214,3 +216,37 @@ TEST_CASE("check image content") {
   check_image_content(context);
   heif_context_free(context);
 }
+
+static std::vector<uint8_t> decode_planes(const std::string& file, int max_decoding_threads) {
+  auto context = get_context_for_test_file(file);
+  heif_context_set_max_decoding_threads(context, max_decoding_threads);
+
+  heif_image_handle *handle = get_primary_image_handle(context);
+  heif_image *img = get_primary_image(handle);
+
+  std::vector<uint8_t> pixels;
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    int stride;
+    const uint8_t *plane = heif_image_get_plane_readonly(img, channel, &stride);
+    int width = heif_image_get_width(img, channel);
+    int height = heif_image_get_height(img, channel);
+    for (int y = 0; y < height; y++) {
+      pixels.insert(pixels.end(), plane + y * stride, plane + y * stride + width);
+    }
+  }
+
+  heif_image_release(img);
+  heif_image_handle_release(handle);
+  heif_context_free(context);
+
+  return pixels;
+}
+
+TEST_CASE("decode tiles in parallel") {
+  auto file = GENERATE(FILES_GENERIC_COMPRESSED);
+  INFO("file name: " << file);
+
+  std::vector<uint8_t> sequential = decode_planes(file, 0);
+  REQUIRE(!sequential.empty());
+  REQUIRE(decode_planes(file, 4) == sequential);
+}
@@ -27,6 +27,9 @@
 #include "catch_amalgamated.hpp"
 #include "libheif/api_structs.h"
 #include "libheif/heif.h"
+#include "libheif/heif_experimental.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <string.h>
 #include "test_utils.h"
@@ -49,58 +52,6 @@ TEST_CASE("check have uncompressed")
 }
 
 
-struct heif_image *createImage_Mono()
-{
-  struct heif_image *image;
-  struct heif_error err;
-  int w = 1024;
-  int h = 768;
-  err = heif_image_create(w, h, heif_colorspace_monochrome,
-                          heif_chroma_monochrome, &image);
-  if (err.code) {
-    return nullptr;
-  }
-
-  err = heif_image_add_plane(image, heif_channel_Y, w, h, 8);
-  REQUIRE(err.code == heif_error_Ok);
-
-  int stride;
-  uint8_t *p = heif_image_get_plane(image, heif_channel_Y, &stride);
-
-  int y = 0;
-  for (; y < h / 2; y++) {
-    int x = 0;
-    for (; x < w / 3; x++) {
-      p[y * stride + x] = 255;
-    }
-    for (; x < 2 * w / 3; x++) {
-      p[y * stride + x] = 127;
-    }
-    for (; x < w; x++) {
-      p[y * stride + x] = 1;
-    }
-  }
-  for (; y < h; y++) {
-    int x = 0;
-    for (; x < w / 3; x++) {
-      p[y * stride + x] =  (uint8_t) (x % 256);
-    }
-    for (; x < 2 * w / 3; x++) {
-      p[y * stride + x] = (uint8_t) ((255 - x) % 256);
-    }
-    for (; x < w; x++) {
-      p[y * stride + x] =  (uint8_t) ((x + y) % 256);
-    }
-  }
-  if (err.code) {
-    heif_image_release(image);
-    return nullptr;
-  }
-
-  return image;
-}
-
-
 struct heif_image *createImage_YCbCr()
 {
   struct heif_image *image;
@@ -670,42 +621,42 @@ TEST_CASE("Encode YCBCr")
 TEST_CASE("Encode RRRGGBB_LE 10 bit")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBB_LE, 10, true, false);
-  do_encode(input_image, "encode_rrggbb_10_le.heif", false);
+  do_encode(input_image, "encode_rrggbb_10_le.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBB_BE 10 bit ")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBB_BE, 10, false, false);
-  do_encode(input_image, "encode_rrggbb_10_be.heif", false);
+  do_encode(input_image, "encode_rrggbb_10_be.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBB_LE 12 bit")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBB_LE, 12, true, false);
-  do_encode(input_image, "encode_rrggbb_12_le.heif", false);
+  do_encode(input_image, "encode_rrggbb_12_le.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBB_BE 12 bit ")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBB_BE, 12, false, false);
-  do_encode(input_image, "encode_rrggbb_12_be.heif", false);
+  do_encode(input_image, "encode_rrggbb_12_be.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBB_LE 16 bit")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBB_LE, 16, true, false);
-  do_encode(input_image, "encode_rrggbb_16_le.heif", false);
+  do_encode(input_image, "encode_rrggbb_16_le.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBB_BE 16 bit ")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBB_BE, 16, false, false);
-  do_encode(input_image, "encode_rrggbb_16_be.heif", false);
+  do_encode(input_image, "encode_rrggbb_16_be.heif", true);
 }
 
 
@@ -725,42 +676,42 @@ TEST_CASE("Encode RGBA Version 1")
 TEST_CASE("Encode RRRGGBBAA_LE 10 bit")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBBAA_LE, 10, true, true);
-  do_encode(input_image, "encode_rrggbbaa_10_le.heif", false);
+  do_encode(input_image, "encode_rrggbbaa_10_le.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBBAA_BE 10 bit ")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBBAA_BE, 10, false, true);
-  do_encode(input_image, "encode_rrggbbaa_10_be.heif", false);
+  do_encode(input_image, "encode_rrggbbaa_10_be.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBBAA_LE 12 bit")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBBAA_LE, 12, true, true);
-  do_encode(input_image, "encode_rrggbbaa_12_le.heif", false);
+  do_encode(input_image, "encode_rrggbbaa_12_le.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBBAA_BE 12 bit ")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBBAA_BE, 12, false, true);
-  do_encode(input_image, "encode_rrggbbaa_12_be.heif", false);
+  do_encode(input_image, "encode_rrggbbaa_12_be.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBBAA_LE 16 bit")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBBAA_LE, 16, true, true);
-  do_encode(input_image, "encode_rrggbbaa_16_le.heif", false);
+  do_encode(input_image, "encode_rrggbbaa_16_le.heif", true);
 }
 
 
 TEST_CASE("Encode RRRGGBBAA_BE 16 bit ")
 {
   heif_image *input_image = createImage_RRGGBB_interleaved(heif_chroma_interleaved_RRGGBBAA_BE, 16, false, true);
-  do_encode(input_image, "encode_rrggbbaa_16_be.heif", false);
+  do_encode(input_image, "encode_rrggbbaa_16_be.heif", true);
 }
 
 
@@ -776,3 +727,769 @@ TEST_CASE("Encode RGBA planar")
   heif_image *input_image = createImage_RGBA_planar();
   do_encode(input_image, "encode_rgba_planar.heif", true);
 }
+
+
+static heif_image* encode_and_decode(heif_image* input_image)
+{
+  heif_context* ctx = heif_context_alloc();
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  err = heif_context_encode_image(ctx, input_image, encoder, nullptr, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  heif_context* decode_ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(decode_ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle = get_primary_image_handle(decode_ctx);
+  heif_image* decoded;
+  err = heif_decode_image(handle, &decoded, heif_colorspace_undefined, heif_chroma_undefined, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle_release(handle);
+  heif_context_free(decode_ctx);
+
+  return decoded;
+}
+
+
+TEST_CASE("Encode high bit depth planes")
+{
+  // odd width, so that the rows of the input image are padded
+  const int w = 37;
+  const int h = 5;
+
+  heif_image* image;
+  heif_error err = heif_image_create(w, h, heif_colorspace_monochrome, heif_chroma_monochrome, &image);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_image_add_plane(image, heif_channel_Y, w, h, 10);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_image_add_plane(image, heif_channel_Alpha, w, h, 10);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Alpha}) {
+    int stride;
+    uint8_t* p = heif_image_get_plane(image, channel, &stride);
+    for (int y = 0; y < h; y++) {
+      auto* row = reinterpret_cast<uint16_t*>(p + y * stride);
+      for (int x = 0; x < w; x++) {
+        row[x] = static_cast<uint16_t>((x * 29 + y * 101 + channel) & 0x3FF);
+      }
+    }
+  }
+
+  heif_image* decoded = encode_and_decode(image);
+  REQUIRE(heif_image_get_colorspace(decoded) == heif_colorspace_monochrome);
+
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Alpha}) {
+    REQUIRE(heif_image_get_bits_per_pixel_range(decoded, channel) == 10);
+
+    int stride_in, stride_out;
+    const uint8_t* in = heif_image_get_plane_readonly(image, channel, &stride_in);
+    const uint8_t* out = heif_image_get_plane_readonly(decoded, channel, &stride_out);
+    for (int y = 0; y < h; y++) {
+      REQUIRE(memcmp(in + y * stride_in, out + y * stride_out, w * 2) == 0);
+    }
+  }
+
+  heif_image_release(decoded);
+  heif_image_release(image);
+}
+
+
+TEST_CASE("Encode little-endian RRGGBB")
+{
+  const int w = 37;
+  const int h = 5;
+
+  heif_image* image;
+  heif_error err = heif_image_create(w, h, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBB_LE, &image);
+  REQUIRE(err.code == heif_error_Ok);
+  err = heif_image_add_plane(image, heif_channel_interleaved, w, h, 12);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int stride;
+  uint8_t* p = heif_image_get_plane(image, heif_channel_interleaved, &stride);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w * 3; x++) {
+      uint16_t v = static_cast<uint16_t>((x * 67 + y * 13) & 0xFFF);
+      p[y * stride + 2 * x] = static_cast<uint8_t>(v & 0xFF);
+      p[y * stride + 2 * x + 1] = static_cast<uint8_t>(v >> 8);
+    }
+  }
+
+  heif_image* decoded = encode_and_decode(image);
+  REQUIRE(heif_image_get_colorspace(decoded) == heif_colorspace_RGB);
+  REQUIRE(heif_image_get_chroma_format(decoded) == heif_chroma_444);
+
+  const heif_channel channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+  for (int c = 0; c < 3; c++) {
+    int stride_out;
+    const uint8_t* out = heif_image_get_plane_readonly(decoded, channels[c], &stride_out);
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        uint16_t expected = static_cast<uint16_t>(p[y * stride + 6 * x + 2 * c] | (p[y * stride + 6 * x + 2 * c + 1] << 8));
+        uint16_t decoded_value;
+        memcpy(&decoded_value, out + y * stride_out + 2 * x, 2);
+        REQUIRE(decoded_value == expected);
+      }
+    }
+  }
+
+  heif_image_release(decoded);
+  heif_image_release(image);
+}
+
+
+TEST_CASE("Encode grid with multiple threads")
+{
+  heif_image* tiles[6];
+  for (heif_image*& tile : tiles) {
+    tile = createImage_RGB_planar();
+  }
+
+  std::vector<uint8_t> sequential = encode_grid(tiles, 0);
+  std::vector<uint8_t> parallel = encode_grid(tiles, 4);
+
+  REQUIRE(!sequential.empty());
+  REQUIRE(sequential == parallel);
+
+  // fewer threads in the budget than parallel encodes
+  REQUIRE(encode_grid(tiles, 4, 2) == sequential);
+
+  // encoders keep their own thread settings
+  REQUIRE(encode_grid(tiles, 4, -1) == sequential);
+
+  // a single encoder, with the color conversion of the next tile in a second thread
+  REQUIRE(encode_grid(tiles, 1) == sequential);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+}
+
+
+TEST_CASE("Grid tiles are converted to the output format while decoding")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  // reference: decode the planar RGB canvas and interleave it here
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* planar;
+  err = heif_decode_image(handle, &planar, heif_colorspace_undefined, heif_chroma_undefined, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_chroma_format(planar) == heif_chroma_444);
+
+  int width = heif_image_get_primary_width(planar);
+  int height = heif_image_get_primary_height(planar);
+
+  std::vector<uint8_t> expected;
+  int strides[3];
+  const uint8_t* planes[3];
+  const heif_channel channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+  for (int c = 0; c < 3; c++) {
+    planes[c] = heif_image_get_plane_readonly(planar, channels[c], &strides[c]);
+  }
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) {
+        expected.push_back(planes[c][y * strides[c] + x]);
+      }
+    }
+  }
+
+  heif_image_release(planar);
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  REQUIRE(decode_grid(file_data, 0) == expected);
+  REQUIRE(decode_grid(file_data, 4) == expected);
+}
+
+
+TEST_CASE("Decode into caller memory")
+{
+  heif_image* tiles[6];
+  for (int i = 0; i < 6; i++) {
+    tiles[i] = create_gradient_image(160, 120, i * 40);
+  }
+
+  std::vector<uint8_t> file_data = encode_grid(tiles, 0);
+
+  for (heif_image* tile : tiles) {
+    heif_image_release(tile);
+  }
+
+  heif_context* ctx = heif_context_alloc();
+  heif_error err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  int width = heif_image_handle_get_width(handle);
+  int height = heif_image_handle_get_height(handle);
+
+  // --- interleaved RGB, with padding at the end of the rows
+
+  heif_image* reference;
+  err = heif_decode_image(handle, &reference, heif_colorspace_RGB, heif_chroma_interleaved_RGB, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  size_t stride = width * 3 + 5;
+  std::vector<uint8_t> buffer(stride * height, 0xAB);
+  uint8_t* interleaved_planes[1] = {buffer.data()};
+  size_t interleaved_strides[1] = {stride};
+
+  err = heif_decode_image_into(handle, heif_colorspace_RGB, heif_chroma_interleaved_RGB,
+                               interleaved_planes, interleaved_strides, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> pixels;
+  for (int y = 0; y < height; y++) {
+    pixels.insert(pixels.end(), buffer.data() + y * stride, buffer.data() + y * stride + width * 3);
+    REQUIRE(buffer[y * stride + width * 3] == 0xAB);
+  }
+
+  REQUIRE(pixels == get_interleaved_pixels(reference, 0, 0, width, height));
+  heif_image_release(reference);
+
+  // --- planar RGB (the coded format of the tiles)
+
+  err = heif_decode_image(handle, &reference, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> planar_buffers[3];
+  uint8_t* planar_planes[3];
+  size_t planar_strides[3];
+  for (int c = 0; c < 3; c++) {
+    planar_buffers[c].resize(width * height);
+    planar_planes[c] = planar_buffers[c].data();
+    planar_strides[c] = width;
+  }
+
+  err = heif_decode_image_into(handle, heif_colorspace_RGB, heif_chroma_444, planar_planes, planar_strides, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  const heif_channel channels[3] = {heif_channel_R, heif_channel_G, heif_channel_B};
+  for (int c = 0; c < 3; c++) {
+    int ref_stride;
+    const uint8_t* ref = heif_image_get_plane_readonly(reference, channels[c], &ref_stride);
+    for (int y = 0; y < height; y++) {
+      REQUIRE(memcmp(planar_planes[c] + y * width, ref + y * ref_stride, width) == 0);
+    }
+  }
+
+  heif_image_release(reference);
+
+  // --- invalid arguments
+
+  err = heif_decode_image_into(handle, heif_colorspace_RGB, heif_chroma_420, planar_planes, planar_strides, nullptr);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  size_t short_strides[1] = {static_cast<size_t>(width * 3 - 1)};
+  err = heif_decode_image_into(handle, heif_colorspace_RGB, heif_chroma_interleaved_RGB,
+                               interleaved_planes, short_strides, nullptr);
+  REQUIRE(err.code == heif_error_Usage_error);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+}
+
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+static std::vector<uint8_t> encode_compressed_unci_tiles(heif_unci_compression compression, int max_encoding_threads)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, max_encoding_threads);
+
+  const int tile_size = 64;
+  const int columns = 4;
+  const int rows = 3;
+
+  heif_image* prototype = create_gradient_image(tile_size, tile_size, 0);
+
+  heif_unci_image_parameters params{};
+  params.version = 1;
+  params.image_width = tile_size * columns;
+  params.image_height = tile_size * rows;
+  params.tile_width = tile_size;
+  params.tile_height = tile_size;
+  params.compression = compression;
+
+  heif_image_handle* handle;
+  heif_error err = heif_context_add_unci_image(ctx, &params, nullptr, prototype, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_release(prototype);
+
+  for (int ty = 0; ty < rows; ty++) {
+    for (int tx = 0; tx < columns; tx++) {
+      heif_image* tile = create_gradient_image(tile_size, tile_size, ty * columns + tx);
+      err = heif_context_add_image_tile(ctx, handle, tx, ty, tile, nullptr);
+      REQUIRE(err.code == heif_error_Ok);
+      heif_image_release(tile);
+    }
+  }
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  return data;
+}
+
+TEST_CASE("Compress unci tiles with multiple threads")
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_unci_image_parameters params{};
+  params.version = 1;
+  params.image_width = params.image_height = params.tile_width = params.tile_height = 8;
+  params.compression = heif_unci_compression_deflate;
+  heif_image* prototype = create_gradient_image(8, 8, 0);
+  heif_image_handle* handle;
+  heif_error err = heif_context_add_unci_image(ctx, &params, nullptr, prototype, &handle);
+  heif_image_release(prototype);
+  if (err.code == heif_error_Ok) {
+    heif_image_handle_release(handle);
+  }
+  heif_context_free(ctx);
+
+  if (err.code == heif_error_Unsupported_feature) {
+    SKIP("Skipping test because deflate compression is not compiled.");
+  }
+
+  std::vector<uint8_t> sequential = encode_compressed_unci_tiles(heif_unci_compression_deflate, 0);
+  REQUIRE(!sequential.empty());
+  REQUIRE(encode_compressed_unci_tiles(heif_unci_compression_deflate, 1) == sequential);
+  REQUIRE(encode_compressed_unci_tiles(heif_unci_compression_deflate, 4) == sequential);
+}
+
+
+// Even tiles are flat, odd tiles are noise.
+static heif_image* create_flat_or_noise_tile(int size, int idx)
+{
+  heif_image* image;
+  heif_error err = heif_image_create(size, size, heif_colorspace_RGB, heif_chroma_444, &image);
+  REQUIRE(err.code == heif_error_Ok);
+
+  uint32_t state = 12345u + static_cast<uint32_t>(idx);
+
+  for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+    err = heif_image_add_plane(image, channel, size, size, 8);
+    REQUIRE(err.code == heif_error_Ok);
+
+    int stride;
+    uint8_t* p = heif_image_get_plane(image, channel, &stride);
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        state = state * 1664525u + 1013904223u;
+        p[y * stride + x] = (idx % 2) ? static_cast<uint8_t>(state >> 24) : 0;
+      }
+    }
+  }
+
+  return image;
+}
+
+static std::vector<uint8_t> encode_flat_and_noise_unci_tiles(heif_unci_compression compression,
+                                                             heif_unci_compression_selection selection,
+                                                             int max_encoding_threads)
+{
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, max_encoding_threads);
+
+  const int tile_size = 64;
+  const int columns = 3;
+  const int rows = 2;
+
+  heif_image* prototype = create_flat_or_noise_tile(tile_size, 0);
+
+  heif_unci_image_parameters params{};
+  params.version = 2;
+  params.image_width = tile_size * columns;
+  params.image_height = tile_size * rows;
+  params.tile_width = tile_size;
+  params.tile_height = tile_size;
+  params.compression = compression;
+  params.compression_selection = selection;
+
+  heif_image_handle* handle;
+  heif_error err = heif_context_add_unci_image(ctx, &params, nullptr, prototype, &handle);
+  heif_image_release(prototype);
+  if (err.code == heif_error_Unsupported_feature) {
+    heif_context_free(ctx);
+    return {};
+  }
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int ty = 0; ty < rows; ty++) {
+    for (int tx = 0; tx < columns; tx++) {
+      heif_image* tile = create_flat_or_noise_tile(tile_size, ty * columns + tx);
+      err = heif_context_add_image_tile(ctx, handle, tx, ty, tile, nullptr);
+      REQUIRE(err.code == heif_error_Ok);
+      heif_image_release(tile);
+    }
+  }
+
+  err = heif_context_set_primary_image(ctx, handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  std::vector<uint8_t> data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle_release(handle);
+  heif_context_free(ctx);
+
+  // The decoded image has to match the tiles.
+
+  heif_context* decode_ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(decode_ctx, data.data(), data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* decode_handle;
+  err = heif_context_get_primary_image_handle(decode_ctx, &decode_handle);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image* decoded;
+  err = heif_decode_image(decode_handle, &decoded, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (int ty = 0; ty < rows; ty++) {
+    for (int tx = 0; tx < columns; tx++) {
+      heif_image* tile = create_flat_or_noise_tile(tile_size, ty * columns + tx);
+
+      for (heif_channel channel : {heif_channel_R, heif_channel_G, heif_channel_B}) {
+        int tile_stride, decoded_stride;
+        const uint8_t* t = heif_image_get_plane_readonly(tile, channel, &tile_stride);
+        const uint8_t* d = heif_image_get_plane_readonly(decoded, channel, &decoded_stride);
+        for (int y = 0; y < tile_size; y++) {
+          REQUIRE(memcmp(t + y * tile_stride, d + (ty * tile_size + y) * decoded_stride + tx * tile_size, tile_size) == 0);
+        }
+      }
+
+      heif_image_release(tile);
+    }
+  }
+
+  heif_image_release(decoded);
+  heif_image_handle_release(decode_handle);
+  heif_context_free(decode_ctx);
+
+  return data;
+}
+
+TEST_CASE("Select the unci compression method automatically")
+{
+  std::vector<uint8_t> smallest = encode_flat_and_noise_unci_tiles(heif_unci_compression_auto,
+                                                                   heif_unci_compression_selection_smallest_size, 0);
+  if (smallest.empty()) {
+    SKIP("Skipping test because no compression method is compiled.");
+  }
+
+  REQUIRE(encode_flat_and_noise_unci_tiles(heif_unci_compression_auto,
+                                           heif_unci_compression_selection_smallest_size, 4) == smallest);
+
+  for (heif_unci_compression method : {heif_unci_compression_deflate,
+                                       heif_unci_compression_brotli,
+                                       heif_unci_compression_zstd}) {
+    std::vector<uint8_t> fixed = encode_flat_and_noise_unci_tiles(method, heif_unci_compression_selection_smallest_size, 0);
+    if (!fixed.empty()) {
+      REQUIRE(smallest.size() <= fixed.size());
+    }
+  }
+
+  std::vector<uint8_t> fastest = encode_flat_and_noise_unci_tiles(heif_unci_compression_auto,
+                                                                  heif_unci_compression_selection_decoding_speed, 2);
+  REQUIRE(fastest.size() >= smallest.size());
+}
+#endif
+
+
+TEST_CASE("Split large images into grid tiles while encoding")
+{
+  heif_image* image = create_gradient_image(300, 200, 0);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, 2);
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  options->grid_tile_size = 128;
+  options->image_orientation = heif_orientation_rotate_180;
+
+  heif_image_handle* handle;
+  err = heif_context_encode_image(ctx, image, encoder, options, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_handle_release(handle);
+
+  // An image that fits into a single tile is not split.
+  heif_image* small_image = create_gradient_image(100, 100, 1);
+  err = heif_context_encode_image(ctx, small_image, encoder, options, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_image_handle_release(handle);
+  heif_image_release(small_image);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options_free(options);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_context_get_number_of_top_level_images(ctx) == 2);
+
+  err = heif_context_get_primary_image_handle(ctx, &handle);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_handle_get_width(handle) == 300);
+  REQUIRE(heif_image_handle_get_height(handle) == 200);
+
+  heif_image_tiling tiling;
+  err = heif_image_handle_get_image_tiling(handle, false, &tiling);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(tiling.num_columns == 3);
+  REQUIRE(tiling.num_rows == 2);
+  REQUIRE(tiling.tile_width == 128);
+  REQUIRE(tiling.tile_height == 128);
+
+  // The orientation is applied to the whole image, not to each tile.
+  heif_image* decoded;
+  err = heif_decode_image(handle, &decoded, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // A rotation by 180 degrees reverses the pixel order in each plane.
+  std::vector<uint8_t> rotated = get_planar_pixels(image);
+  const size_t plane_size = 300 * 200;
+  for (size_t i = 0; i < 3; i++) {
+    std::reverse(rotated.begin() + i * plane_size, rotated.begin() + (i + 1) * plane_size);
+  }
+
+  REQUIRE(get_planar_pixels(decoded) == rotated);
+
+  heif_image_release(decoded);
+  heif_image_handle_release(handle);
+  heif_image_release(image);
+  heif_context_free(ctx);
+}
+
+
+#if HEIF_ENABLE_EXPERIMENTAL_FEATURES
+TEST_CASE("Encode multi-resolution pyramid")
+{
+  heif_image* image = create_gradient_image(400, 300, 0);
+
+  heif_context* ctx = heif_context_alloc();
+  heif_context_set_max_encoding_threads(ctx, 2);
+
+  heif_encoder* encoder;
+  heif_error err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_image_handle* handle;
+  heif_entity_group_id group_id;
+  err = heif_context_encode_pyramid(ctx, image, 128, 128, encoder, nullptr, &handle, &group_id);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_handle_get_width(handle) == 400);
+  REQUIRE(heif_image_handle_get_height(handle) == 300);
+  heif_image_handle_release(handle);
+
+  std::vector<uint8_t> file_data;
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+
+  // --- read back
+
+  ctx = heif_context_alloc();
+  err = heif_context_read_from_memory_without_copy(ctx, file_data.data(), file_data.size(), nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  // the downscaled layers are hidden
+  REQUIRE(heif_context_get_number_of_top_level_images(ctx) == 1);
+
+  int num_layers;
+  heif_pyramid_layer_info* layers = heif_context_get_pyramid_entity_group_info(ctx, group_id, &num_layers);
+  REQUIRE(layers != nullptr);
+  REQUIRE(num_layers == 3);
+
+  // 400x300 as 4x3 tiles, 200x150 as 2x2 tiles, 100x75 as a single image
+  REQUIRE(layers[0].layer_binning == 4);
+  REQUIRE(layers[1].layer_binning == 2);
+  REQUIRE(layers[1].tile_columns_in_layer == 2);
+  REQUIRE(layers[1].tile_rows_in_layer == 2);
+  REQUIRE(layers[2].layer_binning == 1);
+  REQUIRE(layers[2].tile_columns_in_layer == 4);
+  REQUIRE(layers[2].tile_rows_in_layer == 3);
+
+  heif_image_handle* smallest_handle;
+  err = heif_context_get_image_handle(ctx, layers[0].layer_image_id, &smallest_handle);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_pyramid_layer_info_release(layers);
+
+  heif_image* smallest;
+  err = heif_decode_image(smallest_handle, &smallest, heif_colorspace_RGB, heif_chroma_444, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(heif_image_get_primary_width(smallest) == 100);
+  REQUIRE(heif_image_get_primary_height(smallest) == 75);
+
+  // Each layer is scaled from the previous one. The result may differ from scaling the full image by rounding.
+
+  heif_scaling_options* scaling_options = heif_scaling_options_alloc();
+  heif_image* reference;
+  err = heif_image_scale_image(image, &reference, 100, 75, scaling_options);
+  REQUIRE(err.code == heif_error_Ok);
+  heif_scaling_options_free(scaling_options);
+
+  std::vector<uint8_t> pixels = get_planar_pixels(smallest);
+  std::vector<uint8_t> reference_pixels = get_planar_pixels(reference);
+  REQUIRE(pixels.size() == reference_pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++) {
+    REQUIRE(std::abs(pixels[i] - reference_pixels[i]) <= 1);
+  }
+
+  heif_image_release(reference);
+  heif_image_release(smallest);
+  heif_image_handle_release(smallest_handle);
+  heif_image_release(image);
+  heif_context_free(ctx);
+}
+
+#endif
+
+
+TEST_CASE("Encode YCbCr with other nclx primaries without conversion")
+{
+  const int width = 64, height = 48;
+
+  heif_image* image;
+  heif_error err = heif_image_create(width, height, heif_colorspace_YCbCr, heif_chroma_420, &image);
+  REQUIRE(err.code == heif_error_Ok);
+
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    int w = (channel == heif_channel_Y ? width : width / 2);
+    int h = (channel == heif_channel_Y ? height : height / 2);
+
+    err = heif_image_add_plane(image, channel, w, h, 8);
+    REQUIRE(err.code == heif_error_Ok);
+
+    int stride;
+    uint8_t* p = heif_image_get_plane(image, channel, &stride);
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        p[y * stride + x] = overlay_layer_value(channel, x, y, 0);
+      }
+    }
+  }
+
+  heif_color_profile_nclx* image_nclx = heif_nclx_color_profile_alloc();
+  image_nclx->matrix_coefficients = heif_matrix_coefficients_ITU_R_BT_601_6;
+  image_nclx->color_primaries = heif_color_primaries_ITU_R_BT_709_5;
+  image_nclx->full_range_flag = 1;
+  heif_image_set_nclx_color_profile(image, image_nclx);
+
+  // Only the primaries differ. They do not change the YCbCr values, thus the image is encoded as it is.
+  heif_color_profile_nclx* output_nclx = heif_nclx_color_profile_alloc();
+  *output_nclx = *image_nclx;
+  output_nclx->color_primaries = heif_color_primaries_ITU_R_BT_2020_2_and_2100_0;
+
+  heif_context* ctx = heif_context_alloc();
+  heif_encoder* encoder;
+  err = heif_context_get_encoder_for_format(ctx, heif_compression_uncompressed, &encoder);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options* options = heif_encoding_options_alloc();
+  options->output_nclx_profile = output_nclx;
+
+  err = heif_context_encode_image(ctx, image, encoder, options, nullptr);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_writer writer{};
+  writer.writer_api_version = 1;
+  writer.write = write_to_vector;
+
+  std::vector<uint8_t> file_data;
+  err = heif_context_write(ctx, &writer, &file_data);
+  REQUIRE(err.code == heif_error_Ok);
+
+  heif_encoding_options_free(options);
+  heif_nclx_color_profile_free(output_nclx);
+  heif_nclx_color_profile_free(image_nclx);
+  heif_encoder_release(encoder);
+  heif_context_free(ctx);
+  heif_image_release(image);
+
+  std::vector<std::vector<uint8_t>> planes = decode_primary_image_ycbcr420(file_data, 0);
+
+  int plane_index = 0;
+  for (heif_channel channel : {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}) {
+    int w = (channel == heif_channel_Y ? width : width / 2);
+    int h = (channel == heif_channel_Y ? height : height / 2);
+
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        INFO(channel << ": " << x << ";" << y);
+        REQUIRE(planes[plane_index][y * w + x] == overlay_layer_value(channel, x, y, 0));
+      }
+    }
+
+    plane_index++;
+  }
+}
@@ -0,0 +1,89 @@
+/*
+  libheifio Y4M decode unit tests
+
+  MIT License
+
+  Copyright (c) 2025 Dirk Farin <dirk.farin@gmail.com>
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "catch_amalgamated.hpp"
+#include <cstdint>
+#include "heifio/decoder.h"
+#include "heifio/decoder_y4m.h"
+#include "test_utils.h"
+#include "libheif/heif.h"
+
+// frames.y4m: 6x4 pixels, 4:2:0, three frames at 30000:1001 fps.
+// The luma samples of frame k are 16*k + i, the chroma planes are filled with 100+k and 200+k.
+
+static void checkFrame(const InputImage& input_image, int k)
+{
+  REQUIRE(input_image.image != nullptr);
+  const struct heif_image* image = input_image.image.get();
+  REQUIRE(heif_image_get_colorspace(image) == heif_colorspace_YCbCr);
+  REQUIRE(heif_image_get_chroma_format(image) == heif_chroma_420);
+  REQUIRE(heif_image_get_width(image, heif_channel_Y) == 6);
+  REQUIRE(heif_image_get_height(image, heif_channel_Y) == 4);
+  REQUIRE(heif_image_get_width(image, heif_channel_Cb) == 3);
+  REQUIRE(heif_image_get_height(image, heif_channel_Cb) == 2);
+
+  size_t stride;
+  const uint8_t* py = heif_image_get_plane_readonly2(image, heif_channel_Y, &stride);
+  REQUIRE(py[0] == 16 * k);
+  REQUIRE(py[3 * stride + 5] == 16 * k + 23);
+
+  const uint8_t* pcb = heif_image_get_plane_readonly2(image, heif_channel_Cb, &stride);
+  REQUIRE(pcb[stride + 2] == 100 + k);
+
+  const uint8_t* pcr = heif_image_get_plane_readonly2(image, heif_channel_Cr, &stride);
+  REQUIRE(pcr[0] == 200 + k);
+}
+
+TEST_CASE("first frame") {
+  InputImage input_image;
+  std::string path = get_path_for_heifio_test_file("frames.y4m");
+  heif_error err = loadY4M(path.c_str(), &input_image);
+  REQUIRE(err.code == heif_error_Ok);
+  checkFrame(input_image, 0);
+}
+
+TEST_CASE("read all frames") {
+  Y4MReader reader;
+  std::string path = get_path_for_heifio_test_file("frames.y4m");
+  heif_error err = reader.open(path.c_str());
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(reader.get_width() == 6);
+  REQUIRE(reader.get_height() == 4);
+  REQUIRE(reader.get_framerate_numerator() == 30000);
+  REQUIRE(reader.get_framerate_denominator() == 1001);
+
+  for (int k = 0; k < 3; k++) {
+    InputImage input_image;
+    err = reader.read_next_frame(&input_image);
+    REQUIRE(err.code == heif_error_Ok);
+    checkFrame(input_image, k);
+  }
+
+  InputImage input_image;
+  err = reader.read_next_frame(&input_image);
+  REQUIRE(err.code == heif_error_Ok);
+  REQUIRE(input_image.image == nullptr);
+}